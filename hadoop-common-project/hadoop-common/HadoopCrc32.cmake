@@ -0,0 +1,51 @@
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+#
+# CRC32 and CRC32C routines shared by all Native components, with hardware
+# acceleration selected at runtime when the platform has it.
+#
+# Sets HADOOP_CRC32_SOURCES, to be compiled into the library, and
+# HADOOP_CRC32_INCLUDE_DIRS, where bulk_crc32.h is found.
+#
+
+set(_hadoop_crc32_src ${CMAKE_CURRENT_LIST_DIR}/src/main/native/src)
+set(HADOOP_CRC32_INCLUDE_DIRS
+    ${_hadoop_crc32_src}
+    ${_hadoop_crc32_src}/org/apache/hadoop/util)
+set(HADOOP_CRC32_SOURCES ${_hadoop_crc32_src}/org/apache/hadoop/util/bulk_crc32.c)
+
+# Build hardware CRC32 acceleration, if supported on the platform.
+if(CMAKE_SYSTEM_PROCESSOR MATCHES "^i.86$" OR CMAKE_SYSTEM_PROCESSOR STREQUAL "x86_64" OR CMAKE_SYSTEM_PROCESSOR STREQUAL "amd64")
+    list(APPEND HADOOP_CRC32_SOURCES ${_hadoop_crc32_src}/org/apache/hadoop/util/bulk_crc32_x86.c)
+    set(_hadoop_crc32_arch TRUE)
+elseif(CMAKE_SYSTEM_PROCESSOR STREQUAL "aarch64")
+    list(APPEND HADOOP_CRC32_SOURCES ${_hadoop_crc32_src}/org/apache/hadoop/util/bulk_crc32_aarch64.c)
+    set(_hadoop_crc32_arch TRUE)
+elseif(CMAKE_SYSTEM_PROCESSOR STREQUAL "ppc64le")
+    list(APPEND HADOOP_CRC32_SOURCES ${_hadoop_crc32_src}/org/apache/hadoop/util/bulk_crc32_ppc64le.c)
+    set(_hadoop_crc32_arch TRUE)
+else()
+    message("No HW CRC acceleration for ${CMAKE_SYSTEM_PROCESSOR}, falling back to SW")
+endif()
+
+# bulk_crc32.c runs the cpu detection of the architecture specific file.
+if(_hadoop_crc32_arch)
+    set_source_files_properties(${_hadoop_crc32_src}/org/apache/hadoop/util/bulk_crc32.c
+        PROPERTIES COMPILE_DEFINITIONS HADOOP_CRC32_ARCH)
+endif()
@@ -0,0 +1,34 @@
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+
+#
+# Accounting of the memory native code allocates, by subsystem, shared by
+# all Native components. Each library that compiles it in keeps counters of
+# its own.
+#
+# Sets HADOOP_NATIVE_MEMORY_SOURCES, to be compiled into the library, and
+# HADOOP_NATIVE_MEMORY_INCLUDE_DIRS, where native_memory.h is found.
+#
+
+set(_hadoop_native_memory_src ${CMAKE_CURRENT_LIST_DIR}/src/main/native/src)
+set(HADOOP_NATIVE_MEMORY_INCLUDE_DIRS
+    ${_hadoop_native_memory_src}
+    ${_hadoop_native_memory_src}/org/apache/hadoop/util)
+set(HADOOP_NATIVE_MEMORY_SOURCES
+    ${_hadoop_native_memory_src}/org/apache/hadoop/util/native_memory.c)
@@ -24,6 +24,7 @@
 import java.nio.ByteBuffer;
 import java.security.GeneralSecurityException;
 import java.security.SecureRandom;
+import java.util.Arrays;
 import java.util.Random;
 
 import org.apache.commons.logging.Log;
@@ -105,6 +106,8 @@ private static class OpensslAesCtrCipher implements Encryptor, Decryptor {
     private final OpensslCipher cipher;
     private final int mode;
     private boolean contextReset = false;
+    /** The key of the last init, whose key schedule the cipher holds. */
+    private byte[] lastKey;
     
     public OpensslAesCtrCipher(int mode) throws GeneralSecurityException {
       this.mode = mode;
@@ -115,8 +118,14 @@ public OpensslAesCtrCipher(int mode) throws GeneralSecurityException {
     public void init(byte[] key, byte[] iv) throws IOException {
       Preconditions.checkNotNull(key);
       Preconditions.checkNotNull(iv);
+      if (!contextReset && lastKey != null && Arrays.equals(key, lastKey)) {
+        // Only the counter moves, e.g. for a seek or a positioned read
+        cipher.setIV(iv, 0);
+        return;
+      }
       contextReset = false;
       cipher.init(mode, key, iv);
+      lastKey = key.clone();
     }
     
     /**
@@ -21,6 +21,7 @@
 import java.security.NoSuchAlgorithmException;
 import java.util.StringTokenizer;
 
+import javax.crypto.AEADBadTagException;
 import javax.crypto.BadPaddingException;
 import javax.crypto.IllegalBlockSizeException;
 import javax.crypto.NoSuchPaddingException;
@@ -29,6 +30,8 @@
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.fs.ChecksumException;
+import org.apache.hadoop.util.DataChecksum;
 import org.apache.hadoop.util.NativeCodeLoader;
 
 import com.google.common.base.Preconditions;
@@ -36,8 +39,17 @@
 
 /**
  * OpenSSL cipher using JNI.
- * Currently only AES-CTR is supported. It's flexible to add 
+ * Currently only AES-CTR and AES-GCM are supported. It's flexible to add 
  * other crypto algorithms/modes.
+ * <p/>
+ *
+ * AES-GCM works like it does in {@link javax.crypto.Cipher}: the iv is 12
+ * bytes, the 16 byte tag is written by {@link #doFinal(ByteBuffer)} after
+ * the data when encrypting, and read from the end of the input when
+ * decrypting, so that {@link #update(ByteBuffer, ByteBuffer)} holds the
+ * last 16 bytes it is given back until more input arrives. Unlike there,
+ * decrypted data is returned before the tag is checked, and must not be
+ * trusted until doFinal has returned.
  */
 @InterfaceAudience.Private
 public final class OpensslCipher {
@@ -45,10 +57,13 @@ public final class OpensslCipher {
       LogFactory.getLog(OpensslCipher.class.getName());
   public static final int ENCRYPT_MODE = 1;
   public static final int DECRYPT_MODE = 0;
+  /** The length of the AES-GCM authentication tag. */
+  public static final int GCM_TAG_LENGTH = 16;
   
-  /** Currently only support AES/CTR/NoPadding. */
+  /** Currently only support AES/CTR/NoPadding and AES/GCM/NoPadding. */
   private static enum AlgMode {
-    AES_CTR;
+    AES_CTR,
+    AES_GCM;
     
     static int get(String algorithm, String mode) 
         throws NoSuchAlgorithmException {
@@ -76,6 +91,11 @@ static int get(String padding) throws NoSuchPaddingException {
   private long context = 0;
   private final int alg;
   private final int padding;
+  private boolean encrypt;
+  /** Whether a key has been set up by init, which setIV depends on. */
+  private boolean keyed;
+  /** The input held back as the possible tag when decrypting AES-GCM. */
+  private ByteBuffer tagBuffer;
   
   private static final String loadingFailureReason;
 
@@ -176,6 +196,50 @@ private static Transform tokenizeTransformation(String transformation)
    */
   public void init(int mode, byte[] key, byte[] iv) {
     context = init(context, mode, alg, padding, key, iv);
+    encrypt = mode == ENCRYPT_MODE;
+    keyed = true;
+    if (alg == AlgMode.AES_GCM.ordinal()) {
+      if (tagBuffer == null) {
+        tagBuffer = ByteBuffer.allocateDirect(GCM_TAG_LENGTH);
+      }
+      tagBuffer.clear();
+    }
+  }
+
+  /**
+   * Restarts AES-CTR at another counter, keeping the key and mode of the
+   * last {@link #init(int, byte[], byte[])}. Unlike init, the key schedule
+   * is not computed again, which makes it cheap to move to a new position,
+   * e.g. for each positioned read of an encrypted file.
+   * <p/>
+   *
+   * The first <code>skip</code> bytes of the keystream of the counter
+   * block are used up, so the next byte given to
+   * {@link #update(ByteBuffer, ByteBuffer)} is processed as if it were at
+   * offset <code>skip</code> of that block.
+   *
+   * @param iv crypto iv, the counter block to start at
+   * @param skip the offset in the counter block, less than its 16 bytes
+   */
+  public void setIV(byte[] iv, int skip) {
+    checkState();
+    Preconditions.checkState(alg == AlgMode.AES_CTR.ordinal(),
+        "Setting the iv alone is only supported by AES/CTR.");
+    Preconditions.checkState(keyed, "Cipher has not been initialized.");
+    setIV(context, iv, skip);
+  }
+
+  /**
+   * Supplies additional authenticated data for AES-GCM. It must be given
+   * after init and before any data.
+   *
+   * @param aad the additional authenticated data
+   */
+  public void updateAAD(byte[] aad) {
+    checkState();
+    Preconditions.checkState(alg == AlgMode.AES_GCM.ordinal(),
+        "AAD is only supported by AES/GCM.");
+    updateAAD(context, aad, 0, aad.length);
   }
   
   /**
@@ -208,13 +272,144 @@ public int update(ByteBuffer input, ByteBuffer output)
     checkState();
     Preconditions.checkArgument(input.isDirect() && output.isDirect(), 
         "Direct buffers are required.");
+    if (tagBuffer != null && !encrypt) {
+      return updateHoldingTag(input, output);
+    }
     int len = update(context, input, input.position(), input.remaining(),
         output, output.position(), output.remaining());
     input.position(input.limit());
     output.position(output.position() + len);
     return len;
   }
+
+  /**
+   * Decrypts all but the last {@link #GCM_TAG_LENGTH} bytes seen so far,
+   * those held back before first, and holds back the last ones.
+   */
+  private int updateHoldingTag(ByteBuffer input, ByteBuffer output)
+      throws ShortBufferException {
+    int held = tagBuffer.position();
+    int toDecrypt = held + input.remaining() - GCM_TAG_LENGTH;
+    if (toDecrypt <= 0) {
+      tagBuffer.put(input);
+      return 0;
+    }
+    int fromHeld = Math.min(toDecrypt, held);
+    int fromInput = toDecrypt - fromHeld;
+    if (output.remaining() < toDecrypt) {
+      throw new ShortBufferException("Output buffer is not sufficient.");
+    }
+    int len = 0;
+    if (fromHeld > 0) {
+      len = update(context, tagBuffer, 0, fromHeld,
+          output, output.position(), output.remaining());
+      tagBuffer.flip();
+      tagBuffer.position(fromHeld);
+      tagBuffer.compact();
+    }
+    if (fromInput > 0) {
+      len += update(context, input, input.position(), fromInput,
+          output, output.position() + len, output.remaining() - len);
+      input.position(input.position() + fromInput);
+    }
+    tagBuffer.put(input);
+    output.position(output.position() + len);
+    return len;
+  }
   
+  /**
+   * Verifies the chunked checksums of the input and continues the
+   * encryption or decryption with it, in a single pass: the input is
+   * decrypted a few KB at a time right after its checksums are verified,
+   * while it is still in the cache, so it is only read from memory once.
+   * This suits reads from an encryption zone, where the checksums stored
+   * with a block are those of its encrypted bytes.
+   * <p/>
+   *
+   * The input must start at a chunk boundary, and <code>sums</code> holds
+   * the checksums of its chunks from its position on. The positions of
+   * input and output are advanced as by {@link #update(ByteBuffer,
+   * ByteBuffer)}; that of sums is not modified.
+   *
+   * @param input the input ByteBuffer
+   * @param output the output ByteBuffer
+   * @param checksum the CRC32 or CRC32C checksum of the input
+   * @param sums the direct ByteBuffer of stored checksums
+   * @param fileName the name of the file being read, for the exception
+   * @param basePos the position in the file where the input starts
+   * @return int number of bytes stored in <code>output</code>
+   * @throws ShortBufferException if there is insufficient space in the
+   * output buffer
+   * @throws ChecksumException if a checksum does not match. Output may
+   * have been written for the chunks before it.
+   */
+  public int updateVerified(ByteBuffer input, ByteBuffer output,
+      DataChecksum checksum, ByteBuffer sums, String fileName, long basePos)
+      throws ShortBufferException, ChecksumException {
+    checkState();
+    Preconditions.checkState(alg == AlgMode.AES_CTR.ordinal(),
+        "Verified updates are only supported by AES/CTR.");
+    Preconditions.checkArgument(input.isDirect() && output.isDirect() &&
+        sums.isDirect(), "Direct buffers are required.");
+    int len = updateVerified(context, input, input.position(),
+        input.remaining(), output, output.position(), output.remaining(),
+        checksum.getBytesPerChecksum(), checksum.getChecksumType().id,
+        sums, sums.position(), fileName, basePos);
+    input.position(input.limit());
+    output.position(output.position() + len);
+    return len;
+  }
+
+  /**
+   * Encrypts or decrypts several independent buffers in a single native
+   * call. Buffer i is processed as if this cipher had been initialized with
+   * <code>keys[i]</code> and <code>ivs[i]</code> and then updated with
+   * <code>inputs[i]</code> into <code>outputs[i]</code>, so many small
+   * reads or writes only pay for one JNI call. The key schedule is only
+   * computed again when a key differs from the one before it, so buffers
+   * that share a key are cheapest next to each other.
+   * <p/>
+   *
+   * The positions of the buffers are advanced as by
+   * {@link #update(ByteBuffer, ByteBuffer)}. Afterwards this cipher is in
+   * the state the last buffer left it in.
+   *
+   * @param mode {@link #ENCRYPT_MODE} or {@link #DECRYPT_MODE}
+   * @param keys the crypto key of each buffer
+   * @param ivs the crypto iv of each buffer
+   * @param inputs the direct input buffers
+   * @param outputs the direct output buffers
+   * @throws ShortBufferException if an output buffer is too small for its
+   * input, in which case the buffers before it have been processed
+   */
+  public void updateBatch(int mode, byte[][] keys, byte[][] ivs,
+      ByteBuffer[] inputs, ByteBuffer[] outputs) throws ShortBufferException {
+    checkState();
+    Preconditions.checkState(alg == AlgMode.AES_CTR.ordinal(),
+        "Batches are only supported by AES/CTR.");
+    int count = inputs.length;
+    Preconditions.checkArgument(keys.length == count && ivs.length == count
+        && outputs.length == count, "Batch arrays differ in length.");
+    int[] inputOffsets = new int[count];
+    int[] inputLengths = new int[count];
+    int[] outputOffsets = new int[count];
+    int[] outputLengths = new int[count];
+    for (int i = 0; i < count; i++) {
+      Preconditions.checkArgument(inputs[i].isDirect() &&
+          outputs[i].isDirect(), "Direct buffers are required.");
+      inputOffsets[i] = inputs[i].position();
+      inputLengths[i] = inputs[i].remaining();
+      outputOffsets[i] = outputs[i].position();
+      outputLengths[i] = outputs[i].remaining();
+    }
+    context = updateBatch(context, mode, alg, padding, keys, ivs, inputs,
+        inputOffsets, inputLengths, outputs, outputOffsets, outputLengths);
+    for (int i = 0; i < count; i++) {
+      inputs[i].position(inputs[i].limit());
+      outputs[i].position(outputOffsets[i] + outputLengths[i]);
+    }
+  }
+
   /**
    * Finishes a multiple-part operation. The data is encrypted or decrypted,
    * depending on how this cipher was initialized.
@@ -231,7 +426,7 @@ public int update(ByteBuffer input, ByteBuffer output)
    * 
    * Upon finishing, this method resets this cipher object to the state it was
    * in when previously initialized. That is, the object is available to encrypt
-   * or decrypt more data.
+   * or decrypt more data. AES-GCM must be initialized again with a new iv.
    * <p/>
    * 
    * If any exception is thrown, this cipher object need to be reset before it 
@@ -241,12 +436,23 @@ public int update(ByteBuffer input, ByteBuffer output)
    * @return int number of bytes stored in <code>output</code>
    * @throws ShortBufferException
    * @throws IllegalBlockSizeException
-   * @throws BadPaddingException
+   * @throws BadPaddingException an {@link AEADBadTagException} if the AES-GCM
+   * tag does not match the data
    */
   public int doFinal(ByteBuffer output) throws ShortBufferException, 
       IllegalBlockSizeException, BadPaddingException {
     checkState();
     Preconditions.checkArgument(output.isDirect(), "Direct buffer is required.");
+    if (tagBuffer != null && !encrypt) {
+      if (tagBuffer.position() < GCM_TAG_LENGTH) {
+        throw new AEADBadTagException("Input too short, the tag is missing.");
+      }
+      byte[] tag = new byte[GCM_TAG_LENGTH];
+      tagBuffer.flip();
+      tagBuffer.get(tag);
+      tagBuffer.clear();
+      setTag(context, tag);
+    }
     int len = doFinal(context, output, output.position(), output.remaining());
     output.position(output.position() + len);
     return len;
@@ -257,6 +463,7 @@ public void clean() {
     if (context != 0) {
       clean(context);
       context = 0;
+      keyed = false;
     }
   }
 
@@ -277,9 +484,27 @@ protected void finalize() throws Throwable {
   private native long init(long context, int mode, int alg, int padding, 
       byte[] key, byte[] iv);
   
-  private native int update(long context, ByteBuffer input, int inputOffset, 
+  private native void setIV(long context, byte[] iv, int skip);
+
+  private native int update(long context, ByteBuffer input, int inputOffset,
       int inputLength, ByteBuffer output, int outputOffset, int maxOutputLength);
   
+  private native int updateVerified(long context, ByteBuffer input,
+      int inputOffset, int inputLength, ByteBuffer output, int outputOffset,
+      int maxOutputLength, int bytesPerChecksum, int checksumType,
+      ByteBuffer sums, int sumsOffset, String fileName, long basePos)
+      throws ChecksumException;
+
+  private native long updateBatch(long context, int mode, int alg,
+      int padding, byte[][] keys, byte[][] ivs, ByteBuffer[] inputs,
+      int[] inputOffsets, int[] inputLengths, ByteBuffer[] outputs,
+      int[] outputOffsets, int[] outputLengths);
+  
+  private native void updateAAD(long context, byte[] aad, int offset,
+      int length);
+
+  private native void setTag(long context, byte[] tag);
+  
   private native int doFinal(long context, ByteBuffer output, int offset, 
       int maxOutputLength);
   
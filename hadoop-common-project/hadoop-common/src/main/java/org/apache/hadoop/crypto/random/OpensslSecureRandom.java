@@ -22,11 +22,16 @@
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.conf.Configurable;
+import org.apache.hadoop.conf.Configuration;
 import org.apache.hadoop.util.NativeCodeLoader;
 
 import com.google.common.base.Preconditions;
 import org.apache.hadoop.util.PerformanceAdvisory;
 
+import static org.apache.hadoop.fs.CommonConfigurationKeysPublic.HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_KEY;
+import static org.apache.hadoop.fs.CommonConfigurationKeysPublic.HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_DEFAULT;
+
 /**
  * OpenSSL secure random using JNI.
  * This implementation is thread-safe.
@@ -38,17 +43,27 @@
  * OpenSSL secure random generator will be used. It's still faster
  * and can generate strong random bytes.
  * <p/>
+ *
+ * All threads share the OpenSSL generator, which takes a lock for every
+ * call. With {@link org.apache.hadoop.fs.CommonConfigurationKeysPublic
+ * #HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_KEY} set, every thread
+ * instead gets a ChaCha20 generator of its own, which only goes back to
+ * OpenSSL to reseed.
+ * <p/>
  * @see https://wiki.openssl.org/index.php/Random_Numbers
  * @see http://en.wikipedia.org/wiki/RdRand
  */
 @InterfaceAudience.Private
-public class OpensslSecureRandom extends Random {
+public class OpensslSecureRandom extends Random implements Configurable {
   private static final long serialVersionUID = -7828193502768789584L;
   private static final Log LOG =
       LogFactory.getLog(OpensslSecureRandom.class.getName());
   
   /** If native SecureRandom unavailable, use java SecureRandom */
   private java.security.SecureRandom fallback = null;
+  private transient Configuration conf;
+  private boolean perThread =
+      HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_DEFAULT;
   private static boolean nativeEnabled = false;
   static {
     if (NativeCodeLoader.isNativeCodeLoaded() &&
@@ -74,6 +89,19 @@ public OpensslSecureRandom() {
     }
   }
   
+  @Override
+  public void setConf(Configuration conf) {
+    this.conf = conf;
+    this.perThread = conf.getBoolean(
+        HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_KEY,
+        HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_DEFAULT);
+  }
+
+  @Override
+  public Configuration getConf() {
+    return conf;
+  }
+
   /**
    * Generates a user-specified number of random bytes.
    * It's thread-safe.
@@ -82,7 +110,8 @@ public OpensslSecureRandom() {
    */
   @Override
   public void nextBytes(byte[] bytes) {
-    if (!nativeEnabled || !nextRandBytes(bytes)) {
+    if (!nativeEnabled ||
+        !(perThread ? nextThreadRandBytes(bytes) : nextRandBytes(bytes))) {
       fallback.nextBytes(bytes);
     }
   }
@@ -119,4 +148,5 @@ final protected int next(int numBits) {
   
   private native static void initSR();
   private native boolean nextRandBytes(byte[] bytes); 
+  private native boolean nextThreadRandBytes(byte[] bytes);
 }
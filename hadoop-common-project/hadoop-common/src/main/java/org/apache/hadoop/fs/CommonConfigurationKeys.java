@@ -125,6 +125,27 @@ public class CommonConfigurationKeys extends CommonConfigurationKeysPublic {
   public static final int IO_COMPRESSION_CODEC_SNAPPY_BUFFERSIZE_DEFAULT =
       256 * 1024;
 
+  /**
+   * Number of threads that may compress one buffer of a Snappy compressor.
+   * With more than 1, buffers are compressed as frames that each become a
+   * chunk of their own in the block, which existing readers decompress as
+   * before.
+   */
+  public static final String IO_COMPRESSION_CODEC_SNAPPY_COMPRESS_THREADS_KEY =
+      "io.compression.codec.snappy.compress.threads";
+
+  /** Default value for IO_COMPRESSION_CODEC_SNAPPY_COMPRESS_THREADS_KEY */
+  public static final int IO_COMPRESSION_CODEC_SNAPPY_COMPRESS_THREADS_DEFAULT =
+      1;
+
+  /** Size of the frames of IO_COMPRESSION_CODEC_SNAPPY_COMPRESS_THREADS_KEY */
+  public static final String IO_COMPRESSION_CODEC_SNAPPY_FRAMESIZE_KEY =
+      "io.compression.codec.snappy.framesize";
+
+  /** Default value for IO_COMPRESSION_CODEC_SNAPPY_FRAMESIZE_KEY */
+  public static final int IO_COMPRESSION_CODEC_SNAPPY_FRAMESIZE_DEFAULT =
+      1024 * 1024;
+
   /** Internal buffer size for Lz4 compressor/decompressors */
   public static final String IO_COMPRESSION_CODEC_LZ4_BUFFERSIZE_KEY =
       "io.compression.codec.lz4.buffersize";
@@ -141,6 +162,88 @@ public class CommonConfigurationKeys extends CommonConfigurationKeysPublic {
   public static final boolean IO_COMPRESSION_CODEC_LZ4_USELZ4HC_DEFAULT =
       false;
 
+  /**
+   * Acceleration of lz4 compression.  Each step above 1 trades compression
+   * ratio for a few percent of speed.  Ignored with lz4hc.
+   */
+  public static final String IO_COMPRESSION_CODEC_LZ4_ACCELERATION_KEY =
+      "io.compression.codec.lz4.acceleration";
+
+  /** Default value for IO_COMPRESSION_CODEC_LZ4_ACCELERATION_KEY */
+  public static final int IO_COMPRESSION_CODEC_LZ4_ACCELERATION_DEFAULT = 1;
+
+  /** Level of lz4hc compression, 1 to 16, or 0 for the lz4hc default of 8 */
+  public static final String IO_COMPRESSION_CODEC_LZ4HC_LEVEL_KEY =
+      "io.compression.codec.lz4.lz4hc.level";
+
+  /** Default value for IO_COMPRESSION_CODEC_LZ4HC_LEVEL_KEY */
+  public static final int IO_COMPRESSION_CODEC_LZ4HC_LEVEL_DEFAULT = 0;
+
+  /**
+   * Whether each lz4 block of a stream may refer to the last 64 KB of data
+   * before it, which helps the ratio of small blocks.  Streams written this
+   * way must be read with the same setting.
+   */
+  public static final String IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_KEY =
+      "io.compression.codec.lz4.linked.blocks";
+
+  /** Default value for IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_KEY */
+  public static final boolean IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_DEFAULT =
+      false;
+
+  /**
+   * Number of threads that may compress one buffer of a Lz4 compressor.
+   * With more than 1, buffers are compressed as frames that each become a
+   * chunk of their own in the block, which existing readers decompress as
+   * before.
+   */
+  public static final String IO_COMPRESSION_CODEC_LZ4_COMPRESS_THREADS_KEY =
+      "io.compression.codec.lz4.compress.threads";
+
+  /** Default value for IO_COMPRESSION_CODEC_LZ4_COMPRESS_THREADS_KEY */
+  public static final int IO_COMPRESSION_CODEC_LZ4_COMPRESS_THREADS_DEFAULT =
+      1;
+
+  /** Size of the frames of IO_COMPRESSION_CODEC_LZ4_COMPRESS_THREADS_KEY */
+  public static final String IO_COMPRESSION_CODEC_LZ4_FRAMESIZE_KEY =
+      "io.compression.codec.lz4.framesize";
+
+  /** Default value for IO_COMPRESSION_CODEC_LZ4_FRAMESIZE_KEY */
+  public static final int IO_COMPRESSION_CODEC_LZ4_FRAMESIZE_DEFAULT =
+      1024 * 1024;
+
+  /** Internal buffer size for zstd compressor/decompressors */
+  public static final String IO_COMPRESSION_CODEC_ZSTD_BUFFERSIZE_KEY =
+      "io.compression.codec.zstd.buffersize";
+
+  /** Default value for IO_COMPRESSION_CODEC_ZSTD_BUFFERSIZE_KEY */
+  public static final int IO_COMPRESSION_CODEC_ZSTD_BUFFERSIZE_DEFAULT =
+      128 * 1024;
+
+  /** Level of zstd compression, up to 22; negative levels are faster */
+  public static final String IO_COMPRESSION_CODEC_ZSTD_LEVEL_KEY =
+      "io.compression.codec.zstd.level";
+
+  /** Default value for IO_COMPRESSION_CODEC_ZSTD_LEVEL_KEY */
+  public static final int IO_COMPRESSION_CODEC_ZSTD_LEVEL_DEFAULT = 3;
+
+  /**
+   * Log2 of the zstd window, or 0 for the default of the level.  Windows
+   * over 2^27 must be configured on readers too.
+   */
+  public static final String IO_COMPRESSION_CODEC_ZSTD_WINDOW_LOG_KEY =
+      "io.compression.codec.zstd.window.log";
+
+  /** Default value for IO_COMPRESSION_CODEC_ZSTD_WINDOW_LOG_KEY */
+  public static final int IO_COMPRESSION_CODEC_ZSTD_WINDOW_LOG_DEFAULT = 0;
+
+  /**
+   * Local path of a zstd dictionary, as trained by zstd --train, to compress
+   * and decompress with.  Readers need the same dictionary.
+   */
+  public static final String IO_COMPRESSION_CODEC_ZSTD_DICTIONARY_KEY =
+      "io.compression.codec.zstd.dictionary";
+
   /**
    * Erasure Coding configuration family
    */
@@ -152,6 +255,16 @@ public class CommonConfigurationKeys extends CommonConfigurationKeysPublic {
   public static final String IO_ERASURECODE_CODEC_RS_RAWCODER_KEY =
       "io.erasurecode.codec.rs.rawcoder";
 
+  /**
+   * Number of threads that may decode one stripe with the native RS decoder.
+   * Cells of at least 128 KB are cut into slices decoded in parallel.
+   */
+  public static final String IO_ERASURECODE_CODEC_RS_DECODE_THREADS_KEY =
+      "io.erasurecode.codec.rs.decode.threads";
+
+  /** Default value for IO_ERASURECODE_CODEC_RS_DECODE_THREADS_KEY */
+  public static final int IO_ERASURECODE_CODEC_RS_DECODE_THREADS_DEFAULT = 1;
+
   /** Raw coder factory for the XOR codec. */
   public static final String IO_ERASURECODE_CODEC_XOR_RAWCODER_KEY =
       "io.erasurecode.codec.xor.rawcoder";
@@ -291,6 +291,26 @@ public class CommonConfigurationKeysPublic {
   public static final long HADOOP_SECURITY_GROUPS_CACHE_WARN_AFTER_MS_DEFAULT =
     5000;
   /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final String HADOOP_SECURITY_GROUPS_JNI_NAME_CACHE_SECS =
+    "hadoop.security.groups.jni.name.cache.secs";
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final long HADOOP_SECURITY_GROUPS_JNI_NAME_CACHE_SECS_DEFAULT =
+    300;
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final String
+      HADOOP_SECURITY_GROUPS_JNI_NAME_NEGATIVE_CACHE_SECS =
+    "hadoop.security.groups.jni.name.negative-cache.secs";
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final long
+      HADOOP_SECURITY_GROUPS_JNI_NAME_NEGATIVE_CACHE_SECS_DEFAULT = 30;
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final String
+      HADOOP_SECURITY_GROUPS_JNI_NETGROUP_REFRESH_SECS =
+    "hadoop.security.groups.jni.netgroup.refresh.secs";
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final long
+      HADOOP_SECURITY_GROUPS_JNI_NETGROUP_REFRESH_SECS_DEFAULT = 0;
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
   public static final String  HADOOP_SECURITY_AUTHENTICATION =
     "hadoop.security.authentication";
   /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
@@ -391,6 +411,13 @@ public class CommonConfigurationKeysPublic {
   public static final String HADOOP_SECURITY_SECURE_RANDOM_IMPL_KEY = 
     "hadoop.security.secure.random.impl";
   /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
+  public static final String
+      HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_KEY =
+    "hadoop.security.secure.random.openssl.per-thread";
+  /** Default value for HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_KEY */
+  public static final boolean
+      HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_DEFAULT = false;
+  /** See <a href="{@docRoot}/../core-default.html">core-default.xml</a> */
   public static final String HADOOP_SECURITY_SECURE_RANDOM_DEVICE_FILE_PATH_KEY = 
     "hadoop.security.random.device.file.path";
   public static final String HADOOP_SECURITY_SECURE_RANDOM_DEVICE_FILE_PATH_DEFAULT = 
@@ -35,7 +35,7 @@
 public class FSDataInputStream extends DataInputStream
     implements Seekable, PositionedReadable, 
       ByteBufferReadable, HasFileDescriptor, CanSetDropBehind, CanSetReadahead,
-      HasEnhancedByteBufferAccess, CanUnbuffer {
+      HasEnhancedByteBufferAccess, CanUnbuffer, ByteBufferPositionedReadable {
   /**
    * Map ByteBuffers that we have handed out to readers to ByteBufferPool 
    * objects
@@ -146,6 +146,16 @@ public int read(ByteBuffer buf) throws IOException {
     throw new UnsupportedOperationException("Byte-buffer read unsupported by input stream");
   }
 
+  @Override
+  public int read(long position, ByteBuffer buf) throws IOException {
+    if (in instanceof ByteBufferPositionedReadable) {
+      return ((ByteBufferPositionedReadable) in).read(position, buf);
+    }
+
+    throw new UnsupportedOperationException(
+        "Byte-buffer pread unsupported by input stream");
+  }
+
   @Override
   public FileDescriptor getFileDescriptor() throws IOException {
     if (in instanceof HasFileDescriptor) {
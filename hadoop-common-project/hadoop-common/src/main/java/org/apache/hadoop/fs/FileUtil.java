@@ -877,6 +877,10 @@ public static void setOwner(File file, String username,
     if (username == null && groupname == null) {
       throw new IOException("username == null && groupname == null");
     }
+    if (Shell.WINDOWS && NativeIO.isAvailable()) {
+      NativeIO.Windows.chown(file.getCanonicalPath(), username, groupname);
+      return;
+    }
     String arg = (username == null ? "" : username)
         + (groupname == null ? "" : ":" + groupname);
     String [] cmd = Shell.getSetOwnerCommand(arg);
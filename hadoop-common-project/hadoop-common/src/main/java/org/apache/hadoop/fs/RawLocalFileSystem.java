@@ -49,6 +49,7 @@
 import org.apache.hadoop.fs.permission.FsPermission;
 import org.apache.hadoop.io.IOUtils;
 import org.apache.hadoop.io.nativeio.NativeIO;
+import org.apache.hadoop.io.nativeio.NativeIOException;
 import org.apache.hadoop.util.Progressable;
 import org.apache.hadoop.util.Shell;
 import org.apache.hadoop.util.StringUtils;
@@ -702,6 +703,10 @@ public String getGroup() {
 
     /// loads permissions, owner, and group from `ls -ld`
     private void loadPermissionInfo() {
+      if (Shell.WINDOWS && NativeIO.isAvailable()) {
+        loadPermissionInfoByNativeIO();
+        return;
+      }
       IOException e = null;
       try {
         String output = FileUtil.execCommand(new File(getPath().toUri()), 
@@ -749,6 +754,25 @@ private void loadPermissionInfo() {
       }
     }
 
+    /// loads permissions, owner, and group as `winutils ls` would, in process
+    private void loadPermissionInfoByNativeIO() {
+      try {
+        String path = new File(getPath().toUri()).getCanonicalPath();
+        NativeIO.POSIX.Stat stat = NativeIO.Windows.stat(path);
+        setPermission(new FsPermission((short) (stat.getMode() & 0777)));
+        setOwner(stat.getOwner());
+        setGroup(stat.getGroup());
+      } catch (NativeIOException nioe) {
+        // as when winutils ls fails
+        setPermission(null);
+        setOwner(null);
+        setGroup(null);
+      } catch (IOException ioe) {
+        throw new RuntimeException("Error while getting file permissions : " +
+                                   StringUtils.stringifyException(ioe));
+      }
+    }
+
     @Override
     public void write(DataOutput out) throws IOException {
       if (!isPermissionLoaded()) {
@@ -23,6 +23,7 @@
 
 import org.apache.hadoop.classification.InterfaceAudience;
 import org.apache.hadoop.classification.InterfaceStability;
+import org.apache.hadoop.io.compress.lz4.Lz4Compressor;
 
 /**
  * A {@link org.apache.hadoop.io.compress.CompressorStream} which works
@@ -98,7 +99,7 @@ public void write(byte[] b, int off, int len) throws IOException {
       // Adding this segment would exceed the maximum size.
       // Flush data if we have it.
       finish();
-      compressor.reset();
+      startBlock();
     }
 
     if (len > MAX_INPUT_SIZE) {
@@ -114,7 +115,7 @@ public void write(byte[] b, int off, int len) throws IOException {
         while (!compressor.finished()) {
           compress();
         }
-        compressor.reset();
+        startBlock();
         off += bufLen;
         len -= bufLen;
       } while (len > 0);
@@ -144,6 +145,19 @@ public void finish() throws IOException {
     }
   }
 
+  /**
+   * Prepare the compressor for the next block of this stream.  A
+   * {@link Lz4Compressor} with linked blocks keeps the data the next block
+   * may refer to, which {@link #resetState()} still drops.
+   */
+  private void startBlock() {
+    if (compressor instanceof Lz4Compressor) {
+      ((Lz4Compressor) compressor).resetBlock();
+    } else {
+      compressor.reset();
+    }
+  }
+
   @Override
   protected void compress() throws IOException {
     int len = compressor.compress(buffer, 0, buffer.length);
@@ -144,7 +144,16 @@ public Compressor createCompressor() {
     boolean useLz4HC = conf.getBoolean(
         CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_USELZ4HC_KEY,
         CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_USELZ4HC_DEFAULT);
-    return new Lz4Compressor(bufferSize, useLz4HC);
+    int compressThreads = conf.getInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_COMPRESS_THREADS_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_COMPRESS_THREADS_DEFAULT);
+    int frameSize = conf.getInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_FRAMESIZE_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_FRAMESIZE_DEFAULT);
+    Lz4Compressor compressor = new Lz4Compressor(bufferSize, useLz4HC,
+        compressThreads, frameSize);
+    compressor.reinit(conf);
+    return compressor;
   }
 
   /**
@@ -211,7 +220,10 @@ public Decompressor createDecompressor() {
     int bufferSize = conf.getInt(
         CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_BUFFERSIZE_KEY,
         CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_BUFFERSIZE_DEFAULT);
-    return new Lz4Decompressor(bufferSize);
+    boolean linkedBlocks = conf.getBoolean(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_DEFAULT);
+    return new Lz4Decompressor(bufferSize, linkedBlocks);
   }
 
   /**
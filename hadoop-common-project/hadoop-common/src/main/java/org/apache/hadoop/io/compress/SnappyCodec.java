@@ -146,7 +146,13 @@ public Compressor createCompressor() {
     int bufferSize = conf.getInt(
         CommonConfigurationKeys.IO_COMPRESSION_CODEC_SNAPPY_BUFFERSIZE_KEY,
         CommonConfigurationKeys.IO_COMPRESSION_CODEC_SNAPPY_BUFFERSIZE_DEFAULT);
-    return new SnappyCompressor(bufferSize);
+    int compressThreads = conf.getInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_SNAPPY_COMPRESS_THREADS_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_SNAPPY_COMPRESS_THREADS_DEFAULT);
+    int frameSize = conf.getInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_SNAPPY_FRAMESIZE_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_SNAPPY_FRAMESIZE_DEFAULT);
+    return new SnappyCompressor(bufferSize, compressThreads, frameSize);
   }
 
   /**
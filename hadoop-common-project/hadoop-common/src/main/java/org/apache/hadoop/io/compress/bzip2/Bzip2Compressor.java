@@ -56,6 +56,18 @@ public class Bzip2Compressor implements Compressor {
   private Buffer compressedDirectBuf = null;
   private boolean finish, finished;
 
+  // With more than one thread, the input is split into frames that are
+  // compressed on native threads, and the single bzip2 block each frame
+  // compresses to is spliced into the one stream
+  private final int compressThreads;
+  private int frameSize;
+  private Buffer frameDirectBuf = null;
+  // The splicing state: the bits of the last byte not written out yet, the
+  // combined CRC of the blocks so far and whether the header is out
+  private int pendingBits, pendingBitCount, combinedCRC;
+  private boolean headerWritten;
+  private long bytesRead = 0L, bytesWritten = 0L;
+
   /**
    * Creates a new compressor with a default values for the
    * compression block size and work factor.  Compressed data will be
@@ -71,7 +83,8 @@ public Bzip2Compressor() {
   public Bzip2Compressor(Configuration conf) {
     this(Bzip2Factory.getBlockSize(conf),
          Bzip2Factory.getWorkFactor(conf),
-         DEFAULT_DIRECT_BUFFER_SIZE);
+         DEFAULT_DIRECT_BUFFER_SIZE,
+         Bzip2Factory.getCompressThreads(conf));
   }
 
   /** 
@@ -88,15 +101,66 @@ public Bzip2Compressor(Configuration conf) {
    */
   public Bzip2Compressor(int blockSize, int workFactor, 
                          int directBufferSize) {
+    this(blockSize, workFactor, directBufferSize, 1);
+  }
+
+  /**
+   * Creates a new compressor that may compress on several threads.
+   * Compressed data will be generated in bzip2 format.
+   *
+   * @param blockSize The block size to be used for compression.
+   * @param workFactor The threshold for the fallback sorting algorithm.
+   * @param directBufferSize Size of the direct buffer to be used when
+   *        compressing on the calling thread.
+   * @param compressThreads How many threads may compress the blocks of the
+   *        stream, 1 to stream the input through libbz2 on the calling
+   *        thread.  With more, up to that many frames of input are
+   *        buffered and compressed at once.
+   */
+  public Bzip2Compressor(int blockSize, int workFactor,
+                         int directBufferSize, int compressThreads) {
     this.blockSize = blockSize;
     this.workFactor = workFactor;
-    this.directBufferSize = directBufferSize;
-    stream = init(blockSize, workFactor);
-    uncompressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
-    compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+    this.compressThreads = compressThreads;
+    if (compressThreads > 1) {
+      allocateFrameBuffers();
+    } else {
+      this.directBufferSize = directBufferSize;
+      stream = init(blockSize, workFactor);
+      uncompressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+      compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+    }
     compressedDirectBuf.position(directBufferSize);
   }
 
+  /**
+   * The most input that is sure to compress to a single block.  The run
+   * length encoding done before the block sort grows data by up to 5/4.
+   */
+  private static int maxFrameSize(int blockSize) {
+    return (blockSize * 100000 - 24) / 5 * 4;
+  }
+
+  private void allocateFrameBuffers() {
+    if (blockSize < 1 || blockSize > 9) {
+      throw new IllegalArgumentException("Invalid bzip2 block size " +
+          blockSize);
+    }
+    frameSize = maxFrameSize(blockSize);
+    // Each frame is compressed into a slot of its own
+    long frameCapacity = (long) compressThreads *
+        (frameSize + frameSize / 100 + 600);
+    if (frameCapacity + 16 > Integer.MAX_VALUE) {
+      throw new IllegalArgumentException("Too many bzip2 compress threads "
+          + compressThreads);
+    }
+    directBufferSize = (int) frameCapacity + 16;
+    uncompressedDirectBuf = ByteBuffer.allocateDirect(
+        compressThreads * frameSize);
+    frameDirectBuf = ByteBuffer.allocateDirect((int) frameCapacity);
+    compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+  }
+
   /**
    * Prepare the compressor to be used in a new stream with settings defined in
    * the given Configuration. It will reset the compressor's block size and
@@ -107,6 +171,18 @@ public Bzip2Compressor(int blockSize, int workFactor,
   @Override
   public synchronized void reinit(Configuration conf) {
     reset();
+    if (compressThreads > 1) {
+      if (conf != null) {
+        workFactor = Bzip2Factory.getWorkFactor(conf);
+        int newBlockSize = Bzip2Factory.getBlockSize(conf);
+        if (newBlockSize != blockSize) {
+          blockSize = newBlockSize;
+          allocateFrameBuffers();
+          compressedDirectBuf.position(directBufferSize);
+        }
+      }
+      return;
+    }
     end(stream);
     if (conf == null) {
       stream = init(blockSize, workFactor);
@@ -214,7 +290,21 @@ public synchronized int compress(byte[] b, int off, int len)
     compressedDirectBuf.limit(directBufferSize);
 
     // Compress the data.
-    n = deflateBytesDirect();
+    if (compressThreads > 1) {
+      // Frames are only compressed a buffer at a time, and nothing follows
+      // the end of the stream
+      if (finished || (!finish && uncompressedDirectBuf.remaining() > 0)) {
+        compressedDirectBuf.limit(0);
+        return 0;
+      }
+      int len = uncompressedDirectBufLen;
+      n = compressFramesDirect(blockSize, workFactor, frameSize,
+          compressThreads, finish);
+      bytesRead += len;
+      bytesWritten += n;
+    } else {
+      n = deflateBytesDirect();
+    }
     compressedDirectBuf.limit(n);
     
     // Check if bzip2 has consumed the entire input buffer.
@@ -242,6 +332,9 @@ public synchronized int compress(byte[] b, int off, int len)
    */
   @Override
   public synchronized long getBytesWritten() {
+    if (compressThreads > 1) {
+      return bytesWritten;
+    }
     checkStream();
     return getBytesWritten(stream);
   }
@@ -253,15 +346,24 @@ public synchronized long getBytesWritten() {
    */
   @Override
   public synchronized long getBytesRead() {
+    if (compressThreads > 1) {
+      return bytesRead;
+    }
     checkStream();
     return getBytesRead(stream);
   }
 
   @Override
   public synchronized void reset() {
-    checkStream();
-    end(stream);
-    stream = init(blockSize, workFactor);
+    if (compressThreads > 1) {
+      pendingBits = pendingBitCount = combinedCRC = 0;
+      headerWritten = false;
+      bytesRead = bytesWritten = 0L;
+    } else {
+      checkStream();
+      end(stream);
+      stream = init(blockSize, workFactor);
+    }
     finish = false;
     finished = false;
     uncompressedDirectBuf.rewind();
@@ -292,6 +394,8 @@ private void checkStream() {
   private native static void initIDs(String libname);
   private native static long init(int blockSize, int workFactor);
   private native int deflateBytesDirect();
+  private native int compressFramesDirect(int blockSize, int workFactor,
+      int frameSize, int threads, boolean last);
   private native static long getBytesRead(long strm);
   private native static long getBytesWritten(long strm);
   private native static void end(long strm);
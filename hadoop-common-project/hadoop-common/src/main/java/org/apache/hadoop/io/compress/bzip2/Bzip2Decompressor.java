@@ -244,4 +244,32 @@ private void checkStream() {
   private native static long getBytesWritten(long strm);
   private native static int getRemaining(long strm);
   private native static void end(long strm);
+  private native static byte[] decompressBlocks(Buffer src, int off, int len,
+      int threads);
+
+  /**
+   * Decompresses bzip2 data, one or more whole streams, a block per task on
+   * up to threads threads.  The blocks are found by their magic, and every
+   * one is decompressed on its own, checking its crc, while the combined
+   * crc of each stream is checked against those of its blocks.  Data that
+   * does not split into blocks that way is decompressed in one go.
+   * Requires the native bzip2 library, see {@link Bzip2Factory}.
+   *
+   * @param src direct buffer with the bzip2 data from its position to its
+   *            limit, which is consumed
+   * @param threads the number of threads, the calling one included
+   * @return the decompressed data
+   * @throws IOException if the data is corrupt, or decompresses to more than
+   *                     fits in an array
+   */
+  public static byte[] decompressBlocks(ByteBuffer src, int threads)
+      throws IOException {
+    if (!src.isDirect()) {
+      throw new IllegalArgumentException("Not a direct buffer");
+    }
+    byte[] uncompressed = decompressBlocks(src, src.position(),
+        src.remaining(), threads);
+    src.position(src.limit());
+    return uncompressed;
+  }
 }
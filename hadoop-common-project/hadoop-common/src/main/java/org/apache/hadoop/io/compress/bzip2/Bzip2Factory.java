@@ -141,4 +141,18 @@ public static int getWorkFactor(Configuration conf) {
                        Bzip2Compressor.DEFAULT_WORK_FACTOR);
   }
 
+  /**
+   * Set how many threads may compress the blocks of a native bzip2 stream.
+   * With more than 1, blocks of up to 4/5 of the block size are compressed
+   * on native threads and spliced into a single stream, which every bzip2
+   * reader, the splittable one included, reads as before.
+   */
+  public static void setCompressThreads(Configuration conf, int threads) {
+    conf.setInt("bzip2.compress.threads", threads);
+  }
+
+  public static int getCompressThreads(Configuration conf) {
+    return conf.getInt("bzip2.compress.threads", 1);
+  }
+
 }
@@ -25,6 +25,7 @@
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeys;
 import org.apache.hadoop.io.compress.Compressor;
 import org.apache.hadoop.util.NativeCodeLoader;
 
@@ -37,6 +38,9 @@ public class Lz4Compressor implements Compressor {
       LogFactory.getLog(Lz4Compressor.class.getName());
   private static final int DEFAULT_DIRECT_BUFFER_SIZE = 64 * 1024;
 
+  /** How much of the data before a linked block it may refer to. */
+  static final int LINKED_DICTIONARY_SIZE = 64 * 1024;
+
   private int directBufferSize;
   private Buffer compressedDirectBuf = null;
   private int uncompressedDirectBufLen;
@@ -48,6 +52,26 @@ public class Lz4Compressor implements Compressor {
   private long bytesRead = 0L;
   private long bytesWritten = 0L;
 
+  // With more than one thread, input longer than a frame is split into frames
+  // that are compressed independently and returned by compress() one at a
+  // time, so that each becomes a chunk of its own in a BlockCompressorStream
+  private final int compressThreads;
+  private final int frameSize;
+  // The end of each frame in compressedDirectBuf, when it holds frames
+  private final int[] frameEnds;
+  private int numFrames = 0;
+  private int frame = 0;
+
+  // Settings of reinit(), 1 and 0 are those of compressBytesDirect() and
+  // compressBytesDirectHC()
+  private int acceleration = 1;
+  private int lz4hcLevel = 0;
+  // With linked blocks the lz4 stream that carries the history of one block
+  // over to the next, and the copy of that history, or null
+  private Buffer streamState = null;
+  private Buffer dictionary = null;
+  private boolean resetStream = true;
+
   private final boolean useLz4HC;
 
   static {
@@ -71,14 +95,59 @@ public class Lz4Compressor implements Compressor {
    * @param directBufferSize size of the direct buffer to be used.
    * @param useLz4HC use high compression ratio version of lz4, 
    *                 which trades CPU for compression ratio.
+   * @param compressThreads how many threads may compress the frames of one
+   *                        buffer, 1 to compress it as a whole on the
+   *                        calling thread.
+   * @param frameSize size of the frames a buffer is split into when
+   *                  compressThreads is more than 1.
    */
-  public Lz4Compressor(int directBufferSize, boolean useLz4HC) {
+  public Lz4Compressor(int directBufferSize, boolean useLz4HC,
+      int compressThreads, int frameSize) {
     this.useLz4HC = useLz4HC;
     this.directBufferSize = directBufferSize;
+    this.compressThreads = compressThreads;
 
     uncompressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
-    compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
-    compressedDirectBuf.position(directBufferSize);
+    if (compressThreads > 1) {
+      if (frameSize <= 0) {
+        throw new IllegalArgumentException("Invalid frame size " + frameSize);
+      }
+      this.frameSize = Math.min(frameSize, directBufferSize);
+      frameEnds = new int[(directBufferSize + this.frameSize - 1) /
+          this.frameSize];
+      // Each frame is compressed into a slot of its own
+      long capacity = (long) frameEnds.length * maxCompressedLength(
+          this.frameSize);
+      if (capacity > Integer.MAX_VALUE) {
+        throw new IllegalArgumentException("Frames of " + this.frameSize +
+            " bytes are too small for a buffer of " + directBufferSize);
+      }
+      compressedDirectBuf = ByteBuffer.allocateDirect((int) capacity);
+    } else {
+      this.frameSize = directBufferSize;
+      frameEnds = null;
+      compressedDirectBuf = ByteBuffer.allocateDirect(
+          maxCompressedLength(directBufferSize));
+    }
+    compressedDirectBuf.position(compressedDirectBuf.capacity());
+  }
+
+  /**
+   * The worst case length of lz4 compressed data of the given length.
+   */
+  private static int maxCompressedLength(int length) {
+    return length + length / 255 + 16;
+  }
+
+  /**
+   * Creates a new compressor.
+   *
+   * @param directBufferSize size of the direct buffer to be used.
+   * @param useLz4HC use high compression ratio version of lz4, 
+   *                 which trades CPU for compression ratio.
+   */
+  public Lz4Compressor(int directBufferSize, boolean useLz4HC) {
+    this(directBufferSize, useLz4HC, 1, directBufferSize);
   }
 
   /**
@@ -216,7 +285,7 @@ public synchronized int compress(byte[] b, int off, int len)
     // Check if there is compressed data
     int n = compressedDirectBuf.remaining();
     if (n > 0) {
-      n = Math.min(n, len);
+      n = Math.min(chunkLength(), len);
       ((ByteBuffer) compressedDirectBuf).get(b, off, n);
       bytesWritten += n;
       return n;
@@ -236,7 +305,20 @@ public synchronized int compress(byte[] b, int off, int len)
     }
 
     // Compress data
-    n = useLz4HC ? compressBytesDirectHC() : compressBytesDirect();
+    if (compressThreads > 1 && uncompressedDirectBufLen > frameSize) {
+      numFrames = (uncompressedDirectBufLen + frameSize - 1) / frameSize;
+      n = compressFramesDirect(useLz4HC, lz4hcLevel, acceleration, frameSize,
+          compressThreads, frameEnds);
+      for (int i = 1; i < numFrames; i++) {
+        frameEnds[i] += frameEnds[i - 1];
+      }
+      frame = 0;
+      // The frames bypass the stream, so the next block starts afresh
+      resetStream = true;
+    } else {
+      numFrames = 0;
+      n = compressBlock();
+    }
     compressedDirectBuf.limit(n);
     uncompressedDirectBuf.clear(); // lz4 consumes all buffer input
 
@@ -246,13 +328,46 @@ public synchronized int compress(byte[] b, int off, int len)
     }
 
     // Get atmost 'len' bytes
-    n = Math.min(n, len);
+    n = Math.min(chunkLength(), len);
     bytesWritten += n;
     ((ByteBuffer) compressedDirectBuf).get(b, off, n);
 
     return n;
   }
 
+  /**
+   * Compress the input buffer as one block, with the current settings.
+   */
+  private int compressBlock() {
+    if (useLz4HC) {
+      // lz4hc blocks are never linked, which linked readers handle too
+      return lz4hcLevel == 0 ? compressBytesDirectHC() :
+          compressBytesDirectHC2(lz4hcLevel);
+    }
+    if (acceleration == 1 && streamState == null) {
+      return compressBytesDirect();
+    }
+    int n = compressBytesDirectFast(acceleration, streamState, dictionary,
+        resetStream);
+    resetStream = false;
+    return n;
+  }
+
+  /**
+   * The number of compressed bytes left to return before the end of the
+   * current frame, or in all if the input was not compressed in frames.
+   */
+  private int chunkLength() {
+    if (numFrames == 0) {
+      return compressedDirectBuf.remaining();
+    }
+    int position = compressedDirectBuf.position();
+    while (frameEnds[frame] <= position) {
+      frame++;
+    }
+    return frameEnds[frame] - position;
+  }
+
   /**
    * Resets compressor so that a new set of input data can be processed.
    */
@@ -264,19 +379,51 @@ public synchronized void reset() {
     uncompressedDirectBufLen = 0;
     compressedDirectBuf.clear();
     compressedDirectBuf.limit(0);
+    numFrames = 0;
+    resetStream = true;
     userBufOff = userBufLen = 0;
     bytesRead = bytesWritten = 0L;
   }
 
+  /**
+   * Resets the compressor like {@link #reset()}, for the next block of the
+   * same stream, which may then refer to the data before it if blocks are
+   * linked.
+   */
+  public synchronized void resetBlock() {
+    boolean reset = resetStream;
+    reset();
+    resetStream = reset;
+  }
+
   /**
    * Prepare the compressor to be used in a new stream with settings defined in
-   * the given Configuration
+   * the given Configuration: the acceleration of lz4, the level of lz4hc, and
+   * whether blocks are linked to the ones before them.
    *
    * @param conf Configuration from which new setting are fetched
    */
   @Override
   public synchronized void reinit(Configuration conf) {
     reset();
+    if (conf == null) {
+      return;
+    }
+    acceleration = Math.max(1, conf.getInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_ACCELERATION_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_ACCELERATION_DEFAULT));
+    lz4hcLevel = Math.max(0, conf.getInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4HC_LEVEL_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4HC_LEVEL_DEFAULT));
+    if (!conf.getBoolean(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_KEY,
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_DEFAULT)) {
+      streamState = null;
+      dictionary = null;
+    } else if (streamState == null) {
+      streamState = ByteBuffer.allocateDirect(streamStateSize());
+      dictionary = ByteBuffer.allocateDirect(LINKED_DICTIONARY_SIZE);
+    }
   }
 
   /**
@@ -308,5 +455,15 @@ public synchronized void end() {
 
   private native int compressBytesDirectHC();
 
+  private native int compressBytesDirectFast(int acceleration,
+      Buffer streamState, Buffer dictionary, boolean resetStream);
+
+  private native int compressBytesDirectHC2(int level);
+
+  private native int compressFramesDirect(boolean useHC, int hcLevel,
+      int acceleration, int frameSize, int threads, int[] frameLengths);
+
+  private native static int streamStateSize();
+
   public native static String getLibraryName();
 }
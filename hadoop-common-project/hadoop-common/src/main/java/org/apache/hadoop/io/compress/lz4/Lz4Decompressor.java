@@ -44,6 +44,11 @@ public class Lz4Decompressor implements Decompressor {
   private int userBufOff = 0, userBufLen = 0;
   private boolean finished;
 
+  // With linked blocks the end of the data decompressed so far, which the
+  // next block may refer to, or null
+  private final Buffer dictionary;
+  private int dictionaryLen = 0;
+
   static {
     if (NativeCodeLoader.isNativeCodeLoaded()) {
       // Initialize the native library
@@ -60,12 +65,16 @@ public class Lz4Decompressor implements Decompressor {
   }
 
   /**
-   * Creates a new compressor.
+   * Creates a new decompressor.
    *
    * @param directBufferSize size of the direct buffer to be used.
+   * @param linkedBlocks whether the blocks may refer to the data of the
+   *                     blocks before them since the last reset.
    */
-  public Lz4Decompressor(int directBufferSize) {
+  public Lz4Decompressor(int directBufferSize, boolean linkedBlocks) {
     this.directBufferSize = directBufferSize;
+    dictionary = linkedBlocks ?
+        ByteBuffer.allocateDirect(Lz4Compressor.LINKED_DICTIONARY_SIZE) : null;
 
     compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
     uncompressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
@@ -73,6 +82,15 @@ public Lz4Decompressor(int directBufferSize) {
 
   }
 
+  /**
+   * Creates a new decompressor.
+   *
+   * @param directBufferSize size of the direct buffer to be used.
+   */
+  public Lz4Decompressor(int directBufferSize) {
+    this(directBufferSize, false);
+  }
+
   /**
    * Creates a new decompressor with the default buffer size.
    */
@@ -228,7 +246,13 @@ public synchronized int decompress(byte[] b, int off, int len)
       uncompressedDirectBuf.limit(directBufferSize);
 
       // Decompress data
-      n = decompressBytesDirect();
+      if (dictionary == null) {
+        n = decompressBytesDirect();
+      } else {
+        n = decompressBytesDirectUsingDict(dictionary, dictionaryLen);
+        dictionaryLen = Math.min(dictionaryLen + n,
+            Lz4Compressor.LINKED_DICTIONARY_SIZE);
+      }
       uncompressedDirectBuf.limit(n);
 
       if (userBufLen <= 0) {
@@ -258,6 +282,7 @@ public synchronized int getRemaining() {
   public synchronized void reset() {
     finished = false;
     compressedDirectBufLen = 0;
+    dictionaryLen = 0;
     uncompressedDirectBuf.limit(directBufferSize);
     uncompressedDirectBuf.position(directBufferSize);
     userBufOff = userBufLen = 0;
@@ -275,4 +300,7 @@ public synchronized void end() {
   private native static void initIDs();
 
   private native int decompressBytesDirect();
+
+  private native int decompressBytesDirectUsingDict(Buffer dictionary,
+      int dictionaryLen);
 }
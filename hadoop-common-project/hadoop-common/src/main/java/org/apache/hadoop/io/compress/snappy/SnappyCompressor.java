@@ -48,6 +48,16 @@ public class SnappyCompressor implements Compressor {
   private long bytesRead = 0L;
   private long bytesWritten = 0L;
 
+  // With more than one thread, input longer than a frame is split into frames
+  // that are compressed independently and returned by compress() one at a
+  // time, so that each becomes a chunk of its own in a BlockCompressorStream
+  private final int compressThreads;
+  private final int frameSize;
+  // The end of each frame in compressedDirectBuf, when it holds frames
+  private final int[] frameEnds;
+  private int numFrames = 0;
+  private int frame = 0;
+
   private static boolean nativeSnappyLoaded = false;
   
   static {
@@ -70,13 +80,55 @@ public static boolean isNativeCodeLoaded() {
    * Creates a new compressor.
    *
    * @param directBufferSize size of the direct buffer to be used.
+   * @param compressThreads how many threads may compress the frames of one
+   *                        buffer, 1 to compress it as a whole on the
+   *                        calling thread.
+   * @param frameSize size of the frames a buffer is split into when
+   *                  compressThreads is more than 1.
    */
-  public SnappyCompressor(int directBufferSize) {
+  public SnappyCompressor(int directBufferSize, int compressThreads,
+      int frameSize) {
     this.directBufferSize = directBufferSize;
+    this.compressThreads = compressThreads;
 
     uncompressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
-    compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
-    compressedDirectBuf.position(directBufferSize);
+    if (compressThreads > 1) {
+      if (frameSize <= 0) {
+        throw new IllegalArgumentException("Invalid frame size " + frameSize);
+      }
+      this.frameSize = Math.min(frameSize, directBufferSize);
+      frameEnds = new int[(directBufferSize + this.frameSize - 1) /
+          this.frameSize];
+      // Each frame is compressed into a slot of its own
+      long capacity = (long) frameEnds.length * maxCompressedLength(
+          this.frameSize);
+      if (capacity > Integer.MAX_VALUE) {
+        throw new IllegalArgumentException("Frames of " + this.frameSize +
+            " bytes are too small for a buffer of " + directBufferSize);
+      }
+      compressedDirectBuf = ByteBuffer.allocateDirect((int) capacity);
+    } else {
+      this.frameSize = directBufferSize;
+      frameEnds = null;
+      compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+    }
+    compressedDirectBuf.position(compressedDirectBuf.capacity());
+  }
+
+  /**
+   * The worst case length of snappy compressed data of the given length.
+   */
+  private static int maxCompressedLength(int length) {
+    return 32 + length + length / 6;
+  }
+
+  /**
+   * Creates a new compressor.
+   *
+   * @param directBufferSize size of the direct buffer to be used.
+   */
+  public SnappyCompressor(int directBufferSize) {
+    this(directBufferSize, 1, directBufferSize);
   }
 
   /**
@@ -205,7 +257,7 @@ public int compress(byte[] b, int off, int len)
     // Check if there is compressed data
     int n = compressedDirectBuf.remaining();
     if (n > 0) {
-      n = Math.min(n, len);
+      n = Math.min(chunkLength(), len);
       ((ByteBuffer) compressedDirectBuf).get(b, off, n);
       bytesWritten += n;
       return n;
@@ -225,7 +277,17 @@ public int compress(byte[] b, int off, int len)
     }
 
     // Compress data
-    n = compressBytesDirect();
+    if (compressThreads > 1 && uncompressedDirectBufLen > frameSize) {
+      numFrames = (uncompressedDirectBufLen + frameSize - 1) / frameSize;
+      n = compressFramesDirect(frameSize, compressThreads, frameEnds);
+      for (int i = 1; i < numFrames; i++) {
+        frameEnds[i] += frameEnds[i - 1];
+      }
+      frame = 0;
+    } else {
+      numFrames = 0;
+      n = compressBytesDirect();
+    }
     compressedDirectBuf.limit(n);
     uncompressedDirectBuf.clear(); // snappy consumes all buffer input
 
@@ -235,13 +297,28 @@ public int compress(byte[] b, int off, int len)
     }
 
     // Get atmost 'len' bytes
-    n = Math.min(n, len);
+    n = Math.min(chunkLength(), len);
     bytesWritten += n;
     ((ByteBuffer) compressedDirectBuf).get(b, off, n);
 
     return n;
   }
 
+  /**
+   * The number of compressed bytes left to return before the end of the
+   * current frame, or in all if the input was not compressed in frames.
+   */
+  private int chunkLength() {
+    if (numFrames == 0) {
+      return compressedDirectBuf.remaining();
+    }
+    int position = compressedDirectBuf.position();
+    while (frameEnds[frame] <= position) {
+      frame++;
+    }
+    return frameEnds[frame] - position;
+  }
+
   /**
    * Resets compressor so that a new set of input data can be processed.
    */
@@ -253,6 +330,7 @@ public void reset() {
     uncompressedDirectBufLen = 0;
     compressedDirectBuf.clear();
     compressedDirectBuf.limit(0);
+    numFrames = 0;
     userBufOff = userBufLen = 0;
     bytesRead = bytesWritten = 0L;
   }
@@ -295,5 +373,8 @@ public void end() {
 
   private native int compressBytesDirect();
 
+  private native int compressFramesDirect(int frameSize, int threads,
+      int[] frameLengths);
+
   public native static String getLibraryName();
 }
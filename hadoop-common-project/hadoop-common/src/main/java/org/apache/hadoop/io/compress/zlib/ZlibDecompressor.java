@@ -308,6 +308,59 @@ private native static void setDictionary(long strm, byte[] b, int off,
   private native static int getRemaining(long strm);
   private native static void reset(long strm);
   private native static void end(long strm);
+  private native static int[] indexGzipMembers(Buffer src, int off, int len);
+  private native static byte[] inflateGzipMembers(Buffer src, int off,
+      int len, int[] members, int threads);
+
+  /**
+   * Finds where the members of gzip data made of concatenated members, as
+   * written by parallel gzip writers, may start.  Every member start is
+   * found, along with any spot inside compressed data that only looks like
+   * one, which {@link #inflateGzipMembers(ByteBuffer, int[], int)} sorts out.
+   *
+   * @param src direct buffer with the gzip data from its position to its
+   *            limit
+   * @return the offsets from the position of src where members may start
+   * @throws IOException if src does not start with a gzip header
+   */
+  public static int[] indexGzipMembers(ByteBuffer src) throws IOException {
+    checkDirect(src);
+    int[] members = indexGzipMembers(src, src.position(), src.remaining());
+    if (src.hasRemaining() && (members.length == 0 || members[0] != 0)) {
+      throw new IOException("Not in gzip format");
+    }
+    return members;
+  }
+
+  /**
+   * Inflates gzip data made of concatenated members.  The members of the
+   * index are inflated at the same time into buffers of their own, with the
+   * length their trailers claim, on up to threads threads.  Any that turn
+   * out to span a false member start are inflated again from their real
+   * start, and the output of all is put together in order.
+   *
+   * @param src direct buffer with the gzip data from its position to its
+   *            limit, which is consumed
+   * @param members the index of src from {@link #indexGzipMembers}
+   * @param threads the number of threads, the calling one included
+   * @return the inflated data
+   * @throws IOException if the data is corrupt, or inflates to more than
+   *                     fits in an array
+   */
+  public static byte[] inflateGzipMembers(ByteBuffer src, int[] members,
+      int threads) throws IOException {
+    checkDirect(src);
+    byte[] uncompressed = inflateGzipMembers(src, src.position(),
+        src.remaining(), members, threads);
+    src.position(src.limit());
+    return uncompressed;
+  }
+
+  private static void checkDirect(ByteBuffer src) {
+    if (!src.isDirect()) {
+      throw new IllegalArgumentException("Not a direct buffer");
+    }
+  }
     
   int inflateDirect(ByteBuffer src, ByteBuffer dst) throws IOException {
     assert (this instanceof ZlibDirectDecompressor);
@@ -0,0 +1,296 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.hadoop.io.compress.zstd;
+
+import java.io.IOException;
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+
+import org.apache.commons.logging.Log;
+import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.io.compress.Decompressor;
+import org.apache.hadoop.util.NativeCodeLoader;
+
+/**
+ * A {@link Decompressor} based on the zstandard compression algorithm.
+ * http://facebook.github.io/zstd/
+ */
+public class ZStandardDecompressor implements Decompressor {
+  private static final Log LOG =
+      LogFactory.getLog(ZStandardDecompressor.class.getName());
+
+  private long stream;
+  private int directBufferSize;
+  private Buffer compressedDirectBuf = null;
+  private int compressedDirectBufOff, compressedDirectBufLen;
+  private Buffer uncompressedDirectBuf = null;
+  private byte[] userBuf = null;
+  private int userBufOff = 0, userBufLen = 0;
+  private boolean finished;
+  // zstd filled the output buffer, and may hold more of what it decoded
+  private boolean outputPending;
+  private long bytesRead = 0;
+  private long bytesWritten = 0;
+
+  private static boolean nativeZStandardLoaded = false;
+
+  static {
+    if (NativeCodeLoader.isNativeCodeLoaded() &&
+        NativeCodeLoader.buildSupportsZstd()) {
+      try {
+        initIDs();
+        nativeZStandardLoaded = true;
+      } catch (Throwable t) {
+        LOG.error("failed to load ZStandardDecompressor", t);
+      }
+    }
+  }
+
+  public static boolean isNativeCodeLoaded() {
+    return nativeZStandardLoaded;
+  }
+
+  /**
+   * Creates a new decompressor.
+   *
+   * @param windowLog the window log the data was compressed with, or 0 for
+   *                  the default of its level; windows over 2^27 are only
+   *                  accepted if this covers them
+   * @param directBufferSize size of the direct buffers to be used.
+   */
+  public ZStandardDecompressor(int windowLog, int directBufferSize) {
+    this.directBufferSize = directBufferSize;
+    stream = init(windowLog);
+
+    compressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+    uncompressedDirectBuf = ByteBuffer.allocateDirect(directBufferSize);
+    uncompressedDirectBuf.position(directBufferSize);
+  }
+
+  @Override
+  public void setInput(byte[] b, int off, int len) {
+    if (b == null) {
+      throw new NullPointerException();
+    }
+    if (off < 0 || len < 0 || off > b.length - len) {
+      throw new ArrayIndexOutOfBoundsException();
+    }
+
+    // A block stream hands over the frame of the next block without a
+    // reset(), which would drop the counters
+    if (finished) {
+      reset(stream);
+      finished = false;
+      outputPending = false;
+    }
+
+    this.userBuf = b;
+    this.userBufOff = off;
+    this.userBufLen = len;
+
+    setInputFromSavedData();
+
+    // Reinitialize zstd's output direct buffer
+    uncompressedDirectBuf.limit(directBufferSize);
+    uncompressedDirectBuf.position(directBufferSize);
+  }
+
+  void setInputFromSavedData() {
+    compressedDirectBufOff = 0;
+    compressedDirectBufLen = Math.min(userBufLen, directBufferSize);
+
+    // Reinitialize zstd's input direct buffer
+    compressedDirectBuf.rewind();
+    ((ByteBuffer) compressedDirectBuf).put(userBuf, userBufOff,
+        compressedDirectBufLen);
+
+    // Note how much data is being fed to zstd
+    userBufOff += compressedDirectBufLen;
+    userBufLen -= compressedDirectBufLen;
+  }
+
+  /**
+   * Loads the dictionary the data was compressed with.  It stays in use
+   * for every frame until the decompressor is ended.
+   */
+  @Override
+  public void setDictionary(byte[] b, int off, int len) {
+    if (stream == 0 || b == null) {
+      throw new NullPointerException();
+    }
+    if (off < 0 || len < 0 || off > b.length - len) {
+      throw new ArrayIndexOutOfBoundsException();
+    }
+    setDictionary(stream, b, off, len);
+  }
+
+  @Override
+  public boolean needsInput() {
+    // Consume remaining uncompressed data?
+    if (uncompressedDirectBuf.remaining() > 0) {
+      return false;
+    }
+
+    // Let zstd hand out what it holds before asking for more
+    if (outputPending) {
+      return false;
+    }
+
+    // Check if zstd has consumed all input
+    if (compressedDirectBufLen <= 0) {
+      // Check if we have consumed all user-input
+      if (userBufLen <= 0) {
+        return true;
+      } else {
+        setInputFromSavedData();
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * The dictionary comes from the configuration, zstd never asks for it.
+   */
+  @Override
+  public boolean needsDictionary() {
+    return false;
+  }
+
+  /**
+   * Returns true at the end of a zstd frame once all its data has been
+   * consumed.  Data after it can be read after a {@link #reset()}, or
+   * given with {@link #setInput(byte[], int, int)}, which starts a new
+   * frame.
+   */
+  @Override
+  public boolean finished() {
+    return (finished && uncompressedDirectBuf.remaining() == 0);
+  }
+
+  @Override
+  public int decompress(byte[] b, int off, int len)
+      throws IOException {
+    if (b == null) {
+      throw new NullPointerException();
+    }
+    if (off < 0 || len < 0 || off > b.length - len) {
+      throw new ArrayIndexOutOfBoundsException();
+    }
+
+    // Check if there is uncompressed data
+    int n = uncompressedDirectBuf.remaining();
+    if (n > 0) {
+      n = Math.min(n, len);
+      ((ByteBuffer) uncompressedDirectBuf).get(b, off, n);
+      return n;
+    }
+    if (finished) {
+      return 0;
+    }
+
+    // Re-initialize the zstd's output direct buffer
+    uncompressedDirectBuf.rewind();
+    uncompressedDirectBuf.limit(directBufferSize);
+
+    // Decompress data
+    int compressedLen = compressedDirectBufLen;
+    n = inflateBytesDirect();
+    uncompressedDirectBuf.limit(n);
+    outputPending = !finished && n == directBufferSize;
+    bytesRead += compressedLen - compressedDirectBufLen;
+    bytesWritten += n;
+
+    // Get at most 'len' bytes
+    n = Math.min(n, len);
+    ((ByteBuffer) uncompressedDirectBuf).get(b, off, n);
+
+    return n;
+  }
+
+  /**
+   * Returns the total number of uncompressed bytes output since last reset.
+   */
+  public long getBytesWritten() {
+    return bytesWritten;
+  }
+
+  /**
+   * Returns the total number of compressed bytes input since last reset.
+   */
+  public long getBytesRead() {
+    return bytesRead;
+  }
+
+  /**
+   * Returns the number of bytes remaining in the input buffers; normally
+   * called when finished() is true to determine the amount of data after
+   * the frame.
+   *
+   * @return the total (non-negative) number of unprocessed bytes in input
+   */
+  @Override
+  public int getRemaining() {
+    return userBufLen + compressedDirectBufLen;
+  }
+
+  /**
+   * Resets everything including the input buffers (user and direct), but
+   * keeps the window limit and dictionary.
+   */
+  @Override
+  public void reset() {
+    checkStream();
+    reset(stream);
+    finished = false;
+    outputPending = false;
+    compressedDirectBufOff = compressedDirectBufLen = 0;
+    uncompressedDirectBuf.limit(directBufferSize);
+    uncompressedDirectBuf.position(directBufferSize);
+    userBufOff = userBufLen = 0;
+    bytesRead = bytesWritten = 0L;
+  }
+
+  @Override
+  public void end() {
+    if (stream != 0) {
+      end(stream);
+      stream = 0;
+    }
+  }
+
+  @Override
+  protected void finalize() {
+    end();
+  }
+
+  private void checkStream() {
+    if (stream == 0) {
+      throw new NullPointerException();
+    }
+  }
+
+  private native static void initIDs();
+  private native static long init(int windowLog);
+  private native static void setDictionary(long strm, byte[] b, int off,
+                                           int len);
+  private native int inflateBytesDirect();
+  private native static void reset(long strm);
+  private native static void end(long strm);
+}
@@ -20,6 +20,7 @@
 import org.apache.hadoop.classification.InterfaceAudience;
 import org.apache.hadoop.conf.Configuration;
 import org.apache.hadoop.fs.CommonConfigurationKeys;
+import org.apache.hadoop.io.erasurecode.rawcoder.NativeRSRawDecoder;
 import org.apache.hadoop.io.erasurecode.rawcoder.RSRawDecoder;
 import org.apache.hadoop.io.erasurecode.rawcoder.RSRawEncoder;
 import org.apache.hadoop.io.erasurecode.rawcoder.RawErasureCoder;
@@ -70,6 +71,12 @@ public static RawErasureDecoder createRSRawDecoder(
         false, numDataUnits, numParityUnits);
     if (rawCoder == null) {
       rawCoder = new RSRawDecoder(numDataUnits, numParityUnits);
+    } else if (rawCoder instanceof NativeRSRawDecoder) {
+      int threads = conf.getInt(
+          CommonConfigurationKeys.IO_ERASURECODE_CODEC_RS_DECODE_THREADS_KEY,
+          CommonConfigurationKeys
+              .IO_ERASURECODE_CODEC_RS_DECODE_THREADS_DEFAULT);
+      ((NativeRSRawDecoder) rawCoder).setDecodeThreads(threads);
     }
 
     return (RawErasureDecoder) rawCoder;
@@ -24,6 +24,9 @@
 
 /**
  * Erasure code native libraries (for now, Intel ISA-L) related utilities.
+ * When libhadoop was built without ISA-L, or the library can't be loaded at
+ * run time, the native coders use a compatible built-in implementation
+ * instead, which {@link #getLibraryName()} reports as "built-in".
  */
 public final class ErasureCodeNative {
 
@@ -38,8 +41,6 @@ public final class ErasureCodeNative {
   static {
     if (!NativeCodeLoader.isNativeCodeLoaded()) {
       LOADING_FAILURE_REASON = "hadoop native library cannot be loaded.";
-    } else if (!NativeCodeLoader.buildSupportsIsal()) {
-      LOADING_FAILURE_REASON = "libhadoop was built without ISA-L support";
     } else {
       String problem = null;
       try {
@@ -0,0 +1,105 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.erasurecode.rawcoder;
+
+import java.nio.ByteBuffer;
+
+import org.apache.hadoop.HadoopIllegalArgumentException;
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.io.erasurecode.ErasureCodeNative;
+import org.apache.hadoop.io.erasurecode.rawcoder.util.CoderUtil;
+
+/**
+ * A raw erasure decoder in RS code scheme, which decodes direct buffers with
+ * ISA-L.  Byte arrays are still decoded in pure Java, compatibly.
+ *
+ * With {@link #setDecodeThreads} long cells are cut into slices that are
+ * decoded in parallel on a native worker pool, so that reconstructing a
+ * large block is not bound to a single core.
+ */
+@InterfaceAudience.Private
+public class NativeRSRawDecoder extends RSRawDecoder {
+
+  static {
+    ErasureCodeNative.checkNativeCodeLoaded();
+  }
+
+  // To link with the underlying data structure in the native layer.
+  // No get/set as only used by native codes.
+  private long __native_coder;
+  private long __native_verbose;
+
+  private int decodeThreads = 1;
+
+  public NativeRSRawDecoder(int numDataUnits, int numParityUnits) {
+    super(numDataUnits, numParityUnits);
+    initImpl(numDataUnits, numParityUnits);
+  }
+
+  /**
+   * Set how many threads may decode one stripe, the calling one included.
+   * Only cells of at least 128 KB are decoded on more than one.
+   * @param threads the number of threads, at least 1
+   */
+  public void setDecodeThreads(int threads) {
+    if (threads < 1) {
+      throw new HadoopIllegalArgumentException(
+          "Invalid decode threads " + threads);
+    }
+    decodeThreads = threads;
+  }
+
+  @Override
+  protected void doDecode(ByteBuffer[] inputs, int[] erasedIndexes,
+                          ByteBuffer[] outputs) {
+    int[] inputOffsets = new int[inputs.length];
+    int[] outputOffsets = new int[outputs.length];
+    int dataLen = CoderUtil.findFirstValidInput(inputs).remaining();
+
+    for (int i = 0; i < inputs.length; i++) {
+      if (inputs[i] != null) {
+        inputOffsets[i] = inputs[i].position();
+      }
+    }
+    for (int i = 0; i < outputs.length; i++) {
+      outputOffsets[i] = outputs[i].position();
+    }
+
+    decodeImpl(inputs, inputOffsets, dataLen, erasedIndexes, outputs,
+        outputOffsets, decodeThreads);
+  }
+
+  @Override
+  public void release() {
+    destroyImpl();
+  }
+
+  @Override
+  protected boolean preferDirectBuffer() {
+    return true;
+  }
+
+  private native void initImpl(int numDataUnits, int numParityUnits);
+
+  private native void decodeImpl(ByteBuffer[] inputs, int[] inputOffsets,
+                                 int dataLen, int[] erasedIndexes,
+                                 ByteBuffer[] outputs, int[] outputOffsets,
+                                 int threads);
+
+  private native void destroyImpl();
+}
@@ -0,0 +1,207 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.erasurecode.rawcoder;
+
+import java.nio.ByteBuffer;
+
+import org.apache.hadoop.HadoopIllegalArgumentException;
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.io.erasurecode.ErasureCodeNative;
+
+/**
+ * A raw erasure encoder in RS code scheme, which encodes direct buffers with
+ * ISA-L.  Byte arrays are still encoded in pure Java, compatibly.
+ *
+ * Writers can also fold data cells into the parity one at a time as they
+ * arrive with {@link #encodeUpdate}, rather than holding a whole stripe.
+ *
+ * Writers that fill the same cell buffers stripe after stripe can register
+ * them once with {@link #registerBuffers} and encode many stripes per native
+ * call with {@link #encodeRegistered}, without resolving any buffer again.
+ */
+@InterfaceAudience.Private
+public class NativeRSRawEncoder extends RSRawEncoder {
+
+  static {
+    ErasureCodeNative.checkNativeCodeLoaded();
+  }
+
+  // To link with the underlying data structure in the native layer.
+  // No get/set as only used by native codes.
+  private long __native_coder;
+  private long __native_verbose;
+
+  // Keep the registered buffers reachable while native code uses them
+  private ByteBuffer[] registeredInputs;
+  private ByteBuffer[] registeredOutputs;
+  private int registeredLength;
+
+  public NativeRSRawEncoder(int numDataUnits, int numParityUnits) {
+    super(numDataUnits, numParityUnits);
+    initImpl(numDataUnits, numParityUnits);
+  }
+
+  @Override
+  protected void doEncode(ByteBuffer[] inputs, ByteBuffer[] outputs) {
+    int[] inputOffsets = new int[inputs.length];
+    int[] outputOffsets = new int[outputs.length];
+    int dataLen = inputs[0].remaining();
+
+    for (int i = 0; i < inputs.length; i++) {
+      inputOffsets[i] = inputs[i].position();
+    }
+    for (int i = 0; i < outputs.length; i++) {
+      outputOffsets[i] = outputs[i].position();
+    }
+
+    encodeImpl(inputs, inputOffsets, dataLen, outputs, outputOffsets);
+  }
+
+  /**
+   * Fold one data unit into the parity units.  The parity units must be
+   * zero before the first data unit of a stripe is folded in, and hold the
+   * same parity as {@link #encode} once all of them are, in any order.
+   * The input is consumed, the positions of the outputs are not changed.
+   * @param input direct buffer of the data unit
+   * @param dataUnitIndex index of the data unit in the stripe
+   * @param outputs direct buffers of the parity units, with at least
+   *                input.remaining() bytes remaining
+   */
+  public void encodeUpdate(ByteBuffer input, int dataUnitIndex,
+                           ByteBuffer[] outputs) {
+    if (dataUnitIndex < 0 || dataUnitIndex >= getNumDataUnits()) {
+      throw new HadoopIllegalArgumentException(
+          "Invalid dataUnitIndex " + dataUnitIndex);
+    }
+    if (outputs.length != getNumParityUnits()) {
+      throw new HadoopIllegalArgumentException("Invalid outputs length");
+    }
+    int dataLen = input.remaining();
+    checkDirect(input);
+    int[] outputOffsets = new int[outputs.length];
+    for (int i = 0; i < outputs.length; i++) {
+      if (checkDirect(outputs[i]) < dataLen) {
+        throw new HadoopIllegalArgumentException(
+            "Not enough space in output " + i);
+      }
+      outputOffsets[i] = outputs[i].position();
+    }
+
+    encodeUpdateImpl(input, input.position(), dataLen, dataUnitIndex,
+        outputs, outputOffsets);
+    input.position(input.position() + dataLen);
+  }
+
+  /**
+   * Register the cell buffers of a number of stripes, replacing any
+   * registered before.  Stripe s reads
+   * inputs[s * numDataUnits, (s + 1) * numDataUnits) and writes
+   * outputs[s * numParityUnits, (s + 1) * numParityUnits), all from their
+   * positions at the time of this call.
+   * @param inputs direct buffers of the data units
+   * @param outputs direct buffers of the parity units
+   */
+  public void registerBuffers(ByteBuffer[] inputs, ByteBuffer[] outputs) {
+    int numStripes = inputs.length / getNumDataUnits();
+    if (inputs.length != numStripes * getNumDataUnits() ||
+        outputs.length != numStripes * getNumParityUnits()) {
+      throw new HadoopIllegalArgumentException(
+          "Inputs and outputs are not whole stripes");
+    }
+
+    int length = Integer.MAX_VALUE;
+    int[] inputOffsets = new int[inputs.length];
+    int[] outputOffsets = new int[outputs.length];
+    for (int i = 0; i < inputs.length; i++) {
+      length = Math.min(length, checkDirect(inputs[i]));
+      inputOffsets[i] = inputs[i].position();
+    }
+    for (int i = 0; i < outputs.length; i++) {
+      length = Math.min(length, checkDirect(outputs[i]));
+      outputOffsets[i] = outputs[i].position();
+    }
+
+    registerBuffersImpl(inputs, inputOffsets, outputs, outputOffsets,
+        numStripes);
+    registeredInputs = inputs.clone();
+    registeredOutputs = outputs.clone();
+    registeredLength = length;
+  }
+
+  private static int checkDirect(ByteBuffer buffer) {
+    if (buffer == null || !buffer.isDirect()) {
+      throw new HadoopIllegalArgumentException(
+          "Buffers must be direct");
+    }
+    return buffer.remaining();
+  }
+
+  /**
+   * Encode the first stripes of the registered buffers in one native call.
+   * Positions of the buffers are not changed.
+   * @param numStripes how many stripes to encode
+   * @param dataLen how many bytes of each cell to encode
+   */
+  public void encodeRegistered(int numStripes, int dataLen) {
+    if (registeredInputs == null ||
+        numStripes < 0 ||
+        numStripes * getNumDataUnits() > registeredInputs.length) {
+      throw new HadoopIllegalArgumentException(
+          "More stripes than registered");
+    }
+    if (dataLen < 0 || dataLen > registeredLength) {
+      throw new HadoopIllegalArgumentException(
+          "Invalid dataLen " + dataLen);
+    }
+
+    encodeRegisteredImpl(numStripes, dataLen);
+  }
+
+  @Override
+  public void release() {
+    destroyImpl();
+    registeredInputs = null;
+    registeredOutputs = null;
+  }
+
+  @Override
+  protected boolean preferDirectBuffer() {
+    return true;
+  }
+
+  private native void initImpl(int numDataUnits, int numParityUnits);
+
+  private native void encodeImpl(ByteBuffer[] inputs, int[] inputOffsets,
+                                 int dataLen, ByteBuffer[] outputs,
+                                 int[] outputOffsets);
+
+  private native void encodeUpdateImpl(ByteBuffer input, int inputOffset,
+                                       int dataLen, int dataUnitIndex,
+                                       ByteBuffer[] outputs,
+                                       int[] outputOffsets);
+
+  private native void registerBuffersImpl(ByteBuffer[] inputs,
+                                          int[] inputOffsets,
+                                          ByteBuffer[] outputs,
+                                          int[] outputOffsets,
+                                          int numStripes);
+
+  private native void encodeRegisteredImpl(int numStripes, int dataLen);
+
+  private native void destroyImpl();
+}
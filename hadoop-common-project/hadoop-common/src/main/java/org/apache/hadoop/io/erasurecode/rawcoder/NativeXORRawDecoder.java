@@ -0,0 +1,85 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.erasurecode.rawcoder;
+
+import java.nio.ByteBuffer;
+
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.io.erasurecode.ErasureCodeNative;
+import org.apache.hadoop.io.erasurecode.rawcoder.util.CoderUtil;
+
+/**
+ * A raw decoder in XOR code scheme, which does the xor of direct buffers in
+ * native code, either through ISA-L or with the SIMD instructions of the CPU.
+ * Byte arrays are still decoded in pure Java.
+ */
+@InterfaceAudience.Private
+public class NativeXORRawDecoder extends XORRawDecoder {
+
+  static {
+    ErasureCodeNative.checkNativeCodeLoaded();
+  }
+
+  // To link with the underlying data structure in the native layer.
+  // No get/set as only used by native codes.
+  private long __native_coder;
+  private long __native_verbose;
+
+  public NativeXORRawDecoder(int numDataUnits, int numParityUnits) {
+    super(numDataUnits, numParityUnits);
+    initImpl(numDataUnits, numParityUnits);
+  }
+
+  @Override
+  protected void doDecode(ByteBuffer[] inputs, int[] erasedIndexes,
+                          ByteBuffer[] outputs) {
+    int[] inputOffsets = new int[inputs.length];
+    int[] outputOffsets = new int[outputs.length];
+    int dataLen = CoderUtil.findFirstValidInput(inputs).remaining();
+
+    for (int i = 0; i < inputs.length; i++) {
+      if (inputs[i] != null) {
+        inputOffsets[i] = inputs[i].position();
+      }
+    }
+    for (int i = 0; i < outputs.length; i++) {
+      outputOffsets[i] = outputs[i].position();
+    }
+
+    decodeImpl(inputs, inputOffsets, dataLen, erasedIndexes, outputs,
+        outputOffsets);
+  }
+
+  @Override
+  public void release() {
+    destroyImpl();
+  }
+
+  @Override
+  protected boolean preferDirectBuffer() {
+    return true;
+  }
+
+  private native void initImpl(int numDataUnits, int numParityUnits);
+
+  private native void decodeImpl(ByteBuffer[] inputs, int[] inputOffsets,
+                                 int dataLen, int[] erasedIndexes,
+                                 ByteBuffer[] outputs, int[] outputOffsets);
+
+  private native void destroyImpl();
+}
@@ -0,0 +1,224 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.nativeio;
+
+import java.io.Closeable;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+import org.apache.commons.lang.SystemUtils;
+import org.apache.commons.logging.Log;
+import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.classification.InterfaceStability;
+
+import com.google.common.base.Preconditions;
+
+/**
+ * Asynchronous file I/O through a Linux io_uring.
+ *
+ * Reads, writes, fsyncs and fadvises are queued with the methods of the
+ * same name, handed to the kernel together by {@link #submit()}, and their
+ * results are collected later with {@link #complete(long[], int[], int)},
+ * so that one thread can keep many operations in flight instead of
+ * blocking one thread per operation.  Reads and writes go to and from
+ * buffers registered when the ring is created, whose pages the kernel pins
+ * once instead of on every operation.
+ *
+ * A ring is not thread-safe: it must be used by one thread at a time.
+ * io_uring needs Linux 5.6 or later.  Where {@link #getLoadingFailureReason()}
+ * is not null, callers should fall back to their blocking I/O.
+ */
+@InterfaceAudience.Private
+@InterfaceStability.Unstable
+public class IoUring implements Closeable {
+  public static final Log LOG = LogFactory.getLog(IoUring.class);
+
+  // Operations, and the native code relies on these values
+  static final int OP_READ = 0;
+  static final int OP_WRITE = 1;
+  static final int OP_FSYNC = 2;
+  static final int OP_FDATASYNC = 3;
+  static final int OP_FADVISE = 4;
+
+  private static final String loadingFailureReason;
+
+  static {
+    String reason = null;
+    if (!NativeIO.isAvailable()) {
+      reason = "NativeIO is not available.";
+    } else if (!SystemUtils.IS_OS_LINUX) {
+      reason = "The OS is not Linux.";
+    } else {
+      try {
+        if (!isSupported0()) {
+          reason = "io_uring is not supported by the kernel or by the " +
+              "build of libhadoop.";
+        }
+      } catch (UnsatisfiedLinkError e) {
+        reason = "libhadoop was built without io_uring support.";
+      }
+    }
+    loadingFailureReason = reason;
+  }
+
+  private long handle;
+  // Kept so that the registered memory is not freed while the ring uses it
+  private final ByteBuffer[] buffers;
+
+  /**
+   * @return null if io_uring can be used, or the reason it cannot
+   */
+  public static String getLoadingFailureReason() {
+    return loadingFailureReason;
+  }
+
+  /**
+   * Create a ring.
+   *
+   * @param entries   How many operations can be queued between submits,
+   *                    rounded up to a power of 2 by the kernel.
+   * @param buffers   The direct buffers reads and writes use, by index.
+   *                    Their pages stay pinned until the ring is closed.
+   * @return          The ring.
+   * @throws IOException If the ring cannot be created, for example because
+   *                       the buffers exceed RLIMIT_MEMLOCK.
+   */
+  public static IoUring create(int entries, ByteBuffer[] buffers)
+      throws IOException {
+    if (loadingFailureReason != null) {
+      throw new IOException(loadingFailureReason);
+    }
+    Preconditions.checkArgument(entries > 0, "entries must be positive");
+    return new IoUring(create0(entries, buffers), buffers.clone());
+  }
+
+  private IoUring(long handle, ByteBuffer[] buffers) {
+    this.handle = handle;
+    this.buffers = buffers;
+  }
+
+  private long checkOpen() {
+    Preconditions.checkState(handle != 0, "the ring is closed");
+    return handle;
+  }
+
+  /**
+   * Queue a read into a registered buffer.
+   *
+   * @param fd        The file to read.
+   * @param buffer    The index of the registered buffer to read into.
+   * @param position  Where in the buffer to start.
+   * @param length    How many bytes to read at most.
+   * @param offset    The file offset to read at.
+   * @param userData  What {@link #complete(long[], int[], int)} returns to
+   *                    identify the operation.
+   * @return          false if the submission queue is full, in which case
+   *                    nothing was queued and {@link #submit()} makes room.
+   */
+  public boolean read(FileDescriptor fd, int buffer, int position,
+      int length, long offset, long userData) {
+    return prepare0(checkOpen(), OP_READ, fd, buffer, position, length,
+        offset, 0, userData);
+  }
+
+  /**
+   * Queue a write from a registered buffer.  The arguments are those of
+   * {@link #read(FileDescriptor, int, int, int, long, long)}.
+   */
+  public boolean write(FileDescriptor fd, int buffer, int position,
+      int length, long offset, long userData) {
+    return prepare0(checkOpen(), OP_WRITE, fd, buffer, position, length,
+        offset, 0, userData);
+  }
+
+  /**
+   * Queue an fsync, or an fdatasync if dataOnly.  It is not ordered with
+   * the writes queued before it, so those must have completed first.
+   */
+  public boolean fsync(FileDescriptor fd, boolean dataOnly, long userData) {
+    return prepare0(checkOpen(), dataOnly ? OP_FDATASYNC : OP_FSYNC, fd, 0,
+        0, 0, 0, 0, userData);
+  }
+
+  /**
+   * Queue a posix_fadvise.
+   *
+   * @param advice    One of the NativeIO.POSIX.POSIX_FADV_* constants.
+   */
+  public boolean fadvise(FileDescriptor fd, long offset, int length,
+      int advice, long userData) {
+    return prepare0(checkOpen(), OP_FADVISE, fd, 0, 0, length, offset,
+        advice, userData);
+  }
+
+  /**
+   * Hand the queued operations to the kernel without waiting for them.
+   */
+  public void submit() throws IOException {
+    submit0(checkOpen());
+  }
+
+  /**
+   * Submit the queued operations and collect the results of finished ones.
+   *
+   * @param userData    Filled in with the userData of each finished
+   *                      operation.
+   * @param results     Filled in with the result of each, as the system call
+   *                      returns it: the bytes read or written, 0, or a
+   *                      negative errno.
+   * @param minComplete How many to wait for, at most userData.length.  0
+   *                      does not wait.
+   * @return            How many operations were collected.
+   */
+  public int complete(long[] userData, int[] results, int minComplete)
+      throws IOException {
+    Preconditions.checkArgument(results.length >= userData.length,
+        "results is shorter than userData");
+    return complete0(checkOpen(), userData, results, minComplete);
+  }
+
+  /**
+   * Close the ring.  Operations still in flight are finished by the kernel,
+   * but their results are lost.
+   */
+  @Override
+  public void close() {
+    if (handle != 0) {
+      destroy0(handle);
+      handle = 0;
+    }
+  }
+
+  private static native boolean isSupported0();
+
+  private static native long create0(int entries, ByteBuffer[] buffers)
+      throws IOException;
+
+  private static native boolean prepare0(long handle, int op,
+      FileDescriptor fd, int buffer, int position, int length, long offset,
+      int advice, long userData);
+
+  private static native void submit0(long handle) throws IOException;
+
+  private static native int complete0(long handle, long[] userData,
+      int[] results, int minComplete) throws IOException;
+
+  private static native void destroy0(long handle);
+}
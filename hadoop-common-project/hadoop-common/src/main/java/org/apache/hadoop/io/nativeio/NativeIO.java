@@ -25,8 +25,11 @@
 import java.io.RandomAccessFile;
 import java.lang.reflect.Field;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.nio.MappedByteBuffer;
 import java.nio.channels.FileChannel;
+import java.util.ArrayList;
+import java.util.List;
 import java.util.Map;
 import java.util.concurrent.ConcurrentHashMap;
 
@@ -46,6 +49,7 @@
 import sun.misc.Unsafe;
 
 import com.google.common.annotations.VisibleForTesting;
+import com.google.common.base.Charsets;
 
 /**
  * JNI wrappers for various native IO-related calls not available in Java.
@@ -98,10 +102,18 @@ public static class POSIX {
        write.  */
     public static int SYNC_FILE_RANGE_WAIT_AFTER = 4;
 
+    // Flags for fallocate() from linux/falloc.h - Updated by JNI
+    /* Do not change the file size, even when allocating past the end.  */
+    public static int FALLOC_FL_KEEP_SIZE = 1;
+    /* Free the range, which must be used with FALLOC_FL_KEEP_SIZE.  */
+    public static int FALLOC_FL_PUNCH_HOLE = 2;
+
     private static final Log LOG = LogFactory.getLog(NativeIO.class);
 
     // Set to true via JNI if possible
     public static boolean fadvisePossible = false;
+    // Set to true via JNI if possible
+    private static boolean fallocatePossible = false;
 
     private static boolean nativeLoaded = false;
     private static boolean syncFileRangePossible = true;
@@ -132,6 +144,32 @@ public void mlock(String identifier, ByteBuffer buffer,
         POSIX.mlock(buffer, len);
       }
 
+      /**
+       * Like {@link #mlock(String, ByteBuffer, long)}, but asks for
+       * transparent huge pages and moves the pages to a NUMA node.  Without
+       * either it calls {@link #mlock(String, ByteBuffer, long)}, so
+       * subclasses overriding only that keep working.
+       *
+       * @param hugePages   Whether to madvise(MADV_HUGEPAGE) the buffer.
+       * @param numaNode    The node to mbind the pages to, or -1 for none.
+       */
+      public void mlock(String identifier, ByteBuffer buffer, long len,
+          boolean hugePages, int numaNode) throws IOException {
+        if (!hugePages && numaNode < 0) {
+          mlock(identifier, buffer, len);
+        } else {
+          POSIX.mlock(buffer, len, hugePages, numaNode);
+        }
+      }
+
+      /**
+       * @return How many bytes of the pages of the buffer are resident.
+       */
+      public long getResidentBytes(String identifier, ByteBuffer buffer,
+          long len) throws IOException {
+        return POSIX.getResidentBytes(buffer, len);
+      }
+
       public long getMemlockLimit() {
         return NativeIO.getMemlockLimit();
       }
@@ -164,6 +202,16 @@ public void mlock(String identifier, ByteBuffer buffer,
         LOG.info("mlocking " + identifier);
       }
 
+      public void mlock(String identifier, ByteBuffer buffer, long len,
+          boolean hugePages, int numaNode) throws IOException {
+        LOG.info("mlocking " + identifier);
+      }
+
+      public long getResidentBytes(String identifier, ByteBuffer buffer,
+          long len) {
+        return len;
+      }
+
       public long getMemlockLimit() {
         return 1125899906842624L;
       }
@@ -252,6 +300,10 @@ static native void posix_fadvise(
     static native void sync_file_range(
       FileDescriptor fd, long offset, long nbytes, int flags) throws NativeIOException;
 
+    /** Wrapper around fallocate(2) */
+    static native void fallocate(
+      FileDescriptor fd, int mode, long offset, long len) throws NativeIOException;
+
     /**
      * Call posix_fadvise on the given file descriptor. See the manpage
      * for this syscall for more information. On systems where this
@@ -292,6 +344,33 @@ public static void syncFileRangeIfPossible(
       }
     }
 
+    /**
+     * Call fallocate on the given file descriptor, to allocate the blocks of
+     * a range up front, or with FALLOC_FL_PUNCH_HOLE to free them. See the
+     * manpage for this syscall for more information. Where the platform, the
+     * kernel or the filesystem of the file does not support the mode, does
+     * nothing.
+     *
+     * @param mode 0, or a combination of the FALLOC_FL_* flags
+     * @return true if the range was allocated or freed
+     * @throws NativeIOException if there is an error with the syscall
+     */
+    public static boolean fallocateIfPossible(FileDescriptor fd, int mode,
+        long offset, long len) throws NativeIOException {
+      if (nativeLoaded && fallocatePossible) {
+        try {
+          fallocate(fd, mode, offset, len);
+          return true;
+        } catch (UnsupportedOperationException uoe) {
+          // Only this filesystem or mode may lack support, so try again
+          // next time
+        } catch (UnsatisfiedLinkError ule) {
+          fallocatePossible = false;
+        }
+      }
+      return false;
+    }
+
     static native void mlock_native(
         ByteBuffer buffer, long len) throws NativeIOException;
 
@@ -313,6 +392,168 @@ static void mlock(ByteBuffer buffer, long len)
       mlock_native(buffer, len);
     }
     
+    static native void mlockPlaced_native(ByteBuffer buffer, long len,
+        boolean hugePages, int numaNode) throws NativeIOException;
+
+    /**
+     * Locks the provided direct ByteBuffer into memory like
+     * {@link #mlock(ByteBuffer, long)}.  If hugePages, it first asks for
+     * transparent huge pages, which saves TLB misses on large buffers where
+     * the kernel supports them for the mapping.  If numaNode is not
+     * negative, the locked pages are then moved to that node.
+     *
+     * See the madvise(2), mlock(2) and mbind(2) man pages for more
+     * information.
+     *
+     * @throws NativeIOException
+     */
+    static void mlock(ByteBuffer buffer, long len, boolean hugePages,
+        int numaNode) throws IOException {
+      assertCodeLoaded();
+      if (!buffer.isDirect()) {
+        throw new IOException("Cannot mlock a non-direct ByteBuffer");
+      }
+      mlockPlaced_native(buffer, len, hugePages, numaNode);
+    }
+
+    static native long mincore_native(ByteBuffer buffer, long len)
+        throws NativeIOException;
+
+    /**
+     * Counts the bytes of the pages of a direct ByteBuffer that are resident
+     * in memory.  See the mincore(2) man page for more information.
+     *
+     * @throws NativeIOException
+     */
+    static long getResidentBytes(ByteBuffer buffer, long len)
+        throws IOException {
+      assertCodeLoaded();
+      if (!buffer.isDirect()) {
+        throw new IOException("Cannot mincore a non-direct ByteBuffer");
+      }
+      return mincore_native(buffer, len);
+    }
+
+    static native int scanDirectory_native(String path, ByteBuffer buffer)
+        throws NativeIOException;
+
+    /** Initial size of the buffer of {@link #listDirectory(File)}. */
+    private static final int SCAN_BUFFER_SIZE = 256 * 1024;
+
+    /** Largest buffer {@link #listDirectory(File)} grows to. */
+    private static final int MAX_SCAN_BUFFER_SIZE = 1 << 30;
+
+    private static final ThreadLocal<ByteBuffer> SCAN_BUFFER =
+        new ThreadLocal<ByteBuffer>() {
+          @Override
+          protected ByteBuffer initialValue() {
+            return ByteBuffer.allocateDirect(SCAN_BUFFER_SIZE)
+                .order(ByteOrder.nativeOrder());
+          }
+        };
+
+    /**
+     * An entry of a directory listed by {@link #listDirectory(File)}.
+     */
+    public static class DirectoryEntry {
+      // Entry types of the scan buffer
+      static final int TYPE_FILE = 0;
+      static final int TYPE_DIRECTORY = 1;
+      static final int TYPE_OTHER = 2;
+
+      private final String name;
+      private final int type;
+      private final long length;
+      private final long modificationTime;
+
+      DirectoryEntry(String name, int type, long length,
+          long modificationTime) {
+        this.name = name;
+        this.type = type;
+        this.length = length;
+        this.modificationTime = modificationTime;
+      }
+
+      public String getName() {
+        return name;
+      }
+
+      public boolean isFile() {
+        return type == TYPE_FILE;
+      }
+
+      public boolean isDirectory() {
+        return type == TYPE_DIRECTORY;
+      }
+
+      /** @return The length of a file, 0 for other entries. */
+      public long getLength() {
+        return length;
+      }
+
+      /** @return The modification time in milliseconds since the epoch. */
+      public long getModificationTime() {
+        return modificationTime;
+      }
+
+      @Override
+      public String toString() {
+        return "DirectoryEntry(name='" + name + "', type=" + type +
+            ", length=" + length + ", mtime=" + modificationTime + ")";
+      }
+    }
+
+    /**
+     * Lists a directory together with the type, length and modification
+     * time of each of its entries, other than "." and "..".  The entries
+     * are read in batches with getdents64(2) on Linux and stat'ed relative
+     * to the open directory, which saves a path lookup and a JNI round trip
+     * per entry over File#list followed by File#length and
+     * File#lastModified.  Symbolic links are followed like File#isDirectory
+     * does, and entries removed while the directory is read are left out.
+     *
+     * @param dir       The directory to list.
+     * @return          The entries, in no particular order.
+     * @throws IOException if the directory could not be read.
+     */
+    public static List<DirectoryEntry> listDirectory(File dir)
+        throws IOException {
+      assertCodeLoaded();
+      ByteBuffer buffer = SCAN_BUFFER.get();
+      int used;
+      while ((used = scanDirectory_native(dir.getPath(), buffer)) < 0) {
+        if (buffer.capacity() >= MAX_SCAN_BUFFER_SIZE) {
+          throw new IOException("Too many entries to list in " + dir);
+        }
+        buffer = ByteBuffer.allocateDirect(buffer.capacity() * 2)
+            .order(ByteOrder.nativeOrder());
+        SCAN_BUFFER.set(buffer);
+      }
+      // Each entry is packed as its type (1 byte), name length (2 bytes),
+      // length (8 bytes), modification time (8 bytes) and name bytes
+      List<DirectoryEntry> entries = new ArrayList<DirectoryEntry>();
+      byte[] name = new byte[256];
+      int pos = 0;
+      while (pos < used) {
+        int type = buffer.get(pos);
+        int nameLength = buffer.getShort(pos + 1) & 0xffff;
+        long length = buffer.getLong(pos + 3);
+        long mtime = buffer.getLong(pos + 11);
+        pos += 19;
+        if (nameLength > name.length) {
+          name = new byte[nameLength];
+        }
+        for (int i = 0; i < nameLength; i++) {
+          name[i] = buffer.get(pos + i);
+        }
+        pos += nameLength;
+        entries.add(new DirectoryEntry(
+            new String(name, 0, nameLength, Charsets.UTF_8), type, length,
+            mtime));
+      }
+      return entries;
+    }
+
     /**
      * Unmaps the block from memory. See munmap(2).
      *
@@ -569,6 +810,41 @@ public static native long setFilePointer(FileDescriptor fd,
     /** Windows only methods used for getOwner() implementation */
     private static native String getOwner(FileDescriptor fd) throws IOException;
 
+    /**
+     * Change the owner and/or group of a path, as winutils chown does but
+     * without starting a process for it.
+     *
+     * @param path the path to change
+     * @param username the new owner, or null or empty to leave it
+     * @param groupname the new group, or null or empty to leave it
+     * @throws IOException if there is an I/O error
+     */
+    public static void chown(String path, String username, String groupname)
+        throws IOException {
+      chown0(path, username, groupname);
+    }
+
+    /** Wrapper around ChownImpl() in libwinutils */
+    private static native void chown0(String path, String username,
+        String groupname) throws NativeIOException;
+
+    /**
+     * Get the owner, group and permissions of a path, as winutils ls does
+     * but without starting a process for it.  Symbolic links are not
+     * followed.
+     *
+     * @param path the path to look at
+     * @return the owner, group and mode of the path
+     * @throws IOException if there is an I/O error
+     */
+    public static POSIX.Stat stat(String path) throws IOException {
+      return stat0(path);
+    }
+
+    /** Wrapper around FindFileOwnerAndPermission() in libwinutils */
+    private static native POSIX.Stat stat0(String path)
+        throws NativeIOException;
+
     /** Supported list of Windows access right flags */
     public static enum AccessRight {
       ACCESS_READ (0x0001),      // FILE_READ_DATA
@@ -914,7 +1190,13 @@ private static native void link0(String src, String dst)
   /**
    * Unbuffered file copy from src to dst without tainting OS buffer cache
    *
-   * In POSIX platform:
+   * In Linux platform:
+   * It first tries to reflink dst to src with the FICLONE ioctl, which only
+   * shares extents on filesystems like XFS and Btrfs that support it, then
+   * copy_file_range(), which keeps the copy within the kernel, and falls back
+   * to sendfile() on kernels without either.
+   *
+   * In other POSIX platforms, and in Linux without native code:
    * It uses FileChannel#transferTo() which internally attempts
    * unbuffered IO on OS with native sendfile64() support and falls back to
    * buffered IO otherwise.
@@ -947,7 +1229,7 @@ private static native void link0(String src, String dst)
    * @throws IOException
    */
   public static void copyFileUnbuffered(File src, File dst) throws IOException {
-    if (nativeLoaded && Shell.WINDOWS) {
+    if (nativeLoaded && (Shell.WINDOWS || Shell.LINUX)) {
       copyFileUnbuffered0(src.getAbsolutePath(), dst.getAbsolutePath());
     } else {
       FileInputStream fis = null;
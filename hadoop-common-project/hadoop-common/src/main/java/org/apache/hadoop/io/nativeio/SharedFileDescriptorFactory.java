@@ -17,9 +17,11 @@
  */
 package org.apache.hadoop.io.nativeio;
 
+import java.io.Closeable;
 import java.io.FileInputStream;
 import java.io.IOException;
 import java.io.FileDescriptor;
+import java.util.ArrayDeque;
 
 import org.apache.commons.lang.SystemUtils;
 import org.apache.commons.logging.Log;
@@ -41,14 +43,27 @@
  * unlinking it.  In the constructor, we attempt to clean up after any such
  * remnants by trying to unlink any temporary files created by previous
  * SharedFileDescriptorFactory instances that also used our prefix.
+ *
+ * On Linux, the factory can instead hand out memfds, which have no directory
+ * entry at all and so cannot be left behind.  Their size is sealed, so that
+ * the processes they are shared with cannot shrink them under our mappings.
+ *
+ * Descriptors of one length can also be created ahead of time with
+ * {@link #preallocate(int, int)}, so that handing them out later costs no
+ * system calls.
  */
 @InterfaceAudience.Private
 @InterfaceStability.Unstable
-public class SharedFileDescriptorFactory {
+public class SharedFileDescriptorFactory implements Closeable {
   public static final Log LOG = LogFactory.getLog(SharedFileDescriptorFactory.class);
   private final String prefix;
   private final String path;
 
+  // Descriptors created ahead of time, all poolLength bytes long
+  private final ArrayDeque<FileInputStream> pool =
+      new ArrayDeque<FileInputStream>();
+  private int poolLength;
+
   public static String getLoadingFailureReason() {
     if (!NativeIO.isAvailable()) {
       return "NativeIO is not available.";
@@ -59,6 +74,36 @@ public static String getLoadingFailureReason() {
     return null;
   }
 
+  /**
+   * @return true if memfds can be created here.
+   */
+  public static boolean isMemfdSupported() {
+    if (getLoadingFailureReason() != null || !SystemUtils.IS_OS_LINUX) {
+      return false;
+    }
+    try {
+      return isMemfdSupported0();
+    } catch (UnsatisfiedLinkError e) {
+      // An older libhadoop
+      return false;
+    }
+  }
+
+  /**
+   * Create a new SharedFileDescriptorFactory, which hands out memfds if
+   * useMemfd is set and they are supported, and otherwise uses the first
+   * usable path.
+   *
+   * @see #create(String, String[])
+   */
+  public static SharedFileDescriptorFactory create(String prefix,
+      String paths[], boolean useMemfd) throws IOException {
+    if (useMemfd && isMemfdSupported()) {
+      return new SharedFileDescriptorFactory(prefix, null);
+    }
+    return create(prefix, paths);
+  }
+
   /**
    * Create a new SharedFileDescriptorFactory.
    *
@@ -102,17 +147,25 @@ public static SharedFileDescriptorFactory create(String prefix,
    * Create a SharedFileDescriptorFactory.
    *
    * @param prefix    Prefix to add to all file names we use.
-   * @param path      Path to use.
+   * @param path      Path to use, or null to use memfds.
    */
   private SharedFileDescriptorFactory(String prefix, String path) {
     this.prefix = prefix;
     this.path = path;
   }
 
+  /**
+   * @return The directory the descriptors are created in, or null if they
+   *           are memfds.
+   */
   public String getPath() {
     return path;
   }
 
+  public boolean isMemfd() {
+    return path == null;
+  }
+
   /**
    * Create a shared file descriptor which will be both readable and writable.
    *
@@ -126,8 +179,71 @@ public String getPath() {
    */
   public FileInputStream createDescriptor(String info, int length)
       throws IOException {
-    return new FileInputStream(
-        createDescriptor0(prefix + info, path, length));
+    synchronized (pool) {
+      if (length == poolLength && !pool.isEmpty()) {
+        return pool.poll();
+      }
+    }
+    return newDescriptor(prefix + info, length);
+  }
+
+  /**
+   * Create descriptors ahead of time, which later calls to
+   * {@link #createDescriptor(String, int)} for the same length hand out
+   * until they run out.  The descriptors of an earlier call for another
+   * length are closed.
+   *
+   * @param count          How many descriptors to create.
+   * @param length         Their length.
+   * @throws IOException   If there was an error creating them.
+   */
+  public void preallocate(int count, int length) throws IOException {
+    ArrayDeque<FileInputStream> created = new ArrayDeque<FileInputStream>();
+    try {
+      for (int i = 0; i < count; i++) {
+        created.add(newDescriptor(prefix + "pool", length));
+      }
+      synchronized (pool) {
+        if (length != poolLength) {
+          closeAll(pool);
+          poolLength = length;
+        }
+        pool.addAll(created);
+        created.clear();
+      }
+    } finally {
+      closeAll(created);
+    }
+  }
+
+  /**
+   * Close the descriptors created ahead of time.  Those already handed out
+   * are not affected.
+   */
+  @Override
+  public void close() {
+    synchronized (pool) {
+      closeAll(pool);
+    }
+  }
+
+  private static void closeAll(ArrayDeque<FileInputStream> streams) {
+    FileInputStream fis;
+    while ((fis = streams.poll()) != null) {
+      try {
+        fis.close();
+      } catch (IOException e) {
+        LOG.debug("Error closing a shared file descriptor", e);
+      }
+    }
+  }
+
+  private FileInputStream newDescriptor(String name, int length)
+      throws IOException {
+    if (path == null) {
+      return new FileInputStream(createMemfd0(name, length));
+    }
+    return new FileInputStream(createDescriptor0(name, path, length));
   }
 
   /**
@@ -141,4 +257,12 @@ private static native void deleteStaleTemporaryFiles0(String prefix,
    */
   private static native FileDescriptor createDescriptor0(String prefix,
       String path, int length) throws IOException;
+
+  private static native boolean isMemfdSupported0();
+
+  /**
+   * Create a memfd of the given length, with its size sealed.
+   */
+  private static native FileDescriptor createMemfd0(String name, int length)
+      throws IOException;
 }
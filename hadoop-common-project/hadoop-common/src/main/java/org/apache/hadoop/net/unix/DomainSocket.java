@@ -18,6 +18,7 @@
 package org.apache.hadoop.net.unix;
 
 import java.io.Closeable;
+import java.io.EOFException;
 import org.apache.hadoop.classification.InterfaceAudience;
 import java.io.FileDescriptor;
 import java.io.FileInputStream;
@@ -25,8 +26,10 @@
 import java.io.InputStream;
 import java.io.OutputStream;
 import java.nio.channels.ClosedChannelException;
-import java.nio.channels.ReadableByteChannel;
+import java.nio.channels.GatheringByteChannel;
+import java.nio.channels.ScatteringByteChannel;
 import java.nio.ByteBuffer;
+import java.util.Arrays;
 
 import org.apache.commons.lang.SystemUtils;
 import org.apache.commons.logging.Log;
@@ -475,6 +478,109 @@ public int recvFileInputStreams(FileInputStream[] streams, byte buf[],
     }
   }
 
+  private native static void sendFileDescriptorBatch0(int fd,
+      FileDescriptor descriptors[][], byte jbuf[], int offset, int lengths[])
+      throws IOException;
+
+  /**
+   * Send several messages, each with its own FileDescriptor objects, to the
+   * process on the other side of this socket.  Where sendmmsg(2) is
+   * available, many messages go in one system call.
+   *
+   * @param descriptors       The file descriptors of each message.  Each
+   *                          message must pass at least one.
+   * @param jbuf              The bytes of the messages, back to back.
+   * @param offset            The offset in the jbuf array to start at.
+   * @param lengths           The length of each message, which must be at
+   *                          least one byte.
+   */
+  public void sendFileDescriptorBatch(FileDescriptor descriptors[][],
+      byte jbuf[], int offset, int lengths[]) throws IOException {
+    refCount.reference();
+    boolean exc = true;
+    try {
+      sendFileDescriptorBatch0(fd, descriptors, jbuf, offset, lengths);
+      exc = false;
+    } finally {
+      unreference(exc);
+    }
+  }
+
+  private static native int receiveFileDescriptorBatch0(int fd,
+      FileDescriptor[][] descriptors, byte[] buf, int offset, int lengths[],
+      int bytesRead[]) throws IOException;
+
+  /**
+   * Receive one or more messages sent by
+   * {@link #sendFileDescriptorBatch(FileDescriptor[][], byte[], int, int[])},
+   * and wrap the FileDescriptor objects of each in FileInputStream objects.
+   * This waits for the first message only, and also returns those of the
+   * others which have arrived.
+   *
+   * @param streams           Filled in with the streams of each message.
+   *                          streams[i] must have room for all of the
+   *                          descriptors of message i.
+   * @param buf               Filled in with the bytes of the messages, each
+   *                          at the offset its lengths place it at.
+   * @param offset            The offset in buf to start at.
+   * @param lengths           How many bytes to read at most for each
+   *                          message.
+   * @param bytesRead         Filled in with how many bytes were read for
+   *                          each message received.  Like
+   *                          {@link #recvFileInputStreams}, that may be
+   *                          less than sent, and the rest of the message
+   *                          then has to be read from the input stream.
+   * @return                  How many messages were received, or -1 at EOF.
+   */
+  public int recvFileInputStreamBatch(FileInputStream[][] streams,
+      byte buf[], int offset, int lengths[], int bytesRead[])
+      throws IOException {
+    FileDescriptor descriptors[][] = new FileDescriptor[streams.length][];
+    boolean success = false;
+    for (int i = 0; i < streams.length; i++) {
+      descriptors[i] = new FileDescriptor[streams[i].length];
+      Arrays.fill(streams[i], null);
+    }
+    refCount.reference();
+    try {
+      int ret = receiveFileDescriptorBatch0(fd, descriptors, buf, offset,
+          lengths, bytesRead);
+      for (int i = 0; i < ret; i++) {
+        for (int j = 0, k = 0; j < descriptors[i].length; j++) {
+          if (descriptors[i][j] != null) {
+            streams[i][k++] = new FileInputStream(descriptors[i][j]);
+            descriptors[i][j] = null;
+          }
+        }
+      }
+      success = true;
+      return ret;
+    } finally {
+      if (!success) {
+        for (int i = 0; i < descriptors.length; i++) {
+          for (int j = 0; j < descriptors[i].length; j++) {
+            if (descriptors[i][j] != null) {
+              try {
+                closeFileDescriptor0(descriptors[i][j]);
+              } catch (Throwable t) {
+                LOG.warn(t);
+              }
+            } else if (streams[i][j] != null) {
+              try {
+                streams[i][j].close();
+              } catch (Throwable t) {
+                LOG.warn(t);
+              } finally {
+                streams[i][j] = null;
+              }
+            }
+          }
+        }
+      }
+      unreference(!success);
+    }
+  }
+
   private native static int readArray0(int fd, byte b[], int off, int len)
       throws IOException;
   
@@ -488,6 +594,19 @@ private static native void writeArray0(int fd, byte b[], int offset, int length)
   private native static int readByteBufferDirect0(int fd, ByteBuffer dst,
       int position, int remaining) throws IOException;
 
+  /**
+   * The most buffers readv0 and writev0 use in one call.  Must not be more
+   * than MAX_SCATTER_BUFS in DomainSocket.c.
+   */
+  private static final int MAX_SCATTER_BUFS = 64;
+
+  private native static long readv0(int fd, ByteBuffer dsts[],
+      int positions[], int remaining[], int count, boolean waitAll)
+      throws IOException;
+
+  private native static long writev0(int fd, ByteBuffer srcs[],
+      int positions[], int remaining[], int count) throws IOException;
+
   /**
    * Input stream for UNIX domain sockets.
    */
@@ -577,7 +696,8 @@ public void write(byte[] b, int off, int len) throws IOException {
   }
 
   @InterfaceAudience.LimitedPrivate("HDFS")
-  public class DomainChannel implements ReadableByteChannel {
+  public class DomainChannel implements ScatteringByteChannel,
+      GatheringByteChannel {
     @Override
     public boolean isOpen() {
       return DomainSocket.this.isOpen();
@@ -615,6 +735,151 @@ public int read(ByteBuffer dst) throws IOException {
         unreference(exc);
       }
     }
+
+    @Override
+    public long read(ByteBuffer[] dsts) throws IOException {
+      return read(dsts, 0, dsts.length);
+    }
+
+    /**
+     * Read into several buffers.  If they are all direct, the bytes go
+     * straight into them in one readv-like system call, so that a packet
+     * header and its payload need neither two reads nor a copy.
+     */
+    @Override
+    public long read(ByteBuffer[] dsts, int offset, int length)
+        throws IOException {
+      return scatter(dsts, offset, length, false);
+    }
+
+    /**
+     * Read until the buffers are full, waiting for all of the bytes with
+     * MSG_WAITALL where they are direct.
+     *
+     * @throws EOFException   If the stream ends first.
+     */
+    public void readFully(ByteBuffer[] dsts, int offset, int length)
+        throws IOException {
+      while (length > 0) {
+        if (!dsts[offset].hasRemaining()) {
+          offset++;
+          length--;
+        } else if (scatter(dsts, offset, length, true) < 0) {
+          throw new EOFException("unexpected EOF on " + DomainSocket.this);
+        }
+      }
+    }
+
+    private long scatter(ByteBuffer[] dsts, int offset, int length,
+        boolean waitAll) throws IOException {
+      int count = Math.min(length, MAX_SCATTER_BUFS);
+      for (int i = offset; i < offset + count; i++) {
+        if (!dsts[i].isDirect()) {
+          // Fall back to filling the first buffer with room
+          for (int j = offset; j < offset + length; j++) {
+            if (dsts[j].hasRemaining()) {
+              return read(dsts[j]);
+            }
+          }
+          return 0;
+        }
+      }
+      int positions[] = new int[count];
+      int remaining[] = new int[count];
+      ByteBuffer bufs[] = new ByteBuffer[count];
+      for (int i = 0; i < count; i++) {
+        bufs[i] = dsts[offset + i];
+        positions[i] = bufs[i].position();
+        remaining[i] = bufs[i].remaining();
+      }
+      refCount.reference();
+      boolean exc = true;
+      try {
+        long nread = readv0(DomainSocket.this.fd, bufs, positions,
+            remaining, count, waitAll);
+        advance(bufs, nread);
+        exc = false;
+        return nread;
+      } finally {
+        unreference(exc);
+      }
+    }
+
+    @Override
+    public int write(ByteBuffer src) throws IOException {
+      return (int)write(new ByteBuffer[] { src }, 0, 1);
+    }
+
+    @Override
+    public long write(ByteBuffer[] srcs) throws IOException {
+      return write(srcs, 0, srcs.length);
+    }
+
+    /**
+     * Write all of the remaining bytes of several buffers.  Runs of direct
+     * buffers are written with writev-like system calls, without a copy.
+     */
+    @Override
+    public long write(ByteBuffer[] srcs, int offset, int length)
+        throws IOException {
+      long written = 0;
+      refCount.reference();
+      boolean exc = true;
+      try {
+        int end = offset + length;
+        while (offset < end) {
+          if (!srcs[offset].hasRemaining()) {
+            offset++;
+          } else if (!srcs[offset].isDirect()) {
+            ByteBuffer src = srcs[offset++];
+            int len = src.remaining();
+            if (src.hasArray()) {
+              writeArray0(DomainSocket.this.fd, src.array(),
+                  src.arrayOffset() + src.position(), len);
+              src.position(src.limit());
+            } else {
+              byte buf[] = new byte[len];
+              src.get(buf);
+              writeArray0(DomainSocket.this.fd, buf, 0, len);
+            }
+            written += len;
+          } else {
+            int count = 0;
+            while (count < MAX_SCATTER_BUFS && offset + count < end &&
+                srcs[offset + count].isDirect()) {
+              count++;
+            }
+            int positions[] = new int[count];
+            int remaining[] = new int[count];
+            ByteBuffer bufs[] = new ByteBuffer[count];
+            for (int i = 0; i < count; i++) {
+              bufs[i] = srcs[offset + i];
+              positions[i] = bufs[i].position();
+              remaining[i] = bufs[i].remaining();
+            }
+            long n = writev0(DomainSocket.this.fd, bufs, positions,
+                remaining, count);
+            advance(bufs, n);
+            written += n;
+          }
+        }
+        exc = false;
+        return written;
+      } finally {
+        unreference(exc);
+      }
+    }
+
+    /**
+     * Move the positions of buffers past the bytes a system call moved.
+     */
+    private void advance(ByteBuffer bufs[], long n) {
+      for (int i = 0; i < bufs.length && n > 0; i++) {
+        int len = (int)Math.min(n, bufs[i].remaining());
+        bufs[i].position(bufs[i].position() + len);
+        n -= len;
+      }
+    }
   }
 
   @Override
@@ -151,7 +151,8 @@ Handler getHandler() {
   /**
    * The FdSet is a set of file descriptors that gets passed to poll(2).
    * It contains a native memory segment, so that we don't have to copy
-   * in the poll0 function.
+   * in the poll0 function.  On Linux it is an epoll(7) set instead, so that
+   * adding, removing and polling do not cost a walk over every fd.
    */
   private static class FdSet {
     private long data;
@@ -419,8 +420,9 @@ private boolean sendCallback(String caller, TreeMap<Integer, Entry> entries,
             this + ": file descriptor " + sock.fd + " was closed while " +
             "still in the poll(2) loop.");
       }
-      IOUtils.cleanup(LOG, sock);
+      // Remove the fd while it is still open, which an epoll set needs
       fdSet.remove(fd);
+      IOUtils.cleanup(LOG, sock);
       return true;
     } else {
       if (LOG.isTraceEnabled()) {
@@ -0,0 +1,150 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.net.unix;
+
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.classification.InterfaceStability;
+
+/**
+ * How long libhadoop takes to set up short-circuit reads: to connect to a
+ * domain socket, to pass file descriptors over it, and to allocate the
+ * shared memory segments that are passed.  Only the calls that succeed
+ * are counted.  The counters are process wide and never reset; take the
+ * difference of two snapshots for an interval.
+ */
+@InterfaceAudience.Private
+@InterfaceStability.Unstable
+public final class ShortCircuitStats {
+
+  /**
+   * The operations timed, in the order of short_circuit_stats.h.
+   */
+  public enum Op {
+    /** {@link DomainSocket#connect(String)}. */
+    CONNECT,
+    /** Sending file descriptors, alone or in a batch. */
+    SEND_FDS,
+    /** Receiving file descriptors, alone or in a batch. */
+    RECEIVE_FDS,
+    /** Allocating a shared memory segment, from a file or a memfd. */
+    SHM_ALLOC
+  }
+
+  /**
+   * The number of histogram buckets.  Bucket 0 counts the calls that took
+   * less than a microsecond, bucket i those that took from 2^(i-1) up to
+   * 2^i microseconds, and the last one everything longer.
+   */
+  public static final int BUCKETS = 26;
+
+  private static final int VALUES_PER_OP = 3 + BUCKETS;
+
+  private ShortCircuitStats() {
+  }
+
+  /**
+   * Return true if libhadoop, and with it the domain sockets, are
+   * available.
+   */
+  public static boolean isAvailable() {
+    return DomainSocket.getLoadingFailureReason() == null;
+  }
+
+  /**
+   * A snapshot of the times of an operation.
+   */
+  public static final class Stats {
+    private final long count;
+    private final long totalNanos;
+    private final long maxNanos;
+    private final long[] buckets;
+
+    private Stats(long[] values, int offset) {
+      this.count = values[offset];
+      this.totalNanos = values[offset + 1];
+      this.maxNanos = values[offset + 2];
+      this.buckets = new long[BUCKETS];
+      System.arraycopy(values, offset + 3, buckets, 0, BUCKETS);
+    }
+
+    /** The calls that succeeded. */
+    public long getCount() {
+      return count;
+    }
+
+    /** The time taken by all of them. */
+    public long getTotalNanos() {
+      return totalNanos;
+    }
+
+    /** The time of the slowest one. */
+    public long getMaxNanos() {
+      return maxNanos;
+    }
+
+    /** The mean time of a call, or 0 if there were none. */
+    public long getMeanNanos() {
+      return count == 0 ? 0 : totalNanos / count;
+    }
+
+    /** The calls in each bucket, see {@link ShortCircuitStats#BUCKETS}. */
+    public long[] getBuckets() {
+      return buckets.clone();
+    }
+
+    /**
+     * An upper bound, in microseconds, of the time of the given fraction
+     * of the calls, such as 0.99 for the 99th percentile.  It is the upper
+     * end of the bucket the percentile falls in, or {@link #getMaxNanos()}
+     * if that is less.  Returns 0 if there were no calls.
+     */
+    public long getPercentileMicros(double fraction) {
+      long rank = (long) Math.ceil(fraction * count);
+      long seen = 0;
+      long maxMicros = (maxNanos + 999) / 1000;
+
+      if (count == 0) {
+        return 0;
+      }
+      for (int i = 0; i < BUCKETS - 1; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+          return Math.min(1L << i, maxMicros);
+        }
+      }
+      return maxMicros;
+    }
+
+    @Override
+    public String toString() {
+      return "count=" + count + ", meanNanos=" + getMeanNanos() +
+          ", maxNanos=" + maxNanos + ", p50Micros=" + getPercentileMicros(0.5) +
+          ", p99Micros=" + getPercentileMicros(0.99);
+    }
+  }
+
+  /**
+   * Get the times of an operation.  Must only be called if
+   * {@link #isAvailable()}.
+   */
+  public static Stats getStats(Op op) {
+    return new Stats(nativeGetStats(), VALUES_PER_OP * op.ordinal());
+  }
+
+  private static native long[] nativeGetStats();
+}
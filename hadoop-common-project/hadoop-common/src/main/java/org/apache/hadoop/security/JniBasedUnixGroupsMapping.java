@@ -19,7 +19,9 @@
 package org.apache.hadoop.security;
 
 import java.io.IOException;
+import java.util.ArrayList;
 import java.util.Arrays;
+import java.util.Collections;
 import java.util.List;
 
 import org.apache.hadoop.classification.InterfaceAudience;
@@ -27,20 +29,32 @@
 
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.conf.Configurable;
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeysPublic;
 import org.apache.hadoop.util.NativeCodeLoader;
 
 /**
  * A JNI-based implementation of {@link GroupMappingServiceProvider} 
  * that invokes libC calls to get the group
  * memberships of a given user.
+ *
+ * The names of group ids are cached natively, and shared by all instances,
+ * for {@link CommonConfigurationKeysPublic#HADOOP_SECURITY_GROUPS_JNI_NAME_CACHE_SECS}.
+ * Ids whose name could not be looked up are remembered for
+ * {@link CommonConfigurationKeysPublic#HADOOP_SECURITY_GROUPS_JNI_NAME_NEGATIVE_CACHE_SECS}.
+ * The instance configured last sets the timeouts of the shared cache.
  */
 @InterfaceAudience.LimitedPrivate({"HDFS", "MapReduce"})
 @InterfaceStability.Evolving
-public class JniBasedUnixGroupsMapping implements GroupMappingServiceProvider {
+public class JniBasedUnixGroupsMapping implements GroupMappingServiceProvider,
+    Configurable {
   
   private static final Log LOG = 
     LogFactory.getLog(JniBasedUnixGroupsMapping.class);
 
+  private Configuration conf;
+
   static {
     if (!NativeCodeLoader.isNativeCodeLoaded()) {
       throw new RuntimeException("Bailing out since native library couldn't " +
@@ -66,6 +80,28 @@ public class JniBasedUnixGroupsMapping implements GroupMappingServiceProvider {
    */
   native static String[] getGroupsForUser(String username);
 
+  /**
+   * Get the sets of groups associated with several users, with one native
+   * call.
+   *
+   * @param usernames          The user names
+   *
+   * @return                   The set of groups associated with each user,
+   *                             or null for those whose lookup failed.
+   */
+  native static String[][] getGroupsForUsers(String[] usernames);
+
+  /**
+   * Set how long the names of group ids, and failures to look them up, are
+   * cached.  0 or less disables either.
+   */
+  native static void setGroupNameCacheTimeouts(long ttlMs, long negativeTtlMs);
+
+  /**
+   * Drop all cached group names.
+   */
+  native static void clearGroupNameCache();
+
   /**
    * Log an error message about a group.  Used from JNI.
    */
@@ -88,13 +124,65 @@ public List<String> getGroups(String user) throws IOException {
     return Arrays.asList(groups);
   }
 
+  /**
+   * Get the groups of several users at once, which is cheaper than asking
+   * for each in turn.
+   *
+   * @param users              The user names
+   *
+   * @return                   The groups of each user, in the same order.
+   *                             Users that do not exist or could not be
+   *                             looked up have none.
+   */
+  public List<List<String>> getGroups(List<String> users) {
+    String[][] groups = null;
+    try {
+      groups = getGroupsForUsers(users.toArray(new String[users.size()]));
+    } catch (Exception e) {
+      if (LOG.isDebugEnabled()) {
+        LOG.debug("Error getting groups for " + users, e);
+      } else {
+        LOG.info("Error getting groups for " + users + ": " + e.getMessage());
+      }
+    }
+    List<List<String>> result = new ArrayList<List<String>>(users.size());
+    for (int i = 0; i < users.size(); i++) {
+      if (groups == null || groups[i] == null) {
+        result.add(Collections.<String>emptyList());
+      } else {
+        result.add(Arrays.asList(groups[i]));
+      }
+    }
+    return result;
+  }
+
   @Override
   public void cacheGroupsRefresh() throws IOException {
-    // does nothing in this provider of user to groups mapping
+    clearGroupNameCache();
   }
 
   @Override
   public void cacheGroupsAdd(List<String> groups) throws IOException {
     // does nothing in this provider of user to groups mapping
   }
+
+  @Override
+  public void setConf(Configuration conf) {
+    this.conf = conf;
+    long ttlMs = conf.getLong(
+        CommonConfigurationKeysPublic.HADOOP_SECURITY_GROUPS_JNI_NAME_CACHE_SECS,
+        CommonConfigurationKeysPublic.
+            HADOOP_SECURITY_GROUPS_JNI_NAME_CACHE_SECS_DEFAULT) * 1000;
+    long negativeTtlMs = conf.getLong(
+        CommonConfigurationKeysPublic.
+            HADOOP_SECURITY_GROUPS_JNI_NAME_NEGATIVE_CACHE_SECS,
+        CommonConfigurationKeysPublic.
+            HADOOP_SECURITY_GROUPS_JNI_NAME_NEGATIVE_CACHE_SECS_DEFAULT) * 1000;
+    setGroupNameCacheTimeouts(ttlMs, negativeTtlMs);
+  }
+
+  @Override
+  public Configuration getConf() {
+    return conf;
+  }
 }
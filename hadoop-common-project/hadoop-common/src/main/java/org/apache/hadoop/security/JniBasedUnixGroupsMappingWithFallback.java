@@ -23,17 +23,22 @@
 
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.conf.Configurable;
+import org.apache.hadoop.conf.Configuration;
 import org.apache.hadoop.util.NativeCodeLoader;
 import org.apache.hadoop.util.PerformanceAdvisory;
+import org.apache.hadoop.util.ReflectionUtils;
 
 public class JniBasedUnixGroupsMappingWithFallback implements
-    GroupMappingServiceProvider {
+    GroupMappingServiceProvider, Configurable {
 
   private static final Log LOG = LogFactory
       .getLog(JniBasedUnixGroupsMappingWithFallback.class);
   
   private GroupMappingServiceProvider impl;
 
+  private Configuration conf;
+
   public JniBasedUnixGroupsMappingWithFallback() {
     if (NativeCodeLoader.isNativeCodeLoaded()) {
       this.impl = new JniBasedUnixGroupsMapping();
@@ -61,4 +66,14 @@ public void cacheGroupsAdd(List<String> groups) throws IOException {
     impl.cacheGroupsAdd(groups);
   }
 
+  @Override
+  public void setConf(Configuration conf) {
+    this.conf = conf;
+    ReflectionUtils.setConf(impl, conf);
+  }
+
+  @Override
+  public Configuration getConf() {
+    return conf;
+  }
 }
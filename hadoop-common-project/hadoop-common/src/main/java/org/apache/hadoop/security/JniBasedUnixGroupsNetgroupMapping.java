@@ -20,22 +20,38 @@
 
 import java.io.IOException;
 import java.util.Arrays;
+import java.util.HashMap;
 import java.util.List;
 import java.util.LinkedList;
+import java.util.Map;
+import java.util.concurrent.Executors;
+import java.util.concurrent.ScheduledExecutorService;
+import java.util.concurrent.TimeUnit;
 
 import org.apache.hadoop.classification.InterfaceAudience;
 import org.apache.hadoop.classification.InterfaceStability;
 
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeysPublic;
 import org.apache.hadoop.util.NativeCodeLoader;
 
 import org.apache.hadoop.security.NetgroupCache;
 
+import com.google.common.util.concurrent.ThreadFactoryBuilder;
+
 /**
  * A JNI-based implementation of {@link GroupMappingServiceProvider} 
  * that invokes libC calls to get the group
  * memberships of a given user.
+ *
+ * The users of the netgroups used in ACLs are enumerated into the
+ * {@link NetgroupCache} when the ACLs are loaded, and enumerated again on
+ * {@link #cacheGroupsRefresh()} and, if
+ * {@link CommonConfigurationKeysPublic#HADOOP_SECURITY_GROUPS_JNI_NETGROUP_REFRESH_SECS}
+ * is set, periodically in the background.  Lookups only read the cache, so
+ * they never wait for an enumeration.
  */
 @InterfaceAudience.LimitedPrivate({"HDFS", "MapReduce"})
 @InterfaceStability.Evolving
@@ -45,8 +61,16 @@
   private static final Log LOG = LogFactory.getLog(
     JniBasedUnixGroupsNetgroupMapping.class);
 
+  private ScheduledExecutorService refresher;
+
   native String[] getUsersForNetgroupJNI(String group);
 
+  /**
+   * Get the users of several netgroups, without '@', with one native call.
+   * The users of unknown netgroups are null.
+   */
+  native String[][] getUsersForNetgroupsJNI(String[] groups);
+
   static {
     if (!NativeCodeLoader.isNativeCodeLoaded()) {
       throw new RuntimeException("Bailing out since native library couldn't " +
@@ -72,13 +96,14 @@ public List<String> getGroups(String user) throws IOException {
   }
 
   /**
-   * Refresh the netgroup cache
+   * Refresh the netgroup cache.  Lookups go on using the old users of the
+   * netgroups until all of them have been enumerated again.
    */
   @Override
   public void cacheGroupsRefresh() throws IOException {
+    super.cacheGroupsRefresh();
     List<String> groups = NetgroupCache.getNetgroupNames();
-    NetgroupCache.clear();
-    cacheGroupsAdd(groups);
+    NetgroupCache.update(getUsersForNetgroups(groups));
   }
 
   /**
@@ -88,17 +113,96 @@ public void cacheGroupsRefresh() throws IOException {
    */
   @Override
   public void cacheGroupsAdd(List<String> groups) throws IOException {
+    List<String> netgroups = new LinkedList<String>();
     for(String group: groups) {
       if(group.length() == 0) {
         // better safe than sorry (should never happen)
       } else if(group.charAt(0) == '@') {
         if(!NetgroupCache.isCached(group)) {
-          NetgroupCache.add(group, getUsersForNetgroup(group));
+          netgroups.add(group);
         }
       } else {
         // unix group, not caching
       }
     }
+    if (!netgroups.isEmpty()) {
+      NetgroupCache.update(getUsersForNetgroups(netgroups));
+    }
+  }
+
+  @Override
+  public void setConf(Configuration conf) {
+    super.setConf(conf);
+    long refreshSecs = conf.getLong(
+        CommonConfigurationKeysPublic.
+            HADOOP_SECURITY_GROUPS_JNI_NETGROUP_REFRESH_SECS,
+        CommonConfigurationKeysPublic.
+            HADOOP_SECURITY_GROUPS_JNI_NETGROUP_REFRESH_SECS_DEFAULT);
+    synchronized (this) {
+      if (refresher != null) {
+        refresher.shutdownNow();
+        refresher = null;
+      }
+      if (refreshSecs > 0) {
+        refresher = Executors.newSingleThreadScheduledExecutor(
+            new ThreadFactoryBuilder().setDaemon(true)
+                .setNameFormat("Netgroup cache refresher").build());
+        refresher.scheduleWithFixedDelay(new Runnable() {
+          @Override
+          public void run() {
+            try {
+              List<String> groups = NetgroupCache.getNetgroupNames();
+              if (!groups.isEmpty()) {
+                NetgroupCache.update(getUsersForNetgroups(groups));
+              }
+            } catch (Throwable t) {
+              LOG.warn("Error refreshing the netgroup cache", t);
+            }
+          }
+        }, refreshSecs, refreshSecs, TimeUnit.SECONDS);
+      }
+    }
+  }
+
+  /**
+   * Get the users of several netgroups with one JNI call, made synchronized
+   * for the same reason as {@link #getUsersForNetgroup(String)}.
+   *
+   * @param netgroups return users for these netgroups
+   * @return the users of each netgroup, none for those that are unknown
+   */
+  protected synchronized Map<String, List<String>> getUsersForNetgroups(
+      List<String> netgroups) {
+    String[] names = new String[netgroups.size()];
+    for (int i = 0; i < names.length; i++) {
+      // JNI code does not expect '@' at the begining of the group name
+      names[i] = netgroups.get(i).substring(1);
+    }
+    String[][] users = null;
+    try {
+      users = getUsersForNetgroupsJNI(names);
+    } catch (Exception e) {
+      if (LOG.isDebugEnabled()) {
+        LOG.debug("Error getting users for netgroups " + netgroups, e);
+      } else {
+        LOG.info("Error getting users for netgroups " + netgroups +
+            ": " + e.getMessage());
+      }
+    }
+    Map<String, List<String>> result = new HashMap<String, List<String>>();
+    for (int i = 0; i < names.length; i++) {
+      if (users == null || users[i] == null) {
+        if (users != null) {
+          LOG.info("Error getting users for netgroup " + netgroups.get(i) +
+              ": no netgroup of this name is known or some other error " +
+              "occurred");
+        }
+        result.put(netgroups.get(i), new LinkedList<String>());
+      } else {
+        result.put(netgroups.get(i), Arrays.asList(users[i]));
+      }
+    }
+    return result;
   }
 
   /**
@@ -18,9 +18,9 @@
 package org.apache.hadoop.security;
 
 import java.util.Collections;
-import java.util.HashSet;
 import java.util.LinkedList;
 import java.util.List;
+import java.util.Map;
 import java.util.Set;
 import java.util.concurrent.ConcurrentHashMap;
 
@@ -32,12 +32,23 @@
  * to user-to-group map, primarily intended for use with
  * netgroups (as returned by getent netgrgoup) which only returns
  * group to user mapping.
+ *
+ * Readers never wait: the cache is replaced whole by {@link #update(Map)},
+ * so a refresh that enumerates the netgroups again is never seen half done.
  */
 @InterfaceAudience.LimitedPrivate({"HDFS", "MapReduce"})
 @InterfaceStability.Unstable
 public class NetgroupCache {
-  private static ConcurrentHashMap<String, Set<String>> userToNetgroupsMap =
-    new ConcurrentHashMap<String, Set<String>>();
+  private static volatile ConcurrentHashMap<String, Set<String>>
+      userToNetgroupsMap = new ConcurrentHashMap<String, Set<String>>();
+
+  // The cached netgroups, including those without users
+  private static volatile Set<String> netgroups = newConcurrentSet();
+
+  private static Set<String> newConcurrentSet() {
+    //Generate a ConcurrentHashSet (backed by the keyset of the ConcurrentHashMap)
+    return Collections.newSetFromMap(new ConcurrentHashMap<String,Boolean>());
+  }
 
   /**
    * Get netgroups for a given user
@@ -61,15 +72,7 @@ public static void getNetgroups(final String user,
    * @return list of cached groups
    */
   public static List<String> getNetgroupNames() {
-    return new LinkedList<String>(getGroups());
-  }
-
-  private static Set<String> getGroups() {
-    Set<String> allGroups = new HashSet<String> ();
-    for (Set<String> userGroups : userToNetgroupsMap.values()) {
-      allGroups.addAll(userGroups);
-    }
-    return allGroups;
+    return new LinkedList<String>(netgroups);
   }
 
   /**
@@ -79,14 +82,15 @@ private static Set<String> getGroups() {
    * @return true if group is cached, false otherwise
    */
   public static boolean isCached(String group) {
-    return getGroups().contains(group);
+    return netgroups.contains(group);
   }
 
   /**
    * Clear the cache
    */
-  public static void clear() {
-    userToNetgroupsMap.clear();
+  public static synchronized void clear() {
+    userToNetgroupsMap = new ConcurrentHashMap<String, Set<String>>();
+    netgroups = newConcurrentSet();
   }
 
   /**
@@ -95,16 +99,53 @@ public static void clear() {
    * @param group name of the group to add to cache
    * @param users list of users for a given group
    */
-  public static void add(String group, List<String> users) {
+  public static synchronized void add(String group, List<String> users) {
+    addTo(userToNetgroupsMap, group, users);
+    netgroups.add(group);
+  }
+
+  /**
+   * Replace the users of some groups, adding those that are not cached yet,
+   * and leave the other groups alone.  Readers see either the old users of
+   * all of the groups or the new ones.
+   *
+   * @param groupsToUsers the users of each group
+   */
+  public static synchronized void update(
+      Map<String, List<String>> groupsToUsers) {
+    ConcurrentHashMap<String, Set<String>> newMap =
+        new ConcurrentHashMap<String, Set<String>>();
+    for (Map.Entry<String, Set<String>> entry :
+        userToNetgroupsMap.entrySet()) {
+      Set<String> kept = newConcurrentSet();
+      for (String group : entry.getValue()) {
+        if (!groupsToUsers.containsKey(group)) {
+          kept.add(group);
+        }
+      }
+      if (!kept.isEmpty()) {
+        newMap.put(entry.getKey(), kept);
+      }
+    }
+    Set<String> newGroups = newConcurrentSet();
+    newGroups.addAll(netgroups);
+    for (Map.Entry<String, List<String>> entry : groupsToUsers.entrySet()) {
+      addTo(newMap, entry.getKey(), entry.getValue());
+      newGroups.add(entry.getKey());
+    }
+    userToNetgroupsMap = newMap;
+    netgroups = newGroups;
+  }
+
+  private static void addTo(ConcurrentHashMap<String, Set<String>> map,
+      String group, List<String> users) {
     for (String user : users) {
-      Set<String> userGroups = userToNetgroupsMap.get(user);
+      Set<String> userGroups = map.get(user);
       // ConcurrentHashMap does not allow null values; 
       // So null value check can be used to check if the key exists
       if (userGroups == null) {
-        //Generate a ConcurrentHashSet (backed by the keyset of the ConcurrentHashMap)
-        userGroups =
-            Collections.newSetFromMap(new ConcurrentHashMap<String,Boolean>());
-        Set<String> currentSet = userToNetgroupsMap.putIfAbsent(user, userGroups);
+        userGroups = newConcurrentSet();
+        Set<String> currentSet = map.putIfAbsent(user, userGroups);
         if (currentSet != null) {
           userGroups = currentSet;
         }
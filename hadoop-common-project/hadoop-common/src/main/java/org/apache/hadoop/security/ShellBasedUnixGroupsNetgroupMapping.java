@@ -18,8 +18,10 @@
 package org.apache.hadoop.security;
 
 import java.io.IOException;
+import java.util.HashMap;
 import java.util.LinkedList;
 import java.util.List;
+import java.util.Map;
 import org.apache.hadoop.classification.InterfaceAudience;
 import org.apache.hadoop.classification.InterfaceStability;
 
@@ -58,13 +60,17 @@ public List<String> getGroups(String user) throws IOException {
   }
 
   /**
-   * Refresh the netgroup cache
+   * Refresh the netgroup cache.  Lookups go on using the old users of the
+   * netgroups until all of them have been enumerated again.
    */
   @Override
   public void cacheGroupsRefresh() throws IOException {
-    List<String> groups = NetgroupCache.getNetgroupNames();
-    NetgroupCache.clear();
-    cacheGroupsAdd(groups);
+    Map<String, List<String>> groupsToUsers =
+        new HashMap<String, List<String>>();
+    for (String group : NetgroupCache.getNetgroupNames()) {
+      groupsToUsers.put(group, getUsersForNetgroup(group));
+    }
+    NetgroupCache.update(groupsToUsers);
   }
 
   /**
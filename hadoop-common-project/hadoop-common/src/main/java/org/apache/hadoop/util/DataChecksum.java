@@ -450,6 +450,42 @@ public void calculateChunkedSums(ByteBuffer data, ByteBuffer checksums) {
     }
   }
 
+  /**
+   * Copy data and calculate its checksums.  With native code and direct
+   * buffers this takes a single pass over the data, instead of a copy
+   * followed by {@link #calculateChunkedSums(ByteBuffer, ByteBuffer)}.
+   *
+   * The data from the position to the limit of src is copied to dst at its
+   * position.  The 'mark' of the ByteBuffer parameters may be modified by
+   * this function, but the positions are maintained.
+   *
+   * @param src the buffer holding the data to copy and checksum.
+   * @param dst the buffer to copy the data into, which must not overlap src.
+   *            Enough space must be available in this buffer to put the data.
+   * @param checksums the buffer into which checksums will be stored.
+   *                  Enough space must be available in this buffer to put
+   *                  the checksums.
+   */
+  public void copyAndCalculateChunkedSums(ByteBuffer src, ByteBuffer dst,
+      ByteBuffer checksums) {
+    if (dst.remaining() < src.remaining()) {
+      throw new IllegalArgumentException("Destination buffer has room for "
+          + dst.remaining() + " bytes out of " + src.remaining());
+    }
+    if (type.size != 0 && src.isDirect() && dst.isDirect() &&
+        checksums.isDirect() && NativeCrc32.isAvailable()) {
+      NativeCrc32.copyAndCalculateChunkedSums(bytesPerChecksum, type.id,
+          checksums, src, dst);
+      return;
+    }
+
+    ByteBuffer copied = dst.duplicate();
+    copied.put(src.duplicate());
+    copied.flip();
+    copied.position(dst.position());
+    calculateChunkedSums(copied, checksums);
+  }
+
   /**
    * Implementation of chunked calculation specifically on byte arrays. This
    * is to avoid the copy when dealing with ByteBuffers that have array backing.
@@ -79,6 +79,11 @@ public static boolean isNativeCodeLoaded() {
    */
   public static native boolean buildSupportsSnappy();
 
+  /**
+   * Returns true only if this build was compiled with support for zstd.
+   */
+  public static native boolean buildSupportsZstd();
+
   /**
    * Returns true only if this build was compiled with support for ISA-L.
    */
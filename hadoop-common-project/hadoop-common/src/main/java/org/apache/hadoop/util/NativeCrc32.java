@@ -62,6 +62,39 @@ public static void verifyChunkedSums(int bytesPerSum, int checksumType,
         fileName, basePos, true);
   }
 
+  /**
+   * Verify the checksums of several buffers of data in one call.  Each
+   * buffer is verified from its position to its limit as if it had been
+   * given to {@link #verifyChunkedSums}, its checksums following those of
+   * the buffer before it in sums, but the chunks on either side of a buffer
+   * boundary are checksummed together.  The positions, limits, and marks
+   * are not modified.
+   *
+   * @param bytesPerSum the chunk size (eg 512 bytes)
+   * @param checksumType the DataChecksum type constant (NULL is not supported)
+   * @param sums the DirectByteBuffer pointing at the beginning of the
+   *             stored checksums of all the buffers
+   * @param data the DirectByteBuffers of data to check, which follow each
+   *             other in the file
+   * @param fileName the name of the file being verified
+   * @param basePos the position in the file where the first buffer starts
+   * @throws ChecksumException if there is an invalid checksum
+   */
+  public static void verifyChunkedSumsScattered(int bytesPerSum,
+      int checksumType, ByteBuffer sums, ByteBuffer[] data, String fileName,
+      long basePos) throws ChecksumException {
+    int[] dataOffsets = new int[data.length];
+    int[] dataLengths = new int[data.length];
+    for (int i = 0; i < data.length; i++) {
+      dataOffsets[i] = data[i].position();
+      dataLengths[i] = data[i].remaining();
+    }
+    nativeComputeChunkedSumsScattered(bytesPerSum, checksumType,
+        sums, sums.position(),
+        data, dataOffsets, dataLengths,
+        fileName, basePos, true);
+  }
+
   public static void verifyChunkedSumsByteArray(int bytesPerSum,
       int checksumType, byte[] sums, int sumsOffset, byte[] data,
       int dataOffset, int dataLength, String fileName, long basePos)
@@ -80,6 +113,32 @@ public static void calculateChunkedSums(int bytesPerSum, int checksumType,
         "", 0, false);
   }
 
+  /**
+   * Copy src to dst and calculate the checksums of the data in one pass,
+   * so that it is only read from memory once.  The data from the position
+   * to the limit of src is copied to dst at its position.  The positions,
+   * limits, and marks are not modified.
+   *
+   * @param bytesPerSum the chunk size (eg 512 bytes)
+   * @param checksumType the DataChecksum type constant (NULL is not supported)
+   * @param sums the DirectByteBuffer to store the checksums into
+   * @param src the DirectByteBuffer of data to copy
+   * @param dst the DirectByteBuffer to copy to, which must not overlap src
+   *            and must have room for the data
+   */
+  public static void copyAndCalculateChunkedSums(int bytesPerSum,
+      int checksumType, ByteBuffer sums, ByteBuffer src, ByteBuffer dst) {
+    if (dst.remaining() < src.remaining()) {
+      throw new IllegalArgumentException("Destination buffer has room for "
+          + dst.remaining() + " bytes out of " + src.remaining());
+    }
+    nativeCopyAndComputeChunkedSums(bytesPerSum, checksumType,
+        sums, sums.position(),
+        src, src.position(),
+        dst, dst.position(), src.remaining(),
+        "", 0, false);
+  }
+
   public static void calculateChunkedSumsByteArray(int bytesPerSum,
       int checksumType, byte[] sums, int sumsOffset, byte[] data,
       int dataOffset, int dataLength) {
@@ -126,12 +185,25 @@ private static native void nativeComputeChunkedSums(
       ByteBuffer data, int dataOffset, int dataLength,
       String fileName, long basePos, boolean verify);
 
+    private static native void nativeCopyAndComputeChunkedSums(
+      int bytesPerSum, int checksumType,
+      ByteBuffer sums, int sumsOffset,
+      ByteBuffer src, int srcOffset,
+      ByteBuffer dst, int dstOffset, int dataLength,
+      String fileName, long basePos, boolean verify);
+
     private static native void nativeComputeChunkedSumsByteArray(
       int bytesPerSum, int checksumType,
       byte[] sums, int sumsOffset,
       byte[] data, int dataOffset, int dataLength,
       String fileName, long basePos, boolean verify);
 
+    private static native void nativeComputeChunkedSumsScattered(
+      int bytesPerSum, int checksumType,
+      ByteBuffer sums, int sumsOffset,
+      ByteBuffer[] data, int[] dataOffsets, int[] dataLengths,
+      String fileName, long basePos, boolean verify);
+
   // Copy the constants over from DataChecksum so that javah will pick them up
   // and make them available in the native code header.
   public static final int CHECKSUM_CRC32 = DataChecksum.CHECKSUM_CRC32;
@@ -23,6 +23,7 @@
 import org.apache.hadoop.crypto.OpensslCipher;
 import org.apache.hadoop.io.compress.Lz4Codec;
 import org.apache.hadoop.io.compress.SnappyCodec;
+import org.apache.hadoop.io.compress.ZStandardCodec;
 import org.apache.hadoop.io.compress.bzip2.Bzip2Factory;
 import org.apache.hadoop.io.compress.zlib.ZlibFactory;
 import org.apache.hadoop.classification.InterfaceAudience;
@@ -66,6 +67,7 @@ public static void main(String[] args) {
     boolean nativeHadoopLoaded = NativeCodeLoader.isNativeCodeLoaded();
     boolean zlibLoaded = false;
     boolean snappyLoaded = false;
+    boolean zstdLoaded = false;
     boolean isalLoaded = false;
     // lz4 is linked within libhadoop
     boolean lz4Loaded = nativeHadoopLoaded;
@@ -77,6 +79,7 @@ public static void main(String[] args) {
     String hadoopLibraryName = "";
     String zlibLibraryName = "";
     String snappyLibraryName = "";
+    String zstdLibraryName = "";
     String isalDetail = "";
     String lz4LibraryName = "";
     String bzip2LibraryName = "";
@@ -95,6 +98,12 @@ public static void main(String[] args) {
         snappyLibraryName = SnappyCodec.getLibraryName();
       }
 
+      zstdLoaded = NativeCodeLoader.buildSupportsZstd() &&
+          ZStandardCodec.isNativeCodeLoaded();
+      if (zstdLoaded) {
+        zstdLibraryName = ZStandardCodec.getLibraryName();
+      }
+
       try {
         isalDetail = ErasureCodeNative.getLoadingFailureReason();
         isalDetail = ErasureCodeNative.getLibraryName();
@@ -136,6 +145,7 @@ public static void main(String[] args) {
     System.out.printf("hadoop:  %b %s%n", nativeHadoopLoaded, hadoopLibraryName);
     System.out.printf("zlib:    %b %s%n", zlibLoaded, zlibLibraryName);
     System.out.printf("snappy:  %b %s%n", snappyLoaded, snappyLibraryName);
+    System.out.printf("zstd:    %b %s%n", zstdLoaded, zstdLibraryName);
     System.out.printf("lz4:     %b %s%n", lz4Loaded, lz4LibraryName);
     System.out.printf("bzip2:   %b %s%n", bzip2Loaded, bzip2LibraryName);
     System.out.printf("openssl: %b %s%n", openSslLoaded, openSslDetail);
@@ -146,7 +156,7 @@ public static void main(String[] args) {
     }
 
     if ((!nativeHadoopLoaded) || (Shell.WINDOWS && (!winutilsExists)) ||
-        (checkAll && !(zlibLoaded && snappyLoaded && lz4Loaded && bzip2Loaded && isalLoaded))) {
+        (checkAll && !(zlibLoaded && snappyLoaded && zstdLoaded && lz4Loaded && bzip2Loaded && isalLoaded))) {
       // return 1 to indicated check failed
       ExitUtil.terminate(1);
     }
@@ -0,0 +1,109 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.util;
+
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.classification.InterfaceStability;
+
+/**
+ * The memory libhadoop allocates outside of the JVM heap, by subsystem,
+ * for telling the native part of a process' footprint apart when sizing
+ * containers.  Only long lived state and buffers are counted, such as the
+ * streams of the native codecs and the tables of the erasure coders.
+ * libnativetask keeps counters of its own, which are reported as task
+ * counters.
+ */
+@InterfaceAudience.Private
+@InterfaceStability.Unstable
+public final class NativeMemory {
+
+  /**
+   * What the memory is used for, in the order of native_memory.h.
+   */
+  public enum Subsystem {
+    /** Compressor and decompressor state and buffers. */
+    CODEC,
+    /** Erasure coder state and tables. */
+    ERASURE_CODE,
+    /** The sort buffer of nativetask, not used by libhadoop. */
+    SORT,
+    /** The stream buffers of nativetask, not used by libhadoop. */
+    BUFFERS
+  }
+
+  private NativeMemory() {
+  }
+
+  /**
+   * Return true if libhadoop, and so the accounting, is available.
+   */
+  public static boolean isAvailable() {
+    return NativeCodeLoader.isNativeCodeLoaded();
+  }
+
+  /**
+   * A snapshot of the allocations of a subsystem, or of all of them.
+   */
+  public static final class Stats {
+    private final long currentBytes;
+    private final long peakBytes;
+
+    private Stats(long currentBytes, long peakBytes) {
+      this.currentBytes = currentBytes;
+      this.peakBytes = peakBytes;
+    }
+
+    /** The bytes allocated now. */
+    public long getCurrentBytes() {
+      return currentBytes;
+    }
+
+    /** The most bytes allocated at any time so far. */
+    public long getPeakBytes() {
+      return peakBytes;
+    }
+
+    @Override
+    public String toString() {
+      return "currentBytes=" + currentBytes + ", peakBytes=" + peakBytes;
+    }
+  }
+
+  /**
+   * Get the allocations of a subsystem.  Must only be called if
+   * {@link #isAvailable()}.
+   */
+  public static Stats getStats(Subsystem subsystem) {
+    long[] values = nativeGetStats();
+    int i = 2 * subsystem.ordinal();
+    return new Stats(values[i], values[i + 1]);
+  }
+
+  /**
+   * Get the allocations of all subsystems together.  The peak is the most
+   * allocated at once, which may be less than the sum of the peaks of the
+   * subsystems.  Must only be called if {@link #isAvailable()}.
+   */
+  public static Stats getTotalStats() {
+    long[] values = nativeGetStats();
+    int i = 2 * Subsystem.values().length;
+    return new Stats(values[i], values[i + 1]);
+  }
+
+  private static native long[] nativeGetStats();
+}
@@ -0,0 +1,106 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.util;
+
+import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.classification.InterfaceStability;
+
+/**
+ * The worker threads that libhadoop shares between its CPU kernels, the
+ * parallel codecs, the erasure decoder and the checksums.  The pool never
+ * has more workers than the CPUs the process may use, as bounded by its
+ * affinity and its cgroup CPU quota, less one for the calling thread.
+ */
+@InterfaceAudience.Private
+@InterfaceStability.Unstable
+public final class NativeWorkerPool {
+
+  private NativeWorkerPool() {
+  }
+
+  /**
+   * Return true if libhadoop, and so the pool, is available.
+   */
+  public static boolean isAvailable() {
+    return NativeCodeLoader.isNativeCodeLoaded();
+  }
+
+  /**
+   * A snapshot of the statistics of the pool.
+   */
+  public static final class Stats {
+    private final int maxWorkers;
+    private final int workers;
+    private final long queuedTasks;
+    private final long tasksRun;
+    private final long busyNanos;
+
+    private Stats(long[] values) {
+      maxWorkers = (int) values[0];
+      workers = (int) values[1];
+      queuedTasks = values[2];
+      tasksRun = values[3];
+      busyNanos = values[4];
+    }
+
+    /** The most workers the pool starts. */
+    public int getMaxWorkers() {
+      return maxWorkers;
+    }
+
+    /** The workers started so far. */
+    public int getWorkers() {
+      return workers;
+    }
+
+    /** The tasks handed to the pool that no thread has started yet. */
+    public long getQueuedTasks() {
+      return queuedTasks;
+    }
+
+    /** The tasks run so far. */
+    public long getTasksRun() {
+      return tasksRun;
+    }
+
+    /**
+     * The nanoseconds spent running tasks so far, by the workers and by the
+     * threads that handed them out.
+     */
+    public long getBusyNanos() {
+      return busyNanos;
+    }
+
+    @Override
+    public String toString() {
+      return "maxWorkers=" + maxWorkers + ", workers=" + workers +
+          ", queuedTasks=" + queuedTasks + ", tasksRun=" + tasksRun +
+          ", busyNanos=" + busyNanos;
+    }
+  }
+
+  /**
+   * Get the statistics of the pool.  Must only be called if
+   * {@link #isAvailable()}.
+   */
+  public static Stats getStats() {
+    return new Stats(nativeGetStats());
+  }
+
+  private static native long[] nativeGetStats();
+}
@@ -17,7 +17,10 @@
  */
 package org.apache.hadoop.util;
 
+import java.io.BufferedReader;
 import java.io.IOException;
+import java.io.InputStreamReader;
+import java.nio.charset.Charset;
 
 import com.google.common.annotations.VisibleForTesting;
 
@@ -52,6 +55,18 @@ public class SysInfoWindows extends SysInfo {
   private long lastRefreshTime;
   static final int REFRESH_INTERVAL_MS = 1000;
 
+  /** Number of values in the output of a single "winutils systeminfo". */
+  static final int SYSINFO_SPLIT_COUNT = 11;
+  /**
+   * Number of values "winutils systeminfo -s" adds in front of the busy time
+   * of each processor: the interval and the disk and network deltas.
+   */
+  static final int SYSINFO_STREAM_EXTRA_COUNT = 5;
+
+  private Process streamProcess;
+  private volatile String lastStreamLine;
+  private volatile boolean streamFailed;
+
   public SysInfoWindows() {
     lastRefreshTime = 0;
     reset();
@@ -78,6 +93,10 @@ void reset() {
   }
 
   String getSystemInfoInfoFromShell() {
+    String line = getSystemInfoFromStream();
+    if (line != null) {
+      return line;
+    }
     try {
       ShellCommandExecutor shellExecutor = new ShellCommandExecutor(
           new String[] {Shell.getWinUtilsFile().getCanonicalPath(),
@@ -90,6 +109,63 @@ String getSystemInfoInfoFromShell() {
     return null;
   }
 
+  /**
+   * Get the latest line printed by a long running "winutils systeminfo -s",
+   * which is started on the first call, so that the metrics do not need a
+   * new process on every refresh.
+   * @return the line, or null if there is none yet or the stream cannot be
+   *         used, in which case the caller should run systeminfo itself.
+   */
+  synchronized String getSystemInfoFromStream() {
+    if (streamFailed) {
+      return null;
+    }
+    if (streamProcess == null) {
+      try {
+        ProcessBuilder builder = new ProcessBuilder(
+            Shell.getWinUtilsFile().getCanonicalPath(), "systeminfo", "-s",
+            String.valueOf(REFRESH_INTERVAL_MS));
+        builder.redirectError(ProcessBuilder.Redirect.INHERIT);
+        streamProcess = builder.start();
+      } catch (IOException e) {
+        LOG.warn("Cannot start streaming systeminfo, running it on every "
+            + "refresh instead", e);
+        streamFailed = true;
+        return null;
+      }
+      Thread reader = new Thread(new Runnable() {
+        @Override
+        public void run() {
+          readSystemInfoStream(streamProcess);
+        }
+      }, "SysInfoWindows stream reader");
+      reader.setDaemon(true);
+      reader.start();
+    }
+    return lastStreamLine;
+  }
+
+  private void readSystemInfoStream(Process process) {
+    try (BufferedReader reader = new BufferedReader(new InputStreamReader(
+        process.getInputStream(), Charset.defaultCharset()))) {
+      String line;
+      while ((line = reader.readLine()) != null) {
+        // an older winutils prints its usage for -s instead
+        if (line.split(",").length > SYSINFO_SPLIT_COUNT) {
+          lastStreamLine = line;
+        }
+      }
+    } catch (IOException e) {
+      LOG.warn("Error reading streaming systeminfo", e);
+    } finally {
+      LOG.info("Streaming systeminfo stopped, running it on every refresh "
+          + "instead");
+      lastStreamLine = null;
+      streamFailed = true;
+      process.destroy();
+    }
+  }
+
   void refreshIfNeeded() {
     long now = now();
     if (now - lastRefreshTime > REFRESH_INTERVAL_MS) {
@@ -99,10 +175,10 @@ void refreshIfNeeded() {
       reset();
       String sysInfoStr = getSystemInfoInfoFromShell();
       if (sysInfoStr != null) {
-        final int sysInfoSplitCount = 11;
-        String[] sysInfo = sysInfoStr.substring(0, sysInfoStr.indexOf("\r\n"))
+        int eol = sysInfoStr.indexOf("\r\n");
+        String[] sysInfo = (eol < 0 ? sysInfoStr : sysInfoStr.substring(0, eol))
             .split(",");
-        if (sysInfo.length == sysInfoSplitCount) {
+        if (sysInfo.length >= SYSINFO_SPLIT_COUNT) {
           try {
             vmemSize = Long.parseLong(sysInfo[0]);
             memSize = Long.parseLong(sysInfo[1]);
@@ -115,7 +191,20 @@ void refreshIfNeeded() {
             storageBytesWritten = Long.parseLong(sysInfo[8]);
             netBytesRead = Long.parseLong(sysInfo[9]);
             netBytesWritten = Long.parseLong(sysInfo[10]);
-            if (lastCumCpuTimeMs != -1) {
+            if (sysInfo.length == SYSINFO_SPLIT_COUNT
+                + SYSINFO_STREAM_EXTRA_COUNT + numProcessors) {
+              // streamed line: use the busy time of each processor in the
+              // interval the line was sampled over
+              long intervalMs = Long.parseLong(sysInfo[SYSINFO_SPLIT_COUNT]);
+              long busyTimeMs = 0;
+              for (int i = SYSINFO_SPLIT_COUNT + SYSINFO_STREAM_EXTRA_COUNT;
+                   i < sysInfo.length; i++) {
+                busyTimeMs += Long.parseLong(sysInfo[i]);
+              }
+              if (intervalMs > 0) {
+                cpuUsage = busyTimeMs * 100F / intervalMs;
+              }
+            } else if (lastCumCpuTimeMs != -1) {
               /**
                * This number will be the aggregated usage across all cores in
                * [0.0, 100.0]. For example, it will be 400.0 if there are 8
@@ -128,8 +217,8 @@ void refreshIfNeeded() {
             LOG.warn("Error parsing sysInfo", nfe);
           }
         } else {
-          LOG.warn("Expected split length of sysInfo to be "
-              + sysInfoSplitCount + ". Got " + sysInfo.length);
+          LOG.warn("Expected split length of sysInfo to be at least "
+              + SYSINFO_SPLIT_COUNT + ". Got " + sysInfo.length);
         }
       }
     }
@@ -23,6 +23,8 @@
 #include <string.h>
  
 #include "org_apache_hadoop_crypto_OpensslCipher.h"
+#include "org_apache_hadoop_util_NativeCrc32.h"
+#include "bulk_crc32.h"
 
 #ifdef UNIX
 static EVP_CIPHER_CTX * (*dlsym_EVP_CIPHER_CTX_new)(void);
@@ -37,6 +39,9 @@ static int (*dlsym_EVP_CipherUpdate)(EVP_CIPHER_CTX *, unsigned char *,  \
 static int (*dlsym_EVP_CipherFinal_ex)(EVP_CIPHER_CTX *, unsigned char *, int *);
 static EVP_CIPHER * (*dlsym_EVP_aes_256_ctr)(void);
 static EVP_CIPHER * (*dlsym_EVP_aes_128_ctr)(void);
+static int (*dlsym_EVP_CIPHER_CTX_ctrl)(EVP_CIPHER_CTX *, int, int, void *);
+static EVP_CIPHER * (*dlsym_EVP_aes_256_gcm)(void);
+static EVP_CIPHER * (*dlsym_EVP_aes_128_gcm)(void);
 static void *openssl;
 #endif
 
@@ -55,6 +60,10 @@ typedef int (__cdecl *__dlsym_EVP_CipherFinal_ex)(EVP_CIPHER_CTX *,  \
              unsigned char *, int *);
 typedef EVP_CIPHER * (__cdecl *__dlsym_EVP_aes_256_ctr)(void);
 typedef EVP_CIPHER * (__cdecl *__dlsym_EVP_aes_128_ctr)(void);
+typedef int (__cdecl *__dlsym_EVP_CIPHER_CTX_ctrl)(EVP_CIPHER_CTX *, int,  \
+             int, void *);
+typedef EVP_CIPHER * (__cdecl *__dlsym_EVP_aes_256_gcm)(void);
+typedef EVP_CIPHER * (__cdecl *__dlsym_EVP_aes_128_gcm)(void);
 static __dlsym_EVP_CIPHER_CTX_new dlsym_EVP_CIPHER_CTX_new;
 static __dlsym_EVP_CIPHER_CTX_free dlsym_EVP_CIPHER_CTX_free;
 static __dlsym_EVP_CIPHER_CTX_cleanup dlsym_EVP_CIPHER_CTX_cleanup;
@@ -65,6 +74,9 @@ static __dlsym_EVP_CipherUpdate dlsym_EVP_CipherUpdate;
 static __dlsym_EVP_CipherFinal_ex dlsym_EVP_CipherFinal_ex;
 static __dlsym_EVP_aes_256_ctr dlsym_EVP_aes_256_ctr;
 static __dlsym_EVP_aes_128_ctr dlsym_EVP_aes_128_ctr;
+static __dlsym_EVP_CIPHER_CTX_ctrl dlsym_EVP_CIPHER_CTX_ctrl;
+static __dlsym_EVP_aes_256_gcm dlsym_EVP_aes_256_gcm;
+static __dlsym_EVP_aes_128_gcm dlsym_EVP_aes_128_gcm;
 static HMODULE openssl;
 #endif
 
@@ -83,6 +95,28 @@ static void loadAesCtr(JNIEnv *env)
 #endif
 }
 
+/**
+ * AES-GCM is optional: without it only AES/GCM/NoPadding ciphers fail to
+ * be created.
+ */
+static void loadAesGcm(void)
+{
+#ifdef UNIX
+  dlsym_EVP_CIPHER_CTX_ctrl = dlsym(openssl, "EVP_CIPHER_CTX_ctrl");
+  dlsym_EVP_aes_256_gcm = dlsym(openssl, "EVP_aes_256_gcm");
+  dlsym_EVP_aes_128_gcm = dlsym(openssl, "EVP_aes_128_gcm");
+#endif
+
+#ifdef WINDOWS
+  dlsym_EVP_CIPHER_CTX_ctrl = (__dlsym_EVP_CIPHER_CTX_ctrl)  \
+      GetProcAddress(openssl, "EVP_CIPHER_CTX_ctrl");
+  dlsym_EVP_aes_256_gcm = (__dlsym_EVP_aes_256_gcm)  \
+      GetProcAddress(openssl, "EVP_aes_256_gcm");
+  dlsym_EVP_aes_128_gcm = (__dlsym_EVP_aes_128_gcm)  \
+      GetProcAddress(openssl, "EVP_aes_128_gcm");
+#endif
+}
+
 JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_initIDs
     (JNIEnv *env, jclass clazz)
 {
@@ -151,12 +185,13 @@ JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_initIDs
         "Cannot find AES-CTR support, is your version of Openssl new enough?");
     return;
   }
+  loadAesGcm();
 }
 
 JNIEXPORT jlong JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_initContext
     (JNIEnv *env, jclass clazz, jint alg, jint padding)
 {
-  if (alg != AES_CTR) {
+  if (alg != AES_CTR && alg != AES_GCM) {
     THROW(env, "java/security/NoSuchAlgorithmException", NULL);
     return (jlong)0;
   }
@@ -170,6 +205,12 @@ JNIEXPORT jlong JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_initContext
         "Doesn't support AES CTR.");
     return (jlong)0;
   }
+  if (alg == AES_GCM && (dlsym_EVP_CIPHER_CTX_ctrl == NULL ||  \
+      dlsym_EVP_aes_256_gcm == NULL || dlsym_EVP_aes_128_gcm == NULL)) {
+    THROW(env, "java/security/NoSuchAlgorithmException",  \
+        "Doesn't support AES GCM.");
+    return (jlong)0;
+  }
   
   // Create and initialize a EVP_CIPHER_CTX
   EVP_CIPHER_CTX *context = dlsym_EVP_CIPHER_CTX_new();
@@ -181,7 +222,7 @@ JNIEXPORT jlong JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_initContext
   return JLONG(context);
 }
 
-// Only supports AES-CTR currently
+// Only supports AES-CTR and AES-GCM currently
 static EVP_CIPHER * getEvpCipher(int alg, int keyLen)
 {
   EVP_CIPHER *cipher = NULL;
@@ -191,6 +232,12 @@ static EVP_CIPHER * getEvpCipher(int alg, int keyLen)
     } else if (keyLen == KEY_LENGTH_128) {
       cipher = dlsym_EVP_aes_128_ctr();
     }
+  } else if (alg == AES_GCM) {
+    if (keyLen == KEY_LENGTH_256) {
+      cipher = dlsym_EVP_aes_256_gcm();
+    } else if (keyLen == KEY_LENGTH_128) {
+      cipher = dlsym_EVP_aes_128_gcm();
+    }
   }
   return cipher;
 }
@@ -205,7 +252,7 @@ JNIEXPORT jlong JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_init
     THROW(env, "java/lang/IllegalArgumentException", "Invalid key length.");
     return (jlong)0;
   }
-  if (jIvLen != IV_LENGTH) {
+  if (jIvLen != (alg == AES_GCM ? GCM_IV_LENGTH : IV_LENGTH)) {
     THROW(env, "java/lang/IllegalArgumentException", "Invalid iv length.");
     return (jlong)0;
   }
@@ -249,6 +296,43 @@ JNIEXPORT jlong JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_init
   return JLONG(context);
 }
 
+JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_setIV
+    (JNIEnv *env, jobject object, jlong ctx, jbyteArray iv, jint skip)
+{
+  unsigned char iv_bytes[IV_LENGTH], scratch[IV_LENGTH];
+  int output_len = 0;
+  EVP_CIPHER_CTX *context = CONTEXT(ctx);
+
+  if ((*env)->GetArrayLength(env, iv) != IV_LENGTH) {
+    THROW(env, "java/lang/IllegalArgumentException", "Invalid iv length.");
+    return;
+  }
+  if (skip < 0 || skip >= IV_LENGTH) {
+    THROW(env, "java/lang/IllegalArgumentException", "Invalid skip.");
+    return;
+  }
+  (*env)->GetByteArrayRegion(env, iv, 0, IV_LENGTH, (jbyte *)iv_bytes);
+
+  // A NULL cipher and key keep the key schedule of the context, and an
+  // enc of -1 its direction: only the counter is restarted
+  if (!dlsym_EVP_CipherInit_ex(context, NULL, NULL, NULL, iv_bytes, -1)) {
+    dlsym_EVP_CIPHER_CTX_cleanup(context);
+    THROW(env, "java/lang/InternalError", "Error in EVP_CipherInit_ex.");
+    return;
+  }
+  if (skip > 0) {
+    // Use up the first skip bytes of the keystream of the block
+    memset(scratch, 0, sizeof(scratch));
+    if (!dlsym_EVP_CipherUpdate(context, scratch, &output_len,  \
+        scratch, skip)) {
+      dlsym_EVP_CIPHER_CTX_cleanup(context);
+      THROW(env, "java/lang/InternalError", "Error in EVP_CipherUpdate.");
+      return;
+    }
+    memset(scratch, 0, sizeof(scratch));
+  }
+}
+
 // https://www.openssl.org/docs/crypto/EVP_EncryptInit.html
 static int check_update_max_output_len(EVP_CIPHER_CTX *context, int input_len, 
     int max_output_len)
@@ -303,11 +387,282 @@ JNIEXPORT jint JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_update
   return output_len;
 }
 
+JNIEXPORT jlong JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_updateBatch
+    (JNIEnv *env, jobject object, jlong ctx, jint mode, jint alg, jint padding,
+    jobjectArray keys, jobjectArray ivs, jobjectArray inputs,
+    jintArray input_offsets, jintArray input_lens, jobjectArray outputs,
+    jintArray output_offsets, jintArray output_lens)
+{
+  jint *in_offs = NULL, *in_lens = NULL, *out_offs = NULL, *out_lens = NULL;
+  unsigned char key[KEY_LENGTH_256], last_key[KEY_LENGTH_256], iv[IV_LENGTH];
+  unsigned char *input_bytes, *output_bytes;
+  int key_len, iv_len, last_key_len = 0, output_len, rc, i;
+  jsize count = (*env)->GetArrayLength(env, inputs);
+  jobject elem;
+
+  EVP_CIPHER_CTX *context = CONTEXT(ctx);
+  if (context == 0) {
+    // Create and initialize a EVP_CIPHER_CTX
+    context = dlsym_EVP_CIPHER_CTX_new();
+    if (!context) {
+      THROW(env, "java/lang/OutOfMemoryError", NULL);
+      return (jlong)0;
+    }
+  }
+
+  in_offs = (*env)->GetIntArrayElements(env, input_offsets, NULL);
+  in_lens = (*env)->GetIntArrayElements(env, input_lens, NULL);
+  out_offs = (*env)->GetIntArrayElements(env, output_offsets, NULL);
+  out_lens = (*env)->GetIntArrayElements(env, output_lens, NULL);
+  if (!in_offs || !in_lens || !out_offs || !out_lens) {
+    // An OutOfMemoryError is pending
+    goto done;
+  }
+
+  for (i = 0; i < count; i++) {
+    elem = (*env)->GetObjectArrayElement(env, keys, i);
+    key_len = (*env)->GetArrayLength(env, elem);
+    if (key_len != KEY_LENGTH_128 && key_len != KEY_LENGTH_256) {
+      THROW(env, "java/lang/IllegalArgumentException", "Invalid key length.");
+      goto done;
+    }
+    (*env)->GetByteArrayRegion(env, elem, 0, key_len, (jbyte *)key);
+    (*env)->DeleteLocalRef(env, elem);
+    elem = (*env)->GetObjectArrayElement(env, ivs, i);
+    iv_len = (*env)->GetArrayLength(env, elem);
+    if (iv_len != IV_LENGTH) {
+      THROW(env, "java/lang/IllegalArgumentException", "Invalid iv length.");
+      goto done;
+    }
+    (*env)->GetByteArrayRegion(env, elem, 0, iv_len, (jbyte *)iv);
+    (*env)->DeleteLocalRef(env, elem);
+
+    // Only a new key needs the key schedule to be computed again, a new iv
+    // just restarts the counter
+    if (key_len == last_key_len && memcmp(key, last_key, key_len) == 0) {
+      rc = dlsym_EVP_CipherInit_ex(context, NULL, NULL, NULL, iv,
+          mode == ENCRYPT_MODE);
+    } else {
+      rc = dlsym_EVP_CipherInit_ex(context, getEvpCipher(alg, key_len),
+          NULL, key, iv, mode == ENCRYPT_MODE);
+      if (rc && padding == NOPADDING) {
+        dlsym_EVP_CIPHER_CTX_set_padding(context, 0);
+      }
+      memcpy(last_key, key, key_len);
+      last_key_len = key_len;
+    }
+    if (rc == 0) {
+      dlsym_EVP_CIPHER_CTX_cleanup(context);
+      THROW(env, "java/lang/InternalError", "Error in EVP_CipherInit_ex.");
+      goto done;
+    }
+
+    if (!check_update_max_output_len(context, in_lens[i], out_lens[i])) {
+      THROW(env, "javax/crypto/ShortBufferException",  \
+          "Output buffer is not sufficient.");
+      goto done;
+    }
+    elem = (*env)->GetObjectArrayElement(env, inputs, i);
+    input_bytes = (*env)->GetDirectBufferAddress(env, elem);
+    (*env)->DeleteLocalRef(env, elem);
+    elem = (*env)->GetObjectArrayElement(env, outputs, i);
+    output_bytes = (*env)->GetDirectBufferAddress(env, elem);
+    (*env)->DeleteLocalRef(env, elem);
+    if (input_bytes == NULL || output_bytes == NULL) {
+      THROW(env, "java/lang/InternalError", "Cannot get buffer address.");
+      goto done;
+    }
+
+    output_len = 0;
+    if (!dlsym_EVP_CipherUpdate(context, output_bytes + out_offs[i],  \
+        &output_len, input_bytes + in_offs[i], in_lens[i])) {
+      dlsym_EVP_CIPHER_CTX_cleanup(context);
+      THROW(env, "java/lang/InternalError", "Error in EVP_CipherUpdate.");
+      goto done;
+    }
+    out_lens[i] = output_len;
+  }
+
+done:
+  memset(key, 0, sizeof(key));
+  memset(last_key, 0, sizeof(last_key));
+  if (in_offs) {
+    (*env)->ReleaseIntArrayElements(env, input_offsets, in_offs, JNI_ABORT);
+  }
+  if (in_lens) {
+    (*env)->ReleaseIntArrayElements(env, input_lens, in_lens, JNI_ABORT);
+  }
+  if (out_offs) {
+    (*env)->ReleaseIntArrayElements(env, output_offsets, out_offs, JNI_ABORT);
+  }
+  if (out_lens) {
+    (*env)->ReleaseIntArrayElements(env, output_lens, out_lens, 0);
+  }
+  return JLONG(context);
+}
+
+/**
+ * updateVerified decrypts about this many bytes at a time, right after
+ * bulk_crc has checked them, while they are still in the L1 cache.
+ */
+#define VERIFY_STRIDE 12288
+
+static void throw_checksum_exception(JNIEnv *env, crc32_error_t *error,
+    jstring j_filename, jlong pos)
+{
+  char message[1024];
+  const char *filename = NULL;
+  jclass clazz;
+  jmethodID ctor;
+  jstring jstr_message;
+  jthrowable obj;
+
+  if (j_filename != NULL) {
+    filename = (*env)->GetStringUTFChars(env, j_filename, NULL);
+    if (filename == NULL) {
+      return; // OOME already thrown
+    }
+  }
+  snprintf(message, sizeof(message),
+      "Checksum error: %s at %lld exp: %d got: %d",
+      filename ? filename : "null", (long long)pos,
+      (int)error->expected_crc, (int)error->got_crc);
+  if (filename != NULL) {
+    (*env)->ReleaseStringUTFChars(env, j_filename, filename);
+  }
+  jstr_message = (*env)->NewStringUTF(env, message);
+  if (jstr_message == NULL) {
+    return;
+  }
+  clazz = (*env)->FindClass(env, "org/apache/hadoop/fs/ChecksumException");
+  if (clazz == NULL) {
+    return;
+  }
+  ctor = (*env)->GetMethodID(env, clazz, "<init>", "(Ljava/lang/String;J)V");
+  if (ctor == NULL) {
+    return;
+  }
+  obj = (jthrowable)(*env)->NewObject(env, clazz, ctor, jstr_message, pos);
+  if (obj != NULL) {
+    (*env)->Throw(env, obj);
+  }
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_updateVerified
+    (JNIEnv *env, jobject object, jlong ctx, jobject input, jint input_offset,
+    jint input_len, jobject output, jint output_offset, jint max_output_len,
+    jint bytes_per_checksum, jint j_crc_type, jobject sums, jint sums_offset,
+    jstring j_filename, jlong base_pos)
+{
+  EVP_CIPHER_CTX *context = CONTEXT(ctx);
+  crc32_error_t error_data;
+  int crc_type, stride, done, n, len, output_len = 0;
+
+  switch (j_crc_type) {
+    case org_apache_hadoop_util_NativeCrc32_CHECKSUM_CRC32:
+      crc_type = CRC32_ZLIB_POLYNOMIAL;
+      break;
+    case org_apache_hadoop_util_NativeCrc32_CHECKSUM_CRC32C:
+      crc_type = CRC32C_POLYNOMIAL;
+      break;
+    default:
+      THROW(env, "java/lang/IllegalArgumentException",
+          "Invalid checksum type");
+      return 0;
+  }
+  if (bytes_per_checksum <= 0) {
+    THROW(env, "java/lang/IllegalArgumentException",
+        "invalid bytes_per_checksum");
+    return 0;
+  }
+  if (!check_update_max_output_len(context, input_len, max_output_len)) {
+    THROW(env, "javax/crypto/ShortBufferException",  \
+        "Output buffer is not sufficient.");
+    return 0;
+  }
+  unsigned char *input_bytes = (*env)->GetDirectBufferAddress(env, input);
+  unsigned char *output_bytes = (*env)->GetDirectBufferAddress(env, output);
+  unsigned char *sums_bytes = (*env)->GetDirectBufferAddress(env, sums);
+  if (input_bytes == NULL || output_bytes == NULL || sums_bytes == NULL) {
+    THROW(env, "java/lang/InternalError", "Cannot get buffer address.");
+    return 0;
+  }
+  input_bytes = input_bytes + input_offset;
+  output_bytes = output_bytes + output_offset;
+
+  // Whole triples of chunks, so that bulk_crc interleaves all of them
+  stride = (VERIFY_STRIDE / bytes_per_checksum) / 3 * 3;
+  if (stride < 3) {
+    stride = 3;
+  }
+  stride *= bytes_per_checksum;
+
+  for (done = 0; done < input_len; done += n) {
+    n = input_len - done < stride ? input_len - done : stride;
+    if (bulk_crc(input_bytes + done, n,
+        (uint32_t *)(sums_bytes + sums_offset) + done / bytes_per_checksum,
+        crc_type, bytes_per_checksum, &error_data) != CHECKSUMS_VALID) {
+      throw_checksum_exception(env, &error_data, j_filename,
+          base_pos + (error_data.bad_data - input_bytes));
+      return 0;
+    }
+    if (!dlsym_EVP_CipherUpdate(context, output_bytes + output_len, &len,  \
+        input_bytes + done, n)) {
+      dlsym_EVP_CIPHER_CTX_cleanup(context);
+      THROW(env, "java/lang/InternalError", "Error in EVP_CipherUpdate.");
+      return 0;
+    }
+    output_len += len;
+  }
+  return output_len;
+}
+
 // https://www.openssl.org/docs/crypto/EVP_EncryptInit.html
+JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_updateAAD
+    (JNIEnv *env, jobject object, jlong ctx, jbyteArray aad, jint offset,
+    jint len)
+{
+  EVP_CIPHER_CTX *context = CONTEXT(ctx);
+  jbyte *jAad = (*env)->GetByteArrayElements(env, aad, NULL);
+  if (jAad == NULL) {
+    THROW(env, "java/lang/InternalError", "Cannot get bytes array for aad.");
+    return;
+  }
+  // Without an output buffer EVP_CipherUpdate takes the data as AAD
+  int output_len = 0;
+  int rc = dlsym_EVP_CipherUpdate(context, NULL, &output_len,  \
+      (unsigned char *)jAad + offset, len);
+  (*env)->ReleaseByteArrayElements(env, aad, jAad, JNI_ABORT);
+  if (!rc) {
+    THROW(env, "java/lang/IllegalStateException",  \
+        "AAD must be supplied before the data.");
+  }
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_setTag
+    (JNIEnv *env, jobject object, jlong ctx, jbyteArray tag)
+{
+  EVP_CIPHER_CTX *context = CONTEXT(ctx);
+  jbyte *jTag = (*env)->GetByteArrayElements(env, tag, NULL);
+  if (jTag == NULL) {
+    THROW(env, "java/lang/InternalError", "Cannot get bytes array for tag.");
+    return;
+  }
+  int rc = dlsym_EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG,  \
+      GCM_TAG_LENGTH, jTag);
+  (*env)->ReleaseByteArrayElements(env, tag, jTag, JNI_ABORT);
+  if (!rc) {
+    THROW(env, "java/lang/InternalError", "Error in EVP_CIPHER_CTX_ctrl.");
+  }
+}
+
 static int check_doFinal_max_output_len(EVP_CIPHER_CTX *context, 
     int max_output_len)
 {
-  if (context->flags & EVP_CIPH_NO_PADDING) {
+  if (EVP_CIPHER_CTX_mode(context) == EVP_CIPH_GCM_MODE) {
+    // The tag is written after the data when encrypting
+    return !context->encrypt || max_output_len >= GCM_TAG_LENGTH;
+  } else if (context->flags & EVP_CIPH_NO_PADDING) {
     return 1;
   } else {
     int b = context->cipher->block_size;
@@ -338,10 +693,24 @@ JNIEXPORT jint JNICALL Java_org_apache_hadoop_crypto_OpensslCipher_doFinal
   
   int output_len = 0;
   if (!dlsym_EVP_CipherFinal_ex(context, output_bytes, &output_len)) {
+    if (EVP_CIPHER_CTX_mode(context) == EVP_CIPH_GCM_MODE) {
+      // The tag set by setTag does not match the data
+      THROW(env, "javax/crypto/AEADBadTagException", "Tag mismatch!");
+      return 0;
+    }
     dlsym_EVP_CIPHER_CTX_cleanup(context);
     THROW(env, "java/lang/InternalError", "Error in EVP_CipherFinal_ex.");
     return 0;
   }
+  if (EVP_CIPHER_CTX_mode(context) == EVP_CIPH_GCM_MODE &&  \
+      context->encrypt) {
+    if (!dlsym_EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG,  \
+        GCM_TAG_LENGTH, output_bytes + output_len)) {
+      THROW(env, "java/lang/InternalError", "Error in EVP_CIPHER_CTX_ctrl.");
+      return 0;
+    }
+    output_len += GCM_TAG_LENGTH;
+  }
   return output_len;
 }
 
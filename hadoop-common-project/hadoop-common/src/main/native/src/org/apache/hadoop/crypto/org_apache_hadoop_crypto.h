@@ -49,12 +49,15 @@
 #define KEY_LENGTH_128 16
 #define KEY_LENGTH_256 32
 #define IV_LENGTH 16
+#define GCM_IV_LENGTH 12
+#define GCM_TAG_LENGTH 16
 
 #define ENCRYPT_MODE 1
 #define DECRYPT_MODE 0
 
-/** Currently only support AES/CTR/NoPadding. */
+/** Currently only support AES/CTR/NoPadding and AES/GCM/NoPadding. */
 #define AES_CTR 0
+#define AES_GCM 1
 #define NOPADDING 0
 #define PKCSPADDING 1
 
@@ -24,6 +24,7 @@
 
 #ifdef UNIX
 #include <pthread.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -89,6 +90,8 @@ static __dlsym_ERR_get_error dlsym_ERR_get_error;
 static ENGINE * openssl_rand_init(void);
 static void openssl_rand_clean(ENGINE *eng, int clean_locks);
 static int openssl_rand_bytes(unsigned char *buf, int num);
+static int thread_rand_init(void);
+static int thread_rand_bytes(unsigned char *buf, int num);
 
 JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRandom_initSR
     (JNIEnv *env, jclass clazz)
@@ -162,10 +165,14 @@ JNIEXPORT void JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRandom_
 #endif
 
   openssl_rand_init();
+  if (!thread_rand_init()) {
+    THROW(env, "java/lang/InternalError",
+        "Cannot set up the per-thread generator.");
+  }
 }
 
-JNIEXPORT jboolean JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRandom_nextRandBytes___3B
-    (JNIEnv *env, jobject object, jbyteArray bytes)
+static jboolean fill_bytes(JNIEnv *env, jbyteArray bytes,
+    int (*rand_bytes)(unsigned char *, int))
 {
   if (NULL == bytes) {
     THROW(env, "java/lang/NullPointerException", "Buffer cannot be null.");
@@ -177,7 +184,7 @@ JNIEXPORT jboolean JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRan
     return JNI_FALSE;
   }
   int b_len = (*env)->GetArrayLength(env, bytes);
-  int ret = openssl_rand_bytes((unsigned char *)b, b_len);
+  int ret = rand_bytes((unsigned char *)b, b_len);
   (*env)->ReleaseByteArrayElements(env, bytes, b, 0);
   
   if (1 != ret) {
@@ -186,6 +193,18 @@ JNIEXPORT jboolean JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRan
   return JNI_TRUE;
 }
 
+JNIEXPORT jboolean JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRandom_nextRandBytes___3B
+    (JNIEnv *env, jobject object, jbyteArray bytes)
+{
+  return fill_bytes(env, bytes, openssl_rand_bytes);
+}
+
+JNIEXPORT jboolean JNICALL Java_org_apache_hadoop_crypto_random_OpensslSecureRandom_nextThreadRandBytes
+    (JNIEnv *env, jobject object, jbyteArray bytes)
+{
+  return fill_bytes(env, bytes, thread_rand_bytes);
+}
+
 /**
  * To ensure thread safety for random number generators, we need to call 
  * CRYPTO_set_locking_callback.
@@ -351,3 +370,184 @@ static int openssl_rand_bytes(unsigned char *buf, int num)
 {
   return dlsym_RAND_bytes(buf, num);
 }
+
+/**
+ * The per-thread generator. Each thread has its own ChaCha20 keystream,
+ * keyed from RAND_bytes, so that threads only take the OpenSSL locks to
+ * reseed. After every refill of its buffer the key is replaced with the
+ * first bytes of the new keystream, and bytes handed out are wiped, so the
+ * state of a thread never reveals what it generated before ("fast key
+ * erasure", as arc4random does it).
+ */
+
+#ifdef UNIX
+// Keystream generated per refill, of which the first 32 bytes are the next
+// key
+#define THREAD_RAND_BUF_LEN (64 * 12)
+// Take fresh seed from RAND_bytes after generating this many bytes
+#define THREAD_RAND_RESEED_BYTES (1024 * 1024)
+
+struct thread_rand {
+  uint32_t key[8];
+  unsigned char buf[THREAD_RAND_BUF_LEN];
+  // The unused bytes at the end of buf
+  int avail;
+  // Bytes generated since the last reseed
+  long generated;
+  // The value of thread_rand_forks when the state was last seeded
+  unsigned long forks;
+};
+
+static pthread_key_t thread_rand_key;
+// Bumped in a child after fork, which must not repeat the parent's output
+static volatile unsigned long thread_rand_forks = 0;
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QUARTERROUND(a, b, c, d) \
+  a += b; d ^= a; d = ROTL32(d, 16); \
+  c += d; b ^= c; b = ROTL32(b, 12); \
+  a += b; d ^= a; d = ROTL32(d, 8); \
+  c += d; b ^= c; b = ROTL32(b, 7);
+
+/**
+ * Write one 64 byte block of the ChaCha20 keystream of the key, with a
+ * zero nonce.
+ */
+static void chacha20_block(const uint32_t *key, uint32_t counter,
+    unsigned char *out)
+{
+  uint32_t in[16], x[16];
+  int i;
+
+  in[0] = 0x61707865;
+  in[1] = 0x3320646e;
+  in[2] = 0x79622d32;
+  in[3] = 0x6b206574;
+  memcpy(in + 4, key, 32);
+  in[12] = counter;
+  in[13] = in[14] = in[15] = 0;
+  memcpy(x, in, sizeof(x));
+  for (i = 0; i < 10; i++) {
+    QUARTERROUND(x[0], x[4], x[8], x[12]);
+    QUARTERROUND(x[1], x[5], x[9], x[13]);
+    QUARTERROUND(x[2], x[6], x[10], x[14]);
+    QUARTERROUND(x[3], x[7], x[11], x[15]);
+    QUARTERROUND(x[0], x[5], x[10], x[15]);
+    QUARTERROUND(x[1], x[6], x[11], x[12]);
+    QUARTERROUND(x[2], x[7], x[8], x[13]);
+    QUARTERROUND(x[3], x[4], x[9], x[14]);
+  }
+  for (i = 0; i < 16; i++) {
+    x[i] += in[i];
+    out[4 * i] = (unsigned char)x[i];
+    out[4 * i + 1] = (unsigned char)(x[i] >> 8);
+    out[4 * i + 2] = (unsigned char)(x[i] >> 16);
+    out[4 * i + 3] = (unsigned char)(x[i] >> 24);
+  }
+}
+
+static void thread_rand_refill(struct thread_rand *state)
+{
+  int i;
+
+  for (i = 0; i < THREAD_RAND_BUF_LEN / 64; i++) {
+    chacha20_block(state->key, i, state->buf + 64 * i);
+  }
+  memcpy(state->key, state->buf, sizeof(state->key));
+  memset(state->buf, 0, sizeof(state->key));
+  state->avail = THREAD_RAND_BUF_LEN - sizeof(state->key);
+}
+
+/**
+ * Mix fresh seed from RAND_bytes into the key. Returns 0 if there is none.
+ */
+static int thread_rand_reseed(struct thread_rand *state)
+{
+  uint32_t seed[8];
+  int i;
+
+  if (1 != dlsym_RAND_bytes((unsigned char *)seed, sizeof(seed))) {
+    return 0;
+  }
+  for (i = 0; i < 8; i++) {
+    state->key[i] ^= seed[i];
+  }
+  memset(seed, 0, sizeof(seed));
+  state->generated = 0;
+  state->forks = thread_rand_forks;
+  // Nothing generated before the reseed may be handed out after it
+  thread_rand_refill(state);
+  return 1;
+}
+
+static void thread_rand_free(void *arg)
+{
+  memset(arg, 0, sizeof(struct thread_rand));
+  free(arg);
+}
+
+static void thread_rand_atfork_child(void)
+{
+  thread_rand_forks++;
+}
+
+static int thread_rand_init(void)
+{
+  if (pthread_key_create(&thread_rand_key, thread_rand_free)) {
+    return 0;
+  }
+  return 0 == pthread_atfork(NULL, NULL, thread_rand_atfork_child);
+}
+
+static int thread_rand_bytes(unsigned char *buf, int num)
+{
+  struct thread_rand *state = pthread_getspecific(thread_rand_key);
+  unsigned char *p;
+  int n;
+
+  if (NULL == state) {
+    state = calloc(1, sizeof(*state));
+    if (NULL == state) {
+      return 0;
+    }
+    if (!thread_rand_reseed(state) ||
+        pthread_setspecific(thread_rand_key, state)) {
+      thread_rand_free(state);
+      return 0;
+    }
+  } else if (state->forks != thread_rand_forks ||
+      state->generated >= THREAD_RAND_RESEED_BYTES) {
+    if (!thread_rand_reseed(state)) {
+      return 0;
+    }
+  }
+  state->generated += num;
+  while (num > 0) {
+    if (0 == state->avail) {
+      thread_rand_refill(state);
+    }
+    n = num < state->avail ? num : state->avail;
+    p = state->buf + THREAD_RAND_BUF_LEN - state->avail;
+    memcpy(buf, p, n);
+    memset(p, 0, n);
+    buf += n;
+    num -= n;
+    state->avail -= n;
+  }
+  return 1;
+}
+#endif /* UNIX */
+
+#ifdef WINDOWS
+// There is no per-thread generator on Windows, it is the shared one
+
+static int thread_rand_init(void)
+{
+  return 1;
+}
+
+static int thread_rand_bytes(unsigned char *buf, int num)
+{
+  return openssl_rand_bytes(buf, num);
+}
+#endif /* WINDOWS */
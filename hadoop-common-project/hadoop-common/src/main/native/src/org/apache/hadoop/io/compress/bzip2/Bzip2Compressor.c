@@ -24,6 +24,8 @@
 
 #include "org_apache_hadoop_io_compress_bzip2.h"
 #include "org_apache_hadoop_io_compress_bzip2_Bzip2Compressor.h"
+#include "org/apache/hadoop/io/compress/parallel_compress.h"
+#include "org/apache/hadoop/util/native_memory.h"
 
 static jfieldID Bzip2Compressor_stream;
 static jfieldID Bzip2Compressor_uncompressedDirectBuf;
@@ -33,10 +35,17 @@ static jfieldID Bzip2Compressor_compressedDirectBuf;
 static jfieldID Bzip2Compressor_directBufferSize;
 static jfieldID Bzip2Compressor_finish;
 static jfieldID Bzip2Compressor_finished;
+static jfieldID Bzip2Compressor_frameDirectBuf;
+static jfieldID Bzip2Compressor_pendingBits;
+static jfieldID Bzip2Compressor_pendingBitCount;
+static jfieldID Bzip2Compressor_combinedCRC;
+static jfieldID Bzip2Compressor_headerWritten;
 
 static int (*dlsym_BZ2_bzCompressInit)(bz_stream*, int, int, int);
 static int (*dlsym_BZ2_bzCompress)(bz_stream*, int);
 static int (*dlsym_BZ2_bzCompressEnd)(bz_stream*);
+static int (*dlsym_BZ2_bzBuffToBuffCompress)(char*, unsigned int*, char*,
+                                             unsigned int, int, int, int);
 
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_initIDs(
@@ -71,6 +80,8 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_initIDs(
                         "BZ2_bzCompress");
     LOAD_DYNAMIC_SYMBOL(dlsym_BZ2_bzCompressEnd, env, libbz2,
                         "BZ2_bzCompressEnd");
+    LOAD_DYNAMIC_SYMBOL(dlsym_BZ2_bzBuffToBuffCompress, env, libbz2,
+                        "BZ2_bzBuffToBuffCompress");
 
     // Initialize the requisite fieldIds.
     Bzip2Compressor_stream = (*env)->GetFieldID(env, class, "stream", "J");
@@ -90,6 +101,17 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_initIDs(
                                                      "Ljava/nio/Buffer;");
     Bzip2Compressor_directBufferSize = (*env)->GetFieldID(env, class, 
                                                   "directBufferSize", "I");
+    Bzip2Compressor_frameDirectBuf = (*env)->GetFieldID(env, class,
+                                                     "frameDirectBuf",
+                                                     "Ljava/nio/Buffer;");
+    Bzip2Compressor_pendingBits = (*env)->GetFieldID(env, class,
+                                                  "pendingBits", "I");
+    Bzip2Compressor_pendingBitCount = (*env)->GetFieldID(env, class,
+                                                  "pendingBitCount", "I");
+    Bzip2Compressor_combinedCRC = (*env)->GetFieldID(env, class,
+                                                  "combinedCRC", "I");
+    Bzip2Compressor_headerWritten = (*env)->GetFieldID(env, class,
+                                                  "headerWritten", "Z");
  cleanup:
     if(java_lib_name != NULL) {
         (*env)->ReleaseStringUTFChars(env,libname,java_lib_name);
@@ -102,18 +124,21 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_init(
             JNIEnv *env, jclass class, jint blockSize, jint workFactor)
 {
     // Create a bz_stream.
-    bz_stream *stream = malloc(sizeof(bz_stream));
+    bz_stream *stream = native_memory_malloc(NATIVE_MEMORY_CODEC,
+                                             sizeof(bz_stream));
     if (!stream) {
         THROW(env, "java/lang/OutOfMemoryError", NULL);
         return (jlong)0;
     }
     memset((void*)stream, 0, sizeof(bz_stream));
+    stream->bzalloc = native_memory_bzalloc;
+    stream->bzfree = native_memory_bzfree;
 
     // Initialize stream.
     int rv = (*dlsym_BZ2_bzCompressInit)(stream, blockSize, 0, workFactor);
     if (rv != BZ_OK) {
         // Contingency - Report error by throwing appropriate exceptions.
-        free(stream);
+        native_memory_free(NATIVE_MEMORY_CODEC, stream);
         stream = NULL;
         
         switch (rv) {
@@ -220,6 +245,235 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_deflateBytesDirect(
     return no_compressed_bytes;
 }
 
+/*
+ * Frames are compressed by libbz2 as streams of their own, each small enough
+ * to fit in a single block.  The blocks are then spliced into one stream:
+ * they are not byte aligned, so they are copied bit by bit past the header
+ * and the end of stream marker of their streams, and the combined CRC is
+ * computed from the block CRCs the way libbz2 does.
+ */
+
+#define BZ_BLOCK_MAGIC 0x314159265359ULL
+#define BZ_EOS_MAGIC 0x177245385090ULL
+// "BZh" and the block size
+#define BZ_HEADER_BYTES 4
+// The end of stream marker and the combined CRC
+#define BZ_TRAILER_BITS 80
+
+typedef struct {
+  int block_size;
+  int work_factor;
+} bz_frame_settings;
+
+typedef struct {
+  unsigned char *out;
+  int len;
+  // The bits not written out yet, fewer than 8
+  unsigned int bits;
+  int count;
+} bz_bit_writer;
+
+static int bzip2_compress_frame(const void *arg, const char *in, int in_len,
+                                char *out, int out_capacity)
+{
+  const bz_frame_settings *settings = arg;
+  unsigned int out_len = out_capacity;
+
+  if (dlsym_BZ2_bzBuffToBuffCompress(out, &out_len, (char *)in, in_len,
+                                     settings->block_size, 0,
+                                     settings->work_factor) != BZ_OK) {
+    return -1;
+  }
+  return (int)out_len;
+}
+
+static void put_bits(bz_bit_writer *w, int n, unsigned int v)
+{
+  w->bits = (w->bits << n) | v;
+  w->count += n;
+  while (w->count >= 8) {
+    w->count -= 8;
+    w->out[w->len++] = (unsigned char)(w->bits >> w->count);
+  }
+  w->bits &= (1U << w->count) - 1;
+}
+
+static unsigned long long get_bits(const unsigned char *in, long long pos,
+                                   int n)
+{
+  unsigned long long v = 0;
+  int i;
+
+  for (i = 0; i < n; i++, pos++) {
+    v = (v << 1) | ((in[pos >> 3] >> (7 - (pos & 7))) & 1);
+  }
+  return v;
+}
+
+/**
+ * Append the block of a single block stream, and fold its CRC into the
+ * combined one.  Returns 0, or -1 if the stream is not a single block.
+ */
+static int splice_frame(bz_bit_writer *w, const unsigned char *frame,
+                        int frame_len, unsigned int *combined_crc)
+{
+  long long bits = (long long)frame_len * 8, eos = -1, block_bits, i;
+  unsigned int block_crc;
+  int pad;
+
+  for (pad = 0; pad < 8; pad++) {
+    i = bits - pad - BZ_TRAILER_BITS;
+    if (i >= 8 * BZ_HEADER_BYTES && get_bits(frame, i, 48) == BZ_EOS_MAGIC &&
+        get_bits(frame, bits - pad, pad) == 0) {
+      eos = i;
+      break;
+    }
+  }
+  if (eos < 0 || eos - 8 * BZ_HEADER_BYTES < 80 ||
+      get_bits(frame, 8 * BZ_HEADER_BYTES, 48) != BZ_BLOCK_MAGIC) {
+    return -1;
+  }
+  // With one block the combined CRC of the stream is that of the block
+  block_crc = (unsigned int)get_bits(frame, 8 * BZ_HEADER_BYTES + 48, 32);
+  if (get_bits(frame, eos + 48, 32) != block_crc) {
+    return -1;
+  }
+  *combined_crc = ((*combined_crc << 1) | (*combined_crc >> 31)) ^ block_crc;
+
+  block_bits = eos - 8 * BZ_HEADER_BYTES;
+  frame += BZ_HEADER_BYTES;
+  if (w->count == 0) {
+    memcpy(w->out + w->len, frame, block_bits >> 3);
+    w->len += block_bits >> 3;
+  } else {
+    for (i = 0; i < block_bits >> 3; i++) {
+      put_bits(w, 8, frame[i]);
+    }
+  }
+  if (block_bits & 7) {
+    put_bits(w, block_bits & 7,
+             frame[block_bits >> 3] >> (8 - (block_bits & 7)));
+  }
+  return 0;
+}
+
+JNIEXPORT jint JNICALL
+Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_compressFramesDirect(
+        JNIEnv *env, jobject this, jint blockSize, jint workFactor,
+        jint frameSize, jint threads, jboolean last)
+{
+    bz_frame_settings settings;
+    bz_bit_writer writer;
+    unsigned int combined_crc;
+    int num_frames = 0, i, *frame_lens = NULL, frame_off = 0;
+    jlong frame_capacity, compressed_capacity;
+
+    jobject uncompressed_direct_buf = (*env)->GetObjectField(env, this,
+                                     Bzip2Compressor_uncompressedDirectBuf);
+    jint uncompressed_direct_buf_len = (*env)->GetIntField(env, this,
+                                   Bzip2Compressor_uncompressedDirectBufLen);
+    jobject compressed_direct_buf = (*env)->GetObjectField(env, this,
+                                   Bzip2Compressor_compressedDirectBuf);
+    jobject frame_direct_buf = (*env)->GetObjectField(env, this,
+                                   Bzip2Compressor_frameDirectBuf);
+
+    char* uncompressed_bytes = (*env)->GetDirectBufferAddress(env,
+                                                uncompressed_direct_buf);
+    unsigned char* compressed_bytes = (*env)->GetDirectBufferAddress(env,
+                                                compressed_direct_buf);
+    char* frame_bytes = (*env)->GetDirectBufferAddress(env,
+                                                frame_direct_buf);
+    if (!uncompressed_bytes || !compressed_bytes || !frame_bytes) {
+        return (jint)0;
+    }
+
+    frame_capacity = (*env)->GetDirectBufferCapacity(env, frame_direct_buf);
+    compressed_capacity = (*env)->GetDirectBufferCapacity(env,
+                                                compressed_direct_buf);
+    if (uncompressed_direct_buf_len > 0) {
+        num_frames = (int)(((jlong)uncompressed_direct_buf_len +
+                            frameSize - 1) / frameSize);
+    }
+    // Every frame gets an equal share of the frame buffer to compress into,
+    // and the spliced stream is never longer than the frames
+    if (frameSize <= 0 ||
+        (num_frames > 0 && frame_capacity / num_frames <
+            frameSize + frameSize / 100 + 600) ||
+        compressed_capacity < frame_capacity + 16) {
+        THROW(env, "java/lang/IllegalArgumentException",
+              "Invalid bzip2 frame layout");
+        return (jint)0;
+    }
+
+    if (num_frames > 0) {
+        frame_lens = malloc(sizeof(int) * num_frames);
+        if (!frame_lens) {
+            THROW(env, "java/lang/OutOfMemoryError",
+                  "Cannot allocate bzip2 frame lengths");
+            return (jint)0;
+        }
+        settings.block_size = blockSize;
+        settings.work_factor = workFactor;
+        if (compress_frames(bzip2_compress_frame, &settings,
+                            uncompressed_bytes, uncompressed_direct_buf_len,
+                            frameSize, frame_bytes,
+                            (int)(frame_capacity / num_frames), threads,
+                            frame_lens) < 0) {
+            free(frame_lens);
+            THROW(env, "java/lang/InternalError",
+                  "BZ2_bzBuffToBuffCompress failed");
+            return (jint)0;
+        }
+    }
+
+    memset(&writer, 0, sizeof(writer));
+    writer.out = compressed_bytes;
+    writer.bits = (*env)->GetIntField(env, this, Bzip2Compressor_pendingBits);
+    writer.count = (*env)->GetIntField(env, this,
+                                       Bzip2Compressor_pendingBitCount);
+    combined_crc = (*env)->GetIntField(env, this,
+                                       Bzip2Compressor_combinedCRC);
+    if (!(*env)->GetBooleanField(env, this, Bzip2Compressor_headerWritten)) {
+        writer.out[writer.len++] = 'B';
+        writer.out[writer.len++] = 'Z';
+        writer.out[writer.len++] = 'h';
+        writer.out[writer.len++] = '0' + blockSize;
+        (*env)->SetBooleanField(env, this, Bzip2Compressor_headerWritten,
+                                JNI_TRUE);
+    }
+    for (i = 0; i < num_frames; i++) {
+        if (splice_frame(&writer, (unsigned char *)frame_bytes + frame_off,
+                         frame_lens[i], &combined_crc) < 0) {
+            free(frame_lens);
+            THROW(env, "java/lang/InternalError",
+                  "bzip2 frame is not a single block");
+            return (jint)0;
+        }
+        frame_off += frame_lens[i];
+    }
+    free(frame_lens);
+
+    if (last) {
+        put_bits(&writer, 24, (unsigned int)(BZ_EOS_MAGIC >> 24));
+        put_bits(&writer, 24, (unsigned int)(BZ_EOS_MAGIC & 0xffffff));
+        put_bits(&writer, 16, combined_crc >> 16);
+        put_bits(&writer, 16, combined_crc & 0xffff);
+        if (writer.count > 0) {
+            put_bits(&writer, 8 - writer.count, 0);
+        }
+        (*env)->SetBooleanField(env, this, Bzip2Compressor_finished,
+                                JNI_TRUE);
+    }
+    (*env)->SetIntField(env, this, Bzip2Compressor_pendingBits, writer.bits);
+    (*env)->SetIntField(env, this, Bzip2Compressor_pendingBitCount,
+                        writer.count);
+    (*env)->SetIntField(env, this, Bzip2Compressor_combinedCRC,
+                        (jint)combined_crc);
+    (*env)->SetIntField(env, this, Bzip2Compressor_uncompressedDirectBufLen,
+                        0);
+    return writer.len;
+}
+
 JNIEXPORT jlong JNICALL
 Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_getBytesRead(
                             JNIEnv *env, jclass class, jlong stream)
@@ -244,7 +498,7 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Compressor_end(
         THROW(env, "java/lang/InternalError", NULL);
     }
 
-    free(BZSTREAM(stream));
+    native_memory_free(NATIVE_MEMORY_CODEC, BZSTREAM(stream));
 
 }
 
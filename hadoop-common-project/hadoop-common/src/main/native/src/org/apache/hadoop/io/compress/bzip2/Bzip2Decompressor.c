@@ -17,6 +17,8 @@
  */
 
 #include <config.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,6 +26,8 @@
 
 #include "org_apache_hadoop_io_compress_bzip2.h"
 #include "org_apache_hadoop_io_compress_bzip2_Bzip2Decompressor.h"
+#include "org/apache/hadoop/util/native_memory.h"
+#include "org/apache/hadoop/util/worker_pool.h"
 
 static jfieldID Bzip2Decompressor_stream;
 static jfieldID Bzip2Decompressor_compressedDirectBuf;
@@ -98,18 +102,21 @@ JNIEXPORT jlong JNICALL
 Java_org_apache_hadoop_io_compress_bzip2_Bzip2Decompressor_init(
                                 JNIEnv *env, jclass cls, jint conserveMemory)
 {
-    bz_stream *stream = malloc(sizeof(bz_stream));
+    bz_stream *stream = native_memory_malloc(NATIVE_MEMORY_CODEC,
+                                             sizeof(bz_stream));
     if (stream == 0) {
         THROW(env, "java/lang/OutOfMemoryError", NULL);
         return (jlong)0;
     } 
     memset((void*)stream, 0, sizeof(bz_stream));
+    stream->bzalloc = native_memory_bzalloc;
+    stream->bzfree = native_memory_bzfree;
     
     int rv = dlsym_BZ2_bzDecompressInit(stream, 0, conserveMemory);
 
     if (rv != BZ_OK) {
         // Contingency - Report error by throwing appropriate exceptions.
-        free(stream);
+        native_memory_free(NATIVE_MEMORY_CODEC, stream);
         stream = NULL;
 
         switch (rv) {
@@ -216,6 +223,432 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Decompressor_inflateBytesDirect(
     return no_decompressed_bytes;
 }
 
+/*
+ * bzip2 blocks start with the 48 bit magic of pi and the end of stream with
+ * that of sqrt(pi), at any bit offset.  A block can be decompressed on its
+ * own by libbz2 when it is wrapped in a stream of its own: a header, the
+ * block, and an end of stream whose combined crc is that of the block.
+ */
+#define BZ2_BLOCK_MAGIC 0x314159265359ULL
+#define BZ2_EOS_MAGIC 0x177245385090ULL
+#define BZ2_MAGIC_MASK 0xffffffffffffULL
+
+#define BZ2_SCAN_CHUNK (4 * 1024 * 1024)
+#define BZ2_OUT_MIN (1024 * 1024)
+
+/* A spot where a block or the end of a stream starts. */
+typedef struct {
+    uint64_t bit;
+    int eos;
+} bz2_mark;
+
+typedef struct {
+    bz2_mark *marks;
+    int len;
+    int capacity;
+} bz2_marks;
+
+/* The input, the spots found in each chunk of it, and the blocks. */
+typedef struct {
+    const unsigned char *in;
+    size_t in_len;
+    bz2_marks *chunk_marks;
+    struct bz2_block *blocks;
+} bz2_job;
+
+typedef struct bz2_block {
+    uint64_t bit;
+    uint64_t bits;
+    uint32_t crc;
+    char *out;
+    size_t out_len;
+    int rv;
+} bz2_block;
+
+static uint32_t get_bits(const unsigned char *in, uint64_t bit, int n) {
+    uint32_t v = 0;
+    int i;
+    for (i = 0; i < n; i++, bit++) {
+        v = (v << 1) | ((in[bit >> 3] >> (7 - (bit & 7))) & 1);
+    }
+    return v;
+}
+
+static void put_bits(unsigned char *out, uint64_t *bit, uint64_t v, int n) {
+    int i;
+    for (i = n - 1; i >= 0; i--, (*bit)++) {
+        if (v >> i & 1) {
+            out[*bit >> 3] |= 0x80 >> (*bit & 7);
+        } else {
+            out[*bit >> 3] &= ~(0x80 >> (*bit & 7));
+        }
+    }
+}
+
+static int add_mark(bz2_marks *marks, uint64_t bit, int eos) {
+    bz2_mark *grown;
+    if (marks->len == marks->capacity) {
+        marks->capacity = marks->capacity ? marks->capacity * 2 : 64;
+        grown = realloc(marks->marks, sizeof(bz2_mark) * marks->capacity);
+        if (!grown) {
+            return 0;
+        }
+        marks->marks = grown;
+    }
+    marks->marks[marks->len].bit = bit;
+    marks->marks[marks->len].eos = eos;
+    marks->len++;
+    return 1;
+}
+
+/**
+ * Find the magics that start in one chunk of the input.  On failure the
+ * marks of the chunk are left with a negative length.
+ */
+static void scan_chunk(void *arg, int chunk) {
+    bz2_job *job = arg;
+    bz2_marks *marks = &job->chunk_marks[chunk];
+    size_t start = (size_t)chunk * BZ2_SCAN_CHUNK;
+    size_t end = start + BZ2_SCAN_CHUNK;
+    size_t i, scan_end;
+    uint64_t reg = 0, v, first;
+    int k;
+
+    if (end > job->in_len) {
+        end = job->in_len;
+    }
+    // A magic that starts in the chunk ends in at most 6 more bytes
+    scan_end = end + 6 < job->in_len ? end + 6 : job->in_len;
+    for (i = start; i < scan_end; i++) {
+        reg = (reg << 8) | job->in[i];
+        if (i < start + 5) {
+            continue;
+        }
+        for (k = 7; k >= 0; k--) {
+            if (i == start + 5 && k > 0) {
+                continue;
+            }
+            v = (reg >> k) & BZ2_MAGIC_MASK;
+            if (v != BZ2_BLOCK_MAGIC && v != BZ2_EOS_MAGIC) {
+                continue;
+            }
+            first = (uint64_t)(i + 1) * 8 - k - 48;
+            if (first < (uint64_t)start * 8 || first >= (uint64_t)end * 8) {
+                continue;
+            }
+            if (!add_mark(marks, first, v == BZ2_EOS_MAGIC)) {
+                marks->len = -1;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Decompress one block, wrapped in a stream of its own, into a buffer that
+ * is grown as needed.  Leaves the libbz2 result in block->rv.
+ */
+static void decompress_block(void *arg, int task) {
+    bz2_job *job = arg;
+    bz2_block *block = &job->blocks[task];
+    size_t nbytes = (size_t)((block->bits + 7) >> 3);
+    size_t capacity = BZ2_OUT_MIN, i;
+    const unsigned char *p = job->in + (block->bit >> 3);
+    const unsigned char *in_end = job->in + job->in_len;
+    int shift = block->bit & 7;
+    unsigned char *wrapped;
+    uint64_t bit;
+    bz_stream stream;
+    char *out;
+    int rv;
+
+    block->out = NULL;
+    block->out_len = 0;
+    // The header, the block, the end of stream magic, crc and padding
+    wrapped = malloc(4 + nbytes + 11);
+    if (!wrapped) {
+        block->rv = BZ_MEM_ERROR;
+        return;
+    }
+    // The level only bounds the block size, 9 takes them all
+    memcpy(wrapped, "BZh9", 4);
+    for (i = 0; i < nbytes; i++) {
+        wrapped[4 + i] = (p[i] << shift) |
+            (shift && p + i + 1 < in_end ? p[i + 1] >> (8 - shift) : 0);
+    }
+    bit = 32 + block->bits;
+    put_bits(wrapped, &bit, BZ2_EOS_MAGIC, 48);
+    put_bits(wrapped, &bit, block->crc, 32);
+    put_bits(wrapped, &bit, 0, (8 - (bit & 7)) & 7);
+
+    memset(&stream, 0, sizeof(stream));
+    stream.bzalloc = native_memory_bzalloc;
+    stream.bzfree = native_memory_bzfree;
+    rv = dlsym_BZ2_bzDecompressInit(&stream, 0, 0);
+    if (rv != BZ_OK) {
+        free(wrapped);
+        block->rv = rv;
+        return;
+    }
+    stream.next_in = (char *)wrapped;
+    stream.avail_in = (unsigned int)(bit >> 3);
+    for (;;) {
+        if (!block->out || block->out_len == capacity) {
+            if (block->out) {
+                capacity *= 2;
+            }
+            out = realloc(block->out, capacity);
+            if (!out) {
+                rv = BZ_MEM_ERROR;
+                break;
+            }
+            block->out = out;
+        }
+        stream.next_out = block->out + block->out_len;
+        stream.avail_out = (unsigned int)(capacity - block->out_len);
+        rv = dlsym_BZ2_bzDecompress(&stream);
+        block->out_len = stream.next_out - block->out;
+        if (rv != BZ_OK) {
+            break;
+        }
+        if (stream.avail_out > 0) {
+            // All the input went in, and the stream did not end
+            rv = BZ_UNEXPECTED_EOF;
+            break;
+        }
+    }
+    dlsym_BZ2_bzDecompressEnd(&stream);
+    free(wrapped);
+    block->rv = rv;
+    if (rv != BZ_STREAM_END) {
+        free(block->out);
+        block->out = NULL;
+    }
+}
+
+/**
+ * Check that the marks make up whole streams, each a header, blocks and an
+ * end of stream, and that the combined crc of every stream matches that of
+ * its blocks.  Fills in the blocks and returns how many there are, or -1.
+ */
+static int plan_blocks(const unsigned char *in, size_t in_len,
+                       const bz2_mark *marks, int num_marks,
+                       bz2_block *blocks) {
+    uint64_t bit = 0, in_bits = (uint64_t)in_len * 8;
+    uint32_t combined = 0;
+    int i = 0, num_blocks = 0;
+
+    while (bit < in_bits) {
+        // A stream header, at a byte boundary
+        if (in_bits - bit < 32 + 80 || memcmp(in + (bit >> 3), "BZh", 3) ||
+            in[(bit >> 3) + 3] < '1' || in[(bit >> 3) + 3] > '9') {
+            return -1;
+        }
+        bit += 32;
+        combined = 0;
+        for (;;) {
+            if (i == num_marks || marks[i].bit != bit) {
+                return -1;
+            }
+            if (marks[i].eos) {
+                break;
+            }
+            if (i + 1 == num_marks || marks[i + 1].bit - bit < 80) {
+                return -1;
+            }
+            blocks[num_blocks].bit = bit;
+            blocks[num_blocks].bits = marks[i + 1].bit - bit;
+            blocks[num_blocks].crc = get_bits(in, bit + 48, 32);
+            blocks[num_blocks].out = NULL;
+            combined = ((combined << 1) | (combined >> 31)) ^
+                blocks[num_blocks].crc;
+            num_blocks++;
+            bit = marks[++i].bit;
+        }
+        if (in_bits - bit < 80 || get_bits(in, bit + 48, 32) != combined) {
+            return -1;
+        }
+        bit = (bit + 80 + 7) & ~(uint64_t)7;
+        i++;
+    }
+    return i == num_marks ? num_blocks : -1;
+}
+
+/**
+ * Decompress all the streams in the input one after the other, when the
+ * blocks could not be told apart.
+ */
+static int decompress_serial(const unsigned char *in, size_t in_len,
+                             bz2_block *whole) {
+    size_t capacity = BZ2_OUT_MIN;
+    bz_stream stream;
+    char *out;
+    int rv = BZ_OK;
+
+    whole->out = NULL;
+    whole->out_len = 0;
+    while (in_len > 0) {
+        memset(&stream, 0, sizeof(stream));
+        rv = dlsym_BZ2_bzDecompressInit(&stream, 0, 0);
+        if (rv != BZ_OK) {
+            return rv;
+        }
+        stream.next_in = (char *)in;
+        stream.avail_in = (unsigned int)in_len;
+        for (;;) {
+            if (!whole->out || whole->out_len == capacity) {
+                if (whole->out) {
+                    capacity *= 2;
+                }
+                out = realloc(whole->out, capacity);
+                if (!out) {
+                    rv = BZ_MEM_ERROR;
+                    break;
+                }
+                whole->out = out;
+            }
+            stream.next_out = whole->out + whole->out_len;
+            stream.avail_out = capacity - whole->out_len > UINT_MAX ?
+                UINT_MAX : (unsigned int)(capacity - whole->out_len);
+            rv = dlsym_BZ2_bzDecompress(&stream);
+            whole->out_len = stream.next_out - whole->out;
+            if (rv != BZ_OK) {
+                break;
+            }
+            if (stream.avail_out > 0) {
+                rv = BZ_UNEXPECTED_EOF;
+                break;
+            }
+        }
+        in_len -= (const unsigned char *)stream.next_in - in;
+        in = (const unsigned char *)stream.next_in;
+        dlsym_BZ2_bzDecompressEnd(&stream);
+        if (rv != BZ_STREAM_END) {
+            return rv;
+        }
+    }
+    return BZ_STREAM_END;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_org_apache_hadoop_io_compress_bzip2_Bzip2Decompressor_decompressBlocks(
+                        JNIEnv *env, jclass cls, jobject src, jint off,
+                        jint len, jint threads)
+{
+    const unsigned char *in = (*env)->GetDirectBufferAddress(env, src);
+    int num_chunks = (int)(((jlong)len + BZ2_SCAN_CHUNK - 1) / BZ2_SCAN_CHUNK);
+    bz2_job job;
+    bz2_mark *marks = NULL;
+    bz2_block whole;
+    jbyteArray result = NULL;
+    jlong total = 0;
+    int i, num_marks = 0, num_blocks = -1, planned = 0, rv = BZ_STREAM_END;
+
+    if (!in) {
+        THROW(env, "java/lang/IllegalArgumentException",
+              "Not a direct buffer");
+        return NULL;
+    }
+    memset(&job, 0, sizeof(job));
+    memset(&whole, 0, sizeof(whole));
+    job.in = in + off;
+    job.in_len = len;
+
+    // Find the blocks
+    job.chunk_marks = calloc(num_chunks > 0 ? num_chunks : 1,
+                             sizeof(bz2_marks));
+    if (!job.chunk_marks) {
+        THROW(env, "java/lang/OutOfMemoryError", NULL);
+        goto cleanup;
+    }
+    run_tasks(scan_chunk, &job, num_chunks, threads);
+    for (i = 0; i < num_chunks; i++) {
+        if (job.chunk_marks[i].len < 0) {
+            THROW(env, "java/lang/OutOfMemoryError", NULL);
+            goto cleanup;
+        }
+        num_marks += job.chunk_marks[i].len;
+    }
+    marks = malloc(sizeof(bz2_mark) * (num_marks > 0 ? num_marks : 1));
+    job.blocks = malloc(sizeof(bz2_block) * (num_marks > 0 ? num_marks : 1));
+    if (!marks || !job.blocks) {
+        THROW(env, "java/lang/OutOfMemoryError", NULL);
+        goto cleanup;
+    }
+    num_marks = 0;
+    for (i = 0; i < num_chunks; i++) {
+        memcpy(marks + num_marks, job.chunk_marks[i].marks,
+               sizeof(bz2_mark) * job.chunk_marks[i].len);
+        num_marks += job.chunk_marks[i].len;
+    }
+
+    // Decompress them, or all in one go when some magic was a false one
+    num_blocks = plan_blocks(job.in, job.in_len, marks, num_marks,
+                             job.blocks);
+    if (num_blocks >= 0) {
+        planned = num_blocks;
+        run_tasks(decompress_block, &job, num_blocks, threads);
+        for (i = 0; i < num_blocks; i++) {
+            if (job.blocks[i].rv != BZ_STREAM_END) {
+                break;
+            }
+            total += job.blocks[i].out_len;
+        }
+        if (i < num_blocks) {
+            num_blocks = -1;
+            total = 0;
+        }
+    }
+    if (num_blocks < 0) {
+        rv = decompress_serial(job.in, job.in_len, &whole);
+        total = whole.out_len;
+    }
+    if (rv == BZ_MEM_ERROR) {
+        THROW(env, "java/lang/OutOfMemoryError", NULL);
+        goto cleanup;
+    } else if (rv != BZ_STREAM_END) {
+        THROW(env, "java/io/IOException", "Corrupt bzip2 data");
+        goto cleanup;
+    } else if (total > INT_MAX) {
+        THROW(env, "java/io/IOException",
+              "bzip2 data decompresses to more than 2 GB");
+        goto cleanup;
+    }
+
+    // Put the blocks together in order
+    result = (*env)->NewByteArray(env, (jsize)total);
+    if (!result) {
+        goto cleanup;
+    }
+    if (num_blocks < 0) {
+        (*env)->SetByteArrayRegion(env, result, 0, (jsize)whole.out_len,
+                                   (jbyte *)whole.out);
+    } else {
+        total = 0;
+        for (i = 0; i < num_blocks; i++) {
+            (*env)->SetByteArrayRegion(env, result, (jsize)total,
+                                       (jsize)job.blocks[i].out_len,
+                                       (jbyte *)job.blocks[i].out);
+            total += job.blocks[i].out_len;
+        }
+    }
+
+cleanup:
+    for (i = 0; i < planned; i++) {
+        free(job.blocks[i].out);
+    }
+    if (job.chunk_marks) {
+        for (i = 0; i < num_chunks; i++) {
+            free(job.chunk_marks[i].marks);
+        }
+    }
+    free(whole.out);
+    free(job.blocks);
+    free(job.chunk_marks);
+    free(marks);
+    return result;
+}
+
 JNIEXPORT jlong JNICALL
 Java_org_apache_hadoop_io_compress_bzip2_Bzip2Decompressor_getBytesRead(
                                 JNIEnv *env, jclass cls, jlong stream)
@@ -247,7 +680,7 @@ Java_org_apache_hadoop_io_compress_bzip2_Bzip2Decompressor_end(
         THROW(env, "java/lang/InternalError", 0);
     }
 
-    free(BZSTREAM(stream));
+    native_memory_free(NATIVE_MEMORY_CODEC, BZSTREAM(stream));
 
 }
 
@@ -19,6 +19,7 @@
 
 #include "org_apache_hadoop.h"
 #include "org_apache_hadoop_io_compress_lz4_Lz4Compressor.h"
+#include "org/apache/hadoop/io/compress/parallel_compress.h"
 
 #ifdef UNIX
 #include "config.h"
@@ -26,6 +27,8 @@
 #include "lz4.h"
 #include "lz4hc.h"
 
+#include <stdlib.h>
+
 
 static jfieldID Lz4Compressor_uncompressedDirectBuf;
 static jfieldID Lz4Compressor_uncompressedDirectBufLen;
@@ -83,6 +86,176 @@ JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Compressor_comp
   return (jint)compressed_direct_buf_len;
 }
 
+// The history a linked block may refer to
+#define LZ4_DICTIONARY_SIZE (64 * 1024)
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Compressor_streamStateSize
+(JNIEnv *env, jclass clazz){
+  return (jint)sizeof(LZ4_stream_t);
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Compressor_compressBytesDirectFast
+(JNIEnv *env, jobject thisj, jint acceleration, jobject streamState, jobject dictionary, jboolean resetStream){
+  const char* uncompressed_bytes;
+  char *compressed_bytes;
+  LZ4_stream_t *stream = NULL;
+  char *dictionary_bytes = NULL;
+  jint compressed_capacity;
+
+  // Get members of Lz4Compressor
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env, thisj, Lz4Compressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, Lz4Compressor_uncompressedDirectBufLen);
+  jobject compressed_direct_buf = (*env)->GetObjectField(env, thisj, Lz4Compressor_compressedDirectBuf);
+  jint compressed_direct_buf_len;
+
+  uncompressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+  compressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+  if (uncompressed_bytes == 0 || compressed_bytes == 0) {
+    return (jint)0;
+  }
+  compressed_capacity = (jint)(*env)->GetDirectBufferCapacity(env, compressed_direct_buf);
+
+  if (streamState != NULL) {
+    stream = (LZ4_stream_t *)(*env)->GetDirectBufferAddress(env, streamState);
+    dictionary_bytes = (char *)(*env)->GetDirectBufferAddress(env, dictionary);
+    if (stream == NULL || dictionary_bytes == NULL) {
+      THROW(env, "java/lang/IllegalArgumentException", "Invalid LZ4 stream state");
+      return 0;
+    }
+    if (resetStream) {
+      LZ4_resetStream(stream);
+    }
+    compressed_direct_buf_len = LZ4_compress_fast_continue(stream, uncompressed_bytes, compressed_bytes,
+                                                           uncompressed_direct_buf_len, compressed_capacity,
+                                                           acceleration);
+    // The input buffer is refilled before the next block, so the part of
+    // it the next block may refer to is kept aside
+    if (compressed_direct_buf_len > 0) {
+      LZ4_saveDict(stream, dictionary_bytes, LZ4_DICTIONARY_SIZE);
+    }
+  } else {
+    compressed_direct_buf_len = LZ4_compress_fast(uncompressed_bytes, compressed_bytes,
+                                                  uncompressed_direct_buf_len, compressed_capacity,
+                                                  acceleration);
+  }
+  if (compressed_direct_buf_len <= 0 && uncompressed_direct_buf_len > 0) {
+    THROW(env, "java/lang/InternalError", "LZ4_compress_fast failed");
+    return 0;
+  }
+
+  (*env)->SetIntField(env, thisj, Lz4Compressor_uncompressedDirectBufLen, 0);
+
+  return (jint)compressed_direct_buf_len;
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Compressor_compressBytesDirectHC2
+(JNIEnv *env, jobject thisj, jint level){
+  const char* uncompressed_bytes;
+  char *compressed_bytes;
+
+  // Get members of Lz4Compressor
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env, thisj, Lz4Compressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, Lz4Compressor_uncompressedDirectBufLen);
+  jobject compressed_direct_buf = (*env)->GetObjectField(env, thisj, Lz4Compressor_compressedDirectBuf);
+  jint compressed_direct_buf_len;
+
+  uncompressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+  compressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+  if (uncompressed_bytes == 0 || compressed_bytes == 0) {
+    return (jint)0;
+  }
+
+  compressed_direct_buf_len = LZ4_compressHC2_limitedOutput(uncompressed_bytes, compressed_bytes,
+      uncompressed_direct_buf_len,
+      (int)(*env)->GetDirectBufferCapacity(env, compressed_direct_buf), level);
+  if (compressed_direct_buf_len <= 0 && uncompressed_direct_buf_len > 0) {
+    THROW(env, "java/lang/InternalError", "LZ4_compressHC2 failed");
+    return 0;
+  }
+
+  (*env)->SetIntField(env, thisj, Lz4Compressor_uncompressedDirectBufLen, 0);
+
+  return (jint)compressed_direct_buf_len;
+}
+
+// The settings of the frames of compressFramesDirect
+struct lz4_frame_settings {
+  int use_hc;
+  int hc_level;
+  int acceleration;
+};
+
+static int lz4_compress_frame(const void *arg, const char *in, int in_len,
+                              char *out, int out_capacity)
+{
+  const struct lz4_frame_settings *settings = arg;
+
+  if (settings->use_hc) {
+    return LZ4_compressHC2_limitedOutput(in, out, in_len, out_capacity,
+                                         settings->hc_level);
+  }
+  return LZ4_compress_fast(in, out, in_len, out_capacity,
+                           settings->acceleration);
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Compressor_compressFramesDirect
+(JNIEnv *env, jobject thisj, jboolean useHC, jint hcLevel, jint acceleration, jint frameSize, jint threads, jintArray frameLengths){
+  struct lz4_frame_settings settings;
+  const char* uncompressed_bytes;
+  char *compressed_bytes;
+  jlong compressed_capacity;
+  int num_frames, i, *frame_lens;
+  jint frame_len, compressed_len;
+
+  // Get members of Lz4Compressor
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env, thisj, Lz4Compressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, Lz4Compressor_uncompressedDirectBufLen);
+  jobject compressed_direct_buf = (*env)->GetObjectField(env, thisj, Lz4Compressor_compressedDirectBuf);
+
+  uncompressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+  compressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+  if (uncompressed_bytes == 0 || compressed_bytes == 0 || uncompressed_direct_buf_len <= 0) {
+    return (jint)0;
+  }
+
+  // Every frame gets an equal share of the output buffer to compress into
+  num_frames = (int)(((jlong)uncompressed_direct_buf_len + frameSize - 1) / frameSize);
+  compressed_capacity = (*env)->GetDirectBufferCapacity(env, compressed_direct_buf);
+  if (frameSize <= 0 || num_frames > (*env)->GetArrayLength(env, frameLengths) ||
+      compressed_capacity / num_frames < LZ4_compressBound(frameSize)) {
+    THROW(env, "java/lang/IllegalArgumentException", "Invalid LZ4 frame layout");
+    return 0;
+  }
+  frame_lens = malloc(sizeof(int) * num_frames);
+  if (!frame_lens) {
+    THROW(env, "java/lang/OutOfMemoryError", "Cannot allocate LZ4 frame lengths");
+    return 0;
+  }
+
+  settings.use_hc = useHC;
+  settings.hc_level = hcLevel;
+  settings.acceleration = acceleration;
+  compressed_len = compress_frames(lz4_compress_frame, &settings,
+                                   uncompressed_bytes, uncompressed_direct_buf_len,
+                                   frameSize, compressed_bytes,
+                                   (int)(compressed_capacity / num_frames),
+                                   threads, frame_lens);
+  if (compressed_len < 0) {
+    free(frame_lens);
+    THROW(env, "java/lang/InternalError", useHC ? "LZ4_compressHC failed" : "LZ4_compress failed");
+    return 0;
+  }
+  for (i = 0; i < num_frames; i++) {
+    frame_len = frame_lens[i];
+    (*env)->SetIntArrayRegion(env, frameLengths, i, 1, &frame_len);
+  }
+  free(frame_lens);
+
+  (*env)->SetIntField(env, thisj, Lz4Compressor_uncompressedDirectBufLen, 0);
+
+  return compressed_len;
+}
+
 JNIEXPORT jstring JNICALL
 Java_org_apache_hadoop_io_compress_lz4_Lz4Compressor_getLibraryName(
  JNIEnv *env, jclass class
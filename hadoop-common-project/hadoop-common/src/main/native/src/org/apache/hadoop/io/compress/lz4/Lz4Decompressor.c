@@ -24,6 +24,11 @@
 #endif // UNIX
 #include "lz4.h"
 
+#include <string.h>
+
+// The history a linked block may refer to
+#define LZ4_DICTIONARY_SIZE (64 * 1024)
+
 
 static jfieldID Lz4Decompressor_compressedDirectBuf;
 static jfieldID Lz4Decompressor_compressedDirectBufLen;
@@ -79,3 +84,49 @@ JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Decompressor_de
 
   return (jint)uncompressed_direct_buf_len;
 }
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_lz4_Lz4Decompressor_decompressBytesDirectUsingDict
+(JNIEnv *env, jobject thisj, jobject dictionary, jint dictionaryLen){
+  const char *compressed_bytes;
+  char *uncompressed_bytes;
+  char *dictionary_bytes;
+  int uncompressed_len, keep;
+
+  // Get members of Lz4Decompressor
+  jobject compressed_direct_buf = (*env)->GetObjectField(env,thisj, Lz4Decompressor_compressedDirectBuf);
+  jint compressed_direct_buf_len = (*env)->GetIntField(env,thisj, Lz4Decompressor_compressedDirectBufLen);
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env,thisj, Lz4Decompressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, Lz4Decompressor_directBufferSize);
+
+  compressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+  uncompressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+  dictionary_bytes = (char *)(*env)->GetDirectBufferAddress(env, dictionary);
+  if (compressed_bytes == 0 || uncompressed_bytes == 0 || dictionary_bytes == 0) {
+    return (jint)0;
+  }
+
+  uncompressed_len = LZ4_decompress_safe_usingDict(compressed_bytes, uncompressed_bytes,
+                                                   compressed_direct_buf_len, uncompressed_direct_buf_len,
+                                                   dictionary_bytes, dictionaryLen);
+  if (uncompressed_len < 0) {
+    THROW(env, "java/lang/InternalError", "LZ4_decompress_safe_usingDict failed.");
+    return 0;
+  }
+
+  // Keep the last 64 KB of everything decompressed for the next block
+  if (uncompressed_len >= LZ4_DICTIONARY_SIZE) {
+    memcpy(dictionary_bytes, uncompressed_bytes + uncompressed_len - LZ4_DICTIONARY_SIZE,
+           LZ4_DICTIONARY_SIZE);
+  } else {
+    keep = LZ4_DICTIONARY_SIZE - uncompressed_len;
+    if (keep > dictionaryLen) {
+      keep = dictionaryLen;
+    }
+    memmove(dictionary_bytes, dictionary_bytes + dictionaryLen - keep, keep);
+    memcpy(dictionary_bytes + keep, uncompressed_bytes, uncompressed_len);
+  }
+
+  (*env)->SetIntField(env, thisj, Lz4Decompressor_compressedDirectBufLen, 0);
+
+  return (jint)uncompressed_len;
+}
@@ -128,6 +128,16 @@ LZ4_compress_limitedOutput() :
 int LZ4_compress_limitedOutput (const char* source, char* dest, int sourceSize, int maxOutputSize);
 
 
+/*
+LZ4_compress_fast() :
+    Same as LZ4_compress_limitedOutput(), but with an "acceleration" factor.
+    The larger the acceleration value, the faster the algorithm, but also the lesser the compression.
+    It's a trade-off. It can be fine tuned, with each successive value providing an additional +2/3% to speed.
+    An acceleration value of "1" is the same as regular LZ4_compress_limitedOutput(). Values <= 0 are replaced by 1.
+*/
+int LZ4_compress_fast (const char* source, char* dest, int sourceSize, int maxOutputSize, int acceleration);
+
+
 /*
 LZ4_compress_withState() :
     Same compression functions, but using an externally allocated memory space to store compression state.
@@ -218,6 +228,12 @@ int LZ4_compress_continue (LZ4_stream_t* LZ4_stream, const char* source, char* d
  */
 int LZ4_compress_limitedOutput_continue (LZ4_stream_t* LZ4_stream, const char* source, char* dest, int inputSize, int maxOutputSize);
 
+/*
+ * LZ4_compress_fast_continue
+ * Same as before, with the "acceleration" factor of LZ4_compress_fast()
+ */
+int LZ4_compress_fast_continue (LZ4_stream_t* LZ4_stream, const char* source, char* dest, int inputSize, int maxOutputSize, int acceleration);
+
 /*
  * LZ4_saveDict
  * If previously compressed data block is not guaranteed to remain available at its memory location
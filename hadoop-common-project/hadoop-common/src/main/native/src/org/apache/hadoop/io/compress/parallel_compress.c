@@ -0,0 +1,83 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+#include "parallel_compress.h"
+#include "org/apache/hadoop/util/worker_pool.h"
+
+#include <string.h>
+
+/**
+ * The frames of one compress_frames call.
+ */
+struct compress_job {
+  compress_frame_fn fn;
+  const void *arg;
+  const char *in;
+  int in_len;
+  int frame_size;
+  char *out;
+  int slot_size;
+  int *frame_lens;
+};
+
+static void compress_one_frame(void *arg, int frame)
+{
+  struct compress_job *job = arg;
+  int offset = frame * job->frame_size;
+  int len = job->in_len - offset;
+
+  if (len > job->frame_size) {
+    len = job->frame_size;
+  }
+  job->frame_lens[frame] = job->fn(job->arg, job->in + offset, len,
+      job->out + frame * job->slot_size, job->slot_size);
+}
+
+int compress_frames(compress_frame_fn fn, const void *arg, const char *in,
+                    int in_len, int frame_size, char *out, int slot_size,
+                    int threads, int *frame_lens)
+{
+  struct compress_job job;
+  int frame, num_frames, total = 0;
+
+  memset(&job, 0, sizeof(job));
+  job.fn = fn;
+  job.arg = arg;
+  job.in = in;
+  job.in_len = in_len;
+  job.frame_size = frame_size;
+  job.out = out;
+  job.slot_size = slot_size;
+  job.frame_lens = frame_lens;
+  num_frames = (int)(((long long)in_len + frame_size - 1) / frame_size);
+  run_tasks(compress_one_frame, &job, num_frames, threads);
+
+  for (frame = 0; frame < num_frames; frame++) {
+    if (frame_lens[frame] < 1) {
+      return -1;
+    }
+    // Slots are at least as long as the frames in them, so this only ever
+    // moves a frame towards the start of the buffer
+    if (total != frame * slot_size) {
+      memmove(out + total, out + frame * slot_size, frame_lens[frame]);
+    }
+    total += frame_lens[frame];
+  }
+  return total;
+}
@@ -0,0 +1,47 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORG_APACHE_HADOOP_IO_COMPRESS_PARALLEL_COMPRESS_H
+#define ORG_APACHE_HADOOP_IO_COMPRESS_PARALLEL_COMPRESS_H
+
+/**
+ * Compresses one frame of in_len bytes into at most out_capacity bytes of
+ * out, with the settings in arg.  Returns the compressed length, or a value
+ * < 1 on failure.
+ */
+typedef int (*compress_frame_fn)(const void *arg, const char *in, int in_len,
+                                 char *out, int out_capacity);
+
+/**
+ * Splits in_len bytes of in into frames of frame_size bytes, the last one
+ * possibly shorter, and compresses each of them independently with fn.
+ *
+ * fn is passed arg for every frame.  Frame i is compressed into the
+ * slot_size bytes at out + i * slot_size.  The frames are spread over at
+ * most threads threads with run_tasks.  When every frame is done they are
+ * moved down to follow each other from out, and the compressed length of
+ * frame i is stored in frame_lens[i].
+ *
+ * @return the total compressed length, or -1 if a frame could not be
+ *         compressed into its slot
+ */
+int compress_frames(compress_frame_fn fn, const void *arg, const char *in,
+                    int in_len, int frame_size, char *out, int slot_size,
+                    int threads, int *frame_lens);
+
+#endif //ORG_APACHE_HADOOP_IO_COMPRESS_PARALLEL_COMPRESS_H
@@ -35,6 +35,7 @@
 #endif
 
 #include "org_apache_hadoop_io_compress_snappy_SnappyCompressor.h"
+#include "org/apache/hadoop/io/compress/parallel_compress.h"
 
 #define JINT_MAX 0x7fffffff
 
@@ -138,6 +139,70 @@ JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_snappy_SnappyCompresso
   return (jint)buf_len;
 }
 
+static int snappy_compress_frame(const void *arg, const char *in, int in_len,
+                                 char *out, int out_capacity)
+{
+  size_t buf_len = (size_t)out_capacity;
+
+  if (dlsym_snappy_compress(in, in_len, out, &buf_len) != SNAPPY_OK) {
+    return 0;
+  }
+  return (int)buf_len;
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_snappy_SnappyCompressor_compressFramesDirect
+(JNIEnv *env, jobject thisj, jint frameSize, jint threads, jintArray frameLengths){
+  const char* uncompressed_bytes;
+  char* compressed_bytes;
+  jlong compressed_capacity;
+  int num_frames, i, *frame_lens;
+  jint frame_len, compressed_len;
+  // Get members of SnappyCompressor
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env, thisj, SnappyCompressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, SnappyCompressor_uncompressedDirectBufLen);
+  jobject compressed_direct_buf = (*env)->GetObjectField(env, thisj, SnappyCompressor_compressedDirectBuf);
+
+  uncompressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+  compressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+  if (uncompressed_bytes == 0 || compressed_bytes == 0 || uncompressed_direct_buf_len <= 0) {
+    return (jint)0;
+  }
+
+  // Every frame gets an equal share of the output buffer to compress into
+  num_frames = (int)(((jlong)uncompressed_direct_buf_len + frameSize - 1) / frameSize);
+  compressed_capacity = (*env)->GetDirectBufferCapacity(env, compressed_direct_buf);
+  if (frameSize <= 0 || num_frames > (*env)->GetArrayLength(env, frameLengths) ||
+      compressed_capacity / num_frames > JINT_MAX) {
+    THROW(env, "java/lang/IllegalArgumentException", "Invalid snappy frame layout");
+    return 0;
+  }
+  frame_lens = malloc(sizeof(int) * num_frames);
+  if (!frame_lens) {
+    THROW(env, "java/lang/OutOfMemoryError", "Cannot allocate snappy frame lengths");
+    return 0;
+  }
+
+  compressed_len = compress_frames(snappy_compress_frame, NULL,
+                                   uncompressed_bytes,
+                                   uncompressed_direct_buf_len, frameSize,
+                                   compressed_bytes,
+                                   (int)(compressed_capacity / num_frames),
+                                   threads, frame_lens);
+  if (compressed_len < 0) {
+    free(frame_lens);
+    THROW(env, "java/lang/InternalError", "Could not compress data. Buffer length is too small.");
+    return 0;
+  }
+  for (i = 0; i < num_frames; i++) {
+    frame_len = frame_lens[i];
+    (*env)->SetIntArrayRegion(env, frameLengths, i, 1, &frame_len);
+  }
+  free(frame_lens);
+
+  (*env)->SetIntField(env, thisj, SnappyCompressor_uncompressedDirectBufLen, 0);
+  return compressed_len;
+}
+
 JNIEXPORT jstring JNICALL
 Java_org_apache_hadoop_io_compress_snappy_SnappyCompressor_getLibraryName(JNIEnv *env, jclass class) {
 #ifdef UNIX
@@ -27,6 +27,7 @@
 
 #include "org_apache_hadoop_io_compress_zlib.h"
 #include "org_apache_hadoop_io_compress_zlib_ZlibCompressor.h"
+#include "org/apache/hadoop/util/native_memory.h"
 
 static jfieldID ZlibCompressor_stream;
 static jfieldID ZlibCompressor_uncompressedDirectBuf;
@@ -164,12 +165,15 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibCompressor_init(
     int rv = 0;
     static const int memLevel = 8; 							// See zconf.h
 	  // Create a z_stream
-    z_stream *stream = malloc(sizeof(z_stream));
+    z_stream *stream = native_memory_malloc(NATIVE_MEMORY_CODEC,
+                                            sizeof(z_stream));
     if (!stream) {
 		THROW(env, "java/lang/OutOfMemoryError", NULL);
 		return (jlong)0;
     }
     memset((void*)stream, 0, sizeof(z_stream));
+    stream->zalloc = native_memory_zalloc;
+    stream->zfree = native_memory_zfree;
 
 	// Initialize stream
     rv = (*dlsym_deflateInit2_)(stream, level, Z_DEFLATED, windowBits,
@@ -177,7 +181,7 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibCompressor_init(
 
     if (rv != Z_OK) {
 	    // Contingency - Report error by throwing appropriate exceptions
-	    free(stream);
+	    native_memory_free(NATIVE_MEMORY_CODEC, stream);
 	    stream = NULL;
 
 		switch (rv) {
@@ -353,7 +357,7 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibCompressor_end(
     if (dlsym_deflateEnd(ZSTREAM(stream)) == Z_STREAM_ERROR) {
 		THROW(env, "java/lang/InternalError", NULL);
     } else {
-		free(ZSTREAM(stream));
+		native_memory_free(NATIVE_MEMORY_CODEC, ZSTREAM(stream));
     }
 }
 
@@ -16,6 +16,7 @@
  * limitations under the License.
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +28,33 @@
 
 #include "org_apache_hadoop_io_compress_zlib.h"
 #include "org_apache_hadoop_io_compress_zlib_ZlibDecompressor.h"
+#include "org/apache/hadoop/util/native_memory.h"
+#include "org/apache/hadoop/util/worker_pool.h"
+
+#ifdef HADOOP_IGZIP_INFLATE
+#include <igzip_lib.h>
+#endif
+
+/*
+ * The state behind a stream handle.  The z_stream comes first, so that the
+ * handle can be used as a z_stream pointer by everything that only needs
+ * zlib.
+ */
+typedef struct {
+  z_stream zstream;
+#ifdef HADOOP_IGZIP_INFLATE
+  // Inflates the stream in place of zlib when use_igzip is 1.  Allocated the
+  // first time, and kept across resets.
+  struct inflate_state *igzip;
+  int window_bits;
+  // -1 until the start of the stream has been seen
+  int use_igzip;
+  // Only zlib handles preset dictionaries
+  int has_dict;
+#endif
+} zlib_inflater;
+
+#define INFLATER(stream) ((zlib_inflater*)((ptrdiff_t)(stream)))
 
 static jfieldID ZlibDecompressor_stream;
 static jfieldID ZlibDecompressor_compressedDirectBuf;
@@ -60,6 +88,137 @@ static __dlsym_inflateEnd dlsym_inflateEnd;
 extern HANDLE LoadZlibTryHadoopNativeDir();
 #endif
 
+#ifdef HADOOP_IGZIP_INFLATE
+static void (*dlsym_isal_inflate_init)(struct inflate_state *);
+static int (*dlsym_isal_inflate)(struct inflate_state *);
+
+/**
+ * Load the inflater of ISA-L, if the library is there.  Streams are inflated
+ * by zlib when it is not.
+ */
+static void load_igzip(void) {
+  void *libisal = dlopen(HADOOP_ISAL_LIBRARY, RTLD_LAZY | RTLD_GLOBAL);
+  if (!libisal) {
+    return;
+  }
+  dlerror();                                 // Clear any existing error
+  dlsym_isal_inflate_init = dlsym(libisal, "isal_inflate_init");
+  dlsym_isal_inflate = dlsym(libisal, "isal_inflate");
+  if (!dlsym_isal_inflate_init || !dlsym_isal_inflate) {
+    dlsym_isal_inflate_init = NULL;
+    dlsym_isal_inflate = NULL;
+  }
+}
+
+/**
+ * Decide which library inflates the stream, from its first bytes.  igzip
+ * takes gzip, zlib and raw deflate streams, but not the ones that need a
+ * preset dictionary, or that zlib would reject anyway, so that zlib reports
+ * those as before.
+ */
+static void choose_inflater(zlib_inflater *inflater) {
+  z_stream *stream = &inflater->zstream;
+  int window_bits = inflater->window_bits;
+  int flag = -1;
+
+  inflater->use_igzip = 0;
+  if (!dlsym_isal_inflate || inflater->has_dict) {
+    return;
+  }
+  if (window_bits == -15) {
+    flag = ISAL_DEFLATE;
+  } else if (stream->avail_in < 2) {
+    // Too little to tell, let zlib have it
+    return;
+  } else if ((window_bits == 31 || window_bits == 47) &&
+             stream->next_in[0] == 0x1f && stream->next_in[1] == 0x8b) {
+    flag = ISAL_GZIP;
+  } else if ((window_bits == 15 || window_bits == 47) &&
+             (stream->next_in[0] & 0x0f) == Z_DEFLATED &&
+             (stream->next_in[0] >> 4) <= 7 &&
+             !(stream->next_in[1] & 0x20) &&
+             ((stream->next_in[0] << 8) | stream->next_in[1]) % 31 == 0) {
+    flag = ISAL_ZLIB;
+  }
+  if (flag < 0) {
+    return;
+  }
+  if (!inflater->igzip) {
+    inflater->igzip = native_memory_malloc(NATIVE_MEMORY_CODEC,
+                                           sizeof(struct inflate_state));
+    if (!inflater->igzip) {
+      return;
+    }
+  }
+  dlsym_isal_inflate_init(inflater->igzip);
+  inflater->igzip->crc_flag = flag;
+  inflater->use_igzip = 1;
+}
+
+static const char *igzip_error(int rv) {
+  switch (rv) {
+    case ISAL_INVALID_BLOCK:
+      return "invalid block";
+    case ISAL_INVALID_SYMBOL:
+      return "invalid symbol";
+    case ISAL_INVALID_LOOKBACK:
+      return "invalid distance too far back";
+    case ISAL_INVALID_WRAPPER:
+      return "incorrect header";
+    case ISAL_UNSUPPORTED_METHOD:
+      return "unknown compression method";
+    case ISAL_INCORRECT_CHECKSUM:
+      return "incorrect data check";
+    default:
+      return "igzip inflate failed";
+  }
+}
+
+/**
+ * Inflate with igzip from where the z_stream points, and keep the z_stream
+ * counters current for getBytesRead, getBytesWritten and getRemaining.
+ */
+static jint igzip_inflate_bytes(JNIEnv *env, jobject this,
+                                zlib_inflater *inflater,
+                                jint compressed_direct_buf_off) {
+  z_stream *stream = &inflater->zstream;
+  struct inflate_state *state = inflater->igzip;
+  jint no_decompressed_bytes = 0;
+  uInt avail_in = stream->avail_in;
+  int rv;
+
+  state->next_in = stream->next_in;
+  state->avail_in = stream->avail_in;
+  state->next_out = stream->next_out;
+  state->avail_out = stream->avail_out;
+
+  rv = dlsym_isal_inflate(state);
+  if (rv != ISAL_DECOMP_OK && rv != ISAL_END_INPUT &&
+      rv != ISAL_OUT_OVERFLOW) {
+    THROW(env, "java/io/IOException", igzip_error(rv));
+    return (jint)0;
+  }
+
+  no_decompressed_bytes = stream->avail_out - state->avail_out;
+  stream->next_in = state->next_in;
+  stream->avail_in = state->avail_in;
+  stream->next_out = state->next_out;
+  stream->avail_out = state->avail_out;
+  stream->total_in += avail_in - state->avail_in;
+  stream->total_out += no_decompressed_bytes;
+
+  if (state->block_state == ISAL_BLOCK_FINISH) {
+    (*env)->SetBooleanField(env, this, ZlibDecompressor_finished, JNI_TRUE);
+  }
+  compressed_direct_buf_off += avail_in - stream->avail_in;
+  (*env)->SetIntField(env, this, ZlibDecompressor_compressedDirectBufOff,
+                      compressed_direct_buf_off);
+  (*env)->SetIntField(env, this, ZlibDecompressor_compressedDirectBufLen,
+                      stream->avail_in);
+  return no_decompressed_bytes;
+}
+#endif
+
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_initIDs(
 JNIEnv *env, jclass class
@@ -93,6 +252,10 @@ JNIEnv *env, jclass class
 	LOAD_DYNAMIC_SYMBOL(dlsym_inflateEnd, env, libz, "inflateEnd");
 #endif
 
+#ifdef HADOOP_IGZIP_INFLATE
+	load_igzip();
+#endif
+
 #ifdef WINDOWS
 	LOAD_DYNAMIC_SYMBOL(__dlsym_inflateInit2_, dlsym_inflateInit2_, env, libz, "inflateInit2_");
 	LOAD_DYNAMIC_SYMBOL(__dlsym_inflate, dlsym_inflate, env, libz, "inflate");
@@ -125,19 +288,27 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_init(
 	JNIEnv *env, jclass cls, jint windowBits
 	) {
     int rv = 0;
-    z_stream *stream = malloc(sizeof(z_stream));
-    memset((void*)stream, 0, sizeof(z_stream));
+    zlib_inflater *inflater = native_memory_malloc(NATIVE_MEMORY_CODEC,
+                                                   sizeof(zlib_inflater));
+    z_stream *stream = (z_stream*)inflater;
 
     if (stream == 0) {
 		THROW(env, "java/lang/OutOfMemoryError", NULL);
 		return (jlong)0;
     }
+    memset((void*)inflater, 0, sizeof(zlib_inflater));
+    stream->zalloc = native_memory_zalloc;
+    stream->zfree = native_memory_zfree;
+#ifdef HADOOP_IGZIP_INFLATE
+    inflater->window_bits = windowBits;
+    inflater->use_igzip = -1;
+#endif
 
     rv = dlsym_inflateInit2_(stream, windowBits, ZLIB_VERSION, sizeof(z_stream));
 
 	if (rv != Z_OK) {
 	    // Contingency - Report error by throwing appropriate exceptions
-		free(stream);
+		native_memory_free(NATIVE_MEMORY_CODEC, stream);
 		stream = NULL;
 
 		switch (rv) {
@@ -168,6 +339,9 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_setDictionary(
 		THROW(env, "java/lang/InternalError", NULL);
         return;
     }
+#ifdef HADOOP_IGZIP_INFLATE
+    INFLATER(stream)->has_dict = 1;
+#endif
     rv = dlsym_inflateSetDictionary(ZSTREAM(stream), buf + off, len);
     (*env)->ReleasePrimitiveArrayCritical(env, b, buf, 0);
 
@@ -248,6 +422,16 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_inflateBytesDirect(
 	stream->avail_in  = compressed_direct_buf_len;
 	stream->avail_out = uncompressed_direct_buf_len;
 
+#ifdef HADOOP_IGZIP_INFLATE
+	if (INFLATER(stream)->use_igzip < 0) {
+	  choose_inflater(INFLATER(stream));
+	}
+	if (INFLATER(stream)->use_igzip) {
+	  return igzip_inflate_bytes(env, this, INFLATER(stream),
+	                             compressed_direct_buf_off);
+	}
+#endif
+
 	// Decompress
 	rv = dlsym_inflate(stream, Z_PARTIAL_FLUSH);
 
@@ -299,6 +483,288 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_inflateBytesDirect(
     return no_decompressed_bytes;
 }
 
+/*
+ * A gzip member as far as the index can tell: from a spot that looks like a
+ * gzip header up to the next such spot, or the end of the input.
+ */
+typedef struct {
+  const Bytef *in;
+  uInt in_len;
+  // The inflated member, in a buffer of its own
+  Bytef *out;
+  size_t out_len;
+  uInt in_used;
+  int rv;
+} gzip_member;
+
+#define GZIP_OUT_MIN (64 * 1024)
+
+/*
+ * Deflate cannot do better than about 1032:1, a trailer that claims more
+ * than that is no trailer.
+ */
+#define DEFLATE_MAX_RATIO 1032
+
+static int is_gzip_header(const Bytef *p, size_t left) {
+  // The magic, deflate, none of the reserved flags, and a valid XFL
+  return left >= 10 && p[0] == 0x1f && p[1] == 0x8b && p[2] == Z_DEFLATED &&
+         !(p[3] & 0xe0) && (p[8] == 0 || p[8] == 2 || p[8] == 4);
+}
+
+/**
+ * Inflate the single gzip member at member->in into a new buffer of
+ * capacity bytes, grown as needed.  Leaves the zlib result in member->rv,
+ * Z_STREAM_END if the whole member was inflated.
+ */
+static void inflate_member(gzip_member *member, size_t capacity) {
+  z_stream stream;
+  Bytef *out;
+  int rv;
+
+  member->out = NULL;
+  member->out_len = 0;
+  member->in_used = 0;
+  if (capacity < GZIP_OUT_MIN) {
+    capacity = GZIP_OUT_MIN;
+  }
+
+  memset(&stream, 0, sizeof(stream));
+  stream.zalloc = native_memory_zalloc;
+  stream.zfree = native_memory_zfree;
+  rv = dlsym_inflateInit2_(&stream, 31, ZLIB_VERSION, sizeof(z_stream));
+  if (rv != Z_OK) {
+    member->rv = rv;
+    return;
+  }
+  stream.next_in = (Bytef *)member->in;
+  stream.avail_in = member->in_len;
+  for (;;) {
+    if (member->out_len == capacity || !member->out) {
+      if (member->out) {
+        capacity *= 2;
+      }
+      out = realloc(member->out, capacity);
+      if (!out) {
+        rv = Z_MEM_ERROR;
+        break;
+      }
+      member->out = out;
+    }
+    stream.next_out = member->out + member->out_len;
+    stream.avail_out = capacity - member->out_len > UINT_MAX ? UINT_MAX :
+      (uInt)(capacity - member->out_len);
+    rv = dlsym_inflate(&stream, Z_NO_FLUSH);
+    member->out_len = stream.next_out - member->out;
+    if (rv == Z_STREAM_END || (rv != Z_OK && rv != Z_BUF_ERROR)) {
+      break;
+    }
+    if (stream.avail_out > 0) {
+      // All the input went in, and the member did not end
+      rv = Z_BUF_ERROR;
+      break;
+    }
+  }
+  member->in_used = member->in_len - stream.avail_in;
+  member->rv = rv;
+  dlsym_inflateEnd(&stream);
+}
+
+/**
+ * Inflate a member of the index, into a buffer of the length its trailer
+ * claims.  A member that turns out not to be one is left to the caller.
+ */
+static void inflate_member_task(void *arg, int task) {
+  gzip_member *member = (gzip_member *)arg + task;
+  const Bytef *trailer;
+  size_t capacity = 0;
+
+  if (member->in_len >= 18) {
+    trailer = member->in + member->in_len - 4;
+    capacity = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) |
+      ((uInt)trailer[3] << 24);
+  }
+  if (capacity > (size_t)member->in_len * DEFLATE_MAX_RATIO) {
+    capacity = (size_t)member->in_len * 4;
+  }
+  inflate_member(member, capacity);
+  if (member->rv != Z_STREAM_END || member->in_used != member->in_len) {
+    // Not a whole member, the caller inflates again from the real start
+    free(member->out);
+    member->out = NULL;
+  }
+}
+
+JNIEXPORT jintArray JNICALL
+Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_indexGzipMembers(
+	JNIEnv *env, jclass cls, jobject src, jint off, jint len
+	) {
+    const Bytef *in = (*env)->GetDirectBufferAddress(env, src);
+    const Bytef *end, *p;
+    jint *starts = NULL;
+    jintArray result = NULL;
+    int pass, n = 0;
+
+    if (!in) {
+      THROW(env, "java/lang/IllegalArgumentException",
+            "Not a direct buffer");
+      return NULL;
+    }
+    in += off;
+    end = in + len;
+
+    // Count the spots first, then fill them in
+    for (pass = 0; pass < 2; pass++) {
+      n = 0;
+      for (p = memchr(in, 0x1f, len); p;
+           p = p + 1 < end ? memchr(p + 1, 0x1f, end - p - 1) : NULL) {
+        if (is_gzip_header(p, end - p)) {
+          if (starts) {
+            starts[n] = (jint)(p - in);
+          }
+          n++;
+        }
+      }
+      if (!starts) {
+        starts = malloc(sizeof(jint) * (n > 0 ? n : 1));
+        if (!starts) {
+          THROW(env, "java/lang/OutOfMemoryError", NULL);
+          return NULL;
+        }
+      }
+    }
+
+    result = (*env)->NewIntArray(env, n);
+    if (result) {
+      (*env)->SetIntArrayRegion(env, result, 0, n, starts);
+    }
+    free(starts);
+    return result;
+}
+
+static const char *gzip_member_error(int rv) {
+  switch (rv) {
+    case Z_BUF_ERROR:
+      return "truncated gzip member";
+    case Z_NEED_DICT:
+      return "gzip member needs a dictionary";
+    default:
+      return "invalid gzip member";
+  }
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_inflateGzipMembers(
+	JNIEnv *env, jclass cls, jobject src, jint off, jint len,
+	jintArray starts, jint threads
+	) {
+    const Bytef *in = (*env)->GetDirectBufferAddress(env, src);
+    jint n = (*env)->GetArrayLength(env, starts);
+    jint *offsets = NULL;
+    gzip_member *members = NULL, *chain = NULL, *grown;
+    int chain_len = 0, chain_capacity = 0;
+    jbyteArray result = NULL;
+    jlong total = 0;
+    uInt in_pos = 0;
+    int i;
+
+    if (!in) {
+      THROW(env, "java/lang/IllegalArgumentException",
+            "Not a direct buffer");
+      return NULL;
+    }
+    in += off;
+
+    offsets = malloc(sizeof(jint) * (n > 0 ? n : 1));
+    members = calloc(n > 0 ? n : 1, sizeof(gzip_member));
+    if (!offsets || !members) {
+      THROW(env, "java/lang/OutOfMemoryError", NULL);
+      goto done;
+    }
+    (*env)->GetIntArrayRegion(env, starts, 0, n, offsets);
+    for (i = 0; i < n; i++) {
+      jint end = i + 1 < n ? offsets[i + 1] : len;
+      if (offsets[i] < 0 || offsets[i] >= end || end > len) {
+        THROW(env, "java/lang/IllegalArgumentException",
+              "Member offsets out of order");
+        goto done;
+      }
+      members[i].in = in + offsets[i];
+      members[i].in_len = end - offsets[i];
+    }
+
+    run_tasks(inflate_member_task, members, n, threads);
+
+    // Chain the members in order.  One that did not inflate whole starts at
+    // a spot that only looked like a header, or ends at one: inflate again
+    // from the real start, on this thread, past the false spots.
+    i = 0;
+    while (in_pos < (uInt)len) {
+      if (chain_len == chain_capacity) {
+        chain_capacity = chain_capacity ? chain_capacity * 2 : n + 1;
+        grown = realloc(chain, sizeof(gzip_member) * chain_capacity);
+        if (!grown) {
+          THROW(env, "java/lang/OutOfMemoryError", NULL);
+          goto done;
+        }
+        chain = grown;
+      }
+      if (i < n && members[i].in == in + in_pos && members[i].out) {
+        chain[chain_len] = members[i];
+        members[i].out = NULL;
+      } else {
+        chain[chain_len].in = in + in_pos;
+        chain[chain_len].in_len = len - in_pos;
+        inflate_member(&chain[chain_len], 0);
+        if (chain[chain_len].rv != Z_STREAM_END) {
+          free(chain[chain_len].out);
+          if (chain[chain_len].rv == Z_MEM_ERROR) {
+            THROW(env, "java/lang/OutOfMemoryError", NULL);
+          } else {
+            THROW(env, "java/io/IOException",
+                  gzip_member_error(chain[chain_len].rv));
+          }
+          goto done;
+        }
+      }
+      in_pos += chain[chain_len].in_used;
+      total += chain[chain_len].out_len;
+      chain_len++;
+      while (i < n && members[i].in < in + in_pos) {
+        i++;
+      }
+    }
+
+    if (total > INT_MAX) {
+      THROW(env, "java/io/IOException",
+            "Gzip members inflate to more than 2 GB");
+      goto done;
+    }
+    result = (*env)->NewByteArray(env, (jsize)total);
+    if (result) {
+      total = 0;
+      for (i = 0; i < chain_len; i++) {
+        (*env)->SetByteArrayRegion(env, result, (jsize)total,
+                                   (jsize)chain[i].out_len,
+                                   (jbyte *)chain[i].out);
+        total += chain[i].out_len;
+      }
+    }
+
+done:
+    for (i = 0; i < chain_len; i++) {
+      free(chain[i].out);
+    }
+    if (members) {
+      for (i = 0; i < n; i++) {
+        free(members[i].out);
+      }
+    }
+    free(chain);
+    free(members);
+    free(offsets);
+    return result;
+}
+
 JNIEXPORT jlong JNICALL
 Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_getBytesRead(
 	JNIEnv *env, jclass cls, jlong stream
@@ -327,6 +793,10 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_reset(
     if (dlsym_inflateReset(ZSTREAM(stream)) != Z_OK) {
 		THROW(env, "java/lang/InternalError", 0);
     }
+#ifdef HADOOP_IGZIP_INFLATE
+    INFLATER(stream)->use_igzip = -1;
+    INFLATER(stream)->has_dict = 0;
+#endif
 }
 
 JNIEXPORT void JNICALL
@@ -336,7 +806,10 @@ Java_org_apache_hadoop_io_compress_zlib_ZlibDecompressor_end(
     if (dlsym_inflateEnd(ZSTREAM(stream)) == Z_STREAM_ERROR) {
 		THROW(env, "java/lang/InternalError", 0);
     } else {
-		free(ZSTREAM(stream));
+#ifdef HADOOP_IGZIP_INFLATE
+		native_memory_free(NATIVE_MEMORY_CODEC, INFLATER(stream)->igzip);
+#endif
+		native_memory_free(NATIVE_MEMORY_CODEC, INFLATER(stream));
     }
 }
 
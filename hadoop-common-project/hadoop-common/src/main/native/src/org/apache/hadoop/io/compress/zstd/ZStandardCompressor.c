@@ -0,0 +1,230 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop_io_compress_zstd.h"
+
+#if defined HADOOP_ZSTD_LIBRARY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef UNIX
+#include <dlfcn.h>
+#include "config.h"
+#endif // UNIX
+
+#include "org_apache_hadoop_io_compress_zstd_ZStandardCompressor.h"
+
+static jfieldID ZStandardCompressor_stream;
+static jfieldID ZStandardCompressor_uncompressedDirectBuf;
+static jfieldID ZStandardCompressor_uncompressedDirectBufOff;
+static jfieldID ZStandardCompressor_uncompressedDirectBufLen;
+static jfieldID ZStandardCompressor_compressedDirectBuf;
+static jfieldID ZStandardCompressor_directBufferSize;
+static jfieldID ZStandardCompressor_finish;
+static jfieldID ZStandardCompressor_finished;
+
+#ifdef UNIX
+static ZSTD_CCtx* (*dlsym_ZSTD_createCCtx)(void);
+static size_t (*dlsym_ZSTD_freeCCtx)(ZSTD_CCtx*);
+static size_t (*dlsym_ZSTD_CCtx_setParameter)(ZSTD_CCtx*, ZSTD_cParameter, int);
+static size_t (*dlsym_ZSTD_CCtx_loadDictionary)(ZSTD_CCtx*, const void*, size_t);
+static size_t (*dlsym_ZSTD_CCtx_reset)(ZSTD_CCtx*, ZSTD_ResetDirective);
+static size_t (*dlsym_ZSTD_compressStream2)(ZSTD_CCtx*, ZSTD_outBuffer*,
+    ZSTD_inBuffer*, ZSTD_EndDirective);
+static unsigned (*dlsym_ZSTD_isError)(size_t);
+static const char* (*dlsym_ZSTD_getErrorName)(size_t);
+#endif
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_initIDs
+(JNIEnv *env, jclass clazz){
+#ifdef UNIX
+  // Load libzstd.so
+  void *libzstd = dlopen(HADOOP_ZSTD_LIBRARY, RTLD_LAZY | RTLD_GLOBAL);
+  if (!libzstd) {
+    char msg[1000];
+    snprintf(msg, 1000, "%s (%s)!", "Cannot load " HADOOP_ZSTD_LIBRARY, dlerror());
+    THROW(env, "java/lang/UnsatisfiedLinkError", msg);
+    return;
+  }
+
+  // Locate the requisite symbols from libzstd.so
+  dlerror();                                 // Clear any existing error
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_createCCtx, env, libzstd, "ZSTD_createCCtx");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_freeCCtx, env, libzstd, "ZSTD_freeCCtx");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_CCtx_setParameter, env, libzstd, "ZSTD_CCtx_setParameter");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_CCtx_loadDictionary, env, libzstd, "ZSTD_CCtx_loadDictionary");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_CCtx_reset, env, libzstd, "ZSTD_CCtx_reset");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_compressStream2, env, libzstd, "ZSTD_compressStream2");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_isError, env, libzstd, "ZSTD_isError");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_getErrorName, env, libzstd, "ZSTD_getErrorName");
+#endif
+
+  ZStandardCompressor_stream = (*env)->GetFieldID(env, clazz, "stream", "J");
+  ZStandardCompressor_uncompressedDirectBuf = (*env)->GetFieldID(env, clazz,
+                                                           "uncompressedDirectBuf",
+                                                           "Ljava/nio/Buffer;");
+  ZStandardCompressor_uncompressedDirectBufOff = (*env)->GetFieldID(env, clazz,
+                                                              "uncompressedDirectBufOff", "I");
+  ZStandardCompressor_uncompressedDirectBufLen = (*env)->GetFieldID(env, clazz,
+                                                              "uncompressedDirectBufLen", "I");
+  ZStandardCompressor_compressedDirectBuf = (*env)->GetFieldID(env, clazz,
+                                                         "compressedDirectBuf",
+                                                         "Ljava/nio/Buffer;");
+  ZStandardCompressor_directBufferSize = (*env)->GetFieldID(env, clazz,
+                                                       "directBufferSize", "I");
+  ZStandardCompressor_finish = (*env)->GetFieldID(env, clazz, "finish", "Z");
+  ZStandardCompressor_finished = (*env)->GetFieldID(env, clazz, "finished", "Z");
+}
+
+JNIEXPORT jlong JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_init
+(JNIEnv *env, jclass clazz, jint level, jint windowLog){
+  size_t rv;
+  ZSTD_CCtx *context = dlsym_ZSTD_createCCtx();
+
+  if (!context) {
+    THROW(env, "java/lang/OutOfMemoryError", NULL);
+    return (jlong)0;
+  }
+  rv = dlsym_ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, level);
+  // 0 leaves the window to the level
+  if (!dlsym_ZSTD_isError(rv) && windowLog > 0) {
+    rv = dlsym_ZSTD_CCtx_setParameter(context, ZSTD_c_windowLog, windowLog);
+  }
+  // Let readers catch corrupt data
+  if (!dlsym_ZSTD_isError(rv)) {
+    rv = dlsym_ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+  }
+  if (dlsym_ZSTD_isError(rv)) {
+    dlsym_ZSTD_freeCCtx(context);
+    THROW(env, "java/lang/IllegalArgumentException", dlsym_ZSTD_getErrorName(rv));
+    return (jlong)0;
+  }
+  return JLONG(context);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_setDictionary
+(JNIEnv *env, jclass clazz, jlong stream, jarray b, jint off, jint len){
+  size_t rv;
+  char *buf = (*env)->GetPrimitiveArrayCritical(env, b, 0);
+
+  if (!buf) {
+    return;
+  }
+  // zstd keeps a copy, which stays loaded across resets
+  rv = dlsym_ZSTD_CCtx_loadDictionary(ZSTD_CONTEXT(stream), buf + off, len);
+  (*env)->ReleasePrimitiveArrayCritical(env, b, buf, 0);
+  if (dlsym_ZSTD_isError(rv)) {
+    THROW(env, "java/lang/IllegalArgumentException", dlsym_ZSTD_getErrorName(rv));
+  }
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_deflateBytesDirect
+(JNIEnv *env, jobject thisj){
+  ZSTD_inBuffer input;
+  ZSTD_outBuffer output;
+  size_t rv;
+  // Get members of ZStandardCompressor
+  ZSTD_CCtx *context = ZSTD_CONTEXT((*env)->GetLongField(env, thisj, ZStandardCompressor_stream));
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env, thisj, ZStandardCompressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_off = (*env)->GetIntField(env, thisj, ZStandardCompressor_uncompressedDirectBufOff);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, ZStandardCompressor_uncompressedDirectBufLen);
+  jobject compressed_direct_buf = (*env)->GetObjectField(env, thisj, ZStandardCompressor_compressedDirectBuf);
+  jint compressed_direct_buf_len = (*env)->GetIntField(env, thisj, ZStandardCompressor_directBufferSize);
+  jboolean finish = (*env)->GetBooleanField(env, thisj, ZStandardCompressor_finish);
+  const char* uncompressed_bytes;
+  char* compressed_bytes;
+
+  if (!context) {
+    THROW(env, "java/lang/NullPointerException", NULL);
+    return (jint)0;
+  }
+
+  // Get the input direct buffer
+  uncompressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+
+  if (uncompressed_bytes == 0) {
+    return (jint)0;
+  }
+
+  // Get the output direct buffer
+  compressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+
+  if (compressed_bytes == 0) {
+    return (jint)0;
+  }
+
+  input.src = uncompressed_bytes + uncompressed_direct_buf_off;
+  input.size = uncompressed_direct_buf_len;
+  input.pos = 0;
+  output.dst = compressed_bytes;
+  output.size = compressed_direct_buf_len;
+  output.pos = 0;
+
+  // Without finish zstd may hold on to what it was given until the block
+  // it is building is full, which is what makes the stream compress well
+  rv = dlsym_ZSTD_compressStream2(context, &output, &input,
+        finish ? ZSTD_e_end : ZSTD_e_continue);
+  if (dlsym_ZSTD_isError(rv)) {
+    THROW(env, "java/lang/InternalError", dlsym_ZSTD_getErrorName(rv));
+    return (jint)0;
+  }
+  // With ZSTD_e_end, what is left to flush
+  if (finish && rv == 0) {
+    (*env)->SetBooleanField(env, thisj, ZStandardCompressor_finished, JNI_TRUE);
+  }
+
+  (*env)->SetIntField(env, thisj, ZStandardCompressor_uncompressedDirectBufOff,
+        uncompressed_direct_buf_off + (jint)input.pos);
+  (*env)->SetIntField(env, thisj, ZStandardCompressor_uncompressedDirectBufLen,
+        uncompressed_direct_buf_len - (jint)input.pos);
+  return (jint)output.pos;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_reset
+(JNIEnv *env, jclass clazz, jlong stream){
+  // Start a new frame, keeping the level, window and dictionary
+  size_t rv = dlsym_ZSTD_CCtx_reset(ZSTD_CONTEXT(stream), ZSTD_reset_session_only);
+
+  if (dlsym_ZSTD_isError(rv)) {
+    THROW(env, "java/lang/InternalError", dlsym_ZSTD_getErrorName(rv));
+  }
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_end
+(JNIEnv *env, jclass clazz, jlong stream){
+  dlsym_ZSTD_freeCCtx(ZSTD_CONTEXT(stream));
+}
+
+JNIEXPORT jstring JNICALL
+Java_org_apache_hadoop_io_compress_zstd_ZStandardCompressor_getLibraryName(JNIEnv *env, jclass class) {
+#ifdef UNIX
+  if (dlsym_ZSTD_compressStream2) {
+    Dl_info dl_info;
+    if(dladdr(
+        dlsym_ZSTD_compressStream2,
+        &dl_info)) {
+      return (*env)->NewStringUTF(env, dl_info.dli_fname);
+    }
+  }
+#endif
+
+  return (*env)->NewStringUTF(env, HADOOP_ZSTD_LIBRARY);
+}
+#endif //define HADOOP_ZSTD_LIBRARY
@@ -0,0 +1,207 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop_io_compress_zstd.h"
+
+#if defined HADOOP_ZSTD_LIBRARY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef UNIX
+#include <dlfcn.h>
+#include "config.h"
+#endif // UNIX
+
+#include "org_apache_hadoop_io_compress_zstd_ZStandardDecompressor.h"
+
+// The largest window zstd decodes without being told to
+#define ZSTD_DEFAULT_WINDOW_LOG_MAX 27
+
+static jfieldID ZStandardDecompressor_stream;
+static jfieldID ZStandardDecompressor_compressedDirectBuf;
+static jfieldID ZStandardDecompressor_compressedDirectBufOff;
+static jfieldID ZStandardDecompressor_compressedDirectBufLen;
+static jfieldID ZStandardDecompressor_uncompressedDirectBuf;
+static jfieldID ZStandardDecompressor_directBufferSize;
+static jfieldID ZStandardDecompressor_finished;
+
+#ifdef UNIX
+static ZSTD_DCtx* (*dlsym_ZSTD_createDCtx)(void);
+static size_t (*dlsym_ZSTD_freeDCtx)(ZSTD_DCtx*);
+static size_t (*dlsym_ZSTD_DCtx_setParameter)(ZSTD_DCtx*, ZSTD_dParameter, int);
+static size_t (*dlsym_ZSTD_DCtx_loadDictionary)(ZSTD_DCtx*, const void*, size_t);
+static size_t (*dlsym_ZSTD_DCtx_reset)(ZSTD_DCtx*, ZSTD_ResetDirective);
+static size_t (*dlsym_ZSTD_decompressStream)(ZSTD_DCtx*, ZSTD_outBuffer*,
+    ZSTD_inBuffer*);
+static unsigned (*dlsym_ZSTD_isError)(size_t);
+static const char* (*dlsym_ZSTD_getErrorName)(size_t);
+#endif
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardDecompressor_initIDs
+(JNIEnv *env, jclass clazz){
+#ifdef UNIX
+  // Load libzstd.so
+  void *libzstd = dlopen(HADOOP_ZSTD_LIBRARY, RTLD_LAZY | RTLD_GLOBAL);
+  if (!libzstd) {
+    char msg[1000];
+    snprintf(msg, 1000, "%s (%s)!", "Cannot load " HADOOP_ZSTD_LIBRARY, dlerror());
+    THROW(env, "java/lang/UnsatisfiedLinkError", msg);
+    return;
+  }
+
+  // Locate the requisite symbols from libzstd.so
+  dlerror();                                 // Clear any existing error
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_createDCtx, env, libzstd, "ZSTD_createDCtx");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_freeDCtx, env, libzstd, "ZSTD_freeDCtx");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_DCtx_setParameter, env, libzstd, "ZSTD_DCtx_setParameter");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_DCtx_loadDictionary, env, libzstd, "ZSTD_DCtx_loadDictionary");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_DCtx_reset, env, libzstd, "ZSTD_DCtx_reset");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_decompressStream, env, libzstd, "ZSTD_decompressStream");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_isError, env, libzstd, "ZSTD_isError");
+  LOAD_DYNAMIC_SYMBOL(dlsym_ZSTD_getErrorName, env, libzstd, "ZSTD_getErrorName");
+#endif
+
+  ZStandardDecompressor_stream = (*env)->GetFieldID(env, clazz, "stream", "J");
+  ZStandardDecompressor_compressedDirectBuf = (*env)->GetFieldID(env, clazz,
+                                                           "compressedDirectBuf",
+                                                           "Ljava/nio/Buffer;");
+  ZStandardDecompressor_compressedDirectBufOff = (*env)->GetFieldID(env, clazz,
+                                                              "compressedDirectBufOff", "I");
+  ZStandardDecompressor_compressedDirectBufLen = (*env)->GetFieldID(env, clazz,
+                                                              "compressedDirectBufLen", "I");
+  ZStandardDecompressor_uncompressedDirectBuf = (*env)->GetFieldID(env, clazz,
+                                                             "uncompressedDirectBuf",
+                                                             "Ljava/nio/Buffer;");
+  ZStandardDecompressor_directBufferSize = (*env)->GetFieldID(env, clazz,
+                                                         "directBufferSize", "I");
+  ZStandardDecompressor_finished = (*env)->GetFieldID(env, clazz, "finished", "Z");
+}
+
+JNIEXPORT jlong JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardDecompressor_init
+(JNIEnv *env, jclass clazz, jint windowLog){
+  size_t rv = 0;
+  ZSTD_DCtx *context = dlsym_ZSTD_createDCtx();
+
+  if (!context) {
+    THROW(env, "java/lang/OutOfMemoryError", NULL);
+    return (jlong)0;
+  }
+  // Frames with a window above the default limit are refused unless the
+  // reader expects them.  Smaller settings leave the limit alone, so data
+  // written with the default window of a high level can still be read.
+  if (windowLog > ZSTD_DEFAULT_WINDOW_LOG_MAX) {
+    rv = dlsym_ZSTD_DCtx_setParameter(context, ZSTD_d_windowLogMax, windowLog);
+  }
+  if (dlsym_ZSTD_isError(rv)) {
+    dlsym_ZSTD_freeDCtx(context);
+    THROW(env, "java/lang/IllegalArgumentException", dlsym_ZSTD_getErrorName(rv));
+    return (jlong)0;
+  }
+  return JLONG(context);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardDecompressor_setDictionary
+(JNIEnv *env, jclass clazz, jlong stream, jarray b, jint off, jint len){
+  size_t rv;
+  char *buf = (*env)->GetPrimitiveArrayCritical(env, b, 0);
+
+  if (!buf) {
+    return;
+  }
+  rv = dlsym_ZSTD_DCtx_loadDictionary(ZSTD_CONTEXT(stream), buf + off, len);
+  (*env)->ReleasePrimitiveArrayCritical(env, b, buf, 0);
+  if (dlsym_ZSTD_isError(rv)) {
+    THROW(env, "java/lang/IllegalArgumentException", dlsym_ZSTD_getErrorName(rv));
+  }
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardDecompressor_inflateBytesDirect
+(JNIEnv *env, jobject thisj){
+  ZSTD_inBuffer input;
+  ZSTD_outBuffer output;
+  size_t rv;
+  // Get members of ZStandardDecompressor
+  ZSTD_DCtx *context = ZSTD_CONTEXT((*env)->GetLongField(env, thisj, ZStandardDecompressor_stream));
+  jobject compressed_direct_buf = (*env)->GetObjectField(env, thisj, ZStandardDecompressor_compressedDirectBuf);
+  jint compressed_direct_buf_off = (*env)->GetIntField(env, thisj, ZStandardDecompressor_compressedDirectBufOff);
+  jint compressed_direct_buf_len = (*env)->GetIntField(env, thisj, ZStandardDecompressor_compressedDirectBufLen);
+  jobject uncompressed_direct_buf = (*env)->GetObjectField(env, thisj, ZStandardDecompressor_uncompressedDirectBuf);
+  jint uncompressed_direct_buf_len = (*env)->GetIntField(env, thisj, ZStandardDecompressor_directBufferSize);
+  const char* compressed_bytes;
+  char* uncompressed_bytes;
+
+  if (!context) {
+    THROW(env, "java/lang/NullPointerException", NULL);
+    return (jint)0;
+  }
+
+  // Get the input direct buffer
+  compressed_bytes = (const char*)(*env)->GetDirectBufferAddress(env, compressed_direct_buf);
+
+  if (compressed_bytes == 0) {
+    return (jint)0;
+  }
+
+  // Get the output direct buffer
+  uncompressed_bytes = (char *)(*env)->GetDirectBufferAddress(env, uncompressed_direct_buf);
+
+  if (uncompressed_bytes == 0) {
+    return (jint)0;
+  }
+
+  input.src = compressed_bytes + compressed_direct_buf_off;
+  input.size = compressed_direct_buf_len;
+  input.pos = 0;
+  output.dst = uncompressed_bytes;
+  output.size = uncompressed_direct_buf_len;
+  output.pos = 0;
+
+  rv = dlsym_ZSTD_decompressStream(context, &output, &input);
+  if (dlsym_ZSTD_isError(rv)) {
+    THROW(env, "java/io/IOException", dlsym_ZSTD_getErrorName(rv));
+    return (jint)0;
+  }
+  // 0 once a frame is decoded and all of it handed out
+  if (rv == 0) {
+    (*env)->SetBooleanField(env, thisj, ZStandardDecompressor_finished, JNI_TRUE);
+  }
+
+  (*env)->SetIntField(env, thisj, ZStandardDecompressor_compressedDirectBufOff,
+        compressed_direct_buf_off + (jint)input.pos);
+  (*env)->SetIntField(env, thisj, ZStandardDecompressor_compressedDirectBufLen,
+        compressed_direct_buf_len - (jint)input.pos);
+  return (jint)output.pos;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardDecompressor_reset
+(JNIEnv *env, jclass clazz, jlong stream){
+  // Expect a new frame, keeping the window limit and dictionary
+  size_t rv = dlsym_ZSTD_DCtx_reset(ZSTD_CONTEXT(stream), ZSTD_reset_session_only);
+
+  if (dlsym_ZSTD_isError(rv)) {
+    THROW(env, "java/lang/InternalError", dlsym_ZSTD_getErrorName(rv));
+  }
+}
+
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_compress_zstd_ZStandardDecompressor_end
+(JNIEnv *env, jclass clazz, jlong stream){
+  dlsym_ZSTD_freeDCtx(ZSTD_CONTEXT(stream));
+}
+#endif //define HADOOP_ZSTD_LIBRARY
@@ -95,6 +95,6 @@ void dumpDecoder(IsalDecoder* pCoder) {
 
   printf("DecodeMatrix:\n");
   dumpCodingMatrix((unsigned char*) pCoder->decodeMatrix,
-                                    numDataUnits, numAllUnits);
+                                    pCoder->numErased, numDataUnits);
 }
 
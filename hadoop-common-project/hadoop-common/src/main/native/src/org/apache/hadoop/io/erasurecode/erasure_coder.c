@@ -43,10 +43,27 @@ static void initEncodeMatrix(int numDataUnits, int numParityUnits,
                           numDataUnits + numParityUnits, numDataUnits);
 }
 
-void initEncoder(IsalEncoder* pCoder, int numDataUnits,
+int isValidCoder(int numDataUnits, int numParityUnits) {
+  return numDataUnits > 0 && numDataUnits <= KMAX && numParityUnits > 0 &&
+      numDataUnits + numParityUnits <= MMAX;
+}
+
+int initEncoder(IsalEncoder* pCoder, int numDataUnits,
                             int numParityUnits) {
+  if (!isValidCoder(numDataUnits, numParityUnits)) {
+    return -1;
+  }
+
   initCoder(&pCoder->coder, numDataUnits, numParityUnits);
 
+  pCoder->gftbls = EC_MALLOC(numDataUnits * numParityUnits * 32);
+  pCoder->encodeMatrix = EC_MALLOC((numDataUnits + numParityUnits) *
+                                      numDataUnits);
+  if (pCoder->gftbls == NULL || pCoder->encodeMatrix == NULL) {
+    destroyEncoder(pCoder);
+    return -1;
+  }
+
   initEncodeMatrix(numDataUnits, numParityUnits, pCoder->encodeMatrix);
 
   // Generate gftbls from encode matrix
@@ -57,13 +74,72 @@ void initEncoder(IsalEncoder* pCoder, int numDataUnits,
   if (pCoder->coder.verbose > 0) {
     dumpEncoder(pCoder);
   }
+
+  return 0;
 }
 
-void initDecoder(IsalDecoder* pCoder, int numDataUnits,
+void destroyEncoder(IsalEncoder* pCoder) {
+  EC_FREE(pCoder->gftbls);
+  EC_FREE(pCoder->encodeMatrix);
+  pCoder->gftbls = NULL;
+  pCoder->encodeMatrix = NULL;
+}
+
+int initDecoder(IsalDecoder* pCoder, int numDataUnits,
                                   int numParityUnits) {
+  size_t tablesSize = numDataUnits * numParityUnits * 32;
+  unsigned char* cacheTables;
+  int i;
+
+  if (!isValidCoder(numDataUnits, numParityUnits)) {
+    return -1;
+  }
+
   initCoder(&pCoder->coder, numDataUnits, numParityUnits);
 
+  memset(pCoder->decodeCache, 0, sizeof(pCoder->decodeCache));
+  pCoder->decodeCacheClock = 0;
+
+  pCoder->encodeMatrix = EC_MALLOC((numDataUnits + numParityUnits) *
+                                      numDataUnits);
+  pCoder->gftbls = EC_MALLOC(tablesSize);
+  pCoder->tmpMatrix = EC_MALLOC(numDataUnits * numDataUnits);
+  pCoder->invertMatrix = EC_MALLOC(numDataUnits * numDataUnits);
+  pCoder->decodeMatrix = EC_MALLOC(numParityUnits * numDataUnits);
+  // The tables of all the cache entries are one allocation, owned by the
+  // first entry
+  cacheTables = EC_MALLOC(DECODE_CACHE_SIZE * tablesSize);
+  if (pCoder->encodeMatrix == NULL || pCoder->gftbls == NULL ||
+      pCoder->tmpMatrix == NULL || pCoder->invertMatrix == NULL ||
+      pCoder->decodeMatrix == NULL || cacheTables == NULL) {
+    EC_FREE(cacheTables);
+    destroyDecoder(pCoder);
+    return -1;
+  }
+  for (i = 0; i < DECODE_CACHE_SIZE; i++) {
+    pCoder->decodeCache[i].gftbls = cacheTables + i * tablesSize;
+  }
+
   initEncodeMatrix(numDataUnits, numParityUnits, pCoder->encodeMatrix);
+
+  clearDecoder(pCoder);
+
+  return 0;
+}
+
+void destroyDecoder(IsalDecoder* pCoder) {
+  EC_FREE(pCoder->encodeMatrix);
+  EC_FREE(pCoder->gftbls);
+  EC_FREE(pCoder->tmpMatrix);
+  EC_FREE(pCoder->invertMatrix);
+  EC_FREE(pCoder->decodeMatrix);
+  EC_FREE(pCoder->decodeCache[0].gftbls);
+  pCoder->encodeMatrix = NULL;
+  pCoder->gftbls = NULL;
+  pCoder->tmpMatrix = NULL;
+  pCoder->invertMatrix = NULL;
+  pCoder->decodeMatrix = NULL;
+  memset(pCoder->decodeCache, 0, sizeof(pCoder->decodeCache));
 }
 
 int encode(IsalEncoder* pCoder, unsigned char** dataUnits,
@@ -82,6 +158,21 @@ int encode(IsalEncoder* pCoder, unsigned char** dataUnits,
   return 0;
 }
 
+int encodeUpdate(IsalEncoder* pCoder, unsigned char* dataUnit,
+    int dataUnitIndex, unsigned char** parityUnits, int chunkSize) {
+  int numDataUnits = pCoder->coder.numDataUnits;
+  int numParityUnits = pCoder->coder.numParityUnits;
+
+  if (dataUnitIndex < 0 || dataUnitIndex >= numDataUnits) {
+    return -1;
+  }
+
+  h_ec_encode_data_update(chunkSize, numDataUnits, numParityUnits,
+      dataUnitIndex, pCoder->gftbls, dataUnit, parityUnits);
+
+  return 0;
+}
+
 // Return 1 when diff, 0 otherwise
 static int compare(int* arr1, int len1, int* arr2, int len2) {
   int i;
@@ -98,11 +189,63 @@ static int compare(int* arr1, int len1, int* arr2, int len2) {
   return 1;
 }
 
+static unsigned int decodeInputMask(IsalDecoder* pCoder) {
+  unsigned int mask = 0;
+  int i;
+
+  for (i = 0; i < pCoder->coder.numDataUnits; i++) {
+    mask |= 1U << pCoder->decodeIndex[i];
+  }
+  return mask;
+}
+
+// Load the tables of the current erasures if they are cached.
+// Return 1 when found, 0 otherwise
+static int lookupDecodeCache(IsalDecoder* pCoder, unsigned int inputMask) {
+  IsalDecodeCacheEntry* entry;
+  int i;
+
+  for (i = 0; i < DECODE_CACHE_SIZE; i++) {
+    entry = &pCoder->decodeCache[i];
+    if (entry->inputMask == inputMask &&
+            compare(entry->erasedIndexes, entry->numErased,
+                    pCoder->erasedIndexes, pCoder->numErased) == 0) {
+      entry->lastUsed = ++pCoder->decodeCacheClock;
+      memcpy(pCoder->gftbls, entry->gftbls,
+          pCoder->coder.numDataUnits * pCoder->numErased * 32);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Keep the tables of the current erasures in place of the least recently
+// used ones
+static void storeDecodeCache(IsalDecoder* pCoder, unsigned int inputMask) {
+  IsalDecodeCacheEntry* entry = &pCoder->decodeCache[0];
+  int i;
+
+  for (i = 1; i < DECODE_CACHE_SIZE; i++) {
+    if (pCoder->decodeCache[i].lastUsed < entry->lastUsed) {
+      entry = &pCoder->decodeCache[i];
+    }
+  }
+
+  entry->inputMask = inputMask;
+  memcpy(entry->erasedIndexes, pCoder->erasedIndexes,
+      sizeof(entry->erasedIndexes));
+  entry->numErased = pCoder->numErased;
+  entry->lastUsed = ++pCoder->decodeCacheClock;
+  memcpy(entry->gftbls, pCoder->gftbls,
+      pCoder->coder.numDataUnits * pCoder->numErased * 32);
+}
+
 static int processErasures(IsalDecoder* pCoder, unsigned char** inputs,
                                     int* erasedIndexes, int numErased) {
   int i, r, ret, index;
   int numDataUnits = pCoder->coder.numDataUnits;
   int isChanged = 0;
+  unsigned int inputMask;
 
   for (i = 0, r = 0; i < numDataUnits; i++, r++) {
     while (inputs[r] == NULL) {
@@ -138,6 +281,13 @@ static int processErasures(IsalDecoder* pCoder, unsigned char** inputs,
 
   pCoder->numErased = numErased;
 
+  // The decode and invert matrices are only needed to build the tables, so
+  // they are left cleared when the tables come from the cache
+  inputMask = decodeInputMask(pCoder);
+  if (lookupDecodeCache(pCoder, inputMask)) {
+    return 0;
+  }
+
   ret = generateDecodeMatrix(pCoder);
   if (ret != 0) {
     printf("Failed to generate decode matrix\n");
@@ -147,6 +297,8 @@ static int processErasures(IsalDecoder* pCoder, unsigned char** inputs,
   h_ec_init_tables(numDataUnits, pCoder->numErased,
                       pCoder->decodeMatrix, pCoder->gftbls);
 
+  storeDecodeCache(pCoder, inputMask);
+
   if (pCoder->coder.verbose > 0) {
     dumpDecoder(pCoder);
   }
@@ -154,32 +306,49 @@ static int processErasures(IsalDecoder* pCoder, unsigned char** inputs,
   return 0;
 }
 
-int decode(IsalDecoder* pCoder, unsigned char** inputs,
-                  int* erasedIndexes, int numErased,
-                   unsigned char** outputs, int chunkSize) {
+int prepareDecode(IsalDecoder* pCoder, unsigned char** inputs,
+                  int* erasedIndexes, int numErased) {
+  return processErasures(pCoder, inputs, erasedIndexes, numErased);
+}
+
+void decodeRange(IsalDecoder* pCoder, unsigned char** outputs,
+                 int offset, int len) {
   int numDataUnits = pCoder->coder.numDataUnits;
+  unsigned char* rangeInputs[MMAX];
+  unsigned char* rangeOutputs[MMAX];
   int i;
 
-  processErasures(pCoder, inputs, erasedIndexes, numErased);
-
-  for (i = 0; i < numErased; i++) {
-    memset(outputs[i], 0, chunkSize);
+  for (i = 0; i < numDataUnits; i++) {
+    rangeInputs[i] = pCoder->realInputs[i] + offset;
+  }
+  for (i = 0; i < pCoder->numErased; i++) {
+    rangeOutputs[i] = outputs[i] + offset;
+    memset(rangeOutputs[i], 0, len);
   }
 
-  h_ec_encode_data(chunkSize, numDataUnits, pCoder->numErased,
-      pCoder->gftbls, pCoder->realInputs, outputs);
+  h_ec_encode_data(len, numDataUnits, pCoder->numErased,
+      pCoder->gftbls, rangeInputs, rangeOutputs);
+}
 
+int decode(IsalDecoder* pCoder, unsigned char** inputs,
+                  int* erasedIndexes, int numErased,
+                   unsigned char** outputs, int chunkSize) {
+  prepareDecode(pCoder, inputs, erasedIndexes, numErased);
+  decodeRange(pCoder, outputs, 0, chunkSize);
   return 0;
 }
 
 // Clear variables used per decode call
 void clearDecoder(IsalDecoder* decoder) {
+  int numDataUnits = decoder->coder.numDataUnits;
+  int numParityUnits = decoder->coder.numParityUnits;
+
   decoder->numErasedDataUnits = 0;
   decoder->numErased = 0;
-  memset(decoder->gftbls, 0, sizeof(decoder->gftbls));
-  memset(decoder->decodeMatrix, 0, sizeof(decoder->decodeMatrix));
-  memset(decoder->tmpMatrix, 0, sizeof(decoder->tmpMatrix));
-  memset(decoder->invertMatrix, 0, sizeof(decoder->invertMatrix));
+  memset(decoder->gftbls, 0, numDataUnits * numParityUnits * 32);
+  memset(decoder->decodeMatrix, 0, numParityUnits * numDataUnits);
+  memset(decoder->tmpMatrix, 0, numDataUnits * numDataUnits);
+  memset(decoder->invertMatrix, 0, numDataUnits * numDataUnits);
   memset(decoder->erasureFlags, 0, sizeof(decoder->erasureFlags));
   memset(decoder->erasedIndexes, 0, sizeof(decoder->erasedIndexes));
 }
@@ -30,8 +30,20 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define MMAX 14
-#define KMAX 10
+#include "org/apache/hadoop/util/native_memory.h"
+
+// The state of the coders is accounted as erasure code memory
+#define EC_MALLOC(size) native_memory_malloc(NATIVE_MEMORY_ERASURE_CODE, (size))
+#define EC_FREE(ptr) native_memory_free(NATIVE_MEMORY_ERASURE_CODE, (ptr))
+
+// The most units of a coder, data and parity together, which is also the
+// number of bits in the input mask of a decode
+#define MMAX 32
+// The most data units of a coder
+#define KMAX 24
+
+// How many erasure patterns a decoder keeps the tables of
+#define DECODE_CACHE_SIZE 8
 
 typedef struct _IsalCoder {
   int verbose;
@@ -40,25 +52,50 @@ typedef struct _IsalCoder {
   int numAllUnits;
 } IsalCoder;
 
+// The matrices and tables are sized for the units of the coder, and
+// allocated by initEncoder and initDecoder
 typedef struct _IsalEncoder {
   IsalCoder coder;
 
-  unsigned char gftbls[MMAX * KMAX * 32];
+  // numDataUnits * numParityUnits * 32 bytes
+  unsigned char* gftbls;
 
-  unsigned char encodeMatrix[MMAX * KMAX];
+  // numAllUnits * numDataUnits bytes
+  unsigned char* encodeMatrix;
 } IsalEncoder;
 
+// The tables of one erasure pattern
+typedef struct _IsalDecodeCacheEntry {
+  // The units the pattern reads, one bit per unit, 0 if the entry is free
+  unsigned int inputMask;
+  int erasedIndexes[MMAX];
+  int numErased;
+  // The value of decodeCacheClock when the entry was last used
+  unsigned long lastUsed;
+  // numDataUnits * numParityUnits * 32 bytes
+  unsigned char* gftbls;
+} IsalDecodeCacheEntry;
+
 typedef struct _IsalDecoder {
   IsalCoder coder;
 
-  unsigned char encodeMatrix[MMAX * KMAX];
+  // numAllUnits * numDataUnits bytes
+  unsigned char* encodeMatrix;
+
+  // Least recently used erasure patterns, so that stripes alternating
+  // between a few of them do not regenerate the tables every time
+  IsalDecodeCacheEntry decodeCache[DECODE_CACHE_SIZE];
+  unsigned long decodeCacheClock;
 
   // Below are per decode call
-  unsigned char gftbls[MMAX * KMAX * 32];
+  // numDataUnits * numParityUnits * 32 bytes
+  unsigned char* gftbls;
   unsigned int decodeIndex[MMAX];
-  unsigned char tmpMatrix[MMAX * KMAX];
-  unsigned char invertMatrix[MMAX * KMAX];
-  unsigned char decodeMatrix[MMAX * KMAX];
+  // numDataUnits * numDataUnits bytes
+  unsigned char* tmpMatrix;
+  unsigned char* invertMatrix;
+  // numParityUnits * numDataUnits bytes
+  unsigned char* decodeMatrix;
   unsigned char erasureFlags[MMAX];
   int erasedIndexes[MMAX];
   int numErased;
@@ -70,19 +107,45 @@ void initCoder(IsalCoder* pCoder, int numDataUnits, int numParityUnits);
 
 void allowVerbose(IsalCoder* pCoder, int flag);
 
-void initEncoder(IsalEncoder* encoder, int numDataUnits, int numParityUnits);
+// Return 1 when a coder can have these units, 0 otherwise
+int isValidCoder(int numDataUnits, int numParityUnits);
 
-void initDecoder(IsalDecoder* decoder, int numDataUnits, int numParityUnits);
+// Return 0 on success, -1 when out of memory or the units are not valid
+int initEncoder(IsalEncoder* encoder, int numDataUnits, int numParityUnits);
+
+// Release what initEncoder allocated, but not the encoder itself
+void destroyEncoder(IsalEncoder* encoder);
+
+// Return 0 on success, -1 when out of memory or the units are not valid
+int initDecoder(IsalDecoder* decoder, int numDataUnits, int numParityUnits);
+
+// Release what initDecoder allocated, but not the decoder itself
+void destroyDecoder(IsalDecoder* decoder);
 
 void clearDecoder(IsalDecoder* decoder);
 
 int encode(IsalEncoder* encoder, unsigned char** dataUnits,
     unsigned char** parityUnits, int chunkSize);
 
+// Fold one data unit into the parity units, which must be zero before the
+// first unit of a stripe is folded in. The units may come in any order
+int encodeUpdate(IsalEncoder* encoder, unsigned char* dataUnit,
+    int dataUnitIndex, unsigned char** parityUnits, int chunkSize);
+
 int decode(IsalDecoder* decoder, unsigned char** allUnits,
     int* erasedIndexes, int numErased,
     unsigned char** recoveredUnits, int chunkSize);
 
+// Compute the tables of an erasure pattern, or take them from the cache.
+// Afterwards decodeRange may decode any parts of the units, on several
+// threads at once, since it only reads the decoder
+int prepareDecode(IsalDecoder* decoder, unsigned char** allUnits,
+    int* erasedIndexes, int numErased);
+
+// Decode len bytes from offset of the units given to the last prepareDecode
+void decodeRange(IsalDecoder* decoder, unsigned char** recoveredUnits,
+    int offset, int len);
+
 int generateDecodeMatrix(IsalDecoder* pCoder);
 
 #endif //_ERASURE_CODER_H_
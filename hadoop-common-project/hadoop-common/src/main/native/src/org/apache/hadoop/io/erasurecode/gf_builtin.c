@@ -0,0 +1,362 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "isal_load.h"
+#include "gf_builtin.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GF_BUILTIN_X86
+#elif defined(__GNUC__) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GF_BUILTIN_NEON
+#endif
+
+// GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1, as in ISA-L
+#define GF_POLY 0x1d
+
+static unsigned char gfMulSlow(unsigned char a, unsigned char b) {
+  unsigned char p = 0;
+
+  while (b) {
+    if (b & 1) {
+      p ^= a;
+    }
+    a = (unsigned char)((a << 1) ^ ((a & 0x80) ? GF_POLY : 0));
+    b >>= 1;
+  }
+  return p;
+}
+
+static unsigned char builtin_gf_mul(unsigned char a, unsigned char b) {
+  return gfMulSlow(a, b);
+}
+
+static unsigned char builtin_gf_inv(unsigned char a) {
+  unsigned char p = 1;
+  int i;
+
+  if (a == 0) {
+    return 0;
+  }
+  // a^254 is the inverse, since a^255 is 1
+  for (i = 0; i < 254; i++) {
+    p = gfMulSlow(p, a);
+  }
+  return p;
+}
+
+static void builtin_gf_gen_rs_matrix(unsigned char *a, int m, int k) {
+  unsigned char p, gen = 1;
+  int i, j;
+
+  memset(a, 0, k * m);
+  for (i = 0; i < k; i++) {
+    a[k * i + i] = 1;
+  }
+  for (i = k; i < m; i++) {
+    p = 1;
+    for (j = 0; j < k; j++) {
+      a[k * i + j] = p;
+      p = gfMulSlow(p, gen);
+    }
+    gen = gfMulSlow(gen, 2);
+  }
+}
+
+static void builtin_gf_gen_cauchy_matrix(unsigned char *a, int m, int k) {
+  unsigned char* p;
+  int i, j;
+
+  memset(a, 0, k * m);
+  for (i = 0; i < k; i++) {
+    a[k * i + i] = 1;
+  }
+  p = &a[k * k];
+  for (i = k; i < m; i++) {
+    for (j = 0; j < k; j++) {
+      *p++ = builtin_gf_inv((unsigned char)(i ^ j));
+    }
+  }
+}
+
+static int builtin_gf_invert_matrix(unsigned char *in, unsigned char *out,
+                                    const int n) {
+  unsigned char temp;
+  int i, j, c;
+
+  memset(out, 0, n * n);
+  for (i = 0; i < n; i++) {
+    out[i * n + i] = 1;
+  }
+
+  for (i = 0; i < n; i++) {
+    // Swap in a row with a non-zero pivot
+    if (in[i * n + i] == 0) {
+      for (j = i + 1; j < n && in[j * n + i] == 0; j++) {
+      }
+      if (j == n) {
+        return -1; // Singular
+      }
+      for (c = 0; c < n; c++) {
+        temp = in[i * n + c];
+        in[i * n + c] = in[j * n + c];
+        in[j * n + c] = temp;
+        temp = out[i * n + c];
+        out[i * n + c] = out[j * n + c];
+        out[j * n + c] = temp;
+      }
+    }
+
+    temp = builtin_gf_inv(in[i * n + i]);
+    for (c = 0; c < n; c++) {
+      in[i * n + c] = gfMulSlow(in[i * n + c], temp);
+      out[i * n + c] = gfMulSlow(out[i * n + c], temp);
+    }
+
+    for (j = 0; j < n; j++) {
+      if (j == i) {
+        continue;
+      }
+      temp = in[j * n + i];
+      for (c = 0; c < n; c++) {
+        out[j * n + c] ^= gfMulSlow(temp, out[i * n + c]);
+        in[j * n + c] ^= gfMulSlow(temp, in[i * n + c]);
+      }
+    }
+  }
+  return 0;
+}
+
+// The products of c with every low nibble, then with every high nibble
+static void gfVectMulInit(unsigned char c, unsigned char* tbl) {
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    tbl[i] = gfMulSlow(c, (unsigned char)i);
+    tbl[16 + i] = gfMulSlow(c, (unsigned char)(i << 4));
+  }
+}
+
+static void builtin_ec_init_tables(int k, int rows, unsigned char* a,
+                                   unsigned char* gftbls) {
+  int i;
+
+  for (i = 0; i < k * rows; i++) {
+    gfVectMulInit(a[i], gftbls + i * 32);
+  }
+}
+
+/**
+ * Set or xor into each of the rows of coding the dot product of the data
+ * units with the row of tables, from byte off to len.  The tables of data
+ * unit j for row l are at gftbls[(l * k + j) * 32].
+ */
+static void dotProdBytes(int off, int len, int k, int rows,
+                         unsigned char* gftbls, unsigned char** data,
+                         unsigned char** coding, int update) {
+  unsigned char products[256];
+  unsigned char* tbl;
+  unsigned char* in;
+  unsigned char* out;
+  int i, j, l;
+
+  if (off >= len) {
+    return;
+  }
+  // A unit at a time, so that each pass reads and writes sequentially
+  for (l = 0; l < rows; l++) {
+    out = coding[l];
+    if (!update) {
+      memset(out + off, 0, len - off);
+    }
+    for (j = 0; j < k; j++) {
+      tbl = gftbls + (l * k + j) * 32;
+      in = data[j];
+      if (len - off < (int)sizeof(products)) {
+        for (i = off; i < len; i++) {
+          out[i] ^= tbl[in[i] & 0x0f] ^ tbl[16 + (in[i] >> 4)];
+        }
+        continue;
+      }
+      // Long enough to pay for one lookup per byte instead of two
+      for (i = 0; i < 256; i++) {
+        products[i] = tbl[i & 0x0f] ^ tbl[16 + (i >> 4)];
+      }
+      for (i = off; i < len; i++) {
+        out[i] ^= products[in[i]];
+      }
+    }
+  }
+}
+
+#ifdef GF_BUILTIN_X86
+
+__attribute__ ((target("avx512bw")))
+static int dotProdAvx512(int len, int k, int rows, unsigned char* gftbls,
+                         unsigned char** data, unsigned char** coding,
+                         int update) {
+  const __m512i mask = _mm512_set1_epi8(0x0f);
+  __m512i s, b, lo, hi;
+  unsigned char* tbl;
+  int i, j, l;
+
+  for (i = 0; i + 64 <= len; i += 64) {
+    for (l = 0; l < rows; l++) {
+      s = update ? _mm512_loadu_si512((const void*)(coding[l] + i))
+                 : _mm512_setzero_si512();
+      for (j = 0; j < k; j++) {
+        tbl = gftbls + (l * k + j) * 32;
+        b = _mm512_loadu_si512((const void*)(data[j] + i));
+        lo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)tbl));
+        hi = _mm512_broadcast_i32x4(
+            _mm_loadu_si128((const __m128i*)(tbl + 16)));
+        lo = _mm512_shuffle_epi8(lo, _mm512_and_si512(b, mask));
+        hi = _mm512_shuffle_epi8(hi,
+            _mm512_and_si512(_mm512_srli_epi64(b, 4), mask));
+        s = _mm512_ternarylogic_epi64(s, lo, hi, 0x96);
+      }
+      _mm512_storeu_si512((void*)(coding[l] + i), s);
+    }
+  }
+  return i;
+}
+
+__attribute__ ((target("avx2")))
+static int dotProdAvx2(int len, int k, int rows, unsigned char* gftbls,
+                       unsigned char** data, unsigned char** coding,
+                       int update) {
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  __m256i s, b, lo, hi;
+  unsigned char* tbl;
+  int i, j, l;
+
+  for (i = 0; i + 32 <= len; i += 32) {
+    for (l = 0; l < rows; l++) {
+      s = update ? _mm256_loadu_si256((const __m256i*)(coding[l] + i))
+                 : _mm256_setzero_si256();
+      for (j = 0; j < k; j++) {
+        tbl = gftbls + (l * k + j) * 32;
+        b = _mm256_loadu_si256((const __m256i*)(data[j] + i));
+        lo = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)tbl));
+        hi = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*)(tbl + 16)));
+        lo = _mm256_shuffle_epi8(lo, _mm256_and_si256(b, mask));
+        hi = _mm256_shuffle_epi8(hi,
+            _mm256_and_si256(_mm256_srli_epi64(b, 4), mask));
+        s = _mm256_xor_si256(s, _mm256_xor_si256(lo, hi));
+      }
+      _mm256_storeu_si256((__m256i*)(coding[l] + i), s);
+    }
+  }
+  return i;
+}
+
+#endif
+
+#ifdef GF_BUILTIN_NEON
+
+static int dotProdNeon(int len, int k, int rows, unsigned char* gftbls,
+                       unsigned char** data, unsigned char** coding,
+                       int update) {
+  const uint8x16_t mask = vdupq_n_u8(0x0f);
+  uint8x16_t s, b;
+  unsigned char* tbl;
+  int i, j, l;
+
+  for (i = 0; i + 16 <= len; i += 16) {
+    for (l = 0; l < rows; l++) {
+      s = update ? vld1q_u8(coding[l] + i) : vdupq_n_u8(0);
+      for (j = 0; j < k; j++) {
+        tbl = gftbls + (l * k + j) * 32;
+        b = vld1q_u8(data[j] + i);
+        s = veorq_u8(s, vqtbl1q_u8(vld1q_u8(tbl), vandq_u8(b, mask)));
+        s = veorq_u8(s, vqtbl1q_u8(vld1q_u8(tbl + 16), vshrq_n_u8(b, 4)));
+      }
+      vst1q_u8(coding[l] + i, s);
+    }
+  }
+  return i;
+}
+
+#endif
+
+static void dotProd(int len, int k, int rows, unsigned char* gftbls,
+                    unsigned char** data, unsigned char** coding,
+                    int update) {
+  int done = 0;
+
+#ifdef GF_BUILTIN_X86
+  if (__builtin_cpu_supports("avx512bw")) {
+    done = dotProdAvx512(len, k, rows, gftbls, data, coding, update);
+  } else if (__builtin_cpu_supports("avx2")) {
+    done = dotProdAvx2(len, k, rows, gftbls, data, coding, update);
+  }
+#endif
+#ifdef GF_BUILTIN_NEON
+  done = dotProdNeon(len, k, rows, gftbls, data, coding, update);
+#endif
+
+  dotProdBytes(done, len, k, rows, gftbls, data, coding, update);
+}
+
+static void builtin_ec_encode_data(int len, int k, int rows,
+                                   unsigned char* gftbls,
+                                   unsigned char** data,
+                                   unsigned char** coding) {
+  dotProd(len, k, rows, gftbls, data, coding, 0);
+}
+
+static void builtin_ec_encode_data_update(int len, int k, int rows,
+                                          int vec_i, unsigned char* gftbls,
+                                          unsigned char* data,
+                                          unsigned char** coding) {
+  int l;
+
+  // One data unit against the tables of its column, one row at a time
+  for (l = 0; l < rows; l++) {
+    dotProd(len, 1, 1, gftbls + (l * k + vec_i) * 32, &data,
+            &coding[l], 1);
+  }
+}
+
+static int builtin_gf_vect_mul(int len, unsigned char* gftbl, void* src,
+                               void* dest) {
+  unsigned char* data = src;
+  unsigned char* coding = dest;
+
+  dotProd(len, 1, 1, gftbl, &data, &coding, 0);
+  return 0;
+}
+
+void load_builtin_functions(IsaLibLoader* loader) {
+  loader->gf_mul = builtin_gf_mul;
+  loader->gf_inv = builtin_gf_inv;
+  loader->gf_gen_rs_matrix = builtin_gf_gen_rs_matrix;
+  loader->gf_gen_cauchy_matrix = builtin_gf_gen_cauchy_matrix;
+  loader->gf_invert_matrix = builtin_gf_invert_matrix;
+  loader->gf_vect_mul = builtin_gf_vect_mul;
+  loader->ec_init_tables = builtin_ec_init_tables;
+  loader->ec_encode_data = builtin_ec_encode_data;
+  loader->ec_encode_data_update = builtin_ec_encode_data_update;
+  loader->xor_gen = NULL;
+}
@@ -0,0 +1,40 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GF_BUILTIN_H_
+#define _GF_BUILTIN_H_
+
+#include "isal_load.h"
+
+/**
+ *  A built-in implementation of the ISA-L functions isal_load.c looks up,
+ *  for when the library can't be loaded.  It uses the same field, the same
+ *  matrices and the same 32 byte multiplication tables as ISA-L, so its
+ *  output is interchangeable with it and with the Java coders.
+ *
+ *  Products are looked up in the tables a nibble at a time, 32 bytes at a
+ *  time with PSHUFB on x86-64 with AVX2 and 16 bytes at a time with TBL on
+ *  aarch64, as ISA-L does, and a byte at a time elsewhere.
+ */
+
+/**
+ * Point the functions of the loader to the built-in ones.
+ */
+void load_builtin_functions(IsaLibLoader* loader);
+
+#endif //_GF_BUILTIN_H_
@@ -22,6 +22,7 @@
 
 #include "org_apache_hadoop.h"
 #include "isal_load.h"
+#include "gf_builtin.h"
 
 #ifdef UNIX
 #include <sys/time.h>
@@ -41,11 +42,13 @@ IsaLibLoader* isaLoader;
 /**
  *  isal_load.c
  *  Utility of loading the ISA-L library and the required functions.
- *  Building of this codes won't rely on any ISA-L source codes, but running
- *  into this will rely on successfully loading of the dynamic library.
+ *  Building of this codes won't rely on any ISA-L source codes.  When the
+ *  dynamic library can't be loaded at run time, or libhadoop was built
+ *  without it, the built-in functions of gf_builtin.c are used instead.
  *
  */
 
+#ifdef HADOOP_ISAL_LIBRARY
 static const char* load_functions() {
 #ifdef UNIX
   EC_LOAD_DYNAMIC_SYMBOL((isaLoader->gf_mul), "gf_mul");
@@ -58,6 +61,8 @@ static const char* load_functions() {
   EC_LOAD_DYNAMIC_SYMBOL((isaLoader->ec_init_tables), "ec_init_tables");
   EC_LOAD_DYNAMIC_SYMBOL((isaLoader->ec_encode_data), "ec_encode_data");
   EC_LOAD_DYNAMIC_SYMBOL((isaLoader->ec_encode_data_update), "ec_encode_data_update");
+
+  isaLoader->xor_gen = myDlsym(isaLoader->libec, "xor_gen");
 #endif
 
 #ifdef WINDOWS
@@ -71,13 +76,18 @@ static const char* load_functions() {
   EC_LOAD_DYNAMIC_SYMBOL(__d_ec_init_tables, (isaLoader->ec_init_tables), "ec_init_tables");
   EC_LOAD_DYNAMIC_SYMBOL(__d_ec_encode_data, (isaLoader->ec_encode_data), "ec_encode_data");
   EC_LOAD_DYNAMIC_SYMBOL(__d_ec_encode_data_update, (isaLoader->ec_encode_data_update), "ec_encode_data_update");
+
+  isaLoader->xor_gen = (__d_xor_gen)myDlsym(isaLoader->libec, "xor_gen");
 #endif
 
   return NULL;
 }
+#endif
 
 void load_erasurecode_lib(char* err, size_t err_len) {
+#ifdef HADOOP_ISAL_LIBRARY
   const char* errMsg;
+#endif
 
   err[0] = '\0';
 
@@ -87,12 +97,15 @@ void load_erasurecode_lib(char* err, size_t err_len) {
   isaLoader = calloc(1, sizeof(IsaLibLoader));
   memset(isaLoader, 0, sizeof(IsaLibLoader));
 
+#ifndef HADOOP_ISAL_LIBRARY
+  // Built without ISA-L, nothing to load
+  load_builtin_functions(isaLoader);
+#else
   // Load Intel ISA-L
   #ifdef UNIX
   isaLoader->libec = dlopen(HADOOP_ISAL_LIBRARY, RTLD_LAZY | RTLD_GLOBAL);
   if (isaLoader->libec == NULL) {
-    snprintf(err, err_len, "Failed to load %s (%s)",
-                             HADOOP_ISAL_LIBRARY, dlerror());
+    load_builtin_functions(isaLoader);
     return;
   }
   // Clear any existing error
@@ -102,32 +115,43 @@ void load_erasurecode_lib(char* err, size_t err_len) {
   #ifdef WINDOWS
   isaLoader->libec = LoadLibrary(HADOOP_ISAL_LIBRARY);
   if (isaLoader->libec == NULL) {
-    snprintf(err, err_len, "Failed to load %s", HADOOP_ISAL_LIBRARY);
+    load_builtin_functions(isaLoader);
     return;
   }
   #endif
 
   errMsg = load_functions(isaLoader->libec);
   if (errMsg != NULL) {
-    snprintf(err, err_len, "Loading functions from ISA-L failed: %s", errMsg);
+    // Don't mix functions of the library with built-in ones
+    #ifdef UNIX
+    dlclose(isaLoader->libec);
+    #endif
+    #ifdef WINDOWS
+    FreeLibrary(isaLoader->libec);
+    #endif
+    isaLoader->libec = NULL;
+    load_builtin_functions(isaLoader);
   }
+#endif
 }
 
 int build_support_erasurecode() {
-#ifdef HADOOP_ISAL_LIBRARY
   return 1;
-#else
-  return 0;
-#endif
 }
 
 const char* get_library_name() {
 #ifdef UNIX
   Dl_info dl_info;
 
+  if (isaLoader->libec == NULL && isaLoader->ec_encode_data != NULL) {
+    return "built-in";
+  }
+
+#ifdef HADOOP_ISAL_LIBRARY
   if (isaLoader->ec_encode_data == NULL) {
     return HADOOP_ISAL_LIBRARY;
   }
+#endif
 
   if(dladdr(isaLoader->ec_encode_data, &dl_info)) {
     return dl_info.dli_fname;
@@ -136,7 +160,11 @@ const char* get_library_name() {
   LPTSTR filename = NULL;
 
   if (isaLoader->libec == NULL) {
-    return HADOOP_ISAL_LIBRARY;
+#ifdef HADOOP_ISAL_LIBRARY
+    return isaLoader->ec_encode_data != NULL ? "built-in" : HADOOP_ISAL_LIBRARY;
+#else
+    return "built-in";
+#endif
   }
 
   if (GetModuleFileName(isaLoader->libec, filename, 256) > 0) {
@@ -54,6 +54,9 @@ typedef void (*__d_ec_encode_data)(int, int, int, unsigned char*,
                                           unsigned char**, unsigned char**);
 typedef void (*__d_ec_encode_data_update)(int, int, int, int, unsigned char*,
                                              unsigned char*, unsigned char**);
+
+// For xor_code.h
+typedef int (*__d_xor_gen)(int, int, void**);
 #endif
 
 #ifdef WINDOWS
@@ -73,6 +76,9 @@ typedef void (__cdecl *__d_ec_encode_data)(int, int, int, unsigned char*,
                                              unsigned char**, unsigned char**);
 typedef void (__cdecl *__d_ec_encode_data_update)(int, int, int, int, unsigned char*,
                                              unsigned char*, unsigned char**);
+
+// For xor_code.h
+typedef int (__cdecl *__d_xor_gen)(int, int, void**);
 #endif
 
 typedef struct __IsaLibLoader {
@@ -88,6 +94,8 @@ typedef struct __IsaLibLoader {
   __d_ec_init_tables ec_init_tables;
   __d_ec_encode_data ec_encode_data;
   __d_ec_encode_data_update ec_encode_data_update;
+  // Optional, NULL if the library does not have it
+  __d_xor_gen xor_gen;
 } IsaLibLoader;
 
 extern IsaLibLoader* isaLoader;
@@ -129,7 +137,8 @@ static FARPROC WINAPI myDlsym(HMODULE handle, LPCSTR symbol) {
 #endif
 
 /**
- * Return 0 if not support, 1 otherwise.
+ * Return 0 if not support, 1 otherwise.  The coders are always built, on the
+ * functions of gf_builtin.c when libhadoop was built without ISA-L.
  */
 int build_support_erasurecode();
 
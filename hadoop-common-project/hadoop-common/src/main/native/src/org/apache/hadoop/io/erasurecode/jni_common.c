@@ -42,7 +42,7 @@ IsalCoder* getCoder(JNIEnv* env, jobject thiz) {
   jclass clazz = (*env)->GetObjectClass(env, thiz);
 
   jfieldID __verbose = (*env)->GetFieldID(env, clazz, "__native_verbose", "J");
-  int verbose = (int)(*env)->GetIntField(env, thiz, __verbose);
+  int verbose = (int)(*env)->GetLongField(env, thiz, __verbose);
 
   jfieldID __coderState = (*env)->GetFieldID(env, clazz, "__native_coder", "J");
   IsalCoder* pCoder = (IsalCoder*)(*env)->GetLongField(env,
@@ -61,6 +61,7 @@ void getInputs(JNIEnv *env, jobjectArray inputs, jintArray inputOffsets,
 
   if (numInputs != num) {
     THROW(env, "java/lang/InternalError", "Invalid inputs");
+    return;
   }
 
   tmpInputOffsets = (int*)(*env)->GetIntArrayElements(env,
@@ -71,10 +72,13 @@ void getInputs(JNIEnv *env, jobjectArray inputs, jintArray inputOffsets,
       destInputs[i] = (unsigned char *)((*env)->GetDirectBufferAddress(env,
                                                                 byteBuffer));
       destInputs[i] += tmpInputOffsets[i];
+      (*env)->DeleteLocalRef(env, byteBuffer);
     } else {
       destInputs[i] = NULL;
     }
   }
+  (*env)->ReleaseIntArrayElements(env, inputOffsets, (jint*)tmpInputOffsets,
+                                  JNI_ABORT);
 }
 
 void getOutputs(JNIEnv *env, jobjectArray outputs, jintArray outputOffsets,
@@ -85,6 +89,7 @@ void getOutputs(JNIEnv *env, jobjectArray outputs, jintArray outputOffsets,
 
   if (numOutputs != num) {
     THROW(env, "java/lang/InternalError", "Invalid outputs");
+    return;
   }
 
   tmpOutputOffsets = (int*)(*env)->GetIntArrayElements(env,
@@ -94,5 +99,9 @@ void getOutputs(JNIEnv *env, jobjectArray outputs, jintArray outputOffsets,
     destOutputs[i] = (unsigned char *)((*env)->GetDirectBufferAddress(env,
                                                                   byteBuffer));
     destOutputs[i] += tmpOutputOffsets[i];
+    (*env)->DeleteLocalRef(env, byteBuffer);
   }
+  (*env)->ReleaseIntArrayElements(env, outputOffsets,
+                                  (jint*)tmpOutputOffsets,
+                                  JNI_ABORT);
 }
\ No newline at end of file
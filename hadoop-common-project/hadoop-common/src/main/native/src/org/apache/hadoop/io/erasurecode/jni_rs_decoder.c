@@ -24,20 +24,92 @@
 #include "erasure_code.h"
 #include "gf_util.h"
 #include "jni_common.h"
+#include "org/apache/hadoop/util/worker_pool.h"
 #include "org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder.h"
 
+// Cells shorter than two of these are decoded on the calling thread, longer
+// ones are cut into slices of at least this size, one per thread
+#define DECODE_SLICE_MIN (64 * 1024)
+// Slices start on a multiple of this, to keep the SIMD kernels aligned
+#define DECODE_SLICE_ALIGN 64
+
 typedef struct _RSDecoder {
   IsalDecoder decoder;
   unsigned char* inputs[MMAX];
   unsigned char* outputs[MMAX];
 } RSDecoder;
 
+typedef struct _DecodeSlices {
+  IsalDecoder* decoder;
+  unsigned char** outputs;
+  int chunkSize;
+  int sliceSize;
+} DecodeSlices;
+
+static void decodeSlice(void* arg, int slice) {
+  DecodeSlices* slices = (DecodeSlices*)arg;
+  int offset = slice * slices->sliceSize;
+  int len = slices->chunkSize - offset;
+
+  if (len > slices->sliceSize) {
+    len = slices->sliceSize;
+  }
+  decodeRange(slices->decoder, slices->outputs, offset, len);
+}
+
+/**
+ * Decode the cells on up to threads threads of the shared native worker
+ * pool.  The tables of the erasure pattern are computed once, and every
+ * thread then reads them to decode its own slice of all the cells.
+ */
+static void decodeParallel(RSDecoder* rsDecoder, int* erasedIndexes,
+                           int numErased, int chunkSize, int threads) {
+  DecodeSlices slices;
+  int numSlices = chunkSize / DECODE_SLICE_MIN;
+
+  prepareDecode(&rsDecoder->decoder, rsDecoder->inputs, erasedIndexes,
+                numErased);
+  if (numSlices > threads) {
+    numSlices = threads;
+  }
+  if (numSlices < 2) {
+    decodeRange(&rsDecoder->decoder, rsDecoder->outputs, 0, chunkSize);
+    return;
+  }
+
+  slices.decoder = &rsDecoder->decoder;
+  slices.outputs = rsDecoder->outputs;
+  slices.chunkSize = chunkSize;
+  slices.sliceSize = (chunkSize + numSlices - 1) / numSlices;
+  slices.sliceSize = (slices.sliceSize + DECODE_SLICE_ALIGN - 1) &
+      ~(DECODE_SLICE_ALIGN - 1);
+  numSlices = (chunkSize + slices.sliceSize - 1) / slices.sliceSize;
+  run_tasks(decodeSlice, &slices, numSlices, threads);
+}
+
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder_initImpl(
 JNIEnv *env, jobject thiz, jint numDataUnits, jint numParityUnits) {
-  RSDecoder* rsDecoder = (RSDecoder*)malloc(sizeof(RSDecoder));
+  RSDecoder* rsDecoder;
+
+  if (!isValidCoder((int)numDataUnits, (int)numParityUnits)) {
+    THROW(env, "java/lang/IllegalArgumentException",
+          "Invalid number of units for the RS code");
+    return;
+  }
+
+  rsDecoder = (RSDecoder*)EC_MALLOC(sizeof(RSDecoder));
+  if (rsDecoder == NULL) {
+    THROW(env, "java/lang/OutOfMemoryError", "Failed to allocate the coder");
+    return;
+  }
   memset(rsDecoder, 0, sizeof(*rsDecoder));
-  initDecoder(&rsDecoder->decoder, (int)numDataUnits, (int)numParityUnits);
+  if (initDecoder(&rsDecoder->decoder, (int)numDataUnits,
+                  (int)numParityUnits)) {
+    EC_FREE(rsDecoder);
+    THROW(env, "java/lang/OutOfMemoryError", "Failed to allocate the coder");
+    return;
+  }
 
   setCoder(env, thiz, &rsDecoder->decoder.coder);
 }
@@ -46,7 +118,7 @@ JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder_decodeImpl(
 JNIEnv *env, jobject thiz, jobjectArray inputs, jintArray inputOffsets,
 jint dataLen, jintArray erasedIndexes, jobjectArray outputs,
-jintArray outputOffsets) {
+jintArray outputOffsets, jint threads) {
   RSDecoder* rsDecoder = (RSDecoder*)getCoder(env, thiz);
 
   int numDataUnits = rsDecoder->decoder.coder.numDataUnits;
@@ -60,13 +132,17 @@ jintArray outputOffsets) {
                                                numDataUnits + numParityUnits);
   getOutputs(env, outputs, outputOffsets, rsDecoder->outputs, numErased);
 
-  decode(&rsDecoder->decoder, rsDecoder->inputs, tmpErasedIndexes,
-                           numErased, rsDecoder->outputs, chunkSize);
+  decodeParallel(rsDecoder, tmpErasedIndexes, numErased, chunkSize,
+                 (int)threads);
+
+  (*env)->ReleaseIntArrayElements(env, erasedIndexes,
+                                  (jint*)tmpErasedIndexes, JNI_ABORT);
 }
 
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder_destroyImpl(
 JNIEnv *env, jobject thiz) {
   RSDecoder* rsDecoder = (RSDecoder*)getCoder(env, thiz);
-  free(rsDecoder);
+  destroyDecoder(&rsDecoder->decoder);
+  EC_FREE(rsDecoder);
 }
@@ -30,14 +30,35 @@ typedef struct _RSEncoder {
   IsalEncoder encoder;
   unsigned char* inputs[MMAX];
   unsigned char* outputs[MMAX];
+  // The addresses of the registered buffers: the data units of all the
+  // stripes, then their parity units, NULL if none are registered
+  unsigned char** registered;
+  int numRegisteredStripes;
 } RSEncoder;
 
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_initImpl(
 JNIEnv *env, jobject thiz, jint numDataUnits, jint numParityUnits) {
-  RSEncoder* rsEncoder = (RSEncoder*)malloc(sizeof(RSEncoder));
+  RSEncoder* rsEncoder;
+
+  if (!isValidCoder((int)numDataUnits, (int)numParityUnits)) {
+    THROW(env, "java/lang/IllegalArgumentException",
+          "Invalid number of units for the RS code");
+    return;
+  }
+
+  rsEncoder = (RSEncoder*)EC_MALLOC(sizeof(RSEncoder));
+  if (rsEncoder == NULL) {
+    THROW(env, "java/lang/OutOfMemoryError", "Failed to allocate the coder");
+    return;
+  }
   memset(rsEncoder, 0, sizeof(*rsEncoder));
-  initEncoder(&rsEncoder->encoder, (int)numDataUnits, (int)numParityUnits);
+  if (initEncoder(&rsEncoder->encoder, (int)numDataUnits,
+                  (int)numParityUnits)) {
+    EC_FREE(rsEncoder);
+    THROW(env, "java/lang/OutOfMemoryError", "Failed to allocate the coder");
+    return;
+  }
 
   setCoder(env, thiz, &rsEncoder->encoder.coder);
 }
@@ -58,9 +79,88 @@ jint dataLen, jobjectArray outputs, jintArray outputOffsets) {
   encode(&rsEncoder->encoder, rsEncoder->inputs, rsEncoder->outputs, chunkSize);
 }
 
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_encodeUpdateImpl(
+JNIEnv *env, jobject thiz, jobject input, jint inputOffset, jint dataLen,
+jint dataUnitIndex, jobjectArray outputs, jintArray outputOffsets) {
+  RSEncoder* rsEncoder = (RSEncoder*)getCoder(env, thiz);
+
+  int numParityUnits = rsEncoder->encoder.coder.numParityUnits;
+  unsigned char* dataUnit;
+
+  dataUnit = (unsigned char*)(*env)->GetDirectBufferAddress(env, input);
+  getOutputs(env, outputs, outputOffsets, rsEncoder->outputs, numParityUnits);
+  if ((*env)->ExceptionCheck(env)) {
+    return;
+  }
+
+  if (encodeUpdate(&rsEncoder->encoder, dataUnit + inputOffset,
+                   (int)dataUnitIndex, rsEncoder->outputs, (int)dataLen)) {
+    THROW(env, "java/lang/IllegalArgumentException", "Invalid data unit");
+  }
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_registerBuffersImpl(
+JNIEnv *env, jobject thiz, jobjectArray inputs, jintArray inputOffsets,
+jobjectArray outputs, jintArray outputOffsets, jint numStripes) {
+  RSEncoder* rsEncoder = (RSEncoder*)getCoder(env, thiz);
+
+  int numDataUnits = rsEncoder->encoder.coder.numDataUnits;
+  int numParityUnits = rsEncoder->encoder.coder.numParityUnits;
+  int numAllUnits = rsEncoder->encoder.coder.numAllUnits;
+  unsigned char** registered;
+
+  registered = EC_MALLOC(numStripes * numAllUnits * sizeof(*registered));
+  if (registered == NULL) {
+    THROW(env, "java/lang/OutOfMemoryError",
+          "Failed to allocate the registered buffers");
+    return;
+  }
+
+  getInputs(env, inputs, inputOffsets, registered, numStripes * numDataUnits);
+  getOutputs(env, outputs, outputOffsets,
+             registered + numStripes * numDataUnits,
+             numStripes * numParityUnits);
+  if ((*env)->ExceptionCheck(env)) {
+    EC_FREE(registered);
+    return;
+  }
+
+  EC_FREE(rsEncoder->registered);
+  rsEncoder->registered = registered;
+  rsEncoder->numRegisteredStripes = (int)numStripes;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_encodeRegisteredImpl(
+JNIEnv *env, jobject thiz, jint numStripes, jint dataLen) {
+  RSEncoder* rsEncoder = (RSEncoder*)getCoder(env, thiz);
+
+  int numDataUnits = rsEncoder->encoder.coder.numDataUnits;
+  int numParityUnits = rsEncoder->encoder.coder.numParityUnits;
+  unsigned char** parity;
+  int i;
+
+  if (numStripes > rsEncoder->numRegisteredStripes) {
+    THROW(env, "java/lang/IllegalArgumentException",
+          "More stripes than registered");
+    return;
+  }
+
+  parity = rsEncoder->registered +
+      rsEncoder->numRegisteredStripes * numDataUnits;
+  for (i = 0; i < numStripes; i++) {
+    encode(&rsEncoder->encoder, rsEncoder->registered + i * numDataUnits,
+           parity + i * numParityUnits, (int)dataLen);
+  }
+}
+
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_destroyImpl(
 JNIEnv *env, jobject thiz) {
   RSEncoder* rsEncoder = (RSEncoder*)getCoder(env, thiz);
-  free(rsEncoder);
+  destroyEncoder(&rsEncoder->encoder);
+  EC_FREE(rsEncoder->registered);
+  EC_FREE(rsEncoder);
 }
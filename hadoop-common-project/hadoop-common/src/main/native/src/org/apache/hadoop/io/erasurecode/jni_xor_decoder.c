@@ -0,0 +1,85 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "org_apache_hadoop.h"
+#include "xor_code.h"
+#include "jni_common.h"
+#include "org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawDecoder.h"
+
+typedef struct _XORDecoder {
+  IsalCoder coder;
+  unsigned char* inputs[MMAX];
+  unsigned char* outputs[MMAX];
+} XORDecoder;
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawDecoder_initImpl(
+JNIEnv *env, jobject thiz, jint numDataUnits, jint numParityUnits) {
+  XORDecoder* xorDecoder;
+
+  if (numParityUnits != 1 || numDataUnits < 1 || numDataUnits >= MMAX) {
+    THROW(env, "java/lang/IllegalArgumentException",
+          "Invalid number of units for the XOR code");
+    return;
+  }
+
+  xorDecoder = (XORDecoder*)EC_MALLOC(sizeof(XORDecoder));
+  memset(xorDecoder, 0, sizeof(*xorDecoder));
+  initCoder(&xorDecoder->coder, (int)numDataUnits, (int)numParityUnits);
+
+  setCoder(env, thiz, &xorDecoder->coder);
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawDecoder_decodeImpl(
+JNIEnv *env, jobject thiz, jobjectArray inputs, jintArray inputOffsets,
+jint dataLen, jintArray erasedIndexes, jobjectArray outputs,
+jintArray outputOffsets) {
+  XORDecoder* xorDecoder = (XORDecoder*)getCoder(env, thiz);
+
+  int numDataUnits = xorDecoder->coder.numDataUnits;
+  int numParityUnits = xorDecoder->coder.numParityUnits;
+  int chunkSize = (int)dataLen;
+  int i, numInputs = 0;
+
+  getInputs(env, inputs, inputOffsets, xorDecoder->inputs,
+                                               numDataUnits + numParityUnits);
+  getOutputs(env, outputs, outputOffsets, xorDecoder->outputs,
+             (*env)->GetArrayLength(env, erasedIndexes));
+
+  // The erased unit is the xor of all the others, which are never erased
+  // too since there is only one parity unit
+  for (i = 0; i < numDataUnits + numParityUnits; i++) {
+    if (xorDecoder->inputs[i] != NULL) {
+      xorDecoder->inputs[numInputs++] = xorDecoder->inputs[i];
+    }
+  }
+
+  xorUnits(xorDecoder->inputs, numInputs, xorDecoder->outputs[0], chunkSize);
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawDecoder_destroyImpl(
+JNIEnv *env, jobject thiz) {
+  XORDecoder* xorDecoder = (XORDecoder*)getCoder(env, thiz);
+  EC_FREE(xorDecoder);
+}
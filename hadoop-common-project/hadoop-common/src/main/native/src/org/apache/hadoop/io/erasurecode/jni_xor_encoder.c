@@ -0,0 +1,74 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "org_apache_hadoop.h"
+#include "xor_code.h"
+#include "jni_common.h"
+#include "org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawEncoder.h"
+
+typedef struct _XOREncoder {
+  IsalCoder coder;
+  unsigned char* inputs[MMAX];
+  unsigned char* outputs[MMAX];
+} XOREncoder;
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawEncoder_initImpl(
+JNIEnv *env, jobject thiz, jint numDataUnits, jint numParityUnits) {
+  XOREncoder* xorEncoder;
+
+  if (numParityUnits != 1 || numDataUnits < 1 || numDataUnits >= MMAX) {
+    THROW(env, "java/lang/IllegalArgumentException",
+          "Invalid number of units for the XOR code");
+    return;
+  }
+
+  xorEncoder = (XOREncoder*)EC_MALLOC(sizeof(XOREncoder));
+  memset(xorEncoder, 0, sizeof(*xorEncoder));
+  initCoder(&xorEncoder->coder, (int)numDataUnits, (int)numParityUnits);
+
+  setCoder(env, thiz, &xorEncoder->coder);
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawEncoder_encodeImpl(
+JNIEnv *env, jobject thiz, jobjectArray inputs, jintArray inputOffsets,
+jint dataLen, jobjectArray outputs, jintArray outputOffsets) {
+  XOREncoder* xorEncoder = (XOREncoder*)getCoder(env, thiz);
+
+  int numDataUnits = xorEncoder->coder.numDataUnits;
+  int numParityUnits = xorEncoder->coder.numParityUnits;
+  int chunkSize = (int)dataLen;
+
+  getInputs(env, inputs, inputOffsets, xorEncoder->inputs, numDataUnits);
+  getOutputs(env, outputs, outputOffsets, xorEncoder->outputs, numParityUnits);
+
+  xorUnits(xorEncoder->inputs, numDataUnits, xorEncoder->outputs[0],
+           chunkSize);
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeXORRawEncoder_destroyImpl(
+JNIEnv *env, jobject thiz) {
+  XOREncoder* xorEncoder = (XOREncoder*)getCoder(env, thiz);
+  EC_FREE(xorEncoder);
+}
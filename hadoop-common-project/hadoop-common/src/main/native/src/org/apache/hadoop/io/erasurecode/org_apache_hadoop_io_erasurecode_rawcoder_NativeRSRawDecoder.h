@@ -18,10 +18,10 @@ JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRa
 /*
  * Class:     org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder
  * Method:    decodeImpl
- * Signature: ([Ljava/nio/ByteBuffer;[II[I[Ljava/nio/ByteBuffer;[I)V
+ * Signature: ([Ljava/nio/ByteBuffer;[II[I[Ljava/nio/ByteBuffer;[II)V
  */
 JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder_decodeImpl
-  (JNIEnv *, jobject, jobjectArray, jintArray, jint, jintArray, jobjectArray, jintArray);
+  (JNIEnv *, jobject, jobjectArray, jintArray, jint, jintArray, jobjectArray, jintArray, jint);
 
 /*
  * Class:     org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawDecoder
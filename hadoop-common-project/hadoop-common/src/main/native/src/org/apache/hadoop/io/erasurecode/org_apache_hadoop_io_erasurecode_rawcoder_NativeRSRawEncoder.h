@@ -23,6 +23,30 @@ JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRa
 JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_encodeImpl
   (JNIEnv *, jobject, jobjectArray, jintArray, jint, jobjectArray, jintArray);
 
+/*
+ * Class:     org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder
+ * Method:    encodeUpdateImpl
+ * Signature: (Ljava/nio/ByteBuffer;III[Ljava/nio/ByteBuffer;[I)V
+ */
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_encodeUpdateImpl
+  (JNIEnv *, jobject, jobject, jint, jint, jint, jobjectArray, jintArray);
+
+/*
+ * Class:     org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder
+ * Method:    registerBuffersImpl
+ * Signature: ([Ljava/nio/ByteBuffer;[I[Ljava/nio/ByteBuffer;[II)V
+ */
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_registerBuffersImpl
+  (JNIEnv *, jobject, jobjectArray, jintArray, jobjectArray, jintArray, jint);
+
+/*
+ * Class:     org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder
+ * Method:    encodeRegisteredImpl
+ * Signature: (II)V
+ */
+JNIEXPORT void JNICALL Java_org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder_encodeRegisteredImpl
+  (JNIEnv *, jobject, jint, jint);
+
 /*
  * Class:     org_apache_hadoop_io_erasurecode_rawcoder_NativeRSRawEncoder
  * Method:    destroyImpl
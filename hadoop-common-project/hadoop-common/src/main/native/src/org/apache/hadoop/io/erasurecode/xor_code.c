@@ -0,0 +1,158 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "isal_load.h"
+#include "erasure_coder.h"
+#include "xor_code.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define XOR_CODE_X86
+#elif defined(__GNUC__) && defined(__aarch64__)
+#include <arm_neon.h>
+#define XOR_CODE_NEON
+#endif
+
+/**
+ *  xor_code.c
+ *  Implementation of the XOR code.  Each kernel xors as many whole vectors
+ *  as fit in the units and returns how many bytes it did, leaving the rest
+ *  to the next narrower one.
+ */
+
+#ifdef XOR_CODE_X86
+
+__attribute__ ((target("avx512f")))
+static int xorAvx512(unsigned char** units, int numUnits,
+                     unsigned char* output, int len) {
+  __m512i x;
+  int i, j;
+
+  for (i = 0; i + 64 <= len; i += 64) {
+    x = _mm512_loadu_si512((const void*)(units[0] + i));
+    for (j = 1; j < numUnits; j++) {
+      x = _mm512_xor_si512(x, _mm512_loadu_si512((const void*)(units[j] + i)));
+    }
+    _mm512_storeu_si512((void*)(output + i), x);
+  }
+  return i;
+}
+
+__attribute__ ((target("avx2")))
+static int xorAvx2(unsigned char** units, int numUnits,
+                   unsigned char* output, int len) {
+  __m256i x;
+  int i, j;
+
+  for (i = 0; i + 32 <= len; i += 32) {
+    x = _mm256_loadu_si256((const __m256i*)(units[0] + i));
+    for (j = 1; j < numUnits; j++) {
+      x = _mm256_xor_si256(x,
+          _mm256_loadu_si256((const __m256i*)(units[j] + i)));
+    }
+    _mm256_storeu_si256((__m256i*)(output + i), x);
+  }
+  return i;
+}
+
+#endif
+
+#ifdef XOR_CODE_NEON
+
+static int xorNeon(unsigned char** units, int numUnits,
+                   unsigned char* output, int len) {
+  uint8x16_t x;
+  int i, j;
+
+  for (i = 0; i + 16 <= len; i += 16) {
+    x = vld1q_u8(units[0] + i);
+    for (j = 1; j < numUnits; j++) {
+      x = veorq_u8(x, vld1q_u8(units[j] + i));
+    }
+    vst1q_u8(output + i, x);
+  }
+  return i;
+}
+
+#endif
+
+static void xorWords(unsigned char** units, int numUnits,
+                     unsigned char* output, int off, int len) {
+  uint64_t x, y;
+  int i, j;
+
+  for (i = off; i + 8 <= len; i += 8) {
+    memcpy(&x, units[0] + i, sizeof(x));
+    for (j = 1; j < numUnits; j++) {
+      memcpy(&y, units[j] + i, sizeof(y));
+      x ^= y;
+    }
+    memcpy(output + i, &x, sizeof(x));
+  }
+  for (; i < len; i++) {
+    output[i] = units[0][i];
+    for (j = 1; j < numUnits; j++) {
+      output[i] ^= units[j][i];
+    }
+  }
+}
+
+// xor_gen wants all the pointers aligned to 32 bytes
+static int canUseXorGen(unsigned char** units, int numUnits,
+                        unsigned char* output) {
+  uintptr_t bits = (uintptr_t)output;
+  int i;
+
+  if (isaLoader == NULL || isaLoader->xor_gen == NULL || numUnits < 2) {
+    return 0;
+  }
+  for (i = 0; i < numUnits; i++) {
+    bits |= (uintptr_t)units[i];
+  }
+  return (bits & 31) == 0;
+}
+
+void xorUnits(unsigned char** units, int numUnits,
+    unsigned char* output, int len) {
+  void* vects[MMAX + 1];
+  int done = 0;
+
+  if (numUnits <= MMAX && canUseXorGen(units, numUnits, output)) {
+    memcpy(vects, units, numUnits * sizeof(*units));
+    vects[numUnits] = output;
+    if (isaLoader->xor_gen(numUnits + 1, len, vects) == 0) {
+      return;
+    }
+  }
+
+#ifdef XOR_CODE_X86
+  if (__builtin_cpu_supports("avx512f")) {
+    done = xorAvx512(units, numUnits, output, len);
+  } else if (__builtin_cpu_supports("avx2")) {
+    done = xorAvx2(units, numUnits, output, len);
+  }
+#endif
+#ifdef XOR_CODE_NEON
+  done = xorNeon(units, numUnits, output, len);
+#endif
+
+  xorWords(units, numUnits, output, done, len);
+}
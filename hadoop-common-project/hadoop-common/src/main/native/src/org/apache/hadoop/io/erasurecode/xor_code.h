@@ -0,0 +1,42 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _XOR_CODE_H_
+#define _XOR_CODE_H_
+
+/**
+ *  Interface to the XOR code, where the single parity unit is the xor of all
+ *  the data units, and any one erased unit is the xor of all the others.
+ *
+ *  It does not need any tables, so xor_gen of ISA-L is only used when loaded.
+ *  Otherwise it runs on the widest vectors the CPU has: AVX-512 or AVX2 on
+ *  x86-64, NEON on aarch64, and 64 bit words elsewhere.
+ */
+
+/**
+ * Xor the given units into one.
+ *
+ * @param units    The units to xor, at least one.
+ * @param numUnits The number of units.
+ * @param output   The unit to write the xor into, not one of the units.
+ * @param len      The length of each unit in bytes.
+ */
+void xorUnits(unsigned char** units, int numUnits,
+    unsigned char* output, int len);
+
+#endif //_XOR_CODE_H_
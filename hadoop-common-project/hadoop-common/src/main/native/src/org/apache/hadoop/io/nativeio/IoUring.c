@@ -0,0 +1,431 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+
+#ifdef UNIX
+
+#include "exception.h"
+#include "file_descriptor.h"
+#include "org_apache_hadoop_io_nativeio_IoUring.h"
+#include "config.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define OP_READ org_apache_hadoop_io_nativeio_IoUring_OP_READ
+#define OP_WRITE org_apache_hadoop_io_nativeio_IoUring_OP_WRITE
+#define OP_FSYNC org_apache_hadoop_io_nativeio_IoUring_OP_FSYNC
+#define OP_FDATASYNC org_apache_hadoop_io_nativeio_IoUring_OP_FDATASYNC
+#define OP_FADVISE org_apache_hadoop_io_nativeio_IoUring_OP_FADVISE
+
+/**
+ * A ring and the buffers registered with it.  It is used by one thread at a
+ * time, which the Java side makes sure of.
+ */
+struct uring {
+  int ring_fd;
+  // The mappings of the rings, which are the same one when the kernel has
+  // IORING_FEAT_SINGLE_MMAP
+  void *sq_ring;
+  size_t sq_ring_len;
+  void *cq_ring;
+  size_t cq_ring_len;
+  struct io_uring_sqe *sqes;
+  size_t sqes_len;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  // Entries queued since the last io_uring_enter
+  unsigned unsubmitted;
+  int num_bufs;
+  struct iovec *bufs;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                      flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg,
+                                 unsigned nr_args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_free(struct uring *ring)
+{
+  if (ring->sqes) {
+    munmap(ring->sqes, ring->sqes_len);
+  }
+  if (ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_len);
+  }
+  if (ring->sq_ring) {
+    munmap(ring->sq_ring, ring->sq_ring_len);
+  }
+  if (ring->ring_fd >= 0) {
+    // Closing the ring also unregisters its buffers
+    close(ring->ring_fd);
+  }
+  free(ring->bufs);
+  free(ring);
+}
+
+/**
+ * Map the rings of a ring that was set up.  Returns 0 or an errno.
+ */
+static int uring_map(struct uring *ring, struct io_uring_params *p)
+{
+  void *sq, *cq;
+
+  ring->sq_ring_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+  ring->cq_ring_len = p->cq_off.cqes +
+      p->cq_entries * sizeof(struct io_uring_cqe);
+  if (p->features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_len > ring->sq_ring_len) {
+      ring->sq_ring_len = ring->cq_ring_len;
+    }
+    ring->cq_ring_len = ring->sq_ring_len;
+  }
+  sq = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return errno;
+  }
+  ring->sq_ring = sq;
+  if (p->features & IORING_FEAT_SINGLE_MMAP) {
+    cq = sq;
+  } else {
+    cq = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return errno;
+    }
+  }
+  ring->cq_ring = cq;
+  ring->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+                    IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    return errno;
+  }
+  ring->sq_head = (unsigned *)((char *)sq + p->sq_off.head);
+  ring->sq_tail = (unsigned *)((char *)sq + p->sq_off.tail);
+  ring->sq_mask = *(unsigned *)((char *)sq + p->sq_off.ring_mask);
+  ring->sq_entries = p->sq_entries;
+  ring->sq_array = (unsigned *)((char *)sq + p->sq_off.array);
+  ring->cq_head = (unsigned *)((char *)cq + p->cq_off.head);
+  ring->cq_tail = (unsigned *)((char *)cq + p->cq_off.tail);
+  ring->cq_mask = *(unsigned *)((char *)cq + p->cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)((char *)cq + p->cq_off.cqes);
+  return 0;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_isSupported0(
+  JNIEnv *env, jclass clazz)
+{
+  struct io_uring_params p;
+  int fd;
+
+  // Kernels before 5.1 fail with ENOSYS, and io_uring may be disabled
+  memset(&p, 0, sizeof(p));
+  fd = sys_io_uring_setup(1, &p);
+  if (fd < 0) {
+    return JNI_FALSE;
+  }
+  close(fd);
+  // The operations used here are all there from Linux 5.6 on
+  return (p.features & IORING_FEAT_RW_CUR_POS) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_create0(
+  JNIEnv *env, jclass clazz, jint entries, jobjectArray jbufs)
+{
+  struct io_uring_params p;
+  struct uring *ring;
+  jthrowable jthr = NULL;
+  jobject jbuf;
+  int i, ret;
+
+  ring = calloc(1, sizeof(*ring));
+  if (!ring) {
+    jthr = newRuntimeException(env, "calloc failed");
+    goto done;
+  }
+  ring->ring_fd = -1;
+  ring->num_bufs = (*env)->GetArrayLength(env, jbufs);
+  ring->bufs = calloc(ring->num_bufs ? ring->num_bufs : 1,
+                      sizeof(struct iovec));
+  if (!ring->bufs) {
+    jthr = newRuntimeException(env, "calloc failed");
+    goto done;
+  }
+  for (i = 0; i < ring->num_bufs; i++) {
+    jbuf = (*env)->GetObjectArrayElement(env, jbufs, i);
+    ring->bufs[i].iov_base = (*env)->GetDirectBufferAddress(env, jbuf);
+    ring->bufs[i].iov_len = (*env)->GetDirectBufferCapacity(env, jbuf);
+    (*env)->DeleteLocalRef(env, jbuf);
+    if (!ring->bufs[i].iov_base) {
+      jthr = newException(env, "java/lang/IllegalArgumentException",
+                          "buffer %d is not a direct buffer", i);
+      goto done;
+    }
+  }
+  memset(&p, 0, sizeof(p));
+  ring->ring_fd = sys_io_uring_setup(entries, &p);
+  if (ring->ring_fd < 0) {
+    ret = errno;
+    jthr = newIOException(env, "io_uring_setup(%d) failed: error %d (%s)",
+                          entries, ret, terror(ret));
+    goto done;
+  }
+  ret = uring_map(ring, &p);
+  if (ret) {
+    jthr = newIOException(env, "mmap of the io_uring rings failed: "
+                          "error %d (%s)", ret, terror(ret));
+    goto done;
+  }
+  // Pages of fixed buffers are pinned once here, instead of on every I/O
+  if (ring->num_bufs > 0 &&
+      sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS,
+                            ring->bufs, ring->num_bufs) < 0) {
+    ret = errno;
+    jthr = newIOException(env, "registering %d buffers failed: error %d "
+                          "(%s)", ring->num_bufs, ret, terror(ret));
+    goto done;
+  }
+
+done:
+  if (jthr) {
+    if (ring) {
+      uring_free(ring);
+    }
+    (*env)->Throw(env, jthr);
+    return 0;
+  }
+  return (jlong)(intptr_t)ring;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_prepare0(
+  JNIEnv *env, jclass clazz, jlong handle, jint op, jobject jfd,
+  jint buf_index, jint buf_offset, jint length, jlong offset, jint advice,
+  jlong user_data)
+{
+  struct uring *ring = (struct uring *)(intptr_t)handle;
+  struct io_uring_sqe *sqe;
+  unsigned tail, index;
+  int fd;
+
+  fd = fd_get(env, jfd);
+  if ((*env)->ExceptionCheck(env)) {
+    return JNI_FALSE;
+  }
+  if (op == OP_READ || op == OP_WRITE) {
+    if (buf_index < 0 || buf_index >= ring->num_bufs || buf_offset < 0 ||
+        length < 0 ||
+        (size_t)buf_offset + length > ring->bufs[buf_index].iov_len) {
+      THROW(env, "java/lang/IllegalArgumentException",
+            "not within a registered buffer");
+      return JNI_FALSE;
+    }
+  }
+  tail = *ring->sq_tail;
+  if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+      ring->sq_entries) {
+    return JNI_FALSE;
+  }
+  index = tail & ring->sq_mask;
+  sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = fd;
+  sqe->user_data = (uint64_t)user_data;
+  switch (op) {
+  case OP_READ:
+  case OP_WRITE:
+    sqe->opcode = op == OP_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+    sqe->addr = (uint64_t)(uintptr_t)
+        ((char *)ring->bufs[buf_index].iov_base + buf_offset);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->buf_index = buf_index;
+    break;
+  case OP_FSYNC:
+  case OP_FDATASYNC:
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fsync_flags = op == OP_FDATASYNC ? IORING_FSYNC_DATASYNC : 0;
+    break;
+  case OP_FADVISE:
+    sqe->opcode = IORING_OP_FADVISE;
+    sqe->off = offset;
+    sqe->len = length;
+    sqe->fadvise_advice = advice;
+    break;
+  default:
+    THROW(env, "java/lang/IllegalArgumentException", "unknown operation");
+    return JNI_FALSE;
+  }
+  ring->sq_array[index] = index;
+  // The kernel must see the entry before the new tail
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->unsubmitted++;
+  return JNI_TRUE;
+}
+
+/**
+ * Hand the queued entries to the kernel, and wait for min_complete
+ * completions.  Returns 0 or an errno.
+ */
+static int uring_enter(struct uring *ring, unsigned min_complete)
+{
+  int ret;
+
+  for (;;) {
+    ret = sys_io_uring_enter(ring->ring_fd, ring->unsubmitted, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0);
+    if (ret >= 0) {
+      ring->unsubmitted -= ret;
+      if (ring->unsubmitted == 0 || min_complete) {
+        return 0;
+      }
+      // Submission stopped short, for example on a full completion queue
+      continue;
+    }
+    if (errno != EINTR) {
+      return errno;
+    }
+  }
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_submit0(
+  JNIEnv *env, jclass clazz, jlong handle)
+{
+  struct uring *ring = (struct uring *)(intptr_t)handle;
+  int ret;
+
+  if (ring->unsubmitted == 0) {
+    return;
+  }
+  ret = uring_enter(ring, 0);
+  if (ret) {
+    (*env)->Throw(env, newIOException(env, "io_uring_enter failed: error "
+                                      "%d (%s)", ret, terror(ret)));
+  }
+}
+
+JNIEXPORT jint JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_complete0(
+  JNIEnv *env, jclass clazz, jlong handle, jlongArray juser_data,
+  jintArray jresults, jint min_complete)
+{
+  struct uring *ring = (struct uring *)(intptr_t)handle;
+  struct io_uring_cqe *cqe;
+  unsigned head, tail;
+  jint max, count = 0;
+  jlong *user_data;
+  jint *results;
+  int ret;
+
+  max = (*env)->GetArrayLength(env, juser_data);
+  if (min_complete > max) {
+    min_complete = max;
+  }
+  head = *ring->cq_head;
+  tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  if (ring->unsubmitted > 0 || tail - head < (unsigned)min_complete) {
+    ret = uring_enter(ring, tail - head < (unsigned)min_complete ?
+                      min_complete - (tail - head) : 0);
+    if (ret) {
+      (*env)->Throw(env, newIOException(env, "io_uring_enter failed: error "
+                                        "%d (%s)", ret, terror(ret)));
+      return 0;
+    }
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  }
+  if (head == tail) {
+    return 0;
+  }
+  user_data = (*env)->GetLongArrayElements(env, juser_data, NULL);
+  if (!user_data) {
+    return 0; // exception raised
+  }
+  results = (*env)->GetIntArrayElements(env, jresults, NULL);
+  if (!results) {
+    (*env)->ReleaseLongArrayElements(env, juser_data, user_data, JNI_ABORT);
+    return 0; // exception raised
+  }
+  for (; head != tail && count < max; head++, count++) {
+    cqe = &ring->cqes[head & ring->cq_mask];
+    user_data[count] = (jlong)cqe->user_data;
+    results[count] = cqe->res;
+  }
+  // The kernel may reuse the entries once the new head is seen
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  (*env)->ReleaseLongArrayElements(env, juser_data, user_data, 0);
+  (*env)->ReleaseIntArrayElements(env, jresults, results, 0);
+  return count;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_destroy0(
+  JNIEnv *env, jclass clazz, jlong handle)
+{
+  uring_free((struct uring *)(intptr_t)handle);
+}
+
+#else
+
+JNIEXPORT jboolean JNICALL
+Java_org_apache_hadoop_io_nativeio_IoUring_isSupported0(
+  JNIEnv *env, jclass clazz)
+{
+  // Built against kernel headers without io_uring
+  return JNI_FALSE;
+}
+
+#endif // HAVE_IO_URING
+
+#endif // UNIX
@@ -24,6 +24,7 @@
 #include "file_descriptor.h"
 #include "org_apache_hadoop.h"
 #include "org_apache_hadoop_io_nativeio_SharedFileDescriptorFactory.h"
+#include "org/apache/hadoop/net/unix/short_circuit_stats.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -33,6 +34,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -112,6 +116,7 @@ Java_org_apache_hadoop_io_nativeio_SharedFileDescriptorFactory_createDescriptor0
   int ret, fd = -1, rnd;
   jthrowable jthr;
   jobject jret = NULL;
+  int64_t start = short_circuit_now();
 
   prefix = (*env)->GetStringUTFChars(env, jprefix, NULL);
   if (!prefix) goto done; // exception raised
@@ -171,6 +176,9 @@ Java_org_apache_hadoop_io_nativeio_SharedFileDescriptorFactory_createDescriptor0
     goto done;
   }
   jret = fd_create(env, fd); // throws exception on error.
+  if (jret) {
+    short_circuit_record(SHORT_CIRCUIT_SHM_ALLOC, start);
+  }
 
 done:
   if (prefix) {
@@ -187,4 +195,85 @@ done:
   return jret;
 }
 
+JNIEXPORT jboolean JNICALL
+Java_org_apache_hadoop_io_nativeio_SharedFileDescriptorFactory_isMemfdSupported0(
+  JNIEnv *env, jclass clazz)
+{
+#ifdef HAVE_MEMFD_CREATE
+  int fd;
+
+  // libc may have memfd_create while the kernel does not (before 3.17)
+  fd = memfd_create("HadoopMemfdProbe", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    return JNI_FALSE;
+  }
+  close(fd);
+  return JNI_TRUE;
+#else
+  return JNI_FALSE;
+#endif
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_apache_hadoop_io_nativeio_SharedFileDescriptorFactory_createMemfd0(
+  JNIEnv *env, jclass clazz, jstring jname, jint length)
+{
+#ifdef HAVE_MEMFD_CREATE
+  const char *name = NULL;
+  int ret, fd = -1;
+  jthrowable jthr;
+  jobject jret = NULL;
+  int64_t start = short_circuit_now();
+
+  name = (*env)->GetStringUTFChars(env, jname, NULL);
+  if (!name) goto done; // exception raised
+
+  fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    ret = errno;
+    jthr = newIOException(env, "memfd_create(%s) failed: error %d (%s)",
+                          name, ret, terror(ret));
+    (*env)->Throw(env, jthr);
+    goto done;
+  }
+  // The new pages read as zeroes, so unlike a file there is nothing to
+  // write out.
+  if (ftruncate(fd, length) < 0) {
+    ret = errno;
+    jthr = newIOException(env, "ftruncate(%s, %d) failed: error %d (%s)",
+                          name, length, ret, terror(ret));
+    (*env)->Throw(env, jthr);
+    goto done;
+  }
+  // Fix the size, so that a process the segment is shared with cannot
+  // shrink it under our mapping and have us take a SIGBUS.
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+    ret = errno;
+    jthr = newIOException(env, "fcntl(%s, F_ADD_SEALS) failed: error %d (%s)",
+                          name, ret, terror(ret));
+    (*env)->Throw(env, jthr);
+    goto done;
+  }
+  jret = fd_create(env, fd); // throws exception on error.
+  if (jret) {
+    short_circuit_record(SHORT_CIRCUIT_SHM_ALLOC, start);
+  }
+
+done:
+  if (name) {
+    (*env)->ReleaseStringUTFChars(env, jname, name);
+  }
+  if (!jret) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  return jret;
+#else
+  THROW(env, "java/lang/UnsupportedOperationException",
+        "libhadoop was built without memfd_create support.");
+  return NULL;
+#endif
+}
+
 #endif
@@ -19,6 +19,7 @@
 #include "config.h"
 #include "exception.h"
 #include "org/apache/hadoop/io/nativeio/file_descriptor.h"
+#include "org/apache/hadoop/net/unix/short_circuit_stats.h"
 #include "org_apache_hadoop.h"
 #include "org_apache_hadoop_net_unix_DomainSocket.h"
 
@@ -476,6 +477,7 @@ JNIEnv *env, jclass clazz, jstring path)
 {
   int ret, fd;
   jthrowable jthr = NULL;
+  int64_t start = short_circuit_now();
 
   jthr = setup(env, &fd, path, 1);
   if (jthr) {
@@ -488,6 +490,7 @@ JNIEnv *env, jclass clazz, jstring path)
     (*env)->Throw(env, jthr);
     return -1;
   }
+  short_circuit_record(SHORT_CIRCUIT_CONNECT, start);
   return fd;
 }
 
@@ -717,6 +720,7 @@ jint offset, jint length)
   int i, ret = -1, auxLen;
   struct msghdr socketMsg;
   jthrowable jthr = NULL;
+  int64_t start = short_circuit_now();
 
   jthr = flexBufInit(env, &flexBuf, length);
   if (jthr) {
@@ -791,6 +795,7 @@ jint offset, jint length)
       goto done;
     }
   }
+  short_circuit_record(SHORT_CIRCUIT_SEND_FDS, start);
 
 done:
   flexBufFree(&flexBuf);
@@ -813,6 +818,7 @@ jint offset, jint length)
   ssize_t bytesRead = -1;
   jobject fdObj;
   jthrowable jthr = NULL;
+  int64_t start = short_circuit_now();
 
   jthr = flexBufInit(env, &flexBuf, length);
   if (jthr) {
@@ -886,6 +892,7 @@ jint offset, jint length)
     (*env)->ExceptionClear(env);
     goto done;
   }
+  short_circuit_record(SHORT_CIRCUIT_RECEIVE_FDS, start);
 done:
   flexBufFree(&flexBuf);
   if (jthr) {
@@ -911,6 +918,423 @@ done:
   return bytesRead;
 }
 
+/**
+ * Can't pass more than this number of messages to one sendmmsg or recvmmsg.
+ * Longer batches take several system calls.
+ */
+#define MAX_BATCHED_MSGS 64
+
+#ifdef __linux__
+typedef struct mmsghdr batch_msg_t;
+#else
+// Without sendmmsg and recvmmsg, a batch takes a system call per message
+typedef struct {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+} batch_msg_t;
+#endif
+
+/**
+ * Send some of the messages of a batch.
+ *
+ * @return          How many messages were sent, with the bytes sent of each
+ *                  in its msg_len, or -1 with errno set.
+ */
+static int send_batch(int fd, batch_msg_t *msgs, int num_msgs)
+{
+#ifdef __linux__
+  return sendmmsg(fd, msgs, num_msgs, PLATFORM_SEND_FLAGS);
+#else
+  ssize_t ret = sendmsg(fd, &msgs[0].msg_hdr, PLATFORM_SEND_FLAGS);
+  if (ret < 0) {
+    return -1;
+  }
+  msgs[0].msg_len = ret;
+  return 1;
+#endif
+}
+
+/**
+ * Receive at least one message of a batch, without waiting for more.
+ *
+ * @return          Like send_batch.
+ */
+static int recv_batch(int fd, batch_msg_t *msgs, int num_msgs)
+{
+#ifdef __linux__
+  return recvmmsg(fd, msgs, num_msgs, MSG_WAITFORONE, NULL);
+#else
+  ssize_t ret = recvmsg(fd, &msgs[0].msg_hdr, 0);
+  if (ret < 0) {
+    return -1;
+  }
+  msgs[0].msg_len = ret;
+  return 1;
+#endif
+}
+
+/**
+ * The messages of a batch, each with its own bytes and fds.  The bytes of
+ * all of them are back to back in one buffer.
+ */
+struct fd_batch {
+  int num_msgs;
+  int total_len;
+  jint *lengths;
+  jbyte *buf;
+  batch_msg_t *msgs;
+  struct iovec *vecs;
+  struct cmsghdr_with_fds *auxs;
+  // How many fds each received message carried
+  int *num_fds;
+};
+
+static void fd_batch_free(struct fd_batch *batch)
+{
+  free(batch->lengths);
+  free(batch->buf);
+  free(batch->msgs);
+  free(batch->vecs);
+  free(batch->auxs);
+  free(batch->num_fds);
+}
+
+static jthrowable fd_batch_init(JNIEnv *env, struct fd_batch *batch,
+                                jobjectArray jfdss, jintArray jlengths)
+{
+  jthrowable jthr;
+  int i;
+
+  memset(batch, 0, sizeof(*batch));
+  batch->num_msgs = (*env)->GetArrayLength(env, jlengths);
+  if (batch->num_msgs <= 0) {
+    return newException(env, "java/lang/IllegalArgumentException",
+        "A batch must have at least one message.");
+  }
+  if ((*env)->GetArrayLength(env, jfdss) != batch->num_msgs) {
+    return newException(env, "java/lang/IllegalArgumentException",
+        "There are %d messages, but %d arrays of descriptors.",
+        batch->num_msgs, (*env)->GetArrayLength(env, jfdss));
+  }
+  batch->lengths = malloc(sizeof(jint) * batch->num_msgs);
+  batch->msgs = calloc(batch->num_msgs, sizeof(batch_msg_t));
+  batch->vecs = calloc(batch->num_msgs, sizeof(struct iovec));
+  batch->auxs = calloc(batch->num_msgs, sizeof(struct cmsghdr_with_fds));
+  batch->num_fds = calloc(batch->num_msgs, sizeof(int));
+  if (!batch->lengths || !batch->msgs || !batch->vecs || !batch->auxs ||
+      !batch->num_fds) {
+    return newException(env, "java/lang/OutOfMemoryError",
+        "OOM allocating a batch of %d messages.", batch->num_msgs);
+  }
+  (*env)->GetIntArrayRegion(env, jlengths, 0, batch->num_msgs,
+                            batch->lengths);
+  jthr = (*env)->ExceptionOccurred(env);
+  if (jthr) {
+    (*env)->ExceptionClear(env);
+    return jthr;
+  }
+  for (i = 0; i < batch->num_msgs; i++) {
+    if (batch->lengths[i] <= 0 ||
+        batch->lengths[i] > INT_MAX - batch->total_len) {
+      return newException(env, "java/lang/IllegalArgumentException",
+          "Message %d has a length of %d.  Each message must have at least "
+          "one byte, and all of them at most %d.", i, batch->lengths[i],
+          INT_MAX);
+    }
+    batch->total_len += batch->lengths[i];
+  }
+  batch->buf = malloc(batch->total_len);
+  if (!batch->buf) {
+    return newException(env, "java/lang/OutOfMemoryError",
+        "OOM allocating space for %d bytes of data.", batch->total_len);
+  }
+  return NULL;
+}
+
+/**
+ * Point message i of a batch at its bytes, and at room for numFds fds.
+ */
+static void fd_batch_set_msg(struct fd_batch *batch, int i, int offset,
+                             int numFds)
+{
+  struct cmsghdr_with_fds *aux = &batch->auxs[i];
+  struct msghdr *msg = &batch->msgs[i].msg_hdr;
+  int auxLen = CMSG_LEN(numFds * sizeof(int));
+
+  batch->vecs[i].iov_base = batch->buf + offset;
+  batch->vecs[i].iov_len = batch->lengths[i];
+  msg->msg_iov = &batch->vecs[i];
+  msg->msg_iovlen = 1;
+  msg->msg_control = aux;
+  msg->msg_controllen = auxLen;
+  aux->hdr.cmsg_len = auxLen;
+  aux->hdr.cmsg_level = SOL_SOCKET;
+  aux->hdr.cmsg_type = SCM_RIGHTS;
+}
+
+/**
+ * Get the fd array of message i of a batch, checking its length.
+ */
+static jthrowable get_batch_fds(JNIEnv *env, jobjectArray jfdss, int i,
+                                jobjectArray *jfds, int *numFds)
+{
+  jthrowable jthr;
+
+  *jfds = (*env)->GetObjectArrayElement(env, jfdss, i);
+  if (!*jfds) {
+    jthr = (*env)->ExceptionOccurred(env);
+    if (jthr) {
+      (*env)->ExceptionClear(env);
+      return jthr;
+    }
+    return newException(env, "java/lang/NullPointerException",
+          "the descriptors of message %d were NULL.", i);
+  }
+  *numFds = (*env)->GetArrayLength(env, *jfds);
+  if (*numFds <= 0 || *numFds > MAX_PASSED_FDS) {
+    (*env)->DeleteLocalRef(env, *jfds);
+    *jfds = NULL;
+    return newException(env, "java/lang/IllegalArgumentException",
+          "Message %d has an array of %d descriptors.  The minimum is 1 and "
+          "the maximum is %d.", i, *numFds, MAX_PASSED_FDS);
+  }
+  return NULL;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocket_sendFileDescriptorBatch0(
+JNIEnv *env, jclass clazz, jint fd, jobjectArray jfdss, jbyteArray jbuf,
+jint offset, jintArray jlengths)
+{
+  struct fd_batch batch;
+  jobjectArray jfds;
+  jobject jfd;
+  int i, j, numFds, msgOffset, next, num, sent, ret;
+  jthrowable jthr;
+  int64_t start = short_circuit_now();
+
+  jthr = fd_batch_init(env, &batch, jfdss, jlengths);
+  if (jthr) {
+    goto done;
+  }
+  (*env)->GetByteArrayRegion(env, jbuf, offset, batch.total_len, batch.buf);
+  jthr = (*env)->ExceptionOccurred(env);
+  if (jthr) {
+    (*env)->ExceptionClear(env);
+    goto done;
+  }
+  for (i = 0, msgOffset = 0; i < batch.num_msgs; i++) {
+    jthr = get_batch_fds(env, jfdss, i, &jfds, &numFds);
+    if (jthr) {
+      goto done;
+    }
+    for (j = 0; j < numFds; j++) {
+      jfd = (*env)->GetObjectArrayElement(env, jfds, j);
+      if (!jfd) {
+        (*env)->DeleteLocalRef(env, jfds);
+        jthr = (*env)->ExceptionOccurred(env);
+        if (jthr) {
+          (*env)->ExceptionClear(env);
+          goto done;
+        }
+        jthr = newException(env, "java/lang/NullPointerException",
+              "element %d of the descriptors of message %d was NULL.", j, i);
+        goto done;
+      }
+      batch.auxs[i].fds[j] = fd_get(env, jfd);
+      (*env)->DeleteLocalRef(env, jfd);
+    }
+    (*env)->DeleteLocalRef(env, jfds);
+    fd_batch_set_msg(&batch, i, msgOffset, numFds);
+    msgOffset += batch.lengths[i];
+  }
+  for (next = 0; next < batch.num_msgs; next += ret) {
+    num = batch.num_msgs - next;
+    if (num > MAX_BATCHED_MSGS) {
+      num = MAX_BATCHED_MSGS;
+    }
+    RETRY_ON_EINTR(ret, send_batch(fd, batch.msgs + next, num));
+    if (ret < 0) {
+      ret = errno;
+      jthr = newSocketException(env, ret, "sendmmsg(2) error: %s",
+                                terror(ret));
+      goto done;
+    }
+    for (i = next; i < next + ret; i++) {
+      sent = batch.msgs[i].msg_len;
+      if (sent >= batch.lengths[i]) {
+        continue;
+      }
+      if (i != next + ret - 1) {
+        // The rest of this message can no longer go before the next one
+        jthr = newSocketException(env, EIO, "sendmmsg(2) sent only %d of "
+              "the %d bytes of message %d.", sent, batch.lengths[i], i);
+        goto done;
+      }
+      // Write the rest of the bytes of the message.
+      // This time, no fds will be attached.
+      jthr = write_fully(env, fd, (jbyte*)batch.vecs[i].iov_base + sent,
+                         batch.lengths[i] - sent);
+      if (jthr) {
+        goto done;
+      }
+    }
+  }
+  short_circuit_record(SHORT_CIRCUIT_SEND_FDS, start);
+
+done:
+  fd_batch_free(&batch);
+  if (jthr) {
+    (*env)->Throw(env, jthr);
+  }
+}
+
+JNIEXPORT jint JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocket_receiveFileDescriptorBatch0(
+JNIEnv *env, jclass clazz, jint fd, jobjectArray jfdss, jbyteArray jbuf,
+jint offset, jintArray jlengths, jintArray jbytesRead)
+{
+  struct fd_batch batch;
+  struct msghdr *msg;
+  jobjectArray jfds;
+  jobject fdObj;
+  int i, j, numFds, msgOffset, num = 0, numRecv = 0;
+  jint bytesRead;
+  jthrowable jthr;
+  int64_t start = short_circuit_now();
+
+  jthr = fd_batch_init(env, &batch, jfdss, jlengths);
+  if (jthr) {
+    goto done;
+  }
+  if ((*env)->GetArrayLength(env, jbytesRead) < batch.num_msgs) {
+    jthr = newException(env, "java/lang/IllegalArgumentException",
+        "bytesRead is shorter than lengths.");
+    goto done;
+  }
+  num = batch.num_msgs;
+  if (num > MAX_BATCHED_MSGS) {
+    num = MAX_BATCHED_MSGS;
+  }
+  for (i = 0, msgOffset = 0; i < num; i++) {
+    jthr = get_batch_fds(env, jfdss, i, &jfds, &numFds);
+    if (jthr) {
+      goto done;
+    }
+    for (j = 0; j < numFds; j++) {
+      (*env)->SetObjectArrayElement(env, jfds, j, NULL);
+    }
+    (*env)->DeleteLocalRef(env, jfds);
+    fd_batch_set_msg(&batch, i, msgOffset, numFds);
+    msgOffset += batch.lengths[i];
+  }
+  RETRY_ON_EINTR(numRecv, recv_batch(fd, batch.msgs, num));
+  if (numRecv < 0) {
+    int ret = errno;
+    numRecv = num = 0;
+    if (ret == ECONNABORTED) {
+      // The remote peer disconnected on us.  Treat this as an EOF.
+      goto done;
+    }
+    jthr = newSocketException(env, ret, "recvmmsg(2) failed: %s",
+                              terror(ret));
+    goto done;
+  }
+  for (i = 0; i < numRecv; i++) {
+    msg = &batch.msgs[i].msg_hdr;
+    // The kernel only fills in the header when fds came with the message
+    if (msg->msg_controllen >= CMSG_LEN(0) &&
+        batch.auxs[i].hdr.cmsg_level == SOL_SOCKET &&
+        batch.auxs[i].hdr.cmsg_type == SCM_RIGHTS) {
+      batch.num_fds[i] =
+          (batch.auxs[i].hdr.cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    }
+  }
+  for (i = 0; i < numRecv; i++) {
+    if (batch.msgs[i].msg_len == 0) {
+      // EOF: the messages after it, if any, are empty too
+      break;
+    }
+  }
+  // Keep the fds of the messages after an EOF for the cleanup below
+  num = i;
+  for (i = 0; i < num; i++) {
+    if (batch.num_fds[i] == 0) {
+      continue;
+    }
+    jfds = (*env)->GetObjectArrayElement(env, jfdss, i);
+    for (j = 0; j < batch.num_fds[i]; j++) {
+      fdObj = fd_create(env, batch.auxs[i].fds[j]);
+      if (!fdObj) {
+        jthr = (*env)->ExceptionOccurred(env);
+        (*env)->ExceptionClear(env);
+        (*env)->DeleteLocalRef(env, jfds);
+        goto done;
+      }
+      // Make this -1 so we don't attempt to close it twice in an error path.
+      batch.auxs[i].fds[j] = -1;
+      (*env)->SetObjectArrayElement(env, jfds, j, fdObj);
+      (*env)->DeleteLocalRef(env, fdObj);
+    }
+    (*env)->DeleteLocalRef(env, jfds);
+  }
+  for (i = 0; i < num; i++) {
+    bytesRead = batch.msgs[i].msg_len;
+    (*env)->SetIntArrayRegion(env, jbytesRead, i, 1, &bytesRead);
+    (*env)->SetByteArrayRegion(env, jbuf,
+        offset + (int)((jbyte*)batch.vecs[i].iov_base - batch.buf),
+        bytesRead, batch.vecs[i].iov_base);
+    jthr = (*env)->ExceptionOccurred(env);
+    if (jthr) {
+      (*env)->ExceptionClear(env);
+      goto done;
+    }
+  }
+  if (num > 0) {
+    short_circuit_record(SHORT_CIRCUIT_RECEIVE_FDS, start);
+  }
+
+done:
+  // Close the fds nobody else will: those of messages after an EOF, or all
+  // of them on an error
+  for (i = jthr ? 0 : num; i < numRecv; i++) {
+    for (j = 0; j < batch.num_fds[i]; j++) {
+      int ret;
+      if (batch.auxs[i].fds[j] >= 0) {
+        RETRY_ON_EINTR(ret, close(batch.auxs[i].fds[j]));
+        batch.auxs[i].fds[j] = -1;
+      }
+    }
+  }
+  if (jthr) {
+    // Free any FileDescriptor references we may have created.
+    for (i = 0; i < numRecv; i++) {
+      if (batch.num_fds[i] == 0) {
+        continue;
+      }
+      jfds = (*env)->GetObjectArrayElement(env, jfdss, i);
+      for (j = 0; jfds && j < batch.num_fds[i]; j++) {
+        fdObj = (*env)->GetObjectArrayElement(env, jfds, j);
+        if (fdObj) {
+          int ret, afd = fd_get(env, fdObj);
+          if (afd >= 0) {
+            RETRY_ON_EINTR(ret, close(afd));
+          }
+          (*env)->SetObjectArrayElement(env, jfds, j, NULL);
+          (*env)->DeleteLocalRef(env, fdObj);
+        }
+      }
+      (*env)->DeleteLocalRef(env, jfds);
+    }
+  }
+  fd_batch_free(&batch);
+  if (jthr) {
+    (*env)->Throw(env, jthr);
+    return 0;
+  }
+  return num > 0 ? num : -1;
+}
+
 JNIEXPORT jint JNICALL
 Java_org_apache_hadoop_net_unix_DomainSocket_readArray0(
 JNIEnv *env, jclass clazz, jint fd, jarray b, jint offset, jint length)
@@ -1033,3 +1457,130 @@ done:
   }
   return res;
 }
+
+/**
+ * Can't read into or write from more than this number of buffers in a single
+ * system call.  Longer arrays are handled as partial reads and writes.
+ */
+#define MAX_SCATTER_BUFS 64
+
+/**
+ * Point iovecs at the remaining bytes of some direct buffers.
+ *
+ * @return          NULL on success, or the exception to throw.
+ */
+static jthrowable direct_bufs_to_iovecs(JNIEnv *env, jobjectArray jbufs,
+    jintArray jpositions, jintArray jremaining, int count,
+    struct iovec *vecs)
+{
+  jint positions[MAX_SCATTER_BUFS], remaining[MAX_SCATTER_BUFS];
+  jobject jbuf;
+  uint8_t *buf;
+  jthrowable jthr;
+  int i;
+
+  (*env)->GetIntArrayRegion(env, jpositions, 0, count, positions);
+  (*env)->GetIntArrayRegion(env, jremaining, 0, count, remaining);
+  jthr = (*env)->ExceptionOccurred(env);
+  if (jthr) {
+    (*env)->ExceptionClear(env);
+    return jthr;
+  }
+  for (i = 0; i < count; i++) {
+    jbuf = (*env)->GetObjectArrayElement(env, jbufs, i);
+    if (!jbuf) {
+      jthr = (*env)->ExceptionOccurred(env);
+      if (jthr) {
+        (*env)->ExceptionClear(env);
+        return jthr;
+      }
+      return newException(env, "java/lang/NullPointerException",
+            "buffer %d was NULL.", i);
+    }
+    buf = (*env)->GetDirectBufferAddress(env, jbuf);
+    (*env)->DeleteLocalRef(env, jbuf);
+    if (!buf) {
+      return newRuntimeException(env, "GetDirectBufferAddress failed.");
+    }
+    vecs[i].iov_base = buf + positions[i];
+    vecs[i].iov_len = remaining[i];
+  }
+  return NULL;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocket_readv0(
+JNIEnv *env, jclass clazz, jint fd, jobjectArray jbufs, jintArray jpositions,
+jintArray jremaining, jint count, jboolean waitAll)
+{
+  struct iovec vecs[MAX_SCATTER_BUFS];
+  struct msghdr socketMsg;
+  jthrowable jthr;
+  ssize_t res = -1;
+
+  if (count > MAX_SCATTER_BUFS) {
+    count = MAX_SCATTER_BUFS;
+  }
+  jthr = direct_bufs_to_iovecs(env, jbufs, jpositions, jremaining, count,
+                               vecs);
+  if (jthr) {
+    goto done;
+  }
+  memset(&socketMsg, 0, sizeof(socketMsg));
+  socketMsg.msg_iov = vecs;
+  socketMsg.msg_iovlen = count;
+  // With MSG_WAITALL, a packet header and its payload come back together
+  // rather than as whatever happened to have arrived
+  RETRY_ON_EINTR(res, recvmsg(fd, &socketMsg, waitAll ? MSG_WAITALL : 0));
+  if (res < 0) {
+    int err = errno;
+    if (err != ECONNABORTED) {
+      jthr = newSocketException(env, err, "recvmsg(2) error: %s",
+                                terror(err));
+      goto done;
+    }
+    // The remote peer disconnected on us.  Treat this as an EOF.
+    res = 0;
+  }
+  if (res == 0) {
+    res = -1;
+  }
+done:
+  if (jthr) {
+    (*env)->Throw(env, jthr);
+  }
+  return res;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocket_writev0(
+JNIEnv *env, jclass clazz, jint fd, jobjectArray jbufs, jintArray jpositions,
+jintArray jremaining, jint count)
+{
+  struct iovec vecs[MAX_SCATTER_BUFS];
+  struct msghdr socketMsg;
+  jthrowable jthr;
+  ssize_t res = -1;
+
+  if (count > MAX_SCATTER_BUFS) {
+    count = MAX_SCATTER_BUFS;
+  }
+  jthr = direct_bufs_to_iovecs(env, jbufs, jpositions, jremaining, count,
+                               vecs);
+  if (jthr) {
+    goto done;
+  }
+  memset(&socketMsg, 0, sizeof(socketMsg));
+  socketMsg.msg_iov = vecs;
+  socketMsg.msg_iovlen = count;
+  RETRY_ON_EINTR(res, sendmsg(fd, &socketMsg, PLATFORM_SEND_FLAGS));
+  if (res < 0) {
+    int err = errno;
+    jthr = newSocketException(env, err, "sendmsg(2) error: %s", terror(err));
+  }
+done:
+  if (jthr) {
+    (*env)->Throw(env, jthr);
+  }
+  return res;
+}
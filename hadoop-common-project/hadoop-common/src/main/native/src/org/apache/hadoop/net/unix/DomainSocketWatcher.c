@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -38,6 +41,40 @@ static jfieldID fd_set_data_fid;
 
 #define FD_SET_DATA_MIN_SIZE 2
 
+#ifdef __linux__
+/*
+ * On Linux the FdSet is an epoll set, so that adding and removing an fd and
+ * finding the readable ones do not cost a walk over every watched fd.
+ */
+struct fd_set_data {
+  /**
+   * The epoll fd.
+   */
+  int epfd;
+
+  /**
+   * Number of events we have allocated space for.
+   */
+  int alloc_size;
+
+  /**
+   * Number of fds in the epoll set.
+   */
+  int used_size;
+
+  /**
+   * Number of events the last doPoll0 returned which have not been handed
+   * out by getAndClearReadableFds yet.
+   */
+  int num_ready;
+
+  /**
+   * Beginning of the events returned by epoll_wait.
+   */
+  struct epoll_event events[0];
+};
+
+#else
 struct fd_set_data {
   /**
    * Number of fds we have allocated space for.
@@ -54,6 +91,7 @@ struct fd_set_data {
    */
   struct pollfd pollfd[0];
 };
+#endif
 
 JNIEXPORT void JNICALL
 Java_org_apache_hadoop_net_unix_DomainSocketWatcher_anchorNative(
@@ -68,6 +106,189 @@ JNIEnv *env, jclass clazz)
   if (!fd_set_data_fid) return; // exception raised
 }
 
+#ifdef __linux__
+JNIEXPORT jlong JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocketWatcher_00024FdSet_alloc0(
+JNIEnv *env, jclass clazz)
+{
+  struct fd_set_data *sd;
+  int err;
+
+  sd = calloc(1, sizeof(struct fd_set_data) +
+              (sizeof(struct epoll_event) * FD_SET_DATA_MIN_SIZE));
+  if (!sd) {
+    (*env)->Throw(env, newRuntimeException(env, "out of memory allocating "
+                                            "DomainSocketWatcher#FdSet"));
+    return 0L;
+  }
+  sd->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (sd->epfd < 0) {
+    err = errno;
+    free(sd);
+    (*env)->Throw(env, newRuntimeException(env, "epoll_create1(2) failed "
+            "with error code %d: %s", err, terror(err)));
+    return 0L;
+  }
+  sd->alloc_size = FD_SET_DATA_MIN_SIZE;
+  return (jlong)(intptr_t)sd;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocketWatcher_00024FdSet_add(
+JNIEnv *env, jobject obj, jint fd)
+{
+  struct fd_set_data *sd, *nd;
+  struct epoll_event event;
+  int err;
+
+  sd = (struct fd_set_data*)(intptr_t)(*env)->
+    GetLongField(env, obj, fd_set_data_fid);
+  // Keep room for every fd to be returned by a single epoll_wait
+  if (sd->used_size + 1 > sd->alloc_size) {
+    nd = realloc(sd, sizeof(struct fd_set_data) +
+            (sizeof(struct epoll_event) * sd->alloc_size * 2));
+    if (!nd) {
+      (*env)->Throw(env, newRuntimeException(env, "out of memory adding "
+            "another fd to DomainSocketWatcher#FdSet.  we have %d already",
+            sd->alloc_size));
+      return;
+    }
+    nd->alloc_size = nd->alloc_size * 2;
+    (*env)->SetLongField(env, obj, fd_set_data_fid, (jlong)(intptr_t)nd);
+    sd = nd;
+  }
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN | EPOLLHUP;
+  event.data.fd = fd;
+  if (epoll_ctl(sd->epfd, EPOLL_CTL_ADD, fd, &event)) {
+    err = errno;
+    (*env)->Throw(env, newRuntimeException(env, "failed to add fd %d to "
+          "the FdSet: epoll_ctl(2) failed with error code %d: %s", fd, err,
+          terror(err)));
+    return;
+  }
+  sd->used_size++;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocketWatcher_00024FdSet_remove(
+JNIEnv *env, jobject obj, jint fd)
+{
+  struct fd_set_data *sd;
+  int i;
+
+  sd = (struct fd_set_data*)(intptr_t)(*env)->
+      GetLongField(env, obj, fd_set_data_fid);
+  if (epoll_ctl(sd->epfd, EPOLL_CTL_DEL, fd, NULL)) {
+    // Closing the last reference to a file leaves the epoll set by itself,
+    // so EBADF means the fd is gone already
+    if (errno != EBADF) {
+      (*env)->Throw(env, newRuntimeException(env, "failed to remove fd %d "
+            "from the FdSet because it was never present.", fd));
+      return;
+    }
+  }
+  sd->used_size--;
+  // Do not hand out an fd which is no longer watched
+  for (i = 0; i < sd->num_ready; i++) {
+    if (sd->events[i].data.fd == fd) {
+      sd->events[i] = sd->events[--sd->num_ready];
+      break;
+    }
+  }
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocketWatcher_00024FdSet_getAndClearReadableFds(
+JNIEnv *env, jobject obj)
+{
+  int *carr = NULL;
+  jobject jarr = NULL;
+  struct fd_set_data *sd;
+  int num_ready, num_readable = 0, i;
+  jthrowable jthr = NULL;
+
+  sd = (struct fd_set_data*)(intptr_t)(*env)->
+      GetLongField(env, obj, fd_set_data_fid);
+  num_ready = sd->num_ready;
+  sd->num_ready = 0;
+  if (num_ready > 0) {
+    carr = malloc(sizeof(int) * num_ready);
+    if (!carr) {
+      jthr = newRuntimeException(env, "failed to allocate a temporary array "
+            "of %d ints", num_ready);
+      goto done;
+    }
+    for (i = 0; i < num_ready; i++) {
+      // We check for both EPOLLIN and EPOLLHUP, as the poll(2) version
+      // checks for both POLLIN and POLLHUP
+      if (sd->events[i].events & (EPOLLIN | EPOLLHUP)) {
+        carr[num_readable++] = sd->events[i].data.fd;
+      }
+    }
+  }
+  jarr = (*env)->NewIntArray(env, num_readable);
+  if (!jarr) {
+    jthr = (*env)->ExceptionOccurred(env);
+    (*env)->ExceptionClear(env);
+    goto done;
+  }
+  if (num_readable > 0) {
+    (*env)->SetIntArrayRegion(env, jarr, 0, num_readable, carr);
+    jthr = (*env)->ExceptionOccurred(env);
+    if (jthr) {
+      (*env)->ExceptionClear(env);
+      goto done;
+    }
+  }
+
+done:
+  free(carr);
+  if (jthr) {
+    (*env)->DeleteLocalRef(env, jarr);
+    (*env)->Throw(env, jthr);
+  }
+  return jarr;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocketWatcher_00024FdSet_close(
+JNIEnv *env, jobject obj)
+{
+  struct fd_set_data *sd;
+
+  sd = (struct fd_set_data*)(intptr_t)(*env)->
+      GetLongField(env, obj, fd_set_data_fid);
+  if (sd) {
+    close(sd->epfd);
+    free(sd);
+    (*env)->SetLongField(env, obj, fd_set_data_fid, 0L);
+  }
+}
+
+JNIEXPORT jint JNICALL
+Java_org_apache_hadoop_net_unix_DomainSocketWatcher_doPoll0(
+JNIEnv *env, jclass clazz, jint checkMs, jobject fdSet)
+{
+  struct fd_set_data *sd;
+  int ret, err;
+
+  sd = (struct fd_set_data*)(intptr_t)(*env)->
+      GetLongField(env, fdSet, fd_set_data_fid);
+  ret = epoll_wait(sd->epfd, sd->events, sd->alloc_size, checkMs);
+  if (ret >= 0) {
+    sd->num_ready = ret;
+    return ret;
+  }
+  err = errno;
+  if (err != EINTR) { // treat EINTR as 0 fds ready
+    (*env)->Throw(env, newIOException(env,
+            "epoll_wait(2) failed with error code %d: %s", err, terror(err)));
+  }
+  return 0;
+}
+
+#else
 JNIEXPORT jlong JNICALL
 Java_org_apache_hadoop_net_unix_DomainSocketWatcher_00024FdSet_alloc0(
 JNIEnv *env, jclass clazz)
@@ -251,3 +472,4 @@ JNIEnv *env, jclass clazz, jint checkMs, jobject fdSet)
   }
   return 0;
 }
+#endif
@@ -0,0 +1,49 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+#include "org_apache_hadoop_net_unix_ShortCircuitStats.h"
+#include "short_circuit_stats.h"
+
+// count, total and max nanos, then the buckets, of every operation
+#define VALUES_PER_OP (3 + SHORT_CIRCUIT_BUCKETS)
+
+JNIEXPORT jlongArray JNICALL Java_org_apache_hadoop_net_unix_ShortCircuitStats_nativeGetStats
+  (JNIEnv *env, jclass clazz)
+{
+  jlong values[VALUES_PER_OP * SHORT_CIRCUIT_OPS];
+  struct short_circuit_stats stats;
+  jlongArray result;
+  int i, j;
+
+  for (i = 0; i < SHORT_CIRCUIT_OPS; i++) {
+    get_short_circuit_stats((enum short_circuit_op)i, &stats);
+    values[VALUES_PER_OP * i] = stats.count;
+    values[VALUES_PER_OP * i + 1] = stats.total_nanos;
+    values[VALUES_PER_OP * i + 2] = stats.max_nanos;
+    for (j = 0; j < SHORT_CIRCUIT_BUCKETS; j++) {
+      values[VALUES_PER_OP * i + 3 + j] = stats.buckets[j];
+    }
+  }
+  result = (*env)->NewLongArray(env, VALUES_PER_OP * SHORT_CIRCUIT_OPS);
+  if (result) {
+    (*env)->SetLongArrayRegion(env, result, 0,
+        VALUES_PER_OP * SHORT_CIRCUIT_OPS, values);
+  }
+  return result;
+}
@@ -0,0 +1,79 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "short_circuit_stats.h"
+
+#include <time.h>
+
+static struct short_circuit_stats op_stats[SHORT_CIRCUIT_OPS];
+
+int64_t short_circuit_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int bucket_of(int64_t nanos)
+{
+  uint64_t micros = (uint64_t)nanos / 1000;
+  int bucket = 0;
+
+  while (micros) {
+    micros >>= 1;
+    bucket++;
+  }
+  return bucket < SHORT_CIRCUIT_BUCKETS ? bucket : SHORT_CIRCUIT_BUCKETS - 1;
+}
+
+void short_circuit_record(enum short_circuit_op op, int64_t start)
+{
+  struct short_circuit_stats *stats = &op_stats[op];
+  int64_t nanos = short_circuit_now() - start;
+  int64_t seen;
+
+  if (nanos < 0) {
+    nanos = 0;
+  }
+  __atomic_add_fetch(&stats->count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&stats->total_nanos, nanos, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&stats->buckets[bucket_of(nanos)], 1, __ATOMIC_RELAXED);
+  seen = __atomic_load_n(&stats->max_nanos, __ATOMIC_RELAXED);
+  while (nanos > seen &&
+         !__atomic_compare_exchange_n(&stats->max_nanos, &seen, nanos, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void get_short_circuit_stats(enum short_circuit_op op,
+                             struct short_circuit_stats *stats)
+{
+  int i;
+
+  stats->count = __atomic_load_n(&op_stats[op].count, __ATOMIC_RELAXED);
+  stats->total_nanos =
+      __atomic_load_n(&op_stats[op].total_nanos, __ATOMIC_RELAXED);
+  stats->max_nanos =
+      __atomic_load_n(&op_stats[op].max_nanos, __ATOMIC_RELAXED);
+  for (i = 0; i < SHORT_CIRCUIT_BUCKETS; i++) {
+    stats->buckets[i] =
+        __atomic_load_n(&op_stats[op].buckets[i], __ATOMIC_RELAXED);
+  }
+}
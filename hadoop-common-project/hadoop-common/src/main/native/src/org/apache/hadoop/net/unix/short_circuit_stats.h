@@ -0,0 +1,85 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ORG_APACHE_HADOOP_NET_UNIX_SHORT_CIRCUIT_STATS_H
+#define ORG_APACHE_HADOOP_NET_UNIX_SHORT_CIRCUIT_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Latencies of the native calls that set up a short-circuit read: the
+ * connect to the DataNode's domain socket, the passing of the block and
+ * shared memory descriptors over it, and the allocation of shared memory
+ * segments.  For every operation libhadoop counts the calls that
+ * succeeded, their total and longest time, and a histogram of their
+ * times with power of two buckets of microseconds.  Updates are atomic,
+ * a handful per call, so the counters are always on.
+ */
+enum short_circuit_op {
+  // DomainSocket#connect
+  SHORT_CIRCUIT_CONNECT = 0,
+  // DomainSocket#sendFileDescriptors, and every batch of them
+  SHORT_CIRCUIT_SEND_FDS = 1,
+  // DomainSocket#receiveFileDescriptors, and every batch of them
+  SHORT_CIRCUIT_RECEIVE_FDS = 2,
+  // A SharedFileDescriptorFactory segment, from a file or a memfd
+  SHORT_CIRCUIT_SHM_ALLOC = 3,
+  SHORT_CIRCUIT_OPS = 4
+};
+
+/**
+ * Bucket 0 counts the calls that took less than a microsecond, bucket i
+ * those that took from 2^(i-1) up to 2^i microseconds, and the last one
+ * everything longer, from about 17 seconds on.
+ */
+#define SHORT_CIRCUIT_BUCKETS 26
+
+struct short_circuit_stats {
+  int64_t count;
+  int64_t total_nanos;
+  int64_t max_nanos;
+  int64_t buckets[SHORT_CIRCUIT_BUCKETS];
+};
+
+/**
+ * A monotonic clock in nanoseconds, to take before the operation.
+ */
+int64_t short_circuit_now(void);
+
+/**
+ * Accounts an operation that started at start, by short_circuit_now, and
+ * has just finished.
+ */
+void short_circuit_record(enum short_circuit_op op, int64_t start);
+
+/**
+ * Gets the counters of op.
+ */
+void get_short_circuit_stats(enum short_circuit_op op,
+                             struct short_circuit_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ORG_APACHE_HADOOP_NET_UNIX_SHORT_CIRCUIT_STATS_H
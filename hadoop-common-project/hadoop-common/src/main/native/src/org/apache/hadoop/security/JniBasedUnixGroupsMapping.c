@@ -26,9 +26,12 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <grp.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <string.h>
+#include <time.h>
 
 #include "exception.h"
 #include "org_apache_hadoop_security_JniBasedUnixGroupsMapping.h"
@@ -40,6 +43,8 @@ static jmethodID g_log_error_method;
 
 static jclass g_string_clazz;
 
+static jclass g_string_array_clazz;
+
 extern jobject pw_lock_object;
 
 JNIEXPORT void JNICALL
@@ -65,6 +70,18 @@ JNIEnv *env, jclass clazz)
     (*env)->Throw(env, jthr);
     return;
   }
+  string_clazz = (*env)->FindClass(env, "[Ljava/lang/String;");
+  if (!string_clazz) {
+    return; // an exception has been raised
+  }
+  g_string_array_clazz = (*env)->NewGlobalRef(env, string_clazz);
+  if (!g_string_array_clazz) {
+    jthrowable jthr = newRuntimeException(env,
+        "JniBasedUnixGroupsMapping#anchorNative: failed to make "
+        "a global reference to the java.lang.String[] class\n");
+    (*env)->Throw(env, jthr);
+    return;
+  }
 }
 
 /**
@@ -92,48 +109,199 @@ static void logError(JNIEnv *env, jclass clazz, jint gid, int ret)
   (*env)->DeleteLocalRef(env, error_msg);
 }
 
-JNIEXPORT jobjectArray JNICALL 
-Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_getGroupsForUser 
-(JNIEnv *env, jclass clazz, jstring jusername)
+/**
+ * A cache of group names by gid, shared by all lookups, so that users in
+ * hundreds of groups do not cost hundreds of NSS calls each time.  Groups
+ * whose name could not be looked up are cached too, for a shorter time, so
+ * that a failing directory service is not asked again for every user.
+ */
+#define GID_CACHE_BUCKETS 4096
+// Past this, the whole cache is dropped rather than evicting entries
+#define GID_CACHE_MAX_ENTRIES 65536
+
+struct gid_cache_entry {
+  gid_t gid;
+  // A global reference to the name, or NULL if the lookup failed
+  jstring name;
+  // When the entry expires, in monotonic milliseconds
+  int64_t expires;
+  struct gid_cache_entry *next;
+};
+
+static pthread_mutex_t g_gid_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct gid_cache_entry *g_gid_cache[GID_CACHE_BUCKETS];
+static int g_gid_cache_size;
+static int64_t g_gid_cache_ttl_ms = 300000;
+static int64_t g_gid_cache_negative_ttl_ms = 30000;
+
+static int64_t monotonic_now_ms(void)
 {
-  const char *username = NULL;
-  struct hadoop_user_info *uinfo = NULL;
-  struct hadoop_group_info *ginfo = NULL;
-  jstring jgroupname = NULL;
-  int i, ret, nvalid;
-  int pw_lock_locked = 0;
-  jobjectArray jgroups = NULL, jnewgroups = NULL;
+  struct timespec ts;
 
-  if (pw_lock_object != NULL) {
-    if ((*env)->MonitorEnter(env, pw_lock_object) != JNI_OK) {
-      goto done; // exception thrown
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((int64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static void gid_cache_entry_free(JNIEnv *env, struct gid_cache_entry *entry)
+{
+  if (entry->name) {
+    (*env)->DeleteGlobalRef(env, entry->name);
+  }
+  free(entry);
+}
+
+/**
+ * Drop every entry.  Called with the cache lock held.
+ */
+static void gid_cache_clear(JNIEnv *env)
+{
+  struct gid_cache_entry *entry, *next;
+  int i;
+
+  for (i = 0; i < GID_CACHE_BUCKETS; i++) {
+    for (entry = g_gid_cache[i]; entry; entry = next) {
+      next = entry->next;
+      gid_cache_entry_free(env, entry);
     }
-    pw_lock_locked = 1;
+    g_gid_cache[i] = NULL;
   }
-  username = (*env)->GetStringUTFChars(env, jusername, NULL);
-  if (username == NULL) {
-    goto done; // exception thrown
+  g_gid_cache_size = 0;
+}
+
+/**
+ * Find the live entry for a gid, dropping it if it has expired.  Called
+ * with the cache lock held.
+ */
+static struct gid_cache_entry *gid_cache_find(JNIEnv *env, gid_t gid,
+                                              int64_t now)
+{
+  struct gid_cache_entry **p, *entry;
+
+  for (p = &g_gid_cache[gid % GID_CACHE_BUCKETS]; (entry = *p);
+       p = &entry->next) {
+    if (entry->gid != gid) {
+      continue;
+    }
+    if (entry->expires - now > 0) {
+      return entry;
+    }
+    *p = entry->next;
+    gid_cache_entry_free(env, entry);
+    g_gid_cache_size--;
+    return NULL;
   }
-  uinfo = hadoop_user_info_alloc();
-  if (!uinfo) {
-    THROW(env, "java/lang/OutOfMemoryError", NULL);
-    goto done;
+  return NULL;
+}
+
+/**
+ * Cache the name of a group, or its absence if name is NULL.  The cache
+ * takes its own reference to the name.
+ */
+static void gid_cache_put(JNIEnv *env, gid_t gid, jstring name)
+{
+  struct gid_cache_entry *entry;
+  int64_t now, ttl;
+
+  entry = calloc(1, sizeof(*entry));
+  if (!entry) {
+    return; // the lookup is just not cached
+  }
+  if (name) {
+    entry->name = (*env)->NewGlobalRef(env, name);
+    if (!entry->name) {
+      free(entry);
+      return;
+    }
+  }
+  entry->gid = gid;
+  pthread_mutex_lock(&g_gid_cache_lock);
+  ttl = name ? g_gid_cache_ttl_ms : g_gid_cache_negative_ttl_ms;
+  now = monotonic_now_ms();
+  if (ttl <= 0 || gid_cache_find(env, gid, now)) {
+    // Caching is off, or another thread got there first
+    pthread_mutex_unlock(&g_gid_cache_lock);
+    gid_cache_entry_free(env, entry);
+    return;
   }
+  if (g_gid_cache_size >= GID_CACHE_MAX_ENTRIES) {
+    gid_cache_clear(env);
+  }
+  entry->expires = now + ttl;
+  entry->next = g_gid_cache[gid % GID_CACHE_BUCKETS];
+  g_gid_cache[gid % GID_CACHE_BUCKETS] = entry;
+  g_gid_cache_size++;
+  pthread_mutex_unlock(&g_gid_cache_lock);
+}
+
+/**
+ * Look up the name of a group, from the cache if possible.
+ *
+ * @param env   The JNI environment
+ * @param clazz JniBasedUnixGroupsMapping class
+ * @param ginfo The group info context to look up with on a miss
+ * @param gid   The gid to look up
+ * @param jname Set to a local reference to the name on success
+ *
+ * @return      0 on success, ENOENT if the group has no name, or -1 if
+ *              an exception has been raised
+ */
+static int get_group_name(JNIEnv *env, jclass clazz,
+                          struct hadoop_group_info *ginfo, gid_t gid,
+                          jstring *jname)
+{
+  struct gid_cache_entry *entry;
+  int ret;
+
+  pthread_mutex_lock(&g_gid_cache_lock);
+  entry = gid_cache_find(env, gid, monotonic_now_ms());
+  if (entry) {
+    ret = ENOENT;
+    if (entry->name) {
+      *jname = (*env)->NewLocalRef(env, entry->name);
+      ret = *jname ? 0 : -1;
+    }
+    pthread_mutex_unlock(&g_gid_cache_lock);
+    return ret;
+  }
+  pthread_mutex_unlock(&g_gid_cache_lock);
+
+  ret = hadoop_group_info_fetch(ginfo, gid);
+  if (ret) {
+    logError(env, clazz, gid, ret);
+    gid_cache_put(env, gid, NULL);
+    return ENOENT;
+  }
+  *jname = (*env)->NewStringUTF(env, ginfo->group.gr_name);
+  if (!*jname) {
+    return -1; // exception raised
+  }
+  gid_cache_put(env, gid, *jname);
+  return 0;
+}
+
+/**
+ * Get the names of the groups of a user.  Called with the pw lock held.
+ *
+ * @return      The names, or NULL if an exception has been raised
+ */
+static jobjectArray get_groups(JNIEnv *env, jclass clazz,
+                               const char *username,
+                               struct hadoop_user_info *uinfo,
+                               struct hadoop_group_info *ginfo)
+{
+  jstring jgroupname = NULL;
+  int i, ret, nvalid;
+  jobjectArray jgroups = NULL, jnewgroups = NULL;
+
   ret = hadoop_user_info_fetch(uinfo, username);
   if (ret) {
     if (ret == ENOENT) {
-      jgroups = (*env)->NewObjectArray(env, 0, g_string_clazz, NULL);
-    } else { // handle other errors
-      (*env)->Throw(env, newRuntimeException(env,
-          "getgrouplist: error looking up user. %d (%s)", ret, terror(ret)));
+      return (*env)->NewObjectArray(env, 0, g_string_clazz, NULL);
     }
-    goto done;
-  }
-
-  ginfo = hadoop_group_info_alloc();
-  if (!ginfo) {
-    THROW(env, "java/lang/OutOfMemoryError", NULL);
-    goto done;
+    // handle other errors
+    (*env)->Throw(env, newRuntimeException(env,
+        "getgrouplist: error looking up user. %d (%s)", ret, terror(ret)));
+    return NULL;
   }
   ret = hadoop_user_info_getgroups(uinfo);
   if (ret) {
@@ -143,21 +311,19 @@ Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_getGroupsForUser
       (*env)->Throw(env, newRuntimeException(env,
           "getgrouplist: error looking up group. %d (%s)", ret, terror(ret)));
     }
-    goto done;
+    return NULL;
   }
   jgroups = (jobjectArray)(*env)->NewObjectArray(env, uinfo->num_gids,
                                                  g_string_clazz, NULL);
+  if (!jgroups) {
+    return NULL; // exception raised
+  }
   for (nvalid = 0, i = 0; i < uinfo->num_gids; i++) {
-    ret = hadoop_group_info_fetch(ginfo, uinfo->gids[i]);
-    if (ret) {
-      logError(env, clazz, uinfo->gids[i], ret);
-    } else {
-      jgroupname = (*env)->NewStringUTF(env, ginfo->group.gr_name);
-      if (!jgroupname) { // exception raised
-        (*env)->DeleteLocalRef(env, jgroups);
-        jgroups = NULL;
-        goto done;
-      }
+    ret = get_group_name(env, clazz, ginfo, uinfo->gids[i], &jgroupname);
+    if (ret < 0) { // exception raised
+      (*env)->DeleteLocalRef(env, jgroups);
+      return NULL;
+    } else if (ret == 0) {
       (*env)->SetObjectArrayElement(env, jgroups, nvalid++, jgroupname);
       // We delete the local reference once the element is in the array.
       // This is OK because the array has a reference to it.
@@ -171,11 +337,10 @@ Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_getGroupsForUser
     // with just the entries that could be resolved.  Java has no equivalent to
     // realloc, so we have to do this manually.
     jnewgroups = (jobjectArray)(*env)->NewObjectArray(env, nvalid,
-            (*env)->FindClass(env, "java/lang/String"), NULL);
+            g_string_clazz, NULL);
     if (!jnewgroups) { // exception raised
       (*env)->DeleteLocalRef(env, jgroups);
-      jgroups = NULL;
-      goto done;
+      return NULL;
     }
     for (i = 0; i < nvalid; i++) {
       jgroupname = (*env)->GetObjectArrayElement(env, jgroups, i);
@@ -185,6 +350,40 @@ Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_getGroupsForUser
     (*env)->DeleteLocalRef(env, jgroups);
     jgroups = jnewgroups;
   }
+  return jgroups;
+}
+
+JNIEXPORT jobjectArray JNICALL 
+Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_getGroupsForUser 
+(JNIEnv *env, jclass clazz, jstring jusername)
+{
+  const char *username = NULL;
+  struct hadoop_user_info *uinfo = NULL;
+  struct hadoop_group_info *ginfo = NULL;
+  int pw_lock_locked = 0;
+  jobjectArray jgroups = NULL;
+
+  if (pw_lock_object != NULL) {
+    if ((*env)->MonitorEnter(env, pw_lock_object) != JNI_OK) {
+      goto done; // exception thrown
+    }
+    pw_lock_locked = 1;
+  }
+  username = (*env)->GetStringUTFChars(env, jusername, NULL);
+  if (username == NULL) {
+    goto done; // exception thrown
+  }
+  uinfo = hadoop_user_info_alloc();
+  if (!uinfo) {
+    THROW(env, "java/lang/OutOfMemoryError", NULL);
+    goto done;
+  }
+  ginfo = hadoop_group_info_alloc();
+  if (!ginfo) {
+    THROW(env, "java/lang/OutOfMemoryError", NULL);
+    goto done;
+  }
+  jgroups = get_groups(env, clazz, username, uinfo, ginfo);
 
 done:
   if (pw_lock_locked) {
@@ -199,8 +398,110 @@ done:
   if (ginfo) {
     hadoop_group_info_free(ginfo);
   }
-  if (jgroupname) {
-    (*env)->DeleteLocalRef(env, jgroupname);
-  }
   return jgroups;
 }
+
+JNIEXPORT jobjectArray JNICALL
+Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_getGroupsForUsers
+(JNIEnv *env, jclass clazz, jobjectArray jusernames)
+{
+  const char *username = NULL;
+  struct hadoop_user_info *uinfo = NULL;
+  struct hadoop_group_info *ginfo = NULL;
+  jstring jusername = NULL;
+  int i, num_users, pw_lock_locked = 0;
+  jobjectArray jresult = NULL, jgroups;
+
+  num_users = (*env)->GetArrayLength(env, jusernames);
+  jresult = (*env)->NewObjectArray(env, num_users, g_string_array_clazz,
+                                   NULL);
+  if (!jresult) {
+    goto done; // exception thrown
+  }
+  if (pw_lock_object != NULL) {
+    if ((*env)->MonitorEnter(env, pw_lock_object) != JNI_OK) {
+      goto error; // exception thrown
+    }
+    pw_lock_locked = 1;
+  }
+  // One context for all of the users, so that its buffers only grow once
+  uinfo = hadoop_user_info_alloc();
+  if (!uinfo) {
+    THROW(env, "java/lang/OutOfMemoryError", NULL);
+    goto error;
+  }
+  ginfo = hadoop_group_info_alloc();
+  if (!ginfo) {
+    THROW(env, "java/lang/OutOfMemoryError", NULL);
+    goto error;
+  }
+  for (i = 0; i < num_users; i++) {
+    jusername = (*env)->GetObjectArrayElement(env, jusernames, i);
+    if (!jusername) {
+      // An unknown user has no groups, leave its element null.
+      if ((*env)->ExceptionCheck(env)) {
+        goto error;
+      }
+      continue;
+    }
+    username = (*env)->GetStringUTFChars(env, jusername, NULL);
+    if (!username) {
+      goto error; // exception thrown
+    }
+    jgroups = get_groups(env, clazz, username, uinfo, ginfo);
+    (*env)->ReleaseStringUTFChars(env, jusername, username);
+    username = NULL;
+    (*env)->DeleteLocalRef(env, jusername);
+    jusername = NULL;
+    if (!jgroups) {
+      // Leave this user out, as getGroupsForUser would have failed for it
+      // alone, but go on with the others.
+      (*env)->ExceptionClear(env);
+      continue;
+    }
+    (*env)->SetObjectArrayElement(env, jresult, i, jgroups);
+    (*env)->DeleteLocalRef(env, jgroups);
+  }
+  goto done;
+
+error:
+  (*env)->DeleteLocalRef(env, jresult);
+  jresult = NULL;
+
+done:
+  if (pw_lock_locked) {
+    (*env)->MonitorExit(env, pw_lock_object);
+  }
+  if (username) {
+    (*env)->ReleaseStringUTFChars(env, jusername, username);
+  }
+  if (jusername) {
+    (*env)->DeleteLocalRef(env, jusername);
+  }
+  if (uinfo) {
+    hadoop_user_info_free(uinfo);
+  }
+  if (ginfo) {
+    hadoop_group_info_free(ginfo);
+  }
+  return jresult;
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_setGroupNameCacheTimeouts
+(JNIEnv *env, jclass clazz, jlong ttlMs, jlong negativeTtlMs)
+{
+  pthread_mutex_lock(&g_gid_cache_lock);
+  g_gid_cache_ttl_ms = ttlMs;
+  g_gid_cache_negative_ttl_ms = negativeTtlMs;
+  pthread_mutex_unlock(&g_gid_cache_lock);
+}
+
+JNIEXPORT void JNICALL
+Java_org_apache_hadoop_security_JniBasedUnixGroupsMapping_clearGroupNameCache
+(JNIEnv *env, jclass clazz)
+{
+  pthread_mutex_lock(&g_gid_cache_lock);
+  gid_cache_clear(env);
+  pthread_mutex_unlock(&g_gid_cache_lock);
+}
@@ -42,26 +42,41 @@ struct listElement {
 
 typedef struct listElement UserList;
 
-JNIEXPORT jobjectArray JNICALL 
-Java_org_apache_hadoop_security_JniBasedUnixGroupsNetgroupMapping_getUsersForNetgroupJNI
-(JNIEnv *env, jobject jobj, jstring jgroup) {
+// get_netgroup_users results, besides success
+#define NETGROUP_EXCEPTION -1
+#define NETGROUP_UNKNOWN 1
+
+/**
+ * Get the users of a netgroup.  The netgroup functions share state across
+ * the process, so callers must not run it concurrently.
+ *
+ * @param env     The JNI environment
+ * @param jgroup  The netgroup, without '@'
+ * @param jusers  Set to the users on success
+ *
+ * @return        0 on success, NETGROUP_UNKNOWN if there is no netgroup of
+ *                this name, or NETGROUP_EXCEPTION if an exception has been
+ *                raised
+ */
+static int get_netgroup_users(JNIEnv *env, jstring jgroup,
+                              jobjectArray *jusers)
+{
   UserList *userListHead = NULL;
   UserList *current = NULL;
   int       userListSize = 0;
+  int       ret = 0;
 
   // pointers to free at the end
   const char *cgroup  = NULL;
-  jobjectArray jusers = NULL;
+  jclass string_clazz = NULL;
 
   // do we need to end the group lookup?
   int setnetgrentCalledFlag = 0;
 
-  // if not NULL then THROW exception
-  char *errorType = NULL;
-  char *errorMessage = NULL;
-
+  *jusers = NULL;
   cgroup = (*env)->GetStringUTFChars(env, jgroup, NULL);
   if (cgroup == NULL) {
+    ret = NETGROUP_EXCEPTION;
     goto END;
   }
 
@@ -87,31 +102,43 @@ Java_org_apache_hadoop_security_JniBasedUnixGroupsNetgroupMapping_getUsersForNet
     while(getnetgrent(p, p + 1, p + 2)) {
       if(p[1]) {
         current = (UserList *)malloc(sizeof(UserList));
-        current->string = malloc(strlen(p[1]) + 1);
-        strcpy(current->string, p[1]);
+        if (current == NULL) {
+          THROW(env, "java/lang/OutOfMemoryError", NULL);
+          ret = NETGROUP_EXCEPTION;
+          goto END;
+        }
+        current->string = strdup(p[1]);
         current->next = userListHead;
         userListHead = current;
+        if (current->string == NULL) {
+          THROW(env, "java/lang/OutOfMemoryError", NULL);
+          ret = NETGROUP_EXCEPTION;
+          goto END;
+        }
         userListSize++;
       }
     }
   }
 #if defined(__linux__)
   else {
-    errorType = "java/io/IOException";
-    errorMessage =
-        "no netgroup of this name is known or some other error occurred";
+    ret = NETGROUP_UNKNOWN;
     goto END;
   }
 #endif
   //--------------------------------------------------
   // build return data (java array)
 
-  jusers = (jobjectArray)(*env)->NewObjectArray(env,
+  string_clazz = (*env)->FindClass(env, "java/lang/String");
+  if (string_clazz == NULL) {
+    ret = NETGROUP_EXCEPTION;
+    goto END;
+  }
+  *jusers = (jobjectArray)(*env)->NewObjectArray(env,
     userListSize, 
-    (*env)->FindClass(env, "java/lang/String"),
+    string_clazz,
     NULL);
-  if (jusers == NULL) {
-    errorType = "java/lang/OutOfMemoryError";
+  if (*jusers == NULL) {
+    ret = NETGROUP_EXCEPTION;
     goto END;
   }
 
@@ -122,10 +149,15 @@ Java_org_apache_hadoop_security_JniBasedUnixGroupsNetgroupMapping_getUsersForNet
   for(current = userListHead; current != NULL; current = current->next) {
     jstring juser = (*env)->NewStringUTF(env, current->string);
     if (juser == NULL) {
-      errorType = "java/lang/OutOfMemoryError";
+      (*env)->DeleteLocalRef(env, *jusers);
+      *jusers = NULL;
+      ret = NETGROUP_EXCEPTION;
       goto END;
     }
-    (*env)->SetObjectArrayElement(env, jusers, i++, juser);
+    (*env)->SetObjectArrayElement(env, *jusers, i++, juser);
+    // The array holds the reference now, and a netgroup can have more users
+    // than the JVM guarantees local references for.
+    (*env)->DeleteLocalRef(env, juser);
   }
 
 
@@ -134,18 +166,69 @@ END:
   // cleanup
   if(cgroup) { (*env)->ReleaseStringUTFChars(env, jgroup, cgroup); }
   if(setnetgrentCalledFlag) { endnetgrent(); }
+  if(string_clazz) { (*env)->DeleteLocalRef(env, string_clazz); }
   while(userListHead) {
     UserList *current = userListHead;
     userListHead = userListHead->next;
     if(current->string) { free(current->string); }
     free(current);
   }
+  return ret;
+}
+
+JNIEXPORT jobjectArray JNICALL 
+Java_org_apache_hadoop_security_JniBasedUnixGroupsNetgroupMapping_getUsersForNetgroupJNI
+(JNIEnv *env, jobject jobj, jstring jgroup) {
+  jobjectArray jusers = NULL;
 
-  // return results or THROW
-  if(errorType) {
-    THROW(env, errorType, errorMessage);
+  if (get_netgroup_users(env, jgroup, &jusers) == NETGROUP_UNKNOWN) {
+    THROW(env, "java/io/IOException",
+        "no netgroup of this name is known or some other error occurred");
     return NULL;
-  } else {
-    return jusers;
   }
+  return jusers;
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_org_apache_hadoop_security_JniBasedUnixGroupsNetgroupMapping_getUsersForNetgroupsJNI
+(JNIEnv *env, jobject jobj, jobjectArray jgroups) {
+  jobjectArray jresult = NULL, jusers = NULL;
+  jclass string_array_clazz = NULL;
+  jstring jgroup;
+  int i, ngroups;
+
+  ngroups = (*env)->GetArrayLength(env, jgroups);
+  string_array_clazz = (*env)->FindClass(env, "[Ljava/lang/String;");
+  if (string_array_clazz == NULL) {
+    return NULL; // exception raised
+  }
+  jresult = (*env)->NewObjectArray(env, ngroups, string_array_clazz, NULL);
+  (*env)->DeleteLocalRef(env, string_array_clazz);
+  if (jresult == NULL) {
+    return NULL; // exception raised
+  }
+  for (i = 0; i < ngroups; i++) {
+    jgroup = (*env)->GetObjectArrayElement(env, jgroups, i);
+    if (jgroup == NULL) {
+      if ((*env)->ExceptionCheck(env)) {
+        goto ERROR;
+      }
+      continue;
+    }
+    // Unknown netgroups are left null
+    if (get_netgroup_users(env, jgroup, &jusers) == NETGROUP_EXCEPTION) {
+      (*env)->DeleteLocalRef(env, jgroup);
+      goto ERROR;
+    }
+    (*env)->DeleteLocalRef(env, jgroup);
+    if (jusers) {
+      (*env)->SetObjectArrayElement(env, jresult, i, jusers);
+      (*env)->DeleteLocalRef(env, jusers);
+    }
+  }
+  return jresult;
+
+ERROR:
+  (*env)->DeleteLocalRef(env, jresult);
+  return NULL;
 }
@@ -65,16 +65,16 @@ static void hadoop_user_info_clear(struct hadoop_user_info *uinfo)
   pwd->pw_gecos = NULL;
   pwd->pw_dir = NULL;
   pwd->pw_shell = NULL;
-  free(uinfo->gids);
-  uinfo->gids = 0;
+  // Keep the gids array, so that a context reused across users does not
+  // start over at INITIAL_GIDS_SIZE, and call getgrouplist twice, each time.
   uinfo->num_gids = 0;
-  uinfo->gids_size = 0;
 }
 
 void hadoop_user_info_free(struct hadoop_user_info *uinfo)
 {
   free(uinfo->buf);
   hadoop_user_info_clear(uinfo);
+  free(uinfo->gids);
   free(uinfo);
 }
 
@@ -181,6 +181,74 @@ JNIEXPORT void JNICALL Java_org_apache_hadoop_util_NativeCrc32_nativeComputeChun
   }
 }
 
+JNIEXPORT void JNICALL Java_org_apache_hadoop_util_NativeCrc32_nativeCopyAndComputeChunkedSums
+  (JNIEnv *env, jclass clazz,
+    jint bytes_per_checksum, jint j_crc_type,
+    jobject j_sums, jint sums_offset,
+    jobject j_src, jint src_offset,
+    jobject j_dst, jint dst_offset, jint data_len,
+    jstring j_filename, jlong base_pos, jboolean verify)
+{
+  uint8_t *sums_addr;
+  uint8_t *src_addr;
+  uint8_t *dst_addr;
+  uint32_t *sums;
+  uint8_t *src;
+  int crc_type;
+  crc32_error_t error_data;
+  int ret;
+
+  if (unlikely(!j_sums || !j_src || !j_dst)) {
+    THROW(env, "java/lang/NullPointerException",
+      "input ByteBuffers must not be null");
+    return;
+  }
+
+  // Convert direct byte buffers to C pointers
+  sums_addr = (*env)->GetDirectBufferAddress(env, j_sums);
+  src_addr = (*env)->GetDirectBufferAddress(env, j_src);
+  dst_addr = (*env)->GetDirectBufferAddress(env, j_dst);
+
+  if (unlikely(!sums_addr || !src_addr || !dst_addr)) {
+    THROW(env, "java/lang/IllegalArgumentException",
+      "input ByteBuffers must be direct buffers");
+    return;
+  }
+  if (unlikely(sums_offset < 0 || src_offset < 0 || dst_offset < 0 ||
+               data_len < 0)) {
+    THROW(env, "java/lang/IllegalArgumentException",
+      "bad offsets or lengths");
+    return;
+  }
+  if (unlikely(bytes_per_checksum) <= 0) {
+    THROW(env, "java/lang/IllegalArgumentException",
+      "invalid bytes_per_checksum");
+    return;
+  }
+
+  sums = (uint32_t *)(sums_addr + sums_offset);
+  src = src_addr + src_offset;
+
+  // Convert to correct internal C constant for CRC type
+  crc_type = convert_java_crc_type(env, j_crc_type);
+  if (crc_type == -1) return; // exception already thrown
+
+  // Setup complete. Actually copy and checksum.
+  ret = bulk_crc_copy(dst_addr + dst_offset, src, data_len, sums, crc_type,
+                      bytes_per_checksum, verify ? &error_data : NULL);
+  if (likely((verify && ret == CHECKSUMS_VALID) || (!verify && ret == 0))) {
+    return;
+  } else if (unlikely(verify && ret == INVALID_CHECKSUM_DETECTED)) {
+    long pos = base_pos + (error_data.bad_data - src);
+    throw_checksum_exception(
+      env, error_data.got_crc, error_data.expected_crc,
+      j_filename, pos);
+  } else {
+    THROW(env, "java/lang/AssertionError",
+      "Bad response code from native bulk_crc_copy");
+  }
+}
+
 JNIEXPORT void JNICALL Java_org_apache_hadoop_util_NativeCrc32_nativeVerifyChunkedSums
   (JNIEnv *env, jclass clazz,
     jint bytes_per_checksum, jint j_crc_type,
@@ -271,6 +339,120 @@ JNIEXPORT void JNICALL Java_org_apache_hadoop_util_NativeCrc32_nativeComputeChun
 
 }
 
+JNIEXPORT void JNICALL Java_org_apache_hadoop_util_NativeCrc32_nativeComputeChunkedSumsScattered
+  (JNIEnv *env, jclass clazz,
+    jint bytes_per_checksum, jint j_crc_type,
+    jobject j_sums, jint sums_offset,
+    jobjectArray j_data, jintArray j_data_offsets, jintArray j_data_lengths,
+    jstring j_filename, jlong base_pos, jboolean verify)
+{
+  uint8_t *sums_addr;
+  uint8_t *data_addr;
+  uint32_t *sums;
+  crc32_buffer_t *bufs = NULL;
+  jint *offsets = NULL, *lengths = NULL;
+  jobject j_buf;
+  jsize num_bufs;
+  int crc_type;
+  crc32_error_t error_data;
+  int i, ret;
+  long pos;
+
+  if (unlikely(!j_sums || !j_data || !j_data_offsets || !j_data_lengths)) {
+    THROW(env, "java/lang/NullPointerException",
+      "input ByteBuffers must not be null");
+    return;
+  }
+  if (unlikely(bytes_per_checksum) <= 0) {
+    THROW(env, "java/lang/IllegalArgumentException",
+      "invalid bytes_per_checksum");
+    return;
+  }
+  num_bufs = (*env)->GetArrayLength(env, j_data);
+  if (unlikely(sums_offset < 0 ||
+      (*env)->GetArrayLength(env, j_data_offsets) != num_bufs ||
+      (*env)->GetArrayLength(env, j_data_lengths) != num_bufs)) {
+    THROW(env, "java/lang/IllegalArgumentException",
+      "bad offsets or lengths");
+    return;
+  }
+  sums_addr = (*env)->GetDirectBufferAddress(env, j_sums);
+  if (unlikely(!sums_addr)) {
+    THROW(env, "java/lang/IllegalArgumentException",
+      "input ByteBuffers must be direct buffers");
+    return;
+  }
+  sums = (uint32_t *)(sums_addr + sums_offset);
+
+  // Convert to correct internal C constant for CRC type
+  crc_type = convert_java_crc_type(env, j_crc_type);
+  if (crc_type == -1) return; // exception already thrown
+
+  bufs = malloc(sizeof(crc32_buffer_t) * MAX(1, num_bufs));
+  offsets = malloc(sizeof(jint) * MAX(1, num_bufs));
+  lengths = malloc(sizeof(jint) * MAX(1, num_bufs));
+  if (unlikely(!bufs || !offsets || !lengths)) {
+    THROW(env, "java/lang/OutOfMemoryError",
+      "not enough memory for the buffer list in JNI code");
+    goto cleanup;
+  }
+  (*env)->GetIntArrayRegion(env, j_data_offsets, 0, num_bufs, offsets);
+  (*env)->GetIntArrayRegion(env, j_data_lengths, 0, num_bufs, lengths);
+
+  // Convert direct byte buffers to C pointers
+  for (i = 0; i < num_bufs; i++) {
+    j_buf = (*env)->GetObjectArrayElement(env, j_data, i);
+    if (unlikely(!j_buf)) {
+      THROW(env, "java/lang/NullPointerException",
+        "input ByteBuffers must not be null");
+      goto cleanup;
+    }
+    data_addr = (*env)->GetDirectBufferAddress(env, j_buf);
+    (*env)->DeleteLocalRef(env, j_buf);
+    if (unlikely(!data_addr)) {
+      THROW(env, "java/lang/IllegalArgumentException",
+        "input ByteBuffers must be direct buffers");
+      goto cleanup;
+    }
+    if (unlikely(offsets[i] < 0 || lengths[i] < 0)) {
+      THROW(env, "java/lang/IllegalArgumentException",
+        "bad offsets or lengths");
+      goto cleanup;
+    }
+    bufs[i].data = data_addr + offsets[i];
+    bufs[i].len = lengths[i];
+  }
+
+  // Setup complete. Actually verify checksums.
+  ret = bulk_crc_scattered(bufs, num_bufs, sums, crc_type,
+                           bytes_per_checksum, verify ? &error_data : NULL);
+  if (likely((verify && ret == CHECKSUMS_VALID) || (!verify && ret == 0))) {
+    goto cleanup;
+  } else if (unlikely(verify && ret == INVALID_CHECKSUM_DETECTED)) {
+    // Find the buffer the bad chunk is in to get its position in the file
+    pos = base_pos;
+    for (i = 0; i < num_bufs; i++) {
+      if (error_data.bad_data >= bufs[i].data &&
+          error_data.bad_data < bufs[i].data + bufs[i].len) {
+        pos += error_data.bad_data - bufs[i].data;
+        break;
+      }
+      pos += bufs[i].len;
+    }
+    throw_checksum_exception(
+      env, error_data.got_crc, error_data.expected_crc,
+      j_filename, pos);
+  } else {
+    THROW(env, "java/lang/AssertionError",
+      "Bad response code from native bulk_crc_scattered");
+  }
+
+cleanup:
+  free(bufs);
+  free(offsets);
+  free(lengths);
+}
+
 /**
  * vim: sw=2: ts=2: et:
  */
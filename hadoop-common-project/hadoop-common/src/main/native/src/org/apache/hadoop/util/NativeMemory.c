@@ -0,0 +1,43 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+#include "org_apache_hadoop_util_NativeMemory.h"
+#include "native_memory.h"
+
+JNIEXPORT jlongArray JNICALL Java_org_apache_hadoop_util_NativeMemory_nativeGetStats
+  (JNIEnv *env, jclass clazz)
+{
+  // current and peak of every subsystem, then of the total
+  jlong values[2 * (NATIVE_MEMORY_SUBSYSTEMS + 1)];
+  struct native_memory_stats stats;
+  jlongArray result;
+  int i;
+
+  for (i = 0; i <= NATIVE_MEMORY_SUBSYSTEMS; i++) {
+    get_native_memory_stats((enum native_memory_subsystem)i, &stats);
+    values[2 * i] = stats.current;
+    values[2 * i + 1] = stats.peak;
+  }
+  result = (*env)->NewLongArray(env, 2 * (NATIVE_MEMORY_SUBSYSTEMS + 1));
+  if (result) {
+    (*env)->SetLongArrayRegion(env, result, 0,
+        2 * (NATIVE_MEMORY_SUBSYSTEMS + 1), values);
+  }
+  return result;
+}
@@ -0,0 +1,41 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+#include "org_apache_hadoop_util_NativeWorkerPool.h"
+#include "worker_pool.h"
+
+JNIEXPORT jlongArray JNICALL Java_org_apache_hadoop_util_NativeWorkerPool_nativeGetStats
+  (JNIEnv *env, jclass clazz)
+{
+  struct worker_pool_stats stats;
+  jlong values[5];
+  jlongArray result;
+
+  get_worker_pool_stats(&stats);
+  values[0] = stats.max_workers;
+  values[1] = stats.workers;
+  values[2] = stats.queued_tasks;
+  values[3] = stats.tasks_run;
+  values[4] = stats.busy_nanos;
+  result = (*env)->NewLongArray(env, 5);
+  if (result) {
+    (*env)->SetLongArrayRegion(env, result, 0, 5, values);
+  }
+  return result;
+}
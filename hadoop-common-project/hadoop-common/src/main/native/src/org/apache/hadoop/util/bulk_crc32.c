@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef UNIX
 #include <arpa/inet.h>
@@ -56,6 +57,32 @@ static void pipelined_crc32_zlib_sb8(uint32_t *crc1, uint32_t *crc2, uint32_t *c
 crc_pipelined_func_t pipelined_crc32c_func = pipelined_crc32c_sb8;
 crc_pipelined_func_t pipelined_crc32_zlib_func = pipelined_crc32_zlib_sb8;
 
+typedef uint32_t (*crc_update_func_t)(uint32_t, const uint8_t *, size_t);
+
+// Single buffer versions of the polynomials, left NULL unless the platform
+// has a dedicated routine. Otherwise a hardware pipelined function also
+// serves single buffers, see crc_update_pipelined.
+crc_update_func_t crc32_zlib_update_func = NULL;
+crc_update_func_t crc32c_update_func = NULL;
+
+/*
+ * For crc32c_update and crc32_zlib_update a buffer is cut into three blocks
+ * which go through the pipelined function together. The crcs of the second
+ * and third block are then appended to the one of the first by feeding a
+ * block of zeros to it, which is a linear map applied through the tables
+ * below.
+ */
+#define CRC_LONG_BLOCK 8192
+#define CRC_SHORT_BLOCK 256
+
+typedef uint32_t crc_shift_table_t[4][256];
+
+static crc_shift_table_t crc32c_long_zeros;
+static crc_shift_table_t crc32c_short_zeros;
+static crc_shift_table_t crc32_zlib_long_zeros;
+static crc_shift_table_t crc32_zlib_short_zeros;
+static int crc_shift_tables_ready = 0;
+
 static inline int store_or_verify(uint32_t *sums, uint32_t crc,
                                    int is_verify) {
   if (!is_verify) {
@@ -145,6 +172,346 @@ return_crc_error:
   return INVALID_CHECKSUM_DETECTED;
 }
 
+/*
+ * bulk_crc_copy copies about this many bytes at a time and checksums them
+ * straight away, while they are still in the L1 cache.
+ */
+#define CRC_COPY_STRIDE 12288
+
+int bulk_crc_copy(uint8_t *dst, const uint8_t *src, size_t data_len,
+                  uint32_t *sums, int checksum_type,
+                  int bytes_per_checksum,
+                  crc32_error_t *error_info) {
+  size_t stride, done, n;
+  int ret;
+
+  /* Whole triples of chunks, so that bulk_crc interleaves all of them */
+  stride = (CRC_COPY_STRIDE / bytes_per_checksum) / 3 * 3;
+  if (stride < 3)
+    stride = 3;
+  stride *= bytes_per_checksum;
+
+  for (done = 0; done < data_len; done += n) {
+    n = data_len - done < stride ? data_len - done : stride;
+    memcpy(dst + done, src + done, n);
+    ret = bulk_crc(dst + done, n, sums + done / bytes_per_checksum,
+                   checksum_type, bytes_per_checksum, error_info);
+    if (unlikely(ret != 0)) {
+      if (ret == INVALID_CHECKSUM_DETECTED)
+        error_info->bad_data = src + (error_info->bad_data - dst);
+      memcpy(dst + done + n, src + done + n, data_len - done - n);
+      return ret;
+    }
+  }
+  return error_info != NULL ? CHECKSUMS_VALID : 0;
+}
+
+/*
+ * Chunks of bulk_crc_scattered which are not next to each other in memory,
+ * because they are on either side of a buffer boundary, are copied together
+ * so that they still go through the pipelined function as one triple, as
+ * long as they are at most this big.
+ */
+#define CRC_SCATTER_STAGING 1024
+
+/**
+ * Compute the crcs of up to three chunks of bytes_per_checksum bytes,
+ * interleaved even when the chunks are not contiguous.
+ */
+static void crc_scattered_chunks(crc_pipelined_func_t crc_pipelined_func,
+    const uint8_t **chunks, int n_chunks, int bytes_per_checksum,
+    uint8_t *staging, uint32_t *crcs) {
+  int i, contiguous = 1;
+
+  crcs[0] = crcs[1] = crcs[2] = CRC_INITIAL_VAL;
+  for (i = 1; i < n_chunks; i++) {
+    if (chunks[i] != chunks[0] + i * bytes_per_checksum)
+      contiguous = 0;
+  }
+  if (contiguous) {
+    crc_pipelined_func(&crcs[0], &crcs[1], &crcs[2], chunks[0],
+                       bytes_per_checksum, n_chunks);
+  } else if (bytes_per_checksum <= CRC_SCATTER_STAGING) {
+    for (i = 0; i < n_chunks; i++)
+      memcpy(staging + i * bytes_per_checksum, chunks[i], bytes_per_checksum);
+    crc_pipelined_func(&crcs[0], &crcs[1], &crcs[2], staging,
+                       bytes_per_checksum, n_chunks);
+  } else {
+    // Big chunks are rare, and go through one at a time
+    for (i = 0; i < n_chunks; i++) {
+      uint32_t unused1 = CRC_INITIAL_VAL, unused2 = CRC_INITIAL_VAL;
+      crc_pipelined_func(&crcs[i], &unused1, &unused2, chunks[i],
+                         bytes_per_checksum, 1);
+    }
+  }
+}
+
+int bulk_crc_scattered(const crc32_buffer_t *bufs, int num_bufs,
+                       uint32_t *sums, int checksum_type,
+                       int bytes_per_checksum,
+                       crc32_error_t *error_info) {
+
+  int is_verify = error_info != NULL;
+
+  uint8_t staging[3 * CRC_SCATTER_STAGING];
+  const uint8_t *chunks[3];
+  uint32_t crcs[3];
+  int n_chunks = 0;
+  const uint8_t *data, *bad_data;
+  size_t len;
+  uint32_t crc;
+  int b, i;
+  crc_pipelined_func_t crc_pipelined_func;
+  switch (checksum_type) {
+    case CRC32_ZLIB_POLYNOMIAL:
+      crc_pipelined_func = pipelined_crc32_zlib_func;
+      break;
+    case CRC32C_POLYNOMIAL:
+      crc_pipelined_func = pipelined_crc32c_func;
+      break;
+    default:
+      return is_verify ? INVALID_CHECKSUM_TYPE : -EINVAL;
+  }
+
+  /*
+   * Whole chunks are queued up across buffers and go through the pipelined
+   * function three at a time. The queue is emptied before the partial last
+   * chunk of a buffer, so that the checksums are stored and verified in
+   * order.
+   */
+  for (b = 0; b <= num_bufs; b++) {
+    if (b < num_bufs) {
+      data = bufs[b].data;
+      len = bufs[b].len;
+    } else {
+      data = NULL;
+      len = 0;
+    }
+    for (;;) {
+      if (len >= (size_t)bytes_per_checksum) {
+        chunks[n_chunks++] = data;
+        data += bytes_per_checksum;
+        len -= bytes_per_checksum;
+        if (likely(n_chunks < 3))
+          continue;
+      } else if (!n_chunks || (!len && b < num_bufs)) {
+        /* Carry the queue over to the next buffer */
+        break;
+      }
+      crc_scattered_chunks(crc_pipelined_func, chunks, n_chunks,
+                           bytes_per_checksum, staging, crcs);
+      for (i = 0; i < n_chunks; i++) {
+        bad_data = chunks[i];
+        if (unlikely(!store_or_verify(sums,
+                (crc = ntohl(crc_val(crcs[i]))), is_verify)))
+          goto return_crc_error;
+        sums++;
+      }
+      n_chunks = 0;
+    }
+
+    /* For something smaller than a block */
+    if (len) {
+      crcs[0] = crcs[1] = crcs[2] = CRC_INITIAL_VAL;
+      crc_pipelined_func(&crcs[0], &crcs[1], &crcs[2], data, len, 1);
+
+      bad_data = data;
+      if (unlikely(!store_or_verify(sums,
+              (crc = ntohl(crc_val(crcs[0]))), is_verify)))
+        goto return_crc_error;
+      sums++;
+    }
+  }
+  return is_verify ? CHECKSUMS_VALID : 0;
+
+return_crc_error:
+  if (error_info != NULL) {
+    error_info->got_crc = crc;
+    error_info->expected_crc = *sums;
+    error_info->bad_data = bad_data;
+  }
+  return INVALID_CHECKSUM_DETECTED;
+}
+
+/**
+ * Multiply the 32x32 GF(2) matrix mat by vec.
+ */
+static uint32_t gf2_matrix_times(const uint32_t *mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1)
+      sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+static void gf2_matrix_square(uint32_t *square, const uint32_t *mat) {
+  int n;
+  for (n = 0; n < 32; n++)
+    square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/**
+ * Build the tables which feed length zero bytes to a crc of the reflected
+ * polynomial poly, length must be a power of two.
+ */
+static void crc_zeros(crc_shift_table_t zeros, uint32_t poly, size_t length) {
+  uint32_t odd[32];
+  uint32_t even[32];
+  const uint32_t *op;
+  uint32_t row = 1;
+  uint32_t n;
+
+  // operator for one zero bit
+  odd[0] = poly;
+  for (n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  gf2_matrix_square(even, odd); // two zero bits
+  gf2_matrix_square(odd, even); // four zero bits
+
+  // every square doubles the zeros, the first one gives a single byte
+  for (;;) {
+    gf2_matrix_square(even, odd);
+    op = even;
+    length >>= 1;
+    if (length == 0)
+      break;
+    gf2_matrix_square(odd, even);
+    op = odd;
+    length >>= 1;
+    if (length == 0)
+      break;
+  }
+
+  for (n = 0; n < 256; n++) {
+    zeros[0][n] = gf2_matrix_times(op, n);
+    zeros[1][n] = gf2_matrix_times(op, n << 8);
+    zeros[2][n] = gf2_matrix_times(op, n << 16);
+    zeros[3][n] = gf2_matrix_times(op, n << 24);
+  }
+}
+
+#ifdef HADOOP_CRC32_ARCH
+// Defined by the architecture specific file, which sets the function
+// pointers above to the hardware routines of the cpu. Calling it from here
+// also keeps the file in when linking against a static library.
+extern void init_cpu_support_flag(void);
+#endif
+
+#ifdef __GNUC__
+static void __attribute__ ((constructor)) init_crc32(void) {
+#ifdef HADOOP_CRC32_ARCH
+  init_cpu_support_flag();
+#endif
+  crc_zeros(crc32c_long_zeros, 0x82F63B78, CRC_LONG_BLOCK);
+  crc_zeros(crc32c_short_zeros, 0x82F63B78, CRC_SHORT_BLOCK);
+  crc_zeros(crc32_zlib_long_zeros, 0xEDB88320, CRC_LONG_BLOCK);
+  crc_zeros(crc32_zlib_short_zeros, 0xEDB88320, CRC_SHORT_BLOCK);
+  crc_shift_tables_ready = 1;
+}
+#endif
+
+static inline uint32_t crc_shift(const crc_shift_table_t zeros, uint32_t crc) {
+  return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+      zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+static uint32_t crc_update_pipelined(crc_pipelined_func_t func,
+    const crc_shift_table_t long_zeros, const crc_shift_table_t short_zeros,
+    uint32_t crc, const uint8_t *data, size_t length) {
+  uint32_t crc2, crc3;
+
+  while (length >= CRC_LONG_BLOCK * 3) {
+    crc2 = crc3 = 0;
+    func(&crc, &crc2, &crc3, data, CRC_LONG_BLOCK, 3);
+    crc = crc_shift(long_zeros, crc) ^ crc2;
+    crc = crc_shift(long_zeros, crc) ^ crc3;
+    data += CRC_LONG_BLOCK * 3;
+    length -= CRC_LONG_BLOCK * 3;
+  }
+  while (length >= CRC_SHORT_BLOCK * 3) {
+    crc2 = crc3 = 0;
+    func(&crc, &crc2, &crc3, data, CRC_SHORT_BLOCK, 3);
+    crc = crc_shift(short_zeros, crc) ^ crc2;
+    crc = crc_shift(short_zeros, crc) ^ crc3;
+    data += CRC_SHORT_BLOCK * 3;
+    length -= CRC_SHORT_BLOCK * 3;
+  }
+  if (length) {
+    crc2 = crc3 = 0;
+    func(&crc, &crc2, &crc3, data, length, 1);
+  }
+  return crc;
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t length) {
+  if (crc32c_update_func != NULL)
+    return crc32c_update_func(crc, data, length);
+  if (pipelined_crc32c_func == pipelined_crc32c_sb8 || !crc_shift_tables_ready)
+    return crc32c_sb8(crc, data, length);
+  return crc_update_pipelined(pipelined_crc32c_func, crc32c_long_zeros,
+      crc32c_short_zeros, crc, data, length);
+}
+
+uint32_t crc32_zlib_update(uint32_t crc, const uint8_t *data, size_t length) {
+  if (crc32_zlib_update_func != NULL)
+    return crc32_zlib_update_func(crc, data, length);
+  if (pipelined_crc32_zlib_func == pipelined_crc32_zlib_sb8 || !crc_shift_tables_ready)
+    return crc32_zlib_sb8(crc, data, length);
+  return crc_update_pipelined(pipelined_crc32_zlib_func, crc32_zlib_long_zeros,
+      crc32_zlib_short_zeros, crc, data, length);
+}
+
+/**
+ * Multiply a and b modulo the reflected polynomial poly.
+ */
+static uint32_t gf2_multmodp(uint32_t poly, uint32_t a, uint32_t b) {
+  uint32_t m = (uint32_t)1 << 31;
+  uint32_t p = 0;
+
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0)
+        break;
+    }
+    m >>= 1;
+    b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+  }
+  return p;
+}
+
+/**
+ * Append len2 bytes with a crc of crc2 to data with a crc of crc1. Feeding
+ * len2 zero bytes to crc1 multiplies it by x^(8 * len2), which is built from
+ * the table of x^(2^n) in at most one multiplication per bit of len2.
+ */
+static uint32_t crc_combine(uint32_t poly, const uint32_t *x2n, int period,
+    uint32_t crc1, uint32_t crc2, uint64_t len2) {
+  uint32_t shift = (uint32_t)1 << 31; // x^0
+  int n = 3;                          // len2 counts bytes, x^(2^3) per byte
+
+  for (; len2; len2 >>= 1, n++) {
+    if (len2 & 1)
+      shift = gf2_multmodp(poly, x2n[n % period], shift);
+  }
+  return gf2_multmodp(poly, shift, crc1) ^ crc2;
+}
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+  return crc_combine(0x82F63B78, CRC32C_X2N,
+      sizeof(CRC32C_X2N) / sizeof(CRC32C_X2N[0]), crc1, crc2, len2);
+}
+
+uint32_t crc32_zlib_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+  return crc_combine(0xEDB88320, CRC32_X2N,
+      sizeof(CRC32_X2N) / sizeof(CRC32_X2N[0]), crc1, crc2, len2);
+}
+
 /**
  * Extract the final result of a CRC
  */
@@ -156,7 +523,7 @@ static uint32_t crc_val(uint32_t crc) {
  * Computes the CRC32c checksum for the specified buffer using the slicing by 8 
  * algorithm over 64 bit quantities.
  */
-static uint32_t crc32c_sb8(uint32_t crc, const uint8_t *buf, size_t length) {
+uint32_t crc32c_sb8(uint32_t crc, const uint8_t *buf, size_t length) {
   uint32_t running_length = ((length)/8)*8;
   uint32_t end_bytes = length - running_length; 
   int li;
@@ -201,7 +568,7 @@ static void pipelined_crc32c_sb8(uint32_t *crc1, uint32_t *crc2, uint32_t *crc3,
  * Update a CRC using the "zlib" polynomial -- what Hadoop calls CHECKSUM_CRC32
  * using slicing-by-8
  */
-static uint32_t crc32_zlib_sb8(
+uint32_t crc32_zlib_sb8(
     uint32_t crc, const uint8_t *buf, size_t length) {
   uint32_t running_length = ((length)/8)*8;
   uint32_t end_bytes = length - running_length; 
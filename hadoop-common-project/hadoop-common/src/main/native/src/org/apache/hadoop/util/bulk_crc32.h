@@ -18,12 +18,17 @@
 #ifndef BULK_CRC32_H_INCLUDED
 #define BULK_CRC32_H_INCLUDED
 
+#include <stddef.h> /* for size_t */
 #include <stdint.h>
 
 #ifdef UNIX
-#include <unistd.h> /* for size_t */
+#include <unistd.h>
 #endif // UNIX
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Constants for different CRC algorithms
 #define CRC32C_POLYNOMIAL 1
 #define CRC32_ZLIB_POLYNOMIAL 2
@@ -40,6 +45,12 @@ typedef struct crc32_error {
   const uint8_t *bad_data; // pointer to start of data chunk with error
 } crc32_error_t;
 
+// One buffer of the data given to bulk_crc_scattered
+typedef struct crc32_buffer {
+  const uint8_t *data;
+  size_t len;
+} crc32_buffer_t;
+
 
 /**
  * Either calculates checksums for or verifies a buffer of data.
@@ -70,4 +81,104 @@ extern int bulk_crc(const uint8_t *data, size_t data_len,
     int bytes_per_checksum,
     crc32_error_t *error_info);
 
+/**
+ * Copy a buffer and calculate or verify the checksums of the copy, like
+ * bulk_crc, in one pass: the data is checksummed a few KB at a time right
+ * after it is copied, while it is still in the cache, so it is only read
+ * from memory once. The buffers must not overlap, and the data is copied
+ * even when verification fails.
+ *
+ * @param dst                   Where to copy the data to
+ * @param src                   The data to copy and checksum
+ * @param data_len              Length of the data
+ * @param sums                  (out param) buffer to write checksums into or
+ *                              where checksums are already stored, as for
+ *                              bulk_crc
+ * @param checksum_type         One of the CRC32 algorithm constants defined
+ *                              above
+ * @param bytes_per_checksum    How many bytes of data to process per checksum.
+ * @param error_info            If non-NULL, verification will be performed and
+ *                              it will be filled in if an error is detected,
+ *                              with bad_data pointing into src. Otherwise
+ *                              calculation is performed.
+ *
+ * @return                      0 for success, non-zero for an error, result codes
+ *                              for verification are defined above
+ */
+extern int bulk_crc_copy(uint8_t *dst, const uint8_t *src, size_t data_len,
+    uint32_t *sums, int checksum_type,
+    int bytes_per_checksum,
+    crc32_error_t *error_info);
+
+/**
+ * Like bulk_crc, over a list of buffers with one array of checksums. Each
+ * buffer is cut into chunks of its own, its last chunk is shorter than
+ * bytes_per_checksum unless the buffer length is a multiple of it, and the
+ * checksums of its chunks follow those of the buffer before it. Whole
+ * chunks on either side of a buffer boundary are still checksummed three
+ * at a time, so many small buffers cost about as much as one big one.
+ *
+ * @param bufs                  The buffers to checksum
+ * @param num_bufs              Number of buffers
+ * @param sums                  (out param) buffer to write checksums into or
+ *                              where checksums are already stored. It must
+ *                              hold the checksums of every buffer.
+ * @param checksum_type         One of the CRC32 algorithm constants defined
+ *                              above
+ * @param bytes_per_checksum    How many bytes of data to process per checksum.
+ * @param error_info            If non-NULL, verification will be performed and
+ *                              it will be filled in if an error
+ *                              is detected. Otherwise calculation is performed.
+ *
+ * @return                      0 for success, non-zero for an error, result codes
+ *                              for verification are defined above
+ */
+extern int bulk_crc_scattered(const crc32_buffer_t *bufs, int num_bufs,
+    uint32_t *sums, int checksum_type,
+    int bytes_per_checksum,
+    crc32_error_t *error_info);
+
+/**
+ * Update the running value of a CRC with a buffer of data, using the
+ * fastest implementation the cpu supports. The running value starts at
+ * 0xffffffff and the checksum is its complement, as for bulk_crc.
+ *
+ * @param crc                   The running value
+ * @param data                  The data to checksum
+ * @param length                Length of the data buffer
+ *
+ * @return                      The updated running value
+ */
+extern uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t length);
+extern uint32_t crc32_zlib_update(uint32_t crc, const uint8_t *data, size_t length);
+
+/**
+ * Combine the checksums of two adjacent pieces of data into the checksum of
+ * both, without the data: crc1 is the checksum of the first piece, crc2
+ * that of the second of len2 bytes. The checksums are final values, as
+ * DataChecksum returns them and bulk_crc stores them once converted to host
+ * byte order. It takes a few dozen table lookups and multiplications in
+ * GF(2), at most one per bit of len2.
+ *
+ * @param crc1                  The checksum of the first piece
+ * @param crc2                  The checksum of the second piece
+ * @param len2                  Length of the second piece
+ *
+ * @return                      The checksum of the first piece followed by
+ *                              the second one
+ */
+extern uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+extern uint32_t crc32_zlib_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+/**
+ * Table driven versions of the above, used where the cpu has no crc
+ * support, exported for the tests.
+ */
+extern uint32_t crc32c_sb8(uint32_t crc, const uint8_t *buf, size_t length);
+extern uint32_t crc32_zlib_sb8(uint32_t crc, const uint8_t *buf, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -350,10 +350,10 @@ extern crc_pipelined_func_t pipelined_crc32_zlib_func;
 #endif
 
 /**
- * On library load, determine what sort of crc we are going to do
- * and set crc function pointers appropriately.
+ * Called by bulk_crc32.c on library load, determine what sort of crc we
+ * are going to do and set crc function pointers appropriately.
  */
-void __attribute__ ((constructor)) init_cpu_support_flag(void) {
+void init_cpu_support_flag(void) {
   unsigned long auxv = getauxval(AT_HWCAP);
   if (auxv & HWCAP_CRC32) {
     pipelined_crc32c_func = pipelined_crc32c;
@@ -0,0 +1,173 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stddef.h>    // for size_t
+#include <string.h>
+
+#include  "bulk_crc32.h"
+#include "gcc_optimizations.h"
+
+#include <altivec.h>
+#include <sys/auxv.h>
+
+#ifndef PPC_FEATURE2_VEC_CRYPTO
+#define PPC_FEATURE2_VEC_CRYPTO 0x02000000
+#endif
+
+/**
+ * POWER8 has no crc instruction, instead both polynomials are folded into
+ * 128 bit lanes with vpmsumd, the carry-less multiply of the two
+ * doublewords of a vector which xors the two products together. That is
+ * exactly the fold of a lane: its low half times x^(D+32) mod P plus its
+ * high half times x^(D-32) mod P, in a single instruction. The constants
+ * are those of the pclmul kernels of bulk_crc32_x86.c, see there.
+ *
+ * On little endian the low doubleword of a vector is element 0 and loads
+ * keep the byte order of memory, so the lanes hold the data just as the
+ * xmm registers do on x86. POWER8 is the baseline of ppc64le, so the
+ * compiler emits vpmsumd without any extra flags.
+ */
+#define CRC32_VPMSUM_MIN_LENGTH 64
+
+typedef __vector unsigned long long v2du;
+
+static inline v2du vpmsumd(v2du a, v2du b) {
+  return (v2du)__builtin_crypto_vpmsumd(a, b);
+}
+
+static inline v2du load128(const uint8_t *buf) {
+  v2du v;
+  memcpy(&v, buf, sizeof(v));
+  return v;
+}
+
+/**
+ * Fold the buffer into a single 128 bit lane, with the running crc xored
+ * into its first bytes, and finish with the crc of that lane from a zero
+ * state, which is the crc of it all. length must be at least 64 and a
+ * multiple of 16.
+ */
+__attribute__ ((always_inline))
+static inline uint32_t crc32_fold(uint32_t crc, const uint8_t *buf,
+    size_t length, v2du k1k2, v2du k3k4,
+    uint32_t (*crc_sb8)(uint32_t, const uint8_t *, size_t)) {
+  const v2du init = { crc, 0 };
+  v2du x1 = load128(buf + 0x00) ^ init;
+  v2du x2 = load128(buf + 0x10);
+  v2du x3 = load128(buf + 0x20);
+  v2du x4 = load128(buf + 0x30);
+  uint8_t lane[16];
+
+  buf += 64;
+  length -= 64;
+
+  /* Fold 4 x 128 bits at a time */
+  while (length >= 64) {
+    x1 = vpmsumd(x1, k1k2) ^ load128(buf + 0x00);
+    x2 = vpmsumd(x2, k1k2) ^ load128(buf + 0x10);
+    x3 = vpmsumd(x3, k1k2) ^ load128(buf + 0x20);
+    x4 = vpmsumd(x4, k1k2) ^ load128(buf + 0x30);
+    buf += 64;
+    length -= 64;
+  }
+
+  /* Fold the 4 lanes into one */
+  x1 = vpmsumd(x1, k3k4) ^ x2;
+  x1 = vpmsumd(x1, k3k4) ^ x3;
+  x1 = vpmsumd(x1, k3k4) ^ x4;
+
+  /* Remaining 128 bit blocks */
+  while (length >= 16) {
+    x1 = vpmsumd(x1, k3k4) ^ load128(buf);
+    buf += 16;
+    length -= 16;
+  }
+
+  memcpy(lane, &x1, sizeof(lane));
+  return crc_sb8(0, lane, sizeof(lane));
+}
+
+static uint32_t crc32c_update_ppc64le(uint32_t crc, const uint8_t *buf, size_t length) {
+  const v2du k1k2 = { 0x00740eef02ULL, 0x009e4addf8ULL }; // D = 512
+  const v2du k3k4 = { 0x00f20c0dfeULL, 0x014cd00bd6ULL }; // D = 128
+  size_t folded = length & ~(size_t)15;
+
+  if (length >= CRC32_VPMSUM_MIN_LENGTH) {
+    crc = crc32_fold(crc, buf, folded, k1k2, k3k4, crc32c_sb8);
+    return crc32c_sb8(crc, buf + folded, length - folded);
+  }
+  return crc32c_sb8(crc, buf, length);
+}
+
+static uint32_t crc32_zlib_update_ppc64le(uint32_t crc, const uint8_t *buf, size_t length) {
+  const v2du k1k2 = { 0x0154442bd4ULL, 0x01c6e41596ULL }; // D = 512
+  const v2du k3k4 = { 0x01751997d0ULL, 0x00ccaa009eULL }; // D = 128
+  size_t folded = length & ~(size_t)15;
+
+  if (length >= CRC32_VPMSUM_MIN_LENGTH) {
+    crc = crc32_fold(crc, buf, folded, k1k2, k3k4, crc32_zlib_sb8);
+    return crc32_zlib_sb8(crc, buf + folded, length - folded);
+  }
+  return crc32_zlib_sb8(crc, buf, length);
+}
+
+/**
+ * The folding kernel keeps four independent lanes already, so there is
+ * nothing to gain from interleaving the blocks.
+ */
+static void pipelined_crc32c(uint32_t *crc1, uint32_t *crc2, uint32_t *crc3, const uint8_t *p_buf, size_t block_size, int num_blocks) {
+  assert(num_blocks >= 1 && num_blocks <=3 && "invalid num_blocks");
+  *crc1 = crc32c_update_ppc64le(*crc1, p_buf, block_size);
+  if (num_blocks >= 2)
+    *crc2 = crc32c_update_ppc64le(*crc2, p_buf + block_size, block_size);
+  if (num_blocks >= 3)
+    *crc3 = crc32c_update_ppc64le(*crc3, p_buf + 2 * block_size, block_size);
+}
+
+static void pipelined_crc32_zlib(uint32_t *crc1, uint32_t *crc2, uint32_t *crc3, const uint8_t *p_buf, size_t block_size, int num_blocks) {
+  assert(num_blocks >= 1 && num_blocks <=3 && "invalid num_blocks");
+  *crc1 = crc32_zlib_update_ppc64le(*crc1, p_buf, block_size);
+  if (num_blocks >= 2)
+    *crc2 = crc32_zlib_update_ppc64le(*crc2, p_buf + block_size, block_size);
+  if (num_blocks >= 3)
+    *crc3 = crc32_zlib_update_ppc64le(*crc3, p_buf + 2 * block_size, block_size);
+}
+
+typedef void (*crc_pipelined_func_t)(uint32_t *, uint32_t *, uint32_t *, const uint8_t *, size_t, int);
+typedef uint32_t (*crc_update_func_t)(uint32_t, const uint8_t *, size_t);
+extern crc_pipelined_func_t pipelined_crc32c_func;
+extern crc_pipelined_func_t pipelined_crc32_zlib_func;
+extern crc_update_func_t crc32_zlib_update_func;
+extern crc_update_func_t crc32c_update_func;
+
+/**
+ * Called by bulk_crc32.c on library load, determine what sort of crc we
+ * are going to do and set crc function pointers appropriately. Every
+ * ppc64le cpu is a POWER8 or later and has vpmsumd, but the kernel still
+ * reports it.
+ */
+void init_cpu_support_flag(void) {
+  unsigned long auxv = getauxval(AT_HWCAP2);
+  if (auxv & PPC_FEATURE2_VEC_CRYPTO) {
+    pipelined_crc32c_func = pipelined_crc32c;
+    pipelined_crc32_zlib_func = pipelined_crc32_zlib;
+    crc32c_update_func = crc32c_update_ppc64le;
+    crc32_zlib_update_func = crc32_zlib_update_ppc64le;
+  }
+}
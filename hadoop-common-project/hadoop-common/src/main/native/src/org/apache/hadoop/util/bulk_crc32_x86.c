@@ -29,6 +29,17 @@
 #include "gcc_optimizations.h"
 #include "gcc_optimizations.h"
 
+// the carry-less multiplication kernels are compiled for their own target
+// with the function attribute, which needs gcc 5 for the sse intrinsics and
+// gcc 8 for the avx-512 ones
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#  define HAVE_PCLMUL_KERNEL
+#  include <immintrin.h>
+#  if defined(__LP64__) && !defined(__clang__) && __GNUC__ >= 8
+#    define HAVE_VPCLMUL_KERNEL
+#  endif
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 // Begin code for SSE4.2 specific hardware support of CRC32C
 ///////////////////////////////////////////////////////////////////////////
@@ -56,34 +67,6 @@ static uint32_t cpuid(uint32_t eax_in) {
   return ecx;
 }
 
-//
-// Definitions of the SSE4.2 crc32 operations. Using these instead of
-// the GCC __builtin_* intrinsics allows this code to compile without
-// -msse4.2, since we do dynamic CPU detection at runtime.
-//
-
-#  ifdef __LP64__
-inline uint64_t _mm_crc32_u64(uint64_t crc, uint64_t value) {
-  asm("crc32q %[value], %[crc]\n" : [crc] "+r" (crc) : [value] "rm" (value));
-  return crc;
-}
-#  endif
-
-inline uint32_t _mm_crc32_u32(uint32_t crc, uint32_t value) {
-  asm("crc32l %[value], %[crc]\n" : [crc] "+r" (crc) : [value] "rm" (value));
-  return crc;
-}
-
-inline uint32_t _mm_crc32_u16(uint32_t crc, uint16_t value) {
-  asm("crc32w %[value], %[crc]\n" : [crc] "+r" (crc) : [value] "rm" (value));
-  return crc;
-}
-
-inline uint32_t _mm_crc32_u8(uint32_t crc, uint8_t value) {
-  asm("crc32b %[value], %[crc]\n" : [crc] "+r" (crc) : [value] "rm" (value));
-  return crc;
-}
-
 #  ifdef __LP64__
 /**
  * Pipelined version of hardware-accelerated CRC32C calculation using
@@ -332,14 +315,404 @@ static void pipelined_crc32c(uint32_t *crc1, uint32_t *crc2, uint32_t *crc3, con
 
 # endif // 64-bit vs 32-bit
 
+///////////////////////////////////////////////////////////////////////////
+// Begin code for PCLMULQDQ specific hardware support of the zlib CRC32
+///////////////////////////////////////////////////////////////////////////
+
+#ifdef HAVE_PCLMUL_KERNEL
+
+#  define SSE41_FEATURE_BIT (1 << 19)
+#  define PCLMUL_FEATURE_BIT (1 << 1)
+
+/*
+ * The zlib polynomial has no crc instruction, instead the data is folded
+ * into 128 bit lanes with carry-less multiplications, which are then
+ * reduced to 32 bits with Barrett reduction. See "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" by Gopal et al.
+ *
+ * Folding a lane over D bits multiplies its low half by x^(D+32) mod P
+ * and its high half by x^(D-32) mod P, the constants are given bit
+ * reflected and shifted left by one. They are the ones of the Linux
+ * crc32-pclmul module, plus D = 2048 for the avx-512 kernel.
+ */
+#  define CRC32_ZLIB_PCLMUL_MIN_LENGTH 64
+#  define CRC32_ZLIB_VPCLMUL_MIN_LENGTH 512
+
+static int cpu_supports_vpclmul = 0;
+
 /**
- * On library load, initiailize the cached function pointer
- * if cpu supports SSE4.2's crc32 instruction.
+ * Fold the lanes x1..x4, which hold four consecutive 128 bit blocks, with
+ * the rest of the buffer and reduce them. length must be a multiple of 16.
+ *
+ * It is inlined so that the avx-512 kernel gets a VEX encoded copy: calling
+ * legacy SSE code with the upper halves of the zmm registers dirty stalls
+ * every SSE instruction after it.
+ */
+__attribute__ ((target("pclmul,sse4.1"), always_inline))
+static inline uint32_t crc32_zlib_fold(__m128i x1, __m128i x2, __m128i x3, __m128i x4,
+                                const uint8_t *buf, size_t length) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL); // D = 512
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL); // D = 128
+  const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x5, x6, x7, x8;
+
+  /* Fold 4 x 128 bits at a time */
+  while (length >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+    buf += 64;
+    length -= 64;
+  }
+
+  /* Fold the 4 lanes into one */
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /* Remaining 128 bit blocks */
+  while (length >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+    buf += 16;
+    length -= 16;
+  }
+
+  /* 128 bits to 64 bits */
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits */
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return _mm_extract_epi32(x1, 1);
+}
+
+/**
+ * length must be at least 64 and a multiple of 16.
+ */
+__attribute__ ((target("pclmul,sse4.1")))
+static uint32_t crc32_zlib_pclmul(uint32_t crc, const uint8_t *buf, size_t length) {
+  __m128i x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+  return crc32_zlib_fold(x1, x2, x3, x4, buf + 64, length - 64);
+}
+
+#  ifdef HAVE_VPCLMUL_KERNEL
+
+#    define AVX512F_FEATURE_BIT (1 << 16)   // leaf 7, ebx
+#    define VPCLMUL_FEATURE_BIT (1 << 10)   // leaf 7, ecx
+#    define OSXSAVE_FEATURE_BIT (1 << 27)   // leaf 1, ecx
+#    define XCR0_ZMM_STATE 0xe6
+
+/**
+ * Same folding as crc32_zlib_fold on four 512 bit registers, each of
+ * them holding four lanes. length must be at least 256 and a multiple of
+ * 16.
+ */
+__attribute__ ((target("avx512f,vpclmulqdq,pclmul,sse4.1")))
+static uint32_t crc32_zlib_vpclmul(uint32_t crc, const uint8_t *buf, size_t length) {
+  const __m512i k2048 = _mm512_set_epi64(0x01322d1430LL, 0x011542778aLL,
+      0x01322d1430LL, 0x011542778aLL, 0x01322d1430LL, 0x011542778aLL,
+      0x01322d1430LL, 0x011542778aLL);
+  const __m512i k512 = _mm512_set_epi64(0x01c6e41596LL, 0x0154442bd4LL,
+      0x01c6e41596LL, 0x0154442bd4LL, 0x01c6e41596LL, 0x0154442bd4LL,
+      0x01c6e41596LL, 0x0154442bd4LL);
+  __m512i x0 = _mm512_loadu_si512((const void *)(buf + 0x00));
+  __m512i x1 = _mm512_loadu_si512((const void *)(buf + 0x40));
+  __m512i x2 = _mm512_loadu_si512((const void *)(buf + 0x80));
+  __m512i x3 = _mm512_loadu_si512((const void *)(buf + 0xc0));
+  x0 = _mm512_xor_si512(x0,
+      _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128(crc), 0));
+  buf += 256;
+  length -= 256;
+
+  /* Fold 16 x 128 bits at a time, 0x96 is the xor of the three operands */
+  while (length >= 256) {
+    x0 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x0, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x0, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0x00)), 0x96);
+    x1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x1, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x1, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0x40)), 0x96);
+    x2 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x2, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x2, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0x80)), 0x96);
+    x3 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x3, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x3, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0xc0)), 0x96);
+    buf += 256;
+    length -= 256;
+  }
+
+  /* Fold the 4 registers into one, they are 512 bits apart */
+  x1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x0, k512, 0x00),
+      _mm512_clmulepi64_epi128(x0, k512, 0x11), x1, 0x96);
+  x2 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x1, k512, 0x00),
+      _mm512_clmulepi64_epi128(x1, k512, 0x11), x2, 0x96);
+  x3 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x2, k512, 0x00),
+      _mm512_clmulepi64_epi128(x2, k512, 0x11), x3, 0x96);
+
+  return crc32_zlib_fold(_mm512_extracti32x4_epi32(x3, 0),
+      _mm512_extracti32x4_epi32(x3, 1), _mm512_extracti32x4_epi32(x3, 2),
+      _mm512_extracti32x4_epi32(x3, 3), buf, length);
+}
+
+/*
+ * CRC32C folds the same way with the constants of its own polynomial, and
+ * the last 128 bits are reduced with the crc instruction instead of a
+ * Barrett reduction. The crc instruction is as fast as folding on 128 bit
+ * registers, so only the avx-512 kernel is worth it, and only for blocks
+ * long enough to amortise folding the lanes back together.
+ */
+#    define CRC32C_VPCLMUL_MIN_LENGTH 512
+
+/**
+ * Fold the lanes x1..x4, which hold four consecutive 128 bit blocks, with
+ * the rest of the buffer and reduce them. length must be a multiple of 16.
+ * Inlined for the same reason as crc32_zlib_fold.
+ */
+__attribute__ ((target("pclmul,sse4.2"), always_inline))
+static inline uint32_t crc32c_fold(__m128i x1, __m128i x2, __m128i x3, __m128i x4,
+                            const uint8_t *buf, size_t length) {
+  const __m128i k1k2 = _mm_set_epi64x(0x009e4addf8LL, 0x00740eef02LL); // D = 512
+  const __m128i k3k4 = _mm_set_epi64x(0x014cd00bd6LL, 0x00f20c0dfeLL); // D = 128
+  __m128i x5, x6, x7, x8;
+  uint64_t crc;
+
+  /* Fold 4 x 128 bits at a time */
+  while (length >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+    buf += 64;
+    length -= 64;
+  }
+
+  /* Fold the 4 lanes into one */
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /* Remaining 128 bit blocks */
+  while (length >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+    buf += 16;
+    length -= 16;
+  }
+
+  /* The crc of the folded 128 bits from a zero state is the crc of it all */
+  crc = _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(x1));
+  crc = _mm_crc32_u64(crc, (uint64_t)_mm_extract_epi64(x1, 1));
+  return (uint32_t)crc;
+}
+
+/**
+ * The avx-512 kernel of crc32c_fold, as crc32_zlib_vpclmul. length must be
+ * at least 256 and a multiple of 16.
+ */
+__attribute__ ((target("avx512f,vpclmulqdq,pclmul,sse4.2")))
+static uint32_t crc32c_vpclmul(uint32_t crc, const uint8_t *buf, size_t length) {
+  const __m512i k2048 = _mm512_set_epi64(0x00b9e02b86LL, 0x00dcb17aa4LL,
+      0x00b9e02b86LL, 0x00dcb17aa4LL, 0x00b9e02b86LL, 0x00dcb17aa4LL,
+      0x00b9e02b86LL, 0x00dcb17aa4LL);
+  const __m512i k512 = _mm512_set_epi64(0x009e4addf8LL, 0x00740eef02LL,
+      0x009e4addf8LL, 0x00740eef02LL, 0x009e4addf8LL, 0x00740eef02LL,
+      0x009e4addf8LL, 0x00740eef02LL);
+  __m512i x0 = _mm512_loadu_si512((const void *)(buf + 0x00));
+  __m512i x1 = _mm512_loadu_si512((const void *)(buf + 0x40));
+  __m512i x2 = _mm512_loadu_si512((const void *)(buf + 0x80));
+  __m512i x3 = _mm512_loadu_si512((const void *)(buf + 0xc0));
+  x0 = _mm512_xor_si512(x0,
+      _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128(crc), 0));
+  buf += 256;
+  length -= 256;
+
+  /* Fold 16 x 128 bits at a time, 0x96 is the xor of the three operands */
+  while (length >= 256) {
+    x0 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x0, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x0, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0x00)), 0x96);
+    x1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x1, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x1, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0x40)), 0x96);
+    x2 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x2, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x2, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0x80)), 0x96);
+    x3 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x3, k2048, 0x00),
+        _mm512_clmulepi64_epi128(x3, k2048, 0x11),
+        _mm512_loadu_si512((const void *)(buf + 0xc0)), 0x96);
+    buf += 256;
+    length -= 256;
+  }
+
+  /* Fold the 4 registers into one, they are 512 bits apart */
+  x1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x0, k512, 0x00),
+      _mm512_clmulepi64_epi128(x0, k512, 0x11), x1, 0x96);
+  x2 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x1, k512, 0x00),
+      _mm512_clmulepi64_epi128(x1, k512, 0x11), x2, 0x96);
+  x3 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x2, k512, 0x00),
+      _mm512_clmulepi64_epi128(x2, k512, 0x11), x3, 0x96);
+
+  return crc32c_fold(_mm512_extracti32x4_epi32(x3, 0),
+      _mm512_extracti32x4_epi32(x3, 1), _mm512_extracti32x4_epi32(x3, 2),
+      _mm512_extracti32x4_epi32(x3, 3), buf, length);
+}
+
+static uint32_t crc32c_update_x86(uint32_t crc, const uint8_t *buf, size_t length) {
+  size_t folded = length & ~(size_t)15;
+  uint32_t unused1 = 0, unused2 = 0;
+
+  if (length >= CRC32C_VPCLMUL_MIN_LENGTH) {
+    crc = crc32c_vpclmul(crc, buf, folded);
+    buf += folded;
+    length -= folded;
+  }
+  pipelined_crc32c(&crc, &unused1, &unused2, buf, length, 1);
+  return crc;
+}
+
+/**
+ * Long blocks go through the avx-512 kernel one after the other, short ones
+ * are still interleaved with the crc instruction.
+ */
+static void pipelined_crc32c_vpclmul(uint32_t *crc1, uint32_t *crc2, uint32_t *crc3, const uint8_t *p_buf, size_t block_size, int num_blocks) {
+  assert(num_blocks >= 1 && num_blocks <=3 && "invalid num_blocks");
+  if (block_size < CRC32C_VPCLMUL_MIN_LENGTH) {
+    pipelined_crc32c(crc1, crc2, crc3, p_buf, block_size, num_blocks);
+    return;
+  }
+  *crc1 = crc32c_update_x86(*crc1, p_buf, block_size);
+  if (num_blocks >= 2)
+    *crc2 = crc32c_update_x86(*crc2, p_buf + block_size, block_size);
+  if (num_blocks >= 3)
+    *crc3 = crc32c_update_x86(*crc3, p_buf + 2 * block_size, block_size);
+}
+
+static uint64_t xgetbv(uint32_t index) {
+  uint32_t eax, edx;
+  asm("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+  return ((uint64_t)edx << 32) | eax;
+}
+
+/**
+ * The avx-512 kernel needs the cpu flags and the OS saving the zmm state.
+ */
+static int detect_vpclmul(uint32_t ecx1) {
+  uint32_t eax, ebx, ecx, edx;
+  if (!(ecx1 & OSXSAVE_FEATURE_BIT) ||
+      (xgetbv(0) & XCR0_ZMM_STATE) != XCR0_ZMM_STATE)
+    return 0;
+  asm("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0)
+      : "cc");
+  return (ebx & AVX512F_FEATURE_BIT) && (ecx & VPCLMUL_FEATURE_BIT);
+}
+
+#  endif // HAVE_VPCLMUL_KERNEL
+
+static uint32_t crc32_zlib_update_x86(uint32_t crc, const uint8_t *buf, size_t length) {
+  size_t folded = length & ~(size_t)15;
+
+#  ifdef HAVE_VPCLMUL_KERNEL
+  if (cpu_supports_vpclmul && length >= CRC32_ZLIB_VPCLMUL_MIN_LENGTH) {
+    crc = crc32_zlib_vpclmul(crc, buf, folded);
+    return crc32_zlib_sb8(crc, buf + folded, length - folded);
+  }
+#  endif
+  if (length >= CRC32_ZLIB_PCLMUL_MIN_LENGTH) {
+    crc = crc32_zlib_pclmul(crc, buf, folded);
+    return crc32_zlib_sb8(crc, buf + folded, length - folded);
+  }
+  return crc32_zlib_sb8(crc, buf, length);
+}
+
+/**
+ * The folding kernels keep four independent lanes already, so there is
+ * nothing to gain from interleaving the blocks.
+ */
+static void pipelined_crc32_zlib(uint32_t *crc1, uint32_t *crc2, uint32_t *crc3, const uint8_t *p_buf, size_t block_size, int num_blocks) {
+  assert(num_blocks >= 1 && num_blocks <=3 && "invalid num_blocks");
+  *crc1 = crc32_zlib_update_x86(*crc1, p_buf, block_size);
+  if (num_blocks >= 2)
+    *crc2 = crc32_zlib_update_x86(*crc2, p_buf + block_size, block_size);
+  if (num_blocks >= 3)
+    *crc3 = crc32_zlib_update_x86(*crc3, p_buf + 2 * block_size, block_size);
+}
+
+#endif // HAVE_PCLMUL_KERNEL
+
+/**
+ * Called by bulk_crc32.c on library load, initiailize the cached
+ * function pointers if cpu supports SSE4.2's crc32 instruction,
+ * PCLMULQDQ for the zlib polynomial, and VPCLMULQDQ on avx-512 for both.
  */
 typedef void (*crc_pipelined_func_t)(uint32_t *, uint32_t *, uint32_t *, const uint8_t *, size_t, int);
+typedef uint32_t (*crc_update_func_t)(uint32_t, const uint8_t *, size_t);
 extern crc_pipelined_func_t pipelined_crc32c_func;
+extern crc_pipelined_func_t pipelined_crc32_zlib_func;
+extern crc_update_func_t crc32_zlib_update_func;
+extern crc_update_func_t crc32c_update_func;
 
-void __attribute__ ((constructor)) init_cpu_support_flag(void) {
+void init_cpu_support_flag(void) {
   uint32_t ecx = cpuid(CPUID_FEATURES);
   if (ecx & SSE42_FEATURE_BIT) pipelined_crc32c_func = pipelined_crc32c;
+#ifdef HAVE_PCLMUL_KERNEL
+  if ((ecx & PCLMUL_FEATURE_BIT) && (ecx & SSE41_FEATURE_BIT)) {
+#  ifdef HAVE_VPCLMUL_KERNEL
+    cpu_supports_vpclmul = detect_vpclmul(ecx);
+    if (cpu_supports_vpclmul && (ecx & SSE42_FEATURE_BIT)) {
+      pipelined_crc32c_func = pipelined_crc32c_vpclmul;
+      crc32c_update_func = crc32c_update_x86;
+    }
+#  endif
+    pipelined_crc32_zlib_func = pipelined_crc32_zlib;
+    crc32_zlib_update_func = crc32_zlib_update_x86;
+  }
+#endif
 }
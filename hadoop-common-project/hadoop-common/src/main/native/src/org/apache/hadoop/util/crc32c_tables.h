@@ -548,3 +548,18 @@ const uint32_t CRC32C_T8_7[256] = {
   0xE54C35A1, 0xAC704886, 0x7734CFEF, 0x3E08B2C8, 
   0xC451B7CC, 0x8D6DCAEB, 0x56294D82, 0x1F1530A5
 };
+
+/*
+ * x^(2^n) modulo the polynomial 82F63B78, bit reflected, for n from 0 to 30.
+ * From there on the powers repeat, x^(2^31) being x.
+ */
+const uint32_t CRC32C_X2N[31] = {
+  0x40000000, 0x20000000, 0x08000000, 0x00800000, 
+  0x00008000, 0x82F63B78, 0x6EA2D55C, 0x18B8EA18, 
+  0x510AC59A, 0xB82BE955, 0xB8FDB1E7, 0x88E56F72, 
+  0x74C360A4, 0xE4172B16, 0x0D65762A, 0x35D73A62, 
+  0x28461564, 0xBF455269, 0xE2EA32DC, 0xFE7740E6, 
+  0xF946610B, 0x3C204F8F, 0x538586E3, 0x59726915, 
+  0x734D5309, 0xBC1AC763, 0x7D0722CC, 0xD289CABE, 
+  0xE94CA9BC, 0x05B74F3F, 0xA51E1F42
+};
@@ -0,0 +1,149 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+#include "native_memory.h"
+
+#include <stdlib.h>
+
+/*
+ * native_memory_malloc puts the size in front of the memory it hands out,
+ * in a header that keeps the alignment malloc gives.
+ */
+#define NATIVE_MEMORY_HEADER 16
+
+// The subsystems, and the total after them
+static int64_t memory_current[NATIVE_MEMORY_SUBSYSTEMS + 1];
+static int64_t memory_peak[NATIVE_MEMORY_SUBSYSTEMS + 1];
+
+#ifdef WINDOWS
+
+static int64_t add_fetch(int64_t *value, int64_t delta)
+{
+  return InterlockedExchangeAdd64(value, delta) + delta;
+}
+
+static int64_t load(int64_t *value)
+{
+  return InterlockedCompareExchange64(value, 0, 0);
+}
+
+static void raise_peak(int64_t *peak, int64_t current)
+{
+  int64_t seen = load(peak);
+
+  while (current > seen) {
+    int64_t prev = InterlockedCompareExchange64(peak, current, seen);
+    if (prev == seen) {
+      break;
+    }
+    seen = prev;
+  }
+}
+
+#else
+
+static int64_t add_fetch(int64_t *value, int64_t delta)
+{
+  return __atomic_add_fetch(value, delta, __ATOMIC_RELAXED);
+}
+
+static int64_t load(int64_t *value)
+{
+  return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+static void raise_peak(int64_t *peak, int64_t current)
+{
+  int64_t seen = load(peak);
+
+  while (current > seen &&
+         !__atomic_compare_exchange_n(peak, &seen, current, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+#endif // WINDOWS
+
+void native_memory_add(enum native_memory_subsystem subsystem, int64_t bytes)
+{
+  int64_t current;
+
+  if (bytes == 0) {
+    return;
+  }
+  current = add_fetch(&memory_current[subsystem], bytes);
+  if (bytes > 0) {
+    raise_peak(&memory_peak[subsystem], current);
+  }
+  current = add_fetch(&memory_current[NATIVE_MEMORY_SUBSYSTEMS], bytes);
+  if (bytes > 0) {
+    raise_peak(&memory_peak[NATIVE_MEMORY_SUBSYSTEMS], current);
+  }
+}
+
+void *native_memory_malloc(enum native_memory_subsystem subsystem, size_t size)
+{
+  char *block = malloc(NATIVE_MEMORY_HEADER + size);
+
+  if (!block) {
+    return NULL;
+  }
+  *(size_t *)block = size;
+  native_memory_add(subsystem, (int64_t)size);
+  return block + NATIVE_MEMORY_HEADER;
+}
+
+void native_memory_free(enum native_memory_subsystem subsystem, void *ptr)
+{
+  char *block;
+
+  if (!ptr) {
+    return;
+  }
+  block = (char *)ptr - NATIVE_MEMORY_HEADER;
+  native_memory_add(subsystem, -(int64_t)*(size_t *)block);
+  free(block);
+}
+
+void *native_memory_zalloc(void *opaque, unsigned int items, unsigned int size)
+{
+  return native_memory_malloc(NATIVE_MEMORY_CODEC, (size_t)items * size);
+}
+
+void native_memory_zfree(void *opaque, void *ptr)
+{
+  native_memory_free(NATIVE_MEMORY_CODEC, ptr);
+}
+
+void *native_memory_bzalloc(void *opaque, int items, int size)
+{
+  return native_memory_malloc(NATIVE_MEMORY_CODEC, (size_t)items * size);
+}
+
+void native_memory_bzfree(void *opaque, void *ptr)
+{
+  native_memory_free(NATIVE_MEMORY_CODEC, ptr);
+}
+
+void get_native_memory_stats(enum native_memory_subsystem subsystem,
+                             struct native_memory_stats *stats)
+{
+  stats->current = load(&memory_current[subsystem]);
+  stats->peak = load(&memory_peak[subsystem]);
+}
@@ -0,0 +1,96 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORG_APACHE_HADOOP_UTIL_NATIVE_MEMORY_H
+#define ORG_APACHE_HADOOP_UTIL_NATIVE_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Accounting of the memory native code allocates outside of the view of the
+ * JVM, so that the native part of a container's footprint can be told
+ * apart.  Every library that compiles this in, libhadoop and libnativetask,
+ * keeps counters of its own: the bytes currently allocated and the most
+ * ever allocated at once, by subsystem and in total.  Updates are atomic
+ * and only made when state or buffers are created, grown or released, not
+ * on the data path.
+ */
+enum native_memory_subsystem {
+  // Compressor and decompressor state and buffers
+  NATIVE_MEMORY_CODEC = 0,
+  // Erasure coder state and tables
+  NATIVE_MEMORY_ERASURE_CODE = 1,
+  // The nativetask sort buffer, as far as it has been touched
+  NATIVE_MEMORY_SORT = 2,
+  // The nativetask read and write buffers of streams
+  NATIVE_MEMORY_BUFFERS = 3,
+  NATIVE_MEMORY_SUBSYSTEMS = 4
+};
+
+struct native_memory_stats {
+  // The bytes allocated now
+  int64_t current;
+  // The most bytes allocated at any time so far
+  int64_t peak;
+};
+
+/**
+ * Accounts bytes allocated by subsystem, or released if negative.
+ */
+void native_memory_add(enum native_memory_subsystem subsystem, int64_t bytes);
+
+/**
+ * malloc and free that account the size of the allocation to subsystem.
+ * Memory from native_memory_malloc must be freed by native_memory_free of
+ * the same subsystem and nothing else.  free of NULL does nothing.
+ */
+void *native_memory_malloc(enum native_memory_subsystem subsystem, size_t size);
+void native_memory_free(enum native_memory_subsystem subsystem, void *ptr);
+
+/**
+ * zalloc and zfree of a zlib stream, accounting what zlib allocates to
+ * NATIVE_MEMORY_CODEC.  opaque is ignored.
+ */
+void *native_memory_zalloc(void *opaque, unsigned int items, unsigned int size);
+void native_memory_zfree(void *opaque, void *ptr);
+
+/**
+ * bzalloc and bzfree of a bzip2 stream, accounting what libbz2 allocates
+ * to NATIVE_MEMORY_CODEC.  opaque is ignored.
+ */
+void *native_memory_bzalloc(void *opaque, int items, int size);
+void native_memory_bzfree(void *opaque, void *ptr);
+
+/**
+ * Gets the counters of subsystem, or the total of all subsystems if it is
+ * NATIVE_MEMORY_SUBSYSTEMS.  The peak of the total is the most allocated
+ * at once, not the sum of the peaks.
+ */
+void get_native_memory_stats(enum native_memory_subsystem subsystem,
+                             struct native_memory_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ORG_APACHE_HADOOP_UTIL_NATIVE_MEMORY_H
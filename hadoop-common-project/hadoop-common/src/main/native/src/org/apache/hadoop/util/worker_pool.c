@@ -0,0 +1,313 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "org_apache_hadoop.h"
+#include "worker_pool.h"
+
+#include <string.h>
+
+#ifdef UNIX
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#endif // UNIX
+
+// Never start more workers than this, however many CPUs there are
+#define MAX_POOL_WORKERS 64
+
+/**
+ * The tasks of one run_tasks call.  It lives on the stack of the caller,
+ * which does not return before every task handed out is finished.
+ */
+struct task_job {
+  parallel_task_fn fn;
+  void *arg;
+  int num_tasks;
+  // The next task to hand out
+  int next_task;
+  // The tasks that are not finished yet, handed out or not
+  int pending;
+  // How many more workers may join in
+  int helpers;
+  int queued;
+  struct task_job *next;
+};
+
+#ifdef UNIX
+// Protects everything below, and the fields of the queued jobs
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+// Signalled when a job is queued
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+// Broadcast when the last task of a job is finished
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+// The jobs that have tasks left and may take more workers, oldest first
+static struct task_job *pool_jobs = NULL;
+static int pool_workers = 0;
+// The most workers to start, -1 until the CPUs are counted
+static int pool_max_workers = -1;
+static int64_t pool_queued_tasks = 0;
+static int64_t pool_tasks_run = 0;
+static int64_t pool_busy_nanos = 0;
+
+static int64_t monotonic_nanos(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long read_long(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  long value = -1;
+
+  if (file) {
+    if (fscanf(file, "%ld", &value) != 1) {
+      value = -1;
+    }
+    fclose(file);
+  }
+  return value;
+}
+
+/**
+ * Gets the CPUs the CFS quota of the cgroup of the process amounts to,
+ * rounded up, or 0 if there is no quota.
+ */
+static long cgroup_cpu_quota(void)
+{
+  FILE *file;
+  char quota[32];
+  long period = 0;
+
+  // cgroup v2: "<quota> <period>", the quota being "max" if there is none
+  file = fopen("/sys/fs/cgroup/cpu.max", "r");
+  if (file) {
+    if (fscanf(file, "%31s %ld", quota, &period) != 2 ||
+        !strcmp(quota, "max") || period <= 0 || atol(quota) <= 0) {
+      period = 0;
+    }
+    fclose(file);
+    return period ? (atol(quota) + period - 1) / period : 0;
+  }
+  // cgroup v1, with a quota of -1 if there is none
+  period = read_long("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+  if (period <= 0) {
+    return 0;
+  }
+  return (read_long("/sys/fs/cgroup/cpu/cpu.cfs_quota_us") + period - 1) /
+      period;
+}
+
+/**
+ * Counts the CPUs the process may use.
+ */
+static int count_cpus(void)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN), quota;
+#ifdef __linux__
+  cpu_set_t set;
+
+  if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0 &&
+      CPU_COUNT(&set) < cpus) {
+    cpus = CPU_COUNT(&set);
+  }
+#endif
+  quota = cgroup_cpu_quota();
+  if (quota > 0 && quota < cpus) {
+    cpus = quota;
+  }
+  return cpus < 1 ? 1 : (int)cpus;
+}
+
+/**
+ * Gets the most workers to start.  Called with the lock held.
+ */
+static int max_workers(void)
+{
+  if (pool_max_workers < 0) {
+    pool_max_workers = count_cpus() - 1;
+    if (pool_max_workers > MAX_POOL_WORKERS) {
+      pool_max_workers = MAX_POOL_WORKERS;
+    }
+  }
+  return pool_max_workers;
+}
+
+/**
+ * Take a job off the queue.  Called with the lock held.
+ */
+static void dequeue_job(struct task_job *job)
+{
+  struct task_job **p;
+
+  if (!job->queued) {
+    return;
+  }
+  for (p = &pool_jobs; *p != job; p = &(*p)->next) {
+  }
+  *p = job->next;
+  job->queued = 0;
+}
+
+/**
+ * Run tasks of a job until there are none left to hand out.  Called with
+ * the lock held, which it holds again when it returns.  The job must not be
+ * touched afterwards, since its caller may have returned.
+ */
+static void run_job(struct task_job *job)
+{
+  int64_t start;
+  int task;
+
+  while (job->next_task < job->num_tasks) {
+    task = job->next_task++;
+    pool_queued_tasks--;
+    if (job->next_task == job->num_tasks) {
+      dequeue_job(job);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    start = monotonic_nanos();
+    job->fn(job->arg, task);
+    start = monotonic_nanos() - start;
+    pthread_mutex_lock(&pool_lock);
+    pool_tasks_run++;
+    pool_busy_nanos += start;
+    if (--job->pending == 0) {
+      pthread_cond_broadcast(&pool_done);
+    }
+  }
+}
+
+static void *task_worker(void *arg)
+{
+  struct task_job *job;
+
+  pthread_mutex_lock(&pool_lock);
+  for (;;) {
+    while (!pool_jobs) {
+      pthread_cond_wait(&pool_work, &pool_lock);
+    }
+    job = pool_jobs;
+    if (--job->helpers == 0) {
+      dequeue_job(job);
+    }
+    run_job(job);
+  }
+  return NULL;
+}
+
+/**
+ * Start workers until there are at least the given number, or as many as
+ * the pool may have.  Called with the lock held.  A worker that cannot be
+ * started only costs parallelism.
+ */
+static void start_workers(int workers)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  if (workers > max_workers()) {
+    workers = max_workers();
+  }
+  if (pool_workers >= workers || pthread_attr_init(&attr)) {
+    return;
+  }
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  while (pool_workers < workers) {
+    if (pthread_create(&thread, &attr, task_worker, NULL)) {
+      break;
+    }
+    pool_workers++;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+void run_tasks(parallel_task_fn fn, void *arg, int num_tasks, int threads)
+{
+  struct task_job job;
+  struct task_job **p;
+
+  memset(&job, 0, sizeof(job));
+  job.fn = fn;
+  job.arg = arg;
+  job.num_tasks = num_tasks;
+  job.pending = num_tasks;
+
+  pthread_mutex_lock(&pool_lock);
+  pool_queued_tasks += num_tasks;
+  if (threads > 1 && num_tasks > 1) {
+    start_workers(threads - 1);
+  }
+  // No more helpers than there are workers to wake
+  if (threads - 1 > pool_workers) {
+    threads = pool_workers + 1;
+  }
+  if (threads > 1 && num_tasks > 1) {
+    job.helpers = threads - 1;
+    job.queued = 1;
+    for (p = &pool_jobs; *p; p = &(*p)->next) {
+    }
+    *p = &job;
+    pthread_cond_broadcast(&pool_work);
+  }
+  run_job(&job);
+  while (job.pending > 0) {
+    pthread_cond_wait(&pool_done, &pool_lock);
+  }
+  pthread_mutex_unlock(&pool_lock);
+}
+
+void get_worker_pool_stats(struct worker_pool_stats *stats)
+{
+  pthread_mutex_lock(&pool_lock);
+  stats->max_workers = max_workers();
+  stats->workers = pool_workers;
+  stats->queued_tasks = pool_queued_tasks;
+  stats->tasks_run = pool_tasks_run;
+  stats->busy_nanos = pool_busy_nanos;
+  pthread_mutex_unlock(&pool_lock);
+}
+#endif // UNIX
+
+#ifdef WINDOWS
+static volatile LONG64 pool_tasks_run = 0;
+
+void run_tasks(parallel_task_fn fn, void *arg, int num_tasks, int threads)
+{
+  int task;
+
+  // No worker pool here, the tasks run one after the other
+  for (task = 0; task < num_tasks; task++) {
+    fn(arg, task);
+  }
+  InterlockedExchangeAdd64(&pool_tasks_run, num_tasks);
+}
+
+void get_worker_pool_stats(struct worker_pool_stats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+  stats->tasks_run = pool_tasks_run;
+}
+#endif // WINDOWS
@@ -0,0 +1,65 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORG_APACHE_HADOOP_UTIL_WORKER_POOL_H
+#define ORG_APACHE_HADOOP_UTIL_WORKER_POOL_H
+
+#include <stdint.h>
+
+/**
+ * The worker threads shared by the CPU kernels of libhadoop: the codecs of
+ * io/compress, the coders of io/erasurecode and the checksums of util.  The
+ * pool is started on demand and never has more workers than the CPUs the
+ * process may use, taking the CPU affinity and the CFS quota of its cgroup
+ * into account, less one for the calling thread, so that callers asking for
+ * many threads do not oversubscribe a container.
+ */
+
+/**
+ * Runs task number task of the job described by arg.
+ */
+typedef void (*parallel_task_fn)(void *arg, int task);
+
+/**
+ * Runs tasks 0 to num_tasks - 1 of fn, spread over at most threads
+ * threads, the calling one included, taken from the shared pool.  Idle
+ * workers, and the caller while it waits, take the next task of the oldest
+ * job that has tasks left, so a slow task holds up no others.  Returns when
+ * every task is done.
+ */
+void run_tasks(parallel_task_fn fn, void *arg, int num_tasks, int threads);
+
+struct worker_pool_stats {
+  // The most workers the pool starts
+  int max_workers;
+  // The workers started so far
+  int workers;
+  // The tasks of run_tasks calls that no thread has started yet
+  int64_t queued_tasks;
+  // The tasks run so far
+  int64_t tasks_run;
+  // The nanoseconds spent running them, by the workers and the callers
+  int64_t busy_nanos;
+};
+
+/**
+ * Gets a snapshot of the statistics of the pool.
+ */
+void get_worker_pool_stats(struct worker_pool_stats *stats);
+
+#endif //ORG_APACHE_HADOOP_UTIL_WORKER_POOL_H
@@ -0,0 +1,621 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures the codecs of libhadoop: compress and decompress throughput, in
+ * MB/s of uncompressed data, and the compression ratio.  The data is text,
+ * JSON log lines and binary columns, plus any files named on the command
+ * line, for several direct buffer sizes.
+ *
+ * Each codec is driven the way its JNI compressor and decompressor drive it.
+ * zlib, bzip2 and zstd stream through input and output pieces of the buffer
+ * size.  lz4 and snappy compress each buffer as one block behind the two
+ * lengths BlockCompressorStream writes.
+ *
+ * COMPRESS_BENCH_MILLIS   how long to run each case, 500 milliseconds by
+ *                         default
+ * COMPRESS_BENCH_CODECS   a comma separated list of the codecs to run, all
+ *                         of those built in by default
+ */
+
+#include "config.h"
+#include "org/apache/hadoop/io/compress/lz4/lz4.h"
+#include "org/apache/hadoop/io/compress/lz4/lz4hc.h"
+
+#include <zlib.h>
+#ifdef HADOOP_BZIP2_LIBRARY
+#include <bzlib.h>
+#endif
+#ifdef HADOOP_SNAPPY_LIBRARY
+#include <snappy-c.h>
+#endif
+#ifdef HADOOP_ZSTD_LIBRARY
+#include <zstd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DATA_SIZE (16 * 1024 * 1024)
+
+static const int bufferSizes[] = {
+  16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024
+};
+
+#define NUM_BUFFER_SIZES (int)(sizeof(bufferSizes) / sizeof(bufferSizes[0]))
+
+static double nowSeconds(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static int minInt(int a, int b) {
+  return a < b ? a : b;
+}
+
+/**
+ * Text: words of a small vocabulary, in random order.
+ */
+static void fillText(unsigned char* data, int len) {
+  static const char* words[] = {
+    "hadoop ", "block ", "replica ", "datanode ", "namenode ", "stream ",
+    "checksum ", "codec ", "\n", "the ", "of ", "a ", "with ", "is ",
+    "pipeline ", "lease ", "quota ", "snapshot ", "volume ", "rack "
+  };
+  int i = 0;
+  const char* w;
+
+  while (i < len) {
+    for (w = words[rand() % 20]; *w && i < len; w++) {
+      data[i++] = *w;
+    }
+  }
+}
+
+/**
+ * JSON logs: one event a line, with a rising timestamp, a few levels and
+ * hosts, and ids and sizes that vary from line to line.
+ */
+static void fillJson(unsigned char* data, int len) {
+  static const char* levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN" };
+  static const char* ops[] = { "READ_BLOCK", "WRITE_BLOCK", "COPY_BLOCK",
+                               "BLOCK_CHECKSUM" };
+  char line[512];
+  long long millis = 1700000000000LL;
+  int i = 0, n;
+
+  while (i < len) {
+    millis += rand() % 50;
+    n = snprintf(line, sizeof(line),
+        "{\"ts\":%lld,\"level\":\"%s\",\"host\":\"dn-%03d.example.com\","
+        "\"op\":\"%s\",\"block\":\"blk_%d_%d\",\"bytes\":%d,"
+        "\"latencyMs\":%d,\"client\":\"10.%d.%d.%d\"}\n",
+        millis, levels[rand() % 5], rand() % 200, ops[rand() % 4],
+        1073741825 + rand() % 1000000, 1001 + rand() % 5000,
+        rand() % (128 * 1024 * 1024), rand() % 400, rand() % 4,
+        rand() % 256, rand() % 256);
+    memcpy(data + i, line, minInt(n, len - i));
+    i += n;
+  }
+}
+
+/**
+ * Binary columns, as a columnar file lays them out: sorted 64 bit ids, then
+ * 32 bit codes of a small dictionary, then 64 bit doubles.
+ */
+static void fillColumns(unsigned char* data, int len) {
+  int rows = len / (8 + 4 + 8), i;
+  long long id = 0;
+  int code;
+  double value;
+
+  memset(data, 0, len);
+  for (i = 0; i < rows; i++) {
+    id += 1 + rand() % 16;
+    code = rand() % 64;
+    value = (rand() % 1000000) / 100.0;
+    memcpy(data + (size_t)i * 8, &id, 8);
+    memcpy(data + (size_t)rows * 8 + (size_t)i * 4, &code, 4);
+    memcpy(data + (size_t)rows * 12 + (size_t)i * 8, &value, 8);
+  }
+}
+
+/**
+ * The codecs return the length they produced, or -1 on failure.  out has
+ * room for the worst case; it is written a buffer at a time all the same.
+ */
+typedef int (*codec_func)(const unsigned char* in, int inLen,
+                          unsigned char* out, int outLen, int bufferSize);
+
+static int zlibCompress(const unsigned char* in, int inLen,
+                        unsigned char* out, int outLen, int bufferSize) {
+  z_stream stream;
+  int ret = Z_OK, off = 0;
+
+  memset(&stream, 0, sizeof(stream));
+  // ZlibCompressor: DEFAULT_COMPRESSION, DEFAULT_STRATEGY, DEFAULT_HEADER
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return -1;
+  }
+  while (ret != Z_STREAM_END) {
+    if (stream.avail_in == 0 && off < inLen) {
+      stream.next_in = (unsigned char*)in + off;
+      stream.avail_in = minInt(inLen - off, bufferSize);
+      off += stream.avail_in;
+    }
+    stream.next_out = out + stream.total_out;
+    stream.avail_out = minInt(outLen - (int)stream.total_out, bufferSize);
+    ret = deflate(&stream, off == inLen ? Z_FINISH : Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      deflateEnd(&stream);
+      return -1;
+    }
+  }
+  outLen = stream.total_out;
+  deflateEnd(&stream);
+  return outLen;
+}
+
+static int zlibDecompress(const unsigned char* in, int inLen,
+                          unsigned char* out, int outLen, int bufferSize) {
+  z_stream stream;
+  int ret = Z_OK, off = 0;
+
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, 15) != Z_OK) {
+    return -1;
+  }
+  while (ret != Z_STREAM_END) {
+    if (stream.avail_in == 0) {
+      stream.next_in = (unsigned char*)in + off;
+      stream.avail_in = minInt(inLen - off, bufferSize);
+      off += stream.avail_in;
+    }
+    stream.next_out = out + stream.total_out;
+    stream.avail_out = minInt(outLen - (int)stream.total_out, bufferSize);
+    ret = inflate(&stream, Z_PARTIAL_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      inflateEnd(&stream);
+      return -1;
+    }
+  }
+  outLen = stream.total_out;
+  inflateEnd(&stream);
+  return outLen;
+}
+
+#ifdef HADOOP_BZIP2_LIBRARY
+static int bzip2Compress(const unsigned char* in, int inLen,
+                         unsigned char* out, int outLen, int bufferSize) {
+  bz_stream stream;
+  int ret = BZ_RUN_OK, off = 0;
+
+  memset(&stream, 0, sizeof(stream));
+  // Bzip2Factory: 900 KB blocks, work factor 30
+  if (BZ2_bzCompressInit(&stream, 9, 0, 30) != BZ_OK) {
+    return -1;
+  }
+  while (ret != BZ_STREAM_END) {
+    if (stream.avail_in == 0 && off < inLen) {
+      stream.next_in = (char*)in + off;
+      stream.avail_in = minInt(inLen - off, bufferSize);
+      off += stream.avail_in;
+    }
+    stream.next_out = (char*)out + stream.total_out_lo32;
+    stream.avail_out = minInt(outLen - (int)stream.total_out_lo32,
+                              bufferSize);
+    ret = BZ2_bzCompress(&stream, off == inLen ? BZ_FINISH : BZ_RUN);
+    if (ret != BZ_RUN_OK && ret != BZ_FINISH_OK && ret != BZ_STREAM_END) {
+      BZ2_bzCompressEnd(&stream);
+      return -1;
+    }
+  }
+  outLen = stream.total_out_lo32;
+  BZ2_bzCompressEnd(&stream);
+  return outLen;
+}
+
+static int bzip2Decompress(const unsigned char* in, int inLen,
+                           unsigned char* out, int outLen, int bufferSize) {
+  bz_stream stream;
+  int ret = BZ_OK, off = 0;
+
+  memset(&stream, 0, sizeof(stream));
+  if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK) {
+    return -1;
+  }
+  while (ret != BZ_STREAM_END) {
+    if (stream.avail_in == 0) {
+      stream.next_in = (char*)in + off;
+      stream.avail_in = minInt(inLen - off, bufferSize);
+      off += stream.avail_in;
+    }
+    stream.next_out = (char*)out + stream.total_out_lo32;
+    stream.avail_out = minInt(outLen - (int)stream.total_out_lo32,
+                              bufferSize);
+    ret = BZ2_bzDecompress(&stream);
+    if (ret != BZ_OK && ret != BZ_STREAM_END) {
+      BZ2_bzDecompressEnd(&stream);
+      return -1;
+    }
+  }
+  outLen = stream.total_out_lo32;
+  BZ2_bzDecompressEnd(&stream);
+  return outLen;
+}
+#endif
+
+#ifdef HADOOP_ZSTD_LIBRARY
+static int zstdCompress(const unsigned char* in, int inLen,
+                        unsigned char* out, int outLen, int bufferSize) {
+  ZSTD_CCtx* context = ZSTD_createCCtx();
+  ZSTD_inBuffer input = { in, 0, 0 };
+  ZSTD_outBuffer output;
+  size_t rv = 1;
+  int off = 0, total = 0;
+
+  if (context == NULL) {
+    return -1;
+  }
+  // ZStandardCompressor: level 3 and a checksum
+  ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, 3);
+  ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+  while (off < inLen || input.pos < input.size || rv != 0) {
+    if (input.pos == input.size && off < inLen) {
+      input.src = in + off;
+      input.size = minInt(inLen - off, bufferSize);
+      input.pos = 0;
+      off += input.size;
+    }
+    output.dst = out + total;
+    output.size = minInt(outLen - total, bufferSize);
+    output.pos = 0;
+    rv = ZSTD_compressStream2(context, &output, &input,
+                              off == inLen ? ZSTD_e_end : ZSTD_e_continue);
+    if (ZSTD_isError(rv) || (output.size == 0 && rv != 0)) {
+      ZSTD_freeCCtx(context);
+      return -1;
+    }
+    total += output.pos;
+  }
+  ZSTD_freeCCtx(context);
+  return total;
+}
+
+static int zstdDecompress(const unsigned char* in, int inLen,
+                          unsigned char* out, int outLen, int bufferSize) {
+  ZSTD_DCtx* context = ZSTD_createDCtx();
+  ZSTD_inBuffer input = { in, 0, 0 };
+  ZSTD_outBuffer output;
+  size_t rv = 1;
+  int off = 0, total = 0;
+
+  if (context == NULL) {
+    return -1;
+  }
+  while (rv != 0) {
+    if (input.pos == input.size && off < inLen) {
+      input.src = in + off;
+      input.size = minInt(inLen - off, bufferSize);
+      input.pos = 0;
+      off += input.size;
+    }
+    output.dst = out + total;
+    output.size = minInt(outLen - total, bufferSize);
+    output.pos = 0;
+    rv = ZSTD_decompressStream(context, &output, &input);
+    if (ZSTD_isError(rv) ||
+        (rv != 0 && output.pos == 0 && input.pos == input.size &&
+         off == inLen)) {
+      ZSTD_freeDCtx(context);
+      return -1;
+    }
+    total += output.pos;
+  }
+  ZSTD_freeDCtx(context);
+  return total;
+}
+#endif
+
+static void putInt(unsigned char* p, int v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static int getInt(const unsigned char* p) {
+  return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * Block codecs: each buffer becomes its uncompressed and compressed
+ * lengths followed by the compressed block, as BlockCompressorStream
+ * writes them.
+ */
+typedef int (*block_func)(const char* in, int inLen, char* out, int outLen);
+
+static int blockCompress(block_func compress, const unsigned char* in,
+                         int inLen, unsigned char* out, int outLen,
+                         int bufferSize) {
+  int off = 0, total = 0, len, compressed;
+
+  while (off < inLen) {
+    len = minInt(inLen - off, bufferSize);
+    if (outLen - total < 8) {
+      return -1;
+    }
+    compressed = compress((const char*)in + off, len, (char*)out + total + 8,
+                          outLen - total - 8);
+    if (compressed <= 0) {
+      return -1;
+    }
+    putInt(out + total, len);
+    putInt(out + total + 4, compressed);
+    total += 8 + compressed;
+    off += len;
+  }
+  return total;
+}
+
+static int blockDecompress(block_func decompress, const unsigned char* in,
+                           int inLen, unsigned char* out, int outLen) {
+  int off = 0, total = 0, len, compressed;
+
+  while (off + 8 <= inLen) {
+    len = getInt(in + off);
+    compressed = getInt(in + off + 4);
+    if (len > outLen - total || compressed > inLen - off - 8 ||
+        decompress((const char*)in + off + 8, compressed, (char*)out + total,
+                   len) != len) {
+      return -1;
+    }
+    total += len;
+    off += 8 + compressed;
+  }
+  return total;
+}
+
+static int lz4Block(const char* in, int inLen, char* out, int outLen) {
+  return outLen < LZ4_compressBound(inLen) ? -1 :
+      LZ4_compress(in, out, inLen);
+}
+
+static int lz4hcBlock(const char* in, int inLen, char* out, int outLen) {
+  return outLen < LZ4_compressBound(inLen) ? -1 :
+      LZ4_compressHC(in, out, inLen);
+}
+
+static int lz4Uncompress(const char* in, int inLen, char* out, int outLen) {
+  return LZ4_decompress_safe(in, out, inLen, outLen);
+}
+
+static int lz4Compress(const unsigned char* in, int inLen,
+                       unsigned char* out, int outLen, int bufferSize) {
+  return blockCompress(lz4Block, in, inLen, out, outLen, bufferSize);
+}
+
+static int lz4hcCompress(const unsigned char* in, int inLen,
+                         unsigned char* out, int outLen, int bufferSize) {
+  return blockCompress(lz4hcBlock, in, inLen, out, outLen, bufferSize);
+}
+
+static int lz4Decompress(const unsigned char* in, int inLen,
+                         unsigned char* out, int outLen, int bufferSize) {
+  return blockDecompress(lz4Uncompress, in, inLen, out, outLen);
+}
+
+#ifdef HADOOP_SNAPPY_LIBRARY
+static int snappyBlock(const char* in, int inLen, char* out, int outLen) {
+  size_t len = outLen;
+
+  return snappy_compress(in, inLen, out, &len) == SNAPPY_OK ? (int)len : -1;
+}
+
+static int snappyUncompress(const char* in, int inLen, char* out,
+                            int outLen) {
+  size_t len = outLen;
+
+  return snappy_uncompress(in, inLen, out, &len) == SNAPPY_OK ?
+      (int)len : -1;
+}
+
+static int snappyCompress(const unsigned char* in, int inLen,
+                          unsigned char* out, int outLen, int bufferSize) {
+  return blockCompress(snappyBlock, in, inLen, out, outLen, bufferSize);
+}
+
+static int snappyDecompress(const unsigned char* in, int inLen,
+                            unsigned char* out, int outLen, int bufferSize) {
+  return blockDecompress(snappyUncompress, in, inLen, out, outLen);
+}
+#endif
+
+static const struct {
+  const char* name;
+  codec_func compress;
+  codec_func decompress;
+} codecs[] = {
+  { "zlib", zlibCompress, zlibDecompress },
+#ifdef HADOOP_BZIP2_LIBRARY
+  { "bzip2", bzip2Compress, bzip2Decompress },
+#endif
+#ifdef HADOOP_ZSTD_LIBRARY
+  { "zstd", zstdCompress, zstdDecompress },
+#endif
+  { "lz4", lz4Compress, lz4Decompress },
+  { "lz4hc", lz4hcCompress, lz4Decompress },
+#ifdef HADOOP_SNAPPY_LIBRARY
+  { "snappy", snappyCompress, snappyDecompress },
+#endif
+};
+
+#define NUM_CODECS (int)(sizeof(codecs) / sizeof(codecs[0]))
+
+static int isSelected(const char* list, const char* name) {
+  size_t len = strlen(name);
+  const char* p;
+
+  if (list == NULL) {
+    return 1;
+  }
+  for (p = list; (p = strstr(p, name)) != NULL; p += len) {
+    if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0')) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static unsigned char* readFile(const char* path, int* len) {
+  FILE* file = fopen(path, "rb");
+  unsigned char* data;
+  long size;
+
+  if (file == NULL || fseek(file, 0, SEEK_END) != 0 ||
+      (size = ftell(file)) <= 0 || size > 256 * 1024 * 1024 ||
+      fseek(file, 0, SEEK_SET) != 0) {
+    if (file != NULL) {
+      fclose(file);
+    }
+    return NULL;
+  }
+  data = malloc(size);
+  if (data != NULL && fread(data, 1, size, file) != (size_t)size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  *len = (int)size;
+  return data;
+}
+
+static int benchCorpus(const char* corpus, const unsigned char* data, int len,
+                       double seconds, const char* selected) {
+  int outLen = len + len / 8 + 64 * 1024;
+  unsigned char *compressed, *out;
+  double start, elapsed, compressRate, decompressRate;
+  long long calls;
+  int i, j, compressedLen, ret = 0;
+
+  compressed = malloc(outLen);
+  out = malloc(len);
+  if (compressed == NULL || out == NULL) {
+    fprintf(stderr, "Failed to allocate the buffers\n");
+    free(compressed);
+    free(out);
+    return 1;
+  }
+  for (i = 0; i < NUM_CODECS && ret == 0; i++) {
+    if (!isSelected(selected, codecs[i].name)) {
+      continue;
+    }
+    for (j = 0; j < NUM_BUFFER_SIZES; j++) {
+      compressedLen = codecs[i].compress(data, len, compressed, outLen,
+                                         bufferSizes[j]);
+      if (compressedLen < 0 ||
+          codecs[i].decompress(compressed, compressedLen, out, len,
+                               bufferSizes[j]) != len ||
+          memcmp(data, out, len) != 0) {
+        fprintf(stderr, "%s round trip of %s failed\n", codecs[i].name,
+                corpus);
+        ret = 1;
+        break;
+      }
+
+      calls = 0;
+      start = nowSeconds();
+      do {
+        codecs[i].compress(data, len, compressed, outLen, bufferSizes[j]);
+        calls++;
+        elapsed = nowSeconds() - start;
+      } while (elapsed < seconds);
+      compressRate = (double)calls * len / elapsed / (1024 * 1024);
+
+      calls = 0;
+      start = nowSeconds();
+      do {
+        codecs[i].decompress(compressed, compressedLen, out, len,
+                             bufferSizes[j]);
+        calls++;
+        elapsed = nowSeconds() - start;
+      } while (elapsed < seconds);
+      decompressRate = (double)calls * len / elapsed / (1024 * 1024);
+
+      printf("%-6s %-12s buffer %4d KB: compress %8.1f MB/s, "
+             "decompress %8.1f MB/s, ratio %6.2f\n", codecs[i].name, corpus,
+             bufferSizes[j] / 1024, compressRate, decompressRate,
+             (double)len / compressedLen);
+    }
+  }
+  free(compressed);
+  free(out);
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  static const struct {
+    const char* name;
+    void (*fill)(unsigned char*, int);
+  } corpora[] = {
+    { "text", fillText },
+    { "json", fillJson },
+    { "columns", fillColumns },
+  };
+  unsigned char* data;
+  const char *str, *selected;
+  double seconds;
+  int i, len, ret = 0;
+
+  str = getenv("COMPRESS_BENCH_MILLIS");
+  seconds = (str ? atoi(str) : 500) / 1000.0;
+  if (seconds <= 0) {
+    fprintf(stderr, "COMPRESS_BENCH_MILLIS must be greater than 0.\n");
+    return 1;
+  }
+  selected = getenv("COMPRESS_BENCH_CODECS");
+
+  data = malloc(DATA_SIZE);
+  if (data == NULL) {
+    fprintf(stderr, "Failed to allocate the buffers\n");
+    return 1;
+  }
+  srand(135);
+  for (i = 0; i < 3 && ret == 0; i++) {
+    corpora[i].fill(data, DATA_SIZE);
+    ret = benchCorpus(corpora[i].name, data, DATA_SIZE, seconds, selected);
+  }
+  free(data);
+
+  for (i = 1; i < argc && ret == 0; i++) {
+    data = readFile(argv[i], &len);
+    if (data == NULL) {
+      fprintf(stderr, "Failed to read %s\n", argv[i]);
+      return 1;
+    }
+    str = strrchr(argv[i], '/');
+    ret = benchCorpus(str ? str + 1 : argv[i], data, len, seconds, selected);
+    free(data);
+  }
+  return ret;
+}
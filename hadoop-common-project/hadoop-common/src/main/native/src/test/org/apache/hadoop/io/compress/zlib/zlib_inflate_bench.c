@@ -0,0 +1,231 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Compares the inflate throughput of zlib and igzip, in MB/s of
+ * decompressed output, on the same gzip, zlib and raw deflate data.  Input
+ * is fed in 64 KB pieces into a 64 KB output buffer, the way
+ * ZlibDecompressor drives them.
+ *
+ * ZLIB_BENCH_MILLIS   how long to run each case, 500 milliseconds by default
+ */
+
+#include <igzip_lib.h>
+#include <zlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DATA_SIZE (16 * 1024 * 1024)
+#define BUFFER_SIZE (64 * 1024)
+
+static const struct {
+  const char* name;
+  int windowBits;
+  int crcFlag;
+} formats[] = {
+  { "gzip", 31, ISAL_GZIP },
+  { "zlib", 15, ISAL_ZLIB },
+  { "raw", -15, ISAL_DEFLATE },
+};
+
+static const int levels[] = { 1, 6, 9 };
+
+#define NUM_FORMATS (int)(sizeof(formats) / sizeof(formats[0]))
+#define NUM_LEVELS (int)(sizeof(levels) / sizeof(levels[0]))
+
+static double nowSeconds(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+/**
+ * Text-like data: words of a small vocabulary, in random order.
+ */
+static void fillData(unsigned char* data, int len) {
+  static const char* words[] = {
+    "hadoop ", "block ", "replica ", "datanode ", "namenode ", "stream ",
+    "checksum ", "codec ", "\n", "0123 ", "4567 ", "89ab ", "cdef "
+  };
+  int i = 0;
+  const char* w;
+
+  while (i < len) {
+    for (w = words[rand() % 13]; *w && i < len; w++) {
+      data[i++] = *w;
+    }
+  }
+}
+
+static int compressData(const unsigned char* data, int len, unsigned char* out,
+                        int outLen, int level, int windowBits) {
+  z_stream stream;
+  int ret;
+
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return -1;
+  }
+  stream.next_in = (unsigned char*)data;
+  stream.avail_in = len;
+  stream.next_out = out;
+  stream.avail_out = outLen;
+  ret = deflate(&stream, Z_FINISH);
+  len = stream.total_out;
+  deflateEnd(&stream);
+  return ret == Z_STREAM_END ? len : -1;
+}
+
+static long long inflateZlib(const unsigned char* in, int inLen,
+                             unsigned char* out, int windowBits) {
+  z_stream stream;
+  long long total = 0;
+  int ret = Z_OK, off = 0, len;
+
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, windowBits) != Z_OK) {
+    return -1;
+  }
+  while (ret != Z_STREAM_END) {
+    if (stream.avail_in == 0) {
+      len = inLen - off < BUFFER_SIZE ? inLen - off : BUFFER_SIZE;
+      stream.next_in = (unsigned char*)in + off;
+      stream.avail_in = len;
+      off += len;
+    }
+    stream.next_out = out;
+    stream.avail_out = BUFFER_SIZE;
+    ret = inflate(&stream, Z_PARTIAL_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      total = -1;
+      break;
+    }
+    total += BUFFER_SIZE - stream.avail_out;
+  }
+  inflateEnd(&stream);
+  return total;
+}
+
+static long long inflateIgzip(struct inflate_state* state,
+                              const unsigned char* in, int inLen,
+                              unsigned char* out, int crcFlag) {
+  long long total = 0;
+  int ret, off = 0, len;
+
+  isal_inflate_init(state);
+  state->crc_flag = crcFlag;
+  while (state->block_state != ISAL_BLOCK_FINISH) {
+    if (state->avail_in == 0) {
+      if (off == inLen) {
+        return -1;
+      }
+      len = inLen - off < BUFFER_SIZE ? inLen - off : BUFFER_SIZE;
+      state->next_in = (unsigned char*)in + off;
+      state->avail_in = len;
+      off += len;
+    }
+    state->next_out = out;
+    state->avail_out = BUFFER_SIZE;
+    ret = isal_inflate(state);
+    if (ret != ISAL_DECOMP_OK && ret != ISAL_END_INPUT &&
+        ret != ISAL_OUT_OVERFLOW) {
+      return -1;
+    }
+    total += BUFFER_SIZE - state->avail_out;
+  }
+  return total;
+}
+
+static void report(const char* lib, const char* format, int level,
+                   long long calls, double elapsed) {
+  printf("%-5s %-4s level %d: %8.1f MB/s\n", lib, format, level,
+         (double)calls * DATA_SIZE / elapsed / (1024 * 1024));
+}
+
+int main(int argc, char *argv[]) {
+  struct inflate_state* state;
+  unsigned char *data, *compressed, *out;
+  const char* str;
+  double seconds, start, elapsed;
+  long long calls;
+  int i, j, len, outLen = DATA_SIZE + DATA_SIZE / 10 + 1024;
+
+  str = getenv("ZLIB_BENCH_MILLIS");
+  seconds = (str ? atoi(str) : 500) / 1000.0;
+  if (seconds <= 0) {
+    fprintf(stderr, "ZLIB_BENCH_MILLIS must be greater than 0.\n");
+    return 1;
+  }
+
+  data = malloc(DATA_SIZE);
+  compressed = malloc(outLen);
+  out = malloc(BUFFER_SIZE);
+  state = malloc(sizeof(struct inflate_state));
+  if (data == NULL || compressed == NULL || out == NULL || state == NULL) {
+    fprintf(stderr, "Failed to allocate the buffers\n");
+    return 1;
+  }
+  srand(135);
+  fillData(data, DATA_SIZE);
+
+  for (i = 0; i < NUM_FORMATS; i++) {
+    for (j = 0; j < NUM_LEVELS; j++) {
+      len = compressData(data, DATA_SIZE, compressed, outLen, levels[j],
+                     formats[i].windowBits);
+      if (len < 0) {
+        fprintf(stderr, "Compressing %s failed\n", formats[i].name);
+        return 1;
+      }
+      if (inflateZlib(compressed, len, out, formats[i].windowBits) !=
+              DATA_SIZE ||
+          inflateIgzip(state, compressed, len, out, formats[i].crcFlag) !=
+              DATA_SIZE) {
+        fprintf(stderr, "Inflating %s failed\n", formats[i].name);
+        return 1;
+      }
+
+      calls = 0;
+      start = nowSeconds();
+      do {
+        inflateZlib(compressed, len, out, formats[i].windowBits);
+        calls++;
+        elapsed = nowSeconds() - start;
+      } while (elapsed < seconds);
+      report("zlib", formats[i].name, levels[j], calls, elapsed);
+
+      calls = 0;
+      start = nowSeconds();
+      do {
+        inflateIgzip(state, compressed, len, out, formats[i].crcFlag);
+        calls++;
+        elapsed = nowSeconds() - start;
+      } while (elapsed < seconds);
+      report("igzip", formats[i].name, levels[j], calls, elapsed);
+    }
+  }
+  free(data);
+  free(compressed);
+  free(out);
+  free(state);
+  return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures the throughput of the native encoder and decoder for the common
+ * schemas and cell sizes, in GB/s of the data units read.
+ *
+ * EC_BENCH_MILLIS   how long to run each case, 500 milliseconds by default
+ * EC_BENCH_BUILTIN  set to 1 to use the built-in coder even when ISA-L can
+ *                   be loaded, to compare the two
+ */
+
+#include "isal_load.h"
+#include "gf_builtin.h"
+#include "erasure_code.h"
+#include "gf_util.h"
+#include "erasure_coder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const int schemas[][2] = { {3, 2}, {6, 3}, {10, 4} };
+
+static const int cellSizes[] = {
+  64 * 1024, 128 * 1024, 256 * 1024, 512 * 1024, 1024 * 1024
+};
+
+#define NUM_SCHEMAS (int)(sizeof(schemas) / sizeof(schemas[0]))
+#define NUM_CELL_SIZES (int)(sizeof(cellSizes) / sizeof(cellSizes[0]))
+
+static double nowSeconds(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static void report(const char* op, int numDataUnits, int numParityUnits,
+                   int numErased, int cellSize, long long calls,
+                   double elapsed) {
+  double bytes = (double)calls * numDataUnits * cellSize;
+
+  printf("%-6s RS-%d-%d erased %d cell %4d KB: %8.3f GB/s\n", op,
+         numDataUnits, numParityUnits, numErased, cellSize / 1024,
+         bytes / elapsed / (1024 * 1024 * 1024));
+}
+
+static int benchSchema(int numDataUnits, int numParityUnits, int cellSize,
+                       double seconds) {
+  int numAllUnits = numDataUnits + numParityUnits;
+  unsigned char* units[MMAX];
+  unsigned char* allUnits[MMAX];
+  unsigned char* outputs[MMAX];
+  int erasedIndexes[MMAX];
+  IsalEncoder encoder;
+  IsalDecoder decoder;
+  long long calls;
+  double start, elapsed;
+  int i, j, numErased, ret = -1;
+
+  memset(units, 0, sizeof(units));
+  memset(outputs, 0, sizeof(outputs));
+  memset(&encoder, 0, sizeof(encoder));
+  memset(&decoder, 0, sizeof(decoder));
+  for (i = 0; i < numAllUnits; i++) {
+    units[i] = malloc(cellSize);
+    outputs[i] = malloc(cellSize);
+    if (units[i] == NULL || outputs[i] == NULL) {
+      fprintf(stderr, "Failed to allocate the cells\n");
+      goto done;
+    }
+    for (j = 0; j < cellSize; j++) {
+      units[i][j] = rand();
+    }
+  }
+  if (initEncoder(&encoder, numDataUnits, numParityUnits) ||
+      initDecoder(&decoder, numDataUnits, numParityUnits)) {
+    fprintf(stderr, "Failed to initialize the coders\n");
+    goto done;
+  }
+
+  calls = 0;
+  start = nowSeconds();
+  do {
+    encode(&encoder, units, units + numDataUnits, cellSize);
+    calls++;
+    elapsed = nowSeconds() - start;
+  } while (elapsed < seconds);
+  report("encode", numDataUnits, numParityUnits, 0, cellSize, calls, elapsed);
+
+  // Erase data units, which is the most work to recover
+  for (numErased = 1; numErased <= numParityUnits; numErased++) {
+    for (i = 0; i < numAllUnits; i++) {
+      allUnits[i] = i < numErased ? NULL : units[i];
+    }
+    for (i = 0; i < numErased; i++) {
+      erasedIndexes[i] = i;
+    }
+
+    decode(&decoder, allUnits, erasedIndexes, numErased, outputs, cellSize);
+    for (i = 0; i < numErased; i++) {
+      if (memcmp(outputs[i], units[i], cellSize) != 0) {
+        fprintf(stderr, "Decoding RS-%d-%d with %d erased failed\n",
+                numDataUnits, numParityUnits, numErased);
+        goto done;
+      }
+    }
+
+    calls = 0;
+    start = nowSeconds();
+    do {
+      decode(&decoder, allUnits, erasedIndexes, numErased, outputs,
+             cellSize);
+      calls++;
+      elapsed = nowSeconds() - start;
+    } while (elapsed < seconds);
+    report("decode", numDataUnits, numParityUnits, numErased, cellSize,
+           calls, elapsed);
+  }
+  ret = 0;
+
+done:
+  destroyEncoder(&encoder);
+  destroyDecoder(&decoder);
+  for (i = 0; i < numAllUnits; i++) {
+    free(units[i]);
+    free(outputs[i]);
+  }
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  char err[256];
+  const char* str;
+  double seconds;
+  int i, j;
+
+  if (0 == build_support_erasurecode()) {
+    printf("The native library isn't available, skipping this benchmark\n");
+    return 0;
+  }
+
+  str = getenv("EC_BENCH_MILLIS");
+  seconds = (str ? atoi(str) : 500) / 1000.0;
+  if (seconds <= 0) {
+    fprintf(stderr, "EC_BENCH_MILLIS must be greater than 0.\n");
+    return 1;
+  }
+
+  str = getenv("EC_BENCH_BUILTIN");
+  if (str && atoi(str)) {
+    isaLoader = calloc(1, sizeof(IsaLibLoader));
+    if (isaLoader == NULL) {
+      fprintf(stderr, "Failed to allocate the loader\n");
+      return 1;
+    }
+    load_builtin_functions(isaLoader);
+  } else {
+    load_erasurecode_lib(err, sizeof(err));
+    if (strlen(err) > 0) {
+      fprintf(stderr, "Loading erasurecode library failed: %s\n", err);
+      return 1;
+    }
+  }
+  printf("Using %s\n", get_library_name());
+
+  srand(135);
+  for (i = 0; i < NUM_SCHEMAS; i++) {
+    for (j = 0; j < NUM_CELL_SIZES; j++) {
+      if (benchSchema(schemas[i][0], schemas[i][1], cellSizes[j], seconds)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
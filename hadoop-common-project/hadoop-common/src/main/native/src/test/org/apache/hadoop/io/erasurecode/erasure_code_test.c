@@ -84,12 +84,18 @@ int main(int argc, char *argv[]) {
 
   pEncoder = (IsalEncoder*)malloc(sizeof(IsalEncoder));
   memset(pEncoder, 0, sizeof(*pEncoder));
-  initEncoder(pEncoder, numDataUnits, numParityUnits);
+  if (initEncoder(pEncoder, numDataUnits, numParityUnits)) {
+    fprintf(stderr, "Initializing the encoder failed\n");
+    return -1;
+  }
   encode(pEncoder, dataUnits, parityUnits, chunkSize);
 
   pDecoder = (IsalDecoder*)malloc(sizeof(IsalDecoder));
   memset(pDecoder, 0, sizeof(*pDecoder));
-  initDecoder(pDecoder, numDataUnits, numParityUnits);
+  if (initDecoder(pDecoder, numDataUnits, numParityUnits)) {
+    fprintf(stderr, "Initializing the decoder failed\n");
+    return -1;
+  }
 
   memcpy(allUnits, dataUnits, numDataUnits * (sizeof (unsigned char*)));
   memcpy(allUnits + numDataUnits, parityUnits,
@@ -119,6 +125,8 @@ int main(int argc, char *argv[]) {
   }
 
   dumpDecoder(pDecoder);
+  destroyEncoder(pEncoder);
+  destroyDecoder(pDecoder);
   fprintf(stdout, "Successfully done, passed!\n\n");
 
   return 0;
@@ -0,0 +1,328 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures how long it takes to open short-circuit replicas: a DataNode
+ * thread listens on a domain socket, and for every replica the client
+ * connects, asks for it, and the DataNode allocates a shared memory slot
+ * segment and passes it over with the block and meta files, which the
+ * client receives.  The steps are timed with the same counters and
+ * histograms libhadoop keeps for DomainSocket and
+ * SharedFileDescriptorFactory, and the same system calls, without a JVM,
+ * so that the kernel and file system side of the latency can be compared
+ * across hosts.
+ *
+ * SHORT_CIRCUIT_BENCH_OPENS   how many replicas to open, 10000 by default
+ * SHORT_CIRCUIT_BENCH_DIR     where to put the socket, the replica and the
+ *                             shared memory files, /tmp by default; use
+ *                             /dev/shm to match a DataNode's default
+ */
+
+#include "config.h"
+#include "org/apache/hadoop/net/unix/short_circuit_stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The size of a DataNode's shared memory segment of slots
+#define SHM_SIZE 8192
+
+struct benchContext {
+  char dir[PATH_MAX];
+  struct sockaddr_un addr;
+  int listenFd;
+  int blockFd;
+  int metaFd;
+  int opens;
+};
+
+struct fdMessage {
+  struct cmsghdr hdr;
+  int fds[3];
+} __attribute__((packed,aligned(8)));
+
+static int makeFile(const char *dir, const char *name, int len) {
+  char path[PATH_MAX];
+  char buf[4096];
+  int fd, n;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path);
+  memset(buf, 'x', sizeof(buf));
+  for (; len > 0; len -= n) {
+    n = len < (int)sizeof(buf) ? len : (int)sizeof(buf);
+    if (write(fd, buf, n) != n) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+/**
+ * A segment the way SharedFileDescriptorFactory makes it: a memfd if
+ * the kernel has them, else an unlinked file written full of zeroes.
+ */
+static int allocateShm(const char *dir) {
+  static const char zeroes[SHM_SIZE];
+  char path[PATH_MAX];
+  int fd;
+
+#ifdef HAVE_MEMFD_CREATE
+  fd = memfd_create("HadoopShortCircuitShm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd >= 0) {
+    if (ftruncate(fd, SHM_SIZE) < 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+#endif
+  snprintf(path, sizeof(path), "%s/HadoopShortCircuitShm_%d", dir, rand());
+  fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0700);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path);
+  if (write(fd, zeroes, SHM_SIZE) != SHM_SIZE ||
+      lseek(fd, 0, SEEK_SET) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int sendFds(int sock, int *fds, int numFds) {
+  struct fdMessage aux;
+  struct msghdr msg;
+  struct iovec vec;
+  char status = 0;
+  int ret;
+
+  memset(&aux, 0, sizeof(aux));
+  memset(&msg, 0, sizeof(msg));
+  vec.iov_base = &status;
+  vec.iov_len = 1;
+  msg.msg_iov = &vec;
+  msg.msg_iovlen = 1;
+  msg.msg_control = &aux;
+  msg.msg_controllen = CMSG_LEN(numFds * sizeof(int));
+  aux.hdr.cmsg_len = msg.msg_controllen;
+  aux.hdr.cmsg_level = SOL_SOCKET;
+  aux.hdr.cmsg_type = SCM_RIGHTS;
+  memcpy(aux.fds, fds, numFds * sizeof(int));
+  do {
+    ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (ret < 0 && errno == EINTR);
+  return ret == 1 ? 0 : -1;
+}
+
+static int receiveFds(int sock, int *fds, int numFds) {
+  struct fdMessage aux;
+  struct msghdr msg;
+  struct iovec vec;
+  char status;
+  int ret;
+
+  memset(&aux, 0, sizeof(aux));
+  memset(&msg, 0, sizeof(msg));
+  vec.iov_base = &status;
+  vec.iov_len = 1;
+  msg.msg_iov = &vec;
+  msg.msg_iovlen = 1;
+  msg.msg_control = &aux;
+  msg.msg_controllen = CMSG_LEN(numFds * sizeof(int));
+  do {
+    ret = recvmsg(sock, &msg, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret != 1 || aux.hdr.cmsg_len != CMSG_LEN(numFds * sizeof(int))) {
+    return -1;
+  }
+  memcpy(fds, aux.fds, numFds * sizeof(int));
+  return 0;
+}
+
+static void *dataNode(void *arg) {
+  struct benchContext *ctx = arg;
+  int64_t start;
+  int i, sock, fds[3];
+  char request;
+
+  for (i = 0; i < ctx->opens; i++) {
+    do {
+      sock = accept(ctx->listenFd, NULL, NULL);
+    } while (sock < 0 && errno == EINTR);
+    if (sock < 0) {
+      return NULL;
+    }
+    if (read(sock, &request, 1) == 1) {
+      start = short_circuit_now();
+      fds[2] = allocateShm(ctx->dir);
+      if (fds[2] >= 0) {
+        short_circuit_record(SHORT_CIRCUIT_SHM_ALLOC, start);
+        fds[0] = ctx->blockFd;
+        fds[1] = ctx->metaFd;
+        start = short_circuit_now();
+        if (sendFds(sock, fds, 3) == 0) {
+          short_circuit_record(SHORT_CIRCUIT_SEND_FDS, start);
+        }
+        close(fds[2]);
+      }
+    }
+    close(sock);
+  }
+  return NULL;
+}
+
+static int openReplica(struct benchContext *ctx) {
+  int64_t start;
+  int i, sock, ret = -1, fds[3];
+  char request = 1;
+
+  start = short_circuit_now();
+  sock = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return -1;
+  }
+  if (connect(sock, (struct sockaddr *)&ctx->addr, sizeof(ctx->addr)) < 0) {
+    goto done;
+  }
+  short_circuit_record(SHORT_CIRCUIT_CONNECT, start);
+  if (write(sock, &request, 1) != 1) {
+    goto done;
+  }
+  start = short_circuit_now();
+  if (receiveFds(sock, fds, 3) < 0) {
+    goto done;
+  }
+  short_circuit_record(SHORT_CIRCUIT_RECEIVE_FDS, start);
+  for (i = 0; i < 3; i++) {
+    close(fds[i]);
+  }
+  ret = 0;
+
+done:
+  close(sock);
+  return ret;
+}
+
+static void printStats(const char *name, enum short_circuit_op op) {
+  struct short_circuit_stats stats;
+  int64_t seen = 0;
+  int i;
+
+  get_short_circuit_stats(op, &stats);
+  printf("%-12s count %8lld, mean %8.1f us, max %10.1f us\n", name,
+         (long long)stats.count,
+         stats.count ? stats.total_nanos / 1000.0 / stats.count : 0.0,
+         stats.max_nanos / 1000.0);
+  for (i = 0; i < SHORT_CIRCUIT_BUCKETS; i++) {
+    if (stats.buckets[i] == 0) {
+      continue;
+    }
+    seen += stats.buckets[i];
+    printf("  < %9lld us %8lld  %6.2f%%\n", 1LL << i,
+           (long long)stats.buckets[i], 100.0 * seen / stats.count);
+  }
+}
+
+int main(void) {
+  struct benchContext ctx;
+  pthread_t thread;
+  const char *str;
+  int i, ret = 0;
+
+  memset(&ctx, 0, sizeof(ctx));
+  str = getenv("SHORT_CIRCUIT_BENCH_OPENS");
+  ctx.opens = str ? atoi(str) : 10000;
+  if (ctx.opens <= 0) {
+    fprintf(stderr, "SHORT_CIRCUIT_BENCH_OPENS must be greater than 0.\n");
+    return 1;
+  }
+  str = getenv("SHORT_CIRCUIT_BENCH_DIR");
+  snprintf(ctx.dir, sizeof(ctx.dir), "%s", str ? str : "/tmp");
+
+  ctx.blockFd = makeFile(ctx.dir, "short_circuit_bench_blk", 1024 * 1024);
+  ctx.metaFd = makeFile(ctx.dir, "short_circuit_bench_blk.meta", 8199);
+  if (ctx.blockFd < 0 || ctx.metaFd < 0) {
+    fprintf(stderr, "Failed to create the replica in %s: %s\n", ctx.dir,
+            strerror(errno));
+    return 1;
+  }
+  ctx.addr.sun_family = AF_UNIX;
+  if (snprintf(ctx.addr.sun_path, sizeof(ctx.addr.sun_path),
+               "%.*s/short_circuit_bench.%d.sock",
+               (int)sizeof(ctx.addr.sun_path), ctx.dir, (int)getpid()) >=
+      (int)sizeof(ctx.addr.sun_path)) {
+    fprintf(stderr, "%s is too long a path for a socket\n", ctx.dir);
+    return 1;
+  }
+  unlink(ctx.addr.sun_path);
+  ctx.listenFd = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (ctx.listenFd < 0 ||
+      bind(ctx.listenFd, (struct sockaddr *)&ctx.addr, sizeof(ctx.addr)) < 0 ||
+      listen(ctx.listenFd, 128) < 0) {
+    fprintf(stderr, "Failed to listen on %s: %s\n", ctx.addr.sun_path,
+            strerror(errno));
+    return 1;
+  }
+  if (pthread_create(&thread, NULL, dataNode, &ctx)) {
+    fprintf(stderr, "Failed to start the DataNode thread\n");
+    return 1;
+  }
+  for (i = 0; i < ctx.opens; i++) {
+    if (openReplica(&ctx) < 0) {
+      fprintf(stderr, "Failed to open replica %d: %s\n", i, strerror(errno));
+      ret = 1;
+      break;
+    }
+  }
+  if (ret) {
+    // The DataNode thread may still wait for connections
+    shutdown(ctx.listenFd, SHUT_RDWR);
+  }
+  pthread_join(thread, NULL);
+  close(ctx.listenFd);
+  unlink(ctx.addr.sun_path);
+  close(ctx.blockFd);
+  close(ctx.metaFd);
+
+  printStats("connect", SHORT_CIRCUIT_CONNECT);
+  printStats("send fds", SHORT_CIRCUIT_SEND_FDS);
+  printStats("receive fds", SHORT_CIRCUIT_RECEIVE_FDS);
+  printStats("shm alloc", SHORT_CIRCUIT_SHM_ALLOC);
+  return ret;
+}
@@ -20,9 +20,11 @@
 
 #include "bulk_crc32.h"
 
+#include <arpa/inet.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #define EXPECT_ZERO(x) \
@@ -58,6 +60,233 @@ static int testBulkVerifyCrc(int dataLen, int crcType, int bytesPerChecksum)
   return 0;
 }
 
+/**
+ * Compare the hardware routines against the table driven ones, over lengths
+ * and offsets which exercise the tails of the interleaved and folded paths.
+ */
+static int testCrcUpdate(int crcType)
+{
+  static const size_t lengths[] = { 0, 1, 7, 15, 16, 63, 64, 65, 255, 256,
+      767, 768, 1000, 1023, 1024, 1040, 4097, 8192 * 3 - 1, 8192 * 3,
+      8192 * 3 + 768 + 13, 65536 + 1024 + 3 };
+  size_t maxLen = 65536 + 1024 + 3 + 16;
+  uint8_t *data;
+  uint32_t *sums;
+  size_t i, j, offset;
+  uint32_t got, expected;
+  crc32_error_t errorData;
+
+  data = malloc(maxLen);
+  for (i = 0; i < maxLen; i++) {
+    data[i] = (uint8_t)((i * 2654435761U) >> 13);
+  }
+  for (offset = 0; offset < 16; offset += 3) {
+    for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+      if (crcType == CRC32C_POLYNOMIAL) {
+        got = crc32c_update(0xffffffff, data + offset, lengths[i]);
+        expected = crc32c_sb8(0xffffffff, data + offset, lengths[i]);
+      } else {
+        got = crc32_zlib_update(0xffffffff, data + offset, lengths[i]);
+        expected = crc32_zlib_sb8(0xffffffff, data + offset, lengths[i]);
+      }
+      if (got != expected) {
+        fprintf(stderr, "TEST_ERROR: crc type %d of %d bytes at offset %d: "
+                "got %08x, expected %08x\n", crcType, (int)lengths[i],
+                (int)offset, got, expected);
+        return 1;
+      }
+    }
+  }
+
+  /* bulk_crc stores the checksums big endian */
+  sums = calloc(sizeof(uint32_t), maxLen / 512 + 1);
+  EXPECT_ZERO(bulk_crc(data, maxLen, sums, crcType, 512, NULL));
+  for (j = 0; j * 512 < maxLen; j++) {
+    size_t len = maxLen - j * 512 < 512 ? maxLen - j * 512 : 512;
+    expected = crcType == CRC32C_POLYNOMIAL ?
+        crc32c_sb8(0xffffffff, data + j * 512, len) :
+        crc32_zlib_sb8(0xffffffff, data + j * 512, len);
+    sums[j] = ntohl(~expected);
+  }
+  EXPECT_ZERO(bulk_crc(data, maxLen, sums, crcType, 512, &errorData));
+  free(data);
+  free(sums);
+  return 0;
+}
+
+/**
+ * Check bulk_crc_scattered against bulk_crc of each buffer, with buffer
+ * lengths that leave one or two whole chunks before each boundary, and that
+ * it points at the first corrupt chunk.
+ */
+static int testBulkCrcScattered(int crcType, int bytesPerChecksum)
+{
+  const int lengths[] = { 5, 1, 0, 2, 4, -1, 3, 0, 1, -2, 2 };
+  const int numBufs = sizeof(lengths) / sizeof(lengths[0]);
+  crc32_buffer_t bufs[sizeof(lengths) / sizeof(lengths[0])];
+  uint8_t *data;
+  uint32_t *sums, *expected;
+  crc32_error_t errorData;
+  int i, j, numSums = 0;
+
+  for (i = 0; i < numBufs; i++) {
+    /* a negative length is a partial last chunk */
+    size_t len = lengths[i] >= 0 ? lengths[i] * bytesPerChecksum :
+        -lengths[i] * bytesPerChecksum + 7;
+    data = malloc(len + 1);
+    for (j = 0; j < (int)len; j++) {
+      data[j] = (uint8_t)(((i * 131 + j) * 2654435761U) >> 13);
+    }
+    bufs[i].data = data;
+    bufs[i].len = len;
+    numSums += (len + bytesPerChecksum - 1) / bytesPerChecksum;
+  }
+  sums = calloc(sizeof(uint32_t), numSums);
+  expected = calloc(sizeof(uint32_t), numSums);
+  for (i = 0, j = 0; i < numBufs; i++) {
+    EXPECT_ZERO(bulk_crc(bufs[i].data, bufs[i].len, expected + j, crcType,
+                         bytesPerChecksum, NULL));
+    j += (bufs[i].len + bytesPerChecksum - 1) / bytesPerChecksum;
+  }
+  EXPECT_ZERO(bulk_crc_scattered(bufs, numBufs, sums, crcType,
+                                 bytesPerChecksum, NULL));
+  for (j = 0; j < numSums; j++) {
+    if (sums[j] != expected[j]) {
+      fprintf(stderr, "TEST_ERROR: crc type %d, scattered checksum %d: "
+              "got %08x, expected %08x\n", crcType, j, sums[j], expected[j]);
+      return 1;
+    }
+  }
+  EXPECT_ZERO(bulk_crc_scattered(bufs, numBufs, sums, crcType,
+                                 bytesPerChecksum, &errorData));
+
+  /* corrupt the second chunk of the fourth buffer, after a carried chunk */
+  ((uint8_t *)bufs[3].data)[bytesPerChecksum + 1] ^= 1;
+  if (bulk_crc_scattered(bufs, numBufs, sums, crcType, bytesPerChecksum,
+                         &errorData) != INVALID_CHECKSUM_DETECTED ||
+      errorData.bad_data != bufs[3].data + bytesPerChecksum) {
+    fprintf(stderr, "TEST_ERROR: crc type %d, scattered verification did "
+            "not find the corrupt chunk\n", crcType);
+    return 1;
+  }
+  for (i = 0; i < numBufs; i++) {
+    free((void *)bufs[i].data);
+  }
+  free(sums);
+  free(expected);
+  return 0;
+}
+
+/**
+ * Check that bulk_crc_copy copies the data and gets the checksums bulk_crc
+ * gets, over lengths which end in the middle of a stride and of a chunk.
+ */
+static int testBulkCrcCopy(int crcType, int bytesPerChecksum)
+{
+  const size_t dataLen = 40000 + 17;
+  int numSums = (dataLen + bytesPerChecksum - 1) / bytesPerChecksum;
+  uint8_t *src, *dst;
+  uint32_t *sums, *expected;
+  crc32_error_t errorData;
+  size_t i;
+
+  src = malloc(dataLen);
+  dst = malloc(dataLen);
+  for (i = 0; i < dataLen; i++) {
+    src[i] = (uint8_t)((i * 2654435761U) >> 13);
+  }
+  sums = calloc(sizeof(uint32_t), numSums);
+  expected = calloc(sizeof(uint32_t), numSums);
+  EXPECT_ZERO(bulk_crc(src, dataLen, expected, crcType, bytesPerChecksum,
+                       NULL));
+  EXPECT_ZERO(bulk_crc_copy(dst, src, dataLen, sums, crcType,
+                            bytesPerChecksum, NULL));
+  if (memcmp(dst, src, dataLen) ||
+      memcmp(sums, expected, numSums * sizeof(uint32_t))) {
+    fprintf(stderr, "TEST_ERROR: crc type %d, bulk_crc_copy at %d bytes "
+            "per checksum differs from bulk_crc\n", crcType,
+            bytesPerChecksum);
+    return 1;
+  }
+  memset(dst, 0, dataLen);
+  EXPECT_ZERO(bulk_crc_copy(dst, src, dataLen, sums, crcType,
+                            bytesPerChecksum, &errorData));
+
+  /* a bad checksum is reported against src, and all of it is copied */
+  src[dataLen / 2] ^= 1;
+  memset(dst, 0, dataLen);
+  if (bulk_crc_copy(dst, src, dataLen, sums, crcType, bytesPerChecksum,
+                    &errorData) != INVALID_CHECKSUM_DETECTED ||
+      errorData.bad_data != src + (dataLen / 2) / bytesPerChecksum *
+          bytesPerChecksum || memcmp(dst, src, dataLen)) {
+    fprintf(stderr, "TEST_ERROR: crc type %d, bulk_crc_copy did not report "
+            "the corrupt chunk\n", crcType);
+    return 1;
+  }
+  free(src);
+  free(dst);
+  free(sums);
+  free(expected);
+  return 0;
+}
+
+/**
+ * Check that combining the checksums of the two parts of a buffer, split at
+ * various points, gives the checksum of the whole buffer.
+ */
+static int testCrcCombine(int crcType)
+{
+  static const size_t splits[] = { 0, 1, 3, 8, 255, 512, 4097, 65536 };
+  size_t dataLen = 65536 + 1024 + 3;
+  uint8_t *data;
+  uint32_t whole, crc1, crc2, got;
+  size_t i;
+
+  data = malloc(dataLen);
+  for (i = 0; i < dataLen; i++) {
+    data[i] = (uint8_t)((i * 2654435761U) >> 13);
+  }
+  for (i = 0; i < sizeof(splits) / sizeof(splits[0]); i++) {
+    if (crcType == CRC32C_POLYNOMIAL) {
+      whole = ~crc32c_sb8(0xffffffff, data, dataLen);
+      crc1 = ~crc32c_sb8(0xffffffff, data, splits[i]);
+      crc2 = ~crc32c_sb8(0xffffffff, data + splits[i], dataLen - splits[i]);
+      got = crc32c_combine(crc1, crc2, dataLen - splits[i]);
+    } else {
+      whole = ~crc32_zlib_sb8(0xffffffff, data, dataLen);
+      crc1 = ~crc32_zlib_sb8(0xffffffff, data, splits[i]);
+      crc2 = ~crc32_zlib_sb8(0xffffffff, data + splits[i],
+                             dataLen - splits[i]);
+      got = crc32_zlib_combine(crc1, crc2, dataLen - splits[i]);
+    }
+    if (got != whole) {
+      fprintf(stderr, "TEST_ERROR: crc type %d split at %d: combined to "
+              "%08x, expected %08x\n", crcType, (int)splits[i], got, whole);
+      return 1;
+    }
+  }
+  free(data);
+
+  /* Past 2^31 bytes the table of powers wraps around; shifting by 2^41
+   * bytes at once must match shifting by 2^40 bytes twice. */
+  crc1 = 0x12345678;
+  if (crcType == CRC32C_POLYNOMIAL) {
+    got = crc32c_combine(crc32c_combine(crc1, 0, (uint64_t)1 << 40), 0,
+                         (uint64_t)1 << 40);
+    whole = crc32c_combine(crc1, 0, (uint64_t)1 << 41);
+  } else {
+    got = crc32_zlib_combine(crc32_zlib_combine(crc1, 0, (uint64_t)1 << 40),
+                             0, (uint64_t)1 << 40);
+    whole = crc32_zlib_combine(crc1, 0, (uint64_t)1 << 41);
+  }
+  if (got != whole) {
+    fprintf(stderr, "TEST_ERROR: crc type %d: shifting by 2^41 bytes "
+            "does not match shifting by 2^40 twice\n", crcType);
+    return 1;
+  }
+  return 0;
+}
+
 static int timeBulkCrc(int dataLen, int crcType, int bytesPerChecksum, int iterations)
 {
   int i;
@@ -104,6 +333,17 @@ int main(int argc, char **argv)
   EXPECT_ZERO(testBulkVerifyCrc(17, CRC32_ZLIB_POLYNOMIAL, 2));
   EXPECT_ZERO(testBulkVerifyCrc(17, CRC32C_POLYNOMIAL, 4));
   EXPECT_ZERO(testBulkVerifyCrc(17, CRC32_ZLIB_POLYNOMIAL, 4));
+  EXPECT_ZERO(testCrcUpdate(CRC32C_POLYNOMIAL));
+  EXPECT_ZERO(testCrcUpdate(CRC32_ZLIB_POLYNOMIAL));
+  EXPECT_ZERO(testCrcCombine(CRC32C_POLYNOMIAL));
+  EXPECT_ZERO(testCrcCombine(CRC32_ZLIB_POLYNOMIAL));
+  EXPECT_ZERO(testBulkCrcCopy(CRC32C_POLYNOMIAL, 512));
+  EXPECT_ZERO(testBulkCrcCopy(CRC32_ZLIB_POLYNOMIAL, 512));
+  EXPECT_ZERO(testBulkCrcCopy(CRC32C_POLYNOMIAL, 9000));
+  EXPECT_ZERO(testBulkCrcScattered(CRC32C_POLYNOMIAL, 512));
+  EXPECT_ZERO(testBulkCrcScattered(CRC32_ZLIB_POLYNOMIAL, 512));
+  EXPECT_ZERO(testBulkCrcScattered(CRC32C_POLYNOMIAL, 4096));
+  EXPECT_ZERO(testBulkCrcScattered(CRC32_ZLIB_POLYNOMIAL, 4096));
 
   EXPECT_ZERO(timeBulkCrc(16 * 1024, CRC32C_POLYNOMIAL, 512, 1000000));
   EXPECT_ZERO(timeBulkCrc(16 * 1024, CRC32_ZLIB_POLYNOMIAL, 512, 1000000));
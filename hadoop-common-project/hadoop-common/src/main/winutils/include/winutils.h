@@ -123,7 +123,7 @@ void SymlinkUsage();
 int Readlink(__in int argc, __in_ecount(argc) wchar_t *argv[]);
 void ReadlinkUsage();
 
-int SystemInfo();
+int SystemInfo(__in int argc, __in_ecount(argc) wchar_t *argv[]);
 void SystemInfoUsage();
 
 DWORD GetFileInformationByName(__in LPCWSTR pathName,  __in BOOL followLink,
@@ -80,7 +80,7 @@ int wmain(__in int argc, __in_ecount(argc) wchar_t* argv[])
   }
   else if (wcscmp(L"systeminfo", cmd) == 0)
   {
-    return SystemInfo();
+    return SystemInfo(argc - 1, argv + 1);
   }
   else if (wcscmp(L"service", cmd) == 0)
   {
@@ -20,6 +20,7 @@
 #include <PowrProf.h>
 #include <pdh.h>
 #include <pdhmsg.h>
+#include <winternl.h>
 
 #ifdef PSAPI_VERSION
 #undef PSAPI_VERSION
@@ -28,6 +29,7 @@
 #pragma comment(lib, "psapi.lib")
 #pragma comment(lib, "Powrprof.lib")
 #pragma comment(lib, "pdh.lib")
+#pragma comment(lib, "ntdll.lib")
 
 CONST PWSTR COUNTER_PATH_NET_READ_ALL   = L"\\Network Interface(*)\\Bytes Received/Sec";
 CONST PWSTR COUNTER_PATH_NET_WRITE_ALL  = L"\\Network Interface(*)\\Bytes Sent/Sec";
@@ -43,29 +45,58 @@ typedef struct _PROCESSOR_POWER_INFORMATION {
    ULONG  CurrentIdleState;
 } PROCESSOR_POWER_INFORMATION, *PPROCESSOR_POWER_INFORMATION;
 
+// The values printed by systeminfo, in the order they are printed
+typedef struct _SYSTEM_INFO_VALUES {
+  size_t vmemSize;
+  size_t memSize;
+  size_t vmemFree;
+  size_t memFree;
+  DWORD numberOfProcessors;
+  ULONGLONG cpuFrequencyKhz;
+  ULONGLONG cpuTimeMs;
+  LONGLONG diskRead;
+  LONGLONG diskWrite;
+  LONGLONG netRead;
+  LONGLONG netWrite;
+} SYSTEM_INFO_VALUES, *PSYSTEM_INFO_VALUES;
+
+// An open PDH query for the disk and network counters, so that streaming
+// mode can collect it again on every interval instead of rebuilding it
+typedef struct _DISK_NETWORK_QUERY {
+  PDH_HQUERY hQuery;
+  PDH_HCOUNTER hCounterNetRead;
+  PDH_HCOUNTER hCounterNetWrite;
+  PDH_HCOUNTER hCounterDiskRead;
+  PDH_HCOUNTER hCounterDiskWrite;
+} DISK_NETWORK_QUERY, *PDISK_NETWORK_QUERY;
+
+static int OpenDiskAndNetworkQuery(__out PDISK_NETWORK_QUERY query);
+static int CollectDiskAndNetwork(__in PDISK_NETWORK_QUERY query,
+  LONGLONG* diskRead, LONGLONG* diskWrite, LONGLONG* netRead, LONGLONG* netWrite);
+static void CloseDiskAndNetworkQuery(__in PDISK_NETWORK_QUERY query);
+PDH_STATUS ReadTotalCounter(PDH_HCOUNTER hCounter, LONGLONG* ret);
+
 //----------------------------------------------------------------------------
-// Function: SystemInfo
+// Function: GetSystemInfoValues
 //
 // Description:
-// Returns the resource information about the machine 
+// Reads the resource information about the machine, with the disk and
+// network counters collected from the given open query
 //
 // Returns:
 // EXIT_SUCCESS: On success
 // EXIT_FAILURE: otherwise
-int SystemInfo() 
+static int GetSystemInfoValues(__in PDISK_NETWORK_QUERY query,
+  __out PSYSTEM_INFO_VALUES values)
 {
-  size_t vmemSize, vmemFree, memSize, memFree;
   PERFORMANCE_INFORMATION memInfo;
   SYSTEM_INFO sysInfo;
   FILETIME idleTimeFt, kernelTimeFt, userTimeFt;
   ULARGE_INTEGER idleTime, kernelTime, userTime;
-  ULONGLONG cpuTimeMs;
   size_t size;
   LPBYTE pBuffer;
   PROCESSOR_POWER_INFORMATION const *ppi;
-  ULONGLONG cpuFrequencyKhz;
   NTSTATUS status;
-  LONGLONG diskRead, diskWrite, netRead, netWrite;
 
   ZeroMemory(&memInfo, sizeof(PERFORMANCE_INFORMATION));
   memInfo.cb = sizeof(PERFORMANCE_INFORMATION);
@@ -74,12 +105,13 @@ int SystemInfo()
     ReportErrorCode(L"GetPerformanceInfo", GetLastError());
     return EXIT_FAILURE;
   }
-  vmemSize = memInfo.CommitLimit*memInfo.PageSize;
-  vmemFree = vmemSize - memInfo.CommitTotal*memInfo.PageSize;
-  memSize = memInfo.PhysicalTotal*memInfo.PageSize;
-  memFree = memInfo.PhysicalAvailable*memInfo.PageSize;
+  values->vmemSize = memInfo.CommitLimit*memInfo.PageSize;
+  values->vmemFree = values->vmemSize - memInfo.CommitTotal*memInfo.PageSize;
+  values->memSize = memInfo.PhysicalTotal*memInfo.PageSize;
+  values->memFree = memInfo.PhysicalAvailable*memInfo.PageSize;
 
   GetSystemInfo(&sysInfo);
+  values->numberOfProcessors = sysInfo.dwNumberOfProcessors;
 
   if(!GetSystemTimes(&idleTimeFt, &kernelTimeFt, &userTimeFt))
   {
@@ -93,7 +125,7 @@ int SystemInfo()
   userTime.HighPart = userTimeFt.dwHighDateTime;
   userTime.LowPart = userTimeFt.dwLowDateTime;
 
-  cpuTimeMs = (kernelTime.QuadPart - idleTime.QuadPart + userTime.QuadPart)/10000;
+  values->cpuTimeMs = (kernelTime.QuadPart - idleTime.QuadPart + userTime.QuadPart)/10000;
 
   // allocate buffer to get info for each processor
   size = sysInfo.dwNumberOfProcessors * sizeof(PROCESSOR_POWER_INFORMATION);
@@ -111,19 +143,212 @@ int SystemInfo()
     return EXIT_FAILURE;
   }
   ppi = (PROCESSOR_POWER_INFORMATION const *)pBuffer;
-  cpuFrequencyKhz = ppi->MaxMhz*1000;
+  values->cpuFrequencyKhz = ppi->MaxMhz*1000;
   LocalFree(pBuffer);
 
-  status = GetDiskAndNetwork(&diskRead, &diskWrite, &netRead, &netWrite);
+  status = CollectDiskAndNetwork(query, &values->diskRead, &values->diskWrite,
+    &values->netRead, &values->netWrite);
   if(0 != status)
   {
-    fwprintf_s(stderr, L"Error in GetDiskAndNetwork. Err:%d\n", status);
+    fwprintf_s(stderr, L"Error in CollectDiskAndNetwork. Err:%d\n", status);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static void PrintSystemInfoValues(__in PSYSTEM_INFO_VALUES values)
+{
+  fwprintf_s(stdout, L"%Iu,%Iu,%Iu,%Iu,%u,%I64u,%I64u,%I64d,%I64d,%I64d,%I64d",
+    values->vmemSize, values->memSize, values->vmemFree, values->memFree,
+    values->numberOfProcessors, values->cpuFrequencyKhz, values->cpuTimeMs,
+    values->diskRead, values->diskWrite, values->netRead, values->netWrite);
+}
+
+//----------------------------------------------------------------------------
+// Function: GetProcessorBusyTimes
+//
+// Description:
+// Reads the cumulative kernel+user time of each of the numberOfProcessors
+// processors, in milliseconds
+//
+// Returns:
+// EXIT_SUCCESS: On success
+// EXIT_FAILURE: otherwise
+static int GetProcessorBusyTimes(DWORD numberOfProcessors,
+  __out_ecount(numberOfProcessors) ULONGLONG *busyTimeMs)
+{
+  SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION *ppi;
+  ULONG size = numberOfProcessors * sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION);
+  ULONG returned = 0;
+  NTSTATUS status;
+  DWORD i;
+
+  ppi = (SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION *) LocalAlloc(LPTR, size);
+  if(!ppi)
+  {
+    ReportErrorCode(L"LocalAlloc", GetLastError());
+    return EXIT_FAILURE;
+  }
+  status = NtQuerySystemInformation(SystemProcessorPerformanceInformation,
+    ppi, size, &returned);
+  if(!NT_SUCCESS(status) || returned < size)
+  {
+    fwprintf_s(stderr, L"Error in NtQuerySystemInformation. Err:0x%x\n", status);
+    LocalFree(ppi);
+    return EXIT_FAILURE;
+  }
+  // KernelTime includes the idle time
+  for (i = 0; i < numberOfProcessors; i++)
+  {
+    busyTimeMs[i] = (ppi[i].KernelTime.QuadPart - ppi[i].IdleTime.QuadPart +
+      ppi[i].UserTime.QuadPart)/10000;
+  }
+  LocalFree(ppi);
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Function: SystemInfoStream
+//
+// Description:
+// Prints the resource information about the machine every intervalMs
+// milliseconds until stdout is closed, keeping one disk and network query
+// open for the whole run. Each line carries the systeminfo values followed
+// by the length of the interval, the disk and network bytes moved in it and
+// the busy time of each processor in it
+//
+// Returns:
+// EXIT_SUCCESS: When the reader has closed stdout
+// EXIT_FAILURE: otherwise
+static int SystemInfoStream(DWORD intervalMs)
+{
+  int ret = EXIT_FAILURE;
+  DISK_NETWORK_QUERY query;
+  SYSTEM_INFO sysInfo;
+  SYSTEM_INFO_VALUES values, lastValues;
+  ULONGLONG *busyTimeMs = NULL, *lastBusyTimeMs = NULL, *tmp;
+  ULONGLONG tick, lastTick;
+  DWORD i;
+
+  if (OpenDiskAndNetworkQuery(&query) != EXIT_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  GetSystemInfo(&sysInfo);
+  busyTimeMs = (ULONGLONG *) LocalAlloc(LPTR,
+    sysInfo.dwNumberOfProcessors * sizeof(ULONGLONG));
+  lastBusyTimeMs = (ULONGLONG *) LocalAlloc(LPTR,
+    sysInfo.dwNumberOfProcessors * sizeof(ULONGLONG));
+  if (!busyTimeMs || !lastBusyTimeMs)
+  {
+    ReportErrorCode(L"LocalAlloc", GetLastError());
+    goto cleanup;
+  }
+
+  if (GetSystemInfoValues(&query, &lastValues) != EXIT_SUCCESS ||
+      GetProcessorBusyTimes(sysInfo.dwNumberOfProcessors, lastBusyTimeMs)
+        != EXIT_SUCCESS)
+  {
+    goto cleanup;
+  }
+  lastTick = GetTickCount64();
+
+  for (;;)
+  {
+    Sleep(intervalMs);
+
+    if (GetSystemInfoValues(&query, &values) != EXIT_SUCCESS ||
+        GetProcessorBusyTimes(sysInfo.dwNumberOfProcessors, busyTimeMs)
+          != EXIT_SUCCESS)
+    {
+      goto cleanup;
+    }
+    tick = GetTickCount64();
+
+    PrintSystemInfoValues(&values);
+    fwprintf_s(stdout, L",%I64u,%I64d,%I64d,%I64d,%I64d", tick - lastTick,
+      values.diskRead - lastValues.diskRead,
+      values.diskWrite - lastValues.diskWrite,
+      values.netRead - lastValues.netRead,
+      values.netWrite - lastValues.netWrite);
+    for (i = 0; i < sysInfo.dwNumberOfProcessors; i++)
+    {
+      fwprintf_s(stdout, L",%I64u", busyTimeMs[i] - lastBusyTimeMs[i]);
+    }
+    fwprintf_s(stdout, L"\n");
+
+    // The reader has gone away, which is how it stops us
+    if (fflush(stdout) != 0 || ferror(stdout))
+    {
+      ret = EXIT_SUCCESS;
+      goto cleanup;
+    }
+
+    lastValues = values;
+    lastTick = tick;
+    tmp = lastBusyTimeMs;
+    lastBusyTimeMs = busyTimeMs;
+    busyTimeMs = tmp;
+  }
+
+cleanup:
+  LocalFree(busyTimeMs);
+  LocalFree(lastBusyTimeMs);
+  CloseDiskAndNetworkQuery(&query);
+
+  return ret;
+}
+
+//----------------------------------------------------------------------------
+// Function: SystemInfo
+//
+// Description:
+// Returns the resource information about the machine 
+//
+// Returns:
+// EXIT_SUCCESS: On success
+// EXIT_FAILURE: otherwise
+int SystemInfo(__in int argc, __in_ecount(argc) wchar_t *argv[])
+{
+  DISK_NETWORK_QUERY query;
+  SYSTEM_INFO_VALUES values;
+  int ret;
+  wchar_t *end;
+  unsigned long intervalMs;
+
+  if (argc == 3 && wcscmp(argv[1], L"-s") == 0)
+  {
+    intervalMs = wcstoul(argv[2], &end, 10);
+    if (*argv[2] == L'\0' || *end != L'\0' || intervalMs == 0)
+    {
+      fwprintf(stderr, L"Invalid interval: %s\n", argv[2]);
+      SystemInfoUsage();
+      return EXIT_FAILURE;
+    }
+    return SystemInfoStream(intervalMs);
+  }
+  else if (argc != 1)
+  {
+    SystemInfoUsage();
+    return EXIT_FAILURE;
+  }
+
+  if (OpenDiskAndNetworkQuery(&query) != EXIT_SUCCESS)
+  {
     return EXIT_FAILURE;
   }
+  ret = GetSystemInfoValues(&query, &values);
+  CloseDiskAndNetworkQuery(&query);
+  if (ret != EXIT_SUCCESS)
+  {
+    return ret;
+  }
 
-  fwprintf_s(stdout, L"%Iu,%Iu,%Iu,%Iu,%u,%I64u,%I64u,%I64d,%I64d,%I64d,%I64d\n", vmemSize, memSize,
-    vmemFree, memFree, sysInfo.dwNumberOfProcessors, cpuFrequencyKhz, cpuTimeMs,
-    diskRead, diskWrite, netRead, netWrite);
+  PrintSystemInfoValues(&values);
+  fwprintf_s(stdout, L"\n");
 
   return EXIT_SUCCESS;
 }
@@ -131,7 +356,7 @@ int SystemInfo()
 void SystemInfoUsage()
 {
     fwprintf(stdout, L"\
-    Usage: systeminfo\n\
+    Usage: systeminfo [-s INTERVAL]\n\
     Prints machine information on stdout\n\
     Comma separated list of the following values.\n\
     VirtualMemorySize(bytes),PhysicalMemorySize(bytes),\n\
@@ -139,95 +364,127 @@ void SystemInfoUsage()
     NumberOfProcessors,CpuFrequency(Khz),\n\
     CpuTime(MilliSec,Kernel+User),\n\
     DiskRead(bytes),DiskWrite(bytes),\n\
-    NetworkRead(bytes),NetworkWrite(bytes)\n");
+    NetworkRead(bytes),NetworkWrite(bytes)\n\
+    With -s, keeps running and prints a line every INTERVAL milliseconds\n\
+    until stdout is closed, with the following values appended.\n\
+    Interval(MilliSec),\n\
+    DiskReadInInterval(bytes),DiskWriteInInterval(bytes),\n\
+    NetworkReadInInterval(bytes),NetworkWriteInInterval(bytes),\n\
+    CpuTimeInInterval(MilliSec,Kernel+User) of each processor\n");
 }
 
-int GetDiskAndNetwork(LONGLONG* diskRead, LONGLONG* diskWrite, LONGLONG* netRead, LONGLONG* netWrite)
+//----------------------------------------------------------------------------
+// Function: OpenDiskAndNetworkQuery
+//
+// Description:
+// Opens a PDH query with the disk and network counters added to it. The
+// query is closed again on failure.
+//
+// Returns:
+// EXIT_SUCCESS: On success
+// EXIT_FAILURE: otherwise
+static int OpenDiskAndNetworkQuery(__out PDISK_NETWORK_QUERY query)
 {
-  int ret = EXIT_SUCCESS;
   PDH_STATUS status = ERROR_SUCCESS;
-  PDH_HQUERY hQuery = NULL;
-  PDH_HCOUNTER hCounterNetRead = NULL;
-  PDH_HCOUNTER hCounterNetWrite = NULL;
-  PDH_HCOUNTER hCounterDiskRead = NULL;
-  PDH_HCOUNTER hCounterDiskWrite = NULL;
-  DWORD i;
 
-  if(status = PdhOpenQuery(NULL, 0, &hQuery))
+  ZeroMemory(query, sizeof(DISK_NETWORK_QUERY));
+
+  if(status = PdhOpenQuery(NULL, 0, &query->hQuery))
   {
     fwprintf_s(stderr, L"PdhOpenQuery failed with 0x%x.\n", status);
-    ret = EXIT_FAILURE;
-    goto cleanup;
+    query->hQuery = NULL;
+    return EXIT_FAILURE;
   }
 
   // Add each one of the counters with wild cards
-  if(status = PdhAddCounter(hQuery, COUNTER_PATH_NET_READ_ALL, 0, &hCounterNetRead))
+  if(status = PdhAddCounter(query->hQuery, COUNTER_PATH_NET_READ_ALL, 0, &query->hCounterNetRead))
   {
     fwprintf_s(stderr, L"PdhAddCounter %s failed with 0x%x.\n", COUNTER_PATH_NET_READ_ALL, status);
-    ret = EXIT_FAILURE;
-    goto cleanup;
+    goto failure;
   }
-  if(status = PdhAddCounter(hQuery, COUNTER_PATH_NET_WRITE_ALL, 0, &hCounterNetWrite))
+  if(status = PdhAddCounter(query->hQuery, COUNTER_PATH_NET_WRITE_ALL, 0, &query->hCounterNetWrite))
   {
     fwprintf_s(stderr, L"PdhAddCounter %s failed with 0x%x.\n", COUNTER_PATH_NET_WRITE_ALL, status);
-    ret = EXIT_FAILURE;
-    goto cleanup;
+    goto failure;
   }
-  if(status = PdhAddCounter(hQuery, COUNTER_PATH_DISK_READ_ALL, 0, &hCounterDiskRead))
+  if(status = PdhAddCounter(query->hQuery, COUNTER_PATH_DISK_READ_ALL, 0, &query->hCounterDiskRead))
   {
     fwprintf_s(stderr, L"PdhAddCounter %s failed with 0x%x.\n", COUNTER_PATH_DISK_READ_ALL, status);
-    ret = EXIT_FAILURE;
-    goto cleanup;
+    goto failure;
   }
-  if(status = PdhAddCounter(hQuery, COUNTER_PATH_DISK_WRITE_ALL, 0, &hCounterDiskWrite))
+  if(status = PdhAddCounter(query->hQuery, COUNTER_PATH_DISK_WRITE_ALL, 0, &query->hCounterDiskWrite))
   {
     fwprintf_s(stderr, L"PdhAddCounter %s failed with 0x%x.\n", COUNTER_PATH_DISK_WRITE_ALL, status);
-    ret = EXIT_FAILURE;
-    goto cleanup;
+    goto failure;
   }
 
-  if(status = PdhCollectQueryData(hQuery))
+  return EXIT_SUCCESS;
+
+failure:
+  CloseDiskAndNetworkQuery(query);
+  return EXIT_FAILURE;
+}
+
+static void CloseDiskAndNetworkQuery(__in PDISK_NETWORK_QUERY query)
+{
+  if (query->hQuery)
+  {
+    PdhCloseQuery(query->hQuery);
+    query->hQuery = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Function: CollectDiskAndNetwork
+//
+// Description:
+// Collects the open query and aggregates each of its counters over all the
+// disks and network interfaces
+//
+// Returns:
+// EXIT_SUCCESS: On success
+// EXIT_FAILURE: otherwise
+static int CollectDiskAndNetwork(__in PDISK_NETWORK_QUERY query,
+  LONGLONG* diskRead, LONGLONG* diskWrite, LONGLONG* netRead, LONGLONG* netWrite)
+{
+  int ret = EXIT_SUCCESS;
+  PDH_STATUS status = ERROR_SUCCESS;
+
+  if(status = PdhCollectQueryData(query->hQuery))
   {
     fwprintf_s(stderr, L"PdhCollectQueryData() failed with 0x%x.\n", status);
-    ret = EXIT_FAILURE;
-    goto cleanup;
+    return EXIT_FAILURE;
   }
 
   // Read and aggregate counters
-  status = ReadTotalCounter(hCounterNetRead, netRead);
+  status = ReadTotalCounter(query->hCounterNetRead, netRead);
   if(ERROR_SUCCESS != status)
   {
     fwprintf_s(stderr, L"ReadTotalCounter(Network Read): Error 0x%x.\n", status);
     ret = EXIT_FAILURE;
   }
 
-  status = ReadTotalCounter(hCounterNetWrite, netWrite);
+  status = ReadTotalCounter(query->hCounterNetWrite, netWrite);
   if(ERROR_SUCCESS != status)
   {
     fwprintf_s(stderr, L"ReadTotalCounter(Network Write): Error 0x%x.\n", status);
     ret = EXIT_FAILURE;
   }
 
-  status = ReadTotalCounter(hCounterDiskRead, diskRead);
+  status = ReadTotalCounter(query->hCounterDiskRead, diskRead);
   if(ERROR_SUCCESS != status)
   {
     fwprintf_s(stderr, L"ReadTotalCounter(Disk Read): Error 0x%x.\n", status);
     ret = EXIT_FAILURE;
   }
 
-  status = ReadTotalCounter(hCounterDiskWrite, diskWrite);
+  status = ReadTotalCounter(query->hCounterDiskWrite, diskWrite);
   if(ERROR_SUCCESS != status)
   {
     fwprintf_s(stderr, L"ReadTotalCounter(Disk Write): Error 0x%x.\n", status);
     ret = EXIT_FAILURE;
   }
 
-cleanup:
-  if (hQuery)
-  {
-    status = PdhCloseQuery(hQuery);
-  }
-
   return ret;
 }
 
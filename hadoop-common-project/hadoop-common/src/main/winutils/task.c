@@ -49,7 +49,8 @@ typedef enum TaskCommandOptionType
   TaskCreateAsUser,
   TaskIsAlive,
   TaskKill,
-  TaskProcessList
+  TaskProcessList,
+  TaskProcessListBatch
 } TaskCommandOption;
 
  //----------------------------------------------------------------------------
@@ -118,6 +119,14 @@ static BOOL ParseCommandLine(__in int argc,
     }
   }
 
+  if (argc >= 3) {
+    if (wcscmp(argv[1], L"processListBatch") == 0)
+    {
+      *command = TaskProcessListBatch;
+      return TRUE;
+    }
+  }
+
   if (argc >= 4 && argc <= 8) {
     if (wcscmp(argv[1], L"create") == 0)
     {
@@ -1079,15 +1088,16 @@ DWORD IsTaskAlive(const WCHAR* jobObjName, int* isAlive, int* procsInJob)
 }
 
 //----------------------------------------------------------------------------
-// Function: PrintTaskProcessList
+// Function: PrintJobProcessList
 //
 // Description:
-// Prints resource usage of all processes in the task jobobject
+// Prints resource usage of all processes in the task jobobject, each line
+// starting with the task name and a comma if withName is TRUE
 //
 // Returns:
 // ERROR_SUCCESS: On success
 // GetLastError: otherwise
-DWORD PrintTaskProcessList(const WCHAR* jobObjName)
+static DWORD PrintJobProcessList(const WCHAR* jobObjName, BOOL withName)
 {
   DWORD i;
   PJOBOBJECT_BASIC_PROCESS_ID_LIST procList;
@@ -1158,6 +1168,10 @@ DWORD PrintTaskProcessList(const WCHAR* jobObjName)
           userTime.HighPart = user.dwHighDateTime;
           userTime.LowPart = user.dwLowDateTime;
           cpuTimeMs = (kernelTime.QuadPart+userTime.QuadPart)/10000;
+          if (withName)
+          {
+            fwprintf_s(stdout, L"%s,", jobObjName);
+          }
           fwprintf_s(stdout, L"%Iu,%Iu,%Iu,%I64u\n", procList->ProcessIdList[i], pmc.PrivateUsage, pmc.WorkingSetSize, cpuTimeMs);
         }
       }
@@ -1171,6 +1185,49 @@ DWORD PrintTaskProcessList(const WCHAR* jobObjName)
   return ERROR_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+// Function: PrintTaskProcessList
+//
+// Description:
+// Prints resource usage of all processes in the task jobobject
+//
+// Returns:
+// ERROR_SUCCESS: On success
+// GetLastError: otherwise
+DWORD PrintTaskProcessList(const WCHAR* jobObjName)
+{
+  return PrintJobProcessList(jobObjName, FALSE);
+}
+
+//----------------------------------------------------------------------------
+// Function: PrintTaskProcessListBatch
+//
+// Description:
+// Prints resource usage of all processes in each of the task jobobjects,
+// as PrintTaskProcessList does with the task name in front, so that the
+// tasks of a node can be monitored with one process. A task that is not
+// alive prints nothing, and one that cannot be listed is reported to stderr
+// without failing the others.
+//
+// Returns:
+// ERROR_SUCCESS
+DWORD PrintTaskProcessListBatch(int count, WCHAR* jobObjNames[])
+{
+  int i;
+
+  for (i = 0; i < count; ++i)
+  {
+    DWORD err = PrintJobProcessList(jobObjNames[i], TRUE);
+    // A job object that is gone has no processes, which is not an error
+    if (err != ERROR_SUCCESS && err != ERROR_FILE_NOT_FOUND)
+    {
+      ReportErrorCode(L"PrintTaskProcessList", err);
+    }
+  }
+
+  return ERROR_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 // Function: Task
 //
@@ -1312,6 +1369,15 @@ int Task(__in int argc, __in_ecount(argc) wchar_t *argv[])
       ReportErrorCode(L"PrintTaskProcessList", dwErrorCode);
       goto TaskExit;
     }
+  } else if (command == TaskProcessListBatch)
+  {
+    // List the processes of all the given task jobobjects
+    //
+    dwErrorCode = PrintTaskProcessListBatch(argc - 2, argv + 2);
+    if (dwErrorCode != ERROR_SUCCESS)
+    {
+      goto TaskExit;
+    }
   } else
   {
     // Should not happen
@@ -1355,5 +1421,10 @@ Usage: task create [OPTOINS] [TASKNAME] [COMMAND_LINE]\n\
          along with their resource usage. One process per line\n\
          and comma separated info per process\n\
          ProcessId,VirtualMemoryCommitted(bytes),\n\
-         WorkingSetSize(bytes),CpuTime(Millisec,Kernel+User)\n");
+         WorkingSetSize(bytes),CpuTime(Millisec,Kernel+User)\n\
+\n\
+       task processListBatch [TASKNAME]...\n\
+         Prints to stdout the processes of each task as processList\n\
+         does, with TASKNAME and a comma in front of each line.\n\
+         Tasks that are not alive print nothing\n");
 }
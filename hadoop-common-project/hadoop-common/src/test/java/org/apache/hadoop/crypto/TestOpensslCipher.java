@@ -19,11 +19,15 @@
 
 import java.nio.ByteBuffer;
 import java.security.NoSuchAlgorithmException;
+import java.util.Random;
 
+import javax.crypto.AEADBadTagException;
 import javax.crypto.NoSuchPaddingException;
 import javax.crypto.ShortBufferException;
 
+import org.apache.hadoop.fs.ChecksumException;
 import org.apache.hadoop.test.GenericTestUtils;
+import org.apache.hadoop.util.DataChecksum;
 import org.junit.Assume;
 import org.junit.Assert;
 import org.junit.Test;
@@ -107,4 +111,228 @@ public void testDoFinalArguments() throws Exception {
           "Direct buffer is required", e);
     }
   }
+
+  @Test(timeout=120000)
+  public void testUpdateBatch() throws Exception {
+    Assume.assumeTrue(OpensslCipher.getLoadingFailureReason() == null);
+    OpensslCipher cipher = OpensslCipher.getInstance("AES/CTR/NoPadding");
+    Random random = new Random(1234);
+    byte[] key256 = new byte[32];
+    random.nextBytes(key256);
+    // Runs of the same key, and lengths that are not whole blocks
+    byte[][] keys = {key, key, key256, key256, key};
+    int[] lengths = {1, 4096, 17, 0, 1000};
+    byte[][] ivs = new byte[keys.length][];
+    ByteBuffer[] inputs = new ByteBuffer[keys.length];
+    ByteBuffer[] outputs = new ByteBuffer[keys.length];
+    for (int i = 0; i < keys.length; i++) {
+      ivs[i] = new byte[16];
+      random.nextBytes(ivs[i]);
+      byte[] data = new byte[lengths[i]];
+      random.nextBytes(data);
+      inputs[i] = ByteBuffer.allocateDirect(lengths[i] + 3);
+      inputs[i].position(3);
+      inputs[i].put(data);
+      inputs[i].position(3);
+      outputs[i] = ByteBuffer.allocateDirect(lengths[i] + 5);
+      outputs[i].position(5);
+    }
+
+    cipher.init(OpensslCipher.ENCRYPT_MODE, key, iv);
+    cipher.updateBatch(OpensslCipher.ENCRYPT_MODE, keys, ivs, inputs,
+        outputs);
+
+    for (int i = 0; i < keys.length; i++) {
+      Assert.assertEquals(inputs[i].limit(), inputs[i].position());
+      Assert.assertEquals(5 + lengths[i], outputs[i].position());
+      // Each buffer matches encrypting it on its own
+      OpensslCipher single = OpensslCipher.getInstance("AES/CTR/NoPadding");
+      single.init(OpensslCipher.ENCRYPT_MODE, keys[i], ivs[i]);
+      inputs[i].position(3);
+      ByteBuffer expected = ByteBuffer.allocateDirect(lengths[i]);
+      single.update(inputs[i], expected);
+      expected.flip();
+      outputs[i].position(5);
+      Assert.assertEquals(expected, outputs[i]);
+      single.clean();
+    }
+
+    // A short output buffer fails the batch
+    outputs[2] = ByteBuffer.allocateDirect(lengths[2] - 1);
+    for (ByteBuffer input : inputs) {
+      input.position(3);
+    }
+    try {
+      cipher.updateBatch(OpensslCipher.DECRYPT_MODE, keys, ivs, inputs,
+          outputs);
+      Assert.fail("Output buffer length should be sufficient " +
+          "to store output data");
+    } catch (ShortBufferException e) {
+      GenericTestUtils.assertExceptionContains(
+          "Output buffer is not sufficient", e);
+    }
+    cipher.clean();
+  }
+
+  @Test(timeout=120000)
+  public void testSetIV() throws Exception {
+    Assume.assumeTrue(OpensslCipher.getLoadingFailureReason() == null);
+    OpensslCipher cipher = OpensslCipher.getInstance("AES/CTR/NoPadding");
+    try {
+      cipher.setIV(iv, 0);
+      Assert.fail("setIV should fail before init");
+    } catch (IllegalStateException e) {
+      GenericTestUtils.assertExceptionContains("not been initialized", e);
+    }
+
+    Random random = new Random(4321);
+    byte[] data = new byte[100];
+    random.nextBytes(data);
+    ByteBuffer input = ByteBuffer.allocateDirect(data.length);
+    input.put(data);
+    input.flip();
+    ByteBuffer expected = ByteBuffer.allocateDirect(data.length);
+    cipher.init(OpensslCipher.ENCRYPT_MODE, key, iv);
+    cipher.update(input, expected);
+    expected.flip();
+
+    // Moving the counter and skipping into its block matches the stream
+    // encrypted from the start, at every offset
+    byte[] nextIV = iv.clone();
+    for (int pos = 0; pos < data.length; pos++) {
+      if (pos > 0 && pos % 16 == 0) {
+        nextIV[nextIV.length - 1]++;
+      }
+      cipher.setIV(nextIV, pos % 16);
+      input.position(pos);
+      ByteBuffer output = ByteBuffer.allocateDirect(data.length - pos);
+      cipher.update(input, output);
+      output.flip();
+      expected.position(pos);
+      Assert.assertEquals(expected, output);
+    }
+
+    try {
+      cipher.setIV(iv, 16);
+      Assert.fail("setIV should reject a skip of a whole block");
+    } catch (IllegalArgumentException e) {
+      GenericTestUtils.assertExceptionContains("Invalid skip", e);
+    }
+    cipher.clean();
+  }
+
+  @Test(timeout=120000)
+  public void testUpdateVerified() throws Exception {
+    Assume.assumeTrue(OpensslCipher.getLoadingFailureReason() == null);
+    OpensslCipher cipher = OpensslCipher.getInstance("AES/CTR/NoPadding");
+    DataChecksum checksum = DataChecksum.newDataChecksum(
+        DataChecksum.Type.CRC32C, 512);
+    Random random = new Random(1234);
+    // Several strides, and a short last chunk
+    int length = 100000;
+    byte[] data = new byte[length];
+    random.nextBytes(data);
+    ByteBuffer plain = ByteBuffer.allocateDirect(length);
+    plain.put(data);
+    plain.flip();
+    ByteBuffer encrypted = ByteBuffer.allocateDirect(length);
+    cipher.init(OpensslCipher.ENCRYPT_MODE, key, iv);
+    cipher.update(plain, encrypted);
+    encrypted.flip();
+    ByteBuffer sums = ByteBuffer.allocateDirect(
+        (length - 1) / 512 * 4 + 4);
+    checksum.calculateChunkedSums(encrypted, sums);
+
+    ByteBuffer output = ByteBuffer.allocateDirect(length);
+    cipher.init(OpensslCipher.DECRYPT_MODE, key, iv);
+    Assert.assertEquals(length, cipher.updateVerified(encrypted, output,
+        checksum, sums, "file", 0));
+    Assert.assertEquals(length, encrypted.position());
+    Assert.assertEquals(length, output.position());
+    output.flip();
+    plain.rewind();
+    Assert.assertEquals(plain, output);
+
+    // A corrupt chunk is reported at its file position
+    encrypted.put(50000, (byte) (encrypted.get(50000) ^ 1));
+    encrypted.rewind();
+    output.clear();
+    cipher.init(OpensslCipher.DECRYPT_MODE, key, iv);
+    try {
+      cipher.updateVerified(encrypted, output, checksum, sums, "file", 4096);
+      Assert.fail("Corrupt data should fail verification");
+    } catch (ChecksumException e) {
+      Assert.assertEquals(4096 + 50000 / 512 * 512, e.getPos());
+    }
+    cipher.clean();
+  }
+
+  @Test(timeout=120000)
+  public void testAesGcm() throws Exception {
+    Assume.assumeTrue(OpensslCipher.getLoadingFailureReason() == null);
+    OpensslCipher cipher = OpensslCipher.getInstance("AES/GCM/NoPadding");
+    Assert.assertTrue(cipher != null);
+    byte[] gcmIv = new byte[12];
+    byte[] aad = new byte[20];
+    Random random = new Random(1234);
+    random.nextBytes(gcmIv);
+    random.nextBytes(aad);
+    byte[] data = new byte[1000];
+    random.nextBytes(data);
+
+    ByteBuffer input = ByteBuffer.allocateDirect(data.length);
+    input.put(data);
+    input.flip();
+    ByteBuffer encrypted = ByteBuffer.allocateDirect(
+        data.length + OpensslCipher.GCM_TAG_LENGTH);
+    cipher.init(OpensslCipher.ENCRYPT_MODE, key, gcmIv);
+    cipher.updateAAD(aad);
+    Assert.assertEquals(data.length, cipher.update(input, encrypted));
+    Assert.assertEquals(OpensslCipher.GCM_TAG_LENGTH,
+        cipher.doFinal(encrypted));
+    encrypted.flip();
+
+    // Decrypted in pieces, some shorter than the tag
+    Assert.assertArrayEquals(data, decryptGcm(cipher, gcmIv, aad, encrypted,
+        new int[] {5, 300, 10, 700, 1}));
+    // The tag in pieces of its own
+    Assert.assertArrayEquals(data, decryptGcm(cipher, gcmIv, aad, encrypted,
+        new int[] {1000, 8, 8}));
+
+    // A changed tag or changed AAD fails authentication
+    encrypted.put(data.length + 3, (byte) (encrypted.get(data.length + 3) ^ 1));
+    try {
+      decryptGcm(cipher, gcmIv, aad, encrypted, new int[] {1016});
+      Assert.fail("A changed tag should not authenticate");
+    } catch (AEADBadTagException e) {
+    }
+    encrypted.put(data.length + 3, (byte) (encrypted.get(data.length + 3) ^ 1));
+    aad[0] ^= 1;
+    try {
+      decryptGcm(cipher, gcmIv, aad, encrypted, new int[] {1016});
+      Assert.fail("Changed AAD should not authenticate");
+    } catch (AEADBadTagException e) {
+    }
+    cipher.clean();
+  }
+
+  private static byte[] decryptGcm(OpensslCipher cipher, byte[] gcmIv,
+      byte[] aad, ByteBuffer encrypted, int[] pieces) throws Exception {
+    ByteBuffer output = ByteBuffer.allocateDirect(encrypted.remaining());
+    cipher.init(OpensslCipher.DECRYPT_MODE, key, gcmIv);
+    cipher.updateAAD(aad);
+    int offset = 0;
+    for (int piece : pieces) {
+      ByteBuffer input = encrypted.duplicate();
+      input.position(offset);
+      input.limit(offset + piece);
+      cipher.update(input, output);
+      offset += piece;
+    }
+    cipher.doFinal(output);
+    output.flip();
+    byte[] result = new byte[output.remaining()];
+    output.get(result);
+    return result;
+  }
 }
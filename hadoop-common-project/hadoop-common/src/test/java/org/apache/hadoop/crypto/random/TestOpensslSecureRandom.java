@@ -19,6 +19,9 @@
 
 import java.util.Arrays;
 
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeysPublic;
+import org.junit.Assert;
 import org.junit.Test;
 
 public class TestOpensslSecureRandom {
@@ -111,4 +114,37 @@ public void testRandomDouble() throws Exception {
       rand2 = random.nextDouble();
     }
   }
-}
\ No newline at end of file
+
+  @Test(timeout=120000)
+  public void testPerThread() throws Exception {
+    Configuration conf = new Configuration();
+    conf.setBoolean(CommonConfigurationKeysPublic.
+        HADOOP_SECURITY_SECURE_RANDOM_OPENSSL_PER_THREAD_KEY, true);
+    final OpensslSecureRandom random = new OpensslSecureRandom();
+    random.setConf(conf);
+
+    checkRandomBytes(random, 16);
+    // Bigger than one refill of the generator
+    checkRandomBytes(random, 4096);
+
+    // Every thread has a generator of its own, and they must not agree
+    final byte[][] bytes = new byte[4][32];
+    Thread[] threads = new Thread[bytes.length];
+    for (int i = 0; i < threads.length; i++) {
+      final int n = i;
+      threads[i] = new Thread() {
+        @Override
+        public void run() {
+          random.nextBytes(bytes[n]);
+        }
+      };
+      threads[i].start();
+    }
+    for (Thread thread : threads) {
+      thread.join();
+    }
+    for (int i = 1; i < bytes.length; i++) {
+      Assert.assertFalse(Arrays.equals(bytes[0], bytes[i]));
+    }
+  }
+}
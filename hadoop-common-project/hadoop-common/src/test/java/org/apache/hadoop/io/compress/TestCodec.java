@@ -160,6 +160,18 @@ public void testLz4Codec() throws IOException {
     }
   }
 
+  @Test
+  public void testZStandardCodec() throws IOException {
+    Assume.assumeTrue(ZStandardCodec.isNativeCodeLoaded());
+    Configuration conf = new Configuration(this.conf);
+    codecTest(conf, seed, 0, "org.apache.hadoop.io.compress.ZStandardCodec");
+    codecTest(conf, seed, count, "org.apache.hadoop.io.compress.ZStandardCodec");
+    conf.setInt(CommonConfigurationKeys.IO_COMPRESSION_CODEC_ZSTD_LEVEL_KEY, 19);
+    conf.setInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_ZSTD_WINDOW_LOG_KEY, 20);
+    codecTest(conf, seed, count, "org.apache.hadoop.io.compress.ZStandardCodec");
+  }
+
   @Test
   public void testDeflateCodec() throws IOException {
     codecTest(conf, seed, 0, "org.apache.hadoop.io.compress.DeflateCodec");
@@ -590,6 +602,12 @@ public void testSnappyMapFile() throws Exception {
     codecTestMapFile(SnappyCodec.class, CompressionType.BLOCK, 100);
   }
   
+  @Test
+  public void testZStandardMapFile() throws Exception {
+    Assume.assumeTrue(ZStandardCodec.isNativeCodeLoaded());
+    codecTestMapFile(ZStandardCodec.class, CompressionType.BLOCK, 100);
+  }
+
   private void codecTestMapFile(Class<? extends CompressionCodec> clazz,
       CompressionType type, int records) throws Exception {
     
@@ -20,6 +20,7 @@
 import org.apache.hadoop.conf.Configuration;
 import org.apache.hadoop.io.DataInputBuffer;
 import org.apache.hadoop.io.DataOutputBuffer;
+import org.apache.hadoop.io.IOUtils;
 import org.apache.hadoop.io.compress.*;
 import org.apache.hadoop.io.compress.bzip2.Bzip2Compressor;
 import org.apache.hadoop.io.compress.bzip2.Bzip2Decompressor;
@@ -28,6 +29,8 @@
 import org.junit.Test;
 
 import java.io.*;
+import java.nio.ByteBuffer;
+import java.util.Arrays;
 import java.util.Random;
 
 import static org.junit.Assert.*;
@@ -86,6 +89,82 @@ public static byte[] generate(int size) {
     return array;
   }
 
+  @Test
+  public void testCompressOnThreads() throws IOException {
+    Configuration conf = new Configuration();
+    Bzip2Factory.setCompressThreads(conf, 3);
+    BZip2Codec codec = new BZip2Codec();
+    codec.setConf(conf);
+    // Several buffers of frames, the last one partly filled
+    byte[] rawData = generate(7 * 1000 * 1000 + 12345);
+
+    Compressor compressor = codec.createCompressor();
+    ByteArrayOutputStream compressed = new ByteArrayOutputStream();
+    CompressionOutputStream out =
+        codec.createOutputStream(compressed, compressor);
+    out.write(rawData);
+    out.close();
+    assertEquals(rawData.length, compressor.getBytesRead());
+    assertEquals(compressed.size(), compressor.getBytesWritten());
+    byte[] bytes = compressed.toByteArray();
+
+    // The native decompressor reads it back
+    checkReadsBack(rawData,
+        codec.createInputStream(new ByteArrayInputStream(bytes)));
+    // So does the pure-Java one, which stops at the end of the first stream
+    // and checks the combined CRC
+    checkReadsBack(rawData, new CBZip2InputStream(
+        new ByteArrayInputStream(bytes, 2, bytes.length - 2)));
+  }
+
+  @Test
+  public void testDecompressBlocks() throws IOException {
+    // Several blocks of several streams
+    byte[] rawData = generate(3 * 1000 * 1000 + 777);
+    ByteArrayOutputStream compressed = new ByteArrayOutputStream();
+    BZip2Codec codec = new BZip2Codec();
+    codec.setConf(new Configuration());
+    for (int i = 0; i < 2; i++) {
+      CompressionOutputStream out = codec.createOutputStream(compressed);
+      out.write(rawData);
+      out.close();
+    }
+    byte[] bytes = compressed.toByteArray();
+    ByteBuffer src = ByteBuffer.allocateDirect(bytes.length);
+    src.put(bytes).flip();
+
+    for (int threads : new int[] {1, 4}) {
+      ByteBuffer input = src.duplicate();
+      byte[] result = Bzip2Decompressor.decompressBlocks(input, threads);
+      assertEquals(2 * rawData.length, result.length);
+      assertArrayEquals(rawData, Arrays.copyOf(result, rawData.length));
+      assertArrayEquals(rawData,
+          Arrays.copyOfRange(result, rawData.length, result.length));
+      assertFalse(input.hasRemaining());
+    }
+
+    // A corrupt block
+    src.put(bytes.length / 3, (byte) (bytes[bytes.length / 3] ^ 0x20));
+    try {
+      Bzip2Decompressor.decompressBlocks(src, 4);
+      fail("Corrupt bzip2 data decompressed");
+    } catch (IOException e) {
+      // expected
+    }
+  }
+
+  private static void checkReadsBack(byte[] rawData, InputStream in)
+      throws IOException {
+    byte[] result = new byte[rawData.length];
+    try {
+      IOUtils.readFully(in, result, 0, result.length);
+      assertEquals(-1, in.read());
+    } finally {
+      in.close();
+    }
+    assertArrayEquals(rawData, result);
+  }
+
   @Test
   public void testBzip2CompressDecompressInMultiThreads() throws Exception {
     MultithreadedTestUtil.TestContext ctx = new MultithreadedTestUtil.TestContext();
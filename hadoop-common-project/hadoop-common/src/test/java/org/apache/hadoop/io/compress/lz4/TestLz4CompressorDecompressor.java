@@ -25,8 +25,11 @@
 import java.io.DataInputStream;
 import java.io.DataOutputStream;
 import java.io.IOException;
+import java.util.Arrays;
 import java.util.Random;
 
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeys;
 import org.apache.hadoop.io.DataInputBuffer;
 import org.apache.hadoop.io.DataOutputBuffer;
 import org.apache.hadoop.io.compress.BlockCompressorStream;
@@ -308,6 +311,89 @@ compressedDataBuffer, new Lz4Compressor(bufferSize), bufferSize,
     }
   }  
 
+  @Test
+  public void testLz4CompressInFrames() throws IOException {
+    int bufferSize = 1024 * 1024;
+    int frameSize = 64 * 1024;
+    byte[] bytes = generate(bufferSize * 3 + 12345);
+    Lz4Compressor compressor =
+        new Lz4Compressor(bufferSize, false, 4, frameSize);
+    DataOutputBuffer compressedDataBuffer = new DataOutputBuffer();
+    CompressionOutputStream deflateFilter = new BlockCompressorStream(
+        compressedDataBuffer, compressor, bufferSize, bufferSize / 255 + 16);
+    deflateFilter.write(bytes, 0, bytes.length);
+    deflateFilter.finish();
+    deflateFilter.close();
+
+    // Every frame is a chunk of its own, so a decompressor with room for a
+    // frame, but not for the buffer of the compressor, reads them
+    DataInputBuffer deCompressedDataBuffer = new DataInputBuffer();
+    deCompressedDataBuffer.reset(compressedDataBuffer.getData(), 0,
+        compressedDataBuffer.getLength());
+    CompressionInputStream inflateFilter = new BlockDecompressorStream(
+        deCompressedDataBuffer, new Lz4Decompressor(2 * frameSize),
+        2 * frameSize);
+    DataInputStream inflateIn = new DataInputStream(inflateFilter);
+    byte[] result = new byte[bytes.length];
+    inflateIn.readFully(result);
+    assertEquals(-1, inflateIn.read());
+    inflateIn.close();
+    assertArrayEquals("original array not equals compress/decompressed array",
+        bytes, result);
+  }
+
+  @Test
+  public void testLz4LinkedBlocks() throws IOException {
+    int bufferSize = 16 * 1024;
+    // Repeats further apart than a block, but within reach of the next one
+    byte[] pattern = generate(40 * 1024);
+    byte[] bytes = new byte[1024 * 1024];
+    for (int i = 0; i < bytes.length; i++) {
+      bytes[i] = pattern[i % pattern.length];
+    }
+
+    Configuration conf = new Configuration();
+    conf.setInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_ACCELERATION_KEY, 4);
+    byte[] independent = compressWithConf(conf, bytes, bufferSize);
+    conf.setBoolean(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_LZ4_LINKED_BLOCKS_KEY,
+        true);
+    byte[] linked = compressWithConf(conf, bytes, bufferSize);
+    assertTrue("linked blocks did not compress better",
+        linked.length < independent.length / 2);
+
+    DataInputBuffer deCompressedDataBuffer = new DataInputBuffer();
+    deCompressedDataBuffer.reset(linked, 0, linked.length);
+    CompressionInputStream inflateFilter = new BlockDecompressorStream(
+        deCompressedDataBuffer, new Lz4Decompressor(bufferSize, true),
+        bufferSize);
+    DataInputStream inflateIn = new DataInputStream(inflateFilter);
+    byte[] result = new byte[bytes.length];
+    inflateIn.readFully(result);
+    assertEquals(-1, inflateIn.read());
+    inflateIn.close();
+    assertArrayEquals("original array not equals compress/decompressed array",
+        bytes, result);
+  }
+
+  private static byte[] compressWithConf(Configuration conf, byte[] bytes,
+      int bufferSize) throws IOException {
+    Lz4Compressor compressor = new Lz4Compressor(bufferSize);
+    compressor.reinit(conf);
+    DataOutputBuffer compressedDataBuffer = new DataOutputBuffer();
+    CompressionOutputStream deflateFilter = new BlockCompressorStream(
+        compressedDataBuffer, compressor, bufferSize, bufferSize / 255 + 16);
+    for (int off = 0; off < bytes.length; off += bufferSize / 2) {
+      deflateFilter.write(bytes, off,
+          Math.min(bufferSize / 2, bytes.length - off));
+    }
+    deflateFilter.finish();
+    deflateFilter.close();
+    return Arrays.copyOf(compressedDataBuffer.getData(),
+        compressedDataBuffer.getLength());
+  }
+
   public static byte[] generate(int size) {
     byte[] array = new byte[size];
     for (int i = 0; i < size; i++)
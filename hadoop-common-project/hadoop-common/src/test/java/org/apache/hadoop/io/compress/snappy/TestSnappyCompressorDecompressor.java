@@ -377,6 +377,36 @@ deCompressedDataBuffer, new SnappyDecompressor(bufferSize),
     }
   }
 
+  @Test
+  public void testSnappyCompressInFrames() throws IOException {
+    int bufferSize = 1024 * 1024;
+    int frameSize = 64 * 1024;
+    byte[] bytes = BytesGenerator.get(bufferSize * 3 + 12345);
+    SnappyCompressor compressor = new SnappyCompressor(bufferSize, 4, frameSize);
+    DataOutputBuffer compressedDataBuffer = new DataOutputBuffer();
+    CompressionOutputStream deflateFilter = new BlockCompressorStream(
+        compressedDataBuffer, compressor, bufferSize, bufferSize / 6 + 32);
+    deflateFilter.write(bytes, 0, bytes.length);
+    deflateFilter.finish();
+    deflateFilter.close();
+
+    // Every frame is a chunk of its own, so a decompressor with room for a
+    // frame, but not for the buffer of the compressor, reads them
+    DataInputBuffer deCompressedDataBuffer = new DataInputBuffer();
+    deCompressedDataBuffer.reset(compressedDataBuffer.getData(), 0,
+        compressedDataBuffer.getLength());
+    CompressionInputStream inflateFilter = new BlockDecompressorStream(
+        deCompressedDataBuffer, new SnappyDecompressor(2 * frameSize),
+        2 * frameSize);
+    DataInputStream inflateIn = new DataInputStream(inflateFilter);
+    byte[] result = new byte[bytes.length];
+    inflateIn.readFully(result);
+    assertEquals(-1, inflateIn.read());
+    inflateIn.close();
+    Assert.assertArrayEquals("original array not equals compress/decompressed array",
+        bytes, result);
+  }
+
   static final class BytesGenerator {
     private BytesGenerator() {
     }
@@ -25,7 +25,9 @@
 import java.io.InputStream;
 import java.nio.ByteBuffer;
 import java.util.Random;
+import java.util.zip.Deflater;
 import java.util.zip.DeflaterOutputStream;
+import java.util.zip.GZIPOutputStream;
 
 import org.apache.hadoop.conf.Configuration;
 import org.apache.hadoop.fs.CommonConfigurationKeys;
@@ -459,4 +461,52 @@ public void doWork() throws Exception {
 
     ctx.waitFor(60000);
   }
+
+  @Test
+  public void testInflateGzipMembers() throws IOException {
+    ByteArrayOutputStream raw = new ByteArrayOutputStream();
+    ByteArrayOutputStream gz = new ByteArrayOutputStream();
+    // Something that looks like a gzip header in the middle of a member
+    byte[] falseHeader = {0x1f, (byte) 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+    for (int i = 0; i < 20; i++) {
+      byte[] data = generate(i % 4 == 0 ? 0 : random.nextInt(200 * 1024));
+      final boolean stored = i % 5 == 1;
+      GZIPOutputStream out = new GZIPOutputStream(gz) {
+        {
+          if (stored) {
+            def.setLevel(Deflater.NO_COMPRESSION);
+          }
+        }
+      };
+      out.write(data);
+      raw.write(data);
+      if (stored) {
+        out.write(falseHeader);
+        raw.write(falseHeader);
+      }
+      out.finish();
+    }
+
+    ByteBuffer src = ByteBuffer.allocateDirect(gz.size());
+    src.put(gz.toByteArray()).flip();
+    int[] members = ZlibDecompressor.indexGzipMembers(src);
+    assertTrue("Members found " + members.length, members.length > 20);
+    for (int threads : new int[] {1, 4}) {
+      ByteBuffer input = src.duplicate();
+      byte[] uncompressed =
+          ZlibDecompressor.inflateGzipMembers(input, members, threads);
+      assertArrayEquals(raw.toByteArray(), uncompressed);
+      assertFalse(input.hasRemaining());
+    }
+
+    // A truncated member
+    src.limit(src.limit() - 3);
+    members = ZlibDecompressor.indexGzipMembers(src);
+    try {
+      ZlibDecompressor.inflateGzipMembers(src, members, 4);
+      fail("Truncated gzip data inflated");
+    } catch (IOException e) {
+      // expected
+    }
+  }
 }
@@ -0,0 +1,266 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.compress.zstd;
+
+import static org.junit.Assert.assertArrayEquals;
+import static org.junit.Assert.assertTrue;
+import static org.junit.Assert.fail;
+import static org.junit.Assume.assumeTrue;
+
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.util.Random;
+
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeys;
+import org.apache.hadoop.io.compress.CompressionInputStream;
+import org.apache.hadoop.io.compress.CompressionOutputStream;
+import org.apache.hadoop.io.compress.Compressor;
+import org.apache.hadoop.io.compress.CompressorStream;
+import org.apache.hadoop.io.compress.Decompressor;
+import org.apache.hadoop.io.compress.DecompressorStream;
+import org.apache.hadoop.io.compress.ZStandardCodec;
+import org.junit.Before;
+import org.junit.Test;
+
+public class TestZStandardCompressorDecompressor {
+  private static final Random rnd = new Random(12345L);
+  private static final String[] WORDS = {
+    "hadoop ", "zstandard ", "frame ", "block ", "stream ", "native ", "codec "
+  };
+
+  @Before
+  public void before() {
+    assumeTrue(ZStandardCodec.isNativeCodeLoaded());
+  }
+
+  @Test
+  public void testZStandardCompressorSetInputNullPointerException() {
+    try {
+      Compressor compressor = new ZStandardCompressor(3, 0, 4096);
+      compressor.setInput(null, 0, 10);
+      fail("testZStandardCompressorSetInputNullPointerException error !!!");
+    } catch (NullPointerException ex) {
+      // expected
+    }
+  }
+
+  @Test
+  public void testZStandardCompressDecompressSmallBuffers() throws IOException {
+    byte[] bytes = generate(1024 * 1024);
+    // An output buffer smaller than what zstd decodes at a time
+    byte[] compressed = compress(new ZStandardCompressor(3, 0, 4096), 4096,
+        bytes);
+    assertTrue("zstd did not compress", compressed.length < bytes.length / 2);
+    assertArrayEquals(bytes, decompress(new ZStandardDecompressor(0, 1024),
+        1024, compressed, bytes.length));
+  }
+
+  @Test
+  public void testZStandardConcatenatedFrames() throws IOException {
+    byte[] bytes = generate(100 * 1024);
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    CompressionOutputStream deflateFilter = new CompressorStream(out,
+        new ZStandardCompressor(1, 0, 8192), 8192);
+    deflateFilter.write(bytes, 0, bytes.length / 2);
+    deflateFilter.finish();
+    deflateFilter.resetState();
+    deflateFilter.write(bytes, bytes.length / 2, bytes.length / 2);
+    deflateFilter.close();
+
+    assertArrayEquals(bytes, decompress(new ZStandardDecompressor(0, 8192),
+        8192, out.toByteArray(), bytes.length));
+  }
+
+  @Test
+  public void testZStandardDictionary() throws IOException {
+    // A short record benefits from a dictionary of what records look like
+    byte[] bytes = generate(200);
+    byte[] dictionary = generate(16 * 1024);
+    byte[] plain = compress(new ZStandardCompressor(3, 0, 4096), 4096, bytes);
+    Compressor compressor = new ZStandardCompressor(3, 0, 4096);
+    compressor.setDictionary(dictionary, 0, dictionary.length);
+    byte[] compressed = compress(compressor, 4096, bytes);
+    assertTrue("dictionary did not help",
+        compressed.length < plain.length);
+
+    Decompressor decompressor = new ZStandardDecompressor(0, 4096);
+    decompressor.setDictionary(dictionary, 0, dictionary.length);
+    assertArrayEquals(bytes, decompress(decompressor, 4096, compressed,
+        bytes.length));
+  }
+
+  @Test
+  public void testZStandardLargeWindow() throws IOException {
+    byte[] bytes = generate(64 * 1024);
+    byte[] compressed = compress(new ZStandardCompressor(3, 28, 4096), 4096,
+        bytes);
+    try {
+      decompress(new ZStandardDecompressor(0, 4096), 4096, compressed,
+          bytes.length);
+      fail("a window over the default limit was accepted");
+    } catch (IOException e) {
+      // expected
+    }
+    assertArrayEquals(bytes, decompress(new ZStandardDecompressor(28, 4096),
+        4096, compressed, bytes.length));
+  }
+
+  @Test
+  public void testZStandardCodecBlockFraming() throws IOException {
+    ZStandardCodec codec = newCodec(8192);
+    byte[] bytes = generate(100 * 1024);
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    CompressionOutputStream deflateFilter = codec.createOutputStream(out);
+    for (int off = 0; off < bytes.length; off += 1000) {
+      deflateFilter.write(bytes, off, Math.min(1000, bytes.length - off));
+    }
+    deflateFilter.close();
+    byte[] compressed = out.toByteArray();
+
+    // Every block starts with its uncompressed length, as for snappy
+    DataInputStream blocks = new DataInputStream(
+        new ByteArrayInputStream(compressed));
+    int blockLength = blocks.readInt();
+    assertTrue("bad block length " + blockLength,
+        blockLength > 0 && blockLength <= 8192);
+    assertArrayEquals(bytes, readAll(codec.createInputStream(
+        new ByteArrayInputStream(compressed)), bytes.length));
+  }
+
+  @Test
+  public void testZStandardCodecReadsFramePerBlock() throws IOException {
+    // The native map output collector writes a whole frame per block, in
+    // blocks larger than the buffer of the reader
+    byte[] bytes = generate(100 * 1024);
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    DataOutputStream blocks = new DataOutputStream(out);
+    for (int off = 0; off < bytes.length; off += 16 * 1024) {
+      int length = Math.min(16 * 1024, bytes.length - off);
+      byte[] block = new byte[length];
+      System.arraycopy(bytes, off, block, 0, length);
+      byte[] frame = compress(new ZStandardCompressor(3, 0, 4096), 4096,
+          block);
+      blocks.writeInt(length);
+      blocks.writeInt(frame.length);
+      blocks.write(frame);
+    }
+    blocks.close();
+
+    byte[] compressed = out.toByteArray();
+    assertArrayEquals(bytes, readAll(newCodec(4096).createInputStream(
+        new ByteArrayInputStream(compressed)), bytes.length));
+  }
+
+  @Test
+  public void testZStandardCodecReadsStoredBlock() throws IOException {
+    // Blocks that do not compress are stored by the native collector as
+    // a frame of raw zstd blocks of at most 128KB each
+    byte[] bytes = new byte[300 * 1024];
+    rnd.nextBytes(bytes);
+    ByteArrayOutputStream frame = new ByteArrayOutputStream();
+    writeLittleEndian(frame, 0xfd2fb528, 4);
+    // Frame_Content_Size_flag 2, Single_Segment_flag
+    frame.write(0xa0);
+    writeLittleEndian(frame, bytes.length, 4);
+    int off = 0;
+    do {
+      int size = Math.min(128 * 1024, bytes.length - off);
+      boolean last = off + size == bytes.length;
+      // Block_Size, Block_Type 0 for raw, Last_Block
+      writeLittleEndian(frame, (size << 3) | (last ? 1 : 0), 3);
+      frame.write(bytes, off, size);
+      off += size;
+    } while (off < bytes.length);
+
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    DataOutputStream blocks = new DataOutputStream(out);
+    blocks.writeInt(bytes.length);
+    blocks.writeInt(frame.size());
+    frame.writeTo(blocks);
+    blocks.close();
+
+    assertArrayEquals(bytes, readAll(newCodec(4096).createInputStream(
+        new ByteArrayInputStream(out.toByteArray())), bytes.length));
+  }
+
+  private static void writeLittleEndian(ByteArrayOutputStream out, int v,
+      int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      out.write(v >>> (8 * i));
+    }
+  }
+
+  private static ZStandardCodec newCodec(int bufferSize) {
+    Configuration conf = new Configuration();
+    conf.setInt(
+        CommonConfigurationKeys.IO_COMPRESSION_CODEC_ZSTD_BUFFERSIZE_KEY,
+        bufferSize);
+    ZStandardCodec codec = new ZStandardCodec();
+    codec.setConf(conf);
+    return codec;
+  }
+
+  private static byte[] compress(Compressor compressor, int bufferSize,
+      byte[] bytes) throws IOException {
+    ByteArrayOutputStream out = new ByteArrayOutputStream();
+    CompressionOutputStream deflateFilter = new CompressorStream(out,
+        compressor, bufferSize);
+    for (int off = 0; off < bytes.length; off += 1000) {
+      deflateFilter.write(bytes, off, Math.min(1000, bytes.length - off));
+    }
+    deflateFilter.close();
+    return out.toByteArray();
+  }
+
+  private static byte[] decompress(Decompressor decompressor, int bufferSize,
+      byte[] compressed, int length) throws IOException {
+    return readAll(new DecompressorStream(
+        new ByteArrayInputStream(compressed), decompressor, bufferSize),
+        length);
+  }
+
+  private static byte[] readAll(CompressionInputStream inflateFilter,
+      int length) throws IOException {
+    DataInputStream inflateIn = new DataInputStream(inflateFilter);
+    byte[] result = new byte[length];
+    try {
+      inflateIn.readFully(result);
+      if (inflateIn.read() != -1) {
+        fail("more data than was compressed");
+      }
+    } finally {
+      inflateIn.close();
+    }
+    return result;
+  }
+
+  private static byte[] generate(int size) {
+    byte[] array = new byte[size];
+    for (int i = 0; i < size; ) {
+      byte[] word = WORDS[rnd.nextInt(WORDS.length)].getBytes();
+      for (int j = 0; j < word.length && i < size; j++) {
+        array[i++] = word[j];
+      }
+    }
+    return array;
+  }
+}
@@ -0,0 +1,94 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.erasurecode.rawcoder;
+
+import java.nio.ByteBuffer;
+import java.util.Random;
+
+import org.apache.hadoop.io.erasurecode.ErasureCodeNative;
+import org.junit.Assert;
+import org.junit.Assume;
+import org.junit.Before;
+import org.junit.Test;
+
+/**
+ * Test the native RS decoder against the Java encoder, and its decoding of
+ * large cells on several threads.
+ */
+public class TestNativeRSRawDecoder extends TestRSRawCoderBase {
+
+  @Before
+  public void setup() {
+    Assume.assumeTrue(ErasureCodeNative.isNativeCodeLoaded());
+    this.encoderClass = RSRawEncoder.class;
+    this.decoderClass = NativeRSRawDecoder.class;
+    setAllowDump(false);
+  }
+
+  @Test
+  public void testDecodeThreads() {
+    int numDataUnits = 6, numParityUnits = 3;
+    // Not a multiple of the slice size, the last slice is short
+    int cellSize = 1024 * 1024 + 100;
+    int[] erasedIndexes = {0, 4, 7};
+    Random random = new Random(4321);
+
+    byte[][] data = new byte[numDataUnits][cellSize];
+    byte[][] parity = new byte[numParityUnits][cellSize];
+    for (byte[] unit : data) {
+      random.nextBytes(unit);
+    }
+    new RSRawEncoder(numDataUnits, numParityUnits).encode(data, parity);
+
+    ByteBuffer[] inputs = new ByteBuffer[numDataUnits + numParityUnits];
+    for (int i = 0; i < inputs.length; i++) {
+      byte[] unit = i < numDataUnits ? data[i] : parity[i - numDataUnits];
+      inputs[i] = ByteBuffer.allocateDirect(cellSize);
+      inputs[i].put(unit).flip();
+    }
+    for (int index : erasedIndexes) {
+      inputs[index] = null;
+    }
+
+    for (int threads : new int[] {1, 4, 32}) {
+      NativeRSRawDecoder decoder =
+          new NativeRSRawDecoder(numDataUnits, numParityUnits);
+      decoder.setDecodeThreads(threads);
+      ByteBuffer[] outputs = new ByteBuffer[erasedIndexes.length];
+      for (int i = 0; i < outputs.length; i++) {
+        outputs[i] = ByteBuffer.allocateDirect(cellSize);
+      }
+      // Decoding consumes the inputs, each round reads its own views
+      ByteBuffer[] views = new ByteBuffer[inputs.length];
+      for (int i = 0; i < inputs.length; i++) {
+        views[i] = inputs[i] == null ? null : inputs[i].duplicate();
+      }
+      decoder.decode(views, erasedIndexes, outputs);
+
+      byte[] actual = new byte[cellSize];
+      for (int i = 0; i < erasedIndexes.length; i++) {
+        int index = erasedIndexes[i];
+        byte[] expected = index < numDataUnits ? data[index] :
+            parity[index - numDataUnits];
+        outputs[i].duplicate().get(actual);
+        Assert.assertArrayEquals("threads " + threads, expected, actual);
+      }
+      decoder.release();
+    }
+  }
+}
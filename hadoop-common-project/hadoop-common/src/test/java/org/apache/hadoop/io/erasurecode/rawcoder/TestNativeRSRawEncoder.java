@@ -0,0 +1,121 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.erasurecode.rawcoder;
+
+import java.nio.ByteBuffer;
+import java.util.Random;
+
+import org.apache.hadoop.io.erasurecode.ErasureCodeNative;
+import org.junit.Assert;
+import org.junit.Assume;
+import org.junit.Before;
+import org.junit.Test;
+
+/**
+ * Test the native RS encoder against the Java decoder, and its batch and
+ * incremental encoding against the Java encoder.
+ */
+public class TestNativeRSRawEncoder extends TestRSRawCoderBase {
+
+  @Before
+  public void setup() {
+    Assume.assumeTrue(ErasureCodeNative.isNativeCodeLoaded());
+    this.encoderClass = NativeRSRawEncoder.class;
+    this.decoderClass = RSRawDecoder.class;
+    setAllowDump(false);
+  }
+
+  @Test
+  public void testEncodeRegistered() {
+    int numDataUnits = 6, numParityUnits = 3, numStripes = 5;
+    int cellSize = 4096, dataLen = 3000;
+    Random random = new Random(1234);
+    NativeRSRawEncoder encoder =
+        new NativeRSRawEncoder(numDataUnits, numParityUnits);
+    RSRawEncoder expected = new RSRawEncoder(numDataUnits, numParityUnits);
+
+    ByteBuffer[] inputs = new ByteBuffer[numStripes * numDataUnits];
+    ByteBuffer[] outputs = new ByteBuffer[numStripes * numParityUnits];
+    for (int i = 0; i < inputs.length; i++) {
+      byte[] data = new byte[cellSize];
+      random.nextBytes(data);
+      inputs[i] = ByteBuffer.allocateDirect(cellSize);
+      inputs[i].put(data).flip();
+    }
+    for (int i = 0; i < outputs.length; i++) {
+      outputs[i] = ByteBuffer.allocateDirect(cellSize);
+    }
+    encoder.registerBuffers(inputs, outputs);
+    // Only the first stripes are encoded, the others keep their zeros
+    encoder.encodeRegistered(numStripes - 1, dataLen);
+
+    byte[][] stripeInputs = new byte[numDataUnits][dataLen];
+    byte[][] stripeOutputs = new byte[numParityUnits][dataLen];
+    byte[] actual = new byte[dataLen];
+    for (int s = 0; s < numStripes; s++) {
+      for (int i = 0; i < numDataUnits; i++) {
+        inputs[s * numDataUnits + i].duplicate().get(stripeInputs[i]);
+      }
+      if (s < numStripes - 1) {
+        expected.encode(stripeInputs, stripeOutputs);
+      } else {
+        stripeOutputs = new byte[numParityUnits][dataLen];
+      }
+      for (int i = 0; i < numParityUnits; i++) {
+        outputs[s * numParityUnits + i].duplicate().get(actual);
+        Assert.assertArrayEquals(stripeOutputs[i], actual);
+      }
+    }
+    encoder.release();
+  }
+
+  @Test
+  public void testEncodeUpdate() {
+    int numDataUnits = 6, numParityUnits = 3, dataLen = 5000;
+    Random random = new Random(5678);
+    NativeRSRawEncoder encoder =
+        new NativeRSRawEncoder(numDataUnits, numParityUnits);
+
+    byte[][] inputs = new byte[numDataUnits][dataLen];
+    byte[][] expected = new byte[numParityUnits][dataLen];
+    for (byte[] input : inputs) {
+      random.nextBytes(input);
+    }
+    new RSRawEncoder(numDataUnits, numParityUnits).encode(inputs, expected);
+
+    ByteBuffer[] outputs = new ByteBuffer[numParityUnits];
+    for (int i = 0; i < numParityUnits; i++) {
+      outputs[i] = ByteBuffer.allocateDirect(dataLen);
+    }
+    // The units arrive out of order
+    int[] order = {3, 0, 5, 1, 4, 2};
+    for (int index : order) {
+      ByteBuffer input = ByteBuffer.allocateDirect(dataLen);
+      input.put(inputs[index]).flip();
+      encoder.encodeUpdate(input, index, outputs);
+      Assert.assertEquals(dataLen, input.position());
+    }
+
+    byte[] actual = new byte[dataLen];
+    for (int i = 0; i < numParityUnits; i++) {
+      outputs[i].duplicate().get(actual);
+      Assert.assertArrayEquals(expected[i], actual);
+    }
+    encoder.release();
+  }
+}
@@ -0,0 +1,143 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.io.nativeio;
+
+import java.io.File;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.util.Random;
+
+import org.junit.Assert;
+import org.junit.Assume;
+import org.junit.Before;
+import org.junit.Test;
+
+public class TestIoUring {
+  private static final File TEST_BASE =
+      new File(System.getProperty("test.build.data", "/tmp"));
+
+  private static final int BUFFER_SIZE = 65536;
+
+  @Before
+  public void setup() throws Exception {
+    Assume.assumeTrue(null == IoUring.getLoadingFailureReason());
+  }
+
+  /**
+   * Wait for count operations, checking that each returned its expected
+   * result, indexed by its userData.
+   */
+  private static void awaitAll(IoUring ring, int count, int[] expected)
+      throws Exception {
+    long[] userData = new long[count];
+    int[] results = new int[count];
+    int done = 0;
+    while (done < count) {
+      int n = ring.complete(userData, results, 1);
+      for (int i = 0; i < n; i++) {
+        Assert.assertEquals("result of " + userData[i],
+            expected[(int) userData[i]], results[i]);
+      }
+      done += n;
+    }
+  }
+
+  @Test(timeout=10000)
+  public void testWriteSyncAndRead() throws Exception {
+    File file = new File(TEST_BASE, "testWriteSyncAndRead");
+    ByteBuffer[] buffers = new ByteBuffer[4];
+    byte[] data = new byte[buffers.length * BUFFER_SIZE];
+    new Random(0xdeadbeef).nextBytes(data);
+    for (int i = 0; i < buffers.length; i++) {
+      buffers[i] = ByteBuffer.allocateDirect(BUFFER_SIZE);
+      buffers[i].put(data, i * BUFFER_SIZE, BUFFER_SIZE);
+    }
+    int[] expected = new int[buffers.length + 1];
+    RandomAccessFile raf = new RandomAccessFile(file, "rw");
+    IoUring ring = IoUring.create(buffers.length, buffers);
+    try {
+      // Write the buffers in reverse order, each to its own place
+      for (int i = buffers.length - 1; i >= 0; i--) {
+        Assert.assertTrue(ring.write(raf.getFD(), i, 0, BUFFER_SIZE,
+            (long) i * BUFFER_SIZE, i));
+        expected[i] = BUFFER_SIZE;
+      }
+      // The queue is full until the writes are submitted
+      Assert.assertFalse(ring.fsync(raf.getFD(), true, buffers.length));
+      ring.submit();
+      awaitAll(ring, buffers.length, expected);
+      Assert.assertEquals(data.length, raf.length());
+
+      Assert.assertTrue(ring.fsync(raf.getFD(), true, buffers.length));
+      expected[buffers.length] = 0;
+      awaitAll(ring, 1, expected);
+
+      for (int i = 0; i < buffers.length; i++) {
+        buffers[i].clear();
+        buffers[i].put(new byte[BUFFER_SIZE]);
+        Assert.assertTrue(ring.read(raf.getFD(), i, 0, BUFFER_SIZE,
+            (long) i * BUFFER_SIZE, i));
+      }
+      awaitAll(ring, buffers.length, expected);
+      for (int i = 0; i < buffers.length; i++) {
+        byte[] read = new byte[BUFFER_SIZE];
+        buffers[i].clear();
+        buffers[i].get(read);
+        for (int j = 0; j < BUFFER_SIZE; j++) {
+          Assert.assertEquals(data[i * BUFFER_SIZE + j], read[j]);
+        }
+      }
+
+      // Reading past the end returns 0
+      Assert.assertTrue(ring.read(raf.getFD(), 0, 0, BUFFER_SIZE,
+          data.length, 0));
+      expected[0] = 0;
+      awaitAll(ring, 1, expected);
+    } finally {
+      ring.close();
+      raf.close();
+      file.delete();
+    }
+  }
+
+  @Test(timeout=10000)
+  public void testOutsideRegisteredBuffer() throws Exception {
+    File file = new File(TEST_BASE, "testOutsideRegisteredBuffer");
+    ByteBuffer[] buffers = { ByteBuffer.allocateDirect(BUFFER_SIZE) };
+    RandomAccessFile raf = new RandomAccessFile(file, "rw");
+    IoUring ring = IoUring.create(2, buffers);
+    try {
+      try {
+        ring.write(raf.getFD(), 0, 1, BUFFER_SIZE, 0, 0);
+        Assert.fail("wrote past the end of a registered buffer");
+      } catch (IllegalArgumentException e) {
+        // expected
+      }
+      try {
+        ring.read(raf.getFD(), 1, 0, 1, 0, 0);
+        Assert.fail("read into a buffer that is not registered");
+      } catch (IllegalArgumentException e) {
+        // expected
+      }
+    } finally {
+      ring.close();
+      raf.close();
+      file.delete();
+    }
+  }
+}
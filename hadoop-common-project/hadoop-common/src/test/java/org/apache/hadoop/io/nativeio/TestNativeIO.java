@@ -253,6 +253,43 @@ public void testCreateFile() throws Exception {
 
   }
 
+  /** Validate stat and chown on Windows, which replace winutils ls/chown */
+  @Test (timeout = 30000)
+  public void testStatAndChownOnWindows() throws Exception {
+    if (!Path.WINDOWS) {
+      return;
+    }
+
+    File testFile = new File(TEST_DIR, "testfilestat");
+    assertTrue(testFile.createNewFile());
+    NativeIO.POSIX.chmod(testFile.getCanonicalPath(), 0640);
+
+    NativeIO.POSIX.Stat stat =
+        NativeIO.Windows.stat(testFile.getCanonicalPath());
+    LOG.info("Stat: " + String.valueOf(stat));
+    assertEquals(0640, stat.getMode() & 0777);
+    assertNotNull(stat.getOwner());
+    assertNotNull(stat.getGroup());
+
+    // Setting the owner and group it already has only has to succeed
+    NativeIO.Windows.chown(testFile.getCanonicalPath(), stat.getOwner(),
+        null);
+    NativeIO.Windows.chown(testFile.getCanonicalPath(), null,
+        stat.getGroup());
+    NativeIO.POSIX.Stat after =
+        NativeIO.Windows.stat(testFile.getCanonicalPath());
+    assertEquals(stat.getOwner(), after.getOwner());
+    assertEquals(stat.getGroup(), after.getGroup());
+
+    try {
+      NativeIO.Windows.stat(new File(TEST_DIR, "nosuchfile")
+          .getCanonicalPath());
+      fail("Expected stat of a missing file to fail");
+    } catch (NativeIOException nioe) {
+      LOG.info("Got expected exception", nioe);
+    }
+  }
+
   /** Validate access checks on Windows */
   @Test (timeout = 30000)
   public void testAccess() throws Exception {
@@ -489,6 +526,43 @@ public void testSyncFileRange() throws Exception {
     }
   }
 
+  @Test (timeout = 30000)
+  public void testFallocate() throws Exception {
+    File file = new File(TEST_DIR, "testFallocate");
+    RandomAccessFile raf = new RandomAccessFile(file, "rw");
+    try {
+      if (!NativeIO.POSIX.fallocateIfPossible(raf.getFD(),
+          FALLOC_FL_KEEP_SIZE, 0, 1 << 20)) {
+        // we should just skip the unit test on machines where we don't
+        // have fallocate support
+        assumeTrue(false);
+      }
+      assertEquals("KEEP_SIZE changed the size", 0, raf.length());
+      assertTrue(NativeIO.POSIX.fallocateIfPossible(raf.getFD(), 0, 0, 8192));
+      assertEquals(8192, raf.length());
+
+      raf.write(new byte[] { 1, 2, 3 });
+      raf.seek(4096);
+      raf.write(new byte[] { 4, 5, 6 });
+      if (NativeIO.POSIX.fallocateIfPossible(raf.getFD(),
+          FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, 4096)) {
+        assertEquals(8192, raf.length());
+        raf.seek(0);
+        assertEquals(0, raf.read());
+        raf.seek(4096);
+        assertEquals(4, raf.read());
+      }
+    } finally {
+      raf.close();
+    }
+    try {
+      NativeIO.POSIX.fallocate(raf.getFD(), 0, 0, 1024);
+      fail("Did not throw on bad file");
+    } catch (NativeIOException nioe) {
+      assertEquals(Errno.EBADF, nioe.getErrno());
+    }
+  }
+
   private void assertPermissions(File f, int expected) throws IOException {
     FileSystem localfs = FileSystem.getLocal(new Configuration());
     FsPermission perms = localfs.getFileStatus(
@@ -612,6 +686,86 @@ public void testMlock() throws Exception {
     }
   }
 
+  @Test (timeout = 30000)
+  public void testMlockPlaced() throws Exception {
+    assumeTrue(NativeIO.isAvailable());
+    assumeTrue(!Path.WINDOWS);
+    final File TEST_FILE = new File(TEST_DIR, "testMlockPlacedFile");
+    final int BUF_LEN = 3 * 4096 + 1;
+    FileOutputStream fos = new FileOutputStream(TEST_FILE);
+    try {
+      fos.write(new byte[BUF_LEN]);
+    } finally {
+      fos.close();
+    }
+
+    FileInputStream fis = new FileInputStream(TEST_FILE);
+    try {
+      FileChannel channel = fis.getChannel();
+      MappedByteBuffer mapbuf = channel.map(MapMode.READ_ONLY, 0, BUF_LEN);
+      try {
+        // Every Linux machine has a node 0, NUMA or not
+        NativeIO.POSIX.mlock(mapbuf, BUF_LEN, true, 0);
+      } catch (UnsupportedOperationException uoe) {
+        // we should just skip the unit test on machines where we don't
+        // have mbind support
+        assumeTrue(false);
+      }
+      assertTrue("locked pages are not resident",
+          NativeIO.POSIX.getResidentBytes(mapbuf, BUF_LEN) >= BUF_LEN);
+      NativeIO.POSIX.munmap(mapbuf);
+    } finally {
+      fis.close();
+    }
+  }
+
+  @Test (timeout = 30000)
+  public void testListDirectory() throws Exception {
+    assumeTrue(NativeIO.isAvailable());
+    assumeTrue(!Path.WINDOWS);
+    final File dir = new File(TEST_DIR, "testListDirectory");
+    assertTrue(new File(dir, "subdir").mkdirs());
+    // enough entries to outgrow the initial scan buffer
+    final int numFiles = 6000;
+    for (int i = 0; i < numFiles; i++) {
+      FileOutputStream fos = new FileOutputStream(
+          new File(dir, String.format("blk_%06d_padding_the_name", i)));
+      try {
+        fos.write(new byte[i % 7]);
+      } finally {
+        fos.close();
+      }
+    }
+    long mtime = new File(dir, "blk_000003_padding_the_name").lastModified();
+
+    List<DirectoryEntry> entries = NativeIO.POSIX.listDirectory(dir);
+    assertEquals(numFiles + 1, entries.size());
+    int files = 0;
+    for (DirectoryEntry entry : entries) {
+      if (entry.getName().equals("subdir")) {
+        assertTrue(entry.isDirectory());
+        assertFalse(entry.isFile());
+        continue;
+      }
+      assertTrue(entry.toString(), entry.isFile());
+      int i = Integer.parseInt(entry.getName().substring(4, 10));
+      assertEquals(entry.toString(), i % 7, entry.getLength());
+      if (i == 3) {
+        // File#lastModified may drop the milliseconds
+        assertEquals(mtime / 1000, entry.getModificationTime() / 1000);
+      }
+      files++;
+    }
+    assertEquals(numFiles, files);
+
+    try {
+      NativeIO.POSIX.listDirectory(new File(dir, "nosuchdir"));
+      fail("listed a missing directory");
+    } catch (NativeIOException nioe) {
+      assertEquals(Errno.ENOENT, nioe.getErrno());
+    }
+  }
+
   @Test(timeout=10000)
   public void testGetMemlockLimit() throws Exception {
     assumeTrue(NativeIO.isAvailable());
@@ -110,4 +110,56 @@ public void testDirectoryFallbacks() throws Exception {
     Assert.assertEquals(goodPath.getAbsolutePath(), factory.getPath());
     FileUtil.fullyDelete(goodPath);
   }
+
+  @Test(timeout=10000)
+  public void testMemfd() throws Exception {
+    Assume.assumeTrue(SharedFileDescriptorFactory.isMemfdSupported());
+    SharedFileDescriptorFactory factory =
+        SharedFileDescriptorFactory.create("woot3_", new String[0], true);
+    Assert.assertTrue(factory.isMemfd());
+    Assert.assertNull(factory.getPath());
+    FileInputStream inStream = factory.createDescriptor("testMemfd", 4096);
+    Assert.assertEquals(4096, inStream.getChannel().size());
+    Assert.assertEquals(0, inStream.read());
+    // The size is sealed
+    FileOutputStream outStream = new FileOutputStream(inStream.getFD());
+    try {
+      outStream.getChannel().truncate(0);
+      Assert.fail("truncated a sealed memfd");
+    } catch (IOException e) {
+      // expected
+    }
+    Assert.assertEquals(4096, inStream.getChannel().size());
+    inStream.close();
+    outStream.close();
+  }
+
+  @Test(timeout=10000)
+  public void testPreallocate() throws Exception {
+    File path = new File(TEST_BASE, "testPreallocate");
+    path.mkdirs();
+    SharedFileDescriptorFactory factory =
+        SharedFileDescriptorFactory.create("woot4_",
+            new String[] { path.getAbsolutePath() });
+    try {
+      factory.preallocate(2, 8192);
+      // Nothing is left behind in the directory
+      Assert.assertEquals(0, path.list().length);
+      FileInputStream pooled[] = new FileInputStream[3];
+      for (int i = 0; i < pooled.length; i++) {
+        pooled[i] = factory.createDescriptor("testPreallocate", 8192);
+        Assert.assertEquals(8192, pooled[i].getChannel().size());
+      }
+      FileInputStream other = factory.createDescriptor("testPreallocate", 1);
+      Assert.assertEquals(1, other.getChannel().size());
+      other.close();
+      for (FileInputStream fis : pooled) {
+        Assert.assertTrue(fis.getFD().valid());
+        fis.close();
+      }
+    } finally {
+      factory.close();
+      FileUtil.fullyDelete(path);
+    }
+  }
 }
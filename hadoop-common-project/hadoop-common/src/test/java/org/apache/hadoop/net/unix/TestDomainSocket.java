@@ -662,6 +662,114 @@ public void run(){
     }
   }
   
+  /**
+   * Test that a batch of messages passes each message's file descriptors
+   * along with it.
+   */
+  @Test(timeout=180000)
+  public void testFdBatchPassing() throws Exception {
+    final PassedFile passedFiles[] = new PassedFile[] {
+        new PassedFile(1), new PassedFile(2), new PassedFile(3) };
+    // Message i passes the first i + 1 files
+    final FileDescriptor passedFds[][] = new FileDescriptor[3][];
+    final int lengths[] = new int[] { 2, 3, 1 };
+    final byte msgs[] = new byte[] { 0x1, 0x2, 0x3, 0x4, 0x5, 0x6 };
+    for (int i = 0; i < passedFds.length; i++) {
+      passedFds[i] = new FileDescriptor[i + 1];
+      for (int j = 0; j <= i; j++) {
+        passedFds[i][j] = passedFiles[j].getInputStream().getFD();
+      }
+    }
+    DomainSocket socks[] = DomainSocket.socketpair();
+    try {
+      socks[0].sendFileDescriptorBatch(passedFds, msgs, 0, lengths);
+
+      FileInputStream recvFis[][] = new FileInputStream[3][3];
+      byte in[] = new byte[msgs.length];
+      int bytesRead[] = new int[3];
+      int received = 0, offset = 0;
+      while (received < 3) {
+        FileInputStream batchFis[][] = Arrays.copyOfRange(recvFis,
+            received, 3);
+        int n = socks[1].recvFileInputStreamBatch(batchFis, in, offset,
+            Arrays.copyOfRange(lengths, received, 3), bytesRead);
+        Assert.assertTrue(n > 0);
+        for (int i = 0; i < n; i++) {
+          Assert.assertEquals(lengths[received + i], bytesRead[i]);
+          offset += bytesRead[i];
+        }
+        received += n;
+      }
+      Assert.assertTrue(Arrays.equals(msgs, in));
+      for (int i = 0; i < recvFis.length; i++) {
+        for (int j = 0; j < recvFis[i].length; j++) {
+          if (j <= i) {
+            Assert.assertNotNull(recvFis[i][j]);
+            passedFiles[j].checkInputStream(recvFis[i][j]);
+            recvFis[i][j].close();
+          } else {
+            Assert.assertNull(recvFis[i][j]);
+          }
+        }
+      }
+    } finally {
+      socks[0].close();
+      socks[1].close();
+      for (PassedFile pf : passedFiles) {
+        pf.cleanup();
+      }
+    }
+  }
+
+  /**
+   * Test that a header and a payload written together from several buffers
+   * arrive intact in several others, direct or not.
+   */
+  @Test(timeout=180000)
+  public void testScatterGather() throws Exception {
+    byte header[] = new byte[] { 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7 };
+    byte payload[] = new byte[16384];
+    for (int i = 0; i < payload.length; i++) {
+      payload[i] = (byte)(i % 251);
+    }
+    for (boolean direct : new boolean[] { true, false }) {
+      DomainSocket socks[] = DomainSocket.socketpair();
+      try {
+        ByteBuffer out[] = new ByteBuffer[] {
+            ByteBuffer.allocateDirect(header.length),
+            ByteBuffer.wrap(new byte[0]),
+            ByteBuffer.allocateDirect(payload.length) };
+        out[0].put(header).flip();
+        out[2].put(payload).flip();
+        Assert.assertEquals(header.length + payload.length,
+            socks[0].getChannel().write(out));
+        for (ByteBuffer buf : out) {
+          Assert.assertFalse(buf.hasRemaining());
+        }
+
+        ByteBuffer in[] = direct ?
+            new ByteBuffer[] { ByteBuffer.allocateDirect(header.length),
+                ByteBuffer.allocateDirect(payload.length) } :
+            new ByteBuffer[] { ByteBuffer.allocate(header.length),
+                ByteBuffer.allocate(payload.length) };
+        socks[1].getChannel().readFully(in, 0, in.length);
+        byte readHeader[] = new byte[header.length];
+        byte readPayload[] = new byte[payload.length];
+        ((ByteBuffer)in[0].flip()).get(readHeader);
+        ((ByteBuffer)in[1].flip()).get(readPayload);
+        Assert.assertTrue(Arrays.equals(header, readHeader));
+        Assert.assertTrue(Arrays.equals(payload, readPayload));
+
+        socks[0].close();
+        in[0].clear();
+        Assert.assertEquals(-1, socks[1].getChannel().read(in, 0, 1));
+      } finally {
+        socks[0].close();
+        socks[1].close();
+      }
+    }
+  }
+
   /**
    * Run validateSocketPathSecurity
    *
@@ -0,0 +1,108 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.net.unix;
+
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
+import static org.junit.Assume.assumeTrue;
+
+import java.io.File;
+import java.io.FileDescriptor;
+import java.io.FileInputStream;
+import java.io.IOException;
+
+import org.apache.hadoop.io.nativeio.SharedFileDescriptorFactory;
+import org.apache.hadoop.net.unix.ShortCircuitStats.Op;
+import org.apache.hadoop.net.unix.ShortCircuitStats.Stats;
+import org.junit.AfterClass;
+import org.junit.BeforeClass;
+import org.junit.Test;
+
+public class TestShortCircuitStats {
+  private static TemporarySocketDirectory sockDir;
+
+  @BeforeClass
+  public static void init() {
+    sockDir = new TemporarySocketDirectory();
+    DomainSocket.disableBindPathValidation();
+  }
+
+  @AfterClass
+  public static void shutdown() throws IOException {
+    sockDir.close();
+  }
+
+  private static void assertCounted(Stats before, Op op) {
+    Stats after = ShortCircuitStats.getStats(op);
+    long[] buckets = after.getBuckets();
+    long sum = 0;
+
+    assertTrue(op + ": " + after, after.getCount() > before.getCount());
+    assertTrue(op + ": " + after,
+        after.getTotalNanos() >= after.getMaxNanos());
+    assertTrue(op + ": " + after,
+        after.getPercentileMicros(0.5) <= after.getPercentileMicros(1.0));
+    assertEquals(ShortCircuitStats.BUCKETS, buckets.length);
+    for (long bucket : buckets) {
+      sum += bucket;
+    }
+    assertEquals(op + ": " + after, after.getCount(), sum);
+  }
+
+  /**
+   * Test that setting up a short-circuit read the way the DataNode and the
+   * client do is timed, step by step.
+   */
+  @Test(timeout=180000)
+  public void testShortCircuitSetupIsTimed() throws Exception {
+    assumeTrue(ShortCircuitStats.isAvailable());
+    assumeTrue(SharedFileDescriptorFactory.getLoadingFailureReason() == null);
+
+    Stats connect = ShortCircuitStats.getStats(Op.CONNECT);
+    Stats send = ShortCircuitStats.getStats(Op.SEND_FDS);
+    Stats receive = ShortCircuitStats.getStats(Op.RECEIVE_FDS);
+    Stats shm = ShortCircuitStats.getStats(Op.SHM_ALLOC);
+
+    String path = new File(sockDir.getDir(), "test_sock").getAbsolutePath();
+    DomainSocket serv = DomainSocket.bindAndListen(path);
+    DomainSocket client = DomainSocket.connect(path);
+    DomainSocket conn = serv.accept();
+    SharedFileDescriptorFactory factory = SharedFileDescriptorFactory.create(
+        "test_shm_", new String[] { sockDir.getDir().getAbsolutePath() });
+    FileInputStream shmStream = factory.createDescriptor("test", 4096);
+    FileInputStream[] received = new FileInputStream[1];
+    byte[] buf = new byte[1];
+    try {
+      conn.sendFileDescriptors(new FileDescriptor[] { shmStream.getFD() },
+          new byte[] { 0x1 }, 0, 1);
+      assertEquals(1, client.recvFileInputStreams(received, buf, 0, 1));
+      received[0].close();
+    } finally {
+      shmStream.close();
+      factory.close();
+      conn.close();
+      client.close();
+      serv.close();
+    }
+
+    assertCounted(connect, Op.CONNECT);
+    assertCounted(send, Op.SEND_FDS);
+    assertCounted(receive, Op.RECEIVE_FDS);
+    assertCounted(shm, Op.SHM_ALLOC);
+  }
+}
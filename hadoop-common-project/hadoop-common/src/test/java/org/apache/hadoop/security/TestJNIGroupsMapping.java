@@ -21,6 +21,9 @@
 
 import java.util.Arrays;
 import java.util.List;
+
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeysPublic;
 import org.apache.hadoop.security.GroupMappingServiceProvider;
 import org.apache.hadoop.security.JniBasedUnixGroupsMapping;
 import org.apache.hadoop.security.ShellBasedUnixGroupsMapping;
@@ -49,6 +52,31 @@ public void testJNIGroupsMapping() throws Exception {
     //return an empty list
     testForUser("fooBarBaz1234DoesNotExist");
   }
+
+  @Test
+  public void testJNIGroupsMappingBatch() throws Exception {
+    String user = UserGroupInformation.getCurrentUser().getShortUserName();
+    JniBasedUnixGroupsMapping g = new JniBasedUnixGroupsMapping();
+    List<String> expected = g.getGroups(user);
+    List<List<String>> groups = g.getGroups(
+        Arrays.asList(user, "fooBarBaz1234DoesNotExist", null, user));
+    assertEquals(4, groups.size());
+    assertEquals(expected, groups.get(0));
+    assertTrue(groups.get(1).isEmpty());
+    assertTrue(groups.get(2).isEmpty());
+    assertEquals(expected, groups.get(3));
+
+    // The same groups come back with the group name cache disabled, or
+    // after it is dropped
+    Configuration conf = new Configuration();
+    conf.setLong(CommonConfigurationKeysPublic.
+        HADOOP_SECURITY_GROUPS_JNI_NAME_CACHE_SECS, 0);
+    g.setConf(conf);
+    assertEquals(expected, g.getGroups(user));
+    g.setConf(new Configuration());
+    g.cacheGroupsRefresh();
+    assertEquals(expected, g.getGroups(user));
+  }
   private void testForUser(String user) throws Exception {
     GroupMappingServiceProvider g = new ShellBasedUnixGroupsMapping();
     List<String> shellBasedGroups = g.getGroups(user);
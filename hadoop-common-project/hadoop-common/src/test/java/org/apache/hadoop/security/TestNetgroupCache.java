@@ -17,10 +17,15 @@
 package org.apache.hadoop.security;
 
 import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertFalse;
 import static org.junit.Assert.assertTrue;
 
 import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.HashMap;
 import java.util.List;
+import java.util.Map;
 
 import org.junit.After;
 import org.junit.Test;
@@ -109,6 +114,29 @@ public void testGroupRemoval() {
     verifyGroupMembership(USER3, 0, null);
   }
 
+  /**
+   * Cache two groups, then update the users of one of them.
+   * Test that the other group is left alone, and that a group without
+   * users is still cached.
+   */
+  @Test
+  public void testUpdate() {
+    NetgroupCache.add(GROUP1, Arrays.asList(USER1, USER2));
+    NetgroupCache.add(GROUP2, Arrays.asList(USER1, USER3));
+    Map<String, List<String>> update = new HashMap<String, List<String>>();
+    update.put(GROUP1, Arrays.asList(USER3));
+    update.put("group3", Collections.<String>emptyList());
+    NetgroupCache.update(update);
+    verifyGroupMembership(USER1, 1, GROUP2);
+    verifyGroupMembership(USER2, 0, null);
+    verifyGroupMembership(USER3, 2, GROUP1);
+    verifyGroupMembership(USER3, 2, GROUP2);
+    assertTrue(NetgroupCache.isCached("group3"));
+    assertEquals(3, NetgroupCache.getNetgroupNames().size());
+    NetgroupCache.clear();
+    assertFalse(NetgroupCache.isCached(GROUP1));
+  }
+
   private void verifyGroupMembership(String user, int size, String group) {
     List<String> groups = new ArrayList<String>();
     NetgroupCache.getNetgroups(user, groups);
@@ -112,6 +112,24 @@ public void testVerifyChunkedSumsSuccessOddSize() throws ChecksumException {
     bytesPerChecksum++;
   }
 
+  @Test
+  public void testVerifyChunkedSumsScatteredSuccess()
+      throws ChecksumException {
+    allocateDirectByteBuffers();
+    fillDataAndValidChecksums();
+    NativeCrc32.verifyChunkedSumsScattered(bytesPerChecksum, checksumType.id,
+      checksums, splitData(), fileName, BASE_POSITION);
+  }
+
+  @Test
+  public void testVerifyChunkedSumsScatteredFail() throws ChecksumException {
+    allocateDirectByteBuffers();
+    fillDataAndInvalidChecksums();
+    exception.expect(ChecksumException.class);
+    NativeCrc32.verifyChunkedSumsScattered(bytesPerChecksum, checksumType.id,
+      checksums, splitData(), fileName, BASE_POSITION);
+  }
+
   @Test
   public void testVerifyChunkedSumsByteArraySuccess() throws ChecksumException {
     allocateArrayByteBuffers();
@@ -147,6 +165,18 @@ public void testCalculateChunkedSumsFail() throws ChecksumException {
       checksums, data);
   }
 
+  @Test
+  public void testCopyAndCalculateChunkedSums() throws ChecksumException {
+    allocateDirectByteBuffers();
+    fillDataAndValidChecksums();
+    ByteBuffer copy = ByteBuffer.allocateDirect(data.remaining());
+    ByteBuffer sums = ByteBuffer.allocateDirect(checksums.remaining());
+    NativeCrc32.copyAndCalculateChunkedSums(bytesPerChecksum,
+      checksumType.id, sums, data, copy);
+    assertEquals(data, copy);
+    assertEquals(checksums, sums);
+  }
+
   @Test
   public void testCalculateChunkedSumsByteArraySuccess() throws ChecksumException {
     allocateArrayByteBuffers();
@@ -186,6 +216,18 @@ public void testNativeVerifyChunkedSumsFail() throws ChecksumException {
       fileName, BASE_POSITION);
   }
 
+  /**
+   * Splits the data buffer into a buffer of one chunk and a buffer of the
+   * other chunks.
+   */
+  private ByteBuffer[] splitData() {
+    ByteBuffer first = data.duplicate();
+    first.limit(first.position() + bytesPerChecksum);
+    ByteBuffer rest = data.duplicate();
+    rest.position(first.limit());
+    return new ByteBuffer[] { first, rest };
+  }
+
   /**
    * Allocates data buffer and checksums buffer as arrays on the heap.
    */
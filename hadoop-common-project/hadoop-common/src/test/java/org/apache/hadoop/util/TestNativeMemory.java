@@ -0,0 +1,52 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.util;
+
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
+import static org.junit.Assume.assumeTrue;
+
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.io.compress.zlib.ZlibCompressor;
+import org.apache.hadoop.io.compress.zlib.ZlibFactory;
+import org.apache.hadoop.util.NativeMemory.Subsystem;
+import org.junit.Test;
+
+public class TestNativeMemory {
+
+  @Test
+  public void testCodecMemory() {
+    assumeTrue(NativeMemory.isAvailable());
+    assumeTrue(ZlibFactory.isNativeZlibLoaded(new Configuration()));
+
+    long before = NativeMemory.getStats(Subsystem.CODEC).getCurrentBytes();
+    ZlibCompressor compressor = new ZlibCompressor();
+    NativeMemory.Stats during = NativeMemory.getStats(Subsystem.CODEC);
+    // deflate keeps a 32k window, and more, for the stream
+    assertTrue(during.toString(),
+        during.getCurrentBytes() - before >= 32 * 1024);
+    assertTrue(during.toString(),
+        during.getPeakBytes() >= during.getCurrentBytes());
+    assertTrue(NativeMemory.getTotalStats().getPeakBytes() >=
+        during.getCurrentBytes());
+
+    compressor.end();
+    assertEquals(before,
+        NativeMemory.getStats(Subsystem.CODEC).getCurrentBytes());
+  }
+}
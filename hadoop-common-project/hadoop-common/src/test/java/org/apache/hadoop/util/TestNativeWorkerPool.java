@@ -0,0 +1,80 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.apache.hadoop.util;
+
+import static org.junit.Assert.assertArrayEquals;
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
+import static org.junit.Assume.assumeTrue;
+
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.Random;
+import java.util.zip.GZIPOutputStream;
+
+import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.io.compress.zlib.ZlibDecompressor;
+import org.apache.hadoop.io.compress.zlib.ZlibFactory;
+import org.junit.Test;
+
+public class TestNativeWorkerPool {
+
+  @Test
+  public void testStats() throws IOException {
+    assumeTrue(NativeWorkerPool.isAvailable());
+    assumeTrue(ZlibFactory.isNativeZlibLoaded(new Configuration()));
+
+    // Concatenated gzip members are inflated on the pool
+    ByteArrayOutputStream raw = new ByteArrayOutputStream();
+    ByteArrayOutputStream gz = new ByteArrayOutputStream();
+    Random random = new Random(1);
+    int numMembers = 16;
+    for (int i = 0; i < numMembers; i++) {
+      byte[] data = new byte[64 * 1024];
+      for (int j = 0; j < data.length; j++) {
+        data[j] = (byte) ('a' + random.nextInt(8));
+      }
+      GZIPOutputStream out = new GZIPOutputStream(gz);
+      out.write(data);
+      out.finish();
+      raw.write(data);
+    }
+    ByteBuffer src = ByteBuffer.allocateDirect(gz.size());
+    src.put(gz.toByteArray()).flip();
+    int[] members = ZlibDecompressor.indexGzipMembers(src);
+
+    NativeWorkerPool.Stats before = NativeWorkerPool.getStats();
+    byte[] uncompressed =
+        ZlibDecompressor.inflateGzipMembers(src.duplicate(), members, 4);
+    NativeWorkerPool.Stats after = NativeWorkerPool.getStats();
+    assertArrayEquals(raw.toByteArray(), uncompressed);
+
+    assertTrue(after.toString(), after.getMaxWorkers() >= 0);
+    assertTrue(after.toString(),
+        after.getWorkers() <= after.getMaxWorkers());
+    assertTrue(after.toString(),
+        after.getWorkers() >= before.getWorkers());
+    assertTrue(after.toString(),
+        after.getTasksRun() - before.getTasksRun() >= numMembers);
+    assertTrue(after.toString(),
+        after.getBusyNanos() > before.getBusyNanos());
+    // Nothing is left queued once every caller has returned
+    assertEquals(after.toString(), 0, after.getQueuedTasks());
+  }
+}
@@ -138,6 +138,22 @@ public void refreshAndCpuUsageMulticore() throws InterruptedException {
                  tester.getNumVCoresUsed(), 0.0);
   }
 
+  @Test(timeout = 10000)
+  public void parseStreamedSystemInfoString() {
+    SysInfoWindowsMock tester = new SysInfoWindowsMock();
+    // 2 cores busy for 500 and 250 ms in a 1000 ms interval
+    tester.setSysinfoString(
+        "17177038848,8589467648,15232745472,6400417792,2,2805000,6261812," +
+        "1234567,2345678,3456789,4567890,1000,10,20,30,40,500,250");
+    assertEquals(6400417792L, tester.getAvailablePhysicalMemorySize());
+    assertEquals(2, tester.getNumProcessors());
+    assertEquals(6261812L, tester.getCumulativeCpuTime());
+    assertEquals(4567890L, tester.getNetworkBytesWritten());
+    // available on the first call, without a previous sample
+    assertEquals(75F / 2, tester.getCpuUsagePercentage(), 0.0);
+    assertEquals(0.75F, tester.getNumVCoresUsed(), 0.0);
+  }
+
   @Test(timeout = 10000)
   public void errorInGetSystemInfo() {
     SysInfoWindowsMock tester = new SysInfoWindowsMock();
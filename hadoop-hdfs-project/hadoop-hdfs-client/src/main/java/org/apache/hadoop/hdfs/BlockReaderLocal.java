@@ -17,6 +17,7 @@
  */
 package org.apache.hadoop.hdfs;
 
+import java.io.FileInputStream;
 import java.io.IOException;
 import java.nio.ByteBuffer;
 import java.nio.channels.FileChannel;
@@ -684,6 +685,27 @@ public ClientMmap getClientMmap(EnumSet<ReadOption> opts) {
     return clientMmap;
   }
 
+  /**
+   * Get the block data file of the replica, for callers that read or map
+   * it themselves. As for {@link #getClientMmap}, the data is not verified,
+   * so this needs SKIP_CHECKSUMS or a reader that does not verify checksums,
+   * unless the replica is on transient storage, which has no checksums.
+   *
+   * @param opts          The read options to use.
+   * @return              The data file, or null if checksums are required.
+   *                      It stays owned by the replica.
+   */
+  FileInputStream getDataStream(EnumSet<ReadOption> opts) {
+    if (verifyChecksum && !opts.contains(ReadOption.SKIP_CHECKSUMS) &&
+        (storageType == null || !storageType.isTransient())) {
+      LOG.trace("can't hand out the data file of {} of {} since "
+          + "SKIP_CHECKSUMS was not given and we aren't skipping checksums.",
+          block, filename);
+      return null;
+    }
+    return replica.getDataStream();
+  }
+
   @VisibleForTesting
   boolean getVerifyChecksum() {
     return this.verifyChecksum;
@@ -18,6 +18,8 @@
 package org.apache.hadoop.hdfs;
 
 import java.io.EOFException;
+import java.io.FileDescriptor;
+import java.io.FileInputStream;
 import java.io.IOException;
 import java.net.InetSocketAddress;
 import java.nio.ByteBuffer;
@@ -44,6 +46,7 @@
 
 import org.apache.commons.io.IOUtils;
 import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.fs.ByteBufferPositionedReadable;
 import org.apache.hadoop.fs.ByteBufferReadable;
 import org.apache.hadoop.fs.ByteBufferUtil;
 import org.apache.hadoop.fs.CanSetDropBehind;
@@ -92,7 +95,7 @@
 @InterfaceAudience.Private
 public class DFSInputStream extends FSInputStream
     implements ByteBufferReadable, CanSetDropBehind, CanSetReadahead,
-    HasEnhancedByteBufferAccess, CanUnbuffer {
+    HasEnhancedByteBufferAccess, CanUnbuffer, ByteBufferPositionedReadable {
   @VisibleForTesting
   public static boolean tcpReadsDisabledForTesting = false;
   private long hedgedReadOpsLoopNumForTesting = 0;
@@ -466,6 +469,44 @@ synchronized public ExtendedBlock getCurrentBlock() {
     return currentLocatedBlock.getBlock();
   }
 
+  /**
+   * Returns the local block data file the block at the current position is
+   * read from through short-circuit local reads, so native clients can map
+   * the replica directly. The descriptor stays owned by the stream's block
+   * reader and is only valid until the stream moves to another block or is
+   * closed, callers that keep it must duplicate it right away. The data is
+   * not checksummed, like that of zero-copy reads.
+   *
+   * @param opts    SKIP_CHECKSUMS is needed unless the stream does not
+   *                verify checksums anyway.
+   * @param range   Set to the offset in the descriptor of the current
+   *                position and the number of bytes left in the block.
+   * @return        The descriptor, or null if the block is not read through
+   *                short-circuit reads or checksums are required.
+   */
+  public synchronized FileDescriptor getShortCircuitFileDescriptor(
+      EnumSet<ReadOption> opts, long[] range) throws IOException {
+    if (pos >= getFileLength()) {
+      return null;
+    }
+    if ((blockReader == null) || (blockEnd == -1) || (pos > blockEnd)) {
+      if ((!seekToBlockSource(pos)) || (blockReader == null)) {
+        return null;
+      }
+    }
+    if (!(blockReader instanceof BlockReaderLocal)) {
+      return null;
+    }
+    FileInputStream dataStream =
+        ((BlockReaderLocal) blockReader).getDataStream(opts);
+    if (dataStream == null) {
+      return null;
+    }
+    range[0] = pos - currentLocatedBlock.getStartOffset();
+    range[1] = blockEnd - pos + 1;
+    return dataStream.getFD();
+  }
+
   /**
    * Return collection of blocks that has already been located.
    */
@@ -1436,6 +1477,41 @@ public int read(long position, byte[] buffer, int offset, int length)
     }
   }
 
+  /**
+   * Read bytes starting from the specified position into a ByteBuffer.
+   * Heap buffers are read into directly, direct buffers (such as the
+   * ones libhdfs wraps around native memory) are filled through a heap copy.
+   */
+  @Override
+  public int read(long position, ByteBuffer buf) throws IOException {
+    if (!buf.hasRemaining()) {
+      return 0;
+    }
+    int length = buf.remaining();
+    try (TraceScope scope = dfsClient.
+        newReaderTraceScope("DFSInputStream#byteBufferPread",
+            src, position, length)) {
+      int retLen;
+      if (buf.hasArray()) {
+        retLen = pread(position, buf.array(),
+            buf.arrayOffset() + buf.position(), length);
+        if (retLen > 0) {
+          buf.position(buf.position() + retLen);
+        }
+      } else {
+        byte[] tmp = new byte[length];
+        retLen = pread(position, tmp, 0, length);
+        if (retLen > 0) {
+          buf.put(tmp, 0, retLen);
+        }
+      }
+      if (retLen < length) {
+        dfsClient.addRetLenToReaderScope(scope, retLen);
+      }
+      return retLen;
+    }
+  }
+
   private int pread(long position, byte[] buffer, int offset, int length)
       throws IOException {
     // sanity checks
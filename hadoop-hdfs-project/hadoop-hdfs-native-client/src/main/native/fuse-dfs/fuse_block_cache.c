@@ -0,0 +1,654 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuse_block_cache.h"
+#include "fuse_stats.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The cache is split into shards by the hash of the chunk key, each with its
+ * own lock, hash table, LRU list and share of the capacity, so that readers
+ * of different chunks rarely wait for each other.
+ */
+#define FUSE_CACHE_SHARDS 16
+
+/** How many reads in a row must follow each other before prefetching. */
+#define FUSE_CACHE_SEQUENTIAL_READS 2
+
+struct fuseCacheChunk {
+  // Next chunk in the same hash bucket
+  struct fuseCacheChunk *hashNext;
+  // Neighbours in the LRU list of the shard, most recently used first
+  struct fuseCacheChunk *lruPrev;
+  struct fuseCacheChunk *lruNext;
+  uint32_t hash;
+  char *path;
+  tTime mtime;
+  tOffset fileSize;
+  uint64_t index;
+  // One reference is held by the shard while the chunk is cached, one by a
+  // prefetch filling it, and one by each reader copying out of it.  The
+  // reference count and the flags are protected by the shard lock.
+  int refs;
+  // Set while the chunk is in the hash table and LRU list
+  int cached;
+  // Set while a prefetch is filling the chunk
+  int loading;
+  // Set if the prefetch failed, in which case readers read it themselves
+  int failed;
+  // Bytes of file data in the chunk, less than FUSE_CACHE_CHUNK_SIZE only
+  // for the last chunk of the file
+  size_t length;
+  char data[1];
+};
+
+struct fuseCacheShard {
+  pthread_mutex_t lock;
+  // Broadcast when a prefetch completes
+  pthread_cond_t loaded;
+  struct fuseCacheChunk **buckets;
+  uint32_t numBuckets;
+  struct fuseCacheChunk *lruHead;
+  struct fuseCacheChunk *lruTail;
+  size_t used;
+  size_t capacity;
+};
+
+struct fuseBlockCache {
+  int readahead;
+  struct fuseCacheShard shards[FUSE_CACHE_SHARDS];
+};
+
+/** The cookie of a prefetch. */
+struct fuseCachePrefetch {
+  struct fuseBlockCache *cache;
+  struct fuseCacheFile *id;
+  struct fuseCacheChunk *chunk;
+};
+
+static uint32_t fuseCacheHash(const char *path, tTime mtime, tOffset size,
+                              uint64_t index)
+{
+  // FNV-1a over the path, with the numeric parts of the key mixed in
+  uint32_t hash = 2166136261U;
+  uint64_t mix;
+
+  for (; *path; path++) {
+    hash = (hash ^ (unsigned char)*path) * 16777619U;
+  }
+  mix = ((uint64_t)mtime * 31 + (uint64_t)size) * 31 + index;
+  hash = (hash ^ (uint32_t)mix) * 16777619U;
+  hash = (hash ^ (uint32_t)(mix >> 32)) * 16777619U;
+  return hash;
+}
+
+static struct fuseCacheShard *fuseCacheShardOf(struct fuseBlockCache *cache,
+                                               uint32_t hash)
+{
+  return &cache->shards[hash % FUSE_CACHE_SHARDS];
+}
+
+static struct fuseCacheChunk **fuseCacheBucket(struct fuseCacheShard *shard,
+                                               uint32_t hash)
+{
+  return &shard->buckets[(hash / FUSE_CACHE_SHARDS) % shard->numBuckets];
+}
+
+static void fuseCacheChunkFree(struct fuseCacheChunk *chunk)
+{
+  free(chunk->path);
+  free(chunk);
+}
+
+/** Drop a reference, called with the shard lock held. */
+static void fuseCacheChunkUnref(struct fuseCacheChunk *chunk)
+{
+  if (--chunk->refs == 0) {
+    fuseCacheChunkFree(chunk);
+  }
+}
+
+static void fuseCacheLruUnlink(struct fuseCacheShard *shard,
+                               struct fuseCacheChunk *chunk)
+{
+  if (chunk->lruPrev) {
+    chunk->lruPrev->lruNext = chunk->lruNext;
+  } else {
+    shard->lruHead = chunk->lruNext;
+  }
+  if (chunk->lruNext) {
+    chunk->lruNext->lruPrev = chunk->lruPrev;
+  } else {
+    shard->lruTail = chunk->lruPrev;
+  }
+  chunk->lruPrev = NULL;
+  chunk->lruNext = NULL;
+}
+
+static void fuseCacheLruPush(struct fuseCacheShard *shard,
+                             struct fuseCacheChunk *chunk)
+{
+  chunk->lruPrev = NULL;
+  chunk->lruNext = shard->lruHead;
+  if (shard->lruHead) {
+    shard->lruHead->lruPrev = chunk;
+  } else {
+    shard->lruTail = chunk;
+  }
+  shard->lruHead = chunk;
+}
+
+/** Remove a chunk from the shard, called with the shard lock held. */
+static void fuseCacheEvict(struct fuseCacheShard *shard,
+                           struct fuseCacheChunk *chunk)
+{
+  struct fuseCacheChunk **link;
+
+  for (link = fuseCacheBucket(shard, chunk->hash); *link;
+       link = &(*link)->hashNext) {
+    if (*link == chunk) {
+      *link = chunk->hashNext;
+      break;
+    }
+  }
+  fuseCacheLruUnlink(shard, chunk);
+  shard->used -= FUSE_CACHE_CHUNK_SIZE;
+  chunk->cached = 0;
+  fuseCacheChunkUnref(chunk);
+}
+
+/** Add a chunk to the shard, called with the shard lock held. */
+static void fuseCacheInsert(struct fuseCacheShard *shard,
+                            struct fuseCacheChunk *chunk)
+{
+  struct fuseCacheChunk **bucket;
+
+  while (shard->lruTail &&
+         shard->used + FUSE_CACHE_CHUNK_SIZE > shard->capacity) {
+    fuseCacheEvict(shard, shard->lruTail);
+  }
+  bucket = fuseCacheBucket(shard, chunk->hash);
+  chunk->hashNext = *bucket;
+  *bucket = chunk;
+  fuseCacheLruPush(shard, chunk);
+  shard->used += FUSE_CACHE_CHUNK_SIZE;
+  chunk->cached = 1;
+  chunk->refs++;
+}
+
+/** Find a chunk, called with the shard lock held. */
+static struct fuseCacheChunk *fuseCacheFind(struct fuseCacheShard *shard,
+    uint32_t hash, const struct fuseCacheFile *id, uint64_t index)
+{
+  struct fuseCacheChunk *chunk;
+
+  for (chunk = *fuseCacheBucket(shard, hash); chunk;
+       chunk = chunk->hashNext) {
+    if (chunk->hash == hash && chunk->index == index &&
+        chunk->mtime == id->mtime && chunk->fileSize == id->size &&
+        !strcmp(chunk->path, id->path)) {
+      return chunk;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Find a chunk and take a reference to it, waiting for it if it is being
+ * prefetched.  Called with the shard lock held.
+ *
+ * @return              The chunk, or NULL if it is not cached or its
+ *                      prefetch failed.
+ */
+static struct fuseCacheChunk *fuseCacheLookup(struct fuseCacheShard *shard,
+    uint32_t hash, const struct fuseCacheFile *id, uint64_t index)
+{
+  struct fuseCacheChunk *chunk;
+
+  chunk = fuseCacheFind(shard, hash, id, index);
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->refs++;
+  while (chunk->loading) {
+    pthread_cond_wait(&shard->loaded, &shard->lock);
+  }
+  if (chunk->failed) {
+    fuseCacheChunkUnref(chunk);
+    return NULL;
+  }
+  if (chunk->cached) {
+    fuseCacheLruUnlink(shard, chunk);
+    fuseCacheLruPush(shard, chunk);
+  }
+  return chunk;
+}
+
+static struct fuseCacheChunk *fuseCacheChunkAlloc(
+    const struct fuseCacheFile *id, uint32_t hash, uint64_t index)
+{
+  struct fuseCacheChunk *chunk;
+
+  chunk = malloc(sizeof(*chunk) + FUSE_CACHE_CHUNK_SIZE);
+  if (!chunk) {
+    return NULL;
+  }
+  memset(chunk, 0, sizeof(*chunk));
+  chunk->path = strdup(id->path);
+  if (!chunk->path) {
+    free(chunk);
+    return NULL;
+  }
+  chunk->hash = hash;
+  chunk->mtime = id->mtime;
+  chunk->fileSize = id->size;
+  chunk->index = index;
+  return chunk;
+}
+
+static int fuseCacheLoad(hdfsFS fs, hdfsFile file,
+                         const struct fuseCacheFile *id, uint32_t hash,
+                         uint64_t index, struct fuseCacheChunk **out)
+{
+  struct fuseCacheChunk *chunk;
+  tOffset start = (tOffset)index * FUSE_CACHE_CHUNK_SIZE;
+  tSize num_read;
+
+  chunk = fuseCacheChunkAlloc(id, hash, index);
+  if (!chunk) {
+    return ENOMEM;
+  }
+  while (chunk->length < FUSE_CACHE_CHUNK_SIZE) {
+    num_read = hdfsPread(fs, file, start + chunk->length,
+                         chunk->data + chunk->length,
+                         FUSE_CACHE_CHUNK_SIZE - chunk->length);
+    if (num_read < 0) {
+      fuseCacheChunkFree(chunk);
+      return EIO;
+    }
+    if (num_read == 0) {
+      break;
+    }
+    chunk->length += num_read;
+  }
+  *out = chunk;
+  return 0;
+}
+
+/**
+ * Get a chunk of a file, reading it from HDFS if it is not cached.  The
+ * caller must release the chunk with fuseCacheRelease.
+ */
+static int fuseCacheGet(struct fuseBlockCache *cache, hdfsFS fs,
+                        hdfsFile file, const struct fuseCacheFile *id,
+                        uint64_t index, struct fuseCacheChunk **out)
+{
+  uint32_t hash = fuseCacheHash(id->path, id->mtime, id->size, index);
+  struct fuseCacheShard *shard = fuseCacheShardOf(cache, hash);
+  struct fuseCacheChunk *chunk, *fresh;
+  int ret;
+
+  pthread_mutex_lock(&shard->lock);
+  chunk = fuseCacheLookup(shard, hash, id, index);
+  pthread_mutex_unlock(&shard->lock);
+  if (chunk) {
+    fuseStatsCount(FUSE_STATS_CACHE_HITS, 1);
+    *out = chunk;
+    return 0;
+  }
+  fuseStatsCount(FUSE_STATS_CACHE_MISSES, 1);
+
+  // Read without the lock.  Two readers missing on the same chunk both
+  // read it, and the second one uses the chunk the first cached.
+  ret = fuseCacheLoad(fs, file, id, hash, index, &fresh);
+  if (ret) {
+    return ret;
+  }
+  pthread_mutex_lock(&shard->lock);
+  chunk = fuseCacheLookup(shard, hash, id, index);
+  if (chunk) {
+    pthread_mutex_unlock(&shard->lock);
+    fuseCacheChunkFree(fresh);
+    *out = chunk;
+    return 0;
+  }
+  fresh->refs = 1;
+  fuseCacheInsert(shard, fresh);
+  pthread_mutex_unlock(&shard->lock);
+  *out = fresh;
+  return 0;
+}
+
+static void fuseCacheRelease(struct fuseBlockCache *cache,
+                             struct fuseCacheChunk *chunk)
+{
+  struct fuseCacheShard *shard = fuseCacheShardOf(cache, chunk->hash);
+
+  pthread_mutex_lock(&shard->lock);
+  fuseCacheChunkUnref(chunk);
+  pthread_mutex_unlock(&shard->lock);
+}
+
+static void fuseCachePrefetchDone(tSize ret, int error, void *cookie)
+{
+  struct fuseCachePrefetch *prefetch = cookie;
+  struct fuseCacheChunk *chunk = prefetch->chunk;
+  struct fuseCacheFile *id = prefetch->id;
+  struct fuseCacheShard *shard = fuseCacheShardOf(prefetch->cache,
+                                                  chunk->hash);
+  tOffset start = (tOffset)chunk->index * FUSE_CACHE_CHUNK_SIZE;
+
+  pthread_mutex_lock(&shard->lock);
+  // A single pread may stop short of the end of the chunk.  Rather than
+  // caching a chunk that looks like the end of the file, let readers read
+  // it themselves.
+  if (ret < 0 || (ret < FUSE_CACHE_CHUNK_SIZE && start + ret < id->size)) {
+    chunk->failed = 1;
+    if (chunk->cached) {
+      fuseCacheEvict(shard, chunk);
+    }
+  } else {
+    chunk->length = ret;
+  }
+  chunk->loading = 0;
+  pthread_cond_broadcast(&shard->loaded);
+  fuseCacheChunkUnref(chunk);
+  pthread_mutex_unlock(&shard->lock);
+
+  pthread_mutex_lock(&id->lock);
+  if (--id->pendingPrefetches == 0) {
+    pthread_cond_broadcast(&id->idle);
+  }
+  pthread_mutex_unlock(&id->lock);
+  free(prefetch);
+}
+
+/**
+ * Start filling a chunk in the background, unless it is already cached.
+ * The caller has counted the prefetch in id->pendingPrefetches.
+ */
+static void fuseCacheStartPrefetch(struct fuseBlockCache *cache, hdfsFS fs,
+                                   hdfsFile file, struct fuseCacheFile *id,
+                                   uint64_t index)
+{
+  uint32_t hash = fuseCacheHash(id->path, id->mtime, id->size, index);
+  struct fuseCacheShard *shard = fuseCacheShardOf(cache, hash);
+  struct fuseCachePrefetch *prefetch;
+  struct fuseCacheChunk *chunk = NULL;
+
+  prefetch = malloc(sizeof(*prefetch));
+  chunk = fuseCacheChunkAlloc(id, hash, index);
+  if (!prefetch || !chunk) {
+    goto skip;
+  }
+  pthread_mutex_lock(&shard->lock);
+  if (fuseCacheFind(shard, hash, id, index)) {
+    pthread_mutex_unlock(&shard->lock);
+    goto skip;
+  }
+  // One reference for the cache, one for the prefetch
+  chunk->loading = 1;
+  chunk->refs = 1;
+  fuseCacheInsert(shard, chunk);
+  pthread_mutex_unlock(&shard->lock);
+  fuseStatsCount(FUSE_STATS_CACHE_PREFETCHES, 1);
+
+  prefetch->cache = cache;
+  prefetch->id = id;
+  prefetch->chunk = chunk;
+  if (hdfsPreadAsync(fs, file, (tOffset)index * FUSE_CACHE_CHUNK_SIZE,
+                     chunk->data, FUSE_CACHE_CHUNK_SIZE,
+                     fuseCachePrefetchDone, prefetch)) {
+    // Most likely the queue is full; readers will read the chunk themselves
+    fuseCachePrefetchDone(-1, errno, prefetch);
+  }
+  return;
+
+skip:
+  free(prefetch);
+  if (chunk) {
+    fuseCacheChunkFree(chunk);
+  }
+  pthread_mutex_lock(&id->lock);
+  if (--id->pendingPrefetches == 0) {
+    pthread_cond_broadcast(&id->idle);
+  }
+  pthread_mutex_unlock(&id->lock);
+}
+
+/**
+ * Note a read of a handle, and prefetch the chunks after it if the reads of
+ * the handle are sequential.
+ */
+static void fuseCacheReadAhead(struct fuseBlockCache *cache, hdfsFS fs,
+                               hdfsFile file, struct fuseCacheFile *id,
+                               off_t offset, size_t length)
+{
+  uint64_t next, last, end, index;
+
+  if (!cache->readahead) {
+    return;
+  }
+  next = (offset + length + FUSE_CACHE_CHUNK_SIZE - 1) /
+      FUSE_CACHE_CHUNK_SIZE;
+  end = (id->size + FUSE_CACHE_CHUNK_SIZE - 1) / FUSE_CACHE_CHUNK_SIZE;
+  last = next + cache->readahead;
+  if (last > end) {
+    last = end;
+  }
+  pthread_mutex_lock(&id->lock);
+  if (offset == id->nextOffset) {
+    id->sequentialReads++;
+  } else {
+    id->sequentialReads = 0;
+    id->prefetchedTo = 0;
+  }
+  id->nextOffset = offset + length;
+  if (id->sequentialReads < FUSE_CACHE_SEQUENTIAL_READS) {
+    pthread_mutex_unlock(&id->lock);
+    return;
+  }
+  if (next < id->prefetchedTo) {
+    next = id->prefetchedTo;
+  }
+  if (next >= last) {
+    pthread_mutex_unlock(&id->lock);
+    return;
+  }
+  id->prefetchedTo = last;
+  id->pendingPrefetches += last - next;
+  pthread_mutex_unlock(&id->lock);
+  for (index = next; index < last; index++) {
+    fuseCacheStartPrefetch(cache, fs, file, id, index);
+  }
+}
+
+int fuseCacheFileInit(struct fuseCacheFile *id, const char *path,
+                      tTime mtime, tOffset size)
+{
+  memset(id, 0, sizeof(*id));
+  if (pthread_mutex_init(&id->lock, NULL)) {
+    return ENOMEM;
+  }
+  if (pthread_cond_init(&id->idle, NULL)) {
+    pthread_mutex_destroy(&id->lock);
+    return ENOMEM;
+  }
+  id->path = strdup(path);
+  if (!id->path) {
+    pthread_cond_destroy(&id->idle);
+    pthread_mutex_destroy(&id->lock);
+    return ENOMEM;
+  }
+  id->mtime = mtime;
+  id->size = size;
+  return 0;
+}
+
+void fuseCacheFileDestroy(struct fuseCacheFile *id)
+{
+  if (!id->path) {
+    return;
+  }
+  pthread_mutex_lock(&id->lock);
+  while (id->pendingPrefetches > 0) {
+    pthread_cond_wait(&id->idle, &id->lock);
+  }
+  pthread_mutex_unlock(&id->lock);
+  pthread_cond_destroy(&id->idle);
+  pthread_mutex_destroy(&id->lock);
+  free(id->path);
+  id->path = NULL;
+}
+
+int fuseBlockCacheAlloc(size_t capacity, int readahead,
+                        struct fuseBlockCache **out)
+{
+  struct fuseBlockCache *cache;
+  struct fuseCacheShard *shard;
+  size_t shardCapacity;
+  int i;
+
+  cache = calloc(1, sizeof(*cache));
+  if (!cache) {
+    return ENOMEM;
+  }
+  cache->readahead = readahead;
+  shardCapacity = capacity / FUSE_CACHE_SHARDS;
+  if (shardCapacity < FUSE_CACHE_CHUNK_SIZE) {
+    shardCapacity = FUSE_CACHE_CHUNK_SIZE;
+  }
+  for (i = 0; i < FUSE_CACHE_SHARDS; i++) {
+    shard = &cache->shards[i];
+    shard->capacity = shardCapacity;
+    // About two buckets for each chunk the shard can hold
+    shard->numBuckets = (shardCapacity / FUSE_CACHE_CHUNK_SIZE) * 2 + 1;
+    shard->buckets = calloc(shard->numBuckets,
+                            sizeof(struct fuseCacheChunk *));
+    if (!shard->buckets || pthread_mutex_init(&shard->lock, NULL)) {
+      free(shard->buckets);
+      shard->buckets = NULL;
+      fuseBlockCacheFree(cache);
+      return ENOMEM;
+    }
+    if (pthread_cond_init(&shard->loaded, NULL)) {
+      pthread_mutex_destroy(&shard->lock);
+      free(shard->buckets);
+      shard->buckets = NULL;
+      fuseBlockCacheFree(cache);
+      return ENOMEM;
+    }
+  }
+  *out = cache;
+  return 0;
+}
+
+void fuseBlockCacheFree(struct fuseBlockCache *cache)
+{
+  struct fuseCacheShard *shard;
+  int i;
+
+  for (i = 0; i < FUSE_CACHE_SHARDS; i++) {
+    shard = &cache->shards[i];
+    if (!shard->buckets) {
+      break;
+    }
+    while (shard->lruHead) {
+      fuseCacheEvict(shard, shard->lruHead);
+    }
+    free(shard->buckets);
+    pthread_cond_destroy(&shard->loaded);
+    pthread_mutex_destroy(&shard->lock);
+  }
+  free(cache);
+}
+
+ssize_t fuseBlockCacheRead(struct fuseBlockCache *cache, hdfsFS fs,
+                           hdfsFile file, struct fuseCacheFile *id,
+                           char *buf, size_t size, off_t offset)
+{
+  struct fuseCacheChunk *chunk;
+  size_t done = 0, skip, amount;
+  int ret, lastChunk;
+
+  while (done < size) {
+    ret = fuseCacheGet(cache, fs, file, id,
+                       (offset + done) / FUSE_CACHE_CHUNK_SIZE, &chunk);
+    if (ret) {
+      return -ret;
+    }
+    skip = (offset + done) % FUSE_CACHE_CHUNK_SIZE;
+    amount = 0;
+    if (skip < chunk->length) {
+      amount = chunk->length - skip;
+      if (amount > size - done) {
+        amount = size - done;
+      }
+      memcpy(buf + done, chunk->data + skip, amount);
+    }
+    lastChunk = (chunk->length < FUSE_CACHE_CHUNK_SIZE);
+    fuseCacheRelease(cache, chunk);
+    done += amount;
+    if (lastChunk) {
+      break;
+    }
+  }
+  fuseCacheReadAhead(cache, fs, file, id, offset, done);
+  return done;
+}
+
+void fuseBlockCacheInvalidate(struct fuseBlockCache *cache, const char *path)
+{
+  struct fuseCacheShard *shard;
+  struct fuseCacheChunk *chunk, *next;
+  int i;
+
+  for (i = 0; i < FUSE_CACHE_SHARDS; i++) {
+    shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    for (chunk = shard->lruHead; chunk; chunk = next) {
+      next = chunk->lruNext;
+      if (!strcmp(chunk->path, path)) {
+        fuseCacheEvict(shard, chunk);
+      }
+    }
+    pthread_mutex_unlock(&shard->lock);
+  }
+}
+
+void fuseBlockCacheUsage(struct fuseBlockCache *cache, size_t *used,
+                         size_t *capacity)
+{
+  struct fuseCacheShard *shard;
+  int i;
+
+  *used = 0;
+  *capacity = 0;
+  for (i = 0; i < FUSE_CACHE_SHARDS; i++) {
+    shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    *used += shard->used;
+    *capacity += shard->capacity;
+    pthread_mutex_unlock(&shard->lock);
+  }
+}
@@ -0,0 +1,131 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FUSE_BLOCK_CACHE_H__
+#define __FUSE_BLOCK_CACHE_H__
+
+#include <hdfs/hdfs.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** The size of the chunks files are cached in. */
+#define FUSE_CACHE_CHUNK_SIZE (128 * 1024)
+
+struct fuseBlockCache;
+
+/**
+ * The version of a file that a handle reads.  Chunks are cached under the
+ * path together with the modification time and size taken when the file was
+ * opened, so that a handle opened after the file changed elsewhere does not
+ * see chunks of the old version.
+ */
+struct fuseCacheFile {
+  char *path;
+  tTime mtime;
+  tOffset size;
+  // Protects the read-ahead state below
+  pthread_mutex_t lock;
+  // Signalled when the last prefetch of the handle completes
+  pthread_cond_t idle;
+  // Where the previous read ended
+  off_t nextOffset;
+  // How many reads in a row started where the previous one ended
+  int sequentialReads;
+  // The first chunk not prefetched yet
+  uint64_t prefetchedTo;
+  // Prefetches still reading from the handle
+  int pendingPrefetches;
+};
+
+/**
+ * Set up the cache state of a handle.
+ *
+ * @return              0 on success; error code otherwise
+ */
+int fuseCacheFileInit(struct fuseCacheFile *id, const char *path,
+                      tTime mtime, tOffset size);
+
+/**
+ * Tear down the cache state of a handle, waiting for its prefetches.  This
+ * must be called before the file is closed.  It does nothing if
+ * fuseCacheFileInit was not called.
+ */
+void fuseCacheFileDestroy(struct fuseCacheFile *id);
+
+/**
+ * Allocate a chunk cache shared by all the open files.
+ *
+ * @param capacity      The most bytes of file data to keep.
+ * @param readahead     How many chunks to prefetch ahead of sequential
+ *                      readers, 0 for none.
+ * @param out           (out param) the new cache.
+ *
+ * @return              0 on success; error code otherwise
+ */
+int fuseBlockCacheAlloc(size_t capacity, int readahead,
+                        struct fuseBlockCache **out);
+
+/**
+ * Free a chunk cache.  No reads may be in progress.
+ */
+void fuseBlockCacheFree(struct fuseBlockCache *cache);
+
+/**
+ * Read from a file through the cache.  The chunks the read covers are
+ * served from memory when cached, and read with hdfsPread and cached
+ * otherwise.  Reads run concurrently, apart from short critical sections on
+ * one of several locks.  Once reads of a handle follow each other, the
+ * chunks after them are prefetched in the background with hdfsPreadAsync,
+ * and a read reaching a chunk still being prefetched waits for it.
+ *
+ * @param cache         The cache.
+ * @param fs            The filesystem the file was opened on.
+ * @param file          The open file.
+ * @param id            The version of the file.
+ * @param buf           Where to put the data.
+ * @param size          The number of bytes to read.
+ * @param offset        Where in the file to read from.
+ *
+ * @return              The number of bytes read, short only at end-of-file,
+ *                      or a negative error code.
+ */
+ssize_t fuseBlockCacheRead(struct fuseBlockCache *cache, hdfsFS fs,
+                           hdfsFile file, struct fuseCacheFile *id,
+                           char *buf, size_t size, off_t offset);
+
+/**
+ * Drop the cached chunks of every version of a path.
+ *
+ * @param cache         The cache.
+ * @param path          The path that was modified, renamed or removed.
+ */
+void fuseBlockCacheInvalidate(struct fuseBlockCache *cache, const char *path);
+
+/**
+ * Get how much of a chunk cache is in use.
+ *
+ * @param cache         The cache.
+ * @param used          (out param) the bytes taken by cached chunks.
+ * @param capacity      (out param) the most bytes the cache keeps.
+ */
+void fuseBlockCacheUsage(struct fuseBlockCache *cache, size_t *used,
+                         size_t *capacity);
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuse_block_fd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// The block each thread last replied from
+static pthread_once_t gHeldOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t gHeldKey;
+static int gHeldKeyError;
+
+static void fuseBlockFdHeldDestroy(void *v)
+{
+  fuseBlockFdUnref(v);
+}
+
+static void fuseBlockFdHeldInit(void)
+{
+  gHeldKeyError = pthread_key_create(&gHeldKey, fuseBlockFdHeldDestroy);
+}
+
+static int fuseBlockFdErrno(void)
+{
+  return (errno == 0 || errno == EINTERNAL) ? EIO : errno;
+}
+
+int fuseBlockFdGet(hdfsFS fs, hdfsFile file, struct hadoopRzOptions *opts,
+                   off_t offset, struct fuseBlockFd **out)
+{
+  struct hadoopBlockFd blockFd;
+  struct fuseBlockFd *bfd;
+  int fd;
+
+  if (hdfsSeek(fs, file, offset)) {
+    return fuseBlockFdErrno();
+  }
+  if (hadoopGetBlockFd(file, opts, &blockFd)) {
+    return fuseBlockFdErrno();
+  }
+  // The stream closes its descriptor when it leaves the block
+  fd = fcntl(blockFd.fd, F_DUPFD_CLOEXEC, 0);
+  if (fd < 0) {
+    return errno;
+  }
+  bfd = malloc(sizeof(*bfd));
+  if (!bfd) {
+    close(fd);
+    return ENOMEM;
+  }
+  bfd->fd = fd;
+  bfd->fileOffset = offset;
+  bfd->fdOffset = blockFd.offset;
+  bfd->length = blockFd.length;
+  bfd->refs = 1;
+  *out = bfd;
+  return 0;
+}
+
+int fuseBlockFdCovers(const struct fuseBlockFd *bfd, off_t offset,
+                      size_t size)
+{
+  return offset >= bfd->fileOffset &&
+    offset + (off_t)size <= bfd->fileOffset + bfd->length;
+}
+
+void fuseBlockFdRef(struct fuseBlockFd *bfd)
+{
+  __atomic_fetch_add(&bfd->refs, 1, __ATOMIC_RELAXED);
+}
+
+void fuseBlockFdUnref(struct fuseBlockFd *bfd)
+{
+  if (bfd && __atomic_sub_fetch(&bfd->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    close(bfd->fd);
+    free(bfd);
+  }
+}
+
+int fuseBlockFdHold(struct fuseBlockFd *bfd)
+{
+  struct fuseBlockFd *prev;
+  int ret;
+
+  pthread_once(&gHeldOnce, fuseBlockFdHeldInit);
+  if (gHeldKeyError) {
+    return gHeldKeyError;
+  }
+  prev = pthread_getspecific(gHeldKey);
+  ret = pthread_setspecific(gHeldKey, bfd);
+  if (ret) {
+    return ret;
+  }
+  fuseBlockFdUnref(prev);
+  return 0;
+}
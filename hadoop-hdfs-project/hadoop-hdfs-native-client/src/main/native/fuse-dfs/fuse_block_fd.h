@@ -0,0 +1,99 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FUSE_BLOCK_FD_H__
+#define __FUSE_BLOCK_FD_H__
+
+#include <hdfs/hdfs.h>
+#include <sys/types.h>
+
+/**
+ * A duplicate of the descriptor of the local block file that a handle reads
+ * through short-circuit local reads, so that FUSE can splice the data
+ * straight from it to the kernel.
+ *
+ * FUSE only splices from a descriptor after the read hook has returned, and
+ * does not tell the hook when it is done.  So the handle keeps a reference
+ * to the block it last read from, and each read that replies from the block
+ * leaves a reference with its thread.  The thread drops it at its next
+ * fuseBlockFdHold, by which time FUSE has sent the reply, or when it exits.
+ * The descriptor is closed when the last reference goes.
+ */
+struct fuseBlockFd {
+  int fd;
+  // The offset in the file of the first byte the descriptor was handed out
+  // for, where that byte is in the descriptor, and the number of bytes of
+  // the block from there
+  off_t fileOffset;
+  off_t fdOffset;
+  off_t length;
+  // Changed with atomics
+  int refs;
+};
+
+/**
+ * Get the block that a byte of a file is read from, if it is read through
+ * short-circuit local reads.
+ *
+ * This seeks the stream, so the stream must not be shared with reads that
+ * use its position.
+ *
+ * @param fs            The connection the file was opened through.
+ * @param file          The file, opened for reading.
+ * @param opts          The options to pass to hadoopGetBlockFd.
+ * @param offset        The offset of the byte in the file.
+ * @param out           (out param) the block, with one reference for the
+ *                      caller.
+ *
+ * @return              0 on success; ENOTSUP if the byte is not read through
+ *                      short-circuit local reads, or at the end of the file;
+ *                      another error code otherwise
+ */
+int fuseBlockFdGet(hdfsFS fs, hdfsFile file, struct hadoopRzOptions *opts,
+                   off_t offset, struct fuseBlockFd **out);
+
+/**
+ * @return              1 if the block has all of the bytes from offset to
+ *                      offset + size - 1 of the file; 0 otherwise
+ */
+int fuseBlockFdCovers(const struct fuseBlockFd *bfd, off_t offset,
+                      size_t size);
+
+/**
+ * Take another reference to a block.
+ */
+void fuseBlockFdRef(struct fuseBlockFd *bfd);
+
+/**
+ * Drop a reference to a block, closing the descriptor with the last one.
+ * Does nothing with NULL.
+ */
+void fuseBlockFdUnref(struct fuseBlockFd *bfd);
+
+/**
+ * Leave a reference to a block that FUSE replies from with the calling
+ * thread, dropping the one it left there before.
+ *
+ * @param bfd           The block, or NULL to only drop the previous one.
+ *
+ * @return              0 on success; error code otherwise, in which case the
+ *                      caller keeps the reference
+ */
+int fuseBlockFdHold(struct fuseBlockFd *bfd);
+
+#endif
@@ -18,6 +18,7 @@
 
 #include "fuse_connect.h"
 #include "fuse_dfs.h"
+#include "fuse_stats.h"
 #include "fuse_users.h" 
 #include "hdfs/hdfs.h"
 #include "util/tree.h"
@@ -38,6 +39,14 @@
 #define HADOOP_SECURITY_AUTHENTICATION      "hadoop.security.authentication"
 #define HADOOP_FUSE_CONNECTION_TIMEOUT      "hadoop.fuse.connection.timeout"
 #define HADOOP_FUSE_TIMER_PERIOD            "hadoop.fuse.timer.period"
+#define LIBHDFS_STAT_CACHE_TTL              "libhdfs.stat.cache.ttl.secs"
+
+/**
+ * The connections are split into shards by the hash of the username, each
+ * with its own lock, so that FUSE operations of different users don't wait
+ * for each other, or for a user whose connection is still being made.
+ */
+#define FUSE_CONN_SHARDS                    16
 
 /** Length of the buffer needed by asctime_r */
 #define TIME_STR_LEN 26
@@ -46,6 +55,9 @@ struct hdfsConn;
 
 static int hdfsConnCompare(const struct hdfsConn *a, const struct hdfsConn *b);
 static void hdfsConnExpiry(void);
+struct hdfsConnShard;
+static void hdfsConnExpireShard(struct hdfsConnShard *shard,
+                                struct hdfsConn **freeList);
 static void* hdfsConnExpiryThread(void *v);
 
 RB_HEAD(hdfsConnTree, hdfsConn);
@@ -77,12 +89,23 @@ struct hdfsConn {
   /** Number of times we should run the expiration timer on this connection
    * before removing it. */
   int expirationCount;
+  /** The shard this connection belongs to. */
+  struct hdfsConnShard *shard;
+  /** Next connection hdfsConnExpiry frees once it dropped the shard lock */
+  struct hdfsConn *freeNext;
 };
 
 RB_GENERATE(hdfsConnTree, hdfsConn, entry, hdfsConnCompare);
 
-/** Current cached libhdfs connections */
-static struct hdfsConnTree gConnTree;
+struct hdfsConnShard {
+  /** Protects tree, and the refcnt, condemned and expirationCount of the
+   * connections in the shard */
+  pthread_mutex_t lock;
+  /** Current cached libhdfs connections of the shard */
+  struct hdfsConnTree tree;
+};
+
+static struct hdfsConnShard gConnShards[FUSE_CONN_SHARDS];
 
 /** The URI used to make our connections.  Dynamically allocated. */
 static char *gUri;
@@ -90,8 +113,9 @@ static char *gUri;
 /** The port used to make our connections, or 0. */
 static int gPort;
 
-/** Lock which protects gConnTree and gConnectTimer->active */
-static pthread_mutex_t gConnMutex;
+/** The stat cache TTL of our connections, or the empty string for none.  The
+ * builders only keep a pointer to it. */
+static char gAttrCacheTtl[16];
 
 /** Type of authentication configured */
 static enum authConf gHdfsAuthConf;
@@ -130,9 +154,9 @@ static enum authConf discoverAuthConf(void)
   return authConf;
 }
 
-int fuseConnectInit(const char *nnUri, int port)
+int fuseConnectInit(const char *nnUri, int port, int attrCacheTtl)
 {
-  int ret;
+  int i, ret;
 
   gTimerPeriod = FUSE_CONN_DEFAULT_TIMER_PERIOD;
   ret = hdfsConfGetInt(HADOOP_FUSE_TIMER_PERIOD, &gTimerPeriod);
@@ -165,23 +189,33 @@ int fuseConnectInit(const char *nnUri, int port)
     return -EINVAL;
   }
   gPort = port;
+  if (attrCacheTtl > 0) {
+    snprintf(gAttrCacheTtl, sizeof(gAttrCacheTtl), "%d", attrCacheTtl);
+  }
   gUri = strdup(nnUri);
   if (!gUri) {
     fprintf(stderr, "fuseConnectInit: OOM allocting nnUri\n");
     return -ENOMEM;
   }
-  ret = pthread_mutex_init(&gConnMutex, NULL);
-  if (ret) {
-    free(gUri);
-    fprintf(stderr, "fuseConnectInit: pthread_mutex_init failed with error %d\n",
-            ret);
-    return -ret;
+  for (i = 0; i < FUSE_CONN_SHARDS; i++) {
+    ret = pthread_mutex_init(&gConnShards[i].lock, NULL);
+    if (ret) {
+      while (i-- > 0) {
+        pthread_mutex_destroy(&gConnShards[i].lock);
+      }
+      free(gUri);
+      fprintf(stderr, "fuseConnectInit: pthread_mutex_init failed with "
+              "error %d\n", ret);
+      return -ret;
+    }
+    RB_INIT(&gConnShards[i].tree);
   }
-  RB_INIT(&gConnTree);
   ret = pthread_create(&gTimerThread, NULL, hdfsConnExpiryThread, NULL);
   if (ret) {
     free(gUri);
-    pthread_mutex_destroy(&gConnMutex);
+    for (i = 0; i < FUSE_CONN_SHARDS; i++) {
+      pthread_mutex_destroy(&gConnShards[i].lock);
+    }
     fprintf(stderr, "fuseConnectInit: pthread_create failed with error %d\n",
             ret);
     return -ret;
@@ -205,19 +239,40 @@ static int hdfsConnCompare(const struct hdfsConn *a, const struct hdfsConn *b)
 }
 
 /**
- * Find a libhdfs connection by username
+ * Get the shard the connections of a user belong to
  *
+ * @param usrname         The username
+ *
+ * @return                The shard
+ */
+static struct hdfsConnShard *hdfsConnShardOf(const char *usrname)
+{
+  uint32_t hash = 2166136261U;
+
+  // FNV-1a
+  for (; *usrname; usrname++) {
+    hash ^= (unsigned char)*usrname;
+    hash *= 16777619U;
+  }
+  return &gConnShards[hash % FUSE_CONN_SHARDS];
+}
+
+/**
+ * Find a libhdfs connection by username, called with the shard lock held
+ *
+ * @param shard           The shard of the username
  * @param usrname         The username to look up
  *
  * @return                The connection, or NULL if none could be found
  */
-static struct hdfsConn* hdfsConnFind(const char *usrname)
+static struct hdfsConn* hdfsConnFind(struct hdfsConnShard *shard,
+                                     const char *usrname)
 {
   struct hdfsConn exemplar;
 
   memset(&exemplar, 0, sizeof(exemplar));
   exemplar.usrname = (char*)usrname;
-  return RB_FIND(hdfsConnTree, &gConnTree, &exemplar);
+  return RB_FIND(hdfsConnTree, &shard->tree, &exemplar);
 }
 
 /**
@@ -240,6 +295,7 @@ static void hdfsConnFree(struct hdfsConn *conn)
   free(conn->usrname);
   free(conn->kpath);
   free(conn);
+  fuseStatsCount(FUSE_STATS_CONN_FREED, 1);
 }
 
 /**
@@ -322,20 +378,50 @@ static int hdfsConnCheckKpath(const struct hdfsConn *conn)
  * connecton is immediately condemned, even if it is currently in use.
  */
 static void hdfsConnExpiry(void)
+{
+  struct hdfsConnShard *shard;
+  struct hdfsConn *conn, *freeList;
+  int i;
+
+  for (i = 0; i < FUSE_CONN_SHARDS; i++) {
+    shard = &gConnShards[i];
+    freeList = NULL;
+    pthread_mutex_lock(&shard->lock);
+    hdfsConnExpireShard(shard, &freeList);
+    pthread_mutex_unlock(&shard->lock);
+    /* hdfsDisconnect may take a while, don't hold up the users of the
+     * shard meanwhile. */
+    while (freeList) {
+      conn = freeList;
+      freeList = conn->freeNext;
+      hdfsConnFree(conn);
+    }
+  }
+}
+
+/**
+ * Expire the connections of one shard, called with the shard lock held.
+ *
+ * @param shard     The shard
+ * @param freeList  (out param) the connections removed from the shard that
+ *                  no thread uses, to be freed once the lock is dropped
+ */
+static void hdfsConnExpireShard(struct hdfsConnShard *shard,
+                                struct hdfsConn **freeList)
 {
   struct hdfsConn *conn, *tmpConn;
 
-  pthread_mutex_lock(&gConnMutex);
-  RB_FOREACH_SAFE(conn, hdfsConnTree, &gConnTree, tmpConn) {
+  RB_FOREACH_SAFE(conn, hdfsConnTree, &shard->tree, tmpConn) {
     if (conn->kpath) {
       if (hdfsConnCheckKpath(conn)) {
         conn->condemned = 1;
-        RB_REMOVE(hdfsConnTree, &gConnTree, conn);
+        RB_REMOVE(hdfsConnTree, &shard->tree, conn);
         if (conn->refcnt == 0) {
           /* If the connection is not in use by any threads, delete it
            * immediately.  If it is still in use by some threads, the last
            * thread using it will clean it up later inside hdfsConnRelease. */
-          hdfsConnFree(conn);
+          conn->freeNext = *freeList;
+          *freeList = conn;
           continue;
         }
       }
@@ -351,12 +437,12 @@ static void hdfsConnExpiry(void)
         }
         fprintf(stderr, "hdfsConnExpiry: freeing and removing connection as "
                 "%s because it's now too old.\n", conn->usrname);
-        RB_REMOVE(hdfsConnTree, &gConnTree, conn);
-        hdfsConnFree(conn);
+        RB_REMOVE(hdfsConnTree, &shard->tree, conn);
+        conn->freeNext = *freeList;
+        *freeList = conn;
       }
     }
   }
-  pthread_mutex_unlock(&gConnMutex);
 }
 
 // The Kerberos FILE: prefix.  This indicates that the kerberos ticket cache
@@ -433,16 +519,18 @@ done:
 }
 
 /**
- * Create a new libhdfs connection.
+ * Create a new libhdfs connection, called with the shard lock held.
  *
+ * @param shard         The shard of the username, which the new connection
+ *                      is added to
  * @param usrname       Username to use for the new connection
  * @param ctx           FUSE context to use for the new connection
  * @param out           (out param) the new libhdfs connection
  *
  * @return              0 on success; error code otherwise
  */
-static int fuseNewConnect(const char *usrname, struct fuse_context *ctx,
-        struct hdfsConn **out)
+static int fuseNewConnect(struct hdfsConnShard *shard, const char *usrname,
+        struct fuse_context *ctx, struct hdfsConn **out)
 {
   struct hdfsBuilder *bld = NULL;
   char kpath[PATH_MAX] = { 0 };
@@ -473,6 +561,9 @@ static int fuseNewConnect(const char *usrname, struct fuse_context *ctx,
     hdfsBuilderSetNameNodePort(bld, gPort);
   }
   hdfsBuilderSetUserName(bld, usrname);
+  if (gAttrCacheTtl[0]) {
+    hdfsBuilderConfSetStr(bld, LIBHDFS_STAT_CACHE_TTL, gAttrCacheTtl);
+  }
   if (gHdfsAuthConf == AUTH_CONF_KERBEROS) {
     findKerbTicketCachePath(ctx, kpath, sizeof(kpath));
     if (stat(kpath, &st) < 0) {
@@ -506,7 +597,9 @@ static int fuseNewConnect(const char *usrname, struct fuse_context *ctx,
             "error code %d\n", usrname, ret);
     goto error;
   }
-  RB_INSERT(hdfsConnTree, &gConnTree, conn);
+  conn->shard = shard;
+  RB_INSERT(hdfsConnTree, &shard->tree, conn);
+  fuseStatsCount(FUSE_STATS_CONN_NEW, 1);
   *out = conn;
   return 0;
 
@@ -541,23 +634,26 @@ static int fuseConnect(const char *usrname, struct fuse_context *ctx,
 {
   int ret;
   struct hdfsConn* conn;
+  struct hdfsConnShard *shard = hdfsConnShardOf(usrname);
 
-  pthread_mutex_lock(&gConnMutex);
-  conn = hdfsConnFind(usrname);
+  pthread_mutex_lock(&shard->lock);
+  conn = hdfsConnFind(shard, usrname);
   if (!conn) {
-    ret = fuseNewConnect(usrname, ctx, &conn);
+    ret = fuseNewConnect(shard, usrname, ctx, &conn);
     if (ret) {
-      pthread_mutex_unlock(&gConnMutex);
+      pthread_mutex_unlock(&shard->lock);
       fprintf(stderr, "fuseConnect(usrname=%s): fuseNewConnect failed with "
               "error code %d\n", usrname, ret);
       return ret;
     }
+  } else {
+    fuseStatsCount(FUSE_STATS_CONN_HITS, 1);
   }
   conn->refcnt++;
   conn->expirationCount = (gExpiryPeriod + gTimerPeriod - 1) / gTimerPeriod;
   if (conn->expirationCount < 2)
     conn->expirationCount = 2;
-  pthread_mutex_unlock(&gConnMutex);
+  pthread_mutex_unlock(&shard->lock);
   *out = conn;
   return 0;
 }
@@ -584,6 +680,7 @@ int fuseConnectTest(void)
 {
   int ret;
   struct hdfsConn *conn;
+  struct hdfsConnShard *shard = hdfsConnShardOf("root");
 
   if (gHdfsAuthConf == AUTH_CONF_KERBEROS) {
     // TODO: call some method which can tell us whether the FS exists.  In order
@@ -591,7 +688,19 @@ int fuseConnectTest(void)
     // this without valid Kerberos authentication.  See HDFS-3674 for details.
     return 0;
   }
-  ret = fuseNewConnect("root", NULL, &conn);
+  pthread_mutex_lock(&shard->lock);
+  conn = hdfsConnFind(shard, "root");
+  if (conn) {
+    conn->refcnt++;
+    ret = 0;
+  } else {
+    ret = fuseNewConnect(shard, "root", NULL, &conn);
+    if (!ret) {
+      conn->refcnt++;
+      conn->expirationCount = 2;
+    }
+  }
+  pthread_mutex_unlock(&shard->lock);
   if (ret) {
     fprintf(stderr, "fuseConnectTest failed with error code %d\n", ret);
     return ret;
@@ -605,20 +714,33 @@ struct hdfs_internal* hdfsConnGetFs(struct hdfsConn *conn)
   return conn->fs;
 }
 
+void hdfsConnRef(struct hdfsConn *conn)
+{
+  struct hdfsConnShard *shard = conn->shard;
+
+  pthread_mutex_lock(&shard->lock);
+  conn->refcnt++;
+  pthread_mutex_unlock(&shard->lock);
+}
+
 void hdfsConnRelease(struct hdfsConn *conn)
 {
-  pthread_mutex_lock(&gConnMutex);
+  struct hdfsConnShard *shard = conn->shard;
+  int condemned;
+
+  pthread_mutex_lock(&shard->lock);
   conn->refcnt--;
-  if ((conn->refcnt == 0) && (conn->condemned)) {
+  condemned = (conn->refcnt == 0) && (conn->condemned);
+  pthread_mutex_unlock(&shard->lock);
+  if (condemned) {
     fprintf(stderr, "hdfsConnRelease(usrname=%s): freeing condemend FS!\n",
       conn->usrname);
-    /* Notice that we're not removing the connection from gConnTree here.
+    /* Notice that we're not removing the connection from the shard here.
      * If the connection is condemned, it must have already been removed from
      * the tree, so that no other threads start using it.
      */
     hdfsConnFree(conn);
   }
-  pthread_mutex_unlock(&gConnMutex);
 }
 
 /**
@@ -30,10 +30,12 @@ struct hdfs_internal;
  *
  * @param nnUri      The NameNode URI
  * @param port       The NameNode port
+ * @param attrCacheTtl  How many seconds each connection caches file status
+ *                   for, or 0 for no cache
  *
  * @return           0 on success; error code otherwise
  */
-int fuseConnectInit(const char *nnUri, int port);
+int fuseConnectInit(const char *nnUri, int port, int attrCacheTtl);
 
 /**
  * Get a libhdfs connection.
@@ -66,6 +68,14 @@ int fuseConnectTest(void);
  */
 struct hdfs_internal* hdfsConnGetFs(struct hdfsConn *conn);
 
+/**
+ * Take another reference of an hdfsConn, to be released with
+ * hdfsConnRelease.
+ *
+ * @param conn       The hdfsConn, which the caller holds a reference of
+ */
+void hdfsConnRef(struct hdfsConn *conn);
+
 /**
  * Release an hdfsConn when we're done with it.
  *
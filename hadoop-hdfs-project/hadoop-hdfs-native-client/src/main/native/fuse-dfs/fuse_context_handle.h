@@ -23,6 +23,10 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+struct fuseBlockCache;
+struct fuseHandleCache;
+struct fusePageCache;
+
 //
 // Structure to store fuse_dfs specific data
 // this will be created and passed to fuse at startup
@@ -35,6 +39,23 @@ typedef struct dfs_context_struct {
   int direct_io;
   char **protectedpaths;
   size_t rdbuffer_size;
+  // Size of each of the two write-behind buffers of a handle opened for
+  // writing, 0 to write through
+  size_t wrbuffer_size;
+  // How many seconds statfs reuses the capacity it got, 0 to always ask
+  int statfs_cache_ttl;
+  // Chunks of file data shared by all the open files, NULL unless mounted
+  // with a cache_size
+  struct fuseBlockCache *block_cache;
+  // Read-only handles shared by the opens of the same file, NULL unless
+  // mounted with a handle_cache_ttl
+  struct fuseHandleCache *handle_cache;
+  // Versions of the files the kernel may keep cached pages of across opens,
+  // NULL unless mounted with keep_cache
+  struct fusePageCache *page_cache;
+  // Whether reads of blocks with a local replica are spliced from the
+  // replica's file, unchecksummed
+  int splice_local_blocks;
 } dfs_context;
 
 #endif
@@ -21,6 +21,7 @@
 #include "fuse_impls.h"
 #include "fuse_init.h"
 #include "fuse_connect.h"
+#include "fuse_stats.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -41,29 +42,47 @@ int is_protected(const char *path) {
   return 0;
 }
 
+/*
+ * The hooks that keep statistics are registered through their fuse_stats.c
+ * wrappers.
+ */
 static struct fuse_operations dfs_oper = {
-  .getattr  = dfs_getattr,
+  .getattr  = dfs_stats_getattr,
   .access   = dfs_access,
-  .readdir  = dfs_readdir,
+  .opendir  = dfs_opendir,
+  .readdir  = dfs_stats_readdir,
+  .releasedir = dfs_releasedir,
   .destroy  = dfs_destroy,
   .init     = dfs_init,
-  .open     = dfs_open,
-  .read     = dfs_read,
+  .open     = dfs_stats_open,
+  .read     = dfs_stats_read,
+#if FUSE_VERSION >= 29
+  .read_buf = dfs_stats_read_buf,
+#endif
   .symlink  = dfs_symlink,
   .statfs   = dfs_statfs,
   .mkdir    = dfs_mkdir,
   .rmdir    = dfs_rmdir,
   .rename   = dfs_rename,
   .unlink   = dfs_unlink,
-  .release  = dfs_release,
+  .release  = dfs_stats_release,
   .create   = dfs_create,
-  .write    = dfs_write,
+  .write    = dfs_stats_write,
   .flush    = dfs_flush,
   .mknod    = dfs_mknod,
   .utimens  = dfs_utimens,
   .chmod    = dfs_chmod,
   .chown    = dfs_chown,
   .truncate = dfs_truncate,
+#if FUSE_VERSION >= 29
+  /*
+   * The high-level API rebuilds the path of every request from its inode
+   * under a global lock.  The operations on open handles take what they need
+   * from the handle instead, so skip that for them.
+   */
+  .flag_nullpath_ok = 1,
+  .flag_nopath = 1,
+#endif
 };
 
 int main(int argc, char *argv[])
@@ -79,6 +98,9 @@ int main(int argc, char *argv[])
   memset(&options, 0, sizeof(struct options));
 
   options.rdbuffer_size = 10*1024*1024; 
+  options.cache_readahead = 4;
+  options.wrbuffer_size = 4096;
+  options.statfs_cache_ttl = 10;
   options.attribute_timeout = 60; 
   options.entry_timeout = 60;
 
@@ -106,6 +128,16 @@ int main(int argc, char *argv[])
     fuse_opt_add_arg(&args, "-r");
   }
 
+#ifdef FUSE_CAP_BIG_WRITES
+  /*
+   * Without big_writes the kernel splits writes into 4 KB requests.  Older
+   * FUSE libraries only take it as a mount option, not from conn->want in
+   * dfs_init, so always pass it; max_write then defaults to the largest
+   * request the kernel sends.
+   */
+  fuse_opt_add_arg(&args, "-obig_writes");
+#endif
+
   {
     char buf[80];
 
@@ -19,9 +19,14 @@
 #ifndef __FUSE_FILE_HANDLE_H__
 #define __FUSE_FILE_HANDLE_H__
 
+#include "fuse_block_cache.h"
+#include "fuse_write_buffer.h"
+
 #include <hdfs/hdfs.h>
 #include <pthread.h>
 
+struct fuseBlockFd;
+struct fuseHandle;
 struct hdfsConn;
 
 /**
@@ -35,12 +40,53 @@ struct hdfsConn;
  *
  */
 typedef struct dfs_fh_struct {
+  // The path the handle was opened with, since FUSE does not pass the path
+  // to the operations on open handles
+  char *path;
   hdfsFile hdfsFH;
+  // The cached handle hdfsFH belongs to, NULL if the file has its own
+  struct fuseHandle *cachedHandle;
   struct hdfsConn *conn;
   char *buf;
   tSize bufferSize;  //what is the size of the buffer we have
   off_t buffersStartOffset; //where the buffer starts in the file
   pthread_mutex_t mutex;
+  // The version of the file the block cache serves to this handle, with a
+  // NULL path if the handle reads around the cache
+  struct fuseCacheFile cacheFile;
+  // Write-behind state of handles opened for writing, with a zero capacity
+  // if writes go straight to hdfs
+  struct fuseWriteBuffer writeBuffer;
+  // With splice_local_blocks, the local block the handle last replied from,
+  // the options it was got with, and whether a read found no local block,
+  // after which the handle stops looking; protected by mutex
+  struct fuseBlockFd *blockFd;
+  struct hadoopRzOptions *rzOpts;
+  int noBlockFd;
 } dfs_fh;
 
+/**
+ * dfs_dh_struct is passed around for open directories.  The entries are read
+ * from a paged libhdfs listing as readdir asks for them, so a huge directory
+ * is never held in memory whole.
+ *
+ * readdir offsets count "." as 0, ".." as 1 and the entries of the listing
+ * from 2 on.
+ */
+typedef struct dfs_dh_struct {
+  struct hdfsConn *conn;
+  char *path;
+  // NULL after an error, until a seek opens the listing again
+  struct hdfsListing *listing;
+  // The page of the listing being returned, and the next entry in it
+  hdfsFileInfo *page;
+  int pageEntries;
+  int pageIndex;
+  // Nonzero once the listing has no entries left
+  int done;
+  // The offset of the next entry readdir returns
+  off_t position;
+  pthread_mutex_t mutex;
+} dfs_dh;
+
 #endif
@@ -0,0 +1,313 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuse_connect.h"
+#include "fuse_dfs.h"
+#include "fuse_handle_cache.h"
+#include "fuse_stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The handles are kept in a hash table of a fixed number of buckets. */
+#define FUSE_HANDLE_BUCKETS 1024
+
+struct fuseHandle {
+  // Next handle in the same hash bucket
+  struct fuseHandle *hashNext;
+  char *path;
+  // The connection the handle was opened on, which it holds a reference of
+  struct hdfsConn *conn;
+  hdfsFile file;
+  // How many open files use the handle
+  int refs;
+  // Nonzero while the handle is in the table, and handed out to new opens
+  int linked;
+  // The monotonic time after which it is no longer handed out
+  time_t expires;
+  // Next handle to close once the lock is dropped
+  struct fuseHandle *closeNext;
+};
+
+struct fuseHandleCache {
+  int ttl;
+  // Protects everything below, and the refs and linked of the handles
+  pthread_mutex_t lock;
+  struct fuseHandle *buckets[FUSE_HANDLE_BUCKETS];
+  // Signalled to stop the expiry thread
+  pthread_cond_t cond;
+  int stop;
+  pthread_t thread;
+};
+
+static time_t fuseHandleNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+static struct fuseHandle **fuseHandleBucket(struct fuseHandleCache *cache,
+                                            const char *path)
+{
+  // FNV-1a over the path, the handles of all users share the bucket
+  uint32_t hash = 2166136261U;
+
+  for (; *path; path++) {
+    hash = (hash ^ (unsigned char)*path) * 16777619U;
+  }
+  return &cache->buckets[hash % FUSE_HANDLE_BUCKETS];
+}
+
+/**
+ * Take a handle out of the table, called with the lock held.  It is added
+ * to closeList if no open file uses it.
+ */
+static void fuseHandleUnlink(struct fuseHandleCache *cache,
+                             struct fuseHandle *handle,
+                             struct fuseHandle **closeList)
+{
+  struct fuseHandle **link;
+
+  for (link = fuseHandleBucket(cache, handle->path); *link;
+       link = &(*link)->hashNext) {
+    if (*link == handle) {
+      *link = handle->hashNext;
+      break;
+    }
+  }
+  handle->hashNext = NULL;
+  handle->linked = 0;
+  if (handle->refs == 0) {
+    handle->closeNext = *closeList;
+    *closeList = handle;
+  }
+}
+
+/**
+ * Close a handle, called without the lock.
+ *
+ * @return              0 on success; error code otherwise
+ */
+static int fuseHandleClose(struct fuseHandle *handle)
+{
+  int ret = 0;
+
+  if (hdfsCloseFile(hdfsConnGetFs(handle->conn), handle->file)) {
+    ret = (errno > 0) ? errno : EIO;
+    ERROR("Could not close cached handle of %s (error %d)", handle->path,
+          ret);
+  }
+  hdfsConnRelease(handle->conn);
+  free(handle->path);
+  free(handle);
+  return ret;
+}
+
+static void fuseHandleCloseList(struct fuseHandle *closeList)
+{
+  struct fuseHandle *handle;
+
+  while ((handle = closeList)) {
+    closeList = handle->closeNext;
+    fuseHandleClose(handle);
+  }
+}
+
+/**
+ * Take the expired handles out of the table, called with the lock held.
+ */
+static void fuseHandleExpire(struct fuseHandleCache *cache, time_t now,
+                             struct fuseHandle **closeList)
+{
+  struct fuseHandle *handle, *next;
+  int i;
+
+  for (i = 0; i < FUSE_HANDLE_BUCKETS; i++) {
+    for (handle = cache->buckets[i]; handle; handle = next) {
+      next = handle->hashNext;
+      if (handle->expires <= now) {
+        fuseHandleUnlink(cache, handle, closeList);
+      }
+    }
+  }
+}
+
+/**
+ * Close the handles left idle, so that they don't keep their connection and
+ * their streams open until the next open of some other file.
+ */
+static void *fuseHandleExpiryThread(void *v)
+{
+  struct fuseHandleCache *cache = v;
+  struct fuseHandle *closeList;
+  struct timespec deadline;
+
+  pthread_mutex_lock(&cache->lock);
+  while (!cache->stop) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += cache->ttl;
+    pthread_cond_timedwait(&cache->cond, &cache->lock, &deadline);
+    closeList = NULL;
+    fuseHandleExpire(cache, fuseHandleNow(), &closeList);
+    pthread_mutex_unlock(&cache->lock);
+    fuseHandleCloseList(closeList);
+    pthread_mutex_lock(&cache->lock);
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return NULL;
+}
+
+int fuseHandleCacheAlloc(int ttl, struct fuseHandleCache **out)
+{
+  struct fuseHandleCache *cache;
+  int ret;
+
+  cache = calloc(1, sizeof(*cache));
+  if (!cache) {
+    return ENOMEM;
+  }
+  cache->ttl = ttl;
+  if (pthread_mutex_init(&cache->lock, NULL)) {
+    free(cache);
+    return ENOMEM;
+  }
+  if (pthread_cond_init(&cache->cond, NULL)) {
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+    return ENOMEM;
+  }
+  ret = pthread_create(&cache->thread, NULL, fuseHandleExpiryThread, cache);
+  if (ret) {
+    pthread_cond_destroy(&cache->cond);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+    return ret;
+  }
+  *out = cache;
+  return 0;
+}
+
+void fuseHandleCacheFree(struct fuseHandleCache *cache)
+{
+  struct fuseHandle *closeList = NULL;
+
+  pthread_mutex_lock(&cache->lock);
+  cache->stop = 1;
+  pthread_cond_signal(&cache->cond);
+  pthread_mutex_unlock(&cache->lock);
+  pthread_join(cache->thread, NULL);
+
+  // Every handle expires within the ttl
+  fuseHandleExpire(cache, fuseHandleNow() + cache->ttl, &closeList);
+  fuseHandleCloseList(closeList);
+  pthread_cond_destroy(&cache->cond);
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+int fuseHandleCacheOpen(struct fuseHandleCache *cache, struct hdfsConn *conn,
+                        const char *path, struct fuseHandle **out)
+{
+  struct fuseHandle *handle, **bucket;
+  time_t now = fuseHandleNow();
+
+  pthread_mutex_lock(&cache->lock);
+  bucket = fuseHandleBucket(cache, path);
+  for (handle = *bucket; handle; handle = handle->hashNext) {
+    if (handle->conn == conn && handle->expires > now &&
+        !strcmp(handle->path, path)) {
+      handle->refs++;
+      pthread_mutex_unlock(&cache->lock);
+      fuseStatsCount(FUSE_STATS_HANDLE_HITS, 1);
+      *out = handle;
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  fuseStatsCount(FUSE_STATS_HANDLE_MISSES, 1);
+
+  handle = calloc(1, sizeof(*handle));
+  if (!handle) {
+    return ENOMEM;
+  }
+  handle->path = strdup(path);
+  if (!handle->path) {
+    free(handle);
+    return ENOMEM;
+  }
+  handle->file = hdfsOpenFile(hdfsConnGetFs(conn), path, O_RDONLY, 0, 0, 0);
+  if (!handle->file) {
+    free(handle->path);
+    free(handle);
+    return (errno == 0 || errno == EINTERNAL) ? EIO : errno;
+  }
+  hdfsConnRef(conn);
+  handle->conn = conn;
+  handle->refs = 1;
+  handle->linked = 1;
+  handle->expires = now + cache->ttl;
+
+  // Another thread may have opened the file meanwhile, new opens then get
+  // whichever of the two handles comes first
+  pthread_mutex_lock(&cache->lock);
+  handle->hashNext = *bucket;
+  *bucket = handle;
+  pthread_mutex_unlock(&cache->lock);
+  *out = handle;
+  return 0;
+}
+
+hdfsFile fuseHandleFile(const struct fuseHandle *handle)
+{
+  return handle->file;
+}
+
+int fuseHandleCacheRelease(struct fuseHandleCache *cache,
+                           struct fuseHandle *handle)
+{
+  int idle;
+
+  pthread_mutex_lock(&cache->lock);
+  handle->refs--;
+  idle = handle->refs == 0 && !handle->linked;
+  pthread_mutex_unlock(&cache->lock);
+  return idle ? fuseHandleClose(handle) : 0;
+}
+
+void fuseHandleCacheInvalidate(struct fuseHandleCache *cache,
+                               const char *path)
+{
+  struct fuseHandle *handle, *next, *closeList = NULL;
+
+  pthread_mutex_lock(&cache->lock);
+  for (handle = *fuseHandleBucket(cache, path); handle; handle = next) {
+    next = handle->hashNext;
+    if (!strcmp(handle->path, path)) {
+      fuseHandleUnlink(cache, handle, &closeList);
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  fuseHandleCloseList(closeList);
+}
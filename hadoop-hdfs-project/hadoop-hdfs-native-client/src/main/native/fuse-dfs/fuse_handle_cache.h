@@ -0,0 +1,86 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FUSE_HANDLE_CACHE_H__
+#define __FUSE_HANDLE_CACHE_H__
+
+#include <hdfs/hdfs.h>
+
+struct fuseHandle;
+struct fuseHandleCache;
+struct hdfsConn;
+
+/**
+ * Allocate a cache of read-only handles, shared by the opens of the same file
+ * by the same user.
+ *
+ * @param ttl           How many seconds after it was opened a handle is
+ *                      handed out to new opens.  It is closed once it is
+ *                      past that and no open file uses it.
+ * @param out           (out param) the new cache.
+ *
+ * @return              0 on success; error code otherwise
+ */
+int fuseHandleCacheAlloc(int ttl, struct fuseHandleCache **out);
+
+/**
+ * Free a handle cache, closing the handles in it.  No handle may be in use.
+ */
+void fuseHandleCacheFree(struct fuseHandleCache *cache);
+
+/**
+ * Get a read-only handle of a file, opening it unless the user has one
+ * already.  Handles are only read with hdfsPread, so any number of open files
+ * can share one.
+ *
+ * @param cache         The cache.
+ * @param conn          The connection of the user.  The cache takes a
+ *                      reference of its own while it keeps the handle.
+ * @param path          The path of the file.
+ * @param out           (out param) the handle, to be given back with
+ *                      fuseHandleCacheRelease.
+ *
+ * @return              0 on success; error code otherwise
+ */
+int fuseHandleCacheOpen(struct fuseHandleCache *cache, struct hdfsConn *conn,
+                        const char *path, struct fuseHandle **out);
+
+/**
+ * Get the libhdfs file of a handle.
+ */
+hdfsFile fuseHandleFile(const struct fuseHandle *handle);
+
+/**
+ * Give back a handle got from fuseHandleCacheOpen.
+ *
+ * @return              0 on success; error code if the handle was closed
+ *                      and that failed
+ */
+int fuseHandleCacheRelease(struct fuseHandleCache *cache,
+                           struct fuseHandle *handle);
+
+/**
+ * Stop handing out the handles of a path, closing those not in use.
+ *
+ * @param cache         The cache.
+ * @param path          The path that was modified, renamed or removed.
+ */
+void fuseHandleCacheInvalidate(struct fuseHandleCache *cache,
+                               const char *path);
+
+#endif
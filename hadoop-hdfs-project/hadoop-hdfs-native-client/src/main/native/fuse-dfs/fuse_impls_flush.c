@@ -22,20 +22,19 @@
 #include "fuse_file_handle.h"
 
 int dfs_flush(const char *path, struct fuse_file_info *fi) {
-  TRACE1("flush", path)
-
   // retrieve dfs specific data
   dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
 
   // check params and the context var
-  assert(path);
   assert(dfs);
-  assert('/' == *path);
   assert(fi);
 
   if (NULL == (void*)fi->fh) {
     return  0;
   }
+  // FUSE passes no path with flag_nopath
+  path = ((dfs_fh*)fi->fh)->path;
+  TRACE1("flush", path)
 
   // note that fuse calls flush on RO files too and hdfs does not like that and will return an error
   if (fi->flags & O_WRONLY) {
@@ -44,6 +43,19 @@ int dfs_flush(const char *path, struct fuse_file_info *fi) {
     assert(fh);
     hdfsFile file_handle = (hdfsFile)fh->hdfsFH;
     assert(file_handle);
+    if (fh->writeBuffer.capacity) {
+      int ret;
+
+      // Errors of earlier background writes surface in close(2) from here
+      pthread_mutex_lock(&fh->mutex);
+      ret = fuseWriteBufferFlush(&fh->writeBuffer);
+      pthread_mutex_unlock(&fh->mutex);
+      if (ret) {
+        ERROR("Could not write buffered data for %s (error %d)\n",
+              path, -ret);
+        return ret;
+      }
+    }
     if (hdfsFlush(hdfsConnGetFs(fh->conn), file_handle) != 0) {
       ERROR("Could not flush %lx for %s\n",(long)file_handle, path);
       return -EIO;
@@ -20,6 +20,8 @@
 #include "fuse_impls.h"
 #include "fuse_connect.h"
 #include "fuse_file_handle.h"
+#include "fuse_handle_cache.h"
+#include "fuse_page_cache.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -84,11 +86,31 @@ static int64_t get_hdfs_open_flags(hdfsFS fs, const char *path, int flags)
   return ret;
 }
 
+/**
+ * Record the version of a file opened for reading, so that its reads can be
+ * served from the block cache.
+ *
+ * @param info             The file status, NULL if it could not be looked up
+ *
+ * @return                 1 if the handle can use the cache; 0 if the file
+ *                         could not be looked up, in which case the handle
+ *                         reads around the cache.
+ */
+static int cache_file_init(const hdfsFileInfo *info, const char *path,
+                           struct fuseCacheFile *cacheFile)
+{
+  if (!info) {
+    return 0;
+  }
+  return fuseCacheFileInit(cacheFile, path, info->mLastMod, info->mSize) == 0;
+}
+
 int dfs_open(const char *path, struct fuse_file_info *fi)
 {
   hdfsFS fs = NULL;
   dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
   dfs_fh *fh = NULL;
+  hdfsFileInfo *info = NULL;
   int mutexInit = 0, ret, flags = 0;
   int64_t flagRet;
 
@@ -106,6 +128,12 @@ int dfs_open(const char *path, struct fuse_file_info *fi)
     ret = -EIO;
     goto error;
   }
+  fh->path = strdup(path);
+  if (!fh->path) {
+    ERROR("Malloc of the path of a new file handle failed");
+    ret = -EIO;
+    goto error;
+  }
   ret = fuseConnectAsThreadUid(&fh->conn);
   if (ret) {
     fprintf(stderr, "fuseConnectAsThreadUid: failed to open a libhdfs "
@@ -120,7 +148,17 @@ int dfs_open(const char *path, struct fuse_file_info *fi)
     goto error;
   }
   flags = flagRet;
-  if ((fh->hdfsFH = hdfsOpenFile(fs, path, flags,  0, 0, 0)) == NULL) {
+  if ((flags & O_ACCMODE) == O_RDONLY && dfs->handle_cache) {
+    // Reads only use hdfsPread, so the opens of a user can share a handle
+    ret = fuseHandleCacheOpen(dfs->handle_cache, fh->conn, path,
+                              &fh->cachedHandle);
+    if (ret) {
+      ERROR("Could not open file %s (error %d)", path, ret);
+      ret = -ret;
+      goto error;
+    }
+    fh->hdfsFH = fuseHandleFile(fh->cachedHandle);
+  } else if ((fh->hdfsFH = hdfsOpenFile(fs, path, flags,  0, 0, 0)) == NULL) {
     ERROR("Could not open file %s (errno=%d)", path, errno);
     if (errno == 0 || errno == EINTERNAL) {
       ret = -EIO;
@@ -140,32 +178,77 @@ int dfs_open(const char *path, struct fuse_file_info *fi)
 
   if ((flags & O_ACCMODE) == O_WRONLY) {
     fh->buf = NULL;
-  } else  {
-    assert(dfs->rdbuffer_size > 0);
-    fh->buf = (char*)malloc(dfs->rdbuffer_size * sizeof(char));
-    if (NULL == fh->buf) {
-      ERROR("Could not allocate memory for a read for file %s\n", path);
-      ret = -EIO;
-      goto error;
+    if (dfs->block_cache) {
+      fuseBlockCacheInvalidate(dfs->block_cache, path);
+    }
+    if (dfs->handle_cache) {
+      fuseHandleCacheInvalidate(dfs->handle_cache, path);
+    }
+    if (dfs->page_cache) {
+      fusePageCacheInvalidate(dfs->page_cache, path);
+    }
+    if (dfs->wrbuffer_size > 0) {
+      ret = fuseWriteBufferInit(&fh->writeBuffer, fs, fh->hdfsFH,
+                                dfs->wrbuffer_size);
+      if (ret) {
+        ERROR("Could not set up write buffering for file %s (error %d)",
+              path, ret);
+        ret = -EIO;
+        goto error;
+      }
+    }
+  } else {
+    if (dfs->block_cache || dfs->page_cache) {
+      // From the attribute cache of the connection, if it has one
+      info = hdfsGetPathInfo(fs, path);
+    }
+    if (dfs->block_cache && cache_file_init(info, path, &fh->cacheFile)) {
+      // Reads of this handle go through the shared block cache instead
+      fh->buf = NULL;
+    } else {
+      assert(dfs->rdbuffer_size > 0);
+      fh->buf = (char*)malloc(dfs->rdbuffer_size * sizeof(char));
+      if (NULL == fh->buf) {
+        ERROR("Could not allocate memory for a read for file %s\n", path);
+        ret = -EIO;
+        goto error;
+      }
+      fh->buffersStartOffset = 0;
+      fh->bufferSize = 0;
     }
-    fh->buffersStartOffset = 0;
-    fh->bufferSize = 0;
+    if (dfs->page_cache && info) {
+      // The pages the kernel read at earlier opens are still valid if the
+      // file has not changed since
+      fi->keep_cache = fusePageCacheOpen(dfs->page_cache, path,
+                                         info->mLastMod, info->mSize);
+    }
+  }
+  if (info) {
+    hdfsFreeFileInfo(info, 1);
   }
   fi->fh = (uint64_t)fh;
   return 0;
 
 error:
+  if (info) {
+    hdfsFreeFileInfo(info, 1);
+  }
   if (fh) {
     if (mutexInit) {
       pthread_mutex_destroy(&fh->mutex);
     }
     free(fh->buf);
-    if (fh->hdfsFH) {
+    fuseCacheFileDestroy(&fh->cacheFile);
+    fuseWriteBufferDestroy(&fh->writeBuffer);
+    if (fh->cachedHandle) {
+      fuseHandleCacheRelease(dfs->handle_cache, fh->cachedHandle);
+    } else if (fh->hdfsFH) {
       hdfsCloseFile(fs, fh->hdfsFH);
     }
     if (fh->conn) {
       hdfsConnRelease(fh->conn);
     }
+    free(fh->path);
     free(fh);
   }
   return ret;
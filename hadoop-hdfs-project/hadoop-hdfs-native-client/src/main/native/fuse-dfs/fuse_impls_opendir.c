@@ -0,0 +1,86 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fuse_dfs.h"
+#include "fuse_impls.h"
+#include "fuse_file_handle.h"
+#include "fuse_connect.h"
+
+#include <stdlib.h>
+
+int dfs_opendir(const char *path, struct fuse_file_info *fi)
+{
+  dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
+  dfs_dh *dh = NULL;
+  int mutexInit = 0, ret;
+
+  TRACE1("opendir", path)
+
+  assert(path);
+  assert('/' == *path);
+  assert(dfs);
+
+  dh = calloc(1, sizeof(dfs_dh));
+  if (!dh) {
+    ERROR("Malloc of new directory handle failed");
+    ret = -EIO;
+    goto error;
+  }
+  ret = fuseConnectAsThreadUid(&dh->conn);
+  if (ret) {
+    fprintf(stderr, "fuseConnectAsThreadUid: failed to open a libhdfs "
+            "connection!  error %d.\n", ret);
+    ret = -EIO;
+    goto error;
+  }
+  dh->path = strdup(path);
+  if (!dh->path) {
+    ret = -ENOMEM;
+    goto error;
+  }
+  // Open the listing here, so that a missing directory fails opendir(3)
+  dh->listing = hdfsOpenListing(hdfsConnGetFs(dh->conn), path);
+  if (!dh->listing) {
+    ret = (errno > 0) ? -errno : -ENOENT;
+    goto error;
+  }
+  ret = pthread_mutex_init(&dh->mutex, NULL);
+  if (ret) {
+    fprintf(stderr, "dfs_opendir: error initializing mutex: error %d\n", ret);
+    ret = -EIO;
+    goto error;
+  }
+  mutexInit = 1;
+  fi->fh = (uint64_t)dh;
+  return 0;
+
+error:
+  if (dh) {
+    if (mutexInit) {
+      pthread_mutex_destroy(&dh->mutex);
+    }
+    if (dh->listing) {
+      hdfsCloseListing(dh->listing);
+    }
+    free(dh->path);
+    if (dh->conn) {
+      hdfsConnRelease(dh->conn);
+    }
+    free(dh);
+  }
+  return ret;
+}
@@ -16,10 +16,15 @@
  * limitations under the License.
  */
 
+#include "fuse_block_cache.h"
+#include "fuse_block_fd.h"
 #include "fuse_connect.h"
 #include "fuse_dfs.h"
 #include "fuse_file_handle.h"
 #include "fuse_impls.h"
+#include "fuse_stats.h"
+
+#include <stdlib.h>
 
 static size_t min(const size_t x, const size_t y) {
   return x < y ? x : y;
@@ -35,29 +40,41 @@ static size_t min(const size_t x, const size_t y) {
 int dfs_read(const char *path, char *buf, size_t size, off_t offset,
                    struct fuse_file_info *fi)
 {
-  TRACE1("read",path)
-  
   // retrieve dfs specific data
   dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
 
   // check params and the context var
   assert(dfs);
-  assert(path);
   assert(buf);
   assert(offset >= 0);
   assert(size >= 0);
   assert(fi);
 
   dfs_fh *fh = (dfs_fh*)fi->fh;
-  hdfsFS fs = hdfsConnGetFs(fh->conn);
-
   assert(fh != NULL);
   assert(fh->hdfsFH != NULL);
+  // FUSE passes no path with flag_nopath
+  path = fh->path;
+  TRACE1("read",path)
+
+  hdfsFS fs = hdfsConnGetFs(fh->conn);
 
   // special case this as simplifies the rest of the logic to know the caller wanted > 0 bytes
   if (size == 0)
     return 0;
 
+  // Handles opened while the block cache is on read through it, apart from
+  // the big reads below, which would only push hot chunks out
+  if (fh->cacheFile.path && size < dfs->rdbuffer_size) {
+    ssize_t num_read = fuseBlockCacheRead(dfs->block_cache, fs, fh->hdfsFH,
+                                          &fh->cacheFile, buf, size, offset);
+    if (num_read < 0) {
+      ERROR("cached read failed for %s with error %d", path, (int)-num_read);
+      return -EIO;
+    }
+    return num_read;
+  }
+
   // If size is bigger than the read buffer, then just read right into the user supplied buffer
   if ( size >= dfs->rdbuffer_size) {
     int num_read;
@@ -98,6 +115,8 @@ int dfs_read(const char *path, char *buf, size_t size, off_t offset,
       int num_read = 0;
       size_t total_read = 0;
 
+      fuseStatsCount(FUSE_STATS_RDBUFFER_MISSES, 1);
+
       while (dfs->rdbuffer_size  - total_read > 0 &&
              (num_read = hdfsPread(fs, fh->hdfsFH, offset + total_read, fh->buf + total_read, dfs->rdbuffer_size - total_read)) > 0) {
         total_read += num_read;
@@ -121,6 +140,8 @@ int dfs_read(const char *path, char *buf, size_t size, off_t offset,
           isEOF = 1;
         }
       }
+    } else {
+      fuseStatsCount(FUSE_STATS_RDBUFFER_HITS, 1);
     }
 
   //
@@ -161,3 +182,128 @@ int dfs_read(const char *path, char *buf, size_t size, off_t offset,
 
  return ret;
 }
+
+#if FUSE_VERSION >= 29
+/**
+ * Get the local block a read of a handle can be replied to from.
+ *
+ * @return              The block, with a reference for the caller; NULL if
+ *                      the read goes through dfs_read
+ */
+static struct fuseBlockFd *get_block_fd(dfs_context *dfs, dfs_fh *fh,
+                                        size_t size, off_t offset)
+{
+  struct fuseBlockFd *bfd = NULL;
+  int ret;
+
+  // Finding the block seeks the stream, which the opens sharing a cached
+  // handle read with hdfsPread; and handles the block cache serves are
+  // read from memory anyway
+  if (!dfs->splice_local_blocks || size == 0 || fh->cachedHandle ||
+      fh->cacheFile.path || !hdfsFileIsOpenForRead(fh->hdfsFH)) {
+    return NULL;
+  }
+  pthread_mutex_lock(&fh->mutex);
+  if (fh->blockFd && fuseBlockFdCovers(fh->blockFd, offset, size)) {
+    bfd = fh->blockFd;
+    fuseBlockFdRef(bfd);
+    goto done;
+  }
+  if (fh->noBlockFd) {
+    goto done;
+  }
+  if (!fh->rzOpts) {
+    fh->rzOpts = hadoopRzOptionsAlloc();
+    if (!fh->rzOpts || hadoopRzOptionsSetSkipChecksum(fh->rzOpts, 1)) {
+      ERROR("Could not set up the block reads of %s", fh->path);
+      fh->noBlockFd = 1;
+      goto done;
+    }
+  }
+  ret = fuseBlockFdGet(hdfsConnGetFs(fh->conn), fh->hdfsFH, fh->rzOpts,
+                       offset, &bfd);
+  if (ret) {
+    // The blocks of a file are mostly all local or all remote, so do not
+    // ask again for every read
+    if (ret != ENOTSUP) {
+      ERROR("Could not get the local block of %s at %lld (error %d)",
+            fh->path, (long long)offset, ret);
+    }
+    fh->noBlockFd = 1;
+    bfd = NULL;
+    goto done;
+  }
+  fuseBlockFdUnref(fh->blockFd);
+  fh->blockFd = bfd;
+  // A read across the end of the block, or of the file, is not short
+  if (fuseBlockFdCovers(bfd, offset, size)) {
+    fuseBlockFdRef(bfd);
+  } else {
+    bfd = NULL;
+  }
+done:
+  pthread_mutex_unlock(&fh->mutex);
+  return bfd;
+}
+
+/**
+ * dfs_read_buf
+ *
+ * With splice_local_blocks, replies to reads of blocks that have a local
+ * replica with the replica's file, which FUSE splices to the kernel after
+ * this returns.  All other reads are replied to with what dfs_read reads.
+ */
+int dfs_read_buf(const char *path, struct fuse_bufvec **bufp, size_t size,
+                 off_t offset, struct fuse_file_info *fi)
+{
+  dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
+  struct fuse_bufvec *bv;
+  struct fuseBlockFd *bfd;
+  int ret;
+
+  assert(dfs);
+  assert(fi);
+  dfs_fh *fh = (dfs_fh*)fi->fh;
+  assert(fh != NULL);
+  assert(fh->hdfsFH != NULL);
+  // FUSE passes no path with flag_nopath
+  path = fh->path;
+  TRACE1("read_buf", path)
+
+  bv = malloc(sizeof(*bv));
+  if (!bv) {
+    return -ENOMEM;
+  }
+  *bv = FUSE_BUFVEC_INIT(size);
+  bfd = get_block_fd(dfs, fh, size, offset);
+  if (bfd) {
+    if (fuseBlockFdHold(bfd) == 0) {
+      bv->buf[0].flags = FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK;
+      bv->buf[0].fd = bfd->fd;
+      bv->buf[0].pos = bfd->fdOffset + (offset - bfd->fileOffset);
+      fuseStatsCount(FUSE_STATS_BLOCK_FD_READS, 1);
+      *bufp = bv;
+      return 0;
+    }
+    fuseBlockFdUnref(bfd);
+  } else if (dfs->splice_local_blocks) {
+    // The reply to the previous read of the thread is out, so the block it
+    // came from need not stay open for it
+    fuseBlockFdHold(NULL);
+  }
+  bv->buf[0].mem = malloc(size ? size : 1);
+  if (!bv->buf[0].mem) {
+    free(bv);
+    return -ENOMEM;
+  }
+  ret = dfs_read(path, bv->buf[0].mem, size, offset, fi);
+  if (ret < 0) {
+    free(bv->buf[0].mem);
+    free(bv);
+    return ret;
+  }
+  bv->buf[0].size = ret;
+  *bufp = bv;
+  return 0;
+}
+#endif
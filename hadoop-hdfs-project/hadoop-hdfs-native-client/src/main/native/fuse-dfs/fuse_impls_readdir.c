@@ -15,108 +15,182 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-
 #include "fuse_dfs.h"
 #include "fuse_impls.h"
+#include "fuse_file_handle.h"
 #include "fuse_stat_struct.h"
 #include "fuse_connect.h"
 
-int dfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-                       off_t offset, struct fuse_file_info *fi)
-{
-  int ret;
-  struct hdfsConn *conn = NULL;
-  hdfsFS fs;
-  dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
+#include <stdlib.h>
 
-  TRACE1("readdir", path)
+/** How many entries to ask libhdfs for at a time */
+#define READDIR_PAGE_ENTRIES 1000
 
-  assert(dfs);
-  assert(path);
-  assert(buf);
+/** The offset of the first entry of the listing, after "." and ".." */
+#define READDIR_FIRST_ENTRY 2
 
-  ret = fuseConnectAsThreadUid(&conn);
-  if (ret) {
-    fprintf(stderr, "fuseConnectAsThreadUid: failed to open a libhdfs "
-            "connection!  error %d.\n", ret);
-    ret = -EIO;
-    goto cleanup;
+/**
+ * Get the next entry of the listing of a directory handle without consuming
+ * it, reading the next page when the current one is used up.
+ *
+ * @return        0 on success, with *info NULL at the end of the listing;
+ *                negative error code otherwise
+ */
+static int dh_peek(dfs_dh *dh, hdfsFileInfo **info)
+{
+  *info = NULL;
+  if (dh->pageIndex >= dh->pageEntries) {
+    if (dh->page) {
+      hdfsFreeFileInfo(dh->page, dh->pageEntries);
+      dh->page = NULL;
+    }
+    dh->pageEntries = 0;
+    dh->pageIndex = 0;
+    if (dh->done) {
+      return 0;
+    }
+    if (!dh->listing) {
+      return -EIO;
+    }
+    dh->page = hdfsListingNext(dh->listing, READDIR_PAGE_ENTRIES,
+                               &dh->pageEntries);
+    if (!dh->page) {
+      if (errno) {
+        ERROR("Could not list %s (errno=%d)", dh->path, errno);
+        return -errno;
+      }
+      dh->done = 1;
+      return 0;
+    }
   }
-  fs = hdfsConnGetFs(conn);
-
-  // Read dirents. Calling a variant that just returns the final path
-  // component (HDFS-975) would save us from parsing it out below.
-  int numEntries = 0;
-  hdfsFileInfo *info = hdfsListDirectory(fs, path, &numEntries);
+  *info = &dh->page[dh->pageIndex];
+  return 0;
+}
 
-  // NULL means either the directory doesn't exist or maybe IO error.
-  if (NULL == info) {
-    ret = (errno > 0) ? -errno : -ENOENT;
-    goto cleanup;
-  }
+/**
+ * Move a directory handle to a readdir offset.  Going back, e.g. after
+ * rewinddir(3), starts a new listing, since HDFS listings only go forward.
+ *
+ * @return        0 on success; negative error code otherwise
+ */
+static int dh_seek(dfs_dh *dh, off_t offset)
+{
+  hdfsFileInfo *info;
+  int ret;
 
-  int i ;
-  for (i = 0; i < numEntries; i++) {
-    if (NULL == info[i].mName) {
-      ERROR("Path %s info[%d].mName is NULL", path, i);
-      continue;
+  if (offset < dh->position) {
+    if (dh->page) {
+      hdfsFreeFileInfo(dh->page, dh->pageEntries);
+      dh->page = NULL;
     }
-
-    struct stat st;
-    fill_stat_structure(&info[i], &st);
-
-    // Find the final path component
-    const char *str = strrchr(info[i].mName, '/');
-    if (NULL == str) {
-      ERROR("Invalid URI %s", info[i].mName);
-      continue;
+    dh->pageEntries = 0;
+    dh->pageIndex = 0;
+    dh->done = 0;
+    if (dh->listing) {
+      hdfsCloseListing(dh->listing);
     }
-    str++;
-
-    // pack this entry into the fuse buffer
-    int res = 0;
-    if ((res = filler(buf,str,&st,0)) != 0) {
-      ERROR("Readdir filler failed: %d\n",res);
+    dh->listing = hdfsOpenListing(hdfsConnGetFs(dh->conn), dh->path);
+    dh->position = 0;
+    if (!dh->listing) {
+      return (errno > 0) ? -errno : -ENOENT;
+    }
+  }
+  while (dh->position < offset) {
+    if (dh->position >= READDIR_FIRST_ENTRY) {
+      ret = dh_peek(dh, &info);
+      if (ret) {
+        return ret;
+      }
+      if (!info) {
+        break;
+      }
+      dh->pageIndex++;
     }
+    dh->position++;
   }
+  return 0;
+}
 
-  // insert '.' and '..'
-  const char *const dots [] = { ".",".."};
-  for (i = 0 ; i < 2 ; i++)
-    {
-      struct stat st;
-      memset(&st, 0, sizeof(struct stat));
+static void fill_dot_stat(struct stat *st)
+{
+  memset(st, 0, sizeof(struct stat));
+
+  // set to 0 to indicate not supported for directory because we cannot (efficiently) get this info for every subdirectory
+  st->st_nlink =  0;
+
+  // setup stat size and acl meta data
+  st->st_size    = 512;
+  st->st_blksize = 512;
+  st->st_blocks  =  1;
+  st->st_mode    = (S_IFDIR | 0777);
+  st->st_uid     = default_id;
+  st->st_gid     = default_id;
+  // todo fix below times
+  st->st_atime   = 0;
+  st->st_mtime   = 0;
+  st->st_ctime   = 0;
+}
 
-      // set to 0 to indicate not supported for directory because we cannot (efficiently) get this info for every subdirectory
-      st.st_nlink =  0;
+int dfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+                       off_t offset, struct fuse_file_info *fi)
+{
+  static const char *const dots[] = { ".", ".." };
+  dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
+  dfs_dh *dh;
+  hdfsFileInfo *info;
+  struct stat st;
+  const char *str;
+  int ret = 0;
 
-      // setup stat size and acl meta data
-      st.st_size    = 512;
-      st.st_blksize = 512;
-      st.st_blocks  =  1;
-      st.st_mode    = (S_IFDIR | 0777);
-      st.st_uid     = default_id;
-      st.st_gid     = default_id;
-      // todo fix below times
-      st.st_atime   = 0;
-      st.st_mtime   = 0;
-      st.st_ctime   = 0;
+  assert(dfs);
+  assert(buf);
+  assert(fi);
 
-      const char *const str = dots[i];
+  dh = (dfs_dh*)fi->fh;
+  assert(dh);
+  // FUSE passes no path with flag_nopath
+  path = dh->path;
+  TRACE1("readdir", path)
 
-      // flatten the info using fuse's function into a buffer
-      int res = 0;
-      if ((res = filler(buf,str,&st,0)) != 0) {
-	ERROR("Readdir filler failed: %d\n",res);
+  pthread_mutex_lock(&dh->mutex);
+  if (offset != dh->position) {
+    ret = dh_seek(dh, offset);
+    if (ret) {
+      goto done;
+    }
+  }
+  // Fill the buffer FUSE gave us, passing each entry the offset of the next
+  // one, until it is full or the listing ends
+  while (1) {
+    if (dh->position < READDIR_FIRST_ENTRY) {
+      fill_dot_stat(&st);
+      if (filler(buf, dots[dh->position], &st, dh->position + 1)) {
+        break;
       }
+      dh->position++;
+      continue;
     }
-  // free the info pointers
-  hdfsFreeFileInfo(info,numEntries);
-  ret = 0;
-
-cleanup:
-  if (conn) {
-    hdfsConnRelease(conn);
+    ret = dh_peek(dh, &info);
+    if (ret || !info) {
+      break;
+    }
+    // Find the final path component.  Calling a variant that just returns
+    // it (HDFS-975) would save us from parsing it out here.
+    str = info->mName ? strrchr(info->mName, '/') : NULL;
+    if (NULL == str) {
+      ERROR("Path %s has an entry with an invalid name %s", path,
+            info->mName ? info->mName : "(NULL)");
+    } else {
+      fill_stat_structure(info, &st);
+      if (filler(buf, str + 1, &st, dh->position + 1)) {
+        break;
+      }
+    }
+    dh->pageIndex++;
+    dh->position++;
   }
+
+done:
+  pthread_mutex_unlock(&dh->mutex);
   return ret;
 }
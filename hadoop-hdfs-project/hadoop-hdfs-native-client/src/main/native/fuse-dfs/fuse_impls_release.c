@@ -16,9 +16,11 @@
  * limitations under the License.
  */
 
+#include "fuse_block_fd.h"
 #include "fuse_dfs.h"
 #include "fuse_impls.h"
 #include "fuse_file_handle.h"
+#include "fuse_handle_cache.h"
 #include "fuse_connect.h"
 
 #include <stdlib.h>
@@ -37,27 +39,45 @@
  */
 
 int dfs_release (const char *path, struct fuse_file_info *fi) {
-  TRACE1("release", path)
-
   // retrieve dfs specific data
   dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
 
   // check params and the context var
-  assert(path);
   assert(dfs);
-  assert('/' == *path);
 
   int ret = 0;
   dfs_fh *fh = (dfs_fh*)fi->fh;
   assert(fh);
+  // FUSE passes no path with flag_nopath
+  path = fh->path;
+  TRACE1("release", path)
   hdfsFile file_handle = (hdfsFile)fh->hdfsFH;
-  if (NULL != file_handle) {
+  // Prefetches read from the file until they complete
+  fuseCacheFileDestroy(&fh->cacheFile);
+  // Write out what is still buffered.  close(2) already saw errors through
+  // dfs_flush, this only catches writes made after the last flush.
+  if (fuseWriteBufferDestroy(&fh->writeBuffer)) {
+    ERROR("Could not write buffered data of %s\n", path);
+    ret = -EIO;
+  }
+  if (fh->cachedHandle) {
+    // Other opens of the file may still read from the handle
+    if (fuseHandleCacheRelease(dfs->handle_cache, fh->cachedHandle)) {
+      ret = -EIO;
+    }
+  } else if (NULL != file_handle) {
     if (hdfsCloseFile(hdfsConnGetFs(fh->conn), file_handle) != 0) {
       ERROR("Could not close handle %ld for %s\n",(long)file_handle, path);
       ret = -EIO;
     }
   }
+  // Replies still being spliced from the block hold it open themselves
+  fuseBlockFdUnref(fh->blockFd);
+  if (fh->rzOpts) {
+    hadoopRzOptionsFree(fh->rzOpts);
+  }
   free(fh->buf);
+  free(fh->path);
   hdfsConnRelease(fh->conn);
   pthread_mutex_destroy(&fh->mutex);
   free(fh);
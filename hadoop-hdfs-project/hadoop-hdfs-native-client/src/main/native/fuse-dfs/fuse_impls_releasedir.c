@@ -0,0 +1,46 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fuse_dfs.h"
+#include "fuse_impls.h"
+#include "fuse_file_handle.h"
+#include "fuse_connect.h"
+
+#include <stdlib.h>
+
+int dfs_releasedir(const char *path, struct fuse_file_info *fi)
+{
+  dfs_dh *dh = (dfs_dh*)fi->fh;
+
+  assert(dh);
+  // FUSE passes no path with flag_nopath
+  path = dh->path;
+  TRACE1("releasedir", path)
+
+  if (dh->page) {
+    hdfsFreeFileInfo(dh->page, dh->pageEntries);
+  }
+  if (dh->listing) {
+    hdfsCloseListing(dh->listing);
+  }
+  free(dh->path);
+  hdfsConnRelease(dh->conn);
+  pthread_mutex_destroy(&dh->mutex);
+  free(dh);
+  fi->fh = 0;
+  return 0;
+}
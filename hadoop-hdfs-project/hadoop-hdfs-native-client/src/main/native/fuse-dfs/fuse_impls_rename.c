@@ -20,6 +20,9 @@
 #include "fuse_impls.h"
 #include "fuse_trash.h"
 #include "fuse_connect.h"
+#include "fuse_block_cache.h"
+#include "fuse_handle_cache.h"
+#include "fuse_page_cache.h"
 
 int dfs_rename(const char *from, const char *to)
 {
@@ -56,6 +59,18 @@ int dfs_rename(const char *from, const char *to)
     ret = (errno > 0) ? -errno : -EIO;
     goto cleanup;
   }
+  if (dfs->block_cache) {
+    fuseBlockCacheInvalidate(dfs->block_cache, from);
+    fuseBlockCacheInvalidate(dfs->block_cache, to);
+  }
+  if (dfs->handle_cache) {
+    fuseHandleCacheInvalidate(dfs->handle_cache, from);
+    fuseHandleCacheInvalidate(dfs->handle_cache, to);
+  }
+  if (dfs->page_cache) {
+    fusePageCacheInvalidate(dfs->page_cache, from);
+    fusePageCacheInvalidate(dfs->page_cache, to);
+  }
   ret = 0;
 
 cleanup:
@@ -15,18 +15,113 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-
 #include "fuse_dfs.h"
 #include "fuse_impls.h"
 #include "fuse_connect.h"
 
+#include <pthread.h>
+#include <time.h>
+
+/**
+ * The capacity figures dfs_statfs reports.  Each of them costs a NameNode
+ * RPC, and file managers and df monitoring call statfs all the time, so they
+ * are kept for statfs_cache_ttl seconds.  Once they are older, the next
+ * statfs still returns them but starts a refresh in the background.
+ */
+struct dfsStatfsCache {
+  tOffset cap;
+  tOffset used;
+  tOffset bsize;
+  time_t loaded;
+  // Whether the figures above were ever loaded
+  int valid;
+  // Whether a background refresh is running
+  int refreshing;
+};
+
+static pthread_mutex_t gStatfsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Protected by gStatfsLock */
+static struct dfsStatfsCache gStatfs;
+
+static int statfs_fetch(hdfsFS fs, struct dfsStatfsCache *out)
+{
+  out->cap = hdfsGetCapacity(fs);
+  out->used = hdfsGetUsed(fs);
+  out->bsize = hdfsGetDefaultBlockSize(fs);
+  if (out->cap < 0 || out->used < 0 || out->bsize <= 0) {
+    ERROR("Could not get the capacity of the filesystem (errno=%d)", errno);
+    return -EIO;
+  }
+  out->loaded = time(NULL);
+  out->valid = 1;
+  return 0;
+}
+
+/**
+ * Store freshly fetched figures, with gStatfsLock held.
+ */
+static void statfs_store(const struct dfsStatfsCache *fetched)
+{
+  int refreshing = gStatfs.refreshing;
+
+  gStatfs = *fetched;
+  gStatfs.refreshing = refreshing;
+}
+
+static void *statfs_refresh(void *v)
+{
+  struct hdfsConn *conn = v;
+  struct dfsStatfsCache fetched;
+  int ret;
+
+  ret = statfs_fetch(hdfsConnGetFs(conn), &fetched);
+  hdfsConnRelease(conn);
+  pthread_mutex_lock(&gStatfsLock);
+  if (!ret) {
+    statfs_store(&fetched);
+  }
+  gStatfs.refreshing = 0;
+  pthread_mutex_unlock(&gStatfsLock);
+  return NULL;
+}
+
+/**
+ * Start refreshing the cached figures in the background, through the
+ * connection of the caller.  Falls back to refreshing them in this thread.
+ */
+static void statfs_start_refresh(void)
+{
+  struct hdfsConn *conn = NULL;
+  pthread_attr_t attr;
+  pthread_t thread;
+  int ret;
+
+  ret = fuseConnectAsThreadUid(&conn);
+  if (ret) {
+    pthread_mutex_lock(&gStatfsLock);
+    gStatfs.refreshing = 0;
+    pthread_mutex_unlock(&gStatfsLock);
+    return;
+  }
+  ret = pthread_attr_init(&attr);
+  if (!ret) {
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&thread, &attr, statfs_refresh, conn);
+    pthread_attr_destroy(&attr);
+  }
+  if (ret) {
+    statfs_refresh(conn);
+  }
+}
 
 int dfs_statfs(const char *path, struct statvfs *st)
 {
   struct hdfsConn *conn = NULL;
-  hdfsFS fs;
+  struct dfsStatfsCache figures;
   dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
-  int ret;
+  time_t now;
+  int ret, refresh = 0;
 
   TRACE1("statfs",path)
 
@@ -36,18 +131,46 @@ int dfs_statfs(const char *path, struct statvfs *st)
 
   memset(st,0,sizeof(struct statvfs));
 
-  ret = fuseConnectAsThreadUid(&conn);
-  if (ret) {
-    fprintf(stderr, "fuseConnectAsThreadUid: failed to open a libhdfs "
-            "connection!  error %d.\n", ret);
-    ret = -EIO;
-    goto cleanup;
+  pthread_mutex_lock(&gStatfsLock);
+  figures = gStatfs;
+  if (figures.valid) {
+    now = time(NULL);
+    // a clock stepping backwards expires the figures as well
+    if (now < figures.loaded ||
+        now - figures.loaded >= dfs->statfs_cache_ttl) {
+      if (!gStatfs.refreshing) {
+        gStatfs.refreshing = 1;
+        refresh = 1;
+      }
+    }
+  }
+  pthread_mutex_unlock(&gStatfsLock);
+
+  if (refresh) {
+    statfs_start_refresh();
+  }
+  if (!figures.valid || dfs->statfs_cache_ttl <= 0) {
+    ret = fuseConnectAsThreadUid(&conn);
+    if (ret) {
+      fprintf(stderr, "fuseConnectAsThreadUid: failed to open a libhdfs "
+              "connection!  error %d.\n", ret);
+      ret = -EIO;
+      goto cleanup;
+    }
+    ret = statfs_fetch(hdfsConnGetFs(conn), &figures);
+    if (ret) {
+      goto cleanup;
+    }
+    if (dfs->statfs_cache_ttl > 0) {
+      pthread_mutex_lock(&gStatfsLock);
+      statfs_store(&figures);
+      pthread_mutex_unlock(&gStatfsLock);
+    }
   }
-  fs = hdfsConnGetFs(conn);
 
-  const tOffset cap   = hdfsGetCapacity(fs);
-  const tOffset used  = hdfsGetUsed(fs);
-  const tOffset bsize = hdfsGetDefaultBlockSize(fs);
+  const tOffset cap   = figures.cap;
+  const tOffset used  = figures.used;
+  const tOffset bsize = figures.bsize;
 
   st->f_bsize   =  bsize;
   st->f_frsize  =  bsize;
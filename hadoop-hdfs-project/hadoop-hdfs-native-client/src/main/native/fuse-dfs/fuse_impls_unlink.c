@@ -20,6 +20,9 @@
 #include "fuse_impls.h"
 #include "fuse_connect.h"
 #include "fuse_trash.h"
+#include "fuse_block_cache.h"
+#include "fuse_handle_cache.h"
+#include "fuse_page_cache.h"
 
 int dfs_unlink(const char *path)
 {
@@ -54,6 +57,15 @@ int dfs_unlink(const char *path)
     ret = (errno > 0) ? -errno : -EIO;
     goto cleanup;
   }
+  if (dfs->block_cache) {
+    fuseBlockCacheInvalidate(dfs->block_cache, path);
+  }
+  if (dfs->handle_cache) {
+    fuseHandleCacheInvalidate(dfs->handle_cache, path);
+  }
+  if (dfs->page_cache) {
+    fusePageCacheInvalidate(dfs->page_cache, path);
+  }
   ret = 0;
 
 cleanup:
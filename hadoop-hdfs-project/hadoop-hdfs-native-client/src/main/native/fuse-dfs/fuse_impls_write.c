@@ -24,20 +24,19 @@
 int dfs_write(const char *path, const char *buf, size_t size,
                      off_t offset, struct fuse_file_info *fi)
 {
-  TRACE1("write", path)
-
   // retrieve dfs specific data
   dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
   int ret = 0;
 
   // check params and the context var
-  assert(path);
   assert(dfs);
-  assert('/' == *path);
   assert(fi);
 
   dfs_fh *fh = (dfs_fh*)fi->fh;
   assert(fh);
+  // FUSE passes no path with flag_nopath
+  path = fh->path;
+  TRACE1("write", path)
 
   hdfsFile file_handle = (hdfsFile)fh->hdfsFH;
   assert(file_handle);
@@ -51,11 +50,20 @@ int dfs_write(const char *path, const char *buf, size_t size,
   tSize length = 0;
   hdfsFS fs = hdfsConnGetFs(fh->conn);
 
-  tOffset cur_offset = hdfsTell(fs, file_handle);
+  tOffset cur_offset = fh->writeBuffer.capacity ?
+    fuseWriteBufferOffset(&fh->writeBuffer) : hdfsTell(fs, file_handle);
   if (cur_offset != offset) {
     ERROR("User trying to random access write to a file %d != %d for %s",
 	  (int)cur_offset, (int)offset, path);
     ret =  -ENOTSUP;
+  } else if (fh->writeBuffer.capacity) {
+    // hdfsWrite runs on the writer thread of the handle
+    ret = fuseWriteBufferWrite(&fh->writeBuffer, buf, size);
+    if (ret) {
+      ERROR("Could not write buffered data for %s (error %d)", path, -ret);
+    } else {
+      length = size;
+    }
   } else {
     length = hdfsWrite(fs, file_handle, buf, size);
     if (length <= 0) {
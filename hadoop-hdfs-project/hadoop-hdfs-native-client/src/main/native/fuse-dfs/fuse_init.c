@@ -16,6 +16,9 @@
  * limitations under the License.
  */
 
+#include "fuse_block_cache.h"
+#include "fuse_handle_cache.h"
+#include "fuse_page_cache.h"
 #include "fuse_dfs.h"
 #include "fuse_init.h"
 #include "fuse_options.h"
@@ -91,11 +94,17 @@ static void dfsPrintOptions(FILE *fp, const struct options *o)
   INFO("Mounting with options: [ protected=%s, nn_uri=%s, nn_port=%d, "
           "debug=%d, read_only=%d, initchecks=%d, "
           "no_permissions=%d, usetrash=%d, entry_timeout=%d, "
-          "attribute_timeout=%d, rdbuffer_size=%zd, direct_io=%d ]",
+          "attribute_timeout=%d, rdbuffer_size=%zd, direct_io=%d, "
+          "cache_size=%d, cache_readahead=%d, attr_cache_ttl=%d, "
+          "wrbuffer_size=%d, statfs_cache_ttl=%d, handle_cache_ttl=%d, "
+          "keep_cache=%d, splice_local_blocks=%d ]",
           (o->protected ? o->protected : "(NULL)"), o->nn_uri, o->nn_port, 
           o->debug, o->read_only, o->initchecks,
           o->no_permissions, o->usetrash, o->entry_timeout,
-          o->attribute_timeout, o->rdbuffer_size, o->direct_io);
+          o->attribute_timeout, o->rdbuffer_size, o->direct_io,
+          o->cache_size, o->cache_readahead, o->attr_cache_ttl,
+          o->wrbuffer_size, o->statfs_cache_ttl, o->handle_cache_ttl,
+          o->keep_cache, o->splice_local_blocks);
 }
 
 void *dfs_init(struct fuse_conn_info *conn)
@@ -118,6 +127,10 @@ void *dfs_init(struct fuse_conn_info *conn)
   dfs->protectedpaths        = NULL;
   dfs->rdbuffer_size         = options.rdbuffer_size;
   dfs->direct_io             = options.direct_io;
+  dfs->wrbuffer_size         = options.wrbuffer_size > 0 ?
+    (size_t)options.wrbuffer_size * 1024 : 0;
+  dfs->statfs_cache_ttl      = options.statfs_cache_ttl;
+  dfs->splice_local_blocks   = options.splice_local_blocks;
 
   dfsPrintOptions(stderr, &options);
 
@@ -129,7 +142,36 @@ void *dfs_init(struct fuse_conn_info *conn)
     dfs->rdbuffer_size = 32768;
   }
 
-  ret = fuseConnectInit(options.nn_uri, options.nn_port);
+  if (options.cache_size > 0) {
+    ret = fuseBlockCacheAlloc((size_t)options.cache_size * 1024 * 1024,
+                              options.cache_readahead, &dfs->block_cache);
+    if (ret) {
+      ERROR("FATAL: dfs_init: could not allocate the block cache: "
+            "error %d", ret);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (options.handle_cache_ttl > 0) {
+    ret = fuseHandleCacheAlloc(options.handle_cache_ttl, &dfs->handle_cache);
+    if (ret) {
+      ERROR("FATAL: dfs_init: could not allocate the handle cache: "
+            "error %d", ret);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (options.keep_cache && !options.direct_io) {
+    ret = fusePageCacheAlloc(&dfs->page_cache);
+    if (ret) {
+      ERROR("FATAL: dfs_init: could not allocate the page cache table: "
+            "error %d", ret);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  ret = fuseConnectInit(options.nn_uri, options.nn_port,
+                        options.attr_cache_ttl);
   if (ret) {
     ERROR("FATAL: dfs_init: fuseConnectInit failed with error %d!", ret);
     print_env_vars();
@@ -182,11 +224,33 @@ void *dfs_init(struct fuse_conn_info *conn)
   }
 #endif
 
+#ifdef FUSE_CAP_SPLICE_READ
+  // Let FUSE splice the replies of dfs_read_buf from local block files,
+  // rather than copy them through memory
+  if (options.splice_local_blocks && (conn->capable & FUSE_CAP_SPLICE_READ)) {
+    conn->want |= FUSE_CAP_SPLICE_READ;
+  }
+#endif
+
   return (void*)dfs;
 }
 
 
 void dfs_destroy(void *ptr)
 {
+  dfs_context *dfs = (dfs_context*)ptr;
+
   TRACE("destroy")
+  if (dfs && dfs->block_cache) {
+    fuseBlockCacheFree(dfs->block_cache);
+    dfs->block_cache = NULL;
+  }
+  if (dfs && dfs->handle_cache) {
+    fuseHandleCacheFree(dfs->handle_cache);
+    dfs->handle_cache = NULL;
+  }
+  if (dfs && dfs->page_cache) {
+    fusePageCacheFree(dfs->page_cache);
+    dfs->page_cache = NULL;
+  }
 }
@@ -37,11 +37,23 @@ void print_options() {
 	 "\tentry_timeout=%d\n"
 	 "\tattribute_timeout=%d\n"
 	 "\tprivate=%d\n"
-	 "\trdbuffer_size=%d (KBs)\n", 
+	 "\trdbuffer_size=%d (KBs)\n"
+	 "\tcache_size=%d (MBs)\n"
+	 "\tcache_readahead=%d (chunks)\n"
+	 "\tattr_cache_ttl=%d\n"
+	 "\twrbuffer_size=%d (KBs)\n"
+	 "\tstatfs_cache_ttl=%d\n"
+	 "\thandle_cache_ttl=%d\n"
+	 "\tkeep_cache=%d\n"
+	 "\tsplice_local_blocks=%d\n",
 	 options.protected, options.nn_uri, options.nn_port, options.debug,
 	 options.read_only, options.usetrash, options.entry_timeout, 
 	 options.attribute_timeout, options.private, 
-	 (int)options.rdbuffer_size / 1024);
+	 (int)options.rdbuffer_size / 1024, options.cache_size,
+	 options.cache_readahead, options.attr_cache_ttl,
+	 options.wrbuffer_size, options.statfs_cache_ttl,
+	 options.handle_cache_ttl, options.keep_cache,
+	 options.splice_local_blocks);
 }
 
 const char *program;
@@ -56,7 +68,12 @@ void print_usage(const char *pname)
 	 "[-ousetrash] [-obig_writes] [-oprivate (single user)] [ro] "
 	 "[-oserver=<hadoop_servername>] [-oport=<hadoop_port>] "
 	 "[-oentry_timeout=<secs>] [-oattribute_timeout=<secs>] "
-	 "[-odirect_io] [-onopoermissions] [-o<other fuse option>] "
+	 "[-odirect_io] [-ocache_size=<MBs>] [-ocache_readahead=<chunks>] "
+	 "[-oattr_cache_ttl=<secs>] [-owrbuffer=<KBs>] "
+	 "[-ostatfs_cache_ttl=<secs>] [-ohandle_cache_ttl=<secs>] [-okeep_cache] "
+	 "[-osplice_local_blocks] "
+	 "[-onopoermissions] "
+	 "[-o<other fuse option>] "
 	 "<mntpoint> [fuse options]\n", pname);
   printf("NOTE: debugging option for fuse is -debug\n");
 }
@@ -77,6 +94,8 @@ enum
     KEY_INITCHECKS,
     KEY_NOPERMISSIONS,
     KEY_DIRECTIO,
+    KEY_KEEPCACHE,
+    KEY_SPLICELOCALBLOCKS,
   };
 
 struct fuse_opt dfs_opts[] =
@@ -87,6 +106,12 @@ struct fuse_opt dfs_opts[] =
     DFSFS_OPT_KEY("protected=%s", protected, 0),
     DFSFS_OPT_KEY("port=%d", nn_port, 0),
     DFSFS_OPT_KEY("rdbuffer=%d", rdbuffer_size,0),
+    DFSFS_OPT_KEY("cache_size=%d", cache_size, 0),
+    DFSFS_OPT_KEY("cache_readahead=%d", cache_readahead, 0),
+    DFSFS_OPT_KEY("attr_cache_ttl=%d", attr_cache_ttl, 0),
+    DFSFS_OPT_KEY("wrbuffer=%d", wrbuffer_size, 0),
+    DFSFS_OPT_KEY("statfs_cache_ttl=%d", statfs_cache_ttl, 0),
+    DFSFS_OPT_KEY("handle_cache_ttl=%d", handle_cache_ttl, 0),
 
     FUSE_OPT_KEY("private", KEY_PRIVATE),
     FUSE_OPT_KEY("ro", KEY_RO),
@@ -98,6 +123,8 @@ struct fuse_opt dfs_opts[] =
     FUSE_OPT_KEY("usetrash", KEY_USETRASH),
     FUSE_OPT_KEY("notrash", KEY_NOTRASH),
     FUSE_OPT_KEY("direct_io", KEY_DIRECTIO),
+    FUSE_OPT_KEY("keep_cache", KEY_KEEPCACHE),
+    FUSE_OPT_KEY("splice_local_blocks", KEY_SPLICELOCALBLOCKS),
     FUSE_OPT_KEY("-v",             KEY_VERSION),
     FUSE_OPT_KEY("--version",      KEY_VERSION),
     FUSE_OPT_KEY("-h",             KEY_HELP),
@@ -148,6 +175,12 @@ int dfs_options(void *data, const char *arg, int key,  struct fuse_args *outargs
   case KEY_DIRECTIO:
     options.direct_io = 1;
     break;
+  case KEY_KEEPCACHE:
+    options.keep_cache = 1;
+    break;
+  case KEY_SPLICELOCALBLOCKS:
+    options.splice_local_blocks = 1;
+    break;
   case KEY_BIGWRITES:
 #ifdef FUSE_CAP_BIG_WRITES
     fuse_opt_add_arg(outargs, "-obig_writes");
@@ -34,6 +34,14 @@ struct options {
   int private;
   size_t rdbuffer_size;
   int direct_io;
+  int cache_size;
+  int cache_readahead;
+  int attr_cache_ttl;
+  int wrbuffer_size;
+  int statfs_cache_ttl;
+  int handle_cache_ttl;
+  int keep_cache;
+  int splice_local_blocks;
 } options;
 
 extern struct fuse_opt dfs_opts[];
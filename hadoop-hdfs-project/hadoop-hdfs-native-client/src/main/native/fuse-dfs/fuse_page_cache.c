@@ -0,0 +1,168 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuse_page_cache.h"
+#include "fuse_stats.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The versions are kept in a hash table of a fixed number of buckets, each
+ * holding at most FUSE_PAGE_CACHE_BUCKET_FILES paths, most recently opened
+ * first.
+ */
+#define FUSE_PAGE_CACHE_BUCKETS 1024
+#define FUSE_PAGE_CACHE_BUCKET_FILES 64
+
+struct fusePageFile {
+  // Next file in the same hash bucket
+  struct fusePageFile *hashNext;
+  char *path;
+  // The version the file had when it was last opened for reading
+  tTime mtime;
+  tOffset size;
+};
+
+struct fusePageCache {
+  // Protects the buckets
+  pthread_mutex_t lock;
+  struct fusePageFile *buckets[FUSE_PAGE_CACHE_BUCKETS];
+};
+
+static struct fusePageFile **fusePageBucket(struct fusePageCache *cache,
+                                            const char *path)
+{
+  // FNV-1a over the path
+  uint32_t hash = 2166136261U;
+
+  for (; *path; path++) {
+    hash = (hash ^ (unsigned char)*path) * 16777619U;
+  }
+  return &cache->buckets[hash % FUSE_PAGE_CACHE_BUCKETS];
+}
+
+static void fusePageFileFree(struct fusePageFile *file)
+{
+  free(file->path);
+  free(file);
+}
+
+int fusePageCacheAlloc(struct fusePageCache **out)
+{
+  struct fusePageCache *cache;
+  int ret;
+
+  cache = calloc(1, sizeof(*cache));
+  if (!cache) {
+    return ENOMEM;
+  }
+  ret = pthread_mutex_init(&cache->lock, NULL);
+  if (ret) {
+    free(cache);
+    return ret;
+  }
+  *out = cache;
+  return 0;
+}
+
+void fusePageCacheFree(struct fusePageCache *cache)
+{
+  struct fusePageFile *file;
+  int i;
+
+  for (i = 0; i < FUSE_PAGE_CACHE_BUCKETS; i++) {
+    while ((file = cache->buckets[i])) {
+      cache->buckets[i] = file->hashNext;
+      fusePageFileFree(file);
+    }
+  }
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+int fusePageCacheOpen(struct fusePageCache *cache, const char *path,
+                      tTime mtime, tOffset size)
+{
+  struct fusePageFile **bucket, **link, *file;
+  int files = 0, same = 0;
+
+  pthread_mutex_lock(&cache->lock);
+  bucket = fusePageBucket(cache, path);
+  for (link = bucket; *link; link = &(*link)->hashNext) {
+    if (!strcmp((*link)->path, path)) {
+      break;
+    }
+    files++;
+  }
+  file = *link;
+  if (file) {
+    *link = file->hashNext;
+    same = file->mtime == mtime && file->size == size;
+  } else if (files >= FUSE_PAGE_CACHE_BUCKET_FILES) {
+    // The bucket is full, the least recently opened file makes room
+    for (link = bucket; (*link)->hashNext; link = &(*link)->hashNext) {
+    }
+    file = *link;
+    *link = NULL;
+    free(file->path);
+    file->path = NULL;
+  }
+  if (!file) {
+    file = calloc(1, sizeof(*file));
+  }
+  if (file && !file->path) {
+    file->path = strdup(path);
+    if (!file->path) {
+      // Not remembered, the next open drops the pages again
+      free(file);
+      file = NULL;
+    }
+  }
+  if (file) {
+    file->mtime = mtime;
+    file->size = size;
+    file->hashNext = *bucket;
+    *bucket = file;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  fuseStatsCount(same ? FUSE_STATS_PAGE_CACHE_HITS :
+                 FUSE_STATS_PAGE_CACHE_MISSES, 1);
+  return same;
+}
+
+void fusePageCacheInvalidate(struct fusePageCache *cache, const char *path)
+{
+  struct fusePageFile **link, *file = NULL;
+
+  pthread_mutex_lock(&cache->lock);
+  for (link = fusePageBucket(cache, path); *link; link = &(*link)->hashNext) {
+    if (!strcmp((*link)->path, path)) {
+      file = *link;
+      *link = file->hashNext;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  if (file) {
+    fusePageFileFree(file);
+  }
+}
@@ -0,0 +1,66 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FUSE_PAGE_CACHE_H__
+#define __FUSE_PAGE_CACHE_H__
+
+#include <hdfs/hdfs.h>
+
+struct fusePageCache;
+
+/**
+ * Allocate the table of the file versions whose pages the kernel may keep
+ * across opens.  It is bounded, a version that was forgotten only costs the
+ * kernel its cached pages of the file.
+ *
+ * @param out           (out param) the new table.
+ *
+ * @return              0 on success; error code otherwise
+ */
+int fusePageCacheAlloc(struct fusePageCache **out);
+
+/**
+ * Free a page cache table.
+ */
+void fusePageCacheFree(struct fusePageCache *cache);
+
+/**
+ * Check whether a file opened for reading is the version the kernel cached
+ * pages of, and remember the version for the next open.
+ *
+ * @param cache         The table.
+ * @param path          The path of the file.
+ * @param mtime         The modification time of the file.
+ * @param size          The length of the file.
+ *
+ * @return              1 if the path had the same modification time and
+ *                      length at its previous open, so the open can set
+ *                      keep_cache; 0 if the kernel must drop its pages
+ */
+int fusePageCacheOpen(struct fusePageCache *cache, const char *path,
+                      tTime mtime, tOffset size);
+
+/**
+ * Forget the version of a path, so its next open drops the cached pages.
+ *
+ * @param cache         The table.
+ * @param path          The path that was modified, renamed or removed.
+ */
+void fusePageCacheInvalidate(struct fusePageCache *cache, const char *path);
+
+#endif
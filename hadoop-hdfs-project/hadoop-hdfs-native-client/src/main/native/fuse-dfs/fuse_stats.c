@@ -0,0 +1,423 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuse_stats.h"
+#include "fuse_block_cache.h"
+#include "fuse_context_handle.h"
+#include "fuse_dfs.h"
+#include "fuse_file_handle.h"
+#include "fuse_impls.h"
+#include "fuse_stat_struct.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Bucket i of a latency histogram counts the operations that took less than
+ * 2^i microseconds, down to half that; the last one everything slower.
+ */
+#define FUSE_STATS_BUCKETS 26
+
+struct fuseOpStats {
+  uint64_t count;
+  uint64_t errors;
+  uint64_t bytes;
+  uint64_t totalUs;
+  uint64_t maxUs;
+  uint64_t buckets[FUSE_STATS_BUCKETS];
+};
+
+/* Updated with relaxed atomics, so a snapshot may be off by the operations
+ * in flight while it is taken. */
+static struct fuseOpStats gOpStats[FUSE_STATS_NUM_OPS];
+static uint64_t gCounters[FUSE_STATS_NUM_COUNTERS];
+
+static const char * const gOpNames[FUSE_STATS_NUM_OPS] = {
+  "getattr", "open", "read", "write", "readdir", "release",
+};
+
+static const char * const gCounterNames[FUSE_STATS_NUM_COUNTERS] = {
+  "rdbuffer_hits", "rdbuffer_misses",
+  "block_cache_hits", "block_cache_misses", "block_cache_prefetches",
+  "connection_hits", "connections_made", "connections_closed",
+  "handle_cache_hits", "handle_cache_misses",
+  "page_cache_hits", "page_cache_misses",
+  "block_fd_reads",
+};
+
+void fuseStatsCount(enum fuseStatsCounter counter, uint64_t n)
+{
+  __atomic_fetch_add(&gCounters[counter], n, __ATOMIC_RELAXED);
+}
+
+uint64_t fuseStatsNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void fuseStatsRecord(enum fuseStatsOp op, uint64_t start, int ret)
+{
+  struct fuseOpStats *stats = &gOpStats[op];
+  uint64_t us = fuseStatsNow() - start;
+  uint64_t max;
+  int bucket;
+
+  bucket = us ? 64 - __builtin_clzll(us) : 0;
+  if (bucket >= FUSE_STATS_BUCKETS) {
+    bucket = FUSE_STATS_BUCKETS - 1;
+  }
+  __atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->totalUs, us, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->buckets[bucket], 1, __ATOMIC_RELAXED);
+  if (ret < 0) {
+    __atomic_fetch_add(&stats->errors, 1, __ATOMIC_RELAXED);
+  } else if (op == FUSE_STATS_READ || op == FUSE_STATS_WRITE) {
+    __atomic_fetch_add(&stats->bytes, (uint64_t)ret, __ATOMIC_RELAXED);
+  }
+  max = __atomic_load_n(&stats->maxUs, __ATOMIC_RELAXED);
+  while (us > max &&
+         !__atomic_compare_exchange_n(&stats->maxUs, &max, us, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/** A growing text buffer */
+struct fuseStatsText {
+  char *buf;
+  size_t length;
+  size_t capacity;
+  int oom;
+};
+
+static void stats_printf(struct fuseStatsText *text, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void stats_printf(struct fuseStatsText *text, const char *fmt, ...)
+{
+  va_list ap;
+  char *grown;
+  int ret;
+
+  if (text->oom) {
+    return;
+  }
+  while (1) {
+    va_start(ap, fmt);
+    ret = vsnprintf(text->buf + text->length, text->capacity - text->length,
+                    fmt, ap);
+    va_end(ap);
+    if (ret < 0) {
+      text->oom = 1;
+      return;
+    }
+    if ((size_t)ret < text->capacity - text->length) {
+      text->length += ret;
+      return;
+    }
+    grown = realloc(text->buf, text->capacity * 2 + ret);
+    if (!grown) {
+      text->oom = 1;
+      return;
+    }
+    text->buf = grown;
+    text->capacity = text->capacity * 2 + ret;
+  }
+}
+
+/**
+ * Get the upper bound of the latency below which a fraction of the
+ * operations in a histogram completed.
+ */
+static uint64_t stats_percentile(const uint64_t *buckets, uint64_t count,
+                                 double fraction)
+{
+  uint64_t target = (uint64_t)(count * fraction + 0.999999), seen = 0;
+  int i;
+
+  for (i = 0; i < FUSE_STATS_BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      break;
+    }
+  }
+  return (i >= FUSE_STATS_BUCKETS - 1) ? UINT64_MAX : ((uint64_t)1 << i);
+}
+
+static void stats_format(struct fuseStatsText *text, const dfs_context *dfs)
+{
+  struct fuseOpStats snap;
+  uint64_t counters[FUSE_STATS_NUM_COUNTERS], hits, misses;
+  size_t used, capacity;
+  int op, i;
+
+  stats_printf(text, "%-8s %12s %8s %14s %10s %10s %10s %10s %10s\n",
+               "op", "count", "errors", "bytes", "avg_us", "max_us",
+               "p50_us", "p90_us", "p99_us");
+  for (op = 0; op < FUSE_STATS_NUM_OPS; op++) {
+    snap.count = __atomic_load_n(&gOpStats[op].count, __ATOMIC_RELAXED);
+    snap.errors = __atomic_load_n(&gOpStats[op].errors, __ATOMIC_RELAXED);
+    snap.bytes = __atomic_load_n(&gOpStats[op].bytes, __ATOMIC_RELAXED);
+    snap.totalUs = __atomic_load_n(&gOpStats[op].totalUs, __ATOMIC_RELAXED);
+    snap.maxUs = __atomic_load_n(&gOpStats[op].maxUs, __ATOMIC_RELAXED);
+    for (i = 0; i < FUSE_STATS_BUCKETS; i++) {
+      snap.buckets[i] = __atomic_load_n(&gOpStats[op].buckets[i],
+                                        __ATOMIC_RELAXED);
+    }
+    // percentiles are bucket bounds, "inf" for the overflow bucket
+    stats_printf(text, "%-8s %12"PRIu64" %8"PRIu64" %14"PRIu64" %10"PRIu64
+                 " %10"PRIu64, gOpNames[op], snap.count, snap.errors,
+                 snap.bytes, snap.count ? snap.totalUs / snap.count : 0,
+                 snap.maxUs);
+    if (snap.count) {
+      uint64_t p[3];
+      p[0] = stats_percentile(snap.buckets, snap.count, 0.50);
+      p[1] = stats_percentile(snap.buckets, snap.count, 0.90);
+      p[2] = stats_percentile(snap.buckets, snap.count, 0.99);
+      for (i = 0; i < 3; i++) {
+        if (p[i] == UINT64_MAX) {
+          stats_printf(text, " %10s", "inf");
+        } else {
+          stats_printf(text, " %10"PRIu64, p[i]);
+        }
+      }
+    } else {
+      stats_printf(text, " %10d %10d %10d", 0, 0, 0);
+    }
+    stats_printf(text, "\n");
+  }
+
+  stats_printf(text, "\nlatency histogram, operations taking under the "
+               "given microseconds:\n");
+  for (op = 0; op < FUSE_STATS_NUM_OPS; op++) {
+    stats_printf(text, "%-8s", gOpNames[op]);
+    for (i = 0; i < FUSE_STATS_BUCKETS; i++) {
+      uint64_t n = __atomic_load_n(&gOpStats[op].buckets[i],
+                                   __ATOMIC_RELAXED);
+      if (!n) {
+        continue;
+      }
+      if (i == FUSE_STATS_BUCKETS - 1) {
+        stats_printf(text, " inf:%"PRIu64, n);
+      } else {
+        stats_printf(text, " %"PRIu64":%"PRIu64, (uint64_t)1 << i, n);
+      }
+    }
+    stats_printf(text, "\n");
+  }
+
+  stats_printf(text, "\n");
+  for (i = 0; i < FUSE_STATS_NUM_COUNTERS; i++) {
+    counters[i] = __atomic_load_n(&gCounters[i], __ATOMIC_RELAXED);
+    stats_printf(text, "%s %"PRIu64"\n", gCounterNames[i], counters[i]);
+  }
+  hits = counters[FUSE_STATS_RDBUFFER_HITS];
+  misses = counters[FUSE_STATS_RDBUFFER_MISSES];
+  stats_printf(text, "rdbuffer_hit_rate %.4f\n",
+               (hits + misses) ? (double)hits / (hits + misses) : 0.0);
+  hits = counters[FUSE_STATS_CACHE_HITS];
+  misses = counters[FUSE_STATS_CACHE_MISSES];
+  stats_printf(text, "block_cache_hit_rate %.4f\n",
+               (hits + misses) ? (double)hits / (hits + misses) : 0.0);
+  if (dfs->block_cache) {
+    fuseBlockCacheUsage(dfs->block_cache, &used, &capacity);
+    stats_printf(text, "block_cache_used_bytes %zu\n", used);
+    stats_printf(text, "block_cache_capacity_bytes %zu\n", capacity);
+  }
+  stats_printf(text, "connections_open %"PRIu64"\n",
+               counters[FUSE_STATS_CONN_NEW] - counters[FUSE_STATS_CONN_FREED]);
+}
+
+static int is_stats_path(const char *path)
+{
+  return path && !strcmp(path, FUSE_STATS_PATH);
+}
+
+/** Handles of the stats file have no hdfs file, only the text read in open */
+static int is_stats_handle(const struct fuse_file_info *fi)
+{
+  return fi->fh && !((dfs_fh*)fi->fh)->hdfsFH;
+}
+
+int dfs_stats_getattr(const char *path, struct stat *st)
+{
+  uint64_t start;
+  int ret;
+
+  if (is_stats_path(path)) {
+    memset(st, 0, sizeof(struct stat));
+    // Opened with direct_io, so a size of 0 does not stop reads
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+    st->st_uid = default_id;
+    st->st_gid = default_id;
+    st->st_mtime = time(NULL);
+    return 0;
+  }
+  start = fuseStatsNow();
+  ret = dfs_getattr(path, st);
+  fuseStatsRecord(FUSE_STATS_GETATTR, start, ret);
+  return ret;
+}
+
+int dfs_stats_open(const char *path, struct fuse_file_info *fi)
+{
+  dfs_context *dfs = (dfs_context*)fuse_get_context()->private_data;
+  struct fuseStatsText text;
+  dfs_fh *fh;
+  uint64_t start;
+  int ret;
+
+  if (!is_stats_path(path)) {
+    start = fuseStatsNow();
+    ret = dfs_open(path, fi);
+    fuseStatsRecord(FUSE_STATS_OPEN, start, ret);
+    return ret;
+  }
+  if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+    return -EACCES;
+  }
+  // Take the snapshot now, so that reads of one open see consistent text
+  memset(&text, 0, sizeof(text));
+  text.capacity = 4096;
+  text.buf = malloc(text.capacity);
+  if (!text.buf) {
+    return -ENOMEM;
+  }
+  stats_format(&text, dfs);
+  fh = calloc(1, sizeof(dfs_fh));
+  if (text.oom || !fh) {
+    free(fh);
+    free(text.buf);
+    return -ENOMEM;
+  }
+  fh->path = strdup(path);
+  if (!fh->path) {
+    free(fh);
+    free(text.buf);
+    return -ENOMEM;
+  }
+  fh->buf = text.buf;
+  fh->bufferSize = text.length;
+  fi->fh = (uint64_t)fh;
+  fi->direct_io = 1;
+  return 0;
+}
+
+int dfs_stats_read(const char *path, char *buf, size_t size, off_t offset,
+                   struct fuse_file_info *fi)
+{
+  dfs_fh *fh = (dfs_fh*)fi->fh;
+  uint64_t start;
+  int ret;
+
+  if (is_stats_handle(fi)) {
+    if (offset >= fh->bufferSize) {
+      return 0;
+    }
+    if (size > fh->bufferSize - offset) {
+      size = fh->bufferSize - offset;
+    }
+    memcpy(buf, fh->buf + offset, size);
+    return size;
+  }
+  start = fuseStatsNow();
+  ret = dfs_read(path, buf, size, offset, fi);
+  fuseStatsRecord(FUSE_STATS_READ, start, ret);
+  return ret;
+}
+
+#if FUSE_VERSION >= 29
+int dfs_stats_read_buf(const char *path, struct fuse_bufvec **bufp,
+                       size_t size, off_t offset, struct fuse_file_info *fi)
+{
+  struct fuse_bufvec *bv;
+  uint64_t start;
+  int ret;
+
+  if (is_stats_handle(fi)) {
+    bv = malloc(sizeof(*bv));
+    if (!bv) {
+      return -ENOMEM;
+    }
+    *bv = FUSE_BUFVEC_INIT(size);
+    bv->buf[0].mem = malloc(size ? size : 1);
+    if (!bv->buf[0].mem) {
+      free(bv);
+      return -ENOMEM;
+    }
+    bv->buf[0].size = dfs_stats_read(path, bv->buf[0].mem, size, offset, fi);
+    *bufp = bv;
+    return 0;
+  }
+  start = fuseStatsNow();
+  ret = dfs_read_buf(path, bufp, size, offset, fi);
+  fuseStatsRecord(FUSE_STATS_READ, start,
+                  ret ? ret : (int)(*bufp)->buf[0].size);
+  return ret;
+}
+#endif
+
+int dfs_stats_write(const char *path, const char *buf, size_t size,
+                    off_t offset, struct fuse_file_info *fi)
+{
+  uint64_t start = fuseStatsNow();
+  int ret;
+
+  ret = dfs_write(path, buf, size, offset, fi);
+  fuseStatsRecord(FUSE_STATS_WRITE, start, ret);
+  return ret;
+}
+
+int dfs_stats_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+                      off_t offset, struct fuse_file_info *fi)
+{
+  uint64_t start = fuseStatsNow();
+  int ret;
+
+  ret = dfs_readdir(path, buf, filler, offset, fi);
+  fuseStatsRecord(FUSE_STATS_READDIR, start, ret);
+  return ret;
+}
+
+int dfs_stats_release(const char *path, struct fuse_file_info *fi)
+{
+  dfs_fh *fh = (dfs_fh*)fi->fh;
+  uint64_t start;
+  int ret;
+
+  if (is_stats_handle(fi)) {
+    free(fh->buf);
+    free(fh->path);
+    free(fh);
+    fi->fh = 0;
+    return 0;
+  }
+  start = fuseStatsNow();
+  ret = dfs_release(path, fi);
+  fuseStatsRecord(FUSE_STATS_RELEASE, start, ret);
+  return ret;
+}
@@ -0,0 +1,111 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FUSE_STATS_H__
+#define __FUSE_STATS_H__
+
+#include <fuse.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * The virtual file the statistics can be read from.  It is not listed in the
+ * root directory, and hides an HDFS file of the same name.
+ */
+#define FUSE_STATS_PATH "/.fuse_dfs_stats"
+
+/** The operations whose latency is kept */
+enum fuseStatsOp {
+  FUSE_STATS_GETATTR = 0,
+  FUSE_STATS_OPEN,
+  FUSE_STATS_READ,
+  FUSE_STATS_WRITE,
+  FUSE_STATS_READDIR,
+  FUSE_STATS_RELEASE,
+  FUSE_STATS_NUM_OPS,
+};
+
+/** Plain event counters */
+enum fuseStatsCounter {
+  // Reads served from the read buffer of a handle, and reads that refilled it
+  FUSE_STATS_RDBUFFER_HITS = 0,
+  FUSE_STATS_RDBUFFER_MISSES,
+  // Chunks found in the block cache, chunks readers had to read, and chunks
+  // prefetched
+  FUSE_STATS_CACHE_HITS,
+  FUSE_STATS_CACHE_MISSES,
+  FUSE_STATS_CACHE_PREFETCHES,
+  // Lookups that found a connection for the user, connections made and
+  // connections closed
+  FUSE_STATS_CONN_HITS,
+  FUSE_STATS_CONN_NEW,
+  FUSE_STATS_CONN_FREED,
+  // Opens that shared a cached read-only handle, and opens that had to open
+  // one
+  FUSE_STATS_HANDLE_HITS,
+  FUSE_STATS_HANDLE_MISSES,
+  // Opens that let the kernel keep its cached pages of an unchanged file,
+  // and opens that made it drop them
+  FUSE_STATS_PAGE_CACHE_HITS,
+  FUSE_STATS_PAGE_CACHE_MISSES,
+  // Reads replied to from a local block file with splice_local_blocks
+  FUSE_STATS_BLOCK_FD_READS,
+  FUSE_STATS_NUM_COUNTERS,
+};
+
+/**
+ * Count an event.  This is a single atomic add.
+ */
+void fuseStatsCount(enum fuseStatsCounter counter, uint64_t n);
+
+/**
+ * Get the time to pass to fuseStatsRecord.
+ *
+ * @return              The monotonic time in microseconds
+ */
+uint64_t fuseStatsNow(void);
+
+/**
+ * Record one operation.
+ *
+ * @param op            The operation.
+ * @param start         What fuseStatsNow returned when it started.
+ * @param ret           What it returns to FUSE: a negative error code, or
+ *                      for reads and writes the number of bytes.
+ */
+void fuseStatsRecord(enum fuseStatsOp op, uint64_t start, int ret);
+
+/**
+ * The fuse_operations hooks that keep the statistics, wrapping the dfs_
+ * hooks of the same name, and serving FUSE_STATS_PATH.
+ */
+int dfs_stats_getattr(const char *path, struct stat *st);
+int dfs_stats_open(const char *path, struct fuse_file_info *fi);
+int dfs_stats_read(const char *path, char *buf, size_t size, off_t offset,
+                   struct fuse_file_info *fi);
+#if FUSE_VERSION >= 29
+int dfs_stats_read_buf(const char *path, struct fuse_bufvec **bufp,
+                       size_t size, off_t offset, struct fuse_file_info *fi);
+#endif
+int dfs_stats_write(const char *path, const char *buf, size_t size,
+                    off_t offset, struct fuse_file_info *fi);
+int dfs_stats_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+                      off_t offset, struct fuse_file_info *fi);
+int dfs_stats_release(const char *path, struct fuse_file_info *fi);
+
+#endif
@@ -20,9 +20,12 @@
 #include <pthread.h>
 #include <grp.h>
 #include <pwd.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "fuse_dfs.h"
+#include "fuse_users.h"
 
 /*
  * getpwuid and getgrgid return static structs so we safeguard the contents
@@ -32,11 +35,235 @@
 pthread_mutex_t passwdstruct_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t groupstruct_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Every FUSE operation maps the uid of the caller to a user name, and every
+ * getattr maps the owner and group names of a file to ids.  With an NSS
+ * backed by LDAP each of those lookups can take milliseconds, so their
+ * results are cached for FUSE_ID_CACHE_TTL seconds, failed lookups
+ * included.  Each direction has its own table, split into shards with a
+ * read-write lock each, so that concurrent hits don't wait for each other.
+ */
+#define FUSE_ID_CACHE_TTL 60
+#define FUSE_ID_CACHE_SHARDS 16
+#define FUSE_ID_CACHE_BUCKETS 64
+/* A shard that is full drops its expired entries, or all of them if none are */
+#define FUSE_ID_CACHE_SHARD_ENTRIES 256
+
+struct fuseIdEntry {
+  struct fuseIdEntry *next;
+  int64_t id;
+  // NULL if an id is cached as having no name
+  char *name;
+  // Zero if a name is cached as having no id
+  int found;
+  time_t loaded;
+};
+
+struct fuseIdShard {
+  pthread_rwlock_t lock;
+  struct fuseIdEntry *buckets[FUSE_ID_CACHE_BUCKETS];
+  int numEntries;
+};
+
+struct fuseIdCache {
+  // Whether entries are looked up by name rather than by id
+  int byName;
+  struct fuseIdShard shards[FUSE_ID_CACHE_SHARDS];
+};
+
+static struct fuseIdCache gUserNames = { 0 };
+static struct fuseIdCache gGroupNames = { 0 };
+static struct fuseIdCache gUserIds = { 1 };
+static struct fuseIdCache gGroupIds = { 1 };
+static pthread_once_t gIdCacheOnce = PTHREAD_ONCE_INIT;
+
+static void idCacheInitOne(struct fuseIdCache *cache)
+{
+  int i;
+
+  for (i = 0; i < FUSE_ID_CACHE_SHARDS; i++) {
+    pthread_rwlock_init(&cache->shards[i].lock, NULL);
+  }
+}
+
+static void idCacheInit(void)
+{
+  idCacheInitOne(&gUserNames);
+  idCacheInitOne(&gGroupNames);
+  idCacheInitOne(&gUserIds);
+  idCacheInitOne(&gGroupIds);
+}
+
+static uint32_t idCacheHash(const struct fuseIdCache *cache, int64_t id,
+                            const char *name)
+{
+  uint32_t hash = 2166136261U;
+
+  if (!cache->byName) {
+    return (uint32_t)id * 2654435761U;
+  }
+  // FNV-1a
+  for (; *name; name++) {
+    hash ^= (unsigned char)*name;
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+static int idCacheMatches(const struct fuseIdCache *cache,
+                          const struct fuseIdEntry *entry, int64_t id,
+                          const char *name)
+{
+  if (cache->byName) {
+    return entry->name && !strcmp(entry->name, name);
+  }
+  return entry->id == id;
+}
+
+/**
+ * Look an id or a name up in a cache.
+ *
+ * @param id        The id to look up, if the cache is by id
+ * @param name      The name to look up, if the cache is by name
+ * @param out       (out param) a copy of the cached entry, whose name the
+ *                  caller must free, on a hit
+ *
+ * @return          1 on a hit; 0 otherwise
+ */
+static int idCacheGet(struct fuseIdCache *cache, int64_t id, const char *name,
+                      struct fuseIdEntry *out)
+{
+  uint32_t hash = idCacheHash(cache, id, name);
+  struct fuseIdShard *shard = &cache->shards[hash % FUSE_ID_CACHE_SHARDS];
+  struct fuseIdEntry *entry;
+  time_t now = time(NULL);
+  int hit = 0;
+
+  pthread_once(&gIdCacheOnce, idCacheInit);
+  pthread_rwlock_rdlock(&shard->lock);
+  entry = shard->buckets[(hash / FUSE_ID_CACHE_SHARDS) % FUSE_ID_CACHE_BUCKETS];
+  for (; entry; entry = entry->next) {
+    if (!idCacheMatches(cache, entry, id, name)) {
+      continue;
+    }
+    // a clock stepping backwards expires the entry as well
+    if (now < entry->loaded || now - entry->loaded >= FUSE_ID_CACHE_TTL) {
+      break;
+    }
+    *out = *entry;
+    out->next = NULL;
+    out->name = NULL;
+    if (entry->name) {
+      out->name = strdup(entry->name);
+      if (!out->name) {
+        break;
+      }
+    }
+    hit = 1;
+    break;
+  }
+  pthread_rwlock_unlock(&shard->lock);
+  return hit;
+}
+
+static void idCacheFreeEntry(struct fuseIdEntry *entry)
+{
+  free(entry->name);
+  free(entry);
+}
+
+/**
+ * Drop the entries of a shard loaded before a time, or all of them with
+ * 0, called with the shard write-locked.
+ */
+static void idCacheEvict(struct fuseIdShard *shard, time_t loadedBefore)
+{
+  struct fuseIdEntry **link, *entry;
+  int i;
+
+  for (i = 0; i < FUSE_ID_CACHE_BUCKETS; i++) {
+    link = &shard->buckets[i];
+    while ((entry = *link)) {
+      if (loadedBefore && entry->loaded >= loadedBefore) {
+        link = &entry->next;
+        continue;
+      }
+      *link = entry->next;
+      idCacheFreeEntry(entry);
+      shard->numEntries--;
+    }
+  }
+}
+
+/**
+ * Cache the result of a lookup.
+ *
+ * @param id        The id
+ * @param name      The name, NULL if the id has none
+ * @param found     Whether the name has an id, if the cache is by name
+ */
+static void idCachePut(struct fuseIdCache *cache, int64_t id,
+                       const char *name, int found)
+{
+  uint32_t hash;
+  struct fuseIdShard *shard;
+  struct fuseIdEntry **link, *entry, *old;
+  time_t now = time(NULL);
+
+  if (cache->byName && !name) {
+    return;
+  }
+  hash = idCacheHash(cache, id, name);
+  shard = &cache->shards[hash % FUSE_ID_CACHE_SHARDS];
+  entry = calloc(1, sizeof(*entry));
+  if (!entry) {
+    return;
+  }
+  entry->id = id;
+  entry->found = found;
+  entry->loaded = now;
+  if (name) {
+    entry->name = strdup(name);
+    if (!entry->name) {
+      free(entry);
+      return;
+    }
+  }
+  pthread_once(&gIdCacheOnce, idCacheInit);
+  pthread_rwlock_wrlock(&shard->lock);
+  link = &shard->buckets[(hash / FUSE_ID_CACHE_SHARDS) % FUSE_ID_CACHE_BUCKETS];
+  for (; (old = *link); link = &old->next) {
+    if (idCacheMatches(cache, old, id, name)) {
+      *link = old->next;
+      idCacheFreeEntry(old);
+      shard->numEntries--;
+      break;
+    }
+  }
+  if (shard->numEntries >= FUSE_ID_CACHE_SHARD_ENTRIES) {
+    idCacheEvict(shard, now - FUSE_ID_CACHE_TTL + 1);
+    if (shard->numEntries >= FUSE_ID_CACHE_SHARD_ENTRIES) {
+      idCacheEvict(shard, 0);
+    }
+  }
+  link = &shard->buckets[(hash / FUSE_ID_CACHE_SHARDS) % FUSE_ID_CACHE_BUCKETS];
+  entry->next = *link;
+  *link = entry;
+  shard->numEntries++;
+  pthread_rwlock_unlock(&shard->lock);
+}
+
 /*
  * Utility for getting the user making the fuse call in char * form
  * NOTE: if non-null return, the return must be freed by the caller.
  */
 char *getUsername(uid_t uid) {
+  struct fuseIdEntry cached;
+
+  if (idCacheGet(&gUserNames, uid, NULL, &cached)) {
+    return cached.name;
+  }
+
   //
   // Critical section - protect from concurrent calls in different threads.
   // since the struct below is static.
@@ -47,15 +274,70 @@ char *getUsername(uid_t uid) {
 
   struct passwd *userinfo = getpwuid(uid);
   char * ret = userinfo && userinfo->pw_name ? strdup(userinfo->pw_name) : NULL;
+  int found = userinfo != NULL;
 
   pthread_mutex_unlock(&passwdstruct_mutex);
 
   //
   // End critical section 
   // 
+  // Don't remember a name as missing when only strdup failed
+  if (ret || !found) {
+    idCachePut(&gUserNames, uid, ret, 1);
+  }
   return ret;
 }
 
+int getUserId(const char *name, uid_t *uid) {
+  struct fuseIdEntry cached;
+  struct passwd *userinfo;
+
+  if (idCacheGet(&gUserIds, 0, name, &cached)) {
+    free(cached.name);
+    *uid = (uid_t)cached.id;
+    return cached.found ? 0 : ENOENT;
+  }
+
+  //
+  // Critical section - protect from concurrent calls in different threads.
+  // since the struct below is static.
+  //
+  pthread_mutex_lock(&passwdstruct_mutex);
+  userinfo = getpwnam(name);
+  if (userinfo) {
+    *uid = userinfo->pw_uid;
+  }
+  pthread_mutex_unlock(&passwdstruct_mutex);
+
+  idCachePut(&gUserIds, userinfo ? *uid : 0, name, userinfo != NULL);
+  return userinfo ? 0 : ENOENT;
+}
+
+int getGroupId(const char *name, gid_t *gid) {
+  struct fuseIdEntry cached;
+  struct group *grp;
+
+  if (idCacheGet(&gGroupIds, 0, name, &cached)) {
+    free(cached.name);
+    *gid = (gid_t)cached.id;
+    return cached.found ? 0 : ENOENT;
+  }
+
+  //
+  // Critical section - protect from concurrent calls in different threads.
+  // since the struct below is static.
+  //
+  pthread_mutex_lock(&groupstruct_mutex);
+  grp = getgrnam(name);
+  if (grp) {
+    *gid = grp->gr_gid;
+  }
+  pthread_mutex_unlock(&groupstruct_mutex);
+
+  idCachePut(&gGroupIds, grp ? *gid : 0, name, grp != NULL);
+  return grp ? 0 : ENOENT;
+}
+
 /**
  * Cleans up a char ** group pointer
  */
@@ -74,6 +356,12 @@ void freeGroups(char **groups, int numgroups) {
 #define GROUPBUF_SIZE 5
 
 char *getGroup(gid_t gid) {
+  struct fuseIdEntry cached;
+
+  if (idCacheGet(&gGroupNames, gid, NULL, &cached)) {
+    return cached.name;
+  }
+
   //
   // Critical section - protect from concurrent calls in different threads.
   // since the struct below is static.
@@ -84,12 +372,16 @@ char *getGroup(gid_t gid) {
 
   struct group* grp = getgrgid(gid);
   char * ret = grp && grp->gr_name ? strdup(grp->gr_name) : NULL;
+  int found = grp != NULL;
 
   //
   // End critical section 
   // 
   pthread_mutex_unlock(&groupstruct_mutex);
 
+  if (ret || !found) {
+    idCachePut(&gGroupNames, gid, ret, 1);
+  }
   return ret;
 }
 
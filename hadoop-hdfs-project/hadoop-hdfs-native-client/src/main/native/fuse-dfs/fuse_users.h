@@ -28,6 +28,8 @@
  * 1. all these functions should be thread safe.
  * 2. the ones that return char * or char **, generally require
  * the caller to free the return value.
+ * 3. getUsername, getGroup, getUserId and getGroupId cache their results
+ * for a minute, so changes to the user database show up that much later.
  *
  */
 
@@ -38,6 +40,20 @@
  */
 char *getUsername(uid_t uid);
 
+/**
+ * Look up the uid of a user name.
+ *
+ * @return  0 on success; ENOENT if there is no such user
+ */
+int getUserId(const char *name, uid_t *uid);
+
+/**
+ * Look up the gid of a group name.
+ *
+ * @return  0 on success; ENOENT if there is no such group
+ */
+int getGroupId(const char *name, gid_t *gid);
+
 
 /**
  * Cleans up a char ** group pointer
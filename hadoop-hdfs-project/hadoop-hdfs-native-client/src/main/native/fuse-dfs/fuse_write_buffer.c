@@ -0,0 +1,203 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fuse_write_buffer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *fuseWriteBufferThread(void *v)
+{
+  struct fuseWriteBuffer *wb = v;
+  const char *buf;
+  size_t length, done;
+  tSize ret;
+  int err;
+
+  pthread_mutex_lock(&wb->lock);
+  for (;;) {
+    while (!wb->pending && !wb->stop) {
+      pthread_cond_wait(&wb->cond, &wb->lock);
+    }
+    if (!wb->pending) {
+      break;
+    }
+    buf = wb->bufs[!wb->active];
+    length = wb->pending;
+    // Nothing written after a failure can end up in the right place
+    err = wb->error;
+    pthread_mutex_unlock(&wb->lock);
+    done = 0;
+    while (!err && done < length) {
+      ret = hdfsWrite(wb->fs, wb->file, buf + done, length - done);
+      if (ret <= 0) {
+        err = (errno == 0 || errno == EINTERNAL) ? EIO : errno;
+      } else {
+        done += ret;
+      }
+    }
+    pthread_mutex_lock(&wb->lock);
+    if (err && !wb->error) {
+      wb->error = err;
+    }
+    wb->pending = 0;
+    pthread_cond_broadcast(&wb->cond);
+  }
+  pthread_mutex_unlock(&wb->lock);
+  return NULL;
+}
+
+/**
+ * Hand the buffer being filled to the writer, once it is done with the other
+ * one.  Called with the lock held.
+ */
+static void fuseWriteBufferHandOff(struct fuseWriteBuffer *wb)
+{
+  while (wb->pending) {
+    pthread_cond_wait(&wb->cond, &wb->lock);
+  }
+  if (wb->error) {
+    wb->fill = 0;
+    return;
+  }
+  wb->pending = wb->fill;
+  wb->active = !wb->active;
+  wb->fill = 0;
+  pthread_cond_broadcast(&wb->cond);
+}
+
+int fuseWriteBufferInit(struct fuseWriteBuffer *wb, hdfsFS fs, hdfsFile file,
+                        size_t capacity)
+{
+  int ret;
+
+  memset(wb, 0, sizeof(*wb));
+  wb->fs = fs;
+  wb->file = file;
+  wb->offset = hdfsTell(fs, file);
+  if (wb->offset < 0) {
+    return errno ? errno : EIO;
+  }
+  wb->bufs[0] = malloc(capacity);
+  wb->bufs[1] = malloc(capacity);
+  if (!wb->bufs[0] || !wb->bufs[1]) {
+    ret = ENOMEM;
+    goto error;
+  }
+  if (pthread_mutex_init(&wb->lock, NULL)) {
+    ret = ENOMEM;
+    goto error;
+  }
+  if (pthread_cond_init(&wb->cond, NULL)) {
+    pthread_mutex_destroy(&wb->lock);
+    ret = ENOMEM;
+    goto error;
+  }
+  ret = pthread_create(&wb->thread, NULL, fuseWriteBufferThread, wb);
+  if (ret) {
+    pthread_cond_destroy(&wb->cond);
+    pthread_mutex_destroy(&wb->lock);
+    goto error;
+  }
+  wb->capacity = capacity;
+  return 0;
+
+error:
+  free(wb->bufs[0]);
+  free(wb->bufs[1]);
+  memset(wb, 0, sizeof(*wb));
+  return ret;
+}
+
+int fuseWriteBufferWrite(struct fuseWriteBuffer *wb, const char *buf,
+                         size_t size)
+{
+  size_t length;
+  int ret = 0;
+
+  pthread_mutex_lock(&wb->lock);
+  while (size > 0) {
+    if (wb->error) {
+      ret = -wb->error;
+      break;
+    }
+    length = wb->capacity - wb->fill;
+    if (length > size) {
+      length = size;
+    }
+    memcpy(wb->bufs[wb->active] + wb->fill, buf, length);
+    wb->fill += length;
+    wb->offset += length;
+    buf += length;
+    size -= length;
+    if (wb->fill == wb->capacity) {
+      fuseWriteBufferHandOff(wb);
+    }
+  }
+  pthread_mutex_unlock(&wb->lock);
+  return ret;
+}
+
+tOffset fuseWriteBufferOffset(struct fuseWriteBuffer *wb)
+{
+  tOffset offset;
+
+  pthread_mutex_lock(&wb->lock);
+  offset = wb->offset;
+  pthread_mutex_unlock(&wb->lock);
+  return offset;
+}
+
+int fuseWriteBufferFlush(struct fuseWriteBuffer *wb)
+{
+  int ret;
+
+  pthread_mutex_lock(&wb->lock);
+  if (wb->fill) {
+    fuseWriteBufferHandOff(wb);
+  }
+  while (wb->pending) {
+    pthread_cond_wait(&wb->cond, &wb->lock);
+  }
+  ret = -wb->error;
+  pthread_mutex_unlock(&wb->lock);
+  return ret;
+}
+
+int fuseWriteBufferDestroy(struct fuseWriteBuffer *wb)
+{
+  int ret;
+
+  if (!wb->capacity) {
+    return 0;
+  }
+  ret = fuseWriteBufferFlush(wb);
+  pthread_mutex_lock(&wb->lock);
+  wb->stop = 1;
+  pthread_cond_broadcast(&wb->cond);
+  pthread_mutex_unlock(&wb->lock);
+  pthread_join(wb->thread, NULL);
+  pthread_cond_destroy(&wb->cond);
+  pthread_mutex_destroy(&wb->lock);
+  free(wb->bufs[0]);
+  free(wb->bufs[1]);
+  memset(wb, 0, sizeof(*wb));
+  return ret;
+}
@@ -0,0 +1,105 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FUSE_WRITE_BUFFER_H__
+#define __FUSE_WRITE_BUFFER_H__
+
+#include <hdfs/hdfs.h>
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * Write-behind state of a handle opened for writing.
+ *
+ * FUSE hands writes over in pieces of at most 128 KB.  They are copied into
+ * one of two buffers, and when it is full a writer thread of the handle
+ * passes it to hdfsWrite while the next writes fill the other one, so that
+ * the application only waits for hdfs when it gets two buffers ahead.
+ *
+ * A failed background write is reported by the next write or flush of the
+ * handle, and by every one after it, since the data behind it is lost.
+ */
+struct fuseWriteBuffer {
+  hdfsFS fs;
+  hdfsFile file;
+  // The size of each buffer, 0 if fuseWriteBufferInit was not called
+  size_t capacity;
+  char *bufs[2];
+  // Protects everything below
+  pthread_mutex_t lock;
+  // Signalled when a buffer is handed to the writer, when the writer is done
+  // with it, and on shutdown
+  pthread_cond_t cond;
+  pthread_t thread;
+  // The buffer being filled, and how much of it is
+  int active;
+  size_t fill;
+  // How much of the other buffer the writer still has to write, 0 if it is
+  // idle
+  size_t pending;
+  // The offset the next write must start at
+  tOffset offset;
+  // The first error of a background write, 0 if none
+  int error;
+  int stop;
+};
+
+/**
+ * Set up the write-behind state of a handle and start its writer thread.
+ *
+ * @param fs            The connection the file was opened through.
+ * @param file          The file, opened for writing.
+ * @param capacity      The size of each of the two buffers.
+ *
+ * @return              0 on success; error code otherwise
+ */
+int fuseWriteBufferInit(struct fuseWriteBuffer *wb, hdfsFS fs, hdfsFile file,
+                        size_t capacity);
+
+/**
+ * Buffer data written at the current end of the file.
+ *
+ * @return              0 on success; negative error code otherwise
+ */
+int fuseWriteBufferWrite(struct fuseWriteBuffer *wb, const char *buf,
+                         size_t size);
+
+/**
+ * Get the offset the next write must start at.
+ */
+tOffset fuseWriteBufferOffset(struct fuseWriteBuffer *wb);
+
+/**
+ * Pass everything buffered to hdfsWrite and wait for it.  This does not call
+ * hdfsFlush.
+ *
+ * @return              0 on success; negative error code otherwise
+ */
+int fuseWriteBufferFlush(struct fuseWriteBuffer *wb);
+
+/**
+ * Flush the buffers, stop the writer thread and free the state.  This must
+ * be called before the file is closed.  It does nothing if
+ * fuseWriteBufferInit was not called.
+ *
+ * @return              0 on success; negative error code if buffered data
+ *                      could not be written
+ */
+int fuseWriteBufferDestroy(struct fuseWriteBuffer *wb);
+
+#endif
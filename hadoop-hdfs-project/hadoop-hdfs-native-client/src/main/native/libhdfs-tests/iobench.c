@@ -0,0 +1,567 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the throughput and latency of libhdfs calls made from several
+ * threads at once.  Each thread uses its own file in IOBENCH_DIR and runs, one
+ * phase after the other, streaming writes, sequential reads and random
+ * positional reads of each of the IOBENCH_PREAD_SIZES.  Every phase prints its
+ * ops/s, MB/s and the percentiles of the latency of a single call.
+ *
+ * IOBENCH_THREADS      the number of threads, 4 by default
+ * IOBENCH_SECONDS      how long to run each phase, 10 seconds by default
+ * IOBENCH_WRITE_SIZE   the size of each write, 1 MB by default
+ * IOBENCH_READ_SIZE    the size of each sequential read, 1 MB by default
+ * IOBENCH_PREAD_SIZES  comma separated sizes of the positional reads,
+ *                      "4096,65536,1048576" by default
+ * IOBENCH_DIR          the directory of the files, "/tmp/iobench" by default
+ * IOBENCH_RPC_ADDRESS  the NameNode to use, such as "default"; a
+ *                      native_mini_dfs cluster is started when it is not set
+ */
+
+#include "hdfs/hdfs.h"
+#include "native_mini_dfs.h"
+#include "os/clock.h"
+#include "os/thread.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IOBENCH_MAX_THREADS 64
+#define IOBENCH_MAX_OP_SIZE (64 * 1024 * 1024)
+#define IOBENCH_MAX_PREAD_SIZES 16
+
+enum iobench_op {
+    IOBENCH_WRITE,
+    IOBENCH_READ,
+    IOBENCH_PREAD,
+};
+
+static const char * const IOBENCH_OP_NAMES[] = { "write", "read", "pread" };
+
+struct options {
+    // The number of threads.
+    int threads;
+
+    // How long to run each phase for.
+    int seconds;
+
+    // The size of each write.
+    int writeSize;
+
+    // The size of each sequential read.
+    int readSize;
+
+    // The sizes of the positional reads.
+    int preadSizes[IOBENCH_MAX_PREAD_SIZES];
+    int numPreadSizes;
+
+    // The directory of the files.
+    const char *dir;
+
+    // RPC address to use for HDFS, or NULL to start a mini cluster
+    const char *rpcAddress;
+};
+
+struct iobench_thread {
+    // The thread.
+    thread theThread;
+
+    // The options of the run.
+    const struct options *opts;
+
+    // The filesystem, shared by all threads.
+    hdfsFS fs;
+
+    // The file of this thread.
+    char path[4096];
+
+    // What this thread does in the current phase, and with what size.
+    enum iobench_op op;
+    int opSize;
+
+    // State of the random positions of the positional reads.
+    uint64_t random;
+
+    // The calls made in the phase, and the latency of each in microseconds.
+    uint32_t *latencies;
+    size_t numOps;
+    size_t latenciesCapacity;
+
+    // The bytes moved in the phase.
+    int64_t bytes;
+
+    // 0 if the phase was successful; error code otherwise.
+    int error;
+};
+
+static int parse_size(const char *name, const char *str, int defaultSize,
+                      int *out)
+{
+    int size = str ? atoi(str) : defaultSize;
+
+    if (size <= 0 || size > IOBENCH_MAX_OP_SIZE) {
+        fprintf(stderr, "%s must be between 1 and %d.\n", name,
+                IOBENCH_MAX_OP_SIZE);
+        return EINVAL;
+    }
+    *out = size;
+    return 0;
+}
+
+static int options_init(struct options *opts)
+{
+    const char *str;
+    char *sizes, *size, *saveptr = NULL;
+    int ret = 0;
+
+    str = getenv("IOBENCH_THREADS");
+    opts->threads = str ? atoi(str) : 4;
+    if (opts->threads <= 0 || opts->threads > IOBENCH_MAX_THREADS) {
+        fprintf(stderr, "IOBENCH_THREADS must be between 1 and %d.\n",
+                IOBENCH_MAX_THREADS);
+        return EINVAL;
+    }
+    str = getenv("IOBENCH_SECONDS");
+    opts->seconds = str ? atoi(str) : 10;
+    if (opts->seconds <= 0) {
+        fprintf(stderr, "IOBENCH_SECONDS must be greater than 0.\n");
+        return EINVAL;
+    }
+    if (parse_size("IOBENCH_WRITE_SIZE", getenv("IOBENCH_WRITE_SIZE"),
+                   1024 * 1024, &opts->writeSize) ||
+        parse_size("IOBENCH_READ_SIZE", getenv("IOBENCH_READ_SIZE"),
+                   1024 * 1024, &opts->readSize)) {
+        return EINVAL;
+    }
+    str = getenv("IOBENCH_PREAD_SIZES");
+    sizes = strdup(str ? str : "4096,65536,1048576");
+    if (!sizes) {
+        return ENOMEM;
+    }
+    opts->numPreadSizes = 0;
+    for (size = strtok_r(sizes, ",", &saveptr); size;
+         size = strtok_r(NULL, ",", &saveptr)) {
+        if (opts->numPreadSizes == IOBENCH_MAX_PREAD_SIZES) {
+            fprintf(stderr, "IOBENCH_PREAD_SIZES can have at most %d "
+                    "sizes.\n", IOBENCH_MAX_PREAD_SIZES);
+            ret = EINVAL;
+            break;
+        }
+        ret = parse_size("IOBENCH_PREAD_SIZES", size, 0,
+                         &opts->preadSizes[opts->numPreadSizes++]);
+        if (ret) {
+            break;
+        }
+    }
+    free(sizes);
+    if (ret) {
+        return ret;
+    }
+    opts->dir = getenv("IOBENCH_DIR");
+    if (!opts->dir) {
+        opts->dir = "/tmp/iobench";
+    }
+    opts->rpcAddress = getenv("IOBENCH_RPC_ADDRESS");
+    return 0;
+}
+
+/**
+ * A xorshift generator, so that threads do not share the state of rand().
+ */
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static int record_latency(struct iobench_thread *t, uint64_t micros)
+{
+    uint32_t *latencies;
+    size_t capacity;
+
+    if (t->numOps == t->latenciesCapacity) {
+        capacity = t->latenciesCapacity ? t->latenciesCapacity * 2 : 4096;
+        latencies = realloc(t->latencies, capacity * sizeof(uint32_t));
+        if (!latencies) {
+            return ENOMEM;
+        }
+        t->latencies = latencies;
+        t->latenciesCapacity = capacity;
+    }
+    t->latencies[t->numOps++] = micros > UINT32_MAX ?
+        UINT32_MAX : (uint32_t)micros;
+    return 0;
+}
+
+static void run_write(struct iobench_thread *t, char *buf, uint64_t end)
+{
+    hdfsFile file;
+    uint64_t start, now;
+    tSize ret;
+
+    file = hdfsOpenFile(t->fs, t->path, O_WRONLY, 0, 0, 0);
+    if (!file) {
+        t->error = errno;
+        fprintf(stderr, "hdfsOpenFile(%s, O_WRONLY) failed: error %d (%s)\n",
+                t->path, t->error, strerror(t->error));
+        return;
+    }
+    do {
+        start = monotonicMicros();
+        ret = hdfsWrite(t->fs, file, buf, t->opSize);
+        now = monotonicMicros();
+        if (ret < 0) {
+            t->error = errno;
+            fprintf(stderr, "hdfsWrite(%s) failed: error %d (%s)\n",
+                    t->path, t->error, strerror(t->error));
+            break;
+        }
+        t->bytes += ret;
+        t->error = record_latency(t, now - start);
+    } while (!t->error && now < end);
+    if (hdfsCloseFile(t->fs, file) && !t->error) {
+        t->error = errno;
+        fprintf(stderr, "hdfsCloseFile(%s) failed: error %d (%s)\n",
+                t->path, t->error, strerror(t->error));
+    }
+}
+
+static void run_read(struct iobench_thread *t, char *buf, uint64_t end)
+{
+    hdfsFile file;
+    uint64_t start, now;
+    tSize ret;
+
+    file = hdfsOpenFile(t->fs, t->path, O_RDONLY, 0, 0, 0);
+    if (!file) {
+        t->error = errno;
+        fprintf(stderr, "hdfsOpenFile(%s) failed: error %d (%s)\n",
+                t->path, t->error, strerror(t->error));
+        return;
+    }
+    do {
+        start = monotonicMicros();
+        ret = hdfsRead(t->fs, file, buf, t->opSize);
+        if (ret == 0) {
+            // Start again from the beginning at the end of the file
+            if (hdfsSeek(t->fs, file, 0)) {
+                t->error = errno;
+                fprintf(stderr, "hdfsSeek(%s, 0) failed: error %d (%s)\n",
+                        t->path, t->error, strerror(t->error));
+                break;
+            }
+            now = monotonicMicros();
+            continue;
+        }
+        now = monotonicMicros();
+        if (ret < 0) {
+            t->error = errno;
+            fprintf(stderr, "hdfsRead(%s) failed: error %d (%s)\n",
+                    t->path, t->error, strerror(t->error));
+            break;
+        }
+        t->bytes += ret;
+        t->error = record_latency(t, now - start);
+    } while (!t->error && now < end);
+    hdfsCloseFile(t->fs, file);
+}
+
+static void run_pread(struct iobench_thread *t, char *buf, uint64_t end)
+{
+    hdfsFile file;
+    hdfsFileInfo *info;
+    tOffset size, position;
+    uint64_t start, now;
+    tSize ret;
+
+    info = hdfsGetPathInfo(t->fs, t->path);
+    if (!info) {
+        t->error = errno;
+        fprintf(stderr, "hdfsGetPathInfo(%s) failed: error %d (%s)\n",
+                t->path, t->error, strerror(t->error));
+        return;
+    }
+    size = info->mSize;
+    hdfsFreeFileInfo(info, 1);
+    if (size < t->opSize) {
+        fprintf(stderr, "%s is shorter than one read of %d bytes; make "
+                "IOBENCH_SECONDS longer.\n", t->path, t->opSize);
+        t->error = EINVAL;
+        return;
+    }
+    file = hdfsOpenFile(t->fs, t->path, O_RDONLY, 0, 0, 0);
+    if (!file) {
+        t->error = errno;
+        fprintf(stderr, "hdfsOpenFile(%s) failed: error %d (%s)\n",
+                t->path, t->error, strerror(t->error));
+        return;
+    }
+    do {
+        position = (tOffset)(next_random(&t->random) %
+                             (uint64_t)(size - t->opSize + 1));
+        start = monotonicMicros();
+        ret = hdfsPread(t->fs, file, position, buf, t->opSize);
+        now = monotonicMicros();
+        if (ret < 0) {
+            t->error = errno;
+            fprintf(stderr, "hdfsPread(%s, %" PRId64 ") failed: error %d "
+                    "(%s)\n", t->path, (int64_t)position, t->error,
+                    strerror(t->error));
+            break;
+        }
+        t->bytes += ret;
+        t->error = record_latency(t, now - start);
+    } while (!t->error && now < end);
+    hdfsCloseFile(t->fs, file);
+}
+
+static void run_thread(void *arg)
+{
+    struct iobench_thread *t = arg;
+    char *buf;
+    uint64_t end;
+    int i;
+
+    buf = malloc(t->opSize);
+    if (!buf) {
+        t->error = ENOMEM;
+        return;
+    }
+    for (i = 0; i < t->opSize; i++) {
+        buf[i] = (char)i;
+    }
+    end = monotonicMicros() + t->opts->seconds * 1000000ULL;
+    switch (t->op) {
+    case IOBENCH_WRITE:
+        run_write(t, buf, end);
+        break;
+    case IOBENCH_READ:
+        run_read(t, buf, end);
+        break;
+    case IOBENCH_PREAD:
+        run_pread(t, buf, end);
+        break;
+    }
+    free(buf);
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    uint32_t la = *(const uint32_t *)a, lb = *(const uint32_t *)b;
+
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t num, double pct)
+{
+    size_t idx = (size_t)(num * pct / 100.0);
+
+    return sorted[idx < num ? idx : num - 1];
+}
+
+/**
+ * Runs one phase in all the threads and prints its results.
+ *
+ * @return 0 on success; an error code if any of the threads failed.
+ */
+static int run_phase(struct iobench_thread *threads,
+                     const struct options *opts, enum iobench_op op,
+                     int opSize)
+{
+    uint32_t *all;
+    size_t numOps = 0, off = 0;
+    int64_t bytes = 0;
+    uint64_t start;
+    double elapsed;
+    int i, ret = 0;
+
+    start = monotonicMicros();
+    for (i = 0; i < opts->threads; i++) {
+        threads[i].op = op;
+        threads[i].opSize = opSize;
+        threads[i].numOps = 0;
+        threads[i].bytes = 0;
+        threads[i].error = 0;
+        threads[i].theThread.start = run_thread;
+        threads[i].theThread.arg = &threads[i];
+        if (threadCreate(&threads[i].theThread)) {
+            fprintf(stderr, "Failed to create thread %d.\n", i);
+            ret = EINVAL;
+            break;
+        }
+    }
+    // Let the threads already started finish, even on failure.
+    while (--i >= 0) {
+        threadJoin(&threads[i].theThread);
+    }
+    if (ret) {
+        return ret;
+    }
+    elapsed = (monotonicMicros() - start) / 1000000.0;
+    for (i = 0; i < opts->threads; i++) {
+        if (threads[i].error) {
+            ret = threads[i].error;
+        }
+        numOps += threads[i].numOps;
+        bytes += threads[i].bytes;
+    }
+    if (ret) {
+        return ret;
+    }
+    if (!numOps) {
+        fprintf(stderr, "No %s calls completed.\n", IOBENCH_OP_NAMES[op]);
+        return EINVAL;
+    }
+    all = malloc(numOps * sizeof(uint32_t));
+    if (!all) {
+        return ENOMEM;
+    }
+    for (i = 0; i < opts->threads; i++) {
+        memcpy(all + off, threads[i].latencies,
+               threads[i].numOps * sizeof(uint32_t));
+        off += threads[i].numOps;
+    }
+    qsort(all, numOps, sizeof(uint32_t), compare_latency);
+    printf("iobench: %s of %d bytes in %d threads: %" PRIu64 " calls in "
+           "%.5g seconds, %.5g calls/s, %.5g MB/s, latency in us p50=%" PRIu32
+           " p90=%" PRIu32 " p99=%" PRIu32 " p99.9=%" PRIu32 " max=%" PRIu32
+           "\n", IOBENCH_OP_NAMES[op], opSize, opts->threads,
+           (uint64_t)numOps, elapsed, numOps / elapsed,
+           bytes / elapsed / (1024.0 * 1024.0), percentile(all, numOps, 50),
+           percentile(all, numOps, 90), percentile(all, numOps, 99),
+           percentile(all, numOps, 99.9), all[numOps - 1]);
+    fflush(stdout);
+    free(all);
+    return 0;
+}
+
+static hdfsFS connect_fs(const struct options *opts,
+                         struct NativeMiniDfsCluster *cl)
+{
+    struct hdfsBuilder *builder;
+    int port;
+
+    builder = hdfsNewBuilder();
+    if (!builder) {
+        fprintf(stderr, "Failed to create builder.\n");
+        return NULL;
+    }
+    if (cl) {
+        port = nmdGetNameNodePort(cl);
+        if (port < 0) {
+            fprintf(stderr, "nmdGetNameNodePort failed with error %d\n",
+                    port);
+            hdfsFreeBuilder(builder);
+            return NULL;
+        }
+        hdfsBuilderSetNameNode(builder, "localhost");
+        hdfsBuilderSetNameNodePort(builder, (tPort)port);
+    } else {
+        hdfsBuilderSetNameNode(builder, opts->rpcAddress);
+    }
+    return hdfsBuilderConnect(builder);
+}
+
+int main(void)
+{
+    struct options opts;
+    struct NativeMiniDfsConf conf = {
+        1, /* doFormat */
+    };
+    struct NativeMiniDfsCluster *cl = NULL;
+    struct iobench_thread *threads = NULL;
+    hdfsFS fs = NULL;
+    int i, ret = 1;
+
+    if (options_init(&opts)) {
+        goto done;
+    }
+    if (!opts.rpcAddress) {
+        cl = nmdCreate(&conf);
+        if (!cl || nmdWaitClusterUp(cl)) {
+            fprintf(stderr, "Failed to start the mini cluster.\n");
+            goto done;
+        }
+    }
+    fs = connect_fs(&opts, cl);
+    if (!fs) {
+        fprintf(stderr, "Could not connect to the namenode: error %d (%s)\n",
+                errno, strerror(errno));
+        goto done;
+    }
+    if (hdfsCreateDirectory(fs, opts.dir)) {
+        fprintf(stderr, "hdfsCreateDirectory(%s) failed: error %d (%s)\n",
+                opts.dir, errno, strerror(errno));
+        goto done;
+    }
+    threads = calloc(opts.threads, sizeof(struct iobench_thread));
+    if (!threads) {
+        fprintf(stderr, "Failed to allocate the threads.\n");
+        goto done;
+    }
+    for (i = 0; i < opts.threads; i++) {
+        threads[i].opts = &opts;
+        threads[i].fs = fs;
+        threads[i].random = 0x9e3779b97f4a7c15ULL * (i + 1);
+        snprintf(threads[i].path, sizeof(threads[i].path), "%s/%d",
+                 opts.dir, i);
+    }
+
+    if (run_phase(threads, &opts, IOBENCH_WRITE, opts.writeSize) ||
+        run_phase(threads, &opts, IOBENCH_READ, opts.readSize)) {
+        goto done;
+    }
+    for (i = 0; i < opts.numPreadSizes; i++) {
+        if (run_phase(threads, &opts, IOBENCH_PREAD, opts.preadSizes[i])) {
+            goto done;
+        }
+    }
+    ret = 0;
+
+done:
+    if (threads) {
+        for (i = 0; i < opts.threads; i++) {
+            if (threads[i].path[0]) {
+                hdfsDelete(fs, threads[i].path, 0);
+            }
+            free(threads[i].latencies);
+        }
+        free(threads);
+    }
+    if (fs) {
+        hdfsDisconnect(fs);
+    }
+    if (cl) {
+        nmdShutdown(cl);
+        nmdFree(cl);
+    }
+    return ret;
+}
+
+// vim: ts=4:sw=4:tw=79:et
@@ -0,0 +1,214 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Counts how many small positional reads per second libhdfs does on one
+ * file, which is dominated by the per-call cost of the JNI layer rather than
+ * by the data transfer.
+ *
+ * PREADBENCH_PATH      the file to read, created if it does not exist
+ * PREADBENCH_READ_SIZE the size of each read, 512 bytes by default
+ * PREADBENCH_SECONDS   how long to run, 10 seconds by default
+ * PREADBENCH_RPC_ADDRESS the NameNode to use, "default" by default
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "hdfs/hdfs.h"
+
+#define PREADBENCH_FILE_SIZE (16 * 1024 * 1024)
+#define PREADBENCH_MAX_READ_SIZE (1024 * 1024)
+
+struct options {
+    // The path to read.
+    const char *path;
+
+    // The size of each read.
+    int readSize;
+
+    // How long to read for.
+    int seconds;
+
+    // RPC address to use for HDFS
+    const char *rpcAddress;
+};
+
+static int options_init(struct options *opts)
+{
+    const char *str;
+
+    opts->path = getenv("PREADBENCH_PATH");
+    if (!opts->path) {
+        fprintf(stderr, "You must set the PREADBENCH_PATH environment "
+            "variable to the path of the file to read.\n");
+        return EINVAL;
+    }
+    str = getenv("PREADBENCH_READ_SIZE");
+    opts->readSize = str ? atoi(str) : 512;
+    if (opts->readSize <= 0 || opts->readSize > PREADBENCH_MAX_READ_SIZE) {
+        fprintf(stderr, "PREADBENCH_READ_SIZE must be between 1 and %d.\n",
+                PREADBENCH_MAX_READ_SIZE);
+        return EINVAL;
+    }
+    str = getenv("PREADBENCH_SECONDS");
+    opts->seconds = str ? atoi(str) : 10;
+    if (opts->seconds <= 0) {
+        fprintf(stderr, "PREADBENCH_SECONDS must be greater than 0.\n");
+        return EINVAL;
+    }
+    opts->rpcAddress = getenv("PREADBENCH_RPC_ADDRESS");
+    if (!opts->rpcAddress) {
+        opts->rpcAddress = "default";
+    }
+    return 0;
+}
+
+static double now_seconds(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static int create_file(hdfsFS fs, const char *path)
+{
+    hdfsFile file;
+    char *buf;
+    int i, ret = 0;
+
+    buf = malloc(PREADBENCH_MAX_READ_SIZE);
+    if (!buf) {
+        return ENOMEM;
+    }
+    for (i = 0; i < PREADBENCH_MAX_READ_SIZE; i++) {
+        buf[i] = (char)i;
+    }
+    file = hdfsOpenFile(fs, path, O_WRONLY, 0, 0, 0);
+    if (!file) {
+        ret = errno;
+        fprintf(stderr, "hdfsOpenFile(%s, O_WRONLY) failed: error %d (%s)\n",
+                path, ret, strerror(ret));
+        goto done;
+    }
+    for (i = 0; i < PREADBENCH_FILE_SIZE / PREADBENCH_MAX_READ_SIZE; i++) {
+        if (hdfsWrite(fs, file, buf, PREADBENCH_MAX_READ_SIZE) < 0) {
+            ret = errno;
+            fprintf(stderr, "hdfsWrite(%s) failed: error %d (%s)\n",
+                    path, ret, strerror(ret));
+            break;
+        }
+    }
+    if (hdfsCloseFile(fs, file) && !ret) {
+        ret = errno;
+        fprintf(stderr, "hdfsCloseFile(%s) failed: error %d (%s)\n",
+                path, ret, strerror(ret));
+    }
+done:
+    free(buf);
+    return ret;
+}
+
+int main(void)
+{
+    struct options opts;
+    struct hdfsBuilder *builder;
+    hdfsFS fs = NULL;
+    hdfsFile file = NULL;
+    hdfsFileInfo *info;
+    char *buf = NULL;
+    tOffset size, position = 0;
+    long long calls = 0;
+    double start, elapsed;
+    int ret = 1;
+
+    if (options_init(&opts)) {
+        goto done;
+    }
+    builder = hdfsNewBuilder();
+    if (!builder) {
+        fprintf(stderr, "Failed to create builder.\n");
+        goto done;
+    }
+    hdfsBuilderSetNameNode(builder, opts.rpcAddress);
+    fs = hdfsBuilderConnect(builder);
+    if (!fs) {
+        fprintf(stderr, "Could not connect to namenode %s!\n",
+                opts.rpcAddress);
+        goto done;
+    }
+    info = hdfsGetPathInfo(fs, opts.path);
+    if (!info) {
+        if (create_file(fs, opts.path)) {
+            goto done;
+        }
+        size = PREADBENCH_FILE_SIZE;
+    } else {
+        size = info->mSize;
+        hdfsFreeFileInfo(info, 1);
+    }
+    if (size < opts.readSize) {
+        fprintf(stderr, "%s is shorter than one read.\n", opts.path);
+        goto done;
+    }
+    file = hdfsOpenFile(fs, opts.path, O_RDONLY, 0, 0, 0);
+    if (!file) {
+        fprintf(stderr, "hdfsOpenFile(%s) failed: error %d (%s)\n",
+                opts.path, errno, strerror(errno));
+        goto done;
+    }
+    buf = malloc(opts.readSize);
+    if (!buf) {
+        fprintf(stderr, "Failed to allocate the read buffer.\n");
+        goto done;
+    }
+
+    // Stride through the file so that reads are not served by one packet
+    start = now_seconds();
+    do {
+        if (hdfsPread(fs, file, position, buf, opts.readSize) < 0) {
+            fprintf(stderr, "hdfsPread(%s, %lld) failed: error %d (%s)\n",
+                    opts.path, (long long)position, errno, strerror(errno));
+            goto done;
+        }
+        calls++;
+        position = (position + 64 * 1024 + opts.readSize) %
+            (size - opts.readSize + 1);
+        elapsed = now_seconds() - start;
+    } while (elapsed < opts.seconds);
+    printf("preadbench: %lld reads of %d bytes in %.5g seconds, "
+           "%.5g reads/s\n", calls, opts.readSize, elapsed, calls / elapsed);
+    ret = 0;
+
+done:
+    free(buf);
+    if (file) {
+        hdfsCloseFile(fs, file);
+    }
+    if (fs) {
+        hdfsDisconnect(fs);
+    }
+    return ret;
+}
+
+// vim: ts=4:sw=4:tw=79:et
@@ -19,6 +19,7 @@
 #include "common/htable.h"
 #include "expect.h"
 #include "hdfs_test.h"
+#include "os/thread.h"
 
 #include <errno.h>
 #include <inttypes.h>
@@ -64,6 +65,81 @@ static void *htable_pop_val(struct htable *ht, void *key)
     return old_val;
 }
 
+#define ONCE_TEST_NUM_KEYS 1000
+#define ONCE_TEST_NUM_READERS 4
+
+static void htable_once_writer(void *arg)
+{
+    struct htable_once *ht = arg;
+    uintptr_t k;
+
+    for (k = 1; k <= ONCE_TEST_NUM_KEYS; k++) {
+        if (htable_once_put(ht, (void*)k, (void*)(k + 1000))) {
+            abort();
+        }
+    }
+}
+
+static void htable_once_reader(void *arg)
+{
+    struct htable_once *ht = arg;
+    uintptr_t k, val;
+
+    // Wait for each key to be published, and check that it is never seen
+    // without its value.
+    for (k = 1; k <= ONCE_TEST_NUM_KEYS; k++) {
+        do {
+            val = (uintptr_t)htable_once_get(ht, (void*)k);
+        } while (!val);
+        if (val != k + 1000) {
+            abort();
+        }
+    }
+}
+
+static int test_htable_once(void)
+{
+    struct htable_once *ht;
+    thread writer, readers[ONCE_TEST_NUM_READERS];
+    int i;
+
+    ht = htable_once_alloc(3, simple_hash, simple_compare);
+    EXPECT_NONNULL(ht);
+    EXPECT_NULL(htable_once_get(ht, (void*)123));
+    EXPECT_INT_EQ(EINVAL, htable_once_put(ht, NULL, (void*)456));
+    EXPECT_INT_EQ(EINVAL, htable_once_put(ht, (void*)123, NULL));
+    EXPECT_ZERO(htable_once_put(ht, (void*)123, (void*)456));
+    EXPECT_INT_EQ(456, (uintptr_t)htable_once_get(ht, (void*)123));
+    EXPECT_INT_EQ(EEXIST, htable_once_put(ht, (void*)123, (void*)789));
+    EXPECT_INT_EQ(456, (uintptr_t)htable_once_get(ht, (void*)123));
+    EXPECT_ZERO(htable_once_put(ht, (void*)1, (void*)101));
+    EXPECT_ZERO(htable_once_put(ht, (void*)2, (void*)102));
+    // The capacity is fixed
+    EXPECT_INT_EQ(ENOSPC, htable_once_put(ht, (void*)3, (void*)103));
+    EXPECT_NULL(htable_once_get(ht, (void*)3));
+    EXPECT_INT_EQ(101, (uintptr_t)htable_once_get(ht, (void*)1));
+    EXPECT_INT_EQ(102, (uintptr_t)htable_once_get(ht, (void*)2));
+    htable_once_free(ht);
+
+    // Read while another thread is adding entries
+    ht = htable_once_alloc(ONCE_TEST_NUM_KEYS, simple_hash, simple_compare);
+    EXPECT_NONNULL(ht);
+    for (i = 0; i < ONCE_TEST_NUM_READERS; i++) {
+        readers[i].start = htable_once_reader;
+        readers[i].arg = ht;
+        EXPECT_ZERO(threadCreate(&readers[i]));
+    }
+    writer.start = htable_once_writer;
+    writer.arg = ht;
+    EXPECT_ZERO(threadCreate(&writer));
+    EXPECT_ZERO(threadJoin(&writer));
+    for (i = 0; i < ONCE_TEST_NUM_READERS; i++) {
+        EXPECT_ZERO(threadJoin(&readers[i]));
+    }
+    htable_once_free(ht);
+    return 0;
+}
+
 int main(void)
 {
     struct htable *ht;
@@ -93,6 +169,8 @@ int main(void)
     EXPECT_INT_EQ(1, found_102);
     htable_free(ht);
 
+    EXPECT_ZERO(test_htable_once());
+
     fprintf(stderr, "SUCCESS.\n");
     return EXIT_SUCCESS;
 }
@@ -220,15 +220,205 @@ int main(int argc, char **argv) {
         fprintf(stderr, "Read following %d bytes:\n%s\n", 
                 num_read_bytes, buffer);
 
+        if (!hdfsFileUsesDirectPread(readFile)) {
+          fprintf(stderr, "Direct pread support incorrectly not detected "
+                  "for HDFS filesystem\n");
+          exit(-1);
+        }
+
+        // Test the direct pread path, from the start and from an offset
+        memset(buffer, 0, sizeof(buffer));
+        num_read_bytes = hdfsPread(fs, readFile, 0, (void*)buffer,
+                sizeof(buffer));
+        if (strncmp(fileContents, buffer, strlen(fileContents)) != 0) {
+            fprintf(stderr, "Failed to pread (direct). Expected %s but got %s (%d bytes)\n",
+                    fileContents, buffer, num_read_bytes);
+            exit(-1);
+        }
+        memset(buffer, 0, sizeof(buffer));
+        num_read_bytes = hdfsPread(fs, readFile, 7, (void*)buffer,
+                sizeof(buffer));
+        if (strncmp(fileContents + 7, buffer, strlen(fileContents + 7)) != 0) {
+            fprintf(stderr, "Failed to pread (direct) at 7. Expected %s but got %s (%d bytes)\n",
+                    fileContents + 7, buffer, num_read_bytes);
+            exit(-1);
+        }
+        fprintf(stderr, "Pread (direct) following %d bytes:\n%s\n",
+                num_read_bytes, buffer);
+
+        // Disable the direct pread path so that we really go through the
+        // byte array path
+        hdfsFileDisableDirectPread(readFile);
+
         memset(buffer, 0, strlen(fileContents + 1));
 
         num_read_bytes = hdfsPread(fs, readFile, 0, (void*)buffer, 
                 sizeof(buffer));
-        fprintf(stderr, "Read following %d bytes:\n%s\n", 
+        fprintf(stderr, "Read following %d bytes:\n%s\n",
                 num_read_bytes, buffer);
 
+        // Test the vectored pread, the first three ranges are coalesced
+        // and the last one runs past the end of the file
+        {
+            char parts[4][32];
+            struct hdfsReadRange ranges[4] = {
+                { 0, 5, parts[0], 0 },
+                { 5, 2, parts[1], 0 },
+                { 7, 5, parts[2], 0 },
+                { 10, 20, parts[3], 0 },
+            };
+            memset(parts, 0, sizeof(parts));
+            if (hdfsPreadv(fs, readFile, ranges, 4)) {
+                fprintf(stderr, "hdfsPreadv failed: %d\n", errno);
+                exit(-1);
+            }
+            if (ranges[0].bytesRead != 5 || strncmp(parts[0], "Hello", 5) ||
+                ranges[1].bytesRead != 2 || strncmp(parts[1], ", ", 2) ||
+                ranges[2].bytesRead != 5 || strncmp(parts[2], "World", 5) ||
+                ranges[3].bytesRead != 4 || strcmp(parts[3], "ld!")) {
+                fprintf(stderr, "hdfsPreadv read wrong ranges: "
+                        "%s(%d) %s(%d) %s(%d) %s(%d)\n",
+                        parts[0], ranges[0].bytesRead,
+                        parts[1], ranges[1].bytesRead,
+                        parts[2], ranges[2].bytesRead,
+                        parts[3], ranges[3].bytesRead);
+                exit(-1);
+            }
+        }
+
         hdfsCloseFile(fs, readFile);
 
+        // Read the file in small sequential reads through a read-ahead
+        // window smaller than the file, so that prefetched windows are
+        // consumed and refilled
+        {
+            struct hdfsStreamBuilder *bld;
+            tSize total = 0;
+
+            bld = hdfsStreamBuilderAlloc(fs, readPath, O_RDONLY);
+            if (!bld || hdfsStreamBuilderSetReadahead(bld, 4)) {
+                fprintf(stderr, "Failed to set up the read-ahead builder\n");
+                exit(-1);
+            }
+            readFile = hdfsStreamBuilderBuild(bld);
+            if (!readFile) {
+                fprintf(stderr, "Failed to open %s with read-ahead!\n",
+                        readPath);
+                exit(-1);
+            }
+            memset(buffer, 0, sizeof(buffer));
+            do {
+                num_read_bytes = hdfsRead(fs, readFile, buffer + total, 3);
+                if (num_read_bytes < 0) {
+                    fprintf(stderr, "hdfsRead with read-ahead failed: %d\n",
+                            errno);
+                    exit(-1);
+                }
+                total += num_read_bytes;
+            } while (num_read_bytes > 0);
+            if (strcmp(fileContents, buffer) ||
+                    hdfsTell(fs, readFile) != total) {
+                fprintf(stderr, "Failed to read with read-ahead. Expected "
+                        "%s but got %s (%d bytes)\n", fileContents, buffer,
+                        total);
+                exit(-1);
+            }
+            hdfsCloseFile(fs, readFile);
+        }
+
+        // Small reads out of a native read buffer smaller than the file,
+        // with seeks both within and outside of the buffered data
+        {
+            struct hdfsStreamBuilder *bld;
+            tSize total = 0;
+
+            bld = hdfsStreamBuilderAlloc(fs, readPath, O_RDONLY);
+            if (!bld || hdfsStreamBuilderSetReadBufferSize(bld, 8)) {
+                fprintf(stderr, "Failed to set up the read buffer builder\n");
+                exit(-1);
+            }
+            readFile = hdfsStreamBuilderBuild(bld);
+            if (!readFile) {
+                fprintf(stderr, "Failed to open %s with a read buffer!\n",
+                        readPath);
+                exit(-1);
+            }
+            memset(buffer, 0, sizeof(buffer));
+            if (hdfsRead(fs, readFile, buffer, 3) != 3 ||
+                    strncmp(buffer, "Hel", 3) ||
+                    hdfsTell(fs, readFile) != 3 ||
+                    hdfsSeek(fs, readFile, 1) ||
+                    hdfsRead(fs, readFile, buffer, 3) != 3 ||
+                    strncmp(buffer, "ell", 3) ||
+                    hdfsSeek(fs, readFile, 11) ||
+                    hdfsRead(fs, readFile, buffer, 2) != 2 ||
+                    strncmp(buffer, "d!", 2) ||
+                    hdfsSeek(fs, readFile, 0)) {
+                fprintf(stderr, "Failed to read and seek with a read "
+                        "buffer: %d\n", errno);
+                exit(-1);
+            }
+            memset(buffer, 0, sizeof(buffer));
+            do {
+                num_read_bytes = hdfsRead(fs, readFile, buffer + total, 3);
+                if (num_read_bytes < 0) {
+                    fprintf(stderr, "hdfsRead with a read buffer failed: "
+                            "%d\n", errno);
+                    exit(-1);
+                }
+                total += num_read_bytes;
+            } while (num_read_bytes > 0);
+            if (strcmp(fileContents, buffer) ||
+                    hdfsTell(fs, readFile) != total) {
+                fprintf(stderr, "Failed to read with a read buffer. Expected "
+                        "%s but got %s (%d bytes)\n", fileContents, buffer,
+                        total);
+                exit(-1);
+            }
+            hdfsCloseFile(fs, readFile);
+
+            bld = hdfsStreamBuilderAlloc(fs, readPath, O_RDONLY);
+            if (!bld || hdfsStreamBuilderSetReadBufferSize(bld, 8) ||
+                    hdfsStreamBuilderSetReadahead(bld, 8)) {
+                fprintf(stderr, "Failed to set up the read buffer builder\n");
+                exit(-1);
+            }
+            readFile = hdfsStreamBuilderBuild(bld);
+            if (readFile || errno != EINVAL) {
+                fprintf(stderr, "Opened %s with both a read buffer and "
+                        "read-ahead\n", readPath);
+                exit(-1);
+            }
+        }
+
+        // Positional reads through a handle with extra pread streams
+        {
+            struct hdfsStreamBuilder *bld;
+
+            bld = hdfsStreamBuilderAlloc(fs, readPath, O_RDONLY);
+            if (!bld || hdfsStreamBuilderSetPreadStreams(bld, 2)) {
+                fprintf(stderr, "Failed to set up the pread stream builder\n");
+                exit(-1);
+            }
+            readFile = hdfsStreamBuilderBuild(bld);
+            if (!readFile) {
+                fprintf(stderr, "Failed to open %s with pread streams!\n",
+                        readPath);
+                exit(-1);
+            }
+            memset(buffer, 0, sizeof(buffer));
+            num_read_bytes = hdfsPread(fs, readFile, 7, buffer,
+                    (tSize)strlen(fileContents) - 7);
+            if (num_read_bytes != (tSize)strlen(fileContents) - 7 ||
+                    strncmp(fileContents + 7, buffer, num_read_bytes)) {
+                fprintf(stderr, "Failed to pread with pread streams. "
+                        "Expected %s but got %s (%d bytes)\n",
+                        fileContents + 7, buffer, num_read_bytes);
+                exit(-1);
+            }
+            hdfsCloseFile(fs, readFile);
+        }
+
         // Test correct behaviour for unsupported filesystems
         localFile = hdfsOpenFile(lfs, writePath, O_WRONLY|O_CREAT, 0, 0, 0);
         if(!localFile) {
@@ -248,6 +438,12 @@ int main(int argc, char **argv) {
           exit(-1);
         }
 
+        if (hdfsFileUsesDirectPread(localFile)) {
+          fprintf(stderr, "Direct pread support incorrectly detected for local "
+                  "filesystem\n");
+          exit(-1);
+        }
+
         hdfsCloseFile(lfs, localFile);
     }
 
@@ -356,6 +552,46 @@ int main(int argc, char **argv) {
             totalResult++;
             fprintf(stderr, "waah! hdfsGetHosts - FAILED!\n");
         }
+
+        // The compact block locations must name the same hosts
+        {
+            struct hdfsBlockLocations *locs;
+            int k, match = 1;
+
+            locs = hdfsGetBlockLocations(fs, srcPath, 0, 1);
+            if (!locs || !hosts) {
+                match = 0;
+            } else {
+                for (i = 0; match && i < locs->numBlocks; i++) {
+                    if (!hosts[i]) {
+                        match = 0;
+                        break;
+                    }
+                    for (k = 0; k < locs->blocks[i].numReplicas; k++) {
+                        if (!hosts[i][k] || strcmp(hosts[i][k],
+                                locs->hosts[locs->blocks[i].hostIndices[k]])) {
+                            match = 0;
+                            break;
+                        }
+                    }
+                    if (match && hosts[i][k]) {
+                        match = 0;
+                    }
+                }
+                if (match && hosts[i]) {
+                    match = 0;
+                }
+            }
+            fprintf(stderr, "hdfsGetBlockLocations: %s\n",
+                    match ? "Success!" : "Failed!");
+            totalResult += !match;
+            if (locs) {
+                hdfsFreeBlockLocations(locs);
+            }
+        }
+        if (hosts) {
+            hdfsFreeHosts(hosts);
+        }
        
         // setting tmp dir to 777 so later when connectAsUser nobody, we can write to it
 
@@ -528,6 +764,34 @@ int main(int argc, char **argv) {
     
     totalResult += (hdfsDisconnect(fs) != 0);
 
+    {
+      // Shared connections with the same settings are one handle, which
+      // stays open until the last of them disconnects
+      struct hdfsBuilder *bld;
+      hdfsFS fs2;
+
+      bld = hdfsNewBuilder();
+      hdfsBuilderSetNameNode(bld, "default");
+      hdfsBuilderSetForceNewInstance(bld);
+      hdfsBuilderSetShared(bld);
+      fs = hdfsBuilderConnect(bld);
+      bld = hdfsNewBuilder();
+      hdfsBuilderSetNameNode(bld, "default");
+      hdfsBuilderSetForceNewInstance(bld);
+      hdfsBuilderSetShared(bld);
+      fs2 = hdfsBuilderConnect(bld);
+      if (!fs || fs != fs2) {
+        fprintf(stderr, "Shared connections were not shared\n");
+        exit(-1);
+      }
+      totalResult += (hdfsDisconnect(fs2) != 0);
+      fprintf(stderr, "shared connection open after one disconnect: %s\n",
+              ((result = hdfsExists(fs, userPath)) != 0 ?
+               "Failed!" : "Success!"));
+      totalResult += (result != 0);
+      totalResult += (hdfsDisconnect(fs) != 0);
+    }
+
     if (totalResult != 0) {
         return -1;
     } else {
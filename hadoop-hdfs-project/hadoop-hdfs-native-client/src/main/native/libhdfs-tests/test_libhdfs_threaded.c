@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define TO_STR_HELPER(X) #X
 #define TO_STR(X) TO_STR_HELPER(X)
@@ -46,6 +47,45 @@ struct tlhThreadInfo {
     thread theThread;
 };
 
+struct tlhAsyncRead {
+    volatile int done;
+    volatile tSize ret;
+    volatile int error;
+};
+
+static void asyncReadDone(tSize ret, int error, void *cookie)
+{
+    struct tlhAsyncRead *read = cookie;
+    read->ret = ret;
+    read->error = error;
+    read->done = 1;
+}
+
+struct tlhEvictor {
+    hdfsFS fs;
+    hdfsFile file;
+    tSize length;
+    volatile int stop;
+    volatile int failures;
+};
+
+/**
+ * Read a stream over and over, which unbuffers the least recently read
+ * stream past the limit.
+ */
+static void evictOthers(void *v)
+{
+    struct tlhEvictor *evictor = v;
+    char buf[16];
+
+    while (!evictor->stop) {
+        if (hdfsPread(evictor->fs, evictor->file, 0, buf,
+                      evictor->length) != evictor->length) {
+            evictor->failures++;
+        }
+    }
+}
+
 static int hdfsSingleNameNodeConnect(struct NativeMiniDfsCluster *cl, hdfsFS *fs,
                                      const char *username)
 {
@@ -70,6 +110,9 @@ static int hdfsSingleNameNodeConnect(struct NativeMiniDfsCluster *cl, hdfsFS *fs
                           TO_STR(TLH_DEFAULT_BLOCK_SIZE));
     hdfsBuilderConfSetStr(bld, "dfs.blocksize",
                           TO_STR(TLH_DEFAULT_BLOCK_SIZE));
+    /* Every hdfsGetPathInfo after a change below then checks that the
+     * change dropped the cached status */
+    hdfsBuilderConfSetStr(bld, "libhdfs.stat.cache.ttl.secs", "600");
     if (username) {
         hdfsBuilderSetUserName(bld, username);
     }
@@ -187,6 +230,34 @@ static int doTestHdfsOperations(struct tlhThreadInfo *ti, hdfsFS fs,
     EXPECT_ZERO(hdfsHSync(fs, file));
     EXPECT_ZERO(hdfsCloseFile(fs, file));
 
+    /* A gathering write in batches that split the buffers */
+    {
+        struct hdfsStreamBuilder *bld;
+        struct hdfsWriteVec vecs[3];
+        char writevPath[300], got[16];
+
+        snprintf(writevPath, sizeof(writevPath), "%s/writev", paths->prefix);
+        bld = hdfsStreamBuilderAlloc(fs, writevPath, O_WRONLY);
+        EXPECT_NONNULL(bld);
+        EXPECT_ZERO(hdfsStreamBuilderSetWriteBatchSize(bld, 3));
+        file = hdfsStreamBuilderBuild(bld);
+        EXPECT_NONNULL(file);
+        vecs[0].buffer = "abcd";
+        vecs[0].length = 4;
+        vecs[1].buffer = "";
+        vecs[1].length = 0;
+        vecs[2].buffer = "efghi";
+        vecs[2].length = 5;
+        EXPECT_INT_EQ(9, hdfsWritev(fs, file, vecs, 3));
+        EXPECT_ZERO(hdfsCloseFile(fs, file));
+        file = hdfsOpenFile(fs, writevPath, O_RDONLY, 0, 0, 0);
+        EXPECT_NONNULL(file);
+        EXPECT_INT_EQ(9, hdfsPread(fs, file, 0, got, sizeof(got)));
+        EXPECT_ZERO(memcmp(got, "abcdefghi", 9));
+        EXPECT_ZERO(hdfsCloseFile(fs, file));
+        EXPECT_ZERO(hdfsDelete(fs, writevPath, 0));
+    }
+
     /* There should be 1 entry in the directory. */
     EXPECT_NONNULL(hdfsListDirectory(fs, paths->prefix, &numEntries));
     if (numEntries != 1) {
@@ -194,6 +265,40 @@ static int doTestHdfsOperations(struct tlhThreadInfo *ti, hdfsFS fs,
                 "%d on directory containing 1 file.", numEntries);
     }
 
+    /* The listing cached file1, with the size it got when it was closed */
+    fileInfo = hdfsGetPathInfo(fs, paths->file1);
+    EXPECT_NONNULL(fileInfo);
+    EXPECT_INT64_EQ((int64_t)expected, fileInfo->mSize);
+    hdfsFreeFileInfo(fileInfo, 1);
+
+    /* The same entry through the paged listing and the batch lookup */
+    {
+        struct hdfsListing *listing;
+        const char *batchPaths[2];
+        int batchErrnos[2];
+
+        listing = hdfsOpenListing(fs, paths->prefix);
+        EXPECT_NONNULL(listing);
+        fileInfo = hdfsListingNext(listing, 1, &numEntries);
+        EXPECT_NONNULL(fileInfo);
+        EXPECT_INT_EQ(1, numEntries);
+        EXPECT_INT_EQ(kObjectKindFile, fileInfo->mKind);
+        hdfsFreeFileInfo(fileInfo, numEntries);
+        EXPECT_NULL_WITH_ERRNO(hdfsListingNext(listing, 1, &numEntries), 0);
+        EXPECT_INT_EQ(0, numEntries);
+        hdfsCloseListing(listing);
+
+        batchPaths[0] = paths->file1;
+        batchPaths[1] = paths->file2;
+        fileInfo = hdfsGetPathInfoBatch(fs, batchPaths, 2, batchErrnos);
+        EXPECT_NONNULL(fileInfo);
+        EXPECT_INT_EQ(0, batchErrnos[0]);
+        EXPECT_INT_EQ(ENOENT, batchErrnos[1]);
+        EXPECT_INT_EQ(kObjectKindFile, fileInfo[0].mKind);
+        EXPECT_NULL(fileInfo[1].mName);
+        hdfsFreeFileInfo(fileInfo, 2);
+    }
+
     /* Let's re-open the file for reading */
     file = hdfsOpenFile(fs, paths->file1, O_RDONLY, 0, 0, 0);
     EXPECT_NONNULL(file);
@@ -225,12 +330,114 @@ static int doTestHdfsOperations(struct tlhThreadInfo *ti, hdfsFS fs,
     EXPECT_UINT64_EQ((uint64_t)0, readStats->totalBytesRead);
     hdfsFileFreeReadStatistics(readStats);
     EXPECT_ZERO(memcmp(paths->prefix, tmp, expected));
+
+    /* The read shows up in the latency histograms, the Java part of it
+     * taking no longer than the whole call */
+    {
+        struct hdfsLatencyStats latency;
+        uint64_t bucketed = 0;
+        int i;
+
+        EXPECT_ZERO(hdfsFileGetLatencyStats(file, &latency));
+        EXPECT_UINT64_EQ(UINT64_C(1), latency.calls[HDFS_LATENCY_READ].count);
+        EXPECT_UINT64_EQ(UINT64_C(1), latency.java[HDFS_LATENCY_READ].count);
+        EXPECT_UINT64_EQ(UINT64_C(0), latency.calls[HDFS_LATENCY_WRITE].count);
+        if (latency.java[HDFS_LATENCY_READ].totalMicros >
+                latency.calls[HDFS_LATENCY_READ].totalMicros) {
+            fprintf(stderr, "the Java read took longer than hdfsRead\n");
+            return EIO;
+        }
+        for (i = 0; i < HDFS_LATENCY_BUCKETS; i++) {
+            bucketed += latency.calls[HDFS_LATENCY_READ].buckets[i];
+        }
+        EXPECT_UINT64_EQ(UINT64_C(1), bucketed);
+        EXPECT_ZERO(hdfsFileClearLatencyStats(file));
+        EXPECT_ZERO(hdfsFileGetLatencyStats(file, &latency));
+        EXPECT_UINT64_EQ(UINT64_C(0), latency.calls[HDFS_LATENCY_READ].count);
+    }
+
+    /* The same bytes read through the asynchronous API */
+    {
+        struct tlhAsyncRead asyncRead;
+        int waited;
+
+        memset(&asyncRead, 0, sizeof(asyncRead));
+        memset(tmp, 0, sizeof(tmp));
+        EXPECT_ZERO(hdfsPreadAsync(fs, file, 0, tmp, sizeof(tmp),
+                                   asyncReadDone, &asyncRead));
+        for (waited = 0; !asyncRead.done && waited < 60; waited++) {
+            sleep(1);
+        }
+        EXPECT_INT_EQ(1, asyncRead.done);
+        EXPECT_INT_EQ(0, asyncRead.error);
+        EXPECT_INT_EQ(expected, asyncRead.ret);
+        EXPECT_ZERO(memcmp(paths->prefix, tmp, expected));
+    }
+
+    /* With a limit of one stream, reading a second stream unbuffers the
+     * first, which reconnects on its next read */
+    {
+        hdfsFile other;
+
+        hdfsSetUnbufferLimit(1);
+        other = hdfsOpenFile(fs, paths->file1, O_RDONLY, 0, 0, 0);
+        EXPECT_NONNULL(other);
+        memset(tmp, 0, sizeof(tmp));
+        EXPECT_INT_EQ(expected, hdfsPread(fs, other, 0, tmp, sizeof(tmp)));
+        EXPECT_ZERO(memcmp(paths->prefix, tmp, expected));
+        memset(tmp, 0, sizeof(tmp));
+        EXPECT_INT_EQ(expected, hdfsPread(fs, file, 0, tmp, sizeof(tmp)));
+        EXPECT_ZERO(memcmp(paths->prefix, tmp, expected));
+        EXPECT_ZERO(hdfsSeek(fs, other, 0));
+        memset(tmp, 0, sizeof(tmp));
+        EXPECT_INT_EQ(expected, hdfsRead(fs, other, tmp, sizeof(tmp)));
+        EXPECT_ZERO(memcmp(paths->prefix, tmp, expected));
+
+        /* Telling the position and what is available races with another
+         * thread unbuffering the stream */
+        {
+            struct tlhEvictor evictor;
+            thread evictorThread;
+            int i, failures = 0;
+
+            memset(&evictor, 0, sizeof(evictor));
+            evictor.fs = fs;
+            evictor.file = file;
+            evictor.length = expected;
+            evictorThread.start = evictOthers;
+            evictorThread.arg = &evictor;
+            EXPECT_ZERO(threadCreate(&evictorThread));
+            for (i = 0; i < 200; i++) {
+                if (hdfsSeek(fs, other, 0) ||
+                        hdfsRead(fs, other, tmp, 1) != 1 ||
+                        hdfsTell(fs, other) != 1 ||
+                        hdfsAvailable(fs, other) != expected - 1 ||
+                        hdfsTell(fs, other) != 1) {
+                    failures++;
+                }
+            }
+            evictor.stop = 1;
+            EXPECT_ZERO(threadJoin(&evictorThread));
+            EXPECT_INT_EQ(0, failures);
+            EXPECT_INT_EQ(0, evictor.failures);
+        }
+        EXPECT_ZERO(hdfsCloseFile(fs, other));
+        hdfsSetUnbufferLimit(0);
+    }
     EXPECT_ZERO(hdfsCloseFile(fs, file));
 
     // TODO: Non-recursive delete should fail?
     //EXPECT_NONZERO(hdfsDelete(fs, prefix, 0));
     EXPECT_ZERO(hdfsCopy(fs, paths->file1, fs, paths->file2));
 
+    // A move within the filesystem is a rename, there and back again
+    snprintf(tmp, sizeof(tmp), "%s/moved", paths->prefix);
+    EXPECT_ZERO(hdfsMove(fs, paths->file2, fs, tmp));
+    EXPECT_NONZERO(hdfsExists(fs, paths->file2));
+    EXPECT_ZERO(hdfsExists(fs, tmp));
+    EXPECT_ZERO(hdfsMove(fs, tmp, fs, paths->file2));
+    EXPECT_NONZERO(hdfsExists(fs, tmp));
+
     EXPECT_ZERO(hdfsChown(fs, paths->file2, NULL, NULL));
     EXPECT_ZERO(hdfsChown(fs, paths->file2, NULL, "doop"));
     fileInfo = hdfsGetPathInfo(fs, paths->file2);
@@ -258,6 +465,90 @@ static int doTestHdfsOperations(struct tlhThreadInfo *ti, hdfsFS fs,
     return 0;
 }
 
+#define TLH_PARALLEL_BLOCK_SIZE 1048576
+#define TLH_PARALLEL_FILE_SIZE (3 * TLH_PARALLEL_BLOCK_SIZE + 524288)
+
+/**
+ * Test hdfsPreadParallel on a file of several blocks, through a connection
+ * with hedged reads turned on.
+ */
+static int doTestParallelPread(const struct tlhPaths *paths)
+{
+    hdfsFS fs;
+    hdfsFile file;
+    struct hdfsBuilder *bld;
+    struct hdfsStreamBuilder *sbld;
+    char path[256];
+    char *data, *out;
+    tOffset position;
+    int i;
+
+    bld = hdfsNewBuilder();
+    EXPECT_NONNULL(bld);
+    hdfsBuilderSetForceNewInstance(bld);
+    hdfsBuilderSetNameNode(bld, "localhost");
+    hdfsBuilderSetNameNodePort(bld, (tPort)nmdGetNameNodePort(tlhCluster));
+    EXPECT_ZERO(hdfsBuilderConfSetStr(bld, "dfs.blocksize",
+                                      TO_STR(TLH_PARALLEL_BLOCK_SIZE)));
+    EXPECT_INT_EQ(-EINVAL, hdfsBuilderSetHedgedReads(bld, 2, 0));
+    EXPECT_ZERO(hdfsBuilderSetHedgedReads(bld, 2, 100));
+    fs = hdfsBuilderConnect(bld);
+    EXPECT_NONNULL(fs);
+    EXPECT_INT64_EQ((int64_t)TLH_PARALLEL_BLOCK_SIZE,
+                    hdfsGetDefaultBlockSize(fs));
+
+    data = malloc(TLH_PARALLEL_FILE_SIZE);
+    EXPECT_NONNULL(data);
+    out = malloc(TLH_PARALLEL_FILE_SIZE);
+    EXPECT_NONNULL(out);
+    for (i = 0; i < TLH_PARALLEL_FILE_SIZE; i++) {
+        data[i] = (char)(i % 251);
+    }
+    snprintf(path, sizeof(path), "%s/parallel", paths->prefix);
+    file = hdfsOpenFile(fs, path, O_WRONLY, 0, 0, TLH_PARALLEL_BLOCK_SIZE);
+    EXPECT_NONNULL(file);
+    EXPECT_INT_EQ(TLH_PARALLEL_FILE_SIZE,
+                  hdfsWrite(fs, file, data, TLH_PARALLEL_FILE_SIZE));
+    EXPECT_ZERO(hdfsCloseFile(fs, file));
+
+    sbld = hdfsStreamBuilderAlloc(fs, path, O_RDONLY);
+    EXPECT_NONNULL(sbld);
+    EXPECT_ZERO(hdfsStreamBuilderSetPreadStreams(sbld, 2));
+    file = hdfsStreamBuilderBuild(sbld);
+    EXPECT_NONNULL(file);
+
+    // Starts and ends in the middle of a block
+    position = 100;
+    memset(out, 0, TLH_PARALLEL_FILE_SIZE);
+    EXPECT_INT_EQ(TLH_PARALLEL_FILE_SIZE - 200,
+                  hdfsPreadParallel(fs, file, position, out,
+                                    TLH_PARALLEL_FILE_SIZE - 200));
+    EXPECT_ZERO(memcmp(data + position, out, TLH_PARALLEL_FILE_SIZE - 200));
+
+    // Short only at the end of the file
+    position = TLH_PARALLEL_BLOCK_SIZE - 10;
+    memset(out, 0, TLH_PARALLEL_FILE_SIZE);
+    EXPECT_INT_EQ(TLH_PARALLEL_FILE_SIZE - (int)position,
+                  hdfsPreadParallel(fs, file, position, out,
+                                    TLH_PARALLEL_FILE_SIZE));
+    EXPECT_ZERO(memcmp(data + position, out,
+                       TLH_PARALLEL_FILE_SIZE - position));
+
+    // Within one block
+    EXPECT_INT_EQ(1000, hdfsPreadParallel(fs, file, 5000, out, 1000));
+    EXPECT_ZERO(memcmp(data + 5000, out, 1000));
+    EXPECT_ZERO(hdfsPreadParallel(fs, file, TLH_PARALLEL_FILE_SIZE, out, 1));
+    EXPECT_NEGATIVE_ONE_WITH_ERRNO(hdfsPreadParallel(fs, file, -1, out, 1),
+                                   EINVAL);
+
+    EXPECT_ZERO(hdfsCloseFile(fs, file));
+    free(data);
+    free(out);
+    EXPECT_ZERO(hdfsDelete(fs, path, 0));
+    EXPECT_ZERO(hdfsDisconnect(fs));
+    return 0;
+}
+
 static int testHdfsOperationsImpl(struct tlhThreadInfo *ti)
 {
     hdfsFS fs = NULL;
@@ -270,6 +561,7 @@ static int testHdfsOperationsImpl(struct tlhThreadInfo *ti)
     // test some operations
     EXPECT_ZERO(doTestHdfsOperations(ti, fs, &paths));
     EXPECT_ZERO(hdfsDisconnect(fs));
+    EXPECT_ZERO(doTestParallelPread(&paths));
     // reconnect as user "foo" and verify that we get permission errors
     EXPECT_ZERO(hdfsSingleNameNodeConnect(tlhCluster, &fs, "foo"));
     EXPECT_NEGATIVE_ONE_WITH_ERRNO(hdfsChown(fs, paths.file1, "ha3", NULL), EACCES);
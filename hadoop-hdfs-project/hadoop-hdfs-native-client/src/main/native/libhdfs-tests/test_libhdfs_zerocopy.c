@@ -74,6 +74,8 @@ static int doTestZeroCopyReads(hdfsFS fs, const char *fileName)
     hdfsFile file = NULL;
     struct hadoopRzOptions *opts = NULL;
     struct hadoopRzBuffer *buffer = NULL;
+    struct hadoopBlockFd blockFd;
+    uint8_t fdBuf[SMALL_READ_LEN];
     uint8_t *block;
 
     file = hdfsOpenFile(fs, fileName, O_RDONLY, 0, 0, 0);
@@ -124,6 +126,37 @@ static int doTestZeroCopyReads(hdfsFS fs, const char *fileName)
           TEST_ZEROCOPY_FULL_BLOCK_SIZE + SMALL_READ_LEN,
           TEST_ZEROCOPY_FULL_BLOCK_SIZE + SMALL_READ_LEN));
 
+    /* The rest of this block can be read straight from the block file. */
+    EXPECT_ZERO(hadoopGetBlockFd(file, opts, &blockFd));
+    EXPECT_INT64_EQ((int64_t)SMALL_READ_LEN, (int64_t)blockFd.offset);
+    EXPECT_INT64_EQ((int64_t)(TEST_ZEROCOPY_FULL_BLOCK_SIZE - SMALL_READ_LEN),
+          (int64_t)blockFd.length);
+    EXPECT_INT_EQ(SMALL_READ_LEN, pread(blockFd.fd, fdBuf, SMALL_READ_LEN,
+          blockFd.offset));
+    EXPECT_ZERO(memcmp(block + SMALL_READ_LEN, fdBuf, SMALL_READ_LEN));
+
+    /* Reading other streams does not unbuffer the stream while its block
+     * descriptor is held, even with a limit of one stream. */
+    {
+        hdfsFile other;
+        uint8_t tmp[SMALL_READ_LEN];
+
+        hdfsSetUnbufferLimit(1);
+        EXPECT_INT_EQ(SMALL_READ_LEN, hdfsPread(fs, file, 0, tmp,
+              SMALL_READ_LEN));
+        EXPECT_ZERO(hadoopGetBlockFd(file, opts, &blockFd));
+        other = hdfsOpenFile(fs, fileName, O_RDONLY, 0, 0, 0);
+        EXPECT_NONNULL(other);
+        EXPECT_INT_EQ(SMALL_READ_LEN, hdfsPread(fs, other, 0, tmp,
+              SMALL_READ_LEN));
+        memset(fdBuf, 0, sizeof(fdBuf));
+        EXPECT_INT_EQ(SMALL_READ_LEN, pread(blockFd.fd, fdBuf, SMALL_READ_LEN,
+              blockFd.offset));
+        EXPECT_ZERO(memcmp(block + SMALL_READ_LEN, fdBuf, SMALL_READ_LEN));
+        EXPECT_ZERO(hdfsCloseFile(fs, other));
+        hdfsSetUnbufferLimit(0);
+    }
+
     /* Clear 'skip checksums' and test that we can't do zero-copy reads any
      * more.  Since there is no ByteBufferPool set, we should fail with
      * EPROTONOSUPPORT.
@@ -17,6 +17,7 @@
  */
 
 #include "common/htable.h"
+#include "platform.h"
 
 #include <errno.h>
 #include <inttypes.h>
@@ -267,6 +268,122 @@ uint32_t htable_capacity(const struct htable *htable)
     return htable->capacity;
 }
 
+/**
+ * A hash table which uses linear probing, and whose entries are added once and
+ * never removed.
+ *
+ * A writer fills in the value of a free slot before it publishes the key with
+ * a release store.  A reader loads each key with an acquire load, so that a
+ * non-NULL key it sees always comes with its value.  Since slots are never
+ * emptied again, the compactness invariant of htable_get_internal holds for
+ * readers at all times.  The table is never resized, which would move entries
+ * under readers; instead it has twice the requested capacity in slots, to keep
+ * the probe sequences short.
+ */
+struct htable_once {
+    uint32_t capacity;
+    uint32_t max_used;
+    uint32_t used;
+    htable_hash_fn_t hash_fun;
+    htable_eq_fn_t eq_fun;
+    struct htable_pair *elem;
+};
+
+struct htable_once *htable_once_alloc(uint32_t capacity,
+                htable_hash_fn_t hash_fun, htable_eq_fn_t eq_fun)
+{
+    struct htable_once *htable;
+    uint32_t size;
+
+    if (capacity > (UINT32_MAX / 4)) {
+        return NULL;
+    }
+    htable = calloc(1, sizeof(*htable));
+    if (!htable) {
+        return NULL;
+    }
+    size = round_up_to_power_of_2(capacity * 2);
+    if (size < HTABLE_MIN_SIZE) {
+        size = HTABLE_MIN_SIZE;
+    }
+    htable->elem = calloc(size, sizeof(struct htable_pair));
+    if (!htable->elem) {
+        free(htable);
+        return NULL;
+    }
+    htable->capacity = size;
+    htable->max_used = capacity;
+    htable->hash_fun = hash_fun;
+    htable->eq_fun = eq_fun;
+    return htable;
+}
+
+void htable_once_free(struct htable_once *htable)
+{
+    if (htable) {
+        free(htable->elem);
+        free(htable);
+    }
+}
+
+int htable_once_put(struct htable_once *htable, void *key, void *val)
+{
+    uint32_t i;
+    struct htable_pair *pair;
+
+    if (!key || !val) {
+        return EINVAL;
+    }
+    if (htable_once_get(htable, key)) {
+        return EEXIST;
+    }
+    if (htable->used >= htable->max_used) {
+        return ENOSPC;
+    }
+    i = htable->hash_fun(key, htable->capacity);
+    while (1) {
+        pair = htable->elem + i;
+        // Only writers change keys, and they are serialized, so a plain load
+        // is enough here.
+        if (!pair->key) {
+            break;
+        }
+        i++;
+        if (i == htable->capacity) {
+            i = 0;
+        }
+    }
+    pair->val = val;
+    atomicStorePtr(&pair->key, key);
+    htable->used++;
+    return 0;
+}
+
+void *htable_once_get(const struct htable_once *htable, const void *key)
+{
+    uint32_t start_idx, idx;
+    void *pkey;
+
+    start_idx = htable->hash_fun(key, htable->capacity);
+    idx = start_idx;
+    while (1) {
+        struct htable_pair *pair = htable->elem + idx;
+        pkey = atomicLoadPtr(&pair->key);
+        if (!pkey) {
+            return NULL;
+        } else if (htable->eq_fun(pkey, key)) {
+            return pair->val;
+        }
+        idx++;
+        if (idx == htable->capacity) {
+            idx = 0;
+        }
+        if (idx == start_idx) {
+            return NULL;
+        }
+    }
+}
+
 uint32_t ht_hash_string(const void *str, uint32_t max)
 {
     const char *s = str;
@@ -136,6 +136,62 @@ uint32_t htable_used(const struct htable *htable);
  */
 uint32_t htable_capacity(const struct htable *htable);
 
+struct htable_once;
+
+/**
+ * Allocate a new publish-once hash table.
+ *
+ * A publish-once hash table has a fixed capacity and its entries can never be
+ * changed or removed once they have been added.  In return, htable_once_get
+ * can be called from any number of threads without a lock, while another
+ * thread is adding entries.  Calls to htable_once_put must still be
+ * serialized by the caller.
+ *
+ * @param capacity  The maximum number of entries.
+ * @param hash_fun  The hash function to use in this hash table.
+ * @param eq_fun    The equals function to use in this hash table.
+ *
+ * @return          The new hash table on success; NULL on OOM.
+ */
+struct htable_once *htable_once_alloc(uint32_t capacity,
+                htable_hash_fn_t hash_fun, htable_eq_fn_t eq_fun);
+
+/**
+ * Free the publish-once hash table.
+ *
+ * No other thread may be using the hash table.  It is up the calling code to
+ * ensure that the keys and values inside the table are de-allocated, if that
+ * is necessary.
+ *
+ * @param htable    The hash table.
+ */
+void htable_once_free(struct htable_once *htable);
+
+/**
+ * Add an entry to the publish-once hash table.  The entry is visible to
+ * htable_once_get in other threads as soon as this returns.
+ *
+ * @param htable    The hash table.
+ * @param key       The key to add.  This cannot be NULL.
+ * @param val       The value to add.  This cannot be NULL.
+ *
+ * @return          0 on success;
+ *                  EEXIST if the key already exists in the table;
+ *                  ENOSPC if the table already holds as many entries as the
+ *                      capacity it was allocated with.
+ */
+int htable_once_put(struct htable_once *htable, void *key, void *val);
+
+/**
+ * Get an entry from the publish-once hash table, without a lock.
+ *
+ * @param htable    The hash table.
+ * @param key       The key to find.
+ *
+ * @return          NULL if there is no such entry; the entry otherwise.
+ */
+void *htable_once_get(const struct htable_once *htable, const void *key);
+
 /**
  * Hash a string.
  *
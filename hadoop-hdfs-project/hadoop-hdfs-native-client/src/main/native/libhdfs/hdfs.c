@@ -16,15 +16,20 @@
  * limitations under the License.
  */
 
+#include "common/htable.h"
 #include "exception.h"
 #include "hdfs/hdfs.h"
 #include "jni_helper.h"
+#include "os/clock.h"
+#include "os/mutexes.h"
+#include "os/thread.h"
 #include "platform.h"
 
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 /* Some frequently used Java paths */
 #define HADOOP_CONF     "org/apache/hadoop/conf/Configuration"
@@ -35,12 +40,16 @@
 #define HADOOP_BLK_LOC  "org/apache/hadoop/fs/BlockLocation"
 #define HADOOP_DFS      "org/apache/hadoop/hdfs/DistributedFileSystem"
 #define HADOOP_ISTRM    "org/apache/hadoop/fs/FSDataInputStream"
+#define HADOOP_DFSISTRM "org/apache/hadoop/hdfs/DFSInputStream"
 #define HADOOP_OSTRM    "org/apache/hadoop/fs/FSDataOutputStream"
 #define HADOOP_STAT     "org/apache/hadoop/fs/FileStatus"
+#define HADOOP_RITERATOR "org/apache/hadoop/fs/RemoteIterator"
 #define HADOOP_FSPERM   "org/apache/hadoop/fs/permission/FsPermission"
+#define HADOOP_NATIVEIO "org/apache/hadoop/io/nativeio/NativeIO"
 #define JAVA_NET_ISA    "java/net/InetSocketAddress"
 #define JAVA_NET_URI    "java/net/URI"
 #define JAVA_STRING     "java/lang/String"
+#define JAVA_FILE       "java/io/File"
 #define READ_OPTION     "org/apache/hadoop/fs/ReadOption"
 
 #define JAVA_VOID       "V"
@@ -53,12 +62,82 @@
 #define JMETHOD3(X, Y, Z, R)   "(" X Y Z")" R
 
 #define KERBEROS_TICKET_CACHE_PATH "hadoop.security.kerberos.ticket.cache.path"
+#define HEDGED_READ_THREADS "dfs.client.hedged.read.threadpool.size"
+#define HEDGED_READ_THRESHOLD "dfs.client.hedged.read.threshold.millis"
 
 // Bit fields for hdfsFile_internal flags
 #define HDFS_FILE_SUPPORTS_DIRECT_READ (1<<0)
+#define HDFS_FILE_SUPPORTS_DIRECT_PREAD (1<<1)
+
+// hdfsPreadv does not coalesce ranges into reads larger than this
+#define HDFS_PREADV_MAX_SPAN (4 * 1024 * 1024)
+
+// Default number of threads serving hdfsPreadAsync, LIBHDFS_ASYNC_THREADS
+// overrides it
+#define HDFS_ASYNC_DEFAULT_THREADS 8
+#define HDFS_ASYNC_MAX_THREADS 256
+
+// hdfsPreadAsync fails with EAGAIN when this many reads are already queued
+#define HDFS_ASYNC_MAX_QUEUED 4096
+
+// The file status cache is off unless the TTL is set on the builder
+#define HDFS_STAT_CACHE_TTL_KEY "libhdfs.stat.cache.ttl.secs"
+#define HDFS_STAT_CACHE_SIZE_KEY "libhdfs.stat.cache.max.entries"
+#define HDFS_STAT_CACHE_DEFAULT_SIZE 10000
+
+// Input streams that have read since they were last unbuffered are
+// unbuffered, least recently used first, once there are more than this
+// many; LIBHDFS_UNBUFFER_LIMIT or hdfsSetUnbufferLimit turn it on
+#define HDFS_UNBUFFER_DEFAULT_LIMIT 0
+
+// The most streams a read unbuffers before it goes on, so that lowering the
+// limit doesn't stall one read for long
+#define HDFS_UNBUFFER_MAX_BATCH 16
+
+// Writes up to this size reuse the per-file staging array, larger ones
+// allocate a temporary array per call
+#define HDFS_WRITE_STAGING_MAX (1024 * 1024)
+
+// The first read-ahead window, and the number of reads in a row that must
+// continue where the previous one ended before the stream prefetches
+#define HDFS_READAHEAD_MIN_WINDOW (64 * 1024)
+#define HDFS_READAHEAD_SEQUENTIAL_READS 2
 
 tSize readDirect(hdfsFS fs, hdfsFile f, void* buffer, tSize length);
-static void hdfsFreeFileInfoEntry(hdfsFileInfo *hdfsFileInfo);
+static tSize preadDirectOn(hdfsFile f, jobject jStream, tOffset position,
+                           void* buffer, tSize length);
+tSize preadDirect(hdfsFS fs, hdfsFile file, tOffset position, void* buffer,
+                  tSize length);
+static void statCacheRegister(hdfsFS fs, const struct hdfsBuilder *bld);
+static void statCacheUnregister(hdfsFS fs);
+static int statCacheLookup(hdfsFS fs, const char *path, hdfsFileInfo **info);
+static void statCacheStore(hdfsFS fs, const char *path,
+                           const hdfsFileInfo *info);
+static void statCacheStoreListing(hdfsFS fs, const char *dir,
+                                  const hdfsFileInfo *infos, int numEntries);
+static void statCacheInvalidate(hdfsFS fs, const char *path,
+                                int descendants);
+static struct hdfsReadahead *readaheadAlloc(tSize maxWindow);
+static void readaheadFree(struct hdfsReadahead *ra);
+static void readaheadDiscard(struct hdfsReadahead *ra);
+static tSize readaheadRead(hdfsFS fs, hdfsFile f, void *buffer,
+                           tSize length);
+static void latencyRecord(hdfsFile f, struct hdfsLatencyHistogram *stats,
+                          enum hdfsLatencyOp op, uint64_t start);
+static int readaheadSyncPosition(JNIEnv *env, hdfsFile f);
+static struct hdfsReadBuffer *readBufferAlloc(tSize capacity);
+static void readBufferFree(struct hdfsReadBuffer *rb);
+static tSize readBufferRead(hdfsFS fs, hdfsFile f, void *buffer,
+                            tSize length);
+static int readBufferSyncPosition(JNIEnv *env, hdfsFile f);
+static tSize readStream(hdfsFS fs, hdfsFile f, void *buffer, tSize length);
+static int preadPoolAcquire(hdfsFile f, jobject *jStream);
+static void preadPoolRelease(hdfsFile f, int slot);
+static int unbufferLruAcquire(hdfsFile f, int reading);
+static void unbufferLruRelease(hdfsFile f, int acquired);
+static int unbufferLruPin(hdfsFile f, int acquired);
+static void unbufferLruUnpin(hdfsFile f);
+static int unbufferImpl(hdfsFile file);
 
 /**
  * The C equivalent of org.apache.org.hadoop.FSData(Input|Output)Stream .
@@ -70,6 +149,19 @@ enum hdfsStreamType
     HDFS_STREAM_OUTPUT = 2,
 };
 
+/**
+ * Where an input stream is in the unbuffer LRU.
+ */
+enum hdfsLruState
+{
+    // Unbuffered, or not read since it was opened
+    HDFS_LRU_IDLE = 0,
+    // On the list, holding whatever its reads buffered
+    HDFS_LRU_LISTED = 1,
+    // Taken off the list and being unbuffered by a read of another stream
+    HDFS_LRU_UNBUFFERING = 2,
+};
+
 /**
  * The 'file-handle' to a file in hdfs.
  */
@@ -77,6 +169,48 @@ struct hdfsFile_internal {
     void* file;
     enum hdfsStreamType type;
     int flags;
+    // Global reference to the byte[] hdfsWrite copies into, NULL until
+    // the first write
+    jbyteArray writeStaging;
+    tSize writeStagingLength;
+    // How much of the data of hdfsWritev goes to Java in one call
+    tSize writeBatch;
+    // Prefetch state of input streams opened with a read-ahead window,
+    // NULL otherwise
+    struct hdfsReadahead *readahead;
+    // Native buffer of input streams opened with a read buffer size, NULL
+    // otherwise
+    struct hdfsReadBuffer *readBuffer;
+    // Protected by hdfsLatencyMutex, since preads may run concurrently
+    struct hdfsLatencyStats latency;
+    // Extra streams for concurrent preads, NULL unless the stream was built
+    // with hdfsStreamBuilderSetPreadStreams
+    struct hdfsPreadPool *preadPool;
+    // Path of an output stream, whose cached status is dropped again on
+    // close since the size only settles then
+    char *writePath;
+    // Place in the unbuffer LRU, most recently read first, and the reads
+    // in progress, which keep it from being unbuffered, as does a block
+    // descriptor handed out by hadoopGetBlockFd until the next read or seek;
+    // all protected by hdfsUnbufferMutex
+    struct hdfsFile_internal *lruPrev;
+    struct hdfsFile_internal *lruNext;
+    enum hdfsLruState lruState;
+    int lruBusy;
+    int lruFdPinned;
+};
+
+/**
+ * Extra input streams on the file of an hdfsFile.  Each pread takes a stream
+ * whose busy flag is clear, so that concurrent preads don't queue up on the
+ * lock of a single Java stream.
+ */
+struct hdfsPreadPool {
+    int numStreams;
+    // Global references to the FSDataInputStreams
+    jobject *streams;
+    // Protected by hdfsPreadPoolMutex
+    char *busy;
 };
 
 #define HDFS_EXTENDED_FILE_INFO_ENCRYPTED 0x1
@@ -220,6 +354,59 @@ void hdfsFileFreeReadStatistics(struct hdfsReadStatistics *stats)
     free(stats);
 }
 
+/**
+ * Count a call that started at the given time in a latency histogram.
+ * Does not change errno.
+ */
+static void latencyRecord(hdfsFile f, struct hdfsLatencyHistogram *stats,
+                          enum hdfsLatencyOp op, uint64_t start)
+{
+    struct hdfsLatencyHistogram *hist;
+    uint64_t elapsed;
+    int bucket = 0;
+
+    if (!f) {
+        return;
+    }
+    elapsed = monotonicMicros() - start;
+    while (bucket < HDFS_LATENCY_BUCKETS - 1 && (elapsed >> bucket)) {
+        bucket++;
+    }
+    hist = &stats[op];
+    mutexLock(&hdfsLatencyMutex);
+    hist->count++;
+    hist->totalMicros += elapsed;
+    if (elapsed > hist->maxMicros) {
+        hist->maxMicros = elapsed;
+    }
+    hist->buckets[bucket]++;
+    mutexUnlock(&hdfsLatencyMutex);
+}
+
+int hdfsFileGetLatencyStats(hdfsFile file, struct hdfsLatencyStats *stats)
+{
+    if (!file || file->type == HDFS_STREAM_UNINITIALIZED || !stats) {
+        errno = EINVAL;
+        return -1;
+    }
+    mutexLock(&hdfsLatencyMutex);
+    memcpy(stats, &file->latency, sizeof(*stats));
+    mutexUnlock(&hdfsLatencyMutex);
+    return 0;
+}
+
+int hdfsFileClearLatencyStats(hdfsFile file)
+{
+    if (!file || file->type == HDFS_STREAM_UNINITIALIZED) {
+        errno = EINVAL;
+        return -1;
+    }
+    mutexLock(&hdfsLatencyMutex);
+    memset(&file->latency, 0, sizeof(file->latency));
+    mutexUnlock(&hdfsLatencyMutex);
+    return 0;
+}
+
 int hdfsFileIsOpenForWrite(hdfsFile file)
 {
     return (file->type == HDFS_STREAM_OUTPUT);
@@ -235,6 +422,16 @@ void hdfsFileDisableDirectRead(hdfsFile file)
     file->flags &= ~HDFS_FILE_SUPPORTS_DIRECT_READ;
 }
 
+int hdfsFileUsesDirectPread(hdfsFile file)
+{
+    return !!(file->flags & HDFS_FILE_SUPPORTS_DIRECT_PREAD);
+}
+
+void hdfsFileDisableDirectPread(hdfsFile file)
+{
+    file->flags &= ~HDFS_FILE_SUPPORTS_DIRECT_PREAD;
+}
+
 int hdfsDisableDomainSocketSecurity(void)
 {
     jthrowable jthr;
@@ -411,11 +608,14 @@ struct hdfsBuilderConfOpt {
 
 struct hdfsBuilder {
     int forceNewInstance;
+    int shared;
     const char *nn;
     tPort port;
     const char *kerbTicketCachePath;
     const char *userName;
     struct hdfsBuilderConfOpt *opts;
+    char hedgedReadThreads[16];
+    char hedgedReadThreshold[32];
 };
 
 struct hdfsBuilder *hdfsNewBuilder(void)
@@ -462,6 +662,30 @@ void hdfsBuilderSetForceNewInstance(struct hdfsBuilder *bld)
     bld->forceNewInstance = 1;
 }
 
+void hdfsBuilderSetShared(struct hdfsBuilder *bld)
+{
+    bld->shared = 1;
+}
+
+int hdfsBuilderSetHedgedReads(struct hdfsBuilder *bld, int32_t numThreads,
+                              int64_t thresholdMillis)
+{
+    int ret;
+
+    if (numThreads < 0 || thresholdMillis <= 0)
+        return -EINVAL;
+    snprintf(bld->hedgedReadThreads, sizeof(bld->hedgedReadThreads),
+             "%" PRId32, numThreads);
+    snprintf(bld->hedgedReadThreshold, sizeof(bld->hedgedReadThreshold),
+             "%" PRId64, thresholdMillis);
+    ret = hdfsBuilderConfSetStr(bld, HEDGED_READ_THREADS,
+                                bld->hedgedReadThreads);
+    if (ret)
+        return ret;
+    return hdfsBuilderConfSetStr(bld, HEDGED_READ_THRESHOLD,
+                                 bld->hedgedReadThreshold);
+}
+
 void hdfsBuilderSetNameNode(struct hdfsBuilder *bld, const char *nn)
 {
     bld->nn = nn;
@@ -596,7 +820,130 @@ static const char *hdfsBuilderToStr(const struct hdfsBuilder *bld,
     return buf;
 }
 
+/**
+ * A FileSystem connection shared by the connects of builders with the same
+ * settings.  The list is protected by hdfsSharedFSMutex.
+ */
+struct hdfsSharedFS {
+    struct hdfsSharedFS *next;
+    hdfsFS fs;
+    int refs;
+    char key[1];
+};
+
+static struct hdfsSharedFS *sharedFSes;
+
+/**
+ * Describe everything in a builder that affects the FileSystem it connects
+ * to, so that builders with the same key can share a connection.
+ *
+ * @return A dynamically allocated key, or NULL on OOM.
+ */
+static char *sharedFSKey(const struct hdfsBuilder *bld)
+{
+    const struct hdfsBuilderConfOpt *opt;
+    size_t len;
+    char *key;
+
+    len = snprintf(NULL, 0, "%d\n%s\n%d\n%s\n%s\n",
+            bld->forceNewInstance, maybeNull(bld->nn), bld->port,
+            maybeNull(bld->kerbTicketCachePath), maybeNull(bld->userName));
+    for (opt = bld->opts; opt; opt = opt->next) {
+        len += strlen(opt->key) + strlen(maybeNull(opt->val)) + 2;
+    }
+    key = malloc(len + 1);
+    if (!key) {
+        return NULL;
+    }
+    len = sprintf(key, "%d\n%s\n%d\n%s\n%s\n",
+            bld->forceNewInstance, maybeNull(bld->nn), bld->port,
+            maybeNull(bld->kerbTicketCachePath), maybeNull(bld->userName));
+    for (opt = bld->opts; opt; opt = opt->next) {
+        len += sprintf(key + len, "%s=%s\n", opt->key, maybeNull(opt->val));
+    }
+    return key;
+}
+
+static hdfsFS hdfsBuilderConnectImpl(struct hdfsBuilder *bld);
+
 hdfsFS hdfsBuilderConnect(struct hdfsBuilder *bld)
+{
+    struct hdfsSharedFS *shared;
+    hdfsFS fs;
+    char *key;
+
+    if (!bld->shared) {
+        return hdfsBuilderConnectImpl(bld);
+    }
+    key = sharedFSKey(bld);
+    if (!key) {
+        hdfsFreeBuilder(bld);
+        errno = ENOMEM;
+        return NULL;
+    }
+    // The lock is held while connecting, so that concurrent shared connects
+    // with the same settings don't both create a FileSystem
+    mutexLock(&hdfsSharedFSMutex);
+    for (shared = sharedFSes; shared; shared = shared->next) {
+        if (!strcmp(shared->key, key)) {
+            break;
+        }
+    }
+    if (shared) {
+        shared->refs++;
+        fs = shared->fs;
+        hdfsFreeBuilder(bld);
+    } else {
+        fs = hdfsBuilderConnectImpl(bld);
+        if (fs) {
+            shared = malloc(sizeof(struct hdfsSharedFS) + strlen(key));
+            if (shared) {
+                strcpy(shared->key, key);
+                shared->fs = fs;
+                shared->refs = 1;
+                shared->next = sharedFSes;
+                sharedFSes = shared;
+            } else {
+                // Still usable, just as an unshared connection
+                fprintf(stderr, "hdfsBuilderConnect: WARN: OOM sharing the "
+                        "connection\n");
+            }
+        }
+    }
+    mutexUnlock(&hdfsSharedFSMutex);
+    free(key);
+    return fs;
+}
+
+/**
+ * Drop a reference to a shared connection.
+ *
+ * @return 1 if other references remain and the connection must stay open,
+ *         0 if the connection is not shared or this was the last reference.
+ */
+static int sharedFSRelease(hdfsFS fs)
+{
+    struct hdfsSharedFS **link, *shared;
+    int inUse = 0;
+
+    mutexLock(&hdfsSharedFSMutex);
+    for (link = &sharedFSes; *link; link = &(*link)->next) {
+        shared = *link;
+        if (shared->fs == fs) {
+            if (--shared->refs > 0) {
+                inUse = 1;
+            } else {
+                *link = shared->next;
+                free(shared);
+            }
+            break;
+        }
+    }
+    mutexUnlock(&hdfsSharedFSMutex);
+    return inUse;
+}
+
+static hdfsFS hdfsBuilderConnectImpl(struct hdfsBuilder *bld)
 {
     JNIEnv *env = 0;
     jobject jConfiguration = NULL, jFS = NULL, jURI = NULL, jCachePath = NULL;
@@ -751,6 +1098,7 @@ hdfsFS hdfsBuilderConnect(struct hdfsBuilder *bld)
                     hdfsBuilderToStr(bld, buf, sizeof(buf)));
         goto done;
     }
+    statCacheRegister((hdfsFS)jRet, bld);
     ret = 0;
 
 done:
@@ -795,6 +1143,9 @@ int hdfsDisconnect(hdfsFS fs)
         errno = EBADF;
         return -1;
     }
+    if (sharedFSRelease(fs)) {
+        return 0;
+    }
 
     jthr = invokeMethod(env, NULL, INSTANCE, jFS, HADOOP_FS,
                      "close", "()V");
@@ -804,6 +1155,7 @@ int hdfsDisconnect(hdfsFS fs)
     } else {
         ret = 0;
     }
+    statCacheUnregister(fs);
     (*env)->DeleteGlobalRef(env, jFS);
     if (ret) {
         errno = ret;
@@ -858,6 +1210,10 @@ struct hdfsStreamBuilder {
     int32_t bufferSize;
     int16_t replication;
     int64_t defaultBlockSize;
+    int32_t readahead;
+    int32_t readBufferSize;
+    int32_t preadStreams;
+    int32_t writeBatch;
     char path[1];
 };
 
@@ -879,6 +1235,10 @@ struct hdfsStreamBuilder *hdfsStreamBuilderAlloc(hdfsFS fs,
     bld->bufferSize = 0;
     bld->replication = 0;
     bld->defaultBlockSize = 0;
+    bld->readahead = 0;
+    bld->readBufferSize = 0;
+    bld->preadStreams = 0;
+    bld->writeBatch = 0;
     memcpy(bld->path, path, path_len);
     bld->path[path_len] = '\0';
     return bld;
@@ -922,8 +1282,173 @@ int hdfsStreamBuilderSetDefaultBlockSize(struct hdfsStreamBuilder *bld,
     return 0;
 }
 
+int hdfsStreamBuilderSetReadahead(struct hdfsStreamBuilder *bld,
+                                  int32_t readahead)
+{
+    if ((bld->flags & O_ACCMODE) != O_RDONLY || readahead < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    bld->readahead = readahead;
+    return 0;
+}
+
+int hdfsStreamBuilderSetReadBufferSize(struct hdfsStreamBuilder *bld,
+                                       int32_t bufferSize)
+{
+    if ((bld->flags & O_ACCMODE) != O_RDONLY || bufferSize < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    bld->readBufferSize = bufferSize;
+    return 0;
+}
+
+int hdfsStreamBuilderSetPreadStreams(struct hdfsStreamBuilder *bld,
+                                     int32_t numStreams)
+{
+    if ((bld->flags & O_ACCMODE) != O_RDONLY || numStreams < 0 ||
+            numStreams > HDFS_PREAD_MAX_STREAMS) {
+        errno = EINVAL;
+        return -1;
+    }
+    bld->preadStreams = numStreams;
+    return 0;
+}
+
+int hdfsStreamBuilderSetWriteBatchSize(struct hdfsStreamBuilder *bld,
+                                       int32_t batchSize)
+{
+    if ((bld->flags & O_ACCMODE) != O_WRONLY || batchSize < 0 ||
+            batchSize > HDFS_WRITE_BATCH_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    bld->writeBatch = batchSize;
+    return 0;
+}
+
+static void preadPoolFree(JNIEnv *env, struct hdfsPreadPool *pool)
+{
+    int i;
+    jthrowable jthr;
+
+    for (i = 0; i < pool->numStreams; i++) {
+        jthr = invokeMethod(env, NULL, INSTANCE, pool->streams[i],
+                            HADOOP_ISTRM, "close", "()V");
+        if (jthr) {
+            printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                    "preadPoolFree: FSDataInputStream#close");
+        }
+        (*env)->DeleteGlobalRef(env, pool->streams[i]);
+    }
+    free(pool->streams);
+    free(pool->busy);
+    free(pool);
+}
+
+/**
+ * Open the extra streams of a pread pool.  Since the pool only makes preads
+ * faster, failing to set it up is not an error: it is reported, and the
+ * caller carries on without one.
+ */
+static struct hdfsPreadPool *preadPoolAlloc(JNIEnv *env, jobject jFS,
+        const char *path, jobject jPath, jint jBufferSize, int numStreams)
+{
+    struct hdfsPreadPool *pool;
+    jthrowable jthr;
+    jvalue jVal;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        goto oom;
+    }
+    pool->streams = calloc(numStreams, sizeof(jobject));
+    pool->busy = calloc(numStreams, 1);
+    if (!pool->streams || !pool->busy) {
+        goto oom;
+    }
+    while (pool->numStreams < numStreams) {
+        jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS, "open",
+                JMETHOD2(JPARAM(HADOOP_PATH), "I", JPARAM(HADOOP_ISTRM)),
+                jPath, jBufferSize);
+        if (jthr) {
+            printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsOpenFile(%s): WARN: FileSystem#open of pread stream %d",
+                path, pool->numStreams);
+            goto error;
+        }
+        pool->streams[pool->numStreams] = (*env)->NewGlobalRef(env, jVal.l);
+        destroyLocalReference(env, jVal.l);
+        if (!pool->streams[pool->numStreams]) {
+            printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                "hdfsOpenFile(%s): WARN: NewGlobalRef", path);
+            goto error;
+        }
+        pool->numStreams++;
+    }
+    return pool;
+
+oom:
+    fprintf(stderr, "hdfsOpenFile(%s): WARN: OOM allocating the pread "
+            "streams\n", path);
+error:
+    if (pool) {
+        preadPoolFree(env, pool);
+    }
+    return NULL;
+}
+
+/**
+ * Pick the stream for a pread.
+ *
+ * @return The pool slot that was taken, to be passed to preadPoolRelease,
+ *         or -1 if the pread goes to the main stream.
+ */
+static int preadPoolAcquire(hdfsFile f, jobject *jStream)
+{
+    struct hdfsPreadPool *pool;
+    int i;
+
+    if (!f) {
+        *jStream = NULL;
+        return -1;
+    }
+    *jStream = f->file;
+    pool = f->preadPool;
+    if (!pool) {
+        return -1;
+    }
+    mutexLock(&hdfsPreadPoolMutex);
+    for (i = 0; i < pool->numStreams; i++) {
+        if (!pool->busy[i]) {
+            pool->busy[i] = 1;
+            *jStream = pool->streams[i];
+            break;
+        }
+    }
+    mutexUnlock(&hdfsPreadPoolMutex);
+    return (i < pool->numStreams) ? i : -1;
+}
+
+static void preadPoolRelease(hdfsFile f, int slot)
+{
+    int prevErrno;
+
+    if (slot < 0) {
+        return;
+    }
+    prevErrno = errno;
+    mutexLock(&hdfsPreadPoolMutex);
+    f->preadPool->busy[slot] = 0;
+    mutexUnlock(&hdfsPreadPoolMutex);
+    errno = prevErrno;
+}
+
 static hdfsFile hdfsOpenFileImpl(hdfsFS fs, const char *path, int flags,
-                  int32_t bufferSize, int16_t replication, int64_t blockSize)
+                  int32_t bufferSize, int16_t replication, int64_t blockSize,
+                  int32_t readahead, int32_t readBufferSize,
+                  int32_t preadStreams, int32_t writeBatch)
 {
     /*
       JAVA EQUIVALENT:
@@ -938,6 +1463,8 @@ static hdfsFile hdfsOpenFileImpl(hdfsFS fs, const char *path, int flags,
     jthrowable jthr;
     jvalue jVal;
     hdfsFile file = NULL;
+    struct hdfsReadahead *ra = NULL;
+    struct hdfsReadBuffer *rb = NULL;
     int ret;
     jint jBufferSize = bufferSize;
     jshort jReplication = replication;
@@ -970,6 +1497,31 @@ static hdfsFile hdfsOpenFileImpl(hdfsFS fs, const char *path, int flags,
       fprintf(stderr, "WARN: hdfs does not truly support O_CREATE && O_EXCL\n");
     }
 
+    if (accmode == O_RDONLY && readahead > 0 && readBufferSize > 0) {
+        fprintf(stderr, "hdfsOpenFile(%s): a stream cannot have both a "
+                "read-ahead window and a read buffer\n", path);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (accmode == O_RDONLY && readBufferSize > 0) {
+        rb = readBufferAlloc(readBufferSize);
+        if (!rb) {
+            fprintf(stderr, "hdfsOpenFile(%s): OOM allocating the "
+                    "read buffer\n", path);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    if (accmode == O_RDONLY && readahead > 0) {
+        ra = readaheadAlloc(readahead);
+        if (!ra) {
+            fprintf(stderr, "hdfsOpenFile(%s): OOM allocating the "
+                    "read-ahead buffers\n", path);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
     if (accmode == O_RDONLY) {
 	method = "open";
         signature = JMETHOD2(JPARAM(HADOOP_PATH), "I", JPARAM(HADOOP_ISTRM));
@@ -1066,6 +1618,9 @@ static hdfsFile hdfsOpenFileImpl(hdfsFS fs, const char *path, int flags,
                          method, signature, jPath, jOverWrite,
                          jBufferSize, jReplication, jBlockSize);
     }
+    if (accmode == O_WRONLY) {
+        statCacheInvalidate(fs, path, 0);
+    }
     if (jthr) {
         ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsOpenFile(%s): FileSystem#%s(%s)", path, method, signature);
@@ -1088,6 +1643,15 @@ static hdfsFile hdfsOpenFileImpl(hdfsFS fs, const char *path, int flags,
     file->type = (((flags & O_WRONLY) == 0) ? HDFS_STREAM_INPUT :
         HDFS_STREAM_OUTPUT);
     file->flags = 0;
+    file->writeBatch = writeBatch ? writeBatch : HDFS_WRITE_BATCH_DEFAULT;
+    if (file->type == HDFS_STREAM_OUTPUT) {
+        file->writePath = strdup(path);
+        if (!file->writePath) {
+            fprintf(stderr, "hdfsOpenFile(%s): OOM copying path\n", path);
+            ret = ENOMEM;
+            goto done;
+        }
+    }
 
     if ((flags & O_WRONLY) == 0) {
         // Try a test read to see if we can do direct reads
@@ -1101,6 +1665,24 @@ static hdfsFile hdfsOpenFileImpl(hdfsFS fs, const char *path, int flags,
                   "hdfsOpenFile(%s): WARN: Unexpected error %d when testing "
                   "for direct read compatibility\n", path, errno);
         }
+        // Same for positional reads into a ByteBuffer
+        if (preadDirect(fs, file, 0, &buf, 0) == 0) {
+            file->flags |= HDFS_FILE_SUPPORTS_DIRECT_PREAD;
+        } else if (errno != ENOTSUP) {
+            fprintf(stderr,
+                  "hdfsOpenFile(%s): WARN: Unexpected error %d when testing "
+                  "for direct pread compatibility\n", path, errno);
+        }
+        file->readahead = ra;
+        ra = NULL;
+        file->readBuffer = rb;
+        rb = NULL;
+        if (preadStreams > 0) {
+            file->preadPool = preadPoolAlloc(env, jFS, path, jPath,
+                                             jBufferSize, preadStreams);
+        }
+        // Don't count the probes above
+        memset(&file->latency, 0, sizeof(file->latency));
     }
     ret = 0;
 
@@ -1110,11 +1692,16 @@ done:
     destroyLocalReference(env, jConfiguration); 
     destroyLocalReference(env, jPath); 
     destroyLocalReference(env, jFile); 
+    if (ra) {
+        readaheadFree(ra);
+    }
+    readBufferFree(rb);
     if (ret) {
         if (file) {
             if (file->file) {
                 (*env)->DeleteGlobalRef(env, file->file);
             }
+            free(file->writePath);
             free(file);
         }
         errno = ret;
@@ -1126,7 +1713,9 @@ done:
 hdfsFile hdfsStreamBuilderBuild(struct hdfsStreamBuilder *bld)
 {
     hdfsFile file = hdfsOpenFileImpl(bld->fs, bld->path, bld->flags,
-                  bld->bufferSize, bld->replication, bld->defaultBlockSize);
+                  bld->bufferSize, bld->replication, bld->defaultBlockSize,
+                  bld->readahead, bld->readBufferSize, bld->preadStreams,
+                  bld->writeBatch);
     int prevErrno = errno;
     hdfsStreamBuilderFree(bld);
     errno = prevErrno;
@@ -1158,6 +1747,7 @@ int hdfsTruncateFile(hdfsFS fs, const char* path, tOffset newlength)
     jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
                         "truncate", JMETHOD2(JPARAM(HADOOP_PATH), "J", "Z"),
                         jPath, newlength);
+    statCacheInvalidate(fs, path, 0);
     destroyLocalReference(env, jPath);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -1170,62 +1760,309 @@ int hdfsTruncateFile(hdfsFS fs, const char* path, tOffset newlength)
     return 0;
 }
 
-int hdfsUnbufferFile(hdfsFile file)
+// The unbuffer LRU, all protected by hdfsUnbufferMutex.  The limit is -1
+// until it is first needed.
+static struct hdfsFile_internal *lruHead;
+static struct hdfsFile_internal *lruTail;
+static int lruListed;
+static int lruLimit = -1;
+
+/**
+ * Get the unbuffer limit, called with hdfsUnbufferMutex held.
+ */
+static int unbufferLimit(void)
 {
-    int ret;
-    jthrowable jthr;
-    JNIEnv *env = getJNIEnv();
+    const char *value;
 
-    if (!env) {
-        ret = EINTERNAL;
-        goto done;
+    if (lruLimit < 0) {
+        lruLimit = HDFS_UNBUFFER_DEFAULT_LIMIT;
+        value = getenv("LIBHDFS_UNBUFFER_LIMIT");
+        if (value && atoi(value) > 0) {
+            lruLimit = atoi(value);
+        }
     }
-    if (file->type != HDFS_STREAM_INPUT) {
-        ret = ENOTSUP;
-        goto done;
+    return lruLimit;
+}
+
+/**
+ * Take a listed stream off the LRU, called with hdfsUnbufferMutex held.
+ */
+static void lruUnlink(hdfsFile f)
+{
+    if (f->lruPrev) {
+        f->lruPrev->lruNext = f->lruNext;
+    } else {
+        lruHead = f->lruNext;
     }
-    jthr = invokeMethod(env, NULL, INSTANCE, file->file, HADOOP_ISTRM,
-                     "unbuffer", "()V");
-    if (jthr) {
-        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
-                HADOOP_ISTRM "#unbuffer failed:");
-        goto done;
+    if (f->lruNext) {
+        f->lruNext->lruPrev = f->lruPrev;
+    } else {
+        lruTail = f->lruPrev;
     }
-    ret = 0;
-
-done:
-    errno = ret;
-    return ret;
+    f->lruPrev = NULL;
+    f->lruNext = NULL;
+    f->lruState = HDFS_LRU_IDLE;
+    lruListed--;
 }
 
-int hdfsCloseFile(hdfsFS fs, hdfsFile file)
+/**
+ * Let the LRU unbuffer a stream again that a block descriptor kept from it,
+ * called with hdfsUnbufferMutex held.
+ */
+static void lruUnpin(hdfsFile f)
 {
-    int ret;
-    // JAVA EQUIVALENT:
-    //  file.close 
-
-    //The interface whose 'close' method to be called
-    const char *interface;
-    const char *interfaceShortName;
-
-    //Caught exception
-    jthrowable jthr;
-
-    //Get the JNIEnv* corresponding to current thread
-    JNIEnv* env = getJNIEnv();
-    if (env == NULL) {
-        errno = EINTERNAL;
-        return -1;
+    if (f->lruFdPinned) {
+        f->lruFdPinned = 0;
+        f->lruBusy--;
     }
+}
 
-    //Sanity check
-    if (!file || file->type == HDFS_STREAM_UNINITIALIZED) {
-        errno = EBADF;
-        return -1;
+/**
+ * Keep the LRU from unbuffering an input stream while it is used.  A read
+ * also makes it the most recently used stream and then unbuffers the least
+ * recently used streams that are not in use beyond the limit.  The Java
+ * streams reconnect to the DataNodes on their next read, as they do after
+ * hdfsUnbufferFile.
+ *
+ * @return 1 if unbufferLruRelease must be called when the stream is no
+ *         longer used, 0 if the LRU is off
+ */
+static int unbufferLruAcquire(hdfsFile f, int reading)
+{
+    hdfsFile victims[HDFS_UNBUFFER_MAX_BATCH];
+    hdfsFile v, prev;
+    int numVictims = 0, limit, i;
+
+    if (!f || f->type != HDFS_STREAM_INPUT) {
+        return 0;
+    }
+    mutexLock(&hdfsUnbufferMutex);
+    limit = unbufferLimit();
+    if (limit <= 0) {
+        mutexUnlock(&hdfsUnbufferMutex);
+        return 0;
+    }
+    while (f->lruState == HDFS_LRU_UNBUFFERING) {
+        conditionWait(&hdfsUnbufferCondition, &hdfsUnbufferMutex);
+    }
+    f->lruBusy++;
+    if (!reading) {
+        mutexUnlock(&hdfsUnbufferMutex);
+        return 1;
+    }
+    lruUnpin(f);
+    if (f->lruState == HDFS_LRU_LISTED) {
+        lruUnlink(f);
+    }
+    f->lruNext = lruHead;
+    if (lruHead) {
+        lruHead->lruPrev = f;
+    } else {
+        lruTail = f;
+    }
+    lruHead = f;
+    f->lruState = HDFS_LRU_LISTED;
+    lruListed++;
+    for (v = lruTail; v && lruListed > limit &&
+            numVictims < HDFS_UNBUFFER_MAX_BATCH; v = prev) {
+        prev = v->lruPrev;
+        if (v->lruBusy) {
+            continue;
+        }
+        lruUnlink(v);
+        v->lruState = HDFS_LRU_UNBUFFERING;
+        victims[numVictims++] = v;
+    }
+    mutexUnlock(&hdfsUnbufferMutex);
+
+    if (numVictims == 0) {
+        return 1;
+    }
+    for (i = 0; i < numVictims; i++) {
+        // A stream that fails to unbuffer keeps its buffers until it is
+        // read and unbuffered again
+        unbufferImpl(victims[i]);
+    }
+    mutexLock(&hdfsUnbufferMutex);
+    for (i = 0; i < numVictims; i++) {
+        victims[i]->lruState = HDFS_LRU_IDLE;
+    }
+    conditionBroadcast(&hdfsUnbufferCondition);
+    mutexUnlock(&hdfsUnbufferMutex);
+    return 1;
+}
+
+/**
+ * Let the LRU unbuffer a stream that unbufferLruAcquire kept from it.
+ */
+static void unbufferLruRelease(hdfsFile f, int acquired)
+{
+    if (!acquired) {
+        return;
+    }
+    mutexLock(&hdfsUnbufferMutex);
+    f->lruBusy--;
+    mutexUnlock(&hdfsUnbufferMutex);
+}
+
+/**
+ * Keep the LRU from unbuffering a stream whose block descriptor was handed
+ * out, which unbuffering would close, until the stream is read from or
+ * moved again.
+ *
+ * @return what to pass to unbufferLruRelease in place of acquired
+ */
+static int unbufferLruPin(hdfsFile f, int acquired)
+{
+    if (!acquired) {
+        return 0;
+    }
+    mutexLock(&hdfsUnbufferMutex);
+    if (f->lruFdPinned) {
+        mutexUnlock(&hdfsUnbufferMutex);
+        return 1;
+    }
+    f->lruFdPinned = 1;
+    mutexUnlock(&hdfsUnbufferMutex);
+    return 0;
+}
+
+/**
+ * Let the LRU unbuffer a stream pinned by unbufferLruPin, once it moves.
+ */
+static void unbufferLruUnpin(hdfsFile f)
+{
+    if (!f || f->type != HDFS_STREAM_INPUT) {
+        return;
+    }
+    mutexLock(&hdfsUnbufferMutex);
+    lruUnpin(f);
+    mutexUnlock(&hdfsUnbufferMutex);
+}
+
+/**
+ * Take a stream that is unbuffered by hand or closed out of the LRU,
+ * waiting for a read of another stream to finish unbuffering it first.
+ */
+static void unbufferLruRemove(hdfsFile f)
+{
+    if (f->type != HDFS_STREAM_INPUT) {
+        return;
+    }
+    mutexLock(&hdfsUnbufferMutex);
+    while (f->lruState == HDFS_LRU_UNBUFFERING) {
+        conditionWait(&hdfsUnbufferCondition, &hdfsUnbufferMutex);
+    }
+    if (f->lruState == HDFS_LRU_LISTED) {
+        lruUnlink(f);
+    }
+    lruUnpin(f);
+    mutexUnlock(&hdfsUnbufferMutex);
+}
+
+void hdfsSetUnbufferLimit(int limit)
+{
+    mutexLock(&hdfsUnbufferMutex);
+    lruLimit = (limit > 0) ? limit : 0;
+    mutexUnlock(&hdfsUnbufferMutex);
+}
+
+int hdfsUnbufferFile(hdfsFile file)
+{
+    if (file) {
+        unbufferLruRemove(file);
+    }
+    return unbufferImpl(file);
+}
+
+static int unbufferImpl(hdfsFile file)
+{
+    int i, ret;
+    jthrowable jthr;
+    JNIEnv *env = getJNIEnv();
+
+    if (!env) {
+        ret = EINTERNAL;
+        goto done;
+    }
+    if (file->type != HDFS_STREAM_INPUT) {
+        ret = ENOTSUP;
+        goto done;
+    }
+    if (file->readahead) {
+        readaheadDiscard(file->readahead);
+    }
+    ret = readBufferSyncPosition(env, file);
+    if (ret) {
+        goto done;
+    }
+    jthr = invokeMethod(env, NULL, INSTANCE, file->file, HADOOP_ISTRM,
+                     "unbuffer", "()V");
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                HADOOP_ISTRM "#unbuffer failed:");
+        goto done;
+    }
+    if (file->preadPool) {
+        for (i = 0; i < file->preadPool->numStreams; i++) {
+            jthr = invokeMethod(env, NULL, INSTANCE,
+                    file->preadPool->streams[i], HADOOP_ISTRM,
+                    "unbuffer", "()V");
+            if (jthr) {
+                ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                        HADOOP_ISTRM "#unbuffer failed:");
+                goto done;
+            }
+        }
+    }
+    ret = 0;
+
+done:
+    errno = ret;
+    return ret;
+}
+
+int hdfsCloseFile(hdfsFS fs, hdfsFile file)
+{
+    int ret;
+    // JAVA EQUIVALENT:
+    //  file.close 
+
+    //The interface whose 'close' method to be called
+    const char *interface;
+    const char *interfaceShortName;
+
+    //Caught exception
+    jthrowable jthr;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+        errno = EINTERNAL;
+        return -1;
+    }
+
+    //Sanity check
+    if (!file || file->type == HDFS_STREAM_UNINITIALIZED) {
+        errno = EBADF;
+        return -1;
     }
+    unbufferLruRemove(file);
 
     interface = (file->type == HDFS_STREAM_INPUT) ?
         HADOOP_ISTRM : HADOOP_OSTRM;
+
+    // Wait for the prefetches still reading from the stream
+    if (file->readahead) {
+        readaheadFree(file->readahead);
+        file->readahead = NULL;
+    }
+    readBufferFree(file->readBuffer);
+    file->readBuffer = NULL;
+    if (file->preadPool) {
+        preadPoolFree(env, file->preadPool);
+        file->preadPool = NULL;
+    }
   
     jthr = invokeMethod(env, NULL, INSTANCE, file->file, interface,
                      "close", "()V");
@@ -1237,8 +2074,14 @@ int hdfsCloseFile(hdfsFS fs, hdfsFile file)
     } else {
         ret = 0;
     }
+    // Lookups made while the stream was open may have cached a partial size
+    statCacheInvalidate(fs, file->writePath, 0);
 
     //De-allocate memory
+    free(file->writePath);
+    if (file->writeStaging) {
+        (*env)->DeleteGlobalRef(env, file->writeStaging);
+    }
     (*env)->DeleteGlobalRef(env, file->file);
     free(file);
 
@@ -1256,6 +2099,7 @@ int hdfsExists(hdfsFS fs, const char *path)
     jvalue  jVal;
     jobject jFS = (jobject)fs;
     jthrowable jthr;
+    hdfsFileInfo *fileInfo;
 
     if (env == NULL) {
         errno = EINTERNAL;
@@ -1266,6 +2110,14 @@ int hdfsExists(hdfsFS fs, const char *path)
         errno = EINVAL;
         return -1;
     }
+    if (statCacheLookup(fs, path, &fileInfo)) {
+        if (!fileInfo) {
+            errno = ENOENT;
+            return -1;
+        }
+        hdfsFreeFileInfo(fileInfo, 1);
+        return 0;
+    }
     jthr = constructNewObjectOfPath(env, path, &jPath);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -1284,6 +2136,8 @@ int hdfsExists(hdfsFS fs, const char *path)
     if (jVal.z) {
         return 0;
     } else {
+        // only a missing path is cached, its status is not known here
+        statCacheStore(fs, path, NULL);
         errno = ENOENT;
         return -1;
     }
@@ -1311,7 +2165,25 @@ static int readPrepare(JNIEnv* env, hdfsFS fs, hdfsFile f,
     return 0;
 }
 
-tSize hdfsRead(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
+static tSize readImpl(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
+{
+    if (length == 0) {
+        return 0;
+    } else if (length < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (f->readahead) {
+      return readaheadRead(fs, f, buffer, length);
+    }
+    if (f->readBuffer) {
+      return readBufferRead(fs, f, buffer, length);
+    }
+    return readStream(fs, f, buffer, length);
+}
+
+// Reads from the Java stream at its position
+static tSize readStream(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
 {
     jobject jInputStream;
     jbyteArray jbRarray;
@@ -1319,13 +2191,8 @@ tSize hdfsRead(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
     jvalue jVal;
     jthrowable jthr;
     JNIEnv* env;
+    uint64_t javaStart;
 
-    if (length == 0) {
-        return 0;
-    } else if (length < 0) {
-        errno = EINVAL;
-        return -1;
-    }
     if (f->flags & HDFS_FILE_SUPPORTS_DIRECT_READ) {
       return readDirect(fs, f, buffer, length);
     }
@@ -1354,8 +2221,10 @@ tSize hdfsRead(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
         return -1;
     }
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jInputStream, HADOOP_ISTRM,
-                               "read", "([B)I", jbRarray);
+    javaStart = monotonicMicros();
+    jthr = invokeCachedMethod(env, &jVal, jInputStream, JM_ISTRM_READ,
+                               jbRarray);
+    latencyRecord(f, f->latency.java, HDFS_LATENCY_READ, javaStart);
     if (jthr) {
         destroyLocalReference(env, jbRarray);
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -1381,6 +2250,17 @@ tSize hdfsRead(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
     return jVal.i;
 }
 
+tSize hdfsRead(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
+{
+    uint64_t start = monotonicMicros();
+    int acquired = unbufferLruAcquire(f, 1);
+    tSize ret = readImpl(fs, f, buffer, length);
+
+    unbufferLruRelease(f, acquired);
+    latencyRecord(f, f ? f->latency.calls : NULL, HDFS_LATENCY_READ, start);
+    return ret;
+}
+
 // Reads using the read(ByteBuffer) API, which does fewer copies
 tSize readDirect(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
 {
@@ -1392,6 +2272,7 @@ tSize readDirect(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
     jvalue jVal;
     jthrowable jthr;
     jobject bb;
+    uint64_t javaStart;
 
     //Get the JNIEnv* corresponding to current thread
     JNIEnv* env = getJNIEnv();
@@ -1412,8 +2293,10 @@ tSize readDirect(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
         return -1;
     }
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jInputStream,
-        HADOOP_ISTRM, "read", "(Ljava/nio/ByteBuffer;)I", bb);
+    javaStart = monotonicMicros();
+    jthr = invokeCachedMethod(env, &jVal, jInputStream,
+        JM_ISTRM_READ_BUFFER, bb);
+    latencyRecord(f, f->latency.java, HDFS_LATENCY_READ, javaStart);
     destroyLocalReference(env, bb);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -1423,13 +2306,14 @@ tSize readDirect(hdfsFS fs, hdfsFile f, void* buffer, tSize length)
     return (jVal.i < 0) ? 0 : jVal.i;
 }
 
-tSize hdfsPread(hdfsFS fs, hdfsFile f, tOffset position,
-                void* buffer, tSize length)
+static tSize preadImpl(hdfsFS fs, hdfsFile f, jobject jStream,
+                       tOffset position, void* buffer, tSize length)
 {
     JNIEnv* env;
     jbyteArray jbRarray;
     jvalue jVal;
     jthrowable jthr;
+    uint64_t javaStart;
 
     if (length == 0) {
         return 0;
@@ -1455,6 +2339,10 @@ tSize hdfsPread(hdfsFS fs, hdfsFile f, tOffset position,
         return -1;
     }
 
+    if (f->flags & HDFS_FILE_SUPPORTS_DIRECT_PREAD) {
+        return preadDirectOn(f, jStream, position, buffer, length);
+    }
+
     // JAVA EQUIVALENT:
     //  byte [] bR = new byte[length];
     //  fis.read(pos, bR, 0, length);
@@ -1464,8 +2352,10 @@ tSize hdfsPread(hdfsFS fs, hdfsFile f, tOffset position,
             "hdfsPread: NewByteArray");
         return -1;
     }
-    jthr = invokeMethod(env, &jVal, INSTANCE, f->file, HADOOP_ISTRM,
-                     "read", "(J[BII)I", position, jbRarray, 0, length);
+    javaStart = monotonicMicros();
+    jthr = invokeCachedMethod(env, &jVal, jStream, JM_ISTRM_PREAD,
+                     position, jbRarray, 0, length);
+    latencyRecord(f, f->latency.java, HDFS_LATENCY_PREAD, javaStart);
     if (jthr) {
         destroyLocalReference(env, jbRarray);
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -1491,78 +2381,1075 @@ tSize hdfsPread(hdfsFS fs, hdfsFile f, tOffset position,
     return jVal.i;
 }
 
-tSize hdfsWrite(hdfsFS fs, hdfsFile f, const void* buffer, tSize length)
+tSize hdfsPread(hdfsFS fs, hdfsFile f, tOffset position,
+                void* buffer, tSize length)
 {
-    // JAVA EQUIVALENT
-    // byte b[] = str.getBytes();
-    // fso.write(b);
+    uint64_t start = monotonicMicros();
+    jobject jStream;
+    int acquired = unbufferLruAcquire(f, 1);
+    int slot = preadPoolAcquire(f, &jStream);
+    tSize ret = preadImpl(fs, f, jStream, position, buffer, length);
 
-    jobject jOutputStream;
-    jbyteArray jbWarray;
+    preadPoolRelease(f, slot);
+    unbufferLruRelease(f, acquired);
+    latencyRecord(f, f ? f->latency.calls : NULL, HDFS_LATENCY_PREAD, start);
+    return ret;
+}
+
+/**
+ * Read ranges[0..count) of a coalesced run, which cover
+ * [position, position + span) of the file back to back, through one byte
+ * array. Reads until the span is full or end-of-file.
+ *
+ * @return 0 on success, or an errno value
+ */
+static int preadvRun(JNIEnv *env, hdfsFile f, struct hdfsReadRange *ranges,
+                     int count, tOffset position, tSize span)
+{
+    jbyteArray jbRarray;
+    jvalue jVal;
     jthrowable jthr;
+    tSize done = 0;
+    tSize offset;
+    int i;
 
-    //Get the JNIEnv* corresponding to current thread
-    JNIEnv* env = getJNIEnv();
-    if (env == NULL) {
-      errno = EINTERNAL;
-      return -1;
+    jbRarray = (*env)->NewByteArray(env, span);
+    if (!jbRarray) {
+        return printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "hdfsPreadv: NewByteArray");
     }
-
-    //Sanity check
-    if (!f || f->type == HDFS_STREAM_UNINITIALIZED) {
-        errno = EBADF;
-        return -1;
+    while (done < span) {
+        jthr = invokeCachedMethod(env, &jVal, f->file, JM_ISTRM_PREAD,
+                position + done, jbRarray, done,
+                span - done);
+        if (jthr) {
+            destroyLocalReference(env, jbRarray);
+            return printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsPreadv: FSDataInputStream#read");
+        }
+        if (jVal.i < 0) {
+            // EOF
+            break;
+        } else if (jVal.i == 0) {
+            destroyLocalReference(env, jbRarray);
+            return EINTR;
+        }
+        done += jVal.i;
+    }
+    offset = 0;
+    for (i = 0; i < count; i++) {
+        tSize available = done - offset;
+        if (available > ranges[i].length) {
+            available = ranges[i].length;
+        } else if (available < 0) {
+            available = 0;
+        }
+        if (available > 0) {
+            (*env)->GetByteArrayRegion(env, jbRarray, offset, available,
+                                       ranges[i].buffer);
+            if ((*env)->ExceptionCheck(env)) {
+                destroyLocalReference(env, jbRarray);
+                return printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                    "hdfsPreadv: GetByteArrayRegion");
+            }
+        }
+        ranges[i].bytesRead = available;
+        offset += ranges[i].length;
     }
+    destroyLocalReference(env, jbRarray);
+    return 0;
+}
 
-    jOutputStream = f->file;
-    
-    if (length < 0) {
-    	errno = EINVAL;
-    	return -1;
+/**
+ * Read a single range with the direct pread path, until it is full or
+ * end-of-file.
+ *
+ * @return 0 on success, or an errno value
+ */
+static int preadvDirect(hdfsFS fs, hdfsFile f, struct hdfsReadRange *range)
+{
+    tSize done = 0;
+    tSize ret;
+
+    while (done < range->length) {
+        ret = preadDirect(fs, f, range->offset + done,
+                          (char *)range->buffer + done,
+                          range->length - done);
+        if (ret < 0) {
+            return errno;
+        } else if (ret == 0) {
+            // EOF
+            break;
+        }
+        done += ret;
     }
+    range->bytesRead = done;
+    return 0;
+}
 
-    //Error checking... make sure that this file is 'writable'
-    if (f->type != HDFS_STREAM_OUTPUT) {
-        fprintf(stderr, "Cannot write into a non-OutputStream object!\n");
-        errno = EINVAL;
-        return -1;
-    }
+static int preadvImpl(hdfsFS fs, hdfsFile f, struct hdfsReadRange *ranges,
+                      int numRanges)
+{
+    JNIEnv* env;
+    int first, last, i;
+    tOffset position;
+    tSize span;
+    int ret;
 
-    if (length < 0) {
+    if (numRanges < 0 || (numRanges > 0 && !ranges)) {
         errno = EINVAL;
         return -1;
     }
-    if (length == 0) {
+    for (i = 0; i < numRanges; i++) {
+        if (ranges[i].offset < 0 || ranges[i].length < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        ranges[i].bytesRead = 0;
+    }
+    if (numRanges == 0) {
         return 0;
     }
-    //Write the requisite bytes into the file
-    jbWarray = (*env)->NewByteArray(env, length);
-    if (!jbWarray) {
-        errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
-            "hdfsWrite: NewByteArray");
+    if (!f || f->type == HDFS_STREAM_UNINITIALIZED) {
+        errno = EBADF;
         return -1;
     }
-    (*env)->SetByteArrayRegion(env, jbWarray, 0, length, buffer);
-    if ((*env)->ExceptionCheck(env)) {
-        destroyLocalReference(env, jbWarray);
-        errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
-            "hdfsWrite(length = %d): SetByteArrayRegion", length);
-        return -1;
+
+    env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return -1;
     }
-    jthr = invokeMethod(env, NULL, INSTANCE, jOutputStream,
-            HADOOP_OSTRM, "write", "([B)V", jbWarray);
-    destroyLocalReference(env, jbWarray);
-    if (jthr) {
-        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
-            "hdfsWrite: FSDataOutputStream#write");
+
+    //Error checking... make sure that this file is 'readable'
+    if (f->type != HDFS_STREAM_INPUT) {
+        fprintf(stderr, "Cannot read from a non-InputStream object!\n");
+        errno = EINVAL;
         return -1;
     }
-    // Unlike most Java streams, FSDataOutputStream never does partial writes.
-    // If we succeeded, all the data was written.
-    return length;
+
+    for (first = 0; first < numRanges; first = last) {
+        // extend the run while the next range starts where it ends
+        position = ranges[first].offset;
+        span = ranges[first].length;
+        for (last = first + 1; last < numRanges; last++) {
+            if (ranges[last].offset != position + span ||
+                ranges[last].length > HDFS_PREADV_MAX_SPAN - span) {
+                break;
+            }
+            span += ranges[last].length;
+        }
+        if (span == 0) {
+            continue;
+        }
+        if (last - first == 1 && (f->flags & HDFS_FILE_SUPPORTS_DIRECT_PREAD)) {
+            ret = preadvDirect(fs, f, &ranges[first]);
+        } else {
+            ret = preadvRun(env, f, ranges + first, last - first, position,
+                            span);
+        }
+        if (ret) {
+            errno = ret;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int hdfsPreadv(hdfsFS fs, hdfsFile f, struct hdfsReadRange *ranges,
+               int numRanges)
+{
+    int acquired = unbufferLruAcquire(f, 1);
+    int ret = preadvImpl(fs, f, ranges, numRanges);
+
+    unbufferLruRelease(f, acquired);
+    return ret;
+}
+
+/**
+ * A read queued by hdfsPreadAsync.
+ */
+struct hdfsAsyncRead {
+    struct hdfsAsyncRead *next;
+    hdfsFS fs;
+    hdfsFile file;
+    tOffset position;
+    void *buffer;
+    tSize length;
+    hdfsReadCallback callback;
+    void *cookie;
+};
+
+// The queue and the worker pool, all protected by hdfsAsyncMutex
+static struct hdfsAsyncRead *asyncHead;
+static struct hdfsAsyncRead *asyncTail;
+static int asyncQueued;
+static int asyncNumThreads;
+static thread asyncThreads[HDFS_ASYNC_MAX_THREADS];
+
+static void asyncReadWorker(void *arg)
+{
+    struct hdfsAsyncRead *req;
+    tSize ret;
+    int err;
+
+    for (;;) {
+        mutexLock(&hdfsAsyncMutex);
+        while (!asyncHead) {
+            conditionWait(&hdfsAsyncCondition, &hdfsAsyncMutex);
+        }
+        req = asyncHead;
+        asyncHead = req->next;
+        if (!asyncHead) {
+            asyncTail = NULL;
+        }
+        asyncQueued--;
+        mutexUnlock(&hdfsAsyncMutex);
+
+        ret = hdfsPread(req->fs, req->file, req->position, req->buffer,
+                        req->length);
+        err = (ret < 0) ? errno : 0;
+        req->callback(ret, err, req->cookie);
+        free(req);
+    }
+}
+
+/**
+ * Start the worker threads, called with hdfsAsyncMutex held.
+ *
+ * @return 0 on success, or an errno value
+ */
+static int startAsyncThreads(void)
+{
+    const char *value;
+    int numThreads = HDFS_ASYNC_DEFAULT_THREADS;
+    int i, ret;
+
+    value = getenv("LIBHDFS_ASYNC_THREADS");
+    if (value) {
+        numThreads = atoi(value);
+        if (numThreads <= 0) {
+            numThreads = HDFS_ASYNC_DEFAULT_THREADS;
+        } else if (numThreads > HDFS_ASYNC_MAX_THREADS) {
+            numThreads = HDFS_ASYNC_MAX_THREADS;
+        }
+    }
+    for (i = 0; i < numThreads; i++) {
+        asyncThreads[i].start = asyncReadWorker;
+        asyncThreads[i].arg = NULL;
+        ret = threadCreate(&asyncThreads[i]);
+        if (ret) {
+            break;
+        }
+        asyncNumThreads++;
+    }
+    return (asyncNumThreads > 0) ? 0 : EINTERNAL;
+}
+
+int hdfsPreadAsync(hdfsFS fs, hdfsFile f, tOffset position, void* buffer,
+                   tSize length, hdfsReadCallback callback, void *cookie)
+{
+    struct hdfsAsyncRead *req;
+    int ret = 0;
+
+    if (!callback || length < 0 || position < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!f || f->type == HDFS_STREAM_UNINITIALIZED) {
+        errno = EBADF;
+        return -1;
+    }
+    if (f->type != HDFS_STREAM_INPUT) {
+        fprintf(stderr, "Cannot read from a non-InputStream object!\n");
+        errno = EINVAL;
+        return -1;
+    }
+    req = calloc(1, sizeof(struct hdfsAsyncRead));
+    if (!req) {
+        errno = ENOMEM;
+        return -1;
+    }
+    req->fs = fs;
+    req->file = f;
+    req->position = position;
+    req->buffer = buffer;
+    req->length = length;
+    req->callback = callback;
+    req->cookie = cookie;
+
+    mutexLock(&hdfsAsyncMutex);
+    if (asyncNumThreads == 0) {
+        ret = startAsyncThreads();
+    }
+    if (!ret && asyncQueued >= HDFS_ASYNC_MAX_QUEUED) {
+        ret = EAGAIN;
+    }
+    if (!ret) {
+        if (asyncTail) {
+            asyncTail->next = req;
+        } else {
+            asyncHead = req;
+        }
+        asyncTail = req;
+        asyncQueued++;
+        conditionSignal(&hdfsAsyncCondition);
+    }
+    mutexUnlock(&hdfsAsyncMutex);
+    if (ret) {
+        free(req);
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Positional read until length bytes are read or end-of-file.
+ *
+ * @return 0 on success, or an errno value
+ */
+static int preadFully(hdfsFS fs, hdfsFile f, tOffset position, char *buffer,
+                      tSize length, tSize *done)
+{
+    tSize ret;
+
+    while (*done < length) {
+        ret = hdfsPread(fs, f, position + *done, buffer + *done,
+                        length - *done);
+        if (ret < 0) {
+            return errno;
+        }
+        if (ret == 0) {
+            break;
+        }
+        *done += ret;
+    }
+    return 0;
+}
+
+/**
+ * One piece of a hdfsPreadParallel read.  ret, err and the pending count
+ * are written by the pool thread under hdfsParallelPreadMutex.
+ */
+struct hdfsParallelPreadPiece {
+    tOffset position;
+    tSize length;
+    int queued;
+    tSize ret;
+    int err;
+    int *pending;
+};
+
+static void parallelPreadDone(tSize ret, int error, void *cookie)
+{
+    struct hdfsParallelPreadPiece *piece = cookie;
+
+    mutexLock(&hdfsParallelPreadMutex);
+    piece->ret = ret;
+    piece->err = error;
+    (*piece->pending)--;
+    conditionBroadcast(&hdfsParallelPreadCondition);
+    mutexUnlock(&hdfsParallelPreadMutex);
+}
+
+tSize hdfsPreadParallel(hdfsFS fs, hdfsFile f, tOffset position,
+                        void* buffer, tSize length)
+{
+    struct hdfsParallelPreadPiece pieces[HDFS_PREAD_PARALLEL_MAX_PIECES];
+    char *buf = buffer;
+    tOffset blockSize, end, firstBlock, numBlocks, blocksPerPiece, pieceEnd;
+    int numPieces, pending = 0, i, ret = 0;
+    tSize done, total = 0;
+
+    if (length < 0 || position < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    end = position + length;
+    blockSize = hdfsGetDefaultBlockSize(fs);
+    if (blockSize <= 0) {
+        blockSize = end;
+    }
+    firstBlock = position / blockSize;
+    numBlocks = (end - 1) / blockSize - firstBlock + 1;
+    if (numBlocks == 1) {
+        done = 0;
+        ret = preadFully(fs, f, position, buf, length, &done);
+        if (ret) {
+            errno = ret;
+            return -1;
+        }
+        return done;
+    }
+    // Merge neighbouring blocks into one piece when there are too many
+    blocksPerPiece = (numBlocks + HDFS_PREAD_PARALLEL_MAX_PIECES - 1) /
+        HDFS_PREAD_PARALLEL_MAX_PIECES;
+    numPieces = (int)((numBlocks + blocksPerPiece - 1) / blocksPerPiece);
+    for (i = 0; i < numPieces; i++) {
+        pieces[i].position = (i == 0) ? position :
+            (firstBlock + i * blocksPerPiece) * blockSize;
+        pieceEnd = (firstBlock + (i + 1) * blocksPerPiece) * blockSize;
+        if (pieceEnd > end) {
+            pieceEnd = end;
+        }
+        pieces[i].length = (tSize)(pieceEnd - pieces[i].position);
+        pieces[i].queued = 0;
+        pieces[i].ret = 0;
+        pieces[i].err = 0;
+        pieces[i].pending = &pending;
+    }
+
+    // The first piece is read on this thread, the others on the pool.
+    // Pieces the pool has no room for are read here after the first one.
+    for (i = 1; i < numPieces; i++) {
+        mutexLock(&hdfsParallelPreadMutex);
+        pending++;
+        mutexUnlock(&hdfsParallelPreadMutex);
+        if (hdfsPreadAsync(fs, f, pieces[i].position,
+                           buf + (pieces[i].position - position),
+                           pieces[i].length, parallelPreadDone, &pieces[i])) {
+            mutexLock(&hdfsParallelPreadMutex);
+            pending--;
+            mutexUnlock(&hdfsParallelPreadMutex);
+            if (errno != EAGAIN) {
+                ret = errno;
+                break;
+            }
+        } else {
+            pieces[i].queued = 1;
+        }
+    }
+    if (!ret) {
+        done = 0;
+        ret = preadFully(fs, f, position, buf, pieces[0].length, &done);
+        pieces[0].ret = done;
+    }
+    mutexLock(&hdfsParallelPreadMutex);
+    while (pending > 0) {
+        conditionWait(&hdfsParallelPreadCondition, &hdfsParallelPreadMutex);
+    }
+    mutexUnlock(&hdfsParallelPreadMutex);
+    if (ret) {
+        errno = ret;
+        return -1;
+    }
+
+    // The result is the contiguous data up to the first short piece, which
+    // has reached the end of the file once it has been completed.
+    for (i = 0; i < numPieces; i++) {
+        if (pieces[i].err) {
+            errno = pieces[i].err;
+            return -1;
+        }
+        done = (i == 0 || pieces[i].queued) ? pieces[i].ret : 0;
+        ret = preadFully(fs, f, pieces[i].position,
+                         buf + (pieces[i].position - position),
+                         pieces[i].length, &done);
+        if (ret) {
+            errno = ret;
+            return -1;
+        }
+        total += done;
+        if (done < pieces[i].length) {
+            break;
+        }
+    }
+    return total;
+}
+
+/**
+ * A prefetch buffer of a read-ahead stream.  The pending flag, and the
+ * length while it is set, are protected by hdfsReadaheadMutex.  Everything
+ * else is only touched by the thread using the stream.
+ */
+struct hdfsReadaheadBuffer {
+    char *data;
+    tOffset start;
+    tSize requested;
+    tSize length;
+    int pending;
+};
+
+/**
+ * Read-ahead state of a stream opened with hdfsStreamBuilderSetReadahead.
+ *
+ * hdfsRead is served through positional reads at pos, out of the buffer
+ * being consumed when it holds that position.  The other buffer is filled
+ * with the window after it in the background.  The Java stream is only
+ * moved to pos when something uses its position.
+ */
+struct hdfsReadahead {
+    tSize maxWindow;
+    tSize window;
+    int sequentialReads;
+    // a prefetch came back short, don't prefetch past the end of the file
+    int eof;
+    tOffset pos;
+    tOffset lastEnd;
+    tOffset streamPos;
+    int cur;
+    struct hdfsReadaheadBuffer buffers[2];
+};
+
+static struct hdfsReadahead *readaheadAlloc(tSize maxWindow)
+{
+    struct hdfsReadahead *ra;
+
+    ra = calloc(1, sizeof(struct hdfsReadahead));
+    if (!ra) {
+        return NULL;
+    }
+    ra->buffers[0].data = malloc(maxWindow);
+    ra->buffers[1].data = malloc(maxWindow);
+    if (!ra->buffers[0].data || !ra->buffers[1].data) {
+        free(ra->buffers[0].data);
+        free(ra->buffers[1].data);
+        free(ra);
+        return NULL;
+    }
+    ra->maxWindow = maxWindow;
+    ra->window = (maxWindow < HDFS_READAHEAD_MIN_WINDOW) ?
+        maxWindow : HDFS_READAHEAD_MIN_WINDOW;
+    return ra;
+}
+
+static void readaheadWait(struct hdfsReadaheadBuffer *b)
+{
+    mutexLock(&hdfsReadaheadMutex);
+    while (b->pending) {
+        conditionWait(&hdfsReadaheadCondition, &hdfsReadaheadMutex);
+    }
+    mutexUnlock(&hdfsReadaheadMutex);
+}
+
+// Whether the buffer is being filled or holds data
+static int readaheadInUse(struct hdfsReadaheadBuffer *b)
+{
+    int inUse;
+
+    mutexLock(&hdfsReadaheadMutex);
+    inUse = b->pending || b->length > 0;
+    mutexUnlock(&hdfsReadaheadMutex);
+    return inUse;
+}
+
+static void readaheadFillDone(tSize ret, int error, void *cookie)
+{
+    struct hdfsReadaheadBuffer *b = cookie;
+
+    // A failed prefetch leaves the buffer empty, the read that needs the
+    // data then reads it itself and gets the error.
+    mutexLock(&hdfsReadaheadMutex);
+    b->length = (ret < 0) ? 0 : ret;
+    b->pending = 0;
+    conditionBroadcast(&hdfsReadaheadCondition);
+    mutexUnlock(&hdfsReadaheadMutex);
+}
+
+static void readaheadDiscard(struct hdfsReadahead *ra)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        readaheadWait(&ra->buffers[i]);
+        ra->buffers[i].length = 0;
+    }
+    ra->eof = 0;
+}
+
+static void readaheadFree(struct hdfsReadahead *ra)
+{
+    readaheadDiscard(ra);
+    free(ra->buffers[0].data);
+    free(ra->buffers[1].data);
+    free(ra);
+}
+
+/**
+ * Start filling the buffer that is not being consumed with the window after
+ * the buffered data.  Nothing happens if that buffer is still in use.
+ */
+static void readaheadStartFill(hdfsFS fs, hdfsFile f)
+{
+    struct hdfsReadahead *ra = f->readahead;
+    struct hdfsReadaheadBuffer *cur = &ra->buffers[ra->cur];
+    struct hdfsReadaheadBuffer *next = &ra->buffers[!ra->cur];
+
+    if (ra->eof || readaheadInUse(next)) {
+        return;
+    }
+    next->start = (cur->length > 0) ? cur->start + cur->length : ra->pos;
+    next->requested = ra->window;
+    next->pending = 1;
+    if (hdfsPreadAsync(fs, f, next->start, next->data, next->requested,
+                       readaheadFillDone, next)) {
+        // The pool is busy, try again on the next read
+        next->pending = 0;
+    }
+}
+
+static tSize readaheadRead(hdfsFS fs, hdfsFile f, void *buffer, tSize length)
+{
+    struct hdfsReadahead *ra = f->readahead;
+    struct hdfsReadaheadBuffer *cur = &ra->buffers[ra->cur];
+    struct hdfsReadaheadBuffer *next = &ra->buffers[!ra->cur];
+    tSize ret;
+
+    if (ra->pos != ra->lastEnd) {
+        // A seek, wait for reads to become sequential again before
+        // prefetching
+        ra->sequentialReads = 0;
+        ra->window = (ra->maxWindow < HDFS_READAHEAD_MIN_WINDOW) ?
+            ra->maxWindow : HDFS_READAHEAD_MIN_WINDOW;
+    }
+    if ((ra->pos < cur->start || ra->pos >= cur->start + cur->length) &&
+            ra->pos >= next->start &&
+            ra->pos < next->start + next->requested &&
+            readaheadInUse(next)) {
+        // Move on to the prefetched window, and fetch a larger one next
+        readaheadWait(next);
+        if (next->length < next->requested) {
+            ra->eof = 1;
+        }
+        cur->length = 0;
+        ra->cur = !ra->cur;
+        cur = next;
+        next = &ra->buffers[!ra->cur];
+        ra->window = (ra->window > ra->maxWindow / 2) ?
+            ra->maxWindow : ra->window * 2;
+    }
+    if (ra->pos >= cur->start && ra->pos < cur->start + cur->length) {
+        ret = (tSize)(cur->start + cur->length - ra->pos);
+        if (ret > length) {
+            ret = length;
+        }
+        memcpy(buffer, cur->data + (ra->pos - cur->start), ret);
+    } else {
+        // Nothing buffered at this position, drop what is buffered elsewhere
+        readaheadDiscard(ra);
+        ret = hdfsPread(fs, f, ra->pos, buffer, length);
+        if (ret <= 0) {
+            return ret;
+        }
+    }
+    ra->pos += ret;
+    ra->lastEnd = ra->pos;
+    if (++ra->sequentialReads >= HDFS_READAHEAD_SEQUENTIAL_READS) {
+        readaheadStartFill(fs, f);
+    }
+    return ret;
+}
+
+/**
+ * Move the Java stream of a read-ahead stream to where hdfsRead got to,
+ * before calling something that uses its position.
+ *
+ * @return 0 on success, or an errno value
+ */
+static int readaheadSyncPosition(JNIEnv *env, hdfsFile f)
+{
+    struct hdfsReadahead *ra = f->readahead;
+    jthrowable jthr;
+
+    if (!ra || ra->streamPos == ra->pos) {
+        return 0;
+    }
+    jthr = invokeCachedMethod(env, NULL, f->file, JM_ISTRM_SEEK, ra->pos);
+    if (jthr) {
+        return printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "readaheadSyncPosition(pos=%" PRId64 "): FSDataInputStream#seek",
+            ra->pos);
+    }
+    ra->streamPos = ra->pos;
+    return 0;
+}
+
+/**
+ * Native read buffer of a stream opened with
+ * hdfsStreamBuilderSetReadBufferSize.  It holds the bytes of the file from
+ * start to start + length, and hdfsRead has got to pos in them.  The Java
+ * stream is always at start + length.
+ */
+struct hdfsReadBuffer {
+    char *data;
+    tSize capacity;
+    tOffset start;
+    tSize length;
+    tOffset pos;
+};
+
+static struct hdfsReadBuffer *readBufferAlloc(tSize capacity)
+{
+    struct hdfsReadBuffer *rb;
+
+    rb = calloc(1, sizeof(struct hdfsReadBuffer));
+    if (!rb) {
+        return NULL;
+    }
+    rb->data = malloc(capacity);
+    if (!rb->data) {
+        free(rb);
+        return NULL;
+    }
+    rb->capacity = capacity;
+    return rb;
+}
+
+static void readBufferFree(struct hdfsReadBuffer *rb)
+{
+    if (rb) {
+        free(rb->data);
+        free(rb);
+    }
+}
+
+static tSize readBufferRead(hdfsFS fs, hdfsFile f, void *buffer, tSize length)
+{
+    struct hdfsReadBuffer *rb = f->readBuffer;
+    tSize avail = (tSize)(rb->start + rb->length - rb->pos);
+    tSize ret;
+
+    if (avail == 0) {
+        if (length >= rb->capacity) {
+            // Copying through the buffer would not save any calls
+            ret = readStream(fs, f, buffer, length);
+            if (ret > 0) {
+                rb->pos += ret;
+                rb->start = rb->pos;
+                rb->length = 0;
+            }
+            return ret;
+        }
+        ret = readStream(fs, f, rb->data, rb->capacity);
+        if (ret <= 0) {
+            return ret;
+        }
+        rb->start = rb->pos;
+        rb->length = ret;
+        avail = ret;
+    }
+    ret = (avail < length) ? avail : length;
+    memcpy(buffer, rb->data + (rb->pos - rb->start), ret);
+    rb->pos += ret;
+    return ret;
+}
+
+/**
+ * Move the Java stream of a buffered stream back to where hdfsRead got to,
+ * dropping the buffered data, before calling something that uses its
+ * position.
+ *
+ * @return 0 on success, or an errno value
+ */
+static int readBufferSyncPosition(JNIEnv *env, hdfsFile f)
+{
+    struct hdfsReadBuffer *rb = f->readBuffer;
+    jthrowable jthr;
+
+    if (!rb) {
+        return 0;
+    }
+    if (rb->pos != rb->start + rb->length) {
+        jthr = invokeCachedMethod(env, NULL, f->file, JM_ISTRM_SEEK, rb->pos);
+        if (jthr) {
+            return printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "readBufferSyncPosition(pos=%" PRId64 "): "
+                "FSDataInputStream#seek", rb->pos);
+        }
+    }
+    rb->start = rb->pos;
+    rb->length = 0;
+    return 0;
+}
+
+// Reads using the read(long, ByteBuffer) API, which avoids the byte array
+// allocation and the copy out of it
+tSize preadDirect(hdfsFS fs, hdfsFile f, tOffset position, void* buffer,
+                  tSize length)
+{
+    return preadDirectOn(f, f->file, position, buffer, length);
+}
+
+static tSize preadDirectOn(hdfsFile f, jobject jStream, tOffset position,
+                           void* buffer, tSize length)
+{
+    // JAVA EQUIVALENT:
+    //  ByteBuffer bbuffer = ByteBuffer.allocateDirect(length) // wraps C buffer
+    //  fis.read(position, bbuffer);
+
+    jvalue jVal;
+    jthrowable jthr;
+    jobject bb;
+    uint64_t javaStart;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return -1;
+    }
+
+    //Read the requisite bytes
+    bb = (*env)->NewDirectByteBuffer(env, buffer, length);
+    if (bb == NULL) {
+        errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "preadDirect: NewDirectByteBuffer");
+        return -1;
+    }
+
+    javaStart = monotonicMicros();
+    jthr = invokeCachedMethod(env, &jVal, jStream,
+        JM_ISTRM_PREAD_BUFFER, position, bb);
+    latencyRecord(f, f->latency.java, HDFS_LATENCY_PREAD, javaStart);
+    destroyLocalReference(env, bb);
+    if (jthr) {
+        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "preadDirect: FSDataInputStream#read");
+        return -1;
+    }
+    if (jVal.i < 0) {
+        // EOF
+        return 0;
+    } else if (jVal.i == 0 && length > 0) {
+        errno = EINTR;
+        return -1;
+    }
+    return jVal.i;
+}
+
+/**
+ * Get a byte[] of at least length bytes for hdfsWrite. Writes up to
+ * HDFS_WRITE_STAGING_MAX bytes share one array per file, grown to the
+ * largest such write, so steady streams of small writes do not allocate.
+ * Larger writes get a new local reference the caller must destroy.
+ *
+ * @return the array, or NULL with a pending exception
+ */
+static jbyteArray getWriteStaging(JNIEnv *env, hdfsFile f, tSize length)
+{
+    jbyteArray jArray;
+
+    if (length > HDFS_WRITE_STAGING_MAX) {
+        return (*env)->NewByteArray(env, length);
+    }
+    if (f->writeStaging && f->writeStagingLength >= length) {
+        return f->writeStaging;
+    }
+    jArray = (*env)->NewByteArray(env, length);
+    if (!jArray) {
+        return NULL;
+    }
+    if (f->writeStaging) {
+        (*env)->DeleteGlobalRef(env, f->writeStaging);
+        f->writeStaging = NULL;
+        f->writeStagingLength = 0;
+    }
+    f->writeStaging = (*env)->NewGlobalRef(env, jArray);
+    destroyLocalReference(env, jArray);
+    if (!f->writeStaging) {
+        return NULL;
+    }
+    f->writeStagingLength = length;
+    return f->writeStaging;
 }
 
-int hdfsSeek(hdfsFS fs, hdfsFile f, tOffset desiredPos) 
+static tSize writeImpl(hdfsFS fs, hdfsFile f, const void* buffer,
+                       tSize length)
+{
+    // JAVA EQUIVALENT
+    // byte b[] = str.getBytes();
+    // fso.write(b);
+
+    jobject jOutputStream;
+    jbyteArray jbWarray;
+    jthrowable jthr;
+    uint64_t javaStart;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return -1;
+    }
+
+    //Sanity check
+    if (!f || f->type == HDFS_STREAM_UNINITIALIZED) {
+        errno = EBADF;
+        return -1;
+    }
+
+    jOutputStream = f->file;
+    
+    if (length < 0) {
+    	errno = EINVAL;
+    	return -1;
+    }
+
+    //Error checking... make sure that this file is 'writable'
+    if (f->type != HDFS_STREAM_OUTPUT) {
+        fprintf(stderr, "Cannot write into a non-OutputStream object!\n");
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (length < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    //Write the requisite bytes into the file
+    jbWarray = getWriteStaging(env, f, length);
+    if (!jbWarray) {
+        errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "hdfsWrite: NewByteArray");
+        return -1;
+    }
+    (*env)->SetByteArrayRegion(env, jbWarray, 0, length, buffer);
+    if ((*env)->ExceptionCheck(env)) {
+        if (jbWarray != f->writeStaging) {
+            destroyLocalReference(env, jbWarray);
+        }
+        errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "hdfsWrite(length = %d): SetByteArrayRegion", length);
+        return -1;
+    }
+    javaStart = monotonicMicros();
+    jthr = invokeCachedMethod(env, NULL, jOutputStream,
+            JM_OSTRM_WRITE, jbWarray, 0, length);
+    latencyRecord(f, f->latency.java, HDFS_LATENCY_WRITE, javaStart);
+    if (jbWarray != f->writeStaging) {
+        destroyLocalReference(env, jbWarray);
+    }
+    if (jthr) {
+        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsWrite: FSDataOutputStream#write");
+        return -1;
+    }
+    // Unlike most Java streams, FSDataOutputStream never does partial writes.
+    // If we succeeded, all the data was written.
+    return length;
+}
+
+tSize hdfsWrite(hdfsFS fs, hdfsFile f, const void* buffer, tSize length)
+{
+    uint64_t start = monotonicMicros();
+    tSize ret = writeImpl(fs, f, buffer, length);
+    latencyRecord(f, f ? f->latency.calls : NULL, HDFS_LATENCY_WRITE, start);
+    return ret;
+}
+
+/**
+ * Write the first length bytes of a staging array to f.
+ *
+ * @return 0 on success, or an errno value.
+ */
+static int writeStaged(JNIEnv *env, hdfsFile f, jbyteArray jbWarray,
+                       tSize length)
+{
+    jthrowable jthr;
+    uint64_t javaStart;
+
+    javaStart = monotonicMicros();
+    jthr = invokeCachedMethod(env, NULL, f->file, JM_OSTRM_WRITE,
+                              jbWarray, 0, length);
+    latencyRecord(f, f->latency.java, HDFS_LATENCY_WRITE, javaStart);
+    if (jthr) {
+        return printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsWritev: FSDataOutputStream#write");
+    }
+    return 0;
+}
+
+static tSize writevImpl(hdfsFS fs, hdfsFile f,
+                        const struct hdfsWriteVec *vecs, int numVecs)
+{
+    // JAVA EQUIVALENT
+    //  for each batch of vecs: fso.write(batch, 0, batchLength);
+
+    jbyteArray jbWarray;
+    tSize total = 0, staged = 0, chunk, done;
+    int i, ret;
+
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return -1;
+    }
+    if (!f || f->type != HDFS_STREAM_OUTPUT) {
+        errno = EBADF;
+        return -1;
+    }
+    if (numVecs < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (i = 0; i < numVecs; i++) {
+        if (vecs[i].length < 0 || vecs[i].length > INT32_MAX - total) {
+            errno = EINVAL;
+            return -1;
+        }
+        total += vecs[i].length;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    jbWarray = getWriteStaging(env, f,
+            (total < f->writeBatch) ? total : f->writeBatch);
+    if (!jbWarray) {
+        errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "hdfsWritev: NewByteArray");
+        return -1;
+    }
+    for (i = 0; i < numVecs; i++) {
+        for (done = 0; done < vecs[i].length; done += chunk) {
+            chunk = vecs[i].length - done;
+            if (chunk > f->writeBatch - staged) {
+                chunk = f->writeBatch - staged;
+            }
+            (*env)->SetByteArrayRegion(env, jbWarray, staged, chunk,
+                    (const jbyte *)vecs[i].buffer + done);
+            if ((*env)->ExceptionCheck(env)) {
+                errno = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                    "hdfsWritev(length = %d): SetByteArrayRegion", chunk);
+                return -1;
+            }
+            staged += chunk;
+            if (staged == f->writeBatch) {
+                ret = writeStaged(env, f, jbWarray, staged);
+                if (ret) {
+                    errno = ret;
+                    return -1;
+                }
+                staged = 0;
+            }
+        }
+    }
+    if (staged) {
+        ret = writeStaged(env, f, jbWarray, staged);
+        if (ret) {
+            errno = ret;
+            return -1;
+        }
+    }
+    return total;
+}
+
+tSize hdfsWritev(hdfsFS fs, hdfsFile f, const struct hdfsWriteVec *vecs,
+                 int numVecs)
+{
+    uint64_t start = monotonicMicros();
+    tSize ret = writevImpl(fs, f, vecs, numVecs);
+    latencyRecord(f, f ? f->latency.calls : NULL, HDFS_LATENCY_WRITE, start);
+    return ret;
+}
+
+static int seekImpl(hdfsFS fs, hdfsFile f, tOffset desiredPos)
 {
     // JAVA EQUIVALENT
     //  fis.seek(pos);
@@ -1583,27 +3470,54 @@ int hdfsSeek(hdfsFS fs, hdfsFile f, tOffset desiredPos)
         return -1;
     }
 
+    // Seeks within the buffered data don't need the Java stream
+    if (f->readBuffer && desiredPos >= f->readBuffer->start &&
+            desiredPos <= f->readBuffer->start + f->readBuffer->length) {
+        f->readBuffer->pos = desiredPos;
+        return 0;
+    }
+
     jInputStream = f->file;
-    jthr = invokeMethod(env, NULL, INSTANCE, jInputStream,
-            HADOOP_ISTRM, "seek", "(J)V", desiredPos);
+    jthr = invokeCachedMethod(env, NULL, jInputStream,
+            JM_ISTRM_SEEK, desiredPos);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsSeek(desiredPos=%" PRId64 ")"
             ": FSDataInputStream#seek", desiredPos);
         return -1;
     }
+    if (f->readahead) {
+        f->readahead->pos = desiredPos;
+        f->readahead->streamPos = desiredPos;
+    }
+    if (f->readBuffer) {
+        f->readBuffer->pos = desiredPos;
+        f->readBuffer->start = desiredPos;
+        f->readBuffer->length = 0;
+    }
     return 0;
 }
 
+int hdfsSeek(hdfsFS fs, hdfsFile f, tOffset desiredPos)
+{
+    int acquired, ret;
 
+    // The stream may leave the block of a descriptor from hadoopGetBlockFd
+    unbufferLruUnpin(f);
+    // The buffers a seek moves in must not be unbuffered under it
+    acquired = unbufferLruAcquire(f, 0);
+    ret = seekImpl(fs, f, desiredPos);
 
-tOffset hdfsTell(hdfsFS fs, hdfsFile f)
+    unbufferLruRelease(f, acquired);
+    return ret;
+}
+
+static tOffset tellImpl(hdfsFS fs, hdfsFile f)
 {
     // JAVA EQUIVALENT
     //  pos = f.getPos();
 
     jobject jStream;
-    const char *interface;
     jvalue jVal;
     jthrowable jthr;
 
@@ -1620,12 +3534,19 @@ tOffset hdfsTell(hdfsFS fs, hdfsFile f)
         return -1;
     }
 
+    // Reads of a read-ahead stream do not move the Java stream
+    if (f->readahead) {
+        return f->readahead->pos;
+    }
+    if (f->readBuffer) {
+        return f->readBuffer->pos;
+    }
+
     //Parameters
     jStream = f->file;
-    interface = (f->type == HDFS_STREAM_INPUT) ?
-        HADOOP_ISTRM : HADOOP_OSTRM;
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStream,
-                     interface, "getPos", "()J");
+    jthr = invokeCachedMethod(env, &jVal, jStream,
+                     (f->type == HDFS_STREAM_INPUT) ?
+                        JM_ISTRM_GET_POS : JM_OSTRM_GET_POS);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsTell: %s#getPos",
@@ -1636,6 +3557,16 @@ tOffset hdfsTell(hdfsFS fs, hdfsFile f)
     return jVal.j;
 }
 
+tOffset hdfsTell(hdfsFS fs, hdfsFile f)
+{
+    // The position is kept in the buffers until they are unbuffered
+    int acquired = unbufferLruAcquire(f, 0);
+    tOffset ret = tellImpl(fs, f);
+
+    unbufferLruRelease(f, acquired);
+    return ret;
+}
+
 int hdfsFlush(hdfsFS fs, hdfsFile f) 
 {
     // JAVA EQUIVALENT
@@ -1655,8 +3586,8 @@ int hdfsFlush(hdfsFS fs, hdfsFile f)
         errno = EBADF;
         return -1;
     }
-    jthr = invokeMethod(env, NULL, INSTANCE, f->file,
-                     HADOOP_OSTRM, "flush", "()V");
+    jthr = invokeCachedMethod(env, NULL, f->file,
+                     JM_OSTRM_FLUSH);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsFlush: FSDataInputStream#flush");
@@ -1684,8 +3615,8 @@ int hdfsHFlush(hdfsFS fs, hdfsFile f)
     }
 
     jOutputStream = f->file;
-    jthr = invokeMethod(env, NULL, INSTANCE, jOutputStream,
-                     HADOOP_OSTRM, "hflush", "()V");
+    jthr = invokeCachedMethod(env, NULL, jOutputStream,
+                     JM_OSTRM_HFLUSH);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsHFlush: FSDataOutputStream#hflush");
@@ -1713,8 +3644,8 @@ int hdfsHSync(hdfsFS fs, hdfsFile f)
     }
 
     jOutputStream = f->file;
-    jthr = invokeMethod(env, NULL, INSTANCE, jOutputStream,
-                     HADOOP_OSTRM, "hsync", "()V");
+    jthr = invokeCachedMethod(env, NULL, jOutputStream,
+                     JM_OSTRM_HSYNC);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsHSync: FSDataOutputStream#hsync");
@@ -1723,7 +3654,7 @@ int hdfsHSync(hdfsFS fs, hdfsFile f)
     return 0;
 }
 
-int hdfsAvailable(hdfsFS fs, hdfsFile f)
+static int availableImpl(hdfsFS fs, hdfsFile f)
 {
     // JAVA EQUIVALENT
     //  fis.available();
@@ -1745,16 +3676,160 @@ int hdfsAvailable(hdfsFS fs, hdfsFile f)
         return -1;
     }
 
-    //Parameters
-    jInputStream = f->file;
-    jthr = invokeMethod(env, &jVal, INSTANCE, jInputStream,
-                     HADOOP_ISTRM, "available", "()I");
+    errno = readaheadSyncPosition(env, f);
+    if (!errno) {
+        errno = readBufferSyncPosition(env, f);
+    }
+    if (errno) {
+        return -1;
+    }
+
+    //Parameters
+    jInputStream = f->file;
+    jthr = invokeCachedMethod(env, &jVal, jInputStream,
+                     JM_ISTRM_AVAILABLE);
+    if (jthr) {
+        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsAvailable: FSDataInputStream#available");
+        return -1;
+    }
+    return jVal.i;
+}
+
+int hdfsAvailable(hdfsFS fs, hdfsFile f)
+{
+    int acquired = unbufferLruAcquire(f, 0);
+    int ret = availableImpl(fs, f);
+
+    unbufferLruRelease(f, acquired);
+    return ret;
+}
+
+/**
+ * Get the java.io.File of a path of a LocalFileSystem, or of the checksum
+ * file that goes with it.
+ */
+static jthrowable localFileOfPath(JNIEnv *env, jobject jFS, jobject jPath,
+                                  int checksum, jobject *out)
+{
+    jthrowable jthr;
+    jvalue jVal;
+
+    if (checksum) {
+        jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_LOCALFS,
+                "getChecksumFile",
+                JMETHOD1(JPARAM(HADOOP_PATH), JPARAM(HADOOP_PATH)), jPath);
+        if (jthr)
+            return jthr;
+        jPath = jVal.l;
+    }
+    jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_LOCALFS,
+            "pathToFile", JMETHOD1(JPARAM(HADOOP_PATH), JPARAM(JAVA_FILE)),
+            jPath);
+    if (jthr)
+        return jthr;
+    *out = jVal.l;
+    return NULL;
+}
+
+static jthrowable localFileTest(JNIEnv *env, jobject jFile,
+                                const char *method, int *result)
+{
+    jthrowable jthr;
+    jvalue jVal;
+
+    jthr = invokeMethod(env, &jVal, INSTANCE, jFile, JAVA_FILE, method,
+                        JMETHOD1("", "Z"));
+    if (jthr)
+        return jthr;
+    *result = jVal.z;
+    return NULL;
+}
+
+/**
+ * Copy a regular file within a LocalFileSystem, and its checksum file if
+ * it has one, with NativeIO#copyFileUnbuffered.  That shares the extents
+ * of the file on filesystems which can reflink, and otherwise copies in
+ * the kernel, rather than streaming the bytes through the JVM as
+ * FileUtil#copy does.
+ *
+ * Sets *copied to 0, having changed nothing, if src is not a regular file,
+ * dst or its checksum file exists already, or the parent of dst does not,
+ * for FileUtil#copy to handle.
+ * On an error the files created so far are deleted again.
+ */
+static jthrowable copyLocalFile(JNIEnv *env, jobject jFS, jobject jSrcPath,
+                                jobject jDstPath, int *copied)
+{
+    jobject jSrc, jDst, jSrcCrc, jDstCrc, jDstParent;
+    jthrowable jthr;
+    jvalue jVal;
+    int isFile, isDir, exists, dstCreated = 0, crcCreated = 0;
+
+    *copied = 0;
+    jthr = pushLocalFrame(env, 8);
+    if (jthr)
+        return jthr;
+    if ((jthr = localFileOfPath(env, jFS, jSrcPath, 0, &jSrc)) ||
+        (jthr = localFileOfPath(env, jFS, jDstPath, 0, &jDst)) ||
+        (jthr = localFileOfPath(env, jFS, jSrcPath, 1, &jSrcCrc)) ||
+        (jthr = localFileOfPath(env, jFS, jDstPath, 1, &jDstCrc)))
+        goto done;
+    if ((jthr = localFileTest(env, jSrc, "isFile", &isFile)))
+        goto done;
+    if (!isFile)
+        goto done;
+    if ((jthr = localFileTest(env, jDst, "exists", &exists)))
+        goto done;
+    if (exists)
+        goto done;
+    if ((jthr = localFileTest(env, jDstCrc, "exists", &exists)))
+        goto done;
+    if (exists)
+        goto done;
+    jthr = invokeMethod(env, &jVal, INSTANCE, jDst, JAVA_FILE, "getParentFile",
+                        JMETHOD1("", JPARAM(JAVA_FILE)));
+    if (jthr)
+        goto done;
+    jDstParent = jVal.l;
+    if (!jDstParent)
+        goto done;
+    if ((jthr = localFileTest(env, jDstParent, "isDirectory", &isDir)))
+        goto done;
+    if (!isDir)
+        goto done;
+
+    dstCreated = 1;
+    jthr = invokeMethod(env, &jVal, STATIC, NULL, HADOOP_NATIVEIO,
+            "copyFileUnbuffered",
+            JMETHOD2(JPARAM(JAVA_FILE), JPARAM(JAVA_FILE), JAVA_VOID),
+            jSrc, jDst);
+    if (jthr)
+        goto done;
+    if ((jthr = localFileTest(env, jSrcCrc, "isFile", &isFile)))
+        goto done;
+    if (isFile) {
+        crcCreated = 1;
+        jthr = invokeMethod(env, &jVal, STATIC, NULL, HADOOP_NATIVEIO,
+                "copyFileUnbuffered",
+                JMETHOD2(JPARAM(JAVA_FILE), JPARAM(JAVA_FILE), JAVA_VOID),
+                jSrcCrc, jDstCrc);
+        if (jthr)
+            goto done;
+    }
+    *copied = 1;
+
+done:
     if (jthr) {
-        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
-            "hdfsAvailable: FSDataInputStream#available");
-        return -1;
+        // Should a delete fail too, its exception goes with the frame
+        if (crcCreated) {
+            localFileTest(env, jDstCrc, "delete", &exists);
+        }
+        if (dstCreated) {
+            localFileTest(env, jDst, "delete", &exists);
+        }
     }
-    return jVal.i;
+    return popLocalFrame(env, jthr);
 }
 
 static int hdfsCopyImpl(hdfsFS srcFS, const char *src, hdfsFS dstFS,
@@ -1763,6 +3838,9 @@ static int hdfsCopyImpl(hdfsFS srcFS, const char *src, hdfsFS dstFS,
     //JAVA EQUIVALENT
     //  FileUtil#copy(srcFS, srcPath, dstFS, dstPath,
     //                 deleteSource = false, conf)
+    //
+    //  Within one filesystem a move is a FileSystem#rename, and a copy of
+    //  a local file is a NativeIO#copyFileUnbuffered, when they succeed.
 
     //Parameters
     jobject jSrcFS = (jobject)srcFS;
@@ -1770,7 +3848,7 @@ static int hdfsCopyImpl(hdfsFS srcFS, const char *src, hdfsFS dstFS,
     jobject jConfiguration = NULL, jSrcPath = NULL, jDstPath = NULL;
     jthrowable jthr;
     jvalue jVal;
-    int ret;
+    int ret, sameFS, copied;
 
     //Get the JNIEnv* corresponding to current thread
     JNIEnv* env = getJNIEnv();
@@ -1792,6 +3870,39 @@ static int hdfsCopyImpl(hdfsFS srcFS, const char *src, hdfsFS dstFS,
         goto done;
     }
 
+    // Only one FileSystem object is known to be one filesystem as one user:
+    // handles with equal URIs may still be connected as different users.
+    sameFS = (*env)->IsSameObject(env, jSrcFS, jDstFS);
+    if (sameFS && deleteSource) {
+        // Nothing is copied at all.  If the rename is refused, FileUtil#copy
+        // reports why, or does what rename cannot, such as creating the
+        // parents of dst.
+        jthr = invokeMethod(env, &jVal, INSTANCE, jSrcFS, HADOOP_FS, "rename",
+                JMETHOD2(JPARAM(HADOOP_PATH), JPARAM(HADOOP_PATH), "Z"),
+                jSrcPath, jDstPath);
+        statCacheInvalidate(srcFS, src, 1);
+        statCacheInvalidate(srcFS, dst, 1);
+        if (jthr) {
+            printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsCopyImpl(src=%s, dst=%s): FileSystem#rename, "
+                "falling back to FileUtil#copy", src, dst);
+        } else if (jVal.z) {
+            ret = 0;
+            goto done;
+        }
+    } else if (sameFS && javaObjectIsOfClass(env, jSrcFS, HADOOP_LOCALFS) == 1) {
+        jthr = copyLocalFile(env, jSrcFS, jSrcPath, jDstPath, &copied);
+        statCacheInvalidate(dstFS, dst, 0);
+        if (jthr) {
+            printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsCopyImpl(src=%s, dst=%s): NativeIO#copyFileUnbuffered, "
+                "falling back to FileUtil#copy", src, dst);
+        } else if (copied) {
+            ret = 0;
+            goto done;
+        }
+    }
+
     //Create the org.apache.hadoop.conf.Configuration object
     jthr = constructNewObjectOfClass(env, &jConfiguration,
                                      HADOOP_CONF, "()V");
@@ -1872,6 +3983,7 @@ int hdfsDelete(hdfsFS fs, const char *path, int recursive)
     jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
                      "delete", "(Lorg/apache/hadoop/fs/Path;Z)Z",
                      jPath, jRecursive);
+    statCacheInvalidate(fs, path, 1);
     destroyLocalReference(env, jPath);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -1926,6 +4038,8 @@ int hdfsRename(hdfsFS fs, const char *oldPath, const char *newPath)
     jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS, "rename",
                      JMETHOD2(JPARAM(HADOOP_PATH), JPARAM(HADOOP_PATH), "Z"),
                      jOldPath, jNewPath);
+    statCacheInvalidate(fs, oldPath, 1);
+    statCacheInvalidate(fs, newPath, 1);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
             "hdfsRename(oldPath=%s, newPath=%s): FileSystem#rename",
@@ -2096,6 +4210,7 @@ int hdfsCreateDirectory(hdfsFS fs, const char *path)
     jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
                      "mkdirs", "(Lorg/apache/hadoop/fs/Path;)Z",
                      jPath);
+    statCacheInvalidate(fs, path, 0);
     destroyLocalReference(env, jPath);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr,
@@ -2146,6 +4261,7 @@ int hdfsSetReplication(hdfsFS fs, const char *path, int16_t replication)
     jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
                      "setReplication", "(Lorg/apache/hadoop/fs/Path;S)Z",
                      jPath, replication);
+    statCacheInvalidate(fs, path, 0);
     destroyLocalReference(env, jPath);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -2210,6 +4326,7 @@ int hdfsChown(hdfsFS fs, const char *path, const char *owner, const char *group)
             "setOwner", JMETHOD3(JPARAM(HADOOP_PATH), 
                     JPARAM(JAVA_STRING), JPARAM(JAVA_STRING), JAVA_VOID),
             jPath, jOwner, jGroup);
+    statCacheInvalidate(fs, path, 0);
     if (jthr) {
         ret = printExceptionAndFree(env, jthr,
             NOPRINT_EXC_ACCESS_CONTROL | NOPRINT_EXC_FILE_NOT_FOUND |
@@ -2272,6 +4389,7 @@ int hdfsChmod(hdfsFS fs, const char *path, short mode)
             "setPermission",
             JMETHOD2(JPARAM(HADOOP_PATH), JPARAM(HADOOP_FSPERM), JAVA_VOID),
             jPath, jPermObj);
+    statCacheInvalidate(fs, path, 0);
     if (jthr) {
         ret = printExceptionAndFree(env, jthr,
             NOPRINT_EXC_ACCESS_CONTROL | NOPRINT_EXC_FILE_NOT_FOUND |
@@ -2324,6 +4442,7 @@ int hdfsUtime(hdfsFS fs, const char *path, tTime mtime, tTime atime)
     jthr = invokeMethod(env, NULL, INSTANCE, jFS, HADOOP_FS,
             "setTimes", JMETHOD3(JPARAM(HADOOP_PATH), "J", "J", JAVA_VOID),
             jPath, jmtime, jatime);
+    statCacheInvalidate(fs, path, 0);
     destroyLocalReference(env, jPath);
     if (jthr) {
         errno = printExceptionAndFree(env, jthr,
@@ -2614,7 +4733,7 @@ done:
     return ret;
 }
 
-struct hadoopRzBuffer* hadoopReadZero(hdfsFile file,
+static struct hadoopRzBuffer* readZeroImpl(hdfsFile file,
             struct hadoopRzOptions *opts, int32_t maxLength)
 {
     JNIEnv *env;
@@ -2634,6 +4753,13 @@ struct hadoopRzBuffer* hadoopReadZero(hdfsFile file,
         ret = EINVAL;
         goto done;
     }
+    ret = readaheadSyncPosition(env, file);
+    if (!ret) {
+        ret = readBufferSyncPosition(env, file);
+    }
+    if (ret) {
+        goto done;
+    }
     buffer = calloc(1, sizeof(struct hadoopRzBuffer));
     if (!buffer) {
         ret = ENOMEM;
@@ -2669,6 +4795,14 @@ struct hadoopRzBuffer* hadoopReadZero(hdfsFile file,
             goto done;
         }
     }
+    if (file->readahead) {
+        file->readahead->pos += buffer->length;
+        file->readahead->streamPos = file->readahead->pos;
+    }
+    if (file->readBuffer) {
+        file->readBuffer->pos += buffer->length;
+        file->readBuffer->start = file->readBuffer->pos;
+    }
     ret = 0;
 done:
     (*env)->DeleteLocalRef(env, byteBuffer);
@@ -2687,6 +4821,20 @@ done:
     return buffer;
 }
 
+struct hadoopRzBuffer* hadoopReadZero(hdfsFile file,
+            struct hadoopRzOptions *opts, int32_t maxLength)
+{
+    int acquired;
+    struct hadoopRzBuffer* ret;
+
+    unbufferLruUnpin(file);
+    acquired = unbufferLruAcquire(file, 0);
+    ret = readZeroImpl(file, opts, maxLength);
+
+    unbufferLruRelease(file, acquired);
+    return ret;
+}
+
 int32_t hadoopRzBufferLength(const struct hadoopRzBuffer *buffer)
 {
     return buffer->length;
@@ -2726,6 +4874,127 @@ void hadoopRzBufferFree(hdfsFile file, struct hadoopRzBuffer *buffer)
     free(buffer);
 }
 
+static int getBlockFdImpl(hdfsFile file, struct hadoopRzOptions *opts,
+        struct hadoopBlockFd *out)
+{
+    // JAVA EQUIVALENT:
+    //  long[] range = new long[2];
+    //  FileDescriptor fd = ((DFSInputStream)in.getWrappedStream()).
+    //      getShortCircuitFileDescriptor(opts, range);
+
+    JNIEnv *env;
+    jthrowable jthr;
+    jvalue jVal;
+    jobject enumSet = NULL, jStream = NULL, jFd = NULL;
+    jlongArray jRange = NULL;
+    jlong range[2];
+    jclass cls;
+    jfieldID fdField;
+    int ret;
+
+    env = getJNIEnv();
+    if (!env) {
+        errno = EINTERNAL;
+        return -1;
+    }
+    if (file->type != HDFS_STREAM_INPUT) {
+        fputs("Cannot read from a non-InputStream object!\n", stderr);
+        ret = EINVAL;
+        goto done;
+    }
+    ret = readaheadSyncPosition(env, file);
+    if (!ret) {
+        ret = readBufferSyncPosition(env, file);
+    }
+    if (ret) {
+        goto done;
+    }
+    jthr = invokeMethod(env, &jVal, INSTANCE, file->file, HADOOP_ISTRM,
+            "getWrappedStream", "()Ljava/io/InputStream;");
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hadoopGetBlockFd: FSDataInputStream#getWrappedStream");
+        goto done;
+    }
+    jStream = jVal.l;
+    ret = javaObjectIsOfClass(env, jStream, HADOOP_DFSISTRM);
+    if (ret < 0) {
+        ret = EINTERNAL;
+        goto done;
+    } else if (ret == 0) {
+        // Encrypted streams are wrapped in a CryptoInputStream.
+        ret = ENOTSUP;
+        goto done;
+    }
+    jthr = hadoopRzOptionsGetEnumSet(env, opts, &enumSet);
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hadoopGetBlockFd: hadoopRzOptionsGetEnumSet failed: ");
+        goto done;
+    }
+    jRange = (*env)->NewLongArray(env, 2);
+    if (!jRange) {
+        ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                "hadoopGetBlockFd: NewLongArray");
+        goto done;
+    }
+    jthr = invokeMethod(env, &jVal, INSTANCE, jStream, HADOOP_DFSISTRM,
+            "getShortCircuitFileDescriptor",
+            "(Ljava/util/EnumSet;[J)Ljava/io/FileDescriptor;",
+            enumSet, jRange);
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hadoopGetBlockFd: DFSInputStream#"
+                "getShortCircuitFileDescriptor");
+        goto done;
+    }
+    jFd = jVal.l;
+    if (!jFd) {
+        ret = ENOTSUP;
+        goto done;
+    }
+    cls = (*env)->GetObjectClass(env, jFd);
+    fdField = (*env)->GetFieldID(env, cls, "fd", "I");
+    (*env)->DeleteLocalRef(env, cls);
+    if (!fdField) {
+        ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                "hadoopGetBlockFd: GetFieldID(FileDescriptor#fd)");
+        goto done;
+    }
+    out->fd = (*env)->GetIntField(env, jFd, fdField);
+    if (out->fd < 0) {
+        // Windows keeps a handle instead of a descriptor.
+        ret = ENOTSUP;
+        goto done;
+    }
+    (*env)->GetLongArrayRegion(env, jRange, 0, 2, range);
+    out->offset = range[0];
+    out->length = range[1];
+    ret = 0;
+done:
+    destroyLocalReference(env, jStream);
+    destroyLocalReference(env, jRange);
+    destroyLocalReference(env, jFd);
+    if (ret) {
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+int hadoopGetBlockFd(hdfsFile file, struct hadoopRzOptions *opts,
+        struct hadoopBlockFd *out)
+{
+    int acquired = unbufferLruAcquire(file, 0);
+    int ret = getBlockFdImpl(file, opts, out);
+
+    if (ret == 0) {
+        acquired = unbufferLruPin(file, acquired);
+    }
+    unbufferLruRelease(file, acquired);
+    return ret;
+}
+
 char***
 hdfsGetHosts(hdfsFS fs, const char *path, tOffset start, tOffset length)
 {
@@ -2737,10 +5006,10 @@ hdfsGetHosts(hdfsFS fs, const char *path, tOffset start, tOffset length)
     jobject jPath = NULL;
     jobject jFileStatus = NULL;
     jvalue jFSVal, jVal;
-    jobjectArray jBlockLocations = NULL, jFileBlockHosts = NULL;
-    jstring jHost = NULL;
+    jobjectArray jBlockLocations = NULL, jFileBlockHosts;
+    jstring jHost;
     char*** blockHosts = NULL;
-    int i, j, ret;
+    int i, j, ret, inFrame = 0;
     jsize jNumFileBlocks = 0;
     jobject jFileBlock;
     jsize jNumBlockHosts;
@@ -2802,6 +5071,15 @@ hdfsGetHosts(hdfsFS fs, const char *path, tOffset start, tOffset length)
 
     //Now parse each block to get hostnames
     for (i = 0; i < jNumFileBlocks; ++i) {
+        // The references made for a block are freed together after it
+        jthr = pushLocalFrame(env, 4);
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetHosts(path=%s, start=%"PRId64", length=%"PRId64"):"
+                "pushLocalFrame", path, start, length);
+            goto done;
+        }
+        inFrame = 1;
         jFileBlock =
             (*env)->GetObjectArrayElement(env, jBlockLocations, i);
         if (!jFileBlock) {
@@ -2848,53 +5126,337 @@ hdfsGetHosts(hdfsFS fs, const char *path, tOffset start, tOffset length)
                 (const char*)((*env)->GetStringUTFChars(env, jHost, NULL));
             if (!hostName) {
                 ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
-                    "hdfsGetHosts(path=%s, start=%"PRId64", length=%"PRId64", "
-                    "j=%d out of %d): GetStringUTFChars",
-                    path, start, length, j, jNumBlockHosts);
+                    "hdfsGetHosts(path=%s, start=%"PRId64", length=%"PRId64", "
+                    "j=%d out of %d): GetStringUTFChars",
+                    path, start, length, j, jNumBlockHosts);
+                goto done;
+            }
+            blockHosts[i][j] = strdup(hostName);
+            (*env)->ReleaseStringUTFChars(env, jHost, hostName);
+            if (!blockHosts[i][j]) {
+                ret = ENOMEM;
+                goto done;
+            }
+            destroyLocalReference(env, jHost);
+        }
+
+        popLocalFrame(env, NULL);
+        inFrame = 0;
+    }
+    ret = 0;
+
+done:
+    if (inFrame) {
+        popLocalFrame(env, NULL);
+    }
+    destroyLocalReference(env, jPath);
+    destroyLocalReference(env, jFileStatus);
+    destroyLocalReference(env, jBlockLocations);
+    if (ret) {
+        if (blockHosts) {
+            hdfsFreeHosts(blockHosts);
+        }
+        return NULL;
+    }
+
+    return blockHosts;
+}
+
+
+void hdfsFreeHosts(char ***blockHosts)
+{
+    int i, j;
+    for (i=0; blockHosts[i]; i++) {
+        for (j=0; blockHosts[i][j]; j++) {
+            free(blockHosts[i][j]);
+        }
+        free(blockHosts[i]);
+    }
+    free(blockHosts);
+}
+
+/**
+ * Find the index of a host in the host table of block locations, adding the
+ * host if it is new.
+ *
+ * @return 0 on success, or an errno value.
+ */
+static int blockLocationsInternHost(struct hdfsBlockLocations *locs,
+        struct htable *hostIndex, int *maxHosts, const char *host,
+        int32_t *index)
+{
+    char **hosts;
+    void *val;
+    int ret;
+
+    val = htable_get(hostIndex, host);
+    if (val) {
+        // Indices are stored plus one, since the table can't hold NULL
+        *index = (int32_t)((uintptr_t)val - 1);
+        return 0;
+    }
+    if (locs->numHosts == *maxHosts) {
+        hosts = realloc(locs->hosts, sizeof(char *) * (*maxHosts * 2 + 8));
+        if (!hosts) {
+            return ENOMEM;
+        }
+        locs->hosts = hosts;
+        *maxHosts = *maxHosts * 2 + 8;
+    }
+    locs->hosts[locs->numHosts] = strdup(host);
+    if (!locs->hosts[locs->numHosts]) {
+        return ENOMEM;
+    }
+    ret = htable_put(hostIndex, locs->hosts[locs->numHosts],
+                     (void *)(uintptr_t)(locs->numHosts + 1));
+    if (ret) {
+        free(locs->hosts[locs->numHosts]);
+        return ret;
+    }
+    *index = locs->numHosts++;
+    return 0;
+}
+
+static enum hdfsStorageType blockLocationsStorageType(JNIEnv *env,
+        jobjectArray jStorageTypes, jsize numStorageTypes, jsize replica)
+{
+    jobject jStorageType;
+    jthrowable jthr;
+    jvalue jVal;
+
+    // Only HDFS reports storage types
+    if (replica >= numStorageTypes) {
+        return HDFS_STORAGE_UNKNOWN;
+    }
+    jStorageType = (*env)->GetObjectArrayElement(env, jStorageTypes, replica);
+    if (!jStorageType) {
+        printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "hdfsGetBlockLocations: GetObjectArrayElement(%d)", replica);
+        return HDFS_STORAGE_UNKNOWN;
+    }
+    jthr = invokeMethod(env, &jVal, INSTANCE, jStorageType, "java/lang/Enum",
+                        "ordinal", "()I");
+    destroyLocalReference(env, jStorageType);
+    if (jthr) {
+        printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsGetBlockLocations: StorageType#ordinal");
+        return HDFS_STORAGE_UNKNOWN;
+    }
+    if (jVal.i < HDFS_STORAGE_RAM_DISK || jVal.i > HDFS_STORAGE_ARCHIVE) {
+        return HDFS_STORAGE_UNKNOWN;
+    }
+    return (enum hdfsStorageType)jVal.i;
+}
+
+struct hdfsBlockLocations *hdfsGetBlockLocations(hdfsFS fs,
+        const char *path, tOffset start, tOffset length)
+{
+    // JAVA EQUIVALENT:
+    //  fs.getFileBlockLocations(new Path(path), start, length);
+
+    jobject jFS = (jobject)fs;
+    jthrowable jthr;
+    jobject jPath = NULL;
+    jvalue jVal;
+    jobjectArray jBlockLocations = NULL, jHosts, jStorageTypes;
+    jobject jBlock;
+    jstring jHost;
+    jsize numHosts, numStorageTypes;
+    const char *hostName;
+    struct hdfsBlockLocations *locs = NULL;
+    struct hdfsBlockLocation *blk;
+    struct htable *hostIndex = NULL;
+    int32_t *hostIndices;
+    enum hdfsStorageType *storageTypes;
+    int i, j, ret, inFrame = 0, maxHosts = 0, maxReplicas = 0;
+
+    JNIEnv *env = getJNIEnv();
+    if (env == NULL) {
+        errno = EINTERNAL;
+        return NULL;
+    }
+
+    jthr = constructNewObjectOfPath(env, path, &jPath);
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsGetBlockLocations(path=%s): constructNewObjectOfPath", path);
+        goto done;
+    }
+    // The Path overload lets DistributedFileSystem answer in one RPC,
+    // without a getFileStatus first
+    jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
+                     "getFileBlockLocations",
+                     JMETHOD2(JPARAM(HADOOP_PATH), "JJ",
+                              JARRPARAM(HADOOP_BLK_LOC)),
+                     jPath, start, length);
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, NOPRINT_EXC_FILE_NOT_FOUND,
+            "hdfsGetBlockLocations(path=%s, start=%"PRId64", "
+            "length=%"PRId64"): FileSystem#getFileBlockLocations",
+            path, start, length);
+        goto done;
+    }
+    jBlockLocations = jVal.l;
+
+    locs = calloc(1, sizeof(*locs));
+    hostIndex = htable_alloc(16, ht_hash_string, ht_compare_string);
+    if (!locs || !hostIndex) {
+        ret = ENOMEM;
+        goto done;
+    }
+    locs->numBlocks = (*env)->GetArrayLength(env, jBlockLocations);
+    locs->blocks = calloc(locs->numBlocks + 1, sizeof(*locs->blocks));
+    if (!locs->blocks) {
+        ret = ENOMEM;
+        goto done;
+    }
+    for (i = 0; i < locs->numBlocks; i++) {
+        // The references made for a block are freed together after it
+        jthr = pushLocalFrame(env, 8);
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetBlockLocations(path=%s): pushLocalFrame", path);
+            goto done;
+        }
+        inFrame = 1;
+        blk = &locs->blocks[i];
+        jBlock = (*env)->GetObjectArrayElement(env, jBlockLocations, i);
+        if (!jBlock) {
+            ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                "hdfsGetBlockLocations(path=%s): GetObjectArrayElement(%d)",
+                path, i);
+            goto done;
+        }
+        jthr = invokeMethod(env, &jVal, INSTANCE, jBlock, HADOOP_BLK_LOC,
+                            "getOffset", "()J");
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetBlockLocations(path=%s): BlockLocation#getOffset",
+                path);
+            goto done;
+        }
+        blk->offset = jVal.j;
+        jthr = invokeMethod(env, &jVal, INSTANCE, jBlock, HADOOP_BLK_LOC,
+                            "getLength", "()J");
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetBlockLocations(path=%s): BlockLocation#getLength",
+                path);
+            goto done;
+        }
+        blk->length = jVal.j;
+        jthr = invokeMethod(env, &jVal, INSTANCE, jBlock, HADOOP_BLK_LOC,
+                            "getHosts", "()[Ljava/lang/String;");
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetBlockLocations(path=%s): BlockLocation#getHosts",
+                path);
+            goto done;
+        }
+        jHosts = jVal.l;
+        jthr = invokeMethod(env, &jVal, INSTANCE, jBlock, HADOOP_BLK_LOC,
+                            "getStorageTypes",
+                            "()[Lorg/apache/hadoop/fs/StorageType;");
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetBlockLocations(path=%s): "
+                "BlockLocation#getStorageTypes", path);
+            goto done;
+        }
+        jStorageTypes = jVal.l;
+        numHosts = jHosts ? (*env)->GetArrayLength(env, jHosts) : 0;
+        numStorageTypes = jStorageTypes ?
+            (*env)->GetArrayLength(env, jStorageTypes) : 0;
+
+        if (locs->numReplicas + numHosts > maxReplicas) {
+            maxReplicas = (locs->numReplicas + numHosts) * 2;
+            hostIndices = realloc(locs->hostIndices,
+                                  sizeof(int32_t) * maxReplicas);
+            if (hostIndices) {
+                locs->hostIndices = hostIndices;
+            }
+            storageTypes = realloc(locs->storageTypes,
+                                   sizeof(enum hdfsStorageType) * maxReplicas);
+            if (storageTypes) {
+                locs->storageTypes = storageTypes;
+            }
+            if (!hostIndices || !storageTypes) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+        for (j = 0; j < numHosts; j++) {
+            jHost = (*env)->GetObjectArrayElement(env, jHosts, j);
+            if (!jHost) {
+                ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                    "hdfsGetBlockLocations(path=%s): "
+                    "GetObjectArrayElement(%d, %d)", path, i, j);
+                goto done;
+            }
+            hostName = (*env)->GetStringUTFChars(env, jHost, NULL);
+            if (!hostName) {
+                ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+                    "hdfsGetBlockLocations(path=%s): GetStringUTFChars",
+                    path);
                 goto done;
             }
-            blockHosts[i][j] = strdup(hostName);
+            ret = blockLocationsInternHost(locs, hostIndex, &maxHosts,
+                    hostName, &locs->hostIndices[locs->numReplicas]);
             (*env)->ReleaseStringUTFChars(env, jHost, hostName);
-            if (!blockHosts[i][j]) {
-                ret = ENOMEM;
+            destroyLocalReference(env, jHost);
+            if (ret) {
                 goto done;
             }
-            destroyLocalReference(env, jHost);
-            jHost = NULL;
+            locs->storageTypes[locs->numReplicas] =
+                blockLocationsStorageType(env, jStorageTypes,
+                                          numStorageTypes, j);
+            locs->numReplicas++;
         }
+        blk->numReplicas = numHosts;
+        popLocalFrame(env, NULL);
+        inFrame = 0;
+    }
 
-        destroyLocalReference(env, jFileBlockHosts);
-        jFileBlockHosts = NULL;
+    // Point the blocks at their replicas now that the arrays won't move
+    for (i = 0, j = 0; i < locs->numBlocks; j += locs->blocks[i].numReplicas,
+            i++) {
+        locs->blocks[i].hostIndices = locs->hostIndices + j;
+        locs->blocks[i].storageTypes = locs->storageTypes + j;
     }
     ret = 0;
 
 done:
+    if (inFrame) {
+        popLocalFrame(env, NULL);
+    }
     destroyLocalReference(env, jPath);
-    destroyLocalReference(env, jFileStatus);
     destroyLocalReference(env, jBlockLocations);
-    destroyLocalReference(env, jFileBlockHosts);
-    destroyLocalReference(env, jHost);
+    if (hostIndex) {
+        // The keys are owned by locs->hosts
+        htable_free(hostIndex);
+    }
     if (ret) {
-        if (blockHosts) {
-            hdfsFreeHosts(blockHosts);
+        if (locs) {
+            hdfsFreeBlockLocations(locs);
         }
+        errno = ret;
         return NULL;
     }
-
-    return blockHosts;
+    return locs;
 }
 
-
-void hdfsFreeHosts(char ***blockHosts)
+void hdfsFreeBlockLocations(struct hdfsBlockLocations *locs)
 {
-    int i, j;
-    for (i=0; blockHosts[i]; i++) {
-        for (j=0; blockHosts[i][j]; j++) {
-            free(blockHosts[i][j]);
-        }
-        free(blockHosts[i]);
+    int i;
+
+    for (i = 0; i < locs->numHosts; i++) {
+        free(locs->hosts[i]);
     }
-    free(blockHosts);
+    free(locs->hosts);
+    free(locs->blocks);
+    free(locs->hostIndices);
+    free(locs->storageTypes);
+    free(locs);
 }
 
 
@@ -2995,137 +5557,664 @@ tOffset hdfsGetCapacity(hdfsFS fs)
             "hdfsGetCapacity: FsStatus#getCapacity");
         return -1;
     }
-    return jVal.j;
+    return jVal.j;
+}
+
+
+  
+tOffset hdfsGetUsed(hdfsFS fs)
+{
+    // JAVA EQUIVALENT:
+    //  FsStatus fss = fs.getStatus();
+    //  return Fss.getUsed();
+
+    jobject jFS = (jobject)fs;
+    jvalue  jVal;
+    jthrowable jthr;
+    jobject fss;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return -1;
+    }
+
+    //FileSystem#getStatus
+    jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
+                     "getStatus", "()Lorg/apache/hadoop/fs/FsStatus;");
+    if (jthr) {
+        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsGetUsed: FileSystem#getStatus");
+        return -1;
+    }
+    fss = (jobject)jVal.l;
+    jthr = invokeMethod(env, &jVal, INSTANCE, fss, HADOOP_FSSTATUS,
+                     "getUsed", "()J");
+    destroyLocalReference(env, fss);
+    if (jthr) {
+        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsGetUsed: FsStatus#getUsed");
+        return -1;
+    }
+    return jVal.j;
+}
+ 
+/**
+ * We cannot add new fields to the hdfsFileInfo structure because it would break
+ * binary compatibility.  The reason is because we return an array
+ * of hdfsFileInfo structures from hdfsListDirectory.  So changing the size of
+ * those structures would break all programs that relied on finding the second
+ * element in the array at <base_offset> + sizeof(struct hdfsFileInfo).
+ *
+ * So instead, we add the new fields to the hdfsExtendedFileInfo structure.
+ * This structure is contained in the mOwner string found inside the
+ * hdfsFileInfo.  Specifically, the format of mOwner is:
+ *
+ * [owner-string] [null byte] [padding] [hdfsExtendedFileInfo structure]
+ *
+ * The padding is added so that the hdfsExtendedFileInfo structure starts on an
+ * 8-byte boundary.
+ *
+ * @param str           The string to locate the extended info in.
+ * @return              The offset of the hdfsExtendedFileInfo structure.
+ */
+static size_t getExtendedFileInfoOffset(const char *str)
+{
+    int num_64_bit_words = ((strlen(str) + 1) + 7) / 8;
+    return num_64_bit_words * 8;
+}
+
+static struct hdfsExtendedFileInfo *getExtendedFileInfo(hdfsFileInfo *fileInfo)
+{
+    char *owner = fileInfo->mOwner;
+    return (struct hdfsExtendedFileInfo *)(owner +
+                getExtendedFileInfoOffset(owner));
+}
+
+/**
+ * Every hdfsFileInfo array libhdfs hands out sits right after a header that
+ * owns the strings of all its entries.  They are carved out of a few chunks
+ * instead of being allocated one by one, so a listing of a million entries
+ * takes a few dozen mallocs for its strings rather than three million, and
+ * hdfsFreeFileInfo frees them all at once.  The layout of the array itself
+ * is unchanged.
+ */
+struct fileInfoChunk {
+    struct fileInfoChunk *next;
+    size_t size;
+    char data[];
+};
+
+struct fileInfoArena {
+    struct fileInfoChunk *chunks;       /* the newest first */
+    size_t used;                        /* bytes used in the newest chunk */
+};
+
+/* The header keeps the array after it aligned as malloc would. */
+#define FILE_INFO_HEADER_SIZE \
+    ((sizeof(struct fileInfoArena) + 15) & ~(size_t)15)
+
+#define FILE_INFO_CHUNK_MIN 256
+#define FILE_INFO_CHUNK_MAX (64 * 1024)
+
+static hdfsFileInfo *fileInfoArrayAlloc(int numEntries)
+{
+    char *block = calloc(1, FILE_INFO_HEADER_SIZE +
+                         (size_t)numEntries * sizeof(hdfsFileInfo));
+    return block ? (hdfsFileInfo *)(block + FILE_INFO_HEADER_SIZE) : NULL;
+}
+
+static struct fileInfoArena *fileInfoArenaOf(hdfsFileInfo *infos)
+{
+    return (struct fileInfoArena *)((char *)infos - FILE_INFO_HEADER_SIZE);
+}
+
+/**
+ * Shrink an array to its first numEntries entries.
+ *
+ * @return      The array, which may have moved; NULL if it could not be
+ *              shrunk, in which case it is left as it was
+ */
+static hdfsFileInfo *fileInfoArrayShrink(hdfsFileInfo *infos, int numEntries)
+{
+    char *block = realloc(fileInfoArenaOf(infos), FILE_INFO_HEADER_SIZE +
+                          (size_t)numEntries * sizeof(hdfsFileInfo));
+    return block ? (hdfsFileInfo *)(block + FILE_INFO_HEADER_SIZE) : NULL;
+}
+
+/**
+ * Allocate size bytes, 8 byte aligned, for the strings of an array.
+ *
+ * @param infos The array, as returned by fileInfoArrayAlloc
+ * @return      The bytes; NULL on OOM
+ */
+static char *fileInfoAlloc(hdfsFileInfo *infos, size_t size)
+{
+    struct fileInfoArena *arena = fileInfoArenaOf(infos);
+    struct fileInfoChunk *chunk = arena->chunks;
+    size_t chunkSize;
+    char *p;
+
+    size = (size + 7) & ~(size_t)7;
+    if (!chunk || chunk->size - arena->used < size) {
+        // Chunks grow with the array, so that a single entry takes little
+        chunkSize = chunk ? chunk->size * 2 : FILE_INFO_CHUNK_MIN;
+        if (chunkSize > FILE_INFO_CHUNK_MAX) {
+            chunkSize = FILE_INFO_CHUNK_MAX;
+        }
+        if (chunkSize < size) {
+            chunkSize = size;
+        }
+        chunk = malloc(sizeof(struct fileInfoChunk) + chunkSize);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->size = chunkSize;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->used = 0;
+    }
+    p = chunk->data + arena->used;
+    arena->used += size;
+    return p;
+}
+
+static char *fileInfoStrdup(hdfsFileInfo *infos, const char *str)
+{
+    size_t length = strlen(str) + 1;
+    char *copy = fileInfoAlloc(infos, length);
+
+    if (copy) {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+/**
+ * Allocate the owner of an entry, followed by its hdfsExtendedFileInfo
+ * cleared.
+ */
+static char *fileInfoAllocOwner(hdfsFileInfo *infos, const char *owner)
+{
+    size_t extOffset = getExtendedFileInfoOffset(owner);
+    char *copy = fileInfoAlloc(infos,
+                               extOffset + sizeof(struct hdfsExtendedFileInfo));
+
+    if (copy) {
+        strcpy(copy, owner);
+        memset(copy + extOffset, 0, sizeof(struct hdfsExtendedFileInfo));
+    }
+    return copy;
+}
+
+/**
+ * A cached result of hdfsGetPathInfo or hdfsExists.
+ */
+struct statCacheEntry {
+    time_t loaded;
+    hdfsFileInfo *info;         /* NULL when the path does not exist */
+};
+
+/**
+ * The file status cache of one hdfsFS, all of them are protected by
+ * hdfsStatCacheMutex.
+ */
+struct statCache {
+    struct statCache *next;
+    hdfsFS fs;
+    time_t ttl;
+    uint32_t maxEntries;
+    struct htable *entries;     /* path -> struct statCacheEntry */
+};
+
+static struct statCache *statCaches;
+
+static struct statCache *statCacheFind(hdfsFS fs)
+{
+    struct statCache *cache;
+
+    for (cache = statCaches; cache; cache = cache->next) {
+        if (cache->fs == fs) {
+            return cache;
+        }
+    }
+    return NULL;
+}
+
+static void statCacheFreeEntry(char *path, struct statCacheEntry *entry)
+{
+    if (entry->info) {
+        hdfsFreeFileInfo(entry->info, 1);
+    }
+    free(entry);
+    free(path);
+}
+
+/**
+ * Copy an entry into a new array of one.
+ *
+ * @return      The copy; NULL on OOM
+ */
+static hdfsFileInfo *copyFileInfo(const hdfsFileInfo *src)
+{
+    hdfsFileInfo *dst;
+    size_t ownerLength;
+
+    dst = fileInfoArrayAlloc(1);
+    if (!dst) {
+        return NULL;
+    }
+    *dst = *src;
+    dst->mName = fileInfoStrdup(dst, src->mName);
+    ownerLength = getExtendedFileInfoOffset(src->mOwner) +
+        sizeof(struct hdfsExtendedFileInfo);
+    dst->mOwner = fileInfoAlloc(dst, ownerLength);
+    if (dst->mOwner) {
+        memcpy(dst->mOwner, src->mOwner, ownerLength);
+    }
+    dst->mGroup = fileInfoStrdup(dst, src->mGroup);
+    if (!dst->mName || !dst->mOwner || !dst->mGroup) {
+        hdfsFreeFileInfo(dst, 1);
+        return NULL;
+    }
+    return dst;
+}
+
+static void statCacheRegister(hdfsFS fs, const struct hdfsBuilder *bld)
+{
+    const struct hdfsBuilderConfOpt *opt;
+    struct statCache *cache;
+    long ttl = 0;
+    long maxEntries = HDFS_STAT_CACHE_DEFAULT_SIZE;
+
+    for (opt = bld->opts; opt; opt = opt->next) {
+        if (!opt->val) {
+            continue;
+        }
+        if (!strcmp(opt->key, HDFS_STAT_CACHE_TTL_KEY)) {
+            ttl = atol(opt->val);
+        } else if (!strcmp(opt->key, HDFS_STAT_CACHE_SIZE_KEY)) {
+            maxEntries = atol(opt->val);
+        }
+    }
+    if (ttl <= 0 || maxEntries <= 0) {
+        return;
+    }
+    cache = calloc(1, sizeof(struct statCache));
+    if (!cache) {
+        return;
+    }
+    cache->fs = fs;
+    cache->ttl = (time_t)ttl;
+    cache->maxEntries = (uint32_t)maxEntries;
+    cache->entries = htable_alloc(16, ht_hash_string, ht_compare_string);
+    if (!cache->entries) {
+        free(cache);
+        return;
+    }
+    mutexLock(&hdfsStatCacheMutex);
+    cache->next = statCaches;
+    statCaches = cache;
+    mutexUnlock(&hdfsStatCacheMutex);
+}
+
+struct statCacheVisit {
+    const char *prefix;         /* NULL collects every key */
+    size_t prefixLength;
+    time_t expiredBefore;       /* 0 collects regardless of age */
+    char **keys;
+    uint32_t numKeys;
+};
+
+static void statCacheCollect(void *ctx, void *key, void *val)
+{
+    struct statCacheVisit *visit = ctx;
+    const char *path = key;
+    const struct statCacheEntry *entry = val;
+
+    if (visit->prefix) {
+        if (strncmp(path, visit->prefix, visit->prefixLength) ||
+                path[visit->prefixLength] != '/') {
+            return;
+        }
+    }
+    if (visit->expiredBefore && entry->loaded >= visit->expiredBefore) {
+        return;
+    }
+    visit->keys[visit->numKeys++] = key;
+}
+
+/**
+ * Remove the entries the visit selects, called with hdfsStatCacheMutex
+ * held.
+ *
+ * @return The number of entries removed.
+ */
+static uint32_t statCacheRemove(struct statCache *cache,
+                                struct statCacheVisit *visit)
+{
+    void *key, *val;
+    uint32_t i;
+
+    visit->numKeys = 0;
+    visit->keys = malloc(sizeof(char *) * (htable_used(cache->entries) + 1));
+    if (!visit->keys) {
+        return 0;
+    }
+    htable_visit(cache->entries, statCacheCollect, visit);
+    for (i = 0; i < visit->numKeys; i++) {
+        htable_pop(cache->entries, visit->keys[i], &key, &val);
+        statCacheFreeEntry(key, val);
+    }
+    free(visit->keys);
+    return visit->numKeys;
+}
+
+static void statCacheUnregister(hdfsFS fs)
+{
+    struct statCache **link;
+    struct statCache *cache = NULL;
+    struct statCacheVisit visit;
+
+    mutexLock(&hdfsStatCacheMutex);
+    for (link = &statCaches; *link; link = &(*link)->next) {
+        if ((*link)->fs == fs) {
+            cache = *link;
+            *link = cache->next;
+            break;
+        }
+    }
+    if (cache) {
+        memset(&visit, 0, sizeof(visit));
+        statCacheRemove(cache, &visit);
+        htable_free(cache->entries);
+        free(cache);
+    }
+    mutexUnlock(&hdfsStatCacheMutex);
+}
+
+/**
+ * Look a path up in the file status cache of fs.
+ *
+ * @param info  (out param) a copy of the cached hdfsFileInfo, NULL if the
+ *              path is cached as not existing
+ * @return      1 on a hit; 0 otherwise
+ */
+static int statCacheLookup(hdfsFS fs, const char *path, hdfsFileInfo **info)
+{
+    struct statCache *cache;
+    struct statCacheEntry *entry;
+    time_t now;
+    int hit = 0;
+
+    mutexLock(&hdfsStatCacheMutex);
+    cache = statCacheFind(fs);
+    if (!cache) {
+        goto done;
+    }
+    entry = htable_get(cache->entries, path);
+    if (!entry) {
+        goto done;
+    }
+    now = time(NULL);
+    // a clock stepping backwards expires the entry as well
+    if (now < entry->loaded || now - entry->loaded >= cache->ttl) {
+        goto done;
+    }
+    *info = NULL;
+    if (entry->info) {
+        *info = copyFileInfo(entry->info);
+        if (!*info) {
+            goto done;
+        }
+    }
+    hit = 1;
+done:
+    mutexUnlock(&hdfsStatCacheMutex);
+    return hit;
+}
+
+/**
+ * Add an entry to a cache, called with hdfsStatCacheMutex held.
+ *
+ * @param evict Whether a full cache makes room for the entry
+ */
+static void statCachePut(struct statCache *cache, const char *path,
+                         const hdfsFileInfo *info, int evict)
+{
+    struct statCacheEntry *entry = NULL;
+    struct statCacheVisit visit;
+    char *key = NULL;
+    void *oldKey, *oldVal;
+
+    htable_pop(cache->entries, path, &oldKey, &oldVal);
+    if (oldKey) {
+        statCacheFreeEntry(oldKey, oldVal);
+    }
+    if (htable_used(cache->entries) >= cache->maxEntries) {
+        if (!evict) {
+            goto done;
+        }
+        memset(&visit, 0, sizeof(visit));
+        visit.expiredBefore = time(NULL) - cache->ttl + 1;
+        if (!statCacheRemove(cache, &visit)) {
+            visit.expiredBefore = 0;
+            statCacheRemove(cache, &visit);
+        }
+    }
+    key = strdup(path);
+    entry = calloc(1, sizeof(struct statCacheEntry));
+    if (!key || !entry) {
+        goto done;
+    }
+    entry->loaded = time(NULL);
+    if (info) {
+        entry->info = copyFileInfo(info);
+        if (!entry->info) {
+            goto done;
+        }
+    }
+    if (htable_put(cache->entries, key, entry)) {
+        goto done;
+    }
+    key = NULL;
+    entry = NULL;
+done:
+    if (entry) {
+        if (entry->info) {
+            hdfsFreeFileInfo(entry->info, 1);
+        }
+        free(entry);
+    }
+    free(key);
+}
+
+/**
+ * Cache the status of a path, info NULL caches it as not existing. A full
+ * cache first drops its expired entries and, when none are, everything.
+ */
+static void statCacheStore(hdfsFS fs, const char *path,
+                           const hdfsFileInfo *info)
+{
+    struct statCache *cache;
+
+    mutexLock(&hdfsStatCacheMutex);
+    cache = statCacheFind(fs);
+    if (cache) {
+        statCachePut(cache, path, info, 1);
+    }
+    mutexUnlock(&hdfsStatCacheMutex);
 }
 
-
-  
-tOffset hdfsGetUsed(hdfsFS fs)
+/**
+ * Cache the entries hdfsListDirectory returned for dir, so that the stat
+ * calls that usually follow a listing don't go to the NameNode. A listing only
+ * fills the room left in the cache rather than pushing other entries out.
+ */
+static void statCacheStoreListing(hdfsFS fs, const char *dir,
+                                  const hdfsFileInfo *infos, int numEntries)
 {
-    // JAVA EQUIVALENT:
-    //  FsStatus fss = fs.getStatus();
-    //  return Fss.getUsed();
-
-    jobject jFS = (jobject)fs;
-    jvalue  jVal;
-    jthrowable jthr;
-    jobject fss;
+    struct statCache *cache;
+    const char *name;
+    char *path = NULL;
+    size_t dirLength, nameLength, pathSize = 0;
+    int i;
 
-    //Get the JNIEnv* corresponding to current thread
-    JNIEnv* env = getJNIEnv();
-    if (env == NULL) {
-      errno = EINTERNAL;
-      return -1;
+    mutexLock(&hdfsStatCacheMutex);
+    cache = statCacheFind(fs);
+    if (!cache) {
+        goto done;
     }
-
-    //FileSystem#getStatus
-    jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
-                     "getStatus", "()Lorg/apache/hadoop/fs/FsStatus;");
-    if (jthr) {
-        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
-            "hdfsGetUsed: FileSystem#getStatus");
-        return -1;
+    dirLength = strlen(dir);
+    if (dirLength > 0 && dir[dirLength - 1] == '/') {
+        dirLength--;
     }
-    fss = (jobject)jVal.l;
-    jthr = invokeMethod(env, &jVal, INSTANCE, fss, HADOOP_FSSTATUS,
-                     "getUsed", "()J");
-    destroyLocalReference(env, fss);
-    if (jthr) {
-        errno = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
-            "hdfsGetUsed: FsStatus#getUsed");
-        return -1;
+    for (i = 0; i < numEntries; i++) {
+        if (htable_used(cache->entries) >= cache->maxEntries) {
+            break;
+        }
+        // mName is a fully qualified URI, the key is the path as the
+        // caller spells it
+        name = strrchr(infos[i].mName, '/');
+        name = name ? name + 1 : infos[i].mName;
+        nameLength = strlen(name);
+        if (dirLength + nameLength + 2 > pathSize) {
+            free(path);
+            pathSize = dirLength + nameLength + 2;
+            path = malloc(pathSize);
+            if (!path) {
+                goto done;
+            }
+        }
+        memcpy(path, dir, dirLength);
+        path[dirLength] = '/';
+        memcpy(path + dirLength + 1, name, nameLength + 1);
+        statCachePut(cache, path, &infos[i], 0);
     }
-    return jVal.j;
+done:
+    mutexUnlock(&hdfsStatCacheMutex);
+    free(path);
 }
- 
+
 /**
- * We cannot add new fields to the hdfsFileInfo structure because it would break
- * binary compatibility.  The reason is because we return an array
- * of hdfsFileInfo structures from hdfsListDirectory.  So changing the size of
- * those structures would break all programs that relied on finding the second
- * element in the array at <base_offset> + sizeof(struct hdfsFileInfo).
- *
- * So instead, we add the new fields to the hdfsExtendedFileInfo structure.
- * This structure is contained in the mOwner string found inside the
- * hdfsFileInfo.  Specifically, the format of mOwner is:
- *
- * [owner-string] [null byte] [padding] [hdfsExtendedFileInfo structure]
- *
- * The padding is added so that the hdfsExtendedFileInfo structure starts on an
- * 8-byte boundary.
- *
- * @param str           The string to locate the extended info in.
- * @return              The offset of the hdfsExtendedFileInfo structure.
+ * Drop the cached status of a path after this client changed it, along with
+ * its ancestors, whose times or existence may have changed too, and with
+ * descendants set, everything below it. Paths are matched as given, so a
+ * change made through another spelling of the path is only seen after the
+ * TTL.
  */
-static size_t getExtendedFileInfoOffset(const char *str)
-{
-    int num_64_bit_words = ((strlen(str) + 1) + 7) / 8;
-    return num_64_bit_words * 8;
-}
-
-static struct hdfsExtendedFileInfo *getExtendedFileInfo(hdfsFileInfo *fileInfo)
+static void statCacheInvalidate(hdfsFS fs, const char *path, int descendants)
 {
-    char *owner = fileInfo->mOwner;
-    return (struct hdfsExtendedFileInfo *)(owner +
-                getExtendedFileInfoOffset(owner));
+    struct statCache *cache;
+    struct statCacheVisit visit;
+    char *ancestor;
+    char *slash;
+    void *key, *val;
+
+    mutexLock(&hdfsStatCacheMutex);
+    cache = statCacheFind(fs);
+    if (!cache || !path) {
+        goto done;
+    }
+    if (descendants) {
+        memset(&visit, 0, sizeof(visit));
+        visit.prefix = path;
+        visit.prefixLength = strlen(path);
+        // "/" is the prefix of everything, and of no "//x" key
+        if (visit.prefixLength > 0 && path[visit.prefixLength - 1] == '/') {
+            visit.prefixLength--;
+        }
+        statCacheRemove(cache, &visit);
+    }
+    ancestor = strdup(path);
+    if (!ancestor) {
+        goto done;
+    }
+    for (;;) {
+        htable_pop(cache->entries, ancestor, &key, &val);
+        if (key) {
+            statCacheFreeEntry(key, val);
+        }
+        slash = strrchr(ancestor, '/');
+        if (!slash) {
+            break;
+        }
+        if (slash == ancestor) {
+            if (ancestor[1] == '\0') {
+                break;
+            }
+            ancestor[1] = '\0';
+        } else {
+            *slash = '\0';
+        }
+    }
+    free(ancestor);
+done:
+    mutexUnlock(&hdfsStatCacheMutex);
 }
 
+/**
+ * Fill in an entry of an array from a FileStatus, with its strings in the
+ * arena of the array.
+ */
 static jthrowable
-getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *fileInfo)
+getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *infos,
+                    int entry)
 {
+    hdfsFileInfo *fileInfo = &infos[entry];
     jvalue jVal;
     jthrowable jthr;
-    jobject jPath = NULL;
-    jstring jPathName = NULL;
-    jstring jUserName = NULL;
-    jstring jGroupName = NULL;
-    jobject jPermission = NULL;
+    jobject jPath;
+    jstring jPathName;
+    jstring jUserName;
+    jstring jGroupName;
+    jobject jPermission;
     const char *cPathName;
     const char *cUserName;
     const char *cGroupName;
     struct hdfsExtendedFileInfo *extInfo;
-    size_t extOffset;
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                     HADOOP_STAT, "isDir", "()Z");
+    // Listings call this for every entry, so free the references it makes
+    // together
+    jthr = pushLocalFrame(env, 8);
+    if (jthr)
+        return jthr;
+
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_IS_DIR);
     if (jthr)
         goto done;
     fileInfo->mKind = jVal.z ? kObjectKindDirectory : kObjectKindFile;
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                     HADOOP_STAT, "getReplication", "()S");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_REPLICATION);
     if (jthr)
         goto done;
     fileInfo->mReplication = jVal.s;
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                     HADOOP_STAT, "getBlockSize", "()J");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_BLOCK_SIZE);
     if (jthr)
         goto done;
     fileInfo->mBlockSize = jVal.j;
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                     HADOOP_STAT, "getModificationTime", "()J");
+    jthr = invokeCachedMethod(env, &jVal, jStat,
+                     JM_STAT_GET_MODIFICATION_TIME);
     if (jthr)
         goto done;
     fileInfo->mLastMod = jVal.j / 1000;
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                     HADOOP_STAT, "getAccessTime", "()J");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_ACCESS_TIME);
     if (jthr)
         goto done;
     fileInfo->mLastAccess = (tTime) (jVal.j / 1000);
 
     if (fileInfo->mKind == kObjectKindFile) {
-        jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                         HADOOP_STAT, "getLen", "()J");
+        jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_LEN);
         if (jthr)
             goto done;
         fileInfo->mSize = jVal.j;
     }
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat, HADOOP_STAT,
-                     "getPath", "()Lorg/apache/hadoop/fs/Path;");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_PATH);
     if (jthr)
         goto done;
     jPath = jVal.l;
@@ -3135,8 +6224,7 @@ getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *fileInfo)
         goto done;
     }
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jPath, HADOOP_PATH,
-                     "toString", "()Ljava/lang/String;");
+    jthr = invokeCachedMethod(env, &jVal, jPath, JM_PATH_TO_STRING);
     if (jthr)
         goto done;
     jPathName = jVal.l;
@@ -3146,10 +6234,13 @@ getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *fileInfo)
         jthr = getPendingExceptionAndClear(env);
         goto done;
     }
-    fileInfo->mName = strdup(cPathName);
+    fileInfo->mName = fileInfoStrdup(infos, cPathName);
     (*env)->ReleaseStringUTFChars(env, jPathName, cPathName);
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat, HADOOP_STAT,
-                    "getOwner", "()Ljava/lang/String;");
+    if (!fileInfo->mName) {
+        jthr = newRuntimeError(env, "getFileInfo: OOM allocating mName");
+        goto done;
+    }
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_OWNER);
     if (jthr)
         goto done;
     jUserName = jVal.l;
@@ -3159,26 +6250,21 @@ getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *fileInfo)
         jthr = getPendingExceptionAndClear(env);
         goto done;
     }
-    extOffset = getExtendedFileInfoOffset(cUserName);
-    fileInfo->mOwner = malloc(extOffset + sizeof(struct hdfsExtendedFileInfo));
+    fileInfo->mOwner = fileInfoAllocOwner(infos, cUserName);
+    (*env)->ReleaseStringUTFChars(env, jUserName, cUserName);
     if (!fileInfo->mOwner) {
         jthr = newRuntimeError(env, "getFileInfo: OOM allocating mOwner");
         goto done;
     }
-    strcpy(fileInfo->mOwner, cUserName);
-    (*env)->ReleaseStringUTFChars(env, jUserName, cUserName);
     extInfo = getExtendedFileInfo(fileInfo);
-    memset(extInfo, 0, sizeof(*extInfo));
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat,
-                    HADOOP_STAT, "isEncrypted", "()Z");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_IS_ENCRYPTED);
     if (jthr) {
         goto done;
     }
     if (jVal.z == JNI_TRUE) {
         extInfo->flags |= HDFS_EXTENDED_FILE_INFO_ENCRYPTED;
     }
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat, HADOOP_STAT,
-                    "getGroup", "()Ljava/lang/String;");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_GROUP);
     if (jthr)
         goto done;
     jGroupName = jVal.l;
@@ -3187,12 +6273,14 @@ getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *fileInfo)
         jthr = getPendingExceptionAndClear(env);
         goto done;
     }
-    fileInfo->mGroup = strdup(cGroupName);
+    fileInfo->mGroup = fileInfoStrdup(infos, cGroupName);
     (*env)->ReleaseStringUTFChars(env, jGroupName, cGroupName);
+    if (!fileInfo->mGroup) {
+        jthr = newRuntimeError(env, "getFileInfo: OOM allocating mGroup");
+        goto done;
+    }
 
-    jthr = invokeMethod(env, &jVal, INSTANCE, jStat, HADOOP_STAT,
-            "getPermission",
-            "()Lorg/apache/hadoop/fs/permission/FsPermission;");
+    jthr = invokeCachedMethod(env, &jVal, jStat, JM_STAT_GET_PERMISSION);
     if (jthr)
         goto done;
     if (jVal.l == NULL) {
@@ -3201,23 +6289,17 @@ getFileInfoFromStat(JNIEnv *env, jobject jStat, hdfsFileInfo *fileInfo)
         goto done;
     }
     jPermission = jVal.l;
-    jthr = invokeMethod(env, &jVal, INSTANCE, jPermission, HADOOP_FSPERM,
-                         "toShort", "()S");
+    jthr = invokeCachedMethod(env, &jVal, jPermission, JM_FSPERM_TO_SHORT);
     if (jthr)
         goto done;
     fileInfo->mPermissions = jVal.s;
     jthr = NULL;
 
 done:
+    // Whatever the entry took from the arena goes with the array
     if (jthr)
-        hdfsFreeFileInfoEntry(fileInfo);
-    destroyLocalReference(env, jPath);
-    destroyLocalReference(env, jPathName);
-    destroyLocalReference(env, jUserName);
-    destroyLocalReference(env, jGroupName);
-    destroyLocalReference(env, jPermission);
-    destroyLocalReference(env, jPath);
-    return jthr;
+        memset(fileInfo, 0, sizeof(*fileInfo));
+    return popLocalFrame(env, jthr);
 }
 
 static jthrowable
@@ -3251,13 +6333,17 @@ getFileInfo(JNIEnv *env, jobject jFS, jobject jPath, hdfsFileInfo **fileInfo)
     if (jthr)
         return jthr;
     jStat = jVal.l;
-    *fileInfo = calloc(1, sizeof(hdfsFileInfo));
+    *fileInfo = fileInfoArrayAlloc(1);
     if (!*fileInfo) {
         destroyLocalReference(env, jStat);
         return newRuntimeError(env, "getFileInfo: OOM allocating hdfsFileInfo");
     }
-    jthr = getFileInfoFromStat(env, jStat, *fileInfo); 
+    jthr = getFileInfoFromStat(env, jStat, *fileInfo, 0);
     destroyLocalReference(env, jStat);
+    if (jthr) {
+        hdfsFreeFileInfo(*fileInfo, 1);
+        *fileInfo = NULL;
+    }
     return jthr;
 }
 
@@ -3317,7 +6403,7 @@ hdfsFileInfo* hdfsListDirectory(hdfsFS fs, const char *path, int *numEntries)
     }
 
     //Allocate memory
-    pathList = calloc(jPathListSize, sizeof(hdfsFileInfo));
+    pathList = fileInfoArrayAlloc(jPathListSize);
     if (pathList == NULL) {
         ret = ENOMEM;
         goto done;
@@ -3332,7 +6418,7 @@ hdfsFileInfo* hdfsListDirectory(hdfsFS fs, const char *path, int *numEntries)
                 path, i, jPathListSize);
             goto done;
         }
-        jthr = getFileInfoFromStat(env, tmpStat, &pathList[i]);
+        jthr = getFileInfoFromStat(env, tmpStat, pathList, i);
         destroyLocalReference(env, tmpStat);
         if (jthr) {
             ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
@@ -3341,6 +6427,7 @@ hdfsFileInfo* hdfsListDirectory(hdfsFS fs, const char *path, int *numEntries)
             goto done;
         }
     }
+    statCacheStoreListing(fs, path, pathList, jPathListSize);
     ret = 0;
 
 done:
@@ -3380,6 +6467,13 @@ hdfsFileInfo *hdfsGetPathInfo(hdfsFS fs, const char *path)
       return NULL;
     }
 
+    if (statCacheLookup(fs, path, &fileInfo)) {
+        if (!fileInfo) {
+            errno = ENOENT;
+        }
+        return fileInfo;
+    }
+
     //Create an object of org.apache.hadoop.fs.Path
     jthr = constructNewObjectOfPath(env, path, &jPath);
     if (jthr) {
@@ -3396,6 +6490,7 @@ hdfsFileInfo *hdfsGetPathInfo(hdfsFS fs, const char *path)
             "hdfsGetPathInfo(%s): getFileInfo", path);
         return NULL;
     }
+    statCacheStore(fs, path, fileInfo);
     if (!fileInfo) {
         errno = ENOENT;
         return NULL;
@@ -3403,24 +6498,266 @@ hdfsFileInfo *hdfsGetPathInfo(hdfsFS fs, const char *path)
     return fileInfo;
 }
 
-static void hdfsFreeFileInfoEntry(hdfsFileInfo *hdfsFileInfo)
+hdfsFileInfo *hdfsGetPathInfoBatch(hdfsFS fs, const char **paths,
+                                   int numPaths, int *errnos)
+{
+    // JAVA EQUIVALENT:
+    //  foreach path in paths
+    //    fs.getFileStatus(new Path(path))
+
+    jobject jFS = (jobject)fs;
+    jobject jPath;
+    jobject jStat;
+    jvalue jVal;
+    jthrowable jthr;
+    hdfsFileInfo *infos;
+    int i;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return NULL;
+    }
+    if (numPaths <= 0 || !paths || !errnos) {
+        errno = EINVAL;
+        return NULL;
+    }
+    infos = fileInfoArrayAlloc(numPaths);
+    if (!infos) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (i = 0; i < numPaths; i++) {
+        jthr = constructNewObjectOfPath(env, paths[i], &jPath);
+        if (jthr) {
+            errnos[i] = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetPathInfoBatch(%s): constructNewObjectOfPath",
+                paths[i]);
+            continue;
+        }
+        // getFileStatus throws FileNotFoundException for a missing path,
+        // so there is no separate exists() round trip as in getFileInfo
+        jthr = invokeMethod(env, &jVal, INSTANCE, jFS,
+                HADOOP_FS, "getFileStatus",
+                JMETHOD1(JPARAM(HADOOP_PATH), JPARAM(HADOOP_STAT)), jPath);
+        destroyLocalReference(env, jPath);
+        if (jthr) {
+            errnos[i] = printExceptionAndFree(env, jthr,
+                NOPRINT_EXC_ACCESS_CONTROL | NOPRINT_EXC_FILE_NOT_FOUND |
+                NOPRINT_EXC_UNRESOLVED_LINK,
+                "hdfsGetPathInfoBatch(%s): FileSystem#getFileStatus",
+                paths[i]);
+            continue;
+        }
+        jStat = jVal.l;
+        jthr = getFileInfoFromStat(env, jStat, infos, i);
+        destroyLocalReference(env, jStat);
+        if (jthr) {
+            errnos[i] = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsGetPathInfoBatch(%s): getFileInfoFromStat", paths[i]);
+            continue;
+        }
+        errnos[i] = 0;
+    }
+    errno = 0;
+    return infos;
+}
+
+/**
+ * A directory listing read through FileSystem#listStatusIterator.
+ */
+struct hdfsListing {
+    jobject iterator;           /* global reference to the RemoteIterator */
+    char *path;                 /* for error messages and the stat cache */
+    hdfsFS fs;
+};
+
+struct hdfsListing *hdfsOpenListing(hdfsFS fs, const char *path)
+{
+    // JAVA EQUIVALENT:
+    //  RemoteIterator<FileStatus> it = fs.listStatusIterator(new Path(path))
+
+    jobject jFS = (jobject)fs;
+    jobject jPath = NULL;
+    jvalue jVal;
+    jthrowable jthr;
+    struct hdfsListing *listing = NULL;
+    int ret;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return NULL;
+    }
+
+    jthr = constructNewObjectOfPath(env, path, &jPath);
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+            "hdfsOpenListing(%s): constructNewObjectOfPath", path);
+        goto done;
+    }
+    jthr = invokeMethod(env, &jVal, INSTANCE, jFS, HADOOP_FS,
+            "listStatusIterator",
+            JMETHOD1(JPARAM(HADOOP_PATH), JPARAM(HADOOP_RITERATOR)), jPath);
+    if (jthr) {
+        ret = printExceptionAndFree(env, jthr,
+            NOPRINT_EXC_ACCESS_CONTROL | NOPRINT_EXC_FILE_NOT_FOUND |
+            NOPRINT_EXC_UNRESOLVED_LINK,
+            "hdfsOpenListing(%s): FileSystem#listStatusIterator", path);
+        goto done;
+    }
+    listing = calloc(1, sizeof(struct hdfsListing));
+    if (!listing) {
+        destroyLocalReference(env, jVal.l);
+        ret = ENOMEM;
+        goto done;
+    }
+    listing->iterator = (*env)->NewGlobalRef(env, jVal.l);
+    destroyLocalReference(env, jVal.l);
+    if (!listing->iterator) {
+        ret = printPendingExceptionAndFree(env, PRINT_EXC_ALL,
+            "hdfsOpenListing(%s): NewGlobalRef", path);
+        goto done;
+    }
+    listing->path = strdup(path);
+    if (!listing->path) {
+        ret = ENOMEM;
+        goto done;
+    }
+    listing->fs = fs;
+    ret = 0;
+
+done:
+    destroyLocalReference(env, jPath);
+    if (ret) {
+        hdfsCloseListing(listing);
+        errno = ret;
+        return NULL;
+    }
+    return listing;
+}
+
+hdfsFileInfo *hdfsListingNext(struct hdfsListing *listing, int maxEntries,
+                              int *numEntries)
+{
+    // JAVA EQUIVALENT:
+    //  while (it.hasNext() && count < maxEntries)
+    //    getFileInfo(it.next())
+
+    jvalue jVal;
+    jthrowable jthr;
+    jobject jStat;
+    hdfsFileInfo *page = NULL;
+    hdfsFileInfo *shrunk;
+    int count = 0;
+    int ret;
+
+    //Get the JNIEnv* corresponding to current thread
+    JNIEnv* env = getJNIEnv();
+    if (env == NULL) {
+      errno = EINTERNAL;
+      return NULL;
+    }
+    if (!listing || maxEntries <= 0 || !numEntries) {
+        errno = EINVAL;
+        return NULL;
+    }
+    *numEntries = 0;
+    page = fileInfoArrayAlloc(maxEntries);
+    if (!page) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    while (count < maxEntries) {
+        jthr = invokeMethod(env, &jVal, INSTANCE, listing->iterator,
+                HADOOP_RITERATOR, "hasNext", "()Z");
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsListingNext(%s): RemoteIterator#hasNext",
+                listing->path);
+            goto done;
+        }
+        if (!jVal.z) {
+            break;
+        }
+        jthr = invokeMethod(env, &jVal, INSTANCE, listing->iterator,
+                HADOOP_RITERATOR, "next", "()Ljava/lang/Object;");
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsListingNext(%s): RemoteIterator#next", listing->path);
+            goto done;
+        }
+        jStat = jVal.l;
+        jthr = getFileInfoFromStat(env, jStat, page, count);
+        destroyLocalReference(env, jStat);
+        if (jthr) {
+            ret = printExceptionAndFree(env, jthr, PRINT_EXC_ALL,
+                "hdfsListingNext(%s): getFileInfoFromStat", listing->path);
+            goto done;
+        }
+        count++;
+    }
+    ret = 0;
+
+done:
+    if (ret) {
+        hdfsFreeFileInfo(page, count);
+        errno = ret;
+        return NULL;
+    }
+    if (count == 0) {
+        hdfsFreeFileInfo(page, 0);
+        errno = 0;
+        return NULL;
+    }
+    if (count < maxEntries) {
+        shrunk = fileInfoArrayShrink(page, count);
+        if (shrunk) {
+            page = shrunk;
+        }
+    }
+    statCacheStoreListing(listing->fs, listing->path, page, count);
+    *numEntries = count;
+    errno = 0;
+    return page;
+}
+
+void hdfsCloseListing(struct hdfsListing *listing)
 {
-    free(hdfsFileInfo->mName);
-    free(hdfsFileInfo->mOwner);
-    free(hdfsFileInfo->mGroup);
-    memset(hdfsFileInfo, 0, sizeof(*hdfsFileInfo));
+    JNIEnv* env;
+
+    if (!listing) {
+        return;
+    }
+    if (listing->iterator) {
+        env = getJNIEnv();
+        if (env) {
+            (*env)->DeleteGlobalRef(env, listing->iterator);
+        }
+    }
+    free(listing->path);
+    free(listing);
 }
 
 void hdfsFreeFileInfo(hdfsFileInfo *hdfsFileInfo, int numEntries)
 {
-    //Free the mName, mOwner, and mGroup
-    int i;
-    for (i=0; i < numEntries; ++i) {
-        hdfsFreeFileInfoEntry(hdfsFileInfo + i);
+    struct fileInfoArena *arena;
+    struct fileInfoChunk *chunk;
+
+    if (!hdfsFileInfo) {
+        return;
+    }
+    //Free the mName, mOwner, and mGroup of every entry, whatever numEntries
+    arena = fileInfoArenaOf(hdfsFileInfo);
+    while ((chunk = arena->chunks)) {
+        arena->chunks = chunk->next;
+        free(chunk);
     }
 
     //Free entire block
-    free(hdfsFileInfo);
+    free(arena);
 }
 
 int hdfsFileIsEncrypted(hdfsFileInfo *fileInfo)
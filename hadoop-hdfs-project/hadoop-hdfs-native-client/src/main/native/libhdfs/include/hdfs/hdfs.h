@@ -169,6 +169,63 @@ extern  "C" {
     LIBHDFS_EXTERNAL
     void hdfsFileFreeReadStatistics(struct hdfsReadStatistics *stats);
 
+    /** The calls whose latency a file handle records. */
+    enum hdfsLatencyOp {
+        HDFS_LATENCY_READ = 0,
+        HDFS_LATENCY_PREAD,
+        HDFS_LATENCY_WRITE,
+        HDFS_LATENCY_NUM_OPS
+    };
+
+#define HDFS_LATENCY_BUCKETS 32
+
+    /**
+     * A latency histogram.  buckets[0] counts the calls that took less
+     * than a microsecond, and buckets[i] those that took at least 2^(i-1)
+     * and less than 2^i microseconds.  The last bucket also counts all
+     * slower calls.
+     */
+    struct hdfsLatencyHistogram {
+        uint64_t count;
+        uint64_t totalMicros;
+        uint64_t maxMicros;
+        uint64_t buckets[HDFS_LATENCY_BUCKETS];
+    };
+
+    struct hdfsLatencyStats {
+        /** Whole calls, from entry to return, indexed by hdfsLatencyOp. */
+        struct hdfsLatencyHistogram calls[HDFS_LATENCY_NUM_OPS];
+        /**
+         * The Java read or write methods those calls invoke.  The rest of
+         * the time of a call is spent in JNI and copies.  The positional
+         * reads of hdfsPreadv, and the prefetches of read-ahead streams,
+         * which go through hdfsPread, are counted too.
+         */
+        struct hdfsLatencyHistogram java[HDFS_LATENCY_NUM_OPS];
+    };
+
+    /**
+     * Get the latencies of hdfsRead, hdfsPread and hdfsWrite on a file
+     * since it was opened or its latency statistics were last cleared.
+     *
+     * @param file     The HDFS file
+     * @param stats    (out parameter) the statistics are copied here.
+     *
+     * @return         0 on success, or -1 and errno on error.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsFileGetLatencyStats(hdfsFile file, struct hdfsLatencyStats *stats);
+
+    /**
+     * Clear the latency statistics of a file.
+     *
+     * @param file     The HDFS file
+     *
+     * @return         0 on success, or -1 and errno on error.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsFileClearLatencyStats(hdfsFile file);
+
     /** 
      * hdfsConnectAsUser - Connect to a hdfs file system as a specific user
      * Connect to the hdfs.
@@ -251,6 +308,52 @@ extern  "C" {
     LIBHDFS_EXTERNAL
     void hdfsBuilderSetForceNewInstance(struct hdfsBuilder *bld);
 
+    /**
+     * Share the connection with the other shared connections of the process
+     * that were built with the same settings.
+     *
+     * The first connect creates the FileSystem handle, and later ones return
+     * the same hdfsFS with a reference count increased.  hdfsDisconnect
+     * drops a reference and only closes the FileSystem with the last one, so
+     * components of a process can connect and disconnect independently
+     * without closing a FileSystem another component still uses.  Combined
+     * with hdfsBuilderSetForceNewInstance, the shared FileSystem is private
+     * to the shared connections, and FileSystem#get callers never see it
+     * closed.
+     *
+     * This saves the FileSystem setup on repeated connects.  Starting the
+     * JVM is a cost paid once per process, which can be reduced with JVM
+     * options such as class data sharing passed through LIBHDFS_OPTS.
+     *
+     * @param bld The HDFS builder
+     */
+    LIBHDFS_EXTERNAL
+    void hdfsBuilderSetShared(struct hdfsBuilder *bld);
+
+    /**
+     * Turn on hedged reads for the positional reads of the connection.
+     *
+     * When a positional read has not completed after the threshold, the
+     * DFSClient starts a second read of the same range from another
+     * DataNode and uses whichever finishes first, so that one slow
+     * DataNode does not hold the read up until it times out.  This sets
+     * dfs.client.hedged.read.threadpool.size and
+     * dfs.client.hedged.read.threshold.millis.  The thread pool is shared by
+     * all the DFSClients of the process, so combine this with
+     * hdfsBuilderSetForceNewInstance if the FileSystem could otherwise come
+     * from the cache with other settings.
+     *
+     * @param bld              The HDFS builder
+     * @param numThreads       The size of the hedged read thread pool, or 0
+     *                         to turn hedged reads off.
+     * @param thresholdMillis  How long a read may take before it is hedged.
+     *
+     * @return                 0 on success; nonzero error code otherwise.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsBuilderSetHedgedReads(struct hdfsBuilder *bld, int32_t numThreads,
+                                  int64_t thresholdMillis);
+
     /**
      * Set the HDFS NameNode to connect to.
      *
@@ -319,6 +422,15 @@ extern  "C" {
     /**
      * Set a configuration string for an HdfsBuilder.
      *
+     * Besides the Hadoop configuration, two keys are read by libhdfs itself:
+     * libhdfs.stat.cache.ttl.secs turns on a cache of hdfsGetPathInfo and
+     * hdfsExists results for the connection, kept for that many seconds,
+     * and libhdfs.stat.cache.max.entries bounds it (10000 by default).
+     * hdfsListDirectory and hdfsListingNext fill it with the entries they
+     * return, as far as there is room.
+     * Changes this connection makes drop the affected entries, changes made
+     * by other clients are seen after the TTL.
+     *
      * @param key      The key to set.
      * @param val      The value, or NULL to set no value.
      *                 This will be shallow-copied.  You are responsible for
@@ -368,7 +480,8 @@ extern  "C" {
 
     /** 
      * hdfsDisconnect - Disconnect from the hdfs file system.
-     * Disconnect from hdfs.
+     * Disconnect from hdfs.  A shared connection is only closed once every
+     * connect that returned it has been matched by a disconnect.
      * @param fs The configured filesystem handle.
      * @return Returns 0 on success, -1 on error.
      *         Even if there is an error, the resources associated with the
@@ -468,6 +581,121 @@ extern  "C" {
     int hdfsStreamBuilderSetDefaultBlockSize(struct hdfsStreamBuilder *bld,
                                        int64_t defaultBlockSize);
 
+    /**
+     * hdfsStreamBuilderSetReadahead - Prefetch ahead of sequential hdfsRead
+     * calls.  This is only relevant for input streams.
+     *
+     * Once reads continue where the previous read ended, the stream fetches
+     * the next window in the background while the caller processes the data
+     * it has, and serves hdfsRead out of that window.  The window starts at
+     * 64 KB and doubles each time it is used up, up to the given size.  A
+     * seek elsewhere drops the buffered data and starts over.
+     *
+     * The stream allocates two buffers of the given size.  Background reads
+     * go through the hdfsPreadAsync thread pool.
+     *
+     * @param bld The hdfs stream builder.
+     * @param readahead The largest prefetch window in bytes, or 0 to read
+     *                  on demand only, which is the default.
+     *
+     * @return 0 on success, or -1 on error.  Errno will be set on error.
+     *              If you call this on an output stream builder, you will get
+     *              EINVAL, because this configuration is not relevant to
+     *              output streams.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsStreamBuilderSetReadahead(struct hdfsStreamBuilder *bld,
+                                      int32_t readahead);
+
+    /**
+     * hdfsStreamBuilderSetReadBufferSize - Serve hdfsRead calls out of a
+     * native buffer.  This is only relevant for input streams.
+     *
+     * Each hdfsRead on a stream without a native buffer is a call into
+     * Java, which dominates the cost of reads of a few bytes, such as those
+     * of a line parser.  With a buffer, a read that finds it empty refills
+     * it with one read of the given size, and the reads after that copy out
+     * of it until it is used up.  Reads at least as large as the buffer skip
+     * it.  hdfsTell is answered from the buffer, and a hdfsSeek within the
+     * buffered data only moves within it.  hdfsPread is not affected.
+     *
+     * This cannot be combined with hdfsStreamBuilderSetReadahead.
+     *
+     * @param bld The hdfs stream builder.
+     * @param bufferSize The size of the buffer in bytes, or 0 for no
+     *                   buffer, which is the default.
+     *
+     * @return 0 on success, or -1 on error.  Errno will be set on error.
+     *              If you call this on an output stream builder, you will get
+     *              EINVAL, because this configuration is not relevant to
+     *              output streams.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsStreamBuilderSetReadBufferSize(struct hdfsStreamBuilder *bld,
+                                           int32_t bufferSize);
+
+    /**
+     * The largest number of extra streams hdfsStreamBuilderSetPreadStreams
+     * accepts.
+     */
+#define HDFS_PREAD_MAX_STREAMS 64
+
+    /**
+     * hdfsStreamBuilderSetPreadStreams - Open extra streams on the same file
+     * for concurrent positional reads.  This is only relevant for input
+     * streams.
+     *
+     * A Java input stream serializes the positional reads made on it, so
+     * threads calling hdfsPread on one handle wait for each other.  With
+     * extra streams, each hdfsPread takes a stream no other thread is using
+     * and only falls back to the main stream when all of them are busy.
+     * Every stream holds its own connection to a DataNode, so only use this
+     * for handles shared by many reading threads.
+     *
+     * @param bld The hdfs stream builder.
+     * @param numStreams The number of extra streams, from 0, which is the
+     *                   default, to HDFS_PREAD_MAX_STREAMS.
+     *
+     * @return 0 on success, or -1 on error.  Errno will be set on error.
+     *              If you call this on an output stream builder, you will get
+     *              EINVAL, because this configuration is not relevant to
+     *              output streams.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsStreamBuilderSetPreadStreams(struct hdfsStreamBuilder *bld,
+                                         int32_t numStreams);
+
+    /**
+     * The default and the largest batch sizes of
+     * hdfsStreamBuilderSetWriteBatchSize.
+     */
+#define HDFS_WRITE_BATCH_DEFAULT (64 * 1024)
+#define HDFS_WRITE_BATCH_MAX (1024 * 1024)
+
+    /**
+     * hdfsStreamBuilderSetWriteBatchSize - Set how many bytes hdfsWritev
+     * hands to Java in one call.  This is only relevant for output streams.
+     *
+     * hdfsWritev gathers its buffers into batches of this size, so a batch
+     * the size of the client packet fills a packet per JNI call.  The packet
+     * size itself is a setting of the filesystem,
+     * dfs.client-write-packet-size, which can be set with
+     * hdfsBuilderConfSetStr before connecting.
+     *
+     * @param bld The hdfs stream builder.
+     * @param batchSize The batch size in bytes, from 1 to
+     *                  HDFS_WRITE_BATCH_MAX, or 0 for the default of
+     *                  HDFS_WRITE_BATCH_DEFAULT.
+     *
+     * @return 0 on success, or -1 on error.  Errno will be set on error.
+     *              If you call this on an input stream builder, you will get
+     *              EINVAL, because this configuration is not relevant to input
+     *              streams.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsStreamBuilderSetWriteBatchSize(struct hdfsStreamBuilder *bld,
+                                           int32_t batchSize);
+
     /**
      * hdfsStreamBuilderBuild - Build the stream by calling open or create.
      *
@@ -506,6 +734,24 @@ extern  "C" {
     LIBHDFS_EXTERNAL
     int hdfsUnbufferFile(hdfsFile file);
 
+    /**
+     * hdfsSetUnbufferLimit - Unbuffer idle input streams automatically.
+     *
+     * Once more than limit input streams have read since they were last
+     * unbuffered, the least recently read ones that no read or seek is
+     * using, and whose block descriptor from hadoopGetBlockFd is not held,
+     * are unbuffered as hdfsUnbufferFile would, so that they give up
+     * their DataNode connections and buffers.  They reconnect on their next
+     * read.  This applies to all the streams of the process.  It is off by
+     * default, unless the LIBHDFS_UNBUFFER_LIMIT environment variable sets
+     * a limit.
+     *
+     * @param limit The most input streams that keep their buffers, or 0 to
+     *              turn automatic unbuffering off.
+     */
+    LIBHDFS_EXTERNAL
+    void hdfsSetUnbufferLimit(int limit);
+
     /** 
      * hdfsCloseFile - Close an open file. 
      * @param fs The configured filesystem handle.
@@ -571,6 +817,15 @@ extern  "C" {
 
     /** 
      * hdfsPread - Positional read of data from an open file.
+     *
+     * hdfsPread does not use or move the file position, and it is the one
+     * call that may run on the same handle from several threads at once,
+     * also while hdfsRead or hdfsSeek run on it.  Concurrent calls share one
+     * stream and take turns unless the handle was opened with
+     * hdfsStreamBuilderSetPreadStreams.  No other call on a handle may run
+     * concurrently with another call on it, and hdfsCloseFile must not run
+     * while any other call on the handle is in progress.
+     *
      * @param fs The configured filesystem handle.
      * @param file The file handle.
      * @param position Position from which to read
@@ -582,6 +837,94 @@ extern  "C" {
     tSize hdfsPread(hdfsFS fs, hdfsFile file, tOffset position,
                     void* buffer, tSize length);
 
+    /**
+     * One range of a vectored positional read.
+     */
+    struct hdfsReadRange {
+        tOffset offset;   /* position in the file */
+        tSize length;     /* bytes wanted */
+        void *buffer;     /* at least length bytes */
+        tSize bytesRead;  /* set by hdfsPreadv, short only at end-of-file */
+    };
+
+    /**
+     * hdfsPreadv - Positional read of several ranges of an open file.
+     * Ranges that follow each other in the file are coalesced into one
+     * read, and the whole batch shares one JNI environment lookup. Every
+     * range is read completely unless it reaches the end of the file.
+     *
+     * @param fs The configured filesystem handle.
+     * @param file The file handle.
+     * @param ranges The ranges to read; bytesRead is filled in for each.
+     * @param numRanges The number of ranges.
+     * @return      0 on success, -1 on error with errno set. On error the
+     *              bytesRead of ranges that were not read is 0.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsPreadv(hdfsFS fs, hdfsFile file, struct hdfsReadRange *ranges,
+                   int numRanges);
+
+    /**
+     * The largest number of reads hdfsPreadParallel splits a read into.
+     */
+#define HDFS_PREAD_PARALLEL_MAX_PIECES 16
+
+    /**
+     * hdfsPreadParallel - Positional read of a large range of an open file,
+     * split into reads of whole blocks that run at the same time.
+     *
+     * The range is split at the block boundaries of the default block size
+     * of the filesystem, into at most HDFS_PREAD_PARALLEL_MAX_PIECES reads.
+     * The calling thread reads the first piece, and the others run on the
+     * hdfsPreadAsync thread pool.  A range within one block is read with a
+     * single positional read.  For the pieces to be read from their
+     * DataNodes concurrently rather than in turns, open the file with
+     * hdfsStreamBuilderSetPreadStreams.
+     *
+     * @param fs The configured filesystem handle.
+     * @param file The file handle.
+     * @param position Position from which to read
+     * @param buffer The buffer to copy read bytes into.
+     * @param length The length of the buffer.
+     * @return      The number of bytes read, which is less than length only
+     *              at the end of the file, or -1 on error with errno set.
+     */
+    LIBHDFS_EXTERNAL
+    tSize hdfsPreadParallel(hdfsFS fs, hdfsFile file, tOffset position,
+                            void* buffer, tSize length);
+
+    /**
+     * Completion callback of hdfsPreadAsync, run on a libhdfs thread.
+     *
+     * @param ret    What hdfsPread returned for the read.
+     * @param error  The errno of a failed read, 0 otherwise.
+     * @param cookie The cookie passed to hdfsPreadAsync.
+     */
+    typedef void (*hdfsReadCallback)(tSize ret, int error, void *cookie);
+
+    /**
+     * hdfsPreadAsync - Queue a positional read of an open file. The read
+     * runs on a bounded pool of libhdfs threads, LIBHDFS_ASYNC_THREADS of
+     * them (8 by default), which is started by the first call. The
+     * callback must not block for long, as it holds up the pool thread.
+     * The buffer must stay valid, and the file open, until the callback
+     * has run.
+     *
+     * @param fs The configured filesystem handle.
+     * @param file The file handle.
+     * @param position Position from which to read
+     * @param buffer The buffer to copy read bytes into.
+     * @param length The length of the buffer.
+     * @param callback Called once when the read completes.
+     * @param cookie Passed to the callback.
+     * @return      0 if the read was queued, -1 on error with errno set.
+     *              errno is EAGAIN when too many reads are already queued.
+     */
+    LIBHDFS_EXTERNAL
+    int hdfsPreadAsync(hdfsFS fs, hdfsFile file, tOffset position,
+                       void* buffer, tSize length, hdfsReadCallback callback,
+                       void *cookie);
+
 
     /** 
      * hdfsWrite - Write data into an open file.
@@ -595,6 +938,31 @@ extern  "C" {
     tSize hdfsWrite(hdfsFS fs, hdfsFile file, const void* buffer,
                     tSize length);
 
+    /**
+     * One buffer of a gathering write.
+     */
+    struct hdfsWriteVec {
+        const void *buffer;
+        tSize length;
+    };
+
+    /**
+     * hdfsWritev - Write several buffers into an open file, in order.
+     * The buffers are copied into batches of the stream's write batch size
+     * (see hdfsStreamBuilderSetWriteBatchSize), and each batch is written
+     * with one JNI call, rather than one call per buffer as with hdfsWrite.
+     *
+     * @param fs The configured filesystem handle.
+     * @param file The file handle.
+     * @param vecs The buffers to write.
+     * @param numVecs The number of buffers.
+     * @return Returns the number of bytes written, -1 on error.  On error,
+     *         an unknown prefix of the data may have been written.
+     */
+    LIBHDFS_EXTERNAL
+    tSize hdfsWritev(hdfsFS fs, hdfsFile file,
+                     const struct hdfsWriteVec *vecs, int numVecs);
+
 
     /** 
      * hdfsWrite - Flush the data. 
@@ -642,6 +1010,9 @@ extern  "C" {
 
     /**
      * hdfsCopy - Copy file from one filesystem to another.
+     * A regular file copied within the local filesystem, when both handles
+     * are the same, is reflinked or copied by the kernel where possible,
+     * rather than read and written.
      * @param srcFS The handle to source filesystem.
      * @param src The path of source file. 
      * @param dstFS The handle to destination filesystem.
@@ -654,6 +1025,9 @@ extern  "C" {
 
     /**
      * hdfsMove - Move file from one filesystem to another.
+     * When srcFS and dstFS are the same handle, or share one cached
+     * FileSystem (the same URI and user), the file is renamed rather than
+     * copied, if the filesystem allows it.
      * @param srcFS The handle to source filesystem.
      * @param src The path of source file. 
      * @param dstFS The handle to destination filesystem.
@@ -776,6 +1150,56 @@ extern  "C" {
     LIBHDFS_EXTERNAL
     hdfsFileInfo *hdfsGetPathInfo(hdfsFS fs, const char* path);
 
+    /**
+     * hdfsGetPathInfoBatch - Get information about many paths in one call.
+     * Entries for paths that could not be looked up are zeroed and their
+     * error is in errnos. hdfsFreeFileInfo(info, numPaths) frees the array.
+     * @param fs The configured filesystem handle.
+     * @param paths The paths to look up.
+     * @param numPaths The number of paths.
+     * @param errnos Set to 0 or the error code of each path, ENOENT for
+     *               paths that do not exist.
+     * @return Returns a dynamically-allocated array of numPaths hdfsFileInfo
+     * objects; NULL on error, with errno set.
+     */
+    LIBHDFS_EXTERNAL
+    hdfsFileInfo *hdfsGetPathInfoBatch(hdfsFS fs, const char **paths,
+                                       int numPaths, int *errnos);
+
+    struct hdfsListing;
+
+    /**
+     * hdfsOpenListing - Start listing a directory one page at a time, so
+     * huge directories are never held in memory whole. The namenode is
+     * asked for entries as the pages are read.
+     * @param fs The configured filesystem handle.
+     * @param path The path of the directory.
+     * @return The listing, to be closed with hdfsCloseListing; NULL on
+     * error, with errno set.
+     */
+    LIBHDFS_EXTERNAL
+    struct hdfsListing *hdfsOpenListing(hdfsFS fs, const char *path);
+
+    /**
+     * hdfsListingNext - Read the next page of a listing.
+     * @param listing The listing.
+     * @param maxEntries The largest number of entries to return.
+     * @param numEntries Set to the number of entries returned.
+     * @return Returns a dynamically-allocated array of hdfsFileInfo objects,
+     * to be freed with hdfsFreeFileInfo; NULL once the listing is done, with
+     * errno set to 0, or on error, with errno set to non-zero.
+     */
+    LIBHDFS_EXTERNAL
+    hdfsFileInfo *hdfsListingNext(struct hdfsListing *listing, int maxEntries,
+                                  int *numEntries);
+
+    /**
+     * hdfsCloseListing - Free a listing.
+     * @param listing The listing.
+     */
+    LIBHDFS_EXTERNAL
+    void hdfsCloseListing(struct hdfsListing *listing);
+
 
     /** 
      * hdfsFreeFileInfo - Free up the hdfsFileInfo array (including fields) 
@@ -822,6 +1246,73 @@ extern  "C" {
     LIBHDFS_EXTERNAL
     void hdfsFreeHosts(char ***blockHosts);
 
+    /**
+     * The storage types of block replicas, in the order of
+     * org.apache.hadoop.fs.StorageType.
+     */
+    enum hdfsStorageType {
+        HDFS_STORAGE_UNKNOWN = -1,
+        HDFS_STORAGE_RAM_DISK = 0,
+        HDFS_STORAGE_SSD = 1,
+        HDFS_STORAGE_DISK = 2,
+        HDFS_STORAGE_ARCHIVE = 3,
+    };
+
+    /** The locations of one block returned by hdfsGetBlockLocations. */
+    struct hdfsBlockLocation {
+        tOffset offset;
+        tOffset length;
+        int numReplicas;
+        // The host of each replica, as an index into
+        // hdfsBlockLocations#hosts
+        const int32_t *hostIndices;
+        // The storage type of each replica
+        const enum hdfsStorageType *storageTypes;
+    };
+
+    /**
+     * Block locations of a file.  Every host name is stored once, and the
+     * per-block arrays point into hostIndices and storageTypes, which hold
+     * the replicas of all the blocks in order.
+     */
+    struct hdfsBlockLocations {
+        int numBlocks;
+        struct hdfsBlockLocation *blocks;
+        int numHosts;
+        char **hosts;
+        int numReplicas;
+        int32_t *hostIndices;
+        enum hdfsStorageType *storageTypes;
+    };
+
+    /**
+     * hdfsGetBlockLocations - Get the locations of the blocks of a file
+     * that overlap a range, in one call to the NameNode.
+     *
+     * Unlike hdfsGetHosts, which copies the host names of every replica,
+     * this makes a few allocations however many blocks the file has, which
+     * matters when scheduling over large datasets.
+     *
+     * @param fs The configured filesystem handle.
+     * @param path The path of the file.
+     * @param start The start of the range.
+     * @param length The length of the range.
+     * @return The block locations, to be freed with hdfsFreeBlockLocations;
+     *         NULL on error, with errno set.
+     */
+    LIBHDFS_EXTERNAL
+    struct hdfsBlockLocations *hdfsGetBlockLocations(hdfsFS fs,
+            const char *path, tOffset start, tOffset length);
+
+    /**
+     * hdfsFreeBlockLocations - Free the block locations returned by
+     * hdfsGetBlockLocations.
+     *
+     * @param locs The block locations.
+     */
+    LIBHDFS_EXTERNAL
+    void hdfsFreeBlockLocations(struct hdfsBlockLocations *locs);
+
 
     /** 
      * hdfsGetDefaultBlockSize - Get the default blocksize.
@@ -1012,6 +1503,45 @@ extern  "C" {
     LIBHDFS_EXTERNAL
     void hadoopRzBufferFree(hdfsFile file, struct hadoopRzBuffer *buffer);
 
+    /**
+     * The local block file a stream reads through short-circuit local reads.
+     */
+    struct hadoopBlockFd {
+        /** The file descriptor of the block data file. */
+        int fd;
+        /** The offset in the file of the current stream position. */
+        tOffset offset;
+        /** The number of bytes of the block left from that offset. */
+        tOffset length;
+    };
+
+    /**
+     * Get the block data file the current position of the stream is read
+     * from, so that it can be mapped or read directly.
+     *
+     * The descriptor belongs to the stream.  It stays valid until the next
+     * read, seek, unbuffer or close of the stream, and must not be closed by
+     * the caller; dup it or map it before using the stream again.  Until
+     * then the unbuffer LRU (see hdfsSetUnbufferLimit) leaves the stream
+     * alone, even if other streams are read.  Like for
+     * zero-copy reads, the data is not checksummed, so this needs
+     * checksums to be skipped in the options unless the stream does not
+     * verify them.
+     *
+     * @param file       The HDFS input stream.
+     * @param opts       The options to use, as for hadoopReadZero.
+     * @param out        (out param) the descriptor and range.
+     *
+     * @return           0 on success, or -1 and errno on error.
+     *                   errno = ENOTSUP indicates that the current block is
+     *                   not read through short-circuit local reads, that
+     *                   checksums are required, or that the stream is at
+     *                   end-of-file.
+     */
+    LIBHDFS_EXTERNAL
+    int hadoopGetBlockFd(hdfsFile file, struct hadoopRzOptions *opts,
+            struct hadoopBlockFd *out);
+
 #ifdef __cplusplus
 }
 #endif
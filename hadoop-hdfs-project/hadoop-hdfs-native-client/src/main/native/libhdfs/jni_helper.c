@@ -27,7 +27,11 @@
 #include <stdio.h> 
 #include <string.h> 
 
-static struct htable *gClassRefHTable = NULL;
+/**
+ * Class name -> global class reference.  Lookups take no lock; additions are
+ * made under hdfsHashMutex.
+ */
+static struct htable_once *gClassRefHTable = NULL;
 
 /** The Native return types that methods could return */
 #define JVOID         'V'
@@ -60,6 +64,19 @@ void destroyLocalReference(JNIEnv *env, jobject jObject)
     (*env)->DeleteLocalRef(env, jObject);
 }
 
+jthrowable pushLocalFrame(JNIEnv *env, jint capacity)
+{
+    if ((*env)->PushLocalFrame(env, capacity) < 0) {
+        return getPendingExceptionAndClear(env);
+    }
+    return NULL;
+}
+
+jthrowable popLocalFrame(JNIEnv *env, jthrowable jthr)
+{
+    return (*env)->PopLocalFrame(env, jthr);
+}
+
 static jthrowable validateMethodType(JNIEnv *env, MethType methType)
 {
     if (methType != STATIC && methType != INSTANCE) {
@@ -106,32 +123,16 @@ jthrowable newCStr(JNIEnv *env, jstring jstr, char **out)
     return NULL;
 }
 
-jthrowable invokeMethod(JNIEnv *env, jvalue *retval, MethType methType,
-                 jobject instObj, const char *className,
-                 const char *methName, const char *methSignature, ...)
+/**
+ * Call a resolved method with the va_list arguments, returnType is the
+ * first character of the signature's return type.
+ */
+static jthrowable invokeMethodIdV(JNIEnv *env, jvalue *retval,
+                 MethType methType, jobject instObj, jclass cls,
+                 jmethodID mid, char returnType, va_list args)
 {
-    va_list args;
-    jclass cls;
-    jmethodID mid;
     jthrowable jthr;
-    const char *str; 
-    char returnType;
-    
-    jthr = validateMethodType(env, methType);
-    if (jthr)
-        return jthr;
-    jthr = globalClassReference(className, env, &cls);
-    if (jthr)
-        return jthr;
-    jthr = methodIdFromClass(className, methName, methSignature, 
-                            methType, env, &mid);
-    if (jthr)
-        return jthr;
-    str = methSignature;
-    while (*str != ')') str++;
-    str++;
-    returnType = *str;
-    va_start(args, methSignature);
+
     if (returnType == JOBJECT || returnType == JARRAYOBJECT) {
         jobject jobj = NULL;
         if (methType == STATIC) {
@@ -190,7 +191,6 @@ jthrowable invokeMethod(JNIEnv *env, jvalue *retval, MethType methType,
         }
         retval->i = ji;
     }
-    va_end(args);
 
     jthr = (*env)->ExceptionOccurred(env);
     if (jthr) {
@@ -200,6 +200,144 @@ jthrowable invokeMethod(JNIEnv *env, jvalue *retval, MethType methType,
     return NULL;
 }
 
+static char methodReturnType(const char *methSignature)
+{
+    const char *str = methSignature;
+    while (*str != ')') str++;
+    str++;
+    return *str;
+}
+
+jthrowable invokeMethod(JNIEnv *env, jvalue *retval, MethType methType,
+                 jobject instObj, const char *className,
+                 const char *methName, const char *methSignature, ...)
+{
+    va_list args;
+    jclass cls;
+    jmethodID mid;
+    jthrowable jthr;
+
+    jthr = validateMethodType(env, methType);
+    if (jthr)
+        return jthr;
+    jthr = globalClassReference(className, env, &cls);
+    if (jthr)
+        return jthr;
+    jthr = methodIdFromClass(className, methName, methSignature, 
+                            methType, env, &mid);
+    if (jthr)
+        return jthr;
+    va_start(args, methSignature);
+    jthr = invokeMethodIdV(env, retval, methType, instObj, cls, mid,
+                           methodReturnType(methSignature), args);
+    va_end(args);
+    return jthr;
+}
+
+/**
+ * The methods behind the CachedMethod enum, in the same order. cls and mid
+ * are filled in by initCachedMethods while holding the jvmMutex, before any
+ * thread gets a JNIEnv from getJNIEnv, and only read afterwards.
+ */
+static struct {
+    const char *className;
+    const char *methName;
+    const char *methSignature;
+    jclass cls;
+    jmethodID mid;
+} cachedMethods[NUM_CACHED_METHODS] = {
+    { "org/apache/hadoop/fs/FSDataInputStream", "read", "([B)I", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataInputStream", "read", "(Ljava/nio/ByteBuffer;)I", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataInputStream", "read", "(J[BII)I", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataInputStream", "read", "(JLjava/nio/ByteBuffer;)I", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataInputStream", "seek", "(J)V", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataInputStream", "getPos", "()J", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataInputStream", "available", "()I", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataOutputStream", "write", "([BII)V", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataOutputStream", "getPos", "()J", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataOutputStream", "flush", "()V", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataOutputStream", "hflush", "()V", NULL, NULL },
+    { "org/apache/hadoop/fs/FSDataOutputStream", "hsync", "()V", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "isDir", "()Z", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getReplication", "()S", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getBlockSize", "()J", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getModificationTime", "()J",
+        NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getAccessTime", "()J", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getLen", "()J", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getPath",
+        "()Lorg/apache/hadoop/fs/Path;", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getOwner", "()Ljava/lang/String;",
+        NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getGroup", "()Ljava/lang/String;",
+        NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "getPermission",
+        "()Lorg/apache/hadoop/fs/permission/FsPermission;", NULL, NULL },
+    { "org/apache/hadoop/fs/FileStatus", "isEncrypted", "()Z", NULL, NULL },
+    { "org/apache/hadoop/fs/Path", "toString", "()Ljava/lang/String;",
+        NULL, NULL },
+    { "org/apache/hadoop/fs/permission/FsPermission", "toShort", "()S",
+        NULL, NULL },
+};
+
+static int cachedMethodsInitialized;
+
+/**
+ * Resolve the cached methods, called with the jvmMutex held. A method that
+ * can not be resolved is left unset, and invokeCachedMethod looks it up on
+ * every call instead, which reports the error to the caller.
+ */
+static void initCachedMethods(JNIEnv *env)
+{
+    jthrowable jthr;
+    int i;
+
+    if (cachedMethodsInitialized) {
+        return;
+    }
+    for (i = 0; i < NUM_CACHED_METHODS; i++) {
+        jthr = globalClassReference(cachedMethods[i].className, env,
+                                    &cachedMethods[i].cls);
+        if (!jthr) {
+            jthr = methodIdFromClass(cachedMethods[i].className,
+                    cachedMethods[i].methName,
+                    cachedMethods[i].methSignature, INSTANCE, env,
+                    &cachedMethods[i].mid);
+        }
+        if (jthr) {
+            destroyLocalReference(env, jthr);
+            cachedMethods[i].mid = NULL;
+        }
+    }
+    cachedMethodsInitialized = 1;
+}
+
+jthrowable invokeCachedMethod(JNIEnv *env, jvalue *retval, jobject instObj,
+                 CachedMethod method, ...)
+{
+    va_list args;
+    jclass cls = cachedMethods[method].cls;
+    jmethodID mid = cachedMethods[method].mid;
+    jthrowable jthr;
+
+    if (!mid) {
+        jthr = globalClassReference(cachedMethods[method].className, env,
+                                    &cls);
+        if (jthr)
+            return jthr;
+        jthr = methodIdFromClass(cachedMethods[method].className,
+                cachedMethods[method].methName,
+                cachedMethods[method].methSignature, INSTANCE, env, &mid);
+        if (jthr)
+            return jthr;
+    }
+    va_start(args, method);
+    jthr = invokeMethodIdV(env, retval, INSTANCE, instObj, cls, mid,
+            methodReturnType(cachedMethods[method].methSignature), args);
+    va_end(args);
+    return jthr;
+}
+
 jthrowable constructNewObjectOfClass(JNIEnv *env, jobject *out, const char *className, 
                                   const char *ctorSignature, ...)
 {
@@ -260,18 +398,30 @@ jthrowable globalClassReference(const char *className, JNIEnv *env, jclass *out)
     jthrowable jthr = NULL;
     jclass local_clazz = NULL;
     jclass clazz = NULL;
+    struct htable_once *table;
     int ret;
 
+    table = atomicLoadPtr(&gClassRefHTable);
+    if (table) {
+        clazz = htable_once_get(table, className);
+        if (clazz) {
+            *out = clazz;
+            return NULL;
+        }
+    }
     mutexLock(&hdfsHashMutex);
-    if (!gClassRefHTable) {
-        gClassRefHTable = htable_alloc(MAX_HASH_TABLE_ELEM, ht_hash_string,
+    table = gClassRefHTable;
+    if (!table) {
+        table = htable_once_alloc(MAX_HASH_TABLE_ELEM, ht_hash_string,
             ht_compare_string);
-        if (!gClassRefHTable) {
-            jthr = newRuntimeError(env, "htable_alloc failed\n");
+        if (!table) {
+            jthr = newRuntimeError(env, "htable_once_alloc failed\n");
             goto done;
         }
+        atomicStorePtr(&gClassRefHTable, table);
     }
-    clazz = htable_get(gClassRefHTable, className);
+    // Another thread may have added it since we looked.
+    clazz = htable_once_get(table, className);
     if (clazz) {
         *out = clazz;
         goto done;
@@ -286,9 +436,9 @@ jthrowable globalClassReference(const char *className, JNIEnv *env, jclass *out)
         jthr = getPendingExceptionAndClear(env);
         goto done;
     }
-    ret = htable_put(gClassRefHTable, (void*)className, clazz);
+    ret = htable_once_put(table, (void*)className, clazz);
     if (ret) {
-        jthr = newRuntimeError(env, "htable_put failed with error "
+        jthr = newRuntimeError(env, "htable_once_put failed with error "
                                "code %d\n", ret);
         goto done;
     }
@@ -462,6 +612,7 @@ static JNIEnv* getGlobalJNIEnv(void)
         if (jthr) {
             printExceptionAndFree(env, jthr, PRINT_EXC_ALL, "loadFileSystems");
         }
+        initCachedMethods(env);
     }
     else {
         //Attach this thread to the VM
@@ -472,6 +623,7 @@ static JNIEnv* getGlobalJNIEnv(void)
                     "failed with error: %d\n", rv);
             return NULL;
         }
+        initCachedMethods(env);
     }
 
     return env;
@@ -65,6 +65,27 @@ jthrowable newJavaStr(JNIEnv *env, const char *str, jstring *out);
  */
 void destroyLocalReference(JNIEnv *env, jobject jObject);
 
+/**
+ * Start a frame of local references.  The local references created until
+ * the matching popLocalFrame are freed together by it, instead of one by
+ * one.
+ *
+ * @param env: The JNIEnv pointer.
+ * @param capacity: The number of local references the frame holds before
+ *                  it has to grow.
+ * @return NULL on success; the exception otherwise.
+ */
+jthrowable pushLocalFrame(JNIEnv *env, jint capacity);
+
+/**
+ * Free the local references of the frame started by pushLocalFrame.
+ *
+ * @param env: The JNIEnv pointer.
+ * @param jthr: An exception from inside the frame, or NULL.
+ * @return jthr as a local reference of the enclosing frame, or NULL.
+ */
+jthrowable popLocalFrame(JNIEnv *env, jthrowable jthr);
+
 /** invokeMethod: Invoke a Static or Instance method.
  * className: Name of the class where the method can be found
  * methName: Name of the method
@@ -86,6 +107,46 @@ jthrowable invokeMethod(JNIEnv *env, jvalue *retval, MethType methType,
                  jobject instObj, const char *className, const char *methName, 
                  const char *methSignature, ...);
 
+/**
+ * Instance methods on the hot read, write and listing paths. They are
+ * resolved once, when the first thread gets its JNIEnv, so
+ * invokeCachedMethod needs no class lookup and takes no lock.
+ */
+typedef enum {
+    JM_ISTRM_READ,              /* FSDataInputStream#read([B)I */
+    JM_ISTRM_READ_BUFFER,       /* FSDataInputStream#read(ByteBuffer)I */
+    JM_ISTRM_PREAD,             /* FSDataInputStream#read(J[BII)I */
+    JM_ISTRM_PREAD_BUFFER,      /* FSDataInputStream#read(JByteBuffer)I */
+    JM_ISTRM_SEEK,              /* FSDataInputStream#seek(J)V */
+    JM_ISTRM_GET_POS,           /* FSDataInputStream#getPos()J */
+    JM_ISTRM_AVAILABLE,         /* FSDataInputStream#available()I */
+    JM_OSTRM_WRITE,             /* FSDataOutputStream#write([BII)V */
+    JM_OSTRM_GET_POS,           /* FSDataOutputStream#getPos()J */
+    JM_OSTRM_FLUSH,             /* FSDataOutputStream#flush()V */
+    JM_OSTRM_HFLUSH,            /* FSDataOutputStream#hflush()V */
+    JM_OSTRM_HSYNC,             /* FSDataOutputStream#hsync()V */
+    JM_STAT_IS_DIR,             /* FileStatus#isDir()Z */
+    JM_STAT_GET_REPLICATION,    /* FileStatus#getReplication()S */
+    JM_STAT_GET_BLOCK_SIZE,     /* FileStatus#getBlockSize()J */
+    JM_STAT_GET_MODIFICATION_TIME, /* FileStatus#getModificationTime()J */
+    JM_STAT_GET_ACCESS_TIME,    /* FileStatus#getAccessTime()J */
+    JM_STAT_GET_LEN,            /* FileStatus#getLen()J */
+    JM_STAT_GET_PATH,           /* FileStatus#getPath()Path */
+    JM_STAT_GET_OWNER,          /* FileStatus#getOwner()String */
+    JM_STAT_GET_GROUP,          /* FileStatus#getGroup()String */
+    JM_STAT_GET_PERMISSION,     /* FileStatus#getPermission()FsPermission */
+    JM_STAT_IS_ENCRYPTED,       /* FileStatus#isEncrypted()Z */
+    JM_PATH_TO_STRING,          /* Path#toString()String */
+    JM_FSPERM_TO_SHORT,         /* FsPermission#toShort()S */
+    NUM_CACHED_METHODS
+} CachedMethod;
+
+/** invokeCachedMethod: Invoke one of the cached instance methods.
+ * Like invokeMethod, for the method the CachedMethod names.
+ */
+jthrowable invokeCachedMethod(JNIEnv *env, jvalue *retval, jobject instObj,
+                 CachedMethod method, ...);
+
 jthrowable constructNewObjectOfClass(JNIEnv *env, jobject *out, const char *className, 
                                   const char *ctorSignature, ...);
 
@@ -36,6 +36,42 @@ extern mutex hdfsHashMutex;
 /** Mutex protecting singleton JVM instance. */
 extern mutex jvmMutex;
 
+/** Mutex protecting the asynchronous read queue. */
+extern mutex hdfsAsyncMutex;
+
+/** Mutex protecting the file status caches. */
+extern mutex hdfsStatCacheMutex;
+
+/** Mutex protecting the pending flags of the read-ahead buffers. */
+extern mutex hdfsReadaheadMutex;
+
+/** Mutex protecting the latency statistics of the file handles. */
+extern mutex hdfsLatencyMutex;
+
+/** Mutex protecting the busy flags of the pread stream pools. */
+extern mutex hdfsPreadPoolMutex;
+
+/** Mutex protecting the table of shared FileSystem connections. */
+extern mutex hdfsSharedFSMutex;
+
+/** Mutex protecting the pieces of parallel positional reads. */
+extern mutex hdfsParallelPreadMutex;
+
+/** Mutex protecting the unbuffer LRU of the input streams. */
+extern mutex hdfsUnbufferMutex;
+
+/** Condition signalled when a read is added to the asynchronous queue. */
+extern condition hdfsAsyncCondition;
+
+/** Condition broadcast when a read-ahead buffer has been filled. */
+extern condition hdfsReadaheadCondition;
+
+/** Condition broadcast when a piece of a parallel positional read is done. */
+extern condition hdfsParallelPreadCondition;
+
+/** Condition broadcast when the unbuffer LRU has unbuffered streams. */
+extern condition hdfsUnbufferCondition;
+
 /**
  * Locks a mutex.
  *
@@ -52,4 +88,29 @@ int mutexLock(mutex *m);
  */
 int mutexUnlock(mutex *m);
 
+/**
+ * Waits on a condition, the mutex must be held and is held again on return.
+ *
+ * @param c condition
+ * @param m mutex
+ * @return 0 if successful, non-zero otherwise
+ */
+int conditionWait(condition *c, mutex *m);
+
+/**
+ * Wakes one thread waiting on a condition.
+ *
+ * @param c condition
+ * @return 0 if successful, non-zero otherwise
+ */
+int conditionSignal(condition *c);
+
+/**
+ * Wakes all threads waiting on a condition.
+ *
+ * @param c condition
+ * @return 0 if successful, non-zero otherwise
+ */
+int conditionBroadcast(condition *c);
+
 #endif
@@ -23,6 +23,18 @@
 
 mutex hdfsHashMutex = PTHREAD_MUTEX_INITIALIZER;
 mutex jvmMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsAsyncMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsStatCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsReadaheadMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsLatencyMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsPreadPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsSharedFSMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsParallelPreadMutex = PTHREAD_MUTEX_INITIALIZER;
+mutex hdfsUnbufferMutex = PTHREAD_MUTEX_INITIALIZER;
+condition hdfsAsyncCondition = PTHREAD_COND_INITIALIZER;
+condition hdfsReadaheadCondition = PTHREAD_COND_INITIALIZER;
+condition hdfsParallelPreadCondition = PTHREAD_COND_INITIALIZER;
+condition hdfsUnbufferCondition = PTHREAD_COND_INITIALIZER;
 
 int mutexLock(mutex *m) {
   int ret = pthread_mutex_lock(m);
@@ -41,3 +53,30 @@ int mutexUnlock(mutex *m) {
   }
   return ret;
 }
+
+int conditionWait(condition *c, mutex *m) {
+  int ret = pthread_cond_wait(c, m);
+  if (ret) {
+    fprintf(stderr, "conditionWait: pthread_cond_wait failed with error %d\n",
+      ret);
+  }
+  return ret;
+}
+
+int conditionSignal(condition *c) {
+  int ret = pthread_cond_signal(c);
+  if (ret) {
+    fprintf(stderr,
+      "conditionSignal: pthread_cond_signal failed with error %d\n", ret);
+  }
+  return ret;
+}
+
+int conditionBroadcast(condition *c) {
+  int ret = pthread_cond_broadcast(c);
+  if (ret) {
+    fprintf(stderr,
+      "conditionBroadcast: pthread_cond_broadcast failed with error %d\n", ret);
+  }
+  return ret;
+}
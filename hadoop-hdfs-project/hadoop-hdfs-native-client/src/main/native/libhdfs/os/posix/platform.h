@@ -25,10 +25,23 @@
 #define TYPE_CHECKED_PRINTF_FORMAT(formatArg, varArgs) \
   __attribute__((format(printf, formatArg, varArgs)))
 
+/*
+ * Pointer loads and stores for data that is read without a lock.  A load that
+ * sees the pointer written by a store also sees every write the storing thread
+ * made before the store.
+ */
+#define atomicLoadPtr(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define atomicStorePtr(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+
 /*
  * Mutex and thread data types defined by pthreads.
  */
 typedef pthread_mutex_t mutex;
 typedef pthread_t threadId;
 
+/*
+ * Condition variable data type defined by pthreads.
+ */
+typedef pthread_cond_t condition;
+
 #endif
@@ -18,10 +18,23 @@
 
 #include "os/mutexes.h"
 
+#include <stdio.h>
 #include <windows.h>
 
 mutex hdfsHashMutex;
 mutex jvmMutex;
+mutex hdfsAsyncMutex;
+mutex hdfsStatCacheMutex;
+mutex hdfsReadaheadMutex;
+mutex hdfsLatencyMutex;
+mutex hdfsPreadPoolMutex;
+mutex hdfsSharedFSMutex;
+mutex hdfsParallelPreadMutex;
+mutex hdfsUnbufferMutex;
+condition hdfsAsyncCondition = CONDITION_VARIABLE_INIT;
+condition hdfsReadaheadCondition = CONDITION_VARIABLE_INIT;
+condition hdfsParallelPreadCondition = CONDITION_VARIABLE_INIT;
+condition hdfsUnbufferCondition = CONDITION_VARIABLE_INIT;
 
 /**
  * Unfortunately, there is no simple static initializer for a critical section.
@@ -36,6 +49,14 @@ mutex jvmMutex;
 static void __cdecl initializeMutexes(void) {
   InitializeCriticalSection(&hdfsHashMutex);
   InitializeCriticalSection(&jvmMutex);
+  InitializeCriticalSection(&hdfsAsyncMutex);
+  InitializeCriticalSection(&hdfsStatCacheMutex);
+  InitializeCriticalSection(&hdfsReadaheadMutex);
+  InitializeCriticalSection(&hdfsLatencyMutex);
+  InitializeCriticalSection(&hdfsPreadPoolMutex);
+  InitializeCriticalSection(&hdfsSharedFSMutex);
+  InitializeCriticalSection(&hdfsParallelPreadMutex);
+  InitializeCriticalSection(&hdfsUnbufferMutex);
 }
 #pragma section(".CRT$XCU", read)
 __declspec(allocate(".CRT$XCU"))
@@ -50,3 +71,23 @@ int mutexUnlock(mutex *m) {
   LeaveCriticalSection(m);
   return 0;
 }
+
+int conditionWait(condition *c, mutex *m) {
+  DWORD ret = 0;
+  if (!SleepConditionVariableCS(c, m, INFINITE)) {
+    ret = GetLastError();
+    fprintf(stderr,
+      "conditionWait: SleepConditionVariableCS failed with error %d\n", ret);
+  }
+  return ret;
+}
+
+int conditionSignal(condition *c) {
+  WakeConditionVariable(c);
+  return 0;
+}
+
+int conditionBroadcast(condition *c) {
+  WakeAllConditionVariable(c);
+  return 0;
+}
@@ -70,6 +70,16 @@
 #define vsnprintf(str, size, format, ...) \
   vsnprintf_s((str), (size), _TRUNCATE, (format), __VA_ARGS__)
 
+/*
+ * Pointer loads and stores for data that is read without a lock.  A load that
+ * sees the pointer written by a store also sees every write the storing thread
+ * made before the store.  The interlocked functions are full barriers.
+ */
+#define atomicLoadPtr(ptr) \
+  InterlockedCompareExchangePointer((PVOID volatile *)(ptr), NULL, NULL)
+#define atomicStorePtr(ptr, val) \
+  ((void)InterlockedExchangePointer((PVOID volatile *)(ptr), (val)))
+
 /*
  * Mutex data type defined as Windows CRITICAL_SECTION.   A critical section (not
  * Windows mutex) is used, because libhdfs only needs synchronization of multiple
@@ -83,4 +93,9 @@ typedef CRITICAL_SECTION mutex;
  */
 typedef HANDLE threadId;
 
+/*
+ * Condition variable data type, waited on with a CRITICAL_SECTION.
+ */
+typedef CONDITION_VARIABLE condition;
+
 #endif
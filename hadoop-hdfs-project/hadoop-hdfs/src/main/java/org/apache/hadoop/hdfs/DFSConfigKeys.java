@@ -317,6 +317,12 @@ public class DFSConfigKeys extends CommonConfigurationKeys {
   public static final String DFS_DATANODE_CACHE_REVOCATION_POLLING_MS = "dfs.datanode.cache.revocation.polling.ms";
   public static final long DFS_DATANODE_CACHE_REVOCATION_POLLING_MS_DEFAULT = 500L;
 
+  public static final String DFS_DATANODE_CACHE_HUGEPAGES_ENABLED_KEY = "dfs.datanode.cache.hugepages.enabled";
+  public static final boolean DFS_DATANODE_CACHE_HUGEPAGES_ENABLED_DEFAULT = false;
+
+  public static final String DFS_DATANODE_CACHE_NUMA_NODE_KEY = "dfs.datanode.cache.numa.node";
+  public static final int DFS_DATANODE_CACHE_NUMA_NODE_DEFAULT = -1;
+
   public static final String DFS_NAMENODE_DATANODE_REGISTRATION_IP_HOSTNAME_CHECK_KEY = "dfs.namenode.datanode.registration.ip-hostname-check";
   public static final boolean DFS_NAMENODE_DATANODE_REGISTRATION_IP_HOSTNAME_CHECK_DEFAULT = true;
 
@@ -475,6 +481,8 @@ public class DFSConfigKeys extends CommonConfigurationKeys {
   public static final int     DFS_DATANODE_DIRECTORYSCAN_INTERVAL_DEFAULT = 21600;
   public static final String  DFS_DATANODE_DIRECTORYSCAN_THREADS_KEY = "dfs.datanode.directoryscan.threads";
   public static final int     DFS_DATANODE_DIRECTORYSCAN_THREADS_DEFAULT = 1;
+  public static final String  DFS_DATANODE_DIRECTORYSCAN_NATIVE_KEY = "dfs.datanode.directoryscan.native";
+  public static final boolean DFS_DATANODE_DIRECTORYSCAN_NATIVE_DEFAULT = true;
 
   public static final String  DFS_DN_EC_RECONSTRUCTION_STRIPED_READ_THREADS_KEY = "dfs.datanode.ec.reconstruction.stripedread.threads";
   public static final int     DFS_DN_EC_RECONSTRUCTION_STRIPED_READ_THREADS_DEFAULT = 20;
@@ -635,6 +643,10 @@ public class DFSConfigKeys extends CommonConfigurationKeys {
   public static final String  DFS_DATANODE_USER_NAME_KEY = DFS_DATANODE_KERBEROS_PRINCIPAL_KEY;
   public static final String  DFS_DATANODE_SHARED_FILE_DESCRIPTOR_PATHS = "dfs.datanode.shared.file.descriptor.paths";
   public static final String  DFS_DATANODE_SHARED_FILE_DESCRIPTOR_PATHS_DEFAULT = "/dev/shm,/tmp";
+  public static final String  DFS_DATANODE_SHARED_MEMORY_MEMFD_ENABLED = "dfs.datanode.shared.memory.memfd.enabled";
+  public static final boolean DFS_DATANODE_SHARED_MEMORY_MEMFD_ENABLED_DEFAULT = false;
+  public static final String  DFS_DATANODE_SHARED_MEMORY_PREALLOCATE = "dfs.datanode.shared.memory.preallocate";
+  public static final int     DFS_DATANODE_SHARED_MEMORY_PREALLOCATE_DEFAULT = 0;
   public static final String
       DFS_SHORT_CIRCUIT_SHARED_MEMORY_WATCHER_INTERRUPT_CHECK_MS =
       HdfsClientConfigKeys
@@ -21,6 +21,7 @@
 import java.io.File;
 import java.io.FilenameFilter;
 import java.io.IOException;
+import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.Collections;
 import java.util.HashMap;
@@ -50,7 +51,9 @@
 import org.apache.hadoop.hdfs.server.datanode.fsdataset.FsDatasetSpi;
 import org.apache.hadoop.hdfs.server.datanode.fsdataset.FsVolumeSpi;
 import org.apache.hadoop.io.IOUtils;
+import org.apache.hadoop.io.nativeio.NativeIO;
 import org.apache.hadoop.util.Daemon;
+import org.apache.hadoop.util.Shell;
 import org.apache.hadoop.util.StopWatch;
 import org.apache.hadoop.util.Time;
 
@@ -76,6 +79,8 @@ public class DirectoryScanner implements Runnable {
   private volatile boolean shouldRun = false;
   private boolean retainDiffs = false;
   private final DataNode datanode;
+  // whether the block directories are listed with NativeIO
+  private final boolean nativeScan;
 
   /**
    * Total combined wall clock time (in milliseconds) spent by the report
@@ -299,12 +304,27 @@ private static String getSuffix(File f, String prefix) {
      * @param vol the volume that contains the block
      */
     ScanInfo(long blockId, File blockFile, File metaFile, FsVolumeSpi vol) {
+      this(blockId, blockFile, blockFile != null ? blockFile.length() : 0,
+          metaFile, vol);
+    }
+
+    /**
+     * Create a ScanInfo object for a block whose data file length is known.
+     *
+     * @param blockId the block ID
+     * @param blockFile the path to the block data file
+     * @param blockFileLength the length of the block data file
+     * @param metaFile the path to the block meta-data file
+     * @param vol the volume that contains the block
+     */
+    ScanInfo(long blockId, File blockFile, long blockFileLength,
+        File metaFile, FsVolumeSpi vol) {
       this.blockId = blockId;
       String condensedVolPath = vol == null ? null :
         getCondensedPath(vol.getBasePath());
       this.blockSuffix = blockFile == null ? null :
         getSuffix(blockFile, condensedVolPath);
-      this.blockFileLength = (blockFile != null) ? blockFile.length() : 0; 
+      this.blockFileLength = blockFileLength;
       if (metaFile == null) {
         this.metaSuffix = null;
       } else if (blockFile == null) {
@@ -445,6 +465,11 @@ public long getGenStamp() {
         conf.getInt(DFSConfigKeys.DFS_DATANODE_DIRECTORYSCAN_THREADS_KEY,
                     DFSConfigKeys.DFS_DATANODE_DIRECTORYSCAN_THREADS_DEFAULT);
 
+    nativeScan =
+        conf.getBoolean(DFSConfigKeys.DFS_DATANODE_DIRECTORYSCAN_NATIVE_KEY,
+            DFSConfigKeys.DFS_DATANODE_DIRECTORYSCAN_NATIVE_DEFAULT)
+        && NativeIO.isAvailable() && !Shell.WINDOWS;
+
     reportCompileThreadPool = Executors.newFixedThreadPool(threads, 
         new Daemon.DaemonFactory());
     masterThread = new ScheduledThreadPoolExecutor(1,
@@ -846,8 +871,21 @@ private LinkedList<ScanInfo> compileReport(FsVolumeSpi vol,
       throttle();
 
       List <String> fileNames;
+      // the types and lengths of the files when listed with NativeIO
+      Map<String, NativeIO.POSIX.DirectoryEntry> entries = null;
       try {
-        fileNames = IOUtils.listDirectory(dir, BlockDirFilter.INSTANCE);
+        if (nativeScan) {
+          entries = new HashMap<>();
+          for (NativeIO.POSIX.DirectoryEntry entry :
+              NativeIO.POSIX.listDirectory(dir)) {
+            if (BlockDirFilter.INSTANCE.accept(dir, entry.getName())) {
+              entries.put(entry.getName(), entry);
+            }
+          }
+          fileNames = new ArrayList<>(entries.keySet());
+        } else {
+          fileNames = IOUtils.listDirectory(dir, BlockDirFilter.INSTANCE);
+        }
       } catch (IOException ioe) {
         LOG.warn("Exception occured while compiling report: ", ioe);
         // Initiate a check on disk failure.
@@ -871,7 +909,9 @@ private LinkedList<ScanInfo> compileReport(FsVolumeSpi vol,
         }
 
         File file = new File(dir, fileNames.get(i));
-        if (file.isDirectory()) {
+        NativeIO.POSIX.DirectoryEntry entry =
+            entries == null ? null : entries.get(file.getName());
+        if (entry == null ? file.isDirectory() : entry.isDirectory()) {
           compileReport(vol, bpFinalizedDir, file, report);
           continue;
         }
@@ -892,7 +932,9 @@ private LinkedList<ScanInfo> compileReport(FsVolumeSpi vol,
         // getting to the metafile for the block
         while (i + 1 < fileNames.size()) {
           File blkMetaFile = new File(dir, fileNames.get(i + 1));
-          if (!(blkMetaFile.isFile()
+          boolean isFile = entries == null ? blkMetaFile.isFile()
+              : entries.get(blkMetaFile.getName()).isFile();
+          if (!(isFile
               && blkMetaFile.getName().startsWith(blockFile.getName()))) {
             break;
           }
@@ -904,7 +946,10 @@ private LinkedList<ScanInfo> compileReport(FsVolumeSpi vol,
         }
         verifyFileLocation(blockFile.getParentFile(), bpFinalizedDir,
             blockId);
-        report.add(new ScanInfo(blockId, blockFile, metaFile, vol));
+        long blockFileLength =
+            entry == null ? blockFile.length() : entry.getLength();
+        report.add(
+            new ScanInfo(blockId, blockFile, blockFileLength, metaFile, vol));
       }
       return report;
     }
@@ -19,6 +19,10 @@
 
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_SHARED_FILE_DESCRIPTOR_PATHS;
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_SHARED_FILE_DESCRIPTOR_PATHS_DEFAULT;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_SHARED_MEMORY_MEMFD_ENABLED;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_SHARED_MEMORY_MEMFD_ENABLED_DEFAULT;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_SHARED_MEMORY_PREALLOCATE;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_SHARED_MEMORY_PREALLOCATE_DEFAULT;
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_SHORT_CIRCUIT_SHARED_MEMORY_WATCHER_INTERRUPT_CHECK_MS;
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_SHORT_CIRCUIT_SHARED_MEMORY_WATCHER_INTERRUPT_CHECK_MS_DEFAULT;
 
@@ -171,8 +175,16 @@ public ShortCircuitRegistry(Configuration conf) throws IOException {
         shmPaths =
             DFS_DATANODE_SHARED_FILE_DESCRIPTOR_PATHS_DEFAULT.split(",");
       }
+      boolean useMemfd = conf.getBoolean(
+          DFS_DATANODE_SHARED_MEMORY_MEMFD_ENABLED,
+          DFS_DATANODE_SHARED_MEMORY_MEMFD_ENABLED_DEFAULT);
       shmFactory = SharedFileDescriptorFactory.
-          create("HadoopShortCircuitShm_", shmPaths);
+          create("HadoopShortCircuitShm_", shmPaths, useMemfd);
+      int preallocate = conf.getInt(DFS_DATANODE_SHARED_MEMORY_PREALLOCATE,
+          DFS_DATANODE_SHARED_MEMORY_PREALLOCATE_DEFAULT);
+      if (preallocate > 0) {
+        shmFactory.preallocate(preallocate, SHM_LENGTH);
+      }
       String dswLoadingFailure = DomainSocketWatcher.getLoadingFailureReason();
       if (dswLoadingFailure != null) {
         throw new IOException(dswLoadingFailure);
@@ -181,12 +193,14 @@ public ShortCircuitRegistry(Configuration conf) throws IOException {
       enabled = true;
       if (LOG.isDebugEnabled()) {
         LOG.debug("created new ShortCircuitRegistry with interruptCheck=" +
-                  interruptCheck + ", shmPath=" + shmFactory.getPath());
+                  interruptCheck + ", shmPath=" +
+                  (shmFactory.isMemfd() ? "memfd" : shmFactory.getPath()));
       }
     } catch (IOException e) {
       if (LOG.isDebugEnabled()) {
         LOG.debug("Disabling ShortCircuitRegistry", e);
       }
+      IOUtils.closeQuietly(shmFactory);
     } finally {
       this.enabled = enabled;
       this.shmFactory = shmFactory;
@@ -390,6 +404,7 @@ public void shutdown() {
       if (!enabled) return;
       enabled = false;
     }
+    IOUtils.closeQuietly(shmFactory);
     IOUtils.closeQuietly(watcher);
   }
 
@@ -22,6 +22,10 @@
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_REVOCATION_TIMEOUT_MS_DEFAULT;
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_REVOCATION_POLLING_MS;
 import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_REVOCATION_POLLING_MS_DEFAULT;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_HUGEPAGES_ENABLED_KEY;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_HUGEPAGES_ENABLED_DEFAULT;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_NUMA_NODE_KEY;
+import static org.apache.hadoop.hdfs.DFSConfigKeys.DFS_DATANODE_CACHE_NUMA_NODE_DEFAULT;
 
 import com.google.common.base.Preconditions;
 import com.google.common.util.concurrent.ThreadFactoryBuilder;
@@ -227,6 +231,17 @@ long get() {
    */
   private final long maxBytes;
 
+  /**
+   * Whether to ask for transparent huge pages for cached blocks.
+   */
+  private final boolean hugePages;
+
+  /**
+   * The NUMA node to place cached blocks on, or -1 to leave them where
+   * they are.
+   */
+  private final int numaNode;
+
   /**
    * Number of cache commands that could not be completed successfully
    */
@@ -268,6 +283,12 @@ public FsDatasetCache(FsDatasetImpl dataset) {
               ".  Reconfigure this to " + minRevocationPollingMs);
     }
     this.revocationPollingMs = confRevocationPollingMs;
+    this.hugePages = dataset.datanode.getConf().getBoolean(
+        DFS_DATANODE_CACHE_HUGEPAGES_ENABLED_KEY,
+        DFS_DATANODE_CACHE_HUGEPAGES_ENABLED_DEFAULT);
+    this.numaNode = dataset.datanode.getConf().getInt(
+        DFS_DATANODE_CACHE_NUMA_NODE_KEY,
+        DFS_DATANODE_CACHE_NUMA_NODE_DEFAULT);
   }
 
   /**
@@ -462,7 +483,8 @@ public void run() {
         }
         try {
           mappableBlock = MappableBlock.
-              load(length, blockIn, metaIn, blockFileName);
+              load(length, blockIn, metaIn, blockFileName, hugePages,
+                  numaNode);
         } catch (ChecksumException e) {
           // Exception message is bogus since this wasn't caused by a file read
           LOG.warn("Failed to cache " + key + ": checksum verification failed.");
@@ -35,6 +35,8 @@
 import org.apache.hadoop.hdfs.server.datanode.BlockMetadataHeader;
 import org.apache.hadoop.io.nativeio.NativeIO;
 import org.apache.hadoop.util.DataChecksum;
+import org.slf4j.Logger;
+import org.slf4j.LoggerFactory;
 
 import com.google.common.annotations.VisibleForTesting;
 import com.google.common.base.Preconditions;
@@ -45,6 +47,9 @@
 @InterfaceAudience.Private
 @InterfaceStability.Unstable
 public class MappableBlock implements Closeable {
+  private static final Logger LOG =
+      LoggerFactory.getLogger(MappableBlock.class);
+
   private MappedByteBuffer mmap;
   private final long length;
 
@@ -75,6 +80,21 @@ public long getLength() {
   public static MappableBlock load(long length,
       FileInputStream blockIn, FileInputStream metaIn,
       String blockFileName) throws IOException {
+    return load(length, blockIn, metaIn, blockFileName, false, -1);
+  }
+
+  /**
+   * Load the block, placing its pages.
+   *
+   * @param hugePages      Whether to ask for transparent huge pages.
+   * @param numaNode       The NUMA node to move the pages to, or -1.
+   *
+   * @see #load(long, FileInputStream, FileInputStream, String)
+   */
+  public static MappableBlock load(long length,
+      FileInputStream blockIn, FileInputStream metaIn,
+      String blockFileName, boolean hugePages, int numaNode)
+      throws IOException {
     MappableBlock mappableBlock = null;
     MappedByteBuffer mmap = null;
     FileChannel blockChannel = null;
@@ -84,7 +104,15 @@ public static MappableBlock load(long length,
         throw new IOException("Block InputStream has no FileChannel.");
       }
       mmap = blockChannel.map(MapMode.READ_ONLY, 0, length);
-      NativeIO.POSIX.getCacheManipulator().mlock(blockFileName, mmap, length);
+      NativeIO.POSIX.CacheManipulator manipulator =
+          NativeIO.POSIX.getCacheManipulator();
+      manipulator.mlock(blockFileName, mmap, length, hugePages, numaNode);
+      if ((hugePages || numaNode >= 0) && LOG.isDebugEnabled()) {
+        LOG.debug("{}: {} of {} bytes resident after placing on node {}",
+            blockFileName,
+            manipulator.getResidentBytes(blockFileName, mmap, length),
+            length, numaNode);
+      }
       verifyChecksum(length, metaIn, blockChannel, blockFileName);
       mappableBlock = new MappableBlock(mmap, length);
     } finally {
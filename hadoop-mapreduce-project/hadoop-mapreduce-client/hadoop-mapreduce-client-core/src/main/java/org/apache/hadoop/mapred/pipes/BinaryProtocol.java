@@ -20,8 +20,11 @@
 
 import java.io.BufferedInputStream;
 import java.io.BufferedOutputStream;
+import java.io.DataInput;
 import java.io.DataInputStream;
+import java.io.DataOutput;
 import java.io.DataOutputStream;
+import java.io.File;
 import java.io.FileOutputStream;
 import java.io.FilterOutputStream;
 import java.io.IOException;
@@ -29,12 +32,14 @@
 import java.io.OutputStream;
 import java.net.Socket;
 import java.util.ArrayList;
+import java.util.Iterator;
 import java.util.List;
 import java.util.Map;
 
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import org.apache.hadoop.io.BytesWritable;
+import org.apache.hadoop.io.DataInputBuffer;
 import org.apache.hadoop.io.DataOutputBuffer;
 import org.apache.hadoop.io.Text;
 import org.apache.hadoop.io.Writable;
@@ -56,9 +61,19 @@
    * The buffer size for the command socket
    */
   private static final int BUFFER_SIZE = 128*1024;
+  /**
+   * The partition of the outputs in an OUTPUT_BATCH that have none
+   */
+  private static final int NO_PARTITION = -1;
 
   private DataOutputStream stream;
   private DataOutputBuffer buffer = new DataOutputBuffer();
+  private final DataOutputBuffer valueBatch = new DataOutputBuffer();
+  private final int reduceBatchBytes;
+  private final OutputStream socketOut;
+  private final int shmBytes;
+  private final File shmDir;
+  private SharedMemoryTransport shm;
   private static final Log LOG = 
     LogFactory.getLog(BinaryProtocol.class.getName());
   private UplinkReaderThread uplink;
@@ -78,6 +93,8 @@ private static enum MessageType { START(0),
                                     CLOSE(8),
                                     ABORT(9),
                                     AUTHENTICATION_REQ(10),
+                                    SHM_TRANSPORT(11),
+                                    REDUCE_VALUES(12),
                                     OUTPUT(50),
                                     PARTITIONED_OUTPUT(51),
                                     STATUS(52),
@@ -85,7 +102,9 @@ private static enum MessageType { START(0),
                                     DONE(54),
                                     REGISTER_COUNTER(55),
                                     INCREMENT_COUNTER(56),
-                                    AUTHENTICATION_RESP(57);
+                                    AUTHENTICATION_RESP(57),
+                                    OUTPUT_BATCH(58),
+                                    SHM_TRANSPORT_ACK(59);
     final int code;
     MessageType(int code) {
       this.code = code;
@@ -96,11 +115,16 @@ private static enum MessageType { START(0),
                                           V2 extends Writable>  
     extends Thread {
     
-    private DataInputStream inStream;
+    private volatile DataInputStream inStream;
+    // The transport to switch to when the child acknowledges it
+    private volatile SharedMemoryTransport shm;
     private UpwardProtocol<K2, V2> handler;
     private K2 key;
     private V2 value;
     private boolean authPending = true;
+    // The last OUTPUT_BATCH read, reused for the next
+    private byte[] batch = new byte[0];
+    private final DataInputBuffer batchIn = new DataInputBuffer();
     
     public UplinkReaderThread(InputStream stream,
                               UpwardProtocol<K2, V2> handler, 
@@ -116,6 +140,10 @@ public void closeConnection() throws IOException {
       inStream.close();
     }
 
+    void setSharedMemory(SharedMemoryTransport shm) {
+      this.shm = shm;
+    }
+
     public void run() {
       while (true) {
         try {
@@ -132,14 +160,27 @@ public void run() {
                 + "complete. Ignoring");
             continue;
           } else if (cmd == MessageType.OUTPUT.code) {
-            readObject(key);
-            readObject(value);
+            readObject(inStream, key);
+            readObject(inStream, value);
             handler.output(key, value);
           } else if (cmd == MessageType.PARTITIONED_OUTPUT.code) {
             int part = WritableUtils.readVInt(inStream);
-            readObject(key);
-            readObject(value);
+            readObject(inStream, key);
+            readObject(inStream, value);
             handler.partitionedOutput(part, key, value);
+          } else if (cmd == MessageType.OUTPUT_BATCH.code) {
+            readBatch();
+          } else if (cmd == MessageType.SHM_TRANSPORT_ACK.code) {
+            if (shm == null) {
+              throw new IOException("Shared memory acknowledged but not " +
+                  "offered");
+            }
+            LOG.debug("Pipe child switched to shared memory");
+            shm.deleteFile();
+            // The socket now only carries doorbells, some of which may
+            // already be buffered in the old stream
+            inStream = new DataInputStream(new BufferedInputStream(
+                shm.getInputStream(inStream), BUFFER_SIZE));
           } else if (cmd == MessageType.STATUS.code) {
             handler.status(Text.readString(inStream));
           } else if (cmd == MessageType.PROGRESS.code) {
@@ -170,22 +211,55 @@ public void run() {
       }
     }
     
-    private void readObject(Writable obj) throws IOException {
-      int numBytes = WritableUtils.readVInt(inStream);
+    /**
+     * Read an OUTPUT_BATCH: the number of outputs and their length in bytes,
+     * then each output as its partition, or NO_PARTITION, its key and its
+     * value.  The batch is read with one call on the socket stream.
+     */
+    private void readBatch() throws IOException {
+      int count = WritableUtils.readVInt(inStream);
+      int length = WritableUtils.readVInt(inStream);
+      if (count < 0 || length < 0) {
+        throw new IOException("Bad output batch of " + count +
+            " outputs in " + length + " bytes");
+      }
+      if (batch.length < length) {
+        batch = new byte[length];
+      }
+      inStream.readFully(batch, 0, length);
+      batchIn.reset(batch, length);
+      for (int i = 0; i < count; i++) {
+        int part = WritableUtils.readVInt(batchIn);
+        readObject(batchIn, key);
+        readObject(batchIn, value);
+        if (part == NO_PARTITION) {
+          handler.output(key, value);
+        } else {
+          handler.partitionedOutput(part, key, value);
+        }
+      }
+      if (batchIn.getPosition() != length) {
+        throw new IOException("Output batch of " + count + " outputs has " +
+            (length - batchIn.getPosition()) + " bytes left over");
+      }
+    }
+
+    private void readObject(DataInput in, Writable obj) throws IOException {
+      int numBytes = WritableUtils.readVInt(in);
       byte[] buffer;
       // For BytesWritable and Text, use the specified length to set the length
       // this causes the "obvious" translations to work. So that if you emit
       // a string "abc" from C++, it shows up as "abc".
       if (obj instanceof BytesWritable) {
         buffer = new byte[numBytes];
-        inStream.readFully(buffer);
+        in.readFully(buffer);
         ((BytesWritable) obj).set(buffer, 0, numBytes);
       } else if (obj instanceof Text) {
         buffer = new byte[numBytes];
-        inStream.readFully(buffer);
+        in.readFully(buffer);
         ((Text) obj).set(buffer);
       } else {
-        obj.readFields(inStream);
+        obj.readFields(in);
       }
     }
   }
@@ -238,10 +312,23 @@ public BinaryProtocol(Socket sock,
                         V2 value,
                         JobConf config) throws IOException {
     OutputStream raw = sock.getOutputStream();
+    socketOut = raw;
+    int bytes = Submitter.getSharedMemoryTransportBytes(config);
     // If we are debugging, save a copy of the downlink commands to a file
     if (Submitter.getKeepCommandFile(config)) {
       raw = new TeeOutputStream("downlink.data", raw);
+      if (bytes > 0) {
+        LOG.info("Not using shared memory, so that the command file is kept");
+        bytes = 0;
+      }
     }
+    if (bytes > 0 && !SharedMemoryTransport.isSupported()) {
+      LOG.warn("Shared memory is not supported, falling back to the socket");
+      bytes = 0;
+    }
+    shmBytes = bytes;
+    shmDir = new File(Submitter.getSharedMemoryTransportDir(config));
+    reduceBatchBytes = Submitter.getReduceBatchBytes(config);
     stream = new DataOutputStream(new BufferedOutputStream(raw, 
                                                            BUFFER_SIZE)) ;
     uplink = new UplinkReaderThread<K2, V2>(sock.getInputStream(),
@@ -261,6 +348,9 @@ public void close() throws IOException, InterruptedException {
     uplink.closeConnection();
     uplink.interrupt();
     uplink.join();
+    if (shm != null) {
+      shm.close();
+    }
   }
   
   public void authenticate(String digest, String challenge)
@@ -276,15 +366,41 @@ public void start() throws IOException {
     LOG.debug("starting downlink");
     WritableUtils.writeVInt(stream, MessageType.START.code);
     WritableUtils.writeVInt(stream, CURRENT_PROTOCOL_VERSION);
+    if (shmBytes > 0) {
+      startSharedMemory();
+    }
+  }
+
+  /**
+   * Offer the child shared memory, and send the messages after this one
+   * through it.  The child answers with SHM_TRANSPORT_ACK once it has
+   * mapped it, and sends its own messages after that through it.
+   */
+  private void startSharedMemory() throws IOException {
+    shm = new SharedMemoryTransport(shmDir, shmBytes, socketOut);
+    LOG.debug("Offering shared memory " + shm.getPath());
+    uplink.setSharedMemory(shm);
+    WritableUtils.writeVInt(stream, MessageType.SHM_TRANSPORT.code);
+    Text.writeString(stream, shm.getPath());
+    WritableUtils.writeVLong(stream, shm.getCapacity());
+    stream.flush();
+    stream = new DataOutputStream(new BufferedOutputStream(
+        shm.getOutputStream(), BUFFER_SIZE));
   }
 
   public void setJobConf(JobConf job) throws IOException {
     WritableUtils.writeVInt(stream, MessageType.SET_JOB_CONF.code);
     List<String> list = new ArrayList<String>();
     for(Map.Entry<String, String> itm: job) {
+      if (Submitter.UPLINK_BATCH_BYTES.equals(itm.getKey())) {
+        continue;
+      }
       list.add(itm.getKey());
       list.add(itm.getValue());
     }
+    // Always sent, since it also tells the child this side reads batches
+    list.add(Submitter.UPLINK_BATCH_BYTES);
+    list.add(Integer.toString(Submitter.getUplinkBatchBytes(job)));
     WritableUtils.writeVInt(stream, list.size());
     for(String entry: list){
       Text.writeString(stream, entry);
@@ -329,6 +445,35 @@ public void reduceValue(Writable value) throws IOException {
     writeObject(value);
   }
 
+  /**
+   * Send the values in REDUCE_VALUES messages of about reduceBatchBytes
+   * each, with the key repeated in each and a flag that says whether
+   * another follows for the same key.
+   */
+  public void reduceValues(K1 key,
+                           Iterator<? extends V1> values) throws IOException {
+    if (reduceBatchBytes <= 0) {
+      reduceKey(key);
+      while (values.hasNext()) {
+        reduceValue(values.next());
+      }
+      return;
+    }
+    boolean more = true;
+    while (more) {
+      valueBatch.reset();
+      do {
+        writeObject(values.next(), valueBatch);
+      } while (valueBatch.getLength() < reduceBatchBytes && values.hasNext());
+      more = values.hasNext();
+      WritableUtils.writeVInt(stream, MessageType.REDUCE_VALUES.code);
+      writeObject(key);
+      WritableUtils.writeVInt(stream, more ? 1 : 0);
+      WritableUtils.writeVInt(stream, valueBatch.getLength());
+      stream.write(valueBatch.getData(), 0, valueBatch.getLength());
+    }
+  }
+
   public void endOfInput() throws IOException {
     WritableUtils.writeVInt(stream, MessageType.CLOSE.code);
     LOG.debug("Sent close command");
@@ -351,24 +496,28 @@ public void flush() throws IOException {
    * @throws IOException
    */
   private void writeObject(Writable obj) throws IOException {
+    writeObject(obj, stream);
+  }
+
+  private void writeObject(Writable obj, DataOutput out) throws IOException {
     // For Text and BytesWritable, encode them directly, so that they end up
     // in C++ as the natural translations.
     if (obj instanceof Text) {
       Text t = (Text) obj;
       int len = t.getLength();
-      WritableUtils.writeVInt(stream, len);
-      stream.write(t.getBytes(), 0, len);
+      WritableUtils.writeVInt(out, len);
+      out.write(t.getBytes(), 0, len);
     } else if (obj instanceof BytesWritable) {
       BytesWritable b = (BytesWritable) obj;
       int len = b.getLength();
-      WritableUtils.writeVInt(stream, len);
-      stream.write(b.getBytes(), 0, len);
+      WritableUtils.writeVInt(out, len);
+      out.write(b.getBytes(), 0, len);
     } else {
       buffer.reset();
       obj.write(buffer);
       int length = buffer.getLength();
-      WritableUtils.writeVInt(stream, length);
-      stream.write(buffer.getData(), 0, length);
+      WritableUtils.writeVInt(out, length);
+      out.write(buffer.getData(), 0, length);
     }
   }
 }
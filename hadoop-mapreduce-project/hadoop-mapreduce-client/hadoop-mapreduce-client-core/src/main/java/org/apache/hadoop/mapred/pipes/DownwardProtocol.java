@@ -19,6 +19,7 @@
 package org.apache.hadoop.mapred.pipes;
 
 import java.io.IOException;
+import java.util.Iterator;
 
 import org.apache.hadoop.io.Writable;
 import org.apache.hadoop.io.WritableComparable;
@@ -97,6 +98,15 @@ void runMap(InputSplit split, int numReduces,
    * @throws IOException
    */
   void reduceValue(V value) throws IOException;
+
+  /**
+   * The reduce should be given a new key and all of its values, which may
+   * be sent together rather than one at a time
+   * @param key the new key
+   * @param values the values of the key, of which there is at least one
+   * @throws IOException
+   */
+  void reduceValues(K key, Iterator<? extends V> values) throws IOException;
   
   /**
    * The task has no more input coming, but it should finish processing it's 
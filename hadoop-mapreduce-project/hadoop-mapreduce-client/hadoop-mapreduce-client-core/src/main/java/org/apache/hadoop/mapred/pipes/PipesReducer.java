@@ -62,10 +62,7 @@ public void reduce(K2 key, Iterator<V2> values,
                      ) throws IOException {
     isOk = false;
     startApplication(output, reporter);
-    downlink.reduceKey(key);
-    while (values.hasNext()) {
-      downlink.reduceValue(values.next());
-    }
+    downlink.reduceValues(key, values);
     if(skipping) {
       //flush the streams on every record input if running in skip mode
       //so that we don't buffer other records surrounding a bad record.
@@ -0,0 +1,339 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.hadoop.mapred.pipes;
+
+import java.io.Closeable;
+import java.io.File;
+import java.io.IOException;
+import java.io.InputStream;
+import java.io.InterruptedIOException;
+import java.io.OutputStream;
+import java.io.RandomAccessFile;
+import java.lang.reflect.Field;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel.MapMode;
+import java.nio.file.Files;
+import java.nio.file.attribute.PosixFilePermissions;
+
+import org.apache.commons.logging.Log;
+import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.io.nativeio.NativeIO;
+
+import sun.misc.Unsafe;
+
+import com.google.common.base.Preconditions;
+
+/**
+ * Rings of shared memory that carry the binary protocol in place of the
+ * socket, so that the messages are copied once each way without a system
+ * call per buffer.
+ *
+ * The memory is a file that the child maps, holding the downward ring and
+ * then the upward ring.  Each is a single producer, single consumer ring
+ * whose header must match ShmRing in HadoopPipes.cc.  A side that has to
+ * wait for bytes or space says so in the header, and the other side then
+ * sends it a byte over the socket, which carries nothing else once the
+ * rings are in use.
+ */
+class SharedMemoryTransport implements Closeable {
+  private static final Log LOG =
+    LogFactory.getLog(SharedMemoryTransport.class.getName());
+
+  static final int HEADER_SIZE = 256;
+  private static final int HEAD = 0;
+  private static final int TAIL = 64;
+  private static final int READER_WAITING = 128;
+  private static final int WRITER_WAITING = 192;
+  /**
+   * How long the writer waits for space before looking again, since the
+   * uplink thread only reads the child's doorbells when it is idle
+   */
+  private static final long SPACE_WAIT_MS = 10;
+
+  private static final Unsafe unsafe = safetyDance();
+
+  private static Unsafe safetyDance() {
+    try {
+      Field f = Unsafe.class.getDeclaredField("theUnsafe");
+      f.setAccessible(true);
+      return (Unsafe)f.get(null);
+    } catch (Throwable e) {
+      LOG.error("failed to load misc.Unsafe", e);
+    }
+    return null;
+  }
+
+  private static final long BYTE_ARRAY_OFFSET =
+    unsafe == null ? 0 : unsafe.arrayBaseOffset(byte[].class);
+
+  /**
+   * @return true if shared memory can be used in this JVM
+   */
+  static boolean isSupported() {
+    return unsafe != null;
+  }
+
+  private final File file;
+  private final MappedByteBuffer buffer;
+  private final long address;
+  private final int capacity;
+  private final OutputStream doorbell;
+  private final Object space = new Object();
+  private final RingOutputStream out;
+
+  /**
+   * Create the memory for a child.
+   * @param dir The directory to create it in, which should be a tmpfs.
+   * @param capacity The size of each ring, a power of 2.
+   * @param doorbell The socket to the child.
+   */
+  SharedMemoryTransport(File dir, int capacity, OutputStream doorbell)
+      throws IOException {
+    Preconditions.checkState(isSupported(), "misc.Unsafe is not available");
+    Preconditions.checkArgument(capacity >= 4096 &&
+        Integer.bitCount(capacity) == 1,
+        "ring size " + capacity + " is not a power of 2 of at least 4096");
+    this.capacity = capacity;
+    this.doorbell = doorbell;
+    // only the task's user, whom the child runs as, may map the rings
+    file = Files.createTempFile(dir.toPath(), "pipes-shm-", null,
+        PosixFilePermissions.asFileAttribute(
+            PosixFilePermissions.fromString("rw-------"))).toFile();
+    file.deleteOnExit();
+    long length = 2L * (HEADER_SIZE + capacity);
+    MappedByteBuffer mapped;
+    RandomAccessFile raf = null;
+    try {
+      raf = new RandomAccessFile(file, "rw");
+      raf.setLength(length);
+      mapped = raf.getChannel().map(MapMode.READ_WRITE, 0, length);
+    } catch (IOException e) {
+      file.delete();
+      throw e;
+    } finally {
+      if (raf != null) {
+        raf.close();
+      }
+    }
+    buffer = mapped;
+    address = ((sun.nio.ch.DirectBuffer) buffer).address();
+    out = new RingOutputStream(address);
+  }
+
+  String getPath() {
+    return file.getAbsolutePath();
+  }
+
+  int getCapacity() {
+    return capacity;
+  }
+
+  /**
+   * @return the stream of the downward ring
+   */
+  OutputStream getOutputStream() {
+    return out;
+  }
+
+  /**
+   * @param doorbellIn the socket from the child, already positioned after
+   *          the child's last message on it
+   * @return the stream of the upward ring
+   */
+  InputStream getInputStream(InputStream doorbellIn) {
+    return new RingInputStream(address + HEADER_SIZE + capacity, doorbellIn);
+  }
+
+  /**
+   * Remove the file, once the child has mapped it.
+   */
+  void deleteFile() {
+    if (!file.delete() && file.exists()) {
+      LOG.warn("failed to delete " + file);
+    }
+  }
+
+  /**
+   * Unmap the memory.  Neither stream may be used after this.
+   */
+  @Override
+  public void close() {
+    deleteFile();
+    NativeIO.POSIX.munmap(buffer);
+  }
+
+  private void ring() throws IOException {
+    synchronized (doorbell) {
+      doorbell.write(0);
+      doorbell.flush();
+    }
+  }
+
+  /**
+   * Ring the other side, if it said it was waiting.
+   */
+  private void wake(long flag) throws IOException {
+    if (unsafe.getIntVolatile(null, flag) == 1 &&
+        unsafe.compareAndSwapInt(null, flag, 1, 0)) {
+      ring();
+    }
+  }
+
+  /**
+   * Writes the downward ring, publishing every write.  It is meant to be
+   * wrapped in a buffered stream so that the writes are large.
+   */
+  private class RingOutputStream extends OutputStream {
+    private final long header;
+    private final long data;
+    private long position = 0;
+
+    RingOutputStream(long header) {
+      this.header = header;
+      this.data = header + HEADER_SIZE;
+    }
+
+    @Override
+    public void write(int b) throws IOException {
+      write(new byte[] { (byte) b }, 0, 1);
+    }
+
+    @Override
+    public void write(byte[] b, int off, int len) throws IOException {
+      while (len > 0) {
+        long free = capacity -
+            (position - unsafe.getLongVolatile(null, header + TAIL));
+        if (free == 0) {
+          waitForSpace();
+          continue;
+        }
+        int offset = (int) (position & (capacity - 1));
+        int n = (int) Math.min(Math.min(free, len), capacity - offset);
+        unsafe.copyMemory(b, BYTE_ARRAY_OFFSET + off, null, data + offset, n);
+        position += n;
+        off += n;
+        len -= n;
+      }
+      unsafe.putLongVolatile(null, header + HEAD, position);
+      wake(header + READER_WAITING);
+    }
+
+    private void waitForSpace() throws IOException {
+      unsafe.putLongVolatile(null, header + HEAD, position);
+      wake(header + READER_WAITING);
+      // Say so before looking again, so that either this sees the space or
+      // the child sees the flag and rings
+      unsafe.putIntVolatile(null, header + WRITER_WAITING, 1);
+      if (position - unsafe.getLongVolatile(null, header + TAIL) < capacity) {
+        return;
+      }
+      synchronized (space) {
+        try {
+          space.wait(SPACE_WAIT_MS);
+        } catch (InterruptedException e) {
+          Thread.currentThread().interrupt();
+          throw new InterruptedIOException("interrupted waiting for space " +
+              "in the shared memory ring");
+        }
+      }
+    }
+
+    @Override
+    public void close() throws IOException {
+      // Closing the socket tells the child there is no more
+      doorbell.close();
+    }
+  }
+
+  /**
+   * Reads the upward ring.  The position read to is published every
+   * quarter of the ring and before waiting.
+   */
+  private class RingInputStream extends InputStream {
+    private final long header;
+    private final long data;
+    private final InputStream doorbellIn;
+    private long position = 0;
+    private long published = 0;
+
+    RingInputStream(long header, InputStream doorbellIn) {
+      this.header = header;
+      this.data = header + HEADER_SIZE;
+      this.doorbellIn = doorbellIn;
+    }
+
+    @Override
+    public int read() throws IOException {
+      byte[] b = new byte[1];
+      return read(b, 0, 1) == -1 ? -1 : (b[0] & 0xff);
+    }
+
+    @Override
+    public int read(byte[] b, int off, int len) throws IOException {
+      if (len == 0) {
+        return 0;
+      }
+      long available;
+      while ((available =
+          unsafe.getLongVolatile(null, header + HEAD) - position) == 0) {
+        if (!waitForBytes()) {
+          return -1;
+        }
+      }
+      int offset = (int) (position & (capacity - 1));
+      int n = (int) Math.min(Math.min(available, len), capacity - offset);
+      unsafe.copyMemory(null, data + offset, b, BYTE_ARRAY_OFFSET + off, n);
+      position += n;
+      if (position - published >= capacity / 4) {
+        publish();
+      }
+      return n;
+    }
+
+    private void publish() throws IOException {
+      unsafe.putLongVolatile(null, header + TAIL, position);
+      published = position;
+      wake(header + WRITER_WAITING);
+    }
+
+    /**
+     * @return false if the child closed the socket
+     */
+    private boolean waitForBytes() throws IOException {
+      if (published != position) {
+        publish();
+      }
+      unsafe.putIntVolatile(null, header + READER_WAITING, 1);
+      if (unsafe.getLongVolatile(null, header + HEAD) != position) {
+        return true;
+      }
+      int ch = doorbellIn.read();
+      // The child may have rung for space in the downward ring
+      synchronized (space) {
+        space.notifyAll();
+      }
+      return ch != -1;
+    }
+
+    @Override
+    public void close() throws IOException {
+      doorbellIn.close();
+    }
+  }
+}
@@ -83,6 +83,20 @@ public class Submitter extends Configured implements Tool {
   public static final String PARTITIONER = "mapreduce.pipes.partitioner";
   public static final String INPUT_FORMAT = "mapreduce.pipes.inputformat";
   public static final String PORT = "mapreduce.pipes.command.port";
+  public static final String UPLINK_BATCH_BYTES =
+    "mapreduce.pipes.uplink.batch.bytes";
+  public static final int DEFAULT_UPLINK_BATCH_BYTES = 64 * 1024;
+  public static final String MAP_THREADS = "mapreduce.pipes.map.threads";
+  public static final String SHM_TRANSPORT_BYTES =
+    "mapreduce.pipes.shm.transport.bytes";
+  public static final String SHM_TRANSPORT_DIR =
+    "mapreduce.pipes.shm.transport.dir";
+  public static final String DEFAULT_SHM_TRANSPORT_DIR = "/dev/shm";
+  public static final String REDUCE_BATCH_BYTES =
+    "mapreduce.pipes.reduce.batch.bytes";
+  public static final String COUNTER_FLUSH_MS =
+    "mapreduce.pipes.counter.flush.ms";
+  public static final int DEFAULT_COUNTER_FLUSH_MS = 1000;
   
   public Submitter() {
     this(new Configuration());
@@ -183,6 +197,117 @@ public static boolean getIsJavaRecordWriter(JobConf conf) {
     return conf.getBoolean(Submitter.IS_JAVA_RW, false);
   }
 
+  /**
+   * Set how many bytes of output the C++ child batches into each message it
+   * sends.  0 sends every output in a message of its own.
+   * @param conf the configuration to modify
+   * @param value the new value to set
+   */
+  public static void setUplinkBatchBytes(JobConf conf, int value) {
+    conf.setInt(Submitter.UPLINK_BATCH_BYTES, value);
+  }
+
+  /**
+   * How many bytes of output does the C++ child batch into each message?
+   * @param conf the configuration to check
+   * @return the batch size in bytes, or 0 if outputs are not batched
+   */
+  public static int getUplinkBatchBytes(JobConf conf) {
+    return Math.max(0, conf.getInt(Submitter.UPLINK_BATCH_BYTES,
+                                   DEFAULT_UPLINK_BATCH_BYTES));
+  }
+
+  /**
+   * Set how many threads the C++ child runs the mapper on, each with its
+   * own instance of the mapper.  The mapper must then be safe to run
+   * alongside copies of itself.
+   * @param conf the configuration to modify
+   * @param value the new value to set
+   */
+  public static void setMapThreads(JobConf conf, int value) {
+    conf.setInt(Submitter.MAP_THREADS, value);
+  }
+
+  /**
+   * How many threads does the C++ child run the mapper on?
+   * @param conf the configuration to check
+   * @return the number of threads
+   */
+  public static int getMapThreads(JobConf conf) {
+    return conf.getInt(Submitter.MAP_THREADS, 1);
+  }
+
+  /**
+   * Set the size of the shared memory rings that carry the messages between
+   * the task and the C++ child in place of the socket.  It must be a power
+   * of 2 of at least 4096, and the child must be linked against a version
+   * of the pipes library that supports them.
+   * @param conf the configuration to modify
+   * @param value the size of each ring in bytes, or 0 to use the socket
+   */
+  public static void setSharedMemoryTransportBytes(JobConf conf, int value) {
+    conf.setInt(Submitter.SHM_TRANSPORT_BYTES, value);
+  }
+
+  /**
+   * How big are the shared memory rings between the task and the C++ child?
+   * @param conf the configuration to check
+   * @return the size of each ring, or 0 if the socket is used
+   */
+  public static int getSharedMemoryTransportBytes(JobConf conf) {
+    return conf.getInt(Submitter.SHM_TRANSPORT_BYTES, 0);
+  }
+
+  /**
+   * Which directory is the shared memory created in?  It should be a tmpfs,
+   * so that the rings are never written back to a disk.
+   * @param conf the configuration to check
+   * @return the directory
+   */
+  public static String getSharedMemoryTransportDir(JobConf conf) {
+    return conf.get(Submitter.SHM_TRANSPORT_DIR, DEFAULT_SHM_TRANSPORT_DIR);
+  }
+
+  /**
+   * Set how many bytes of values the task packs into each message to a C++
+   * reducer, instead of sending each value in its own message.  The child
+   * must be linked against a version of the pipes library that reads them.
+   * @param conf the configuration to modify
+   * @param value the size of each batch in bytes, or 0 to send the values
+   *          one at a time
+   */
+  public static void setReduceBatchBytes(JobConf conf, int value) {
+    conf.setInt(Submitter.REDUCE_BATCH_BYTES, value);
+  }
+
+  /**
+   * How many bytes of values are sent to a C++ reducer in each message?
+   * @param conf the configuration to check
+   * @return the size of each batch, or 0 if the values are sent one at a time
+   */
+  public static int getReduceBatchBytes(JobConf conf) {
+    return conf.getInt(Submitter.REDUCE_BATCH_BYTES, 0);
+  }
+
+  /**
+   * Set how often the C++ child sends the counter increments it has added
+   * up, rather than sending each increment as it is made.
+   * @param conf the configuration to modify
+   * @param value the interval in milliseconds, or 0 to send every increment
+   */
+  public static void setCounterFlushMillis(JobConf conf, int value) {
+    conf.setInt(Submitter.COUNTER_FLUSH_MS, value);
+  }
+
+  /**
+   * How often does the C++ child send its counter increments?
+   * @param conf the configuration to check
+   * @return the interval in milliseconds, or 0 if every increment is sent
+   */
+  public static int getCounterFlushMillis(JobConf conf) {
+    return conf.getInt(Submitter.COUNTER_FLUSH_MS, DEFAULT_COUNTER_FLUSH_MS);
+  }
+
   /**
    * Set the configuration, if it doesn't already have a value for the given
    * key.
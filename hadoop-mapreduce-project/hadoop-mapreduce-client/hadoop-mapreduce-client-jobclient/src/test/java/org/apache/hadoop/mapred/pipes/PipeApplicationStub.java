@@ -19,6 +19,7 @@
 package org.apache.hadoop.mapred.pipes;
 
 
+import org.apache.hadoop.io.DataOutputBuffer;
 import org.apache.hadoop.io.IntWritable;
 import org.apache.hadoop.io.Text;
 import org.apache.hadoop.io.WritableUtils;
@@ -51,6 +52,18 @@ public void binaryProtocolStub() {
       writeObject(wt, dataOut);
       writeObject(new Text("value"), dataOut);
 
+      // OUTPUT_BATCH of one output without a partition and one with
+      DataOutputBuffer batch = new DataOutputBuffer();
+      WritableUtils.writeVInt(batch, -1);
+      writeObject(wt, batch);
+      writeObject(new Text("value"), batch);
+      WritableUtils.writeVInt(batch, 0);
+      writeObject(wt, batch);
+      writeObject(new Text("value"), batch);
+      WritableUtils.writeVInt(dataOut, 58);
+      WritableUtils.writeVInt(dataOut, 2);
+      WritableUtils.writeVInt(dataOut, batch.getLength());
+      dataOut.write(batch.getData(), 0, batch.getLength());
 
       // STATUS
       WritableUtils.writeVInt(dataOut, 52);
@@ -20,6 +20,7 @@
 
 
 import org.apache.hadoop.io.BooleanWritable;
+import org.apache.hadoop.io.DataInputBuffer;
 import org.apache.hadoop.io.Text;
 import org.apache.hadoop.io.WritableUtils;
 
@@ -46,20 +47,41 @@ public void binaryProtocolStub() {
       int intValue = WritableUtils.readVInt(dataInput);
       System.out.println("getIsJavaRecordWriter:" + intValue);
 
-      // reduce key
-      WritableUtils.readVInt(dataInput);
+      // reduce key, or a batch of values
+      intValue = WritableUtils.readVInt(dataInput);
       // value of reduce key
       BooleanWritable value = new BooleanWritable();
       readObject(value, dataInput);
       System.out.println("reducer key :" + value);
-      // reduce value code:
-
-      // reduce values
-      while ((intValue = WritableUtils.readVInt(dataInput)) == 7) {
-        Text txt = new Text();
-        // value
-        readObject(txt, dataInput);
-        System.out.println("reduce value  :" + txt);
+
+      if (intValue == 12) {
+        // batches of values, each of which repeats the key
+        boolean more = true;
+        while (more) {
+          more = WritableUtils.readVInt(dataInput) == 1;
+          byte[] batch = new byte[WritableUtils.readVInt(dataInput)];
+          dataInput.readFully(batch);
+          DataInputBuffer values = new DataInputBuffer();
+          values.reset(batch, batch.length);
+          while (values.getPosition() < batch.length) {
+            Text txt = new Text();
+            readObject(txt, values);
+            System.out.println("reduce value  :" + txt);
+          }
+          System.out.println("reduce batch more :" + more);
+          if (more) {
+            WritableUtils.readVInt(dataInput);
+            readObject(value, dataInput);
+          }
+        }
+      } else {
+        // reduce values
+        while ((intValue = WritableUtils.readVInt(dataInput)) == 7) {
+          Text txt = new Text();
+          // value
+          readObject(txt, dataInput);
+          System.out.println("reduce value  :" + txt);
+        }
       }
 
 
@@ -219,6 +219,8 @@ public void testApplication() throws Throwable {
               .iterator().next();
       assertEquals(123, entry.getKey().get());
       assertEquals("value", entry.getValue().toString());
+      // test MessageType.OUTPUT_BATCH
+      assertEquals(4, output.getCollectCount());
       try {
         // try to abort
         application.abort(new Throwable());
@@ -436,6 +438,59 @@ public void testPipesReduser() throws Exception {
 
   }
 
+  /**
+   * test PipesReducer sending the values in batches
+   */
+  @Test
+  public void testPipesReducerBatch() throws Exception {
+
+    File[] psw = cleanTokenPasswordFile();
+    JobConf conf = new JobConf();
+    try {
+      Token<AMRMTokenIdentifier> token = new Token<AMRMTokenIdentifier>(
+              "user".getBytes(), "password".getBytes(), new Text("kind"), new Text(
+              "service"));
+      TokenCache.setJobToken(token, conf.getCredentials());
+
+      File fCommand = getFileCommand("org.apache.hadoop.mapred.pipes.PipeReducerStub");
+      conf.set(MRJobConfig.CACHE_LOCALFILES, fCommand.getAbsolutePath());
+      // "first" and "second" fill the first batch
+      Submitter.setReduceBatchBytes(conf, 10);
+
+      PipesReducer<BooleanWritable, Text, IntWritable, Text> reducer = new PipesReducer<BooleanWritable, Text, IntWritable, Text>();
+      reducer.configure(conf);
+      BooleanWritable bw = new BooleanWritable(true);
+
+      conf.set(MRJobConfig.TASK_ATTEMPT_ID, taskName);
+      initStdOut(conf);
+      CombineOutputCollector<IntWritable, Text> output = new CombineOutputCollector<IntWritable, Text>(
+              new Counters.Counter(), new Progress());
+      Reporter reporter = new TestTaskReporter();
+      List<Text> texts = new ArrayList<Text>();
+      texts.add(new Text("first"));
+      texts.add(new Text("second"));
+      texts.add(new Text("third"));
+
+      reducer.reduce(bw, texts.iterator(), output, reporter);
+      reducer.close();
+      String stdOut = readStdOut(conf);
+      assertTrue(stdOut.contains("reducer key :true"));
+      assertTrue(stdOut.contains("reduce value  :first\n" +
+          "reduce value  :second\nreduce batch more :true"));
+      assertTrue(stdOut.contains("reduce value  :third\n" +
+          "reduce batch more :false"));
+
+    } finally {
+      if (psw != null) {
+        // remove password files
+        for (File file : psw) {
+          file.deleteOnExit();
+        }
+      }
+    }
+
+  }
+
   /**
    * test PipesPartitioner
    * test set and get data from  PipesPartitioner
@@ -732,6 +787,7 @@ private class FakeCollector extends
           CombineOutputCollector<IntWritable, Text> {
 
     final private Map<IntWritable, Text> collect = new HashMap<IntWritable, Text>();
+    private int collectCount = 0;
 
     public FakeCollector(Counter outCounter, Progressable progressable) {
       super(outCounter, progressable);
@@ -741,11 +797,16 @@ public FakeCollector(Counter outCounter, Progressable progressable) {
     public synchronized void collect(IntWritable key, Text value)
             throws IOException {
       collect.put(key, value);
+      collectCount++;
       super.collect(key, value);
     }
 
     public Map<IntWritable, Text> getCollect() {
       return collect;
     }
+
+    public synchronized int getCollectCount() {
+      return collectCount;
+    }
   }
 }
@@ -45,4 +45,6 @@ public class Constants {
   public static final String NATIVE_CLASS_LIBRARY_CUSTOM = "native.class.library.custom";
   public static final String NATIVE_CLASS_LIBRARY_BUILDIN = "native.class.library.buildin";
   public static final String NATIVE_MAPOUT_KEY_COMPARATOR = "native.map.output.key.comparator";
+  public static final String NATIVE_PARTITIONER_HASH = "native.partitioner.hash";
+  public static final String NATIVE_PARTITIONER_SPLIT_POINTS = "native.partitioner.split.points";
 }
@@ -244,8 +244,9 @@ private void flushOutput(int length) throws IOException {
 
   /**
    * Load data from native
+   * @return length of the data left in the input buffer
    */
-  private native void nativeLoadData(long handler);
+  private native int nativeLoadData(long handler);
 
   protected void finishOutput() {
   }
@@ -262,9 +263,12 @@ public OutputBuffer getOutputBuffer() {
 
   @Override
   public void loadData() throws IOException {
-    nativeLoadData(nativeHandlerAddr);
-    //
-    // return call(Command.CMD_LOAD, param);
+    // native side only calls flushOutput when the buffer fills up, the
+    // last chunk of the load is returned instead of flushed
+    final int length = nativeLoadData(nativeHandlerAddr);
+    if (length > 0) {
+      flushOutput(length);
+    }
   }
 
   @Override
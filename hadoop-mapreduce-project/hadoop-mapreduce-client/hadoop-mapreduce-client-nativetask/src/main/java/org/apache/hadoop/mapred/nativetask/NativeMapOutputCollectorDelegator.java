@@ -17,6 +17,10 @@
  */
 package org.apache.hadoop.mapred.nativetask;
 
+import java.io.BufferedOutputStream;
+import java.io.DataOutputStream;
+import java.io.File;
+import java.io.FileOutputStream;
 import java.io.IOException;
 
 import com.google.common.base.Charsets;
@@ -24,7 +28,15 @@
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import org.apache.hadoop.classification.InterfaceAudience;
+import org.apache.hadoop.fs.FileSystem;
+import org.apache.hadoop.fs.Path;
+import org.apache.hadoop.io.BytesWritable;
+import org.apache.hadoop.io.IOUtils;
+import org.apache.hadoop.io.NullWritable;
 import org.apache.hadoop.io.RawComparator;
+import org.apache.hadoop.io.SequenceFile;
+import org.apache.hadoop.io.Text;
+import org.apache.hadoop.io.Writable;
 import org.apache.hadoop.mapred.InvalidJobConfException;
 import org.apache.hadoop.mapred.JobConf;
 import org.apache.hadoop.mapred.MapOutputCollector;
@@ -35,7 +47,10 @@
 import org.apache.hadoop.mapreduce.MRConfig;
 import org.apache.hadoop.mapreduce.MRJobConfig;
 import org.apache.hadoop.mapreduce.TaskCounter;
+import org.apache.hadoop.mapreduce.lib.partition.HashPartitioner;
+import org.apache.hadoop.mapreduce.lib.partition.TotalOrderPartitioner;
 import org.apache.hadoop.util.QuickSort;
+import org.apache.hadoop.util.ReflectionUtils;
 
 /**
  * native map output collector wrapped in Java interface
@@ -127,6 +142,14 @@ public void init(Context context) throws IOException, ClassNotFoundException {
       throw new IOException(message);
     }
 
+    // the native collector partitions the records itself, they are then
+    // sent without the partition id
+    job.setBoolean(Constants.NATIVE_PARTITIONER_HASH, isHashPartitioned(job, keyCls));
+    if (isTotalOrderPartitioned(job)) {
+      job.set(Constants.NATIVE_PARTITIONER_SPLIT_POINTS,
+          writeSplitPoints(job, keyCls, context.getMapTask().getTaskID()));
+    }
+
     final boolean ret = NativeRuntime.isNativeLibraryLoaded();
     if (ret) {
       if (job.getBoolean(MRJobConfig.MAP_OUTPUT_COMPRESS, false)) {
@@ -168,4 +191,67 @@ public void init(Context context) throws IOException, ClassNotFoundException {
     LOG.info("Native output collector can be successfully enabled!");
   }
 
+  /**
+   * whether the map output is partitioned by the default HashPartitioner
+   * over keys the native side hashes the same way
+   */
+  private static boolean isHashPartitioned(JobConf job, Class<?> keyCls) {
+    if (keyCls != Text.class && keyCls != BytesWritable.class) {
+      return false;
+    }
+    if (job.getUseNewMapper()) {
+      return HashPartitioner.class.getName().equals(
+          job.get(MRJobConfig.PARTITIONER_CLASS_ATTR, HashPartitioner.class.getName()));
+    }
+    return org.apache.hadoop.mapred.lib.HashPartitioner.class == job.getPartitionerClass();
+  }
+
+  /**
+   * whether the map output is partitioned by a TotalOrderPartitioner, the
+   * native side then searches its split points with the native comparator
+   */
+  private static boolean isTotalOrderPartitioned(JobConf job) {
+    if (job.getUseNewMapper()) {
+      return TotalOrderPartitioner.class.getName().equals(
+          job.get(MRJobConfig.PARTITIONER_CLASS_ATTR));
+    }
+    return org.apache.hadoop.mapred.lib.TotalOrderPartitioner.class == job.getPartitionerClass();
+  }
+
+  /**
+   * copy the split points of the TotalOrderPartitioner partition file to a
+   * local file of the task, each key as its int length and native
+   * serialization
+   * @return path of the local file
+   */
+  private static String writeSplitPoints(JobConf job, Class<?> keyCls, TaskAttemptID id)
+      throws IOException {
+    final Path partitionFile = new Path(TotalOrderPartitioner.getPartitionFile(job));
+    final FileSystem fs = TotalOrderPartitioner.DEFAULT_PATH.equals(partitionFile.toString())
+        ? FileSystem.getLocal(job) : partitionFile.getFileSystem(job);
+    final INativeSerializer<Writable> serializer =
+        NativeSerialization.getInstance().getSerializer(keyCls);
+    final Writable key = (Writable) ReflectionUtils.newInstance(keyCls, job);
+    final File splitPoints = new File("nativetask-" + id + ".splits").getAbsoluteFile();
+    SequenceFile.Reader reader = null;
+    DataOutputStream out = null;
+    int count = 0;
+    try {
+      reader = new SequenceFile.Reader(fs, partitionFile, job);
+      out = new DataOutputStream(new BufferedOutputStream(new FileOutputStream(splitPoints)));
+      while (reader.next(key, NullWritable.get())) {
+        out.writeInt(serializer.getLength(key));
+        serializer.serialize(key, out);
+        count++;
+      }
+      out.close();
+      out = null;
+    } finally {
+      IOUtils.cleanup(LOG, reader, out);
+    }
+    LOG.info("Native output collector partitions with " + count + " split points of "
+        + partitionFile);
+    return splitPoints.getPath();
+  }
+
 }
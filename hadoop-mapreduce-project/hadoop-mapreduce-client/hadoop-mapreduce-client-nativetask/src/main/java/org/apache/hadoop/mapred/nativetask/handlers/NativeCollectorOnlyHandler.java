@@ -29,6 +29,7 @@
 import org.apache.hadoop.mapred.TaskAttemptID;
 import org.apache.hadoop.mapred.nativetask.Command;
 import org.apache.hadoop.mapred.nativetask.CommandDispatcher;
+import org.apache.hadoop.mapred.nativetask.Constants;
 import org.apache.hadoop.mapred.nativetask.DataChannel;
 import org.apache.hadoop.mapred.nativetask.ICombineHandler;
 import org.apache.hadoop.mapred.nativetask.INativeHandler;
@@ -61,6 +62,8 @@
   private ICombineHandler combinerHandler = null;
   private final BufferPusher<K, V> kvPusher;
   private final INativeHandler nativeHandler;
+  // the native collector computes the partitions
+  private final boolean hashPartitioned;
   private boolean closed = false;
 
   public static <K, V> NativeCollectorOnlyHandler<K, V> create(TaskContext context)
@@ -105,11 +108,18 @@ protected NativeCollectorOnlyHandler(TaskContext context, INativeHandler nativeH
     this.combinerHandler = combiner;
     this.kvPusher = kvPusher;
     this.nativeHandler = nativeHandler;
+    // the native collector partitions the records itself
+    this.hashPartitioned = conf.getBoolean(Constants.NATIVE_PARTITIONER_HASH, false)
+        || conf.get(Constants.NATIVE_PARTITIONER_SPLIT_POINTS) != null;
     nativeHandler.setCommandDispatcher(this);
   }
 
   public void collect(K key, V value, int partition) throws IOException {
-    kvPusher.collect(key, value, partition);
+    if (hashPartitioned) {
+      kvPusher.collect(key, value);
+    } else {
+      kvPusher.collect(key, value, partition);
+    }
   };
 
   public void flush() throws IOException {
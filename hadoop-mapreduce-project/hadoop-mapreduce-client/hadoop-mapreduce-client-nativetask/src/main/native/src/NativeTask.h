@@ -71,24 +71,69 @@ enum Endium {
 
 #define NATIVE_SORT_TYPE "native.sort.type"
 #define MAPRED_SORT_AVOID "mapreduce.sort.avoidance"
+#define NATIVE_SORT_ORDER "native.sort.order"
 #define NATIVE_SORT_MAX_BLOCK_SIZE "native.sort.blocksize.max"
+#define NATIVE_SORT_THREADS "native.sort.threads"
+#define NATIVE_SORT_COMPACT_HEADERS "native.sort.compact.headers"
+#define NATIVE_SORT_AUTOTUNE "native.sort.autotune"
+#define NATIVE_SORT_AUTOTUNE_RECORD_BYTES "native.sort.autotune.record.bytes"
+#define NATIVE_SORT_AUTOTUNE_PARTITION_SKEW "native.sort.autotune.partition.skew"
+#define NATIVE_SPILL_ASYNC "native.spill.async"
+#define NATIVE_SPILL_PREFIX_KEYS "native.spill.prefix.keys"
+#define NATIVE_COLLECT_ASYNC "native.collect.async"
+#define NATIVE_COLLECT_ASYNC_BUFFERS "native.collect.async.buffers"
+#define MAPRED_SORT_SPILL_PERCENT "mapreduce.map.sort.spill.percent"
+#define NATIVE_MEMORY_POOL_HUGEPAGE "native.memory.pool.hugepage"
+#define NATIVE_MEMORY_POOL_NUMA_LOCAL "native.memory.pool.numa.local"
+#define NATIVE_MEMORY_POOL_HARD_LIMIT "native.memory.pool.hard.limit.mb"
 #define MAPRED_COMPRESS_MAP_OUTPUT "mapreduce.map.output.compress"
 #define MAPRED_MAP_OUTPUT_COMPRESSION_CODEC "mapreduce.map.output.compress.codec"
+#define NATIVE_ZSTD_LEVEL "io.compression.codec.zstd.level"
+#define NATIVE_COMPRESS_THREADS "native.compress.threads"
+#define NATIVE_COMPRESS_MIN_RATIO "native.compress.min.ratio"
+#define NATIVE_ZSTD_DICTIONARY "io.compression.codec.zstd.dictionary"
+#define NATIVE_GZIP_ISAL "native.gzip.isal"
 #define MAPRED_MAPOUTPUT_KEY_CLASS "mapreduce.map.output.key.class"
 #define MAPRED_OUTPUT_KEY_CLASS "mapreduce.job.output.key.class"
 #define MAPRED_MAPOUTPUT_VALUE_CLASS "mapreduce.map.output.value.class"
 #define MAPRED_OUTPUT_VALUE_CLASS "mapreduce.job.output.value.class"
 #define MAPRED_IO_SORT_MB "mapreduce.task.io.sort.mb"
+#define MAPRED_IO_SORT_FACTOR "mapreduce.task.io.sort.factor"
+#define NATIVE_MERGE_THREADS "native.merge.threads"
+#define MAPRED_IFILE_READAHEAD "mapreduce.ifile.readahead"
+#define NATIVE_MERGE_MMAP "native.merge.mmap"
+#define NATIVE_SPILL_DROP_CACHE "native.spill.drop.cache"
+#define NATIVE_SPILL_WRITEV "native.spill.writev"
+#define NATIVE_METRICS_HISTOGRAM "native.metrics.histogram"
+#define NATIVE_TRACE "native.trace"
+#define NATIVE_TRACE_FILE "native.trace.file"
+#define NATIVE_TRACE_MIN_MICROS "native.trace.min.micros"
+#define NATIVE_SPILL_INDEX_SHARED_DIR "native.spill.index.shared.dir"
+#define MAPRED_TASK_ATTEMPT_ID "mapreduce.task.attempt.id"
+#define NATIVE_SPILL_FILESYSTEM "native.spill.filesystem"
+#define NATIVE_SPILL_TIERED_MEMORY_MB "native.spill.tiered.memory.mb"
+#define NATIVE_SPILL_CODEC "native.spill.codec"
+#define MAPRED_LOCAL_DIR "mapreduce.cluster.local.dir"
+#define NATIVE_SPILL_STRIPE "native.spill.stripe"
+#define NATIVE_COMBINE_IN_MEMORY "native.combine.inmemory"
+#define NATIVE_PARTITIONER_HASH "native.partitioner.hash"
+#define NATIVE_PARTITIONER_SPLIT_POINTS "native.partitioner.split.points"
+#define NATIVE_SPILL_SEGMENT_HASH "native.spill.segment.hash"
+#define MAPRED_IFILE_READAHEAD_BYTES "mapreduce.ifile.readahead.bytes"
 #define MAPRED_NUM_REDUCES "mapreduce.job.reduces"
 #define MAPRED_COMBINE_CLASS_OLD "mapred.combiner.class"
 #define MAPRED_COMBINE_CLASS_NEW "mapreduce.job.combine.class"
+#define MAPRED_GROUPING_COMPARATOR "mapreduce.job.output.group.comparator.class"
+#define MAPRED_COMBINER_GROUPING_COMPARATOR "mapreduce.job.combiner.group.comparator.class"
 
 #define NATIVE_LOG_DEVICE "native.log.device"
+#define NATIVE_LOG_ASYNC "native.log.async"
 
 //format: name=path,name=path,name=path
 #define NATIVE_CLASS_LIBRARY_BUILDIN "native.class.library.buildin"
 
 #define NATIVE_MAPOUT_KEY_COMPARATOR "native.map.output.key.comparator"
+#define NATIVE_GROUPING_COMPARATOR "native.grouping.comparator"
 
 extern const std::string NativeObjectTypeToString(NativeObjectType type);
 extern NativeObjectType NativeObjectTypeFromString(const std::string type);
@@ -338,17 +383,48 @@ public:
   virtual float getProgress() = 0;
 };
 
+/**
+ * Counters are increased by the collecting thread as well as the sort,
+ * spill and merge threads. Each thread adds to a shard of its own, on its
+ * own cache line, so the increments do not contend, and get() sums the
+ * shards when counters are reported. Threads beyond COUNTER_SHARDS share
+ * shards, which is why the adds are still atomic.
+ */
 class Counter {
+public:
+  static const uint32_t COUNTER_SHARDS = 16;
+
 private:
-  // not thread safe
-  // TODO: use atomic
-  volatile uint64_t _count;
+  struct Shard {
+    volatile uint64_t count;
+    char padding[64 - sizeof(uint64_t)];
+  };
+
+  Shard _shards[COUNTER_SHARDS];
 
   string _group;
   string _name;
+
+  // 1 based shard of the calling thread, 0 until it is assigned
+  static __thread uint32_t ThreadShard;
+  static uint32_t NextShard;
+
+  static uint32_t assignShard();
+
+  static uint32_t shard() {
+    uint32_t ret = ThreadShard;
+    if (ret == 0) {
+      ret = assignShard();
+    }
+    return ret - 1;
+  }
+
 public:
   Counter(const string & group, const string & name)
-      : _count(0), _group(group), _name(name) {
+      : _group(group), _name(name) {
+    for (uint32_t i = 0; i < COUNTER_SHARDS; i++) {
+      _shards[i].count = 0;
+    }
   }
 
   const string & group() const {
@@ -359,15 +435,19 @@ public:
   }
 
   uint64_t get() const {
-    return _count;
+    uint64_t ret = 0;
+    for (uint32_t i = 0; i < COUNTER_SHARDS; i++) {
+      ret += _shards[i].count;
+    }
+    return ret;
   }
 
   void increase() {
-    _count++;
+    __sync_fetch_and_add(&_shards[shard()].count, 1);
   }
 
   void increase(uint64_t cnt) {
-    _count += cnt;
+    __sync_fetch_and_add(&_shards[shard()].count, cnt);
   }
 };
 
@@ -460,6 +540,21 @@ typedef int (*ComparatorPtr)(const char * src, uint32_t srcLength, const char *
 
 ComparatorPtr get_comparator(const KeyValueType keyType, const char * comparatorName);
 
+/**
+ * Maps a key to a 8 bytes prefix that compares as unsigned integer in the
+ * order of a custom comparator: if normalizer(a) < normalizer(b) then the
+ * comparator must order a before b. Keys with equal prefixes are ordered
+ * by the comparator, so a normalizer may keep just the leading part of
+ * the key. With a normalizer custom comparators can use RADIXSORT and
+ * PREFIXSORT, see REGISTER_KEY_NORMALIZER.
+ */
+typedef uint64_t (*KeyNormalizerPtr)(const char * key, uint32_t keyLength);
+
+/**
+ * the normalizer registered for a custom comparator, NULL if there is none
+ */
+KeyNormalizerPtr get_key_normalizer(const char * comparatorName);
+
 typedef void (*ANY_FUNC_PTR)();
 
 } // namespace NativeTask;
@@ -504,4 +599,17 @@ typedef void (*ANY_FUNC_PTR)();
 
 #define REGISTER_FUNCTION(Type, Library) Library##ClassMap__[#Library"."#Type] = (ObjectCreatorFunc)Type
 
+/**
+ * Registers a KeyNormalizerPtr for a comparator registered with
+ * REGISTER_FUNCTION, e.g.
+ *   DEFINE_NATIVE_LIBRARY(MyDemo) {
+ *     REGISTER_FUNCTION(MyKeyComparator, MyDemo);
+ *     REGISTER_KEY_NORMALIZER(MyKeyComparator, MyKeyNormalizer, MyDemo);
+ *   }
+ * It is looked up as MyDemo.MyKeyComparatorNormalizer whenever
+ * MyDemo.MyKeyComparator is set as native.map.output.key.comparator.
+ */
+#define REGISTER_KEY_NORMALIZER(Comparator, Normalizer, Library) \
+  Library##ClassMap__[#Library"."#Comparator"Normalizer"] = (NativeTask::ObjectCreatorFunc)Normalizer
+
 #endif /* NATIVETASK_H_ */
@@ -17,13 +17,114 @@
  */
 
 #include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "util/SyncUtils.h"
+#include "util/ThreadPool.h"
 #include "NativeTask.h"
+#include "lib/TaskCounters.h"
+#include "lib/NativeObjectFactory.h"
+#include "native_memory.h"
 #include "BlockCodec.h"
 
 namespace NativeTask {
 
+/**
+ * one block of a BlockCompressStream, compressed on the thread pool
+ */
+class BlockCompressTask : public Runnable {
+public:
+  BlockCompressStream * stream;
+  void * context;
+  char * input;
+  uint32_t inputCapacity;
+  uint32_t inputLength;
+  // compressed block, after 8 bytes for the block header
+  char * output;
+  uint32_t outputCapacity;
+  uint32_t outputLength;
+  string error;
+  BlockCompressStream::BlockMode mode;
+  bool stored;
+  bool done;
+  Lock lock;
+  Condition finished;
+
+  BlockCompressTask(BlockCompressStream * stream, uint32_t inputCapacity, uint32_t outputCapacity)
+      : stream(stream), context(NULL), input(new char[inputCapacity]),
+          inputCapacity(inputCapacity), inputLength(0), output(new char[outputCapacity]),
+          outputCapacity(outputCapacity), outputLength(0), mode(BlockCompressStream::COMPRESS_BLOCK), stored(false), done(true), finished(lock) {
+    native_memory_add(NATIVE_MEMORY_CODEC, (int64_t)inputCapacity + outputCapacity);
+    context = stream->createContext();
+  }
+
+  ~BlockCompressTask() {
+    native_memory_add(NATIVE_MEMORY_CODEC, -((int64_t)inputCapacity + outputCapacity));
+    delete[] input;
+    delete[] output;
+  }
+
+  virtual void run() {
+    uint32_t length = 0;
+    string message;
+    try {
+      PhaseTimer timer(COMPRESS_PHASE);
+      stored = false;
+      if (mode == BlockCompressStream::STORE_BLOCK) {
+        length = stream->storeBlock(input, inputLength, output + 8, outputCapacity - 8);
+        stored = length > 0;
+      }
+      if (!stored) {
+        length = stream->compressBlock(context, input, inputLength, output + 8,
+            outputCapacity - 8);
+      }
+    } catch (std::exception & e) {
+      message = e.what();
+    }
+    ScopeLock<Lock> autoLock(lock);
+    outputLength = length;
+    error = message;
+    done = true;
+    finished.signal();
+  }
+
+  void wait() {
+    ScopeLock<Lock> autoLock(lock);
+    while (!done) {
+      finished.wait();
+    }
+  }
+};
+
+/////////////////////////////////////////////////////////////
+
+// blocks sampled at the start of a spill, and how often a stored spill is probed
+static const uint32_t SAMPLE_BLOCKS = 4;
+static const uint32_t PROBE_INTERVAL = 32;
+
+uint32_t BlockCompressStream::Threads = 1;
+float BlockCompressStream::MinRatio = 0;
+Counter * BlockCompressStream::StoredBytes = NULL;
+
+void BlockCompressStream::setThreads(uint32_t threads) {
+  Threads = threads < 1 ? 1 : threads;
+}
+
+void BlockCompressStream::setMinRatio(float ratio) {
+  MinRatio = ratio < 0 ? 0 : ratio;
+}
+
+void BlockCompressStream::configure(Config * config) {
+  setThreads(config->getInt(NATIVE_COMPRESS_THREADS, 1));
+  setMinRatio(config->getFloat(NATIVE_COMPRESS_MIN_RATIO, 1.1));
+  StoredBytes = NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP,
+      TaskCounters::COMPRESS_STORED_BYTES);
+}
+
 BlockCompressStream::BlockCompressStream(OutputStream * stream, uint32_t bufferSizeHint)
-    : CompressStream(stream), _tempBuffer(NULL), _tempBufferSize(0), _compressedBytesWritten(0) {
+    : CompressStream(stream), _tempBuffer(NULL), _tempBufferSize(0), _compressedBytesWritten(0),
+        _context(NULL), _sampledBlocks(0), _sampledLength(0), _sampledCompressedLength(0),
+        _adaptive(MinRatio > 0), _storing(false), _sinceProbe(0), _pool(NULL), _next(0),
+        _pending(0) {
   _hint = bufferSizeHint;
   _blockMax = bufferSizeHint / 2 * 3;
 }
@@ -31,24 +132,168 @@ BlockCompressStream::BlockCompressStream(OutputStream * stream, uint32_t bufferS
 void BlockCompressStream::init() {
   _tempBufferSize = maxCompressedLength(_blockMax) + 8;
   _tempBuffer = new char[_tempBufferSize];
+  native_memory_add(NATIVE_MEMORY_CODEC, _tempBufferSize);
+  _context = createContext();
 }
 
 BlockCompressStream::~BlockCompressStream() {
+  shutdown();
+  if (NULL != _tempBuffer) {
+    native_memory_add(NATIVE_MEMORY_CODEC, -(int64_t)_tempBufferSize);
+  }
   delete[] _tempBuffer;
   _tempBuffer = NULL;
   _tempBufferSize = 0;
 }
 
+void BlockCompressStream::shutdown() {
+  // joins the threads, blocks still queued are compressed and dropped
+  delete _pool;
+  _pool = NULL;
+  for (size_t i = 0; i < _tasks.size(); i++) {
+    destroyContext(_tasks[i]->context);
+    delete _tasks[i];
+  }
+  _tasks.clear();
+  _pending = 0;
+  if (NULL != _context) {
+    destroyContext(_context);
+    _context = NULL;
+  }
+}
+
 void BlockCompressStream::write(const void * buff, uint32_t length) {
   while (length > 0) {
     uint32_t take = length < _blockMax ? length : _hint;
-    compressOneBlock(buff, take);
+    if (Threads > 1) {
+      submitBlock(buff, take);
+    } else {
+      compressOneBlock(buff, take);
+    }
     buff = ((const char *)buff) + take;
     length -= take;
   }
 }
 
+void BlockCompressStream::compressOneBlock(const void * buff, uint32_t length) {
+  uint32_t compressedLength = 0;
+  BlockMode mode = nextBlockMode();
+  bool stored = false;
+  {
+    PhaseTimer timer(COMPRESS_PHASE);
+    if (mode == STORE_BLOCK) {
+      compressedLength = storeBlock(buff, length, _tempBuffer + 8, _tempBufferSize - 8);
+      stored = compressedLength > 0;
+    }
+    if (!stored) {
+      compressedLength = compressBlock(_context, buff, length, _tempBuffer + 8,
+          _tempBufferSize - 8);
+    }
+  }
+  recordBlock(length, compressedLength, mode, stored);
+  writeBlock(_tempBuffer, length, compressedLength);
+}
+
+BlockCompressStream::BlockMode BlockCompressStream::nextBlockMode() {
+  if (!_storing) {
+    return COMPRESS_BLOCK;
+  }
+  if (++_sinceProbe == PROBE_INTERVAL) {
+    _sinceProbe = 0;
+    return PROBE_BLOCK;
+  }
+  return STORE_BLOCK;
+}
+
+/**
+ * with several threads the blocks are recorded when written, so the
+ * decision lags the blocks in flight
+ */
+void BlockCompressStream::recordBlock(uint32_t length, uint32_t compressedLength,
+    BlockMode mode, bool stored) {
+  if (!_adaptive) {
+    return;
+  }
+  if (mode == STORE_BLOCK && !stored) {
+    // the codec can not store blocks
+    _adaptive = false;
+    _storing = false;
+  } else if (stored) {
+    if (NULL != StoredBytes) {
+      StoredBytes->increase(length);
+    }
+  } else if (mode == PROBE_BLOCK) {
+    if (_storing && length >= compressedLength * MinRatio) {
+      // compressing pays again, the next blocks are sampled anew
+      startSpill();
+    }
+  } else if (!_storing && _sampledBlocks < SAMPLE_BLOCKS) {
+    _sampledBlocks++;
+    _sampledLength += length;
+    _sampledCompressedLength += compressedLength;
+    if (_sampledBlocks == SAMPLE_BLOCKS && _sampledLength < _sampledCompressedLength * MinRatio) {
+      _storing = true;
+      _sinceProbe = 0;
+    }
+  }
+}
+
+void BlockCompressStream::startSpill() {
+  _sampledBlocks = 0;
+  _sampledLength = 0;
+  _sampledCompressedLength = 0;
+  _storing = false;
+  _sinceProbe = 0;
+}
+
+void BlockCompressStream::writeBlock(const char * block, uint32_t length,
+    uint32_t compressedLength) {
+  ((uint32_t*)block)[0] = bswap(length);
+  ((uint32_t*)block)[1] = bswap(compressedLength);
+  _stream->write(block, compressedLength + 8);
+  _compressedBytesWritten += (compressedLength + 8);
+}
+
+void BlockCompressStream::submitBlock(const void * buff, uint32_t length) {
+  if (NULL == _pool) {
+    _pool = new ThreadPool(Threads);
+    // two blocks per thread keep the threads busy while the oldest is written
+    for (uint32_t i = 0; i < Threads * 2; i++) {
+      _tasks.push_back(new BlockCompressTask(this, _blockMax, _tempBufferSize));
+    }
+  }
+  if (_pending == _tasks.size()) {
+    writeOldest();
+  }
+  BlockCompressTask * task = _tasks[_next];
+  memcpy(task->input, buff, length);
+  task->inputLength = length;
+  task->mode = nextBlockMode();
+  task->done = false;
+  _pool->submit(task);
+  _next = (_next + 1) % _tasks.size();
+  _pending++;
+}
+
+void BlockCompressStream::writeOldest() {
+  BlockCompressTask * task = _tasks[(_next + _tasks.size() - _pending) % _tasks.size()];
+  task->wait();
+  _pending--;
+  if (!task->error.empty()) {
+    THROW_EXCEPTION_EX(IOException, "compress block failed: %s", task->error.c_str());
+  }
+  recordBlock(task->inputLength, task->outputLength, task->mode, task->stored);
+  writeBlock(task->output, task->inputLength, task->outputLength);
+}
+
+void BlockCompressStream::drain() {
+  while (_pending > 0) {
+    writeOldest();
+  }
+}
+
 void BlockCompressStream::flush() {
+  drain();
   _stream->flush();
 }
 
@@ -57,11 +302,13 @@ void BlockCompressStream::close() {
 }
 
 void BlockCompressStream::writeDirect(const void * buff, uint32_t length) {
+  drain();
   _stream->write(buff, length);
   _compressedBytesWritten += length;
 }
 
 uint64_t BlockCompressStream::compressedBytesWritten() {
+  drain();
   return _compressedBytesWritten;
 }
 
@@ -80,18 +327,29 @@ BlockDecompressStream::BlockDecompressStream(InputStream * stream, uint32_t buff
 
 void BlockDecompressStream::init() {
   _tempBufferSize = maxCompressedLength(_blockMax) + 8;
-  _tempBuffer = (char*)malloc(_tempBufferSize);
+  _tempBuffer = (char*)native_memory_malloc(NATIVE_MEMORY_CODEC, _tempBufferSize);
 }
 
 BlockDecompressStream::~BlockDecompressStream() {
   close();
-  if (NULL != _tempBuffer) {
-    free(_tempBuffer);
-    _tempBuffer = NULL;
-  }
+  native_memory_free(NATIVE_MEMORY_CODEC, _tempBuffer);
+  _tempBuffer = NULL;
   _tempBufferSize = 0;
 }
 
+void BlockDecompressStream::reserveTempBuffer(uint32_t size) {
+  if (size <= _tempBufferSize) {
+    return;
+  }
+  char * newBuffer = (char *)native_memory_malloc(NATIVE_MEMORY_CODEC, size);
+  if (newBuffer == NULL) {
+    THROW_EXCEPTION(OutOfMemoryException, "temp buffer allocation failed");
+  }
+  native_memory_free(NATIVE_MEMORY_CODEC, _tempBuffer);
+  _tempBuffer = newBuffer;
+  _tempBufferSize = size;
+}
+
 int32_t BlockDecompressStream::read(void * buff, uint32_t length) {
   if (_tempDecompressBufferSize == 0) {
     uint32_t sizes[2];
@@ -114,10 +372,12 @@ int32_t BlockDecompressStream::read(void * buff, uint32_t length) {
       return len;
     } else {
       if (sizes[0] > _tempDecompressBufferCapacity) {
-        char * newBuffer = (char *)realloc(_tempDecompressBuffer, sizes[0]);
+        // nothing is left in it, so there is nothing to copy
+        char * newBuffer = (char *)native_memory_malloc(NATIVE_MEMORY_CODEC, sizes[0]);
         if (newBuffer == NULL) {
-          THROW_EXCEPTION(OutOfMemoryException, "realloc failed");
+          THROW_EXCEPTION(OutOfMemoryException, "decompress buffer allocation failed");
         }
+        native_memory_free(NATIVE_MEMORY_CODEC, _tempDecompressBuffer);
         _tempDecompressBuffer = newBuffer;
         _tempDecompressBufferCapacity = sizes[0];
       }
@@ -152,7 +412,7 @@ void BlockDecompressStream::close() {
     LOG("[BlockDecompressStream] Some data left in the _tempDecompressBuffer when close()");
   }
   if (NULL != _tempDecompressBuffer) {
-    free(_tempDecompressBuffer);
+    native_memory_free(NATIVE_MEMORY_CODEC, _tempDecompressBuffer);
     _tempDecompressBuffer = NULL;
     _tempDecompressBufferCapacity = 0;
   }
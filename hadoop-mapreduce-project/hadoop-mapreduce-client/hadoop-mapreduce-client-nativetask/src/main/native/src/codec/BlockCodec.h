@@ -19,20 +19,73 @@
 #ifndef BLOCKCODEC_H_
 #define BLOCKCODEC_H_
 
+#include <vector>
 #include "lib/Compressions.h"
 
 namespace NativeTask {
 
+class Config;
+class Counter;
+class ThreadPool;
+class BlockCompressTask;
+
 class BlockCompressStream : public CompressStream {
+  friend class BlockCompressTask;
+
 protected:
+  enum BlockMode {
+    COMPRESS_BLOCK,
+    // compressed while storing, to notice when the data shrinks again
+    PROBE_BLOCK,
+    STORE_BLOCK,
+  };
+
   uint32_t _hint;
   uint32_t _blockMax;
   char * _tempBuffer;
   uint32_t _tempBufferSize;
   uint64_t _compressedBytesWritten;
+  void * _context;
+
+  static uint32_t Threads;
+  static float MinRatio;
+  static Counter * StoredBytes;
+
+  // the first blocks of each spill, to tell whether compressing pays
+  uint32_t _sampledBlocks;
+  uint64_t _sampledLength;
+  uint64_t _sampledCompressedLength;
+  bool _adaptive;
+  bool _storing;
+  uint32_t _sinceProbe;
+
+  // blocks compressed by _pool, written in order from the oldest
+  ThreadPool * _pool;
+  std::vector<BlockCompressTask *> _tasks;
+  uint32_t _next;
+  uint32_t _pending;
 public:
   BlockCompressStream(OutputStream * stream, uint32_t bufferSizeHint);
 
+  /**
+   * threads compressing the blocks of each stream, finished blocks are
+   * still written in order. 1 compresses on the writing thread
+   */
+  static void setThreads(uint32_t threads);
+
+  /**
+   * native.compress.threads and native.compress.min.ratio
+   */
+  static void configure(Config * config);
+
+  /**
+   * blocks of map output that is compressed already, or random, hardly
+   * shrink. If the first blocks of a spill shrink by less than ratio, the
+   * rest of the spill is written as stored blocks, and every 32nd block is
+   * still compressed to notice when the data changes. 0 always compresses
+   */
+  static void setMinRatio(float ratio);
+
   virtual ~BlockCompressStream();
 
   virtual void write(const void * buff, uint32_t length);
@@ -43,8 +96,17 @@ public:
 
   virtual void writeDirect(const void * buff, uint32_t length);
 
+  /**
+   * blocks still being compressed are written first, so the count is
+   * exact
+   */
   virtual uint64_t compressedBytesWritten();
 
+  /**
+   * the next blocks are sampled again to tell whether compressing pays
+   */
+  virtual void startSpill();
+
   void init();
 
 protected:
@@ -52,8 +114,57 @@ protected:
     return origLength;
   }
 
-  virtual void compressOneBlock(const void * buff, uint32_t length) {
+  /**
+   * codec state used by compressBlock, each compressing thread has its own
+   */
+  virtual void * createContext() {
+    return NULL;
+  }
+
+  virtual void destroyContext(void * context) {
+  }
+
+  /**
+   * compress length bytes of buff to dest, called concurrently with
+   * different contexts when blocks are compressed by several threads
+   * @return compressed length
+   */
+  virtual uint32_t compressBlock(void * context, const void * buff, uint32_t length, char * dest,
+      uint32_t capacity) {
+    return 0;
+  }
+
+  /**
+   * write length bytes of buff to dest as a block that the codec's
+   * decompressor reads back, without compressing them, so a stored block
+   * needs no marker of its own. Called concurrently like compressBlock
+   * @return block length, 0 if the codec can not store blocks
+   */
+  virtual uint32_t storeBlock(const void * buff, uint32_t length, char * dest,
+      uint32_t capacity) {
+    return 0;
   }
+
+  virtual void compressOneBlock(const void * buff, uint32_t length);
+
+  /**
+   * wait for the compressing threads and free all contexts, subclasses
+   * with contexts call it from their destructor
+   */
+  void shutdown();
+
+private:
+  void writeBlock(const char * block, uint32_t length, uint32_t compressedLength);
+
+  BlockMode nextBlockMode();
+
+  void recordBlock(uint32_t length, uint32_t compressedLength, BlockMode mode, bool stored);
+
+  void submitBlock(const void * buff, uint32_t length);
+
+  void writeOldest();
+
+  void drain();
 };
 
 class BlockDecompressStream : public DecompressStream {
@@ -91,6 +202,11 @@ protected:
     //TODO: add implementation
     return 0;
   }
+
+  /**
+   * grows _tempBuffer to at least size bytes, what it held is dropped
+   */
+  void reserveTempBuffer(uint32_t size);
 };
 
 } // namespace NativeTask
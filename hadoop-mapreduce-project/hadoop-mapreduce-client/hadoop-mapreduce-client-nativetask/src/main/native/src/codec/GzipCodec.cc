@@ -18,22 +18,146 @@
 
 #include <zconf.h>
 #include <zlib.h>
+#include "config.h"
 #include "lib/commons.h"
+#include "lib/TaskCounters.h"
+#include "util/SyncUtils.h"
+#include "native_memory.h"
 #include "GzipCodec.h"
 #include <iostream>
 
+#if defined HADOOP_ISAL_LIBRARY
+#include <dlfcn.h>
+#include <isa-l/igzip_lib.h>
+#endif
+
 namespace NativeTask {
 
+static Lock GzipConfigLock;
+static bool IsalEnabled = true;
+
+#if defined HADOOP_ISAL_LIBRARY
+
+typedef void (*IsalDeflateInitFunc)(struct isal_zstream *);
+typedef void (*IsalDeflateResetFunc)(struct isal_zstream *);
+typedef int (*IsalDeflateFunc)(struct isal_zstream *);
+typedef void (*IsalInflateInitFunc)(struct inflate_state *);
+typedef void (*IsalInflateResetFunc)(struct inflate_state *);
+typedef int (*IsalInflateFunc)(struct inflate_state *);
+
+static bool IsalLoadTried = false;
+static bool IsalLoaded = false;
+static IsalDeflateInitFunc IsalDeflateInit = NULL;
+static IsalDeflateResetFunc IsalDeflateReset = NULL;
+static IsalDeflateFunc IsalDeflate = NULL;
+static IsalInflateInitFunc IsalInflateInit = NULL;
+static IsalInflateResetFunc IsalInflateReset = NULL;
+static IsalInflateFunc IsalInflate = NULL;
+
+/**
+ * must hold GzipConfigLock
+ */
+static bool loadIsal() {
+  if (IsalLoadTried) {
+    return IsalLoaded;
+  }
+  IsalLoadTried = true;
+  void * library = dlopen(HADOOP_ISAL_LIBRARY, RTLD_LAZY | RTLD_GLOBAL);
+  if (NULL == library) {
+    LOG("[GzipCodec] %s not loaded, gzip uses zlib", HADOOP_ISAL_LIBRARY);
+    return false;
+  }
+  IsalDeflateInit = (IsalDeflateInitFunc)dlsym(library, "isal_deflate_init");
+  IsalDeflateReset = (IsalDeflateResetFunc)dlsym(library, "isal_deflate_reset");
+  IsalDeflate = (IsalDeflateFunc)dlsym(library, "isal_deflate");
+  IsalInflateInit = (IsalInflateInitFunc)dlsym(library, "isal_inflate_init");
+  IsalInflateReset = (IsalInflateResetFunc)dlsym(library, "isal_inflate_reset");
+  IsalInflate = (IsalInflateFunc)dlsym(library, "isal_inflate");
+  if (NULL == IsalDeflateInit || NULL == IsalDeflateReset || NULL == IsalDeflate
+      || NULL == IsalInflateInit || NULL == IsalInflateReset || NULL == IsalInflate) {
+    LOG("[GzipCodec] igzip functions not found in %s, gzip uses zlib", HADOOP_ISAL_LIBRARY);
+    dlclose(library);
+    return false;
+  }
+  LOG("[GzipCodec] gzip uses igzip from %s", HADOOP_ISAL_LIBRARY);
+  IsalLoaded = true;
+  return true;
+}
+
+struct IsalDeflateState {
+  struct isal_zstream stream;
+  uint8_t levelBuffer[ISAL_DEF_LVL1_DEFAULT];
+};
+
+/**
+ * (re)starts a gzip member, isal_deflate_reset keeps the parameters but
+ * they are cheap to set again
+ */
+static void setupIsalDeflate(IsalDeflateState * state, bool reset) {
+  struct isal_zstream * stream = &state->stream;
+  if (reset) {
+    IsalDeflateReset(stream);
+  } else {
+    IsalDeflateInit(stream);
+  }
+  stream->level = 1;
+  stream->level_buf = state->levelBuffer;
+  stream->level_buf_size = sizeof(state->levelBuffer);
+  stream->gzip_flag = IGZIP_GZIP;
+  stream->flush = NO_FLUSH;
+  stream->end_of_stream = 0;
+}
+
+static void setupIsalInflate(struct inflate_state * state, bool reset) {
+  if (reset) {
+    IsalInflateReset(state);
+  } else {
+    IsalInflateInit(state);
+  }
+  state->crc_flag = ISAL_GZIP;
+}
+
+#endif
+
+void GzipCodec::configure(Config * config) {
+  ScopeLock<Lock> autolock(GzipConfigLock);
+  IsalEnabled = config->getBool(NATIVE_GZIP_ISAL, true);
+}
+
+bool GzipCodec::useIsal() {
+#if defined HADOOP_ISAL_LIBRARY
+  ScopeLock<Lock> autolock(GzipConfigLock);
+  return IsalEnabled && loadIsal();
+#else
+  return false;
+#endif
+}
+
 GzipCompressStream::GzipCompressStream(OutputStream * stream, uint32_t bufferSizeHint)
-    : CompressStream(stream), _compressedBytesWritten(0), _zstream(NULL), _finished(false) {
+    : CompressStream(stream), _compressedBytesWritten(0), _zstream(NULL), _isal(NULL),
+        _finished(false) {
   _buffer = new char[bufferSizeHint];
   _capacity = bufferSizeHint;
-  _zstream = malloc(sizeof(z_stream));
+  native_memory_add(NATIVE_MEMORY_CODEC, _capacity);
+#if defined HADOOP_ISAL_LIBRARY
+  if (GzipCodec::useIsal()) {
+    IsalDeflateState * state = new IsalDeflateState();
+    native_memory_add(NATIVE_MEMORY_CODEC, sizeof(IsalDeflateState));
+    setupIsalDeflate(state, false);
+    state->stream.next_out = (uint8_t *)_buffer;
+    state->stream.avail_out = _capacity;
+    _isal = state;
+    return;
+  }
+#endif
+  _zstream = native_memory_malloc(NATIVE_MEMORY_CODEC, sizeof(z_stream));
   z_stream * zstream = (z_stream*)_zstream;
   memset(zstream, 0, sizeof(z_stream));
+  zstream->zalloc = native_memory_zalloc;
+  zstream->zfree = native_memory_zfree;
   if (Z_OK != deflateInit2(zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
       Z_DEFAULT_STRATEGY)) {
-    free(_zstream);
+    native_memory_free(NATIVE_MEMORY_CODEC, _zstream);
     _zstream = NULL;
     THROW_EXCEPTION(IOException, "deflateInit2 failed");
   }
@@ -42,21 +166,37 @@ GzipCompressStream::GzipCompressStream(OutputStream * stream, uint32_t bufferSiz
 }
 
 GzipCompressStream::~GzipCompressStream() {
+#if defined HADOOP_ISAL_LIBRARY
+  if (NULL != _isal) {
+    native_memory_add(NATIVE_MEMORY_CODEC, -(int64_t)sizeof(IsalDeflateState));
+  }
+  delete (IsalDeflateState *)_isal;
+  _isal = NULL;
+#endif
   if (_zstream != NULL) {
     deflateEnd((z_stream*)_zstream);
-    free(_zstream);
+    native_memory_free(NATIVE_MEMORY_CODEC, _zstream);
     _zstream = NULL;
   }
+  native_memory_add(NATIVE_MEMORY_CODEC, -(int64_t)_capacity);
   delete[] _buffer;
   _buffer = NULL;
 }
 
 void GzipCompressStream::write(const void * buff, uint32_t length) {
+  if (NULL != _isal) {
+    writeIsal(buff, length);
+    return;
+  }
   z_stream * zstream = (z_stream*)_zstream;
   zstream->next_in = (Bytef*)buff;
   zstream->avail_in = length;
   while (true) {
-    int ret = deflate(zstream, Z_NO_FLUSH);
+    int ret = Z_OK;
+    {
+      PhaseTimer timer(COMPRESS_PHASE);
+      ret = deflate(zstream, Z_NO_FLUSH);
+    }
     if (ret == Z_OK) {
       if (zstream->avail_out == 0) {
         _stream->write(_buffer, _capacity);
@@ -75,9 +215,17 @@ void GzipCompressStream::write(const void * buff, uint32_t length) {
 }
 
 void GzipCompressStream::flush() {
+  if (NULL != _isal) {
+    flushIsal();
+    return;
+  }
   z_stream * zstream = (z_stream*)_zstream;
   while (true) {
-    int ret = deflate(zstream, Z_FINISH);
+    int ret = Z_OK;
+    {
+      PhaseTimer timer(COMPRESS_PHASE);
+      ret = deflate(zstream, Z_FINISH);
+    }
     if (ret == Z_OK) {
       if (zstream->avail_out == 0) {
         _stream->write(_buffer, _capacity);
@@ -101,10 +249,89 @@ void GzipCompressStream::flush() {
 }
 
 void GzipCompressStream::resetState() {
+#if defined HADOOP_ISAL_LIBRARY
+  if (NULL != _isal) {
+    setupIsalDeflate((IsalDeflateState *)_isal, true);
+    return;
+  }
+#endif
   z_stream * zstream = (z_stream*)_zstream;
   deflateReset(zstream);
 }
 
+#if defined HADOOP_ISAL_LIBRARY
+
+void GzipCompressStream::writeIsal(const void * buff, uint32_t length) {
+  struct isal_zstream * stream = &((IsalDeflateState *)_isal)->stream;
+  stream->next_in = (uint8_t *)buff;
+  stream->avail_in = length;
+  stream->end_of_stream = 0;
+  while (true) {
+    int ret = COMP_OK;
+    {
+      PhaseTimer timer(COMPRESS_PHASE);
+      ret = IsalDeflate(stream);
+    }
+    if (ret != COMP_OK) {
+      THROW_EXCEPTION(IOException, "isal_deflate return error");
+    }
+    if (stream->avail_out == 0) {
+      _stream->write(_buffer, _capacity);
+      _compressedBytesWritten += _capacity;
+      stream->next_out = (uint8_t *)_buffer;
+      stream->avail_out = _capacity;
+    }
+    if (stream->avail_in == 0) {
+      break;
+    }
+  }
+  _finished = false;
+}
+
+void GzipCompressStream::flushIsal() {
+  struct isal_zstream * stream = &((IsalDeflateState *)_isal)->stream;
+  stream->avail_in = 0;
+  stream->end_of_stream = 1;
+  while (true) {
+    int ret = COMP_OK;
+    {
+      PhaseTimer timer(COMPRESS_PHASE);
+      ret = IsalDeflate(stream);
+    }
+    if (ret != COMP_OK) {
+      THROW_EXCEPTION(IOException, "isal_deflate return error");
+    }
+    if (stream->internal_state.state == ZSTATE_END) {
+      size_t wt = stream->next_out - (uint8_t *)_buffer;
+      _stream->write(_buffer, wt);
+      _compressedBytesWritten += wt;
+      stream->next_out = (uint8_t *)_buffer;
+      stream->avail_out = _capacity;
+      break;
+    }
+    if (stream->avail_out == 0) {
+      _stream->write(_buffer, _capacity);
+      _compressedBytesWritten += _capacity;
+      stream->next_out = (uint8_t *)_buffer;
+      stream->avail_out = _capacity;
+    }
+  }
+  _finished = true;
+  _stream->flush();
+}
+
+#else
+
+void GzipCompressStream::writeIsal(const void * buff, uint32_t length) {
+  THROW_EXCEPTION(UnsupportException, "ISA-L is not built in");
+}
+
+void GzipCompressStream::flushIsal() {
+  THROW_EXCEPTION(UnsupportException, "ISA-L is not built in");
+}
+
+#endif
+
 void GzipCompressStream::close() {
   if (!_finished) {
     flush();
@@ -122,14 +349,29 @@ void GzipCompressStream::writeDirect(const void * buff, uint32_t length) {
 //////////////////////////////////////////////////////////////
 
 GzipDecompressStream::GzipDecompressStream(InputStream * stream, uint32_t bufferSizeHint)
-    : DecompressStream(stream), _compressedBytesRead(0), _zstream(NULL) {
+    : DecompressStream(stream), _compressedBytesRead(0), _zstream(NULL), _isal(NULL),
+        _eof(false) {
   _buffer = new char[bufferSizeHint];
   _capacity = bufferSizeHint;
-  _zstream = malloc(sizeof(z_stream));
+  native_memory_add(NATIVE_MEMORY_CODEC, _capacity);
+#if defined HADOOP_ISAL_LIBRARY
+  if (GzipCodec::useIsal()) {
+    struct inflate_state * state = new struct inflate_state();
+    native_memory_add(NATIVE_MEMORY_CODEC, sizeof(struct inflate_state));
+    setupIsalInflate(state, false);
+    state->next_in = NULL;
+    state->avail_in = 0;
+    _isal = state;
+    return;
+  }
+#endif
+  _zstream = native_memory_malloc(NATIVE_MEMORY_CODEC, sizeof(z_stream));
   z_stream * zstream = (z_stream*)_zstream;
   memset(zstream, 0, sizeof(z_stream));
+  zstream->zalloc = native_memory_zalloc;
+  zstream->zfree = native_memory_zfree;
   if (Z_OK != inflateInit2(zstream, 31)) {
-    free(_zstream);
+    native_memory_free(NATIVE_MEMORY_CODEC, _zstream);
     _zstream = NULL;
     THROW_EXCEPTION(IOException, "inflateInit2 failed");
   }
@@ -139,16 +381,27 @@ GzipDecompressStream::GzipDecompressStream(InputStream * stream, uint32_t buffer
 }
 
 GzipDecompressStream::~GzipDecompressStream() {
+#if defined HADOOP_ISAL_LIBRARY
+  if (NULL != _isal) {
+    native_memory_add(NATIVE_MEMORY_CODEC, -(int64_t)sizeof(struct inflate_state));
+  }
+  delete (struct inflate_state *)_isal;
+  _isal = NULL;
+#endif
   if (_zstream != NULL) {
     inflateEnd((z_stream*)_zstream);
-    free(_zstream);
+    native_memory_free(NATIVE_MEMORY_CODEC, _zstream);
     _zstream = NULL;
   }
+  native_memory_add(NATIVE_MEMORY_CODEC, -(int64_t)_capacity);
   delete[] _buffer;
   _buffer = NULL;
 }
 
 int32_t GzipDecompressStream::read(void * buff, uint32_t length) {
+  if (NULL != _isal) {
+    return readIsal(buff, length);
+  }
   z_stream * zstream = (z_stream*)_zstream;
   zstream->next_out = (Bytef*)buff;
   zstream->avail_out = length;
@@ -166,6 +419,10 @@ int32_t GzipDecompressStream::read(void * buff, uint32_t length) {
       }
     }
     int ret = inflate(zstream, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      // a gzip member is written per partition, go on with the next one
+      inflateReset(zstream);
+    }
     if (ret == Z_OK || ret == Z_STREAM_END) {
       if (zstream->avail_out == 0) {
         return length;
@@ -177,6 +434,55 @@ int32_t GzipDecompressStream::read(void * buff, uint32_t length) {
   return -1;
 }
 
+#if defined HADOOP_ISAL_LIBRARY
+
+int32_t GzipDecompressStream::readIsal(void * buff, uint32_t length) {
+  struct inflate_state * state = (struct inflate_state *)_isal;
+  state->next_out = (uint8_t *)buff;
+  state->avail_out = length;
+  while (true) {
+    if (state->block_state == ISAL_BLOCK_FINISH) {
+      // a gzip member is written per partition, go on with the next one
+      uint8_t * nextIn = state->next_in;
+      uint32_t availIn = state->avail_in;
+      uint8_t * nextOut = state->next_out;
+      uint32_t availOut = state->avail_out;
+      setupIsalInflate(state, true);
+      state->next_in = nextIn;
+      state->avail_in = availIn;
+      state->next_out = nextOut;
+      state->avail_out = availOut;
+    }
+    if (state->avail_in == 0) {
+      int32_t rd = _stream->read(_buffer, _capacity);
+      if (rd <= 0) {
+        _eof = true;
+        size_t wt = state->next_out - (uint8_t *)buff;
+        return wt > 0 ? wt : -1;
+      } else {
+        _compressedBytesRead += rd;
+        state->next_in = (uint8_t *)_buffer;
+        state->avail_in = rd;
+      }
+    }
+    if (IsalInflate(state) < 0) {
+      return -1;
+    }
+    if (state->avail_out == 0) {
+      return length;
+    }
+  }
+  return -1;
+}
+
+#else
+
+int32_t GzipDecompressStream::readIsal(void * buff, uint32_t length) {
+  THROW_EXCEPTION(UnsupportException, "ISA-L is not built in");
+}
+
+#endif
+
 void GzipDecompressStream::close() {
 }
 
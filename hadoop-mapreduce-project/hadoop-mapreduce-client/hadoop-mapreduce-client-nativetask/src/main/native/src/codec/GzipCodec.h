@@ -23,12 +23,30 @@
 
 namespace NativeTask {
 
+/**
+ * Gzip streams compress and decompress with ISA-L igzip instead of zlib
+ * when the ISA-L library found at build time can be loaded at runtime,
+ * unless native.gzip.isal is false. igzip compresses at its level 1, the
+ * output is still a gzip stream that zlib and the java GzipCodec read.
+ */
+class GzipCodec {
+public:
+  static void configure(Config * config);
+
+  /**
+   * if new streams use igzip
+   */
+  static bool useIsal();
+};
+
 class GzipCompressStream : public CompressStream {
 protected:
   uint64_t _compressedBytesWritten;
   char * _buffer;
   uint32_t _capacity;
   void * _zstream;
+  // igzip state instead of _zstream, see GzipCodec
+  void * _isal;
   bool _finished;
 public:
   GzipCompressStream(OutputStream * stream, uint32_t bufferSizeHint);
@@ -52,6 +70,11 @@ public:
   virtual uint64_t compressedBytesWritten() {
     return _compressedBytesWritten;
   }
+
+private:
+  void writeIsal(const void * buff, uint32_t length);
+
+  void flushIsal();
 };
 
 class GzipDecompressStream : public DecompressStream {
@@ -60,6 +83,7 @@ protected:
   char * _buffer;
   uint32_t _capacity;
   void * _zstream;
+  void * _isal;
   bool _eof;
 public:
   GzipDecompressStream(InputStream * stream, uint32_t bufferSizeHint);
@@ -75,6 +99,9 @@ public:
   virtual uint64_t compressedBytesRead() {
     return _compressedBytesRead;
   }
+
+private:
+  int32_t readIsal(void * buff, uint32_t length);
 };
 
 } // namespace NativeTask
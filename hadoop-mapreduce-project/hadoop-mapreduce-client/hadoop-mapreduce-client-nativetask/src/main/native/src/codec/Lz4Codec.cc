@@ -33,20 +33,41 @@ Lz4CompressStream::Lz4CompressStream(OutputStream * stream, uint32_t bufferSizeH
   init();
 }
 
-void Lz4CompressStream::compressOneBlock(const void * buff, uint32_t length) {
-  size_t compressedLength = _tempBufferSize - 8;
-  int ret = LZ4_compress((char*)buff, _tempBuffer + 8, length);
+uint32_t Lz4CompressStream::compressBlock(void * context, const void * buff, uint32_t length,
+    char * dest, uint32_t capacity) {
+  int ret = LZ4_compress((char*)buff, dest, length);
   if (ret > 0) {
-    compressedLength = ret;
-    ((uint32_t*)_tempBuffer)[0] = bswap(length);
-    ((uint32_t*)_tempBuffer)[1] = bswap((uint32_t)compressedLength);
-    _stream->write(_tempBuffer, compressedLength + 8);
-    _compressedBytesWritten += (compressedLength + 8);
+    return ret;
   } else {
     THROW_EXCEPTION(IOException, "compress LZ4 failed");
   }
 }
 
+/**
+ * a block of a single sequence of literals, which is what LZ4 itself
+ * writes for data it finds no match in
+ */
+uint32_t Lz4CompressStream::storeBlock(const void * buff, uint32_t length, char * dest,
+    uint32_t capacity) {
+  uint32_t extra = length < 15 ? 0 : (length - 15) / 255 + 1;
+  if (1 + extra + length > capacity) {
+    return 0;
+  }
+  uint8_t * out = (uint8_t *)dest;
+  if (length < 15) {
+    *out++ = length << 4;
+  } else {
+    *out++ = 0xf0;
+    uint32_t left = length - 15;
+    for (; left >= 255; left -= 255) {
+      *out++ = 255;
+    }
+    *out++ = left;
+  }
+  memcpy(out, buff, length);
+  return out + length - (uint8_t *)dest;
+}
+
 uint64_t Lz4CompressStream::maxCompressedLength(uint64_t origLength) {
   return LZ4_MaxCompressedSize(origLength);
 }
@@ -60,14 +81,7 @@ Lz4DecompressStream::Lz4DecompressStream(InputStream * stream, uint32_t bufferSi
 
 uint32_t Lz4DecompressStream::decompressOneBlock(uint32_t compressedSize, void * buff,
     uint32_t length) {
-  if (compressedSize > _tempBufferSize) {
-    char * newBuffer = (char *)realloc(_tempBuffer, compressedSize);
-    if (newBuffer == NULL) {
-      THROW_EXCEPTION(OutOfMemoryException, "realloc failed");
-    }
-    _tempBuffer = newBuffer;
-    _tempBufferSize = compressedSize;
-  }
+  reserveTempBuffer(compressedSize);
   uint32_t rd = _stream->readFully(_tempBuffer, compressedSize);
   if (rd != compressedSize) {
     THROW_EXCEPTION(IOException, "readFully reach EOF");
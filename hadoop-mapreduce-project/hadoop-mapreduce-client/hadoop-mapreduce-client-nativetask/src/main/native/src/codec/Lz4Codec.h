@@ -29,7 +29,9 @@ public:
   Lz4CompressStream(OutputStream * stream, uint32_t bufferSizeHint);
 protected:
   virtual uint64_t maxCompressedLength(uint64_t origLength);
-  virtual void compressOneBlock(const void * buff, uint32_t length);
+  virtual uint32_t compressBlock(void * context, const void * buff, uint32_t length, char * dest,
+      uint32_t capacity);
+  virtual uint32_t storeBlock(const void * buff, uint32_t length, char * dest, uint32_t capacity);
 };
 
 class Lz4DecompressStream : public BlockDecompressStream {
@@ -32,15 +32,12 @@ SnappyCompressStream::SnappyCompressStream(OutputStream * stream, uint32_t buffe
   init();
 }
 
-void SnappyCompressStream::compressOneBlock(const void * buff, uint32_t length) {
-  size_t compressedLength = _tempBufferSize - 8;
-  snappy_status ret = snappy_compress((const char*)buff, length, _tempBuffer + 8,
-      &compressedLength);
+uint32_t SnappyCompressStream::compressBlock(void * context, const void * buff, uint32_t length,
+    char * dest, uint32_t capacity) {
+  size_t compressedLength = capacity;
+  snappy_status ret = snappy_compress((const char*)buff, length, dest, &compressedLength);
   if (ret == SNAPPY_OK) {
-    ((uint32_t*)_tempBuffer)[0] = bswap(length);
-    ((uint32_t*)_tempBuffer)[1] = bswap((uint32_t)compressedLength);
-    _stream->write(_tempBuffer, compressedLength + 8);
-    _compressedBytesWritten += (compressedLength + 8);
+    return compressedLength;
   } else if (ret == SNAPPY_INVALID_INPUT) {
     THROW_EXCEPTION(IOException, "compress SNAPPY_INVALID_INPUT");
   } else if (ret == SNAPPY_BUFFER_TOO_SMALL) {
@@ -50,6 +47,30 @@ void SnappyCompressStream::compressOneBlock(const void * buff, uint32_t length)
   }
 }
 
+/**
+ * the uncompressed length as a varint, then all of it as a single
+ * literal, with its length less one in 4 bytes after the tag
+ */
+uint32_t SnappyCompressStream::storeBlock(const void * buff, uint32_t length, char * dest,
+    uint32_t capacity) {
+  if (length == 0 || length + 10 > capacity) {
+    return 0;
+  }
+  uint8_t * out = (uint8_t *)dest;
+  uint32_t left = length;
+  for (; left >= 0x80; left >>= 7) {
+    *out++ = (left & 0x7f) | 0x80;
+  }
+  *out++ = left;
+  uint32_t literal = length - 1;
+  *out++ = 63 << 2;
+  for (int i = 0; i < 4; i++) {
+    *out++ = literal >> (8 * i);
+  }
+  memcpy(out, buff, length);
+  return out + length - (uint8_t *)dest;
+}
+
 uint64_t SnappyCompressStream::maxCompressedLength(uint64_t origLength) {
   return snappy_max_compressed_length(origLength);
 }
@@ -63,14 +84,7 @@ SnappyDecompressStream::SnappyDecompressStream(InputStream * stream, uint32_t bu
 
 uint32_t SnappyDecompressStream::decompressOneBlock(uint32_t compressedSize, void * buff,
     uint32_t length) {
-  if (compressedSize > _tempBufferSize) {
-    char * newBuffer = (char *)realloc(_tempBuffer, compressedSize);
-    if (newBuffer == NULL) {
-      THROW_EXCEPTION(OutOfMemoryException, "realloc failed");
-    }
-    _tempBuffer = newBuffer;
-    _tempBufferSize = compressedSize;
-  }
+  reserveTempBuffer(compressedSize);
   uint32_t rd = _stream->readFully(_tempBuffer, compressedSize);
   if (rd != compressedSize) {
     THROW_EXCEPTION(IOException, "readFully reach EOF");
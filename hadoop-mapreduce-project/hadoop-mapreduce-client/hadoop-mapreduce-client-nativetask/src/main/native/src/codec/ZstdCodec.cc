@@ -0,0 +1,198 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "config.h"
+
+#if defined HADOOP_ZSTD_LIBRARY
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "NativeTask.h"
+#include "util/SyncUtils.h"
+#include "lib/FileSystem.h"
+#include "lib/BufferStream.h"
+#include "ZstdCodec.h"
+
+#include <zstd.h>
+
+namespace NativeTask {
+
+static Lock ZstdConfigLock;
+static int ZstdLevel = 3;
+static string ZstdDictionaryPath;
+static ZSTD_CDict * ZstdCompressDictionary = NULL;
+static ZSTD_DDict * ZstdDecompressDictionary = NULL;
+
+void ZstdCodec::configure(Config * config) {
+  ScopeLock<Lock> autolock(ZstdConfigLock);
+  int level = config->getInt(NATIVE_ZSTD_LEVEL, 3);
+  string path = config->get(NATIVE_ZSTD_DICTIONARY, "");
+  if (level == ZstdLevel && path == ZstdDictionaryPath) {
+    return;
+  }
+  ZstdLevel = level;
+  ZstdDictionaryPath = path;
+  ZSTD_freeCDict(ZstdCompressDictionary);
+  ZSTD_freeDDict(ZstdDecompressDictionary);
+  ZstdCompressDictionary = NULL;
+  ZstdDecompressDictionary = NULL;
+  if (path.length() == 0) {
+    return;
+  }
+  // a dictionary trained with zstd --train on samples of the map output
+  string dictionary;
+  OutputStringStream dest(dictionary);
+  InputStream * fin = FileSystem::getLocal().open(path);
+  fin->readAllTo(dest, 64 * 1024);
+  delete fin;
+  ZstdCompressDictionary = ZSTD_createCDict(dictionary.data(), dictionary.length(), ZstdLevel);
+  ZstdDecompressDictionary = ZSTD_createDDict(dictionary.data(), dictionary.length());
+  if (NULL == ZstdCompressDictionary || NULL == ZstdDecompressDictionary) {
+    THROW_EXCEPTION_EX(IOException, "load zstd dictionary failed: [%s]", path.c_str());
+  }
+}
+
+///////////////////////////////////////////////////////////
+
+ZstdCompressStream::ZstdCompressStream(OutputStream * stream, uint32_t bufferSizeHint)
+    : BlockCompressStream(stream, bufferSizeHint) {
+  init();
+}
+
+ZstdCompressStream::~ZstdCompressStream() {
+  shutdown();
+}
+
+void * ZstdCompressStream::createContext() {
+  ZSTD_CCtx * context = ZSTD_createCCtx();
+  if (NULL == context) {
+    THROW_EXCEPTION(OutOfMemoryException, "create zstd compress context failed");
+  }
+  return context;
+}
+
+void ZstdCompressStream::destroyContext(void * context) {
+  ZSTD_freeCCtx((ZSTD_CCtx *)context);
+}
+
+uint32_t ZstdCompressStream::compressBlock(void * context, const void * buff, uint32_t length,
+    char * dest, uint32_t capacity) {
+  size_t compressedLength;
+  if (NULL != ZstdCompressDictionary) {
+    compressedLength = ZSTD_compress_usingCDict((ZSTD_CCtx *)context, dest, capacity, buff,
+        length, ZstdCompressDictionary);
+  } else {
+    compressedLength = ZSTD_compressCCtx((ZSTD_CCtx *)context, dest, capacity, buff, length,
+        ZstdLevel);
+  }
+  if (ZSTD_isError(compressedLength)) {
+    THROW_EXCEPTION_EX(IOException, "compress zstd failed: %s",
+        ZSTD_getErrorName(compressedLength));
+  }
+  return compressedLength;
+}
+
+/**
+ * a frame of raw blocks, with its content size in 4 bytes and no window
+ * descriptor, which zstd itself writes for data it can not compress. A
+ * dictionary the reader loads is not referred to
+ */
+uint32_t ZstdCompressStream::storeBlock(const void * buff, uint32_t length, char * dest,
+    uint32_t capacity) {
+  const uint32_t blockMax = 128 * 1024;
+  uint32_t blocks = length == 0 ? 1 : (length + blockMax - 1) / blockMax;
+  if ((uint64_t)9 + blocks * 3 + length > capacity) {
+    return 0;
+  }
+  uint8_t * out = (uint8_t *)dest;
+  const uint32_t magic = 0xfd2fb528;
+  for (int i = 0; i < 4; i++) {
+    *out++ = magic >> (8 * i);
+  }
+  // Frame_Content_Size_flag 2, Single_Segment_flag
+  *out++ = 0xa0;
+  for (int i = 0; i < 4; i++) {
+    *out++ = length >> (8 * i);
+  }
+  const char * in = (const char *)buff;
+  uint32_t left = length;
+  do {
+    uint32_t size = left < blockMax ? left : blockMax;
+    left -= size;
+    // Block_Size, Block_Type 0 for raw, Last_Block
+    uint32_t header = (size << 3) | (left == 0 ? 1 : 0);
+    *out++ = header;
+    *out++ = header >> 8;
+    *out++ = header >> 16;
+    memcpy(out, in, size);
+    out += size;
+    in += size;
+  } while (left > 0);
+  return out - (uint8_t *)dest;
+}
+
+uint64_t ZstdCompressStream::maxCompressedLength(uint64_t origLength) {
+  return ZSTD_compressBound(origLength);
+}
+
+//////////////////////////////////////////////////////////////
+
+ZstdDecompressStream::ZstdDecompressStream(InputStream * stream, uint32_t bufferSizeHint)
+    : BlockDecompressStream(stream, bufferSizeHint), _context(NULL) {
+  _context = ZSTD_createDCtx();
+  if (NULL == _context) {
+    THROW_EXCEPTION(OutOfMemoryException, "create zstd decompress context failed");
+  }
+  init();
+}
+
+ZstdDecompressStream::~ZstdDecompressStream() {
+  ZSTD_freeDCtx(_context);
+  _context = NULL;
+}
+
+uint32_t ZstdDecompressStream::decompressOneBlock(uint32_t compressedSize, void * buff,
+    uint32_t length) {
+  reserveTempBuffer(compressedSize);
+  uint32_t rd = _stream->readFully(_tempBuffer, compressedSize);
+  if (rd != compressedSize) {
+    THROW_EXCEPTION(IOException, "readFully reach EOF");
+  }
+  _compressedBytesRead += rd;
+  size_t uncompressedLength;
+  if (NULL != ZstdDecompressDictionary) {
+    uncompressedLength = ZSTD_decompress_usingDDict(_context, buff, length, _tempBuffer,
+        compressedSize, ZstdDecompressDictionary);
+  } else {
+    uncompressedLength = ZSTD_decompressDCtx(_context, buff, length, _tempBuffer,
+        compressedSize);
+  }
+  if (ZSTD_isError(uncompressedLength)) {
+    THROW_EXCEPTION_EX(IOException, "decompress zstd failed: %s",
+        ZSTD_getErrorName(uncompressedLength));
+  }
+  return uncompressedLength;
+}
+
+uint64_t ZstdDecompressStream::maxCompressedLength(uint64_t origLength) {
+  return ZSTD_compressBound(origLength);
+}
+
+} // namespace NativeTask
+
+#endif // define HADOOP_ZSTD_LIBRARY
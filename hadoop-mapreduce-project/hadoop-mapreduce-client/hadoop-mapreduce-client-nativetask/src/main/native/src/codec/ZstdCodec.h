@@ -0,0 +1,69 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ZSTDCODEC_H_
+#define ZSTDCODEC_H_
+
+#include "lib/Compressions.h"
+#include "BlockCodec.h"
+
+struct ZSTD_DCtx_s;
+
+namespace NativeTask {
+
+class Config;
+
+/**
+ * compression level and trained dictionary shared by all the zstd
+ * streams of a task, configured once before the streams are created
+ */
+class ZstdCodec {
+public:
+  static void configure(Config * config);
+};
+
+class ZstdCompressStream : public BlockCompressStream {
+public:
+  ZstdCompressStream(OutputStream * stream, uint32_t bufferSizeHint);
+
+  virtual ~ZstdCompressStream();
+protected:
+  virtual uint64_t maxCompressedLength(uint64_t origLength);
+  virtual void * createContext();
+  virtual void destroyContext(void * context);
+  virtual uint32_t compressBlock(void * context, const void * buff, uint32_t length, char * dest,
+      uint32_t capacity);
+  virtual uint32_t storeBlock(const void * buff, uint32_t length, char * dest, uint32_t capacity);
+};
+
+class ZstdDecompressStream : public BlockDecompressStream {
+private:
+  ZSTD_DCtx_s * _context;
+public:
+  ZstdDecompressStream(InputStream * stream, uint32_t bufferSizeHint);
+
+  virtual ~ZstdDecompressStream();
+protected:
+  virtual uint64_t maxCompressedLength(uint64_t origLength);
+  virtual uint32_t decompressOneBlock(uint32_t compressedSize, void * buff, uint32_t length);
+};
+
+} // namespace NativeTask
+
+#endif /* ZSTDCODEC_H_ */
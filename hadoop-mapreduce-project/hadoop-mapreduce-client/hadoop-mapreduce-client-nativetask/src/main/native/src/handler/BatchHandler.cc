@@ -24,6 +24,7 @@
 #include "lib/jniutils.h"
 #include "BatchHandler.h"
 #include "lib/NativeObjectFactory.h"
+#include "lib/TaskCounters.h"
 
 ///////////////////////////////////////////////////////////////
 // NativeBatchProcessor jni util methods
@@ -101,6 +102,7 @@ void BatchHandler::flushOutput() {
     return;
   }
 
+  PhaseTimer timer(JNI_UPCALL_PHASE);
   JNIEnv * env = JNU_GetJNIEnv();
   env->CallVoidMethod((jobject)_processor, FlushOutputMethodID, (jint)length);
   if (env->ExceptionCheck()) {
@@ -112,6 +114,7 @@ void BatchHandler::finishOutput() {
   if (NULL == _out.base()) {
     return;
   }
+  PhaseTimer timer(JNI_UPCALL_PHASE);
   JNIEnv * env = JNU_GetJNIEnv();
   env->CallVoidMethod((jobject)_processor, FinishOutputMethodID);
   if (env->ExceptionCheck()) {
@@ -274,16 +277,21 @@ void JNICALL Java_org_apache_hadoop_mapred_nativetask_NativeBatchProcessor_nativ
   }
 }
 
-void JNICALL Java_org_apache_hadoop_mapred_nativetask_NativeBatchProcessor_nativeLoadData(
+/*
+ * Class:     org_apache_hadoop_mapred_nativetask_NativeBatchProcessor
+ * Method:    nativeLoadData
+ * Signature: (J)I
+ */
+jint JNICALL Java_org_apache_hadoop_mapred_nativetask_NativeBatchProcessor_nativeLoadData(
     JNIEnv * jenv, jobject processor, jlong handler) {
   try {
     NativeTask::BatchHandler * batchHandler = (NativeTask::BatchHandler *)((void*)handler);
     if (NULL == batchHandler) {
       JNU_ThrowByName(jenv, "java/lang/IllegalArgumentException",
           "handler not instance of BatchHandler");
-      return;
+      return 0;
     }
-    batchHandler->onLoadData();
+    return (jint)batchHandler->onLoadData();
   } catch (NativeTask::UnsupportException & e) {
     JNU_ThrowByName(jenv, "java/lang/UnsupportedOperationException", e.what());
   } catch (NativeTask::OutOfMemoryException & e) {
@@ -298,6 +306,7 @@ void JNICALL Java_org_apache_hadoop_mapred_nativetask_NativeBatchProcessor_nativ
   } catch (...) {
     JNU_ThrowByName(jenv, "java/io/IOException", "Unknown exception");
   }
+  return 0;
 }
 
 /*
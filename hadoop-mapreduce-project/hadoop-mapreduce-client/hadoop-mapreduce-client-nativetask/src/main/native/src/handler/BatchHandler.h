@@ -63,7 +63,14 @@ public:
    */
   void onInputData(uint32_t length);
 
-  virtual void onLoadData() {
+  /**
+   * Called by java side to pull data from native side
+   * @return length of the data left in the output buffer, java reads it
+   *         when loadData returns, so the last chunk of every load needs
+   *         no flushOutput upcall
+   */
+  virtual uint32_t onLoadData() {
+    return 0;
   }
 
   /**
@@ -92,6 +99,17 @@ protected:
    */
   virtual void flushOutput();
 
+  /**
+   * Used by subclass, hand the output buffer to java as the return value
+   * of onLoadData instead of flushing it
+   * @return output buffer's available data length
+   */
+  uint32_t takeOutput() {
+    uint32_t length = _out.position();
+    _out.position(0);
+    return length;
+  }
+
   /**
    * Used by subclass, call java side finishOutput()
    */
@@ -108,7 +126,7 @@ protected:
         flushOutput();
       }
       uint32_t cp = length < remain ? length : remain;
-      simple_memcpy(_out.current(), buff, cp);
+      small_memcpy(_out.current(), buff, cp);
       buff += cp;
       length -= cp;
       _out.advance(cp);
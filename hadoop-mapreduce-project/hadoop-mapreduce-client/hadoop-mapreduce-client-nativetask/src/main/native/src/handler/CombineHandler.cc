@@ -82,9 +82,7 @@ uint32_t CombineHandler::feedDataToJavaInWritableSerialization() {
     }
   }
 
-  if (_out.position() > 0) {
-    flushOutput();
-  }
+  // the last chunk is returned by onLoadData
 
   _combineInputRecordCount += recordCount;
   _combineInputBytes += written;
@@ -221,8 +219,9 @@ string toString(uint32_t length) {
   return result;
 }
 
-void CombineHandler::onLoadData() {
+uint32_t CombineHandler::onLoadData() {
   feedDataToJava(WRITABLE_SERIALIZATION);
+  return takeOutput();
 }
 
 ResultBuffer * CombineHandler::onCall(const Command& command, ParameterBuffer * param) {
@@ -74,7 +74,7 @@ public:
 
   void combine(CombineContext type, KVIterator * kvIterator, IFileWriter * writer);
 
-  virtual void onLoadData();
+  virtual uint32_t onLoadData();
 
 private:
   void flushDataToWriter();
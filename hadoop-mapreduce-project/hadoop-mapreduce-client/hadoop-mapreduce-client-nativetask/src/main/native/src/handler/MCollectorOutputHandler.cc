@@ -22,6 +22,7 @@
 #include "MCollectorOutputHandler.h"
 #include "lib/NativeObjectFactory.h"
 #include "lib/MapOutputCollector.h"
+#include "lib/jniutils.h"
 #include "CombineHandler.h"
 
 using std::string;
@@ -29,11 +30,28 @@ using std::vector;
 
 namespace NativeTask {
 
+class AsyncCollectTask : public Runnable {
+private:
+  MCollectorOutputHandler * _handler;
+
+public:
+  AsyncCollectTask(MCollectorOutputHandler * handler)
+      : _handler(handler) {
+  }
+
+  virtual void run() {
+    _handler->collectLoop();
+  }
+};
+
 MCollectorOutputHandler::MCollectorOutputHandler()
-    : _collector(NULL), _dest(NULL), _endium(LARGE_ENDIUM) {
+    : _collector(NULL), _dest(NULL), _endium(LARGE_ENDIUM), _partialLength(0),
+        _ringFilled(_ringLock), _ringFreed(_ringLock), _ringHead(0), _ringCount(0),
+        _ringClosed(false), _collectPool(NULL), _collectTask(NULL) {
 }
 
 MCollectorOutputHandler::~MCollectorOutputHandler() {
+  stopAsyncCollect();
   _dest = NULL;
   delete _collector;
   _collector = NULL;
@@ -48,24 +66,158 @@ void MCollectorOutputHandler::configure(Config * config) {
 
   _collector = new MapOutputCollector(partition, this);
   _collector->configure(config);
+
+  if (config->getBool(NATIVE_COLLECT_ASYNC, false) && _in.capacity() > 0) {
+    if (_collector->hasCombiner()) {
+      // the java combiner can only be called from the collecting thread
+      LOG("[MCollectorOutputHandler] async collect disabled because a combiner is set");
+      return;
+    }
+    int64_t buffers = config->getInt(NATIVE_COLLECT_ASYNC_BUFFERS, 2);
+    buffers = std::max((int64_t)1, std::min(buffers, (int64_t)16));
+    for (int64_t i = 0; i < buffers; i++) {
+      _ring.push_back(new char[_in.capacity()]);
+    }
+    _ringLength.resize(_ring.size(), 0);
+    _collectTask = new AsyncCollectTask(this);
+    _collectPool = new ThreadPool(1);
+    _collectPool->submit(_collectTask);
+    LOG("[MCollectorOutputHandler] async collect with %zu buffers of %d bytes", _ring.size(),
+        _in.capacity());
+  }
 }
 
 void MCollectorOutputHandler::finish() {
+  stopAsyncCollect();
+  if (!_collectError.empty()) {
+    THROW_EXCEPTION_EX(IOException, "async collect failed: %s", _collectError.c_str());
+  }
+  if (_partialLength > 0) {
+    THROW_EXCEPTION(IOException, "k/v pair incomplete at the end of the map output");
+  }
   _collector->close();
   BatchHandler::finish();
 }
 
 void MCollectorOutputHandler::handleInput(ByteBuffer & in) {
-  char * buff = in.current();
-  uint32_t length = in.remain();
+  if (NULL == _collectPool) {
+    collectInput(in.current(), in.remain());
+    return;
+  }
+  const uint32_t length = in.remain();
+  if (length == 0) {
+    return;
+  }
+  uint32_t slot;
+  {
+    ScopeLock<Lock> autoLock(_ringLock);
+    while (_ringCount == _ring.size() && _collectError.empty()) {
+      _ringFreed.wait();
+    }
+    if (!_collectError.empty()) {
+      THROW_EXCEPTION_EX(IOException, "async collect failed: %s", _collectError.c_str());
+    }
+    slot = (_ringHead + _ringCount) % _ring.size();
+  }
+  // the collect thread doesn't touch the slot until it is counted
+  memcpy(_ring[slot], in.current(), length);
+  ScopeLock<Lock> autoLock(_ringLock);
+  _ringLength[slot] = length;
+  _ringCount++;
+  _ringFilled.signal();
+}
+
+void MCollectorOutputHandler::collectLoop() {
+  string error;
+  try {
+    if (NULL != _processor) {
+      // spills ask java for their path from this thread
+      JNU_AttachCurrentThread();
+    }
+  } catch (std::exception & e) {
+    error = e.what();
+  }
+  while (error.empty()) {
+    uint32_t slot;
+    {
+      ScopeLock<Lock> autoLock(_ringLock);
+      while (_ringCount == 0 && !_ringClosed) {
+        _ringFilled.wait();
+      }
+      if (_ringCount == 0) {
+        break;
+      }
+      slot = _ringHead;
+    }
+    try {
+      collectInput(_ring[slot], _ringLength[slot]);
+    } catch (std::exception & e) {
+      error = e.what();
+      break;
+    }
+    ScopeLock<Lock> autoLock(_ringLock);
+    _ringHead = (_ringHead + 1) % _ring.size();
+    _ringCount--;
+    _ringFreed.signalAll();
+  }
+  if (!error.empty()) {
+    ScopeLock<Lock> autoLock(_ringLock);
+    _collectError = error;
+    _ringFreed.signalAll();
+  }
+  if (NULL != _processor) {
+    try {
+      JNIEnv * env = JNU_GetJNIEnv();
+      if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+      }
+      JNU_DetachCurrentThread();
+    } catch (std::exception & e) {
+      LOG("[MCollectorOutputHandler] detaching the collect thread failed: %s", e.what());
+    }
+  }
+}
+
+void MCollectorOutputHandler::stopAsyncCollect() {
+  if (NULL == _collectPool) {
+    return;
+  }
+  {
+    ScopeLock<Lock> autoLock(_ringLock);
+    _ringClosed = true;
+    _ringFilled.signal();
+  }
+  // joins the collect thread once it has collected the filled slots
+  delete _collectPool;
+  _collectPool = NULL;
+  delete _collectTask;
+  _collectTask = NULL;
+  for (size_t i = 0; i < _ring.size(); i++) {
+    delete[] _ring[i];
+  }
+  _ring.clear();
+}
+
+void MCollectorOutputHandler::collectInput(char * buff, uint32_t length) {
+  PhaseTimer timer(COLLECT_PHASE);
 
   const char * end = buff + length;
   char * pos = buff;
+  if (_collector->isHashPartition()) {
+    handlePlainInput(pos, end);
+    return;
+  }
+
   if (_kvContainer.remain() > 0) {
     uint32_t filledLength = _kvContainer.fill(pos, length);
     pos += filledLength;
   }
 
+  // complete records go to the collector in one batch, a record which
+  // continues in the next buffer is filled through _kvContainer
+  pos += _collector->collectBatch(pos, end - pos, _endium);
+
   while (end - pos > 0) {
     KVBufferWithParititionId * kvBuffer = (KVBufferWithParititionId *)pos;
 
@@ -90,6 +242,46 @@ void MCollectorOutputHandler::handleInput(ByteBuffer & in) {
   }
 }
 
+void MCollectorOutputHandler::handlePlainInput(char * pos, const char * end) {
+  if (_partialLength > 0) {
+    uint32_t fillLength = std::min((uint32_t)(end - pos),
+        _partialLength - (uint32_t)_partialRecord.length());
+    _partialRecord.append(pos, fillLength);
+    pos += fillLength;
+    if (_partialRecord.length() < _partialLength) {
+      return;
+    }
+    collectPartialRecord();
+  }
+
+  pos += _collector->collectBatch(pos, end - pos, _endium);
+
+  if (end - pos > 0) {
+    if (unlikely(end - pos < KVBuffer::headerLength())) {
+      THROW_EXCEPTION(IOException, "k/v meta information incomplete");
+    }
+    KVBuffer * kvBuffer = (KVBuffer *)pos;
+    if (_endium == LARGE_ENDIUM) {
+      kvBuffer->keyLength = bswap(kvBuffer->keyLength);
+      kvBuffer->valueLength = bswap(kvBuffer->valueLength);
+    }
+    // only records larger than the java buffer get here, so the extra
+    // copy is cheap compared to the record itself
+    _partialLength = kvBuffer->length();
+    _partialRecord.assign(pos, end - pos);
+  }
+}
+
+void MCollectorOutputHandler::collectPartialRecord() {
+  KVBuffer * kvBuffer = (KVBuffer *)_partialRecord.data();
+  const char * key = kvBuffer->getKey();
+  uint32_t partitionId = _collector->getPartition(key, kvBuffer->keyLength);
+  _collector->collect(key, kvBuffer->keyLength, kvBuffer->getValue(), kvBuffer->valueLength,
+      partitionId);
+  _partialRecord.clear();
+  _partialLength = 0;
+}
+
 KVBuffer * MCollectorOutputHandler::allocateKVBuffer(uint32_t partitionId, uint32_t kvlength) {
   KVBuffer * dest = _collector->allocateKVBuffer(partitionId, kvlength);
   return dest;
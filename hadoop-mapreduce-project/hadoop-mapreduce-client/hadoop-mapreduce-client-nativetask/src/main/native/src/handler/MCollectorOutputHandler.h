@@ -22,11 +22,15 @@
 #include "BatchHandler.h"
 #include "lib/SpillOutputService.h"
 #include "AbstractMapHandler.h"
+#include "util/SyncUtils.h"
+#include "util/ThreadPool.h"
 
 namespace NativeTask {
 class MapOutputCollector;
 
 class MCollectorOutputHandler : public AbstractMapHandler {
+  friend class AsyncCollectTask;
+
 private:
 
   FixSizeContainer _kvContainer;
@@ -37,6 +41,26 @@ private:
 
   Endium _endium;
 
+  // start of a plain k/v record which continues in the next buffer, the
+  // partition is only known once the whole key arrived
+  std::string _partialRecord;
+  uint32_t _partialLength;
+
+  // native.collect.async: each java buffer is copied into a free slot of
+  // _ring and collected by _collectPool while java fills the next one.
+  // Slots [_ringHead, _ringHead + _ringCount) are waiting to be collected
+  Lock _ringLock;
+  Condition _ringFilled;
+  Condition _ringFreed;
+  std::vector<char *> _ring;
+  std::vector<uint32_t> _ringLength;
+  uint32_t _ringHead;
+  uint32_t _ringCount;
+  bool _ringClosed;
+  std::string _collectError;
+  ThreadPool * _collectPool;
+  Runnable * _collectTask;
+
 public:
   MCollectorOutputHandler();
   virtual ~MCollectorOutputHandler();
@@ -46,6 +70,30 @@ public:
   virtual void handleInput(ByteBuffer & byteBuffer);
 private:
   KVBuffer * allocateKVBuffer(uint32_t partition, uint32_t kvlength);
+
+  /**
+   * collect the records of one java buffer
+   */
+  void collectInput(char * buff, uint32_t length);
+
+  /**
+   * body of the background collect thread, collects the filled slots
+   * until the ring is closed
+   */
+  void collectLoop();
+
+  /**
+   * close the ring and wait for the collect thread to finish the
+   * filled slots
+   */
+  void stopAsyncCollect();
+
+  /**
+   * input without partition ids, for native hash partitioning
+   */
+  void handlePlainInput(char * pos, const char * end);
+
+  void collectPartialRecord();
 };
 
 }
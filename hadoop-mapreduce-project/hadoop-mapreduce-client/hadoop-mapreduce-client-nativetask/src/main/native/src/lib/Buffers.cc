@@ -22,19 +22,21 @@
 #include "util/StringUtil.h"
 #include "util/WritableUtils.h"
 #include "lib/Buffers.h"
+#include "native_memory.h"
 
 namespace NativeTask {
 
 
 ReadBuffer::ReadBuffer()
-    : _buff(NULL), _remain(0), _size(0), _capacity(0), _stream(NULL), _source(NULL) {
+    : _buff(NULL), _remain(0), _size(0), _capacity(0), _stream(NULL), _source(NULL),
+        _wrapped(false) {
 }
 
 void ReadBuffer::init(uint32_t size, InputStream * stream, const string & codec) {
   if (size < 1024) {
     THROW_EXCEPTION_EX(UnsupportException, "ReadBuffer size %u not support.", size);
   }
-  _buff = (char *)malloc(size);
+  _buff = (char *)native_memory_malloc(NATIVE_MEMORY_BUFFERS, size);
   if (NULL == _buff) {
     THROW_EXCEPTION(OutOfMemoryException, "create append buffer");
   }
@@ -51,13 +53,32 @@ void ReadBuffer::init(uint32_t size, InputStream * stream, const string & codec)
   }
 }
 
+void ReadBuffer::wrap(const char * data, uint32_t length) {
+  if (NULL != _buff && !_wrapped) {
+    native_memory_free(NATIVE_MEMORY_BUFFERS, _buff);
+  }
+  if (_source != _stream) {
+    delete _source;
+  }
+  _buff = (char *)data;
+  _wrapped = true;
+  _capacity = length;
+  _remain = length;
+  _size = length;
+  _stream = NULL;
+  _source = NULL;
+}
+
 ReadBuffer::~ReadBuffer() {
   if (_source != _stream) {
     delete _source;
     _source = NULL;
   }
+  if (_wrapped) {
+    _buff = NULL;
+  }
   if (NULL != _buff) {
-    free(_buff);
+    native_memory_free(NATIVE_MEMORY_BUFFERS, _buff);
     _buff = NULL;
     _capacity = 0;
     _remain = 0;
@@ -66,10 +87,13 @@ ReadBuffer::~ReadBuffer() {
 }
 
 char * ReadBuffer::fillGet(uint32_t count) {
+  if (_wrapped) {
+    THROW_EXCEPTION(IOException, "read reach end of wrapped buffer");
+  }
 
   if (unlikely(count > _capacity)) {
     uint32_t newcap = _capacity * 2 > count ? _capacity * 2 : count;
-    char * newbuff = (char*)malloc(newcap);
+    char * newbuff = (char*)native_memory_malloc(NATIVE_MEMORY_BUFFERS, newcap);
 
 
     if (newbuff == NULL) {
@@ -81,7 +105,7 @@ char * ReadBuffer::fillGet(uint32_t count) {
       memcpy(newbuff, current(), _remain);
     }
     if (NULL != _buff) {
-      free(_buff);
+      native_memory_free(NATIVE_MEMORY_BUFFERS, _buff);
     }
 
     _buff = newbuff;
@@ -111,6 +135,9 @@ int32_t ReadBuffer::fillRead(char * buff, uint32_t len) {
     memcpy(buff, current(), cp);
     _remain = 0;
   }
+  if (_wrapped) {
+    return cp > 0 ? cp : -1;
+  }
   // TODO: read to buffer first
   int32_t ret = _source->readFully(buff + cp, len - cp);
   if (ret < 0 && cp == 0) {
@@ -122,6 +149,9 @@ int32_t ReadBuffer::fillRead(char * buff, uint32_t len) {
 
 int64_t ReadBuffer::fillReadVLong() {
   if (_remain == 0) {
+    if (_wrapped) {
+      THROW_EXCEPTION(IOException, "fillReadVLong reach end of wrapped buffer");
+    }
     int32_t rd = _source->read(_buff, _capacity);
     if (rd <= 0) {
       THROW_EXCEPTION(IOException, "fillReadVLong reach EOF");
@@ -156,7 +186,7 @@ void AppendBuffer::init(uint32_t size, OutputStream * stream, const string & cod
   if (size < 1024) {
     THROW_EXCEPTION_EX(UnsupportException, "AppendBuffer size %u not support.", size);
   }
-  _buff = (char *)malloc(size + 8);
+  _buff = (char *)native_memory_malloc(NATIVE_MEMORY_BUFFERS, size + 8);
   if (NULL == _buff) {
     THROW_EXCEPTION(OutOfMemoryException, "create append buffer");
   }
@@ -187,7 +217,7 @@ AppendBuffer::~AppendBuffer() {
     _dest = NULL;
   }
   if (NULL != _buff) {
-    free(_buff);
+    native_memory_free(NATIVE_MEMORY_BUFFERS, _buff);
     _buff = NULL;
     _remain = 0;
     _capacity = 0;
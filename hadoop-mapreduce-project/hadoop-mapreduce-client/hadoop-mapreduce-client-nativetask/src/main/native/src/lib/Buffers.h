@@ -22,6 +22,7 @@
 #include "lib/Streams.h"
 #include "lib/Compressions.h"
 #include "lib/Constants.h"
+#include "util/WritableUtils.h"
 
 namespace NativeTask {
 
@@ -38,6 +39,8 @@ protected:
 
   InputStream * _stream;
   InputStream * _source;
+  // _buff points to memory owned by someone else, see wrap()
+  bool _wrapped;
 
 protected:
   inline char * current() {
@@ -52,8 +55,18 @@ public:
 
   void init(uint32_t size, InputStream * stream, const string & codec);
 
+  /**
+   * read the length bytes at data in place, without a stream behind
+   * them, reading past the end throws
+   */
+  void wrap(const char * data, uint32_t length);
+
   ~ReadBuffer();
 
+  uint32_t remain() {
+    return _remain;
+  }
+
   /**
    * use get() to get inplace continuous memory of small object
    */
@@ -104,6 +117,25 @@ public:
     return fillReadVLong();
   }
 
+  /**
+   * read the two vlongs of an IFile record header, while the buffer holds
+   * two encodings of the longest size they are decoded in place without
+   * any refill checks
+   */
+  inline void readVLongPair(int64_t & first, int64_t & second) {
+    if (likely(_remain >= 2 * WritableUtils::MAX_VLONG_SIZE)) {
+      const char * pos = current();
+      uint32_t firstLen;
+      uint32_t secondLen;
+      first = WritableUtils::ReadVLongUnchecked(pos, firstLen);
+      second = WritableUtils::ReadVLongUnchecked(pos + firstLen, secondLen);
+      _remain -= firstLen + secondLen;
+      return;
+    }
+    first = readVLong();
+    second = readVLong();
+  }
+
   /**
    * read uint32_t little endian
    */
@@ -152,6 +184,15 @@ public:
 
   CompressStream * getCompressionStream();
 
+  /**
+   * drop what is buffered and restart the counter, for a new output on
+   * the same stream chain
+   */
+  void reset() {
+    _remain = _capacity;
+    _counter = 0;
+  }
+
   uint64_t getCounter() {
     return _counter;
   }
@@ -291,10 +332,10 @@ struct KVBuffer {
     valueLength = vallen;
 
     if (keylen > 0) {
-      simple_memcpy(getKey(), key, keylen);
+      small_memcpy(getKey(), key, keylen);
     }
     if (vallen > 0) {
-      simple_memcpy(getValue(), value, vallen);
+      small_memcpy(getValue(), value, vallen);
     }
   }
 
@@ -303,6 +344,22 @@ struct KVBuffer {
   }
 };
 
+/**
+ * KVBuffer of a small record with 16 bits lengths, MemoryBlock::compact
+ * rewrites the records of a block with it
+ */
+struct CompactKVBuffer {
+  uint16_t keyLength;
+  uint16_t valueLength;
+  char content[1];
+
+  static const uint32_t MAX_LENGTH = 0xffff;
+
+  static uint32_t headerLength() {
+    return 4;
+  }
+};
+
 struct KVBufferWithParititionId {
   uint32_t partitionId;
   KVBuffer buffer;
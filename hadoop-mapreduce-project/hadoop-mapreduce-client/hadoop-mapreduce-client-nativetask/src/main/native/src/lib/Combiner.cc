@@ -0,0 +1,101 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "lib/Combiner.h"
+
+namespace NativeTask {
+
+NativeCombiner::NativeCombiner(NativeCombineType type, KeyValueType valueType)
+    : _type(type), _valueType(valueType) {
+  if (valueType != IntType && valueType != LongType) {
+    THROW_EXCEPTION_EX(UnsupportException,
+        "Native combiners only support IntWritable and LongWritable values, got type %d",
+        valueType);
+  }
+}
+
+NativeCombiner * NativeCombiner::create(const std::string & name, KeyValueType valueType) {
+  if (name == "NativeTask.SumCombiner") {
+    return new NativeCombiner(SUM_COMBINE, valueType);
+  } else if (name == "NativeTask.MinCombiner") {
+    return new NativeCombiner(MIN_COMBINE, valueType);
+  } else if (name == "NativeTask.MaxCombiner") {
+    return new NativeCombiner(MAX_COMBINE, valueType);
+  }
+  return NULL;
+}
+
+int64_t NativeCombiner::readValue(const char * value, uint32_t length) {
+  if (_valueType == IntType) {
+    if (length != 4) {
+      THROW_EXCEPTION_EX(IOException, "IntWritable value of length %u", length);
+    }
+    return (int32_t)bswap(*(const uint32_t *)value);
+  }
+  if (length != 8) {
+    THROW_EXCEPTION_EX(IOException, "LongWritable value of length %u", length);
+  }
+  return (int64_t)bswap64(*(const uint64_t *)value);
+}
+
+void NativeCombiner::combine(CombineContext type, KVIterator * kvIterator,
+    IFileWriter * writer) {
+  KeyGroupIteratorImpl groups(kvIterator, &_grouping);
+  const bool grouped = !_grouping.byWholeKey();
+  while (groups.nextKey()) {
+    uint32_t length = 0;
+    const char * key = groups.getKey(length);
+    // the key buffer moves on to the next group when the values run out
+    _key.assign(key, length);
+
+    const char * value = groups.nextValue(length);
+    int64_t result = readValue(value, length);
+    while (NULL != (value = groups.nextValue(length))) {
+      int64_t current = readValue(value, length);
+      if (grouped) {
+        uint32_t keyLength;
+        const char * groupKey = groups.getKey(keyLength);
+        _key.assign(groupKey, keyLength);
+      }
+      switch (_type) {
+      case SUM_COMBINE:
+        // wraps around like the java reducers do
+        result = (int64_t)((uint64_t)result + (uint64_t)current);
+        break;
+      case MIN_COMBINE:
+        result = std::min(result, current);
+        break;
+      case MAX_COMBINE:
+        result = std::max(result, current);
+        break;
+      }
+    }
+
+    if (_valueType == IntType) {
+      uint32_t output = bswap((uint32_t)result);
+      writer->write(_key.data(), _key.length(), (const char *)&output, 4);
+    } else {
+      uint64_t output = bswap64((uint64_t)result);
+      writer->write(_key.data(), _key.length(), (const char *)&output, 8);
+    }
+  }
+}
+
+} // namespace NativeTask
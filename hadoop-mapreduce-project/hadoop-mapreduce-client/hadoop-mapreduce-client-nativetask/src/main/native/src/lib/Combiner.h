@@ -19,6 +19,7 @@
 #define COMBINER_H_
 #include "commons.h"
 #include "lib/IFile.h"
+#include "lib/MapOutputSpec.h"
 
 namespace NativeTask {
 
@@ -66,5 +67,49 @@ public:
   }
 };
 
+enum NativeCombineType {
+  SUM_COMBINE = 0,
+  MIN_COMBINE = 1,
+  MAX_COMBINE = 2,
+};
+
+/**
+ * built-in combiner for IntWritable and LongWritable values, the values of
+ * each key are folded into one record without going through java.
+ * Selected with native.combiner.class set to NativeTask.SumCombiner,
+ * NativeTask.MinCombiner or NativeTask.MaxCombiner. The result has the
+ * type of the input values, so the combiner can run again on its own
+ * output when spills are merged
+ */
+class NativeCombiner : public ICombineRunner {
+private:
+  NativeCombineType _type;
+  KeyValueType _valueType;
+  KeyGrouping _grouping;
+  std::string _key;
+
+public:
+  NativeCombiner(NativeCombineType type, KeyValueType valueType);
+
+  /**
+   * NULL if name is not one of the built-in combiners
+   */
+  static NativeCombiner * create(const std::string & name, KeyValueType valueType);
+
+  /**
+   * fold the values of a group instead of equal keys, the last key of
+   * the group is written like by a java combiner that writes after its
+   * loop over the values
+   */
+  void setGrouping(const KeyGrouping & grouping) {
+    _grouping = grouping;
+  }
+
+  virtual void combine(CombineContext type, KVIterator * kvIterator, IFileWriter * writer);
+
+private:
+  int64_t readValue(const char * value, uint32_t length);
+};
+
 } /* namespace NativeTask */
 #endif /* COMBINER_H_ */
@@ -23,6 +23,7 @@
 #include "codec/GzipCodec.h"
 #include "codec/SnappyCodec.h"
 #include "codec/Lz4Codec.h"
+#include "codec/ZstdCodec.h"
 
 namespace NativeTask {
 
@@ -50,6 +51,8 @@ const Compressions::Codec Compressions::SnappyCodec = Compressions::Codec(
     "org.apache.hadoop.io.compress.SnappyCodec", ".snappy");
 const Compressions::Codec Compressions::Lz4Codec = Compressions::Codec(
     "org.apache.hadoop.io.compress.Lz4Codec", ".lz4");
+const Compressions::Codec Compressions::ZstdCodec = Compressions::Codec(
+    "org.apache.hadoop.io.compress.ZStandardCodec", ".zstd");
 
 vector<Compressions::Codec> Compressions::SupportedCodecs = vector<Compressions::Codec>();
 
@@ -60,9 +63,21 @@ void Compressions::initCodecs() {
     SupportedCodecs.push_back(GzipCodec);
     SupportedCodecs.push_back(SnappyCodec);
     SupportedCodecs.push_back(Lz4Codec);
+#if defined HADOOP_ZSTD_LIBRARY
+    // Without it the Java collector handles the job
+    SupportedCodecs.push_back(ZstdCodec);
+#endif
   }
 }
 
+void Compressions::configure(Config * config) {
+  BlockCompressStream::configure(config);
+  NativeTask::GzipCodec::configure(config);
+#if defined HADOOP_ZSTD_LIBRARY
+  NativeTask::ZstdCodec::configure(config);
+#endif
+}
+
 bool Compressions::support(const string & codec) {
   initCodecs();
   for (size_t i = 0; i < SupportedCodecs.size(); i++) {
@@ -120,6 +135,13 @@ CompressStream * Compressions::getCompressionStream(const string & codec, Output
   if (codec == Lz4Codec.name) {
     return new Lz4CompressStream(stream, bufferSizeHint);
   }
+  if (codec == ZstdCodec.name) {
+#if defined HADOOP_ZSTD_LIBRARY
+    return new ZstdCompressStream(stream, bufferSizeHint);
+#else
+    THROW_EXCEPTION(UnsupportException, "ZStandard library is not loaded");
+#endif
+  }
   return NULL;
 }
 
@@ -138,6 +160,13 @@ DecompressStream * Compressions::getDecompressionStream(const string & codec, In
   if (codec == Lz4Codec.name) {
     return new Lz4DecompressStream(stream, bufferSizeHint);
   }
+  if (codec == ZstdCodec.name) {
+#if defined HADOOP_ZSTD_LIBRARY
+    return new ZstdDecompressStream(stream, bufferSizeHint);
+#else
+    THROW_EXCEPTION(UnsupportException, "ZStandard library is not loaded");
+#endif
+  }
   return NULL;
 }
 
@@ -25,6 +25,8 @@
 
 namespace NativeTask {
 
+class Config;
+
 using std::vector;
 using std::string;
 
@@ -46,6 +48,12 @@ public:
 
   }
 
+  /**
+   * a new spill is written, streams that adapt to the data start over
+   */
+  virtual void startSpill() {
+  }
+
   virtual uint64_t compressedBytesWritten() {
     return 0;
   }
@@ -86,8 +94,14 @@ public:
   static const Codec GzipCodec;
   static const Codec SnappyCodec;
   static const Codec Lz4Codec;
+  static const Codec ZstdCodec;
 
 public:
+  /**
+   * codec settings of the task, e.g. the zstd level and dictionary
+   */
+  static void configure(Config * config);
+
   static bool support(const string & codec);
 
   static const string getExtension(const string & codec);
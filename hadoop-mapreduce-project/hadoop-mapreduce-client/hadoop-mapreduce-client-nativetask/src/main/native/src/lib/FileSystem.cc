@@ -20,11 +20,15 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include "lib/commons.h"
 #include "util/StringUtil.h"
 #include "lib/jniutils.h"
 #include "NativeTask.h"
 #include "lib/TaskCounters.h"
+#include "lib/TieredFileSystem.h"
 #include "lib/NativeObjectFactory.h"
 #include "lib/Path.h"
 #include "lib/FileSystem.h"
@@ -33,7 +37,8 @@ namespace NativeTask {
 
 /////////////////////////////////////////////////////////////
 
-FileInputStream::FileInputStream(const string & path) {
+FileInputStream::FileInputStream(const string & path)
+    : _position(0), _readAhead(0), _readAheadEnd(0) {
   _fd = ::open(path.c_str(), O_RDONLY);
   if (_fd >= 0) {
     _path = path;
@@ -49,8 +54,33 @@ FileInputStream::~FileInputStream() {
   close();
 }
 
+void FileInputStream::setReadAhead(uint32_t length) {
+  _readAhead = length;
+  _readAheadEnd = _position;
+  if (_readAhead > 0) {
+    ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    readAhead();
+  }
+}
+
+void FileInputStream::readAhead() {
+  // advise the next window once half of the current one is consumed,
+  // so a whole window is always in flight ahead of the reader
+  if (_position + _readAhead / 2 < _readAheadEnd) {
+    return;
+  }
+  uint64_t start = std::max(_position, _readAheadEnd);
+  ::posix_fadvise(_fd, start, _position + _readAhead - start, POSIX_FADV_WILLNEED);
+  _readAheadEnd = _position + _readAhead;
+}
+
 void FileInputStream::seek(uint64_t position) {
   ::lseek(_fd, position, SEEK_SET);
+  _position = position;
+  if (_readAhead > 0) {
+    _readAheadEnd = _position;
+    readAhead();
+  }
 }
 
 uint64_t FileInputStream::tell() {
@@ -61,6 +91,10 @@ int32_t FileInputStream::read(void * buff, uint32_t length) {
   int32_t ret = ::read(_fd, buff, length);
   if (ret > 0) {
     _bytesRead->increase(ret);
+    _position += ret;
+    if (_readAhead > 0) {
+      readAhead();
+    }
   }
   return ret;
 }
@@ -74,7 +108,79 @@ void FileInputStream::close() {
 
 /////////////////////////////////////////////////////////////
 
-FileOutputStream::FileOutputStream(const string & path, bool overwite) {
+MmapInputStream::MmapInputStream(const string & path)
+    : _data(NULL), _length(0), _position(0) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    THROW_EXCEPTION_EX(IOException, "Can't open file for read: [%s]", path.c_str());
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    THROW_EXCEPTION_EX(IOException, "Can't stat file: [%s]", path.c_str());
+  }
+  _length = st.st_size;
+  if (_length > 0) {
+    void * data = ::mmap(NULL, _length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == data) {
+      ::close(fd);
+      THROW_EXCEPTION_EX(IOException, "Can't mmap file: [%s]", path.c_str());
+    }
+    _data = (char *)data;
+    ::madvise(_data, _length, MADV_SEQUENTIAL);
+  }
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  _path = path;
+  _bytesRead = NativeObjectFactory::GetCounter(TaskCounters::FILESYSTEM_COUNTER_GROUP,
+      TaskCounters::FILE_BYTES_READ);
+}
+
+MmapInputStream::~MmapInputStream() {
+  close();
+}
+
+const char * MmapInputStream::get(uint64_t length) {
+  if (length > _length - _position) {
+    THROW_EXCEPTION_EX(IOException, "read %"PRIu64" bytes beyond end of file: [%s]", length,
+        _path.c_str());
+  }
+  const char * ret = _data + _position;
+  _position += length;
+  _bytesRead->increase(length);
+  return ret;
+}
+
+void MmapInputStream::seek(uint64_t position) {
+  _position = std::min(position, _length);
+}
+
+uint64_t MmapInputStream::tell() {
+  return _position;
+}
+
+int32_t MmapInputStream::read(void * buff, uint32_t length) {
+  if (_position >= _length) {
+    return -1;
+  }
+  uint32_t rd = (uint32_t)std::min((uint64_t)length, _length - _position);
+  memcpy(buff, _data + _position, rd);
+  _position += rd;
+  _bytesRead->increase(rd);
+  return rd;
+}
+
+void MmapInputStream::close() {
+  if (NULL != _data) {
+    ::munmap(_data, _length);
+    _data = NULL;
+  }
+}
+
+/////////////////////////////////////////////////////////////
+
+FileOutputStream::FileOutputStream(const string & path, bool overwite)
+    : _position(0), _dropBehind(0), _syncedEnd(0), _droppedEnd(0) {
   int flags = 0;
   if (overwite) {
     flags = O_WRONLY | O_CREAT | O_TRUNC;
@@ -94,6 +200,23 @@ FileOutputStream::FileOutputStream(const string & path, bool overwite) {
       TaskCounters::FILE_BYTES_WRITTEN);
 }
 
+FileOutputStream::FileOutputStream(const string & path, uint64_t offset)
+    : _position(offset), _dropBehind(0), _syncedEnd(offset), _droppedEnd(offset) {
+  _fd = ::open(path.c_str(), O_WRONLY);
+  if (_fd < 0) {
+    THROW_EXCEPTION_EX(IOException, "Can't open file for write: [%s]", path.c_str());
+  }
+  if (::lseek(_fd, offset, SEEK_SET) != (off_t)offset) {
+    ::close(_fd);
+    _fd = -1;
+    THROW_EXCEPTION_EX(IOException, "Can't seek to %"PRIu64" in file: [%s]", offset,
+        path.c_str());
+  }
+  _path = path;
+  _bytesWrite = NativeObjectFactory::GetCounter(TaskCounters::FILESYSTEM_COUNTER_GROUP,
+      TaskCounters::FILE_BYTES_WRITTEN);
+}
+
 FileOutputStream::~FileOutputStream() {
   close();
 }
@@ -102,11 +225,83 @@ uint64_t FileOutputStream::tell() {
   return ::lseek(_fd, 0, SEEK_CUR);
 }
 
+void FileOutputStream::setDropBehind(uint32_t length) {
+  _dropBehind = length;
+}
+
 void FileOutputStream::write(const void * buff, uint32_t length) {
   if (::write(_fd, buff, length) < length) {
     THROW_EXCEPTION(IOException, "::write error");
   }
   _bytesWrite->increase(length);
+  _position += length;
+  if (_dropBehind > 0 && _position - _syncedEnd >= _dropBehind) {
+    dropBehind(false);
+  }
+}
+
+void FileOutputStream::writev(const struct iovec * iov, uint32_t count) {
+  // ::writev takes at most IOV_MAX buffers and may write only a part
+  struct iovec partial;
+  uint64_t total = 0;
+  while (count > 0) {
+    int batch = count < IOV_MAX ? count : IOV_MAX;
+    ssize_t written = ::writev(_fd, iov, batch);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      THROW_EXCEPTION(IOException, "::writev error");
+    }
+    total += written;
+    while (count > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (written > 0) {
+      partial.iov_base = (char *)iov->iov_base + written;
+      partial.iov_len = iov->iov_len - written;
+      write(partial.iov_base, partial.iov_len);
+      total -= partial.iov_len;
+      iov++;
+      count--;
+    }
+  }
+  _bytesWrite->increase(total);
+  _position += total;
+  if (_dropBehind > 0 && _position - _syncedEnd >= _dropBehind) {
+    dropBehind(false);
+  }
+}
+
+void FileOutputStream::dropBehind(bool wait) {
+#ifdef SYNC_FILE_RANGE_WRITE
+  // the previous window had a whole window of writes to reach the disk,
+  // wait for it and drop it, then start the write back of the new one
+  if (_syncedEnd > _droppedEnd) {
+    ::sync_file_range(_fd, _droppedEnd, _syncedEnd - _droppedEnd,
+        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    ::posix_fadvise(_fd, _droppedEnd, _syncedEnd - _droppedEnd, POSIX_FADV_DONTNEED);
+    _droppedEnd = _syncedEnd;
+  }
+  if (_position > _syncedEnd) {
+    int flags = SYNC_FILE_RANGE_WRITE;
+    if (wait) {
+      flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;
+    }
+    ::sync_file_range(_fd, _syncedEnd, _position - _syncedEnd, flags);
+    _syncedEnd = _position;
+  }
+  if (wait && _syncedEnd > _droppedEnd) {
+    ::posix_fadvise(_fd, _droppedEnd, _syncedEnd - _droppedEnd, POSIX_FADV_DONTNEED);
+    _droppedEnd = _syncedEnd;
+  }
+#else
+  // without sync_file_range only the pages already written back are dropped
+  ::posix_fadvise(_fd, _droppedEnd, _position - _droppedEnd, POSIX_FADV_DONTNEED);
+  _syncedEnd = _position;
+#endif
 }
 
 void FileOutputStream::flush() {
@@ -114,6 +309,9 @@ void FileOutputStream::flush() {
 
 void FileOutputStream::close() {
   if (_fd >= 0) {
+    if (_dropBehind > 0) {
+      dropBehind(true);
+    }
     ::close(_fd);
     _fd = -1;
   }
@@ -267,4 +465,26 @@ FileSystem & FileSystem::getLocal() {
   return RawFileSystemInstance;
 }
 
+static std::map<string, FileSystem *> & fileSystems() {
+  static std::map<string, FileSystem *> registry;
+  if (registry.empty()) {
+    registry["local"] = &RawFileSystemInstance;
+    registry["tiered"] = &TieredFileSystem::getInstance();
+  }
+  return registry;
+}
+
+FileSystem * FileSystem::get(const string & name) {
+  std::map<string, FileSystem *> & registry = fileSystems();
+  std::map<string, FileSystem *>::iterator itr = registry.find(name);
+  if (itr == registry.end()) {
+    return NULL;
+  }
+  return itr->second;
+}
+
+void FileSystem::registerFileSystem(const string & name, FileSystem * fs) {
+  fileSystems()[name] = fs;
+}
+
 } // namespace NativeTask
@@ -36,10 +36,54 @@ private:
   string _path;
   int _fd;
   Counter * _bytesRead;
+  uint64_t _position;
+  uint32_t _readAhead;
+  uint64_t _readAheadEnd;
 public:
   FileInputStream(const string & path);
   virtual ~FileInputStream();
 
+  /**
+   * keep the next length bytes after the read position in flight, the
+   * kernel reads them asynchronously so sequential reads don't wait
+   * for the disk. 0 disables read-ahead
+   */
+  void setReadAhead(uint32_t length);
+
+  virtual void seek(uint64_t position);
+
+  virtual uint64_t tell();
+
+  virtual int32_t read(void * buff, uint32_t length);
+
+  virtual void close();
+
+private:
+  void readAhead();
+};
+
+/**
+ * Local raw filesystem file input stream backed by a read only
+ * mapping of the whole file, data() lets readers use the bytes
+ * in place instead of copying them out with read()
+ */
+class MmapInputStream : public InputStream {
+private:
+  string _path;
+  char * _data;
+  uint64_t _length;
+  uint64_t _position;
+  Counter * _bytesRead;
+public:
+  MmapInputStream(const string & path);
+  virtual ~MmapInputStream();
+
+  /**
+   * take the next length bytes in place, the returned memory is valid
+   * until the stream is closed
+   */
+  const char * get(uint64_t length);
+
   virtual void seek(uint64_t position);
 
   virtual uint64_t tell();
@@ -58,17 +102,39 @@ private:
   string _path;
   int _fd;
   Counter * _bytesWrite;
+  uint64_t _position;
+  uint32_t _dropBehind;
+  uint64_t _syncedEnd;
+  uint64_t _droppedEnd;
 public:
   FileOutputStream(const string & path, bool overwite = true);
+
+  /**
+   * open an existing file for writing at offset, for several writers
+   * filling different ranges of the same file
+   */
+  FileOutputStream(const string & path, uint64_t offset);
   virtual ~FileOutputStream();
 
+  /**
+   * every length bytes written start the write back of the new data and
+   * drop the data written before it from the page cache, so large files
+   * written once don't evict the cache of other processes. 0 disables it
+   */
+  void setDropBehind(uint32_t length);
+
   virtual uint64_t tell();
 
   virtual void write(const void * buff, uint32_t length);
 
+  virtual void writev(const struct iovec * iov, uint32_t count);
+
   virtual void flush();
 
   virtual void close();
+
+private:
+  void dropBehind(bool wait);
 };
 
 
@@ -115,7 +181,25 @@ public:
   virtual void mkdirs(const string & path) {
   }
 
+  /**
+   * per job settings, called by each user of the file system
+   */
+  virtual void configure(Config * config) {
+  }
+
   static FileSystem & getLocal();
+
+  /**
+   * file systems are looked up by name, "local" is always there and
+   * "tiered" keeps files in memory before they go to the local disk
+   * @return NULL if no file system has this name
+   */
+  static FileSystem * get(const string & name);
+
+  /**
+   * fs is not owned, it must live until the process exits
+   */
+  static void registerFileSystem(const string & name, FileSystem * fs);
 };
 
 } // namespace NativeTask
@@ -19,22 +19,60 @@
 #include "lib/commons.h"
 #include "util/StringUtil.h"
 #include "lib/IFile.h"
+#include "lib/BufferStream.h"
 #include "lib/Compressions.h"
 #include "lib/FileSystem.h"
+#include "lib/TaskCounters.h"
 
 namespace NativeTask {
 
 ///////////////////////////////////////////////////////////
 
 IFileReader::IFileReader(InputStream * stream, SingleSpillInfo * spill, bool deleteInputStream)
-    :  _stream(stream), _source(NULL), _checksumType(spill->checkSumType), _kType(spill->keyType),
+    :  _stream(stream), _mapped(NULL), _buffer(NULL), _source(NULL),
+        _checksumType(spill->checkSumType), _kType(spill->keyType),
         _vType(spill->valueType), _codec(spill->codec), _segmentIndex(-1), _spillInfo(spill),
-        _valuePos(NULL), _valueLen(0), _deleteSourceStream(deleteInputStream) {
+        _valuePos(NULL), _valueLen(0), _deleteSourceStream(deleteInputStream),
+        _prefixKeys(spill->prefixKeys) {
   _source = new ChecksumInputStream(_stream, _checksumType);
   _source->setLimit(0);
   _reader.init(128 * 1024, _source, _codec);
 }
 
+IFileReader::IFileReader(MmapInputStream * stream, SingleSpillInfo * spill,
+    bool deleteInputStream)
+    :  _stream(stream), _mapped(NULL), _buffer(NULL), _source(NULL),
+        _checksumType(spill->checkSumType), _kType(spill->keyType),
+        _vType(spill->valueType), _codec(spill->codec), _segmentIndex(-1), _spillInfo(spill),
+        _valuePos(NULL), _valueLen(0), _deleteSourceStream(deleteInputStream),
+        _prefixKeys(spill->prefixKeys) {
+  if (_codec.length() == 0) {
+    _mapped = stream;
+  } else {
+    _source = new ChecksumInputStream(_stream, _checksumType);
+    _source->setLimit(0);
+    _reader.init(128 * 1024, _source, _codec);
+  }
+}
+
+IFileReader::IFileReader(const char * buffer, SingleSpillInfo * spill)
+    :  _stream(NULL), _mapped(NULL), _buffer(NULL), _source(NULL),
+        _checksumType(spill->checkSumType), _kType(spill->keyType),
+        _vType(spill->valueType), _codec(spill->codec), _segmentIndex(-1), _spillInfo(spill),
+        _valuePos(NULL), _valueLen(0), _deleteSourceStream(false),
+        _prefixKeys(spill->prefixKeys) {
+  if (_codec.length() == 0) {
+    _buffer = buffer;
+  } else {
+    // compressed segments still need to be decompressed into the read buffer
+    _stream = new InputBuffer(buffer, spill->getRealEndPosition());
+    _deleteSourceStream = true;
+    _source = new ChecksumInputStream(_stream, _checksumType);
+    _source->setLimit(0);
+    _reader.init(128 * 1024, _source, _codec);
+  }
+}
+
 IFileReader::~IFileReader() {
 
   delete _source;
@@ -51,6 +89,9 @@ IFileReader::~IFileReader() {
  * 1 if end
  */
 bool IFileReader::nextPartition() {
+  if (NULL != _mapped || NULL != _buffer) {
+    return nextInPlacePartition();
+  }
   if (0 != _source->getLimit()) {
     THROW_EXCEPTION(IOException, "bad ifile segment length");
   }
@@ -66,8 +107,12 @@ bool IFileReader::nextPartition() {
       THROW_EXCEPTION_EX(IOException, "read ifile checksum not match, actual %x expect %x", actual,
           expect);
     }
+    if (_checksumType == CHECKSUM_SEGMENT_HASH) {
+      verifySegmentHash(_source->getSegmentHash());
+    }
   }
   _segmentIndex++;
+  _key.clear();
   if (_segmentIndex < (int)(_spillInfo->length)) {
     int64_t end_pos = (int64_t)_spillInfo->segments[_segmentIndex].realEndOffset;
     if (_segmentIndex > 0) {
@@ -85,6 +130,90 @@ bool IFileReader::nextPartition() {
   }
 }
 
+bool IFileReader::nextInPlacePartition() {
+  if (_segmentIndex >= 0 && 0 != _reader.remain()) {
+    THROW_EXCEPTION(IOException, "bad ifile segment length");
+  }
+  _segmentIndex++;
+  _key.clear();
+  if (_segmentIndex >= (int)(_spillInfo->length)) {
+    return false;
+  }
+  uint64_t start = 0;
+  if (_segmentIndex > 0) {
+    start = _spillInfo->segments[_segmentIndex - 1].realEndOffset;
+  }
+  uint64_t end = _spillInfo->segments[_segmentIndex].realEndOffset;
+  if (end < start + 4 || end - start - 4 > 0xffffffffULL) {
+    THROW_EXCEPTION(IOException, "bad ifile format");
+  }
+  const uint32_t length = (uint32_t)(end - start - 4);
+  const char * segment = NULL != _mapped ? _mapped->get(end - start) : _buffer + start;
+
+  // the whole segment is available, verify it before handing it out
+  uint32_t checksum = Checksum::init(_checksumType);
+  uint64_t hash = 0;
+  {
+    PhaseTimer timer(CHECKSUM_PHASE);
+    if (_checksumType == CHECKSUM_SEGMENT_HASH) {
+      hash = XXHash64::hash(segment, length);
+    } else {
+      Checksum::update(_checksumType, checksum, segment, length);
+    }
+  }
+  if (_checksumType == CHECKSUM_SEGMENT_HASH) {
+    verifySegmentHash(hash);
+  }
+  uint32_t chsum;
+  memcpy(&chsum, segment + length, 4);
+  uint32_t actual = bswap(chsum);
+  uint32_t expect = Checksum::getValue(_checksumType, checksum);
+  if (actual != expect) {
+    THROW_EXCEPTION_EX(IOException, "read ifile checksum not match, actual %x expect %x", actual,
+        expect);
+  }
+  _reader.wrap(segment, length);
+  return true;
+}
+
+const char * IFileReader::nextPrefixKey(const char * kvbuff, uint32_t keyBuffLen,
+    uint32_t valueBuffLen, uint32_t & keyLen) {
+  uint32_t len;
+  const uint32_t shared = WritableUtils::ReadVInt(kvbuff, len);
+  if (len > keyBuffLen || shared > _key.length()) {
+    THROW_EXCEPTION(IOException, "bad front coded key in ifile");
+  }
+  // the key is not in the segment as a whole, it stays valid until the
+  // next key like the in place ones
+  _key.resize(shared);
+  _key.append(kvbuff + len, keyBuffLen - len);
+  keyLen = _key.length();
+
+  const char * vbuff = kvbuff + keyBuffLen;
+  switch (_vType) {
+  case TextType:
+    _valueLen = WritableUtils::ReadVInt(vbuff, len);
+    _valuePos = vbuff + len;
+    break;
+  case BytesType:
+    _valueLen = bswap(*(uint32_t*)vbuff);
+    _valuePos = vbuff + 4;
+    break;
+  default:
+    _valueLen = valueBuffLen;
+    _valuePos = vbuff;
+  }
+  return _key.data();
+}
+
+void IFileReader::verifySegmentHash(uint64_t actual) {
+  uint64_t expect = _spillInfo->segments[_segmentIndex].hash;
+  if (actual != expect) {
+    THROW_EXCEPTION_EX(IOException, "ifile segment %d of %s hash not match, actual %"PRIx64
+        " expect %"PRIx64, _segmentIndex, _spillInfo->path.c_str(), actual, expect);
+  }
+}
+
 ///////////////////////////////////////////////////////////
 
 IFileWriter * IFileWriter::create(const std::string & filepath, const MapOutputSpec & spec,
@@ -98,7 +227,8 @@ IFileWriter * IFileWriter::create(const std::string & filepath, const MapOutputS
 IFileWriter::IFileWriter(OutputStream * stream, ChecksumType checksumType, KeyValueType ktype,
     KeyValueType vtype, const string & codec, Counter * counter, bool deleteTargetStream)
     : _stream(stream), _dest(NULL), _checksumType(checksumType), _kType(ktype), _vType(vtype),
-        _codec(codec), _recordCounter(counter), _recordCount(0), _deleteTargetStream(deleteTargetStream) {
+        _codec(codec), _recordCounter(counter), _recordCount(0), _deleteTargetStream(deleteTargetStream),
+        _prefixKeys(false), _gather(false), _gatherBuff(NULL), _gatherUsed(0), _gatheredBytes(0) {
   _dest = new ChecksumOutputStream(_stream, _checksumType);
   _appendBuffer.init(128 * 1024, _dest, _codec);
 }
@@ -107,20 +237,50 @@ IFileWriter::~IFileWriter() {
   delete _dest;
   _dest = NULL;
 
+  delete[] _gatherBuff;
+  _gatherBuff = NULL;
+
   if (_deleteTargetStream) {
     delete _stream;
     _stream = NULL;
   }
 }
 
+void IFileWriter::reset(OutputStream * stream) {
+  if (_deleteTargetStream) {
+    THROW_EXCEPTION(UnsupportException, "IFileWriter owning its stream can not be reset");
+  }
+  _stream = stream;
+  _dest->setStream(_stream);
+  _appendBuffer.reset();
+  CompressStream * compressionStream = _appendBuffer.getCompressionStream();
+  if (NULL != compressionStream) {
+    compressionStream->resetState();
+    compressionStream->startSpill();
+  }
+  _spillFileSegments.clear();
+  _recordCount = 0;
+  _lastKey.clear();
+  _gatherUsed = 0;
+  _gatherIov.clear();
+  _gatheredBytes = 0;
+}
+
 void IFileWriter::startPartition() {
   _spillFileSegments.push_back(IFileSegment());
   _dest->resetChecksum();
+  _lastKey.clear();
 }
 
 void IFileWriter::endPartition() {
   char EOFMarker[2] = {-1, -1};
-  _appendBuffer.write(EOFMarker, 2);
+  if (_gather) {
+    _appendBuffer.flush();
+    gather(EOFMarker, 2);
+    flushGather();
+  } else {
+    _appendBuffer.write(EOFMarker, 2);
+  }
   _appendBuffer.flush();
 
   CompressStream * compressionStream = _appendBuffer.getCompressionStream();
@@ -134,23 +294,34 @@ void IFileWriter::endPartition() {
   _stream->write(&chsum, sizeof(chsum));
   _stream->flush();
   IFileSegment * info = &(_spillFileSegments[_spillFileSegments.size() - 1]);
-  info->uncompressedEndOffset = _appendBuffer.getCounter();
+  info->uncompressedEndOffset = _appendBuffer.getCounter() + _gatheredBytes;
   info->realEndOffset = _stream->tell();
+  info->hash = _dest->getSegmentHash();
 }
 
 void IFileWriter::write(const char * key, uint32_t keyLen, const char * value, uint32_t valueLen) {
+  if (_gather) {
+    // records gathered before this one go out first
+    flushGather();
+  }
   // append KeyLength ValueLength KeyBytesLength
   uint32_t keyBuffLen = keyLen;
   uint32_t valBuffLen = valueLen;
-  switch (_kType) {
-  case TextType:
-    keyBuffLen += WritableUtils::GetVLongSize(keyLen);
-    break;
-  case BytesType:
-    keyBuffLen += 4;
-    break;
-  default:
-    break;
+  uint32_t shared = 0;
+  if (_prefixKeys) {
+    shared = sharedPrefix(key, keyLen);
+    keyBuffLen += WritableUtils::GetVLongSize(shared) - shared;
+  } else {
+    switch (_kType) {
+    case TextType:
+      keyBuffLen += WritableUtils::GetVLongSize(keyLen);
+      break;
+    case BytesType:
+      keyBuffLen += 4;
+      break;
+    default:
+      break;
+    }
   }
 
   switch (_vType) {
@@ -166,19 +337,27 @@ void IFileWriter::write(const char * key, uint32_t keyLen, const char * value, u
 
   _appendBuffer.write_vuint2(keyBuffLen, valBuffLen);
 
-  switch (_kType) {
-  case TextType:
-    _appendBuffer.write_vuint(keyLen);
-    break;
-  case BytesType:
-    _appendBuffer.write_uint32_be(keyLen);
-    break;
-  default:
-    break;
-  }
+  if (_prefixKeys) {
+    _appendBuffer.write_vuint(shared);
+    if (keyLen > shared) {
+      _appendBuffer.write(key + shared, keyLen - shared);
+    }
+    _lastKey.assign(key, keyLen);
+  } else {
+    switch (_kType) {
+    case TextType:
+      _appendBuffer.write_vuint(keyLen);
+      break;
+    case BytesType:
+      _appendBuffer.write_uint32_be(keyLen);
+      break;
+    default:
+      break;
+    }
 
-  if (keyLen > 0) {
-    _appendBuffer.write(key, keyLen);
+    if (keyLen > 0) {
+      _appendBuffer.write(key, keyLen);
+    }
   }
 
   if (NULL != _recordCounter) {
@@ -201,6 +380,126 @@ void IFileWriter::write(const char * key, uint32_t keyLen, const char * value, u
   }
 }
 
+void IFileWriter::setGather(bool gather) {
+  _gather = gather && _codec.length() == 0;
+  if (_gather && NULL == _gatherBuff) {
+    _gatherBuff = new char[GATHER_BUFFER_SIZE];
+    _gatherIov.reserve(GATHER_MAX_IOV);
+  }
+}
+
+void IFileWriter::setPrefixKeys(bool prefixKeys) {
+  _prefixKeys = prefixKeys;
+}
+
+uint32_t IFileWriter::sharedPrefix(const char * key, uint32_t keyLen) {
+  const uint32_t max = std::min(keyLen, (uint32_t)_lastKey.length());
+  const char * last = _lastKey.data();
+  uint32_t shared = 0;
+  while (shared + 8 <= max
+      && *(const uint64_t *)(key + shared) == *(const uint64_t *)(last + shared)) {
+    shared += 8;
+  }
+  while (shared < max && key[shared] == last[shared]) {
+    shared++;
+  }
+  return shared;
+}
+
+char * IFileWriter::writeLengthPrefix(char * pos, KeyValueType type, uint32_t length) {
+  uint32_t len;
+  switch (type) {
+  case TextType:
+    WritableUtils::WriteVLong(length, pos, len);
+    return pos + len;
+  case BytesType:
+    *(uint32_t *)pos = bswap(length);
+    return pos + 4;
+  default:
+    return pos;
+  }
+}
+
+void IFileWriter::gather(const char * data, uint32_t length) {
+  if (length == 0) {
+    return;
+  }
+  if (length >= GATHER_MIN_INPLACE) {
+    if (_gatherIov.size() == GATHER_MAX_IOV) {
+      flushGather();
+    }
+    struct iovec iov = {(void *)data, length};
+    _gatherIov.push_back(iov);
+  } else {
+    if (_gatherUsed + length > GATHER_BUFFER_SIZE || _gatherIov.size() == GATHER_MAX_IOV) {
+      flushGather();
+    }
+    char * pos = _gatherBuff + _gatherUsed;
+    simple_memcpy(pos, data, length);
+    _gatherUsed += length;
+    // extend the last iovec if it ends where this copy starts
+    if (_gatherIov.size() > 0 && (char *)_gatherIov.back().iov_base + _gatherIov.back().iov_len == pos) {
+      _gatherIov.back().iov_len += length;
+    } else {
+      struct iovec iov = {pos, length};
+      _gatherIov.push_back(iov);
+    }
+  }
+  _gatheredBytes += length;
+}
+
+void IFileWriter::flushGather() {
+  if (_gatherIov.size() > 0) {
+    _dest->writev(&_gatherIov[0], _gatherIov.size());
+    _gatherIov.clear();
+  }
+  _gatherUsed = 0;
+}
+
+void IFileWriter::writeInPlace(const char * key, uint32_t keyLen, const char * value,
+    uint32_t valueLen) {
+  if (!_gather) {
+    write(key, keyLen, value, valueLen);
+    return;
+  }
+  // records copied by write() before this one go out first
+  _appendBuffer.flush();
+  // record lengths and the key prefix: 2 vlongs and one prefix at most
+  char framing[32];
+  char keyPrefix[8];
+  char valuePrefix[8];
+  uint32_t keyPrefixLen;
+  uint32_t shared = 0;
+  if (_prefixKeys) {
+    // the shared length takes the place of the key length
+    shared = sharedPrefix(key, keyLen);
+    WritableUtils::WriteVLong(shared, keyPrefix, keyPrefixLen);
+  } else {
+    keyPrefixLen = writeLengthPrefix(keyPrefix, _kType, keyLen) - keyPrefix;
+  }
+  uint32_t valuePrefixLen = writeLengthPrefix(valuePrefix, _vType, valueLen) - valuePrefix;
+  uint32_t len;
+  WritableUtils::WriteVLong(keyLen - shared + keyPrefixLen, framing, len);
+  uint32_t framingLen = len;
+  WritableUtils::WriteVLong(valueLen + valuePrefixLen, framing + framingLen, len);
+  framingLen += len;
+  memcpy(framing + framingLen, keyPrefix, keyPrefixLen);
+  framingLen += keyPrefixLen;
+
+  gather(framing, framingLen);
+  gather(key + shared, keyLen - shared);
+  if (_prefixKeys) {
+    _lastKey.assign(key, keyLen);
+  }
+  gather(valuePrefix, valuePrefixLen);
+  gather(value, valueLen);
+
+  if (NULL != _recordCounter) {
+    _recordCounter->increase();
+  }
+  _recordCount++;
+}
+
 IFileSegment * IFileWriter::toArray(std::vector<IFileSegment> *segments) {
   IFileSegment * segs = new IFileSegment[segments->size()];
   for (size_t i = 0; i < segments->size(); i++) {
@@ -211,8 +510,10 @@ IFileSegment * IFileWriter::toArray(std::vector<IFileSegment> *segments) {
 
 SingleSpillInfo * IFileWriter::getSpillInfo() {
   const uint32_t size = _spillFileSegments.size();
-  return new SingleSpillInfo(toArray(&_spillFileSegments), size, "", _checksumType, _kType, _vType,
-      _codec);
+  SingleSpillInfo * info = new SingleSpillInfo(toArray(&_spillFileSegments), size, "",
+      _checksumType, _kType, _vType, _codec);
+  info->prefixKeys = _prefixKeys;
+  return info;
 }
 
 void IFileWriter::getStatistics(uint64_t & offset, uint64_t & realOffset, uint64_t & recordCount) {
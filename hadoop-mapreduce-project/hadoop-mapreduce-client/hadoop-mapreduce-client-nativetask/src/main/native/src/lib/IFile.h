@@ -27,12 +27,18 @@
 
 namespace NativeTask {
 
+class MmapInputStream;
+
 /**
  * IFileReader
  */
 class IFileReader {
 private:
   InputStream * _stream;
+  // set if segments are read in place from a mapped file
+  MmapInputStream * _mapped;
+  // set if segments are read in place from memory
+  const char * _buffer;
   ChecksumInputStream * _source;
   ReadBuffer _reader;
   ChecksumType _checksumType;
@@ -44,10 +50,28 @@ private:
   const char * _valuePos;
   uint32_t _valueLen;
   bool _deleteSourceStream;
+  bool _prefixKeys;
+  // the current key of a front coded segment
+  string _key;
 
 public:
   IFileReader(InputStream * stream, SingleSpillInfo * spill, bool deleteSourceStream = false);
 
+  /**
+   * uncompressed segments are checksummed and read in place from the
+   * mapping, key/value pointers then point into the file. Compressed
+   * spills are read like from any other stream
+   */
+  IFileReader(MmapInputStream * stream, SingleSpillInfo * spill,
+      bool deleteSourceStream = false);
+
+  /**
+   * read the segments of spill from a buffer of its real length which the
+   * caller keeps valid, uncompressed segments are read in place like from
+   * a mapping
+   */
+  IFileReader(const char * buffer, SingleSpillInfo * spill);
+
   virtual ~IFileReader();
 
   /**
@@ -55,6 +79,13 @@ public:
    */
   bool nextPartition();
 
+private:
+  bool nextInPlacePartition();
+
+  void verifySegmentHash(uint64_t actual);
+
+public:
+
   /**
    * get next key
    * NULL if no more, then next_partition() need to be called
@@ -62,13 +93,17 @@ public:
    *         guaranteed to be valid
    */
   const char * nextKey(uint32_t & keyLen) {
-    int64_t t1 = _reader.readVLong();
-    int64_t t2 = _reader.readVLong();
+    int64_t t1;
+    int64_t t2;
+    _reader.readVLongPair(t1, t2);
     if (t1 == -1) {
       return NULL;
     }
     const char * kvbuff = _reader.get((uint32_t)(t1 + t2));
     uint32_t len;
+    if (_prefixKeys) {
+      return nextPrefixKey(kvbuff, (uint32_t)t1, (uint32_t)t2, keyLen);
+    }
     switch (_kType) {
     case TextType:
       keyLen = WritableUtils::ReadVInt(kvbuff, len);
@@ -99,6 +134,11 @@ public:
     return kbuff;
   }
 
+private:
+  const char * nextPrefixKey(const char * kvbuff, uint32_t keyBuffLen, uint32_t valueBuffLen,
+      uint32_t & keyLen);
+
+public:
   /**
    * length of current value part of IFile entry
    */
@@ -133,9 +173,34 @@ protected:
 
   bool _deleteTargetStream;
 
+  // front coded keys, see setPrefixKeys()
+  bool _prefixKeys;
+  string _lastKey;
+
+  // gather mode, see writeInPlace()
+  bool _gather;
+  char * _gatherBuff;
+  uint32_t _gatherUsed;
+  vector<struct iovec> _gatherIov;
+  uint64_t _gatheredBytes;
+
+  static const uint32_t GATHER_BUFFER_SIZE = 64 * 1024;
+  static const uint32_t GATHER_MAX_IOV = 1024;
+  // keys and values shorter than this are copied, one iovec each
+  // would cost more than the copy
+  static const uint32_t GATHER_MIN_INPLACE = 256;
+
 private:
   IFileSegment * toArray(std::vector<IFileSegment> *segments);
 
+  char * writeLengthPrefix(char * pos, KeyValueType type, uint32_t length);
+
+  void gather(const char * data, uint32_t length);
+
+  void flushGather();
+
+  uint32_t sharedPrefix(const char * key, uint32_t keyLen);
+
 public:
   static IFileWriter * create(const std::string & filepath, const MapOutputSpec & spec,
       Counter * spilledRecords);
@@ -146,12 +211,40 @@ public:
 
   virtual ~IFileWriter();
 
+  /**
+   * start over on stream as a new file, keeping the buffers and the
+   * checksum and codec state. The writer must not own its stream and
+   * every partition must have been ended
+   */
+  void reset(OutputStream * stream);
+
   void startPartition();
 
   void endPartition();
 
   virtual void write(const char * key, uint32_t keyLen, const char * value, uint32_t valueLen);
 
+  /**
+   * uncompressed output only: records are framed in a small side buffer
+   * and large keys and values are written from where they are with
+   * writev, instead of being copied into the stream buffer
+   */
+  void setGather(bool gather);
+
+  /**
+   * front code the keys of each segment: a key is written as the length
+   * of the prefix it shares with the previous key, as a vint, followed by
+   * the rest of its bytes, without a length of its own. Only the native
+   * IFileReader reads this, it must not be used for the map output
+   */
+  void setPrefixKeys(bool prefixKeys);
+
+  /**
+   * same as write(), but in gather mode key and value must stay valid
+   * until endPartition()
+   */
+  void writeInPlace(const char * key, uint32_t keyLen, const char * value, uint32_t valueLen);
+
   SingleSpillInfo * getSpillInfo();
 
   void getStatistics(uint64_t & offset, uint64_t & realOffset, uint64_t & recordCount);
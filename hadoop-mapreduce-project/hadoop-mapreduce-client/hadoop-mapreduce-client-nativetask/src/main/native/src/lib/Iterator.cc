@@ -17,11 +17,15 @@
  */
 #include "lib/Iterator.h"
 #include "lib/commons.h"
+#include "lib/MapOutputSpec.h"
 
 namespace NativeTask {
 
-KeyGroupIteratorImpl::KeyGroupIteratorImpl(KVIterator * iterator)
-    : _keyGroupIterState(NEW_KEY), _iterator(iterator), _first(true) {
+KeyGroupIteratorImpl::KeyGroupIteratorImpl(KVIterator * iterator, const KeyGrouping * grouping)
+    : _keyGroupIterState(NEW_KEY), _iterator(iterator), _grouping(grouping), _first(true) {
+  if (NULL != _grouping && _grouping->byWholeKey()) {
+    _grouping = NULL;
+  }
 }
 
 bool KeyGroupIteratorImpl::nextKey() {
@@ -60,7 +64,17 @@ const char * KeyGroupIteratorImpl::nextValue(uint32_t & len) {
   }
   case SAME_KEY: {
     if (next()) {
-      if (_key.length() == _currentGroupKey.length()) {
+      if (NULL != _grouping) {
+        if (_grouping->sameGroup(_key.data(), _key.length(), _currentGroupKey.data(),
+            _currentGroupKey.length())) {
+          if (NULL != _grouping->comparator) {
+            // like java, each key is compared with the one before it
+            _currentGroupKey.assign(_key.data(), _key.length());
+          }
+          len = _value.length();
+          return _value.data();
+        }
+      } else if (_key.length() == _currentGroupKey.length()) {
         if (fmemeq(_key.data(), _currentGroupKey.c_str(), _key.length())) {
           len = _value.length();
           return _value.data();
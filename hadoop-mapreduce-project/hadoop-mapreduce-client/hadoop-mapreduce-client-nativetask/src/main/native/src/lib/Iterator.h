@@ -23,18 +23,26 @@
 
 namespace NativeTask {
 
+class KeyGrouping;
+
 class KeyGroupIteratorImpl : public KeyGroupIterator {
 protected:
   // for KeyGroupIterator
   KeyGroupIterState _keyGroupIterState;
   KVIterator * _iterator;
+  // NULL for equal keys only
+  const KeyGrouping * _grouping;
   string _currentGroupKey;
   Buffer _key;
   Buffer _value;
   bool _first;
 
 public:
-  KeyGroupIteratorImpl(KVIterator * iterator);
+  /**
+   * grouping must stay valid while the iterator is used, getKey() returns
+   * the key of the current value like the java reducers see it
+   */
+  KeyGroupIteratorImpl(KVIterator * iterator, const KeyGrouping * grouping = NULL);
   bool nextKey();
   const char * getKey(uint32_t & len);
   const char * nextValue(uint32_t & len);
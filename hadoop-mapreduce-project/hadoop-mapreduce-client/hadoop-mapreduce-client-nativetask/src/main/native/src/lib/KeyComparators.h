@@ -0,0 +1,189 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "commons.h"
+
+#ifndef KEYCOMPARATORS_H_
+#define KEYCOMPARATORS_H_
+
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "util/WritableUtils.h"
+
+namespace NativeTask {
+
+/**
+ * Key comparators of the built-in key types as functors, so sort
+ * templates instantiated with them can inline the comparison. The
+ * static comparators of NativeObjectFactory delegate to these, they
+ * are the only definition of the ordering.
+ */
+
+struct BytesKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    uint32_t minlen = std::min(srcLength, destLength);
+    int64_t ret = fmemcmp(src, dest, minlen);
+    if (ret > 0) {
+      return 1;
+    } else if (ret < 0) {
+      return -1;
+    }
+    return srcLength - destLength;
+  }
+};
+
+struct ByteKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    return (*src) - (*dest);
+  }
+};
+
+struct IntKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    int result = (*src) - (*dest);
+    if (result == 0) {
+      uint32_t from = bswap(*(uint32_t*)src);
+      uint32_t to = bswap(*(uint32_t*)dest);
+      if (from > to) {
+        return 1;
+      } else if (from == to) {
+        return 0;
+      } else {
+        return -1;
+      }
+    }
+    return result;
+  }
+};
+
+struct LongKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    int result = (int)(*src) - (int)(*dest);
+    if (result == 0) {
+      uint64_t from = bswap64(*(uint64_t*)src);
+      uint64_t to = bswap64(*(uint64_t*)dest);
+      if (from > to) {
+        return 1;
+      } else if (from == to) {
+        return 0;
+      } else {
+        return -1;
+      }
+    }
+    return result;
+  }
+};
+
+struct VIntKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    int32_t from = WritableUtils::ReadVInt(src, srcLength);
+    int32_t to = WritableUtils::ReadVInt(dest, destLength);
+    if (from > to) {
+      return 1;
+    } else if (from == to) {
+      return 0;
+    } else {
+      return -1;
+    }
+  }
+};
+
+struct VLongKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    int64_t from = WritableUtils::ReadVLong(src, srcLength);
+    int64_t to = WritableUtils::ReadVLong(dest, destLength);
+    if (from > to) {
+      return 1;
+    } else if (from == to) {
+      return 0;
+    } else {
+      return -1;
+    }
+  }
+};
+
+struct FloatKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    if (srcLength != 4 || destLength != 4) {
+      THROW_EXCEPTION_EX(IOException, "float comparator, while src/dest lengt is not 4");
+    }
+
+    uint32_t from = bswap(*(uint32_t*)src);
+    uint32_t to = bswap(*(uint32_t*)dest);
+
+    float * srcValue = (float *)(&from);
+    float * destValue = (float *)(&to);
+
+    if ((*srcValue) < (*destValue)) {
+      return -1;
+    } else if ((*srcValue) == (*destValue)) {
+      return 0;
+    } else {
+      return 1;
+    }
+  }
+};
+
+struct DoubleKeyComparator {
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    if (srcLength != 8 || destLength != 8) {
+      THROW_EXCEPTION_EX(IOException, "double comparator, while src/dest lengt is not 4");
+    }
+
+    uint64_t from = bswap64(*(uint64_t*)src);
+    uint64_t to = bswap64(*(uint64_t*)dest);
+
+    double * srcValue = (double *)(&from);
+    double * destValue = (double *)(&to);
+    if ((*srcValue) < (*destValue)) {
+      return -1;
+    } else if ((*srcValue) == (*destValue)) {
+      return 0;
+    } else {
+      return 1;
+    }
+  }
+};
+
+/**
+ * user supplied comparators, called through the pointer
+ */
+class PointerKeyComparator {
+private:
+  ComparatorPtr _comparator;
+public:
+  PointerKeyComparator(ComparatorPtr comparator)
+      : _comparator(comparator) {
+  }
+
+  inline int operator()(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength) const {
+    return (*_comparator)(src, srcLength, dest, destLength);
+  }
+};
+
+} // namespace NativeTask
+
+#endif /* KEYCOMPARATORS_H_ */
@@ -16,6 +16,12 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "lib/Log.h"
 
 namespace NativeTask {
@@ -24,7 +30,221 @@ namespace NativeTask {
 
 FILE * LOG_DEVICE = stderr;
 
+// slots of the ring, a power of 2
+static const uint32_t LOG_SLOTS = 1024;
+static const uint32_t LOG_SLOT_SIZE = 512;
+
+/**
+ * a slot at ring position pos is free for the producer that claims pos
+ * when sequence == pos, and holds a message for the writer when
+ * sequence == pos + 1
+ */
+struct LogSlot {
+  volatile uint64_t sequence;
+  uint32_t length;
+  // the message when it is longer than text
+  char * overflow;
+  char text[LOG_SLOT_SIZE];
+};
+
+static LogSlot LogRing[LOG_SLOTS];
+static volatile uint64_t LogEnqueuePos = 0;
+static uint64_t LogDequeuePos = 0;
+static volatile bool LogRunning = false;
+static volatile bool LogStopping = false;
+// producers between checking LogRunning and publishing their slot
+static volatile uint32_t LogProducers = 0;
+// the writer sleeps on LogWakeup while the ring is empty
+static volatile bool LogWriterWaiting = false;
+static pthread_mutex_t LogWakeupLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t LogWakeup = PTHREAD_COND_INITIALIZER;
+static pthread_t LogWriter;
+static bool LogRingInited = false;
+static bool LogAtExit = false;
+
+/**
+ * waits while the ring is full
+ * @return the slot claimed for the next message, NULL once the writer is
+ *         stopped
+ */
+static LogSlot * claimLogSlot(uint64_t & pos) {
+  pos = LogEnqueuePos;
+  while (LogRunning) {
+    LogSlot * slot = &LogRing[pos & (LOG_SLOTS - 1)];
+    int64_t diff = (int64_t)(slot->sequence - pos);
+    if (diff == 0) {
+      if (__sync_bool_compare_and_swap(&LogEnqueuePos, pos, pos + 1)) {
+        return slot;
+      }
+    } else if (diff < 0) {
+      sched_yield();
+    }
+    pos = LogEnqueuePos;
+  }
+  return NULL;
+}
+
+/**
+ * writes the messages published so far, only called by the writer thread
+ * @return messages written
+ */
+static uint32_t drainLog() {
+  uint32_t written = 0;
+  while (true) {
+    LogSlot * slot = &LogRing[LogDequeuePos & (LOG_SLOTS - 1)];
+    if (slot->sequence != LogDequeuePos + 1) {
+      return written;
+    }
+    __sync_synchronize();
+    if (NULL != slot->overflow) {
+      fwrite(slot->overflow, 1, slot->length, LOG_DEVICE);
+      free(slot->overflow);
+      slot->overflow = NULL;
+    } else {
+      fwrite(slot->text, 1, slot->length, LOG_DEVICE);
+    }
+    __sync_synchronize();
+    slot->sequence = LogDequeuePos + LOG_SLOTS;
+    LogDequeuePos++;
+    written++;
+  }
+}
+
+static bool logPublished() {
+  LogSlot * slot = &LogRing[LogDequeuePos & (LOG_SLOTS - 1)];
+  return slot->sequence == LogDequeuePos + 1;
+}
+
+/**
+ * once stopping, every producer that got past LogRunning has claimed and
+ * published its slot when none is left and the ring is drained
+ */
+static bool logStopped() {
+  if (!LogStopping) {
+    return false;
+  }
+  __sync_synchronize();
+  return LogProducers == 0 && LogDequeuePos == LogEnqueuePos;
+}
+
+static void * logWriterMain(void * arg) {
+  while (true) {
+    if (drainLog() > 0) {
+      fflush(LOG_DEVICE);
+      continue;
+    }
+    if (logStopped()) {
+      return NULL;
+    }
+    pthread_mutex_lock(&LogWakeupLock);
+    LogWriterWaiting = true;
+    __sync_synchronize();
+    // a producer that published before seeing LogWriterWaiting is seen
+    // here, any later one signals
+    if (!logPublished() && !LogStopping) {
+      pthread_cond_wait(&LogWakeup, &LogWakeupLock);
+    }
+    LogWriterWaiting = false;
+    pthread_mutex_unlock(&LogWakeupLock);
+    if (LogStopping && !logPublished()) {
+      // a claimed slot is being filled in
+      sched_yield();
+    }
+  }
+}
+
+static void wakeLogWriter() {
+  pthread_mutex_lock(&LogWakeupLock);
+  pthread_cond_signal(&LogWakeup);
+  pthread_mutex_unlock(&LogWakeupLock);
+}
+
+static void stopLogAtExit() {
+  AsyncLog::stop();
+}
+
+void AsyncLog::start() {
+  if (LogRunning) {
+    return;
+  }
+  if (!LogRingInited) {
+    for (uint32_t i = 0; i < LOG_SLOTS; i++) {
+      LogRing[i].sequence = i;
+      LogRing[i].overflow = NULL;
+    }
+    LogRingInited = true;
+  }
+  LogStopping = false;
+  if (0 != pthread_create(&LogWriter, NULL, logWriterMain, NULL)) {
+    return;
+  }
+  if (!LogAtExit) {
+    atexit(stopLogAtExit);
+    LogAtExit = true;
+  }
+  LogRunning = true;
+}
+
+void AsyncLog::stop() {
+  if (!LogRunning) {
+    return;
+  }
+  // producers that see this print directly, the writer waits for those
+  // already past it
+  LogRunning = false;
+  __sync_synchronize();
+  LogStopping = true;
+  wakeLogWriter();
+  pthread_join(LogWriter, NULL);
+}
+
+bool AsyncLog::running() {
+  return LogRunning;
+}
+
+void AsyncLog::write(const char * fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  uint64_t pos;
+  LogSlot * slot = NULL;
+  if (LogRunning) {
+    __sync_fetch_and_add(&LogProducers, 1);
+    slot = claimLogSlot(pos);
+    if (NULL == slot) {
+      __sync_fetch_and_sub(&LogProducers, 1);
+    }
+  }
+  if (NULL == slot) {
+    vfprintf(LOG_DEVICE, fmt, args);
+    va_end(args);
+    return;
+  }
+  va_list copy;
+  va_copy(copy, args);
+  int length = vsnprintf(slot->text, LOG_SLOT_SIZE, fmt, copy);
+  va_end(copy);
+  if (length < 0) {
+    length = 0;
+  } else if ((uint32_t)length >= LOG_SLOT_SIZE) {
+    slot->overflow = (char *)malloc(length + 1);
+    if (NULL == slot->overflow) {
+      length = LOG_SLOT_SIZE - 1;
+    } else {
+      vsnprintf(slot->overflow, length + 1, fmt, args);
+    }
+  }
+  va_end(args);
+  slot->length = length;
+  __sync_synchronize();
+  slot->sequence = pos + 1;
+  __sync_synchronize();
+  bool waiting = LogWriterWaiting;
+  __sync_fetch_and_sub(&LogProducers, 1);
+  if (waiting) {
+    wakeLogWriter();
+  }
+}
+
 #endif
 
 } //namespace NativeTask
-
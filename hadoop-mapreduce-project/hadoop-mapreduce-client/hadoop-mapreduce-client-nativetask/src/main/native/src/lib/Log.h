@@ -29,10 +29,37 @@ namespace NativeTask {
 #ifdef PRINT_LOG
 
 extern FILE * LOG_DEVICE;
+
+/**
+ * Once started, LOG() formats its message on the calling thread into a
+ * lock free ring of slots, and a background thread writes them to
+ * LOG_DEVICE, so the caller does not wait on the device. Messages longer
+ * than a slot are copied to the heap. When the ring is full the caller
+ * waits for the writer, so messages are neither lost nor reordered.
+ */
+class AsyncLog {
+public:
+  static void start();
+
+  /**
+   * write out the queued messages and join the writer thread, must be
+   * called before LOG_DEVICE is changed or closed
+   */
+  static void stop();
+
+  static bool running();
+
+  /**
+   * LOG() goes through here, it is a plain fprintf to LOG_DEVICE until
+   * start()
+   */
+  static void write(const char * fmt, ...) __attribute__((format(printf, 1, 2)));
+};
+
 #define LOG(_fmt_, args...)   if (LOG_DEVICE) { \
     time_t log_timer; struct tm log_tm; \
     time(&log_timer); localtime_r(&log_timer, &log_tm); \
-    fprintf(LOG_DEVICE, "%02d/%02d/%02d %02d:%02d:%02d INFO "_fmt_"\n", \
+    AsyncLog::write("%02d/%02d/%02d %02d:%02d:%02d INFO "_fmt_"\n", \
     log_tm.tm_year%100, log_tm.tm_mon+1, log_tm.tm_mday, \
     log_tm.tm_hour, log_tm.tm_min, log_tm.tm_sec, \
     ##args);}
@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOSER_TREE_H_
+#define LOSER_TREE_H_
+
+#include <vector>
+
+namespace NativeTask {
+
+/**
+ * Tournament tree for k-way merge, each internal node keeps the loser of
+ * the match played there and node 0 keeps the overall winner. Replacing
+ * the winner only replays the path from its leaf to the root, which is
+ * log2(k) comparisons, a binary heap needs about twice as many.
+ *
+ * T is the merge source, Compare(a, b) tells whether the current record
+ * of a is less than the one of b. Exhausted sources are treated as
+ * larger than any record.
+ */
+template<typename T, typename Compare>
+class LoserTree {
+private:
+  std::vector<T> _sources;
+  std::vector<bool> _exhausted;
+  std::vector<uint32_t> _tree;
+  uint32_t _live;
+  Compare _compare;
+
+public:
+  LoserTree(Compare compare)
+      : _live(0), _compare(compare) {
+  }
+
+  /**
+   * build the tree, every source must be positioned on its first record
+   */
+  void init(const std::vector<T> & sources) {
+    _sources = sources;
+    const uint32_t k = _sources.size();
+    _live = k;
+    _exhausted.assign(k, false);
+    _tree.assign(k > 0 ? k : 1, 0);
+    if (k == 0) {
+      return;
+    }
+    // leaves are at [k, 2k), winners of the sub trees are kept while building
+    std::vector<uint32_t> winners(2 * k);
+    for (uint32_t i = 0; i < k; i++) {
+      winners[k + i] = i;
+    }
+    for (uint32_t node = k - 1; node >= 1; node--) {
+      uint32_t left = winners[2 * node];
+      uint32_t right = winners[2 * node + 1];
+      if (beats(right, left)) {
+        winners[node] = right;
+        _tree[node] = left;
+      } else {
+        winners[node] = left;
+        _tree[node] = right;
+      }
+    }
+    _tree[0] = winners[1];
+  }
+
+  void clear() {
+    _sources.clear();
+    _exhausted.clear();
+    _tree.clear();
+    _live = 0;
+  }
+
+  bool empty() const {
+    return _live == 0;
+  }
+
+  uint32_t size() const {
+    return _live;
+  }
+
+  /**
+   * source holding the smallest record, only valid if not empty
+   */
+  T top() const {
+    return _sources[_tree[0]];
+  }
+
+  /**
+   * top source has moved to its next record
+   */
+  void adjust() {
+    replay(_tree[0]);
+  }
+
+  /**
+   * top source has no more records
+   */
+  void pop() {
+    uint32_t winner = _tree[0];
+    _exhausted[winner] = true;
+    _live--;
+    replay(winner);
+  }
+
+  /**
+   * all the sources passed to init, including the exhausted ones
+   */
+  const std::vector<T> & sources() const {
+    return _sources;
+  }
+
+private:
+  bool beats(uint32_t lhs, uint32_t rhs) {
+    if (_exhausted[lhs]) {
+      return false;
+    }
+    if (_exhausted[rhs]) {
+      return true;
+    }
+    return _compare(_sources[lhs], _sources[rhs]);
+  }
+
+  void replay(uint32_t leaf) {
+    const uint32_t k = _sources.size();
+    uint32_t winner = leaf;
+    for (uint32_t node = (leaf + k) >> 1; node > 0; node >>= 1) {
+      if (beats(_tree[node], winner)) {
+        std::swap(_tree[node], winner);
+      }
+    }
+    _tree[0] = winner;
+  }
+};
+
+} // namespace NativeTask
+
+#endif /* LOSER_TREE_H_ */
@@ -30,21 +30,32 @@
 #include "util/DualPivotQuickSort.h"
 #include "lib/Combiner.h"
 #include "lib/TaskCounters.h"
-#include "lib/MinHeap.h"
+#include "util/SyncUtils.h"
 
 namespace NativeTask {
 
 ICombineRunner * CombineRunnerWrapper::createCombiner() {
 
   ICombineRunner * combineRunner = NULL;
-  if (NULL != _config->get(NATIVE_COMBINER)) {
-    // Earlier versions of this code supported user-defined
-    // native Combiner implementations. This simplified version
-    // no longer supports it.
-    THROW_EXCEPTION_EX(UnsupportException, "Native Combiners not supported");
+  if (_nativeCombiner.length() > 0) {
+    const char * nativeCombiner = _nativeCombiner.c_str();
+    // user-defined native Combiner implementations are no longer
+    // supported, only the built-in ones
+    NativeCombiner * native = NativeCombiner::create(nativeCombiner, _valueType);
+    if (NULL == native) {
+      THROW_EXCEPTION_EX(UnsupportException, "Native Combiner %s not supported", nativeCombiner);
+    }
+    _grouping.check();
+    native->setGrouping(_grouping);
+    combineRunner = native;
+    LOG("[MapOutputCollector::getCombiner] native combiner %s", nativeCombiner);
+    return combineRunner;
   }
 
-  CombineHandler * javaCombiner = _spillOutput->getJavaCombineHandler();
+  CombineHandler * javaCombiner = NULL;
+  if (NULL != _spillOutput) {
+    javaCombiner = _spillOutput->getJavaCombineHandler();
+  }
   if (NULL != javaCombiner) {
     _isJavaCombiner = true;
     combineRunner = (ICombineRunner *)javaCombiner;
@@ -73,17 +84,126 @@ void CombineRunnerWrapper::combine(CombineContext type, KVIterator * kvIterator,
 // MapOutputCollector
 /////////////////////////////////////////////////////////////////
 
+/**
+ * Spill of frozen buckets, running on _spillPool
+ */
+class BackgroundSpillTask : public Runnable {
+private:
+  MapOutputCollector * _collector;
+  Lock _lock;
+  Condition _finished;
+  volatile bool _running;
+  string _path;
+  SingleSpillInfo * _info;
+  SortMetrics _metrics;
+  uint64_t _spillTime;
+  string _error;
+
+public:
+  BackgroundSpillTask(MapOutputCollector * collector)
+      : _collector(collector), _finished(_lock), _running(false), _info(NULL), _spillTime(0) {
+  }
+
+  ~BackgroundSpillTask() {
+    delete _info;
+  }
+
+  void start(const string & path) {
+    _path = path;
+    _info = NULL;
+    _metrics = SortMetrics();
+    _error.clear();
+    _running = true;
+  }
+
+  /**
+   * @return true if the spill is done
+   */
+  bool tryFinish(bool wait) {
+    ScopeLock<Lock> autoLock(_lock);
+    while (wait && _running) {
+      _finished.wait();
+    }
+    return !_running;
+  }
+
+  bool running() const {
+    return _running;
+  }
+
+  const string & path() const {
+    return _path;
+  }
+
+  const string & error() const {
+    return _error;
+  }
+
+  const SortMetrics & metrics() const {
+    return _metrics;
+  }
+
+  uint64_t spillTime() const {
+    return _spillTime;
+  }
+
+  SingleSpillInfo * takeSpillInfo() {
+    SingleSpillInfo * info = _info;
+    _info = NULL;
+    return info;
+  }
+
+  virtual void run() {
+    Timer timer;
+    SingleSpillInfo * info = NULL;
+    SortMetrics metrics;
+    string error;
+    try {
+      info = _collector->spillBuckets(_collector->_frozenBuckets, _path, metrics, false);
+    } catch (std::exception & e) {
+      error = e.what();
+    }
+    ScopeLock<Lock> autoLock(_lock);
+    _info = info;
+    _metrics = metrics;
+    _error = error;
+    _spillTime = timer.now() - timer.last() - metrics.sortTime;
+    _running = false;
+    _finished.signalAll();
+  }
+};
+
+
 MapOutputCollector::MapOutputCollector(uint32_t numberPartitions, SpillOutputService * spillService)
     : _config(NULL), _numPartitions(numberPartitions), _buckets(NULL),
-      _keyComparator(NULL), _combineRunner(NULL),
+      _keyComparator(NULL), _keyNormalizer(NULL), _combineRunner(NULL),
       _mapOutputRecords(NULL), _mapOutputBytes(NULL),
       _mapOutputMaterializedBytes(NULL), _spilledRecords(NULL),
-      _spillOutput(spillService), _defaultBlockSize(0), _pool(NULL) {
+      _spillOutput(spillService), _defaultBlockSize(0), _pool(NULL), _sortThreads(1),
+      _sortPool(NULL), _compactBlocks(false), _asyncSpill(false), _spillThreshold(0),
+      _frozenBuckets(NULL), _spillPool(NULL), _backgroundSpill(NULL), _mergeFactor(0),
+      _mergeThreads(1), _readAhead(0), _mappedMerge(false), _spillDropBehind(0),
+      _gatherSpill(false), _prefixKeys(false), _inMemoryCombine(false),
+      _spillFs(&FileSystem::getLocal()), _nextLocalDir(0),
+      _hashPartition(false), _totalOrder(NULL), _spillChecksumType(CHECKSUM_CRC32),
+      _spillWriter(NULL) {
   _pool = new MemoryPool();
+  memset(_recordSizes, 0, sizeof(_recordSizes));
 }
 
 MapOutputCollector::~MapOutputCollector() {
 
+  // joins a background spill that may still be running
+  if (NULL != _spillPool) {
+    delete _spillPool;
+    _spillPool = NULL;
+  }
+
+  if (NULL != _backgroundSpill) {
+    delete _backgroundSpill;
+    _backgroundSpill = NULL;
+  }
+
   if (NULL != _buckets) {
     for (uint32_t i = 0; i < _numPartitions; i++) {
       if (NULL != _buckets[i]) {
@@ -96,6 +216,21 @@ MapOutputCollector::~MapOutputCollector() {
   delete[] _buckets;
   _buckets = NULL;
 
+  if (NULL != _frozenBuckets) {
+    for (uint32_t i = 0; i < _numPartitions; i++) {
+      delete _frozenBuckets[i];
+      _frozenBuckets[i] = NULL;
+    }
+  }
+
+  delete[] _frozenBuckets;
+  _frozenBuckets = NULL;
+
+  if (NULL != _sortPool) {
+    delete _sortPool;
+    _sortPool = NULL;
+  }
+
   if (NULL != _pool) {
     delete _pool;
     _pool = NULL;
@@ -105,16 +240,26 @@ MapOutputCollector::~MapOutputCollector() {
     delete _combineRunner;
     _combineRunner = NULL;
   }
+
+  delete _spillWriter;
+  _spillWriter = NULL;
+
+  delete _totalOrder;
+  _totalOrder = NULL;
+
+  TaskTrace::write();
 }
 
-void MapOutputCollector::init(uint32_t defaultBlockSize, uint32_t memoryCapacity,
-    ComparatorPtr keyComparator, ICombineRunner * combiner) {
+void MapOutputCollector::init(uint32_t defaultBlockSize, uint32_t maxBlockSize,
+    uint32_t memoryCapacity, ComparatorPtr keyComparator, ICombineRunner * combiner, uint32_t sortThreads,
+    bool asyncSpill, float spillPercent) {
 
   this->_combineRunner = combiner;
 
   this->_defaultBlockSize = defaultBlockSize;
 
   _pool->init(memoryCapacity);
+  reportMemoryPoolMode();
 
   // TODO: add support for customized comparator
   this->_keyComparator = keyComparator;
@@ -123,11 +268,39 @@ void MapOutputCollector::init(uint32_t defaultBlockSize, uint32_t memoryCapacity
 
   for (uint32_t partitionId = 0; partitionId < _numPartitions; partitionId++) {
     PartitionBucket * pb = new PartitionBucket(_pool, partitionId, keyComparator, _combineRunner,
-        defaultBlockSize);
+        defaultBlockSize, maxBlockSize, _keyNormalizer, _compactBlocks);
 
     _buckets[partitionId] = pb;
   }
 
+  // memory blocks are sorted concurrently, so a few partitions still use
+  // all the threads
+  _sortThreads = std::max(1U, sortThreads);
+  if (_sortThreads > 1 && NULL == _sortPool) {
+    _sortPool = new ThreadPool(_sortThreads);
+  }
+
+  if (asyncSpill && NULL != combiner) {
+    // the java combiner can only be called from the collecting thread
+    LOG("[MapOutputCollector] background spill disabled because a combiner is set");
+    asyncSpill = false;
+  }
+  _asyncSpill = asyncSpill;
+  if (_asyncSpill) {
+    if (spillPercent <= 0 || spillPercent > 1) {
+      spillPercent = 0.8;
+    }
+    _spillThreshold = (uint32_t)(_pool->getSoftLimit() * spillPercent);
+    _frozenBuckets = new PartitionBucket*[_numPartitions];
+    for (uint32_t partitionId = 0; partitionId < _numPartitions; partitionId++) {
+      _frozenBuckets[partitionId] = new PartitionBucket(_pool, partitionId, keyComparator, NULL,
+          defaultBlockSize, 0, _keyNormalizer);
+    }
+    _spillPool = new ThreadPool(1);
+    LOG("[MapOutputCollector] background spill enabled, spill threshold %uK",
+        _spillThreshold / 1024);
+  }
+
   _mapOutputRecords = NativeObjectFactory::GetCounter(
       TaskCounters::TASK_COUNTER_GROUP, TaskCounters::MAP_OUTPUT_RECORDS);
   _mapOutputBytes = NativeObjectFactory::GetCounter(
@@ -146,6 +319,9 @@ void MapOutputCollector::reset() {
     if (NULL != _buckets[i]) {
       _buckets[i]->reset();
     }
+    if (NULL != _frozenBuckets) {
+      _frozenBuckets[i]->reset();
+    }
   }
   _pool->reset();
 }
@@ -153,26 +329,173 @@ void MapOutputCollector::reset() {
 void MapOutputCollector::configure(Config * config) {
   _config = config;
   MapOutputSpec::getSpecFromConfig(config, _spec);
+  TaskPhaseMetrics::init(config);
 
   uint32_t maxBlockSize = config->getInt(NATIVE_SORT_MAX_BLOCK_SIZE, DEFAULT_MAX_BLOCK_SIZE);
   uint32_t capacity = config->getInt(MAPRED_IO_SORT_MB, 300) * 1024 * 1024;
+  // io.sort.mb becomes the soft limit if the pool may grow past it
+  uint32_t hardLimit = config->getInt(NATIVE_MEMORY_POOL_HARD_LIMIT, 0) * 1024 * 1024;
+  if (hardLimit > capacity) {
+    _pool->setSoftLimit(capacity);
+  } else {
+    hardLimit = capacity;
+  }
 
   uint32_t defaultBlockSize = getDefaultBlockSize(capacity, _numPartitions, maxBlockSize);
+  _compactBlocks = config->getBool(NATIVE_SORT_COMPACT_HEADERS, true);
+  if (config->getBool(NATIVE_SORT_AUTOTUNE, false)) {
+    // the statistics an earlier run of the job reported
+    int64_t recordBytes = config->getInt(NATIVE_SORT_AUTOTUNE_RECORD_BYTES, 0);
+    int64_t skewPercent = config->getInt(NATIVE_SORT_AUTOTUNE_PARTITION_SKEW, 0);
+    recordBytes = recordBytes < 0 ? 0 : recordBytes;
+    skewPercent = skewPercent < 0 ? 0 : skewPercent;
+    if (recordBytes > 0 || skewPercent > 0) {
+      defaultBlockSize = getAutotunedBlockSize(capacity, maxBlockSize, recordBytes, skewPercent);
+    }
+    // an explicit native.sort.compact.headers is kept
+    if (recordBytes > 0 && NULL == config->get(NATIVE_SORT_COMPACT_HEADERS)) {
+      _compactBlocks = recordBytes < AUTOTUNE_COMPACT_RECORD_BYTES;
+    }
+    LOG("[MapOutputCollector] autotuned for records of %"PRId64" bytes and partition skew "
+        "%"PRId64"%%: min_block_size %uK, compact headers %s", recordBytes, skewPercent,
+        defaultBlockSize / 1024, _compactBlocks ? "true" : "false");
+  }
   LOG("Native Total MemoryBlockPool: num_partitions %u, min_block_size %uK, "
-      "max_block_size %uK, capacity %uM", _numPartitions, defaultBlockSize / 1024,
-      maxBlockSize / 1024, capacity / 1024 / 1024);
+      "max_block_size %uK, capacity %uM, hard limit %uM", _numPartitions,
+      defaultBlockSize / 1024, maxBlockSize / 1024, capacity / 1024 / 1024,
+      hardLimit / 1024 / 1024);
+
+  ComparatorPtr comparator = getComparator(config, _spec, _keyNormalizer);
+  if (_spec.sortOrder == GROUPBY) {
+    // equal keys only need to be adjacent, the same order is used by the
+    // sort, the merge and the combiner so grouped spills still merge
+    LOG("Native sort order GROUPBY, grouping keys by hash");
+    if (!_spec.combineGrouping.byWholeKey()) {
+      THROW_EXCEPTION(UnsupportException,
+          "sort order GROUPBY only keeps equal keys together, not combiner groups");
+    }
+    comparator = &NativeObjectFactory::HashGroupComparator;
+    _keyNormalizer = NULL;
+  }
 
-  ComparatorPtr comparator = getComparator(config, _spec);
+  int64_t sortThreads = config->getInt(NATIVE_SORT_THREADS, 1);
+  if (sortThreads < 1) {
+    sortThreads = 1;
+  }
 
   ICombineRunner * combiner = NULL;
   if (NULL != config->get(NATIVE_COMBINER)
       // config name for old api and new api
       || NULL != config->get(MAPRED_COMBINE_CLASS_OLD)
       || NULL != config->get(MAPRED_COMBINE_CLASS_NEW)) {
-    combiner = new CombineRunnerWrapper(config, _spillOutput);
+    combiner = new CombineRunnerWrapper(config, _spillOutput, _spec);
   }
 
-  init(defaultBlockSize, capacity, comparator, combiner);
+  _pool->setAllocationMode(config->getBool(NATIVE_MEMORY_POOL_HUGEPAGE, false),
+      config->getBool(NATIVE_MEMORY_POOL_NUMA_LOCAL, false));
+
+  int64_t mergeFactor = config->getInt(MAPRED_IO_SORT_FACTOR, 10);
+  _mergeFactor = mergeFactor < 2 ? 2 : (uint32_t)mergeFactor;
+  int64_t mergeThreads = config->getInt(NATIVE_MERGE_THREADS, 1);
+  _mergeThreads = mergeThreads < 1 ? 1 : (uint32_t)mergeThreads;
+  if (config->getBool(MAPRED_IFILE_READAHEAD, true)) {
+    int64_t readAhead = config->getInt(MAPRED_IFILE_READAHEAD_BYTES, 4 * 1024 * 1024);
+    _readAhead = readAhead < 0 ? 0 : (uint32_t)readAhead;
+  }
+  _mappedMerge = config->getBool(NATIVE_MERGE_MMAP, true);
+  _gatherSpill = config->getBool(NATIVE_SPILL_WRITEV, true);
+  _prefixKeys = config->getBool(NATIVE_SPILL_PREFIX_KEYS, false);
+  _inMemoryCombine = config->getBool(NATIVE_COMBINE_IN_MEMORY, false);
+  if (config->getBool(NATIVE_SPILL_DROP_CACHE, false)) {
+    _spillDropBehind = SPILL_DROP_BEHIND_SIZE;
+  }
+  string spillFs = config->get(NATIVE_SPILL_FILESYSTEM, "local");
+  _spillFs = FileSystem::get(spillFs);
+  if (NULL == _spillFs) {
+    THROW_EXCEPTION_EX(UnsupportException, "spill file system %s not supported", spillFs.c_str());
+  }
+  _spillFs->configure(config);
+  _localDirs.clear();
+  if (config->getBool(NATIVE_SPILL_STRIPE, false)) {
+    StringUtil::Split(config->get(MAPRED_LOCAL_DIR, ""), ",", _localDirs, true);
+    for (size_t i = 0; i < _localDirs.size(); i++) {
+      while (_localDirs[i].length() > 1 && *_localDirs[i].rbegin() == '/') {
+        _localDirs[i].erase(_localDirs[i].length() - 1);
+      }
+    }
+    LOG("[MapOutputCollector] striping spills over %zu local dirs", _localDirs.size());
+  }
+  _spillChecksumType = _spec.checksumType;
+  if (config->getBool(NATIVE_SPILL_SEGMENT_HASH, false)) {
+    _spillChecksumType = CHECKSUM_SEGMENT_HASH;
+  }
+  _spillCodec = _spec.codec;
+  if (_spillCodec.empty() && spillFs == "tiered") {
+    _spillCodec = Compressions::Lz4Codec.name;
+  }
+  _spillCodec = config->get(NATIVE_SPILL_CODEC, _spillCodec);
+  if (_spillCodec.length() > 0 && !Compressions::support(_spillCodec)) {
+    THROW_EXCEPTION_EX(UnsupportException, "spill codec %s not supported", _spillCodec.c_str());
+  }
+  if (_spec.codec.length() > 0 || _spillCodec.length() > 0) {
+    Compressions::configure(config);
+  }
+  _hashPartition = config->getBool(NATIVE_PARTITIONER_HASH, false);
+  if (_hashPartition && _spec.keyType != TextType && _spec.keyType != BytesType) {
+    THROW_EXCEPTION_EX(UnsupportException, "native hash partitioning doesn't support key type %d",
+        _spec.keyType);
+  }
+  string splitPoints = config->get(NATIVE_PARTITIONER_SPLIT_POINTS, "");
+  if (splitPoints.length() > 0) {
+    _totalOrder = TotalOrderPartitioner::create(splitPoints, comparator);
+    if (_totalOrder->numPartitions() != _numPartitions) {
+      THROW_EXCEPTION_EX(IOException, "%u split points in %s for %u partitions",
+          _totalOrder->numPartitions() - 1, splitPoints.c_str(), _numPartitions);
+    }
+    _hashPartition = true;
+    LOG("[MapOutputCollector] total order partitioning over %u split points",
+        _numPartitions - 1);
+  }
+  string sharedIndexDir = config->get(NATIVE_SPILL_INDEX_SHARED_DIR, "");
+  if (sharedIndexDir.length() > 0) {
+    const char * attemptId = config->get(MAPRED_TASK_ATTEMPT_ID);
+    if (NULL == attemptId) {
+      LOG("[MapOutputCollector] %s is not set, the index is not shared", MAPRED_TASK_ATTEMPT_ID);
+    } else {
+      _sharedIndexPath = sharedIndexDir + "/" + attemptId + ".index";
+    }
+  }
+
+  bool asyncSpill = config->getBool(NATIVE_SPILL_ASYNC, false);
+  float spillPercent = config->getFloat(MAPRED_SORT_SPILL_PERCENT, 0.8);
+
+  init(defaultBlockSize, maxBlockSize, hardLimit, comparator, combiner, (uint32_t)sortThreads,
+      asyncSpill, spillPercent);
+}
+
+void MapOutputCollector::reportMemoryPoolMode() {
+  const char * mode = NULL;
+  switch (_pool->getMode()) {
+  case POOL_MMAP:
+    mode = TaskCounters::MEMORY_POOL_MMAP;
+    break;
+  case POOL_TRANSPARENT_HUGEPAGE:
+    mode = TaskCounters::MEMORY_POOL_TRANSPARENT_HUGEPAGE;
+    break;
+  case POOL_HUGETLB:
+    mode = TaskCounters::MEMORY_POOL_HUGETLB;
+    break;
+  default:
+    mode = TaskCounters::MEMORY_POOL_MALLOC;
+    break;
+  }
+  LOG("Native MemoryBlockPool mode: %s, numa local: %s", mode,
+      _pool->isNumaBound() ? "true" : "false");
+  NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP, mode)->increase();
+  if (_pool->isNumaBound()) {
+    NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP,
+        TaskCounters::MEMORY_POOL_NUMA_LOCAL)->increase();
+  }
 }
 
 KVBuffer * MapOutputCollector::allocateKVBuffer(uint32_t partitionId, uint32_t kvlength) {
@@ -182,17 +505,28 @@ KVBuffer * MapOutputCollector::allocateKVBuffer(uint32_t partitionId, uint32_t k
                        partitionId, _numPartitions);
   }
 
+  if (_asyncSpill) {
+    checkBackgroundSpill(false);
+    // checked before allocating, the previous kv has been filled by now
+    if (!_pool->hasFrozen() && _pool->getUsed() >= _spillThreshold) {
+      startBackgroundSpill();
+    }
+  }
+
   KVBuffer * dest = partition->allocateKVBuffer(kvlength);
 
-  if (NULL == dest) {
-    string * spillpath = _spillOutput->getSpillPath();
-    if (NULL == spillpath || spillpath->length() == 0) {
-      THROW_EXCEPTION(IOException, "Illegal(empty) spill files path");
-    } else {
-      middleSpill(*spillpath, "", false);
-      delete spillpath;
-    }
+  if (NULL == dest && _asyncSpill && _pool->hasFrozen()) {
+    // out of memory before the background spill finished
+    checkBackgroundSpill(true);
+    dest = partition->allocateKVBuffer(kvlength);
+  }
+
+  if (NULL == dest && combineInMemory()) {
+    dest = partition->allocateKVBuffer(kvlength);
+  }
 
+  if (NULL == dest) {
+    spill();
     dest = partition->allocateKVBuffer(kvlength);
     if (NULL == dest) {
       // io.sort.mb too small, cann't proceed
@@ -202,9 +536,61 @@ KVBuffer * MapOutputCollector::allocateKVBuffer(uint32_t partitionId, uint32_t k
   }
   _mapOutputRecords->increase();
   _mapOutputBytes->increase(kvlength - KVBuffer::headerLength());
+  _recordSizes[recordSizeBucket(kvlength - KVBuffer::headerLength())]++;
   return dest;
 }
 
+uint32_t MapOutputCollector::collectBatch(const char * buff, uint32_t length, Endium endium) {
+  const uint32_t partitionLength = _hashPartition ? 0 : SIZE_OF_PARTITION_LENGTH;
+  const char * pos = buff;
+  const char * end = buff + length;
+  uint64_t records = 0;
+  uint64_t bytes = 0;
+  while ((uint32_t)(end - pos) >= partitionLength + KVBuffer::headerLength()) {
+    const KVBuffer * src = (const KVBuffer *)(pos + partitionLength);
+    uint32_t keyLength = src->keyLength;
+    uint32_t valueLength = src->valueLength;
+    if (endium == LARGE_ENDIUM) {
+      keyLength = bswap(keyLength);
+      valueLength = bswap(valueLength);
+    }
+    const uint32_t kvLength = KVBuffer::headerLength() + keyLength + valueLength;
+    if ((uint32_t)(end - pos) - partitionLength < kvLength) {
+      break;
+    }
+
+    uint32_t partitionId;
+    if (_hashPartition) {
+      partitionId = getPartition(src->content, keyLength);
+    } else {
+      partitionId = ((const KVBufferWithParititionId *)pos)->partitionId;
+      if (endium == LARGE_ENDIUM) {
+        partitionId = bswap(partitionId);
+      }
+    }
+
+    KVBuffer * dest = NULL;
+    if (likely(partitionId < _numPartitions)) {
+      dest = _buckets[partitionId]->allocateKVBufferInBlock(kvLength);
+    }
+    if (NULL != dest) {
+      records++;
+      bytes += kvLength - KVBuffer::headerLength();
+      _recordSizes[recordSizeBucket(keyLength + valueLength)]++;
+    } else {
+      // bad partition, new memory block or spill, counted there
+      dest = allocateKVBuffer(partitionId, kvLength);
+    }
+    dest->keyLength = keyLength;
+    dest->valueLength = valueLength;
+    small_memcpy(dest->content, src->content, keyLength + valueLength);
+    pos += partitionLength + kvLength;
+  }
+  _mapOutputRecords->increase(records);
+  _mapOutputBytes->increase(bytes);
+  return pos - buff;
+}
+
 /**
  * collect one k/v pair
  * @return true success; false buffer full, need spill
@@ -221,7 +607,8 @@ bool MapOutputCollector::collect(const void * key, uint32_t keylen, const void *
   return true;
 }
 
-ComparatorPtr MapOutputCollector::getComparator(Config * config, MapOutputSpec & spec) {
+ComparatorPtr MapOutputCollector::getComparator(Config * config, MapOutputSpec & spec,
+    KeyNormalizerPtr & normalizer) {
   string nativeComparator = NATIVE_MAPOUT_KEY_COMPARATOR;
   const char * key_class = config->get(MAPRED_MAPOUTPUT_KEY_CLASS);
   if (NULL == key_class) {
@@ -229,6 +616,10 @@ ComparatorPtr MapOutputCollector::getComparator(Config * config, MapOutputSpec &
   }
   nativeComparator.append(".").append(key_class);
   const char * comparatorName = config->get(nativeComparator);
+  normalizer = NativeTask::get_key_normalizer(comparatorName);
+  if (NULL != normalizer) {
+    LOG("[MapOutputCollector] key normalizer found for comparator %s", comparatorName);
+  }
   return NativeTask::get_comparator(spec.keyType, comparatorName);
 }
 
@@ -244,12 +635,18 @@ PartitionBucket * MapOutputCollector::getPartition(uint32_t partition) {
  * @return Array of spill segments information
  */
 void MapOutputCollector::sortPartitions(SortOrder orderType, SortAlgorithm sortType,
-    IFileWriter * writer, SortMetrics & metric) {
+    PartitionBucket ** buckets, IFileWriter * writer, SortMetrics & metric) {
 
   uint32_t start_partition = 0;
   uint32_t num_partition = _numPartitions;
   if (orderType == GROUPBY) {
-    THROW_EXCEPTION(UnsupportException, "GROUPBY not supported");
+    // keys are ordered by hash, which the radix sort does without the comparator
+    sortType = RADIXSORT;
+  }
+
+  if (orderType != NOSORT && NULL != _sortPool) {
+    sortPartitionsParallel(sortType, buckets, writer, metric);
+    return;
   }
 
   uint64_t sortingTime = 0;
@@ -260,10 +657,10 @@ void MapOutputCollector::sortPartitions(SortOrder orderType, SortAlgorithm sortT
     if (NULL != writer) {
       writer->startPartition();
     }
-    PartitionBucket * pb = _buckets[start_partition + i];
+    PartitionBucket * pb = buckets[start_partition + i];
     if (pb != NULL) {
       recordNum += pb->getKVCount();
-      if (orderType == FULLORDER) {
+      if (orderType != NOSORT) {
         timer.reset();
         pb->sort(sortType);
         sortingTime += timer.now() - timer.last();
@@ -280,6 +677,183 @@ void MapOutputCollector::sortPartitions(SortOrder orderType, SortAlgorithm sortT
   metric.recordCount = recordNum;
 }
 
+/**
+ * Completion state of one parallel sortPartitions call, shared
+ * between the spilling thread and the sort workers
+ */
+class BucketSortTracker {
+public:
+  Lock lock;
+  Condition sortDone;
+  // memory blocks of each partition that are not sorted yet
+  vector<uint32_t> unsorted;
+  uint32_t pending;
+  string error;
+
+  BucketSortTracker(uint32_t numPartitions)
+      : sortDone(lock), unsorted(numPartitions, 0), pending(0) {
+  }
+
+  /**
+   * @return time spent waiting, in nanoseconds
+   */
+  uint64_t waitSorted(uint32_t partition) {
+    Timer timer;
+    ScopeLock<Lock> autoLock(lock);
+    while (unsorted[partition] > 0) {
+      sortDone.wait();
+    }
+    return timer.now() - timer.last();
+  }
+
+  void waitAll() {
+    ScopeLock<Lock> autoLock(lock);
+    while (pending > 0) {
+      sortDone.wait();
+    }
+  }
+};
+
+/**
+ * Sorts one memory block of a bucket
+ */
+class BlockSortTask : public Runnable {
+private:
+  PartitionBucket * _bucket;
+  uint32_t _partition;
+  uint32_t _block;
+  SortAlgorithm _sortType;
+  BucketSortTracker * _tracker;
+
+public:
+  BlockSortTask(PartitionBucket * bucket, uint32_t partition, uint32_t block,
+      SortAlgorithm sortType, BucketSortTracker * tracker)
+      : _bucket(bucket), _partition(partition), _block(block), _sortType(sortType),
+          _tracker(tracker) {
+  }
+
+  virtual void run() {
+    string error;
+    try {
+      _bucket->sortBlock(_block, _sortType);
+    } catch (std::exception & e) {
+      error = e.what();
+    }
+    ScopeLock<Lock> autoLock(_tracker->lock);
+    if (!error.empty() && _tracker->error.empty()) {
+      _tracker->error = error;
+    }
+    _tracker->unsorted[_partition]--;
+    _tracker->pending--;
+    _tracker->sortDone.signalAll();
+  }
+};
+
+/**
+ * Sort the memory blocks of all buckets on _sortPool, and spill the
+ * buckets in partition order as soon as all blocks of each one are sorted,
+ * so spilling overlaps sorting of later buckets. The blocks of a bucket
+ * are merged by its iterator while spilling, so jobs with a single or a
+ * few partitions are sorted by all threads too.
+ * metric.sortTime is the time the spilling thread was blocked waiting
+ * for sorts, not the accumulated CPU time of the workers.
+ */
+void MapOutputCollector::sortPartitionsParallel(SortAlgorithm sortType,
+    PartitionBucket ** buckets, IFileWriter * writer, SortMetrics & metric) {
+  const uint32_t num_partition = _numPartitions;
+  BucketSortTracker tracker(num_partition);
+  vector<BlockSortTask> tasks;
+  for (uint32_t i = 0; i < num_partition; i++) {
+    PartitionBucket * pb = buckets[i];
+    if (NULL == pb) {
+      continue;
+    }
+    for (uint32_t j = 0; j < pb->getMemoryBlockCount(); j++) {
+      tasks.push_back(BlockSortTask(pb, i, j, sortType, &tracker));
+    }
+    tracker.unsorted[i] = pb->getMemoryBlockCount();
+  }
+  tracker.pending = tasks.size();
+  for (size_t i = 0; i < tasks.size(); i++) {
+    _sortPool->submit(&tasks[i]);
+  }
+
+  uint64_t sortingTime = 0;
+  uint64_t recordNum = 0;
+  try {
+    for (uint32_t i = 0; i < num_partition; i++) {
+      sortingTime += tracker.waitSorted(i);
+      {
+        ScopeLock<Lock> autoLock(tracker.lock);
+        if (!tracker.error.empty()) {
+          THROW_EXCEPTION_EX(IOException, "parallel sort failed: %s", tracker.error.c_str());
+        }
+      }
+      if (NULL != writer) {
+        writer->startPartition();
+      }
+      PartitionBucket * pb = buckets[i];
+      if (pb != NULL) {
+        // only marks the bucket sorted, its blocks are
+        pb->sort(sortType);
+        recordNum += pb->getKVCount();
+        if (NULL != writer) {
+          pb->spill(writer);
+        }
+      }
+      if (NULL != writer) {
+        writer->endPartition();
+      }
+    }
+  } catch (...) {
+    // tasks and tracker live on this stack frame
+    tracker.waitAll();
+    throw;
+  }
+  metric.sortTime = sortingTime;
+  metric.recordCount = recordNum;
+}
+
+SingleSpillInfo * MapOutputCollector::spillBuckets(PartitionBucket ** buckets,
+    const std::string & spillOutput, SortMetrics & metrics, bool final) {
+  Timer timer;
+  FileSystem & fs = final ? FileSystem::getLocal() : *_spillFs;
+  OutputStream * fout = fs.create(spillOutput, true);
+  if (!final && &fs == &FileSystem::getLocal()) {
+    ((FileOutputStream *)fout)->setDropBehind(_spillDropBehind);
+  }
+
+  // taken while in use, a spill that throws does not leave it half written
+  IFileWriter * writer = final ? NULL : _spillWriter;
+  _spillWriter = NULL;
+  if (NULL != writer) {
+    writer->reset(fout);
+  } else {
+    writer = new IFileWriter(fout, final ? _spec.checksumType : _spillChecksumType,
+        _spec.keyType, _spec.valueType, final ? _spec.codec : _spillCodec, _spilledRecords);
+    writer->setGather(_gatherSpill);
+    // the final output is read by the shuffle
+    writer->setPrefixKeys(_prefixKeys && !final);
+  }
+
+  sortPartitions(_spec.sortOrder, _spec.sortAlgorithm, buckets, writer, metrics);
+
+  SingleSpillInfo * info = writer->getSpillInfo();
+  info->path = spillOutput;
+
+  if (final) {
+    delete writer;
+  } else {
+    _spillWriter = writer;
+  }
+  delete fout;
+  uint64_t end = timer.now();
+  TaskPhaseMetrics::add(SPILL_PHASE, end - timer.last() - metrics.sortTime);
+  // the timeline shows the sort nested in the spill instead
+  TaskTrace::add(SPILL_PHASE, timer.last(), end);
+  return info;
+}
+
 void MapOutputCollector::middleSpill(const std::string & spillOutput,
     const std::string & indexFilePath, bool final) {
 
@@ -288,17 +862,9 @@ void MapOutputCollector::middleSpill(const std::string & spillOutput,
   if (spillOutput.empty()) {
     THROW_EXCEPTION(IOException, "MapOutputCollector: Spill file path empty");
   } else {
-    OutputStream * fout = FileSystem::getLocal().create(spillOutput, true);
-
-    IFileWriter * writer = new IFileWriter(fout, _spec.checksumType, _spec.keyType, _spec.valueType,
-        _spec.codec, _spilledRecords);
-
     Timer timer;
     SortMetrics metrics;
-    sortPartitions(_spec.sortOrder, _spec.sortAlgorithm, writer, metrics);
-
-    SingleSpillInfo * info = writer->getSpillInfo();
-    info->path = spillOutput;
+    SingleSpillInfo * info = spillBuckets(_buckets, spillOutput, metrics, final);
     uint64_t spillTime = timer.now() - timer.last() - metrics.sortTime;
 
     const uint64_t M = 1000000; // million
@@ -321,20 +887,483 @@ void MapOutputCollector::middleSpill(const std::string & spillOutput,
     }
 
     if (indexFilePath.length() > 0) {
-      info->writeSpillInfo(indexFilePath);
+      writeFinalIndex(info, indexFilePath);
       delete info;
     } else {
       _spillInfos.add(info);
     }
 
-    delete writer;
-    delete fout;
-
     reset();
     _collectTimer.reset();
   }
 }
 
+void MapOutputCollector::startBackgroundSpill() {
+  string * spillpath = getSpillPath();
+  if (NULL == spillpath || spillpath->length() == 0) {
+    THROW_EXCEPTION(IOException, "Illegal(empty) spill files path");
+  }
+  if (NULL == _backgroundSpill) {
+    _backgroundSpill = new BackgroundSpillTask(this);
+  }
+  for (uint32_t i = 0; i < _numPartitions; i++) {
+    _buckets[i]->moveBlocksTo(_frozenBuckets[i]);
+  }
+  _pool->freeze();
+  _backgroundSpill->start(*spillpath);
+  delete spillpath;
+  _spillPool->submit(_backgroundSpill);
+}
+
+string MapOutputCollector::stripeSpillPath(const string & path,
+    const vector<string> & localDirs, uint32_t index) {
+  for (size_t i = 0; i < localDirs.size(); i++) {
+    const string & dir = localDirs[i];
+    if (path.length() > dir.length() && path[dir.length()] == '/'
+        && path.compare(0, dir.length(), dir) == 0) {
+      return localDirs[index % localDirs.size()] + path.substr(dir.length());
+    }
+  }
+  return path;
+}
+
+void MapOutputCollector::spill() {
+  string * spillpath = getSpillPath();
+  if (NULL == spillpath || spillpath->length() == 0) {
+    delete spillpath;
+    THROW_EXCEPTION(IOException, "Illegal(empty) spill files path");
+  }
+  middleSpill(*spillpath, "", false);
+  delete spillpath;
+}
+
+/**
+ * collects the combiner output as KVBuffers in one heap buffer
+ */
+class MemoryCombineWriter : public IFileWriter {
+private:
+  string _data;
+
+public:
+  MemoryCombineWriter(const MapOutputSpec & spec)
+      : IFileWriter(NULL, CHECKSUM_NONE, spec.keyType, spec.valueType, "", NULL) {
+  }
+
+  virtual void write(const char * key, uint32_t keyLen, const char * value, uint32_t valueLen) {
+    uint32_t header[2] = {keyLen, valueLen};
+    _data.append((const char *)header, sizeof(header));
+    _data.append(key, keyLen);
+    _data.append(value, valueLen);
+  }
+
+  const string & data() {
+    return _data;
+  }
+};
+
+bool MapOutputCollector::combineInMemory() {
+  if (!_inMemoryCombine || NULL == _combineRunner || _spec.sortOrder == NOSORT) {
+    return false;
+  }
+  Timer timer;
+  const uint64_t used = _pool->getUsed();
+  SortAlgorithm sortType = _spec.sortOrder == GROUPBY ? RADIXSORT : _spec.sortAlgorithm;
+  MemoryCombineWriter writer(_spec);
+  vector<uint64_t> ends(_numPartitions);
+  for (uint32_t i = 0; i < _numPartitions; i++) {
+    PartitionBucket * pb = _buckets[i];
+    if (NULL != pb) {
+      pb->sort(sortType);
+      pb->spill(&writer);
+    }
+    ends[i] = writer.data().length();
+  }
+  reset();
+
+  // the combined records go back in order, a bucket that no longer fits
+  // its blocks is spilled like before
+  const char * data = writer.data().data();
+  uint64_t pos = 0;
+  for (uint32_t i = 0; i < _numPartitions; i++) {
+    while (pos < ends[i]) {
+      const KVBuffer * kv = (const KVBuffer *)(data + pos);
+      const uint32_t length = kv->keyLength + kv->valueLength + KVBuffer::headerLength();
+      KVBuffer * dest = _buckets[i]->allocateKVBuffer(length);
+      if (NULL == dest) {
+        spill();
+        dest = _buckets[i]->allocateKVBuffer(length);
+        if (NULL == dest) {
+          THROW_EXCEPTION(OutOfMemoryException, "key/value pair larger than io.sort.mb");
+        }
+      }
+      memcpy(dest, kv, length);
+      pos += length;
+    }
+  }
+
+  const uint64_t combined = writer.data().length();
+  const uint64_t M = 1000000; // million
+  LOG("In-memory-combine: { used: %"PRIu64", combined: %"PRIu64", time: %"PRIu64" ms }",
+      used, combined, (timer.now() - timer.last()) / M);
+  if (combined * 2 > used) {
+    // not worth it for this data, spill from now on
+    LOG("[MapOutputCollector] combine freed less than half of the buffer, in-memory combine disabled");
+    _inMemoryCombine = false;
+    return false;
+  }
+  return true;
+}
+
+string * MapOutputCollector::getSpillPath() {
+  string * path = _spillOutput->getSpillPath();
+  if (NULL != path && _localDirs.size() > 1) {
+    *path = stripeSpillPath(*path, _localDirs, _nextLocalDir++);
+  }
+  return path;
+}
+
+void MapOutputCollector::writeFinalIndex(SingleSpillInfo * info, const string & indexPath) {
+  info->writeSpillInfo(indexPath);
+  if (_sharedIndexPath.length() > 0 && info->publishSpillInfo(_sharedIndexPath)) {
+    LOG("[MapOutputCollector] index shared as %s", _sharedIndexPath.c_str());
+  }
+  reportOutputStatistics(info);
+}
+
+void MapOutputCollector::reportOutputStatistics(SingleSpillInfo * info) {
+  uint64_t records = 0;
+  for (uint32_t i = 0; i < RECORD_SIZE_BUCKETS; i++) {
+    records += _recordSizes[i];
+  }
+  const uint32_t ranks[] = {50, 90, 99};
+  const char * names[] = {TaskCounters::MAP_OUTPUT_RECORD_BYTES_P50,
+      TaskCounters::MAP_OUTPUT_RECORD_BYTES_P90, TaskCounters::MAP_OUTPUT_RECORD_BYTES_P99};
+  uint64_t percentiles[3] = {0, 0, 0};
+  for (uint32_t p = 0; p < 3 && records > 0; p++) {
+    uint64_t rank = (records * ranks[p] + 99) / 100;
+    uint64_t seen = _recordSizes[0];
+    uint32_t bucket = 0;
+    while (seen < rank && bucket < RECORD_SIZE_BUCKETS - 1) {
+      seen += _recordSizes[++bucket];
+    }
+    percentiles[p] = bucket == 0 ? 0 : (uint64_t)1 << bucket;
+    NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP, names[p])->increase(
+        percentiles[p]);
+  }
+
+  // the uncompressed partitions, without their EOF marker
+  uint64_t total = 0;
+  uint64_t largest = 0;
+  uint64_t empty = 0;
+  for (uint32_t p = 0; p < info->length; p++) {
+    uint64_t start = p > 0 ? info->segments[p - 1].uncompressedEndOffset : 0;
+    uint64_t length = info->segments[p].uncompressedEndOffset - start;
+    length = length > 2 ? length - 2 : 0;
+    total += length;
+    largest = std::max(largest, length);
+    empty += length == 0 ? 1 : 0;
+  }
+  uint64_t skewPercent = total == 0 ? 0 : largest * 100 * info->length / total;
+  NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP,
+      TaskCounters::MAP_OUTPUT_PARTITION_SKEW_PERCENT)->increase(skewPercent);
+  NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP,
+      TaskCounters::MAP_OUTPUT_EMPTY_PARTITIONS)->increase(empty);
+  LOG("[MapOutputCollector] map output: { records: %"PRIu64", record bytes p50: %"PRIu64", "
+      "p90: %"PRIu64", p99: %"PRIu64", partition skew: %"PRIu64"%%, empty partitions: "
+      "%"PRIu64" }", records, percentiles[0], percentiles[1], percentiles[2], skewPercent, empty);
+}
+
+bool MapOutputCollector::checkBackgroundSpill(bool wait) {
+  if (NULL == _backgroundSpill || !_pool->hasFrozen()) {
+    return true;
+  }
+  if (!wait && _backgroundSpill->running()) {
+    return false;
+  }
+  _backgroundSpill->tryFinish(true);
+
+  if (!_backgroundSpill->error().empty()) {
+    THROW_EXCEPTION_EX(IOException, "background spill failed: %s",
+        _backgroundSpill->error().c_str());
+  }
+
+  SingleSpillInfo * info = _backgroundSpill->takeSpillInfo();
+  const SortMetrics & metrics = _backgroundSpill->metrics();
+  const uint64_t M = 1000000; // million
+  LOG("Background-spill: { id: %d, in-memory sort: %"PRIu64" ms, "
+      "in-memory records: %"PRIu64", merge&spill: %"PRIu64" ms, "
+      "uncompressed size: %"PRIu64", real size: %"PRIu64" path: %s }",
+      _spillInfos.getSpillCount(),
+      metrics.sortTime / M,
+      metrics.recordCount,
+      _backgroundSpill->spillTime() / M,
+      info->getEndPosition(),
+      info->getRealEndPosition(),
+      _backgroundSpill->path().c_str());
+  _spillInfos.add(info);
+
+  for (uint32_t i = 0; i < _numPartitions; i++) {
+    _frozenBuckets[i]->reset();
+  }
+  _pool->releaseFrozen();
+  return true;
+}
+
+/**
+ * merges a contiguous range of partitions of all the spills into the
+ * final file, starting at a precomputed offset
+ */
+class PartitionMergeTask : public Runnable {
+private:
+  const std::vector<SingleSpillInfo *> * _spills;
+  const MapOutputSpec * _spec;
+  ComparatorPtr _comparator;
+  std::string _path;
+  uint32_t _start;
+  uint32_t _end;
+  uint64_t _offset;
+  uint64_t _expectedEnd;
+  uint32_t _readAhead;
+  bool _mapped;
+  FileSystem * _fs;
+  uint64_t _records;
+  uint64_t _writtenEnd;
+  std::string _error;
+
+public:
+  PartitionMergeTask(const std::vector<SingleSpillInfo *> * spills, const MapOutputSpec * spec,
+      ComparatorPtr comparator, const std::string & path, uint32_t start, uint32_t end,
+      uint64_t offset, uint64_t expectedEnd, uint32_t readAhead, bool mapped, FileSystem * fs)
+      : _spills(spills), _spec(spec), _comparator(comparator), _path(path),
+          _start(start), _end(end), _offset(offset), _expectedEnd(expectedEnd),
+          _readAhead(readAhead), _mapped(mapped), _fs(fs), _records(0), _writtenEnd(0) {
+  }
+
+  uint64_t expectedEnd() const {
+    return _expectedEnd;
+  }
+
+  uint64_t records() const {
+    return _records;
+  }
+
+  uint64_t writtenEnd() const {
+    return _writtenEnd;
+  }
+
+  const std::string & error() const {
+    return _error;
+  }
+
+  virtual void run() {
+    std::vector<SingleSpillInfo *> ranges;
+    try {
+      OutputStream * fout = new FileOutputStream(_path, _offset);
+      IFileWriter writer(fout, _spec->checksumType, _spec->keyType, _spec->valueType, _spec->codec,
+          NULL, true);
+      Merger merger(&writer, _comparator);
+      for (size_t i = 0; i < _spills->size(); i++) {
+        SingleSpillInfo * spill = (*_spills)[i];
+        // segment offsets of the range, relative to its start
+        uint64_t base = _start > 0 ? spill->segments[_start - 1].realEndOffset : 0;
+        uint64_t uncompressedBase = _start > 0 ? spill->segments[_start - 1].uncompressedEndOffset : 0;
+        IFileSegment * segments = new IFileSegment[_end - _start];
+        for (uint32_t p = _start; p < _end; p++) {
+          segments[p - _start].realEndOffset = spill->segments[p].realEndOffset - base;
+          segments[p - _start].uncompressedEndOffset = spill->segments[p].uncompressedEndOffset
+              - uncompressedBase;
+          segments[p - _start].hash = spill->segments[p].hash;
+        }
+        SingleSpillInfo * range = new SingleSpillInfo(segments, _end - _start, spill->path,
+            spill->checkSumType, spill->keyType, spill->valueType, spill->codec);
+        range->prefixKeys = spill->prefixKeys;
+        ranges.push_back(range);
+        if (_fs != &FileSystem::getLocal()) {
+          InputStream * fin = _fs->open(spill->path);
+          fin->seek(base);
+          merger.addMergeEntry(new IFileMergeEntry(new IFileReader(fin, range, true)));
+        } else if (_mapped) {
+          MmapInputStream * fin = new MmapInputStream(spill->path);
+          fin->seek(base);
+          merger.addMergeEntry(new IFileMergeEntry(new IFileReader(fin, range, true)));
+        } else {
+          FileInputStream * fin = (FileInputStream *)FileSystem::getLocal().open(spill->path);
+          fin->seek(base);
+          fin->setReadAhead(_readAhead);
+          merger.addMergeEntry(new IFileMergeEntry(new IFileReader(fin, range, true)));
+        }
+      }
+      merger.merge();
+      uint64_t offset, realOffset;
+      writer.getStatistics(offset, realOffset, _records);
+      _writtenEnd = fout->tell();
+    } catch (std::exception & e) {
+      _error = e.what();
+    }
+    for (size_t i = 0; i < ranges.size(); i++) {
+      delete ranges[i];
+    }
+  }
+};
+
+SingleSpillInfo * MapOutputCollector::mergeSpills(const std::vector<SingleSpillInfo *> & spills,
+    const std::string & path) {
+  Timer timer;
+  OutputStream * fout = _spillFs->create(path, true);
+  if (_spillFs == &FileSystem::getLocal()) {
+    ((FileOutputStream *)fout)->setDropBehind(_spillDropBehind);
+  }
+  IFileWriter * writer = new IFileWriter(fout, _spillChecksumType, _spec.keyType,
+      _spec.valueType, _spillCodec, _spilledRecords, true);
+  writer->setPrefixKeys(_prefixKeys);
+  Merger * merger = new Merger(writer, _keyComparator, _combineRunner);
+  for (size_t i = 0; i < spills.size(); i++) {
+    merger->addMergeEntry(IFileMergeEntry::create(spills[i], _readAhead, _mappedMerge,
+        *_spillFs));
+  }
+  merger->merge();
+  delete merger;
+
+  SingleSpillInfo * info = writer->getSpillInfo();
+  info->path = path;
+  delete writer;
+
+  const uint64_t M = 1000000; // million
+  LOG("Intermediate-merge: { spills: %zu, merge: %"PRIu64" ms, uncompressed size: %"PRIu64", "
+      "real size: %"PRIu64" path: %s }",
+      spills.size(),
+      (timer.now() - timer.last()) / M,
+      info->getEndPosition(),
+      info->getRealEndPosition(),
+      path.c_str());
+  return info;
+}
+
+static bool spillSizeLessThan(SingleSpillInfo * lhs, SingleSpillInfo * rhs) {
+  return lhs->getRealEndPosition() < rhs->getRealEndPosition();
+}
+
+void MapOutputCollector::mergeIntermediateSpills(uint32_t extraSegments) {
+  std::vector<SingleSpillInfo *> & spills = _spillInfos.spills;
+  bool firstPass = true;
+  while (spills.size() + extraSegments > _mergeFactor) {
+    // like the java merger the first pass merges just enough spills for
+    // the remaining passes to be full, and the smallest spills go first
+    uint32_t segments = spills.size() + extraSegments;
+    uint32_t count = _mergeFactor;
+    uint32_t mod = (segments - 1) % (_mergeFactor - 1);
+    if (firstPass && mod != 0) {
+      count = mod + 1;
+    }
+    firstPass = false;
+    std::stable_sort(spills.begin(), spills.end(), spillSizeLessThan);
+
+    std::vector<SingleSpillInfo *> inputs(spills.begin(), spills.begin() + count);
+    string * path = getSpillPath();
+    if (NULL == path || path->length() == 0) {
+      delete path;
+      THROW_EXCEPTION(IOException, "Illegal(empty) spill files path");
+    }
+    SingleSpillInfo * merged = mergeSpills(inputs, *path);
+    delete path;
+
+    spills.erase(spills.begin(), spills.begin() + count);
+    for (size_t i = 0; i < inputs.size(); i++) {
+      inputs[i]->deleteSpillFile(*_spillFs);
+      delete inputs[i];
+    }
+    spills.push_back(merged);
+  }
+}
+
+void MapOutputCollector::parallelFinalMerge(const std::string & filepath,
+    const std::string & idx_file_path) {
+  Timer timer;
+  std::vector<SingleSpillInfo *> & spills = _spillInfos.spills;
+
+  // without codec and combiner the merged partition is exactly the records
+  // of its segments, plus one EOF marker (2 bytes) and checksum (4 bytes)
+  IFileSegment * segments = new IFileSegment[_numPartitions];
+  uint64_t realEnd = 0;
+  uint64_t uncompressedEnd = 0;
+  for (uint32_t p = 0; p < _numPartitions; p++) {
+    uint64_t realLength = 6;
+    for (size_t i = 0; i < spills.size(); i++) {
+      IFileSegment * segs = spills[i]->segments;
+      realLength += segs[p].realEndOffset - (p > 0 ? segs[p - 1].realEndOffset : 0) - 6;
+    }
+    realEnd += realLength;
+    uncompressedEnd += realLength - 4;
+    segments[p].realEndOffset = realEnd;
+    segments[p].uncompressedEndOffset = uncompressedEnd;
+  }
+  SingleSpillInfo * output = new SingleSpillInfo(segments, _numPartitions, filepath,
+      _spec.checksumType, _spec.keyType, _spec.valueType, _spec.codec);
+
+  OutputStream * fout = FileSystem::getLocal().create(filepath, true);
+  delete fout;
+
+  // contiguous partition ranges of about the same size
+  const uint32_t threads = std::min(_mergeThreads, _numPartitions);
+  std::vector<PartitionMergeTask> tasks;
+  tasks.reserve(threads);
+  uint32_t start = 0;
+  for (uint32_t t = 0; t < threads && start < _numPartitions; t++) {
+    uint64_t target = realEnd * (t + 1) / threads;
+    uint32_t end = start + 1;
+    while (end < _numPartitions && segments[end - 1].realEndOffset < target) {
+      end++;
+    }
+    if (t == threads - 1) {
+      end = _numPartitions;
+    }
+    uint64_t offset = start > 0 ? segments[start - 1].realEndOffset : 0;
+    tasks.push_back(PartitionMergeTask(&spills, &_spec, _keyComparator, filepath,
+        start, end, offset, segments[end - 1].realEndOffset, _readAhead,
+        _mappedMerge, _spillFs));
+    start = end;
+  }
+
+  {
+    ThreadPool pool(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+      pool.submit(&tasks[i]);
+    }
+  }
+
+  uint64_t recordCount = 0;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    if (!tasks[i].error().empty()) {
+      delete output;
+      THROW_EXCEPTION_EX(IOException, "parallel final merge failed: %s",
+          tasks[i].error().c_str());
+    }
+    if (tasks[i].writtenEnd() != tasks[i].expectedEnd()) {
+      delete output;
+      THROW_EXCEPTION_EX(IOException,
+          "parallel final merge wrote to %"PRIu64", expected %"PRIu64, tasks[i].writtenEnd(),
+          tasks[i].expectedEnd());
+    }
+    recordCount += tasks[i].records();
+  }
+  _spilledRecords->increase(recordCount);
+
+  const uint64_t M = 1000000; // million
+  LOG("Final-merge-spill: { id: %d, threads: %zu, merge&spill: %"PRIu64" ms, "
+      "records: %"PRIu64", uncompressed size: %"PRIu64", real size: %"PRIu64" path: %s }",
+      _spillInfos.getSpillCount(),
+      tasks.size(),
+      (timer.now() - timer.last()) / M,
+      recordCount,
+      uncompressedEnd,
+      realEnd,
+      filepath.c_str());
+
+  _mapOutputMaterializedBytes->increase(realEnd);
+  writeFinalIndex(output, idx_file_path);
+  delete output;
+}
+
 /**
  * final merge and/or spill, use previous spilled
  * file & in-memory data
@@ -342,22 +1371,45 @@ void MapOutputCollector::middleSpill(const std::string & spillOutput,
 void MapOutputCollector::finalSpill(const std::string & filepath,
     const std::string & idx_file_path) {
 
+  checkBackgroundSpill(true);
+
   if (_spillInfos.getSpillCount() == 0) {
     middleSpill(filepath, idx_file_path, true);
     return;
   }
 
+  // the offsets of the partitions in the output can only be computed if
+  // the merge doesn't change the bytes of the records
+  if (_mergeThreads > 1 && _numPartitions > 1 && _spec.codec.empty() && _spillCodec.empty()
+      && NULL == _combineRunner && !_prefixKeys) {
+    string * spillpath = getSpillPath();
+    if (NULL == spillpath || spillpath->length() == 0) {
+      delete spillpath;
+      THROW_EXCEPTION(IOException, "Illegal(empty) spill files path");
+    }
+    middleSpill(*spillpath, "", false);
+    delete spillpath;
+    mergeIntermediateSpills(0);
+    parallelFinalMerge(filepath, idx_file_path);
+    _spillInfos.deleteAllSpillFiles(*_spillFs);
+    reset();
+    return;
+  }
+
+  // in-memory data is one more segment of the final merge
+  mergeIntermediateSpills(1);
+
   IFileWriter * writer = IFileWriter::create(filepath, _spec, _spilledRecords);
-  Merger * merger = new Merger(writer, _config, _keyComparator, _combineRunner);
+  Merger * merger = new Merger(writer, _keyComparator, _combineRunner);
 
   for (size_t i = 0; i < _spillInfos.getSpillCount(); i++) {
     SingleSpillInfo * spill = _spillInfos.getSingleSpillInfo(i);
-    MergeEntryPtr pme = IFileMergeEntry::create(spill);
+    MergeEntryPtr pme = IFileMergeEntry::create(spill, _readAhead, _mappedMerge, *_spillFs);
     merger->addMergeEntry(pme);
   }
 
   SortMetrics metrics;
-  sortPartitions(_spec.sortOrder, _spec.sortAlgorithm, NULL, metrics);
+  sortPartitions(_spec.sortOrder, _spec.sortAlgorithm, _buckets, NULL, metrics);
 
   merger->addMergeEntry(new MemoryMergeEntry(_buckets, _numPartitions));
 
@@ -389,9 +1441,9 @@ void MapOutputCollector::finalSpill(const std::string & filepath,
 
   // write index
   SingleSpillInfo * spill_range = writer->getSpillInfo();
-  spill_range->writeSpillInfo(idx_file_path);
+  writeFinalIndex(spill_range, idx_file_path);
   delete spill_range;
-  _spillInfos.deleteAllSpillFiles();
+  _spillInfos.deleteAllSpillFiles(*_spillFs);
   delete writer;
   reset();
 }
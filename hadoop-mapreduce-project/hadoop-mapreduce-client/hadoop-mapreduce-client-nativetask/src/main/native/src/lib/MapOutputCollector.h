@@ -22,13 +22,16 @@
 #include "NativeTask.h"
 #include "lib/MemoryPool.h"
 #include "util/Timer.h"
+#include "util/ThreadPool.h"
 #include "lib/Buffers.h"
 #include "lib/MapOutputSpec.h"
 #include "lib/IFile.h"
 #include "lib/SpillInfo.h"
 #include "lib/Combiner.h"
 #include "lib/PartitionBucket.h"
+#include "lib/TotalOrderPartitioner.h"
 #include "lib/SpillOutputService.h"
+#include "lib/FileSystem.h"
 
 namespace NativeTask {
 /**
@@ -47,16 +50,21 @@ public:
 
 class CombineRunnerWrapper : public ICombineRunner {
 private:
-  Config * _config;
+  // native.combiner.class, empty for the java combiner
+  string _nativeCombiner;
   ICombineRunner * _combineRunner;
   bool _isJavaCombiner;
   bool _combinerInited;
   SpillOutputService * _spillOutput;
+  KeyValueType _valueType;
+  // the java combiner groups on its own
+  KeyGrouping _grouping;
 
 public:
-  CombineRunnerWrapper(Config * config, SpillOutputService * service)
-      : _config(config), _combineRunner(NULL), _isJavaCombiner(false),
-          _combinerInited(false), _spillOutput(service) {
+  CombineRunnerWrapper(Config * config, SpillOutputService * service, const MapOutputSpec & spec)
+      : _nativeCombiner(config->get(NATIVE_COMBINER, "")), _combineRunner(NULL),
+          _isJavaCombiner(false), _combinerInited(false), _spillOutput(service),
+          _valueType(spec.valueType), _grouping(spec.combineGrouping) {
   }
 
   ~CombineRunnerWrapper() {
@@ -71,9 +79,22 @@ private:
   ICombineRunner * createCombiner();
 };
 
+class BackgroundSpillTask;
+
 class MapOutputCollector {
+  friend class BackgroundSpillTask;
+
   static const uint32_t DEFAULT_MIN_BLOCK_SIZE = 16 * 1024;
   static const uint32_t DEFAULT_MAX_BLOCK_SIZE = 4 * 1024 * 1024;
+  // buckets of record lengths, i holds the lengths below 2^i
+  static const uint32_t RECORD_SIZE_BUCKETS = 33;
+  // autotuned blocks start with room for this many of the largest records
+  static const uint32_t AUTOTUNE_BLOCK_RECORDS = 32;
+  // autotuned compact headers need smaller records, the 4 bytes they save
+  // are not worth the compaction pass for larger ones
+  static const uint32_t AUTOTUNE_COMPACT_RECORD_BYTES = 1024;
+  // write back window of spills that are dropped from the page cache
+  static const uint32_t SPILL_DROP_BEHIND_SIZE = 8 * 1024 * 1024;
 
 private:
   Config * _config;
@@ -82,6 +103,8 @@ private:
   PartitionBucket ** _buckets;
 
   ComparatorPtr _keyComparator;
+  // lets custom comparators use the prefix sorts, may be NULL
+  KeyNormalizerPtr _keyNormalizer;
 
   ICombineRunner * _combineRunner;
 
@@ -102,6 +125,62 @@ private:
 
   MemoryPool * _pool;
 
+  uint32_t _sortThreads;
+  ThreadPool * _sortPool;
+  // small records of full memory blocks get a 4 bytes header,
+  // native.sort.compact.headers
+  bool _compactBlocks;
+  // key + value lengths of the collected records, by power of 2
+  uint64_t _recordSizes[RECORD_SIZE_BUCKETS];
+
+  // background spill, enabled by native.spill.async
+  bool _asyncSpill;
+  uint32_t _spillThreshold;
+  PartitionBucket ** _frozenBuckets;
+  ThreadPool * _spillPool;
+  BackgroundSpillTask * _backgroundSpill;
+
+  // max segments of one merge, mapreduce.task.io.sort.factor
+  uint32_t _mergeFactor;
+  // threads of the final merge, native.merge.threads
+  uint32_t _mergeThreads;
+  // bytes read ahead of the merge in each spill, mapreduce.ifile.readahead.bytes
+  uint32_t _readAhead;
+  // read spills through memory mappings, native.merge.mmap
+  bool _mappedMerge;
+  // drop written spills from the page cache, native.spill.drop.cache
+  uint32_t _spillDropBehind;
+  // spill records with writev, native.spill.writev
+  bool _gatherSpill;
+  // front code the keys of intermediate spills, native.spill.prefix.keys
+  bool _prefixKeys;
+  // combine the buckets in memory before spilling, native.combine.inmemory
+  bool _inMemoryCombine;
+  // copy of the final index for the shuffle handler, native.spill.index.shared.dir
+  string _sharedIndexPath;
+  // where intermediate spills go, native.spill.filesystem, the final
+  // output is always local
+  FileSystem * _spillFs;
+  // spills rotate over these, native.spill.stripe
+  vector<string> _localDirs;
+  uint32_t _nextLocalDir;
+  // records carry no partition id, it is the java HashPartitioner
+  // partition of the key, native.partitioner.hash, or the
+  // TotalOrderPartitioner one with _totalOrder
+  bool _hashPartition;
+  // split points of native.partitioner.split.points
+  TotalOrderPartitioner * _totalOrder;
+  // checksum of the intermediate spills, CHECKSUM_SEGMENT_HASH if
+  // native.spill.segment.hash, the final output keeps the spec checksum
+  ChecksumType _spillChecksumType;
+  // codec of the intermediate spills, native.spill.codec, by default the
+  // map output codec, or lz4 if there is none and the spills go to the
+  // tiered file system, so that more of them fit in its memory
+  string _spillCodec;
+  // the writer of the last intermediate spill, the next one reuses its
+  // buffers and codec state instead of allocating them again
+  IFileWriter * _spillWriter;
+
 public:
   MapOutputCollector(uint32_t num_partition, SpillOutputService * spillService);
 
@@ -118,22 +197,140 @@ public:
 
   KVBuffer * allocateKVBuffer(uint32_t partitionId, uint32_t kvlength);
 
+  /**
+   * collect all the complete serialized KVBufferWithParititionId records
+   * in [buff, buff + length), records that fit in the current memory block
+   * of their bucket skip the spill checks and the counters are updated
+   * once per batch. With hash partitioning the records are plain KVBuffers
+   * and the partition is computed from the key
+   * @param endium byte order of the record headers
+   * @return bytes consumed, the remaining tail is an incomplete record
+   */
+  uint32_t collectBatch(const char * buff, uint32_t length, Endium endium);
+
   void close();
 
+  bool isHashPartition() {
+    return _hashPartition;
+  }
+
+  bool hasCombiner() {
+    return NULL != _combineRunner;
+  }
+
+  uint32_t getPartition(const char * key, uint32_t keyLength) {
+    if (NULL != _totalOrder) {
+      return _totalOrder->getPartition(key, keyLength);
+    }
+    return hashPartition(key, keyLength, _numPartitions);
+  }
+
+  /**
+   * partition of the java HashPartitioner for a Text or BytesWritable key,
+   * the key hash is WritableComparator.hashBytes over its bytes
+   */
+  static uint32_t hashPartition(const char * key, uint32_t keyLength, uint32_t numPartitions) {
+    int32_t hash = 1;
+    for (uint32_t i = 0; i < keyLength; i++) {
+      hash = (int32_t)(31U * (uint32_t)hash + (uint32_t)(int32_t)(int8_t)key[i]);
+    }
+    return (uint32_t)(hash & 0x7fffffff) % numPartitions;
+  }
+
+  /**
+   * the key comparator, normalizer is set to the normalizer registered
+   * for a custom comparator or NULL
+   */
+  static ComparatorPtr getComparator(Config * config, MapOutputSpec & spec,
+      KeyNormalizerPtr & normalizer);
+
+  /**
+   * path moved from the local dir it is in to localDirs[index], the part
+   * below the local dir stays the same. Paths outside of all local dirs
+   * are returned unchanged
+   */
+  static string stripeSpillPath(const string & path, const vector<string> & localDirs,
+      uint32_t index);
+
 private:
-  void init(uint32_t maxBlockSize, uint32_t memory_capacity, ComparatorPtr keyComparator,
-      ICombineRunner * combiner);
+  /**
+   * next spill path of the spill output service, spread over the local
+   * dirs if spills are striped
+   */
+  string * getSpillPath();
+
+  /**
+   * spill the buckets to the next spill path
+   */
+  void spill();
+
+  /**
+   * run the combiner over the full buckets and collect its output again,
+   * instead of spilling
+   * @return true if enough memory was freed to keep collecting
+   */
+  bool combineInMemory();
+
+  void init(uint32_t defaultBlockSize, uint32_t maxBlockSize, uint32_t memory_capacity,
+      ComparatorPtr keyComparator, ICombineRunner * combiner, uint32_t sortThreads,
+      bool asyncSpill, float spillPercent);
 
   void reset();
 
   /**
-   * spill a range of partition buckets, prepare for future
-   * Parallel sort & spill, TODO: parallel sort & spill
+   * sort all partition buckets, and spill them to writer in partition order
+   * if writer is not NULL. When native.sort.threads > 1, the memory blocks
+   * of the buckets are sorted concurrently by _sortPool while the calling
+   * thread spills the buckets that are already sorted.
    */
-  void sortPartitions(SortOrder orderType, SortAlgorithm sortType, IFileWriter * writer,
-      SortMetrics & metrics);
+  void sortPartitions(SortOrder orderType, SortAlgorithm sortType, PartitionBucket ** buckets,
+      IFileWriter * writer, SortMetrics & metrics);
+
+  void sortPartitionsParallel(SortAlgorithm sortType, PartitionBucket ** buckets,
+      IFileWriter * writer, SortMetrics & metrics);
+
+  /**
+   * sort & spill buckets to a new spill file, spills which are not the
+   * final output are dropped from the page cache if native.spill.drop.cache
+   * @return spill info of the new file
+   */
+  SingleSpillInfo * spillBuckets(PartitionBucket ** buckets, const std::string & spillOutput,
+      SortMetrics & metrics, bool final);
+
+  /**
+   * count this task under the allocation mode the memory pool got
+   */
+  void reportMemoryPoolMode();
+
+  /**
+   * freeze all buckets and spill them on _spillPool, collect() can
+   * keep using the memory that is not frozen
+   */
+  void startBackgroundSpill();
+
+  /**
+   * if the background spill has finished (or wait is true), record its
+   * result and release the frozen memory
+   * @return true if no background spill is in progress any more
+   */
+  bool checkBackgroundSpill(bool wait);
+
+  /**
+   * write the index of the final output, and publish a copy of it to
+   * _sharedIndexPath if configured
+   */
+  void writeFinalIndex(SingleSpillInfo * info, const string & indexPath);
+
+  /**
+   * report the shape of the map output as NATIVETASK_COUNTER_GROUP
+   * counters: the median, 90th and 99th percentile of the key + value
+   * lengths, each as the power of 2 above it, the largest partition of
+   * the final output in percent of the mean one, and the partitions that
+   * got no records. Fed back as native.sort.autotune.record.bytes and
+   * native.sort.autotune.partition.skew they tune a later run.
+   */
+  void reportOutputStatistics(SingleSpillInfo * info);
 
-  ComparatorPtr getComparator(Config * config, MapOutputSpec & spec);
 
   inline uint32_t GetCeil(uint32_t v, uint32_t unit) {
     return ((v + unit - 1) / unit) * unit;
@@ -147,6 +344,28 @@ private:
     return defaultBlockSize;
   }
 
+  /**
+   * block size from the record length and partition skew an earlier run
+   * reported, see reportOutputStatistics. With skew every partition
+   * starts smaller, the hot ones double their blocks as they fill up, but
+   * a block always has room for AUTOTUNE_BLOCK_RECORDS records.
+   * Zero recordBytes or skewPercent is unknown.
+   */
+  uint32_t getAutotunedBlockSize(uint32_t memoryCapacity, uint32_t maxBlockSize,
+      uint64_t recordBytes, uint64_t skewPercent) {
+    uint64_t blockSize = memoryCapacity / _numPartitions / 4;
+    if (skewPercent > 100) {
+      blockSize = blockSize * 100 / skewPercent;
+    }
+    blockSize = std::max(blockSize, recordBytes * AUTOTUNE_BLOCK_RECORDS);
+    blockSize = std::min(blockSize, (uint64_t)maxBlockSize);
+    return std::min(GetCeil((uint32_t)blockSize, DEFAULT_MIN_BLOCK_SIZE), maxBlockSize);
+  }
+
+  static uint32_t recordSizeBucket(uint32_t length) {
+    return length == 0 ? 0 : 32 - __builtin_clz(length);
+  }
+
   PartitionBucket * getPartition(uint32_t partition);
 
   /**
@@ -160,6 +379,26 @@ private:
    * previous spilled file & in-memory data
    */
   void finalSpill(const std::string & filepath, const std::string & indexpath);
+
+  /**
+   * merge spills to a new spill file at path
+   * @return spill info of the new file
+   */
+  SingleSpillInfo * mergeSpills(const std::vector<SingleSpillInfo *> & spills,
+      const std::string & path);
+
+  /**
+   * merge the smallest spills until the spills plus extraSegments
+   * fit in one merge of _mergeFactor segments
+   */
+  void mergeIntermediateSpills(uint32_t extraSegments);
+
+  /**
+   * merge all spills into filepath, contiguous ranges of partitions are
+   * merged by _mergeThreads threads at offsets computed from the spill
+   * indexes, only valid without codec and combiner
+   */
+  void parallelFinalMerge(const std::string & filepath, const std::string & indexpath);
 };
 
 } //namespace NativeTask
@@ -17,11 +17,86 @@
  */
 
 #include "lib/commons.h"
+#include "util/StringUtil.h"
 #include "lib/MapOutputSpec.h"
+#include "lib/NativeObjectFactory.h"
 #include "NativeTask.h"
 
 namespace NativeTask {
 
+static uint32_t groupLength(const char * key, uint32_t keyLength, uint32_t prefixLength,
+    int32_t separator) {
+  if (prefixLength > 0) {
+    return std::min(keyLength, prefixLength);
+  }
+  const char * end = (const char *)memchr(key, separator, keyLength);
+  return NULL == end ? keyLength : end - key;
+}
+
+bool KeyGrouping::sameGroup(const char * key, uint32_t keyLength, const char * groupKey,
+    uint32_t groupKeyLength) const {
+  if (NULL != comparator) {
+    return comparator(key, keyLength, groupKey, groupKeyLength) == 0;
+  }
+  if (prefixLength > 0 || separator >= 0) {
+    keyLength = groupLength(key, keyLength, prefixLength, separator);
+    groupKeyLength = groupLength(groupKey, groupKeyLength, prefixLength, separator);
+  }
+  return keyLength == groupKeyLength && fmemeq(key, groupKey, keyLength);
+}
+
+void KeyGrouping::check() const {
+  if (!unsupported.empty()) {
+    THROW_EXCEPTION_EX(UnsupportException,
+        "grouping comparator %s has no native counterpart, set %s.%s", unsupported.c_str(),
+        NATIVE_GROUPING_COMPARATOR, unsupported.c_str());
+  }
+}
+
+void KeyGrouping::getGroupingFromConfig(Config * config, const char * comparatorKey,
+    KeyGrouping & grouping) {
+  grouping = KeyGrouping();
+  const char * comparatorClass = config->get(comparatorKey);
+  if (NULL == comparatorClass) {
+    return;
+  }
+  string nativeKey = string(NATIVE_GROUPING_COMPARATOR) + "." + comparatorClass;
+  const char * nativeGrouping = config->get(nativeKey);
+  if (NULL == nativeGrouping) {
+    grouping.unsupported = comparatorClass;
+    return;
+  }
+  string value = nativeGrouping;
+  if (value.compare(0, 7, "prefix:") == 0) {
+    int64_t length = strtoll(value.c_str() + 7, NULL, 10);
+    if (length <= 0 || length > 0xffffffffLL) {
+      THROW_EXCEPTION_EX(IOException, "bad grouping prefix length %s for %s", value.c_str(),
+          nativeKey.c_str());
+    }
+    grouping.prefixLength = (uint32_t)length;
+  } else if (value.compare(0, 10, "separator:") == 0) {
+    string separator = value.substr(10);
+    int64_t code = -1;
+    if (!separator.empty() && separator.find_first_not_of("0123456789") == string::npos) {
+      code = strtoll(separator.c_str(), NULL, 10);
+    } else if (separator.length() == 1) {
+      code = (uint8_t)separator[0];
+    }
+    if (code < 0 || code > 255) {
+      THROW_EXCEPTION_EX(IOException, "bad grouping separator %s for %s", value.c_str(),
+          nativeKey.c_str());
+    }
+    grouping.separator = (int32_t)code;
+  } else {
+    grouping.comparator = (ComparatorPtr)NativeObjectFactory::GetFunction(value);
+    if (NULL == grouping.comparator) {
+      THROW_EXCEPTION_EX(UnsupportException, "native grouping comparator %s not found",
+          value.c_str());
+    }
+  }
+  LOG("[KeyGrouping] %s grouped by %s", comparatorClass, nativeGrouping);
+}
+
 void MapOutputSpec::getSpecFromConfig(Config * config, MapOutputSpec & spec) {
   if (NULL == config) {
     return;
@@ -30,6 +105,10 @@ void MapOutputSpec::getSpecFromConfig(Config * config, MapOutputSpec & spec) {
   string sortType = config->get(NATIVE_SORT_TYPE, "DUALPIVOTSORT");
   if (sortType == "DUALPIVOTSORT") {
     spec.sortAlgorithm = DUALPIVOTSORT;
+  } else if (sortType == "RADIXSORT") {
+    spec.sortAlgorithm = RADIXSORT;
+  } else if (sortType == "PREFIXSORT") {
+    spec.sortAlgorithm = PREFIXSORT;
   } else {
     spec.sortAlgorithm = CPPSORT;
   }
@@ -38,8 +117,11 @@ void MapOutputSpec::getSpecFromConfig(Config * config, MapOutputSpec & spec) {
   } else {
     spec.codec = "";
   }
-  if (config->getBool(MAPRED_SORT_AVOID, false)) {
+  string sortOrder = config->get(NATIVE_SORT_ORDER, "FULLORDER");
+  if (config->getBool(MAPRED_SORT_AVOID, false) || sortOrder == "NOSORT") {
     spec.sortOrder = NOSORT;
+  } else if (sortOrder == "GROUPBY") {
+    spec.sortOrder = GROUPBY;
   } else {
     spec.sortOrder = FULLORDER;
   }
@@ -59,6 +141,9 @@ void MapOutputSpec::getSpecFromConfig(Config * config, MapOutputSpec & spec) {
     THROW_EXCEPTION(IOException, "mapred.mapoutput.value.class not set");
   }
   spec.valueType = JavaClassToKeyValueType(value_class);
+  KeyGrouping::getGroupingFromConfig(config, MAPRED_GROUPING_COMPARATOR, spec.grouping);
+  KeyGrouping::getGroupingFromConfig(config, MAPRED_COMBINER_GROUPING_COMPARATOR,
+      spec.combineGrouping);
 }
 
 } // namespace NativeTask
@@ -35,6 +35,8 @@ enum SortAlgorithm {
   CQSORT = 0,
   CPPSORT = 1,
   DUALPIVOTSORT = 2,
+  RADIXSORT = 3,
+  PREFIXSORT = 4,
 };
 
 /**
@@ -64,6 +66,57 @@ enum CompressionType {
   SNAPPY = 1,
 };
 
+/**
+ * which adjacent keys of the sorted output form one group, for jobs with
+ * a grouping comparator (secondary sort). Without one only equal keys
+ * do. The java comparator class X is replaced by what
+ * native.grouping.comparator.X is set to:
+ *   prefix:N     keys with the same first N bytes
+ *   separator:C  keys with the same bytes before the first C, a decimal
+ *                byte value or a single character other than a digit
+ *   otherwise the name of a native comparator registered with
+ *   REGISTER_FUNCTION, keys comparing as 0
+ * Keys are grouped as they come, the grouping must agree with the sort
+ * order like in java.
+ */
+class KeyGrouping {
+public:
+  // native grouping comparator, NULL if not set
+  ComparatorPtr comparator;
+  // group by the first prefixLength bytes, 0 if not set
+  uint32_t prefixLength;
+  // group by the bytes before separator, -1 if not set
+  int32_t separator;
+  // the java grouping comparator if it has no native counterpart
+  string unsupported;
+
+  KeyGrouping()
+      : comparator(NULL), prefixLength(0), separator(-1) {
+  }
+
+  /**
+   * equal keys only
+   */
+  bool byWholeKey() const {
+    return NULL == comparator && 0 == prefixLength && separator < 0;
+  }
+
+  bool sameGroup(const char * key, uint32_t keyLength, const char * groupKey,
+      uint32_t groupKeyLength) const;
+
+  /**
+   * @throws UnsupportException if the java grouping comparator has no
+   *         native counterpart
+   */
+  void check() const;
+
+  /**
+   * the grouping for the java comparator class set as comparatorKey
+   */
+  static void getGroupingFromConfig(Config * config, const char * comparatorKey,
+      KeyGrouping & grouping);
+};
+
 class MapOutputSpec {
 public:
   KeyValueType keyType;
@@ -72,6 +125,10 @@ public:
   SortAlgorithm sortAlgorithm;
   string codec;
   ChecksumType checksumType;
+  // groups of the reducer, mapreduce.job.output.group.comparator.class
+  KeyGrouping grouping;
+  // groups of the combiner, mapreduce.job.combiner.group.comparator.class
+  KeyGrouping combineGrouping;
 
   static void getSpecFromConfig(Config * config, MapOutputSpec & spec);
 };
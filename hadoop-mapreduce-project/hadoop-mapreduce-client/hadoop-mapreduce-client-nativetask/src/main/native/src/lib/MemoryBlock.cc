@@ -29,14 +29,31 @@
 
 #include "lib/MemoryBlock.h"
 #include "lib/MemoryPool.h"
+#include "lib/NativeObjectFactory.h"
 #include "util/DualPivotQuickSort.h"
 
 namespace NativeTask {
 
 class MemoryPool;
 
-MemoryBlock::MemoryBlock(char * pos, uint32_t size)
-    : _base(pos), _size(size), _position(0), _sorted(false) {
+static KeyPrefixType getKeyPrefixType(ComparatorPtr comparator, KeyNormalizerPtr normalizer) {
+  if (comparator == &NativeObjectFactory::IntComparator) {
+    return INT_PREFIX;
+  } else if (comparator == &NativeObjectFactory::LongComparator) {
+    return LONG_PREFIX;
+  } else if (comparator == &NativeObjectFactory::BytesComparator) {
+    return BYTES_PREFIX;
+  } else if (comparator == &NativeObjectFactory::HashGroupComparator) {
+    return HASH_PREFIX;
+  } else if (NULL != normalizer) {
+    return NORMALIZED_PREFIX;
+  }
+  return NO_PREFIX;
+}
+
+MemoryBlock::MemoryBlock(char * pos, uint32_t size, bool compactable)
+    : _base(pos), _size(size), _position(0), _sorted(false), _compactable(compactable),
+        _compactCount(0), _compactEnd(0) {
 }
 
 KVBuffer * MemoryBlock::getKVBuffer(uint32_t index) {
@@ -44,24 +61,270 @@ KVBuffer * MemoryBlock::getKVBuffer(uint32_t index) {
     return NULL;
   }
   uint32_t offset = _kvOffsets.at(index);
+  if (offset < _compactEnd) {
+    return NULL;
+  }
   KVBuffer * kvbuffer = (KVBuffer*)(_base + offset);
   return kvbuffer;
 }
 
-void MemoryBlock::sort(SortAlgorithm type, ComparatorPtr comparator) {
-  if ((!_sorted) && (_kvOffsets.size() > 1)) {
+bool MemoryBlock::compact(uint32_t length) {
+  const uint32_t count = _kvOffsets.size();
+  if (!_compactable || _sorted || _compactCount == count) {
+    return remainSpace() >= length;
+  }
+  // every record gains the same 4 bytes, not worth moving the whole tail
+  // for a few of them
+  const uint32_t saving = KVBuffer::headerLength() - CompactKVBuffer::headerLength();
+  const uint32_t gain = saving * (count - _compactCount);
+  if (remainSpace() + gain < length || gain * 16 < _position - _compactEnd) {
+    return remainSpace() >= length;
+  }
+
+  // records are in allocation order until the block is sorted, so the
+  // destination never overtakes the source
+  uint32_t dest = _compactEnd;
+  uint32_t i = _compactCount;
+  for (; i < count; i++) {
+    const uint32_t src = _kvOffsets[i];
+    KVBuffer * kv = (KVBuffer *)(_base + src);
+    const uint32_t keyLength = kv->keyLength;
+    const uint32_t valueLength = kv->valueLength;
+    if (keyLength + valueLength > CompactKVBuffer::MAX_LENGTH) {
+      break;
+    }
+    memmove(_base + dest + CompactKVBuffer::headerLength(), kv->content, keyLength + valueLength);
+    CompactKVBuffer * compact = (CompactKVBuffer *)(_base + dest);
+    compact->keyLength = keyLength;
+    compact->valueLength = valueLength;
+    _kvOffsets[i] = dest;
+    dest += CompactKVBuffer::headerLength() + keyLength + valueLength;
+  }
+  _compactCount = i;
+  _compactEnd = dest;
+
+  if (i < count) {
+    // a large record, the rest keep their KVBuffer header
+    _compactable = false;
+    const uint32_t shift = _kvOffsets[i] - dest;
+    if (shift > 0) {
+      memmove(_base + dest, _base + _kvOffsets[i], _position - _kvOffsets[i]);
+      for (; i < count; i++) {
+        _kvOffsets[i] -= shift;
+      }
+    }
+    _position -= shift;
+  } else {
+    _position = dest;
+  }
+  return remainSpace() >= length;
+}
+
+void MemoryBlock::sort(SortAlgorithm type, ComparatorPtr comparator, KeyNormalizerPtr normalizer) {
+  if ((!_sorted) && (_kvOffsets.size() > 1) && !keysInOrder(comparator)) {
     switch (type) {
     case CPPSORT:
-      std::sort(_kvOffsets.begin(), _kvOffsets.end(), ComparatorForStdSort(_base, comparator));
+    case DUALPIVOTSORT:
+      comparisonSort(type, comparator);
       break;
-    case DUALPIVOTSORT: {
-      DualPivotQuicksort(_kvOffsets, ComparatorForDualPivotSort(_base, comparator));
-    }
+    case RADIXSORT:
+      if (!radixSort(comparator, normalizer)) {
+        comparisonSort(DUALPIVOTSORT, comparator);
+      }
+      break;
+    case PREFIXSORT:
+      if (!prefixSort(comparator, normalizer)) {
+        comparisonSort(DUALPIVOTSORT, comparator);
+      }
       break;
     default:
       THROW_EXCEPTION(UnsupportException, "Sort Algorithm not support");
     }
   }
   _sorted = true;
+  // offsets get out of allocation order
+  _compactable = false;
+}
+
+template<typename KeyComparator>
+void MemoryBlock::sortOffsets(SortAlgorithm type, KeyComparator comparator) {
+  if (type == CPPSORT) {
+    std::sort(_kvOffsets.begin(), _kvOffsets.end(),
+        TypedComparatorForStdSort<KeyComparator>(_base, _compactEnd, comparator));
+  } else {
+    DualPivotQuicksort(_kvOffsets, TypedComparatorForDualPivotSort<KeyComparator>(_base, _compactEnd,
+        comparator));
+  }
+}
+
+void MemoryBlock::comparisonSort(SortAlgorithm type, ComparatorPtr comparator) {
+  if (comparator == &NativeObjectFactory::BytesComparator) {
+    sortOffsets(type, BytesKeyComparator());
+  } else if (comparator == &NativeObjectFactory::ByteComparator) {
+    sortOffsets(type, ByteKeyComparator());
+  } else if (comparator == &NativeObjectFactory::IntComparator) {
+    sortOffsets(type, IntKeyComparator());
+  } else if (comparator == &NativeObjectFactory::LongComparator) {
+    sortOffsets(type, LongKeyComparator());
+  } else if (comparator == &NativeObjectFactory::VIntComparator) {
+    sortOffsets(type, VIntKeyComparator());
+  } else if (comparator == &NativeObjectFactory::VLongComparator) {
+    sortOffsets(type, VLongKeyComparator());
+  } else if (comparator == &NativeObjectFactory::FloatComparator) {
+    sortOffsets(type, FloatKeyComparator());
+  } else if (comparator == &NativeObjectFactory::DoubleComparator) {
+    sortOffsets(type, DoubleKeyComparator());
+  } else {
+    sortOffsets(type, PointerKeyComparator(comparator));
+  }
+}
+
+template<typename KeyComparator>
+bool MemoryBlock::offsetsInOrder(KeyComparator comparator) {
+  const uint32_t count = _kvOffsets.size();
+  uint32_t lastLength;
+  const char * last = getRecordKey(_base, _compactEnd, _kvOffsets[0], lastLength);
+  for (uint32_t i = 1; i < count; i++) {
+    uint32_t currentLength;
+    const char * current = getRecordKey(_base, _compactEnd, _kvOffsets[i], currentLength);
+    if (comparator(last, lastLength, current, currentLength) > 0) {
+      return false;
+    }
+    last = current;
+    lastLength = currentLength;
+  }
+  return true;
+}
+
+bool MemoryBlock::keysInOrder(ComparatorPtr comparator) {
+  if (comparator == &NativeObjectFactory::BytesComparator) {
+    return offsetsInOrder(BytesKeyComparator());
+  } else if (comparator == &NativeObjectFactory::ByteComparator) {
+    return offsetsInOrder(ByteKeyComparator());
+  } else if (comparator == &NativeObjectFactory::IntComparator) {
+    return offsetsInOrder(IntKeyComparator());
+  } else if (comparator == &NativeObjectFactory::LongComparator) {
+    return offsetsInOrder(LongKeyComparator());
+  } else if (comparator == &NativeObjectFactory::VIntComparator) {
+    return offsetsInOrder(VIntKeyComparator());
+  } else if (comparator == &NativeObjectFactory::VLongComparator) {
+    return offsetsInOrder(VLongKeyComparator());
+  } else if (comparator == &NativeObjectFactory::FloatComparator) {
+    return offsetsInOrder(FloatKeyComparator());
+  } else if (comparator == &NativeObjectFactory::DoubleComparator) {
+    return offsetsInOrder(DoubleKeyComparator());
+  }
+  return offsetsInOrder(PointerKeyComparator(comparator));
+}
+
+void MemoryBlock::buildPrefixIndex(KeyPrefixType type, KeyNormalizerPtr normalizer,
+    std::vector<PrefixEntry> & entries) {
+  const uint32_t count = _kvOffsets.size();
+  entries.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t keyLength;
+    const char * key = getRecordKey(_base, _compactEnd, _kvOffsets[i], keyLength);
+    if (type == NORMALIZED_PREFIX) {
+      entries[i].prefix = normalizer(key, keyLength);
+    } else {
+      entries[i].prefix = getKeyPrefix(type, key, keyLength);
+    }
+    entries[i].offset = _kvOffsets[i];
+  }
+}
+
+bool MemoryBlock::prefixSort(ComparatorPtr comparator, KeyNormalizerPtr normalizer) {
+  KeyPrefixType prefixType = getKeyPrefixType(comparator, normalizer);
+  if (prefixType == NO_PREFIX) {
+    return false;
+  }
+  std::vector<PrefixEntry> entries;
+  buildPrefixIndex(prefixType, normalizer, entries);
+  if (prefixType == NORMALIZED_PREFIX) {
+    std::sort(entries.begin(), entries.end(),
+        TypedComparatorForPrefixSort<PointerKeyComparator>(_base, _compactEnd, false,
+            PointerKeyComparator(comparator)));
+  } else {
+    bool prefixIsKey = prefixType == INT_PREFIX || prefixType == LONG_PREFIX;
+    std::sort(entries.begin(), entries.end(), ComparatorForPrefixSort(_base, _compactEnd,
+        prefixIsKey));
+  }
+  for (uint32_t i = 0; i < entries.size(); i++) {
+    _kvOffsets[i] = entries[i].offset;
+  }
+  return true;
+}
+
+bool MemoryBlock::radixSort(ComparatorPtr comparator, KeyNormalizerPtr normalizer) {
+  KeyPrefixType prefixType = getKeyPrefixType(comparator, normalizer);
+  if (prefixType == NO_PREFIX) {
+    return false;
+  }
+
+  const uint32_t count = _kvOffsets.size();
+  std::vector<PrefixEntry> entries;
+  std::vector<PrefixEntry> swap(count);
+  buildPrefixIndex(prefixType, normalizer, entries);
+
+  // byte histograms for all passes are built in one scan
+  uint32_t histogram[8][256];
+  memset(histogram, 0, sizeof(histogram));
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t prefix = entries[i].prefix;
+    for (uint32_t pass = 0; pass < 8; pass++) {
+      histogram[pass][(prefix >> (8 * pass)) & 0xff]++;
+    }
+  }
+
+  // LSD, int prefix only lives in the upper 4 bytes
+  PrefixEntry * src = &entries[0];
+  PrefixEntry * dest = &swap[0];
+  for (uint32_t pass = (prefixType == INT_PREFIX ? 4 : 0); pass < 8; pass++) {
+    uint32_t * counts = histogram[pass];
+    const uint32_t shift = 8 * pass;
+    if (counts[(src[0].prefix >> shift) & 0xff] == count) {
+      // every key has the same byte here
+      continue;
+    }
+    uint32_t position = 0;
+    for (uint32_t digit = 0; digit < 256; digit++) {
+      uint32_t digitCount = counts[digit];
+      counts[digit] = position;
+      position += digitCount;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      dest[counts[(src[i].prefix >> shift) & 0xff]++] = src[i];
+    }
+    std::swap(src, dest);
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    _kvOffsets[i] = src[i].offset;
+  }
+
+  if (prefixType == BYTES_PREFIX || prefixType == HASH_PREFIX
+      || prefixType == NORMALIZED_PREFIX) {
+    // keys sharing the same prefix may still differ in the tail or the
+    // length, with equal hashes only the bytes are left to compare
+    uint32_t start = 0;
+    while (start < count) {
+      uint32_t end = start + 1;
+      while (end < count && src[end].prefix == src[start].prefix) {
+        end++;
+      }
+      if (end - start > 1) {
+        if (prefixType == NORMALIZED_PREFIX) {
+          std::sort(_kvOffsets.begin() + start, _kvOffsets.begin() + end,
+              ComparatorForStdSort(_base, _compactEnd, PointerKeyComparator(comparator)));
+        } else {
+          std::sort(_kvOffsets.begin() + start, _kvOffsets.begin() + end,
+              TypedComparatorForStdSort<BytesKeyComparator>(_base, _compactEnd,
+                  BytesKeyComparator()));
+        }
+      }
+      start = end;
+    }
+  }
+  return true;
 }
 } // namespace NativeTask
@@ -20,44 +20,152 @@
 #ifndef MEMORYBLOCK_H_
 #define MEMORYBLOCK_H_
 
+#include "lib/KeyComparators.h"
+
 namespace NativeTask {
 
 class MemoryPool;
 
-class ComparatorForDualPivotSort {
+/**
+ * the key of the record at offset of a memory block, the records below
+ * compactEnd have a CompactKVBuffer header, see MemoryBlock::compact
+ */
+inline const char * getRecordKey(const char * base, uint32_t compactEnd, uint32_t offset,
+    uint32_t & keyLength) {
+  if (offset < compactEnd) {
+    const CompactKVBuffer * kv = (const CompactKVBuffer *)(base + offset);
+    keyLength = kv->keyLength;
+    return kv->content;
+  }
+  const KVBuffer * kv = (const KVBuffer *)(base + offset);
+  keyLength = kv->keyLength;
+  return kv->content;
+}
+
+/**
+ * KeyComparator is one of the functors of lib/KeyComparators.h, the
+ * built-in ones are inlined into the sort, PointerKeyComparator keeps
+ * the call through a ComparatorPtr for the user supplied comparators
+ */
+template<typename KeyComparator>
+class TypedComparatorForDualPivotSort {
 private:
   const char * _base;
-  ComparatorPtr _keyComparator;
+  uint32_t _compactEnd;
+  KeyComparator _keyComparator;
 public:
-  ComparatorForDualPivotSort(const char * base, ComparatorPtr comparator)
-      : _base(base), _keyComparator(comparator) {
+  TypedComparatorForDualPivotSort(const char * base, uint32_t compactEnd,
+      KeyComparator comparator)
+      : _base(base), _compactEnd(compactEnd), _keyComparator(comparator) {
   }
 
   inline int operator()(uint32_t lhs, uint32_t rhs) {
-    KVBuffer * left = (KVBuffer *)(_base + lhs);
-    KVBuffer * right = (KVBuffer *)(_base + rhs);
-    return (*_keyComparator)(left->content, left->keyLength, right->content, right->keyLength);
+    uint32_t leftLength, rightLength;
+    const char * left = getRecordKey(_base, _compactEnd, lhs, leftLength);
+    const char * right = getRecordKey(_base, _compactEnd, rhs, rightLength);
+    return _keyComparator(left, leftLength, right, rightLength);
+  }
+};
+
+typedef TypedComparatorForDualPivotSort<PointerKeyComparator> ComparatorForDualPivotSort;
+
+/**
+ * how a key is mapped to a 8 bytes prefix which compares as unsigned
+ * integer in the same order as the key comparator
+ */
+enum KeyPrefixType {
+  NO_PREFIX = 0,
+  INT_PREFIX = 1,   // the whole key, sign bit flipped
+  LONG_PREFIX = 2,  // the whole key, sign bit flipped
+  BYTES_PREFIX = 3, // first 8 bytes, ties need the comparator
+  HASH_PREFIX = 4,  // fhash64 of the key, ties need a bytes comparison
+  NORMALIZED_PREFIX = 5, // KeyNormalizerPtr of a custom comparator, ties need the comparator
+};
+
+struct PrefixEntry {
+  uint64_t prefix;
+  uint32_t offset;
+};
+
+inline uint64_t getKeyPrefix(KeyPrefixType type, const char * key, uint32_t keyLength) {
+  switch (type) {
+  case INT_PREFIX:
+    return ((uint64_t)(bswap(*(const uint32_t *)key) ^ 0x80000000U)) << 32;
+  case LONG_PREFIX:
+    return bswap64(*(const uint64_t *)key) ^ 0x8000000000000000ULL;
+  case HASH_PREFIX:
+    return fhash64(key, keyLength);
+  default: {
+    uint64_t prefix = 0;
+    uint32_t length = keyLength < 8 ? keyLength : 8;
+    for (uint32_t i = 0; i < length; i++) {
+      prefix |= ((uint64_t)(uint8_t)key[i]) << (56 - 8 * i);
+    }
+    return prefix;
+  }
+  }
+}
+
+/**
+ * compares (prefix, offset) index entries, the key in the arena is only
+ * read when the prefixes are equal and don't hold the whole key, such
+ * ties are ordered by KeyComparator, bytes for BYTES_PREFIX and
+ * HASH_PREFIX, the custom comparator for NORMALIZED_PREFIX
+ */
+template<typename KeyComparator>
+class TypedComparatorForPrefixSort {
+private:
+  const char * _base;
+  uint32_t _compactEnd;
+  KeyComparator _keyComparator;
+  bool _prefixIsKey;
+public:
+  TypedComparatorForPrefixSort(const char * base, uint32_t compactEnd, bool prefixIsKey,
+      KeyComparator comparator = KeyComparator())
+      : _base(base), _compactEnd(compactEnd), _keyComparator(comparator),
+          _prefixIsKey(prefixIsKey) {
+  }
+
+  inline bool operator()(const PrefixEntry & lhs, const PrefixEntry & rhs) {
+    if (lhs.prefix != rhs.prefix) {
+      return lhs.prefix < rhs.prefix;
+    }
+    if (_prefixIsKey) {
+      return false;
+    }
+    uint32_t leftLength, rightLength;
+    const char * left = getRecordKey(_base, _compactEnd, lhs.offset, leftLength);
+    const char * right = getRecordKey(_base, _compactEnd, rhs.offset, rightLength);
+    int ret = _keyComparator(left, leftLength, right, rightLength);
+    return ret < 0;
   }
 };
 
-class ComparatorForStdSort {
+typedef TypedComparatorForPrefixSort<BytesKeyComparator> ComparatorForPrefixSort;
+
+template<typename KeyComparator>
+class TypedComparatorForStdSort {
 private:
   const char * _base;
-  ComparatorPtr _keyComparator;
+  uint32_t _compactEnd;
+  KeyComparator _keyComparator;
 public:
-  ComparatorForStdSort(const char * base, ComparatorPtr comparator)
-      : _base(base), _keyComparator(comparator) {
+  TypedComparatorForStdSort(const char * base, uint32_t compactEnd, KeyComparator comparator)
+      : _base(base), _compactEnd(compactEnd), _keyComparator(comparator) {
   }
 
 public:
   inline bool operator()(uint32_t lhs, uint32_t rhs) {
-    KVBuffer * left = (KVBuffer *)(_base + lhs);
-    KVBuffer * right = (KVBuffer *)(_base + rhs);
-    int ret = (*_keyComparator)(left->getKey(), left->keyLength, right->getKey(), right->keyLength);
+    uint32_t leftLength, rightLength;
+    const char * left = getRecordKey(_base, _compactEnd, lhs, leftLength);
+    const char * right = getRecordKey(_base, _compactEnd, rhs, rightLength);
+    int ret = _keyComparator(left, leftLength, right, rightLength);
     return ret < 0;
   }
 };
 
+typedef TypedComparatorForStdSort<PointerKeyComparator> ComparatorForStdSort;
+
 class MemoryBlock {
 private:
   char * _base;
@@ -65,9 +173,15 @@ private:
   uint32_t _position;
   std::vector<uint32_t> _kvOffsets;
   bool _sorted;
+  // the first _compactCount records, which end at _compactEnd, have been
+  // rewritten by compact(), cleared once the block can't be compacted
+  // any further
+  bool _compactable;
+  uint32_t _compactCount;
+  uint32_t _compactEnd;
 
 public:
-  MemoryBlock(char * pos, uint32_t size);
+  MemoryBlock(char * pos, uint32_t size, bool compactable = false);
 
   char * base() {
     return _base;
@@ -97,9 +211,87 @@ public:
     return _kvOffsets.size();
   }
 
+  /**
+   * NULL for the records rewritten by compact(), use getRecord()
+   */
   KVBuffer * getKVBuffer(uint32_t index);
 
-  void sort(SortAlgorithm type, ComparatorPtr comparator);
+  /**
+   * key and value of the index-th record
+   */
+  void getRecord(uint32_t index, char *& key, uint32_t & keyLength, char *& value,
+      uint32_t & valueLength) {
+    const uint32_t offset = _kvOffsets[index];
+    if (offset < _compactEnd) {
+      CompactKVBuffer * kv = (CompactKVBuffer *)(_base + offset);
+      keyLength = kv->keyLength;
+      valueLength = kv->valueLength;
+      key = kv->content;
+    } else {
+      KVBuffer * kv = (KVBuffer *)(_base + offset);
+      keyLength = kv->keyLength;
+      valueLength = kv->valueLength;
+      key = kv->content;
+    }
+    value = key + keyLength;
+  }
+
+  /**
+   * rewrite the records allocated since the last call with a
+   * CompactKVBuffer header, in one pass which moves them to the start of
+   * the block, so the header bytes saved become free space at the end.
+   * Stops for good at a record longer than CompactKVBuffer::MAX_LENGTH,
+   * or once the block has been sorted. Every record must be filled.
+   * @return true if length bytes are free afterwards
+   */
+  bool compact(uint32_t length);
+
+  /**
+   * sort the kv offsets by key, normalizer is the KeyNormalizerPtr of a
+   * custom comparator, which lets RADIXSORT and PREFIXSORT handle it.
+   * Keys that were collected in order are detected with one comparison
+   * per record and not sorted again
+   */
+  void sort(SortAlgorithm type, ComparatorPtr comparator, KeyNormalizerPtr normalizer = NULL);
+
+private:
+  /**
+   * radix sort on the normalized 8 bytes key prefix, only the ties of the
+   * prefix are resolved with the comparator, return false if the
+   * comparator can't be expressed with a prefix
+   */
+  bool radixSort(ComparatorPtr comparator, KeyNormalizerPtr normalizer);
+
+  /**
+   * std::sort on a (prefix, offset) index, so most comparisons don't touch
+   * the kv arena, return false if the comparator can't be expressed with
+   * a prefix
+   */
+  bool prefixSort(ComparatorPtr comparator, KeyNormalizerPtr normalizer);
+
+  void buildPrefixIndex(KeyPrefixType type, KeyNormalizerPtr normalizer,
+      std::vector<PrefixEntry> & entries);
+
+  /**
+   * CPPSORT or DUALPIVOTSORT with the comparison inlined
+   */
+  template<typename KeyComparator>
+  void sortOffsets(SortAlgorithm type, KeyComparator comparator);
+
+  /**
+   * picks the sortOffsets instantiation of a built-in comparator, user
+   * supplied comparators are called through the pointer
+   */
+  void comparisonSort(SortAlgorithm type, ComparatorPtr comparator);
+
+  /**
+   * whether every key is >= the one before, stops at the first one that
+   * isn't, so unordered blocks pay a few comparisons only
+   */
+  template<typename KeyComparator>
+  bool offsetsInOrder(KeyComparator comparator);
+
+  bool keysInOrder(ComparatorPtr comparator);
 };
 //class MemoryBlock
 
@@ -108,17 +300,36 @@ private:
   MemoryBlock * _memBlock;
   uint32_t _end;
   uint32_t _current;
-  KVBuffer * _kvBuffer;
+  char * _key;
+  uint32_t _keyLength;
+  char * _value;
+  uint32_t _valueLength;
 
 public:
 
   MemBlockIterator(MemoryBlock * memBlock)
-      : _memBlock(memBlock), _end(0), _current(0), _kvBuffer(NULL) {
+      : _memBlock(memBlock), _end(0), _current(0), _key(NULL), _keyLength(0), _value(NULL),
+          _valueLength(0) {
     _end = memBlock->getKVCount();
   }
 
-  KVBuffer * getKVBuffer() {
-    return _kvBuffer;
+  /**
+   * NULL before the first next()
+   */
+  char * getKey() {
+    return _key;
+  }
+
+  uint32_t getKeyLength() {
+    return _keyLength;
+  }
+
+  char * getValue() {
+    return _value;
+  }
+
+  uint32_t getValueLength() {
+    return _valueLength;
   }
 
   /**
@@ -130,7 +341,7 @@ public:
     if (_current >= _end) {
       return false;
     }
-    this->_kvBuffer = _memBlock->getKVBuffer(_current);
+    _memBlock->getRecord(_current, _key, _keyLength, _value, _valueLength);
     ++_current;
     return true;
   }
@@ -151,19 +362,17 @@ public:
 public:
   bool operator()(const MemBlockIteratorPtr lhs, const MemBlockIteratorPtr rhs) {
 
-    KVBuffer * left = lhs->getKVBuffer();
-    KVBuffer * right = rhs->getKVBuffer();
-
     //Treat NULL as infinite MAX, so that we can pop out next value
-    if (NULL == left) {
+    if (NULL == lhs->getKey()) {
       return false;
     }
 
-    if (NULL == right) {
+    if (NULL == rhs->getKey()) {
       return true;
     }
 
-    return (*_keyComparator)(left->content, left->keyLength, right->content, right->keyLength) < 0;
+    return (*_keyComparator)(lhs->getKey(), lhs->getKeyLength(), rhs->getKey(),
+        rhs->getKeyLength()) < 0;
   }
 };
 
@@ -0,0 +1,161 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "lib/commons.h"
+#include "lib/MemoryPool.h"
+
+namespace NativeTask {
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// from numaif.h, which is not always installed
+static const int MPOL_PREFERRED_POLICY = 1;
+
+void MemoryPool::init(uint32_t capacity) throw (OutOfMemoryException) {
+  if (capacity > _capacity) {
+    release();
+    _base = allocateArena(capacity);
+    if (NULL == _base) {
+      THROW_EXCEPTION(OutOfMemoryException, "Not enough memory to init MemoryBlockPool");
+    }
+    _capacity = capacity;
+  }
+  reset();
+}
+
+char * MemoryPool::allocateArena(uint32_t capacity) {
+  _numaBound = false;
+  _highWater = 0;
+  bool elastic = _softLimit > 0 && _softLimit < capacity;
+  if (_hugePages || _numaLocal || elastic) {
+    size_t size = capacity;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (_hugePages) {
+      size = (capacity + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+    void * addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (_hugePages) {
+      addr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+      if (MAP_FAILED != addr) {
+        _mode = POOL_HUGETLB;
+      } else {
+        LOG("[MemoryPool] MAP_HUGETLB failed, %s, fall back to transparent huge pages",
+            strerror(errno));
+      }
+    }
+#endif
+    if (MAP_FAILED == addr) {
+      addr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (MAP_FAILED != addr) {
+        _mode = POOL_MMAP;
+#ifdef MADV_HUGEPAGE
+        if (_hugePages) {
+          if (0 == madvise(addr, size, MADV_HUGEPAGE)) {
+            _mode = POOL_TRANSPARENT_HUGEPAGE;
+          } else {
+            LOG("[MemoryPool] madvise(MADV_HUGEPAGE) failed, %s", strerror(errno));
+          }
+        }
+#endif
+      } else {
+        LOG("[MemoryPool] mmap %zu bytes failed, %s, fall back to malloc", size,
+            strerror(errno));
+      }
+    }
+    if (MAP_FAILED != addr) {
+      _mappedSize = size;
+      // nothing is touched yet, so the policy applies to every page
+      if (_numaLocal) {
+        _numaBound = bindLocalNode(addr, size);
+      }
+      return (char *)addr;
+    }
+  }
+  _mode = POOL_MALLOC;
+  _mappedSize = 0;
+  return (char *)malloc(capacity);
+}
+
+bool MemoryPool::bindLocalNode(void * addr, size_t size) {
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (0 != syscall(SYS_getcpu, &cpu, &node, NULL)) {
+    LOG("[MemoryPool] getcpu failed, %s, NUMA binding skipped", strerror(errno));
+    return false;
+  }
+  const uint32_t bitsPerLong = 8 * sizeof(unsigned long);
+  unsigned long nodeMask[1024 / (8 * sizeof(unsigned long))];
+  if (node >= sizeof(nodeMask) * 8) {
+    return false;
+  }
+  memset(nodeMask, 0, sizeof(nodeMask));
+  nodeMask[node / bitsPerLong] |= 1UL << (node % bitsPerLong);
+  // preferred, not bind: pages come from other nodes once the local one is full
+  if (0 != syscall(SYS_mbind, addr, size, MPOL_PREFERRED_POLICY, nodeMask,
+      sizeof(nodeMask) * 8, 0)) {
+    LOG("[MemoryPool] mbind to node %u failed, %s", node, strerror(errno));
+    return false;
+  }
+  return true;
+#else
+  LOG("[MemoryPool] NUMA binding not supported on this platform");
+  return false;
+#endif
+}
+
+void MemoryPool::trim() {
+  // malloc()ed memory stays resident, so it stays accounted for
+  if (_mode == POOL_MALLOC) {
+    return;
+  }
+  size_t pageSize = (_mode == POOL_HUGETLB) ? HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE);
+  size_t from = (getSoftLimit() + pageSize - 1) / pageSize * pageSize;
+  if (from >= _highWater) {
+    return;
+  }
+  // anonymous pages read back as zero after this, which is fine for the pool
+  if (0 != madvise(_base + from, _highWater - from, MADV_DONTNEED)) {
+    LOG("[MemoryPool] madvise(MADV_DONTNEED) failed, %s", strerror(errno));
+    return;
+  }
+  LOG("[MemoryPool] released %uK above the soft limit", (_highWater - (uint32_t)from) / 1024);
+  native_memory_add(NATIVE_MEMORY_SORT, (int64_t)from - _highWater);
+  _highWater = from;
+}
+
+void MemoryPool::release() {
+  if (NULL != _base) {
+    if (_mode == POOL_MALLOC) {
+      free(_base);
+    } else {
+      munmap(_base, _mappedSize);
+    }
+    _base = NULL;
+  }
+  native_memory_add(NATIVE_MEMORY_SORT, -(int64_t)_highWater);
+  _highWater = 0;
+  _capacity = 0;
+}
+
+} // namespace NativeTask
@@ -23,66 +23,217 @@
 #include "lib/MapOutputSpec.h"
 #include "NativeTask.h"
 #include "util/StringUtil.h"
+#include "native_memory.h"
 
 namespace NativeTask {
 
+/**
+ * how the memory of the pool is obtained
+ */
+enum MemoryPoolMode {
+  POOL_MALLOC = 0,
+  POOL_MMAP = 1,
+  POOL_TRANSPARENT_HUGEPAGE = 2,
+  POOL_HUGETLB = 3,
+};
+
 /**
  * Class for allocating memory buffer
+ *
+ * The pool is used as a ring: allocated memory is [_start, _end) or, once
+ * allocation has wrapped around, [_start, _wrapPoint) + [0, _end).
+ * Without freeze() nothing is ever released before reset(), so _start
+ * stays 0 and the pool behaves as a plain bump allocator.
+ *
+ * The capacity is a hard limit. With a lower soft limit the pool is
+ * mapped so pages are only committed when first used, and reset() gives
+ * the pages above the soft limit back to the system.
+ *
+ * Memory is accounted as NATIVE_MEMORY_SORT once it is handed out, as
+ * pages are only committed when first touched.
  */
 
 class MemoryPool {
 private:
   char * _base;
   uint32_t _capacity;
-  uint32_t _used;
+  uint32_t _start;
+  uint32_t _end;
+  uint32_t _wrapPoint;
+  bool _wrapped;
+
+  // snapshot of _end/_wrapped taken by freeze()
+  uint32_t _frozenEnd;
+  bool _frozenWrapped;
+  bool _hasFrozen;
+
+  // requested by setAllocationMode()
+  bool _hugePages;
+  bool _numaLocal;
+  // 0 if the same as capacity
+  uint32_t _softLimit;
+  // highest offset handed out since the last trim
+  uint32_t _highWater;
+  // what init() actually got
+  MemoryPoolMode _mode;
+  size_t _mappedSize;
+  bool _numaBound;
 
 public:
 
   MemoryPool()
-      : _base(NULL), _capacity(0), _used(0) {
+      : _base(NULL), _capacity(0), _start(0), _end(0), _wrapPoint(0), _wrapped(false),
+          _frozenEnd(0), _frozenWrapped(false), _hasFrozen(false), _hugePages(false),
+          _numaLocal(false), _softLimit(0), _highWater(0), _mode(POOL_MALLOC), _mappedSize(0), _numaBound(false) {
   }
 
   ~MemoryPool() {
-    if (NULL != _base) {
-      free(_base);
-      _base = NULL;
+    release();
+  }
+
+  /**
+   * must be called before init()
+   * @param hugePages back the pool with MAP_HUGETLB pages, or transparent
+   *                  huge pages if none are reserved
+   * @param numaLocal bind the pool to the NUMA node of the calling thread
+   * both fall back to what is available, see getMode()
+   */
+  void setAllocationMode(bool hugePages, bool numaLocal) {
+    _hugePages = hugePages;
+    _numaLocal = numaLocal;
+  }
+
+  /**
+   * must be called before init(), memory above softLimit is returned to
+   * the system on reset()
+   */
+  void setSoftLimit(uint32_t softLimit) {
+    _softLimit = softLimit;
+  }
+
+  /**
+   * the soft limit, or the capacity if there is none
+   */
+  uint32_t getSoftLimit() const {
+    if (_softLimit > 0 && _softLimit < _capacity) {
+      return _softLimit;
+    }
+    return _capacity;
+  }
+
+  /**
+   * @param capacity hard limit of the pool
+   */
+  void init(uint32_t capacity) throw (OutOfMemoryException);
+
+  MemoryPoolMode getMode() const {
+    return _mode;
+  }
+
+  bool isNumaBound() const {
+    return _numaBound;
+  }
+
+  void reset() {
+    if (_highWater > getSoftLimit()) {
+      trim();
     }
+    _start = 0;
+    _end = 0;
+    _wrapPoint = 0;
+    _wrapped = false;
+    _frozenEnd = 0;
+    _frozenWrapped = false;
+    _hasFrozen = false;
   }
 
-  void init(uint32_t capacity) throw (OutOfMemoryException) {
-    if (capacity > _capacity) {
-      if (NULL != _base) {
-        free(_base);
-        _base = NULL;
+  char * allocate(uint32_t min, uint32_t expect, uint32_t & allocated) {
+    uint32_t offset = 0;
+    uint32_t remain = 0;
+    if (!_wrapped) {
+      if (min <= _capacity - _end) {
+        offset = _end;
+        remain = _capacity - _end;
+      } else if (min <= _start) {
+        // the tail is too small, continue at the head of the ring
+        _wrapPoint = _end;
+        _wrapped = true;
+        offset = 0;
+        remain = _start;
+      } else {
+        return NULL;
       }
-      _base = (char*)malloc(capacity);
-      if (NULL == _base) {
-        THROW_EXCEPTION(OutOfMemoryException, "Not enough memory to init MemoryBlockPool");
+    } else {
+      if (min > _start - _end) {
+        return NULL;
       }
-      _capacity = capacity;
+      offset = _end;
+      remain = _start - _end;
+    }
+    // close to full, hand out what is left instead of wasting it
+    allocated = expect > remain ? remain : expect;
+    _end = offset + allocated;
+    if (_end > _highWater) {
+      native_memory_add(NATIVE_MEMORY_SORT, _end - _highWater);
+      _highWater = _end;
     }
-    reset();
+    return _base + offset;
   }
 
-  void reset() {
-    _used = 0;
+  uint32_t getCapacity() const {
+    return _capacity;
   }
 
-  char * allocate(uint32_t min, uint32_t expect, uint32_t & allocated) {
-    if (_used + min > _capacity) {
-      return NULL;
-    } else if (_used + expect > _capacity) {
-      char * buff = _base + _used;
-      allocated = min;
-      _used += min;
-      return buff;
+  /**
+   * bytes currently allocated, including frozen memory
+   */
+  uint32_t getUsed() const {
+    if (_wrapped) {
+      return _wrapPoint - _start + _end;
+    }
+    return _end - _start;
+  }
+
+  /**
+   * mark everything allocated so far as frozen, later allocations
+   * continue after it, and releaseFrozen() gives it back to the pool
+   */
+  void freeze() {
+    _frozenEnd = _end;
+    _frozenWrapped = _wrapped;
+    _hasFrozen = true;
+  }
+
+  bool hasFrozen() const {
+    return _hasFrozen;
+  }
+
+  void releaseFrozen() {
+    if (!_hasFrozen) {
+      return;
+    }
+    _hasFrozen = false;
+    if (_frozenWrapped) {
+      // frozen memory covered the tail of the ring, what is left is linear
+      _start = _frozenEnd;
+      _wrapped = false;
+    } else if (_wrapped && _frozenEnd == _wrapPoint) {
+      _start = 0;
+      _wrapped = false;
     } else {
-      char * buff = _base + _used;
-      allocated = expect;
-      _used += expect;
-      return buff;
+      _start = _frozenEnd;
+    }
+    if (!_wrapped && _start == _end) {
+      _start = 0;
+      _end = 0;
     }
   }
+
+private:
+  char * allocateArena(uint32_t capacity);
+  bool bindLocalNode(void * addr, size_t size);
+  void trim();
+  void release();
 };
 
 } // namespace NativeTask
@@ -21,23 +21,37 @@
 #include "util/StringUtil.h"
 #include "lib/Merge.h"
 #include "lib/FileSystem.h"
+#include "lib/TaskCounters.h"
 
 namespace NativeTask {
 
-IFileMergeEntry * IFileMergeEntry::create(SingleSpillInfo * spill) {
-  InputStream * fileOut = FileSystem::getLocal().open(spill->path);
+IFileMergeEntry * IFileMergeEntry::create(SingleSpillInfo * spill, uint32_t readAhead,
+    bool mapped, FileSystem & fs) {
+  if (&fs != &FileSystem::getLocal()) {
+    return new IFileMergeEntry(new IFileReader(fs.open(spill->path), spill, true));
+  }
+  if (mapped) {
+    MmapInputStream * fin = new MmapInputStream(spill->path);
+    return new IFileMergeEntry(new IFileReader(fin, spill, true));
+  }
+  // spills are always local files
+  FileInputStream * fileOut = (FileInputStream *)FileSystem::getLocal().open(spill->path);
+  fileOut->setReadAhead(readAhead);
   IFileReader * reader = new IFileReader(fileOut, spill, true);
   return new IFileMergeEntry(reader);
 }
 
-Merger::Merger(IFileWriter * writer, Config * config, ComparatorPtr comparator,
-    ICombineRunner * combineRunner)
-    : _writer(writer), _config(config), _combineRunner(combineRunner), _first(true),
-        _comparator(comparator) {
+IFileMergeEntry * IFileMergeEntry::create(SingleSpillInfo * spill, const char * data) {
+  return new IFileMergeEntry(new IFileReader(data, spill));
+}
+
+Merger::Merger(IFileWriter * writer, ComparatorPtr comparator, ICombineRunner * combineRunner)
+    : _tree(MergeEntryComparator(comparator)), _writer(writer), _combineRunner(combineRunner),
+        _first(true) {
 }
 
 Merger::~Merger() {
-  _heap.clear();
+  _tree.clear();
   for (size_t i = 0; i < _entries.size(); i++) {
     delete _entries[i];
   }
@@ -63,7 +77,7 @@ bool Merger::startPartition() {
       THROW_EXCEPTION(IOException, "MergeEntry partition number not equal");
     }
   }
-  if (firstPartitionState) { // do have new partition
+  if (firstPartitionState && NULL != _writer) { // do have new partition
     _writer->startPartition();
   }
   return firstPartitionState;
@@ -76,74 +90,69 @@ void Merger::endPartition() {
   _writer->endPartition();
 }
 
-void Merger::initHeap() {
-  _heap.clear();
+void Merger::initTree() {
+  vector<MergeEntryPtr> sources;
   for (size_t i = 0; i < _entries.size(); i++) {
     MergeEntryPtr pme = _entries[i];
     if (pme->next()) {
-      _heap.push_back(pme);
+      sources.push_back(pme);
     }
   }
-  makeHeap(&(_heap[0]), &(_heap[0]) + _heap.size(), _comparator);
+  _tree.init(sources);
 }
 
 bool Merger::next() {
-  size_t cur_heap_size = _heap.size();
-  if (cur_heap_size > 0) {
-    if (!_first) {
-      if (_heap[0]->next()) { // have more, adjust heap
-        if (cur_heap_size == 1) {
-          return true;
-        } else if (cur_heap_size == 2) {
-          MergeEntryPtr * base = &(_heap[0]);
-
-          if (_comparator(base[1], base[0])) {
-            std::swap(base[0], base[1]);
-          }
-        } else {
-          MergeEntryPtr * base = &(_heap[0]);
-          heapify(base, 1, cur_heap_size, _comparator);
-        }
-      } else { // no more, pop heap
-        MergeEntryPtr * base = &(_heap[0]);
-        popHeap(base, base + cur_heap_size, _comparator);
-        _heap.pop_back();
-      }
+  if (_tree.empty()) {
+    return false;
+  }
+  if (!_first) {
+    if (_tree.top()->next()) {
+      _tree.adjust();
     } else {
-      _first = false;
+      _tree.pop();
     }
-    return _heap.size() > 0;
+  } else {
+    _first = false;
   }
-  return false;
+  return !_tree.empty();
 }
 
 bool Merger::next(Buffer & key, Buffer & value) {
   bool result = next();
   if (result) {
-    MergeEntryPtr * base = &(_heap[0]);
-    key.reset(base[0]->getKey(), base[0]->getKeyLength());
-    value.reset(base[0]->getValue(), base[0]->getValueLength());
+    MergeEntryPtr top = _tree.top();
+    key.reset(top->getKey(), top->getKeyLength());
+    value.reset(top->getValue(), top->getValueLength());
     return true;
   } else {
     return false;
   }
 }
 
+bool Merger::iteratePartition() {
+  if (!startPartition()) {
+    return false;
+  }
+  initTree();
+  _first = true;
+  return true;
+}
+
 void Merger::merge() {
+  PhaseTimer timer(MERGE_PHASE);
   uint64_t total_record = 0;
-  _heap.reserve(_entries.size());
-  MergeEntryPtr * base = &(_heap[0]);
   while (startPartition()) {
-    initHeap();
-    if (_heap.size() == 0) {
+    initTree();
+    if (_tree.empty()) {
       endPartition();
       continue;
     }
     _first = true;
     if (_combineRunner == NULL) {
       while (next()) {
-        _writer->write(base[0]->getKey(), base[0]->getKeyLength(), base[0]->getValue(),
-            base[0]->getValueLength());
+        MergeEntryPtr top = _tree.top();
+        _writer->write(top->getKey(), top->getKeyLength(), top->getValue(),
+            top->getValueLength());
         total_record++;
       }
     } else {
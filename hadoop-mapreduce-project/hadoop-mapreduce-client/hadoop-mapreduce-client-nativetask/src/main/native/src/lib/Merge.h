@@ -23,7 +23,9 @@
 #include "lib/Buffers.h"
 #include "lib/MapOutputCollector.h"
 #include "lib/IFile.h"
-#include "lib/MinHeap.h"
+#include "lib/FileSystem.h"
+#include "lib/LoserTree.h"
+#include "lib/PartitionBucketIterator.h"
 
 namespace NativeTask {
 
@@ -109,9 +111,7 @@ protected:
   uint32_t _number;
   int64_t _index;
 
-  KVIterator * _iterator;
-  Buffer keyBuffer;
-  Buffer valueBuffer;
+  PartitionBucketIterator * _iterator;
 
 public:
   MemoryMergeEntry(PartitionBucket ** partitions, uint32_t numberOfPartitions)
@@ -150,14 +150,14 @@ public:
     if (NULL == _iterator) {
       return false;
     }
-    bool hasNext = _iterator->next(keyBuffer, valueBuffer);
-
-    if (hasNext) {
-      _keyLength = keyBuffer.length();
-      _key = keyBuffer.data();
-      _valueLength = valueBuffer.length();
-      _value = valueBuffer.data();
-      assert(_value != NULL);
+    // key and value point straight into the memory pool
+    MemBlockIterator * record = _iterator->nextRecord();
+
+    if (NULL != record) {
+      _keyLength = record->getKeyLength();
+      _key = record->getKey();
+      _valueLength = record->getValueLength();
+      _value = record->getValue();
       return true;
     }
     // detect error early
@@ -181,7 +181,21 @@ public:
    * @param reader: managed by InterFileMergeEntry
    */
 
-  static IFileMergeEntry * create(SingleSpillInfo * spill);
+  /**
+   * @param readAhead: bytes to read ahead of the merge in the spill file
+   * @param mapped: read the spill through a memory mapping
+   * @param fs: file system of the spill, read-ahead and mappings are
+   *            only used for local files
+   */
+  static IFileMergeEntry * create(SingleSpillInfo * spill, uint32_t readAhead = 0,
+      bool mapped = false, FileSystem & fs = FileSystem::getLocal());
+
+  /**
+   * merge a segment held in memory, like a shuffled map output, the
+   * records are read in place unless the segment is compressed
+   * @param data: the whole spill, valid until the entry is deleted
+   */
+  static IFileMergeEntry * create(SingleSpillInfo * spill, const char * data);
 
   IFileMergeEntry(IFileReader * reader)
       : _reader(reader) {
@@ -224,16 +238,13 @@ class Merger : public KVIterator {
 
 private:
   vector<MergeEntryPtr> _entries;
-  vector<MergeEntryPtr> _heap;
+  LoserTree<MergeEntryPtr, MergeEntryComparator> _tree;
   IFileWriter * _writer;
-  Config * _config;
   ICombineRunner * _combineRunner;
   bool _first;
-  MergeEntryComparator _comparator;
 
 public:
-  Merger(IFileWriter * writer, Config * config, ComparatorPtr comparator,
-      ICombineRunner * combineRunner = NULL);
+  Merger(IFileWriter * writer, ComparatorPtr comparator, ICombineRunner * combineRunner = NULL);
 
   ~Merger();
 
@@ -241,11 +252,18 @@ public:
 
   void merge();
 
+  /**
+   * position on the next partition so its records are read with
+   * next(key, value) instead of merge(), no writer is needed for this
+   * @return false if there are no more partitions
+   */
+  bool iteratePartition();
+
   virtual bool next(Buffer & key, Buffer & value);
 protected:
   bool startPartition();
   void endPartition();
-  void initHeap();
+  void initTree();
   bool next();
 };
 
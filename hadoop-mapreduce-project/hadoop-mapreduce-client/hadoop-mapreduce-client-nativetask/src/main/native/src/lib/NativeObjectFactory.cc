@@ -23,8 +23,10 @@
 #include "lib/commons.h"
 #include "NativeTask.h"
 #include "lib/NativeObjectFactory.h"
+#include "lib/KeyComparators.h"
 #include "lib/NativeLibrary.h"
 #include "lib/BufferStream.h"
+#include "lib/TaskCounters.h"
 #include "util/StringUtil.h"
 #include "util/SyncUtils.h"
 #include "util/WritableUtils.h"
@@ -88,9 +90,13 @@ bool NativeObjectFactory::Init() {
     } else {
       LOG_DEVICE = fopen(device.c_str(), "w");
     }
+    if (GetConfig().getBool(NATIVE_LOG_ASYNC, false)) {
+      AsyncLog::start();
+    }
     NativeTaskInit();
     NativeLibrary * library = new NativeLibrary("libnativetask.so", "NativeTask");
     library->_getObjectCreatorFunc = NativeTaskGetObjectCreator;
+    library->_functionGetter = NativeTaskGetFunctionGetter;
     Libraries.push_back(library);
     Inited = true;
     // load extra user provided libraries
@@ -139,6 +145,7 @@ void NativeObjectFactory::Release() {
     delete Counters[i];
   }
   Counters.clear();
+  AsyncLog::stop();
   if (LOG_DEVICE != stdout && LOG_DEVICE != stderr) {
     fclose(LOG_DEVICE);
     LOG_DEVICE = stderr;
@@ -190,6 +197,8 @@ void NativeObjectFactory::GetTaskStatusUpdate(string & statusData) {
   WritableUtils::WriteFloat(&os, progress);
   WritableUtils::WriteText(&os, LastStatus);
   LastStatus.clear();
+  // outside of CountersLock, which GetCounter takes
+  NativeMemoryMetrics::update();
   {
     ScopeLock<Lock> AutoLock(CountersLock);
     uint32_t numCounter = (uint32_t)Counters.size();
@@ -297,122 +306,54 @@ NativeObject * NativeObjectFactory::CreateDefaultObject(NativeObjectType type) {
 
 int NativeObjectFactory::BytesComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-
-  uint32_t minlen = std::min(srcLength, destLength);
-  int64_t ret = fmemcmp(src, dest, minlen);
-  if (ret > 0) {
-    return 1;
-  } else if (ret < 0) {
-    return -1;
-  }
-  return srcLength - destLength;
+  return BytesKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::ByteComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  return (*src) - (*dest);
+  return ByteKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::IntComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  int result = (*src) - (*dest);
-  if (result == 0) {
-    uint32_t from = bswap(*(uint32_t*)src);
-    uint32_t to = bswap(*(uint32_t*)dest);
-    if (from > to) {
-      return 1;
-    } else if (from == to) {
-      return 0;
-    } else {
-      return -1;
-    }
-  }
-  return result;
+  return IntKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::LongComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  int result = (int)(*src) - (int)(*dest);
-  if (result == 0) {
-
-    uint64_t from = bswap64(*(uint64_t*)src);
-    uint64_t to = bswap64(*(uint64_t*)dest);
-    if (from > to) {
-      return 1;
-    } else if (from == to) {
-      return 0;
-    } else {
-      return -1;
-    }
-  }
-  return result;
+  return LongKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::VIntComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  int32_t from = WritableUtils::ReadVInt(src, srcLength);
-  int32_t to = WritableUtils::ReadVInt(dest, destLength);
-  if (from > to) {
-    return 1;
-  } else if (from == to) {
-    return 0;
-  } else {
-    return -1;
-  }
+  return VIntKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::VLongComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  int64_t from = WritableUtils::ReadVLong(src, srcLength);
-  int64_t to = WritableUtils::ReadVLong(dest, destLength);
-  if (from > to) {
-    return 1;
-  } else if (from == to) {
-    return 0;
-  } else {
-    return -1;
-  }
+  return VLongKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::FloatComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  if (srcLength != 4 || destLength != 4) {
-    THROW_EXCEPTION_EX(IOException, "float comparator, while src/dest lengt is not 4");
-  }
-
-  uint32_t from = bswap(*(uint32_t*)src);
-  uint32_t to = bswap(*(uint32_t*)dest);
-
-  float * srcValue = (float *)(&from);
-  float * destValue = (float *)(&to);
-
-  if ((*srcValue) < (*destValue)) {
-    return -1;
-  } else if ((*srcValue) == (*destValue)) {
-    return 0;
-  } else {
-    return 1;
-  }
+  return FloatKeyComparator()(src, srcLength, dest, destLength);
 }
 
 int NativeObjectFactory::DoubleComparator(const char * src, uint32_t srcLength, const char * dest,
     uint32_t destLength) {
-  if (srcLength != 8 || destLength != 8) {
-    THROW_EXCEPTION_EX(IOException, "double comparator, while src/dest lengt is not 4");
-  }
-
-  uint64_t from = bswap64(*(uint64_t*)src);
-  uint64_t to = bswap64(*(uint64_t*)dest);
+  return DoubleKeyComparator()(src, srcLength, dest, destLength);
+}
 
-  double * srcValue = (double *)(&from);
-  double * destValue = (double *)(&to);
-  if ((*srcValue) < (*destValue)) {
-    return -1;
-  } else if ((*srcValue) == (*destValue)) {
-    return 0;
-  } else {
+int NativeObjectFactory::HashGroupComparator(const char * src, uint32_t srcLength,
+    const char * dest, uint32_t destLength) {
+  uint64_t from = fhash64(src, srcLength);
+  uint64_t to = fhash64(dest, destLength);
+  if (from > to) {
     return 1;
+  } else if (from < to) {
+    return -1;
   }
+  return BytesComparator(src, srcLength, dest, destLength);
 }
 
 ComparatorPtr get_comparator(const KeyValueType keyType, const char * comparatorName) {
@@ -440,5 +381,13 @@ ComparatorPtr get_comparator(const KeyValueType keyType, const char * comparator
   }
   return NULL;
 }
+
+KeyNormalizerPtr get_key_normalizer(const char * comparatorName) {
+  if (NULL == comparatorName) {
+    return NULL;
+  }
+  void * func = NativeObjectFactory::GetFunction(string(comparatorName) + "Normalizer");
+  return (KeyNormalizerPtr)func;
+}
 } // namespace NativeTask
 
@@ -99,6 +99,12 @@ public:
       uint32_t destLength);
   static int DoubleComparator(const char * src, uint32_t srcLength, const char * dest,
       uint32_t destLength);
+  /**
+   * orders keys by fhash64 first, and by bytes only if the hashes are
+   * equal, so equal keys are grouped together, used for GROUPBY
+   */
+  static int HashGroupComparator(const char * src, uint32_t srcLength, const char * dest,
+      uint32_t destLength);
 };
 
 } // namespace NativeTask
@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/Timer.h"
+#include "lib/NativeReduceCollector.h"
+#include "lib/MapOutputCollector.h"
+#include "lib/Merge.h"
+#include "lib/Iterator.h"
+#include "lib/FileSystem.h"
+#include "lib/Compressions.h"
+#include "lib/TaskCounters.h"
+
+namespace NativeTask {
+
+NativeReduceCollector::NativeReduceCollector()
+    : _keyComparator(NULL), _combineRunner(NULL), _readAhead(0), _mappedMerge(false),
+        _merger(NULL), _keyGroups(NULL) {
+}
+
+NativeReduceCollector::~NativeReduceCollector() {
+  close();
+  delete _combineRunner;
+  _combineRunner = NULL;
+}
+
+void NativeReduceCollector::configure(Config * config, SpillOutputService * service) {
+  MapOutputSpec::getSpecFromConfig(config, _spec);
+  if (_spec.codec.length() > 0) {
+    Compressions::configure(config);
+  }
+
+  KeyNormalizerPtr normalizer = NULL;
+  _keyComparator = MapOutputCollector::getComparator(config, _spec, normalizer);
+
+  if (NULL != config->get(NATIVE_COMBINER)
+      || NULL != config->get(MAPRED_COMBINE_CLASS_OLD)
+      || NULL != config->get(MAPRED_COMBINE_CLASS_NEW)) {
+    _combineRunner = new CombineRunnerWrapper(config, service, _spec);
+  }
+
+  if (config->getBool(MAPRED_IFILE_READAHEAD, true)) {
+    int64_t readAhead = config->getInt(MAPRED_IFILE_READAHEAD_BYTES, 4 * 1024 * 1024);
+    _readAhead = readAhead < 0 ? 0 : (uint32_t)readAhead;
+  }
+  _mappedMerge = config->getBool(NATIVE_MERGE_MMAP, true);
+}
+
+void NativeReduceCollector::addSegment(SingleSpillInfo * info, const char * data) {
+  if (NULL != _merger) {
+    THROW_EXCEPTION(IOException, "can not add segments after the final merge started");
+  }
+  ReduceSegment segment;
+  segment.info = info;
+  segment.data = data;
+  _segments.push_back(segment);
+}
+
+void NativeReduceCollector::addMemorySegment(const char * data, uint32_t length) {
+  IFileSegment * segment = new IFileSegment[1];
+  segment->uncompressedEndOffset = length;
+  segment->realEndOffset = length;
+  addSegment(new SingleSpillInfo(segment, 1, "", _spec.checksumType, _spec.keyType,
+      _spec.valueType, _spec.codec), data);
+}
+
+void NativeReduceCollector::addDiskSegment(const string & path) {
+  uint64_t length = FileSystem::getLocal().getLength(path);
+  IFileSegment * segment = new IFileSegment[1];
+  segment->uncompressedEndOffset = length;
+  segment->realEndOffset = length;
+  addSegment(new SingleSpillInfo(segment, 1, path, _spec.checksumType, _spec.keyType,
+      _spec.valueType, _spec.codec), NULL);
+}
+
+uint32_t NativeReduceCollector::getMemorySegmentCount() {
+  uint32_t count = 0;
+  for (size_t i = 0; i < _segments.size(); i++) {
+    if (NULL != _segments[i].data) {
+      count++;
+    }
+  }
+  return count;
+}
+
+Merger * NativeReduceCollector::createMerger(IFileWriter * writer, ICombineRunner * combiner,
+    bool memoryOnly) {
+  Merger * merger = new Merger(writer, _keyComparator, combiner);
+  for (size_t i = 0; i < _segments.size(); i++) {
+    ReduceSegment & segment = _segments[i];
+    if (NULL != segment.data) {
+      merger->addMergeEntry(IFileMergeEntry::create(segment.info, segment.data));
+    } else if (!memoryOnly) {
+      merger->addMergeEntry(IFileMergeEntry::create(segment.info, _readAhead, _mappedMerge));
+    }
+  }
+  return merger;
+}
+
+void NativeReduceCollector::mergeMemoryToDisk(const string & path) {
+  if (NULL != _merger) {
+    THROW_EXCEPTION(IOException, "can not merge segments after the final merge started");
+  }
+  uint32_t memorySegments = getMemorySegmentCount();
+  if (0 == memorySegments) {
+    return;
+  }
+
+  Timer timer;
+  IFileWriter * writer = IFileWriter::create(path, _spec, NULL);
+  Merger * merger = createMerger(writer, _combineRunner, true);
+  merger->merge();
+  delete merger;
+
+  uint64_t outputSize;
+  uint64_t realOutputSize;
+  uint64_t recordCount;
+  writer->getStatistics(outputSize, realOutputSize, recordCount);
+  SingleSpillInfo * info = writer->getSpillInfo();
+  info->path = path;
+  delete writer;
+
+  std::vector<ReduceSegment> remaining;
+  for (size_t i = 0; i < _segments.size(); i++) {
+    if (NULL != _segments[i].data) {
+      delete _segments[i].info;
+    } else {
+      remaining.push_back(_segments[i]);
+    }
+  }
+  _segments.swap(remaining);
+  addSegment(info, NULL);
+
+  LOG("Reduce-memory-merge: { segments: %u, records: %"PRIu64", "
+      "uncompressed size: %"PRIu64", real size: %"PRIu64", time: %"PRIu64" ms, path: %s }",
+      memorySegments, recordCount, outputSize, realOutputSize, timer.now() / 1000000,
+      path.c_str());
+}
+
+KVIterator * NativeReduceCollector::merge() {
+  if (NULL == _merger) {
+    _merger = createMerger(NULL, NULL, false);
+    if (!_merger->iteratePartition()) {
+      THROW_EXCEPTION(IOException, "reduce segments have no partition");
+    }
+  }
+  return _merger;
+}
+
+KeyGroupIterator * NativeReduceCollector::mergeKeyGroups() {
+  if (NULL == _keyGroups) {
+    _spec.grouping.check();
+    _keyGroups = new KeyGroupIteratorImpl(merge(), &_spec.grouping);
+  }
+  return _keyGroups;
+}
+
+void NativeReduceCollector::close() {
+  delete _keyGroups;
+  _keyGroups = NULL;
+  delete _merger;
+  _merger = NULL;
+  for (size_t i = 0; i < _segments.size(); i++) {
+    delete _segments[i].info;
+  }
+  _segments.clear();
+}
+
+} // namespace NativeTask
@@ -0,0 +1,120 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_REDUCE_COLLECTOR_H_
+#define NATIVE_REDUCE_COLLECTOR_H_
+
+#include "NativeTask.h"
+#include "lib/MapOutputSpec.h"
+#include "lib/SpillInfo.h"
+#include "lib/Combiner.h"
+#include "lib/SpillOutputService.h"
+
+namespace NativeTask {
+
+class Merger;
+class KeyGroupIteratorImpl;
+
+/**
+ * Reduce side merge of the fetched map outputs. Every segment is the
+ * IFile partition of one map (or of an earlier merge), held in memory or
+ * in a local file. In-memory segments can be merged to disk with the
+ * combiner, like the java InMemoryMerger, and the final merge over all
+ * segments is read as a KVIterator or as key groups.
+ */
+class NativeReduceCollector {
+private:
+  struct ReduceSegment {
+    SingleSpillInfo * info;
+    // in-memory segment, owned by the caller, NULL for files
+    const char * data;
+  };
+
+  MapOutputSpec _spec;
+  ComparatorPtr _keyComparator;
+  ICombineRunner * _combineRunner;
+  uint32_t _readAhead;
+  bool _mappedMerge;
+
+  std::vector<ReduceSegment> _segments;
+  Merger * _merger;
+  KeyGroupIteratorImpl * _keyGroups;
+
+public:
+  NativeReduceCollector();
+
+  ~NativeReduceCollector();
+
+  /**
+   * @param service provides the java combiner if the job has one, may be
+   *        NULL for native combiners only
+   */
+  void configure(Config * config, SpillOutputService * service = NULL);
+
+  /**
+   * add a segment fetched into memory, data must stay valid until the
+   * segment is merged to disk or the collector is closed
+   */
+  void addMemorySegment(const char * data, uint32_t length);
+
+  /**
+   * add a segment that spans the whole local file at path
+   */
+  void addDiskSegment(const string & path);
+
+  uint32_t getSegmentCount() {
+    return _segments.size();
+  }
+
+  uint32_t getMemorySegmentCount();
+
+  /**
+   * merge all in-memory segments, through the combiner if there is one,
+   * into an IFile at path, which replaces them as a disk segment
+   */
+  void mergeMemoryToDisk(const string & path);
+
+  /**
+   * start the final merge of all the segments, the records are read from
+   * the returned iterator which is owned by the collector
+   */
+  KVIterator * merge();
+
+  /**
+   * the final merge grouped by key, or by the grouping comparator of the
+   * job, owned by the collector
+   * @throws UnsupportException if the grouping comparator has no native
+   *         counterpart
+   */
+  KeyGroupIterator * mergeKeyGroups();
+
+  /**
+   * release the final merge and forget all segments, files are not
+   * deleted
+   */
+  void close();
+
+private:
+  void addSegment(SingleSpillInfo * info, const char * data);
+
+  Merger * createMerger(IFileWriter * writer, ICombineRunner * combiner, bool memoryOnly);
+};
+
+} // namespace NativeTask
+
+#endif /* NATIVE_REDUCE_COLLECTOR_H_ */
@@ -208,4 +208,15 @@ Counter * ProcessorBase::getCounter(const string & group, const string & name) {
 
 ///////////////////////////////////////////////////////////
 
+__thread uint32_t Counter::ThreadShard = 0;
+uint32_t Counter::NextShard = 0;
+
+uint32_t Counter::assignShard() {
+  // round robin, so the first COUNTER_SHARDS threads get a shard each
+  ThreadShard = __sync_fetch_and_add(&NextShard, 1) % COUNTER_SHARDS + 1;
+  return ThreadShard;
+}
+
+///////////////////////////////////////////////////////////
+
 } // namespace NativeTask
@@ -27,12 +27,11 @@
 #include "util/DualPivotQuickSort.h"
 #include "lib/Combiner.h"
 #include "lib/TaskCounters.h"
-#include "lib/MinHeap.h"
 #include "lib/PartitionBucketIterator.h"
 
 namespace NativeTask {
 
-KVIterator * PartitionBucket::getIterator() {
+PartitionBucketIterator * PartitionBucket::getIterator() {
   if (_memBlocks.size() == 0) {
     return NULL;
   }
@@ -41,17 +40,17 @@ KVIterator * PartitionBucket::getIterator() {
 
 void PartitionBucket::spill(IFileWriter * writer)
   throw(IOException, UnsupportException) {
-  KVIterator * iterator = getIterator();
+  PartitionBucketIterator * iterator = getIterator();
   if (NULL == iterator || NULL == writer) {
     return;
   }
 
   if (_combineRunner == NULL) {
-    Buffer key;
-    Buffer value;
-
-    while (iterator->next(key, value)) {
-      writer->write(key.data(), key.length(), value.data(), value.length());
+    // the records stay in the memory blocks until the spill is done
+    MemBlockIterator * record;
+    while (NULL != (record = iterator->nextRecord())) {
+      writer->writeInPlace(record->getKey(), record->getKeyLength(), record->getValue(),
+          record->getValueLength());
     }
   } else {
     _combineRunner->combine(CombineContext(UNKNOWN), iterator, writer);
@@ -64,12 +63,18 @@ void PartitionBucket::sort(SortAlgorithm type) {
     return;
   }
   if ((!_sorted)) {
+    PhaseTimer timer(SORT_PHASE);
     for (uint32_t i = 0; i < _memBlocks.size(); i++) {
       MemoryBlock * block = _memBlocks[i];
-      block->sort(type, _keyComparator);
+      block->sort(type, _keyComparator, _keyNormalizer);
     }
   }
   _sorted = true;
 }
 
+void PartitionBucket::sortBlock(uint32_t index, SortAlgorithm type) {
+  PhaseTimer timer(SORT_PHASE);
+  _memBlocks[index]->sort(type, _keyComparator, _keyNormalizer);
+}
+
 } // namespace NativeTask
@@ -31,6 +31,8 @@
 
 namespace NativeTask {
 
+class PartitionBucketIterator;
+
 /**
  * Buffer for a single partition
  */
@@ -42,16 +44,27 @@ private:
   std::vector<MemoryBlock *> _memBlocks;
   MemoryPool * _pool;
   uint32_t _partition;
+  // current block size, doubled up to _maxBlockSize while the bucket
+  // keeps asking for new blocks
   uint32_t _blockSize;
+  uint32_t _initialBlockSize;
+  uint32_t _maxBlockSize;
   ComparatorPtr _keyComparator;
+  KeyNormalizerPtr _keyNormalizer;
   ICombineRunner * _combineRunner;
   bool _sorted;
+  // small records of a full block get a compact header, see
+  // MemoryBlock::compact
+  bool _compactBlocks;
 
 public:
   PartitionBucket(MemoryPool * pool, uint32_t partition, ComparatorPtr comparator,
-      ICombineRunner * combineRunner, uint32_t blockSize)
-      : _pool(pool), _partition(partition), _blockSize(blockSize),
-          _keyComparator(comparator), _combineRunner(combineRunner),  _sorted(false) {
+      ICombineRunner * combineRunner, uint32_t blockSize, uint32_t maxBlockSize = 0,
+      KeyNormalizerPtr normalizer = NULL, bool compactBlocks = false)
+      : _pool(pool), _partition(partition), _blockSize(blockSize), _initialBlockSize(blockSize),
+          _maxBlockSize(std::max(blockSize, maxBlockSize)), _keyComparator(comparator),
+          _keyNormalizer(normalizer), _combineRunner(combineRunner),  _sorted(false),
+          _compactBlocks(compactBlocks) {
     if (NULL == _pool || NULL == comparator) {
       THROW_EXCEPTION_EX(IOException, "pool is NULL, or comparator is not set");
     }
@@ -70,6 +83,10 @@ public:
   }
 
   void reset() {
+    // a bucket that fitted in one block since the last reset is cooling down
+    if (_memBlocks.size() <= 1 && _blockSize > _initialBlockSize) {
+      _blockSize = std::max(_initialBlockSize, _blockSize / 2);
+    }
     for (uint32_t i = 0; i < _memBlocks.size(); i++) {
       if (NULL != _memBlocks[i]) {
         delete _memBlocks[i];
@@ -79,7 +96,22 @@ public:
     _memBlocks.clear();
   }
 
-  KVIterator * getIterator();
+  /**
+   * NULL if the bucket is empty
+   */
+  PartitionBucketIterator * getIterator();
+
+  /**
+   * hand over all memory blocks to dest, which must be empty
+   */
+  void moveBlocksTo(PartitionBucket * dest) {
+    if (dest->_memBlocks.size() > 0) {
+      THROW_EXCEPTION(IOException, "destination PartitionBucket is not empty");
+    }
+    dest->_memBlocks.swap(_memBlocks);
+    dest->_sorted = false;
+    _sorted = false;
+  }
 
   uint32_t getKVCount() const {
     uint32_t size = 0;
@@ -106,15 +138,20 @@ public:
     if (memBlockSize > 0) {
       memBlock = _memBlocks[memBlockSize - 1];
     }
-    if (NULL != memBlock && memBlock->remainSpace() >= kvLength) {
+    if (NULL != memBlock
+        && (memBlock->remainSpace() >= kvLength || memBlock->compact(kvLength))) {
       return memBlock->allocateKVBuffer(kvLength);
     } else {
+      if (NULL != memBlock && _blockSize < _maxBlockSize) {
+        // refilled, hot partitions get larger blocks so cold ones waste less
+        _blockSize = std::min(_maxBlockSize, _blockSize * 2);
+      }
       uint32_t min = kvLength;
       uint32_t expect = std::max(_blockSize, min);
       uint32_t allocated = 0;
       char * buff = _pool->allocate(min, expect, allocated);
       if (NULL != buff) {
-        memBlock = new MemoryBlock(buff, allocated);
+        memBlock = new MemoryBlock(buff, allocated, _compactBlocks);
         _memBlocks.push_back(memBlock);
         return memBlock->allocateKVBuffer(kvLength);
       }
@@ -122,10 +159,37 @@ public:
     return NULL;
   }
 
+  /**
+   * allocate from the current memory block only, return NULL if it has
+   * no room left, the memory pool is never touched
+   */
+  KVBuffer * allocateKVBufferInBlock(uint32_t kvLength) {
+    uint32_t memBlockSize = _memBlocks.size();
+    if (memBlockSize == 0) {
+      return NULL;
+    }
+    MemoryBlock * memBlock = _memBlocks[memBlockSize - 1];
+    if (memBlock->remainSpace() < kvLength) {
+      return NULL;
+    }
+    _sorted = false;
+    return memBlock->allocateKVBuffer(kvLength);
+  }
+
   void sort(SortAlgorithm type);
 
+  /**
+   * sort one memory block, blocks may be sorted concurrently by different
+   * threads, sort() then only marks the bucket sorted
+   */
+  void sortBlock(uint32_t index, SortAlgorithm type);
+
   void spill(IFileWriter * writer) throw (IOException, UnsupportException);
 
+  uint32_t getBlockSize() const {
+    return _blockSize;
+  }
+
   uint32_t getMemoryBlockCount() const {
     return _memBlocks.size();
   }
@@ -29,7 +29,6 @@
 #include "util/DualPivotQuickSort.h"
 #include "lib/Combiner.h"
 #include "lib/TaskCounters.h"
-#include "lib/MinHeap.h"
 
 namespace NativeTask {
 
@@ -38,74 +37,50 @@ namespace NativeTask {
 /////////////////////////////////////////////////////////////////
 
 PartitionBucketIterator::PartitionBucketIterator(PartitionBucket * pb, ComparatorPtr comparator)
-    : _pb(pb), _comparator(comparator), _first(true) {
+    : _pb(pb), _tree(MemBlockComparator(comparator)), _first(true) {
+  std::vector<MemBlockIteratorPtr> iterators;
   uint32_t blockCount = _pb->getMemoryBlockCount();
   for (uint32_t i = 0; i < blockCount; i++) {
     MemoryBlock * block = _pb->getMemoryBlock(i);
     MemBlockIteratorPtr blockIterator = new MemBlockIterator(block);
     if (blockIterator->next()) {
-      _heap.push_back(blockIterator);
+      iterators.push_back(blockIterator);
     } else {
       delete blockIterator;
     }
   }
-  if (_heap.size() > 1) {
-    makeHeap(&(_heap[0]), &(_heap[0]) + _heap.size(), _comparator);
-  }
+  _tree.init(iterators);
 }
 
 PartitionBucketIterator::~PartitionBucketIterator() {
-  for (uint32_t i = 0; i < _heap.size(); i++) {
-    MemBlockIteratorPtr ptr = _heap[i];
-    if (NULL != ptr) {
-      delete ptr;
-      _heap[i] = NULL;
-    }
+  const std::vector<MemBlockIteratorPtr> & iterators = _tree.sources();
+  for (uint32_t i = 0; i < iterators.size(); i++) {
+    delete iterators[i];
   }
+  _tree.clear();
 }
 
 bool PartitionBucketIterator::next() {
-  size_t cur_heap_size = _heap.size();
-  if (cur_heap_size > 0) {
-    if (!_first) {
-      if (_heap[0]->next()) { // have more, adjust heap
-        if (cur_heap_size == 1) {
-          return true;
-        } else if (cur_heap_size == 2) {
-          MemBlockIteratorPtr * base = &(_heap[0]);
-
-          if (_comparator(base[1], base[0])) {
-            std::swap(base[0], base[1]);
-          }
-        } else {
-          MemBlockIteratorPtr * base = &(_heap[0]);
-          heapify(base, 1, cur_heap_size, _comparator);
-        }
-      } else { // no more, pop heap
-        // after popHeap, the first element of heap will be removed
-        // and replaced by other element, so it needs to be deleted
-        delete _heap[0];
-        MemBlockIteratorPtr * base = &(_heap[0]);
-        popHeap(base, base + cur_heap_size, _comparator);
-        _heap.pop_back();
-      }
+  if (_tree.empty()) {
+    return false;
+  }
+  if (!_first) {
+    if (_tree.top()->next()) {
+      _tree.adjust();
     } else {
-      _first = false;
+      _tree.pop();
     }
-    return _heap.size() > 0;
+  } else {
+    _first = false;
   }
-  return false;
+  return !_tree.empty();
 }
 
 bool PartitionBucketIterator::next(Buffer & key, Buffer & value) {
-  bool result = next();
-  if (result) {
-    MemBlockIteratorPtr * base = &(_heap[0]);
-    KVBuffer * kvBuffer = base[0]->getKVBuffer();
-
-    key.reset(kvBuffer->getKey(), kvBuffer->keyLength);
-    value.reset(kvBuffer->getValue(), kvBuffer->valueLength);
-
+  MemBlockIterator * record = nextRecord();
+  if (NULL != record) {
+    key.reset(record->getKey(), record->getKeyLength());
+    value.reset(record->getValue(), record->getValueLength());
     return true;
   }
   return false;
@@ -28,14 +28,14 @@
 #include "lib/SpillInfo.h"
 #include "lib/Combiner.h"
 #include "lib/PartitionBucket.h"
+#include "lib/LoserTree.h"
 
 namespace NativeTask {
 
 class PartitionBucketIterator : public KVIterator {
 protected:
   PartitionBucket * _pb;
-  std::vector<MemBlockIteratorPtr> _heap;
-  MemBlockComparator _comparator;
+  LoserTree<MemBlockIteratorPtr, MemBlockComparator> _tree;
   bool _first;
 
 public:
@@ -43,6 +43,16 @@ public:
   virtual ~PartitionBucketIterator();
   virtual bool next(Buffer & key, Buffer & value);
 
+  /**
+   * the next record where it is in the memory pool, NULL if no more
+   */
+  MemBlockIterator * nextRecord() {
+    if (next()) {
+      return _tree.top();
+    }
+    return NULL;
+  }
+
 private:
   bool next();
 };
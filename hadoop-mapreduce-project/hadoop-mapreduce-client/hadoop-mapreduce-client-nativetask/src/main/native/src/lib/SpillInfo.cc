@@ -16,6 +16,7 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include "lib/commons.h"
 #include "lib/Streams.h"
 #include "lib/FileSystem.h"
@@ -24,12 +25,9 @@
 
 namespace NativeTask {
 
-void SingleSpillInfo::deleteSpillFile() {
-  if (path.length() > 0) {
-    struct stat st;
-    if (0 == stat(path.c_str(), &st)) {
-      remove(path.c_str());
-    }
+void SingleSpillInfo::deleteSpillFile(FileSystem & fs) {
+  if (path.length() > 0 && fs.exists(path)) {
+    fs.remove(path);
   }
 }
 
@@ -69,5 +67,23 @@ void SingleSpillInfo::writeSpillInfo(const std::string & filepath) {
   delete fout;
 }
 
+bool SingleSpillInfo::publishSpillInfo(const std::string & filepath) {
+  std::string tmpPath = filepath + ".tmp";
+  try {
+    writeSpillInfo(tmpPath);
+  } catch (IOException & e) {
+    LOG("[SpillInfo] failed to write index %s: %s", tmpPath.c_str(), e.what());
+    ::remove(tmpPath.c_str());
+    return false;
+  }
+  if (0 != ::rename(tmpPath.c_str(), filepath.c_str())) {
+    LOG("[SpillInfo] failed to rename index %s to %s: %s", tmpPath.c_str(), filepath.c_str(),
+        strerror(errno));
+    ::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
 } // namespace NativeTask
 
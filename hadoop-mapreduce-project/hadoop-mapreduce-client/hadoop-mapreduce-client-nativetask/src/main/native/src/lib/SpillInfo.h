@@ -26,6 +26,8 @@ namespace NativeTask {
 
 using std::string;
 
+class FileSystem;
+
 /**
  * Store spill file segment information
  */
@@ -34,6 +36,8 @@ struct IFileSegment {
   uint64_t uncompressedEndOffset;
   // compressed stream end position
   uint64_t realEndOffset;
+  // XXHash64 of the segment stream, CHECKSUM_SEGMENT_HASH spills only
+  uint64_t hash;
 };
 
 class SingleSpillInfo {
@@ -45,18 +49,20 @@ public:
   KeyValueType keyType;
   KeyValueType valueType;
   std::string codec;
+  // keys are front coded, see IFileWriter::setPrefixKeys
+  bool prefixKeys;
 
   SingleSpillInfo(IFileSegment * segments, uint32_t len, const string & path, ChecksumType checksum,
       KeyValueType ktype, KeyValueType vtype, const string & inputCodec)
       : length(len), path(path), segments(segments), checkSumType(checksum), keyType(ktype),
-          valueType(vtype), codec(inputCodec) {
+          valueType(vtype), codec(inputCodec), prefixKeys(false) {
   }
 
   ~SingleSpillInfo() {
     delete[] segments;
   }
 
-  void deleteSpillFile();
+  void deleteSpillFile(FileSystem & fs);
 
   uint64_t getEndPosition() {
     return segments ? segments[length - 1].uncompressedEndOffset : 0;
@@ -67,6 +73,13 @@ public:
   }
 
   void writeSpillInfo(const std::string & filepath);
+
+  /**
+   * writeSpillInfo through a temporary file which is renamed to filepath,
+   * so readers never see a partial index
+   * @return false if the index could not be written
+   */
+  bool publishSpillInfo(const std::string & filepath);
 };
 
 class SpillInfos {
@@ -82,9 +95,9 @@ public:
     spills.clear();
   }
 
-  void deleteAllSpillFiles() {
+  void deleteAllSpillFiles(FileSystem & fs) {
     for (size_t i = 0; i < spills.size(); i++) {
-      spills[i]->deleteSpillFile();
+      spills[i]->deleteSpillFile(fs);
     }
   }
 
@@ -19,6 +19,7 @@
 #include "lib/commons.h"
 #include "util/Checksum.h"
 #include "lib/Streams.h"
+#include "lib/TaskCounters.h"
 
 namespace NativeTask {
 
@@ -46,6 +47,12 @@ int32_t InputStream::readFully(void * buff, uint32_t length) {
   return ret;
 }
 
+void OutputStream::writev(const struct iovec * iov, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    write(iov[i].iov_base, iov[i].iov_len);
+  }
+}
+
 void InputStream::readAllTo(OutputStream & out, uint32_t bufferHint) {
   char * buffer = new char[bufferHint];
   while (true) {
@@ -55,7 +62,7 @@ void InputStream::readAllTo(OutputStream & out, uint32_t bufferHint) {
     }
     out.write(buffer, rd);
   }
-  delete buffer;
+  delete [] buffer;
 }
 
 /////////////////////////////////////////////////////////////
@@ -73,6 +80,16 @@ ChecksumInputStream::ChecksumInputStream(InputStream * stream, ChecksumType type
 
 void ChecksumInputStream::resetChecksum() {
   _checksum = Checksum::init(_type);
+  _hash.reset();
+}
+
+void ChecksumInputStream::update(const void * buff, uint32_t length) {
+  PhaseTimer timer(CHECKSUM_PHASE);
+  if (_type == CHECKSUM_SEGMENT_HASH) {
+    _hash.update(buff, length);
+  } else {
+    Checksum::update(_type, _checksum, buff, length);
+  }
 }
 
 uint32_t ChecksumInputStream::getChecksum() {
@@ -83,7 +100,7 @@ int32_t ChecksumInputStream::read(void * buff, uint32_t length) {
   if (_limit < 0) {
     int32_t ret = _stream->read(buff, length);
     if (ret > 0) {
-      Checksum::update(_type, _checksum, buff, ret);
+      update(buff, ret);
     }
     return ret;
   } else if (_limit == 0) {
@@ -93,7 +110,7 @@ int32_t ChecksumInputStream::read(void * buff, uint32_t length) {
     int32_t ret = _stream->read(buff, rd);
     if (ret > 0) {
       _limit -= ret;
-      Checksum::update(_type, _checksum, buff, ret);
+      update(buff, ret);
     }
     return ret;
   }
@@ -108,6 +125,15 @@ ChecksumOutputStream::ChecksumOutputStream(OutputStream * stream, ChecksumType t
 
 void ChecksumOutputStream::resetChecksum() {
   _checksum = Checksum::init(_type);
+  _hash.reset();
+}
+
+void ChecksumOutputStream::update(const void * buff, uint32_t length) {
+  if (_type == CHECKSUM_SEGMENT_HASH) {
+    _hash.update(buff, length);
+  } else {
+    Checksum::update(_type, _checksum, buff, length);
+  }
 }
 
 uint32_t ChecksumOutputStream::getChecksum() {
@@ -115,8 +141,21 @@ uint32_t ChecksumOutputStream::getChecksum() {
 }
 
 void ChecksumOutputStream::write(const void * buff, uint32_t length) {
-  Checksum::update(_type, _checksum, buff, length);
+  {
+    PhaseTimer timer(CHECKSUM_PHASE);
+    update(buff, length);
+  }
   _stream->write(buff, length);
 }
 
+void ChecksumOutputStream::writev(const struct iovec * iov, uint32_t count) {
+  {
+    PhaseTimer timer(CHECKSUM_PHASE);
+    for (uint32_t i = 0; i < count; i++) {
+      update(iov[i].iov_base, iov[i].iov_len);
+    }
+  }
+  _stream->writev(iov, count);
+}
+
 } // namespace NativeTask
@@ -19,7 +19,9 @@
 #ifndef STREAMS_H_
 #define STREAMS_H_
 
+#include <sys/uio.h>
 #include "util/Checksum.h"
+#include "util/XXHash.h"
 
 namespace NativeTask {
 
@@ -62,6 +64,11 @@ public:
   virtual void write(const void * buff, uint32_t length) {
   }
 
+  /**
+   * write count buffers in order, the default writes them one by one
+   */
+  virtual void writev(const struct iovec * iov, uint32_t count);
+
   virtual void flush() {
   }
 
@@ -128,6 +135,10 @@ public:
     _stream->write(buff, length);
   }
 
+  virtual void writev(const struct iovec * iov, uint32_t count) {
+    _stream->writev(iov, count);
+  }
+
   virtual void flush() {
     _stream->flush();
   }
@@ -176,6 +187,8 @@ class ChecksumInputStream : public FilterInputStream {
 protected:
   ChecksumType _type;
   uint32_t _checksum;
+  // CHECKSUM_SEGMENT_HASH only
+  XXHash64 _hash;
   int64_t _limit;
 public:
   ChecksumInputStream(InputStream * stream, ChecksumType type);
@@ -195,13 +208,22 @@ public:
 
   uint32_t getChecksum();
 
+  uint64_t getSegmentHash() {
+    return _hash.digest();
+  }
+
   virtual int32_t read(void * buff, uint32_t length);
+
+private:
+  void update(const void * buff, uint32_t length);
 };
 
 class ChecksumOutputStream : public FilterOutputStream {
 protected:
   ChecksumType _type;
   uint32_t _checksum;
+  // CHECKSUM_SEGMENT_HASH only
+  XXHash64 _hash;
 public:
   ChecksumOutputStream(OutputStream * stream, ChecksumType type);
 
@@ -212,8 +234,17 @@ public:
 
   uint32_t getChecksum();
 
+  uint64_t getSegmentHash() {
+    return _hash.digest();
+  }
+
   virtual void write(const void * buff, uint32_t length);
 
+  virtual void writev(const struct iovec * iov, uint32_t count);
+
+private:
+  void update(const void * buff, uint32_t length);
+
 };
 
 } // namespace NativeTask
@@ -16,7 +16,15 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "lib/NativeObjectFactory.h"
 #include "lib/TaskCounters.h"
+#include "util/SyncUtils.h"
+#include "native_memory.h"
 
 namespace NativeTask {
 
@@ -37,4 +45,160 @@ const char * TaskCounters::FILESYSTEM_COUNTER_GROUP = "FileSystemCounters";
 DEFINE_COUNTER(FILE_BYTES_READ)
 DEFINE_COUNTER(FILE_BYTES_WRITTEN)
 
+const char * TaskCounters::NATIVETASK_COUNTER_GROUP = "NativeTaskCounters";
+
+DEFINE_COUNTER(MEMORY_POOL_MALLOC)
+DEFINE_COUNTER(MEMORY_POOL_MMAP)
+DEFINE_COUNTER(MEMORY_POOL_TRANSPARENT_HUGEPAGE)
+DEFINE_COUNTER(MEMORY_POOL_HUGETLB)
+DEFINE_COUNTER(MEMORY_POOL_NUMA_LOCAL)
+
+DEFINE_COUNTER(NATIVE_MEMORY_PEAK_BYTES)
+DEFINE_COUNTER(NATIVE_MEMORY_CODEC_PEAK_BYTES)
+DEFINE_COUNTER(NATIVE_MEMORY_SORT_PEAK_BYTES)
+DEFINE_COUNTER(NATIVE_MEMORY_BUFFERS_PEAK_BYTES)
+
+DEFINE_COUNTER(COMPRESS_STORED_BYTES)
+
+DEFINE_COUNTER(MAP_OUTPUT_RECORD_BYTES_P50)
+DEFINE_COUNTER(MAP_OUTPUT_RECORD_BYTES_P90)
+DEFINE_COUNTER(MAP_OUTPUT_RECORD_BYTES_P99)
+DEFINE_COUNTER(MAP_OUTPUT_PARTITION_SKEW_PERCENT)
+DEFINE_COUNTER(MAP_OUTPUT_EMPTY_PARTITIONS)
+
+DEFINE_COUNTER(COLLECT_MICROS)
+DEFINE_COUNTER(SORT_MICROS)
+DEFINE_COUNTER(SPILL_MICROS)
+DEFINE_COUNTER(COMPRESS_MICROS)
+DEFINE_COUNTER(CHECKSUM_MICROS)
+DEFINE_COUNTER(MERGE_MICROS)
+DEFINE_COUNTER(JNI_UPCALL_MICROS)
+
+Counter * TaskPhaseMetrics::Times[TASK_PHASE_COUNT] = {NULL};
+Counter * TaskPhaseMetrics::Histograms[TASK_PHASE_COUNT][HISTOGRAM_BUCKETS] = {{NULL}};
+
+void TaskPhaseMetrics::init(Config * config) {
+  const char * names[TASK_PHASE_COUNT] = {
+      TaskCounters::COLLECT_MICROS, TaskCounters::SORT_MICROS, TaskCounters::SPILL_MICROS,
+      TaskCounters::COMPRESS_MICROS, TaskCounters::CHECKSUM_MICROS, TaskCounters::MERGE_MICROS,
+      TaskCounters::JNI_UPCALL_MICROS};
+  const char * buckets[HISTOGRAM_BUCKETS] = {"_LE_100", "_LE_10000", "_LE_1000000",
+      "_GT_1000000"};
+  bool histogram = config->getBool(NATIVE_METRICS_HISTOGRAM, false);
+  for (uint32_t i = 0; i < TASK_PHASE_COUNT; i++) {
+    for (uint32_t j = 0; j < HISTOGRAM_BUCKETS; j++) {
+      Histograms[i][j] = histogram ? NativeObjectFactory::GetCounter(
+          TaskCounters::NATIVETASK_COUNTER_GROUP, string(names[i]) + buckets[j]) : NULL;
+    }
+    Times[i] = NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP, names[i]);
+  }
+  TaskTrace::init(config);
+}
+
+void NativeMemoryMetrics::update() {
+  const native_memory_subsystem subsystems[] = {NATIVE_MEMORY_SUBSYSTEMS, NATIVE_MEMORY_CODEC,
+      NATIVE_MEMORY_SORT, NATIVE_MEMORY_BUFFERS};
+  const char * names[] = {TaskCounters::NATIVE_MEMORY_PEAK_BYTES,
+      TaskCounters::NATIVE_MEMORY_CODEC_PEAK_BYTES, TaskCounters::NATIVE_MEMORY_SORT_PEAK_BYTES,
+      TaskCounters::NATIVE_MEMORY_BUFFERS_PEAK_BYTES};
+  for (size_t i = 0; i < sizeof(subsystems) / sizeof(subsystems[0]); i++) {
+    native_memory_stats stats;
+    get_native_memory_stats(subsystems[i], &stats);
+    Counter * counter = NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP,
+        names[i]);
+    // peaks never go down, so the counter only ever has to catch up
+    uint64_t counted = counter->get();
+    if ((uint64_t)stats.peak > counted) {
+      counter->increase((uint64_t)stats.peak - counted);
+    }
+  }
+}
+
+struct TraceEvent {
+  TaskPhase phase;
+  uint32_t tid;
+  uint64_t start;
+  uint64_t end;
+};
+
+// events past this are dropped, a collect event per input batch adds up
+static const uint32_t MAX_TRACE_EVENTS = 1 << 20;
+static const char * TracePhaseNames[TASK_PHASE_COUNT] = {"collect", "sort", "spill", "compress",
+    "checksum", "merge", "jni_upcall"};
+
+bool TaskTrace::Enabled = false;
+uint64_t TaskTrace::MinNanos = 0;
+static string TracePath;
+static Lock TraceLock;
+static vector<TraceEvent> TraceEvents;
+static uint64_t TraceDropped = 0;
+static __thread uint32_t TraceTid = 0;
+
+void TaskTrace::init(Config * config) {
+  ScopeLock<Lock> autoLock(TraceLock);
+  TraceEvents.clear();
+  TraceDropped = 0;
+  Enabled = config->getBool(NATIVE_TRACE, false);
+  if (!Enabled) {
+    return;
+  }
+  MinNanos = config->getInt(NATIVE_TRACE_MIN_MICROS, 50) * 1000;
+  TracePath = config->get(NATIVE_TRACE_FILE, "");
+  if (TracePath.empty()) {
+    const char * attempt = config->get(MAPRED_TASK_ATTEMPT_ID);
+    TracePath = string(NULL == attempt ? "task" : attempt) + ".nativetask.trace.json";
+    // the container log dirs, as YARN passes them to the task
+    const char * logDirs = getenv("LOG_DIRS");
+    if (NULL != logDirs && logDirs[0] != '\0') {
+      string dirs = logDirs;
+      TracePath = dirs.substr(0, dirs.find(',')) + "/" + TracePath;
+    }
+  }
+  LOG("[TaskTrace] tracing to %s", TracePath.c_str());
+}
+
+void TaskTrace::record(TaskPhase phase, uint64_t start, uint64_t end) {
+  if (0 == TraceTid) {
+    TraceTid = (uint32_t)syscall(SYS_gettid);
+  }
+  TraceEvent event;
+  event.phase = phase;
+  event.tid = TraceTid;
+  event.start = start;
+  event.end = end;
+  ScopeLock<Lock> autoLock(TraceLock);
+  if (TraceEvents.size() < MAX_TRACE_EVENTS) {
+    TraceEvents.push_back(event);
+  } else {
+    TraceDropped++;
+  }
+}
+
+void TaskTrace::write() {
+  ScopeLock<Lock> autoLock(TraceLock);
+  if (!Enabled) {
+    return;
+  }
+  FILE * file = fopen(TracePath.c_str(), "w");
+  if (NULL == file) {
+    LOG("[TaskTrace] can not open %s", TracePath.c_str());
+    return;
+  }
+  const uint32_t pid = getpid();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (size_t i = 0; i < TraceEvents.size(); i++) {
+    const TraceEvent & e = TraceEvents[i];
+    // microseconds, with the nanoseconds as fraction
+    fprintf(file,
+        "%s\n{\"name\":\"%s\",\"cat\":\"nativetask\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+        "\"ts\":%"PRIu64".%03u,\"dur\":%"PRIu64".%03u}",
+        i == 0 ? "" : ",", TracePhaseNames[e.phase], pid, e.tid, e.start / 1000,
+        (uint32_t)(e.start % 1000), (e.end - e.start) / 1000, (uint32_t)((e.end - e.start) % 1000));
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  LOG("[TaskTrace] %zu events written to %s, %"PRIu64" dropped", TraceEvents.size(),
+      TracePath.c_str(), TraceDropped);
+}
+
 } // namespace NativeTask
@@ -19,6 +19,9 @@
 #ifndef TASKCOUNTERS_H_
 #define TASKCOUNTERS_H_
 
+#include "NativeTask.h"
+#include "util/Timer.h"
+
 namespace NativeTask {
 
 class TaskCounters {
@@ -37,6 +40,154 @@ public:
 
   static const char * FILE_BYTES_READ;
   static const char * FILE_BYTES_WRITTEN;
+
+  static const char * NATIVETASK_COUNTER_GROUP;
+
+  static const char * MEMORY_POOL_MALLOC;
+  static const char * MEMORY_POOL_MMAP;
+  static const char * MEMORY_POOL_TRANSPARENT_HUGEPAGE;
+  static const char * MEMORY_POOL_HUGETLB;
+  static const char * MEMORY_POOL_NUMA_LOCAL;
+
+  static const char * NATIVE_MEMORY_PEAK_BYTES;
+  static const char * NATIVE_MEMORY_CODEC_PEAK_BYTES;
+  static const char * NATIVE_MEMORY_SORT_PEAK_BYTES;
+  static const char * NATIVE_MEMORY_BUFFERS_PEAK_BYTES;
+
+  // bytes of map output written as stored blocks, see BlockCompressStream
+  static const char * COMPRESS_STORED_BYTES;
+
+  // shape of the map output, see MapOutputCollector::reportOutputStatistics
+  static const char * MAP_OUTPUT_RECORD_BYTES_P50;
+  static const char * MAP_OUTPUT_RECORD_BYTES_P90;
+  static const char * MAP_OUTPUT_RECORD_BYTES_P99;
+  static const char * MAP_OUTPUT_PARTITION_SKEW_PERCENT;
+  static const char * MAP_OUTPUT_EMPTY_PARTITIONS;
+
+  static const char * COLLECT_MICROS;
+  static const char * SORT_MICROS;
+  static const char * SPILL_MICROS;
+  static const char * COMPRESS_MICROS;
+  static const char * CHECKSUM_MICROS;
+  static const char * MERGE_MICROS;
+  static const char * JNI_UPCALL_MICROS;
+};
+
+enum TaskPhase {
+  COLLECT_PHASE = 0,
+  SORT_PHASE = 1,
+  SPILL_PHASE = 2,
+  COMPRESS_PHASE = 3,
+  CHECKSUM_PHASE = 4,
+  MERGE_PHASE = 5,
+  JNI_UPCALL_PHASE = 6,
+  TASK_PHASE_COUNT = 7,
+};
+
+/**
+ * Time spent in the native hot paths, exported as NATIVETASK_COUNTER_GROUP
+ * counters in microseconds. Phases nest, e.g. the spill and merge times
+ * include the compression and checksum time of their output. With
+ * native.metrics.histogram the calls are also counted in buckets of
+ * their duration, SPILL_MICROS_LE_100, _LE_10000, _LE_1000000 and
+ * _GT_1000000. Nothing is recorded before init().
+ */
+class TaskPhaseMetrics {
+public:
+  static const uint32_t HISTOGRAM_BUCKETS = 4;
+
+private:
+  static Counter * Times[TASK_PHASE_COUNT];
+  static Counter * Histograms[TASK_PHASE_COUNT][HISTOGRAM_BUCKETS];
+
+public:
+  static void init(Config * config);
+
+  static void add(TaskPhase phase, uint64_t nanos) {
+    Counter * times = Times[phase];
+    if (NULL == times) {
+      return;
+    }
+    uint64_t micros = nanos / 1000;
+    times->increase(micros);
+    Counter ** histogram = Histograms[phase];
+    if (NULL != histogram[0]) {
+      uint32_t bucket = 0;
+      for (uint64_t limit = 100; bucket < HISTOGRAM_BUCKETS - 1 && micros > limit; limit *= 100) {
+        bucket++;
+      }
+      histogram[bucket]->increase();
+    }
+  }
+};
+
+/**
+ * The most memory libnativetask had allocated at once, as accounted by
+ * native_memory.h, exported as NATIVETASK_COUNTER_GROUP counters in bytes:
+ * NATIVE_MEMORY_PEAK_BYTES for everything together, and the codec state
+ * and buffers, the touched part of the sort buffer and the stream buffers
+ * on their own. The counters catch up with the peaks on every update(),
+ * which runs before each status update of the task.
+ */
+class NativeMemoryMetrics {
+public:
+  static void update();
+};
+
+/**
+ * Timeline of the phases of the task, enabled by native.trace and written
+ * as a chrome trace event JSON file, for chrome://tracing or perfetto, to
+ * native.trace.file. By default, that file is
+ * <attempt id>.nativetask.trace.json in the first of the container log
+ * dirs. Every phase that took at least native.trace.min.micros (default 50)
+ * is one event on the thread that ran it. Each init() starts a new
+ * timeline.
+ */
+class TaskTrace {
+private:
+  static bool Enabled;
+  static uint64_t MinNanos;
+
+public:
+  static void init(Config * config);
+
+  static bool enabled() {
+    return Enabled;
+  }
+
+  static void add(TaskPhase phase, uint64_t start, uint64_t end) {
+    if (Enabled && end - start >= MinNanos) {
+      record(phase, start, end);
+    }
+  }
+
+  /**
+   * (re)writes the file with every event recorded so far
+   */
+  static void write();
+
+private:
+  static void record(TaskPhase phase, uint64_t start, uint64_t end);
+};
+
+/**
+ * adds the lifetime of the scope to a phase
+ */
+class PhaseTimer {
+private:
+  TaskPhase _phase;
+  Timer _timer;
+
+public:
+  PhaseTimer(TaskPhase phase)
+      : _phase(phase) {
+  }
+
+  ~PhaseTimer() {
+    uint64_t end = _timer.now();
+    TaskPhaseMetrics::add(_phase, end - _timer.last());
+    TaskTrace::add(_phase, _timer.last(), end);
+  }
 };
 
 } // namespace NativeTask
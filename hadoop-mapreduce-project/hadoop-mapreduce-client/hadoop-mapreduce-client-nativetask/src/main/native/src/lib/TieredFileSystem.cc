@@ -0,0 +1,232 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "lib/TieredFileSystem.h"
+#include "lib/BufferStream.h"
+#include "lib/Path.h"
+
+namespace NativeTask {
+
+/**
+ * writes into memory until the file system runs out of budget, then
+ * into the base file system
+ */
+class TieredOutputStream : public OutputStream {
+private:
+  TieredFileSystem * _fs;
+  string _path;
+  string * _data;
+  OutputStream * _overflow;
+  uint64_t _position;
+
+public:
+  TieredOutputStream(TieredFileSystem * fs, const string & path, string * data)
+      : _fs(fs), _path(path), _data(data), _overflow(NULL), _position(0) {
+  }
+
+  virtual ~TieredOutputStream() {
+    close();
+    delete _overflow;
+    _overflow = NULL;
+  }
+
+  virtual uint64_t tell() {
+    return _position;
+  }
+
+  virtual void write(const void * buff, uint32_t length) {
+    if (NULL != _data) {
+      if (_fs->reserve(length)) {
+        _data->append((const char *)buff, length);
+        _position += length;
+        return;
+      }
+      _overflow = _fs->overflow(_path);
+      _data = NULL;
+    }
+    _overflow->write(buff, length);
+    _position += length;
+  }
+
+  virtual void flush() {
+    if (NULL != _overflow) {
+      _overflow->flush();
+    }
+  }
+
+  virtual void close() {
+    if (NULL != _overflow) {
+      _overflow->close();
+    }
+  }
+};
+
+/////////////////////////////////////////////////////////////
+
+TieredFileSystem::TieredFileSystem(FileSystem & base, uint64_t capacity)
+    : _base(base), _capacity(capacity), _used(0) {
+}
+
+TieredFileSystem::~TieredFileSystem() {
+  std::map<string, string *>::iterator itr = _files.begin();
+  for (; itr != _files.end(); itr++) {
+    delete itr->second;
+  }
+  _files.clear();
+}
+
+TieredFileSystem & TieredFileSystem::getInstance() {
+  static TieredFileSystem instance(FileSystem::getLocal());
+  return instance;
+}
+
+void TieredFileSystem::configure(Config * config) {
+  setCapacity((uint64_t)config->getInt(NATIVE_SPILL_TIERED_MEMORY_MB, 0) * 1024 * 1024);
+}
+
+void TieredFileSystem::setCapacity(uint64_t capacity) {
+  ScopeLock<Lock> autoLock(_lock);
+  _capacity = capacity;
+}
+
+bool TieredFileSystem::inMemory(const string & path) {
+  ScopeLock<Lock> autoLock(_lock);
+  return _files.find(path) != _files.end();
+}
+
+uint64_t TieredFileSystem::getMemoryUsed() {
+  ScopeLock<Lock> autoLock(_lock);
+  return _used;
+}
+
+bool TieredFileSystem::reserve(uint64_t length) {
+  ScopeLock<Lock> autoLock(_lock);
+  if (_used + length > _capacity) {
+    return false;
+  }
+  _used += length;
+  return true;
+}
+
+OutputStream * TieredFileSystem::overflow(const string & path) {
+  string * data = NULL;
+  {
+    ScopeLock<Lock> autoLock(_lock);
+    std::map<string, string *>::iterator itr = _files.find(path);
+    if (itr == _files.end()) {
+      THROW_EXCEPTION_EX(IOException, "memory file %s removed while it is written",
+          path.c_str());
+    }
+    data = itr->second;
+    _files.erase(itr);
+    _used -= data->length();
+  }
+  LOG("[TieredFileSystem] out of memory budget, moving %s (%zu bytes) to disk", path.c_str(),
+      data->length());
+  OutputStream * out = _base.create(path, true);
+  out->write(data->data(), data->length());
+  delete data;
+  return out;
+}
+
+bool TieredFileSystem::removeMemoryFile(const string & path) {
+  ScopeLock<Lock> autoLock(_lock);
+  std::map<string, string *>::iterator itr = _files.find(path);
+  if (itr == _files.end()) {
+    return false;
+  }
+  _used -= itr->second->length();
+  delete itr->second;
+  _files.erase(itr);
+  return true;
+}
+
+InputStream * TieredFileSystem::open(const string & path) {
+  {
+    ScopeLock<Lock> autoLock(_lock);
+    std::map<string, string *>::iterator itr = _files.find(path);
+    if (itr != _files.end()) {
+      return new InputBuffer(*itr->second);
+    }
+  }
+  return _base.open(path);
+}
+
+OutputStream * TieredFileSystem::create(const string & path, bool overwrite) {
+  removeMemoryFile(path);
+  string * data = NULL;
+  {
+    ScopeLock<Lock> autoLock(_lock);
+    if (_capacity > 0) {
+      data = new string();
+      _files[path] = data;
+    }
+  }
+  if (NULL == data) {
+    return _base.create(path, overwrite);
+  }
+  if (_base.exists(path)) {
+    _base.remove(path);
+  }
+  return new TieredOutputStream(this, path, data);
+}
+
+uint64_t TieredFileSystem::getLength(const string & path) {
+  {
+    ScopeLock<Lock> autoLock(_lock);
+    std::map<string, string *>::iterator itr = _files.find(path);
+    if (itr != _files.end()) {
+      return itr->second->length();
+    }
+  }
+  return _base.getLength(path);
+}
+
+bool TieredFileSystem::list(const string & path, vector<FileEntry> & status) {
+  bool found = _base.list(path, status);
+  ScopeLock<Lock> autoLock(_lock);
+  std::map<string, string *>::iterator itr = _files.begin();
+  for (; itr != _files.end(); itr++) {
+    if (Path::GetParent(itr->first) == path) {
+      FileEntry entry;
+      entry.name = Path::GetName(itr->first);
+      entry.isDirectory = false;
+      status.push_back(entry);
+      found = true;
+    }
+  }
+  return found;
+}
+
+void TieredFileSystem::remove(const string & path) {
+  if (!removeMemoryFile(path)) {
+    _base.remove(path);
+  }
+}
+
+bool TieredFileSystem::exists(const string & path) {
+  return inMemory(path) || _base.exists(path);
+}
+
+void TieredFileSystem::mkdirs(const string & path) {
+  _base.mkdirs(path);
+}
+
+} // namespace NativeTask
@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TIERED_FILESYSTEM_H_
+#define TIERED_FILESYSTEM_H_
+
+#include "lib/FileSystem.h"
+#include "util/SyncUtils.h"
+
+namespace NativeTask {
+
+class TieredOutputStream;
+
+/**
+ * Files are kept in memory while they fit in the memory budget, a file
+ * that outgrows it is moved to the base file system and written there
+ * from then on. Meant for short lived spill files on nodes with little
+ * or slow local disk, a file must be completely written before it is
+ * opened for reading
+ */
+class TieredFileSystem : public FileSystem {
+  friend class TieredOutputStream;
+
+private:
+  FileSystem & _base;
+  Lock _lock;
+  std::map<string, string *> _files;
+  uint64_t _capacity;
+  uint64_t _used;
+
+public:
+  TieredFileSystem(FileSystem & base, uint64_t capacity = 0);
+
+  virtual ~TieredFileSystem();
+
+  /**
+   * the "tiered" file system, over the local one
+   */
+  static TieredFileSystem & getInstance();
+
+  /**
+   * native.spill.tiered.memory.mb is the memory budget, 0 sends all new
+   * files straight to the base file system
+   */
+  virtual void configure(Config * config);
+
+  void setCapacity(uint64_t capacity);
+
+  bool inMemory(const string & path);
+
+  uint64_t getMemoryUsed();
+
+  virtual InputStream * open(const string & path);
+
+  virtual OutputStream * create(const string & path, bool overwrite = true);
+
+  virtual uint64_t getLength(const string & path);
+
+  virtual bool list(const string & path, vector<FileEntry> & status);
+
+  virtual void remove(const string & path);
+
+  virtual bool exists(const string & path);
+
+  virtual void mkdirs(const string & path);
+
+private:
+  bool reserve(uint64_t length);
+
+  /**
+   * move the memory file to the base file system, the returned stream
+   * continues writing it
+   */
+  OutputStream * overflow(const string & path);
+
+  bool removeMemoryFile(const string & path);
+};
+
+} // namespace NativeTask
+
+#endif /* TIERED_FILESYSTEM_H_ */
@@ -0,0 +1,82 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "lib/BufferStream.h"
+#include "lib/FileSystem.h"
+#include "lib/TotalOrderPartitioner.h"
+
+namespace NativeTask {
+
+TotalOrderPartitioner::TotalOrderPartitioner(const vector<string> & splitPoints,
+    ComparatorPtr comparator)
+    : _comparator(comparator) {
+  for (size_t i = 1; i < splitPoints.size(); i++) {
+    const string & prev = splitPoints[i - 1];
+    const string & cur = splitPoints[i];
+    if (_comparator(prev.data(), prev.length(), cur.data(), cur.length()) > 0) {
+      THROW_EXCEPTION_EX(IOException, "split points are not sorted at %zu", i);
+    }
+  }
+  _nodes.resize(splitPoints.size() + 1);
+  uint32_t next = 0;
+  build(splitPoints, 1, next);
+}
+
+void TotalOrderPartitioner::build(const vector<string> & splitPoints, uint32_t k,
+    uint32_t & next) {
+  if (k >= _nodes.size()) {
+    return;
+  }
+  build(splitPoints, 2 * k, next);
+  const string & key = splitPoints[next];
+  _nodes[k].offset = _keys.length();
+  _nodes[k].length = key.length();
+  _nodes[k].rank = next;
+  _keys.append(key);
+  next++;
+  build(splitPoints, 2 * k + 1, next);
+}
+
+TotalOrderPartitioner * TotalOrderPartitioner::create(const string & path,
+    ComparatorPtr comparator) {
+  string content;
+  OutputStringStream dest(content);
+  InputStream * fin = FileSystem::getLocal().open(path);
+  fin->readAllTo(dest, 64 * 1024);
+  delete fin;
+
+  vector<string> splitPoints;
+  size_t pos = 0;
+  while (pos < content.length()) {
+    if (content.length() - pos < 4) {
+      THROW_EXCEPTION_EX(IOException, "split point file truncated: [%s]", path.c_str());
+    }
+    uint32_t length = bswap(*(const uint32_t *)(content.data() + pos));
+    pos += 4;
+    if (content.length() - pos < length) {
+      THROW_EXCEPTION_EX(IOException, "split point file truncated: [%s]", path.c_str());
+    }
+    splitPoints.push_back(content.substr(pos, length));
+    pos += length;
+  }
+  return new TotalOrderPartitioner(splitPoints, comparator);
+}
+
+} // namespace NativeTask
@@ -0,0 +1,90 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOTALORDERPARTITIONER_H_
+#define TOTALORDERPARTITIONER_H_
+
+#include <string>
+#include <vector>
+#include "NativeTask.h"
+
+namespace NativeTask {
+
+using std::string;
+using std::vector;
+
+/**
+ * Partition of the java TotalOrderPartitioner: the number of split points
+ * not greater than the key, for split points sorted by the same
+ * comparator. The split points are searched in Eytzinger (BFS) order, so
+ * every level of the search is the next node index without branches and
+ * the first levels, which all keys go through, share cache lines.
+ */
+class TotalOrderPartitioner {
+private:
+  struct Node {
+    uint32_t offset;
+    uint32_t length;
+    // of the split point in sorted order
+    uint32_t rank;
+  };
+
+  ComparatorPtr _comparator;
+  string _keys;
+  // _nodes[1..n] in Eytzinger order, _nodes[0] is unused
+  vector<Node> _nodes;
+
+public:
+  /**
+   * @param splitPoints sorted split points, their count + 1 is the number
+   *        of partitions
+   */
+  TotalOrderPartitioner(const vector<string> & splitPoints, ComparatorPtr comparator);
+
+  /**
+   * split points as written by the java collector delegator to a local
+   * file, each one a 4 byte big endian length and the key as it is sent to
+   * the native collector
+   */
+  static TotalOrderPartitioner * create(const string & path, ComparatorPtr comparator);
+
+  uint32_t numPartitions() const {
+    return _nodes.size();
+  }
+
+  uint32_t getPartition(const char * key, uint32_t keyLength) const {
+    const uint32_t n = _nodes.size() - 1;
+    const Node * nodes = &_nodes[0];
+    const char * keys = _keys.data();
+    uint32_t k = 1;
+    while (k <= n) {
+      const Node & node = nodes[k];
+      k = 2 * k + (_comparator(keys + node.offset, node.length, key, keyLength) <= 0);
+    }
+    // the last left turn is at the first split point greater than the key
+    k >>= __builtin_ffs(~k);
+    return k == 0 ? n : nodes[k].rank;
+  }
+
+private:
+  void build(const vector<string> & splitPoints, uint32_t k, uint32_t & next);
+};
+
+} // namespace NativeTask
+
+#endif /* TOTALORDERPARTITIONER_H_ */
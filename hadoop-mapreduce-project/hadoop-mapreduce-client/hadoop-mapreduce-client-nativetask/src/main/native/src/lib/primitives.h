@@ -27,6 +27,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <assert.h>
+#include <string.h>
 #include <string>
 
 #ifdef __GNUC__
@@ -93,6 +94,62 @@ inline void simple_memcpy(void * dest, const void * src, size_t len) {
 
 #endif
 
+/**
+ * fixed size copies, the compiler turns them into single unaligned
+ * loads and stores
+ */
+inline void copy4(uint8_t * dest, const uint8_t * src) {
+  ::memcpy(dest, src, 4);
+}
+
+inline void copy8(uint8_t * dest, const uint8_t * src) {
+  ::memcpy(dest, src, 8);
+}
+
+inline void copy16(uint8_t * dest, const uint8_t * src) {
+  ::memcpy(dest, src, 16);
+}
+
+/**
+ * memcpy for the short keys and values of the collect path, dispatched
+ * on the size class. Every class copies its first and last chunk with
+ * overlapping unaligned loads and stores, so there is no byte by byte
+ * tail and no branch on the exact length. Copies over 256 bytes go to
+ * libc memcpy.
+ * src & dest must not overlap
+ */
+inline void small_memcpy(void * dest, const void * src, size_t len) {
+  const uint8_t * src8 = (const uint8_t*)src;
+  uint8_t * dest8 = (uint8_t*)dest;
+  if (len <= 16) {
+    if (len >= 8) {
+      copy8(dest8, src8);
+      copy8(dest8 + len - 8, src8 + len - 8);
+    } else if (len >= 4) {
+      copy4(dest8, src8);
+      copy4(dest8 + len - 4, src8 + len - 4);
+    } else if (len > 0) {
+      dest8[0] = src8[0];
+      dest8[len >> 1] = src8[len >> 1];
+      dest8[len - 1] = src8[len - 1];
+    }
+    return;
+  }
+  if (len <= 32) {
+    copy16(dest8, src8);
+    copy16(dest8 + len - 16, src8 + len - 16);
+    return;
+  }
+  if (len <= 256) {
+    for (size_t i = 0; i < len - 16; i += 16) {
+      copy16(dest8 + i, src8 + i);
+    }
+    copy16(dest8 + len - 16, src8 + len - 16);
+    return;
+  }
+  ::memcpy(dest, src, len);
+}
+
 /**
  * little-endian to big-endian or vice versa
  */
@@ -126,6 +183,39 @@ inline uint64_t bswap64(uint64_t val) {
   return val;
 }
 
+/**
+ * 64 bit hash of a byte sequence, FNV-1a over 8 byte words with a
+ * murmur3 finalizer, not stable across platforms of different endianness
+ */
+inline uint64_t fhash64(const char * data, uint32_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL ^ len;
+  const uint64_t prime = 0x100000001b3ULL;
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+    hash = (hash ^ word) * prime;
+    data += 8;
+    len -= 8;
+  }
+  while (len > 0) {
+    hash = (hash ^ (uint8_t)*data) * prime;
+    data++;
+    len--;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * From this length on memcmp of the C library, which uses the widest
+ * vector compare of the cpu, is faster than the 8 byte loop below
+ */
+#define FMEMCMP_LIBC_LENGTH 32
+
 /**
  * Fast memcmp
  */
@@ -169,6 +259,10 @@ inline int64_t fmemcmp(const char * src, const char * dest, uint32_t len) {
     return ((int64_t)bswap(*(uint32_t*)(src + len - 4))
         - (int64_t)bswap(*(uint32_t*)(dest + len - 4)));
   }
+  if (len >= FMEMCMP_LIBC_LENGTH) {
+    // the C library picks vector code for the cpu at load time
+    return memcmp(src, dest, len);
+  }
   uint32_t cur = 0;
   uint32_t end = len & (0xffffffffU << 3);
   while (cur < end) {
@@ -227,6 +321,9 @@ inline bool fmemeq(const char * src, const char * dest, uint32_t len) {
     return (*(uint32_t*)src8 == *(uint32_t*)dest8)
         && (*(uint32_t*)(src8 + len - 4) == *(uint32_t*)(dest8 + len - 4));
   }
+  if (len >= FMEMCMP_LIBC_LENGTH) {
+    return 0 == memcmp(src, dest, len);
+  }
   uint32_t cur = 0;
   uint32_t end = len & (0xffffffff << 3);
   while (cur < end) {
@@ -21,16 +21,17 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include "bulk_crc32.h"
 
 namespace NativeTask {
 
-extern uint32_t crc32_sb8(uint32_t, const uint8_t *, size_t);
-extern uint32_t crc32c_sb8(uint32_t, const uint8_t *, size_t);
-
 enum ChecksumType {
   CHECKSUM_NONE,
   CHECKSUM_CRC32,
   CHECKSUM_CRC32C,
+  // native only spills, the stream checksum is 0 and an XXHash64 of each
+  // segment is kept in its IFileSegment instead
+  CHECKSUM_SEGMENT_HASH,
 };
 
 class Checksum {
@@ -38,6 +39,7 @@ public:
   static uint32_t init(ChecksumType type) {
     switch (type) {
     case CHECKSUM_NONE:
+    case CHECKSUM_SEGMENT_HASH:
       return 0;
     case CHECKSUM_CRC32:
       return 0xffffffff;
@@ -50,12 +52,13 @@ public:
   static void update(ChecksumType type, uint32_t & value, const void * buff, uint32_t length) {
     switch (type) {
     case CHECKSUM_NONE:
+    case CHECKSUM_SEGMENT_HASH:
       return;
     case CHECKSUM_CRC32:
-      value = crc32_sb8(value, (const uint8_t *)buff, length);
+      value = crc32_zlib_update(value, (const uint8_t *)buff, length);
       return;
     case CHECKSUM_CRC32C:
-      value = crc32c_sb8(value, (const uint8_t *)buff, length);
+      value = crc32c_update(value, (const uint8_t *)buff, length);
       return;
     }
     return;
@@ -64,6 +67,7 @@ public:
   static uint32_t getValue(ChecksumType type, uint32_t value) {
     switch (type) {
     case CHECKSUM_NONE:
+    case CHECKSUM_SEGMENT_HASH:
       return 0;
     case CHECKSUM_CRC32:
     case CHECKSUM_CRC32C:
@@ -52,4 +52,28 @@ void Lock::unlock() {
   PthreadCall("unlock", pthread_mutex_unlock(&_mutex));
 }
 
+Condition::Condition(Lock & lock)
+    : _lock(&lock) {
+  int ret = pthread_cond_init(&_cond, NULL);
+  if (ret != 0) {
+    THROW_EXCEPTION_EX(IOException, "pthread_cond_init: %s", strerror(ret));
+  }
+}
+
+Condition::~Condition() {
+  PthreadCall("destroy condition", pthread_cond_destroy(&_cond));
+}
+
+void Condition::wait() {
+  PthreadCall("wait", pthread_cond_wait(&_cond, &_lock->_mutex));
+}
+
+void Condition::signal() {
+  PthreadCall("signal", pthread_cond_signal(&_cond));
+}
+
+void Condition::signalAll() {
+  PthreadCall("broadcast", pthread_cond_broadcast(&_cond));
+}
+
 } // namespace NativeTask
@@ -47,6 +47,28 @@ private:
   void operator=(const Lock&);
 };
 
+class Condition {
+public:
+  Condition(Lock & lock);
+  ~Condition();
+
+  /**
+   * wait on this condition, the associated lock must be held
+   * by the caller exactly once
+   */
+  void wait();
+  void signal();
+  void signalAll();
+
+private:
+  pthread_cond_t _cond;
+  Lock * _lock;
+
+  // No copying
+  Condition(const Condition&);
+  void operator=(const Condition&);
+};
+
 template<typename LockT>
 class ScopeLock {
 public:
@@ -0,0 +1,89 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "util/ThreadPool.h"
+
+namespace NativeTask {
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+    : _hasTask(_lock), _stopped(false) {
+  for (uint32_t i = 0; i < numThreads; i++) {
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, ThreadPool::threadMain, this);
+    if (ret != 0) {
+      LOG("[ThreadPool] pthread_create failed: %s, continue with %u threads", strerror(ret),
+          (uint32_t)_threads.size());
+      break;
+    }
+    _threads.push_back(thread);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    ScopeLock<Lock> autoLock(_lock);
+    _stopped = true;
+    _hasTask.signalAll();
+  }
+  for (size_t i = 0; i < _threads.size(); i++) {
+    pthread_join(_threads[i], NULL);
+  }
+  _threads.clear();
+}
+
+void ThreadPool::submit(Runnable * task) {
+  if (_threads.size() == 0) {
+    // no worker available, run in caller
+    task->run();
+    return;
+  }
+  ScopeLock<Lock> autoLock(_lock);
+  _tasks.push_back(task);
+  _hasTask.signal();
+}
+
+void * ThreadPool::threadMain(void * pool) {
+  ((ThreadPool *)pool)->work();
+  return NULL;
+}
+
+void ThreadPool::work() {
+  while (true) {
+    Runnable * task = NULL;
+    {
+      ScopeLock<Lock> autoLock(_lock);
+      while (_tasks.empty() && !_stopped) {
+        _hasTask.wait();
+      }
+      if (_tasks.empty()) {
+        return;
+      }
+      task = _tasks.front();
+      _tasks.pop_front();
+    }
+    try {
+      task->run();
+    } catch (std::exception & e) {
+      LOG("[ThreadPool] uncaught exception in task: %s", e.what());
+    }
+  }
+}
+
+} // namespace NativeTask
@@ -0,0 +1,81 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+#include "util/SyncUtils.h"
+
+namespace NativeTask {
+
+/**
+ * Unit of work executed by ThreadPool
+ */
+class Runnable {
+public:
+  virtual ~Runnable() {
+  }
+
+  virtual void run() = 0;
+};
+
+/**
+ * Fixed size pool of worker threads, tasks are executed
+ * in submission order. Tasks are not owned by the pool, and
+ * must catch their own exceptions if the caller cares about them.
+ */
+class ThreadPool {
+private:
+  Lock _lock;
+  Condition _hasTask;
+  std::deque<Runnable *> _tasks;
+  std::vector<pthread_t> _threads;
+  bool _stopped;
+
+public:
+  ThreadPool(uint32_t numThreads);
+
+  /**
+   * finish all queued tasks and join worker threads
+   */
+  ~ThreadPool();
+
+  void submit(Runnable * task);
+
+  uint32_t size() const {
+    return _threads.size();
+  }
+
+private:
+  static void * threadMain(void * pool);
+
+  void work();
+
+  // No copying
+  ThreadPool(const ThreadPool&);
+  void operator=(const ThreadPool&);
+};
+
+} // namespace NativeTask
+
+#endif /* THREADPOOL_H_ */
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <string>
 #include "lib/Streams.h"
+#include "lib/primitives.h"
 #include "NativeTask.h"
 
 namespace NativeTask {
@@ -36,6 +37,9 @@ protected:
   static void WriteVLongInner(int64_t value, char * pos, uint32_t & len);
   static uint32_t GetVLongSizeInner(int64_t value);
 public:
+  // the longest vint/vlong encoding, a length byte and 8 value bytes
+  static const uint32_t MAX_VLONG_SIZE = 9;
+
   inline static uint32_t DecodeVLongSize(int8_t ch) {
     if (ch >= -112) {
       return 1;
@@ -65,6 +69,26 @@ public:
     }
   }
 
+  /**
+   * ReadVLong with the value bytes loaded in one go instead of a byte
+   * loop, it always reads MAX_VLONG_SIZE bytes at pos, which must be
+   * readable even if the encoding is shorter
+   */
+  inline static int64_t ReadVLongUnchecked(const char * pos, uint32_t & len) {
+    int8_t first = *pos;
+    if (first >= -112) {
+      len = 1;
+      return first;
+    }
+    bool neg = first < -120;
+    uint32_t count = neg ? (-120 - first) : (-112 - first);
+    len = count + 1;
+    uint64_t raw;
+    memcpy(&raw, pos + 1, 8);
+    uint64_t value = bswap64(raw) >> (64 - 8 * count);
+    return neg ? (value ^ -1LL) : value;
+  }
+
   inline static int32_t ReadVInt(const char * pos, uint32_t & len) {
     return (int32_t)ReadVLong(pos, len);
   }
@@ -0,0 +1,150 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "util/XXHash.h"
+
+namespace NativeTask {
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t * p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint32_t read32(const uint8_t * p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input) {
+  acc += input * PRIME2;
+  acc = rotl(acc, 31);
+  return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+  acc ^= hashRound(0, value);
+  return acc * PRIME1 + PRIME4;
+}
+
+void XXHash64::reset(uint64_t seed) {
+  _seed = seed;
+  _v1 = seed + PRIME1 + PRIME2;
+  _v2 = seed + PRIME2;
+  _v3 = seed;
+  _v4 = seed - PRIME1;
+  _totalLength = 0;
+  _buffLength = 0;
+}
+
+void XXHash64::update(const void * data, size_t length) {
+  const uint8_t * p = (const uint8_t *)data;
+  const uint8_t * end = p + length;
+  _totalLength += length;
+
+  if (_buffLength + length < 32) {
+    memcpy(_buff + _buffLength, p, length);
+    _buffLength += length;
+    return;
+  }
+
+  if (_buffLength > 0) {
+    uint32_t fill = 32 - _buffLength;
+    memcpy(_buff + _buffLength, p, fill);
+    p += fill;
+    _v1 = hashRound(_v1, read64(_buff));
+    _v2 = hashRound(_v2, read64(_buff + 8));
+    _v3 = hashRound(_v3, read64(_buff + 16));
+    _v4 = hashRound(_v4, read64(_buff + 24));
+    _buffLength = 0;
+  }
+
+  uint64_t v1 = _v1;
+  uint64_t v2 = _v2;
+  uint64_t v3 = _v3;
+  uint64_t v4 = _v4;
+  while (end - p >= 32) {
+    v1 = hashRound(v1, read64(p));
+    v2 = hashRound(v2, read64(p + 8));
+    v3 = hashRound(v3, read64(p + 16));
+    v4 = hashRound(v4, read64(p + 24));
+    p += 32;
+  }
+  _v1 = v1;
+  _v2 = v2;
+  _v3 = v3;
+  _v4 = v4;
+
+  if (p < end) {
+    _buffLength = end - p;
+    memcpy(_buff, p, _buffLength);
+  }
+}
+
+uint64_t XXHash64::digest() const {
+  uint64_t h;
+  if (_totalLength >= 32) {
+    h = rotl(_v1, 1) + rotl(_v2, 7) + rotl(_v3, 12) + rotl(_v4, 18);
+    h = mergeRound(h, _v1);
+    h = mergeRound(h, _v2);
+    h = mergeRound(h, _v3);
+    h = mergeRound(h, _v4);
+  } else {
+    h = _seed + PRIME5;
+  }
+  h += _totalLength;
+
+  const uint8_t * p = _buff;
+  const uint8_t * end = _buff + _buffLength;
+  while (end - p >= 8) {
+    h ^= hashRound(0, read64(p));
+    h = rotl(h, 27) * PRIME1 + PRIME4;
+    p += 8;
+  }
+  if (end - p >= 4) {
+    h ^= (uint64_t)read32(p) * PRIME1;
+    h = rotl(h, 23) * PRIME2 + PRIME3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= (*p) * PRIME5;
+    h = rotl(h, 11) * PRIME1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+} // namespace NativeTask
@@ -0,0 +1,64 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef XXHASH_H_
+#define XXHASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace NativeTask {
+
+/**
+ * streaming xxHash64, the result doesn't depend on how the data is split
+ * into updates. Words are read in host order, so the values match the
+ * reference implementation on little endian hosts only, which is enough
+ * for hashes that never leave the node
+ */
+class XXHash64 {
+private:
+  uint64_t _seed;
+  uint64_t _v1;
+  uint64_t _v2;
+  uint64_t _v3;
+  uint64_t _v4;
+  uint64_t _totalLength;
+  uint8_t _buff[32];
+  uint32_t _buffLength;
+
+public:
+  XXHash64(uint64_t seed = 0) {
+    reset(seed);
+  }
+
+  void reset(uint64_t seed = 0);
+
+  void update(const void * data, size_t length);
+
+  uint64_t digest() const;
+
+  static uint64_t hash(const void * data, size_t length, uint64_t seed = 0) {
+    XXHash64 hasher(seed);
+    hasher.update(data, length);
+    return hasher.digest();
+  }
+};
+
+} // namespace NativeTask
+
+#endif /* XXHASH_H_ */
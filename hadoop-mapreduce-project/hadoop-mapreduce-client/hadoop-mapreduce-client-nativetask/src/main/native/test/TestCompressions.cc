@@ -23,6 +23,10 @@
 #include "lib/BufferStream.h"
 #include "lib/FileSystem.h"
 #include "lib/Compressions.h"
+#include "lib/NativeObjectFactory.h"
+#include "lib/TaskCounters.h"
+#include "codec/GzipCodec.h"
+#include "codec/BlockCodec.h"
 #include "test_commons.h"
 
 #if defined HADOOP_SNAPPY_LIBRARY
@@ -169,7 +173,139 @@ class CompressResult {
 };
 
 TEST(Perf, GzipCodec) {
+  Config config;
+  config.setBool(NATIVE_GZIP_ISAL, false);
+  Compressions::configure(&config);
   TestCodec("org.apache.hadoop.io.compress.GzipCodec");
+  config.setBool(NATIVE_GZIP_ISAL, true);
+  Compressions::configure(&config);
+  if (GzipCodec::useIsal()) {
+    LOG("igzip:");
+    TestCodec("org.apache.hadoop.io.compress.GzipCodec");
+  }
+}
+
+static string gzipCompress(const string & data, bool isal) {
+  Config config;
+  config.setBool(NATIVE_GZIP_ISAL, isal);
+  Compressions::configure(&config);
+  string compressed;
+  OutputStringStream dest(compressed);
+  GzipCompressStream compressor(&dest, 64 * 1024);
+  // two members, as two partitions of an IFile
+  compressor.write(data.data(), data.length() / 2);
+  compressor.finish();
+  compressor.resetState();
+  compressor.write(data.data() + data.length() / 2, data.length() - data.length() / 2);
+  compressor.finish();
+  return compressed;
+}
+
+static string gzipDecompress(const string & compressed, uint32_t length, bool isal) {
+  Config config;
+  config.setBool(NATIVE_GZIP_ISAL, isal);
+  Compressions::configure(&config);
+  InputBuffer source(compressed);
+  GzipDecompressStream decompressor(&source, 64 * 1024);
+  string data(length, '\0');
+  uint32_t total = 0;
+  while (total < length) {
+    int32_t rd = decompressor.read(&data[total], length - total);
+    if (rd <= 0) {
+      break;
+    }
+    total += rd;
+  }
+  data.resize(total);
+  return data;
+}
+
+TEST(Compressions, GzipMembers) {
+  string data;
+  GenerateKVTextLength(data, 1024 * 1024, "word");
+  ASSERT_TRUE(data == gzipDecompress(gzipCompress(data, false), data.length(), false));
+}
+
+TEST(Compressions, GzipIsal) {
+  Config config;
+  config.setBool(NATIVE_GZIP_ISAL, true);
+  Compressions::configure(&config);
+  if (!GzipCodec::useIsal()) {
+    LOG("igzip not available, skipped");
+    return;
+  }
+  string data;
+  GenerateKVTextLength(data, 4 * 1024 * 1024, "word");
+  string isalCompressed = gzipCompress(data, true);
+  string zlibCompressed = gzipCompress(data, false);
+  // igzip output reads back with zlib, and zlib output with igzip
+  ASSERT_TRUE(data == gzipDecompress(isalCompressed, data.length(), false));
+  ASSERT_TRUE(data == gzipDecompress(zlibCompressed, data.length(), true));
+  ASSERT_TRUE(data == gzipDecompress(isalCompressed, data.length(), true));
+}
+
+static string blockRoundTrip(const string & codec, const string & data) {
+  string compressed;
+  OutputStringStream dest(compressed);
+  CompressStream * compressor = Compressions::getCompressionStream(codec, &dest, 64 * 1024);
+  compressor->write(data.data(), data.length());
+  compressor->flush();
+  delete compressor;
+
+  InputBuffer source(compressed);
+  DecompressStream * decompressor = Compressions::getDecompressionStream(codec, &source,
+      64 * 1024);
+  string decompressed(data.length(), '\0');
+  uint32_t total = 0;
+  while (total < data.length()) {
+    int32_t rd = decompressor->read(&decompressed[total], data.length() - total);
+    if (rd <= 0) {
+      break;
+    }
+    total += rd;
+  }
+  delete decompressor;
+  decompressed.resize(total);
+  EXPECT_TRUE(data == decompressed);
+  return compressed;
+}
+
+TEST(Compressions, StoredBlocks) {
+  // random data, which is stored, then text, which the probes notice
+  string data(4 * 1024 * 1024, '\0');
+  for (size_t i = 0; i < data.length(); i++) {
+    data[i] = rand();
+  }
+  string text;
+  GenerateKVTextLength(text, 8 * 1024 * 1024, "word");
+  data += text;
+
+  Config config;
+  config.set(NATIVE_COMPRESS_MIN_RATIO, "1.1");
+  Counter * storedBytes = NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP,
+      TaskCounters::COMPRESS_STORED_BYTES);
+  vector<string> codecs;
+  codecs.push_back(Compressions::Lz4Codec.name);
+#if defined HADOOP_SNAPPY_LIBRARY
+  codecs.push_back(Compressions::SnappyCodec.name);
+#endif
+#if defined HADOOP_ZSTD_LIBRARY
+  codecs.push_back(Compressions::ZstdCodec.name);
+#endif
+  for (int threads = 1; threads <= 4; threads += 3) {
+    config.setInt(NATIVE_COMPRESS_THREADS, threads);
+    Compressions::configure(&config);
+    for (size_t i = 0; i < codecs.size(); i++) {
+      uint64_t stored = storedBytes->get();
+      string compressed = blockRoundTrip(codecs[i], data);
+      stored = storedBytes->get() - stored;
+      ASSERT_GE(stored, 3 * 1024 * 1024);
+      ASSERT_LT(stored, 7 * 1024 * 1024);
+      ASSERT_LT(compressed.length(), 4 * 1024 * 1024 + text.length() * 3 / 4);
+    }
+  }
+  BlockCompressStream::setThreads(1);
+  BlockCompressStream::setMinRatio(0);
 }
 
 void MeasureSingleFileLz4(const string & path, CompressResult & total, size_t blockSize,
@@ -284,3 +420,9 @@ TEST(Perf, SnappyCodec) {
 }
 
 #endif // define HADOOP_SNAPPY_LIBRARY
+
+#if defined HADOOP_ZSTD_LIBRARY
+TEST(Perf, ZStandardCodec) {
+  TestCodec("org.apache.hadoop.io.compress.ZStandardCodec");
+}
+#endif // define HADOOP_ZSTD_LIBRARY
@@ -20,6 +20,9 @@
 #include "lib/NativeObjectFactory.h"
 #include "lib/BufferStream.h"
 #include "lib/Buffers.h"
+#include "lib/FileSystem.h"
+#include "lib/TaskCounters.h"
+#include "util/ThreadPool.h"
 #include "test_commons.h"
 
 TEST(Counter, Counter) {
@@ -46,3 +49,110 @@ TEST(Counter, CounterSet) {
   ASSERT_EQ(counter1, counter2);
   ASSERT_NE(counter1, counter3);
 }
+
+class CounterIncrease : public Runnable {
+private:
+  Counter * _counter;
+  uint32_t _times;
+
+public:
+  CounterIncrease(Counter * counter, uint32_t times)
+      : _counter(counter), _times(times) {
+  }
+
+  virtual void run() {
+    for (uint32_t i = 0; i < _times; i++) {
+      _counter->increase();
+      _counter->increase(2);
+    }
+  }
+};
+
+TEST(Counter, IncreaseFromThreads) {
+  Counter counter("group", "key");
+
+  // more threads than shards, some of them share one
+  const uint32_t threads = Counter::COUNTER_SHARDS + 4;
+  const uint32_t times = 100000;
+  vector<CounterIncrease *> tasks;
+  {
+    ThreadPool pool(threads);
+    for (uint32_t i = 0; i < threads; i++) {
+      tasks.push_back(new CounterIncrease(&counter, times));
+      pool.submit(tasks.back());
+    }
+  }
+  ASSERT_EQ((uint64_t)threads * times * 3, counter.get());
+  counter.increase(5);
+  ASSERT_EQ((uint64_t)threads * times * 3 + 5, counter.get());
+  for (size_t i = 0; i < tasks.size(); i++) {
+    delete tasks[i];
+  }
+}
+
+TEST(Counter, TaskPhaseMetrics) {
+  Config config;
+  config.setBool(NATIVE_METRICS_HISTOGRAM, true);
+  TaskPhaseMetrics::init(&config);
+  const char * group = TaskCounters::NATIVETASK_COUNTER_GROUP;
+  Counter * spill = NativeObjectFactory::GetCounter(group, TaskCounters::SPILL_MICROS);
+  Counter * fast = NativeObjectFactory::GetCounter(group, "SPILL_MICROS_LE_100");
+  Counter * medium = NativeObjectFactory::GetCounter(group, "SPILL_MICROS_LE_10000");
+  Counter * slow = NativeObjectFactory::GetCounter(group, "SPILL_MICROS_GT_1000000");
+  uint64_t spillBase = spill->get();
+  uint64_t fastBase = fast->get();
+  uint64_t mediumBase = medium->get();
+  uint64_t slowBase = slow->get();
+
+  TaskPhaseMetrics::add(SPILL_PHASE, 50 * 1000);
+  TaskPhaseMetrics::add(SPILL_PHASE, 5 * 1000 * 1000);
+  TaskPhaseMetrics::add(SPILL_PHASE, 10 * 1000 * 1000);
+  TaskPhaseMetrics::add(SPILL_PHASE, 3ULL * 1000 * 1000 * 1000);
+  ASSERT_EQ(spillBase + 50 + 5000 + 10000 + 3000000, spill->get());
+  ASSERT_EQ(fastBase + 1, fast->get());
+  ASSERT_EQ(mediumBase + 2, medium->get());
+  ASSERT_EQ(slowBase + 1, slow->get());
+
+  {
+    PhaseTimer timer(MERGE_PHASE);
+    usleep(2000);
+  }
+  ASSERT_GE(NativeObjectFactory::GetCounter(group, TaskCounters::MERGE_MICROS)->get(), 2000);
+}
+
+TEST(Counter, TaskTrace) {
+  const string path = "tasktrace.json";
+  Config config;
+  config.setBool(NATIVE_TRACE, true);
+  config.set(NATIVE_TRACE_FILE, path);
+  config.setInt(NATIVE_TRACE_MIN_MICROS, 1000);
+  TaskPhaseMetrics::init(&config);
+  ASSERT_TRUE(TaskTrace::enabled());
+
+  TaskTrace::add(SORT_PHASE, 1000000, 1500000);
+  TaskTrace::add(SPILL_PHASE, 1000000, 3000500);
+  {
+    PhaseTimer timer(MERGE_PHASE);
+    usleep(2000);
+  }
+  TaskTrace::write();
+
+  string content;
+  ReadFile(content, path);
+  FileSystem::getLocal().remove(path);
+  ASSERT_EQ(0, content.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  ASSERT_EQ(string::npos, content.find("\"sort\""));
+  ASSERT_NE(string::npos, content.find("\"name\":\"spill\""));
+  ASSERT_NE(string::npos, content.find("\"ts\":1000.000,\"dur\":2000.500}"));
+  ASSERT_NE(string::npos, content.find("\"name\":\"merge\""));
+  size_t events = 0;
+  for (size_t pos = content.find("\"ph\":\"X\""); pos != string::npos;
+      pos = content.find("\"ph\":\"X\"", pos + 1)) {
+    events++;
+  }
+  ASSERT_EQ(2, events);
+
+  Config disabled;
+  TaskPhaseMetrics::init(&disabled);
+  ASSERT_FALSE(TaskTrace::enabled());
+}
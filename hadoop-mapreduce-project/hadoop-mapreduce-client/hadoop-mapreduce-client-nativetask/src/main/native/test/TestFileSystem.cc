@@ -17,6 +17,7 @@
  */
 
 #include "lib/FileSystem.h"
+#include "lib/TieredFileSystem.h"
 #include "test_commons.h"
 
 TEST(FileSystem, RawFileSystem) {
@@ -48,3 +49,95 @@ TEST(FileSystem, RawFileSystem) {
   ASSERT_FALSE(fs.exists(temppath));
 }
 
+TEST(FileSystem, TieredFileSystem) {
+  TieredFileSystem fs(FileSystem::getLocal(), 1024 * 1024);
+  ASSERT_EQ(&TieredFileSystem::getInstance(), FileSystem::get("tiered"));
+  ASSERT_EQ(&FileSystem::getLocal(), FileSystem::get("local"));
+  ASSERT_TRUE(NULL == FileSystem::get("nosuchfs"));
+
+  string small;
+  string large;
+  GenerateKVTextLength(small, 100000, "word");
+  GenerateKVTextLength(large, 2000000, "word");
+
+  OutputStream * output = fs.create("tiered.small", true);
+  output->write(small.data(), small.length());
+  delete output;
+  ASSERT_TRUE(fs.inMemory("tiered.small"));
+  ASSERT_FALSE(FileSystem::getLocal().exists("tiered.small"));
+  ASSERT_EQ(small.length(), fs.getMemoryUsed());
+
+  // outgrows the budget and continues on disk
+  output = fs.create("tiered.large", true);
+  for (size_t i = 0; i < large.length(); i += 100000) {
+    output->write(large.data() + i, std::min((size_t)100000, large.length() - i));
+  }
+  ASSERT_EQ(large.length(), output->tell());
+  delete output;
+  ASSERT_FALSE(fs.inMemory("tiered.large"));
+  ASSERT_TRUE(FileSystem::getLocal().exists("tiered.large"));
+  ASSERT_EQ(small.length(), fs.getMemoryUsed());
+
+  const string paths[] = {"tiered.small", "tiered.large"};
+  const string * contents[] = {&small, &large};
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(fs.exists(paths[i]));
+    ASSERT_EQ(contents[i]->length(), fs.getLength(paths[i]));
+    InputStream * input = fs.open(paths[i]);
+    string read;
+    read.resize(contents[i]->length());
+    ASSERT_EQ(contents[i]->length(), input->readFully(&read[0], read.length()));
+    delete input;
+    ASSERT_TRUE(*contents[i] == read);
+    fs.remove(paths[i]);
+    ASSERT_FALSE(fs.exists(paths[i]));
+  }
+  ASSERT_EQ(0, fs.getMemoryUsed());
+}
+
+TEST(FileSystem, readAhead) {
+  FileSystem & fs = FileSystem::getLocal();
+  string temppath = "readahead.data";
+  string content;
+  GenerateKVTextLength(content, 1000000, "word");
+  OutputStream * output = fs.create(temppath, true);
+  output->write(content.data(), content.length());
+  delete output;
+
+  FileInputStream * input = (FileInputStream*)fs.open(temppath);
+  input->setReadAhead(64 * 1024);
+  const uint64_t start = 12345;
+  input->seek(start);
+  char buff[4000];
+  uint64_t total = start;
+  while (true) {
+    int rd = input->read(buff, sizeof(buff));
+    if (rd <= 0) {
+      break;
+    }
+    ASSERT_EQ(content.substr(total, rd), string(buff, rd));
+    total += rd;
+  }
+  ASSERT_EQ(content.length(), total);
+  delete input;
+  fs.remove(temppath);
+}
+
+TEST(FileSystem, dropBehind) {
+  FileSystem & fs = FileSystem::getLocal();
+  string temppath = "dropbehind.data";
+  string content;
+  GenerateKVTextLength(content, 1000000, "word");
+  FileOutputStream * output = (FileOutputStream*)fs.create(temppath, true);
+  output->setDropBehind(64 * 1024);
+  for (size_t pos = 0; pos < content.length(); pos += 5000) {
+    output->write(content.data() + pos, std::min((size_t)5000, content.length() - pos));
+  }
+  ASSERT_EQ(content.length(), output->tell());
+  delete output;
+
+  string readback;
+  ReadFile(readback, temppath);
+  ASSERT_EQ(content, readback);
+  fs.remove(temppath);
+}
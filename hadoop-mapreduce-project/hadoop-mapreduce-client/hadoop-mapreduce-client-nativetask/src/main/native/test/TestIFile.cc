@@ -25,9 +25,10 @@
 #include "test_commons.h"
 
 SingleSpillInfo * writeIFile(int partition, vector<pair<string, string> > & kvs,
-    const string & path, KeyValueType type, const string & codec) {
+    const string & path, KeyValueType type, const string & codec,
+    ChecksumType checksumType = CHECKSUM_CRC32) {
   FileOutputStream * fout = (FileOutputStream*)FileSystem::getLocal().create(path);
-  IFileWriter * iw = new IFileWriter(fout, CHECKSUM_CRC32, type, type, codec, NULL);
+  IFileWriter * iw = new IFileWriter(fout, checksumType, type, type, codec, NULL);
   for (int i = 0; i < partition; i++) {
     iw->startPartition();
     for (size_t i = 0; i < kvs.size(); i++) {
@@ -43,9 +44,17 @@ SingleSpillInfo * writeIFile(int partition, vector<pair<string, string> > & kvs,
 }
 
 void readIFile(vector<pair<string, string> > & kvs, const string & path, KeyValueType type,
-    SingleSpillInfo * info, const string & codec) {
-  FileInputStream * fin = (FileInputStream*)FileSystem::getLocal().open(path);
-  IFileReader * ir = new IFileReader(fin, info);
+    SingleSpillInfo * info, const string & codec, bool mapped = false) {
+  InputStream * fin;
+  IFileReader * ir;
+  if (mapped) {
+    MmapInputStream * mapping = new MmapInputStream(path);
+    fin = mapping;
+    ir = new IFileReader(mapping, info);
+  } else {
+    fin = FileSystem::getLocal().open(path);
+    ir = new IFileReader(fin, info);
+  }
   while (ir->nextPartition()) {
     const char * key, *value;
     uint32_t keyLen, valueLen;
@@ -61,12 +70,12 @@ void readIFile(vector<pair<string, string> > & kvs, const string & path, KeyValu
 }
 
 void TestIFileReadWrite(KeyValueType kvtype, int partition, int size,
-    vector<pair<string, string> > & kvs, const string & codec = "") {
+    vector<pair<string, string> > & kvs, const string & codec = "", bool mapped = false) {
   string outputpath = "ifilewriter";
   SingleSpillInfo * info = writeIFile(partition, kvs, outputpath, kvtype, codec);
   LOG("write finished");
   vector<pair<string, string> > readkvs;
-  readIFile(readkvs, outputpath, kvtype, info, codec);
+  readIFile(readkvs, outputpath, kvtype, info, codec, mapped);
   LOG("read finished");
   delete info;
   ASSERT_EQ(kvs.size() * partition, readkvs.size());
@@ -94,6 +103,295 @@ TEST(IFile, WriteRead) {
 #if defined HADOOP_SNAPPY_LIBRARY
   TestIFileReadWrite(TextType, partition, size, kvs, "org.apache.hadoop.io.compress.SnappyCodec");
 #endif
+#if defined HADOOP_ZSTD_LIBRARY
+  TestIFileReadWrite(TextType, partition, size, kvs, "org.apache.hadoop.io.compress.ZStandardCodec");
+#endif
+}
+
+#if defined HADOOP_ZSTD_LIBRARY
+TEST(IFile, ZstdDictionary) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 20000, "word");
+  // raw content of typical records works as a zstd dictionary
+  string dictionary;
+  for (size_t i = 0; i < 1000; i++) {
+    dictionary.append(kvs[i].first).append(kvs[i].second);
+  }
+  string path = "zstd.dictionary";
+  OutputStream * fout = FileSystem::getLocal().create(path);
+  fout->write(dictionary.data(), dictionary.length());
+  delete fout;
+
+  Config config;
+  config.setInt(NATIVE_ZSTD_LEVEL, 1);
+  config.set(NATIVE_ZSTD_DICTIONARY, path);
+  Compressions::configure(&config);
+  TestIFileReadWrite(TextType, 3, kvs.size(), kvs, "org.apache.hadoop.io.compress.ZStandardCodec");
+
+  Config defaults;
+  Compressions::configure(&defaults);
+  FileSystem::getLocal().remove(path);
+}
+#endif
+
+TEST(IFile, ParallelCompression) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 20000, "bytes");
+  Config config;
+  config.setInt(NATIVE_COMPRESS_THREADS, 4);
+  Compressions::configure(&config);
+  TestIFileReadWrite(TextType, 7, kvs.size(), kvs, "org.apache.hadoop.io.compress.Lz4Codec");
+#if defined HADOOP_ZSTD_LIBRARY
+  TestIFileReadWrite(TextType, 7, kvs.size(), kvs, "org.apache.hadoop.io.compress.ZStandardCodec");
+#endif
+  Config defaults;
+  Compressions::configure(&defaults);
+}
+
+TEST(IFile, MappedRead) {
+  int partition = TestConfig.getInt("ifile.partition", 7);
+  int size = TestConfig.getInt("partition.size", 20000);
+  vector<pair<string, string> > kvs;
+  Generate(kvs, size, "bytes");
+  TestIFileReadWrite(TextType, partition, size, kvs, "", true);
+  TestIFileReadWrite(BytesType, partition, size, kvs, "", true);
+  TestIFileReadWrite(UnknownType, partition, size, kvs, "", true);
+}
+
+static void TestIFileBufferRead(KeyValueType type, int partition,
+    vector<pair<string, string> > & kvs, const string & codec) {
+  string path = "ifilebuffer";
+  SingleSpillInfo * info = writeIFile(partition, kvs, path, type, codec);
+  string content;
+  ReadFile(content, path);
+  FileSystem::getLocal().remove(path);
+  ASSERT_EQ(info->getRealEndPosition(), content.length());
+
+  IFileReader * ir = new IFileReader(content.data(), info);
+  vector<pair<string, string> > readkvs;
+  while (ir->nextPartition()) {
+    const char * key, *value;
+    uint32_t keyLen, valueLen;
+    while (NULL != (key = ir->nextKey(keyLen))) {
+      value = ir->value(valueLen);
+      if (codec.length() == 0) {
+        // read in place
+        ASSERT_TRUE(key >= content.data() && key < content.data() + content.length());
+      }
+      readkvs.push_back(std::make_pair(string(key, keyLen), string(value, valueLen)));
+    }
+  }
+  delete ir;
+  delete info;
+  ASSERT_EQ(kvs.size() * partition, readkvs.size());
+  for (int i = 0; i < partition; i++) {
+    vector<pair<string, string> > cur_part(readkvs.begin() + i * kvs.size(),
+        readkvs.begin() + (i + 1) * kvs.size());
+    ASSERT_EQ(kvs, cur_part);
+  }
+}
+
+TEST(IFile, BufferRead) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 20000, "bytes");
+  TestIFileBufferRead(TextType, 3, kvs, "");
+  TestIFileBufferRead(BytesType, 3, kvs, "");
+  TestIFileBufferRead(UnknownType, 3, kvs, "");
+  TestIFileBufferRead(TextType, 3, kvs, "org.apache.hadoop.io.compress.Lz4Codec");
+}
+
+static void readIFileBuffer(vector<pair<string, string> > & kvs, const string & content,
+    SingleSpillInfo * info) {
+  IFileReader * ir = new IFileReader(content.data(), info);
+  try {
+    while (ir->nextPartition()) {
+      const char * key, *value;
+      uint32_t keyLen, valueLen;
+      while (NULL != (key = ir->nextKey(keyLen))) {
+        value = ir->value(valueLen);
+        kvs.push_back(std::make_pair(string(key, keyLen), string(value, valueLen)));
+      }
+    }
+  } catch (...) {
+    delete ir;
+    throw;
+  }
+  delete ir;
+}
+
+TEST(IFile, SegmentHash) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 10000, "bytes");
+  const string codecs[] = {"", "org.apache.hadoop.io.compress.Lz4Codec"};
+  for (size_t c = 0; c < 2; c++) {
+    string path = "ifilehash";
+    SingleSpillInfo * info = writeIFile(3, kvs, path, TextType, codecs[c],
+        CHECKSUM_SEGMENT_HASH);
+    ASSERT_NE(0, info->segments[2].hash);
+
+    vector<pair<string, string> > readkvs;
+    readIFile(readkvs, path, TextType, info, codecs[c]);
+    ASSERT_EQ(kvs.size() * 3, readkvs.size());
+    readkvs.clear();
+    readIFile(readkvs, path, TextType, info, codecs[c], true);
+    ASSERT_EQ(kvs.size() * 3, readkvs.size());
+
+    string content;
+    ReadFile(content, path);
+    FileSystem::getLocal().remove(path);
+    readkvs.clear();
+    readIFileBuffer(readkvs, content, info);
+    ASSERT_EQ(kvs.size() * 3, readkvs.size());
+    for (size_t i = 0; i < kvs.size(); i++) {
+      ASSERT_EQ(kvs[i], readkvs[i]);
+    }
+
+    if (codecs[c].empty()) {
+      // a flipped bit in the last segment, the stream checksum is 0 so
+      // only the segment hash catches it
+      content[content.length() - 20] ^= 0x10;
+      readkvs.clear();
+      ASSERT_THROW(readIFileBuffer(readkvs, content, info), IOException);
+    }
+    delete info;
+  }
+}
+
+static string writeIFileToString(vector<pair<string, string> > & kvs, KeyValueType type,
+    bool gather, bool mixed = false, bool prefixKeys = false, SingleSpillInfo ** info = NULL) {
+  string path = gather ? "ifilegather" : "ifilecopy";
+  OutputStream * fout = FileSystem::getLocal().create(path);
+  IFileWriter * iw = new IFileWriter(fout, CHECKSUM_CRC32, type, type, "", NULL);
+  iw->setGather(gather);
+  iw->setPrefixKeys(prefixKeys);
+  for (int i = 0; i < 3; i++) {
+    iw->startPartition();
+    for (size_t j = 0; j < kvs.size(); j++) {
+      pair<string, string> & p = kvs[j];
+      if (mixed && j % 3 == 0) {
+        // combiners write through write() while spilling in gather mode
+        iw->write(p.first.c_str(), p.first.length(), p.second.c_str(), p.second.length());
+      } else {
+        iw->writeInPlace(p.first.c_str(), p.first.length(), p.second.c_str(), p.second.length());
+      }
+    }
+    iw->endPartition();
+  }
+  if (NULL != info) {
+    *info = iw->getSpillInfo();
+  }
+  delete iw;
+  delete fout;
+  string content;
+  ReadFile(content, path);
+  FileSystem::getLocal().remove(path);
+  return content;
+}
+
+TEST(IFile, GatherWrite) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 20000, "bytes");
+  // values long enough to be written in place
+  for (size_t i = 0; i < kvs.size(); i += 7) {
+    kvs[i].second.append(300 + i % 5000, 'v');
+  }
+  KeyValueType types[] = {TextType, BytesType, UnknownType};
+  for (size_t i = 0; i < 3; i++) {
+    string copied = writeIFileToString(kvs, types[i], false);
+    string gathered = writeIFileToString(kvs, types[i], true);
+    ASSERT_EQ(copied.length(), gathered.length());
+    ASSERT_TRUE(copied == gathered);
+    string mixed = writeIFileToString(kvs, types[i], true, true);
+    ASSERT_TRUE(copied == mixed);
+  }
+}
+
+TEST(IFile, PrefixKeys) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 20000, "word");
+  for (size_t i = 0; i < kvs.size(); i++) {
+    kvs[i].first = "http://www.example.com/" + kvs[i].first;
+  }
+  kvs.push_back(std::make_pair(string(""), string("empty")));
+  std::sort(kvs.begin(), kvs.end());
+  KeyValueType types[] = {TextType, BytesType, UnknownType};
+  for (size_t i = 0; i < 3; i++) {
+    string plain = writeIFileToString(kvs, types[i], false);
+    SingleSpillInfo * info = NULL;
+    string copied = writeIFileToString(kvs, types[i], false, false, true, &info);
+    ASSERT_TRUE(info->prefixKeys);
+    ASSERT_LT(copied.length(), plain.length() / 2);
+    string gathered = writeIFileToString(kvs, types[i], true, false, true);
+    ASSERT_TRUE(copied == gathered);
+    string mixed = writeIFileToString(kvs, types[i], true, true, true);
+    ASSERT_TRUE(copied == mixed);
+
+    vector<pair<string, string> > readkvs;
+    readIFileBuffer(readkvs, copied, info);
+    ASSERT_EQ(kvs.size() * 3, readkvs.size());
+    for (int p = 0; p < 3; p++) {
+      ASSERT_TRUE(std::equal(kvs.begin(), kvs.end(), readkvs.begin() + p * kvs.size()));
+    }
+
+    string path = "ifileprefix";
+    OutputStream * fout = FileSystem::getLocal().create(path);
+    fout->write(copied.data(), copied.length());
+    delete fout;
+    vector<pair<string, string> > streamkvs;
+    readIFile(streamkvs, path, types[i], info, "");
+    ASSERT_TRUE(readkvs == streamkvs);
+    FileSystem::getLocal().remove(path);
+    delete info;
+  }
+}
+
+TEST(IFile, ResetWriter) {
+  vector<pair<string, string> > kvs;
+  Generate(kvs, 10000, "bytes");
+  const string codecs[] = {"", "org.apache.hadoop.io.compress.Lz4Codec",
+      "org.apache.hadoop.io.compress.GzipCodec"};
+  for (size_t c = 0; c < 3; c++) {
+    string first;
+    OutputStringStream firstStream(first);
+    IFileWriter * iw = new IFileWriter(&firstStream, CHECKSUM_CRC32, TextType, TextType,
+        codecs[c], NULL);
+    iw->setPrefixKeys(true);
+    for (int i = 0; i < 3; i++) {
+      iw->startPartition();
+      for (size_t j = 0; j < kvs.size(); j++) {
+        iw->write(kvs[j].first.c_str(), kvs[j].first.length(), kvs[j].second.c_str(),
+            kvs[j].second.length());
+      }
+      iw->endPartition();
+    }
+    SingleSpillInfo * firstInfo = iw->getSpillInfo();
+
+    // a second file of only the last partition, as a fresh writer would write it
+    string second;
+    OutputStringStream secondStream(second);
+    iw->reset(&secondStream);
+    iw->startPartition();
+    for (size_t j = 0; j < kvs.size(); j++) {
+      iw->write(kvs[j].first.c_str(), kvs[j].first.length(), kvs[j].second.c_str(),
+          kvs[j].second.length());
+    }
+    iw->endPartition();
+    SingleSpillInfo * secondInfo = iw->getSpillInfo();
+    delete iw;
+
+    ASSERT_EQ(1, secondInfo->length);
+    ASSERT_EQ(firstInfo->segments[0].uncompressedEndOffset,
+        secondInfo->segments[0].uncompressedEndOffset);
+    ASSERT_EQ(firstInfo->segments[0].realEndOffset, secondInfo->segments[0].realEndOffset);
+    ASSERT_EQ(second.length(), secondInfo->segments[0].realEndOffset);
+    ASSERT_TRUE(first.compare(0, second.length(), second) == 0);
+
+    vector<pair<string, string> > readkvs;
+    readIFileBuffer(readkvs, second, secondInfo);
+    ASSERT_TRUE(kvs == readkvs);
+    delete firstInfo;
+    delete secondInfo;
+  }
 }
 
 void TestIFileWriteRead2(vector<pair<string, string> > & kvs, char * buff, size_t buffsize,
@@ -42,6 +42,30 @@ TEST(Primitives, fmemcmp) {
   }
 }
 
+TEST(Primitives, fmemcmpLong) {
+  // a single differing byte at every position, on both sides
+  char lbuff[600];
+  char rbuff[600];
+  for (uint32_t len = 1; len <= 520; len += (len < 40 ? 1 : 13)) {
+    for (uint32_t offset = 0; offset < 3; offset++) {
+      char * l = lbuff + offset;
+      char * r = rbuff + 2;
+      for (uint32_t i = 0; i < len; i++) {
+        l[i] = r[i] = (char)(i * 7);
+      }
+      ASSERT_EQ(0, fmemcmp(l, r, len));
+      for (uint32_t pos = 0; pos < len; pos++) {
+        char saved = l[pos];
+        l[pos] = (char)0x80;
+        r[pos] = (char)0x7f;
+        ASSERT_GT(fmemcmp(l, r, len), 0);
+        ASSERT_LT(fmemcmp(r, l, len), 0);
+        l[pos] = r[pos] = saved;
+      }
+    }
+  }
+}
+
 static int test_memcmp() {
   uint8_t buff[2048];
   for (uint32_t i = 0; i < 2048; i++) {
@@ -95,6 +119,46 @@ TEST(Perf, fmemcmp) {
   TestConfig.setInt("tempvalue", a + b);
 }
 
+TEST(Perf, fmemcmpKeyLength) {
+  // keys which only differ in their last byte, as sorted composite keys
+  // mostly share long prefixes
+  const uint32_t maxLen = 512;
+  const uint32_t times = TestConfig.getInt("fmemcmp.perf.bytes", 1 << 30);
+  char * lhs = new char[maxLen];
+  char * rhs = new char[maxLen];
+  for (uint32_t i = 0; i < maxLen; i++) {
+    lhs[i] = rhs[i] = (char)(i * 31);
+  }
+  int64_t r = 0;
+  char buff[64];
+  for (uint32_t len = 4; len <= maxLen; len *= 2) {
+    lhs[len - 1]++;
+    uint32_t loops = times / len;
+    Timer t;
+    for (uint32_t i = 0; i < loops; i++) {
+      // hide the pointer so that the call is not hoisted out of the loop
+      const char * l = lhs;
+      __asm__ volatile("" : "+r"(l));
+      r += memcmp(l, rhs, len);
+    }
+    snprintf(buff, 64, " memcmp %uB ", len);
+    LOG("%s", t.getSpeedM(buff, (uint64_t)loops * len).c_str());
+    t.reset();
+    for (uint32_t i = 0; i < loops; i++) {
+      const char * l = lhs;
+      __asm__ volatile("" : "+r"(l));
+      r += fmemcmp(l, rhs, len);
+    }
+    snprintf(buff, 64, " fmemcmp %uB ", len);
+    LOG("%s", t.getSpeedM(buff, (uint64_t)loops * len).c_str());
+    lhs[len - 1]--;
+  }
+  // prevent compiler optimization
+  TestConfig.setInt("tempvalue", (int)r);
+  delete[] lhs;
+  delete[] rhs;
+}
+
 static void test_memcpy_perf_len(char * src, char * dest, size_t len, size_t time) {
   for (size_t i = 0; i < time; i++) {
     memcpy(src, dest, len);
@@ -128,6 +192,58 @@ TEST(Perf, simple_memcpy_small) {
   delete[] dest;
 }
 
+TEST(Primitives, small_memcpy) {
+  // every length of every size class, at unaligned offsets, without
+  // touching the bytes around the copy
+  char src[400];
+  char dest[400];
+  for (size_t i = 0; i < sizeof(src); i++) {
+    src[i] = (char)(i * 13 + 1);
+  }
+  for (size_t len = 0; len <= 300; len++) {
+    for (size_t offset = 0; offset < 8; offset++) {
+      memset(dest, 0, sizeof(dest));
+      small_memcpy(dest + offset, src + 7 - offset, len);
+      ASSERT_EQ(0, memcmp(dest + offset, src + 7 - offset, len));
+      for (size_t i = 0; i < offset; i++) {
+        ASSERT_EQ(0, dest[i]);
+      }
+      for (size_t i = offset + len; i < sizeof(dest); i++) {
+        ASSERT_EQ(0, dest[i]);
+      }
+    }
+  }
+}
+
+static void test_small_memcpy_perf_len(char * src, char * dest, size_t len, size_t time) {
+  for (size_t i = 0; i < time; i++) {
+    small_memcpy(src, dest, len);
+    small_memcpy(dest, src, len);
+  }
+}
+
+TEST(Perf, small_memcpy) {
+  char * src = new char[10240];
+  char * dest = new char[10240];
+  char buff[32];
+  for (size_t len = 8; len <= 256; len = len + 8) {
+    LOG("------------------------------");
+    // odd lengths hit the overlapping tail copies
+    for (size_t odd = 0; odd < 2; odd++) {
+      snprintf(buff, 32, "      memcpy %luB\t", len - odd);
+      Timer t;
+      test_memcpy_perf_len(src + 1, dest + 3, len - odd, 1000000);
+      LOG("%s", t.getInterval(buff).c_str());
+      snprintf(buff, 32, "small_memcpy %luB\t", len - odd);
+      t.reset();
+      test_small_memcpy_perf_len(src + 1, dest + 3, len - odd, 1000000);
+      LOG("%s", t.getInterval(buff).c_str());
+    }
+  }
+  delete[] src;
+  delete[] dest;
+}
+
 inline char * memchrbrf4(char * p, char ch, size_t len) {
   ssize_t i = 0;
   for (; i < ((ssize_t)len) - 3; i += 3) {
@@ -19,6 +19,9 @@
 #include "lib/commons.h"
 #include "lib/Streams.h"
 #include "lib/Buffers.h"
+#include "lib/MapOutputSpec.h"
+#include "lib/MemoryBlock.h"
+#include "lib/NativeObjectFactory.h"
 #include "util/DualPivotQuickSort.h"
 #include "test_commons.h"
 
@@ -304,3 +307,42 @@ TEST(Perf, sortCacheMiss) {
     LOG("%s, MOD: %d", timer.getInterval("DualPivotQuicksort 2 partition sort").c_str(), MOD);
   }
 }
+
+static int longComparatorByPointer(const char * src, uint32_t srcLength, const char * dest,
+    uint32_t destLength) {
+  return NativeObjectFactory::LongComparator(src, srcLength, dest, destLength);
+}
+
+static void fillLongKeys(MemoryBlock & block, uint32_t count) {
+  Random r(1234);
+  for (uint32_t i = 0; i < count; i++) {
+    KVBuffer * kv = block.allocateKVBuffer(8 + 4 + KVBuffer::headerLength());
+    kv->keyLength = 8;
+    kv->valueLength = 4;
+    *(uint64_t *)kv->getKey() = bswap64(r.next_uint64());
+    *(uint32_t *)kv->getValue() = i;
+  }
+}
+
+TEST(Perf, sortInlinedComparator) {
+  const uint32_t KV_COUNT = 1000000;
+  const uint32_t BUFFER_LENGTH = KV_COUNT * 24;
+  char * bytes = new char[BUFFER_LENGTH];
+  const SortAlgorithm types[] = {CPPSORT, DUALPIVOTSORT};
+  const char * names[] = {"CPPSORT", "DUALPIVOTSORT"};
+  Timer timer;
+  for (uint32_t i = 0; i < 2; i++) {
+    MemoryBlock byPointer(bytes, BUFFER_LENGTH);
+    fillLongKeys(byPointer, KV_COUNT);
+    timer.reset();
+    byPointer.sort(types[i], &longComparatorByPointer);
+    LOG("%s %s", names[i], timer.getInterval("long keys, comparator pointer").c_str());
+
+    MemoryBlock inlined(bytes, BUFFER_LENGTH);
+    fillLongKeys(inlined, KV_COUNT);
+    timer.reset();
+    inlined.sort(types[i], &NativeObjectFactory::LongComparator);
+    LOG("%s %s", names[i], timer.getInterval("long keys, inlined comparator").c_str());
+  }
+  delete [] bytes;
+}
@@ -0,0 +1,317 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * nttest-bench, end to end benchmark of the native map output path:
+ * collect, sort, spill and the final merge of MapOutputCollector over
+ * generated workloads. Arguments are key=value pairs, the bench.* keys
+ * below select the workload and everything else is passed to the
+ * collector, e.g.
+ *
+ *   nttest-bench bench.records=4000000 bench.distribution=zipf \
+ *       mapreduce.task.io.sort.mb=64 native.sort.type=DUALPIVOTSORT
+ *
+ * bench.records         records per run, default 1000000
+ * bench.partitions      number of partitions, default 8
+ * bench.key.type        text (16 digit decimal) or long, default text
+ * bench.value.length    value bytes, default 32
+ * bench.distribution    uniform, zipf, sorted, reverse or all, default all
+ * bench.zipf.keys       distinct zipf keys, default records / 16
+ * bench.zipf.exponent   zipf exponent, default 1.0
+ * bench.seed            workload seed, default 1
+ * bench.repeat          runs per distribution, default 3
+ * bench.dir             directory of the spills and output, default .
+ * bench.output          result file, default stdout
+ *
+ * Every run writes one JSON object per line, the workloads only depend on
+ * the seed so results of different builds can be compared run by run.
+ */
+
+#include <algorithm>
+#include <math.h>
+#include "lib/commons.h"
+#include "util/StringUtil.h"
+#include "util/Timer.h"
+#include "lib/FileSystem.h"
+#include "lib/MapOutputCollector.h"
+#include "lib/NativeObjectFactory.h"
+#include "lib/TaskCounters.h"
+
+namespace NativeTask {
+
+class BenchSpillOutputService : public SpillOutputService {
+private:
+  string _prefix;
+  uint32_t _spillCount;
+
+public:
+  BenchSpillOutputService(const string & prefix)
+      : _prefix(prefix), _spillCount(0) {
+  }
+
+  virtual string * getSpillPath() {
+    return new string(StringUtil::Format("%s.spill%u", _prefix.c_str(), _spillCount++));
+  }
+
+  virtual string * getOutputPath() {
+    return new string(_prefix + ".out");
+  }
+
+  virtual string * getOutputIndexPath() {
+    return new string(_prefix + ".out.index");
+  }
+
+  virtual CombineHandler * getJavaCombineHandler() {
+    return NULL;
+  }
+
+  uint32_t getSpillCount() {
+    return _spillCount;
+  }
+};
+
+/**
+ * splitmix64, the workloads must not depend on the C library rand()
+ */
+class BenchRandom {
+private:
+  uint64_t _state;
+
+public:
+  BenchRandom(uint64_t seed)
+      : _state(seed) {
+  }
+
+  uint64_t next() {
+    uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  double nextDouble() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+};
+
+struct BenchWorkload {
+  string distribution;
+  bool longKey;
+  uint32_t keyLength;
+  uint32_t valueLength;
+  uint32_t records;
+  uint32_t partitions;
+  // keys and values of all the records, packed back to back
+  string data;
+  vector<uint32_t> partitionIds;
+};
+
+static void generateKeyIds(const string & distribution, Config & config, uint32_t records,
+    BenchRandom & random, vector<uint64_t> & ids) {
+  ids.resize(records);
+  if (distribution == "uniform") {
+    for (uint32_t i = 0; i < records; i++) {
+      ids[i] = random.next() % records;
+    }
+  } else if (distribution == "sorted") {
+    for (uint32_t i = 0; i < records; i++) {
+      ids[i] = i;
+    }
+  } else if (distribution == "reverse") {
+    for (uint32_t i = 0; i < records; i++) {
+      ids[i] = records - 1 - i;
+    }
+  } else if (distribution == "zipf") {
+    uint32_t keys = (uint32_t)config.getInt("bench.zipf.keys", std::max(records / 16, 1U));
+    double exponent = config.getFloat("bench.zipf.exponent", 1.0f);
+    vector<double> cdf(std::max(keys, 1U));
+    double sum = 0;
+    for (uint32_t i = 0; i < cdf.size(); i++) {
+      sum += 1.0 / pow(i + 1.0, exponent);
+      cdf[i] = sum;
+    }
+    // spread the ranks over the key space, the hot keys are not the smallest
+    uint64_t stride = 0x9E3779B97F4A7C15ULL | 1;
+    for (uint32_t i = 0; i < records; i++) {
+      double u = random.nextDouble() * sum;
+      uint64_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+      ids[i] = (rank * stride) % 10000000000000000ULL;
+    }
+  } else {
+    THROW_EXCEPTION_EX(UnsupportException, "unknown bench.distribution: %s",
+        distribution.c_str());
+  }
+}
+
+static void generateWorkload(BenchWorkload & workload, Config & config, uint64_t seed) {
+  BenchRandom random(seed);
+  vector<uint64_t> ids;
+  generateKeyIds(workload.distribution, config, workload.records, random, ids);
+
+  workload.keyLength = workload.longKey ? 8 : 16;
+  workload.data.resize(
+      (uint64_t)workload.records * (workload.keyLength + workload.valueLength));
+  workload.partitionIds.resize(workload.records);
+  char * pos = const_cast<char *>(workload.data.data());
+  for (uint32_t i = 0; i < workload.records; i++) {
+    // equal keys always go to the same partition, like HashPartitioner
+    workload.partitionIds[i] = (uint32_t)((ids[i] * 0x9E3779B97F4A7C15ULL) >> 32)
+        % workload.partitions;
+    if (workload.longKey) {
+      // LongWritable is big endian, flip the sign bit so the byte order of
+      // the generated keys matches their numeric order
+      uint64_t key = bswap64(ids[i] ^ 0x8000000000000000ULL);
+      memcpy(pos, &key, 8);
+    } else {
+      snprintf(pos, 17, "%016llu", (unsigned long long)(ids[i] % 10000000000000000ULL));
+    }
+    pos += workload.keyLength;
+    for (uint32_t j = 0; j < workload.valueLength; j++) {
+      pos[j] = 'a' + random.next() % 26;
+    }
+    pos += workload.valueLength;
+  }
+}
+
+static uint64_t getPhaseMicros(const char * name) {
+  return NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP, name)->get();
+}
+
+static void runWorkload(BenchWorkload & workload, Config & config, uint32_t run,
+    uint64_t seed, FILE * result) {
+  const char * phases[] = {TaskCounters::SORT_MICROS, TaskCounters::SPILL_MICROS,
+      TaskCounters::COMPRESS_MICROS, TaskCounters::CHECKSUM_MICROS, TaskCounters::MERGE_MICROS};
+  const uint32_t numPhases = sizeof(phases) / sizeof(phases[0]);
+
+  string prefix = config.get("bench.dir", ".") + "/nttest-bench";
+  BenchSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(workload.partitions, &service);
+  collector->configure(&config);
+
+  uint64_t phaseBase[numPhases];
+  for (uint32_t i = 0; i < numPhases; i++) {
+    phaseBase[i] = getPhaseMicros(phases[i]);
+  }
+
+  const uint32_t recordLength = workload.keyLength + workload.valueLength;
+  const char * pos = workload.data.data();
+  Timer timer;
+  for (uint32_t i = 0; i < workload.records; i++) {
+    collector->collect(pos, workload.keyLength, pos + workload.keyLength, workload.valueLength,
+        workload.partitionIds[i]);
+    pos += recordLength;
+  }
+  uint64_t collectNanos = timer.now() - timer.last();
+  timer.reset();
+  collector->close();
+  uint64_t closeNanos = timer.now() - timer.last();
+  delete collector;
+
+  uint64_t outputBytes = FileSystem::getLocal().getLength(prefix + ".out");
+  FileSystem::getLocal().remove(prefix + ".out");
+  FileSystem::getLocal().remove(prefix + ".out.index");
+
+  uint64_t totalNanos = collectNanos + closeNanos;
+  uint64_t inputBytes = workload.data.length();
+  string line = StringUtil::Format(
+      "{\"distribution\":\"%s\",\"key_type\":\"%s\",\"records\":%u,\"partitions\":%u,"
+      "\"seed\":%llu,\"run\":%u,\"input_bytes\":%llu,\"output_bytes\":%llu,\"spills\":%u,"
+      "\"collect_us\":%llu,\"close_us\":%llu,\"total_us\":%llu,\"mb_per_sec\":%.2f",
+      workload.distribution.c_str(), workload.longKey ? "long" : "text", workload.records,
+      workload.partitions, (unsigned long long)seed, run, (unsigned long long)inputBytes,
+      (unsigned long long)outputBytes, service.getSpillCount(),
+      (unsigned long long)(collectNanos / 1000), (unsigned long long)(closeNanos / 1000),
+      (unsigned long long)(totalNanos / 1000),
+      totalNanos > 0 ? inputBytes * 1000.0 / totalNanos : 0.0);
+  for (uint32_t i = 0; i < numPhases; i++) {
+    line.append(StringUtil::Format(",\"%s\":%llu", StringUtil::ToLower(phases[i]).c_str(),
+        (unsigned long long)(getPhaseMicros(phases[i]) - phaseBase[i])));
+  }
+  line.append("}\n");
+  fputs(line.c_str(), result);
+  fflush(result);
+}
+
+int BenchMain(int argc, const char ** argv) {
+  Config config;
+  config.parse(argc - 1, argv + 1);
+
+  BenchWorkload workload;
+  workload.records = (uint32_t)config.getInt("bench.records", 1000000);
+  workload.partitions = (uint32_t)config.getInt("bench.partitions", 8);
+  workload.valueLength = (uint32_t)config.getInt("bench.value.length", 32);
+  string keyType = config.get("bench.key.type", "text");
+  if (keyType != "text" && keyType != "long") {
+    THROW_EXCEPTION_EX(UnsupportException, "unknown bench.key.type: %s", keyType.c_str());
+  }
+  workload.longKey = keyType == "long";
+  if (NULL == config.get(MAPRED_MAPOUTPUT_KEY_CLASS)) {
+    config.set(MAPRED_MAPOUTPUT_KEY_CLASS,
+        workload.longKey ? "org.apache.hadoop.io.LongWritable" : "org.apache.hadoop.io.Text");
+  }
+  if (NULL == config.get(MAPRED_MAPOUTPUT_VALUE_CLASS)) {
+    config.set(MAPRED_MAPOUTPUT_VALUE_CLASS, "org.apache.hadoop.io.Text");
+  }
+  if (NULL == config.get(MAPRED_IO_SORT_MB)) {
+    config.setInt(MAPRED_IO_SORT_MB, 100);
+  }
+  const uint64_t seed = config.getInt("bench.seed", 1);
+  const uint32_t repeat = (uint32_t)config.getInt("bench.repeat", 3);
+
+  vector<string> distributions;
+  string distribution = config.get("bench.distribution", "all");
+  if (distribution == "all") {
+    distributions.push_back("uniform");
+    distributions.push_back("zipf");
+    distributions.push_back("sorted");
+    distributions.push_back("reverse");
+  } else {
+    StringUtil::Split(distribution, ",", distributions, true);
+  }
+
+  string output = config.get("bench.output", "");
+  FILE * result = output.length() > 0 ? fopen(output.c_str(), "w") : stdout;
+  if (NULL == result) {
+    THROW_EXCEPTION_EX(IOException, "can not open bench.output: %s", output.c_str());
+  }
+  for (size_t i = 0; i < distributions.size(); i++) {
+    workload.distribution = distributions[i];
+    generateWorkload(workload, config, seed);
+    for (uint32_t run = 0; run < repeat; run++) {
+      runWorkload(workload, config, run, seed, result);
+    }
+  }
+  if (result != stdout) {
+    fclose(result);
+  }
+  return 0;
+}
+
+} // namespace NativeTask
+
+int main(int argc, const char ** argv) {
+  try {
+    int ret = NativeTask::BenchMain(argc, argv);
+    NativeTask::NativeObjectFactory::Release();
+    return ret;
+  } catch (std::exception & e) {
+    fprintf(stderr, "Exception: %s\n", e.what());
+    NativeTask::NativeObjectFactory::Release();
+    return 1;
+  }
+}
@@ -0,0 +1,170 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "lib/Combiner.h"
+#include "lib/IFile.h"
+#include "test_commons.h"
+
+namespace NativeTask {
+
+class VectorKVIterator : public KVIterator {
+private:
+  const std::vector<std::pair<string, string> > & _kvs;
+  uint32_t _index;
+
+public:
+  VectorKVIterator(const std::vector<std::pair<string, string> > & kvs)
+      : _kvs(kvs), _index(0) {
+  }
+
+  bool next(Buffer & key, Buffer & value) {
+    if (_index >= _kvs.size()) {
+      return false;
+    }
+    key.reset(_kvs[_index].first.data(), _kvs[_index].first.length());
+    value.reset(_kvs[_index].second.data(), _kvs[_index].second.length());
+    _index++;
+    return true;
+  }
+};
+
+class CollectingIFileWriter : public IFileWriter {
+public:
+  std::vector<std::pair<string, string> > kvs;
+
+  CollectingIFileWriter()
+      : IFileWriter(NULL, CHECKSUM_NONE, TextType, LongType, "", NULL) {
+  }
+
+  virtual void write(const char * key, uint32_t keyLen, const char * value, uint32_t valueLen) {
+    kvs.push_back(std::make_pair(string(key, keyLen), string(value, valueLen)));
+  }
+};
+
+static string longValue(int64_t value) {
+  uint64_t v = bswap64((uint64_t)value);
+  return string((const char *)&v, 8);
+}
+
+static string intValue(int32_t value) {
+  uint32_t v = bswap((uint32_t)value);
+  return string((const char *)&v, 4);
+}
+
+TEST(NativeCombiner, longValues) {
+  std::vector<std::pair<string, string> > input;
+  input.push_back(std::make_pair(string("a"), longValue(3)));
+  input.push_back(std::make_pair(string("a"), longValue(-5)));
+  input.push_back(std::make_pair(string("a"), longValue(10)));
+  input.push_back(std::make_pair(string("b"), longValue(7)));
+  input.push_back(std::make_pair(string("c"), longValue(1)));
+  input.push_back(std::make_pair(string("c"), longValue(1)));
+
+  const char * names[] = {"NativeTask.SumCombiner", "NativeTask.MinCombiner",
+      "NativeTask.MaxCombiner"};
+  const int64_t expectA[] = {8, -5, 10};
+  const int64_t expectC[] = {2, 1, 1};
+  for (uint32_t i = 0; i < 3; i++) {
+    NativeCombiner * combiner = NativeCombiner::create(names[i], LongType);
+    ASSERT_TRUE(NULL != combiner);
+    VectorKVIterator iterator(input);
+    CollectingIFileWriter writer;
+    combiner->combine(CombineContext(UNKNOWN), &iterator, &writer);
+    delete combiner;
+
+    ASSERT_EQ(3, writer.kvs.size());
+    ASSERT_EQ("a", writer.kvs[0].first);
+    ASSERT_EQ(longValue(expectA[i]), writer.kvs[0].second);
+    ASSERT_EQ("b", writer.kvs[1].first);
+    ASSERT_EQ(longValue(7), writer.kvs[1].second);
+    ASSERT_EQ("c", writer.kvs[2].first);
+    ASSERT_EQ(longValue(expectC[i]), writer.kvs[2].second);
+  }
+}
+
+TEST(NativeCombiner, intValues) {
+  std::vector<std::pair<string, string> > input;
+  input.push_back(std::make_pair(string("word"), intValue(0x7fffffff)));
+  input.push_back(std::make_pair(string("word"), intValue(1)));
+
+  NativeCombiner * combiner = NativeCombiner::create("NativeTask.SumCombiner", IntType);
+  VectorKVIterator iterator(input);
+  CollectingIFileWriter writer;
+  combiner->combine(CombineContext(UNKNOWN), &iterator, &writer);
+  delete combiner;
+
+  // overflows like IntSumReducer
+  ASSERT_EQ(1, writer.kvs.size());
+  ASSERT_EQ(intValue((int32_t)0x80000000), writer.kvs[0].second);
+}
+
+TEST(NativeCombiner, grouping) {
+  std::vector<std::pair<string, string> > input;
+  input.push_back(std::make_pair(string("a\t1"), longValue(3)));
+  input.push_back(std::make_pair(string("a\t2"), longValue(4)));
+  input.push_back(std::make_pair(string("a\t2"), longValue(1)));
+  input.push_back(std::make_pair(string("ab"), longValue(5)));
+  input.push_back(std::make_pair(string("b\t0"), longValue(6)));
+
+  Config config;
+  config.set(MAPRED_COMBINER_GROUPING_COMPARATOR, "org.example.NaturalKeyComparator");
+  config.set(string(NATIVE_GROUPING_COMPARATOR) + ".org.example.NaturalKeyComparator",
+      "separator:\t");
+  KeyGrouping grouping;
+  KeyGrouping::getGroupingFromConfig(&config, MAPRED_COMBINER_GROUPING_COMPARATOR, grouping);
+  ASSERT_EQ('\t', grouping.separator);
+
+  NativeCombiner * combiner = NativeCombiner::create("NativeTask.SumCombiner", LongType);
+  combiner->setGrouping(grouping);
+  VectorKVIterator iterator(input);
+  CollectingIFileWriter writer;
+  combiner->combine(CombineContext(UNKNOWN), &iterator, &writer);
+  delete combiner;
+
+  // the last key of each group
+  ASSERT_EQ(3, writer.kvs.size());
+  ASSERT_EQ("a\t2", writer.kvs[0].first);
+  ASSERT_EQ(longValue(8), writer.kvs[0].second);
+  ASSERT_EQ("ab", writer.kvs[1].first);
+  ASSERT_EQ(longValue(5), writer.kvs[1].second);
+  ASSERT_EQ("b\t0", writer.kvs[2].first);
+  ASSERT_EQ(longValue(6), writer.kvs[2].second);
+
+  config.set(string(NATIVE_GROUPING_COMPARATOR) + ".org.example.NaturalKeyComparator",
+      "separator:9");
+  KeyGrouping::getGroupingFromConfig(&config, MAPRED_COMBINER_GROUPING_COMPARATOR, grouping);
+  ASSERT_EQ(9, grouping.separator);
+  config.set(string(NATIVE_GROUPING_COMPARATOR) + ".org.example.NaturalKeyComparator",
+      "prefix:0");
+  ASSERT_THROW(KeyGrouping::getGroupingFromConfig(&config, MAPRED_COMBINER_GROUPING_COMPARATOR,
+      grouping), IOException);
+}
+
+TEST(NativeCombiner, unsupported) {
+  ASSERT_TRUE(NULL == NativeCombiner::create("org.example.MyCombiner", LongType));
+  bool thrown = false;
+  try {
+    delete NativeCombiner::create("NativeTask.SumCombiner", TextType);
+  } catch (UnsupportException & e) {
+    thrown = true;
+  }
+  ASSERT_TRUE(thrown);
+}
+
+} // namespace NativeTask
@@ -72,7 +72,7 @@ TEST(ComparatorForDualPivotQuickSort, compare) {
   char * value2 = kv2->getValue();
   ::memcpy(value2, VALUE2, strlen(VALUE2));
 
-  ComparatorForDualPivotSort comparator(buff, &MockComparatorForDualPivot);
+  ComparatorForDualPivotSort comparator(buff, 0, &MockComparatorForDualPivot);
 
   expectedSrc = kv1->getKey();
   expectedSrcLength = strlen(KEY);
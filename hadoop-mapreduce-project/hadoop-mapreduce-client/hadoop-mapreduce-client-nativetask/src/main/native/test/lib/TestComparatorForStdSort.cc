@@ -72,7 +72,7 @@ TEST(ComparatorForStdSort, compare) {
   char * value2 = kv2->getValue();
   ::memcpy(value2, VALUE2, strlen(VALUE2));
 
-  ComparatorForStdSort comparator(buff, &MockComparatorForStdOut);
+  ComparatorForStdSort comparator(buff, 0, &MockComparatorForStdOut);
 
   expectedSrc = kv1->content;
   expectedSrcLength = strlen(KEY);
@@ -0,0 +1,131 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/ThreadPool.h"
+#include "test_commons.h"
+
+class LogTask : public Runnable {
+private:
+  uint32_t _id;
+  uint32_t _messages;
+
+public:
+  LogTask(uint32_t id, uint32_t messages)
+      : _id(id), _messages(messages) {
+  }
+
+  virtual void run() {
+    for (uint32_t i = 0; i < _messages; i++) {
+      LOG("[TestLog] thread %u message %u", _id, i);
+    }
+  }
+};
+
+TEST(Log, async) {
+  const uint32_t THREADS = 4;
+  const uint32_t MESSAGES = 5000;
+  FILE * device = tmpfile();
+  ASSERT_TRUE(NULL != device);
+  FILE * saved = LOG_DEVICE;
+  LOG_DEVICE = device;
+  AsyncLog::start();
+  ASSERT_TRUE(AsyncLog::running());
+
+  string longValue(2000, 'x');
+  LOG("[TestLog] long %s", longValue.c_str());
+  vector<LogTask> tasks;
+  for (uint32_t i = 0; i < THREADS; i++) {
+    tasks.push_back(LogTask(i, MESSAGES));
+  }
+  {
+    ThreadPool pool(THREADS);
+    for (uint32_t i = 0; i < THREADS; i++) {
+      pool.submit(&tasks[i]);
+    }
+  }
+  AsyncLog::stop();
+  ASSERT_FALSE(AsyncLog::running());
+  LOG_DEVICE = saved;
+
+  rewind(device);
+  vector<uint32_t> next(THREADS, 0);
+  uint32_t lines = 0;
+  bool longFound = false;
+  char line[4096];
+  while (NULL != fgets(line, sizeof(line), device)) {
+    ASSERT_EQ('\n', line[strlen(line) - 1]);
+    lines++;
+    uint32_t id, message;
+    const char * pos = strstr(line, "[TestLog] ");
+    ASSERT_TRUE(NULL != pos);
+    if (2 == sscanf(pos, "[TestLog] thread %u message %u", &id, &message)) {
+      // the ring fills up, the messages of a thread still keep their order
+      ASSERT_EQ(next[id], message);
+      next[id]++;
+    } else {
+      ASSERT_EQ(string("[TestLog] long ") + longValue + "\n", string(pos));
+      longFound = true;
+    }
+  }
+  fclose(device);
+  ASSERT_TRUE(longFound);
+  ASSERT_EQ(THREADS * MESSAGES + 1, lines);
+}
+
+TEST(Log, stopWhileLogging) {
+  const uint32_t THREADS = 4;
+  const uint32_t MESSAGES = 5000;
+  FILE * device = tmpfile();
+  ASSERT_TRUE(NULL != device);
+  FILE * saved = LOG_DEVICE;
+  LOG_DEVICE = device;
+  AsyncLog::start();
+
+  vector<LogTask> tasks;
+  for (uint32_t i = 0; i < THREADS; i++) {
+    tasks.push_back(LogTask(i, MESSAGES));
+  }
+  {
+    ThreadPool pool(THREADS);
+    for (uint32_t i = 0; i < THREADS; i++) {
+      pool.submit(&tasks[i]);
+    }
+    usleep(1000);
+    // the messages queued up to here are written, later ones are printed
+    // directly
+    AsyncLog::stop();
+  }
+  LOG_DEVICE = saved;
+
+  rewind(device);
+  vector<vector<bool> > seen(THREADS, vector<bool>(MESSAGES, false));
+  uint32_t lines = 0;
+  char line[4096];
+  while (NULL != fgets(line, sizeof(line), device)) {
+    uint32_t id, message;
+    const char * pos = strstr(line, "[TestLog] ");
+    ASSERT_TRUE(NULL != pos);
+    ASSERT_EQ(2, sscanf(pos, "[TestLog] thread %u message %u", &id, &message));
+    ASSERT_FALSE(seen[id][message]);
+    seen[id][message] = true;
+    lines++;
+  }
+  fclose(device);
+  ASSERT_EQ(THREADS * MESSAGES, lines);
+}
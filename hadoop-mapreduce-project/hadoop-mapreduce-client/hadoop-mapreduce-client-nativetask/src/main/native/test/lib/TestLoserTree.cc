@@ -0,0 +1,89 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "lib/LoserTree.h"
+#include "test_commons.h"
+
+namespace NativeTask {
+
+struct IntSource {
+  const vector<int> * values;
+  uint32_t pos;
+
+  int current() const {
+    return (*values)[pos];
+  }
+};
+
+typedef IntSource * IntSourcePtr;
+
+class IntSourceComparator {
+public:
+  bool operator()(const IntSourcePtr lhs, const IntSourcePtr rhs) {
+    return lhs->current() < rhs->current();
+  }
+};
+
+static void mergeAndVerify(uint32_t sourceCount) {
+  Random r(sourceCount);
+  vector<vector<int> > values(sourceCount);
+  vector<IntSource> sources(sourceCount);
+  vector<IntSourcePtr> nonEmpty;
+  vector<int> expect;
+  for (uint32_t i = 0; i < sourceCount; i++) {
+    // leave some sources empty
+    uint32_t length = (i % 3 == 1) ? 0 : r.next_int32(100);
+    for (uint32_t j = 0; j < length; j++) {
+      values[i].push_back(r.next_int32(1000));
+    }
+    std::sort(values[i].begin(), values[i].end());
+    expect.insert(expect.end(), values[i].begin(), values[i].end());
+    sources[i].values = &values[i];
+    sources[i].pos = 0;
+    if (length > 0) {
+      nonEmpty.push_back(&sources[i]);
+    }
+  }
+  std::sort(expect.begin(), expect.end());
+
+  LoserTree<IntSourcePtr, IntSourceComparator> tree((IntSourceComparator()));
+  tree.init(nonEmpty);
+  ASSERT_EQ(nonEmpty.size(), tree.size());
+
+  vector<int> actual;
+  while (!tree.empty()) {
+    IntSourcePtr top = tree.top();
+    actual.push_back(top->current());
+    if (++top->pos < top->values->size()) {
+      tree.adjust();
+    } else {
+      tree.pop();
+    }
+  }
+  ASSERT_EQ(expect, actual);
+}
+
+TEST(LoserTree, merge) {
+  for (uint32_t k = 0; k <= 33; k++) {
+    mergeAndVerify(k);
+  }
+  mergeAndVerify(128);
+}
+
+} // namespace NativeTask
@@ -0,0 +1,638 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "test_commons.h"
+#include "lib/Compressions.h"
+#include "lib/FileSystem.h"
+#include "lib/IFile.h"
+#include "lib/MapOutputCollector.h"
+#include "lib/NativeObjectFactory.h"
+#include "lib/TaskCounters.h"
+#include "lib/TieredFileSystem.h"
+
+namespace NativeTask {
+
+class TestSpillOutputService : public SpillOutputService {
+private:
+  string _prefix;
+  uint32_t _spillCount;
+
+public:
+  TestSpillOutputService(const string & prefix)
+      : _prefix(prefix), _spillCount(0) {
+  }
+
+  virtual string * getSpillPath() {
+    return new string(StringUtil::Format("%s.spill%u", _prefix.c_str(), _spillCount++));
+  }
+
+  virtual string * getOutputPath() {
+    return new string(_prefix + ".out");
+  }
+
+  virtual string * getOutputIndexPath() {
+    return new string(_prefix + ".out.index");
+  }
+
+  virtual CombineHandler * getJavaCombineHandler() {
+    return NULL;
+  }
+
+  uint32_t getSpillCount() {
+    return _spillCount;
+  }
+};
+
+static void setCollectorConfig(Config & config) {
+  config.set(MAPRED_MAPOUTPUT_KEY_CLASS, "org.apache.hadoop.io.Text");
+  config.set(MAPRED_MAPOUTPUT_VALUE_CLASS, "org.apache.hadoop.io.Text");
+  config.setInt(MAPRED_IO_SORT_MB, 1);
+}
+
+/**
+ * read map output back through its index file
+ */
+static void readMapOutput(const string & prefix, uint32_t numPartitions,
+    vector<vector<pair<string, string> > > & partitions, KeyValueType valueType = TextType) {
+  string index;
+  ReadFile(index, prefix + ".out.index");
+  ASSERT_GE(index.length(), numPartitions * 24);
+  IFileSegment * segments = new IFileSegment[numPartitions];
+  uint64_t uncompressed = 0;
+  for (uint32_t i = 0; i < numPartitions; i++) {
+    const uint64_t * entry = (const uint64_t *)(index.data() + i * 24);
+    uncompressed += bswap64(entry[1]);
+    segments[i].uncompressedEndOffset = uncompressed;
+    segments[i].realEndOffset = bswap64(entry[0]) + bswap64(entry[2]);
+  }
+  SingleSpillInfo info(segments, numPartitions, prefix + ".out", CHECKSUM_CRC32, TextType,
+      valueType, "");
+  InputStream * fin = FileSystem::getLocal().open(info.path);
+  IFileReader * reader = new IFileReader(fin, &info);
+  partitions.clear();
+  while (reader->nextPartition()) {
+    partitions.push_back(vector<pair<string, string> >());
+    const char * key;
+    uint32_t keyLen;
+    while (NULL != (key = reader->nextKey(keyLen))) {
+      uint32_t valueLen;
+      const char * value = reader->value(valueLen);
+      partitions.back().push_back(std::make_pair(string(key, keyLen), string(value, valueLen)));
+    }
+  }
+  delete reader;
+  delete fin;
+}
+
+/**
+ * check the sorted keys of each partition and remove the output
+ */
+static void verifyMapOutput(const string & prefix, vector<vector<string> > & expectKeys) {
+  const uint32_t numPartitions = expectKeys.size();
+  vector<vector<pair<string, string> > > partitions;
+  readMapOutput(prefix, numPartitions, partitions);
+  ASSERT_EQ(numPartitions, partitions.size());
+  for (uint32_t i = 0; i < numPartitions; i++) {
+    std::sort(expectKeys[i].begin(), expectKeys[i].end());
+    ASSERT_EQ(expectKeys[i].size(), partitions[i].size());
+    for (uint32_t j = 0; j < partitions[i].size(); j++) {
+      ASSERT_EQ(expectKeys[i][j], partitions[i][j].first);
+    }
+  }
+  FileSystem::getLocal().remove(prefix + ".out");
+  FileSystem::getLocal().remove(prefix + ".out.index");
+}
+
+static void collectAndVerify(Config & config, const string & prefix) {
+  const uint32_t NUM_PARTITIONS = 8;
+  const uint32_t NUM_RECORDS = 100000;
+
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+
+  vector<pair<string, string> > inputs;
+  Generate(inputs, NUM_RECORDS, "word");
+  vector<vector<string> > expectKeys(NUM_PARTITIONS);
+  for (uint32_t i = 0; i < inputs.size(); i++) {
+    const string & key = inputs[i].first;
+    const string & value = inputs[i].second;
+    uint32_t partition = i % NUM_PARTITIONS;
+    collector->collect(key.data(), key.length(), value.data(), value.length(), partition);
+    expectKeys[partition].push_back(key);
+  }
+  collector->close();
+  delete collector;
+
+  verifyMapOutput(prefix, expectKeys);
+}
+
+TEST(MapOutputCollector, sortAndSpill) {
+  Config config;
+  setCollectorConfig(config);
+  collectAndVerify(config, "collector_serial");
+}
+
+TEST(MapOutputCollector, plainHeaders) {
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SORT_COMPACT_HEADERS, false);
+  collectAndVerify(config, "collector_plain_headers");
+}
+
+TEST(MapOutputCollector, parallelSortAndSpill) {
+  Config config;
+  setCollectorConfig(config);
+  config.setInt(NATIVE_SORT_THREADS, 4);
+  collectAndVerify(config, "collector_parallel");
+}
+
+TEST(MapOutputCollector, parallelSortSinglePartition) {
+  // one bucket of many memory blocks, which are sorted concurrently
+  Config config;
+  setCollectorConfig(config);
+  config.setInt(NATIVE_SORT_THREADS, 4);
+  config.setInt(NATIVE_SORT_MAX_BLOCK_SIZE, 64 * 1024);
+  const char * prefix = "collector_parallel_single";
+
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(1, &service);
+  collector->configure(&config);
+
+  vector<pair<string, string> > inputs;
+  Generate(inputs, 100000, "word");
+  vector<vector<string> > expectKeys(1);
+  for (uint32_t i = 0; i < inputs.size(); i++) {
+    const string & key = inputs[i].first;
+    const string & value = inputs[i].second;
+    collector->collect(key.data(), key.length(), value.data(), value.length(), 0);
+    expectKeys[0].push_back(key);
+  }
+  collector->close();
+  delete collector;
+
+  verifyMapOutput(prefix, expectKeys);
+}
+
+TEST(MapOutputCollector, backgroundSpill) {
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SPILL_ASYNC, true);
+  config.set(MAPRED_SORT_SPILL_PERCENT, "0.5");
+  collectAndVerify(config, "collector_async");
+}
+
+TEST(MapOutputCollector, hardLimit) {
+  Config config;
+  setCollectorConfig(config);
+  config.setInt(NATIVE_MEMORY_POOL_HARD_LIMIT, 2);
+  collectAndVerify(config, "collector_hard_limit");
+}
+
+TEST(MapOutputCollector, streamMerge) {
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_MERGE_MMAP, false);
+  collectAndVerify(config, "collector_stream_merge");
+}
+
+TEST(MapOutputCollector, dropSpillCache) {
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SPILL_DROP_CACHE, true);
+  collectAndVerify(config, "collector_drop_cache");
+}
+
+TEST(MapOutputCollector, mergeFactor) {
+  Config config;
+  setCollectorConfig(config);
+  config.setInt(MAPRED_IO_SORT_FACTOR, 2);
+  collectAndVerify(config, "collector_merge_factor");
+}
+
+TEST(MapOutputCollector, prefixKeys) {
+  // front coded intermediate spills and merges, with and without gather,
+  // the final output is plain
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SPILL_PREFIX_KEYS, true);
+  config.setInt(MAPRED_IO_SORT_FACTOR, 2);
+  config.setInt(NATIVE_MERGE_THREADS, 3);
+  collectAndVerify(config, "collector_prefix_keys");
+  config.setBool(NATIVE_SPILL_WRITEV, false);
+  config.setBool(NATIVE_MERGE_MMAP, false);
+  collectAndVerify(config, "collector_prefix_keys_copy");
+}
+
+TEST(MapOutputCollector, parallelMerge) {
+  Config config;
+  setCollectorConfig(config);
+  config.setInt(NATIVE_MERGE_THREADS, 3);
+  config.setInt(MAPRED_IO_SORT_FACTOR, 3);
+  collectAndVerify(config, "collector_parallel_merge");
+}
+
+TEST(MapOutputCollector, segmentHashSpill) {
+  // intermediate merges read and write hashed spills, the final output
+  // is read back with its CRC32 checksum
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SPILL_SEGMENT_HASH, true);
+  config.setInt(MAPRED_IO_SORT_FACTOR, 2);
+  collectAndVerify(config, "collector_segment_hash");
+  config.setBool(NATIVE_MERGE_MMAP, false);
+  collectAndVerify(config, "collector_segment_hash_stream");
+  config.setInt(NATIVE_MERGE_THREADS, 3);
+  collectAndVerify(config, "collector_segment_hash_parallel");
+}
+
+TEST(MapOutputCollector, tieredSpill) {
+  Config config;
+  setCollectorConfig(config);
+  config.set(NATIVE_SPILL_FILESYSTEM, "tiered");
+  // some spills stay in memory, the others overflow to disk
+  config.setInt(NATIVE_SPILL_TIERED_MEMORY_MB, 2);
+  config.setInt(MAPRED_IO_SORT_FACTOR, 3);
+  collectAndVerify(config, "collector_tiered");
+  config.setInt(NATIVE_MERGE_THREADS, 3);
+  collectAndVerify(config, "collector_tiered_parallel");
+  // all spills are removed after the final merge
+  ASSERT_EQ(0, TieredFileSystem::getInstance().getMemoryUsed());
+}
+
+TEST(MapOutputCollector, spillCodec) {
+  // intermediate spills are lz4, the final output stays uncompressed
+  Config config;
+  setCollectorConfig(config);
+  config.set(NATIVE_SPILL_CODEC, Compressions::Lz4Codec.name);
+  config.setInt(MAPRED_IO_SORT_FACTOR, 3);
+  collectAndVerify(config, "collector_spill_codec");
+  config.setInt(NATIVE_MERGE_THREADS, 3);
+  collectAndVerify(config, "collector_spill_codec_parallel");
+  // the tiered file system compresses by default, an empty codec turns it off
+  config.set(NATIVE_SPILL_FILESYSTEM, "tiered");
+  config.set(NATIVE_SPILL_CODEC, "");
+  collectAndVerify(config, "collector_spill_codec_tiered");
+  ASSERT_EQ(0, TieredFileSystem::getInstance().getMemoryUsed());
+
+  config.set(NATIVE_SPILL_CODEC, "org.apache.hadoop.io.compress.NoSuchCodec");
+  TestSpillOutputService service("collector_unknown_codec");
+  MapOutputCollector collector(1, &service);
+  ASSERT_THROW(collector.configure(&config), UnsupportException);
+}
+
+TEST(MapOutputCollector, unknownSpillFileSystem) {
+  Config config;
+  setCollectorConfig(config);
+  config.set(NATIVE_SPILL_FILESYSTEM, "nosuchfs");
+  TestSpillOutputService service("collector_unknown_fs");
+  MapOutputCollector collector(1, &service);
+  ASSERT_THROW(collector.configure(&config), UnsupportException);
+}
+
+TEST(MapOutputCollector, stripeSpillPath) {
+  vector<string> dirs;
+  dirs.push_back("/disk0/local");
+  dirs.push_back("/disk1/local");
+  dirs.push_back("/disk2/local");
+  const string path = "/disk0/local/usercache/app/output/spill3.out";
+  ASSERT_EQ("/disk0/local/usercache/app/output/spill3.out",
+      MapOutputCollector::stripeSpillPath(path, dirs, 0));
+  ASSERT_EQ("/disk2/local/usercache/app/output/spill3.out",
+      MapOutputCollector::stripeSpillPath(path, dirs, 5));
+  ASSERT_EQ("/disk1/local/usercache/app/output/spill3.out",
+      MapOutputCollector::stripeSpillPath("/disk2/local/usercache/app/output/spill3.out", dirs, 1));
+  // only whole path components match
+  ASSERT_EQ("/disk0/local2/spill3.out",
+      MapOutputCollector::stripeSpillPath("/disk0/local2/spill3.out", dirs, 1));
+  ASSERT_EQ("/tmp/spill3.out", MapOutputCollector::stripeSpillPath("/tmp/spill3.out", dirs, 1));
+}
+
+TEST(MapOutputCollector, stripedSpill) {
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SPILL_STRIPE, true);
+  config.set(MAPRED_LOCAL_DIR, "collector_stripe0/, collector_stripe1,collector_stripe2");
+  config.setInt(NATIVE_MERGE_THREADS, 3);
+  collectAndVerify(config, "collector_stripe0/output/collector_stripe");
+  for (int i = 0; i < 3; i++) {
+    FileSystem::getLocal().remove(StringUtil::Format("collector_stripe%d", i));
+  }
+}
+
+/**
+ * count the keys of a small key set with the sum combiner
+ * @return spills of the collector
+ */
+static uint32_t collectAndSum(bool inMemoryCombine, const string & prefix) {
+  const uint32_t NUM_PARTITIONS = 4;
+  const uint32_t NUM_KEYS = 1000;
+  const uint32_t NUM_RECORDS = 200000;
+
+  Config config;
+  setCollectorConfig(config);
+  config.set(MAPRED_MAPOUTPUT_VALUE_CLASS, "org.apache.hadoop.io.LongWritable");
+  config.set(NATIVE_COMBINER, "NativeTask.SumCombiner");
+  config.setBool(NATIVE_COMBINE_IN_MEMORY, inMemoryCombine);
+
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+  const int64_t one = (int64_t)bswap64(1);
+  for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+    string key = StringUtil::Format("key%04u", (i * 7919) % NUM_KEYS);
+    collector->collect(key.data(), key.length(), &one, sizeof(one), i % NUM_PARTITIONS);
+  }
+  collector->close();
+  delete collector;
+
+  vector<vector<pair<string, string> > > partitions;
+  readMapOutput(prefix, NUM_PARTITIONS, partitions, LongType);
+  uint32_t keys = 0;
+  for (uint32_t i = 0; i < partitions.size(); i++) {
+    for (uint32_t j = 0; j < partitions[i].size(); j++) {
+      const string & value = partitions[i][j].second;
+      EXPECT_EQ(8, value.length());
+      // every key is in one partition only
+      EXPECT_EQ(NUM_RECORDS / NUM_KEYS, bswap64(*(const uint64_t *)value.data()));
+      keys++;
+    }
+  }
+  EXPECT_EQ(NUM_KEYS, keys);
+  FileSystem::getLocal().remove(prefix + ".out");
+  FileSystem::getLocal().remove(prefix + ".out.index");
+  return service.getSpillCount();
+}
+
+TEST(MapOutputCollector, inMemoryCombine) {
+  uint32_t spills = collectAndSum(false, "collector_combine");
+  uint32_t combinedSpills = collectAndSum(true, "collector_combine_in_memory");
+  ASSERT_GT(spills, 1);
+  // everything fits after combining, only the final output is written
+  ASSERT_EQ(0, combinedSpills);
+}
+
+TEST(MapOutputCollector, sharedIndex) {
+  const uint32_t NUM_PARTITIONS = 4;
+  const string prefix = "collector_shared_index";
+  const string sharedIndex = "./attempt_1_0001_m_000000_0.index";
+
+  Config config;
+  setCollectorConfig(config);
+  config.set(NATIVE_SPILL_INDEX_SHARED_DIR, ".");
+  config.set(MAPRED_TASK_ATTEMPT_ID, "attempt_1_0001_m_000000_0");
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+
+  vector<pair<string, string> > inputs;
+  Generate(inputs, 100000, "word");
+  vector<vector<string> > expectKeys(NUM_PARTITIONS);
+  for (uint32_t i = 0; i < inputs.size(); i++) {
+    uint32_t partition = i % NUM_PARTITIONS;
+    collector->collect(inputs[i].first.data(), inputs[i].first.length(),
+        inputs[i].second.data(), inputs[i].second.length(), partition);
+    expectKeys[partition].push_back(inputs[i].first);
+  }
+  collector->close();
+  delete collector;
+
+  string index;
+  string shared;
+  ReadFile(index, prefix + ".out.index");
+  ReadFile(shared, sharedIndex);
+  ASSERT_EQ(index, shared);
+  ASSERT_FALSE(FileSystem::getLocal().exists(sharedIndex + ".tmp"));
+  FileSystem::getLocal().remove(sharedIndex);
+  verifyMapOutput(prefix, expectKeys);
+}
+
+static uint64_t nativeTaskCounter(const char * name) {
+  return NativeObjectFactory::GetCounter(TaskCounters::NATIVETASK_COUNTER_GROUP, name)->get();
+}
+
+TEST(MapOutputCollector, outputStatistics) {
+  // 1000 records of 28 bytes over partitions 0-2, 20 of 1008 bytes in
+  // partition 0, partition 3 stays empty
+  const uint32_t NUM_PARTITIONS = 4;
+  const string prefix = "collector_statistics";
+  uint64_t p50 = nativeTaskCounter(TaskCounters::MAP_OUTPUT_RECORD_BYTES_P50);
+  uint64_t p90 = nativeTaskCounter(TaskCounters::MAP_OUTPUT_RECORD_BYTES_P90);
+  uint64_t p99 = nativeTaskCounter(TaskCounters::MAP_OUTPUT_RECORD_BYTES_P99);
+  uint64_t skew = nativeTaskCounter(TaskCounters::MAP_OUTPUT_PARTITION_SKEW_PERCENT);
+  uint64_t empty = nativeTaskCounter(TaskCounters::MAP_OUTPUT_EMPTY_PARTITIONS);
+
+  Config config;
+  setCollectorConfig(config);
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+  vector<vector<string> > expectKeys(NUM_PARTITIONS);
+  const string value(20, 'v');
+  const string largeValue(1000, 'v');
+  for (uint32_t i = 0; i < 1020; i++) {
+    string key = StringUtil::Format("key%05u", i);
+    uint32_t partition = i < 1000 ? i % 3 : 0;
+    const string & v = i < 1000 ? value : largeValue;
+    collector->collect(key.data(), key.length(), v.data(), v.length(), partition);
+    expectKeys[partition].push_back(key);
+  }
+  collector->close();
+  delete collector;
+  verifyMapOutput(prefix, expectKeys);
+
+  ASSERT_EQ(32, nativeTaskCounter(TaskCounters::MAP_OUTPUT_RECORD_BYTES_P50) - p50);
+  ASSERT_EQ(32, nativeTaskCounter(TaskCounters::MAP_OUTPUT_RECORD_BYTES_P90) - p90);
+  ASSERT_EQ(1024, nativeTaskCounter(TaskCounters::MAP_OUTPUT_RECORD_BYTES_P99) - p99);
+  // partition 0 holds about 30K of the 50K
+  skew = nativeTaskCounter(TaskCounters::MAP_OUTPUT_PARTITION_SKEW_PERCENT) - skew;
+  ASSERT_GE(skew, 200);
+  ASSERT_LT(skew, 300);
+  ASSERT_EQ(1, nativeTaskCounter(TaskCounters::MAP_OUTPUT_EMPTY_PARTITIONS) - empty);
+}
+
+TEST(MapOutputCollector, autotune) {
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_SORT_AUTOTUNE, true);
+  config.setInt(NATIVE_SORT_AUTOTUNE_RECORD_BYTES, 2048);
+  config.setInt(NATIVE_SORT_AUTOTUNE_PARTITION_SKEW, 400);
+  collectAndVerify(config, "collector_autotune");
+  config.setInt(NATIVE_SORT_AUTOTUNE_RECORD_BYTES, 64);
+  collectAndVerify(config, "collector_autotune_small");
+}
+
+TEST(MapOutputCollector, groupBy) {
+  const uint32_t NUM_PARTITIONS = 4;
+  const uint32_t NUM_RECORDS = 100000;
+  const string prefix = "collector_groupby";
+
+  Config config;
+  setCollectorConfig(config);
+  config.set(NATIVE_SORT_ORDER, "GROUPBY");
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+
+  // few distinct keys, large enough to spill several times
+  Random r(1234);
+  vector<vector<string> > expectKeys(NUM_PARTITIONS);
+  const string value(100, 'v');
+  for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+    string key = StringUtil::ToString(r.next_int32(1000));
+    uint32_t partition = i % NUM_PARTITIONS;
+    collector->collect(key.data(), key.length(), value.data(), value.length(), partition);
+    expectKeys[partition].push_back(key);
+  }
+  collector->close();
+  delete collector;
+
+  vector<vector<pair<string, string> > > partitions;
+  readMapOutput(prefix, NUM_PARTITIONS, partitions);
+  ASSERT_EQ(NUM_PARTITIONS, partitions.size());
+  for (uint32_t i = 0; i < NUM_PARTITIONS; i++) {
+    ASSERT_EQ(expectKeys[i].size(), partitions[i].size());
+    vector<string> keys;
+    std::set<string> finishedGroups;
+    for (uint32_t j = 0; j < partitions[i].size(); j++) {
+      const string & key = partitions[i][j].first;
+      keys.push_back(key);
+      if (j > 0 && key != partitions[i][j - 1].first) {
+        // a key never shows up again once its group is over
+        ASSERT_TRUE(finishedGroups.insert(partitions[i][j - 1].first).second);
+        ASSERT_EQ(0, finishedGroups.count(key));
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+    std::sort(expectKeys[i].begin(), expectKeys[i].end());
+    ASSERT_EQ(expectKeys[i], keys);
+  }
+  FileSystem::getLocal().remove(prefix + ".out");
+  FileSystem::getLocal().remove(prefix + ".out.index");
+}
+
+TEST(MapOutputCollector, collectBatch) {
+  const uint32_t NUM_PARTITIONS = 8;
+  const uint32_t NUM_RECORDS = 100000;
+  const uint32_t CHUNK_SIZE = 4096;
+  const string prefix = "collector_batch";
+
+  Config config;
+  setCollectorConfig(config);
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+
+  // serialize as the java side does: big endian partition, key and value length
+  vector<pair<string, string> > inputs;
+  Generate(inputs, NUM_RECORDS, "word");
+  vector<vector<string> > expectKeys(NUM_PARTITIONS);
+  string serialized;
+  for (uint32_t i = 0; i < inputs.size(); i++) {
+    uint32_t partition = i % NUM_PARTITIONS;
+    uint32_t header[3] = {bswap(partition), bswap((uint32_t)inputs[i].first.length()),
+        bswap((uint32_t)inputs[i].second.length())};
+    serialized.append((const char *)header, sizeof(header));
+    serialized.append(inputs[i].first);
+    serialized.append(inputs[i].second);
+    expectKeys[partition].push_back(inputs[i].first);
+  }
+
+  // feed in chunks, the tail of a chunk is kept for the next one
+  string pending;
+  for (uint32_t offset = 0; offset < serialized.length(); offset += CHUNK_SIZE) {
+    pending.append(serialized, offset, CHUNK_SIZE);
+    uint32_t consumed = collector->collectBatch(pending.data(), pending.length(), LARGE_ENDIUM);
+    pending.erase(0, consumed);
+  }
+  ASSERT_EQ(0, pending.length());
+  collector->close();
+  delete collector;
+
+  verifyMapOutput(prefix, expectKeys);
+}
+
+TEST(MapOutputCollector, hashPartition) {
+  // partitions of the java HashPartitioner over Text keys
+  ASSERT_EQ(3, MapOutputCollector::hashPartition("hello", 5, 10));
+  ASSERT_EQ(1, MapOutputCollector::hashPartition("hello world", 11, 10));
+  // negative hash codes
+  ASSERT_EQ(8, MapOutputCollector::hashPartition("hello world!", 12, 10));
+  ASSERT_EQ(7, MapOutputCollector::hashPartition("partition", 9, 10));
+  // bytes are signed in java
+  ASSERT_EQ(8, MapOutputCollector::hashPartition("\xe4\xb8\xad", 3, 10));
+  ASSERT_EQ(1, MapOutputCollector::hashPartition("", 0, 10));
+  ASSERT_EQ(0, MapOutputCollector::hashPartition("hello", 5, 1));
+}
+
+TEST(MapOutputCollector, collectBatchHashPartition) {
+  const uint32_t NUM_PARTITIONS = 8;
+  const uint32_t NUM_RECORDS = 100000;
+  const uint32_t CHUNK_SIZE = 4096;
+  const string prefix = "collector_batch_hash";
+
+  Config config;
+  setCollectorConfig(config);
+  config.setBool(NATIVE_PARTITIONER_HASH, true);
+  TestSpillOutputService service(prefix);
+  MapOutputCollector * collector = new MapOutputCollector(NUM_PARTITIONS, &service);
+  collector->configure(&config);
+  ASSERT_TRUE(collector->isHashPartition());
+
+  // plain big endian key and value length, no partition id
+  vector<pair<string, string> > inputs;
+  Generate(inputs, NUM_RECORDS, "word");
+  vector<vector<string> > expectKeys(NUM_PARTITIONS);
+  string serialized;
+  for (uint32_t i = 0; i < inputs.size(); i++) {
+    const string & key = inputs[i].first;
+    uint32_t header[2] = {bswap((uint32_t)key.length()),
+        bswap((uint32_t)inputs[i].second.length())};
+    serialized.append((const char *)header, sizeof(header));
+    serialized.append(key);
+    serialized.append(inputs[i].second);
+    expectKeys[MapOutputCollector::hashPartition(key.data(), key.length(), NUM_PARTITIONS)]
+        .push_back(key);
+  }
+
+  string pending;
+  for (uint32_t offset = 0; offset < serialized.length(); offset += CHUNK_SIZE) {
+    pending.append(serialized, offset, CHUNK_SIZE);
+    uint32_t consumed = collector->collectBatch(pending.data(), pending.length(), LARGE_ENDIUM);
+    pending.erase(0, consumed);
+  }
+  ASSERT_EQ(0, pending.length());
+  collector->close();
+  delete collector;
+
+  verifyMapOutput(prefix, expectKeys);
+}
+
+TEST(MapOutputCollector, hashPartitionKeyType) {
+  Config config;
+  setCollectorConfig(config);
+  config.set(MAPRED_MAPOUTPUT_KEY_CLASS, "org.apache.hadoop.io.LongWritable");
+  config.setBool(NATIVE_PARTITIONER_HASH, true);
+  TestSpillOutputService service("collector_hash_key_type");
+  MapOutputCollector * collector = new MapOutputCollector(2, &service);
+  ASSERT_THROW(collector->configure(&config), UnsupportException);
+  delete collector;
+}
+
+} // namespace NativeTask
@@ -36,8 +36,7 @@ TEST(MemoryBlockIterator, test) {
 
   uint32_t keyCount = 0;
   while (iter.next()) {
-    KVBuffer * kv = iter.getKVBuffer();
-    ASSERT_EQ(block.getKVBuffer(keyCount), kv);
+    ASSERT_EQ(block.getKVBuffer(keyCount)->getKey(), iter.getKey());
     keyCount++;
   }
   delete [] bytes;
@@ -20,6 +20,7 @@
 #include "test_commons.h"
 #include "lib/MapOutputSpec.h"
 #include "lib/MemoryBlock.h"
+#include "lib/NativeObjectFactory.h"
 
 namespace NativeTaskTest {
 
@@ -106,4 +107,334 @@ TEST(MemoryBlock, sort) {
   delete [] bytes;
 }
 
+static void fillRandomKeys(MemoryBlock & block, KeyValueType keyType, uint32_t count) {
+  Random r(1234);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t keyLength = 0;
+    string bytes;
+    switch (keyType) {
+    case IntType:
+      keyLength = 4;
+      break;
+    case LongType:
+      keyLength = 8;
+      break;
+    default:
+      // short alphabet and lengths around 8 to have many shared prefixes
+      bytes = r.nextBytes(6 + r.next_int32(6), string("ab\0\xff", 4));
+      keyLength = bytes.length();
+      break;
+    }
+    KVBuffer * kv = block.allocateKVBuffer(keyLength + 4 + KVBuffer::headerLength());
+    ASSERT_TRUE(NULL != kv);
+    kv->keyLength = keyLength;
+    kv->valueLength = 4;
+    if (keyType == IntType) {
+      *(uint32_t *)kv->getKey() = bswap((uint32_t)r.next_int32());
+    } else if (keyType == LongType) {
+      *(uint64_t *)kv->getKey() = bswap64(r.next_uint64());
+    } else {
+      memcpy(kv->getKey(), bytes.c_str(), keyLength);
+    }
+    *(uint32_t *)kv->getValue() = i;
+  }
+}
+
+static void testPrefixSort(SortAlgorithm type, KeyValueType keyType) {
+  const uint32_t KV_COUNT = 10000;
+  const uint32_t BUFFER_LENGTH = KV_COUNT * 32;
+  char * bytes = new char[BUFFER_LENGTH];
+  char * expectBytes = new char[BUFFER_LENGTH];
+  MemoryBlock block(bytes, BUFFER_LENGTH);
+  MemoryBlock expect(expectBytes, BUFFER_LENGTH);
+  fillRandomKeys(block, keyType, KV_COUNT);
+  fillRandomKeys(expect, keyType, KV_COUNT);
+
+  ComparatorPtr comparator = NativeTask::get_comparator(keyType, NULL);
+  block.sort(type, comparator);
+  expect.sort(CPPSORT, comparator);
+  ASSERT_EQ(true, block.sorted());
+
+  for (uint32_t i = 0; i < KV_COUNT; i++) {
+    KVBuffer * kv = block.getKVBuffer(i);
+    KVBuffer * expectKV = expect.getKVBuffer(i);
+    ASSERT_EQ(0, comparator(kv->getKey(), kv->keyLength, expectKV->getKey(), expectKV->keyLength));
+    if (i > 0) {
+      KVBuffer * prev = block.getKVBuffer(i - 1);
+      ASSERT_LE(comparator(prev->getKey(), prev->keyLength, kv->getKey(), kv->keyLength), 0);
+    }
+  }
+  delete [] bytes;
+  delete [] expectBytes;
+}
+
+TEST(MemoryBlock, radixSortInt) {
+  testPrefixSort(RADIXSORT, IntType);
+}
+
+TEST(MemoryBlock, radixSortLong) {
+  testPrefixSort(RADIXSORT, LongType);
+}
+
+TEST(MemoryBlock, radixSortBytes) {
+  testPrefixSort(RADIXSORT, BytesType);
+}
+
+TEST(MemoryBlock, prefixSortInt) {
+  testPrefixSort(PREFIXSORT, IntType);
+}
+
+TEST(MemoryBlock, prefixSortLong) {
+  testPrefixSort(PREFIXSORT, LongType);
+}
+
+TEST(MemoryBlock, prefixSortBytes) {
+  testPrefixSort(PREFIXSORT, BytesType);
+}
+
+TEST(MemoryBlock, radixSortFallback) {
+  const uint32_t BUFFER_LENGTH = 1000;
+  char * bytes = new char[BUFFER_LENGTH];
+  MemoryBlock block(bytes, BUFFER_LENGTH);
+  const uint32_t values[] = {300, 7, 1, 128};
+  for (uint32_t i = 0; i < 4; i++) {
+    KVBuffer * kv = block.allocateKVBuffer(16);
+    kv->keyLength = 1;
+    kv->valueLength = 4;
+    WritableUtils::WriteVInt(values[i], kv->getKey(), kv->keyLength);
+  }
+  // no prefix form for vint, falls back to the comparator sort
+  ComparatorPtr comparator = NativeTask::get_comparator(VIntType, NULL);
+  block.sort(RADIXSORT, comparator);
+  for (uint32_t i = 1; i < 4; i++) {
+    KVBuffer * prev = block.getKVBuffer(i - 1);
+    KVBuffer * kv = block.getKVBuffer(i);
+    ASSERT_LE(comparator(prev->getKey(), prev->keyLength, kv->getKey(), kv->keyLength), 0);
+  }
+  delete [] bytes;
+}
+
+static ComparatorPtr gWrappedComparator = NULL;
+
+/**
+ * not one of the built-in comparators, so the sort calls it by pointer
+ */
+static int wrappedComparator(const char * src, uint32_t srcLength, const char * dest,
+    uint32_t destLength) {
+  return gWrappedComparator(src, srcLength, dest, destLength);
+}
+
+static void testInlinedSort(SortAlgorithm type, KeyValueType keyType) {
+  const uint32_t KV_COUNT = 10000;
+  const uint32_t BUFFER_LENGTH = KV_COUNT * 32;
+  char * bytes = new char[BUFFER_LENGTH];
+  char * expectBytes = new char[BUFFER_LENGTH];
+  MemoryBlock block(bytes, BUFFER_LENGTH);
+  MemoryBlock expect(expectBytes, BUFFER_LENGTH);
+  fillRandomKeys(block, keyType, KV_COUNT);
+  fillRandomKeys(expect, keyType, KV_COUNT);
+
+  gWrappedComparator = NativeTask::get_comparator(keyType, NULL);
+  block.sort(type, gWrappedComparator);
+  expect.sort(type, &wrappedComparator);
+
+  for (uint32_t i = 0; i < KV_COUNT; i++) {
+    KVBuffer * kv = block.getKVBuffer(i);
+    KVBuffer * expectKV = expect.getKVBuffer(i);
+    ASSERT_EQ(0, gWrappedComparator(kv->getKey(), kv->keyLength, expectKV->getKey(),
+        expectKV->keyLength));
+  }
+  delete [] bytes;
+  delete [] expectBytes;
+}
+
+TEST(MemoryBlock, inlinedSortMatchesPointer) {
+  const SortAlgorithm types[] = {CPPSORT, DUALPIVOTSORT};
+  const KeyValueType keyTypes[] = {IntType, LongType, BytesType};
+  for (uint32_t i = 0; i < 2; i++) {
+    for (uint32_t j = 0; j < 3; j++) {
+      testInlinedSort(types[i], keyTypes[j]);
+    }
+  }
+}
+
+/**
+ * a custom comparator ordering bytes keys descending, its normalizer only
+ * covers the first 8 bytes so ties go back to the comparator
+ */
+static int reverseBytesComparator(const char * src, uint32_t srcLength, const char * dest,
+    uint32_t destLength) {
+  return NativeObjectFactory::BytesComparator(dest, destLength, src, srcLength);
+}
+
+static uint64_t reverseBytesNormalizer(const char * key, uint32_t keyLength) {
+  return ~getKeyPrefix(BYTES_PREFIX, key, keyLength);
+}
+
+TEST(MemoryBlock, normalizedSort) {
+  const uint32_t KV_COUNT = 10000;
+  const uint32_t BUFFER_LENGTH = KV_COUNT * 32;
+  NativeObjectFactory::RegisterClass("NativeTask.TestReverseBytesComparatorNormalizer",
+      (ObjectCreatorFunc)reverseBytesNormalizer);
+  KeyNormalizerPtr normalizer = get_key_normalizer("NativeTask.TestReverseBytesComparator");
+  ASSERT_TRUE(normalizer == &reverseBytesNormalizer);
+  ASSERT_TRUE(NULL == get_key_normalizer("NativeTask.TestNoSuchComparator"));
+
+  const SortAlgorithm types[] = {RADIXSORT, PREFIXSORT};
+  for (uint32_t i = 0; i < 2; i++) {
+    char * bytes = new char[BUFFER_LENGTH];
+    char * expectBytes = new char[BUFFER_LENGTH];
+    MemoryBlock block(bytes, BUFFER_LENGTH);
+    MemoryBlock expect(expectBytes, BUFFER_LENGTH);
+    fillRandomKeys(block, BytesType, KV_COUNT);
+    fillRandomKeys(expect, BytesType, KV_COUNT);
+
+    block.sort(types[i], &reverseBytesComparator, normalizer);
+    expect.sort(CPPSORT, &reverseBytesComparator);
+    for (uint32_t j = 0; j < KV_COUNT; j++) {
+      KVBuffer * kv = block.getKVBuffer(j);
+      KVBuffer * expectKV = expect.getKVBuffer(j);
+      ASSERT_EQ(0, reverseBytesComparator(kv->getKey(), kv->keyLength, expectKV->getKey(),
+          expectKV->keyLength));
+    }
+    delete [] bytes;
+    delete [] expectBytes;
+  }
+}
+
+static uint32_t countedComparisons = 0;
+
+static int countingBytesComparator(const char * src, uint32_t srcLength, const char * dest,
+    uint32_t destLength) {
+  countedComparisons++;
+  return NativeObjectFactory::BytesComparator(src, srcLength, dest, destLength);
+}
+
+TEST(MemoryBlock, presortedInput) {
+  const uint32_t KV_COUNT = 1000;
+  const uint32_t BUFFER_LENGTH = KV_COUNT * 32;
+  const SortAlgorithm types[] = {CPPSORT, DUALPIVOTSORT, RADIXSORT, PREFIXSORT};
+  for (uint32_t t = 0; t < 4; t++) {
+    char * bytes = new char[BUFFER_LENGTH];
+    MemoryBlock block(bytes, BUFFER_LENGTH);
+    vector<KVBuffer *> kvs;
+    for (uint32_t i = 0; i < KV_COUNT; i++) {
+      // equal neighbours are still in order
+      string key = StringUtil::Format("key%06u", i / 2);
+      KVBuffer * kv = block.allocateKVBuffer(key.length() + KVBuffer::headerLength());
+      kv->fill(key.data(), key.length(), NULL, 0);
+      kvs.push_back(kv);
+    }
+
+    // one comparison per record and no reordering
+    countedComparisons = 0;
+    block.sort(types[t], &countingBytesComparator);
+    ASSERT_EQ(KV_COUNT - 1, countedComparisons);
+    ASSERT_TRUE(block.sorted());
+    for (uint32_t i = 0; i < KV_COUNT; i++) {
+      ASSERT_EQ(kvs[i], block.getKVBuffer(i));
+    }
+
+    // a late key out of order is still sorted
+    KVBuffer * kv = block.allocateKVBuffer(6 + KVBuffer::headerLength());
+    kv->fill("key000", 6, NULL, 0);
+    block.sort(types[t], &countingBytesComparator);
+    ASSERT_EQ(kv, block.getKVBuffer(0));
+    delete [] bytes;
+  }
+}
+
+static void checkRecord(MemoryBlock & block, uint32_t index, const string & expectKey,
+    const string & expectValue) {
+  char * key;
+  char * value;
+  uint32_t keyLength;
+  uint32_t valueLength;
+  block.getRecord(index, key, keyLength, value, valueLength);
+  ASSERT_EQ(expectKey, string(key, keyLength));
+  ASSERT_EQ(expectValue, string(value, valueLength));
+}
+
+TEST(MemoryBlock, compact) {
+  const uint32_t KV_COUNT = 100;
+  // key000000 and an 8 bytes value
+  const uint32_t KV_SIZE = 9 + 8 + KVBuffer::headerLength();
+  const uint32_t BUFFER_LENGTH = KV_COUNT * KV_SIZE;
+  char * bytes = new char[BUFFER_LENGTH];
+
+  MemoryBlock plain(bytes, BUFFER_LENGTH);
+  for (uint32_t i = 0; i < KV_COUNT; i++) {
+    plain.allocateKVBuffer(KV_SIZE);
+  }
+  ASSERT_FALSE(plain.compact(KV_SIZE));
+  ASSERT_EQ(0, plain.remainSpace());
+
+  MemoryBlock block(bytes, BUFFER_LENGTH, true);
+  for (uint32_t i = 0; i < KV_COUNT; i++) {
+    string key = StringUtil::Format("key%06u", KV_COUNT - i);
+    block.allocateKVBuffer(KV_SIZE)->fill(key.data(), key.length(), "value123", 8);
+  }
+  ASSERT_EQ(0, block.remainSpace());
+
+  ASSERT_TRUE(block.compact(KV_SIZE));
+  ASSERT_EQ(KV_COUNT * 4, block.remainSpace());
+  ASSERT_EQ(KV_COUNT, block.getKVCount());
+  ASSERT_EQ(NULL, block.getKVBuffer(0));
+  for (uint32_t i = 0; i < KV_COUNT; i++) {
+    checkRecord(block, i, StringUtil::Format("key%06u", KV_COUNT - i), "value123");
+  }
+
+  // compaction stops at a large record, the records after it only move
+  const uint32_t TAIL_COUNT = 5000;
+  string large(0x10000, 'v');
+  const uint32_t LARGE_SIZE = 9 + large.length() + KVBuffer::headerLength();
+  const uint32_t MIXED_LENGTH = BUFFER_LENGTH + LARGE_SIZE + TAIL_COUNT * KV_SIZE;
+  char * largeBytes = new char[MIXED_LENGTH];
+  MemoryBlock mixed(largeBytes, MIXED_LENGTH, true);
+  for (uint32_t i = 0; i < KV_COUNT; i++) {
+    mixed.allocateKVBuffer(KV_SIZE)->fill("key000001", 9, "value123", 8);
+  }
+  mixed.allocateKVBuffer(LARGE_SIZE)->fill("key000000", 9, large.data(), large.length());
+  for (uint32_t i = 0; i < TAIL_COUNT; i++) {
+    string key = StringUtil::Format("key%06u", i);
+    mixed.allocateKVBuffer(KV_SIZE)->fill(key.data(), key.length(), "value123", 8);
+  }
+  ASSERT_EQ(0, mixed.remainSpace());
+  ASSERT_TRUE(mixed.compact(KV_COUNT * 4));
+  ASSERT_EQ(KV_COUNT * 4, mixed.remainSpace());
+  ASSERT_EQ(NULL, mixed.getKVBuffer(KV_COUNT - 1));
+  ASSERT_NE((KVBuffer *)NULL, mixed.getKVBuffer(KV_COUNT));
+  checkRecord(mixed, KV_COUNT - 1, "key000001", "value123");
+  checkRecord(mixed, KV_COUNT, "key000000", large);
+  for (uint32_t i = 0; i < TAIL_COUNT; i++) {
+    checkRecord(mixed, KV_COUNT + 1 + i, StringUtil::Format("key%06u", i), "value123");
+  }
+  mixed.allocateKVBuffer(KV_SIZE)->fill("key000001", 9, "value123", 8);
+  ASSERT_FALSE(mixed.compact(mixed.remainSpace() + 1));
+
+  // compacted and plain records sort together
+  const SortAlgorithm types[] = {CPPSORT, DUALPIVOTSORT, RADIXSORT, PREFIXSORT};
+  for (uint32_t t = 0; t < 4; t++) {
+    MemoryBlock sorted(largeBytes, MIXED_LENGTH, true);
+    for (uint32_t i = 0; i < KV_COUNT; i++) {
+      string key = StringUtil::Format("key%06u", (i * 37) % KV_COUNT);
+      sorted.allocateKVBuffer(key.length() + (i == KV_COUNT / 2 ? large.length() : 8)
+          + KVBuffer::headerLength())->fill(key.data(), key.length(),
+          i == KV_COUNT / 2 ? large.data() : "value123", i == KV_COUNT / 2 ? large.length() : 8);
+      if (i % 10 == 0) {
+        sorted.compact(0);
+      }
+    }
+    sorted.sort(types[t], NativeTask::get_comparator(BytesType, NULL));
+    ASSERT_FALSE(sorted.compact(sorted.remainSpace() + 1));
+    for (uint32_t i = 0; i < KV_COUNT; i++) {
+      uint32_t source = (i * 73) % KV_COUNT; // 37 * 73 = 1 (mod 100)
+      checkRecord(sorted, i, StringUtil::Format("key%06u", i),
+          source == KV_COUNT / 2 ? large : "value123");
+    }
+  }
+  delete [] largeBytes;
+  delete [] bytes;
+}
+
 } // namespace NativeTask
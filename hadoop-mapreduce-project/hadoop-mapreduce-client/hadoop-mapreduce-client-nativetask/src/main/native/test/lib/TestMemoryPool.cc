@@ -22,6 +22,7 @@
 #include "lib/PartitionBucketIterator.h"
 #include "lib/MemoryBlock.h"
 #include "lib/IFile.h"
+#include "native_memory.h"
 
 namespace NativeTask {
 
@@ -45,4 +46,135 @@ TEST(MemoryPool, general) {
 
   delete pool;
 }
+
+TEST(MemoryPool, freezeAndRelease) {
+  MemoryPool * pool = new MemoryPool();
+  const uint32_t POOL_SIZE = 1024;
+  pool->init(POOL_SIZE);
+
+  uint32_t allocated = 0;
+  char * first = pool->allocate(600, 600, allocated);
+  ASSERT_NE((void *)NULL, first);
+  ASSERT_EQ(600, pool->getUsed());
+
+  pool->freeze();
+  ASSERT_TRUE(pool->hasFrozen());
+  char * second = pool->allocate(300, 300, allocated);
+  ASSERT_EQ(first + 600, second);
+  // tail too small, head still frozen
+  ASSERT_EQ(NULL, pool->allocate(300, 300, allocated));
+
+  pool->releaseFrozen();
+  ASSERT_FALSE(pool->hasFrozen());
+  ASSERT_EQ(300, pool->getUsed());
+
+  // wraps around to the released head
+  char * third = pool->allocate(500, 500, allocated);
+  ASSERT_EQ(first, third);
+  ASSERT_EQ(800, pool->getUsed());
+  ASSERT_EQ(NULL, pool->allocate(200, 200, allocated));
+
+  pool->freeze();
+  pool->releaseFrozen();
+  ASSERT_EQ(0, pool->getUsed());
+  ASSERT_EQ(first, pool->allocate(1024, 1024, allocated));
+
+  delete pool;
+}
+static void checkPoolUsable(MemoryPool * pool, uint32_t capacity) {
+  uint32_t allocated = 0;
+  char * buff = pool->allocate(capacity, capacity, allocated);
+  ASSERT_NE((void *)NULL, buff);
+  ASSERT_EQ(capacity, allocated);
+  memset(buff, 0x5a, allocated);
+  ASSERT_EQ(0x5a, buff[allocated - 1]);
+}
+
+TEST(MemoryPool, allocationMode) {
+  const uint32_t POOL_SIZE = 4 * 1024 * 1024;
+
+  MemoryPool * pool = new MemoryPool();
+  pool->init(POOL_SIZE);
+  ASSERT_EQ(POOL_MALLOC, pool->getMode());
+  ASSERT_FALSE(pool->isNumaBound());
+  checkPoolUsable(pool, POOL_SIZE);
+  delete pool;
+
+  pool = new MemoryPool();
+  pool->setAllocationMode(false, true);
+  pool->init(POOL_SIZE);
+  ASSERT_EQ(POOL_MMAP, pool->getMode());
+  checkPoolUsable(pool, POOL_SIZE);
+  delete pool;
+
+  // huge pages may not be available here, any mapped mode is fine
+  pool = new MemoryPool();
+  pool->setAllocationMode(true, true);
+  pool->init(POOL_SIZE);
+  ASSERT_NE(POOL_MALLOC, pool->getMode());
+  checkPoolUsable(pool, POOL_SIZE);
+  // growing remaps with the same mode
+  pool->init(POOL_SIZE * 2);
+  ASSERT_NE(POOL_MALLOC, pool->getMode());
+  checkPoolUsable(pool, POOL_SIZE * 2);
+  delete pool;
+}
+
+TEST(MemoryPool, softLimit) {
+  const uint32_t SOFT_LIMIT = 1024 * 1024;
+  const uint32_t POOL_SIZE = 4 * SOFT_LIMIT;
+
+  MemoryPool * pool = new MemoryPool();
+  pool->setSoftLimit(SOFT_LIMIT);
+  pool->init(POOL_SIZE);
+  ASSERT_EQ(POOL_MMAP, pool->getMode());
+  ASSERT_EQ(SOFT_LIMIT, pool->getSoftLimit());
+  ASSERT_EQ(POOL_SIZE, pool->getCapacity());
+
+  // can grow past the soft limit up to the capacity
+  checkPoolUsable(pool, POOL_SIZE);
+
+  // pages above the soft limit are given back, they read as zero again
+  pool->reset();
+  uint32_t allocated = 0;
+  char * buff = pool->allocate(POOL_SIZE, POOL_SIZE, allocated);
+  ASSERT_EQ(0x5a, buff[SOFT_LIMIT - 1]);
+  ASSERT_EQ(0, buff[SOFT_LIMIT]);
+  ASSERT_EQ(0, buff[POOL_SIZE - 1]);
+  delete pool;
+}
+
+static int64_t sortMemory() {
+  native_memory_stats stats;
+  get_native_memory_stats(NATIVE_MEMORY_SORT, &stats);
+  return stats.current;
+}
+
+TEST(MemoryPool, accounting) {
+  const uint32_t SOFT_LIMIT = 1024 * 1024;
+  const uint32_t POOL_SIZE = 4 * SOFT_LIMIT;
+  const int64_t before = sortMemory();
+
+  MemoryPool * pool = new MemoryPool();
+  pool->setSoftLimit(SOFT_LIMIT);
+  pool->init(POOL_SIZE);
+  // nothing is touched yet
+  ASSERT_EQ(before, sortMemory());
+
+  uint32_t allocated = 0;
+  pool->allocate(1000, 1000, allocated);
+  ASSERT_EQ(before + 1000, sortMemory());
+  pool->allocate(POOL_SIZE - 1000, POOL_SIZE - 1000, allocated);
+  ASSERT_EQ(before + POOL_SIZE, sortMemory());
+
+  // pages above the soft limit are given back
+  pool->reset();
+  ASSERT_EQ(before + SOFT_LIMIT, sortMemory());
+  pool->allocate(1000, 1000, allocated);
+  ASSERT_EQ(before + SOFT_LIMIT, sortMemory());
+
+  delete pool;
+  ASSERT_EQ(before, sortMemory());
+}
+
 } // namespace NativeTask
@@ -0,0 +1,191 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "lib/BufferStream.h"
+#include "lib/FileSystem.h"
+#include "lib/IFile.h"
+#include "lib/NativeReduceCollector.h"
+#include "test_commons.h"
+
+namespace NativeTask {
+
+static void setReduceConfig(Config & config) {
+  config.set(MAPRED_MAPOUTPUT_KEY_CLASS, "org.apache.hadoop.io.Text");
+  config.set(MAPRED_MAPOUTPUT_VALUE_CLASS, "org.apache.hadoop.io.LongWritable");
+}
+
+static string longValue(int64_t value) {
+  int64_t be = (int64_t)bswap64((uint64_t)value);
+  return string((const char *)&be, sizeof(be));
+}
+
+/**
+ * one map output partition with keys [start, start + count) by step,
+ * every value is 1
+ */
+static void writeSegment(OutputStream * out, uint32_t start, uint32_t count, uint32_t step) {
+  IFileWriter writer(out, CHECKSUM_CRC32, TextType, LongType, "", NULL);
+  writer.startPartition();
+  string one = longValue(1);
+  for (uint32_t i = 0; i < count; i++) {
+    string key = StringUtil::Format("key%06u", start + i * step);
+    writer.write(key.data(), key.length(), one.data(), one.length());
+  }
+  writer.endPartition();
+}
+
+static string memorySegment(uint32_t start, uint32_t count, uint32_t step) {
+  string data;
+  OutputStringStream out(data);
+  writeSegment(&out, start, count, step);
+  return data;
+}
+
+static void diskSegment(const string & path, uint32_t start, uint32_t count, uint32_t step) {
+  OutputStream * out = FileSystem::getLocal().create(path, true);
+  writeSegment(out, start, count, step);
+  delete out;
+}
+
+TEST(NativeReduceCollector, merge) {
+  Config config;
+  setReduceConfig(config);
+
+  string first = memorySegment(0, 1000, 3);
+  string second = memorySegment(1, 1000, 3);
+  diskSegment("reducesegment.0", 2, 1000, 3);
+
+  NativeReduceCollector collector;
+  collector.configure(&config);
+  collector.addMemorySegment(first.data(), first.length());
+  collector.addMemorySegment(second.data(), second.length());
+  collector.addDiskSegment("reducesegment.0");
+  ASSERT_EQ(3, collector.getSegmentCount());
+  ASSERT_EQ(2, collector.getMemorySegmentCount());
+
+  KVIterator * iter = collector.merge();
+  Buffer key;
+  Buffer value;
+  uint32_t count = 0;
+  while (iter->next(key, value)) {
+    ASSERT_EQ(StringUtil::Format("key%06u", count), string(key.data(), key.length()));
+    ASSERT_EQ(longValue(1), string(value.data(), value.length()));
+    count++;
+  }
+  ASSERT_EQ(3000, count);
+  collector.close();
+  FileSystem::getLocal().remove("reducesegment.0");
+}
+
+TEST(NativeReduceCollector, groupingComparator) {
+  Config config;
+  setReduceConfig(config);
+  config.set(MAPRED_GROUPING_COMPARATOR, "org.example.NaturalKeyComparator");
+
+  string first = memorySegment(0, 1000, 2);
+  diskSegment("reducesegment.0", 1, 1000, 2);
+
+  NativeReduceCollector collector;
+  collector.configure(&config);
+  collector.addMemorySegment(first.data(), first.length());
+  collector.addDiskSegment("reducesegment.0");
+  ASSERT_THROW(collector.mergeKeyGroups(), UnsupportException);
+  collector.close();
+
+  // key000000 to key001999, grouped by the first 8 bytes
+  config.set(string(NATIVE_GROUPING_COMPARATOR) + ".org.example.NaturalKeyComparator",
+      "prefix:8");
+  NativeReduceCollector grouped;
+  grouped.configure(&config);
+  grouped.addMemorySegment(first.data(), first.length());
+  grouped.addDiskSegment("reducesegment.0");
+  KeyGroupIterator * groups = grouped.mergeKeyGroups();
+  uint32_t keys = 0;
+  uint32_t records = 0;
+  while (groups->nextKey()) {
+    uint32_t length;
+    const char * value;
+    while (NULL != (value = groups->nextValue(length))) {
+      // the key moves along with the values
+      const char * key = groups->getKey(length);
+      ASSERT_EQ(StringUtil::Format("key%06u", records), string(key, length));
+      records++;
+    }
+    ASSERT_EQ(keys * 10 + 10, records);
+    keys++;
+  }
+  ASSERT_EQ(200, keys);
+  grouped.close();
+  FileSystem::getLocal().remove("reducesegment.0");
+}
+
+TEST(NativeReduceCollector, mergeMemoryToDiskWithCombiner) {
+  Config config;
+  setReduceConfig(config);
+  config.set(NATIVE_COMBINER, "NativeTask.SumCombiner");
+
+  string first = memorySegment(0, 500, 1);
+  string second = memorySegment(0, 500, 2);
+  diskSegment("reducesegment.0", 0, 500, 1);
+
+  NativeReduceCollector collector;
+  collector.configure(&config);
+  collector.addMemorySegment(first.data(), first.length());
+  collector.addDiskSegment("reducesegment.0");
+  collector.addMemorySegment(second.data(), second.length());
+
+  collector.mergeMemoryToDisk("reducesegment.1");
+  ASSERT_EQ(2, collector.getSegmentCount());
+  ASSERT_EQ(0, collector.getMemorySegmentCount());
+
+  // the combined file has one record per key
+  string combined;
+  ReadFile(combined, "reducesegment.1");
+  ASSERT_LT(combined.length(), first.length() + second.length());
+
+  KeyGroupIterator * groups = collector.mergeKeyGroups();
+  uint32_t keys = 0;
+  int64_t last = -1;
+  while (groups->nextKey()) {
+    uint32_t length;
+    const char * key = groups->getKey(length);
+    int64_t id = strtol(string(key + 3, length - 3).c_str(), NULL, 10);
+    ASSERT_LT(last, id);
+    last = id;
+    int64_t sum = 0;
+    uint32_t values = 0;
+    const char * value;
+    while (NULL != (value = groups->nextValue(length))) {
+      ASSERT_EQ(8, length);
+      sum += (int64_t)bswap64(*(const uint64_t *)value);
+      values++;
+    }
+    // one record from the combined memory segments, one from the disk
+    ASSERT_EQ(id < 500 ? 2 : 1, values);
+    int64_t expected = (id < 500 ? 2 : 0) + (id % 2 == 0 ? 1 : 0);
+    ASSERT_EQ(expected, sum);
+    keys++;
+  }
+  ASSERT_EQ(750, keys);
+  collector.close();
+  FileSystem::getLocal().remove("reducesegment.0");
+  FileSystem::getLocal().remove("reducesegment.1");
+}
+
+} // namespace NativeTask
@@ -109,6 +109,43 @@ TEST(PartitionBucket, multipleMemoryBlock) {
   delete pool;
 }
 
+TEST(PartitionBucket, adaptiveBlockSize) {
+  MemoryPool * pool = new MemoryPool();
+  const uint32_t POOL_SIZE = 1024 * 1024; // 1MB
+  const uint32_t BLOCK_SIZE = 1024; // 1KB
+  const uint32_t MAX_BLOCK_SIZE = 8 * 1024; // 8KB
+  const uint32_t KV_SIZE = 600;
+  pool->init(POOL_SIZE);
+  ComparatorPtr comparator = NativeTask::get_comparator(BytesType, NULL);
+  PartitionBucket * bucket = new PartitionBucket(pool, 0, comparator, NULL, BLOCK_SIZE,
+      MAX_BLOCK_SIZE);
+
+  // each refill doubles the next block, up to the max
+  uint32_t expect = BLOCK_SIZE;
+  for (uint32_t i = 0; i < 5; i++) {
+    // the first kv opens a new block
+    ASSERT_NE((void *)NULL, bucket->allocateKVBuffer(KV_SIZE));
+    ASSERT_EQ(i + 1, bucket->getMemoryBlockCount());
+    MemoryBlock * block = bucket->getMemoryBlock(i);
+    ASSERT_EQ(expect - KV_SIZE, block->remainSpace());
+    while (block->remainSpace() >= KV_SIZE) {
+      ASSERT_NE((void *)NULL, bucket->allocateKVBuffer(KV_SIZE));
+    }
+    expect = std::min(MAX_BLOCK_SIZE, expect * 2);
+  }
+
+  // a bucket that stays within one block cools down after each reset
+  bucket->reset();
+  pool->reset();
+  ASSERT_EQ(MAX_BLOCK_SIZE, bucket->getBlockSize());
+  bucket->allocateKVBuffer(KV_SIZE);
+  bucket->reset();
+  ASSERT_EQ(MAX_BLOCK_SIZE / 2, bucket->getBlockSize());
+
+  delete bucket;
+  delete pool;
+}
+
 TEST(PartitionBucket, sort) {
   MemoryPool * pool = new MemoryPool();
   const uint32_t POOL_SIZE = 1024 * 1024; // 1MB
@@ -155,8 +192,16 @@ TEST(PartitionBucket, sort) {
 
   iter->next(key, value);
   ASSERT_EQ(BIG, bswap(*(uint32_t * )key.data()));
-
   delete iter;
+
+  // the records themselves, not copies
+  PartitionBucketIterator * bucketIter = bucket->getIterator();
+  ASSERT_EQ(kv2->getKey(), bucketIter->nextRecord()->getKey());
+  ASSERT_EQ(kv3->getKey(), bucketIter->nextRecord()->getKey());
+  ASSERT_EQ(kv1->getKey(), bucketIter->nextRecord()->getKey());
+  ASSERT_EQ(NULL, bucketIter->nextRecord());
+  delete bucketIter;
+
   delete bucket;
   delete pool;
 }
@@ -44,6 +44,36 @@ TEST(Buffers, AppendRead) {
   }
 }
 
+TEST(Buffers, ReadVLongPair) {
+  Random r(4321);
+  vector<int64_t> values;
+  for (uint32_t i = 0; i < 20000; i++) {
+    int64_t v = r.nextLog2(((uint64_t)-1) / 2 - 3);
+    values.push_back(i % 3 == 0 ? -v : v);
+  }
+  values.push_back(-1);
+  values.push_back(-1);
+  string dest;
+  OutputStringStream outputStream = OutputStringStream(dest);
+  AppendBuffer appendBuffer;
+  appendBuffer.init(64 * 1024, &outputStream, "");
+  for (size_t i = 0; i < values.size(); i++) {
+    appendBuffer.write_vlong(values[i]);
+  }
+  appendBuffer.flush();
+  // a small buffer, so pairs also straddle the refills
+  InputBuffer inputBuffer = InputBuffer(dest.c_str(), dest.length());
+  ReadBuffer readBuffer = ReadBuffer();
+  readBuffer.init(1024, &inputBuffer, "");
+  for (size_t i = 0; i < values.size(); i += 2) {
+    int64_t first;
+    int64_t second;
+    readBuffer.readVLongPair(first, second);
+    ASSERT_EQ(values[i], first);
+    ASSERT_EQ(values[i + 1], second);
+  }
+}
+
 #if defined HADOOP_SNAPPY_LIBRARY
 TEST(Buffers, AppendReadSnappy) {
   string codec = "org.apache.hadoop.io.compress.SnappyCodec";
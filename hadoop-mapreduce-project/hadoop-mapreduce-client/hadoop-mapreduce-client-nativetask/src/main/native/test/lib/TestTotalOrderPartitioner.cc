@@ -0,0 +1,96 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "lib/commons.h"
+#include "lib/BufferStream.h"
+#include "lib/FileSystem.h"
+#include "lib/NativeObjectFactory.h"
+#include "lib/TotalOrderPartitioner.h"
+#include "test_commons.h"
+
+namespace NativeTask {
+
+static uint32_t upperBound(const vector<string> & splitPoints, const string & key) {
+  return std::upper_bound(splitPoints.begin(), splitPoints.end(), key) - splitPoints.begin();
+}
+
+TEST(TotalOrderPartitioner, partition) {
+  vector<string> keys;
+  Generate(keys, 5000, "word");
+  for (uint32_t n = 0; n < 70; n += (n < 10 ? 1 : 13)) {
+    vector<string> splitPoints(keys.begin(), keys.begin() + n);
+    std::sort(splitPoints.begin(), splitPoints.end());
+    TotalOrderPartitioner partitioner(splitPoints, NativeObjectFactory::BytesComparator);
+    ASSERT_EQ(n + 1, partitioner.numPartitions());
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_EQ(upperBound(splitPoints, keys[i]),
+          partitioner.getPartition(keys[i].data(), keys[i].length()));
+    }
+    // the split points themselves, and a duplicated one
+    if (n > 2) {
+      splitPoints.insert(splitPoints.begin() + n / 2, splitPoints[n / 2]);
+      TotalOrderPartitioner duplicated(splitPoints, NativeObjectFactory::BytesComparator);
+      for (size_t i = 0; i < splitPoints.size(); i++) {
+        const string & key = splitPoints[i];
+        ASSERT_EQ(upperBound(splitPoints, key), duplicated.getPartition(key.data(), key.length()));
+      }
+    }
+  }
+
+  vector<string> unsorted;
+  unsorted.push_back("b");
+  unsorted.push_back("a");
+  ASSERT_THROW(TotalOrderPartitioner(unsorted, NativeObjectFactory::BytesComparator),
+      IOException);
+}
+
+TEST(TotalOrderPartitioner, create) {
+  const string path = "splitpoints";
+  vector<string> splitPoints;
+  splitPoints.push_back("");
+  splitPoints.push_back("apple");
+  splitPoints.push_back("pear");
+  string content;
+  for (size_t i = 0; i < splitPoints.size(); i++) {
+    uint32_t length = bswap((uint32_t)splitPoints[i].length());
+    content.append((const char *)&length, 4);
+    content.append(splitPoints[i]);
+  }
+  OutputStream * fout = FileSystem::getLocal().create(path);
+  fout->write(content.data(), content.length());
+  delete fout;
+  TotalOrderPartitioner * partitioner = TotalOrderPartitioner::create(path,
+      NativeObjectFactory::BytesComparator);
+  ASSERT_EQ(4, partitioner->numPartitions());
+  ASSERT_EQ(1, partitioner->getPartition("", 0));
+  ASSERT_EQ(1, partitioner->getPartition("ant", 3));
+  ASSERT_EQ(2, partitioner->getPartition("apple", 5));
+  ASSERT_EQ(3, partitioner->getPartition("zebra", 5));
+  delete partitioner;
+
+  // truncated
+  fout = FileSystem::getLocal().create(path);
+  fout->write(content.data(), content.length() - 1);
+  delete fout;
+  ASSERT_THROW(TotalOrderPartitioner::create(path, NativeObjectFactory::BytesComparator),
+      IOException);
+  FileSystem::getLocal().remove(path);
+}
+
+} // namespace NativeTask
@@ -17,6 +17,7 @@
  */
 
 #include "util/Checksum.h"
+#include "util/XXHash.h"
 #include "test_commons.h"
 
 void TestChecksum(ChecksumType type, void * buff, uint32_t len) {
@@ -24,6 +25,66 @@ void TestChecksum(ChecksumType type, void * buff, uint32_t len) {
   Checksum::update(type, chm, buff, len);
 }
 
+TEST(Checksum, HardwareMatchesSoftware) {
+  // long enough for the interleaved blocks, the offsets move the start
+  // off the 8 and 16 byte boundaries
+  const uint32_t size = 8192 * 3 * 2 + 1024;
+  uint8_t * buff = new uint8_t[size + 16];
+  for (uint32_t i = 0; i < size + 16; i++) {
+    buff[i] = (uint8_t)(i * 2654435761U >> 13);
+  }
+  const uint32_t lengths[] = {0, 1, 7, 15, 16, 63, 64, 65, 100, 767, 768, 1000, 4097,
+      8192 * 3 - 1, 8192 * 3, 8192 * 3 + 768 + 13, size};
+  for (uint32_t offset = 0; offset < 16; offset += 3) {
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+      const uint8_t * data = buff + offset;
+      uint32_t length = lengths[i];
+      ASSERT_EQ(crc32_zlib_sb8(0xffffffff, data, length),
+          crc32_zlib_update(0xffffffff, data, length));
+      ASSERT_EQ(crc32c_sb8(0xffffffff, data, length), crc32c_update(0xffffffff, data, length));
+      // continuing from a running value
+      ASSERT_EQ(crc32_zlib_sb8(0x12345678, data, length),
+          crc32_zlib_update(0x12345678, data, length));
+      ASSERT_EQ(crc32c_sb8(0x12345678, data, length), crc32c_update(0x12345678, data, length));
+    }
+  }
+
+  // check values of "123456789"
+  const char * check = "123456789";
+  uint32_t crc = Checksum::init(CHECKSUM_CRC32);
+  Checksum::update(CHECKSUM_CRC32, crc, check, 9);
+  ASSERT_EQ(0xCBF43926, Checksum::getValue(CHECKSUM_CRC32, crc));
+  crc = Checksum::init(CHECKSUM_CRC32C);
+  Checksum::update(CHECKSUM_CRC32C, crc, check, 9);
+  ASSERT_EQ(0xE3069283, Checksum::getValue(CHECKSUM_CRC32C, crc));
+  delete[] buff;
+}
+
+TEST(Checksum, XXHash64) {
+  // reference values of the xxHash64 test suite, seed 0
+  ASSERT_EQ(0xEF46DB3751D8E999ULL, XXHash64::hash("", 0));
+  ASSERT_EQ(0xD24EC4F1A98C6E5BULL, XXHash64::hash("a", 1));
+  ASSERT_EQ(0x44BC2CF5AD770999ULL, XXHash64::hash("abc", 3));
+  const char * text = "Nobody inspects the spammish repetition";
+  ASSERT_EQ(0xFBCEA83C8A378BF1ULL, XXHash64::hash(text, strlen(text)));
+
+  // the same as one update however the data is split
+  const uint32_t size = 1000;
+  uint8_t buff[size];
+  for (uint32_t i = 0; i < size; i++) {
+    buff[i] = (uint8_t)(i * 2654435761U >> 13);
+  }
+  const uint64_t expect = XXHash64::hash(buff, size);
+  for (uint32_t step = 1; step < 70; step += 3) {
+    XXHash64 hasher;
+    for (uint32_t pos = 0; pos < size; pos += step) {
+      hasher.update(buff + pos, std::min(step, size - pos));
+    }
+    ASSERT_EQ(expect, hasher.digest());
+  }
+  ASSERT_NE(expect, XXHash64::hash(buff, size, 1));
+}
+
 TEST(Perf, CRC) {
   uint32_t len = TestConfig.getInt("checksum.perf.size", 1024 * 1024 * 50);
   int testTime = TestConfig.getInt("checksum.perf.time", 2);
@@ -39,5 +100,13 @@ TEST(Perf, CRC) {
     TestChecksum(CHECKSUM_CRC32C, buff, len);
   }
   LOG("%s", timer.getSpeedM("CRC32C", len * testTime).c_str());
+  timer.reset();
+  uint64_t hash = 0;
+  for (int i = 0; i < testTime; i++) {
+    hash ^= XXHash64::hash(buff, len);
+  }
+  LOG("%s", timer.getSpeedM("XXHash64", len * testTime).c_str());
+  // prevent compiler optimization
+  TestConfig.setInt("tempvalue", (int)hash);
   delete[] buff;
 }
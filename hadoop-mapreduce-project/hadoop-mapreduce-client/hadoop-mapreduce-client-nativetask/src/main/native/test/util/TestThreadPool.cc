@@ -0,0 +1,52 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lib/commons.h"
+#include "util/ThreadPool.h"
+#include "test_commons.h"
+
+class CountTask : public Runnable {
+private:
+  Lock * _lock;
+  uint32_t * _count;
+
+public:
+  CountTask(Lock * lock, uint32_t * count)
+      : _lock(lock), _count(count) {
+  }
+
+  virtual void run() {
+    ScopeLock<Lock> autoLock(*_lock);
+    (*_count)++;
+  }
+};
+
+TEST(ThreadPool, runAllTasks) {
+  const uint32_t NUM_TASKS = 1000;
+  Lock lock;
+  uint32_t count = 0;
+  vector<CountTask> tasks(NUM_TASKS, CountTask(&lock, &count));
+  {
+    ThreadPool pool(4);
+    ASSERT_EQ(4, pool.size());
+    for (uint32_t i = 0; i < NUM_TASKS; i++) {
+      pool.submit(&tasks[i]);
+    }
+  }
+  ASSERT_EQ(NUM_TASKS, count);
+}
@@ -31,6 +31,9 @@ void TestVLong(int64_t v) {
   int64_t rv = WritableUtils::ReadVLong(buff2, rsize);
   ASSERT_EQ(v, rv);
   ASSERT_EQ(rsize, dsize);
+  rv = WritableUtils::ReadVLongUnchecked(buff2, rsize);
+  ASSERT_EQ(v, rv);
+  ASSERT_EQ(rsize, dsize);
 }
 
 
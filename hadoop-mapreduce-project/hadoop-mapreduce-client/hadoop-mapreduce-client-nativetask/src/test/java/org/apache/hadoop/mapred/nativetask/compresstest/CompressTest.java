@@ -21,9 +21,11 @@
 import static org.junit.Assert.assertTrue;
 
 import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.CommonConfigurationKeys;
 import org.apache.hadoop.fs.FileSystem;
 import org.apache.hadoop.fs.Path;
 import org.apache.hadoop.io.Text;
+import org.apache.hadoop.io.compress.ZStandardCodec;
 import org.apache.hadoop.mapred.nativetask.NativeRuntime;
 import org.apache.hadoop.mapred.nativetask.kvtest.TestInputFile;
 import org.apache.hadoop.mapred.nativetask.testutil.ResultVerifier;
@@ -37,7 +39,11 @@
 import org.junit.Before;
 import org.junit.Test;
 
+import com.google.common.base.Charsets;
+
+import java.io.File;
 import java.io.IOException;
+import java.nio.file.Files;
 
 public class CompressTest {
 
@@ -117,6 +123,85 @@ public void testLz4Compress() throws Exception {
     ResultVerifier.verifyCounters(hadoopJob, nativeJob);
   }
 
+  /**
+   * Reducers read the map output of the native collector with the Java
+   * ZStandardCodec, so both must agree on the block framing.
+   */
+  @Test
+  public void testZstdCompress() throws Exception {
+    final String zstdCodec = "org.apache.hadoop.io.compress.ZStandardCodec";
+    Assume.assumeTrue(ZStandardCodec.isNativeCodeLoaded());
+    Assume.assumeTrue(NativeRuntime.supportsCompressionCodec(
+      zstdCodec.getBytes(Charsets.UTF_8)));
+
+    nativeConf.set(MRJobConfig.MAP_OUTPUT_COMPRESS_CODEC, zstdCodec);
+    final String nativeOutputPath =
+      TestConstants.NATIVETASK_COMPRESS_TEST_NATIVE_OUTPUTDIR + "/zstd";
+    final Job nativeJob = CompressMapper.getCompressJob("nativezstd", nativeConf,
+      TestConstants.NATIVETASK_COMPRESS_TEST_INPUTDIR, nativeOutputPath);
+    assertTrue(nativeJob.waitForCompletion(true));
+
+    hadoopConf.set(MRJobConfig.MAP_OUTPUT_COMPRESS_CODEC, zstdCodec);
+    final String hadoopOutputPath =
+      TestConstants.NATIVETASK_COMPRESS_TEST_NORMAL_OUTPUTDIR + "/zstd";
+    final Job hadoopJob = CompressMapper.getCompressJob("hadoopzstd", hadoopConf,
+      TestConstants.NATIVETASK_COMPRESS_TEST_INPUTDIR, hadoopOutputPath);
+    assertTrue(hadoopJob.waitForCompletion(true));
+    final boolean compareRet = ResultVerifier.verify(nativeOutputPath, hadoopOutputPath);
+    assertEquals("file compare result: if they are the same ,then return true", true, compareRet);
+    ResultVerifier.verifyCounters(hadoopJob, nativeJob);
+  }
+
+  /**
+   * The native collector and the Java reducers both pick the dictionary up
+   * from {@link CommonConfigurationKeys#IO_COMPRESSION_CODEC_ZSTD_DICTIONARY_KEY};
+   * map output compressed against it must read back unchanged.
+   */
+  @Test
+  public void testZstdDictionaryCompress() throws Exception {
+    final String zstdCodec = "org.apache.hadoop.io.compress.ZStandardCodec";
+    Assume.assumeTrue(ZStandardCodec.isNativeCodeLoaded());
+    Assume.assumeTrue(NativeRuntime.supportsCompressionCodec(
+      zstdCodec.getBytes(Charsets.UTF_8)));
+
+    final File dictionary =
+      new File(TestConstants.NATIVETASK_COMPRESS_TEST_DIR, "zstd.dict");
+    dictionary.getParentFile().mkdirs();
+    final StringBuilder content = new StringBuilder();
+    for (int i = 0; i < 256; i++) {
+      content.append("nativetask-zstd-dictionary-").append(i).append('\n');
+    }
+    Files.write(dictionary.toPath(), content.toString().getBytes(Charsets.UTF_8));
+    final String dictionaryKey =
+      CommonConfigurationKeys.IO_COMPRESSION_CODEC_ZSTD_DICTIONARY_KEY;
+
+    try {
+      nativeConf.set(MRJobConfig.MAP_OUTPUT_COMPRESS_CODEC, zstdCodec);
+      nativeConf.set(dictionaryKey, dictionary.getAbsolutePath());
+      final String nativeOutputPath =
+        TestConstants.NATIVETASK_COMPRESS_TEST_NATIVE_OUTPUTDIR + "/zstddict";
+      final Job nativeJob = CompressMapper.getCompressJob("nativezstddict",
+        nativeConf, TestConstants.NATIVETASK_COMPRESS_TEST_INPUTDIR,
+        nativeOutputPath);
+      assertTrue(nativeJob.waitForCompletion(true));
+
+      hadoopConf.set(MRJobConfig.MAP_OUTPUT_COMPRESS_CODEC, zstdCodec);
+      hadoopConf.set(dictionaryKey, dictionary.getAbsolutePath());
+      final String hadoopOutputPath =
+        TestConstants.NATIVETASK_COMPRESS_TEST_NORMAL_OUTPUTDIR + "/zstddict";
+      final Job hadoopJob = CompressMapper.getCompressJob("hadoopzstddict",
+        hadoopConf, TestConstants.NATIVETASK_COMPRESS_TEST_INPUTDIR,
+        hadoopOutputPath);
+      assertTrue(hadoopJob.waitForCompletion(true));
+      final boolean compareRet = ResultVerifier.verify(nativeOutputPath, hadoopOutputPath);
+      assertEquals("file compare result: if they are the same ,then return true", true, compareRet);
+      ResultVerifier.verifyCounters(hadoopJob, nativeJob);
+    } finally {
+      nativeConf.unset(dictionaryKey);
+      hadoopConf.unset(dictionaryKey);
+    }
+  }
+
   @Before
   public void startUp() throws Exception {
     Assume.assumeTrue(NativeCodeLoader.isNativeCodeLoaded());
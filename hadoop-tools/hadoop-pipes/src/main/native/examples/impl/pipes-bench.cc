@@ -0,0 +1,370 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A mapper and a reducer that pass their records through unchanged, so that
+ * a job running them measures the cost of the pipes protocol rather than of
+ * the application.
+ *
+ * Run as "pipes-bench bench [megabytes [record-size ...]]", it is its own
+ * parent instead: it forks a child that runs the task, speaks the binary
+ * protocol to it over a loopback socket the way the Java task does, and
+ * reports how fast the records went through the map, through the reduce
+ * with a message per value, and through the reduce with REDUCE_VALUES
+ * batches.
+ */
+
+#include "hadoop/Pipes.hh"
+#include "hadoop/SerialUtils.hh"
+#include "hadoop/StringUtils.hh"
+#include "hadoop/TemplateFactory.hh"
+
+#include <algorithm>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using HadoopUtils::Error;
+using HadoopUtils::serializeInt;
+using HadoopUtils::serializeString;
+using HadoopUtils::deserializeInt;
+using HadoopUtils::deserializeString;
+
+class NoOpMap: public HadoopPipes::Mapper {
+public:
+  NoOpMap(HadoopPipes::TaskContext& context) {}
+
+  void map(HadoopPipes::MapContext& context) {
+    HadoopPipes::StringView key = context.getInputKeyView();
+    HadoopPipes::StringView value = context.getInputValueView();
+    context.emit(key.data, key.length, value.data, value.length);
+  }
+};
+
+class NoOpReduce: public HadoopPipes::Reducer {
+public:
+  NoOpReduce(HadoopPipes::TaskContext& context) {}
+
+  void reduce(HadoopPipes::ReduceContext& context) {
+    while (context.nextValue()) {
+      HadoopPipes::StringView key = context.getInputKeyView();
+      HadoopPipes::StringView value = context.getInputValueView();
+      context.emit(key.data, key.length, value.data, value.length);
+    }
+  }
+};
+
+/*
+ * The message codes of the binary protocol, which must match those in
+ * HadoopPipes.cc.
+ */
+enum MESSAGE_TYPE {START_MESSAGE = 0, SET_JOB_CONF = 1, RUN_MAP = 3,
+                   MAP_ITEM = 4, RUN_REDUCE = 5, REDUCE_KEY = 6,
+                   REDUCE_VALUE = 7, CLOSE = 8, AUTHENTICATION_REQ = 10,
+                   REDUCE_VALUES = 12,
+                   OUTPUT = 50, PARTITIONED_OUTPUT, STATUS, PROGRESS, DONE,
+                   REGISTER_COUNTER, INCREMENT_COUNTER, AUTHENTICATION_RESP,
+                   OUTPUT_BATCH};
+
+enum Phase {MAP_PHASE, REDUCE_PHASE, BATCHED_REDUCE_PHASE};
+
+static const char* PHASE_NAMES[] = {"map", "reduce", "reduce-batched"};
+
+/* the bytes of each key, which are counted in the record size */
+static const size_t KEY_SIZE = 8;
+/* how many values the reduce input has for each key */
+static const uint64_t VALUES_PER_KEY = 16;
+/* the size of the uplink and REDUCE_VALUES batches, as the Java task sends */
+static const int BATCH_BYTES = 64 * 1024;
+
+/*
+ * What the thread that reads the child's messages found.
+ */
+struct UplinkResult {
+  FILE* file;
+  uint64_t records;
+  uint64_t bytes;
+  string error;
+};
+
+static void* readUplink(void* arg) {
+  UplinkResult* result = (UplinkResult*) arg;
+  try {
+    HadoopUtils::FileInStream in;
+    in.open(result->file);
+    string key;
+    string value;
+    while (true) {
+      int32_t cmd = deserializeInt(in);
+      switch (cmd) {
+      case PARTITIONED_OUTPUT:
+        deserializeInt(in);
+        // fall through
+      case OUTPUT:
+        deserializeString(key, in);
+        deserializeString(value, in);
+        result->records += 1;
+        result->bytes += key.size() + value.size();
+        break;
+      case OUTPUT_BATCH: {
+        int32_t count = deserializeInt(in);
+        string batch;
+        deserializeString(batch, in);
+        const char* data = batch.data();
+        size_t offset = 0;
+        for (int32_t i = 0; i < count; ++i) {
+          int64_t partition;
+          offset += HadoopUtils::deserializeLong(partition, data + offset,
+                                                 batch.size() - offset);
+          offset += deserializeString(key, data + offset,
+                                      batch.size() - offset);
+          offset += deserializeString(value, data + offset,
+                                      batch.size() - offset);
+          result->bytes += key.size() + value.size();
+        }
+        result->records += count;
+        break;
+      }
+      case STATUS:
+        deserializeString(value, in);
+        break;
+      case PROGRESS: {
+        float progress;
+        HadoopUtils::deserializeFloat(progress, in);
+        break;
+      }
+      case REGISTER_COUNTER:
+        deserializeInt(in);
+        deserializeString(key, in);
+        deserializeString(value, in);
+        break;
+      case INCREMENT_COUNTER:
+        deserializeInt(in);
+        HadoopUtils::deserializeLong(in);
+        break;
+      case DONE:
+        return NULL;
+      default:
+        throw Error("unexpected message " + HadoopUtils::toString(cmd) +
+                    " from the child");
+      }
+    }
+  } catch (Error& err) {
+    result->error = err.getMessage();
+  }
+  return NULL;
+}
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Write the number i as the KEY_SIZE digits of key.
+ */
+static void setKey(string& key, uint64_t i) {
+  for (size_t pos = KEY_SIZE; pos > 0; --pos) {
+    key[pos - 1] = '0' + i % 10;
+    i /= 10;
+  }
+}
+
+static void sendInput(HadoopUtils::OutStream& out, Phase phase,
+                      size_t recordSize, uint64_t records) {
+  string key(KEY_SIZE, '0');
+  string value(recordSize > KEY_SIZE ? recordSize - KEY_SIZE : 0, 'v');
+  if (phase == MAP_PHASE) {
+    serializeInt(RUN_MAP, out);
+    serializeString("", out);
+    serializeInt(0, out);
+    serializeInt(1, out);
+    for (uint64_t i = 0; i < records; ++i) {
+      setKey(key, i);
+      serializeInt(MAP_ITEM, out);
+      serializeString(key, out);
+      serializeString(value, out);
+    }
+    return;
+  }
+  serializeInt(RUN_REDUCE, out);
+  serializeInt(0, out);
+  serializeInt(1, out);
+  string batch;
+  HadoopPipes::StringView view(value);
+  for (uint64_t i = 0; i < records; i += VALUES_PER_KEY) {
+    setKey(key, i / VALUES_PER_KEY);
+    uint64_t values = std::min(VALUES_PER_KEY, records - i);
+    if (phase == REDUCE_PHASE) {
+      serializeInt(REDUCE_KEY, out);
+      serializeString(key, out);
+      for (uint64_t v = 0; v < values; ++v) {
+        serializeInt(REDUCE_VALUE, out);
+        serializeString(value, out);
+      }
+      continue;
+    }
+    uint64_t sent = 0;
+    while (sent < values) {
+      batch.clear();
+      do {
+        char length[HadoopUtils::MAX_VLONG_SIZE];
+        batch.append(length, HadoopUtils::serializeLong(view.length, length));
+        batch.append(view.data, view.length);
+        sent += 1;
+      } while (batch.size() < (size_t) BATCH_BYTES && sent < values);
+      serializeInt(REDUCE_VALUES, out);
+      serializeString(key, out);
+      serializeInt(sent < values ? 1 : 0, out);
+      serializeString(batch, out);
+    }
+  }
+}
+
+/*
+ * Run one task in a child and return how many seconds it took to put the
+ * records through it.
+ */
+static double timeTask(const HadoopPipes::Factory& factory, Phase phase,
+                      size_t recordSize, uint64_t records) {
+  int listener = socket(PF_INET, SOCK_STREAM, 0);
+  HADOOP_ASSERT(listener != -1,
+                string("problem creating socket: ") + strerror(errno));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = 0;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrLength = sizeof(addr);
+  HADOOP_ASSERT(bind(listener, (sockaddr*) &addr, sizeof(addr)) == 0 &&
+                listen(listener, 16) == 0 &&
+                getsockname(listener, (sockaddr*) &addr, &addrLength) == 0,
+                string("problem listening on socket: ") + strerror(errno));
+  setenv("mapreduce.pipes.command.port",
+         HadoopUtils::toString(ntohs(addr.sin_port)).c_str(), 1);
+  fflush(stdout);
+  pid_t child = fork();
+  HADOOP_ASSERT(child != -1, string("problem forking: ") + strerror(errno));
+  if (child == 0) {
+    close(listener);
+    _exit(HadoopPipes::runTask(factory) ? 0 : 1);
+  }
+  int sock = accept(listener, NULL, NULL);
+  HADOOP_ASSERT(sock != -1,
+                string("problem accepting socket: ") + strerror(errno));
+  FILE* down = fdopen(sock, "w");
+  FILE* up = fdopen(dup(sock), "r");
+  setvbuf(down, NULL, _IOFBF, 128 * 1024);
+  setvbuf(up, NULL, _IOFBF, 128 * 1024);
+
+  UplinkResult result;
+  result.file = up;
+  result.records = 0;
+  result.bytes = 0;
+  pthread_t reader;
+  pthread_create(&reader, NULL, readUplink, &result);
+
+  double start = now();
+  HadoopUtils::FileOutStream out;
+  out.open(down);
+  // The child has no password file, so it accepts any digest
+  serializeInt(AUTHENTICATION_REQ, out);
+  serializeString("", out);
+  serializeString("", out);
+  serializeInt(START_MESSAGE, out);
+  serializeInt(0, out);
+  serializeInt(SET_JOB_CONF, out);
+  serializeInt(2, out);
+  serializeString("mapreduce.pipes.uplink.batch.bytes", out);
+  serializeString(HadoopUtils::toString(BATCH_BYTES), out);
+  sendInput(out, phase, recordSize, records);
+  serializeInt(CLOSE, out);
+  out.flush();
+  pthread_join(reader, NULL);
+  double elapsed = now() - start;
+
+  // Everything has been read, so do not wait for the child's ping thread
+  kill(child, SIGKILL);
+  waitpid(child, NULL, 0);
+  fclose(down);
+  fclose(up);
+  close(listener);
+  HADOOP_ASSERT(result.error.empty(), result.error);
+  HADOOP_ASSERT(result.records == records,
+                "the child output " + HadoopUtils::toString(result.records) +
+                " of " + HadoopUtils::toString(records) + " records");
+  HADOOP_ASSERT(result.bytes == records * recordSize,
+                "the child output the wrong number of bytes");
+  return elapsed;
+}
+
+static int runBenchmark(int argc, char *argv[]) {
+  uint64_t megabytes = argc > 2 ? strtoull(argv[2], NULL, 10) : 64;
+  vector<size_t> sizes;
+  for (int i = 3; i < argc; ++i) {
+    sizes.push_back(strtoul(argv[i], NULL, 10));
+  }
+  if (sizes.empty()) {
+    sizes.push_back(16);
+    sizes.push_back(100);
+    sizes.push_back(1000);
+    sizes.push_back(10000);
+  }
+  HadoopPipes::TemplateFactory<NoOpMap, NoOpReduce> factory;
+  try {
+    printf("%-16s %8s %12s %14s %10s\n", "phase", "size", "records",
+           "records/s", "MB/s");
+    for (size_t s = 0; s < sizes.size(); ++s) {
+      size_t recordSize = std::max(sizes[s], KEY_SIZE);
+      uint64_t records = std::max((uint64_t) 1,
+                                  megabytes * 1024 * 1024 / recordSize);
+      for (int phase = MAP_PHASE; phase <= BATCHED_REDUCE_PHASE; ++phase) {
+        double seconds = timeTask(factory, (Phase) phase, recordSize, records);
+        printf("%-16s %8lu %12llu %14.0f %10.1f\n", PHASE_NAMES[phase],
+               (unsigned long) recordSize, (unsigned long long) records,
+               records / seconds,
+               records * recordSize / seconds / (1024 * 1024));
+      }
+    }
+  } catch (Error& err) {
+    fprintf(stderr, "Error: %s\n", err.getMessage().c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    return runBenchmark(argc, argv);
+  }
+  return HadoopPipes::runTask(HadoopPipes::TemplateFactory<NoOpMap,
+                                                           NoOpReduce>());
+}
@@ -31,6 +31,7 @@
 #include <string>
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace HadoopPipes {
@@ -40,6 +41,23 @@ namespace HadoopPipes {
  * foreign code interface to Hadoop Map/Reduce.
  */
 
+/**
+ * A view of bytes that belong to someone else.  It does not copy them, so
+ * it is only valid for as long as they are.
+ */
+class StringView {
+public:
+  const char* data;
+  size_t length;
+
+  StringView(): data(NULL), length(0) {}
+  StringView(const char* _data, size_t _length)
+    : data(_data), length(_length) {}
+  StringView(const std::string& str): data(str.data()), length(str.size()) {}
+
+  std::string toString() const { return std::string(data, length); }
+};
+
 /**
  * A JobConf defines the properties for a job.
  */
@@ -88,11 +106,40 @@ public:
    */
   virtual const std::string& getInputValue() = 0;
 
+  /**
+   * Get the current key without copying it.  The view is only valid until
+   * the next key or value is read, ie. until map or reduce returns or
+   * nextValue is called.
+   * @return the current key
+   */
+  virtual StringView getInputKeyView() {
+    return StringView(getInputKey());
+  }
+
+  /**
+   * Get the current value without copying it.  The view is only valid until
+   * the next key or value is read.
+   * @return the current value
+   */
+  virtual StringView getInputValueView() {
+    return StringView(getInputValue());
+  }
+
   /**
    * Generate an output record
    */
   virtual void emit(const std::string& key, const std::string& value) = 0;
 
+  /**
+   * Generate an output record from buffers, which may be reused as soon as
+   * this returns.  Unlike emit(std::string, std::string), the caller does
+   * not need to build strings for every record.
+   */
+  virtual void emit(const char* key, size_t keyLength,
+                    const char* value, size_t valueLength) {
+    emit(std::string(key, keyLength), std::string(value, valueLength));
+  }
+
   /**
    * Mark your task as having made progress without changing the status 
    * message.
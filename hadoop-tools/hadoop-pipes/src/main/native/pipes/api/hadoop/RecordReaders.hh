@@ -0,0 +1,123 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HADOOP_PIPES_RECORD_READERS_HH
+#define HADOOP_PIPES_RECORD_READERS_HH
+
+#include "hadoop/Pipes.hh"
+
+#include <string>
+#include <vector>
+
+namespace HadoopPipes {
+
+/**
+ * RecordReaders that read the input split in the C++ task, so that the
+ * records do not have to be read in Java and sent over the protocol.  To
+ * use one, pass it to the TemplateFactory and set
+ * mapreduce.pipes.isjavarecordreader to false, keeping a FileInputFormat
+ * such as TextInputFormat or SequenceFileInputFormat to make the splits.
+ *
+ * Paths with an hdfs: (or other non-local) scheme are read through
+ * libhdfs, if the library was built with it, and file: paths or paths
+ * without a scheme are read from the local file system.  Either way the
+ * file is read with positioned reads of mapreduce.pipes.reader.buffer.bytes
+ * (4MB by default) at a time.
+ */
+
+/**
+ * A FileSplit, as Java's FileSplit.write serializes it.
+ */
+struct FileSplit {
+  std::string path;
+  int64_t start;
+  int64_t length;
+
+  /**
+   * Parse the split that MapContext::getInputSplit returns.
+   */
+  static FileSplit parse(const std::string& split);
+};
+
+class BufferedInput;
+
+/**
+ * Reads the lines of an uncompressed text file, as the Java LineRecordReader
+ * does: a line belongs to the split it starts in, and ends at a LF, a CR or
+ * a CRLF, which is not part of the value.  The key is the byte offset of
+ * the line in decimal.
+ */
+class LineRecordReader: public RecordReader {
+private:
+  BufferedInput* input;
+  int64_t start;
+  int64_t end;
+public:
+  LineRecordReader(MapContext& context);
+  virtual bool next(std::string& key, std::string& value);
+  virtual float getProgress();
+  virtual ~LineRecordReader();
+};
+
+class Decompressor;
+
+/**
+ * Reads the records of a SequenceFile, as the Java SequenceFileRecordReader
+ * does: each split starts at the first sync mark in it and ends at the first
+ * sync mark after it.  The files may be uncompressed, record compressed or
+ * block compressed, with DefaultCodec or GzipCodec.  The keys and values of
+ * type Text and BytesWritable are given as their bytes, as the Java reader
+ * sends them, and those of other types in their serialized form.
+ */
+class SequenceFileRecordReader: public RecordReader {
+private:
+  BufferedInput* input;
+  int64_t start;
+  int64_t end;
+  std::string keyClass;
+  std::string valueClass;
+  bool recordCompressed;
+  bool blockCompressed;
+  Decompressor* decompressor;
+  char sync[16];
+  bool syncSeen;
+  bool more;
+  // The decompressed key lengths, keys, value lengths and values of the
+  // block being read, how far each has been read, and how many records
+  // are left in it
+  std::string blockBuffers[4];
+  size_t blockOffsets[4];
+  int64_t blockRecords;
+  std::string rawKey;
+  std::string rawValue;
+
+  void readHeader();
+  void seekToSync(int64_t position);
+  void checkSync();
+  bool readBlock();
+  bool readRecord(std::string& key, std::string& value);
+  void readBlockRecord(std::string& key, std::string& value);
+public:
+  SequenceFileRecordReader(MapContext& context);
+  virtual bool next(std::string& key, std::string& value);
+  virtual float getProgress();
+  virtual ~SequenceFileRecordReader();
+};
+
+}
+
+#endif
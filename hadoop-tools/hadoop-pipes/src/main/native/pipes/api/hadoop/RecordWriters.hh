@@ -0,0 +1,88 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HADOOP_PIPES_RECORD_WRITERS_HH
+#define HADOOP_PIPES_RECORD_WRITERS_HH
+
+#include "hadoop/Pipes.hh"
+
+#include <string>
+
+namespace HadoopPipes {
+
+/**
+ * RecordWriters that write the reduce output in the C++ task, so that the
+ * records do not have to be sent over the protocol and written in Java.
+ * To use one, pass it to the TemplateFactory and leave
+ * mapreduce.pipes.isjavarecordwriter false, its default.
+ *
+ * The writers create part-NNNNN in mapreduce.task.output.dir, the work
+ * directory of the task attempt, which the FileOutputCommitter of the job
+ * moves into the output directory when the task commits, just as it does
+ * with the files of a Java OutputFormat.  Directories with an hdfs: (or
+ * other non-local) scheme are written through libhdfs, if the library was
+ * built with it, and file: directories from the local file system.  Either
+ * way the records are collected in a buffer of
+ * mapreduce.pipes.writer.buffer.bytes (4MB by default) and written a
+ * buffer at a time.  Compressed output is not supported.
+ */
+
+class BufferedOutput;
+
+/**
+ * Writes each record as a line, as the Java TextOutputFormat does: the key,
+ * mapreduce.output.textoutputformat.separator (a tab by default), the value
+ * and a LF.
+ */
+class LineRecordWriter: public RecordWriter {
+private:
+  BufferedOutput* output;
+  std::string separator;
+public:
+  LineRecordWriter(ReduceContext& context);
+  virtual void emit(const std::string& key, const std::string& value);
+  virtual void close();
+  virtual ~LineRecordWriter();
+};
+
+/**
+ * Writes an uncompressed SequenceFile, as the Java SequenceFileOutputFormat
+ * does, with a sync mark about every 2000 bytes.  The key and value classes
+ * are mapreduce.job.output.key.class and mapreduce.job.output.value.class,
+ * Text by default.  Keys and values of type Text and BytesWritable are
+ * given as their bytes, as the Java writer would get them, and those of
+ * other types in their serialized form.
+ */
+class SequenceFileRecordWriter: public RecordWriter {
+private:
+  BufferedOutput* output;
+  std::string keyClass;
+  std::string valueClass;
+  char sync[16];
+  int64_t lastSync;
+  std::string rawKey;
+  std::string rawValue;
+public:
+  SequenceFileRecordWriter(ReduceContext& context);
+  virtual void emit(const std::string& key, const std::string& value);
+  virtual void close();
+  virtual ~SequenceFileRecordWriter();
+};
+
+}
+
+#endif
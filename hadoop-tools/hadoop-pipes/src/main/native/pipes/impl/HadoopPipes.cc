@@ -20,6 +20,7 @@
 #include "hadoop/SerialUtils.hh"
 #include "hadoop/StringUtils.hh"
 
+#include <algorithm>
 #include <map>
 #include <vector>
 
@@ -31,7 +32,10 @@
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <pthread.h>
 #include <iostream>
 #include <fstream>
@@ -93,6 +97,8 @@ namespace HadoopPipes {
     virtual void runReduce(int reduce, bool pipedOutput) = 0;
     virtual void reduceKey(const string& key) = 0;
     virtual void reduceValue(const string& value) = 0;
+    virtual void reduceValues(const string& key, const string& values,
+                              bool more) = 0;
     virtual void close() = 0;
     virtual void abort() = 0;
     virtual ~DownwardProtocol() {}
@@ -110,6 +116,11 @@ namespace HadoopPipes {
                                  const string& name) = 0;
     virtual void 
       incrementCounter(const TaskContext::Counter* counter, uint64_t amount) = 0;
+    /**
+     * Allow outputs to be sent together in frames of about this many bytes.
+     * 0 sends each on its own.
+     */
+    virtual void setOutputBatchBytes(int bytes) {}
     virtual ~UpwardProtocol() {}
   };
 
@@ -296,26 +307,471 @@ namespace HadoopPipes {
 
   enum MESSAGE_TYPE {START_MESSAGE, SET_JOB_CONF, SET_INPUT_TYPES, RUN_MAP, 
                      MAP_ITEM, RUN_REDUCE, REDUCE_KEY, REDUCE_VALUE, 
-                     CLOSE, ABORT, AUTHENTICATION_REQ,
+                     CLOSE, ABORT, AUTHENTICATION_REQ, SHM_TRANSPORT,
+                     REDUCE_VALUES,
                      OUTPUT=50, PARTITIONED_OUTPUT, STATUS, PROGRESS, DONE,
-                     REGISTER_COUNTER, INCREMENT_COUNTER, AUTHENTICATION_RESP};
+                     REGISTER_COUNTER, INCREMENT_COUNTER, AUTHENTICATION_RESP,
+                     OUTPUT_BATCH, SHM_TRANSPORT_ACK};
+
+  // The partition of the outputs in an OUTPUT_BATCH that have none
+  const int NO_PARTITION = -1;
+
+  /**
+   * An output stream that appends to a string.
+   */
+  class StringOutStream: public OutStream {
+  private:
+    string& buffer;
+  public:
+    StringOutStream(string& _buffer): buffer(_buffer) {}
+
+    virtual void write(const void* buf, size_t len) {
+      buffer.append((const char*) buf, len);
+    }
+
+    virtual void flush() {}
+  };
+
+  /**
+   * Wakes up the threads waiting on a shared memory ring.  Once the rings
+   * are in use, the socket only carries these wake up calls, a byte each.
+   * Every byte read wakes every waiter, which then checks its ring again,
+   * so one thread can wait for the socket for all of them.
+   */
+  class Doorbell {
+  private:
+    FILE* in;
+    FILE* out;
+    pthread_mutex_t mutex;
+    pthread_cond_t rung;
+    bool reading;
+    uint64_t generation;
+  public:
+    Doorbell(FILE* _in, FILE* _out) {
+      in = _in;
+      out = _out;
+      reading = false;
+      generation = 0;
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&rung, NULL);
+    }
+
+    /**
+     * @return how many times the doorbell has rung, to pass to wait
+     */
+    uint64_t getGeneration() {
+      pthread_mutex_lock(&mutex);
+      uint64_t result = generation;
+      pthread_mutex_unlock(&mutex);
+      return result;
+    }
+
+    /**
+     * Wait for the other side to ring, unless it has rung since since was
+     * taken from getGeneration, because then another thread might have
+     * read the ring meant for this one.
+     */
+    void wait(uint64_t since) {
+      pthread_mutex_lock(&mutex);
+      if (generation != since) {
+        pthread_mutex_unlock(&mutex);
+        return;
+      }
+      if (reading) {
+        while (since == generation) {
+          pthread_cond_wait(&rung, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+        return;
+      }
+      reading = true;
+      pthread_mutex_unlock(&mutex);
+      int ch = getc(in);
+      pthread_mutex_lock(&mutex);
+      reading = false;
+      generation += 1;
+      pthread_cond_broadcast(&rung);
+      pthread_mutex_unlock(&mutex);
+      HADOOP_ASSERT(ch != EOF, "connection closed while waiting for ring");
+    }
+
+    /**
+     * Wake up the other side.
+     */
+    void ring() {
+      pthread_mutex_lock(&mutex);
+      int result = putc(0, out);
+      if (result != EOF) {
+        result = fflush(out);
+      }
+      pthread_mutex_unlock(&mutex);
+      HADOOP_ASSERT(result != EOF, string("problem ringing doorbell: ") +
+                    strerror(errno));
+    }
+
+    ~Doorbell() {
+      pthread_cond_destroy(&rung);
+      pthread_mutex_destroy(&mutex);
+    }
+  };
+
+  /**
+   * One direction of the shared memory transport: a single producer,
+   * single consumer ring of bytes.  The layout must match
+   * SharedMemoryTransport in Java.  Each field of the header is on a
+   * cache line of its own:
+   *   0   the total number of bytes written, updated by the writer
+   *   64  the total number of bytes read, updated by the reader
+   *   128 1 if the reader is waiting for the doorbell for more bytes
+   *   192 1 if the writer is waiting for the doorbell for more space
+   */
+  class ShmRing {
+  private:
+    int64_t* head;
+    int64_t* tail;
+    int32_t* readerWaiting;
+    int32_t* writerWaiting;
+    char* data;
+    int64_t capacity;
+    Doorbell* doorbell;
+
+    /**
+     * Ring the other side, if it said it was waiting.
+     */
+    void wake(int32_t* flag) {
+      int32_t waiting = 1;
+      if (__atomic_load_n(flag, __ATOMIC_SEQ_CST) == 1 &&
+          __atomic_compare_exchange_n(flag, &waiting, 0, false,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        doorbell->ring();
+      }
+    }
+
+  public:
+    static const int HEADER_SIZE = 256;
+
+    ShmRing(char* base, int64_t _capacity, Doorbell* _doorbell) {
+      head = (int64_t*) base;
+      tail = (int64_t*) (base + 64);
+      readerWaiting = (int32_t*) (base + 128);
+      writerWaiting = (int32_t*) (base + 192);
+      data = base + HEADER_SIZE;
+      capacity = _capacity;
+      doorbell = _doorbell;
+    }
+
+    /**
+     * Copy up to len bytes out of the ring from position, waiting until
+     * there is at least one.
+     * @param published the last position given to publishRead, which is
+     *   updated if this publishes position before waiting
+     * @return the number of bytes copied
+     */
+    size_t read(int64_t position, int64_t& published, char* buf, size_t len) {
+      int64_t available = __atomic_load_n(head, __ATOMIC_ACQUIRE) - position;
+      while (available == 0) {
+        if (published != position) {
+          publishRead(position);
+          published = position;
+        }
+        // Say so before looking again, so that either this sees the new
+        // bytes or the writer sees the flag and rings
+        uint64_t generation = doorbell->getGeneration();
+        __atomic_store_n(readerWaiting, 1, __ATOMIC_SEQ_CST);
+        available = __atomic_load_n(head, __ATOMIC_SEQ_CST) - position;
+        if (available == 0) {
+          doorbell->wait(generation);
+          available = __atomic_load_n(head, __ATOMIC_ACQUIRE) - position;
+        } else {
+          __atomic_store_n(readerWaiting, 0, __ATOMIC_RELAXED);
+        }
+      }
+      int64_t offset = position & (capacity - 1);
+      size_t n = len;
+      if ((int64_t) n > available) {
+        n = available;
+      }
+      if ((int64_t) n > capacity - offset) {
+        n = capacity - offset;
+      }
+      memcpy(buf, data + offset, n);
+      return n;
+    }
+
+    /**
+     * Let the writer reuse the space before position.
+     */
+    void publishRead(int64_t position) {
+      __atomic_store_n(tail, position, __ATOMIC_SEQ_CST);
+      wake(writerWaiting);
+    }
+
+    /**
+     * Copy up to len bytes into the ring at position, waiting until there
+     * is space for at least one.
+     * @param published the last position given to publishWrite, which is
+     *   updated if this publishes position before waiting
+     * @return the number of bytes copied
+     */
+    size_t write(int64_t position, int64_t& published, const char* buf,
+                 size_t len) {
+      int64_t space = capacity - 
+        (position - __atomic_load_n(tail, __ATOMIC_ACQUIRE));
+      while (space == 0) {
+        if (published != position) {
+          publishWrite(position);
+          published = position;
+        }
+        uint64_t generation = doorbell->getGeneration();
+        __atomic_store_n(writerWaiting, 1, __ATOMIC_SEQ_CST);
+        space = capacity - (position - __atomic_load_n(tail, __ATOMIC_SEQ_CST));
+        if (space == 0) {
+          doorbell->wait(generation);
+          space = capacity - 
+            (position - __atomic_load_n(tail, __ATOMIC_ACQUIRE));
+        } else {
+          __atomic_store_n(writerWaiting, 0, __ATOMIC_RELAXED);
+        }
+      }
+      int64_t offset = position & (capacity - 1);
+      size_t n = len;
+      if ((int64_t) n > space) {
+        n = space;
+      }
+      if ((int64_t) n > capacity - offset) {
+        n = capacity - offset;
+      }
+      memcpy(data + offset, buf, n);
+      return n;
+    }
+
+    /**
+     * Let the reader see the bytes before position.
+     */
+    void publishWrite(int64_t position) {
+      __atomic_store_n(head, position, __ATOMIC_SEQ_CST);
+      wake(readerWaiting);
+    }
+
+    int64_t getCapacity() const {
+      return capacity;
+    }
+  };
+
+  /**
+   * Reads the downward messages from a ShmRing.  The position read to is
+   * published a quarter of the ring at a time, and before waiting.
+   */
+  class ShmInStream: public InStream {
+  private:
+    ShmRing ring;
+    int64_t position;
+    int64_t published;
+  public:
+    ShmInStream(const ShmRing& _ring): ring(_ring) {
+      position = 0;
+      published = 0;
+    }
+
+    virtual void read(void *buf, size_t len) {
+      char* dest = (char*) buf;
+      while (len > 0) {
+        size_t n = ring.read(position, published, dest, len);
+        position += n;
+        dest += n;
+        len -= n;
+        if (position - published >= ring.getCapacity() / 4) {
+          ring.publishRead(position);
+          published = position;
+        }
+      }
+    }
+  };
+
+  /**
+   * Writes the upward messages to a ShmRing.  Like a FILE, what is written
+   * is published when the ring is flushed or has filled by a quarter.
+   */
+  class ShmOutStream: public OutStream {
+  private:
+    ShmRing ring;
+    int64_t position;
+    int64_t published;
+  public:
+    ShmOutStream(const ShmRing& _ring): ring(_ring) {
+      position = 0;
+      published = 0;
+    }
+
+    virtual void write(const void* buf, size_t len) {
+      const char* src = (const char*) buf;
+      while (len > 0) {
+        size_t n = ring.write(position, published, src, len);
+        position += n;
+        src += n;
+        len -= n;
+        if (position - published >= ring.getCapacity() / 4) {
+          flush();
+        }
+      }
+    }
+
+    virtual void flush() {
+      if (position != published) {
+        ring.publishWrite(position);
+        published = position;
+      }
+    }
+
+    ~ShmOutStream() {
+      flush();
+    }
+  };
+
+  /**
+   * The memory shared with the Java side, which creates it as a file with
+   * the downward ring followed by the upward ring.
+   */
+  class ShmTransport {
+  private:
+    char* memory;
+    size_t length;
+    Doorbell doorbell;
+    ShmInStream* in;
+    ShmOutStream* out;
+  public:
+    ShmTransport(const string& path, int64_t capacity, FILE* down, FILE* up)
+      : doorbell(down, up) {
+      HADOOP_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0,
+                    "shared memory ring size " + toString((int) capacity) +
+                    " is not a power of 2");
+      length = 2 * (ShmRing::HEADER_SIZE + capacity);
+      int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+      HADOOP_ASSERT(fd != -1, "problem opening " + path + ": " + 
+                    strerror(errno));
+      struct stat st;
+      if (fstat(fd, &st) != 0 || (size_t) st.st_size < length) {
+        close(fd);
+        HADOOP_ASSERT(false, "shared memory file " + path + " is too short");
+      }
+      memory = (char*) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, 0);
+      int err = errno;
+      close(fd);
+      HADOOP_ASSERT(memory != MAP_FAILED, "problem mapping " + path + ": " +
+                    strerror(err));
+      in = new ShmInStream(ShmRing(memory, capacity, &doorbell));
+      out = new ShmOutStream(ShmRing(memory + ShmRing::HEADER_SIZE + capacity,
+                                     capacity, &doorbell));
+    }
+
+    InStream* getInStream() {
+      return in;
+    }
+
+    OutStream* getOutStream() {
+      return out;
+    }
+
+    ~ShmTransport() {
+      delete in;
+      delete out;
+      munmap(memory, length);
+    }
+  };
 
   class BinaryUpwardProtocol: public UpwardProtocol {
   private:
-    FileOutStream* stream;
+    FileOutStream* fileStream;
+    // fileStream, or the upward ring once the transport is shared memory
+    OutStream* stream;
+    // The outputs not sent yet, each a partition, a key and a value, sent in
+    // one OUTPUT_BATCH message once there are batchBytes of them.
+    string batch;
+    StringOutStream batchStream;
+    int batchCount;
+    size_t batchBytes;
+
+    void addToBatch(int reduce, const string& key, const string& value) {
+      serializeInt(reduce, batchStream);
+      serializeString(key, batchStream);
+      serializeString(value, batchStream);
+      batchCount += 1;
+      if (batch.size() >= batchBytes) {
+        flushBatch();
+      }
+    }
+
+    /**
+     * Send the outputs batched so far.  Every other message does this
+     * first, so that they all arrive in the order they were sent.
+     */
+    void flushBatch() {
+      if (batchCount == 0) {
+        return;
+      }
+      serializeInt(OUTPUT_BATCH, *stream);
+      serializeInt(batchCount, *stream);
+      serializeInt(batch.size(), *stream);
+      stream->write(batch.data(), batch.size());
+      batch.clear();
+      batchCount = 0;
+    }
+
+    /**
+     * @return true if an output of this size should go in the batch rather
+     *         than in a message of its own.
+     */
+    bool batchable(const string& key, const string& value) {
+      if (batchBytes == 0) {
+        return false;
+      }
+      if (key.size() + value.size() >= batchBytes) {
+        // Copying it into the batch would cost more than the writes it saves
+        flushBatch();
+        return false;
+      }
+      return true;
+    }
+
   public:
-    BinaryUpwardProtocol(FILE* _stream) {
-      stream = new FileOutStream();
-      HADOOP_ASSERT(stream->open(_stream), "problem opening stream");
+    BinaryUpwardProtocol(FILE* _stream): batchStream(batch) {
+      fileStream = new FileOutStream();
+      HADOOP_ASSERT(fileStream->open(_stream), "problem opening stream");
+      stream = fileStream;
+      batchCount = 0;
+      batchBytes = 0;
+    }
+
+    /**
+     * Tell the parent that the following messages are in shared memory,
+     * and send them there.
+     */
+    void useSharedMemory(OutStream* ring) {
+      flushBatch();
+      serializeInt(SHM_TRANSPORT_ACK, *stream);
+      stream->flush();
+      stream = ring;
+    }
+
+    virtual void setOutputBatchBytes(int bytes) {
+      flushBatch();
+      batchBytes = bytes > 0 ? bytes : 0;
+      batch.reserve(batchBytes + batchBytes / 4);
     }
 
     virtual void authenticate(const string &responseDigest) {
+      flushBatch();
       serializeInt(AUTHENTICATION_RESP, *stream);
       serializeString(responseDigest, *stream);
       stream->flush();
     }
 
     virtual void output(const string& key, const string& value) {
+      if (batchable(key, value)) {
+        addToBatch(NO_PARTITION, key, value);
+        return;
+      }
       serializeInt(OUTPUT, *stream);
       serializeString(key, *stream);
       serializeString(value, *stream);
@@ -323,6 +779,10 @@ namespace HadoopPipes {
 
     virtual void partitionedOutput(int reduce, const string& key,
                                    const string& value) {
+      if (batchable(key, value)) {
+        addToBatch(reduce, key, value);
+        return;
+      }
       serializeInt(PARTITIONED_OUTPUT, *stream);
       serializeInt(reduce, *stream);
       serializeString(key, *stream);
@@ -330,22 +790,27 @@ namespace HadoopPipes {
     }
 
     virtual void status(const string& message) {
+      flushBatch();
       serializeInt(STATUS, *stream);
       serializeString(message, *stream);
     }
 
     virtual void progress(float progress) {
+      flushBatch();
       serializeInt(PROGRESS, *stream);
       serializeFloat(progress, *stream);
       stream->flush();
     }
 
     virtual void done() {
+      flushBatch();
       serializeInt(DONE, *stream);
+      stream->flush();
     }
 
     virtual void registerCounter(int id, const string& group, 
                                  const string& name) {
+      flushBatch();
       serializeInt(REGISTER_COUNTER, *stream);
       serializeInt(id, *stream);
       serializeString(group, *stream);
@@ -354,19 +819,27 @@ namespace HadoopPipes {
 
     virtual void incrementCounter(const TaskContext::Counter* counter, 
                                   uint64_t amount) {
+      flushBatch();
       serializeInt(INCREMENT_COUNTER, *stream);
       serializeInt(counter->getId(), *stream);
       serializeLong(amount, *stream);
     }
     
     ~BinaryUpwardProtocol() {
-      delete stream;
+      flushBatch();
+      stream->flush();
+      delete fileStream;
     }
   };
 
   class BinaryProtocol: public Protocol {
   private:
-    FileInStream* downStream;
+    FILE* downFile;
+    FILE* upFile;
+    FileInStream* fileStream;
+    // fileStream, or the downward ring once the transport is shared memory
+    InStream* downStream;
+    ShmTransport* shm;
     DownwardProtocol* handler;
     BinaryUpwardProtocol * uplink;
     string key;
@@ -450,8 +923,12 @@ namespace HadoopPipes {
 
   public:
     BinaryProtocol(FILE* down, DownwardProtocol* _handler, FILE* up) {
-      downStream = new FileInStream();
-      downStream->open(down);
+      downFile = down;
+      upFile = up;
+      fileStream = new FileInStream();
+      fileStream->open(down);
+      downStream = fileStream;
+      shm = NULL;
       uplink = new BinaryUpwardProtocol(up);
       handler = _handler;
       authDone = false;
@@ -487,6 +964,16 @@ namespace HadoopPipes {
         handler->start(prot);
         break;
       }
+      case SHM_TRANSPORT: {
+        string path;
+        deserializeString(path, *downStream);
+        int64_t capacity = deserializeLong(*downStream);
+        HADOOP_ASSERT(shm == NULL, "shared memory transport already in use");
+        shm = new ShmTransport(path, capacity, downFile, upFile);
+        uplink->useSharedMemory(shm->getOutStream());
+        downStream = shm->getInStream();
+        break;
+      }
       case SET_JOB_CONF: {
         int32_t entries;
         entries = deserializeInt(*downStream);
@@ -541,6 +1028,14 @@ namespace HadoopPipes {
         handler->reduceValue(value);
         break;
       }
+      case REDUCE_VALUES: {
+        int32_t more;
+        deserializeString(key, *downStream);
+        more = deserializeInt(*downStream);
+        deserializeString(value, *downStream);
+        handler->reduceValues(key, value, more);
+        break;
+      }
       case CLOSE:
         handler->close();
         break;
@@ -553,8 +1048,181 @@ namespace HadoopPipes {
     }
 
     virtual ~BinaryProtocol() {
-      delete downStream;
       delete uplink;
+      delete shm;
+      delete fileStream;
+    }
+  };
+
+  /**
+   * The map outputs waiting to be combined.  The keys and values are copied
+   * into one arena of bytes and the keys are found through an open
+   * addressing hash table, so adding an output does not allocate unless
+   * the arena or the table has to grow.  The keys are only sorted when the
+   * buffer is spilled.
+   */
+  class CombineBuffer {
+  private:
+    struct Key {
+      size_t offset;
+      size_t length;
+      uint32_t hash;
+      int32_t firstValue;
+      int32_t lastValue;
+    };
+
+    struct Value {
+      size_t offset;
+      size_t length;
+      int32_t next;
+    };
+
+    /**
+     * Orders keys by their bytes, as the std::map this replaced did.
+     */
+    class KeyLess {
+    private:
+      const CombineBuffer* buffer;
+    public:
+      KeyLess(const CombineBuffer* _buffer): buffer(_buffer) {}
+
+      bool operator()(int32_t left, int32_t right) const {
+        const Key& l = buffer->keys[left];
+        const Key& r = buffer->keys[right];
+        size_t len = l.length < r.length ? l.length : r.length;
+        int cmp = len == 0 ? 0 : memcmp(&buffer->arena[l.offset],
+                                        &buffer->arena[r.offset], len);
+        return cmp < 0 || (cmp == 0 && l.length < r.length);
+      }
+    };
+
+    enum { INITIAL_SLOTS = 1024 };
+
+    vector<char> arena;
+    vector<Key> keys;
+    vector<Value> values;
+    // Indexes into keys, EMPTY where unused, and never more than half full
+    vector<int32_t> slots;
+    vector<int32_t> sorted;
+
+    static uint32_t hashBytes(const char* data, size_t length) {
+      // FNV-1a
+      uint32_t hash = 2166136261u;
+      for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char) data[i];
+        hash *= 16777619u;
+      }
+      return hash;
+    }
+
+    size_t append(const string& bytes) {
+      size_t offset = arena.size();
+      arena.insert(arena.end(), bytes.begin(), bytes.end());
+      return offset;
+    }
+
+    bool matches(const Key& key, uint32_t hash, const string& bytes) const {
+      return key.hash == hash && key.length == bytes.size() &&
+        (key.length == 0 ||
+         memcmp(&arena[key.offset], bytes.data(), key.length) == 0);
+    }
+
+    void grow() {
+      vector<int32_t> bigger(slots.size() * 2, (int32_t) EMPTY);
+      size_t mask = bigger.size() - 1;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        size_t slot = keys[i].hash & mask;
+        while (bigger[slot] != EMPTY) {
+          slot = (slot + 1) & mask;
+        }
+        bigger[slot] = i;
+      }
+      slots.swap(bigger);
+    }
+
+  public:
+    // The end of the values of a key, and an unused slot of the table
+    enum { EMPTY = -1 };
+
+    CombineBuffer(): slots(INITIAL_SLOTS, (int32_t) EMPTY) {}
+
+    void add(const string& key, const string& value) {
+      uint32_t hash = hashBytes(key.data(), key.size());
+      size_t mask = slots.size() - 1;
+      size_t slot = hash & mask;
+      while (slots[slot] != EMPTY && !matches(keys[slots[slot]], hash, key)) {
+        slot = (slot + 1) & mask;
+      }
+      Value v;
+      v.offset = append(value);
+      v.length = value.size();
+      v.next = EMPTY;
+      values.push_back(v);
+      int32_t valueIndex = values.size() - 1;
+      if (slots[slot] != EMPTY) {
+        Key& k = keys[slots[slot]];
+        values[k.lastValue].next = valueIndex;
+        k.lastValue = valueIndex;
+        return;
+      }
+      Key k;
+      k.offset = append(key);
+      k.length = key.size();
+      k.hash = hash;
+      k.firstValue = valueIndex;
+      k.lastValue = valueIndex;
+      keys.push_back(k);
+      slots[slot] = keys.size() - 1;
+      if (keys.size() * 2 > slots.size()) {
+        grow();
+      }
+    }
+
+    size_t numKeys() const {
+      return keys.size();
+    }
+
+    /**
+     * Sort the keys, so that key(i) is the i'th smallest.
+     */
+    void sort() {
+      sorted.resize(keys.size());
+      for (size_t i = 0; i < keys.size(); ++i) {
+        sorted[i] = i;
+      }
+      std::sort(sorted.begin(), sorted.end(), KeyLess(this));
+    }
+
+    StringView key(size_t i) const {
+      const Key& k = keys[sorted[i]];
+      return StringView(k.length == 0 ? NULL : &arena[k.offset], k.length);
+    }
+
+    /**
+     * @return the first value of key(i), to pass to value and nextValue
+     */
+    int32_t firstValue(size_t i) const {
+      return keys[sorted[i]].firstValue;
+    }
+
+    int32_t nextValue(int32_t value) const {
+      return values[value].next;
+    }
+
+    StringView value(int32_t value) const {
+      const Value& v = values[value];
+      return StringView(v.length == 0 ? NULL : &arena[v.offset], v.length);
+    }
+
+    /**
+     * Empty the buffer, keeping its memory for the next outputs.
+     */
+    void clear() {
+      arena.clear();
+      keys.clear();
+      values.clear();
+      sorted.clear();
+      std::fill(slots.begin(), slots.end(), (int32_t) EMPTY);
     }
   };
 
@@ -570,25 +1238,35 @@ namespace HadoopPipes {
     UpwardProtocol* uplink;
     bool firstKey;
     bool firstValue;
-    map<string, vector<string> >::iterator keyItr;
-    map<string, vector<string> >::iterator endKeyItr;
-    vector<string>::iterator valueItr;
-    vector<string>::iterator endValueItr;
+    const CombineBuffer& data;
+    size_t keyIndex;
+    int32_t valueIndex;
+    // Copies of the current key and value, made when they are asked for
+    // as strings rather than views
+    string keyCopy;
+    bool keyCopied;
+    string valueCopy;
+    bool valueCopied;
+    // Reused by emit(const char*, ...) so it only allocates to grow them
+    string emitKey;
+    string emitValue;
 
   public:
     CombineContext(ReduceContext* _baseContext,
                    Partitioner* _partitioner,
                    int _numReduces,
                    UpwardProtocol* _uplink,
-                   map<string, vector<string> >& data) {
+                   const CombineBuffer& _data): data(_data) {
       baseContext = _baseContext;
       partitioner = _partitioner;
       numReduces = _numReduces;
       uplink = _uplink;
-      keyItr = data.begin();
-      endKeyItr = data.end();
+      keyIndex = 0;
+      valueIndex = CombineBuffer::EMPTY;
       firstKey = true;
       firstValue = true;
+      keyCopied = false;
+      valueCopied = false;
     }
 
     virtual const JobConf* getJobConf() {
@@ -596,11 +1274,29 @@ namespace HadoopPipes {
     }
 
     virtual const std::string& getInputKey() {
-      return keyItr->first;
+      if (!keyCopied) {
+        StringView view = data.key(keyIndex);
+        keyCopy.assign(view.data, view.length);
+        keyCopied = true;
+      }
+      return keyCopy;
     }
 
     virtual const std::string& getInputValue() {
-      return *valueItr;
+      if (!valueCopied) {
+        StringView view = data.value(valueIndex);
+        valueCopy.assign(view.data, view.length);
+        valueCopied = true;
+      }
+      return valueCopy;
+    }
+
+    virtual StringView getInputKeyView() {
+      return data.key(keyIndex);
+    }
+
+    virtual StringView getInputValueView() {
+      return data.value(valueIndex);
     }
 
     virtual void emit(const std::string& key, const std::string& value) {
@@ -612,6 +1308,13 @@ namespace HadoopPipes {
       }
     }
 
+    virtual void emit(const char* key, size_t keyLength,
+                      const char* value, size_t valueLength) {
+      emitKey.assign(key, keyLength);
+      emitValue.assign(value, valueLength);
+      emit(emitKey, emitValue);
+    }
+
     virtual void progress() {
       baseContext->progress();
     }
@@ -624,11 +1327,10 @@ namespace HadoopPipes {
       if (firstKey) {
         firstKey = false;
       } else {
-        ++keyItr;
+        ++keyIndex;
       }
-      if (keyItr != endKeyItr) {
-        valueItr = keyItr->second.begin();
-        endValueItr = keyItr->second.end();
+      if (keyIndex < data.numKeys()) {
+        keyCopied = false;
         firstValue = true;
         return true;
       }
@@ -638,10 +1340,12 @@ namespace HadoopPipes {
     virtual bool nextValue() {
       if (firstValue) {
         firstValue = false;
-      } else {
-        ++valueItr;
+        valueIndex = data.firstValue(keyIndex);
+      } else if (valueIndex != CombineBuffer::EMPTY) {
+        valueIndex = data.nextValue(valueIndex);
       }
-      return valueItr != endValueItr;
+      valueCopied = false;
+      return valueIndex != CombineBuffer::EMPTY;
     }
     
     virtual Counter* getCounter(const std::string& group, 
@@ -660,7 +1364,7 @@ namespace HadoopPipes {
    */
   class CombineRunner: public RecordWriter {
   private:
-    map<string, vector<string> > data;
+    CombineBuffer data;
     int64_t spillSize;
     int64_t numBytes;
     ReduceContext* baseContext;
@@ -684,7 +1388,7 @@ namespace HadoopPipes {
     virtual void emit(const std::string& key,
                       const std::string& value) {
       numBytes += key.length() + value.length();
-      data[key].push_back(value);
+      data.add(key, value);
       if (numBytes >= spillSize) {
         spillAll();
       }
@@ -696,6 +1400,7 @@ namespace HadoopPipes {
 
   private:
     void spillAll() {
+      data.sort();
       CombineContext context(baseContext, partitioner, numReduces, 
                              uplink, data);
       while (context.nextKey()) {
@@ -706,6 +1411,362 @@ namespace HadoopPipes {
     }
   };
 
+  /**
+   * The context of one mapper run by a MapWorkerPool.  It holds the record
+   * being mapped and passes everything else to the task's context, which
+   * serializes it.
+   */
+  class MapWorkerContext: public MapContext {
+  private:
+    MapContext* baseContext;
+    const string* key;
+    const string* value;
+  public:
+    MapWorkerContext(MapContext* _baseContext) {
+      baseContext = _baseContext;
+      key = NULL;
+      value = NULL;
+    }
+
+    void setRecord(const string* _key, const string* _value) {
+      key = _key;
+      value = _value;
+    }
+
+    virtual const JobConf* getJobConf() {
+      return baseContext->getJobConf();
+    }
+
+    virtual const std::string& getInputKey() {
+      return *key;
+    }
+
+    virtual const std::string& getInputValue() {
+      return *value;
+    }
+
+    virtual void emit(const std::string& key, const std::string& value) {
+      baseContext->emit(key, value);
+    }
+
+    virtual void emit(const char* key, size_t keyLength,
+                      const char* value, size_t valueLength) {
+      baseContext->emit(key, keyLength, value, valueLength);
+    }
+
+    virtual void progress() {
+      baseContext->progress();
+    }
+
+    virtual void setStatus(const std::string& status) {
+      baseContext->setStatus(status);
+    }
+
+    virtual Counter* getCounter(const std::string& group, 
+                               const std::string& name) {
+      return baseContext->getCounter(group, name);
+    }
+
+    virtual void incrementCounter(const Counter* counter, uint64_t amount) {
+      baseContext->incrementCounter(counter, amount);
+    }
+
+    virtual const std::string& getInputSplit() {
+      return baseContext->getInputSplit();
+    }
+
+    virtual const std::string& getInputKeyClass() {
+      return baseContext->getInputKeyClass();
+    }
+
+    virtual const std::string& getInputValueClass() {
+      return baseContext->getInputValueClass();
+    }
+  };
+
+  /**
+   * Runs a mapper on each of several threads.  The protocol thread adds the
+   * records, which are handed to the workers in batches, and the workers
+   * emit through the task's context.  The records of a batch are reused
+   * once it has been mapped, so they only allocate to grow.
+   */
+  class MapWorkerPool {
+  private:
+    struct Batch {
+      vector<string> keys;
+      vector<string> values;
+      size_t size;
+
+      Batch(): size(0) {}
+    };
+
+    // Records per batch, enough that taking one rarely contends
+    enum { BATCH_RECORDS = 256 };
+
+    struct Worker {
+      MapWorkerPool* pool;
+      MapWorkerContext* context;
+      Mapper* mapper;
+      pthread_t thread;
+    };
+
+    vector<Worker> workers;
+    Batch* current;
+    vector<Batch*> queued;
+    size_t nextQueued;
+    vector<Batch*> spare;
+    size_t maxQueued;
+    bool closing;
+    bool joined;
+    bool failed;
+    string failure;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+
+    static void* run(void* ptr) {
+      Worker* worker = (Worker*) ptr;
+      worker->pool->work(*worker);
+      return NULL;
+    }
+
+    /**
+     * Take the next queued batch, or NULL once the pool is closing and the
+     * queue is drained.  isFailed is set, under the same lock, to whether a
+     * worker has failed, in which case the batch is only to be recycled.
+     */
+    Batch* take(bool& isFailed) {
+      Batch* batch = NULL;
+      pthread_mutex_lock(&mutex);
+      while (nextQueued == queued.size() && !closing) {
+        pthread_cond_wait(&notEmpty, &mutex);
+      }
+      if (nextQueued < queued.size()) {
+        batch = queued[nextQueued++];
+        if (nextQueued == queued.size()) {
+          queued.clear();
+          nextQueued = 0;
+        }
+        pthread_cond_signal(&notFull);
+      }
+      isFailed = failed;
+      pthread_mutex_unlock(&mutex);
+      return batch;
+    }
+
+    void work(Worker& worker) {
+      Batch* batch;
+      bool isFailed;
+      while ((batch = take(isFailed)) != NULL) {
+        try {
+          if (!isFailed) {
+            for(size_t i=0; i < batch->size; ++i) {
+              worker.context->setRecord(&batch->keys[i], &batch->values[i]);
+              worker.mapper->map(*worker.context);
+            }
+          }
+        } catch (Error& err) {
+          pthread_mutex_lock(&mutex);
+          if (!failed) {
+            failed = true;
+            failure = err.getMessage();
+          }
+          pthread_mutex_unlock(&mutex);
+        }
+        batch->size = 0;
+        pthread_mutex_lock(&mutex);
+        spare.push_back(batch);
+        pthread_mutex_unlock(&mutex);
+      }
+    }
+
+    void checkFailed() {
+      pthread_mutex_lock(&mutex);
+      bool isFailed = failed;
+      string message = failure;
+      pthread_mutex_unlock(&mutex);
+      if (isFailed) {
+        throw Error("Mapper thread failed: " + message);
+      }
+    }
+
+    /**
+     * Stop the workers once they have mapped the batches already queued.
+     */
+    void join() {
+      if (joined) {
+        return;
+      }
+      pthread_mutex_lock(&mutex);
+      closing = true;
+      pthread_cond_broadcast(&notEmpty);
+      pthread_mutex_unlock(&mutex);
+      for(size_t i=0; i < workers.size(); ++i) {
+        pthread_join(workers[i].thread, NULL);
+      }
+      joined = true;
+    }
+
+    void submit() {
+      if (current->size == 0) {
+        return;
+      }
+      pthread_mutex_lock(&mutex);
+      while (queued.size() - nextQueued >= maxQueued) {
+        pthread_cond_wait(&notFull, &mutex);
+      }
+      queued.push_back(current);
+      pthread_cond_signal(&notEmpty);
+      if (spare.empty()) {
+        current = new Batch();
+      } else {
+        current = spare.back();
+        spare.pop_back();
+      }
+      pthread_mutex_unlock(&mutex);
+      checkFailed();
+    }
+
+  public:
+    /**
+     * Start the threads, each with a mapper created by the factory.
+     * @param threads the number of mappers to run at once
+     */
+    MapWorkerPool(const Factory& factory, MapContext* baseContext,
+                  int threads) {
+      current = new Batch();
+      nextQueued = 0;
+      maxQueued = 2 * threads;
+      closing = false;
+      joined = false;
+      failed = false;
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&notEmpty, NULL);
+      pthread_cond_init(&notFull, NULL);
+      workers.resize(threads);
+      for(int i=0; i < threads; ++i) {
+        workers[i].pool = this;
+        workers[i].context = new MapWorkerContext(baseContext);
+        workers[i].mapper = factory.createMapper(*workers[i].context);
+      }
+      for(int i=0; i < threads; ++i) {
+        int result = pthread_create(&workers[i].thread, NULL, run, 
+                                    &workers[i]);
+        HADOOP_ASSERT(result == 0, string("problem creating mapper thread: ")
+                                     + strerror(result));
+      }
+    }
+
+    /**
+     * Copy a record to be mapped by one of the workers.
+     */
+    void map(const string& key, const string& value) {
+      if (current->keys.size() == current->size) {
+        current->keys.resize(BATCH_RECORDS);
+        current->values.resize(BATCH_RECORDS);
+      }
+      current->keys[current->size] = key;
+      current->values[current->size] = value;
+      current->size += 1;
+      if (current->size == BATCH_RECORDS) {
+        submit();
+      }
+    }
+
+    /**
+     * Wait for the workers to map every record added and close their 
+     * mappers.
+     * @throws Error if any of the mappers failed
+     */
+    void close() {
+      submit();
+      join();
+      checkFailed();
+      for(size_t i=0; i < workers.size(); ++i) {
+        workers[i].mapper->close();
+      }
+    }
+
+    ~MapWorkerPool() {
+      join();
+      for(size_t i=0; i < workers.size(); ++i) {
+        delete workers[i].mapper;
+        delete workers[i].context;
+      }
+      for(size_t i=0; i < queued.size(); ++i) {
+        delete queued[i];
+      }
+      delete current;
+      for(size_t i=0; i < spare.size(); ++i) {
+        delete spare[i];
+      }
+      pthread_cond_destroy(&notFull);
+      pthread_cond_destroy(&notEmpty);
+      pthread_mutex_destroy(&mutex);
+    }
+  };
+
+  /**
+   * The values of a REDUCE_VALUES message, each serialized as a string one
+   * after the other, which are read in place rather than copied out.
+   */
+  class PackedValues {
+  private:
+    const string* buffer;
+    size_t offset;
+    bool more;
+    StringView current;
+  public:
+    PackedValues(): buffer(NULL), offset(0), more(false) {}
+
+    void reset(const string* _buffer, bool _more) {
+      buffer = _buffer;
+      offset = 0;
+      more = _more;
+    }
+
+    void clear() {
+      buffer = NULL;
+    }
+
+    /**
+     * @return is a batch being read?
+     */
+    bool isActive() const {
+      return buffer != NULL;
+    }
+
+    /**
+     * @return does another batch follow for the same key?
+     */
+    bool hasMore() const {
+      return more;
+    }
+
+    /**
+     * Advance to the next value of the batch.
+     * @return false if the batch has no more values
+     */
+    bool next() {
+      if (offset == buffer->size()) {
+        return false;
+      }
+      int64_t length;
+      offset += deserializeLong(length, buffer->data() + offset,
+                                buffer->size() - offset);
+      HADOOP_ASSERT(length >= 0 &&
+                    (uint64_t) length <= buffer->size() - offset,
+                    "value runs past the end of its REDUCE_VALUES message");
+      current = StringView(buffer->data() + offset, length);
+      offset += length;
+      return true;
+    }
+
+    const StringView& value() const {
+      return current;
+    }
+  };
+
   class TaskContextImpl: public MapContext, public ReduceContext, 
                          public DownwardProtocol {
   private:
@@ -713,7 +1774,14 @@ namespace HadoopPipes {
     JobConf* jobConf;
     string key;
     const string* newKey;
+    // Reused by emit(const char*, ...) so it only allocates to grow them
+    string emitKey;
+    string emitValue;
     const string* value;
+    // The values of the current key, if they came in REDUCE_VALUES
+    // messages, and a copy of the current one once getInputValue is called
+    PackedValues packedValues;
+    string packedValue;
     bool hasTask;
     bool isNewKey;
     bool isNewValue;
@@ -728,13 +1796,44 @@ namespace HadoopPipes {
     string* inputSplit;
     RecordReader* reader;
     Mapper* mapper;
+    // Runs the mappers instead of mapper, if there is more than one
+    MapWorkerPool* mapWorkers;
     Reducer* reducer;
     RecordWriter* writer;
     Partitioner* partitioner;
     int numReduces;
     const Factory* factory;
     pthread_mutex_t mutexDone;
+    // Held by everything that writes to the uplink, since with mapWorkers
+    // the mappers emit from their own threads.  Recursive, because the
+    // combiner calls back into progress() from inside of emit().
+    pthread_mutex_t mutexUplink;
     std::vector<int> registeredCounterIds;
+    // The increments of each counter, by id, not yet sent to the parent,
+    // which are sent together every counterFlushMillis
+    std::vector<uint64_t> counterDeltas;
+    bool countersPending;
+    uint64_t lastCounterFlush;
+    int counterFlushMillis;
+
+    /**
+     * Send the counter increments that have built up.  The caller must hold
+     * mutexUplink.
+     */
+    void flushCounters(uint64_t now) {
+      lastCounterFlush = now;
+      if (!countersPending) {
+        return;
+      }
+      for (size_t id = 0; id < counterDeltas.size(); ++id) {
+        if (counterDeltas[id] != 0) {
+          Counter counter(id);
+          uplink->incrementCounter(&counter, counterDeltas[id]);
+          counterDeltas[id] = 0;
+        }
+      }
+      countersPending = false;
+    }
 
   public:
 
@@ -748,17 +1847,27 @@ namespace HadoopPipes {
       inputValueClass = NULL;
       inputSplit = NULL;
       mapper = NULL;
+      mapWorkers = NULL;
       reducer = NULL;
       reader = NULL;
       writer = NULL;
       partitioner = NULL;
       protocol = NULL;
+      uplink = NULL;
       isNewKey = false;
       isNewValue = false;
       lastProgress = 0;
       progressFloat = 0.0f;
       hasTask = false;
+      countersPending = false;
+      lastCounterFlush = getCurrentMillis();
+      counterFlushMillis = 1000;
       pthread_mutex_init(&mutexDone, NULL);
+      pthread_mutexattr_t attr;
+      pthread_mutexattr_init(&attr);
+      pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+      pthread_mutex_init(&mutexUplink, &attr);
+      pthread_mutexattr_destroy(&attr);
     }
 
     void setProtocol(Protocol* _protocol, UpwardProtocol* _uplink) {
@@ -782,6 +1891,16 @@ namespace HadoopPipes {
         result->set(values[i], values[i+1]);
       }
       jobConf = result;
+      // Only a parent that can read OUTPUT_BATCH messages sets this
+      if (uplink != NULL &&
+          jobConf->hasKey("mapreduce.pipes.uplink.batch.bytes")) {
+        uplink->setOutputBatchBytes(
+          jobConf->getInt("mapreduce.pipes.uplink.batch.bytes"));
+      }
+      if (jobConf->hasKey("mapreduce.pipes.counter.flush.ms")) {
+        counterFlushMillis =
+          jobConf->getInt("mapreduce.pipes.counter.flush.ms");
+      }
     }
 
     virtual void setInputTypes(string keyType, string valueType) {
@@ -798,7 +1917,15 @@ namespace HadoopPipes {
       if (reader != NULL) {
         value = new string();
       }
-      mapper = factory->createMapper(*this);
+      int threads = 1;
+      if (jobConf->hasKey("mapreduce.pipes.map.threads")) {
+        threads = jobConf->getInt("mapreduce.pipes.map.threads");
+      }
+      if (threads > 1) {
+        mapWorkers = new MapWorkerPool(*factory, this, threads);
+      } else {
+        mapper = factory->createMapper(*this);
+      }
       numReduces = _numReduces;
       if (numReduces != 0) { 
         reducer = factory->createCombiner(*this);
@@ -839,6 +1966,16 @@ namespace HadoopPipes {
       isNewValue = true;
       value = &_value;
     }
+
+    virtual void reduceValues(const string& _key, const string& _values,
+                              bool more) {
+      // A batch continues the key if the one before said more would come
+      if (!packedValues.isActive() || !packedValues.hasMore()) {
+        isNewKey = true;
+        newKey = &_key;
+      }
+      packedValues.reset(&_values, more);
+    }
     
     virtual bool isDone() {
       pthread_mutex_lock(&mutexDone);
@@ -882,7 +2019,9 @@ namespace HadoopPipes {
         progressFloat = reader->getProgress();
       }
       isNewKey = false;
-      if (mapper != NULL) {
+      if (mapWorkers != NULL) {
+        mapWorkers->map(key, *value);
+      } else if (mapper != NULL) {
         mapper->map(*this);
       } else {
         reducer->reduce(*this);
@@ -894,13 +2033,24 @@ namespace HadoopPipes {
      * Advance to the next value.
      */
     virtual bool nextValue() {
-      if (isNewKey || done) {
-        return false;
+      while (!isNewKey && !done) {
+        if (packedValues.isActive()) {
+          if (packedValues.next()) {
+            value = NULL;
+            return true;
+          }
+          if (!packedValues.hasMore()) {
+            packedValues.clear();
+          }
+        }
+        isNewValue = false;
+        progress();
+        protocol->nextEvent();
+        if (isNewValue) {
+          return true;
+        }
       }
-      isNewValue = false;
-      progress();
-      protocol->nextEvent();
-      return isNewValue;
+      return false;
     }
 
     /**
@@ -924,24 +2074,41 @@ namespace HadoopPipes {
      *    reduce
      */
     virtual const string& getInputValue() {
+      if (value == NULL) {
+        packedValue.assign(packedValues.value().data,
+                           packedValues.value().length);
+        value = &packedValue;
+      }
       return *value;
     }
 
+    virtual StringView getInputValueView() {
+      if (value == NULL) {
+        return packedValues.value();
+      }
+      return StringView(*value);
+    }
+
     /**
      * Mark your task as having made progress without changing the status 
      * message.
      */
     virtual void progress() {
       if (uplink != 0) {
+        pthread_mutex_lock(&mutexUplink);
         uint64_t now = getCurrentMillis();
         if (now - lastProgress > 1000) {
           lastProgress = now;
+          if (now - lastCounterFlush >= (uint64_t) counterFlushMillis) {
+            flushCounters(now);
+          }
           if (statusSet) {
             uplink->status(status);
             statusSet = false;
           }
           uplink->progress(progressFloat);
         }
+        pthread_mutex_unlock(&mutexUplink);
       }
     }
 
@@ -949,9 +2116,11 @@ namespace HadoopPipes {
      * Set the status message and call progress.
      */
     virtual void setStatus(const string& status) {
+      pthread_mutex_lock(&mutexUplink);
       this->status = status;
       statusSet = true;
       progress();
+      pthread_mutex_unlock(&mutexUplink);
     }
 
     /**
@@ -976,15 +2145,36 @@ namespace HadoopPipes {
     }
 
     virtual void emit(const string& key, const string& value) {
-      progress();
-      if (writer != NULL) {
-        writer->emit(key, value);
-      } else if (partitioner != NULL) {
-        int part = partitioner->partition(key, numReduces);
-        uplink->partitionedOutput(part, key, value);
-      } else {
-        uplink->output(key, value);
+      pthread_mutex_lock(&mutexUplink);
+      try {
+        progress();
+        if (writer != NULL) {
+          writer->emit(key, value);
+        } else if (partitioner != NULL) {
+          int part = partitioner->partition(key, numReduces);
+          uplink->partitionedOutput(part, key, value);
+        } else {
+          uplink->output(key, value);
+        }
+      } catch (...) {
+        pthread_mutex_unlock(&mutexUplink);
+        throw;
       }
+      pthread_mutex_unlock(&mutexUplink);
+    }
+
+    virtual void emit(const char* key, size_t keyLength,
+                      const char* value, size_t valueLength) {
+      pthread_mutex_lock(&mutexUplink);
+      emitKey.assign(key, keyLength);
+      emitValue.assign(value, valueLength);
+      try {
+        emit(emitKey, emitValue);
+      } catch (...) {
+        pthread_mutex_unlock(&mutexUplink);
+        throw;
+      }
+      pthread_mutex_unlock(&mutexUplink);
     }
 
     /**
@@ -992,23 +2182,43 @@ namespace HadoopPipes {
      */
     virtual Counter* getCounter(const std::string& group, 
                                const std::string& name) {
+      pthread_mutex_lock(&mutexUplink);
       int id = registeredCounterIds.size();
       registeredCounterIds.push_back(id);
+      counterDeltas.push_back(0);
       uplink->registerCounter(id, group, name);
+      pthread_mutex_unlock(&mutexUplink);
       return new Counter(id);
     }
 
     /**
-     * Increment the value of the counter with the given amount.
+     * Increment the value of the counter with the given amount.  Unless
+     * "mapreduce.pipes.counter.flush.ms" is 0, the amount is only added up
+     * here, and sent with the others once that many milliseconds have
+     * passed, from progress(), or when the task ends.
      */
     virtual void incrementCounter(const Counter* counter, uint64_t amount) {
-      uplink->incrementCounter(counter, amount); 
+      pthread_mutex_lock(&mutexUplink);
+      if (counterFlushMillis <= 0) {
+        uplink->incrementCounter(counter, amount); 
+      } else {
+        counterDeltas[counter->getId()] += amount;
+        countersPending = true;
+        uint64_t now = getCurrentMillis();
+        if (now - lastCounterFlush >= (uint64_t) counterFlushMillis) {
+          flushCounters(now);
+        }
+      }
+      pthread_mutex_unlock(&mutexUplink);
     }
 
     void closeAll() {
       if (reader) {
         reader->close();
       }
+      if (mapWorkers) {
+        mapWorkers->close();
+      }
       if (mapper) {
         mapper->close();
       }
@@ -1018,6 +2228,9 @@ namespace HadoopPipes {
       if (writer) {
         writer->close();
       }
+      pthread_mutex_lock(&mutexUplink);
+      flushCounters(getCurrentMillis());
+      pthread_mutex_unlock(&mutexUplink);
     }
 
     virtual ~TaskContextImpl() {
@@ -1029,10 +2242,12 @@ namespace HadoopPipes {
         delete value;
       }
       delete reader;
+      delete mapWorkers;
       delete mapper;
       delete reducer;
       delete writer;
       delete partitioner;
+      pthread_mutex_destroy(&mutexUplink);
       pthread_mutex_destroy(&mutexDone);
     }
   };
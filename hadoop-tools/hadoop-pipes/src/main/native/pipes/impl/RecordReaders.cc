@@ -0,0 +1,644 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hadoop/RecordReaders.hh"
+#include "hadoop/SerialUtils.hh"
+#include "hadoop/StringUtils.hh"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HADOOP_PIPES_LIBHDFS
+#include <hdfs.h>
+#endif
+
+using std::string;
+using std::vector;
+
+using namespace HadoopUtils;
+
+namespace HadoopPipes {
+
+  /**
+   * A file that is read with positioned reads.
+   */
+  class InputFile {
+  public:
+    virtual int64_t getLength() = 0;
+
+    /**
+     * Read up to length bytes at position.
+     * @return the number of bytes read, which is 0 at the end of the file
+     */
+    virtual size_t pread(int64_t position, char* buffer, size_t length) = 0;
+
+    virtual ~InputFile() {}
+  };
+
+  class LocalInputFile: public InputFile {
+  private:
+    int fd;
+    int64_t length;
+  public:
+    LocalInputFile(const string& path) {
+      fd = open(path.c_str(), O_RDONLY);
+      HADOOP_ASSERT(fd != -1, "failed to open " + path + ": " +
+                    strerror(errno));
+      struct stat statResult;
+      if (fstat(fd, &statResult) != 0) {
+        int err = errno;
+        close(fd);
+        throw Error("failed to stat " + path + ": " + strerror(err));
+      }
+      length = statResult.st_size;
+    }
+
+    virtual int64_t getLength() {
+      return length;
+    }
+
+    virtual size_t pread(int64_t position, char* buffer, size_t length) {
+      ssize_t result;
+      do {
+        result = ::pread(fd, buffer, length, position);
+      } while (result == -1 && errno == EINTR);
+      HADOOP_ASSERT(result != -1, string("failed to read: ") +
+                    strerror(errno));
+      return result;
+    }
+
+    virtual ~LocalInputFile() {
+      close(fd);
+    }
+  };
+
+#ifdef HADOOP_PIPES_LIBHDFS
+  class HdfsInputFile: public InputFile {
+  private:
+    hdfsFS fs;
+    hdfsFile file;
+    int64_t length;
+  public:
+    /**
+     * @param path the URI of the file
+     * @param nameNode the scheme and authority of it, or "default"
+     */
+    HdfsInputFile(const string& path, const string& nameNode) {
+      struct hdfsBuilder* builder = hdfsNewBuilder();
+      HADOOP_ASSERT(builder != NULL, "failed to create an hdfsBuilder");
+      hdfsBuilderSetNameNode(builder, nameNode.c_str());
+      fs = hdfsBuilderConnect(builder);
+      HADOOP_ASSERT(fs != NULL, "failed to connect to " + nameNode + ": " +
+                    strerror(errno));
+      hdfsFileInfo* info = hdfsGetPathInfo(fs, path.c_str());
+      if (info == NULL) {
+        int err = errno;
+        hdfsDisconnect(fs);
+        throw Error("failed to stat " + path + ": " + strerror(err));
+      }
+      length = info->mSize;
+      hdfsFreeFileInfo(info, 1);
+      file = hdfsOpenFile(fs, path.c_str(), O_RDONLY, 0, 0, 0);
+      if (file == NULL) {
+        int err = errno;
+        hdfsDisconnect(fs);
+        throw Error("failed to open " + path + ": " + strerror(err));
+      }
+    }
+
+    virtual int64_t getLength() {
+      return length;
+    }
+
+    virtual size_t pread(int64_t position, char* buffer, size_t length) {
+      tSize result = hdfsPread(fs, file, position, buffer,
+                               std::min(length, (size_t) INT32_MAX));
+      HADOOP_ASSERT(result >= 0, string("failed to read: ") +
+                    strerror(errno));
+      return result;
+    }
+
+    virtual ~HdfsInputFile() {
+      hdfsCloseFile(fs, file);
+      hdfsDisconnect(fs);
+    }
+  };
+#endif
+
+  static InputFile* openInputFile(const string& path) {
+    string::size_type colon = path.find(':');
+    string::size_type slash = path.find('/');
+    if (colon == string::npos || (slash != string::npos && slash < colon)) {
+      return new LocalInputFile(path);
+    }
+    bool hasAuthority = path.compare(colon + 1, 2, "//") == 0;
+    string::size_type pathStart = hasAuthority ?
+      path.find('/', colon + 3) : colon + 1;
+    HADOOP_ASSERT(pathStart != string::npos, "no path in " + path);
+    if (path.compare(0, colon, "file") == 0) {
+      return new LocalInputFile(path.substr(pathStart));
+    }
+#ifdef HADOOP_PIPES_LIBHDFS
+    return new HdfsInputFile(path, hasAuthority ? path.substr(0, pathStart) :
+                             string("default"));
+#else
+    throw Error("cannot read " + path +
+                ": the pipes library was built without libhdfs");
+#endif
+  }
+
+  /**
+   * Reads a file through a large buffer, refilled a buffer at a time.
+   */
+  class BufferedInput: public InStream {
+  private:
+    InputFile* file;
+    int64_t length;
+    vector<char> buffer;
+    // The file position of buffer[0]
+    int64_t bufferStart;
+    size_t bufferLength;
+    size_t offset;
+
+    /**
+     * @return false if there is nothing left to read
+     */
+    bool fill() {
+      if (offset < bufferLength) {
+        return true;
+      }
+      bufferStart += bufferLength;
+      offset = 0;
+      bufferLength = 0;
+      while (bufferLength < buffer.size()) {
+        size_t result = file->pread(bufferStart + bufferLength,
+                                    &buffer[bufferLength],
+                                    buffer.size() - bufferLength);
+        if (result == 0) {
+          break;
+        }
+        bufferLength += result;
+      }
+      return bufferLength > 0;
+    }
+
+  public:
+    BufferedInput(InputFile* _file, size_t bufferSize): buffer(bufferSize) {
+      file = _file;
+      length = file->getLength();
+      bufferStart = 0;
+      bufferLength = 0;
+      offset = 0;
+    }
+
+    int64_t getLength() const {
+      return length;
+    }
+
+    int64_t getPosition() const {
+      return bufferStart + offset;
+    }
+
+    void seek(int64_t position) {
+      if (position >= bufferStart &&
+          position <= bufferStart + (int64_t) bufferLength) {
+        offset = position - bufferStart;
+      } else {
+        bufferStart = position;
+        bufferLength = 0;
+        offset = 0;
+      }
+    }
+
+    virtual void read(void *buf, size_t len) {
+      char* out = (char*) buf;
+      while (len > 0) {
+        HADOOP_ASSERT(fill(), "unexpected end of file");
+        size_t n = std::min(len, bufferLength - offset);
+        memcpy(out, &buffer[offset], n);
+        offset += n;
+        out += n;
+        len -= n;
+      }
+    }
+
+    void read(string& out, size_t len) {
+      out.resize(len);
+      if (len > 0) {
+        read(&out[0], len);
+      }
+    }
+
+    char readByte() {
+      HADOOP_ASSERT(fill(), "unexpected end of file");
+      return buffer[offset++];
+    }
+
+    /**
+     * Read an int as Java's DataOutput.writeInt writes it.
+     */
+    int32_t readInt() {
+      unsigned char bytes[4];
+      read(bytes, 4);
+      return (int32_t) ((uint32_t) bytes[0] << 24 | bytes[1] << 16 |
+                        bytes[2] << 8 | bytes[3]);
+    }
+
+    /**
+     * Read up to the next LF, CR or CRLF, which is left out of line.
+     * @return false if the end of the file was reached before any bytes
+     */
+    bool readLine(string& line) {
+      line.clear();
+      bool any = false;
+      while (fill()) {
+        const char* data = &buffer[offset];
+        size_t available = bufferLength - offset;
+        size_t eol = 0;
+        while (eol < available && data[eol] != '\n' && data[eol] != '\r') {
+          ++eol;
+        }
+        line.append(data, eol);
+        offset += eol;
+        any = true;
+        if (eol < available) {
+          offset += 1;
+          if (data[eol] == '\r' && fill() && buffer[offset] == '\n') {
+            offset += 1;
+          }
+          return true;
+        }
+      }
+      return any;
+    }
+
+    virtual ~BufferedInput() {
+      delete file;
+    }
+  };
+
+  /**
+   * Inflates the buffers of a compressed SequenceFile.
+   */
+  class Decompressor {
+  private:
+    z_stream stream;
+  public:
+    Decompressor(const string& codec) {
+      int windowBits;
+      if (codec == "org.apache.hadoop.io.compress.DefaultCodec") {
+        windowBits = 15;
+      } else if (codec == "org.apache.hadoop.io.compress.GzipCodec") {
+        windowBits = 15 + 16;
+      } else {
+        throw Error("the native SequenceFile reader does not support " + codec);
+      }
+      memset(&stream, 0, sizeof(stream));
+      HADOOP_ASSERT(inflateInit2(&stream, windowBits) == Z_OK,
+                    "failed to initialize zlib");
+    }
+
+    void decompress(const string& in, string& out) {
+      HADOOP_ASSERT(inflateReset(&stream) == Z_OK, "failed to reset zlib");
+      out.resize(std::max(out.capacity(), in.size() * 4 + 64));
+      stream.next_in = (Bytef*) in.data();
+      stream.avail_in = in.size();
+      size_t produced = 0;
+      while (true) {
+        stream.next_out = (Bytef*) &out[produced];
+        stream.avail_out = out.size() - produced;
+        int result = inflate(&stream, Z_NO_FLUSH);
+        produced = out.size() - stream.avail_out;
+        if (result == Z_STREAM_END) {
+          break;
+        }
+        HADOOP_ASSERT(result == Z_OK || result == Z_BUF_ERROR,
+                      string("failed to decompress: ") +
+                      (stream.msg != NULL ? stream.msg : "zlib error"));
+        if (stream.avail_out == 0) {
+          out.resize(out.size() * 2);
+        } else {
+          HADOOP_ASSERT(stream.avail_in > 0, "truncated compressed buffer");
+        }
+      }
+      out.resize(produced);
+    }
+
+    ~Decompressor() {
+      inflateEnd(&stream);
+    }
+  };
+
+  /**
+   * Read a long as Java's DataOutput.writeLong writes it.
+   */
+  static int64_t readJavaLong(InStream& stream) {
+    unsigned char bytes[8];
+    stream.read(bytes, 8);
+    uint64_t result = 0;
+    for (int i = 0; i < 8; ++i) {
+      result = result << 8 | bytes[i];
+    }
+    return result;
+  }
+
+  FileSplit FileSplit::parse(const string& split) {
+    StringInStream stream(split);
+    FileSplit result;
+    deserializeString(result.path, stream);
+    result.start = readJavaLong(stream);
+    result.length = readJavaLong(stream);
+    return result;
+  }
+
+  static size_t getBufferSize(MapContext& context) {
+    const JobConf* conf = context.getJobConf();
+    if (conf->hasKey("mapreduce.pipes.reader.buffer.bytes")) {
+      int size = conf->getInt("mapreduce.pipes.reader.buffer.bytes");
+      HADOOP_ASSERT(size > 0, "mapreduce.pipes.reader.buffer.bytes must be "
+                    "positive");
+      return size;
+    }
+    return 4 * 1024 * 1024;
+  }
+
+  static float getSplitProgress(int64_t start, int64_t end,
+                                int64_t position) {
+    if (end <= start) {
+      return 1.0f;
+    }
+    return std::min(1.0f, (float) (position - start) / (end - start));
+  }
+
+  LineRecordReader::LineRecordReader(MapContext& context) {
+    FileSplit split = FileSplit::parse(context.getInputSplit());
+    input = new BufferedInput(openInputFile(split.path),
+                              getBufferSize(context));
+    start = split.start;
+    end = split.start + split.length;
+    input->seek(start);
+    // The split before this one reads the line that crosses into it
+    if (start != 0) {
+      string skipped;
+      input->readLine(skipped);
+      start = input->getPosition();
+    }
+  }
+
+  bool LineRecordReader::next(string& key, string& value) {
+    int64_t position = input->getPosition();
+    if (position > end || !input->readLine(value)) {
+      return false;
+    }
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%lld", (long long) position);
+    key = buffer;
+    return true;
+  }
+
+  float LineRecordReader::getProgress() {
+    return getSplitProgress(start, end, input->getPosition());
+  }
+
+  LineRecordReader::~LineRecordReader() {
+    delete input;
+  }
+
+  // The SequenceFile version with metadata, which is the one still written
+  static const char SEQUENCE_FILE_VERSION = 6;
+  // The record length that marks a sync mark
+  static const int32_t SYNC_ESCAPE = -1;
+  static const size_t SYNC_HASH_SIZE = 16;
+  static const size_t SYNC_SIZE = 4 + SYNC_HASH_SIZE;
+
+  /**
+   * Set out to the bytes that the Java BinaryProtocol would send for a
+   * key or value of the given class serialized as raw.
+   */
+  static void unwrap(const string& className, const string& raw,
+                     string& out) {
+    if (className == "org.apache.hadoop.io.Text") {
+      int64_t length;
+      size_t used = deserializeLong(length, raw.data(), raw.size());
+      HADOOP_ASSERT(length >= 0 && (uint64_t) length == raw.size() - used,
+                    "corrupt Text in SequenceFile");
+      out.assign(raw, used, length);
+    } else if (className == "org.apache.hadoop.io.BytesWritable") {
+      HADOOP_ASSERT(raw.size() >= 4, "corrupt BytesWritable in SequenceFile");
+      out.assign(raw, 4, raw.size() - 4);
+    } else {
+      out = raw;
+    }
+  }
+
+  SequenceFileRecordReader::SequenceFileRecordReader(MapContext& context) {
+    FileSplit split = FileSplit::parse(context.getInputSplit());
+    input = new BufferedInput(openInputFile(split.path),
+                              getBufferSize(context));
+    start = split.start;
+    end = split.start + split.length;
+    decompressor = NULL;
+    syncSeen = false;
+    more = true;
+    blockRecords = 0;
+    try {
+      readHeader();
+      if (start > input->getPosition()) {
+        seekToSync(start);
+      }
+    } catch (...) {
+      delete decompressor;
+      delete input;
+      throw;
+    }
+    start = input->getPosition();
+  }
+
+  void SequenceFileRecordReader::readHeader() {
+    char magic[4];
+    input->read(magic, 4);
+    HADOOP_ASSERT(memcmp(magic, "SEQ", 3) == 0, "not a SequenceFile");
+    HADOOP_ASSERT(magic[3] == SEQUENCE_FILE_VERSION,
+                  "unsupported SequenceFile version " +
+                  toString(magic[3]));
+    deserializeString(keyClass, *input);
+    deserializeString(valueClass, *input);
+    bool compressed = input->readByte() != 0;
+    blockCompressed = input->readByte() != 0;
+    recordCompressed = compressed && !blockCompressed;
+    if (compressed) {
+      string codec;
+      deserializeString(codec, *input);
+      decompressor = new Decompressor(codec);
+    }
+    int32_t entries = input->readInt();
+    string name;
+    string value;
+    for (int32_t i = 0; i < entries; ++i) {
+      deserializeString(name, *input);
+      deserializeString(value, *input);
+    }
+    input->read(sync, SYNC_HASH_SIZE);
+  }
+
+  /**
+   * Go to the first sync mark at or after position, as
+   * SequenceFile.Reader.sync does.
+   */
+  void SequenceFileRecordReader::seekToSync(int64_t position) {
+    int64_t length = input->getLength();
+    if (position + (int64_t) SYNC_SIZE >= length) {
+      input->seek(length);
+      return;
+    }
+    input->seek(position + 4);
+    char check[SYNC_HASH_SIZE];
+    input->read(check, SYNC_HASH_SIZE);
+    for (size_t i = 0; input->getPosition() < length; ++i) {
+      size_t j = 0;
+      while (j < SYNC_HASH_SIZE &&
+             sync[j] == check[(i + j) % SYNC_HASH_SIZE]) {
+        ++j;
+      }
+      if (j == SYNC_HASH_SIZE) {
+        input->seek(input->getPosition() - SYNC_SIZE);
+        return;
+      }
+      check[i % SYNC_HASH_SIZE] = input->readByte();
+    }
+  }
+
+  void SequenceFileRecordReader::checkSync() {
+    char check[SYNC_HASH_SIZE];
+    input->read(check, SYNC_HASH_SIZE);
+    HADOOP_ASSERT(memcmp(check, sync, SYNC_HASH_SIZE) == 0,
+                  "SequenceFile is corrupt: bad sync mark");
+    syncSeen = true;
+  }
+
+  bool SequenceFileRecordReader::readRecord(string& key, string& value) {
+    if (input->getPosition() >= input->getLength()) {
+      return false;
+    }
+    int32_t length = input->readInt();
+    if (length == SYNC_ESCAPE) {
+      checkSync();
+      if (input->getPosition() >= input->getLength()) {
+        return false;
+      }
+      length = input->readInt();
+    } else {
+      syncSeen = false;
+    }
+    int32_t keyLength = input->readInt();
+    HADOOP_ASSERT(keyLength >= 0 && keyLength <= length,
+                  "SequenceFile is corrupt: bad record length");
+    input->read(rawKey, keyLength);
+    input->read(rawValue, length - keyLength);
+    unwrap(keyClass, rawKey, key);
+    if (recordCompressed) {
+      // rawKey is free again, now that the key has been unwrapped
+      decompressor->decompress(rawValue, rawKey);
+      unwrap(valueClass, rawKey, value);
+    } else {
+      unwrap(valueClass, rawValue, value);
+    }
+    return true;
+  }
+
+  bool SequenceFileRecordReader::readBlock() {
+    if (input->getPosition() >= input->getLength()) {
+      return false;
+    }
+    HADOOP_ASSERT(input->readInt() == SYNC_ESCAPE,
+                  "SequenceFile is corrupt: no sync mark before block");
+    checkSync();
+    blockRecords = deserializeLong(*input);
+    for (int i = 0; i < 4; ++i) {
+      int64_t length = deserializeLong(*input);
+      HADOOP_ASSERT(length >= 0, "SequenceFile is corrupt: bad block");
+      input->read(rawValue, length);
+      decompressor->decompress(rawValue, blockBuffers[i]);
+      blockOffsets[i] = 0;
+    }
+    return blockRecords > 0;
+  }
+
+  /**
+   * Take the next record of the block: its key length, key, value length
+   * and value are in blockBuffers 0 to 3.
+   */
+  void SequenceFileRecordReader::readBlockRecord(string& key, string& value) {
+    for (int i = 0; i < 4; i += 2) {
+      const string& lengths = blockBuffers[i];
+      const string& data = blockBuffers[i + 1];
+      int64_t length;
+      blockOffsets[i] += deserializeLong(length,
+                                         lengths.data() + blockOffsets[i],
+                                         lengths.size() - blockOffsets[i]);
+      HADOOP_ASSERT(length >= 0 &&
+                    (uint64_t) length <= data.size() - blockOffsets[i + 1],
+                    "SequenceFile is corrupt: bad length in block");
+      string& raw = i == 0 ? rawKey : rawValue;
+      raw.assign(data, blockOffsets[i + 1], length);
+      blockOffsets[i + 1] += length;
+    }
+    unwrap(keyClass, rawKey, key);
+    unwrap(valueClass, rawValue, value);
+    blockRecords -= 1;
+  }
+
+  bool SequenceFileRecordReader::next(string& key, string& value) {
+    if (!more) {
+      return false;
+    }
+    int64_t position = input->getPosition();
+    bool remaining;
+    if (blockCompressed) {
+      syncSeen = false;
+      remaining = blockRecords > 0 || readBlock();
+      if (remaining) {
+        readBlockRecord(key, value);
+      }
+    } else {
+      remaining = readRecord(key, value);
+    }
+    // The record after the first sync mark past the end is the next split's
+    more = remaining && !(position >= end && syncSeen);
+    return more;
+  }
+
+  float SequenceFileRecordReader::getProgress() {
+    return getSplitProgress(start, end, input->getPosition());
+  }
+
+  SequenceFileRecordReader::~SequenceFileRecordReader() {
+    delete decompressor;
+    delete input;
+  }
+}
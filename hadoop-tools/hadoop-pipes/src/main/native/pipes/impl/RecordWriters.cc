@@ -0,0 +1,410 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hadoop/RecordWriters.hh"
+#include "hadoop/SerialUtils.hh"
+#include "hadoop/StringUtils.hh"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef HADOOP_PIPES_LIBHDFS
+#include <hdfs.h>
+#endif
+
+using std::string;
+using std::vector;
+
+using namespace HadoopUtils;
+
+namespace HadoopPipes {
+
+  /**
+   * A file that is written from start to end.
+   */
+  class OutputFile {
+  public:
+    virtual void write(const char* buffer, size_t length) = 0;
+
+    /**
+     * Close the file.
+     * @throws Error if the data could not be written
+     */
+    virtual void close() = 0;
+
+    virtual ~OutputFile() {}
+  };
+
+  /**
+   * Create a directory and the missing ones above it, as mkdir -p does.
+   */
+  static void makeDirectories(const string& path) {
+    string::size_type slash = 0;
+    do {
+      slash = path.find('/', slash + 1);
+      string dir = path.substr(0, slash);
+      if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        throw Error("failed to create " + dir + ": " + strerror(errno));
+      }
+    } while (slash != string::npos);
+  }
+
+  class LocalOutputFile: public OutputFile {
+  private:
+    int fd;
+  public:
+    LocalOutputFile(const string& path) {
+      string::size_type slash = path.rfind('/');
+      if (slash != string::npos && slash > 0) {
+        makeDirectories(path.substr(0, slash));
+      }
+      fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      HADOOP_ASSERT(fd != -1, "failed to create " + path + ": " +
+                    strerror(errno));
+    }
+
+    virtual void write(const char* buffer, size_t length) {
+      while (length > 0) {
+        ssize_t result = ::write(fd, buffer, length);
+        if (result == -1 && errno == EINTR) {
+          continue;
+        }
+        HADOOP_ASSERT(result > 0, string("failed to write: ") +
+                      strerror(errno));
+        buffer += result;
+        length -= result;
+      }
+    }
+
+    virtual void close() {
+      int result = ::close(fd);
+      fd = -1;
+      HADOOP_ASSERT(result == 0, string("failed to close: ") +
+                    strerror(errno));
+    }
+
+    virtual ~LocalOutputFile() {
+      if (fd != -1) {
+        ::close(fd);
+      }
+    }
+  };
+
+#ifdef HADOOP_PIPES_LIBHDFS
+  class HdfsOutputFile: public OutputFile {
+  private:
+    hdfsFS fs;
+    hdfsFile file;
+  public:
+    /**
+     * @param path the URI of the file
+     * @param nameNode the scheme and authority of it, or "default"
+     */
+    HdfsOutputFile(const string& path, const string& nameNode) {
+      struct hdfsBuilder* builder = hdfsNewBuilder();
+      HADOOP_ASSERT(builder != NULL, "failed to create an hdfsBuilder");
+      hdfsBuilderSetNameNode(builder, nameNode.c_str());
+      fs = hdfsBuilderConnect(builder);
+      HADOOP_ASSERT(fs != NULL, "failed to connect to " + nameNode + ": " +
+                    strerror(errno));
+      // The parent directories are created as FileSystem.create does
+      file = hdfsOpenFile(fs, path.c_str(), O_WRONLY, 0, 0, 0);
+      if (file == NULL) {
+        int err = errno;
+        hdfsDisconnect(fs);
+        throw Error("failed to create " + path + ": " + strerror(err));
+      }
+    }
+
+    virtual void write(const char* buffer, size_t length) {
+      while (length > 0) {
+        tSize result = hdfsWrite(fs, file, buffer,
+                                 std::min(length, (size_t) INT32_MAX));
+        HADOOP_ASSERT(result > 0, string("failed to write: ") +
+                      strerror(errno));
+        buffer += result;
+        length -= result;
+      }
+    }
+
+    virtual void close() {
+      int result = hdfsCloseFile(fs, file);
+      file = NULL;
+      HADOOP_ASSERT(result == 0, string("failed to close: ") +
+                    strerror(errno));
+    }
+
+    virtual ~HdfsOutputFile() {
+      if (file != NULL) {
+        hdfsCloseFile(fs, file);
+      }
+      hdfsDisconnect(fs);
+    }
+  };
+#endif
+
+  static OutputFile* openOutputFile(const string& path) {
+    string::size_type colon = path.find(':');
+    string::size_type slash = path.find('/');
+    if (colon == string::npos || (slash != string::npos && slash < colon)) {
+      return new LocalOutputFile(path);
+    }
+    bool hasAuthority = path.compare(colon + 1, 2, "//") == 0;
+    string::size_type pathStart = hasAuthority ?
+      path.find('/', colon + 3) : colon + 1;
+    HADOOP_ASSERT(pathStart != string::npos, "no path in " + path);
+    if (path.compare(0, colon, "file") == 0) {
+      return new LocalOutputFile(path.substr(pathStart));
+    }
+#ifdef HADOOP_PIPES_LIBHDFS
+    return new HdfsOutputFile(path, hasAuthority ? path.substr(0, pathStart) :
+                              string("default"));
+#else
+    throw Error("cannot write " + path +
+                ": the pipes library was built without libhdfs");
+#endif
+  }
+
+  /**
+   * Writes a file through a large buffer, emptied a buffer at a time.
+   */
+  class BufferedOutput: public OutStream {
+  private:
+    OutputFile* file;
+    vector<char> buffer;
+    size_t used;
+    // The bytes of the file written out of the buffer
+    int64_t written;
+  public:
+    BufferedOutput(OutputFile* _file, size_t bufferSize): buffer(bufferSize) {
+      file = _file;
+      used = 0;
+      written = 0;
+    }
+
+    int64_t getPosition() const {
+      return written + used;
+    }
+
+    virtual void write(const void* buf, size_t len) {
+      const char* in = (const char*) buf;
+      if (len > buffer.size() - used) {
+        flush();
+        if (len >= buffer.size()) {
+          file->write(in, len);
+          written += len;
+          return;
+        }
+      }
+      if (len > 0) {
+        memcpy(&buffer[used], in, len);
+        used += len;
+      }
+    }
+
+    /**
+     * Write an int as Java's DataOutput.writeInt does.
+     */
+    void writeInt(int32_t t) {
+      unsigned char bytes[4];
+      bytes[0] = (uint32_t) t >> 24;
+      bytes[1] = (uint32_t) t >> 16;
+      bytes[2] = (uint32_t) t >> 8;
+      bytes[3] = (uint32_t) t;
+      write(bytes, 4);
+    }
+
+    virtual void flush() {
+      if (used > 0) {
+        file->write(&buffer[0], used);
+        written += used;
+        used = 0;
+      }
+    }
+
+    void close() {
+      flush();
+      file->close();
+    }
+
+    virtual ~BufferedOutput() {
+      delete file;
+    }
+  };
+
+  /**
+   * Create the part file of the task in its work directory.
+   */
+  static BufferedOutput* openPartFile(ReduceContext& context) {
+    const JobConf* conf = context.getJobConf();
+    const string compress = "mapreduce.output.fileoutputformat.compress";
+    HADOOP_ASSERT(!conf->hasKey(compress) || !conf->getBoolean(compress),
+                  "the pipes RecordWriters do not write compressed output");
+    HADOOP_ASSERT(conf->hasKey("mapreduce.task.output.dir"),
+                  "mapreduce.task.output.dir is not set");
+    size_t bufferSize = 4 * 1024 * 1024;
+    if (conf->hasKey("mapreduce.pipes.writer.buffer.bytes")) {
+      int size = conf->getInt("mapreduce.pipes.writer.buffer.bytes");
+      HADOOP_ASSERT(size > 0, "mapreduce.pipes.writer.buffer.bytes must be "
+                    "positive");
+      bufferSize = size;
+    }
+    // The name the old API FileOutputFormats give the output of a reduce
+    char name[32];
+    snprintf(name, sizeof(name), "part-%05d",
+             conf->getInt("mapreduce.task.partition"));
+    string path = conf->get("mapreduce.task.output.dir") + "/" + name;
+    return new BufferedOutput(openOutputFile(path), bufferSize);
+  }
+
+  LineRecordWriter::LineRecordWriter(ReduceContext& context) {
+    const JobConf* conf = context.getJobConf();
+    const string key = "mapreduce.output.textoutputformat.separator";
+    separator = conf->hasKey(key) ? conf->get(key) : string("\t");
+    output = openPartFile(context);
+  }
+
+  void LineRecordWriter::emit(const string& key, const string& value) {
+    output->write(key.data(), key.size());
+    output->write(separator.data(), separator.size());
+    output->write(value.data(), value.size());
+    output->write("\n", 1);
+  }
+
+  void LineRecordWriter::close() {
+    output->close();
+  }
+
+  LineRecordWriter::~LineRecordWriter() {
+    delete output;
+  }
+
+  /** The version of SequenceFile written, with metadata. */
+  static const char SEQUENCE_FILE_VERSION = 6;
+
+  /** Java's SequenceFile.SYNC_INTERVAL, 100 sync marks of 20 bytes */
+  static const int64_t SYNC_INTERVAL = 100 * 20;
+
+  /**
+   * Set out to the serialized form of a key or value of the given class,
+   * given as the bytes the Java BinaryProtocol would receive.
+   */
+  static void wrap(const string& className, const string& bytes,
+                   string& out) {
+    if (className == "org.apache.hadoop.io.Text") {
+      out.resize(getVLongSize(bytes.size()) + bytes.size());
+      serializeString(bytes, &out[0]);
+    } else if (className == "org.apache.hadoop.io.BytesWritable") {
+      HADOOP_ASSERT(bytes.size() <= INT32_MAX, "BytesWritable too large");
+      uint32_t length = bytes.size();
+      out.resize(4);
+      out[0] = length >> 24;
+      out[1] = length >> 16;
+      out[2] = length >> 8;
+      out[3] = length;
+      out.append(bytes);
+    } else {
+      out = bytes;
+    }
+  }
+
+  /**
+   * Make the sync mark of a new file, which only has to be unlikely to
+   * appear in its records.
+   */
+  static void makeSync(char* sync) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    bool done = fd != -1 && read(fd, sync, 16) == 16;
+    if (fd != -1) {
+      close(fd);
+    }
+    if (!done) {
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      uint64_t state = ((uint64_t) now.tv_sec * 1000000 + now.tv_usec) ^
+        ((uint64_t) getpid() << 40);
+      for (int i = 0; i < 16; ++i) {
+        // splitmix64
+        state += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        sync[i] = (char) (z ^ (z >> 31));
+      }
+    }
+  }
+
+  SequenceFileRecordWriter::SequenceFileRecordWriter(ReduceContext& context) {
+    const JobConf* conf = context.getJobConf();
+    const string text = "org.apache.hadoop.io.Text";
+    keyClass = conf->hasKey("mapreduce.job.output.key.class") ?
+      conf->get("mapreduce.job.output.key.class") : text;
+    valueClass = conf->hasKey("mapreduce.job.output.value.class") ?
+      conf->get("mapreduce.job.output.value.class") : text;
+    makeSync(sync);
+    lastSync = 0;
+    output = openPartFile(context);
+    try {
+      const char magic[4] = {'S', 'E', 'Q', SEQUENCE_FILE_VERSION};
+      output->write(magic, 4);
+      serializeString(keyClass, *output);
+      serializeString(valueClass, *output);
+      // Neither record nor block compressed, and no metadata
+      output->write("\0\0", 2);
+      output->writeInt(0);
+      output->write(sync, 16);
+    } catch (...) {
+      delete output;
+      throw;
+    }
+  }
+
+  void SequenceFileRecordWriter::emit(const string& key, const string& value) {
+    if (output->getPosition() >= lastSync + SYNC_INTERVAL) {
+      lastSync = output->getPosition();
+      output->writeInt(-1);
+      output->write(sync, 16);
+    }
+    wrap(keyClass, key, rawKey);
+    wrap(valueClass, value, rawValue);
+    HADOOP_ASSERT(rawKey.size() + rawValue.size() <= INT32_MAX,
+                  "record too large for a SequenceFile");
+    output->writeInt(rawKey.size() + rawValue.size());
+    output->writeInt(rawKey.size());
+    output->write(rawKey.data(), rawKey.size());
+    output->write(rawValue.data(), rawValue.size());
+  }
+
+  void SequenceFileRecordWriter::close() {
+    output->close();
+  }
+
+  SequenceFileRecordWriter::~SequenceFileRecordWriter() {
+    delete output;
+  }
+}
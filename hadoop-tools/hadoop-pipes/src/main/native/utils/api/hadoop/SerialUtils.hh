@@ -166,6 +166,44 @@ namespace HadoopUtils {
   float deserializeFloat(InStream& stream);
   void serializeString(const std::string& t, OutStream& stream);
   void deserializeString(std::string& t, InStream& stream);
+
+  /**
+   * The most bytes that a serialized long takes.
+   */
+  const size_t MAX_VLONG_SIZE = 9;
+
+  /**
+   * @return the number of bytes serializeLong writes for t
+   */
+  size_t getVLongSize(int64_t t);
+
+  /**
+   * Serialize a long into buf, which must have room for getVLongSize(t) 
+   * bytes.
+   * @return the number of bytes written
+   */
+  size_t serializeLong(int64_t t, char* buf);
+
+  /**
+   * Deserialize a long from the len bytes at buf.
+   * @return the number of bytes read
+   * @throws Error if buf ends in the middle of the long
+   */
+  size_t deserializeLong(int64_t& t, const char* buf, size_t len);
+
+  /**
+   * Serialize a string into buf, which must have room for
+   * getVLongSize(t.length()) + t.length() bytes.
+   * @return the number of bytes written
+   */
+  size_t serializeString(const std::string& t, char* buf);
+
+  /**
+   * Deserialize a string from the len bytes at buf.
+   * @return the number of bytes read
+   * @throws Error if buf ends in the middle of the string
+   */
+  size_t deserializeString(std::string& t, const char* buf, size_t len);
 }
 
 #endif
@@ -0,0 +1,222 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Times the stream and buffer serializers of SerialUtils against the old
+ * byte at a time stream code, and checks that all of them agree.
+ *
+ *   serial-utils-bench [values] [rounds]
+ */
+
+#include "hadoop/SerialUtils.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using HadoopUtils::Error;
+using HadoopUtils::InStream;
+using HadoopUtils::OutStream;
+
+/**
+ * An OutStream into a vector, so that the timings are of the encoding and
+ * not of a file.
+ */
+class VectorOutStream: public OutStream {
+public:
+  vector<char> buffer;
+  void write(const void *buf, size_t len) {
+    const char* bytes = (const char*) buf;
+    buffer.insert(buffer.end(), bytes, bytes + len);
+  }
+  void flush() {}
+};
+
+class VectorInStream: public InStream {
+private:
+  const vector<char>& buffer;
+  size_t position;
+public:
+  VectorInStream(const vector<char>& _buffer): buffer(_buffer), position(0) {}
+  void read(void *buf, size_t len) {
+    HADOOP_ASSERT(len <= buffer.size() - position, "end of buffer");
+    memcpy(buf, &buffer[position], len);
+    position += len;
+  }
+};
+
+/**
+ * The serializer as it was, one stream write for each byte.
+ */
+static void byteSerializeLong(int64_t t, OutStream& stream) {
+  if (t >= -112 && t <= 127) {
+    int8_t b = t;
+    stream.write(&b, 1);
+    return;
+  }
+  int8_t len = -112;
+  if (t < 0) {
+    t ^= -1ll;
+    len = -120;
+  }
+  uint64_t tmp = t;
+  while (tmp != 0) {
+    tmp = tmp >> 8;
+    len--;
+  }
+  stream.write(&len, 1);
+  len = (len < -120) ? -(len + 120) : -(len + 112);
+  for (uint32_t idx = len; idx != 0; idx--) {
+    uint32_t shiftbits = (idx - 1) * 8;
+    uint64_t mask = 0xFFll << shiftbits;
+    uint8_t b = (t & mask) >> shiftbits;
+    stream.write(&b, 1);
+  }
+}
+
+static int64_t byteDeserializeLong(InStream& stream) {
+  int8_t b;
+  stream.read(&b, 1);
+  if (b >= -112) {
+    return b;
+  }
+  bool negative;
+  int len;
+  if (b < -120) {
+    negative = true;
+    len = -120 - b;
+  } else {
+    negative = false;
+    len = -112 - b;
+  }
+  int64_t t = 0;
+  for (int idx = 0; idx < len; idx++) {
+    uint8_t c;
+    stream.read(&c, 1);
+    t = (t << 8) | c;
+  }
+  return negative ? t ^ -1ll : t;
+}
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char* name, double seconds, size_t values) {
+  printf("%-24s %8.2f ns/value\n", name, seconds * 1e9 / values);
+}
+
+int main(int argc, char *argv[]) {
+  size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 10;
+  try {
+    // A mix of the lengths of record sizes and counters
+    vector<int64_t> values(count);
+    srandom(42);
+    for (size_t i = 0; i < count; ++i) {
+      int bits = random() % 64;
+      int64_t v = ((int64_t) random() << 32 | random()) >> (63 - bits);
+      values[i] = (i % 4 == 0) ? v % 100 : v;
+    }
+    size_t total = count * rounds;
+    uint64_t check = 0;
+
+    double start = now();
+    VectorOutStream byteOut;
+    for (int r = 0; r < rounds; ++r) {
+      byteOut.buffer.clear();
+      for (size_t i = 0; i < count; ++i) {
+        byteSerializeLong(values[i], byteOut);
+      }
+    }
+    report("byte stream write", now() - start, total);
+
+    start = now();
+    VectorOutStream streamOut;
+    for (int r = 0; r < rounds; ++r) {
+      streamOut.buffer.clear();
+      for (size_t i = 0; i < count; ++i) {
+        HadoopUtils::serializeLong(values[i], streamOut);
+      }
+    }
+    report("stream write", now() - start, total);
+
+    start = now();
+    vector<char> buffer(count * HadoopUtils::MAX_VLONG_SIZE);
+    size_t used = 0;
+    for (int r = 0; r < rounds; ++r) {
+      used = 0;
+      for (size_t i = 0; i < count; ++i) {
+        used += HadoopUtils::serializeLong(values[i], &buffer[used]);
+      }
+    }
+    report("buffer write", now() - start, total);
+
+    HADOOP_ASSERT(byteOut.buffer == streamOut.buffer &&
+                  used == streamOut.buffer.size() &&
+                  memcmp(&buffer[0], &streamOut.buffer[0], used) == 0,
+                  "the serializers disagree");
+
+    start = now();
+    for (int r = 0; r < rounds; ++r) {
+      VectorInStream in(byteOut.buffer);
+      for (size_t i = 0; i < count; ++i) {
+        check += byteDeserializeLong(in);
+      }
+    }
+    report("byte stream read", now() - start, total);
+
+    start = now();
+    for (int r = 0; r < rounds; ++r) {
+      VectorInStream in(streamOut.buffer);
+      for (size_t i = 0; i < count; ++i) {
+        int64_t t = HadoopUtils::deserializeLong(in);
+        HADOOP_ASSERT(t == values[i], "stream read the wrong value");
+        check += t;
+      }
+    }
+    report("stream read", now() - start, total);
+
+    start = now();
+    for (int r = 0; r < rounds; ++r) {
+      size_t position = 0;
+      for (size_t i = 0; i < count; ++i) {
+        int64_t t;
+        position += HadoopUtils::deserializeLong(t, &buffer[position],
+                                                 used - position);
+        HADOOP_ASSERT(t == values[i], "buffer read the wrong value");
+        check += t;
+      }
+    }
+    report("buffer read", now() - start, total);
+
+    // Keep the reads from being optimized away
+    printf("checksum %llu\n", (unsigned long long) check);
+  } catch (Error& err) {
+    fprintf(stderr, "Error: %s\n", err.getMessage().c_str());
+    return 1;
+  }
+  return 0;
+}
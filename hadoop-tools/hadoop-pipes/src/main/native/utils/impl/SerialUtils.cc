@@ -18,6 +18,7 @@
 #include "hadoop/SerialUtils.hh"
 #include "hadoop/StringUtils.hh"
 
+#include <algorithm>
 #include <errno.h>
 #include <rpc/types.h>
 #include <rpc/xdr.h>
@@ -162,52 +163,135 @@ namespace HadoopUtils {
   }
 
   void StringInStream::read(void *buf, size_t buflen) {
-    size_t bytes = 0;
-    char* output = (char*) buf;
-    std::string::const_iterator end = buffer.end();
-    while (bytes < buflen) {
-      output[bytes++] = *itr;
-      ++itr;
-      if (itr == end) {
-        break;
-      }
-    }
-    HADOOP_ASSERT(bytes == buflen, "unexpected end of string reached");
+    size_t remaining = buffer.end() - itr;
+    HADOOP_ASSERT(buflen <= remaining, "unexpected end of string reached");
+    std::copy(itr, itr + buflen, (char*) buf);
+    itr += buflen;
   }
 
-  void serializeInt(int32_t t, OutStream& stream) {
-    serializeLong(t,stream);
+  size_t getVLongSize(int64_t t)
+  {
+    if (t >= -112 && t <= 127) {
+      return 1;
+    }
+    if (t < 0) {
+      t ^= -1ll; // reset the sign bit
+    }
+    // t is not 0, so count the bytes from its highest bit set
+    return 1 + (64 - __builtin_clzll((uint64_t) t) + 7) / 8;
   }
 
-  void serializeLong(int64_t t, OutStream& stream)
+  size_t serializeLong(int64_t t, char* buf)
   {
     if (t >= -112 && t <= 127) {
-      int8_t b = t;
-      stream.write(&b, 1);
-      return;
+      buf[0] = (int8_t) t;
+      return 1;
     }
-        
     int8_t len = -112;
     if (t < 0) {
       t ^= -1ll; // reset the sign bit
       len = -120;
     }
-        
     uint64_t tmp = t;
-    while (tmp != 0) {
-      tmp = tmp >> 8;
-      len--;
+    int bytes = (64 - __builtin_clzll(tmp) + 7) / 8;
+    buf[0] = len - bytes;
+    // Write the bytes most significant first, falling through the cases
+    char* out = buf + 1;
+    switch (bytes) {
+    case 8: *out++ = (char) (tmp >> 56);
+    case 7: *out++ = (char) (tmp >> 48);
+    case 6: *out++ = (char) (tmp >> 40);
+    case 5: *out++ = (char) (tmp >> 32);
+    case 4: *out++ = (char) (tmp >> 24);
+    case 3: *out++ = (char) (tmp >> 16);
+    case 2: *out++ = (char) (tmp >> 8);
+    case 1: *out++ = (char) tmp;
     }
-  
-    stream.write(&len, 1);      
-    len = (len < -120) ? -(len + 120) : -(len + 112);
-        
-    for (uint32_t idx = len; idx != 0; idx--) {
-      uint32_t shiftbits = (idx - 1) * 8;
-      uint64_t mask = 0xFFll << shiftbits;
-      uint8_t b = (t & mask) >> shiftbits;
-      stream.write(&b, 1);
+    return 1 + bytes;
+  }
+
+  /**
+   * @return the number of bytes after the first byte of a long
+   */
+  static inline int getVLongLength(int8_t first, bool& negative)
+  {
+    if (first >= -112) {
+      negative = false;
+      return 0;
     }
+    if (first < -120) {
+      negative = true;
+      return -120 - first;
+    }
+    negative = false;
+    return -112 - first;
+  }
+
+  static inline int64_t decodeVLong(const uint8_t* barr, int len, 
+                                    bool negative)
+  {
+    uint64_t t = 0;
+    switch (len) {
+    case 8: t = (t << 8) | *barr++;
+    case 7: t = (t << 8) | *barr++;
+    case 6: t = (t << 8) | *barr++;
+    case 5: t = (t << 8) | *barr++;
+    case 4: t = (t << 8) | *barr++;
+    case 3: t = (t << 8) | *barr++;
+    case 2: t = (t << 8) | *barr++;
+    case 1: t = (t << 8) | *barr++;
+    }
+    if (negative) {
+      t ^= -1ll;
+    }
+    return t;
+  }
+
+  size_t deserializeLong(int64_t& t, const char* buf, size_t len)
+  {
+    HADOOP_ASSERT(len > 0, "end of buffer reading a long");
+    int8_t b = buf[0];
+    if (b >= -112) {
+      t = b;
+      return 1;
+    }
+    bool negative;
+    int bytes = getVLongLength(b, negative);
+    HADOOP_ASSERT(len > (size_t) bytes, "end of buffer reading a long");
+    t = decodeVLong((const uint8_t*) buf + 1, bytes, negative);
+    return 1 + bytes;
+  }
+
+  size_t serializeString(const std::string& t, char* buf)
+  {
+    size_t len = serializeLong(t.length(), buf);
+    memcpy(buf + len, t.data(), t.length());
+    return len + t.length();
+  }
+
+  size_t deserializeString(std::string& t, const char* buf, size_t len)
+  {
+    int64_t length;
+    size_t used = deserializeLong(length, buf, len);
+    if (length <= 0) {
+      t.clear();
+      return used;
+    }
+    HADOOP_ASSERT((uint64_t) length <= len - used,
+                  "end of buffer reading a string");
+    t.assign(buf + used, length);
+    return used + length;
+  }
+
+  void serializeInt(int32_t t, OutStream& stream) {
+    serializeLong(t,stream);
+  }
+
+  void serializeLong(int64_t t, OutStream& stream)
+  {
+    // One write, rather than one for each byte
+    char buf[MAX_VLONG_SIZE];
+    stream.write(buf, serializeLong(t, buf));
   }
 
   int32_t deserializeInt(InStream& stream) {
@@ -222,25 +306,10 @@ namespace HadoopUtils {
       return b;
     }
     bool negative;
-    int len;
-    if (b < -120) {
-      negative = true;
-      len = -120 - b;
-    } else {
-      negative = false;
-      len = -112 - b;
-    }
-    uint8_t barr[len];
+    int len = getVLongLength(b, negative);
+    uint8_t barr[MAX_VLONG_SIZE];
     stream.read(barr, len);
-    int64_t t = 0;
-    for (int idx = 0; idx < len; idx++) {
-      t = t << 8;
-      t |= (barr[idx] & 0xFF);
-    }
-    if (negative) {
-      t ^= -1ll;
-    }
-    return t;
+    return decodeVLong(barr, len, negative);
   }
 
   void serializeFloat(float t, OutStream& stream)
@@ -280,19 +349,10 @@ namespace HadoopUtils {
   {
     int32_t len = deserializeInt(stream);
     if (len > 0) {
-      // resize the string to the right length
+      // resize the string to the right length, which only allocates when it
+      // grows past its capacity, and read straight into it
       t.resize(len);
-      // read into the string in 64k chunks
-      const int bufSize = 65536;
-      int offset = 0;
-      char buf[bufSize];
-      while (len > 0) {
-        int chunkLength = len > bufSize ? bufSize : len;
-        stream.read(buf, chunkLength);
-        t.replace(offset, chunkLength, buf, chunkLength);
-        offset += chunkLength;
-        len -= chunkLength;
-      }
+      stream.read(&t[0], len);
     } else {
       t.clear();
     }
@@ -21,7 +21,9 @@
 import java.io.IOException;
 import java.math.BigInteger;
 import java.util.HashMap;
+import java.util.HashSet;
 import java.util.Map;
+import java.util.Set;
 
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
@@ -55,6 +57,22 @@ static class ProcessInfo {
   /** Clock to account for CPU utilization. */
   private Clock clock;
 
+  /**
+   * The job objects of the trees being monitored. Their processes are listed
+   * with one winutils processListBatch for each round of updates, rather
+   * than with one winutils processList per tree.
+   */
+  private static final Set<String> batchTaskIds = new HashSet<String>();
+  /** The processes of each job object, from the last batch */
+  private static Map<String, String> batchProcessInfo =
+      new HashMap<String, String>();
+  /** Counts the batches, so a tree can tell a new round has started */
+  private static long batchNumber = 0;
+  /** Whether winutils has processListBatch, or null if not known yet */
+  private static Boolean batchSupported = null;
+  /** The batch this tree last read its processes from */
+  private long lastBatchNumber = -1;
+
   public static boolean isAvailable() {
     if (Shell.WINDOWS) {
       if (!Shell.hasWinutilsPath()) {
@@ -100,6 +118,9 @@ public WindowsBasedProcessTree(final String pid, final Clock pClock) {
 
   // helper method to override while testing
   String getAllProcessInfoFromShell() {
+    if (isBatchSupported()) {
+      return getProcessInfoFromBatch(this);
+    }
     try {
       ShellCommandExecutor shellExecutor = new ShellCommandExecutor(
           new String[] {Shell.getWinUtilsFile().getCanonicalPath(),
@@ -112,6 +133,90 @@ String getAllProcessInfoFromShell() {
     return null;
   }
 
+  private static synchronized boolean isBatchSupported() {
+    if (batchSupported == null) {
+      ShellCommandExecutor shellExecutor = new ShellCommandExecutor(
+          new String[] { Shell.getWinUtilsPath(), "help" });
+      try {
+        shellExecutor.execute();
+      } catch (IOException e) {
+        LOG.debug("winutils help failed", e);
+      }
+      String output = shellExecutor.getOutput();
+      batchSupported = output != null && output.contains("processListBatch");
+    }
+    return batchSupported;
+  }
+
+  /**
+   * Get the processes of a tree from the current batch. The first tree to
+   * be updated again in a round, or a tree that is new, lists the processes
+   * of all the trees once for the others to read.
+   */
+  private static synchronized String getProcessInfoFromBatch(
+      WindowsBasedProcessTree tree) {
+    String taskId = tree.taskProcessId;
+    if (!batchTaskIds.contains(taskId) || tree.lastBatchNumber == batchNumber) {
+      batchTaskIds.add(taskId);
+      String[] command = new String[batchTaskIds.size() + 3];
+      int i = 0;
+      try {
+        command[i++] = Shell.getWinUtilsFile().getCanonicalPath();
+      } catch (IOException e) {
+        LOG.error(StringUtils.stringifyException(e));
+        return null;
+      }
+      command[i++] = "task";
+      command[i++] = "processListBatch";
+      for (String id : batchTaskIds) {
+        command[i++] = id;
+      }
+      ShellCommandExecutor shellExecutor = new ShellCommandExecutor(command);
+      try {
+        shellExecutor.execute();
+      } catch (IOException e) {
+        LOG.error(StringUtils.stringifyException(e));
+        return null;
+      }
+      batchProcessInfo = splitBatchedProcessInfo(shellExecutor.getOutput());
+      // Tasks with no processes are done, and a tree that is still being
+      // monitored adds its task back
+      batchTaskIds.retainAll(batchProcessInfo.keySet());
+      batchNumber++;
+    }
+    tree.lastBatchNumber = batchNumber;
+    String processInfo = batchProcessInfo.get(taskId);
+    return processInfo == null ? "" : processInfo;
+  }
+
+  /**
+   * Splits the output of winutils task processListBatch into the process
+   * info lines of each task, as winutils task processList prints them.
+   * @param batchInfoStr
+   * @return Map of task name to its process info lines
+   */
+  static Map<String, String> splitBatchedProcessInfo(String batchInfoStr) {
+    Map<String, StringBuilder> builders = new HashMap<String, StringBuilder>();
+    for (String line : batchInfoStr.split("\r\n")) {
+      int comma = line.indexOf(',');
+      if (comma <= 0) {
+        continue;
+      }
+      String taskId = line.substring(0, comma);
+      StringBuilder builder = builders.get(taskId);
+      if (builder == null) {
+        builder = new StringBuilder();
+        builders.put(taskId, builder);
+      }
+      builder.append(line, comma + 1, line.length()).append("\r\n");
+    }
+    Map<String, String> processInfo = new HashMap<String, String>();
+    for (Map.Entry<String, StringBuilder> entry : builders.entrySet()) {
+      processInfo.put(entry.getKey(), entry.getValue().toString());
+    }
+    return processInfo;
+  }
+
   /**
    * Parses string of process info lines into ProcessInfo objects
    * @param processesInfoStr
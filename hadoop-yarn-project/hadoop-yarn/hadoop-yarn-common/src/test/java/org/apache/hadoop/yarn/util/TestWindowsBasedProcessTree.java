@@ -24,6 +24,9 @@
 import org.junit.Assert;
 import org.junit.Test;
 
+import java.util.Map;
+
+import static org.junit.Assert.assertEquals;
 import static org.junit.Assert.assertTrue;
 
 public class TestWindowsBasedProcessTree {
@@ -102,4 +105,18 @@ public void tree() {
     Assert.assertEquals("Percent CPU time is not correct",
         pTree.getCpuUsagePercent(), 0, 0.01);
   }
+
+  @Test (timeout = 30000)
+  public void splitBatchedProcessInfo() {
+    Map<String, String> processInfo =
+        WindowsBasedProcessTree.splitBatchedProcessInfo(
+            "container_1,3524,1024,1024,500\r\n" +
+            "container_2,2844,2048,2048,1000\r\n" +
+            "container_1,1234,1024,1024,500\r\n");
+    assertEquals(2, processInfo.size());
+    assertEquals("3524,1024,1024,500\r\n1234,1024,1024,500\r\n",
+        processInfo.get("container_1"));
+    assertEquals("2844,2048,2048,1000\r\n", processInfo.get("container_2"));
+    assertTrue(WindowsBasedProcessTree.splitBatchedProcessInfo("").isEmpty());
+  }
 }
@@ -50,7 +50,9 @@ public enum OperationType {
     TC_READ_STATE("--tc-read-state"),
     TC_READ_STATS("--tc-read-stats"),
     ADD_PID_TO_CGROUP(""), //no CLI switch supported yet.
-    RUN_DOCKER_CMD("--run-docker");
+    RUN_DOCKER_CMD("--run-docker"),
+    CGROUP2_STATS("--cgroup2-stats"),
+    TC_READ_CLASS_STATS("--tc-read-class-stats");
 
     private final String option;
 
@@ -65,6 +67,7 @@ public String getOption() {
 
   public static final String CGROUP_ARG_PREFIX = "cgroups=";
   public static final String CGROUP_ARG_NO_TASKS = "none";
+  public static final String CGROUP2_ARG_PREFIX = "cgroups2=";
 
   private final OperationType opType;
   private final List<String> args;
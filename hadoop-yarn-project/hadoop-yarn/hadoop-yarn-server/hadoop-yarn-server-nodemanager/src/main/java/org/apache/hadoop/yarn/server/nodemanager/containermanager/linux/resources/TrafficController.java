@@ -108,6 +108,8 @@
   private int rootBandwidthMbit;
   private int yarnBandwidthMbit;
   private int defaultClassBandwidthMbit;
+  /** Whether container-executor can read the class stats over netlink */
+  private volatile boolean classStatsSupported = true;
 
   TrafficController(Configuration conf, PrivilegedOperationExecutor exec) {
     this.conf = conf;
@@ -322,6 +324,31 @@ private void reacquireContainerClasses(String state) {
   }
 
   public Map<Integer, Integer> readStats() throws ResourceHandlerException {
+    if (classStatsSupported) {
+      PrivilegedOperation op = new PrivilegedOperation(
+          PrivilegedOperation.OperationType.TC_READ_CLASS_STATS, device);
+      op.disableFailureLogging();
+
+      try {
+        String output =
+            privilegedOperationExecutor.executePrivilegedOperation(op, true);
+        Map<Integer, Integer> classIdBytesStats =
+            parseClassStatsString(output);
+
+        if (LOG.isDebugEnabled()) {
+          LOG.debug("classId -> bytes sent %n" + classIdBytesStats);
+        }
+
+        return classIdBytesStats;
+      } catch (PrivilegedOperationException e) {
+        //An older container-executor does not know the option - read the
+        //stats with tc from now on
+        LOG.warn("Failed to read tc class stats over netlink, falling back " +
+            "to parsing tc output", e);
+        classStatsSupported = false;
+      }
+    }
+
     BatchBuilder builder = new BatchBuilder(PrivilegedOperation.
         OperationType.TC_READ_STATS)
         .readClasses();
@@ -348,6 +375,43 @@ public Map<Integer, Integer> readStats() throws ResourceHandlerException {
     }
   }
 
+  /**
+   * Parses the output of --tc-read-class-stats, one line per class, e.g.
+   * "eth0 42:4 parent=42:3 bytes=77921300 packets=52617 drops=0 overlimits=0"
+   */
+  private Map<Integer, Integer> parseClassStatsString(String stats) {
+    String classPrefix = ROOT_QDISC_HANDLE + ":";
+    Map<Integer, Integer> containerClassIdStats = new HashMap<>();
+
+    for (String line : stats.split("\n")) {
+      String[] fields = line.trim().split(" ");
+      //container classes are added with decimal digits, which tc reads and
+      //prints as hex, so the minor is parsed back as decimal as it is for tc
+      if (fields.length < 3 || !fields[1].startsWith(classPrefix)) {
+        continue;
+      }
+      int classId;
+      try {
+        classId = Integer.parseInt(fields[1].substring(classPrefix.length()));
+      } catch (NumberFormatException e) {
+        continue;
+      }
+      if (classId < MIN_CONTAINER_CLASS_ID) {
+        continue;
+      }
+      for (int i = 2; i < fields.length; i++) {
+        if (fields[i].startsWith("bytes=")) {
+          long bytes = Long.parseLong(fields[i].substring("bytes=".length()));
+          containerClassIdStats.put(classId,
+              (int) Math.min(bytes, Integer.MAX_VALUE));
+          break;
+        }
+      }
+    }
+
+    return containerClassIdStats;
+  }
+
   private Map<Integer, Integer> parseStatsString(String stats) {
     //Example class stats segment (multiple present in tc output)
     //  class htb 42:4 parent 42:3 prio 0 rate 1000Kbit ceil 7000Kbit burst1600b cburst 1598b
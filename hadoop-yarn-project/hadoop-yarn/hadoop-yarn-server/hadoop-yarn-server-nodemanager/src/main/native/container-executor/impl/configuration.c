@@ -50,6 +50,59 @@ void free_configurations(struct configuration *cfg) {
     free(cfg->confdetails);
   }
   cfg->size = 0;
+  cfg->capacity = 0;
+  free(cfg->index);
+  cfg->index = NULL;
+  cfg->index_size = 0;
+}
+
+static unsigned int hash_key(const char *key) {
+  // FNV-1a
+  unsigned int hash = 2166136261u;
+  for (; *key != '\0'; ++key) {
+    hash ^= (unsigned char) *key;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Find the slot of the key in the index, which is either the slot of the
+ * entry with that key or the empty slot where it would go.
+ */
+static int find_index_slot(const char *key, struct configuration *cfg) {
+  int mask = cfg->index_size - 1;
+  int slot = hash_key(key) & mask;
+  while (cfg->index[slot] != 0 &&
+         strcmp(cfg->confdetails[cfg->index[slot] - 1]->key, key) != 0) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/**
+ * Build the index of the keys, which is at most half full.  When a key
+ * appears more than once the first entry wins, as in a linear search.
+ * If it cannot be allocated the lookups fall back to a linear search.
+ */
+static void build_index(struct configuration *cfg) {
+  int index_size = 16;
+  while (index_size < 2 * cfg->size) {
+    index_size *= 2;
+  }
+  cfg->index = calloc(index_size, sizeof(int));
+  if (cfg->index == NULL) {
+    cfg->index_size = 0;
+    return;
+  }
+  cfg->index_size = index_size;
+  int i;
+  for (i = 0; i < cfg->size; i++) {
+    int slot = find_index_slot(cfg->confdetails[i]->key, cfg);
+    if (cfg->index[slot] == 0) {
+      cfg->index[slot] = i + 1;
+    }
+  }
 }
 
 /**
@@ -143,6 +196,9 @@ void read_config(const char* file_name, struct configuration *cfg) {
   cfg->confdetails = (struct confentry **) malloc(sizeof(struct confentry *)
       * MAX_SIZE);
   cfg->size = 0;
+  cfg->capacity = MAX_SIZE;
+  cfg->index = NULL;
+  cfg->index_size = 0;
   conf_file = fopen(file_name, "r");
   if (conf_file == NULL) {
     fprintf(ERRORFILE, "Invalid conf file provided : %s \n", file_name);
@@ -220,9 +276,12 @@ void read_config(const char* file_name, struct configuration *cfg) {
     cfg->confdetails[cfg->size]->value = (char *) malloc(
             sizeof(char) * (strlen(equaltok)+1));
     strcpy((char *)cfg->confdetails[cfg->size]->value, equaltok);
-    if((cfg->size + 1) % MAX_SIZE  == 0) {
+    // double the space, so that a large file is not copied for every
+    // few items
+    if(cfg->size + 1 == cfg->capacity) {
+      cfg->capacity *= 2;
       cfg->confdetails = (struct confentry **) realloc(cfg->confdetails,
-          sizeof(struct confentry **) * (MAX_SIZE + cfg->size));
+          sizeof(struct confentry *) * cfg->capacity);
       if (cfg->confdetails == NULL) {
         fprintf(LOGFILE,
             "Failed re-allocating memory for configuration items\n");
@@ -243,6 +302,7 @@ void read_config(const char* file_name, struct configuration *cfg) {
     fprintf(ERRORFILE, "Invalid configuration provided in %s\n", file_name);
     exit(INVALID_CONFIG_FILE);
   }
+  build_index(cfg);
 
   //clean up allocated file name
   return;
@@ -263,6 +323,10 @@ void read_config(const char* file_name, struct configuration *cfg) {
  *
  */
 char * get_value(const char* key, struct configuration *cfg) {
+  if (cfg->index != NULL) {
+    int entry = cfg->index[find_index_slot(key, cfg)];
+    return entry == 0 ? NULL : strdup(cfg->confdetails[entry - 1]->value);
+  }
   int count;
   for (count = 0; count < cfg->size; count++) {
     if (strcmp(cfg->confdetails[count]->key, key) == 0) {
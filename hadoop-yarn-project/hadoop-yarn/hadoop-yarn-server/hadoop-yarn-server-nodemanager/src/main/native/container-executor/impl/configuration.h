@@ -46,6 +46,12 @@ struct confentry {
 struct configuration {
   int size;
   struct confentry **confdetails;
+  // the number of entries confdetails has room for
+  int capacity;
+  // an open addressed hash table of the indexes of the entries plus one,
+  // with 0 for an empty slot, built by read_config
+  int *index;
+  int index_size;
 };
 
 // read the given configuration file into the specified config struct.
@@ -36,12 +36,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/mount.h>
 #include <sys/wait.h>
+#ifdef __linux
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/gen_stats.h>
+#include <linux/netlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+#endif
 
 static const int DEFAULT_MIN_USERID = 1000;
 
+static const int DEFAULT_DELETE_THREADS = 1;
+static const int MAX_DELETE_THREADS = 64;
+
+//the most threads that set up the directories of a user or an app at once
+static const int MAX_DIR_THREADS = 64;
+
 static const char* DEFAULT_BANNED_USERS[] = {"yarn", "mapred", "hdfs", "bin", 0};
 
 //location of traffic control binary
@@ -50,6 +65,12 @@ static const char* TC_MODIFY_STATE_OPTS [] = { "-b" , NULL};
 static const char* TC_READ_STATE_OPTS [] = { "-b", NULL};
 static const char* TC_READ_STATS_OPTS [] = { "-s",  "-b", NULL};
 
+//the cgroup v2 controllers that mount_cgroup enables for the hierarchy
+static const char* CGROUP2_CONTROLLERS[] = { "cpu", "memory", "io", NULL };
+//the controller files that a container's cgroup v2 limits may be written to
+static const char* CGROUP2_LIMIT_FILES[] = { "cpu.weight", "cpu.max",
+  "memory.max", "memory.high", "io.max", "io.weight", NULL };
+
 //struct to store the user details
 struct passwd *user_detail = NULL;
 
@@ -799,40 +820,141 @@ static int change_owner(const char* path, uid_t user, gid_t group) {
 }
 
 /**
- * Create a top level directory for the user.
- * It assumes that the parent directory is *not* writable by the user.
- * It creates directories with 02750 permissions owned by the user
- * and with the group set to the node manager group.
- * return non-0 on failure
+ * The directories being set up in parallel, one per disk.  The threads take
+ * the directories in turn, so a slow disk only holds up its own thread.
  */
-int create_directory_for_user(const char* path) {
+struct parallel_dirs {
+  pthread_mutex_t lock;
+  char* const* paths;
+  int *results;
+  int count;
+  int current;
+  int (*setup)(const char *path, void *arg);
+  void *arg;
+};
+
+static void *parallel_dirs_thread(void *arg) {
+  struct parallel_dirs *pd = (struct parallel_dirs *) arg;
+
+  pthread_mutex_lock(&pd->lock);
+  while (pd->current < pd->count) {
+    int i = pd->current++;
+    pthread_mutex_unlock(&pd->lock);
+    pd->results[i] = pd->setup(pd->paths[i], pd->arg);
+    pthread_mutex_lock(&pd->lock);
+  }
+  pthread_mutex_unlock(&pd->lock);
+  return NULL;
+}
+
+/**
+ * Run setup on each of the paths with a thread per path, up to
+ * MAX_DIR_THREADS, and store what each returned in results.  setup must not
+ * change the effective user, which is shared by all the threads.
+ */
+static void setup_dirs_in_parallel(char* const* paths, int count,
+                                   int (*setup)(const char *, void *),
+                                   void *arg, int *results) {
+  struct parallel_dirs pd;
+  pd.paths = paths;
+  pd.results = results;
+  pd.count = count;
+  pd.current = 0;
+  pd.setup = setup;
+  pd.arg = arg;
+  int threads = count < MAX_DIR_THREADS ? count : MAX_DIR_THREADS;
+  pthread_t *ids = NULL;
+  int started = 0;
+  if (pthread_mutex_init(&pd.lock, NULL) != 0) {
+    // do them all in this thread
+    int i;
+    for (i = 0; i < count; ++i) {
+      results[i] = setup(paths[i], arg);
+    }
+    return;
+  }
+  if (threads > 1) {
+    ids = malloc(sizeof(pthread_t) * (threads - 1));
+  }
+  // This thread is one of the pool
+  while (ids != NULL && started < threads - 1 &&
+         pthread_create(&ids[started], NULL, parallel_dirs_thread, &pd) == 0) {
+    started++;
+  }
+  parallel_dirs_thread(&pd);
+  int i;
+  for (i = 0; i < started; ++i) {
+    pthread_join(ids[i], NULL);
+  }
+  free(ids);
+  pthread_mutex_destroy(&pd.lock);
+}
+
+/**
+ * Create a top level directory owned by the user given in arg, with the
+ * effective user already changed as create_directories_for_user does.
+ */
+static int make_directory_for_user(const char *path, void *arg) {
+  uid_t user = *(uid_t *) arg;
   // set 2750 permissions and group sticky bit
   mode_t permissions = S_IRWXU | S_IRGRP | S_IXGRP | S_ISGID;
+  if (0 != mkdir(path, permissions) && EEXIST != errno) {
+    fprintf(LOGFILE, "Failed to create directory %s - %s\n", path,
+            strerror(errno));
+    return -1;
+  }
+  // need to reassert the group sticky bit
+  if (chmod(path, permissions) != 0) {
+    fprintf(LOGFILE, "Can't chmod %s to add the sticky bit - %s\n",
+            path, strerror(errno));
+    return -1;
+  }
+  if ((geteuid() != user || getegid() != nm_gid) &&
+      chown(path, user, nm_gid) != 0) {
+    fprintf(LOGFILE, "Failed to chown %s to %d:%d: %s\n", path, user, nm_gid,
+            strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Create top level directories for the user, as create_directory_for_user
+ * does, setting them up on all the disks at once.  results, if not NULL,
+ * gets 0 for each directory that was created and -1 for each that was not.
+ * return non-0 if any of them could not be created
+ */
+static int create_directories_for_user(char* const* paths, int count,
+                                       int *results) {
   uid_t user = geteuid();
   gid_t group = getegid();
   uid_t root = 0;
   int ret = 0;
+  int i;
+
+  int *dir_results = results;
+  if (dir_results == NULL) {
+    dir_results = malloc(sizeof(int) * count);
+    if (dir_results == NULL) {
+      fprintf(LOGFILE, "Failed to allocate memory for directory results\n");
+      return -1;
+    }
+  }
+  for (i = 0; i < count; ++i) {
+    dir_results[i] = -1;
+  }
 
   if(getuid() == root) {
     ret = change_effective_user(root, nm_gid);
   }
 
   if (ret == 0) {
-    if (0 == mkdir(path, permissions) || EEXIST == errno) {
-      // need to reassert the group sticky bit
-      if (chmod(path, permissions) != 0) {
-        fprintf(LOGFILE, "Can't chmod %s to add the sticky bit - %s\n",
-                path, strerror(errno));
-        ret = -1;
-      } else if (change_owner(path, user, nm_gid) != 0) {
-        fprintf(LOGFILE, "Failed to chown %s to %d:%d: %s\n", path, user, nm_gid,
-            strerror(errno));
+    setup_dirs_in_parallel(paths, count, make_directory_for_user, &user,
+                           dir_results);
+    for (i = 0; i < count; ++i) {
+      if (dir_results[i] != 0) {
         ret = -1;
       }
-    } else {
-      fprintf(LOGFILE, "Failed to create directory %s - %s\n", path,
-              strerror(errno));
-      ret = -1;
     }
   }
   if (change_effective_user(user, group) != 0) {
@@ -840,9 +962,24 @@ int create_directory_for_user(const char* path) {
  
     ret = -1;
   }
+  if (dir_results != results) {
+    free(dir_results);
+  }
   return ret;
 }
 
+/**
+ * Create a top level directory for the user.
+ * It assumes that the parent directory is *not* writable by the user.
+ * It creates directories with 02750 permissions owned by the user
+ * and with the group set to the node manager group.
+ * return non-0 on failure
+ */
+int create_directory_for_user(const char* path) {
+  char *paths[] = { (char *) path };
+  return create_directories_for_user(paths, 1, NULL);
+}
+
 /**
  * Open a file as the node manager and return a file descriptor for it.
  * Returns -1 on error
@@ -918,48 +1055,78 @@ static int copy_file(int input, const char* in_filename,
  */
 int initialize_user(const char *user, char* const* local_dirs) {
 
-  char *user_dir;
-  char* const* local_dir_ptr;
+  int count = 0;
+  while (local_dirs[count] != NULL) {
+    count++;
+  }
+  char **user_dirs = calloc(count + 1, sizeof(char *));
+  if (user_dirs == NULL) {
+    fprintf(LOGFILE, "Failed to allocate memory for user directories\n");
+    return INITIALIZE_USER_FAILED;
+  }
   int failed = 0;
-  for(local_dir_ptr = local_dirs; *local_dir_ptr != 0; ++local_dir_ptr) {
-    user_dir = get_user_directory(*local_dir_ptr, user);
-    if (user_dir == NULL) {
+  int i;
+  for (i = 0; i < count; ++i) {
+    user_dirs[i] = get_user_directory(local_dirs[i], user);
+    if (user_dirs[i] == NULL) {
       fprintf(LOGFILE, "Couldn't get userdir directory for %s.\n", user);
       failed = 1;
       break;
     }
-    if (create_directory_for_user(user_dir) != 0) {
-      failed = 1;
-    }
-    free(user_dir);
   }
+  if (!failed && create_directories_for_user(user_dirs, count, NULL) != 0) {
+    failed = 1;
+  }
+  for (i = 0; i < count; ++i) {
+    free(user_dirs[i]);
+  }
+  free(user_dirs);
   return failed ? INITIALIZE_USER_FAILED : 0;
 }
 
 int create_log_dirs(const char *app_id, char * const * log_dirs) {
 
-  char* const* log_root;
-  char *any_one_app_log_dir = NULL;
-  for(log_root=log_dirs; *log_root != NULL; ++log_root) {
-    char *app_log_dir = get_app_log_directory(*log_root, app_id);
-    if (app_log_dir == NULL) {
-      // try the next one
-    } else if (create_directory_for_user(app_log_dir) != 0) {
-      free(app_log_dir);
-      return -1;
-    } else if (any_one_app_log_dir == NULL) {
-      any_one_app_log_dir = app_log_dir;
-    } else {
-      free(app_log_dir);
+  int count = 0;
+  while (log_dirs[count] != NULL) {
+    count++;
+  }
+  char **app_log_dirs = calloc(count + 1, sizeof(char *));
+  if (app_log_dirs == NULL) {
+    fprintf(LOGFILE, "Failed to allocate memory for app-log directories\n");
+    return -1;
+  }
+  int found = 0;
+  int i;
+  for (i = 0; i < count; ++i) {
+    char *app_log_dir = get_app_log_directory(log_dirs[i], app_id);
+    // if there is none, try the next one
+    if (app_log_dir != NULL) {
+      app_log_dirs[found++] = app_log_dir;
     }
   }
 
-  if (any_one_app_log_dir == NULL) {
+  int ret = 0;
+  if (found == 0) {
     fprintf(LOGFILE, "Did not create any app-log directories\n");
+    ret = -1;
+  } else if (create_directories_for_user(app_log_dirs, found, NULL) != 0) {
+    ret = -1;
+  }
+  for (i = 0; i < found; ++i) {
+    free(app_log_dirs[i]);
+  }
+  free(app_log_dirs);
+  return ret;
+}
+
+/**
+ * Create an app directory with the permissions given in arg.
+ */
+static int make_app_directory(const char *path, void *arg) {
+  if (path == NULL) {
     return -1;
   }
-  free(any_one_app_log_dir);
-  return 0;
+  return mkdirs(path, *(mode_t *) arg);
 }
 
 
@@ -1000,20 +1167,36 @@ int initialize_app(const char *user, const char *app_id,
 
   // 750
   mode_t permissions = S_IRWXU | S_IRGRP | S_IXGRP;
-  char* const* nm_root;
+  int count = 0;
+  while (local_dirs[count] != NULL) {
+    count++;
+  }
+  char **app_dirs = calloc(count, sizeof(char *));
+  int *results = calloc(count, sizeof(int));
+  if (app_dirs == NULL || results == NULL) {
+    fprintf(LOGFILE, "Failed to allocate memory for app directories\n");
+    free(app_dirs);
+    free(results);
+    return -1;
+  }
+  int i;
+  for (i = 0; i < count; ++i) {
+    // a missing one is skipped and the next one tried
+    app_dirs[i] = get_app_directory(local_dirs[i], user, app_id);
+  }
+  setup_dirs_in_parallel(app_dirs, count, make_app_directory, &permissions,
+                         results);
+  // the first disk that worked gets the credentials, as it would serially
   char *primary_app_dir = NULL;
-  for(nm_root=local_dirs; *nm_root != NULL; ++nm_root) {
-    char *app_dir = get_app_directory(*nm_root, user, app_id);
-    if (app_dir == NULL) {
-      // try the next one
-    } else if (mkdirs(app_dir, permissions) != 0) {
-      free(app_dir);
-    } else if (primary_app_dir == NULL) {
-      primary_app_dir = app_dir;
+  for (i = 0; i < count; ++i) {
+    if (primary_app_dir == NULL && app_dirs[i] != NULL && results[i] == 0) {
+      primary_app_dir = app_dirs[i];
     } else {
-      free(app_dir);
+      free(app_dirs[i]);
     }
   }
+  free(app_dirs);
+  free(results);
 
   if (primary_app_dir == NULL) {
     fprintf(LOGFILE, "Did not create any app directories\n");
@@ -1219,6 +1402,71 @@ int create_local_dirs(const char * user, const char *app_id,
   return exit_code;
 }
 
+/**
+ * Run docker with the given arguments, the first of which is the docker
+ * binary, without a shell, and wait for it.
+ * output: where to put what docker writes to stdout, which is truncated
+ *         to output_size - 1 bytes and NUL terminated, or NULL to discard it
+ * Returns the exit code of docker, or -1 if it could not be run
+ */
+static int run_docker_command(char **args, char *output, size_t output_size) {
+  int out_pipe[2];
+  if (pipe(out_pipe) != 0) {
+    fprintf(ERRORFILE, "Could not create a pipe for %s - %s\n", args[0],
+            strerror(errno));
+    fflush(ERRORFILE);
+    return -1;
+  }
+  fflush(LOGFILE);
+  fflush(ERRORFILE);
+  pid_t child_pid = fork();
+  if (child_pid == -1) {
+    fprintf(ERRORFILE, "Could not fork for %s - %s\n", args[0],
+            strerror(errno));
+    fflush(ERRORFILE);
+    close(out_pipe[0]);
+    close(out_pipe[1]);
+    return -1;
+  }
+  if (child_pid == 0) {
+    close(out_pipe[0]);
+    if (dup2(out_pipe[1], STDOUT_FILENO) == -1) {
+      _exit(127);
+    }
+    close(out_pipe[1]);
+    execvp(args[0], args);
+    fprintf(ERRORFILE, "Couldn't execute %s - %s\n", args[0], strerror(errno));
+    fflush(ERRORFILE);
+    _exit(127);
+  }
+  close(out_pipe[1]);
+  size_t length = 0;
+  char discard[4096];
+  while (1) {
+    char *buf = discard;
+    size_t size = sizeof(discard);
+    if (output != NULL && length + 1 < output_size) {
+      buf = output + length;
+      size = output_size - 1 - length;
+    }
+    ssize_t n = read(out_pipe[0], buf, size);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    if (buf != discard) {
+      length += n;
+    }
+  }
+  close(out_pipe[0]);
+  if (output != NULL && output_size > 0) {
+    output[length] = '\0';
+  }
+  return wait_and_get_exit_code(child_pid);
+}
+
 int launch_docker_container_as_user(const char * user, const char *app_id,
                               const char *container_id, const char *work_dir,
                               const char *script_name, const char *cred_file,
@@ -1230,15 +1478,13 @@ int launch_docker_container_as_user(const char * user, const char *app_id,
   char *script_file_dest = NULL;
   char *cred_file_dest = NULL;
   char *exit_code_file = NULL;
-  char docker_command_with_binary[EXECUTOR_PATH_MAX];
-  char docker_wait_command[EXECUTOR_PATH_MAX];
-  char docker_logs_command[EXECUTOR_PATH_MAX];
-  char docker_inspect_command[EXECUTOR_PATH_MAX];
-  char docker_rm_command[EXECUTOR_PATH_MAX];
+  char *docker_command_with_binary = NULL;
+  char **docker_run_args = NULL;
   int container_file_source =-1;
   int cred_file_source = -1;
   int BUFFER_SIZE = 4096;
   char buffer[BUFFER_SIZE];
+  char output[64];
 
   char *docker_command = parse_docker_command_file(command_file);
   char *docker_binary = get_value(DOCKER_BINARY_KEY, &executor_cfg);
@@ -1284,31 +1530,35 @@ int launch_docker_container_as_user(const char * user, const char *app_id,
     goto cleanup;
   }
 
-  snprintf(docker_command_with_binary, EXECUTOR_PATH_MAX, "%s %s", docker_binary, docker_command);
+  // The docker commands are run directly rather than through a shell.  The
+  // run command is split on spaces, as the node manager joins it with them.
+  if (asprintf(&docker_command_with_binary, "%s %s", docker_binary,
+               docker_command) < 0) {
+    exit_code = OUT_OF_MEMORY;
+    goto cleanup;
+  }
+  docker_run_args = extract_values_delim(docker_command_with_binary, " \n");
 
   fprintf(LOGFILE, "Launching docker container...\n");
-  FILE* start_docker = popen(docker_command_with_binary, "r");
-  if (pclose (start_docker) != 0)
-  {
+  if (docker_run_args == NULL ||
+      run_docker_command(docker_run_args, NULL, 0) != 0) {
     fprintf (ERRORFILE,
-     "Could not invoke docker %s.\n", docker_command_with_binary);
+     "Could not invoke docker %s %s.\n", docker_binary, docker_command);
     fflush(ERRORFILE);
     exit_code = UNABLE_TO_EXECUTE_CONTAINER_SCRIPT;
     goto cleanup;
   }
 
-  snprintf(docker_inspect_command, EXECUTOR_PATH_MAX,
-    "%s inspect --format {{.State.Pid}} %s",
-    docker_binary, container_id);
-
+  char *docker_inspect_args[] = { docker_binary, "inspect", "--format",
+                                  "{{.State.Pid}}", (char *) container_id,
+                                  NULL };
   fprintf(LOGFILE, "Inspecting docker container...\n");
-  FILE* inspect_docker = popen(docker_inspect_command, "r");
   int pid = 0;
-  int res = fscanf (inspect_docker, "%d", &pid);
-  if (pclose (inspect_docker) != 0 || res <= 0)
+  if (run_docker_command(docker_inspect_args, output, sizeof(output)) != 0 ||
+      sscanf(output, "%d", &pid) <= 0)
   {
     fprintf (ERRORFILE,
-     "Could not inspect docker to get pid %s.\n", docker_inspect_command);
+     "Could not inspect docker to get pid of %s.\n", container_id);
     fflush(ERRORFILE);
     exit_code = UNABLE_TO_EXECUTE_CONTAINER_SCRIPT;
     goto cleanup;
@@ -1328,6 +1578,15 @@ int launch_docker_container_as_user(const char * user, const char *app_id,
          goto cleanup;
        }
      }
+    } else if (resources_key != NULL &&
+               ! strcmp(resources_key, CGROUP2_RESOURCES_KEY)) {
+      // the cgroup v2 of the container, then its limits
+      if (resources_values == NULL || resources_values[0] == NULL ||
+          write_pid_to_cgroup2_as_root(resources_values[0],
+                                       resources_values + 1, pid) != 0) {
+        exit_code = WRITE_CGROUP_FAILED;
+        goto cleanup;
+      }
     }
 
     // write pid to pidfile
@@ -1340,57 +1599,36 @@ int launch_docker_container_as_user(const char * user, const char *app_id,
       goto cleanup;
     }
 
-    snprintf(docker_wait_command, EXECUTOR_PATH_MAX,
-      "%s wait %s", docker_binary, container_id);
-
+    char *docker_wait_args[] = { docker_binary, "wait", (char *) container_id,
+                                 NULL };
     fprintf(LOGFILE, "Waiting for docker container to finish...\n");
-    FILE* wait_docker = popen(docker_wait_command, "r");
-    res = fscanf (wait_docker, "%d", &exit_code);
-    if (pclose (wait_docker) != 0 || res <= 0) {
+    if (run_docker_command(docker_wait_args, output, sizeof(output)) != 0 ||
+        sscanf(output, "%d", &exit_code) <= 0) {
       fprintf (ERRORFILE,
-       "Could not attach to docker; is container dead? %s.\n", docker_wait_command);
+       "Could not attach to docker; is container dead? %s.\n", container_id);
       fflush(ERRORFILE);
     }
     if(exit_code != 0) {
       fprintf(ERRORFILE, "Docker container exit code was not zero: %d\n",
       exit_code);
-      snprintf(docker_logs_command, EXECUTOR_PATH_MAX, "%s logs --tail=250 %s",
-        docker_binary, container_id);
-      FILE* logs = popen(docker_logs_command, "r");
-      if(logs != NULL) {
-        clearerr(logs);
-        res = fread(buffer, BUFFER_SIZE, 1, logs);
-        if(res < 1) {
-          fprintf(ERRORFILE, "%s %d %d\n",
-            "Unable to read from docker logs(ferror, feof):", ferror(logs), feof(logs));
-          fflush(ERRORFILE);
-        }
-        else {
-          fprintf(ERRORFILE, "%s\n", buffer);
-          fflush(ERRORFILE);
-        }
-      }
-      else {
-        fprintf(ERRORFILE, "%s\n", "Failed to get output of docker logs");
-        fprintf(ERRORFILE, "Command was '%s'\n", docker_logs_command);
-        fprintf(ERRORFILE, "%s\n", strerror(errno));
-        fflush(ERRORFILE);
-      }
-      if(pclose(logs) != 0) {
+      char *docker_logs_args[] = { docker_binary, "logs", "--tail=250",
+                                   (char *) container_id, NULL };
+      if (run_docker_command(docker_logs_args, buffer, BUFFER_SIZE) != 0) {
         fprintf(ERRORFILE, "%s\n", "Failed to fetch docker logs");
-        fflush(ERRORFILE);
+      } else {
+        fprintf(ERRORFILE, "%s\n", buffer);
       }
+      fflush(ERRORFILE);
     }
   }
 
   fprintf(LOGFILE, "Removing docker container post-exit...\n");
-  snprintf(docker_rm_command, EXECUTOR_PATH_MAX,
-    "%s rm %s", docker_binary, container_id);
-  FILE* rm_docker = popen(docker_rm_command, "w");
-  if (pclose (rm_docker) != 0)
+  char *docker_rm_args[] = { docker_binary, "rm", (char *) container_id,
+                             NULL };
+  if (run_docker_command(docker_rm_args, NULL, 0) != 0)
   {
     fprintf (ERRORFILE,
-     "Could not remove container %s.\n", docker_rm_command);
+     "Could not remove container %s.\n", container_id);
     fflush(ERRORFILE);
     exit_code = UNABLE_TO_EXECUTE_CONTAINER_SCRIPT;
     goto cleanup;
@@ -1415,6 +1653,8 @@ cleanup:
   fclose(stdout);
   fclose(stderr);
 #endif
+  free(docker_run_args);
+  free(docker_command_with_binary);
   free(exit_code_file);
   free(script_file_dest);
   free(cred_file_dest);
@@ -1488,6 +1728,15 @@ int launch_container_as_user(const char *user, const char *app_id,
         goto cleanup;
       }
     }
+  } else if (resources_key != NULL &&
+             ! strcmp(resources_key, CGROUP2_RESOURCES_KEY)) {
+    // the cgroup v2 of the container, then its limits
+    if (resources_values == NULL || resources_values[0] == NULL ||
+        write_pid_to_cgroup2_as_root(resources_values[0],
+                                     resources_values + 1, pid) != 0) {
+      exit_code = WRITE_CGROUP_FAILED;
+      goto cleanup;
+    }
   }
 
   fprintf(LOGFILE, "Creating local dirs...\n");
@@ -1763,11 +2012,12 @@ static int recursive_unlink_helper(int dirfd, const char *name,
   }
   ret = 0;
 done:
-  if (fd >= 0) {
-    close(fd);
-  }
+  // closedir closes the fd too, which must not be closed twice when other
+  // threads may have reused the number
   if (dfd) {
     closedir(dfd);
+  } else if (fd >= 0) {
+    close(fd);
   }
   return ret;
 }
@@ -1821,6 +2071,140 @@ static int delete_path(const char *full_path,
   return 0;
 }
 
+/**
+ * The directories being deleted in parallel.  The delete threads take
+ * their entries in turn, so each directory and each of its subtrees is
+ * deleted by whichever thread is free.
+ */
+struct parallel_delete {
+  pthread_mutex_t lock;
+  DIR **dirs;
+  char **paths;
+  int count;
+  int current;
+};
+
+static void *parallel_delete_thread(void *arg) {
+  struct parallel_delete *pd = (struct parallel_delete *) arg;
+
+  pthread_mutex_lock(&pd->lock);
+  while (pd->current < pd->count) {
+    struct dirent *de = readdir(pd->dirs[pd->current]);
+    if (de == NULL) {
+      // Either it is done or readdir failed, which the serial pass reports
+      pd->current++;
+      continue;
+    }
+    if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+      continue;
+    }
+    int fd = dirfd(pd->dirs[pd->current]);
+    char *name = strdup(de->d_name);
+    char *fullpath = NULL;
+    if (name == NULL || asprintf(&fullpath, "%s/%s",
+                                 pd->paths[pd->current], name) < 0) {
+      fullpath = NULL;
+    }
+    pthread_mutex_unlock(&pd->lock);
+    // Failures are left for the serial pass to retry and report
+    if (fullpath != NULL) {
+      recursive_unlink_helper(fd, name, fullpath);
+    }
+    free(fullpath);
+    free(name);
+    pthread_mutex_lock(&pd->lock);
+  }
+  pthread_mutex_unlock(&pd->lock);
+  return NULL;
+}
+
+/**
+ * Get the number of threads to delete with from the configuration.
+ */
+static int get_delete_threads() {
+  int threads = DEFAULT_DELETE_THREADS;
+  char *threads_str = get_value(DELETE_THREADS_KEY, &executor_cfg);
+  if (threads_str != NULL) {
+    char *end_ptr = NULL;
+    threads = strtol(threads_str, &end_ptr, 10);
+    if (threads_str == end_ptr || *end_ptr != '\0' || threads < 1) {
+      fprintf(LOGFILE, "Illegal value of %s for %s in configuration\n",
+              threads_str, DELETE_THREADS_KEY);
+      threads = DEFAULT_DELETE_THREADS;
+    } else if (threads > MAX_DELETE_THREADS) {
+      threads = MAX_DELETE_THREADS;
+    }
+    free(threads_str);
+  }
+  return threads;
+}
+
+/**
+ * Delete the contents of the given directories with a pool of threads.
+ * This only does the bulk of the work: whatever it could not delete,
+ * including anything it could not open, is left to delete_path, which
+ * deletes the rest serially and reports any error.
+ * paths: the directories, which may be NULL
+ * count: the number of paths
+ */
+static void parallel_delete_children(char **paths, int count) {
+  int threads = get_delete_threads();
+  if (threads <= 1) {
+    return;
+  }
+  struct parallel_delete pd;
+  pd.dirs = malloc(sizeof(DIR *) * count);
+  pd.paths = malloc(sizeof(char *) * count);
+  pd.count = 0;
+  pd.current = 0;
+  if (pd.dirs == NULL || pd.paths == NULL) {
+    free(pd.dirs);
+    free(pd.paths);
+    return;
+  }
+  int i;
+  for (i = 0; i < count; ++i) {
+    if (paths[i] == NULL) {
+      continue;
+    }
+    // O_NOFOLLOW, as in recursive_unlink_helper, so that a symlink swapped
+    // in for the directory is not followed
+    int fd = open(paths[i], O_RDONLY | O_NOFOLLOW | O_DIRECTORY);
+    if (fd < 0) {
+      continue;
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+      close(fd);
+      continue;
+    }
+    pd.dirs[pd.count] = dir;
+    pd.paths[pd.count] = paths[i];
+    pd.count++;
+  }
+  if (pd.count > 0 && pthread_mutex_init(&pd.lock, NULL) == 0) {
+    pthread_t *ids = malloc(sizeof(pthread_t) * (threads - 1));
+    int started = 0;
+    // This thread is one of the pool
+    while (ids != NULL && started < threads - 1 &&
+           pthread_create(&ids[started], NULL, parallel_delete_thread,
+                          &pd) == 0) {
+      started++;
+    }
+    parallel_delete_thread(&pd);
+    for (i = 0; i < started; ++i) {
+      pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    pthread_mutex_destroy(&pd.lock);
+  }
+  for (i = 0; i < pd.count; ++i) {
+    closedir(pd.dirs[i]);
+  }
+  free(pd.dirs);
+  free(pd.paths);
+}
+
 /**
  * Delete the given directory as the user from each of the directories
  * user: the user doing the delete
@@ -1835,45 +2219,78 @@ int delete_as_user(const char *user,
   int subDirEmptyStr = (subdir == NULL || subdir[0] == 0);
   int needs_tt_user = subDirEmptyStr;
   char** ptr;
+  int count = 0;
+  int i;
 
   // TODO: No switching user? !!!!
   if (baseDirs == NULL || *baseDirs == NULL) {
+    if (subdir != NULL) {
+      char *path = (char *) subdir;
+      parallel_delete_children(&path, 1);
+    }
     return delete_path(subdir, needs_tt_user);
   }
-  // do the delete
   for(ptr = (char**)baseDirs; *ptr != NULL; ++ptr) {
-    char* full_path = NULL;
+    count++;
+  }
+  char **full_paths = calloc(count, sizeof(char *));
+  int *needs_tt_users = calloc(count, sizeof(int));
+  if (full_paths == NULL || needs_tt_users == NULL) {
+    fprintf(LOGFILE, "Failed to allocate the paths to delete\n");
+    free(full_paths);
+    free(needs_tt_users);
+    return -1;
+  }
+  // work out what to delete in each of the directories
+  for(i = 0; i < count; ++i) {
     struct stat sb;
-    if (stat(*ptr, &sb) != 0) {
+    if (stat(baseDirs[i], &sb) != 0) {
       if (errno == ENOENT) {
         // Ignore missing dir. Continue deleting other directories.
         continue;
       } else {
-        fprintf(LOGFILE, "Could not stat %s - %s\n", *ptr, strerror(errno));
-        return -1;
+        fprintf(LOGFILE, "Could not stat %s - %s\n", baseDirs[i],
+                strerror(errno));
+        ret = -1;
+        break;
       }
     }
     if (!S_ISDIR(sb.st_mode)) {
       if (!subDirEmptyStr) {
-        fprintf(LOGFILE, "baseDir \"%s\" is a file and cannot contain subdir \"%s\".\n", *ptr, subdir);
-        return -1;
+        fprintf(LOGFILE, "baseDir \"%s\" is a file and cannot contain subdir \"%s\".\n", baseDirs[i], subdir);
+        ret = -1;
+        break;
       }
-      full_path = strdup(*ptr);
-      needs_tt_user = 0;
+      full_paths[i] = strdup(baseDirs[i]);
+      needs_tt_users[i] = 0;
     } else {
-      full_path = concatenate("%s/%s", "user subdir", 2, *ptr, subdir);
+      full_paths[i] = concatenate("%s/%s", "user subdir", 2, baseDirs[i],
+                                  subdir);
+      needs_tt_users[i] = needs_tt_user;
     }
 
-    if (full_path == NULL) {
-      return -1;
+    if (full_paths[i] == NULL) {
+      ret = -1;
+      break;
+    }
+  }
+  // do the delete of everything before any error, as much as can be done
+  // at once, and then the rest
+  count = i;
+  parallel_delete_children(full_paths, count);
+  for(i = 0; i < count; ++i) {
+    if (full_paths[i] == NULL) {
+      continue;
     }
-    int this_ret = delete_path(full_path, needs_tt_user);
-    free(full_path);
+    int this_ret = delete_path(full_paths[i], needs_tt_users[i]);
+    free(full_paths[i]);
     // delete as much as we can, but remember the error
     if (this_ret != 0) {
       ret = this_ret;
     }
   }
+  free(full_paths);
+  free(needs_tt_users);
   return ret;
 }
 
@@ -1902,6 +2319,381 @@ void chown_dir_contents(const char *dir_path, uid_t uid, gid_t gid) {
   free(path_tmp);
 }
 
+/**
+ * Write a value to a cgroup interface file.
+ * Returns 0 on success
+ */
+static int write_cgroup_file(const char *dir, const char *name,
+                             const char *value) {
+  char path[EXECUTOR_PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= sizeof(path)) {
+    fprintf(LOGFILE, "cgroup path %s/%s is too long\n", dir, name);
+    return -1;
+  }
+  int fd = open(path, O_WRONLY | O_NOFOLLOW);
+  if (fd == -1) {
+    fprintf(LOGFILE, "Can't open file %s - %s\n", path, strerror(errno));
+    return -1;
+  }
+  ssize_t written = write(fd, value, strlen(value));
+  int err = errno;
+  close(fd);
+  if (written == -1) {
+    fprintf(LOGFILE, "Failed to write %s to %s - %s\n", value, path,
+            strerror(err));
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Write a value to an interface file of an open cgroup directory.
+ * Returns 0 on success
+ */
+static int write_cgroup_file_at(int dir_fd, const char *dir, const char *name,
+                                const char *value) {
+  int fd = openat(dir_fd, name, O_WRONLY | O_NOFOLLOW);
+  if (fd == -1) {
+    fprintf(LOGFILE, "Can't open file %s/%s - %s\n", dir, name,
+            strerror(errno));
+    return -1;
+  }
+  ssize_t written = write(fd, value, strlen(value));
+  int err = errno;
+  close(fd);
+  if (written == -1) {
+    fprintf(LOGFILE, "Failed to write %s to %s/%s - %s\n", value, dir, name,
+            strerror(err));
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Open a cgroup v2 the node manager names, creating it if asked to.  It
+ * must be a direct child of the hierarchy set as cgroup2.hierarchy in the
+ * configuration, named without symbolic links, "." or "..", and must not
+ * be a symbolic link itself, so that root only ever works on the node
+ * manager's own cgroups.
+ * Returns a descriptor of the directory, or -1 which is logged to log
+ */
+static int open_cgroup2_dir(const char *cgroup_dir, int create, FILE *log) {
+  int dir_fd = -1;
+  int hier_fd = -1;
+  char *parent = NULL;
+  char *parent_real = NULL;
+  char *hier_real = NULL;
+  char *hierarchy = get_value(CGROUP2_HIERARCHY_KEY, &executor_cfg);
+  if (hierarchy == NULL) {
+    fprintf(log, "%s is not set in the configuration\n",
+            CGROUP2_HIERARCHY_KEY);
+    goto cleanup;
+  }
+  hier_real = realpath(hierarchy, NULL);
+  if (hier_real == NULL) {
+    fprintf(log, "Can't resolve cgroup hierarchy %s - %s\n", hierarchy,
+            strerror(errno));
+    goto cleanup;
+  }
+  const char *name = strrchr(cgroup_dir, '/');
+  if (name == NULL || name == cgroup_dir || strcmp(name + 1, "") == 0 ||
+      strcmp(name + 1, ".") == 0 || strcmp(name + 1, "..") == 0) {
+    fprintf(log, "Invalid cgroup %s\n", cgroup_dir);
+    goto cleanup;
+  }
+  parent = strndup(cgroup_dir, name - cgroup_dir);
+  ++name;
+  if (parent == NULL) {
+    fprintf(log, "Failed to allocate memory in open_cgroup2_dir\n");
+    goto cleanup;
+  }
+  // a parent named any other way than by its resolved path went through a
+  // link, "." or ".."
+  parent_real = realpath(parent, NULL);
+  if (parent_real == NULL || strcmp(parent_real, parent) != 0 ||
+      strcmp(parent_real, hier_real) != 0) {
+    fprintf(log, "cgroup %s is not in the cgroup hierarchy %s\n",
+            cgroup_dir, hier_real);
+    goto cleanup;
+  }
+  hier_fd = open(hier_real, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+  if (hier_fd == -1) {
+    fprintf(log, "Can't open cgroup hierarchy %s - %s\n", hier_real,
+            strerror(errno));
+    goto cleanup;
+  }
+  if (create && mkdirat(hier_fd, name, S_IRWXU | S_IRGRP | S_IXGRP) != 0 &&
+      errno != EEXIST) {
+    fprintf(log, "Failed to create cgroup %s - %s\n", cgroup_dir,
+            strerror(errno));
+    goto cleanup;
+  }
+  dir_fd = openat(hier_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+  if (dir_fd == -1) {
+    fprintf(log, "Can't open cgroup %s - %s\n", cgroup_dir,
+            strerror(errno));
+  }
+
+cleanup:
+  if (hier_fd != -1) {
+    close(hier_fd);
+  }
+  free(parent);
+  free(parent_real);
+  free(hier_real);
+  free(hierarchy);
+  return dir_fd;
+}
+
+/**
+ * Enable the controllers for the children of a cgroup v2.  A controller
+ * the kernel does not have is logged and skipped.
+ */
+static void enable_cgroup2_controllers(const char *dir) {
+  const char **controller;
+  for (controller = CGROUP2_CONTROLLERS; *controller != NULL; ++controller) {
+    char value[32];
+    snprintf(value, sizeof(value), "+%s", *controller);
+    write_cgroup_file(dir, "cgroup.subtree_control", value);
+  }
+}
+
+/**
+ * Mount the cgroup v2 hierarchy, unless it is already mounted, and create
+ * the node manager's cgroup in it with the cpu, memory and io controllers
+ * enabled for the containers.
+ */
+static int mount_cgroup2(const char *mount_path, const char *hierarchy) {
+  char hier_path[EXECUTOR_PATH_MAX];
+  if (mount("none", mount_path, CGROUP2_FS_TYPE, 0, NULL) != 0) {
+    // the unified hierarchy is usually already mounted by the system
+    if (errno != EBUSY) {
+      fprintf(LOGFILE, "Failed to mount cgroup2 at %s - %s\n", mount_path,
+              strerror(errno));
+      return -1;
+    }
+  }
+  if (snprintf(hier_path, sizeof(hier_path), "%s/%s", mount_path,
+               hierarchy) >= sizeof(hier_path)) {
+    fprintf(LOGFILE, "cgroup path %s/%s is too long\n", mount_path, hierarchy);
+    return -1;
+  }
+  // the hierarchy is handed to the node manager, so only the configured
+  // one may be
+  char *configured = get_value(CGROUP2_HIERARCHY_KEY, &executor_cfg);
+  int allowed = configured != NULL && strcmp(configured, hier_path) == 0 &&
+      strstr(hier_path, "/..") == NULL;
+  free(configured);
+  if (!allowed) {
+    fprintf(LOGFILE, "cgroup hierarchy %s is not %s in the configuration\n",
+            hier_path, CGROUP2_HIERARCHY_KEY);
+    return -1;
+  }
+  enable_cgroup2_controllers(mount_path);
+  // create hierarchy as 0750 and chown to Hadoop NM user
+  const mode_t perms = S_IRWXU | S_IRGRP | S_IXGRP;
+  if (mkdirs(hier_path, perms) != 0) {
+    return -1;
+  }
+  enable_cgroup2_controllers(hier_path);
+  change_owner(hier_path, nm_uid, nm_gid);
+  chown_dir_contents(hier_path, nm_uid, nm_gid);
+  return 0;
+}
+
+int create_cgroup2(const char *cgroup_dir, char* const* limits, pid_t pid) {
+  int ret = -1;
+  int dir_fd = open_cgroup2_dir(cgroup_dir, 1, LOGFILE);
+  if (dir_fd == -1) {
+    return -1;
+  }
+  char* const* limit;
+  for (limit = limits; limit != NULL && *limit != NULL; ++limit) {
+    const char *equals = strchr(*limit, '=');
+    const char **name;
+    for (name = CGROUP2_LIMIT_FILES; equals != NULL && *name != NULL;
+         ++name) {
+      if (strlen(*name) == (size_t) (equals - *limit) &&
+          strncmp(*name, *limit, equals - *limit) == 0) {
+        break;
+      }
+    }
+    if (equals == NULL || *name == NULL) {
+      fprintf(LOGFILE, "Invalid cgroup limit %s\n", *limit);
+      goto cleanup;
+    }
+    if (write_cgroup_file_at(dir_fd, cgroup_dir, *name, equals + 1) != 0) {
+      goto cleanup;
+    }
+  }
+  char pid_buf[21];
+  snprintf(pid_buf, sizeof(pid_buf), "%" PRId64, (int64_t)pid);
+  if (write_cgroup_file_at(dir_fd, cgroup_dir, "cgroup.procs", pid_buf) != 0) {
+    goto cleanup;
+  }
+  // let the node manager read and change the limits, and remove it
+  if (fchown(dir_fd, nm_uid, nm_gid) != 0) {
+    fprintf(LOGFILE, "Failed to chown cgroup %s to %d:%d - %s\n", cgroup_dir,
+            nm_uid, nm_gid, strerror(errno));
+    goto cleanup;
+  }
+  ret = 0;
+
+cleanup:
+  close(dir_fd);
+  return ret;
+}
+
+int write_pid_to_cgroup2_as_root(const char *cgroup_dir, char* const* limits,
+                                 pid_t pid) {
+  uid_t user = geteuid();
+  gid_t group = getegid();
+  if (change_effective_user(0, 0) != 0) {
+    return -1;
+  }
+  int ret = create_cgroup2(cgroup_dir, limits, pid);
+  // Revert back to the calling user.
+  if (change_effective_user(user, group)) {
+    return -1;
+  }
+  return ret;
+}
+
+/**
+ * Open a cgroup file for reading.
+ * Returns NULL if it does not exist, which it does not unless its
+ * controller is enabled, or if it could not be opened, which is logged
+ */
+static FILE *open_cgroup_file(int dir_fd, const char *dir, const char *name,
+                              char *path, size_t path_size) {
+  snprintf(path, path_size, "%s/%s", dir, name);
+  FILE *file = NULL;
+  int fd = openat(dir_fd, name, O_RDONLY | O_NOFOLLOW);
+  if (fd != -1) {
+    file = fdopen(fd, "r");
+    if (file == NULL) {
+      int err = errno;
+      close(fd);
+      errno = err;
+    }
+  }
+  if (file == NULL && errno != ENOENT) {
+    int err = errno;
+    fprintf(ERRORFILE, "Can't open file %s - %s\n", path, strerror(err));
+    errno = err;
+  }
+  return file;
+}
+
+/**
+ * Read the value of a key in a flat keyed cgroup file, of lines like
+ * "usage_usec 1234", or the value of a single value file if key is NULL.
+ * Returns 0 on success, 1 if the file does not exist and -1 on error
+ */
+static int read_cgroup_value(int dir_fd, const char *dir, const char *name,
+                             const char *key, int64_t *value) {
+  char path[EXECUTOR_PATH_MAX];
+  FILE *file = open_cgroup_file(dir_fd, dir, name, path, sizeof(path));
+  if (file == NULL) {
+    return errno == ENOENT ? 1 : -1;
+  }
+  int ret = -1;
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    size_t key_len = key == NULL ? 0 : strlen(key);
+    if (key == NULL || (strncmp(line, key, key_len) == 0 &&
+                        line[key_len] == ' ')) {
+      if (sscanf(line + key_len, "%" SCNd64, value) == 1) {
+        ret = 0;
+      }
+      break;
+    }
+  }
+  fclose(file);
+  if (ret != 0) {
+    fprintf(ERRORFILE, "Can't find %s in %s\n", key == NULL ? "a value" : key,
+            path);
+  }
+  return ret;
+}
+
+/**
+ * Sum the bytes read and written over the devices in io.stat, whose lines
+ * are like "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0".
+ * Returns 0 on success, 1 if the file does not exist and -1 on error
+ */
+static int read_cgroup_io(int dir_fd, const char *dir, int64_t *rbytes,
+                          int64_t *wbytes) {
+  char path[EXECUTOR_PATH_MAX];
+  FILE *file = open_cgroup_file(dir_fd, dir, "io.stat", path, sizeof(path));
+  if (file == NULL) {
+    return errno == ENOENT ? 1 : -1;
+  }
+  *rbytes = 0;
+  *wbytes = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char *field = strstr(line, " rbytes=");
+    if (field != NULL) {
+      *rbytes += strtoll(field + strlen(" rbytes="), NULL, 10);
+    }
+    field = strstr(line, " wbytes=");
+    if (field != NULL) {
+      *wbytes += strtoll(field + strlen(" wbytes="), NULL, 10);
+    }
+  }
+  fclose(file);
+  return 0;
+}
+
+int read_cgroup2_stats(char* const* cgroup_dirs) {
+  int ret = 0;
+  uid_t user = geteuid();
+  gid_t group = getegid();
+  // read them as the node manager, which is who asks for them
+  if (change_effective_user(nm_uid, nm_gid) != 0) {
+    return ERROR_READING_CGROUP_STATS;
+  }
+  char* const* dir;
+  for (dir = cgroup_dirs; dir != NULL && *dir != NULL; ++dir) {
+    int64_t cpu_usec = 0, memory = 0, rbytes = 0, wbytes = 0;
+    int dir_fd = open_cgroup2_dir(*dir, 0, ERRORFILE);
+    if (dir_fd == -1) {
+      ret = ERROR_READING_CGROUP_STATS;
+      continue;
+    }
+    // cpu.stat is always there, the others only with their controllers
+    int cpu_ret = read_cgroup_value(dir_fd, *dir, "cpu.stat", "usage_usec",
+                                    &cpu_usec);
+    int memory_ret = read_cgroup_value(dir_fd, *dir, "memory.current", NULL,
+                                       &memory);
+    int io_ret = read_cgroup_io(dir_fd, *dir, &rbytes, &wbytes);
+    close(dir_fd);
+    if (cpu_ret != 0 || memory_ret < 0 || io_ret < 0) {
+      if (cpu_ret == 1) {
+        fprintf(ERRORFILE, "%s is not a cgroup\n", *dir);
+      }
+      ret = ERROR_READING_CGROUP_STATS;
+      continue;
+    }
+    fprintf(LOGFILE, "%s cpu.usage_usec=%" PRId64, *dir, cpu_usec);
+    if (memory_ret == 0) {
+      fprintf(LOGFILE, " memory.current=%" PRId64, memory);
+    }
+    if (io_ret == 0) {
+      fprintf(LOGFILE, " io.rbytes=%" PRId64 " io.wbytes=%" PRId64, rbytes,
+              wbytes);
+    }
+    fprintf(LOGFILE, "\n");
+  }
+  fflush(LOGFILE);
+  fflush(ERRORFILE);
+  if (change_effective_user(user, group) != 0) {
+    return ERROR_READING_CGROUP_STATS;
+  }
+  return ret;
+}
+
 /**
  * Mount a cgroup controller at the requested mount point and create
  * a hierarchy for the Hadoop NodeManager to manage.
@@ -1923,6 +2715,8 @@ int mount_cgroup(const char *pair, const char *hierarchy) {
     fprintf(LOGFILE, "Failed to mount cgroup controller; invalid option: %s\n",
               pair);
     result = -1; 
+  } else if (strcmp(controller, CGROUP2_FS_TYPE) == 0) {
+    result = mount_cgroup2(mount_path, hierarchy);
   } else {
     if (mount("none", mount_path, "cgroup", 0, controller) == 0) {
       char *buf = stpncpy(hier_path, mount_path, strlen(mount_path));
@@ -2012,3 +2806,181 @@ int traffic_control_read_state(char *command_file) {
 int traffic_control_read_stats(char *command_file) {
   return run_traffic_control(TC_READ_STATS_OPTS, command_file);
 }
+
+#ifdef __linux
+/**
+ * Copy a netlink attribute into a structure, zeroing whatever a shorter
+ * attribute from another kernel version does not fill.
+ */
+static void copy_rta_payload(void *dest, size_t size, struct rtattr *rta) {
+  size_t payload = RTA_PAYLOAD(rta);
+  memset(dest, 0, size);
+  memcpy(dest, RTA_DATA(rta), payload < size ? payload : size);
+}
+
+/**
+ * Print the counters of one RTM_NEWTCLASS message as a line of the form
+ * "<interface> <major>:<minor> parent=<major>:<minor> bytes=<n> packets=<n>
+ * drops=<n> overlimits=<n>", with the handles in hex as tc prints them and
+ * the parent of a root class printed as "root".
+ */
+static void print_tc_class_stats(const char *interface, struct nlmsghdr *nlh) {
+  struct tcmsg *tcm = NLMSG_DATA(nlh);
+  int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*tcm));
+  uint64_t bytes = 0, packets = 0;
+  uint32_t drops = 0, overlimits = 0;
+  int have_stats2 = 0;
+  struct rtattr *rta;
+
+  for (rta = TCA_RTA(tcm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    if (rta->rta_type == TCA_STATS2) {
+      struct rtattr *nested = RTA_DATA(rta);
+      int nested_len = RTA_PAYLOAD(rta);
+      have_stats2 = 1;
+      for (; RTA_OK(nested, nested_len);
+           nested = RTA_NEXT(nested, nested_len)) {
+        if (nested->rta_type == TCA_STATS_BASIC) {
+          struct gnet_stats_basic basic;
+          copy_rta_payload(&basic, sizeof(basic), nested);
+          bytes = basic.bytes;
+          packets = basic.packets;
+        } else if (nested->rta_type == TCA_STATS_QUEUE) {
+          struct gnet_stats_queue queue;
+          copy_rta_payload(&queue, sizeof(queue), nested);
+          drops = queue.drops;
+          overlimits = queue.overlimits;
+        }
+      }
+    } else if (rta->rta_type == TCA_STATS && !have_stats2) {
+      // kernels older than TCA_STATS2 only send the old structure
+      struct tc_stats stats;
+      copy_rta_payload(&stats, sizeof(stats), rta);
+      bytes = stats.bytes;
+      packets = stats.packets;
+      drops = stats.drops;
+      overlimits = stats.overlimits;
+    }
+  }
+  fprintf(LOGFILE, "%s %x:%x", interface, TC_H_MAJ(tcm->tcm_handle) >> 16,
+          TC_H_MIN(tcm->tcm_handle));
+  if (tcm->tcm_parent == TC_H_ROOT) {
+    fprintf(LOGFILE, " parent=root");
+  } else {
+    fprintf(LOGFILE, " parent=%x:%x", TC_H_MAJ(tcm->tcm_parent) >> 16,
+            TC_H_MIN(tcm->tcm_parent));
+  }
+  fprintf(LOGFILE, " bytes=%" PRIu64 " packets=%" PRIu64 " drops=%" PRIu32
+          " overlimits=%" PRIu32 "\n", bytes, packets, drops, overlimits);
+}
+
+/**
+ * Dump the traffic control classes of an interface over a netlink socket
+ * and print the counters of each.
+ */
+static int read_tc_class_stats(const char *interface) {
+  unsigned int ifindex = if_nametoindex(interface);
+  if (ifindex == 0) {
+    fprintf(ERRORFILE, "Unknown interface %s - %s\n", interface,
+            strerror(errno));
+    return TRAFFIC_CONTROL_EXECUTION_FAILED;
+  }
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd == -1) {
+    fprintf(ERRORFILE, "Can't open netlink socket - %s\n", strerror(errno));
+    return TRAFFIC_CONTROL_EXECUTION_FAILED;
+  }
+
+  struct {
+    struct nlmsghdr nlh;
+    struct tcmsg tcm;
+  } request;
+  memset(&request, 0, sizeof(request));
+  request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(request.tcm));
+  request.nlh.nlmsg_type = RTM_GETTCLASS;
+  request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.nlh.nlmsg_seq = 1;
+  request.tcm.tcm_family = AF_UNSPEC;
+  request.tcm.tcm_ifindex = ifindex;
+  if (send(fd, &request, request.nlh.nlmsg_len, 0) == -1) {
+    fprintf(ERRORFILE, "Can't send netlink request - %s\n", strerror(errno));
+    close(fd);
+    return TRAFFIC_CONTROL_EXECUTION_FAILED;
+  }
+
+  // one receive gets as many classes as fit, so a large buffer keeps the
+  // number of system calls down when there are many containers
+  const size_t buffer_size = 64 * 1024;
+  char *buffer = malloc(buffer_size);
+  if (buffer == NULL) {
+    fprintf(ERRORFILE, "Can't allocate netlink buffer\n");
+    close(fd);
+    return TRAFFIC_CONTROL_EXECUTION_FAILED;
+  }
+  int ret = TRAFFIC_CONTROL_EXECUTION_FAILED;
+  int done = 0;
+  while (!done) {
+    ssize_t received = recv(fd, buffer, buffer_size, 0);
+    if (received == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(ERRORFILE, "Can't read netlink reply - %s\n", strerror(errno));
+      break;
+    }
+    if (received == 0) {
+      fprintf(ERRORFILE, "Netlink socket closed before the end of the dump\n");
+      break;
+    }
+    int len = received;
+    struct nlmsghdr *nlh;
+    for (nlh = (struct nlmsghdr *) buffer; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+      if (nlh->nlmsg_seq != request.nlh.nlmsg_seq) {
+        continue;
+      }
+      if (nlh->nlmsg_type == NLMSG_DONE) {
+        ret = 0;
+        done = 1;
+        break;
+      }
+      if (nlh->nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr *err = NLMSG_DATA(nlh);
+        fprintf(ERRORFILE, "Can't dump traffic control classes of %s - %s\n",
+                interface, strerror(-err->error));
+        done = 1;
+        break;
+      }
+      if (nlh->nlmsg_type == RTM_NEWTCLASS) {
+        print_tc_class_stats(interface, nlh);
+      }
+    }
+  }
+  free(buffer);
+  close(fd);
+  return ret;
+}
+#endif
+
+/**
+ * Print the counters of the traffic control classes of each interface, one
+ * line per class, reading them from the kernel over netlink rather than
+ * running tc and parsing its output.
+ */
+int traffic_control_read_class_stats(char* const* interfaces) {
+#ifndef __linux
+  fprintf(LOGFILE, "Failed to read traffic control class stats, not supported\n");
+  return TRAFFIC_CONTROL_EXECUTION_FAILED;
+#else
+  int ret = 0;
+  char* const* interface;
+  for (interface = interfaces; interface != NULL && *interface != NULL;
+       ++interface) {
+    if (read_tc_class_stats(*interface) != 0) {
+      ret = TRAFFIC_CONTROL_EXECUTION_FAILED;
+    }
+  }
+  fflush(LOGFILE);
+  fflush(ERRORFILE);
+  return ret;
+#endif
+}
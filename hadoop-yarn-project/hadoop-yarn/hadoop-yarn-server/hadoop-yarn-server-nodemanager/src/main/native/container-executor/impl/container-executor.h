@@ -59,7 +59,8 @@ enum errorcodes {
   TRAFFIC_CONTROL_EXECUTION_FAILED = 28,
   DOCKER_RUN_FAILED=29,
   ERROR_OPENING_FILE = 30,
-  ERROR_READING_FILE = 31
+  ERROR_READING_FILE = 31,
+  ERROR_READING_CGROUP_STATS = 32
 };
 
 enum operations {
@@ -73,7 +74,9 @@ enum operations {
   RUN_AS_USER_SIGNAL_CONTAINER = 8,
   RUN_AS_USER_DELETE = 9,
   RUN_AS_USER_LAUNCH_DOCKER_CONTAINER = 10,
-  RUN_DOCKER = 11
+  RUN_DOCKER = 11,
+  CGROUP2_STATS = 12,
+  TRAFFIC_CONTROL_READ_CLASS_STATS = 13
 };
 
 #define NM_GROUP_KEY "yarn.nodemanager.linux-container-executor.group"
@@ -86,6 +89,10 @@ enum operations {
 #define BANNED_USERS_KEY "banned.users"
 #define ALLOWED_SYSTEM_USERS_KEY "allowed.system.users"
 #define DOCKER_BINARY_KEY "docker.binary"
+#define DELETE_THREADS_KEY "delete.threads"
+#define CGROUP2_RESOURCES_KEY "cgroups2"
+#define CGROUP2_HIERARCHY_KEY "cgroup2.hierarchy"
+#define CGROUP2_FS_TYPE "cgroup2"
 #define TMP_DIR "tmp"
 
 extern struct passwd *user_detail;
@@ -249,6 +256,35 @@ int check_dir(const char* npath, mode_t st_mode, mode_t desired,
 int create_validate_dir(const char* npath, mode_t perm, const char* path,
    int finalComponent);
 
+/**
+ * Move a process into a cgroup v2 that is created for it, as root.
+ * cgroup_dir: the cgroup to create, in a hierarchy mounted with
+ *             mount_cgroup
+ * limits: controller files to write before moving the process, such as
+ *         cpu.weight=100, memory.max=1073741824 or io.max=8:0 wbps=1048576
+ * pid: the process to move
+ * Returns 0 on success
+ */
+int write_pid_to_cgroup2_as_root(const char *cgroup_dir, char* const* limits,
+                                 pid_t pid);
+
+/**
+ * Create a cgroup v2 with the given limits and move the process into it,
+ * as the current user.
+ */
+int create_cgroup2(const char *cgroup_dir, char* const* limits, pid_t pid);
+
+/**
+ * Print the CPU, memory and IO use of each of the given cgroup v2
+ * directories to LOGFILE, one line each, as
+ * "<dir> cpu.usage_usec=<n> memory.current=<n> io.rbytes=<n> io.wbytes=<n>",
+ * with the IO summed over all devices.  The memory and IO fields are left
+ * out of the line when the controller is not enabled for the cgroup.
+ * Returns 0 if all of them could be read, and otherwise
+ * ERROR_READING_CGROUP_STATS
+ */
+int read_cgroup2_stats(char* const* cgroup_dirs);
+
 /**
  * Run a batch of tc commands that modify interface configuration
  */
@@ -268,6 +304,15 @@ int traffic_control_read_state(char *command_file);
  */
 int traffic_control_read_stats(char *command_file);
 
+/**
+ * Read the counters of the traffic control classes of the given
+ * NULL-terminated list of interfaces over netlink. Each class is written to
+ * standard output as a line of the form "<interface> <classid>
+ * parent=<classid> bytes=<n> packets=<n> drops=<n> overlimits=<n>", with the
+ * class ids in tc's hex notation.
+ */
+int traffic_control_read_class_stats(char* const* interfaces);
+
 
 /**
  * Run a docker command passing the command file as an argument
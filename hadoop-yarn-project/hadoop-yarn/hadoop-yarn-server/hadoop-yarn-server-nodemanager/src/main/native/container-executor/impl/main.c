@@ -49,7 +49,9 @@ static void display_usage(FILE *stream) {
       "       container-executor --tc-modify-state <command-file>\n" \
       "       container-executor --tc-read-state <command-file>\n" \
       "       container-executor --tc-read-stats <command-file>\n" \
+      "       container-executor --tc-read-class-stats <interface>...\n" \
       "       container-executor --run-docker <command-file>\n" \
+      "       container-executor --cgroup2-stats <cgroup-dir>...\n" \
       "       container-executor <user> <yarn-user> <command> <command-args>\n"  \
       "       where command and command-args: \n" \
       "            initialize container:  %2d appid tokens nm-local-dirs nm-log-dirs cmd app...\n" \
@@ -164,6 +166,8 @@ static struct {
   int container_pid;
   int signal;
   const char *docker_command_file;
+  char **cgroup_dirs;
+  char **tc_interfaces;
 } cmd_input;
 
 static int validate_run_as_user_commands(int argc, char **argv, int *operation);
@@ -231,6 +235,17 @@ static int validate_arguments(int argc, char **argv , int *operation) {
     return 0;
   }
 
+  if (strcmp("--tc-read-class-stats", argv[1]) == 0) {
+    if (argc < 3) {
+      display_usage(stdout);
+      return INVALID_ARGUMENT_NUMBER;
+    }
+    optind++;
+    cmd_input.tc_interfaces = argv + optind;
+    *operation = TRAFFIC_CONTROL_READ_CLASS_STATS;
+    return 0;
+  }
+
   if (strcmp("--run-docker", argv[1]) == 0) {
     if (argc != 3) {
       display_usage(stdout);
@@ -241,6 +256,17 @@ static int validate_arguments(int argc, char **argv , int *operation) {
     *operation = RUN_DOCKER;
     return 0;
   }
+
+  if (strcmp("--cgroup2-stats", argv[1]) == 0) {
+    if (argc < 3) {
+      display_usage(stdout);
+      return INVALID_ARGUMENT_NUMBER;
+    }
+    optind++;
+    cmd_input.cgroup_dirs = argv + optind;
+    *operation = CGROUP2_STATS;
+    return 0;
+  }
   /* Now we have to validate 'run as user' operations that don't use
     a 'long option' - we should fix this at some point. The validation/argument
     parsing here is extensive enough that it done in a separate function */
@@ -535,6 +561,12 @@ int main(int argc, char **argv) {
                         cmd_input.dir_to_be_deleted,
                         argv + optind);
     break;
+  case CGROUP2_STATS:
+    exit_code = read_cgroup2_stats(cmd_input.cgroup_dirs);
+    break;
+  case TRAFFIC_CONTROL_READ_CLASS_STATS:
+    exit_code = traffic_control_read_class_stats(cmd_input.tc_interfaces);
+    break;
   }
 
   flush_and_close_log_files();
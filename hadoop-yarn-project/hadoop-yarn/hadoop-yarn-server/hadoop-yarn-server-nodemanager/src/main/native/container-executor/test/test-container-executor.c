@@ -100,6 +100,8 @@ int write_config_file(char *file_name, int banned) {
   if (banned != 0) {
     fprintf(file, "banned.users=bannedUser\n");
     fprintf(file, "min.user.id=500\n");
+    fprintf(file, "delete.threads=4\n");
+    fprintf(file, "cgroup2.hierarchy=" TEST_ROOT "/cgroup2\n");
   } else {
     fprintf(file, "min.user.id=0\n");
   }
@@ -234,6 +236,48 @@ void test_check_user(int expectedFailure) {
   }
 }
 
+void test_read_config() {
+  printf("\nTesting read_config\n");
+  FILE *file = fopen(TEST_ROOT "/many.cfg", "w");
+  if (file == NULL) {
+    printf("FAIL: failed to open " TEST_ROOT "/many.cfg\n");
+    exit(1);
+  }
+  int i;
+  for (i = 0; i < 1000; i++) {
+    fprintf(file, "key.%d=value%d\n", i, i);
+  }
+  fprintf(file, "key.7=duplicate\n");
+  fprintf(file, "commented=#value\n");
+  fclose(file);
+
+  struct configuration cfg = {.size=0, .confdetails=NULL};
+  read_config(TEST_ROOT "/many.cfg", &cfg);
+  if (cfg.size != 1001) {
+    printf("FAIL: expected 1001 entries but got %d\n", cfg.size);
+    exit(1);
+  }
+  for (i = 0; i < 1000; i++) {
+    char key[20];
+    char expected[20];
+    sprintf(key, "key.%d", i);
+    sprintf(expected, "value%d", i);
+    char *value = get_value(key, &cfg);
+    if (value == NULL || strcmp(value, expected) != 0) {
+      printf("FAIL: expected %s for %s but got %s\n", expected, key,
+             value == NULL ? "null" : value);
+      exit(1);
+    }
+    free(value);
+  }
+  if (get_value("key.1000", &cfg) != NULL ||
+      get_value("commented", &cfg) != NULL) {
+    printf("FAIL: found a key that is not in the configuration\n");
+    exit(1);
+  }
+  free_configurations(&cfg);
+}
+
 void test_resolve_config_path() {
   printf("\nTesting resolve_config_path\n");
   if (strcmp(resolve_config_path(TEST_ROOT, NULL), TEST_ROOT) != 0) {
@@ -260,6 +304,22 @@ void test_check_configuration_permissions() {
   }
 }
 
+void test_initialize_user_bad_disk() {
+  // the middle disk has no usercache, so its user directory can't be made
+  char *dirs[] = { TEST_ROOT "/local-1", TEST_ROOT "/no-such-disk",
+                   TEST_ROOT "/local-3", NULL };
+  if (initialize_user(yarn_username, dirs) != INITIALIZE_USER_FAILED) {
+    printf("FAIL: initialize_user succeeded with a missing disk\n");
+    exit(1);
+  }
+  char *user_dir = get_user_directory(TEST_ROOT "/local-3", yarn_username);
+  if (access(user_dir, R_OK) != 0) {
+    printf("FAIL: failed to create user directory %s\n", user_dir);
+    exit(1);
+  }
+  free(user_dir);
+}
+
 void test_delete_container() {
   if (initialize_user(yarn_username, local_dirs)) {
     printf("FAIL: failed to initialize user %s\n", yarn_username);
@@ -383,6 +443,57 @@ void test_delete_app() {
   free(dont_touch);
 }
 
+void test_delete_app_parallel() {
+  char buffer[100000];
+  char subdir[4096];
+  char** local_dir;
+  char* dont_touch = get_app_directory(TEST_ROOT "/local-3", yarn_username,
+                                       DONT_TOUCH_FILE);
+  for(local_dir = local_dirs; *local_dir != NULL; ++local_dir) {
+    char* container_dir = get_container_work_directory(*local_dir,
+                                      yarn_username, "app_4", "container_1");
+    int i;
+    for(i = 0; i < 8; ++i) {
+      sprintf(buffer, "mkdir -p %s/dir%d/a/b/c && touch %s/dir%d/a/b/c/file"
+              " %s/dir%d/file %s/file%d", container_dir, i, container_dir, i,
+              container_dir, i, container_dir, i);
+      run(buffer);
+    }
+    // soft link to the canary file from the container directory
+    sprintf(buffer, "ln -s %s %s/dir0/softlink", dont_touch, container_dir);
+    run(buffer);
+    // create a no permission directory
+    sprintf(buffer, "chmod 000 %s/dir1/a", container_dir);
+    run(buffer);
+    free(container_dir);
+  }
+  sprintf(buffer, "touch %s", dont_touch);
+  run(buffer);
+
+  // delete the app directory from every local dir at once
+  sprintf(subdir, "usercache/%s/appcache/app_4", yarn_username);
+  int ret = delete_as_user(yarn_username, subdir, local_dirs);
+  if (ret != 0) {
+    printf("FAIL: return code from delete_as_user is %d\n", ret);
+    exit(1);
+  }
+
+  for(local_dir = local_dirs; *local_dir != NULL; ++local_dir) {
+    char* app_dir = get_app_directory(*local_dir, yarn_username, "app_4");
+    if (access(app_dir, R_OK) == 0) {
+      printf("FAIL: didn't delete the directory - %s\n", app_dir);
+      exit(1);
+    }
+    free(app_dir);
+  }
+  // but that the canary is not gone
+  if (access(dont_touch, R_OK) != 0) {
+    printf("FAIL: accidently deleted file %s\n", dont_touch);
+    exit(1);
+  }
+  free(dont_touch);
+}
+
 
 void test_delete_user() {
   printf("\nTesting delete_user\n");
@@ -844,6 +955,142 @@ void test_recursive_unlink_children() {
   }
 }
 
+static void write_file_or_die(const char *path, const char *contents) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL || fputs(contents, file) < 0 || fclose(file) != 0) {
+    printf("Failed to write %s\n", path);
+    exit(1);
+  }
+}
+
+static void expect_file_contents(const char *path, const char *expected) {
+  char buffer[1024];
+  FILE *file = fopen(path, "r");
+  size_t len = file == NULL ? 0 : fread(buffer, 1, sizeof(buffer) - 1, file);
+  buffer[len] = '\0';
+  if (file != NULL) {
+    fclose(file);
+  }
+  if (strcmp(buffer, expected) != 0) {
+    printf("FAIL: expected %s to contain '%s' but it has '%s'\n", path,
+           expected, buffer);
+    exit(1);
+  }
+}
+
+void test_create_cgroup2() {
+  printf("\nTesting create_cgroup2\n");
+  // a cgroup2 directory has its interface files already, so fake them
+  mkdir_or_die(TEST_ROOT "/cgroup2");
+  mkdir_or_die(TEST_ROOT "/cgroup2/container_1");
+  touch_or_die(TEST_ROOT "/cgroup2/container_1/cpu.weight");
+  touch_or_die(TEST_ROOT "/cgroup2/container_1/memory.max");
+  touch_or_die(TEST_ROOT "/cgroup2/container_1/io.max");
+  touch_or_die(TEST_ROOT "/cgroup2/container_1/cgroup.procs");
+  char *limits[] = { "cpu.weight=150", "memory.max=1073741824",
+                     "io.max=8:0 wbps=1048576", NULL };
+  if (create_cgroup2(TEST_ROOT "/cgroup2/container_1", limits, 1234) != 0) {
+    printf("FAIL: create_cgroup2 failed\n");
+    exit(1);
+  }
+  expect_file_contents(TEST_ROOT "/cgroup2/container_1/cpu.weight", "150");
+  expect_file_contents(TEST_ROOT "/cgroup2/container_1/memory.max",
+                       "1073741824");
+  expect_file_contents(TEST_ROOT "/cgroup2/container_1/io.max",
+                       "8:0 wbps=1048576");
+  expect_file_contents(TEST_ROOT "/cgroup2/container_1/cgroup.procs", "1234");
+
+  // only the limit files may be written
+  char *bad_limits[] = { "../test.cfg=x", NULL };
+  if (create_cgroup2(TEST_ROOT "/cgroup2/container_1", bad_limits, 1234) == 0) {
+    printf("FAIL: create_cgroup2 wrote a file that is not a limit\n");
+    exit(1);
+  }
+
+  // only direct children of the configured hierarchy, not reached through
+  // links or "..", may be created or written
+  mkdir_or_die(TEST_ROOT "/cgroup2-outside");
+  touch_or_die(TEST_ROOT "/cgroup2-outside/cgroup.procs");
+  if (symlink(TEST_ROOT "/cgroup2-outside", TEST_ROOT "/cgroup2/link") != 0 ||
+      symlink(TEST_ROOT "/cgroup2", TEST_ROOT "/cgroup2-link") != 0) {
+    printf("FAIL: failed to create links - %s\n", strerror(errno));
+    exit(1);
+  }
+  const char *bad_dirs[] = {
+    TEST_ROOT "/cgroup2-outside",
+    TEST_ROOT "/cgroup2/link",
+    TEST_ROOT "/cgroup2-link/container_1",
+    TEST_ROOT "/cgroup2/container_1/../container_1",
+    TEST_ROOT "/cgroup2/..",
+    TEST_ROOT "/cgroup2/container_1/nested",
+    TEST_ROOT "/cgroup2/",
+    NULL
+  };
+  const char **bad_dir;
+  for (bad_dir = bad_dirs; *bad_dir != NULL; ++bad_dir) {
+    if (create_cgroup2(*bad_dir, NULL, 1234) == 0) {
+      printf("FAIL: create_cgroup2 accepted %s\n", *bad_dir);
+      exit(1);
+    }
+  }
+  expect_file_contents(TEST_ROOT "/cgroup2-outside/cgroup.procs", "");
+  if (access(TEST_ROOT "/cgroup2/container_1/nested", F_OK) == 0) {
+    printf("FAIL: create_cgroup2 created a nested cgroup\n");
+    exit(1);
+  }
+}
+
+void test_read_cgroup2_stats() {
+  printf("\nTesting read_cgroup2_stats\n");
+  mkdir_or_die(TEST_ROOT "/cgroup2/stats");
+  write_file_or_die(TEST_ROOT "/cgroup2/stats/cpu.stat",
+                    "usage_usec 123456\nuser_usec 100000\n"
+                    "system_usec 23456\n");
+  write_file_or_die(TEST_ROOT "/cgroup2/stats/memory.current", "4096\n");
+  write_file_or_die(TEST_ROOT "/cgroup2/stats/io.stat",
+                    "8:0 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n"
+                    "8:16 rbytes=1000 wbytes=2000 rios=3 wios=4 dbytes=0 dios=0\n");
+
+  FILE *saved = LOGFILE;
+  LOGFILE = fopen(TEST_ROOT "/cgroup2-stats.out", "w");
+  char *dirs[] = { TEST_ROOT "/cgroup2/stats", NULL };
+  int ret = read_cgroup2_stats(dirs);
+  char *missing[] = { TEST_ROOT "/cgroup2/missing", NULL };
+  int missing_ret = read_cgroup2_stats(missing);
+  // the stats of a cgroup outside the hierarchy are not read
+  char *outside[] = { TEST_ROOT "/cgroup2-link/stats", NULL };
+  int outside_ret = read_cgroup2_stats(outside);
+  fclose(LOGFILE);
+  LOGFILE = saved;
+  if (ret != 0 || missing_ret != ERROR_READING_CGROUP_STATS ||
+      outside_ret != ERROR_READING_CGROUP_STATS) {
+    printf("FAIL: read_cgroup2_stats returned %d, %d and %d\n", ret,
+           missing_ret, outside_ret);
+    exit(1);
+  }
+  expect_file_contents(TEST_ROOT "/cgroup2-stats.out",
+      TEST_ROOT "/cgroup2/stats cpu.usage_usec=123456 memory.current=4096"
+      " io.rbytes=1100 io.wbytes=2200\n");
+}
+
+void test_traffic_control_read_class_stats() {
+  printf("\nTesting traffic_control_read_class_stats\n");
+  FILE *saved = LOGFILE;
+  LOGFILE = fopen(TEST_ROOT "/tc-class-stats.out", "w");
+  // the loopback interface may or may not have classes, but can be dumped
+  char *interfaces[] = { "lo", NULL };
+  int ret = traffic_control_read_class_stats(interfaces);
+  char *missing[] = { "no-such-interface", NULL };
+  int missing_ret = traffic_control_read_class_stats(missing);
+  fclose(LOGFILE);
+  LOGFILE = saved;
+  if (ret != 0 || missing_ret != TRAFFIC_CONTROL_EXECUTION_FAILED) {
+    printf("FAIL: traffic_control_read_class_stats returned %d and %d\n",
+           ret, missing_ret);
+    exit(1);
+  }
+}
+
 // This test is expected to be executed either by a regular
 // user or by root. If executed by a regular user it doesn't
 // test all the functions that would depend on changing the
@@ -901,9 +1148,17 @@ int main(int argc, char **argv) {
   printf("\nTesting recursive_unlink_children()\n");
   test_recursive_unlink_children();
 
+  test_read_config();
+
   printf("\nTesting resolve_config_path()\n");
   test_resolve_config_path();
 
+  test_create_cgroup2();
+
+  test_read_cgroup2_stats();
+
+  test_traffic_control_read_class_stats();
+
   printf("\nTesting get_user_directory()\n");
   test_get_user_directory();
 
@@ -921,12 +1176,18 @@ int main(int argc, char **argv) {
 
   test_check_configuration_permissions();
 
+  printf("\nTesting initialize_user() with a bad disk\n");
+  test_initialize_user_bad_disk();
+
   printf("\nTesting delete_container()\n");
   test_delete_container();
 
   printf("\nTesting delete_app()\n");
   test_delete_app();
 
+  printf("\nTesting delete_app() in parallel\n");
+  test_delete_app_parallel();
+
   test_check_user(0);
 
   // the tests that change user need to be run in a subshell, so that